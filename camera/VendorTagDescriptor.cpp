@@ -48,10 +48,47 @@ static sp<VendorTagDescriptor> sGlobalVendorTagDescriptor;
 
 VendorTagDescriptor::VendorTagDescriptor() {}
 
-VendorTagDescriptor::~VendorTagDescriptor() {
-    size_t len = mReverseMapping.size();
-    for (size_t i = 0; i < len; ++i)  {
-        delete mReverseMapping[i];
+VendorTagDescriptor::~VendorTagDescriptor() {}
+
+uint32_t VendorTagDescriptor::hashTagName(const String8& section, const String8& name) {
+    // FNV-1a over "section.name"
+    uint32_t hash = 2166136261u;
+    const char* s = section.string();
+    for (size_t i = 0; i < section.length(); ++i) {
+        hash = (hash ^ static_cast<uint8_t>(s[i])) * 16777619u;
+    }
+    hash = (hash ^ static_cast<uint8_t>('.')) * 16777619u;
+    s = name.string();
+    for (size_t i = 0; i < name.length(); ++i) {
+        hash = (hash ^ static_cast<uint8_t>(s[i])) * 16777619u;
+    }
+    return hash;
+}
+
+void VendorTagDescriptor::buildTagHashTable() {
+    size_t count = mTagToNameMap.size();
+    size_t capacity = 1;
+    while (capacity < count * 2) {
+        capacity <<= 1;
+    }
+    TagHashEntry empty;
+    empty.hash = 0;
+    empty.tag = 0;
+    mTagHashTable.clear();
+    mTagHashTable.insertAt(empty, 0, capacity);
+
+    const size_t mask = capacity - 1;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t tag = mTagToNameMap.keyAt(i);
+        const String8& section = mSections[mTagToSectionMap.valueFor(tag)];
+        TagHashEntry entry;
+        entry.hash = hashTagName(section, mTagToNameMap.valueAt(i));
+        entry.tag = tag;
+        size_t slot = entry.hash & mask;
+        while (mTagHashTable[slot].tag != 0) {
+            slot = (slot + 1) & mask;
+        }
+        mTagHashTable.editItemAt(slot) = entry;
     }
 }
 
@@ -122,16 +159,11 @@ status_t VendorTagDescriptor::createDescriptorFromOps(const vendor_tag_ops_t* vO
         ssize_t index = sections.indexOf(sectionString);
         LOG_ALWAYS_FATAL_IF(index < 0, "index %zd must be non-negative", index);
         desc->mTagToSectionMap.add(tag, static_cast<uint32_t>(index));
-
-        // Set up reverse mapping
-        ssize_t reverseIndex = -1;
-        if ((reverseIndex = desc->mReverseMapping.indexOfKey(sectionString)) < 0) {
-            KeyedVector<String8, uint32_t>* nameMapper = new KeyedVector<String8, uint32_t>();
-            reverseIndex = desc->mReverseMapping.add(sectionString, nameMapper);
-        }
-        desc->mReverseMapping[reverseIndex]->add(desc->mTagToNameMap.valueFor(tag), tag);
     }
 
+    // Set up reverse mapping
+    desc->buildTagHashTable();
+
     descriptor = desc;
     return OK;
 }
@@ -233,17 +265,7 @@ status_t VendorTagDescriptor::createFromParcel(const Parcel* parcel,
     LOG_ALWAYS_FATAL_IF(static_cast<size_t>(tagCount) != allTags.size(),
                         "tagCount must be the same as allTags size");
     // Set up reverse mapping
-    for (size_t i = 0; i < static_cast<size_t>(tagCount); ++i) {
-        uint32_t tag = allTags[i];
-        String8 sectionString = desc->mSections[desc->mTagToSectionMap.valueFor(tag)];
-
-        ssize_t reverseIndex = -1;
-        if ((reverseIndex = desc->mReverseMapping.indexOfKey(sectionString)) < 0) {
-            KeyedVector<String8, uint32_t>* nameMapper = new KeyedVector<String8, uint32_t>();
-            reverseIndex = desc->mReverseMapping.add(sectionString, nameMapper);
-        }
-        desc->mReverseMapping[reverseIndex]->add(desc->mTagToNameMap.valueFor(tag), tag);
-    }
+    desc->buildTagHashTable();
 
     descriptor = desc;
     return res;
@@ -329,22 +351,32 @@ SortedVector<String8> VendorTagDescriptor::getAllSectionNames() const {
 }
 
 status_t VendorTagDescriptor::lookupTag(String8 name, String8 section, /*out*/uint32_t* tag) const {
-    ssize_t index = mReverseMapping.indexOfKey(section);
-    if (index < 0) {
-        ALOGE("%s: Section '%s' does not exist.", __FUNCTION__, section.string());
-        return BAD_VALUE;
+    size_t capacity = mTagHashTable.size();
+    if (capacity > 0) {
+        const size_t mask = capacity - 1;
+        const uint32_t hash = hashTagName(section, name);
+        for (size_t slot = hash & mask; mTagHashTable[slot].tag != 0; slot = (slot + 1) & mask) {
+            const TagHashEntry& entry = mTagHashTable[slot];
+            if (entry.hash != hash) {
+                continue;
+            }
+            // Rule out hash collisions; the entry is known to exist in both maps
+            if (mTagToNameMap.valueFor(entry.tag) == name &&
+                    mSections[mTagToSectionMap.valueFor(entry.tag)] == section) {
+                if (tag != NULL) {
+                    *tag = entry.tag;
+                }
+                return OK;
+            }
+        }
     }
 
-    ssize_t nameIndex = mReverseMapping[index]->indexOfKey(name);
-    if (nameIndex < 0) {
+    if (mSections.indexOf(section) < 0) {
+        ALOGE("%s: Section '%s' does not exist.", __FUNCTION__, section.string());
+    } else {
         ALOGE("%s: Tag name '%s' does not exist.", __FUNCTION__, name.string());
-        return BAD_VALUE;
     }
-
-    if (tag != NULL) {
-        *tag = mReverseMapping[index]->valueAt(nameIndex);
-    }
-    return OK;
+    return BAD_VALUE;
 }
 
 void VendorTagDescriptor::dump(int fd, int verbosity, int indentation) const {
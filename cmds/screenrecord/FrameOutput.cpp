@@ -80,6 +80,7 @@ status_t FrameOutput::createInputSurface(int width, int height,
     mGlConsumer->setFrameAvailableListener(this);
 
     mPixelBuf = new uint8_t[width * height * kGlBytesPerPixel];
+    mPixelBufSize = width * height * kGlBytesPerPixel;
 
     *pBufferProducer = producer;
 
@@ -87,6 +88,27 @@ status_t FrameOutput::createInputSurface(int width, int height,
     return NO_ERROR;
 }
 
+status_t FrameOutput::createCpuInputSurface(int width, int height,
+        sp<IGraphicBufferProducer>* pBufferProducer) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    mCpuConsumer = new CpuConsumer(consumer, 1);
+    mCpuConsumer->setName(String8("virtual display"));
+    mCpuConsumer->setDefaultBufferSize(width, height);
+    mCpuConsumer->setDefaultBufferFormat(HAL_PIXEL_FORMAT_RGBA_8888);
+
+    mCpuConsumer->setFrameAvailableListener(this);
+
+    mPixelBuf = new uint8_t[width * height * kOutBytesPerPixel];
+    mPixelBufSize = width * height * kOutBytesPerPixel;
+
+    *pBufferProducer = producer;
+
+    ALOGD("FrameOutput::createCpuInputSurface OK");
+    return NO_ERROR;
+}
+
 status_t FrameOutput::copyFrame(FILE* fp, long timeoutUsec, bool rawFrames) {
     Mutex::Autolock _l(mMutex);
     ALOGV("copyFrame %ld\n", timeoutUsec);
@@ -113,45 +135,17 @@ status_t FrameOutput::copyFrame(FILE* fp, long timeoutUsec, bool rawFrames) {
     // A frame is available.  Clear the flag for the next round.
     mFrameAvailable = false;
 
-    float texMatrix[16];
-    mGlConsumer->updateTexImage();
-    mGlConsumer->getTransformMatrix(texMatrix);
-
-    // The data is in an external texture, so we need to render it to the
-    // pbuffer to get access to RGB pixel data.  We also want to flip it
-    // upside-down for easy conversion to a bitmap.
-    int width = mEglWindow.getWidth();
-    int height = mEglWindow.getHeight();
-    status_t err = mExtTexProgram.blit(mExtTextureName, texMatrix, 0, 0,
-            width, height, true);
+    int width, height;
+    status_t err;
+    if (mCpuConsumer != NULL) {
+        err = readCpuFrame_l(&width, &height);
+    } else {
+        err = readGlFrame_l(&width, &height);
+    }
     if (err != NO_ERROR) {
         return err;
     }
 
-    // GLES only guarantees that glReadPixels() will work with GL_RGBA, so we
-    // need to get 4 bytes/pixel and reduce it.  Depending on the size of the
-    // screen and the device capabilities, this can take a while.
-    int64_t startWhenNsec, pixWhenNsec, endWhenNsec;
-    if (kShowTiming) {
-        startWhenNsec = systemTime(CLOCK_MONOTONIC);
-    }
-    GLenum glErr;
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, mPixelBuf);
-    if ((glErr = glGetError()) != GL_NO_ERROR) {
-        ALOGE("glReadPixels failed: %#x", glErr);
-        return UNKNOWN_ERROR;
-    }
-    if (kShowTiming) {
-        pixWhenNsec = systemTime(CLOCK_MONOTONIC);
-    }
-    reduceRgbaToRgb(mPixelBuf, width * height);
-    if (kShowTiming) {
-        endWhenNsec = systemTime(CLOCK_MONOTONIC);
-        ALOGD("got pixels (get=%.3f ms, reduce=%.3fms)",
-                (pixWhenNsec - startWhenNsec) / 1000000.0,
-                (endWhenNsec - pixWhenNsec) / 1000000.0);
-    }
-
     size_t rgbDataLen = width * height * kOutBytesPerPixel;
 
     if (!rawFrames) {
@@ -170,6 +164,7 @@ status_t FrameOutput::copyFrame(FILE* fp, long timeoutUsec, bool rawFrames) {
     // Currently using buffered I/O rather than writev().  Not expecting it
     // to make much of a difference, but it might be worth a test for larger
     // frame sizes.
+    int64_t startWhenNsec, endWhenNsec;
     if (kShowTiming) {
         startWhenNsec = systemTime(CLOCK_MONOTONIC);
     }
@@ -190,18 +185,112 @@ status_t FrameOutput::copyFrame(FILE* fp, long timeoutUsec, bool rawFrames) {
     return NO_ERROR;
 }
 
+status_t FrameOutput::readCpuFrame_l(int* pWidth, int* pHeight) {
+    CpuConsumer::LockedBuffer buf;
+    status_t err = mCpuConsumer->lockNextBuffer(&buf);
+    if (err == BAD_VALUE) {
+        // No buffer queued after all, treat like a timeout.
+        return ETIMEDOUT;
+    } else if (err != NO_ERROR) {
+        ALOGE("lockNextBuffer failed: %d", err);
+        return err;
+    }
+
+    if (buf.format != HAL_PIXEL_FORMAT_RGBA_8888 &&
+            buf.format != HAL_PIXEL_FORMAT_RGBX_8888) {
+        ALOGE("unexpected buffer format %#x", buf.format);
+        mCpuConsumer->unlockBuffer(buf);
+        return UNKNOWN_ERROR;
+    }
+
+    int64_t startWhenNsec, endWhenNsec;
+    if (kShowTiming) {
+        startWhenNsec = systemTime(CLOCK_MONOTONIC);
+    }
+    // The buffer is already top-down, only the row stride needs handling.
+    const size_t rgbStride = buf.width * kOutBytesPerPixel;
+    if (rgbStride * buf.height > mPixelBufSize) {
+        ALOGE("unexpected buffer size %ux%u", buf.width, buf.height);
+        mCpuConsumer->unlockBuffer(buf);
+        return UNKNOWN_ERROR;
+    }
+    for (uint32_t y = 0; y < buf.height; y++) {
+        copyRgbaToRgb(mPixelBuf + y * rgbStride,
+                buf.data + y * buf.stride * kGlBytesPerPixel, buf.width);
+    }
+    if (kShowTiming) {
+        endWhenNsec = systemTime(CLOCK_MONOTONIC);
+        ALOGD("got pixels (reduce=%.3f ms)",
+                (endWhenNsec - startWhenNsec) / 1000000.0);
+    }
+
+    *pWidth = buf.width;
+    *pHeight = buf.height;
+    mCpuConsumer->unlockBuffer(buf);
+    return NO_ERROR;
+}
+
+status_t FrameOutput::readGlFrame_l(int* pWidth, int* pHeight) {
+    float texMatrix[16];
+    mGlConsumer->updateTexImage();
+    mGlConsumer->getTransformMatrix(texMatrix);
+
+    // The data is in an external texture, so we need to render it to the
+    // pbuffer to get access to RGB pixel data.  We also want to flip it
+    // upside-down for easy conversion to a bitmap.
+    int width = mEglWindow.getWidth();
+    int height = mEglWindow.getHeight();
+    status_t err = mExtTexProgram.blit(mExtTextureName, texMatrix, 0, 0,
+            width, height, true);
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    // GLES only guarantees that glReadPixels() will work with GL_RGBA, so we
+    // need to get 4 bytes/pixel and reduce it.  Depending on the size of the
+    // screen and the device capabilities, this can take a while.
+    int64_t startWhenNsec, pixWhenNsec, endWhenNsec;
+    if (kShowTiming) {
+        startWhenNsec = systemTime(CLOCK_MONOTONIC);
+    }
+    GLenum glErr;
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, mPixelBuf);
+    if ((glErr = glGetError()) != GL_NO_ERROR) {
+        ALOGE("glReadPixels failed: %#x", glErr);
+        return UNKNOWN_ERROR;
+    }
+    if (kShowTiming) {
+        pixWhenNsec = systemTime(CLOCK_MONOTONIC);
+    }
+    reduceRgbaToRgb(mPixelBuf, width * height);
+    if (kShowTiming) {
+        endWhenNsec = systemTime(CLOCK_MONOTONIC);
+        ALOGD("got pixels (get=%.3f ms, reduce=%.3fms)",
+                (pixWhenNsec - startWhenNsec) / 1000000.0,
+                (endWhenNsec - pixWhenNsec) / 1000000.0);
+    }
+
+    *pWidth = width;
+    *pHeight = height;
+    return NO_ERROR;
+}
+
 void FrameOutput::reduceRgbaToRgb(uint8_t* buf, unsigned int pixelCount) {
-    // Convert RGBA to RGB.
+    copyRgbaToRgb(buf, buf, pixelCount);
+}
+
+void FrameOutput::copyRgbaToRgb(uint8_t* dst, const uint8_t* src,
+        unsigned int pixelCount) {
+    // Convert RGBA to RGB.  dst may be the same as src.
     //
     // Unaligned 32-bit accesses are allowed on ARM, so we could do this
     // with 32-bit copies advancing at different rates (taking care at the
     // end to not go one byte over).
-    const uint8_t* readPtr = buf;
     for (unsigned int i = 0; i < pixelCount; i++) {
-        *buf++ = *readPtr++;
-        *buf++ = *readPtr++;
-        *buf++ = *readPtr++;
-        readPtr++;
+        *dst++ = *src++;
+        *dst++ = *src++;
+        *dst++ = *src++;
+        src++;
     }
 }
 
@@ -21,6 +21,7 @@
 #include "EglWindow.h"
 
 #include <gui/BufferQueue.h>
+#include <gui/CpuConsumer.h>
 #include <gui/GLConsumer.h>
 
 namespace android {
@@ -32,7 +33,8 @@ class FrameOutput : public GLConsumer::FrameAvailableListener {
 public:
     FrameOutput() : mFrameAvailable(false),
         mExtTextureName(0),
-        mPixelBuf(NULL)
+        mPixelBuf(NULL),
+        mPixelBufSize(0)
         {}
 
     // Create an "input surface", similar in purpose to a MediaCodec input
@@ -41,6 +43,12 @@ public:
     status_t createInputSurface(int width, int height,
             sp<IGraphicBufferProducer>* pBufferProducer);
 
+    // Like createInputSurface(), but the virtual display renders into
+    // CPU-readable RGBA buffers that are read directly, with no GLES pass or
+    // glReadPixels() stall.  No EGL state is set up.
+    status_t createCpuInputSurface(int width, int height,
+            sp<IGraphicBufferProducer>* pBufferProducer);
+
     // Copy one from input to output.  If no frame is available, this will wait up to the
     // specified number of microseconds.
     //
@@ -49,7 +57,9 @@ public:
 
     // Prepare to copy frames.  Makes the EGL context used by this object current.
     void prepareToCopy() {
-        mEglWindow.makeCurrent();
+        if (mCpuConsumer == NULL) {
+            mEglWindow.makeCurrent();
+        }
     }
 
 private:
@@ -67,6 +77,14 @@ private:
     // Reduces RGBA to RGB, in place.
     static void reduceRgbaToRgb(uint8_t* buf, unsigned int pixelCount);
 
+    // Reduces RGBA to RGB, from src into dst.
+    static void copyRgbaToRgb(uint8_t* dst, const uint8_t* src,
+            unsigned int pixelCount);
+
+    // Fill mPixelBuf with the next frame as top-down RGB.
+    status_t readGlFrame_l(int* pWidth, int* pHeight);
+    status_t readCpuFrame_l(int* pWidth, int* pHeight);
+
     // Put a 32-bit value into a buffer, in little-endian byte order.
     static void setValueLE(uint8_t* buf, uint32_t value);
 
@@ -81,6 +99,9 @@ private:
     // as an external texture.
     sp<GLConsumer> mGlConsumer;
 
+    // Alternative to mGlConsumer, set by createCpuInputSurface().
+    sp<CpuConsumer> mCpuConsumer;
+
     // EGL display / context / surface.
     EglWindow mEglWindow;
 
@@ -92,6 +113,7 @@ private:
 
     // Pixel data buffer.
     uint8_t* mPixelBuf;
+    size_t mPixelBufSize;
 };
 
 }; // namespace android
@@ -74,6 +74,7 @@ static enum {
 static bool gSizeSpecified = false;     // was size explicitly requested?
 static bool gWantInfoScreen = false;    // do we want initial info screen?
 static bool gWantFrameTime = false;     // do we want times on each frame?
+static bool gCpuFrames = false;         // read frames without GLES readback?
 static uint32_t gVideoWidth = 0;        // default width+height
 static uint32_t gVideoHeight = 0;
 static uint32_t gBitRate = 4000000;     // 4Mbps
@@ -594,7 +595,13 @@ static status_t recordScreen(const char* fileName) {
         // We're not using an encoder at all.  The "encoder input surface" we hand to
         // SurfaceFlinger will just feed directly to us.
         frameOutput = new FrameOutput();
-        err = frameOutput->createInputSurface(gVideoWidth, gVideoHeight, &encoderInputSurface);
+        if (gCpuFrames) {
+            err = frameOutput->createCpuInputSurface(gVideoWidth, gVideoHeight,
+                    &encoderInputSurface);
+        } else {
+            err = frameOutput->createInputSurface(gVideoWidth, gVideoHeight,
+                    &encoderInputSurface);
+        }
         if (err != NO_ERROR) {
             return err;
         }
@@ -890,6 +897,7 @@ int main(int argc, char* const argv[]) {
         { "show-frame-time",    no_argument,        NULL, 'f' },
         { "rotate",             no_argument,        NULL, 'r' },
         { "output-format",      required_argument,  NULL, 'o' },
+        { "cpu-frames",         no_argument,        NULL, 'c' },
         { NULL,                 0,                  NULL, 0 }
     };
 
@@ -955,6 +963,11 @@ int main(int argc, char* const argv[]) {
             // experimental feature
             gRotate = true;
             break;
+        case 'c':
+            // With "frames" or "raw-frames", have the virtual display render
+            // into CPU-readable buffers instead of reading back through GLES.
+            gCpuFrames = true;
+            break;
         case 'o':
             if (strcmp(optarg, "mp4") == 0) {
                 gOutputFormat = FORMAT_MP4;
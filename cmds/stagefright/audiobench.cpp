@@ -0,0 +1,451 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures decode throughput of the software audio decoders on a corpus of
+// test streams.  The OMX.google.* components run inside this process, so the
+// numbers do not include any binder traffic.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audiobench"
+#include <utils/Log.h>
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <binder/ProcessState.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/OMXClient.h>
+#include <media/stagefright/OMXCodec.h>
+#include <utils/Vector.h>
+
+using namespace android;
+
+// Every operator new in the process, including the ones in libstagefright and
+// the components, lands here, so that each run can report what it allocated.
+// Plain malloc() calls from C codec libraries are not counted.
+static atomic_uint_fast64_t gNumAllocs;
+static atomic_uint_fast64_t gAllocBytes;
+
+void *operator new(size_t size) {
+    atomic_fetch_add_explicit(&gNumAllocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&gAllocBytes, size, memory_order_relaxed);
+    void *p = malloc(size != 0 ? size : 1);
+    LOG_ALWAYS_FATAL_IF(p == NULL, "out of memory allocating %zu bytes", size);
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+enum OutputFormat {
+    OUTPUT_TEXT,
+    OUTPUT_CSV,
+    OUTPUT_JSON,
+};
+
+struct Result {
+    AString mFile;
+    size_t mTrack;
+    AString mMime;
+    AString mComponent;
+    int32_t mChannels;
+    int32_t mSampleRate;
+    int64_t mFrames;        // decoded sample frames
+    int64_t mWallUs;        // decode loop only, best of all runs
+    int64_t mCpuUs;         // whole process, same run as mWallUs
+    int64_t mCycles;        // whole process, -1 if there is no cycle counter
+    uint64_t mAllocs;
+    uint64_t mAllocBytes;
+};
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n <runs>] [-c <component>] [-f text|csv|json] "
+                    "<file or directory> ...\n", me);
+    fprintf(stderr, "       -n number of times to decode each track, default 3\n");
+    fprintf(stderr, "       -c only use this component, e.g. OMX.google.mp3.decoder\n");
+    fprintf(stderr, "       -f output format, default text\n");
+    fprintf(stderr, "       directories are scanned for streams, not recursively\n");
+    exit(1);
+}
+
+static int64_t cpuTimeUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+// Counts CPU cycles of this thread and of every thread it creates afterwards,
+// which includes the component's looper.  Counts of a child thread are only
+// added when it exits, so read the counter after the decoder is gone.
+static int openCycleCounter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0 /* pid */, -1 /* cpu */,
+            -1 /* group_fd */, 0 /* flags */);
+}
+
+static int64_t readCycleCounter(int fd) {
+    uint64_t cycles;
+    if (fd < 0 || read(fd, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+        return -1;
+    }
+    return cycles;
+}
+
+// Decodes one track once, returns false if no decoder could be created.
+static bool decodeTrack(
+        const sp<IOMX> &omx, const char *path, size_t track,
+        const char *component, Result *result) {
+    sp<DataSource> dataSource = DataSource::CreateFromURI(NULL /* httpService */, path);
+    if (dataSource == NULL) {
+        return false;
+    }
+    sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
+    if (extractor == NULL) {
+        return false;
+    }
+    sp<MediaSource> source = extractor->getTrack(track);
+    if (source == NULL) {
+        return false;
+    }
+    sp<MetaData> meta = extractor->getTrackMetaData(track);
+
+    const uint64_t allocs = atomic_load(&gNumAllocs);
+    const uint64_t allocBytes = atomic_load(&gAllocBytes);
+    const int cycleFd = openCycleCounter();
+    const int64_t startCpuUs = cpuTimeUs();
+
+    sp<MediaSource> decoder = OMXCodec::Create(
+            omx, meta, false /* createEncoder */, source, component,
+            OMXCodec::kSoftwareCodecsOnly);
+    if (decoder == NULL || decoder->start() != OK) {
+        if (cycleFd >= 0) {
+            close(cycleFd);
+        }
+        return false;
+    }
+
+    sp<MetaData> format = decoder->getFormat();
+    const char *name;
+    if (format->findCString(kKeyDecoderComponent, &name)) {
+        result->mComponent = name;
+    }
+    if (!format->findInt32(kKeyChannelCount, &result->mChannels)
+            || result->mChannels <= 0) {
+        result->mChannels = 1;
+    }
+    if (!format->findInt32(kKeySampleRate, &result->mSampleRate)) {
+        result->mSampleRate = 0;
+    }
+
+    int64_t bytes = 0;
+    const int64_t startUs = ALooper::GetNowUs();
+    for (;;) {
+        MediaBuffer *buffer;
+        status_t err = decoder->read(&buffer);
+        if (err == INFO_FORMAT_CHANGED) {
+            // the sample rate and channel count are only final here for some streams
+            format = decoder->getFormat();
+            format->findInt32(kKeyChannelCount, &result->mChannels);
+            format->findInt32(kKeySampleRate, &result->mSampleRate);
+            continue;
+        }
+        if (err != OK) {
+            break;
+        }
+        bytes += buffer->range_length();
+        buffer->release();
+    }
+    result->mWallUs = ALooper::GetNowUs() - startUs;
+
+    decoder->stop();
+    decoder.clear();
+    source.clear();
+
+    result->mCpuUs = cpuTimeUs() - startCpuUs;
+    result->mCycles = readCycleCounter(cycleFd);
+    if (cycleFd >= 0) {
+        close(cycleFd);
+    }
+    result->mAllocs = atomic_load(&gNumAllocs) - allocs;
+    result->mAllocBytes = atomic_load(&gAllocBytes) - allocBytes;
+    result->mFrames = bytes / (result->mChannels * sizeof(int16_t));
+
+    return true;
+}
+
+static void benchmarkFile(
+        const sp<IOMX> &omx, const char *path, const char *component, int numRuns,
+        Vector<Result> *results) {
+    sp<DataSource> dataSource = DataSource::CreateFromURI(NULL /* httpService */, path);
+    sp<MediaExtractor> extractor =
+            dataSource != NULL ? MediaExtractor::Create(dataSource) : NULL;
+    if (extractor == NULL) {
+        fprintf(stderr, "unable to open '%s'\n", path);
+        return;
+    }
+
+    for (size_t track = 0; track < extractor->countTracks(); ++track) {
+        sp<MetaData> meta = extractor->getTrackMetaData(track);
+        const char *mime;
+        if (meta == NULL || !meta->findCString(kKeyMIMEType, &mime)
+                || strncasecmp(mime, "audio/", 6)
+                || !strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_RAW)) {
+            continue;
+        }
+
+        Result best;
+        best.mWallUs = -1;
+        for (int i = 0; i < numRuns; ++i) {
+            Result result;
+            if (!decodeTrack(omx, path, track, component, &result)) {
+                fprintf(stderr, "no software decoder for '%s' track %zu (%s)\n",
+                        path, track, mime);
+                break;
+            }
+            if (best.mWallUs < 0 || result.mWallUs < best.mWallUs) {
+                best = result;
+            }
+        }
+        if (best.mWallUs < 0) {
+            continue;
+        }
+
+        best.mFile = path;
+        best.mTrack = track;
+        best.mMime = mime;
+        if (best.mWallUs <= 0) {
+            best.mWallUs = 1;
+        }
+        results->push_back(best);
+    }
+}
+
+static void addPath(const char *path, Vector<AString> *files) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "unable to stat '%s'\n", path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        files->push_back(AString(path));
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        fprintf(stderr, "unable to read '%s'\n", path);
+        return;
+    }
+    Vector<AString> entries;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        AString file(path);
+        file.append("/");
+        file.append(entry->d_name);
+        if (stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            entries.push_back(file);
+        }
+    }
+    closedir(dir);
+
+    // readdir() order is arbitrary, keep runs comparable
+    entries.sort([](const AString *a, const AString *b) { return a->compare(*b); });
+    files->appendVector(entries);
+}
+
+// real time factor: seconds of audio decoded per second of wall time
+static double realTimeFactor(const Result &r) {
+    return r.mSampleRate > 0 ? (double)r.mFrames * 1E6 / r.mSampleRate / r.mWallUs : 0.;
+}
+
+// cycles per decoded sample, counting each channel separately
+static double cyclesPerSample(const Result &r) {
+    const int64_t samples = r.mFrames * r.mChannels;
+    return r.mCycles >= 0 && samples > 0 ? (double)r.mCycles / samples : -1.;
+}
+
+static void printResults(const Vector<Result> &results, OutputFormat format) {
+    if (format == OUTPUT_CSV) {
+        printf("file,track,mime,component,channels,sample_rate,frames,wall_us,cpu_us,"
+               "realtime_factor,cycles,cycles_per_sample,allocs,alloc_bytes\n");
+    } else if (format == OUTPUT_TEXT) {
+        printf("%-28s %-26s %3s %6s %9s %9s %11s %8s %12s\n",
+               "file", "component", "ch", "rate", "audio(s)", "wall(ms)",
+               "x realtime", "cyc/smp", "allocs");
+    }
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        switch (format) {
+            case OUTPUT_CSV:
+                printf("%s,%zu,%s,%s,%d,%d,%" PRId64 ",%" PRId64 ",%" PRId64
+                       ",%.2f,%" PRId64 ",%.1f,%" PRIu64 ",%" PRIu64 "\n",
+                       r.mFile.c_str(), r.mTrack, r.mMime.c_str(), r.mComponent.c_str(),
+                       r.mChannels, r.mSampleRate, r.mFrames, r.mWallUs, r.mCpuUs,
+                       realTimeFactor(r), r.mCycles, cyclesPerSample(r),
+                       r.mAllocs, r.mAllocBytes);
+                break;
+
+            case OUTPUT_JSON:
+                // one object per line, so that results can be appended to a log
+                printf("{\"file\":\"%s\",\"track\":%zu,\"mime\":\"%s\",\"component\":\"%s\","
+                       "\"channels\":%d,\"sample_rate\":%d,\"frames\":%" PRId64 ","
+                       "\"wall_us\":%" PRId64 ",\"cpu_us\":%" PRId64 ","
+                       "\"realtime_factor\":%.2f,\"cycles\":%" PRId64 ","
+                       "\"cycles_per_sample\":%.1f,\"allocs\":%" PRIu64 ","
+                       "\"alloc_bytes\":%" PRIu64 "}\n",
+                       r.mFile.c_str(), r.mTrack, r.mMime.c_str(), r.mComponent.c_str(),
+                       r.mChannels, r.mSampleRate, r.mFrames, r.mWallUs, r.mCpuUs,
+                       realTimeFactor(r), r.mCycles, cyclesPerSample(r),
+                       r.mAllocs, r.mAllocBytes);
+                break;
+
+            default:
+            {
+                const char *file = strrchr(r.mFile.c_str(), '/');
+                file = file != NULL ? file + 1 : r.mFile.c_str();
+                char cycles[16];
+                if (r.mCycles >= 0) {
+                    snprintf(cycles, sizeof(cycles), "%.1f", cyclesPerSample(r));
+                } else {
+                    snprintf(cycles, sizeof(cycles), "-");
+                }
+                printf("%-28.28s %-26.26s %3d %6d %9.2f %9.2f %11.1f %8s %12" PRIu64 "\n",
+                       file, r.mComponent.c_str(), r.mChannels, r.mSampleRate,
+                       r.mSampleRate > 0 ? (double)r.mFrames / r.mSampleRate : 0.,
+                       r.mWallUs / 1E3, realTimeFactor(r), cycles, r.mAllocs);
+                break;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    int numRuns = 3;
+    const char *component = NULL;
+    OutputFormat format = OUTPUT_TEXT;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:c:f:")) >= 0) {
+        switch (res) {
+            case 'n':
+            {
+                numRuns = atoi(optarg);
+                if (numRuns < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case 'c':
+            {
+                component = optarg;
+                break;
+            }
+
+            case 'f':
+            {
+                if (!strcmp(optarg, "text")) {
+                    format = OUTPUT_TEXT;
+                } else if (!strcmp(optarg, "csv")) {
+                    format = OUTPUT_CSV;
+                } else if (!strcmp(optarg, "json")) {
+                    format = OUTPUT_JSON;
+                } else {
+                    usage(me);
+                }
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1) {
+        usage(me);
+    }
+
+    Vector<AString> files;
+    for (int i = 0; i < argc; ++i) {
+        addPath(argv[i], &files);
+    }
+
+    sp<ProcessState> proc(ProcessState::self());
+    proc->startThreadPool();
+
+    DataSource::RegisterDefaultSniffers();
+
+    OMXClient client;
+    if (client.connect() != OK) {
+        fprintf(stderr, "unable to connect to OMX\n");
+        return 1;
+    }
+
+    Vector<Result> results;
+    for (size_t i = 0; i < files.size(); ++i) {
+        benchmarkFile(client.interface(), files[i].c_str(), component, numRuns, &results);
+    }
+
+    client.disconnect();
+
+    printResults(results, format);
+
+    return results.empty() ? 1 : 0;
+}
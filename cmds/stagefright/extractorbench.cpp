@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how fast an extractor hands out samples, which is dominated by
+// MediaSource::read() and the per sample MetaData it fills in.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "extractorbench"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/Utils.h>
+
+using namespace android;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n <runs>] <media file>\n", me);
+    fprintf(stderr, "       -n number of times to read the file, default 5\n");
+    exit(1);
+}
+
+// Reads every sample of every track, and looks at the metadata a player
+// would look at. Returns the time taken.
+static int64_t readAll(const char *path, size_t *numSamples, size_t *numBytes) {
+    *numSamples = 0;
+    *numBytes = 0;
+
+    sp<DataSource> source = new FileSource(path);
+    if (source->initCheck() != OK) {
+        return -1;
+    }
+    sp<MediaExtractor> extractor = MediaExtractor::Create(source);
+    if (extractor == NULL) {
+        return -1;
+    }
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<MediaSource> track = extractor->getTrack(i);
+        if (track == NULL || track->start() != OK) {
+            continue;
+        }
+
+        sp<AMessage> format;
+        convertMetaDataToMessage(track->getFormat(), &format);
+
+        MediaBuffer *buffer;
+        while (track->read(&buffer) == OK) {
+            int64_t timeUs;
+            int32_t isSync;
+            CHECK(buffer->meta_data()->findInt64(kKeyTime, &timeUs));
+            if (!buffer->meta_data()->findInt32(kKeyIsSyncFrame, &isSync)) {
+                isSync = 0;
+            }
+            ++*numSamples;
+            *numBytes += buffer->range_length();
+            buffer->release();
+        }
+
+        track->stop();
+    }
+
+    return ALooper::GetNowUs() - startUs;
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    int numRuns = 5;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:")) >= 0) {
+        switch (res) {
+            case 'n':
+            {
+                numRuns = atoi(optarg);
+                if (numRuns < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1) {
+        usage(me);
+    }
+
+    DataSource::RegisterDefaultSniffers();
+
+    int64_t bestUs = -1;
+    size_t numSamples = 0;
+    size_t numBytes = 0;
+    for (int i = 0; i < numRuns; ++i) {
+        int64_t us = readAll(argv[0], &numSamples, &numBytes);
+        if (us < 0) {
+            fprintf(stderr, "unable to extract '%s'\n", argv[0]);
+            return 1;
+        }
+        if (bestUs < 0 || us < bestUs) {
+            bestUs = us;
+        }
+    }
+
+    if (bestUs <= 0) {
+        bestUs = 1;
+    }
+
+    printf("%zu samples, %zu bytes in %.2f ms: %.0f samples/s, %.2f us/sample\n",
+           numSamples, numBytes, bestUs / 1E3,
+           numSamples * 1E6 / bestUs,
+           numSamples > 0 ? (double)bestUs / numSamples : 0.);
+
+    return 0;
+}
@@ -42,7 +42,7 @@
 #include "ScriptC_saturation.h"
 
 // test parameters
-static const bool kTestFlush = true;        // Note: true will drop 1 out of
+static bool gTestFlush = true;              // Note: true will drop 1 out of
 static const int kFlushAfterFrames = 25;    // kFlushAfterFrames output frames
 static const int64_t kTimeout = 500ll;
 
@@ -54,6 +54,7 @@ static const float kSaturation = 0.0f;  // SaturationFilter param
 static void usage(const char *me) {
     fprintf(stderr, "usage: [flags] %s\n"
                     "\t[-b] use IntrinsicBlurFilter\n"
+                    "\t[-B] benchmark, do not test flushing\n"
                     "\t[-c] use argb to rgba conversion RSFilter\n"
                     "\t[-n] use night vision RSFilter\n"
                     "\t[-r] use saturation RSFilter\n"
@@ -156,6 +157,8 @@ enum FilterType {
 };
 
 size_t inputFramesSinceFlush = 0;
+int64_t numFramesConverted = 0;
+int64_t convertTimeUs = 0;
 void tryCopyDecodedBuffer(
         List<DecodedFrame> *decodedFrameIndices,
         CodecState *filterState,
@@ -178,7 +181,7 @@ void tryCopyDecodedBuffer(
     // only consume a buffer if we are not going to flush, since we expect
     // the dequeue -> flush -> queue operation to cause an error and
     // not produce an output frame
-    if (!kTestFlush || inputFramesSinceFlush < kFlushAfterFrames) {
+    if (!gTestFlush || inputFramesSinceFlush < kFlushAfterFrames) {
         decodedFrameIndices->erase(decodedFrameIndices->begin());
     }
     size_t outIndex = frame.index;
@@ -208,19 +211,22 @@ void tryCopyDecodedBuffer(
 
     CHECK(srcWidth <= destStride && srcHeight <= destSliceHeight);
 
+    int64_t convertStartUs = ALooper::GetNowUs();
     convertYUV420spToARGB(
             srcBuffer->data(),
             srcBuffer->data() + srcStride * srcSliceHeight,
             srcWidth,
             srcHeight,
             destBuffer->data());
+    convertTimeUs += ALooper::GetNowUs() - convertStartUs;
+    ++numFramesConverted;
 
     // copy timestamp
     int64_t timeUs;
     CHECK(srcBuffer->meta()->findInt64("timeUs", &timeUs));
     destBuffer->meta()->setInt64("timeUs", timeUs);
 
-    if (kTestFlush && inputFramesSinceFlush >= kFlushAfterFrames) {
+    if (gTestFlush && inputFramesSinceFlush >= kFlushAfterFrames) {
         inputFramesSinceFlush = 0;
 
         // check that queueing a buffer that was dequeued before flush
@@ -268,7 +274,7 @@ void tryDrainOutputBuffer(
 
     ++outputFramesSinceFlush;
 
-    if (kTestFlush && outputFramesSinceFlush >= kFlushAfterFrames) {
+    if (gTestFlush && outputFramesSinceFlush >= kFlushAfterFrames) {
         filterState->mCodec->flush();
     }
 
@@ -288,7 +294,7 @@ void tryDrainOutputBuffer(
         err = filterState->mCodec->renderOutputBufferAndRelease(index);
     }
 
-    if (kTestFlush && outputFramesSinceFlush >= kFlushAfterFrames) {
+    if (gTestFlush && outputFramesSinceFlush >= kFlushAfterFrames) {
         outputFramesSinceFlush = 0;
 
         // releasing the buffer dequeued before flush should cause an error
@@ -484,7 +490,7 @@ static int decode(
 
     CHECK_EQ((status_t)OK, filterState->mCodec->setParameters(params));
 
-    if (kTestFlush) {
+    if (gTestFlush) {
         status_t flushErr = filterState->mCodec->flush();
         if (flushErr == OK) {
             ALOGE("FAIL: Flush before start returned OK");
@@ -500,7 +506,7 @@ static int decode(
     CHECK_EQ((status_t)OK, filterState->mCodec->getOutputBuffers(
             &filterState->mOutBuffers));
 
-    if (kTestFlush) {
+    if (gTestFlush) {
         status_t flushErr = filterState->mCodec->flush();
         if (flushErr != OK) {
             ALOGE("FAIL: Flush after start returned %d, expect OK (0)",
@@ -653,6 +659,11 @@ static int decode(
                 state->mNumBuffersDecoded * 1E6 / elapsedTimeUs);
     }
 
+    if (numFramesConverted > 0) {
+        printf("%" PRId64 " frames converted to ARGB, %.2f ms per frame.\n",
+                numFramesConverted, convertTimeUs / 1E3 / numFramesConverted);
+    }
+
     return 0;
 }
 
@@ -669,13 +680,18 @@ int main(int argc, char **argv) {
     FilterType filterType = FILTERTYPE_ZERO;
 
     int res;
-    while ((res = getopt(argc, argv, "bcnrszTRSh")) >= 0) {
+    while ((res = getopt(argc, argv, "bBcnrszTRSh")) >= 0) {
         switch (res) {
             case 'b':
             {
                 filterType = FILTERTYPE_INTRINSIC_BLUR;
                 break;
             }
+            case 'B':
+            {
+                gTestFlush = false;
+                break;
+            }
             case 'c':
             {
                 filterType = FILTERTYPE_RS_ARGB_TO_RGBA;
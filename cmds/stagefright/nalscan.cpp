@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures start code scanning throughput on an H.264/HEVC byte stream,
+// for example a 4K elementary stream dumped from a transport stream.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "nalscan"
+#include <utils/Log.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ALooper.h>
+
+#include "include/avc_utils.h"
+
+using namespace android;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n <runs>] <annex b byte stream file>\n", me);
+    fprintf(stderr, "       -n number of times to split the file, default 5\n");
+    exit(1);
+}
+
+static int64_t split(const uint8_t *data, size_t size, size_t *numNALUnits) {
+    *numNALUnits = 0;
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    const uint8_t *nalStart;
+    size_t nalSize;
+    while (getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
+        ++*numNALUnits;
+    }
+
+    return ALooper::GetNowUs() - startUs;
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    int numRuns = 5;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:")) >= 0) {
+        switch (res) {
+            case 'n':
+            {
+                numRuns = atoi(optarg);
+                if (numRuns < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1) {
+        usage(me);
+    }
+
+    int fd = open(argv[0], O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open '%s'\n", argv[0]);
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 4) {
+        fprintf(stderr, "'%s' is too small\n", argv[0]);
+        close(fd);
+        return 1;
+    }
+
+    size_t size = st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "unable to map '%s'\n", argv[0]);
+        return 1;
+    }
+
+    int64_t bestUs = -1;
+    size_t numNALUnits = 0;
+    for (int i = 0; i < numRuns; ++i) {
+        int64_t us = split((const uint8_t *)data, size, &numNALUnits);
+        if (bestUs < 0 || us < bestUs) {
+            bestUs = us;
+        }
+    }
+
+    munmap(data, size);
+
+    if (bestUs <= 0) {
+        bestUs = 1;
+    }
+
+    printf("%zu NAL units, %zu bytes in %.2f ms: %.1f MB/s\n",
+           numNALUnits, size, bestUs / 1E3, size / (double)bestUs);
+
+    return 0;
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures MediaTranscoder throughput on a local file.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "transcode"
+#include <utils/Log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <binder/ProcessState.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <media/stagefright/MediaTranscoder.h>
+#include <media/stagefright/SegmentedTranscoder.h>
+
+using namespace android;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-v <mime>] [-b <bitrate>] [-a <mime>] [-B <bitrate>]\n"
+                    "       [-s <segments>] [-n <runs>] <input file> <output file>\n", me);
+    fprintf(stderr, "       -v video output mime, default %s, 'copy' to pass through\n",
+            MEDIA_MIMETYPE_VIDEO_AVC);
+    fprintf(stderr, "       -b video bitrate in bits/s, default chosen by the transcoder\n");
+    fprintf(stderr, "       -a audio output mime, default 'copy'\n");
+    fprintf(stderr, "       -B audio bitrate in bits/s, default chosen by the transcoder\n");
+    fprintf(stderr, "       -s transcode that many segments in parallel, 0 for as many\n"
+                    "          as the video encoder allows\n");
+    fprintf(stderr, "       -n number of times to transcode the file, default 1\n");
+    exit(1);
+}
+
+struct DoneListener : public AHandler {
+    DoneListener() : mDone(false), mErr(OK) {}
+
+    status_t waitForDone() {
+        Mutex::Autolock autoLock(mLock);
+        while (!mDone) {
+            mCondition.wait(mLock);
+        }
+        return mErr;
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        int32_t what;
+        CHECK(msg->findInt32("what", &what));
+        if (what == MediaTranscoder::kWhatProgress) {
+            int32_t progress;
+            CHECK(msg->findInt32("progress", &progress));
+            fprintf(stderr, "\r%3d%%", progress);
+        } else if (what == MediaTranscoder::kWhatDone) {
+            Mutex::Autolock autoLock(mLock);
+            CHECK(msg->findInt32("err", &mErr));
+            mDone = true;
+            mCondition.signal();
+        }
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    bool mDone;
+    status_t mErr;
+};
+
+static sp<AMessage> makeOutputFormat(const char *mime, int32_t bitrate) {
+    if (mime == NULL || !strcmp(mime, "copy")) {
+        return NULL;
+    }
+    sp<AMessage> format = new AMessage;
+    format->setString("mime", mime);
+    if (bitrate > 0) {
+        format->setInt32("bitrate", bitrate);
+    }
+    return format;
+}
+
+static status_t transcode(
+        const sp<ALooper> &looper, const char *inPath, const char *outPath,
+        const char *videoMime, int32_t videoBitrate,
+        const char *audioMime, int32_t audioBitrate,
+        int numSegments, MediaTranscoder::Stats *stats) {
+    int inFd = open(inPath, O_RDONLY);
+    if (inFd < 0) {
+        fprintf(stderr, "unable to open '%s'\n", inPath);
+        return -errno;
+    }
+    struct stat st;
+    if (fstat(inFd, &st) != 0) {
+        close(inFd);
+        return -errno;
+    }
+    int outFd = open(outPath, O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (outFd < 0) {
+        fprintf(stderr, "unable to create '%s'\n", outPath);
+        close(inFd);
+        return -errno;
+    }
+
+    if (numSegments >= 0) {
+        sp<SegmentedTranscoder> transcoder = new SegmentedTranscoder;
+        transcoder->setMaxSegments(numSegments);
+        status_t err = transcoder->setDataSource(inFd, 0, st.st_size);
+        if (err == OK) {
+            err = transcoder->setOutput(outFd);
+        }
+
+        sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+        if (err == OK) {
+            err = extractor->setDataSource(inFd, 0, st.st_size);
+        }
+        bool haveAudio = false;
+        bool haveVideo = false;
+        for (size_t i = 0; err == OK && i < extractor->countTracks(); ++i) {
+            sp<AMessage> format;
+            CHECK_EQ(extractor->getTrackFormat(i, &format), (status_t)OK);
+
+            AString mime;
+            CHECK(format->findString("mime", &mime));
+
+            if (!haveVideo && !strncasecmp(mime.c_str(), "video/", 6)) {
+                haveVideo = true;
+                err = transcoder->selectTrack(i, makeOutputFormat(videoMime, videoBitrate));
+            } else if (!haveAudio && !strncasecmp(mime.c_str(), "audio/", 6)) {
+                haveAudio = true;
+                err = transcoder->selectTrack(i, makeOutputFormat(audioMime, audioBitrate));
+            }
+        }
+
+        if (err == OK) {
+            err = transcoder->transcode(stats);
+        }
+        close(outFd);
+        close(inFd);
+        return err;
+    }
+
+    sp<DoneListener> listener = new DoneListener;
+    looper->registerHandler(listener);
+
+    sp<MediaTranscoder> transcoder =
+            new MediaTranscoder(new AMessage(0, listener));
+    looper->registerHandler(transcoder);
+
+    status_t err = transcoder->setDataSource(inFd, 0, st.st_size);
+    if (err == OK) {
+        err = transcoder->setOutput(outFd, MediaMuxer::OUTPUT_FORMAT_MPEG_4);
+    }
+
+    bool haveAudio = false;
+    bool haveVideo = false;
+    for (size_t i = 0; err == OK && i < transcoder->countTracks(); ++i) {
+        sp<AMessage> format;
+        CHECK_EQ(transcoder->getTrackFormat(i, &format), (status_t)OK);
+
+        AString mime;
+        CHECK(format->findString("mime", &mime));
+
+        if (!haveVideo && !strncasecmp(mime.c_str(), "video/", 6)) {
+            haveVideo = true;
+            err = transcoder->selectTrack(i, makeOutputFormat(videoMime, videoBitrate));
+        } else if (!haveAudio && !strncasecmp(mime.c_str(), "audio/", 6)) {
+            haveAudio = true;
+            err = transcoder->selectTrack(i, makeOutputFormat(audioMime, audioBitrate));
+        }
+    }
+
+    if (err == OK) {
+        err = transcoder->start();
+    }
+    if (err == OK) {
+        err = listener->waitForDone();
+        fprintf(stderr, "\n");
+    }
+    transcoder->stop();
+    transcoder->getStats(stats);
+
+    looper->unregisterHandler(transcoder->id());
+    looper->unregisterHandler(listener->id());
+    close(outFd);
+    close(inFd);
+    return err;
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    const char *videoMime = MEDIA_MIMETYPE_VIDEO_AVC;
+    const char *audioMime = NULL;
+    int32_t videoBitrate = 0;
+    int32_t audioBitrate = 0;
+    int numRuns = 1;
+    int numSegments = -1;
+
+    int res;
+    while ((res = getopt(argc, argv, "hv:b:a:B:s:n:")) >= 0) {
+        switch (res) {
+            case 'v':
+                videoMime = optarg;
+                break;
+
+            case 'b':
+                videoBitrate = atoi(optarg);
+                break;
+
+            case 'a':
+                audioMime = optarg;
+                break;
+
+            case 'B':
+                audioBitrate = atoi(optarg);
+                break;
+
+            case 's':
+            {
+                numSegments = atoi(optarg);
+                if (numSegments < 0) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case 'n':
+            {
+                numRuns = atoi(optarg);
+                if (numRuns < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 2) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("transcode");
+    looper->start();
+
+    MediaTranscoder::Stats best;
+    best.mElapsedUs = -1;
+    for (int i = 0; i < numRuns; ++i) {
+        MediaTranscoder::Stats stats;
+        status_t err = transcode(looper, argv[0], argv[1],
+                videoMime, videoBitrate, audioMime, audioBitrate, numSegments, &stats);
+        if (err != OK) {
+            fprintf(stderr, "transcoding failed (%d)\n", err);
+            return 1;
+        }
+        if (best.mElapsedUs < 0 || stats.mElapsedUs < best.mElapsedUs) {
+            best = stats;
+        }
+    }
+
+    looper->stop();
+
+    if (best.mElapsedUs <= 0) {
+        best.mElapsedUs = 1;
+    }
+
+    printf("%" PRId64 " samples read, %" PRId64 " frames decoded, %" PRId64 " encoded, "
+           "%" PRId64 " samples (%" PRId64 " bytes) written in %.2f ms\n",
+           best.mNumSamplesRead, best.mNumFramesDecoded, best.mNumFramesEncoded,
+           best.mNumSamplesWritten, best.mNumBytesWritten, best.mElapsedUs / 1E3);
+    printf("%.1f encoded frames/s, %.2fx realtime\n",
+           best.mNumFramesEncoded * 1E6 / best.mElapsedUs,
+           (double)best.mDurationUs / best.mElapsedUs);
+
+    return 0;
+}
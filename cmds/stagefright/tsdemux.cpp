@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures ATSParser demux throughput on a recorded transport stream.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "tsdemux"
+#include <utils/Log.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+
+#include "mpeg2ts/AnotherPacketSource.h"
+#include "mpeg2ts/ATSParser.h"
+
+using namespace android;
+
+static const size_t kTSPacketSize = 188;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n <runs>] <transport stream file>\n", me);
+    fprintf(stderr, "       -n number of times to demux the file, default 5\n");
+    exit(1);
+}
+
+// Dequeues everything the parser produced, so that memory use stays flat
+// on long captures.
+static size_t drain(const sp<ATSParser> &parser) {
+    size_t numAccessUnits = 0;
+    for (int type = 0; type < ATSParser::NUM_SOURCE_TYPES; ++type) {
+        sp<AnotherPacketSource> source = static_cast<AnotherPacketSource *>(
+                parser->getSource((ATSParser::SourceType)type).get());
+        if (source == NULL) {
+            continue;
+        }
+        status_t finalResult;
+        while (source->hasBufferAvailable(&finalResult)) {
+            sp<ABuffer> accessUnit;
+            if (source->dequeueAccessUnit(&accessUnit) != OK) {
+                break;
+            }
+            ++numAccessUnits;
+        }
+    }
+    return numAccessUnits;
+}
+
+static int64_t demux(const uint8_t *data, size_t size,
+        size_t *numPackets, size_t *numAccessUnits) {
+    sp<ATSParser> parser = new ATSParser;
+
+    *numPackets = 0;
+    *numAccessUnits = 0;
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    size_t offset = 0;
+    while (offset + kTSPacketSize <= size) {
+        if (data[offset] != 0x47) {
+            ssize_t skip = ATSParser::FindSync(data + offset, size - offset);
+            if (skip < 0) {
+                break;
+            }
+            offset += skip;
+            continue;
+        }
+
+        parser->feedTSPacket(data + offset, kTSPacketSize);
+        offset += kTSPacketSize;
+
+        if ((++*numPackets % 1024) == 0) {
+            *numAccessUnits += drain(parser);
+        }
+    }
+    *numAccessUnits += drain(parser);
+
+    return ALooper::GetNowUs() - startUs;
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    int numRuns = 5;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:")) >= 0) {
+        switch (res) {
+            case 'n':
+            {
+                numRuns = atoi(optarg);
+                if (numRuns < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1) {
+        usage(me);
+    }
+
+    int fd = open(argv[0], O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open '%s'\n", argv[0]);
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)kTSPacketSize) {
+        fprintf(stderr, "'%s' is too small\n", argv[0]);
+        close(fd);
+        return 1;
+    }
+
+    size_t size = st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "unable to map '%s'\n", argv[0]);
+        return 1;
+    }
+
+    int64_t bestUs = -1;
+    size_t numPackets = 0;
+    size_t numAccessUnits = 0;
+    for (int i = 0; i < numRuns; ++i) {
+        int64_t us = demux((const uint8_t *)data, size, &numPackets, &numAccessUnits);
+        if (bestUs < 0 || us < bestUs) {
+            bestUs = us;
+        }
+    }
+
+    munmap(data, size);
+
+    if (bestUs <= 0) {
+        bestUs = 1;
+    }
+
+    printf("%zu packets, %zu access units in %.2f ms: "
+           "%.0f packets/s, %.1f Mbit/s\n",
+           numPackets, numAccessUnits, bestUs / 1E3,
+           numPackets * 1E6 / bestUs,
+           numPackets * kTSPacketSize * 8.0 / bestUs);
+
+    return 0;
+}
@@ -18,44 +18,74 @@
 #define LOG_TAG "ClearKeyCryptoPlugin"
 #include <utils/Log.h>
 
-#include <openssl/aes.h>
+#include <limits.h>
+#include <media/stagefright/MediaErrors.h>
+#include <openssl/evp.h>
 
 #include "AesCtrDecryptor.h"
 
 namespace clearkeydrm {
 
-static const size_t kBlockBitCount = kBlockSize * 8;
+AesCtrDecryptor::AesCtrDecryptor() : mHasKey(false) {
+    EVP_CIPHER_CTX_init(&mContext);
+}
 
-android::status_t AesCtrDecryptor::decrypt(const android::Vector<uint8_t>& key,
-        const Iv iv, const uint8_t* source,
+AesCtrDecryptor::~AesCtrDecryptor() {
+    EVP_CIPHER_CTX_cleanup(&mContext);
+}
+
+android::status_t AesCtrDecryptor::setKey(const android::Vector<uint8_t>& key) {
+    mHasKey = false;
+    if (key.size() != kBlockSize) {
+        ALOGE("Invalid key size %zu", key.size());
+        return android::ERROR_DRM_DECRYPT;
+    }
+
+    // The IV is set per sample.
+    if (EVP_DecryptInit_ex(&mContext, EVP_aes_128_ctr(), NULL, key.array(),
+            NULL) != 1) {
+        return android::ERROR_DRM_DECRYPT;
+    }
+    mHasKey = true;
+    return android::OK;
+}
+
+android::status_t AesCtrDecryptor::decrypt(const Iv iv, const uint8_t* source,
         uint8_t* destination,
         const SubSample* subSamples,
         size_t numSubSamples,
         size_t* bytesDecryptedOut) {
-    uint32_t blockOffset = 0;
-    uint8_t previousEncryptedCounter[kBlockSize];
-    memset(previousEncryptedCounter, 0, kBlockSize);
+    if (!mHasKey) {
+        return android::ERROR_DRM_DECRYPT;
+    }
 
-    size_t offset = 0;
-    AES_KEY opensslKey;
-    AES_set_encrypt_key(key.array(), kBlockBitCount, &opensslKey);
-    Iv opensslIv;
-    memcpy(opensslIv, iv, sizeof(opensslIv));
+    // Restarts the counter at iv, without expanding the key again.
+    if (EVP_DecryptInit_ex(&mContext, NULL, NULL, NULL, iv) != 1) {
+        return android::ERROR_DRM_DECRYPT;
+    }
 
+    size_t offset = 0;
     for (size_t i = 0; i < numSubSamples; ++i) {
         const SubSample& subSample = subSamples[i];
 
         if (subSample.mNumBytesOfClearData > 0) {
-            memcpy(destination + offset, source + offset,
-                    subSample.mNumBytesOfClearData);
+            if (destination != source) {
+                memcpy(destination + offset, source + offset,
+                        subSample.mNumBytesOfClearData);
+            }
             offset += subSample.mNumBytesOfClearData;
         }
 
         if (subSample.mNumBytesOfEncryptedData > 0) {
-            AES_ctr128_encrypt(source + offset, destination + offset,
-                    subSample.mNumBytesOfEncryptedData, &opensslKey,
-                    opensslIv, previousEncryptedCounter,
-                    &blockOffset);
+            if (subSample.mNumBytesOfEncryptedData > INT_MAX) {
+                return android::ERROR_DRM_DECRYPT;
+            }
+            int outLength;
+            if (EVP_DecryptUpdate(&mContext, destination + offset, &outLength,
+                    source + offset, subSample.mNumBytesOfEncryptedData) != 1
+                    || (size_t)outLength != subSample.mNumBytesOfEncryptedData) {
+                return android::ERROR_DRM_DECRYPT;
+            }
             offset += subSample.mNumBytesOfEncryptedData;
         }
     }
@@ -64,4 +94,31 @@ android::status_t AesCtrDecryptor::decrypt(const android::Vector<uint8_t>& key,
     return android::OK;
 }
 
+android::status_t AesCtrDecryptor::decrypt(Sample* samples, size_t numSamples) {
+    for (size_t i = 0; i < numSamples; ++i) {
+        Sample& sample = samples[i];
+        android::status_t res = decrypt(sample.mIv, sample.mSource,
+                sample.mDestination, sample.mSubSamples, sample.mNumSubSamples,
+                &sample.mBytesDecrypted);
+        if (res != android::OK) {
+            return res;
+        }
+    }
+    return android::OK;
+}
+
+android::status_t AesCtrDecryptor::decrypt(const android::Vector<uint8_t>& key,
+        const Iv iv, const uint8_t* source,
+        uint8_t* destination,
+        const SubSample* subSamples,
+        size_t numSubSamples,
+        size_t* bytesDecryptedOut) {
+    android::status_t res = setKey(key);
+    if (res != android::OK) {
+        return res;
+    }
+    return decrypt(iv, source, destination, subSamples, numSubSamples,
+            bytesDecryptedOut);
+}
+
 } // namespace clearkeydrm
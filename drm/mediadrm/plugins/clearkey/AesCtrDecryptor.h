@@ -18,6 +18,7 @@
 #define CLEARKEY_AES_CTR_DECRYPTOR_H_
 
 #include <media/stagefright/foundation/ABase.h>
+#include <openssl/evp.h>
 #include <Utils.h>
 #include <utils/Errors.h>
 #include <utils/Vector.h>
@@ -26,10 +27,37 @@
 
 namespace clearkeydrm {
 
+// Decrypts CENC 'cenc' scheme samples.  The key is expanded once by
+// setKey() and reused by every decrypt() after it; the EVP cipher picks
+// AES-NI or the ARMv8 crypto extensions when the CPU has them.
 class AesCtrDecryptor {
 public:
-    AesCtrDecryptor() {}
+    AesCtrDecryptor();
+    ~AesCtrDecryptor();
 
+    // One sample of a batch, mBytesDecrypted is set by decrypt().
+    struct Sample {
+        const uint8_t* mIv;
+        const uint8_t* mSource;
+        uint8_t* mDestination;
+        const SubSample* mSubSamples;
+        size_t mNumSubSamples;
+        size_t mBytesDecrypted;
+    };
+
+    android::status_t setKey(const android::Vector<uint8_t>& key);
+
+    // Decrypts one sample with the key of the last setKey().  The counter
+    // runs on across the encrypted parts of all subsamples.
+    android::status_t decrypt(const Iv iv,
+            const uint8_t* source, uint8_t* destination,
+            const SubSample* subSamples, size_t numSubSamples,
+            size_t* bytesDecryptedOut);
+
+    // Decrypts numSamples samples, stopping at the first failure.
+    android::status_t decrypt(Sample* samples, size_t numSamples);
+
+    // setKey() followed by decrypt(), for one-off use.
     android::status_t decrypt(const android::Vector<uint8_t>& key, const Iv iv,
             const uint8_t* source, uint8_t* destination,
             const SubSample* subSamples, size_t numSubSamples,
@@ -37,6 +65,9 @@ public:
 
 private:
     DISALLOW_EVIL_CONSTRUCTORS(AesCtrDecryptor);
+
+    EVP_CIPHER_CTX mContext;
+    bool mHasKey;
 };
 
 } // namespace clearkeydrm
@@ -23,7 +23,6 @@
 
 #include "Session.h"
 
-#include "AesCtrDecryptor.h"
 #include "InitDataParser.h"
 #include "JsonWebKey.h"
 
@@ -34,6 +33,10 @@ using android::String8;
 using android::Vector;
 using android::status_t;
 
+Session::~Session() {
+    clearDecryptors_l();
+}
+
 status_t Session::getKeyRequest(
         const Vector<uint8_t>& initData,
         const String8& initDataType,
@@ -47,18 +50,30 @@ status_t Session::provideKeyResponse(const Vector<uint8_t>& response) {
             reinterpret_cast<const char*>(response.array()), response.size());
     KeyMap keys;
 
-    Mutex::Autolock lock(mMapLock);
+    // Parse before taking the lock, so that a response carrying the next keys of a
+    // rotation does not hold up decryption with the current ones.
     JsonWebKey parser;
-    if (parser.extractKeysFromJsonWebKeySet(responseString, &keys)) {
-        for (size_t i = 0; i < keys.size(); ++i) {
-            const KeyMap::key_type& keyId = keys.keyAt(i);
-            const KeyMap::value_type& key = keys.valueAt(i);
-            mKeyMap.add(keyId, key);
-        }
-        return android::OK;
-    } else {
+    if (!parser.extractKeysFromJsonWebKeySet(responseString, &keys)) {
         return android::ERROR_DRM_UNKNOWN;
     }
+
+    Mutex::Autolock lock(mMapLock);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const KeyMap::key_type& keyId = keys.keyAt(i);
+        const KeyMap::value_type& key = keys.valueAt(i);
+        ssize_t index = mKeyMap.indexOfKey(keyId);
+        if (index >= 0) {
+            const KeyMap::value_type& oldKey = mKeyMap.valueAt(index);
+            if (oldKey.size() == key.size() &&
+                    !memcmp(oldKey.array(), key.array(), key.size())) {
+                continue;
+            }
+            // the key has been replaced
+            removeDecryptor_l(keyId);
+        }
+        mKeyMap.add(keyId, key);
+    }
+    return android::OK;
 }
 
 status_t Session::decrypt(
@@ -67,19 +82,79 @@ status_t Session::decrypt(
         size_t numSubSamples, size_t* bytesDecryptedOut) {
     Mutex::Autolock lock(mMapLock);
 
-    Vector<uint8_t> keyIdVector;
-    keyIdVector.appendArray(keyId, kBlockSize);
-    if (mKeyMap.indexOfKey(keyIdVector) < 0) {
+    AesCtrDecryptor* decryptor = getDecryptor_l(keyId);
+    if (decryptor == NULL) {
         return android::ERROR_DRM_NO_LICENSE;
     }
 
-    const Vector<uint8_t>& key = mKeyMap.valueFor(keyIdVector);
-    AesCtrDecryptor decryptor;
-    return decryptor.decrypt(
-            key, iv,
+    return decryptor->decrypt(
+            iv,
             reinterpret_cast<const uint8_t*>(source),
             reinterpret_cast<uint8_t*>(destination), subSamples,
             numSubSamples, bytesDecryptedOut);
 }
 
+status_t Session::decrypt(
+        const KeyId keyId, AesCtrDecryptor::Sample* samples,
+        size_t numSamples) {
+    Mutex::Autolock lock(mMapLock);
+
+    AesCtrDecryptor* decryptor = getDecryptor_l(keyId);
+    if (decryptor == NULL) {
+        return android::ERROR_DRM_NO_LICENSE;
+    }
+
+    return decryptor->decrypt(samples, numSamples);
+}
+
+AesCtrDecryptor* Session::getDecryptor_l(const KeyId keyId) {
+    if (mLastDecryptor != NULL && !memcmp(mLastKeyId, keyId, kBlockSize)) {
+        return mLastDecryptor;
+    }
+
+    Vector<uint8_t> keyIdVector;
+    keyIdVector.appendArray(keyId, kBlockSize);
+
+    AesCtrDecryptor* decryptor;
+    ssize_t index = mDecryptors.indexOfKey(keyIdVector);
+    if (index >= 0) {
+        decryptor = mDecryptors.valueAt(index);
+    } else {
+        index = mKeyMap.indexOfKey(keyIdVector);
+        if (index < 0) {
+            return NULL;
+        }
+        decryptor = new AesCtrDecryptor;
+        if (decryptor->setKey(mKeyMap.valueAt(index)) != android::OK) {
+            delete decryptor;
+            return NULL;
+        }
+        mDecryptors.add(keyIdVector, decryptor);
+    }
+
+    memcpy(mLastKeyId, keyId, kBlockSize);
+    mLastDecryptor = decryptor;
+    return decryptor;
+}
+
+void Session::removeDecryptor_l(const Vector<uint8_t>& keyId) {
+    ssize_t index = mDecryptors.indexOfKey(keyId);
+    if (index < 0) {
+        return;
+    }
+    if (mDecryptors.valueAt(index) == mLastDecryptor) {
+        mLastDecryptor = NULL;
+    }
+    delete mDecryptors.valueAt(index);
+    mDecryptors.removeItemsAt(index);
+}
+
+void Session::clearDecryptors_l() {
+    for (size_t i = 0; i < mDecryptors.size(); ++i) {
+        delete mDecryptors.valueAt(i);
+    }
+    mDecryptors.clear();
+    mLastDecryptor = NULL;
+}
+
 } // namespace clearkeydrm
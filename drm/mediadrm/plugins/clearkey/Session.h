@@ -24,6 +24,7 @@
 #include <utils/String8.h>
 #include <utils/Vector.h>
 
+#include "AesCtrDecryptor.h"
 #include "ClearKeyTypes.h"
 #include "Utils.h"
 
@@ -32,8 +33,8 @@ namespace clearkeydrm {
 class Session : public android::RefBase {
 public:
     explicit Session(const android::Vector<uint8_t>& sessionId)
-            : mSessionId(sessionId) {}
-    virtual ~Session() {}
+            : mSessionId(sessionId), mLastDecryptor(NULL) {}
+    virtual ~Session();
 
     const android::Vector<uint8_t>& sessionId() const { return mSessionId; }
 
@@ -50,13 +51,30 @@ public:
             void* destination, const SubSample* subSamples,
             size_t numSubSamples, size_t* bytesDecryptedOut);
 
+    // Decrypts samples that all use keyId, with one key lookup.
+    android::status_t decrypt(
+            const KeyId keyId, AesCtrDecryptor::Sample* samples,
+            size_t numSamples);
+
 private:
     DISALLOW_EVIL_CONSTRUCTORS(Session);
 
+    AesCtrDecryptor* getDecryptor_l(const KeyId keyId);
+    void removeDecryptor_l(const android::Vector<uint8_t>& keyId);
+    void clearDecryptors_l();
+
     const android::Vector<uint8_t> mSessionId;
 
     android::Mutex mMapLock;
     KeyMap mKeyMap;
+
+    // Expanded keys, created on first use of a key id.  Consecutive
+    // samples almost always share the key id, so the last one is kept
+    // aside to skip the lookup.
+    android::KeyedVector<android::Vector<uint8_t>, AesCtrDecryptor*>
+            mDecryptors;
+    KeyId mLastKeyId;
+    AesCtrDecryptor* mLastDecryptor;
 };
 
 } // namespace clearkeydrm
@@ -15,7 +15,9 @@
  */
 
 #include <gtest/gtest.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <utils/String8.h>
 #include <utils/Vector.h>
@@ -418,4 +420,133 @@ TEST_F(AesCtrDecryptorTest, DecryptsComplexMixedSubSamples) {
                                                subSamples, kNumSubsamples);
 }
 
+// A video sample in the usual CENC layout: a clear NAL header in front of
+// each encrypted slice.
+static const size_t kSampleSize = 64 * 1024;
+static const size_t kNumSampleSubSamples = 4;
+static const SubSample kSampleSubSamples[kNumSampleSubSamples] = {
+    {5, 16379},
+    {5, 16379},
+    {5, 16379},
+    {5, 16379},
+};
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void fillRandom(uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = rand();
+    }
+}
+
+TEST_F(AesCtrDecryptorTest, BatchMatchesSingleDecrypts) {
+    const size_t kNumSamples = 8;
+
+    srand(42);
+    Vector<uint8_t> key;
+    key.resize(kBlockSize);
+    fillRandom(key.editArray(), kBlockSize);
+
+    Vector<uint8_t> source, single, batch;
+    source.resize(kSampleSize * kNumSamples);
+    single.resize(kSampleSize * kNumSamples);
+    batch.resize(kSampleSize * kNumSamples);
+    fillRandom(source.editArray(), source.size());
+
+    Iv ivs[kNumSamples];
+    fillRandom(&ivs[0][0], sizeof(ivs));
+
+    AesCtrDecryptor::Sample samples[kNumSamples];
+    for (size_t i = 0; i < kNumSamples; ++i) {
+        size_t bytesDecrypted = 0;
+        AesCtrDecryptor decryptor;
+        ASSERT_EQ(android::OK, decryptor.decrypt(key, ivs[i],
+                source.array() + i * kSampleSize,
+                single.editArray() + i * kSampleSize,
+                kSampleSubSamples, kNumSampleSubSamples, &bytesDecrypted));
+        EXPECT_EQ(kSampleSize, bytesDecrypted);
+
+        samples[i].mIv = ivs[i];
+        samples[i].mSource = source.array() + i * kSampleSize;
+        samples[i].mDestination = batch.editArray() + i * kSampleSize;
+        samples[i].mSubSamples = kSampleSubSamples;
+        samples[i].mNumSubSamples = kNumSampleSubSamples;
+        samples[i].mBytesDecrypted = 0;
+    }
+
+    AesCtrDecryptor decryptor;
+    ASSERT_EQ(android::OK, decryptor.setKey(key));
+    ASSERT_EQ(android::OK, decryptor.decrypt(samples, kNumSamples));
+    for (size_t i = 0; i < kNumSamples; ++i) {
+        EXPECT_EQ(kSampleSize, samples[i].mBytesDecrypted);
+    }
+    EXPECT_EQ(0, memcmp(single.array(), batch.array(), batch.size()));
+}
+
+TEST_F(AesCtrDecryptorTest, Benchmark) {
+    const size_t kNumSamples = 16;
+    const int kRuns = 64;
+
+    srand(42);
+    Vector<uint8_t> key;
+    key.resize(kBlockSize);
+    fillRandom(key.editArray(), kBlockSize);
+    Iv iv;
+    fillRandom(iv, kBlockSize);
+
+    Vector<uint8_t> source, destination;
+    source.resize(kSampleSize * kNumSamples);
+    destination.resize(kSampleSize * kNumSamples);
+    fillRandom(source.editArray(), source.size());
+
+    AesCtrDecryptor::Sample samples[kNumSamples];
+    for (size_t i = 0; i < kNumSamples; ++i) {
+        samples[i].mIv = iv;
+        samples[i].mSource = source.array() + i * kSampleSize;
+        samples[i].mDestination = destination.editArray() + i * kSampleSize;
+        samples[i].mSubSamples = kSampleSubSamples;
+        samples[i].mNumSubSamples = kNumSampleSubSamples;
+    }
+
+    // a new key schedule for every sample
+    int64_t rekeyNs = nowNs();
+    for (int run = 0; run < kRuns; ++run) {
+        for (size_t i = 0; i < kNumSamples; ++i) {
+            AesCtrDecryptor decryptor;
+            size_t bytesDecrypted;
+            decryptor.decrypt(key, iv, samples[i].mSource, samples[i].mDestination,
+                    kSampleSubSamples, kNumSampleSubSamples, &bytesDecrypted);
+        }
+    }
+    rekeyNs = nowNs() - rekeyNs;
+
+    AesCtrDecryptor decryptor;
+    ASSERT_EQ(android::OK, decryptor.setKey(key));
+
+    int64_t cachedNs = nowNs();
+    for (int run = 0; run < kRuns; ++run) {
+        for (size_t i = 0; i < kNumSamples; ++i) {
+            size_t bytesDecrypted;
+            decryptor.decrypt(iv, samples[i].mSource, samples[i].mDestination,
+                    kSampleSubSamples, kNumSampleSubSamples, &bytesDecrypted);
+        }
+    }
+    cachedNs = nowNs() - cachedNs;
+
+    int64_t batchNs = nowNs();
+    for (int run = 0; run < kRuns; ++run) {
+        decryptor.decrypt(samples, kNumSamples);
+    }
+    batchNs = nowNs() - batchNs;
+
+    const double megabytes = (double)kSampleSize * kNumSamples * kRuns / (1024 * 1024);
+    printf("per sample key: %.1f MB/s, cached key: %.1f MB/s, batch of %zu: %.1f MB/s\n",
+            megabytes * 1e9 / rekeyNs, megabytes * 1e9 / cachedNs, kNumSamples,
+            megabytes * 1e9 / batchNs);
+}
+
 }  // namespace clearkeydrm
@@ -128,7 +128,29 @@ class VendorTagDescriptor
         static sp<VendorTagDescriptor> getGlobalVendorTagDescriptor();
     protected:
         VendorTagDescriptor();
-        KeyedVector<String8, KeyedVector<String8, uint32_t>*> mReverseMapping;
+
+        /**
+         * Build mTagHashTable from mTagToNameMap, mTagToSectionMap and
+         * mSections.  Called once by each of the create methods, so that
+         * lookupTag does not have to search through the section and name
+         * strings.
+         */
+        void buildTagHashTable();
+
+        // Hash of a section name and a tag name, as used by mTagHashTable.
+        static uint32_t hashTagName(const String8& section, const String8& name);
+
+        /**
+         * Open addressed table of (hash, tag id) pairs with a power of two
+         * size of at least twice the tag count, probed linearly.  A tag id
+         * of 0 marks an empty slot; vendor tag ids are never below
+         * CAMERA_METADATA_VENDOR_TAG_BOUNDARY.
+         */
+        struct TagHashEntry {
+            uint32_t hash;
+            uint32_t tag;
+        };
+        Vector<TagHashEntry> mTagHashTable;
         KeyedVector<uint32_t, String8> mTagToNameMap;
         KeyedVector<uint32_t, uint32_t> mTagToSectionMap; // Value is offset in mSections
         KeyedVector<uint32_t, int32_t> mTagToTypeMap;
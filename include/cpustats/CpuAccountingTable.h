@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CPU_ACCOUNTING_TABLE_H
+#define _CPU_ACCOUNTING_TABLE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <cpustats/CentralTendencyStatistics.h>
+
+namespace android {
+
+// The CPU and wall time accounted to one component, e.g. all the threads of one looper
+// name, summed over its threads since accounting was enabled.
+struct CpuAccountingData {
+    static const size_t kMaxName = 32;
+
+    char                        mName[kMaxName];    // empty if the slot is unused
+    int32_t                     mThreads;           // currently accounted threads
+    int32_t                     mThreadsTotal;      // threads ever accounted
+    int64_t                     mCpuNs;
+    int64_t                     mWallNs;
+    CentralTendencyStatistics   mLoad;              // CPU over wall time, per thread period
+};
+
+// One slot of the CpuAccountingTable. The writers of a process serialize among themselves;
+// readers in other processes retry until they copied mData between two reads of the same
+// even sequence number.
+class CpuAccountingSlot {
+public:
+    static const int kMaxReadRetries = 8;
+
+    void init() {
+        atomic_init(&mSequence, 0u);
+        mData.mName[0] = '\0';
+        mData.mThreads = 0;
+        mData.mThreadsTotal = 0;
+        mData.mCpuNs = 0;
+        mData.mWallNs = 0;
+        mData.mLoad.reset();
+    }
+
+    // Writer API. data is only valid between beginWrite() and endWrite().
+    CpuAccountingData *beginWrite() {
+        const uint32_t sequence = atomic_load_explicit(&mSequence, memory_order_relaxed);
+        atomic_store_explicit(&mSequence, sequence + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        return &mData;
+    }
+
+    void endWrite() {
+        const uint32_t sequence = atomic_load_explicit(&mSequence, memory_order_relaxed);
+        atomic_store_explicit(&mSequence, sequence + 1, memory_order_release);
+    }
+
+    // Writer API, for the writers of the table only.
+    const CpuAccountingData& data() const { return mData; }
+
+    // Reader API. Returns false if no consistent copy could be made.
+    bool read(CpuAccountingData *data) const {
+        for (int i = 0; i < kMaxReadRetries; i++) {
+            const uint32_t before = atomic_load_explicit(&mSequence, memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            *data = mData;
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&mSequence, memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    mutable atomic_uint_least32_t   mSequence;
+    CpuAccountingData               mData;
+};
+
+// A fixed size table of components, shared by the process whose threads are accounted
+// with a process that dumps it.
+struct CpuAccountingTable {
+    static const uint32_t kMagic = 0x41555043;  // 'CPUA'
+    static const size_t kNumSlots = 64;
+
+    void init();
+
+    // Writer API, serialized by the caller. Returns the slot of component name, adding it
+    // if needed, or -1 if the table is full.
+    ssize_t getSlot(const char *name);
+
+    // Reader API. Dumps the components by decreasing CPU time.
+    void dump(int fd, int indent) const;
+
+    uint32_t            mMagic;
+    uint32_t            mNumSlots;
+    int64_t             mStartNs;   // CLOCK_MONOTONIC time accounting was enabled
+    CpuAccountingSlot   mSlots[kNumSlots];
+};
+
+}   // namespace android
+
+#endif  // _CPU_ACCOUNTING_TABLE_H
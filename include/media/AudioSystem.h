@@ -20,6 +20,7 @@
 #include <hardware/audio_effect.h>
 #include <media/AudioPolicy.h>
 #include <media/AudioIoDescriptor.h>
+#include <media/IAudioFlinger.h>
 #include <media/IAudioFlingerClient.h>
 #include <media/IAudioPolicyServiceClient.h>
 #include <system/audio.h>
@@ -34,6 +35,7 @@ typedef void (*dynamic_policy_callback)(int event, String8 regId, int val);
 typedef void (*audio_session_callback)(int event,
         sp<AudioSessionInfo>& session, bool added);
 
+struct AudioIoStateTable;
 class IAudioFlinger;
 class IAudioPolicyService;
 class String8;
@@ -61,6 +63,8 @@ public:
     // set/get stream volume on specified output
     static status_t setStreamVolume(audio_stream_type_t stream, float value,
                                     audio_io_handle_t output);
+    // set several stream volumes with a single call to audio flinger
+    static status_t setStreamVolumes(const IAudioFlinger::StreamVolume *volumes, size_t count);
     static status_t getStreamVolume(audio_stream_type_t stream, float* volume,
                                     audio_io_handle_t output);
 
@@ -368,7 +372,8 @@ private:
     public:
         AudioFlingerClient() :
             mInBuffSize(0), mInSamplingRate(0),
-            mInFormat(AUDIO_FORMAT_DEFAULT), mInChannelMask(AUDIO_CHANNEL_NONE) {
+            mInFormat(AUDIO_FORMAT_DEFAULT), mInChannelMask(AUDIO_CHANNEL_NONE),
+            mIoStateTable(NULL) {
         }
 
         void clearIoCache();
@@ -376,6 +381,14 @@ private:
                                     audio_channel_mask_t channelMask, size_t* buffSize);
         sp<AudioIoDescriptor> getIoDescriptor(audio_io_handle_t ioHandle);
 
+        // maps the state published by AudioFlinger, see IAudioFlinger::getIoState()
+        void setIoState(const sp<IMemory>& ioState);
+        // Reads the render position published by the output thread, without a binder call.
+        // Returns WOULD_BLOCK if it is not published or older than two periods of the output,
+        // in which case the caller asks AudioFlinger.
+        status_t getRenderPosition(audio_io_handle_t output, uint32_t *halFrames,
+                                   uint32_t *dspFrames);
+
         // DeathRecipient
         virtual void binderDied(const wp<IBinder>& who);
 
@@ -404,6 +417,8 @@ private:
         uint32_t                            mInSamplingRate;
         audio_format_t                      mInFormat;
         audio_channel_mask_t                mInChannelMask;
+        sp<IMemory>                         mIoStateMemory;
+        const AudioIoStateTable*            mIoStateTable;  // NULL if mIoStateMemory is 0
         sp<AudioIoDescriptor> getIoDescriptor_l(audio_io_handle_t ioHandle);
     };
 
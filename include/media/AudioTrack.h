@@ -659,6 +659,38 @@ public:
      */
             ssize_t     write(const void* buffer, size_t size, bool blocking = true);
 
+    /* One buffer of a writeBatch() list.
+     *  data                pointer to the data
+     *  size                in byte units, must be a multiple of the frame size
+     *  presentationTimeUs  time at which the first frame should be presented, in the time base
+     *                      of the other buffers of the stream, or kNoPresentationTime to play
+     *                      it right after the previous buffer
+     */
+    struct BatchBuffer {
+        const void* data;
+        size_t      size;
+        int64_t     presentationTimeUs;
+    };
+    static const int64_t kNoPresentationTime = -1;
+
+    /* Writes a list of buffers in one call, for TRANSFER_SYNC.
+     * Each region returned by obtainBuffer() is filled from as many buffers as fit before
+     * it is released, so the proxy handshake and any wait happen once per region of the track
+     * buffer instead of once per client buffer.
+     * For linear PCM, a buffer whose presentation time is after the end of the previous buffer
+     * by more than kBatchToleranceUs is preceded by silence, and one that starts before it by
+     * more than that has its first frames dropped, so that the stream follows the presentation
+     * times.  Differences of more than kBatchMaxGapUs are taken as a discontinuity, and the
+     * buffer is played as is.  The reference is cleared by stop() and flush().
+     * Returns the number of bytes consumed from the list, in order, including dropped frames
+     * but not inserted silence, or a negative status code as write() does if nothing was
+     * consumed.
+     */
+            ssize_t     writeBatch(const BatchBuffer* buffers, size_t count, bool blocking = true);
+
+    static const int64_t kBatchToleranceUs = 5000;
+    static const int64_t kBatchMaxGapUs = 1000000;
+
     /*
      * Dumps the state of an audio track.
      * Not a general-purpose API; intended only for use by media player service to dump its tracks.
@@ -906,6 +938,9 @@ protected:
                                                     // and could be easily widened to uint64_t
     int64_t                 mStartUs;               // the start time after flush or stop.
                                                     // only used for offloaded and direct tracks.
+    int64_t                 mBatchPresentationTimeUs; // presentation time of the frame after
+                                                    // the last one written by writeBatch(),
+                                                    // or kNoPresentationTime
 
     bool                    mPreviousTimestampValid;// true if mPreviousTimestamp is valid
     bool                    mTimestampStartupGlitchReported; // reduce log spam
@@ -36,6 +36,10 @@ class CharacterEncodingDetector {
         void addTag(const char *name, const char *value);
         size_t size();
 
+        // Removes all tags, so that the detector can be reused for the next file.
+        // The ICU detector and the converters opened so far are kept.
+        void clear();
+
         void detectAndConvert();
         status_t getTag(int index, const char **name, const char**value);
 
@@ -47,6 +51,11 @@ class CharacterEncodingDetector {
 
         bool isFrequent(const uint16_t *values, uint32_t c);
 
+        UConverter *openConverter(const char *name);
+
+        static bool isPrintableAscii(const char *value, size_t len);
+        static bool isValidUtf8(const char *value, size_t len);
+
         // cached name and value strings, for native encoding support.
         // TODO: replace these with byte blob arrays that don't require the data to be
         // singlenullbyte-terminated
@@ -54,6 +63,16 @@ class CharacterEncodingDetector {
         StringArray     mValues;
 
         UConverter*     mUtf8Conv;
+
+        // kept across detectAndConvert() calls, ICU is slow to set these up
+        enum { kMaxConverters = 4 };
+        struct Converter {
+            char            mName[32];
+            UConverter*     mConv;
+        };
+        UCharsetDetector*   mCsd;
+        Converter       mConverters[kMaxConverters];
+        size_t          mNextConverter;
 };
 
 
@@ -124,6 +124,14 @@ public:
                                     audio_io_handle_t output) = 0;
     virtual     status_t    setStreamMute(audio_stream_type_t stream, bool muted) = 0;
 
+    struct StreamVolume {
+        audio_stream_type_t mStream;
+        float               mVolume;
+        audio_io_handle_t   mOutput;    // AUDIO_IO_HANDLE_NONE for all outputs
+    };
+    /* same as setStreamVolume() for each of volumes[0..count-1] in order, in a single call */
+    virtual     status_t    setStreamVolumes(const StreamVolume *volumes, size_t count) = 0;
+
     virtual     float       streamVolume(audio_stream_type_t stream,
                                     audio_io_handle_t output) const = 0;
     virtual     bool        streamMute(audio_stream_type_t stream) const = 0;
@@ -246,6 +254,11 @@ public:
 
     /* Indicate JAVA services are ready (scheduling, power management ...) */
     virtual status_t systemReady() = 0;
+
+    /* Get the read-only shared memory block where each output publishes its state,
+     * an AudioIoStateTable. Returns 0 if it is not available.
+     */
+    virtual sp<IMemory> getIoState() const = 0;
 };
 
 
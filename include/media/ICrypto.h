@@ -56,6 +56,18 @@ struct ICrypto : public IInterface {
             void *dstPtr,
             AString *errorDetailMsg) = 0;
 
+    // Non-secure decryption straight into destBuffer, usually the codec's
+    // input buffer, so that the decrypted data is neither copied through
+    // the binder reply nor staged in a separate buffer.
+    virtual ssize_t decrypt(
+            const uint8_t key[16],
+            const uint8_t iv[16],
+            CryptoPlugin::Mode mode,
+            const sp<IMemory> &sharedBuffer, size_t offset,
+            const CryptoPlugin::SubSample *subSamples, size_t numSubSamples,
+            const sp<IMemory> &destBuffer,
+            AString *errorDetailMsg) = 0;
+
 private:
     DISALLOW_EVIL_CONSTRUCTORS(ICrypto);
 };
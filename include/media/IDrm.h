@@ -54,6 +54,21 @@ struct IDrm : public IInterface {
                                         Vector<uint8_t> const &response,
                                         Vector<uint8_t> &keySetId) = 0;
 
+    // Asynchronous getKeyRequest() and provideKeyResponse(), so that the next keys of a
+    // rotation can be requested and loaded while the current ones are in use.  They return
+    // once the operation is queued, which requires a listener, and the listener's
+    // notifyKeyOperation() is called with the token when it completes.  Operations
+    // complete in the order they were queued.
+    virtual status_t getKeyRequestAsync(uint32_t token,
+                                        Vector<uint8_t> const &sessionId,
+                                        Vector<uint8_t> const &initData,
+                                        String8 const &mimeType, DrmPlugin::KeyType keyType,
+                                        KeyedVector<String8, String8> const &optionalParameters) = 0;
+
+    virtual status_t provideKeyResponseAsync(uint32_t token,
+                                             Vector<uint8_t> const &sessionId,
+                                             Vector<uint8_t> const &response) = 0;
+
     virtual status_t removeKeys(Vector<uint8_t> const &keySetId) = 0;
 
     virtual status_t restoreKeys(Vector<uint8_t> const &sessionId,
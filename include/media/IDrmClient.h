@@ -30,6 +30,12 @@ public:
     DECLARE_META_INTERFACE(DrmClient);
 
     virtual void notify(DrmPlugin::EventType eventType, int extra, const Parcel *obj) = 0;
+
+    // Completion of IDrm::getKeyRequestAsync() or provideKeyResponseAsync().  obj holds
+    // the session id, then, if status is OK, the request, default url and request type of
+    // a key request, or the key set id of a key response.
+    virtual void notifyKeyOperation(uint32_t token __unused, status_t status __unused,
+                                    const Parcel *obj __unused) {}
 };
 
 // ----------------------------------------------------------------------------
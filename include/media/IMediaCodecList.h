@@ -25,6 +25,7 @@
 
 namespace android {
 
+class IMemory;
 struct MediaCodecInfo;
 
 class IMediaCodecList: public IInterface
@@ -41,6 +42,10 @@ public:
             const char *type, bool encoder, size_t startIndex = 0) const = 0;
 
     virtual ssize_t findCodecByName(const char *name) const = 0;
+
+    // The whole list, serialized into read-only shared memory, so that a client can map
+    // it and answer queries locally. May return NULL.
+    virtual sp<IMemory> getSerializedList() const = 0;
 };
 
 // ----------------------------------------------------------------------------
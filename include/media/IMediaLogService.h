@@ -31,6 +31,9 @@ public:
     virtual void    registerWriter(const sp<IMemory>& shared, size_t size, const char *name) = 0;
     virtual void    unregisterWriter(const sp<IMemory>& shared) = 0;
 
+    // Registers the CpuAccountingTable of the calling process, see ACpuAccounting.
+    virtual void    registerCpuAccounting(const sp<IMemory>& shared) = 0;
+
 };
 
 class BnMediaLogService: public BnInterface<IMediaLogService>
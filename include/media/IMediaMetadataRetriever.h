@@ -43,6 +43,9 @@ public:
     virtual status_t        setDataSource(int fd, int64_t offset, int64_t length) = 0;
     virtual status_t        setDataSource(const sp<IDataSource>& dataSource) = 0;
     virtual sp<IMemory>     getFrameAtTime(int64_t timeUs, int option) = 0;
+    // The frame may be scaled down, but is no smaller than maxWidth x maxHeight.
+    virtual sp<IMemory>     getScaledFrameAtTime(
+            int64_t timeUs, int option, int32_t maxWidth, int32_t maxHeight) = 0;
     virtual sp<IMemory>     extractAlbumArt() = 0;
     virtual const char*     extractMetadata(int keyCode) = 0;
 };
@@ -119,6 +119,14 @@ public:
     // Init the audio decoder and the video decoder
     // @return OK if the video player was resumed successfully
     virtual status_t        resume() = 0;
+
+    // Playback statistics since the data source was set: per stage latency
+    // histograms, dropped and late frames, rebuffering, codec queue depths
+    // and bytes read.
+    // @param[out] reply Number of metrics, then for each a String16 name, an
+    //                   int32 count and that many int64 values.
+    // @return INVALID_OPERATION if the player does not collect statistics.
+    virtual status_t        getMetrics(Parcel *reply) = 0;
 };
 
 // ----------------------------------------------------------------------------
@@ -24,6 +24,7 @@
 #include <ui/GraphicBuffer.h>
 #include <utils/List.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 #include <list>
 
@@ -172,6 +173,25 @@ public:
             OMX_U32 range_offset, OMX_U32 range_length,
             OMX_U32 flags, OMX_TICKS timestamp, int fenceFd = -1) = 0;
 
+    // One buffer of a batched fillBuffers() or emptyBuffers() call. The range, flags and
+    // timestamp are ignored by fillBuffers().
+    struct BufferSubmission {
+        buffer_id mBuffer;
+        OMX_U32 mRangeOffset;
+        OMX_U32 mRangeLength;
+        OMX_U32 mFlags;
+        OMX_TICKS mTimestamp;
+        int mFenceFd;
+    };
+
+    // Submits several buffers to the same node in one call, in order, as if fillBuffer()
+    // or emptyBuffer() had been called for each of them. Every buffer is submitted even if
+    // an earlier one fails, and the first error is returned. Takes ownership of all fences.
+    // The default implementation makes one call per buffer; the binder proxy sends all of
+    // them in a single transaction.
+    virtual status_t fillBuffers(node_id node, const Vector<BufferSubmission> &buffers);
+    virtual status_t emptyBuffers(node_id node, const Vector<BufferSubmission> &buffers);
+
     virtual status_t getExtensionIndex(
             node_id node,
             const char *parameter_name,
@@ -184,6 +204,8 @@ public:
         INTERNAL_OPTION_MAX_FPS, // data is float
         INTERNAL_OPTION_START_TIME, // data is an int64_t
         INTERNAL_OPTION_TIME_LAPSE, // data is an int64_t[2]
+        INTERNAL_OPTION_MAX_LATENCY, // data is an int64_t
+        INTERNAL_OPTION_RESET_END_OF_STREAM, // data is a bool, ignored
     };
     virtual status_t setInternalOption(
             node_id node,
@@ -48,6 +48,14 @@ public:
     virtual bool reclaimResource(
             int callingPid,
             const Vector<MediaResource> &resources) = 0;
+
+    // Picks the clients reclaimResource() would reclaim from, without reclaiming anything.
+    // Returns true if there are any. *policyConflict is set if the resources conflict with
+    // the codec policies, in which case allocating them without reclaiming first fails.
+    virtual bool reclaimResourceDryRun(
+            int callingPid,
+            const Vector<MediaResource> &resources,
+            bool *policyConflict) = 0;
 };
 
 // ----------------------------------------------------------------------------
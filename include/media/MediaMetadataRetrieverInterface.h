@@ -43,6 +43,12 @@ public:
     virtual status_t    setDataSource(int fd, int64_t offset, int64_t length) = 0;
     virtual status_t setDataSource(const sp<DataSource>& source) = 0;
     virtual VideoFrame* getFrameAtTime(int64_t timeUs, int option) = 0;
+    // Returns a frame that may be scaled down, but no smaller than maxWidth x maxHeight
+    // in display orientation. Retrievers that cannot scale return the full size frame.
+    virtual VideoFrame* getScaledFrameAtTime(
+            int64_t timeUs, int option, int32_t /* maxWidth */, int32_t /* maxHeight */) {
+        return getFrameAtTime(timeUs, option);
+    }
     virtual MediaAlbumArt* extractAlbumArt() = 0;
     virtual const char* extractMetadata(int keyCode) = 0;
 };
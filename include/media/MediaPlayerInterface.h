@@ -97,6 +97,10 @@ public:
         virtual ssize_t     frameSize() const = 0;
         virtual uint32_t    latency() const = 0;
         virtual float       msecsPerFrame() const = 0;
+        // Duration of the content the sink's buffer holds when full, or -1 if unknown.
+        virtual int64_t     getBufferDurationInUs() const = 0;
+        // Frames played as silence because no data was written in time.
+        virtual uint32_t    getUnderrunFrames() const = 0;
         virtual status_t    getPosition(uint32_t *position) const = 0;
         virtual status_t    getTimestamp(AudioTimestamp &ts) const = 0;
         virtual status_t    getFramesWritten(uint32_t *frameswritten) const = 0;
@@ -275,6 +279,11 @@ public:
         return INVALID_OPERATION;
     }
 
+    // Playback statistics, see IMediaPlayer::getMetrics().
+    virtual status_t getMetrics(Parcel* /* reply */) {
+        return INVALID_OPERATION;
+    }
+
 private:
     friend class MediaPlayerService;
 
@@ -299,7 +299,14 @@ private:
         void getSamples(short *outBuffer, unsigned int count,
                 unsigned int command);
 
+        // Same as getSamples() on each of waveGens[0..numWaveGens-1], with
+        // numWaveGens <= TONEGEN_MAX_WAVES, in a single pass over outBuffer.
+        static void getSamples(WaveGenerator * const waveGens[], unsigned int numWaveGens,
+                short *outBuffer, unsigned int count, unsigned int command);
+
     private:
+        static const unsigned int NUM_LANES = TONEGEN_MAX_WAVES + 1;  // vector width
+
         static const short GEN_AMP = 32000;  // amplitude of generator
         static const short S_Q14 = 14;  // shift for Q14
         static const short S_Q15 = 15;  // shift for Q15
@@ -311,7 +318,13 @@ private:
         short mAmplitude_Q15;  // Q15 amplitude
     };
 
-    KeyedVector<unsigned short, WaveGenerator *> mWaveGens;  // list of active wave generators.
+    // Wave generators, indexed by frequency and number of waves in the segment (which sets
+    // the gain).  They are kept across tones, as the same few frequencies are used by the
+    // standard tones.
+    KeyedVector<uint32_t, WaveGenerator *> mWaveGens;
+    // Wave generators of each segment of mpToneDesc, in waveFreq[] order
+    WaveGenerator *mSegmentWaveGens[TONEGEN_MAX_SEGMENTS+1][TONEGEN_MAX_WAVES];
+    unsigned int mNumSegmentWaveGens[TONEGEN_MAX_SEGMENTS+1];
 };
 
 }
@@ -167,7 +167,14 @@ enum media_parameter_keys {
     KEY_PARAMETER_PLAYBACK_RATE_PERMILLE = 1300,                // set only
 
     // Set a Parcel containing the value of a parcelled Java AudioAttribute instance
-    KEY_PARAMETER_AUDIO_ATTRIBUTES = 1400                       // set only
+    KEY_PARAMETER_AUDIO_ATTRIBUTES = 1400,                      // set only
+
+    // Slave playback to the common time service: set a Parcel containing an int64_t media
+    // time in microseconds and the int64_t common time in microseconds at which it is to be
+    // presented. A negative common time returns to the local clock. The anchor has to be set
+    // again after seeking, pausing or changing the playback rate. Native only, and only
+    // supported by NuPlayer; set it before start() so that audio is not offloaded.
+    KEY_PARAMETER_COMMON_TIME_ANCHOR = 1500                     // set only
 };
 
 // Keep INVOKE_ID_* in sync with MediaPlayer.java.
@@ -258,6 +265,7 @@ public:
             status_t        setNextMediaPlayer(const sp<MediaPlayer>& player);
             status_t        suspend();
             status_t        resume();
+            status_t        getMetrics(Parcel *reply);
 
 private:
             void            clear_l();
@@ -22,6 +22,7 @@
 #include <utils/List.h>
 #include <utils/Errors.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 #include <pthread.h>
 
 struct dirent;
@@ -83,8 +84,19 @@ struct MediaScanner {
     virtual MediaAlbumArt *extractAlbumArt(int fd) = 0;
 
 protected:
+    // Number of regular files past the one being reported that are offered to
+    // prefetchFile() while a directory is scanned.
+    static const size_t kPrefetchWindow = 8;
+
     const char *locale() const;
 
+    // Called while walking a directory for files that the client is about to
+    // be told about, so that an implementation can start extracting their
+    // metadata ahead of processFile(). The default does nothing.
+    virtual void prefetchFile(
+            const char * /* path */, long long /* lastModified */,
+            long long /* fileSize */) {}
+
 private:
     // current locale (like "ja_JP"), created/destroyed with strdup()/free()
     char *mLocale;
@@ -96,6 +108,8 @@ private:
     MediaScanResult doProcessDirectoryEntry(
             char *path, int pathRemaining, MediaScannerClient &client, bool noMedia,
             struct dirent* entry, char* fileSpot);
+    void doPrefetchDirectoryEntry(struct dirent* entry, char *path, int pathRemaining,
+            char* fileSpot);
     void loadSkipList();
     bool shouldSkipDirectory(char *path);
 
@@ -24,6 +24,8 @@ namespace android {
 // Pipe is multi-thread safe for readers (see PipeReader), but safe for only a single writer thread.
 // It cannot UNDERRUN on write, unless we allow designation of a master reader that provides the
 // time-base. Readers can be added and removed dynamically, and it's OK to have no readers.
+// Each reader chooses what happens when it falls behind, see PipeReader::Policy.  Readers with
+// POLICY_BLOCK_WRITER limit availableToWrite() and write() so that they never overrun.
 class Pipe : public NBAIO_Sink {
 
     friend class PipeReader;
@@ -51,17 +53,31 @@ public:
 
     // The write side of a pipe permits overruns; flow control is the caller's responsibility.
     // It doesn't return +infinity because that would guarantee an overrun.
-    virtual ssize_t availableToWrite() const { return mMaxFrames; }
+    // With readers attached using PipeReader::POLICY_BLOCK_WRITER, it is instead the space
+    // left behind the slowest of them, and write() never writes more than that.
+    virtual ssize_t availableToWrite() const;
 
     virtual ssize_t write(const void *buffer, size_t count);
     //virtual ssize_t writeVia(writeVia_t via, size_t total, void *user, size_t block);
 
+    // Maximum number of readers attached with PipeReader::POLICY_BLOCK_WRITER.
+    static const int kMaxBlockingReaders = 4;
+
 private:
+    // Slot management for blocking readers, called by PipeReader.
+    // Returns the slot index, or -1 if all slots are in use.
+    int             addBlockingReader(int32_t front);
+    void            removeBlockingReader(int slot);
+
     const size_t    mMaxFrames;     // always a power of 2
     void * const    mBuffer;
     volatile int32_t mRear;         // written by android_atomic_release_store
     volatile int32_t mReaders;      // number of PipeReader clients currently attached to this Pipe
     const bool      mFreeBufferInDestructor;
+
+    volatile int32_t mBlockingSlots;    // bit i set if slot i is claimed by a reader
+    volatile int32_t mBlockingReaders;  // bit i set if mBlockingFronts[i] is valid
+    volatile int32_t mBlockingFronts[kMaxBlockingReaders]; // each written by its reader only
 };
 
 }   // namespace android
@@ -26,9 +26,22 @@ class PipeReader : public NBAIO_Source {
 
 public:
 
+    // What happens when the reader falls behind the writer
+    enum Policy {
+        // Overrun, and then resume 15/16 of the pipe behind the writer.  This is the default.
+        POLICY_DROP_OLDEST,
+        // Never overrun: the writer is limited to the space this reader has consumed.
+        // Falls back to POLICY_DROP_OLDEST if Pipe::kMaxBlockingReaders are already attached.
+        POLICY_BLOCK_WRITER,
+        // Once more than half of the pipe is pending, discard a few frames ahead of each
+        // read() until the lag is back under half, so that it catches up in small steps
+        // instead of losing 1/16 of the pipe at once on overrun.
+        POLICY_CATCH_UP,
+    };
+
     // Construct a PipeReader and associate it with a Pipe
     // FIXME make this constructor a factory method of Pipe.
-    PipeReader(Pipe& pipe);
+    PipeReader(Pipe& pipe, Policy policy = POLICY_DROP_OLDEST);
     virtual ~PipeReader();
 
     // NBAIO_Port interface
@@ -43,6 +56,14 @@ public:
     virtual size_t framesOverrun() { return mFramesOverrun; }
     virtual size_t overruns()  { return mOverruns; }
 
+    // Frames discarded to catch up with POLICY_CATCH_UP, not counted in framesOverrun()
+    size_t framesDropped() const { return mFramesDropped; }
+
+    // Number of frames written but not yet read, may exceed the pipe size before an overrun
+    size_t lag() const;
+
+    Policy policy() const { return mPolicy; }
+
     virtual ssize_t availableToRead();
 
     virtual ssize_t read(void *buffer, size_t count, int64_t readPTS);
@@ -58,6 +79,9 @@ private:
     int32_t     mFront;         // follows behind mPipe.mRear
     size_t      mFramesOverrun;
     size_t      mOverruns;
+    size_t      mFramesDropped;
+    Policy      mPolicy;
+    int         mBlockingSlot;  // slot in mPipe for POLICY_BLOCK_WRITER, or -1
 };
 
 }   // namespace android
@@ -70,15 +70,19 @@ struct ACodec : public AHierarchicalStateMachine, public CodecBase {
         size_t countBuffers();
         IOMX::buffer_id bufferIDAt(size_t index) const;
         sp<ABuffer> bufferAt(size_t index) const;
+        sp<IMemory> memRefAt(size_t index) const;
 
     private:
         friend struct ACodec;
 
         Vector<IOMX::buffer_id> mBufferIDs;
         Vector<sp<ABuffer> > mBuffers;
+        Vector<sp<IMemory> > mMemRefs;
 
         PortDescription();
-        void addBuffer(IOMX::buffer_id id, const sp<ABuffer> &buffer);
+        void addBuffer(
+                IOMX::buffer_id id, const sp<ABuffer> &buffer,
+                const sp<IMemory> &memRef);
 
         DISALLOW_EVIL_CONSTRUCTORS(PortDescription);
     };
@@ -177,6 +181,7 @@ protected:
         unsigned mDequeuedAt;
 
         sp<ABuffer> mData;
+        sp<IMemory> mMemRef;            // shared memory behind mData, if any
         sp<GraphicBuffer> mGraphicBuffer;
         int mFenceFd;
         FrameRenderTracker::Info *mRenderInfo;
@@ -269,6 +274,7 @@ protected:
 
     int64_t mRepeatFrameDelayUs;
     int64_t mMaxPtsGapUs;
+    int64_t mMaxLatencyUs;
     float mMaxFps;
 
     int64_t mTimePerFrameUs;
@@ -366,7 +372,8 @@ protected:
     status_t setupG711Codec(bool encoder, int32_t sampleRate, int32_t numChannels);
 
     status_t setupFlacCodec(
-            bool encoder, int32_t numChannels, int32_t sampleRate, int32_t compressionLevel);
+            bool encoder, int32_t numChannels, int32_t sampleRate, int32_t compressionLevel,
+            int32_t blockSize = 0, int32_t threadCount = 0);
 
     status_t setupRawAudioFormat(
             OMX_U32 portIndex, int32_t sampleRate, int32_t numChannels);
@@ -63,6 +63,9 @@ protected:
         //calculated for max duration 80 msec with 48K sampling rate.
         kMaxBufferSize = 30720,
 
+        // Number of returned kMaxBufferSize buffers kept for reuse.
+        kMaxFreeBuffers = 8,
+
 
         // After the initial mute, we raise the volume linearly
         // over kAutoRampDurationUs.
@@ -95,6 +98,7 @@ protected:
     bool mRecPaused;
 
     List<MediaBuffer * > mBuffersReceived;
+    List<MediaBuffer * > mFreeBuffers;
 
     void trackMaxAmplitude(int16_t *data, int nSamples);
 
@@ -106,6 +110,14 @@ protected:
 
     virtual void queueInputBuffer_l(MediaBuffer *buffer, int64_t timeUs);
     void releaseQueuedFrames_l();
+
+    // Returns a buffer of at least the given size, reusing a returned one if possible.
+    MediaBuffer *acquireBuffer_l(size_t size);
+    // Keeps an unreferenced buffer for reuse, or frees it.
+    void recycleBuffer_l(MediaBuffer *buffer);
+    void releaseFreeBuffers_l();
+    // Appends queued buffers that fit to the end of the given buffer.
+    void coalesceQueuedFrames_l(MediaBuffer *buffer);
     void waitOutstandingEncodingFrames_l();
     virtual status_t reset();
 
@@ -151,6 +151,13 @@ protected:
     // Otherwise returns false.
     bool trySettingVideoSize(int32_t width, int32_t height);
 
+    // Lowers the camera's preview fps range to the slowest supported range
+    // that still delivers a frame per capture interval, so that the frames
+    // skipFrameAndModifyTimeStamp() would drop are never produced.  Only done
+    // when ro.camera.time_lapse_low_fps is set, since it also slows down the
+    // application's preview.  Returns true if the range was changed.
+    bool trySettingCaptureFpsRange();
+
     // When video camera is used for time lapse capture, returns true
     // until enough time has passed for the next time lapse frame. When
     // the frame needs to be encoded, it returns false and also modifies
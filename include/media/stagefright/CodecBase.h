@@ -19,6 +19,7 @@
 #define CODEC_BASE_H_
 
 #include <stdint.h>
+#include <binder/IMemory.h>
 #include <media/IOMX.h>
 
 #include <media/stagefright/foundation/AHandler.h>
@@ -73,6 +74,10 @@ struct CodecBase : public AHandler {
         virtual IOMX::buffer_id bufferIDAt(size_t index) const = 0;
         virtual sp<ABuffer> bufferAt(size_t index) const = 0;
 
+        // The shared memory behind bufferAt(index), if there is any that
+        // other processes may write to.
+        virtual sp<IMemory> memRefAt(size_t /* index */) const { return NULL; }
+
     protected:
         PortDescription();
         virtual ~PortDescription();
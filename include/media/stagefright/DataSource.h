@@ -97,6 +97,22 @@ public:
         return ERROR_UNSUPPORTED;
     }
 
+    // Identifies the local file, and the range of it, a source reads from, so that
+    // data parsed from it can be cached until the file changes.
+    struct FileIdentity {
+        uint64_t mDevice;
+        uint64_t mInode;
+        int64_t mModifiedNs;
+        int64_t mFileSize;
+        int64_t mOffset;
+        int64_t mLength;
+    };
+
+    // Returns false if the source is not a plain local file.
+    virtual bool getFileIdentity(FileIdentity * /* identity */) {
+        return false;
+    }
+
     ////////////////////////////////////////////////////////////////////////////
 
     bool sniff(String8 *mimeType, float *confidence, sp<AMessage> *meta);
@@ -39,6 +39,8 @@ public:
 
     virtual status_t getSize(off64_t *size);
 
+    virtual bool getFileIdentity(FileIdentity *identity);
+
     virtual sp<DecryptHandle> DrmInitialization(const char *mime);
 
     virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client);
@@ -64,6 +66,25 @@ private:
     ssize_t mDrmBufSize;
     unsigned char *mDrmBuf;
 
+    // Small reads are served from a page aligned cache of the fd, filled by one
+    // pread() per kReadCacheSize bytes; larger reads go straight to the fd.
+    uint8_t *mCache;
+    off64_t mCacheOffset;   // offset of the cache in the fd, not relative to mOffset
+    size_t mCacheSize;
+
+    // Sequential access detection, to hint the kernel to read ahead of the reader.
+    off64_t mNextSequentialOffset;
+    int32_t mSequentialReads;
+    off64_t mReadaheadEnd;
+
+    // Optional read-only mapping of [mOffset, mOffset + mLength), see init().
+    void *mMapping;
+    size_t mMappingSize;
+    const uint8_t *mMappedData;
+
+    void init();
+    ssize_t readAtCached_l(off64_t fileOffset, void *data, size_t size);
+    void hintReadahead_l(off64_t fileOffset, size_t size);
     ssize_t readAtDRM(off64_t offset, void *data, size_t size);
     void fetchUriFromFd(int fd);
 
@@ -70,7 +70,9 @@ private:
     int64_t mNumTSPacketsBeforeMeta;
     int mPATContinuityCounter;
     int mPMTContinuityCounter;
-    uint32_t mCrcTable[256];
+
+    // Holds all TS packets of the access unit being written, reused across access units.
+    sp<ABuffer> mPacketBuffer;
 
     void init();
 
@@ -78,8 +80,6 @@ private:
     void writeProgramAssociationTable();
     void writeProgramMap();
     void writeAccessUnit(int32_t sourceIndex, const sp<ABuffer> &buffer);
-    void initCrcTable();
-    uint32_t crc32(const uint8_t *start, size_t length);
 
     ssize_t internalWrite(const void *data, size_t size);
     status_t reset();
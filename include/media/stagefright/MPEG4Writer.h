@@ -23,6 +23,7 @@
 #include <media/stagefright/MediaWriter.h>
 #include <utils/List.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -72,6 +73,7 @@ protected:
     virtual ~MPEG4Writer();
 
 private:
+    class BatchWriter;
     class Track;
 
     int  mFd;
@@ -90,6 +92,7 @@ protected:
 private:
     off_t mMdatOffset;
     uint8_t *mMoovBoxBuffer;
+    size_t mMoovBoxBufferSize;  // grows as needed
     off64_t mMoovBoxBufferOffset;
     bool  mWriteMoovBoxToMemory;
     off64_t mFreeBoxOffset;
@@ -103,6 +106,14 @@ private:
     int mLongitudex10000;
     bool mAreGeoTagsAvailable;
     int32_t mStartTimeOffsetMs;
+    int32_t mBitRate;  // as requested in start(), -1 if unknown
+
+    // Fragmented files: the moov, without any samples, is written before
+    // the first fragment, once every track has one.
+    int64_t mFragmentDurationUs;  // 0 if the file is not fragmented
+    uint32_t mFragmentSequenceNumber;
+    bool mWroteFragmentedMoov;
+    off64_t mMehdOffset;  // of the fragment duration, written in reset()
 
     Mutex mLock;
 
@@ -120,10 +131,19 @@ private:
     size_t numTracks();
     int64_t estimateMoovBoxSize(int32_t bitRate);
 
+    // What a fragment's trun records about a sample, times in track ticks
+    struct FragmentSample {
+        uint32_t mSize;
+        bool mIsSync;
+        int64_t mDecodingTime;
+        int64_t mCompositionOffset;
+    };
+
     struct Chunk {
         Track               *mTrack;        // Owner
         int64_t             mTimeStampUs;   // Timestamp of the 1st sample
         List<MediaBuffer *> mSamples;       // Sample data
+        Vector<FragmentSample> mFragmentSamples;  // Fragmented files only
 
         // Convenient constructor
         Chunk(): mTrack(NULL), mTimeStampUs(0) {}
@@ -143,6 +163,14 @@ private:
         // Max time interval between neighboring chunks
         int64_t mMaxInterChunkDurUs;
 
+        // Chunks waiting for the writer thread, now and at most
+        size_t mQueueDepth;
+        size_t mMaxQueueDepth;
+
+        // Time the writer thread spent writing this track's chunks
+        size_t mNumChunksWritten;
+        nsecs_t mTotalWriteNs;
+        nsecs_t mMaxWriteNs;
     };
 
     bool            mIsFirstChunk;
@@ -151,6 +179,9 @@ private:
     List<ChunkInfo> mChunkInfos;            // Chunk infos
     Condition       mChunkReadyCondition;   // Signal that chunks are available
 
+    // Batches the sample data while the writer thread runs, NULL otherwise
+    BatchWriter     *mBatchWriter;
+
     // Writer thread handling
     status_t startWriterThread();
     void stopWriterThread();
@@ -170,6 +201,8 @@ private:
     // Actually write the given chunk to the file.
     void writeChunkToFile(Chunk* chunk);
 
+    void noteChunkWritten_l(Track *track, nsecs_t writeNs);
+
     // Adjust other track media clock (presumably wall clock)
     // based on audio track media clock with the drift time.
     int64_t mDriftTimeUs;
@@ -202,15 +235,23 @@ protected:
     static void StripStartcode(MediaBuffer *buffer);
     virtual off64_t addLengthPrefixedSample_l(MediaBuffer *buffer);
 
+    // Writes sample data at mOffset, through the batch writer if there is one.
+    void writeSampleData_l(const void *data, size_t size);
+
 private:
     bool exceedsFileSizeLimit();
     bool use32BitFileOffset() const;
+    bool isFragmented() const { return mFragmentDurationUs > 0; }
     bool exceedsFileDurationLimit();
     bool isFileStreamable() const;
     void trackProgressStatus(size_t trackId, int64_t timeUs, status_t err = OK);
     void writeCompositionMatrix(int32_t degrees);
     void writeMvhdBox(int64_t durationUs);
     void writeMoovBox(int64_t durationUs);
+    void writeMvexBox();
+    void writeFragmentedMoovBox();
+    void beginMoovBoxInMemory(size_t size);
+    bool relocateMoovBox();
     void writeFtypBox(MetaData *param);
     void writeUdtaBox();
     void writeGeoDataBox();
@@ -21,10 +21,14 @@
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MetaData.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
 #include <utils/threads.h>
 
 namespace android {
 
+struct AMessage;
+
 // Convert the MediaMuxer's push model into MPEG4Writer's pull model.
 // Used only by the MediaMuxer for now.
 struct MediaAdapter : public MediaSource, public MediaBufferObserver {
@@ -56,6 +60,20 @@ public:
     // deep copy, such that after pushBuffer return, the buffer can be re-used.
     status_t pushBuffer(MediaBuffer *buffer);
 
+    // queueBuffer() returns as soon as the buffer is queued for read(), and
+    // only waits while more than the max queued bytes are already waiting.
+    // The buffer's data must stay valid until notify, if not NULL, is posted
+    // with an "err" field once the writer is done with it. If the buffer
+    // cannot be queued, it is released and notify is not posted.
+    status_t queueBuffer(MediaBuffer *buffer, const sp<AMessage> &notify);
+
+    // Sets the byte budget for queueBuffer(), kDefaultMaxQueuedBytes by default.
+    void setMaxQueuedBytes(size_t maxQueuedBytes);
+
+    enum {
+        kDefaultMaxQueuedBytes = 4 * 1024 * 1024,
+    };
+
     virtual void notifyError(status_t err);
 
 private:
@@ -65,7 +83,17 @@ private:
     // Make sure the pushBuffer() wait for the current buffer consumed.
     Condition mBufferReturnedCond;
 
-    MediaBuffer *mCurrentMediaBuffer;
+    // Buffers waiting for read(), oldest first.
+    List<MediaBuffer *> mQueuedBuffers;
+    size_t mQueuedBytes;
+    size_t mMaxQueuedBytes;
+
+    // Buffers pushed or queued and not yet returned by the writer, with the
+    // completion message, which may be NULL.
+    KeyedVector<MediaBuffer *, sp<AMessage> > mPendingBuffers;
+
+    status_t enqueue_l(MediaBuffer *buffer, const sp<AMessage> &notify);
+    void complete_l(MediaBuffer *buffer, status_t err);
 
     bool mStarted;
     sp<MetaData> mOutputFormat;
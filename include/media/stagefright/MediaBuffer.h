@@ -101,6 +101,7 @@ private:
 
     MediaBufferObserver *mObserver;
     MediaBuffer *mNextBuffer;
+    MediaBuffer *mNextFree;  // owned by the MediaBufferGroup while the buffer is unused
     int mRefCount;
 
     void *mData;
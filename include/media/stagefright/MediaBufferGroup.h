@@ -18,6 +18,8 @@
 
 #define MEDIA_BUFFER_GROUP_H_
 
+#include <stdatomic.h>
+
 #include <media/stagefright/MediaBuffer.h>
 #include <utils/Errors.h>
 #include <utils/threads.h>
@@ -29,7 +31,9 @@ class MetaData;
 
 class MediaBufferGroup : public MediaBufferObserver {
 public:
-    MediaBufferGroup();
+    // With a growthLimit, acquire_buffer() adds buffers sized for the request
+    // while the group holds fewer than growthLimit buffers, instead of blocking.
+    MediaBufferGroup(size_t growthLimit = 0);
     ~MediaBufferGroup();
 
     void add_buffer(MediaBuffer *buffer);
@@ -39,7 +43,16 @@ public:
     // The returned buffer will have a reference count of 1.
     // If nonBlocking is true and a buffer is not immediately available,
     // buffer is set to NULL and it returns WOULD_BLOCK.
-    status_t acquire_buffer(MediaBuffer **buffer, bool nonBlocking = false);
+    // If requestedSize is not 0, the returned buffer holds at least that many
+    // bytes. A free buffer that is too small is replaced by one that is large
+    // enough, so callers can start from small buffers instead of the largest
+    // sample they may ever see.
+    status_t acquire_buffer(
+            MediaBuffer **buffer, bool nonBlocking = false, size_t requestedSize = 0);
+
+    size_t buffers() const;
+
+    void dump(int fd) const;
 
 protected:
     virtual void signalBufferReturned(MediaBuffer *buffer);
@@ -47,10 +60,45 @@ protected:
 private:
     friend class MediaBuffer;
 
-    Mutex mLock;
+    struct Stats {
+        Stats();
+
+        uint32_t mAcquires;
+        uint32_t mWouldBlock;
+        uint32_t mWaits;
+        nsecs_t mWaitNs;
+        nsecs_t mMaxWaitNs;
+        uint32_t mGrowths;      // buffers added by acquire_buffer()
+        uint32_t mReplacements; // free buffers replaced by larger ones
+        uint32_t mHighWater;    // most buffers in use at once
+    };
+
+    mutable Mutex mLock;
     Condition mCondition;
 
+    // All buffers in the group, linked through mNextBuffer.
     MediaBuffer *mFirstBuffer, *mLastBuffer;
+    size_t mNumBuffers;
+    size_t mGrowthLimit;
+
+    // Free buffers owned by acquire_buffer(), linked through mNextFree, under mLock.
+    MediaBuffer *mFreeBuffers;
+
+    // Buffers given back by signalBufferReturned(), which never takes mLock
+    // unless an acquirer is waiting. acquire_buffer() takes the whole list at once,
+    // so that both sides are a single atomic operation.
+    atomic_uintptr_t mReturnedBuffers;
+    atomic_int mWaiters;
+    atomic_int mInUse;
+
+    Stats mStats;
+
+    void addBuffer_l(MediaBuffer *buffer);
+    void removeBuffer_l(MediaBuffer *buffer);
+    void collectReturnedBuffers_l();
+    MediaBuffer *takeFreeBuffer_l(size_t requestedSize);
+
+    static size_t sizeClass(size_t size);
 
     MediaBufferGroup(const MediaBufferGroup &);
     MediaBufferGroup &operator=(const MediaBufferGroup &);
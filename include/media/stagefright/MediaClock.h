@@ -18,6 +18,8 @@
 
 #define MEDIA_CLOCK_H_
 
+#include <stdatomic.h>
+
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/Mutex.h>
 #include <utils/RefBase.h>
@@ -53,24 +55,50 @@ struct MediaClock : public RefBase {
     // query real time corresponding to media time |targetMediaUs|.
     // The result is saved in |outRealUs|.
     status_t getRealTimeFor(int64_t targetMediaUs, int64_t *outRealUs) const;
+    // same as getRealTimeFor() for each of the |count| media times in
+    // |targetMediaUs|, all against the same clock state and current time.
+    status_t getRealTimesFor(
+            const int64_t *targetMediaUs, int64_t *outRealUs, size_t count) const;
+
+    // The queries above never block: they read a snapshot of the clock
+    // published by the setters, which alone serialize on mLock.
 
 protected:
     virtual ~MediaClock();
 
 private:
-    status_t getMediaTime_l(
+    struct State {
+        int64_t mAnchorTimeMediaUs;
+        int64_t mAnchorTimeRealUs;
+        int64_t mMaxTimeMediaUs;
+        int64_t mStartingTimeMediaUs;
+        float mPlaybackRate;
+    };
+
+    static status_t computeMediaTime(
+            const State &state,
             int64_t realUs,
             int64_t *outMediaUs,
-            bool allowPastMaxTime) const;
+            bool allowPastMaxTime);
 
-    mutable Mutex mLock;
+    // Publishes mState to the readers, called with mLock held after each
+    // change.
+    void publish_l();
+    void readSnapshot(State *state) const;
 
-    int64_t mAnchorTimeMediaUs;
-    int64_t mAnchorTimeRealUs;
-    int64_t mMaxTimeMediaUs;
-    int64_t mStartingTimeMediaUs;
+    mutable Mutex mLock;
 
-    float mPlaybackRate;
+    // Protected by mLock.
+    State mState;
+
+    // Seqlock copy of mState: mSeq is odd while publish_l() updates the
+    // fields, and a reader retries if it changed while reading them.
+    atomic_uint_least32_t mSeq;
+    atomic_int_least64_t mSnapAnchorTimeMediaUs;
+    atomic_int_least64_t mSnapAnchorTimeRealUs;
+    atomic_int_least64_t mSnapMaxTimeMediaUs;
+    atomic_int_least64_t mSnapStartingTimeMediaUs;
+    atomic_uint_least32_t mSnapPlaybackRateBits;
 
     DISALLOW_EVIL_CONSTRUCTORS(MediaClock);
 };
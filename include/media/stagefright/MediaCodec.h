@@ -23,6 +23,7 @@
 #include <media/MediaResource.h>
 #include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/FrameRenderTracker.h>
+#include <utils/KeyedVector.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -164,6 +165,11 @@ struct MediaCodec : public AHandler {
 
     status_t getName(AString *componentName) const;
 
+    // Returns the time from queueing an input buffer to the matching output buffer
+    // becoming available, as "latency-count", "latency-avg-us" and "latency-max-us",
+    // measured since the codec was configured.
+    status_t getStats(sp<AMessage> *stats) const;
+
     status_t setParameters(const sp<AMessage> &params);
 
     // Create a MediaCodec notification message from a list of rendered or dropped render infos
@@ -225,6 +231,7 @@ private:
         kWhatRequestIDRFrame                = 'ridr',
         kWhatRequestActivityNotification    = 'racN',
         kWhatGetName                        = 'getN',
+        kWhatGetStats                       = 'getS',
         kWhatSetParameters                  = 'setP',
         kWhatSetCallback                    = 'setC',
         kWhatSetNotification                = 'setN',
@@ -251,6 +258,7 @@ private:
         sp<ABuffer> mData;
         sp<ABuffer> mEncryptedData;
         sp<IMemory> mSharedEncryptedBuffer;
+        sp<IMemory> mSharedDecryptedBuffer;     // the codec's own input buffer
         sp<AMessage> mNotify;
         sp<AMessage> mFormat;
         bool mOwnedByClient;
@@ -274,6 +282,9 @@ private:
 
         bool reclaimResource(const Vector<MediaResource> &resources);
 
+        bool reclaimResourceDryRun(
+                const Vector<MediaResource> &resources, bool *policyConflict);
+
     private:
         Mutex mLock;
         sp<IResourceManagerService> mService;
@@ -302,6 +313,9 @@ private:
     sp<ResourceManagerServiceProxy> mResourceManagerService;
 
     bool mBatteryStatNotified;
+    // MediaSchedulingPolicy session while started, 0 if none
+    int32_t mSchedulingSessionId;
+    float mFrameRate;   // configured, 0 if unknown
     bool mIsVideo;
     int32_t mVideoWidth;
     int32_t mVideoHeight;
@@ -339,6 +353,16 @@ private:
     bool mHaveInputSurface;
     bool mHavePendingInputBuffers;
 
+    // queue time of the input buffers whose output is still pending, by presentation time
+    KeyedVector<int64_t, int64_t> mInputQueueTimesUs;
+    int64_t mNumLatencySamples;
+    int64_t mTotalLatencyUs;
+    int64_t mMaxLatencyUs;
+
+    void resetLatencyStats();
+    void onInputQueued(int64_t timeUs);
+    void onOutputAvailable(const sp<ABuffer> &buffer);
+
     MediaCodec(const sp<ALooper> &looper, pid_t pid);
 
     static status_t PostAndAwaitResponse(
@@ -382,6 +406,7 @@ private:
 
     status_t amendOutputFormatWithCodecSpecificData(const sp<ABuffer> &buffer);
     void updateBatteryStat();
+    void updateSchedulingSession();
     bool isExecuting() const;
 
     uint64_t getGraphicBufferSize();
@@ -27,6 +27,7 @@
 #include <sys/types.h>
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
 #include <utils/Vector.h>
 #include <utils/StrongPointer.h>
 
@@ -34,7 +35,9 @@ namespace android {
 
 extern const char *kMaxEncoderInputBuffers;
 
+struct ABuffer;
 struct AMessage;
+class IMemory;
 
 struct MediaCodecList : public BnMediaCodecList {
     static sp<IMediaCodecList> getInstance();
@@ -56,6 +59,8 @@ struct MediaCodecList : public BnMediaCodecList {
 
     virtual const sp<AMessage> getGlobalSettings() const;
 
+    virtual sp<IMemory> getSerializedList() const;
+
     // to be used by MediaPlayerService alone
     static sp<IMediaCodecList> getLocalInstance();
 
@@ -84,10 +89,22 @@ private:
         SECTION_INCLUDE,
     };
 
+    // A configuration file the list was built from, with its size and modification time
+    // when it was parsed, or -1 if it did not exist.
+    struct ConfigFile {
+        AString mPath;
+        int64_t mSize;
+        int64_t mModifiedTime;
+    };
+
     static sp<IMediaCodecList> sCodecList;
     static sp<IMediaCodecList> sRemoteList;
 
     status_t mInitCheck;
+    bool mLoadedFromCache;
+    Vector<ConfigFile> mConfigFiles;
+    mutable Mutex mSerializedLock;
+    mutable sp<IMemory> mSerialized;
     Section mCurrentSection;
     bool mUpdate;
     Vector<Section> mPastSections;
@@ -102,10 +119,21 @@ private:
     sp<IOMX> mOMX;
 
     MediaCodecList();
+    // a copy of the list shared by getSerializedList()
+    MediaCodecList(const sp<IMemory> &serialized);
     ~MediaCodecList();
 
     status_t initCheck() const;
     void parseXMLFile(const char *path);
+    void addConfigFile(const char *path);
+    void configureResourceManager() const;
+
+    // The list is kept in /data between boots, and rebuilt only if the build or any of
+    // the configuration files it was parsed from change.
+    sp<ABuffer> serialize() const;
+    bool deserialize(const uint8_t *data, size_t size, bool checkConfigFiles);
+    bool loadCache();
+    void saveCache() const;
 
     static void StartElementHandlerWrapper(
             void *me, const char *name, const char **attrs);
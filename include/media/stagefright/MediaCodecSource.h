@@ -23,6 +23,7 @@
 
 namespace android {
 
+struct ABuffer;
 struct ALooper;
 class AMessage;
 struct AReplyToken;
@@ -36,6 +37,9 @@ struct MediaCodecSource : public MediaSource,
     enum FlagBits {
         FLAG_USE_SURFACE_INPUT      = 1,
         FLAG_USE_METADATA_INPUT     = 2,
+        // With surface input, keep the encoder and its buffers allocated
+        // after stop(), so that a later start() resumes the same encoder.
+        FLAG_REUSE_ENCODER          = 4,
     };
 
     static sp<MediaCodecSource> Create(
@@ -88,6 +92,8 @@ private:
     status_t init();
     status_t initEncoder();
     void releaseEncoder();
+    void parkEncoder();
+    status_t restartEncoder();
     status_t feedEncoderInputBuffers();
     void suspend();
     void resume(int64_t skipFramesBeforeUs = -1ll);
@@ -107,6 +113,10 @@ private:
     bool mIsVideo;
     bool mStarted;
     bool mStopping;
+    bool mParked;
+    // last codec specific data, replayed when a parked encoder restarts
+    sp<ABuffer> mCodecConfig;
+    bool mCodecConfigSent;
     bool mDoMoreWorkPending;
     bool mSetEncoderFormat;
     int mEncoderFormat;
@@ -40,6 +40,14 @@ public:
         return &sPlugin;
     }
 
+    enum CreateFlags {
+        // The caller only wants the container meta data and the track formats,
+        // and won't call getTrack(). Extractors that support it then skip what
+        // is only needed for playback, such as sample tables, frame indexes and
+        // cluster loading. Other flags are passed through to AVFactory.
+        kMetaDataOnly = 0x80000000,
+    };
+
     static sp<MediaExtractor> Create(
             const sp<DataSource> &source, const char *mime = NULL,
             const uint32_t flags = 0, const sp<AMessage> *meta = NULL);
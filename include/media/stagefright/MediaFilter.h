@@ -134,6 +134,14 @@ private:
     sp<SimpleFilter> mFilter;
     sp<GraphicBufferListener> mGraphicBufferListener;
 
+    // converted input surface frames, reused once the filter is done with them
+    Vector<sp<ABuffer> > mFreeSurfaceFrames;
+
+    // filter stage statistics, logged on shutdown
+    int64_t mNumFramesProcessed;
+    int64_t mTotalProcessTimeUs;
+    int64_t mMaxProcessTimeUs;
+
     // helper functions
     void signalProcessBuffers();
     void signalError(status_t error);
@@ -148,6 +156,9 @@ private:
     void sendFormatChange();
     void requestFillEmptyInput();
     void processBuffers();
+    void logStats();
+    sp<ABuffer> acquireSurfaceFrame(size_t size);
+    void releaseSurfaceFrame(const sp<ABuffer> &frame);
 
     void onAllocateComponent(const sp<AMessage> &msg);
     void onConfigureComponent(const sp<AMessage> &msg);
@@ -19,12 +19,17 @@
 #define MEDIA_HTTP_H_
 
 #include <media/stagefright/foundation/AString.h>
+#include <utils/KeyedVector.h>
+#include <utils/Vector.h>
+#include <utils/threads.h>
 
 #include "include/HTTPBase.h"
 
 namespace android {
 
+struct ABuffer;
 struct IMediaHTTPConnection;
+struct IMediaHTTPService;
 
 struct MediaHTTP : public HTTPBase {
     MediaHTTP(const sp<IMediaHTTPConnection> &conn);
@@ -46,6 +51,13 @@ struct MediaHTTP : public HTTPBase {
 
     virtual status_t reconnectAtOffset(off64_t offset);
 
+    // Once the content length is known, reads are served from chunks of
+    // kParallelChunkSize bytes that up to "numConnections" additional
+    // connections made by "service" fetch concurrently ahead of the read
+    // position. numConnections < 2 keeps the serial single connection reads.
+    void setParallelConnections(
+            const sp<IMediaHTTPService> &service, size_t numConnections);
+
 protected:
     virtual ~MediaHTTP();
 
@@ -69,6 +81,45 @@ protected:
 
     void clearDRMState_l();
 
+private:
+    struct Fetcher;
+
+    enum {
+        kParallelChunkSize = 256 * 1024,
+    };
+
+    enum ChunkState {
+        CHUNK_PENDING,
+        CHUNK_FETCHING,
+        CHUNK_DONE,
+        CHUNK_FAILED,
+    };
+
+    struct Chunk {
+        ChunkState mState;
+        sp<ABuffer> mData;
+    };
+
+    Mutex mParallelLock;
+    Condition mParallelCondition;
+    sp<IMediaHTTPService> mHTTPService;
+    size_t mNumParallelConnections;
+    Vector<sp<Fetcher> > mFetchers;
+    bool mStopFetchers;
+
+    // Keyed by chunk index, only the chunks in the read-ahead window.
+    KeyedVector<int64_t, Chunk> mChunks;
+    int64_t mLastFetchCompletedUs;
+
+    ssize_t readAtSerial(off64_t offset, void *data, size_t size);
+    ssize_t readAtParallel(
+            off64_t offset, void *data, size_t size, off64_t contentSize);
+
+    void startFetchers_l();
+    void stopFetchers();
+    void fillWindow_l(int64_t index, off64_t contentSize);
+    bool fetchChunk(Fetcher *fetcher);
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaHTTP);
 };
 
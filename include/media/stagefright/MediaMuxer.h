@@ -47,6 +47,8 @@ public:
     enum OutputFormat {
         OUTPUT_FORMAT_MPEG_4 = 0,
         OUTPUT_FORMAT_WEBM   = 1,
+        // MPEG-4 with a moof/mdat fragment per track about every second
+        OUTPUT_FORMAT_FRAGMENTED_MPEG_4 = 2,
         OUTPUT_FORMAT_LIST_END // must be last - used to validate format type
     };
 
@@ -114,6 +116,32 @@ public:
     status_t writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
                              int64_t timeUs, uint32_t flags) ;
 
+    /**
+     * Queue a sample buffer for muxing without waiting for the writer.
+     * The buffer's data is not copied and must not be reused until notify
+     * is posted, with an int32 "err" field set to OK once the sample has
+     * been written, or to an error if it was dropped by stop(). This only
+     * blocks while the track already holds more than the queued byte budget.
+     * @param buffer the incoming sample buffer.
+     * @param trackIndex the buffer's track index number.
+     * @param timeUs the buffer's time stamp.
+     * @param flags the only supported flag for now is
+     *              MediaCodec::BUFFER_FLAG_SYNCFRAME.
+     * @param notify posted once the buffer can be reused, may be NULL.
+     * @return OK if no error.
+     */
+    status_t writeSampleDataAsync(const sp<ABuffer> &buffer, size_t trackIndex,
+                                  int64_t timeUs, uint32_t flags,
+                                  const sp<AMessage> &notify);
+
+    /**
+     * Set how many bytes writeSampleDataAsync() may queue per track before
+     * it blocks.
+     * @param maxQueuedBytes the per track budget.
+     * @return OK if no error.
+     */
+    status_t setMaxQueuedBytes(size_t maxQueuedBytes);
+
 private:
     const OutputFormat mFormat;
     sp<MediaWriter> mWriter;
@@ -121,6 +149,11 @@ private:
     sp<MetaData> mFileMeta;  // Metadata for the whole file.
 
     Mutex mMuxerLock;
+    size_t mMaxQueuedBytes;
+
+    MediaBuffer *createSampleBuffer_l(const sp<ABuffer> &buffer,
+                                      int64_t timeUs, uint32_t flags);
+    status_t checkSampleData_l(const sp<ABuffer> &buffer, size_t trackIndex);
 
     enum State {
         UNINITIALIZED,
@@ -115,6 +115,18 @@ struct MediaSource : public virtual RefBase {
         return ERROR_UNSUPPORTED;
     }
 
+    // Like read(), but the sample is written straight to the consumer's
+    // "data", which has room for "size" bytes, instead of to a buffer owned
+    // by this source. On success *buffer describes the sample in "data" and
+    // carries its meta data; the consumer must release() it and keeps
+    // ownership of "data". Sources that cannot do this return
+    // ERROR_UNSUPPORTED, after which the consumer should use read().
+    virtual status_t readInto(
+            void * /* data */, size_t /* size */,
+            MediaBuffer ** /* buffer */, const ReadOptions * /* options */ = NULL) {
+        return ERROR_UNSUPPORTED;
+    }
+
 protected:
     virtual ~MediaSource();
 
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_SOURCE_SPLITTER_H_
+#define MEDIA_SOURCE_SPLITTER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/MediaSource.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+
+namespace android {
+
+class MediaBuffer;
+class MetaData;
+
+// Fans the output of one MediaSource out to several readers, so that one camera
+// stream can feed more than one MediaCodecSource.  Every client returns the same
+// MediaBuffer, with one reference per client; the buffer goes back to the source
+// only once all clients have released it.  No data is copied.
+//
+// Clients read in lockstep: a new buffer is pulled from the source only once every
+// started client has read the current one, so the slowest client sets the pace and
+// the source (e.g. CameraSource) drops frames if the clients fall behind.
+//
+// The source is started by the first client that starts, and stopped when the last
+// started client stops.  Clients must not modify the buffer or its meta data.
+struct MediaSourceSplitter : public RefBase {
+    MediaSourceSplitter(const sp<MediaSource> &source);
+
+    sp<MediaSource> createClient();
+
+protected:
+    virtual ~MediaSourceSplitter();
+
+private:
+    struct Client;
+
+    Mutex mLock;
+    Condition mCondition;
+
+    sp<MediaSource> mSource;
+    size_t mNumStarted;
+    bool mSourceStarted;
+    bool mReading;
+
+    // The buffer read by the clients in the current generation, and the status of
+    // the source read that produced it.
+    MediaBuffer *mBuffer;
+    status_t mReadStatus;
+    int64_t mGeneration;
+    size_t mNumReadCurrent;
+
+    status_t startClient(MetaData *params, int64_t *generation);
+    status_t stopClient(int64_t lastGeneration);
+    status_t readClient(int64_t *lastGeneration, MediaBuffer **buffer,
+            const MediaSource::ReadOptions *options);
+
+    // Drops the splitter's own reference once every started client has read.
+    void releaseCurrentIfDone_l();
+
+    DISALLOW_EVIL_CONSTRUCTORS(MediaSourceSplitter);
+};
+
+}  // namespace android
+
+#endif  // MEDIA_SOURCE_SPLITTER_H_
@@ -21,6 +21,7 @@
 #include <gui/IProducerListener.h>
 
 #include <media/AudioResamplerPublic.h>
+#include <media/AudioTimestamp.h>
 #include <media/AVSyncSettings.h>
 #include <media/stagefright/foundation/AHandler.h>
 
@@ -204,6 +205,11 @@ private:
     int64_t mNumFramesWritten;
     bool mHasAudio;
 
+    // Last timestamp from |mAudioTrack|, reused for a short while instead of
+    // querying the track on every audio update. -1 if there is none.
+    AudioTimestamp mAudioTimestamp;
+    int64_t mAudioTimestampFetchedUs;
+
     int64_t mNextBufferItemMediaUs;
     List<BufferItem> mBufferItems;
     sp<VideoFrameScheduler> mFrameScheduler;
@@ -237,6 +243,8 @@ private:
     int64_t getDurationIfPlayedAtNativeSampleRate_l(int64_t numFrames);
     int64_t getPlayedOutAudioDurationMedia_l(int64_t nowUs);
 
+    // How long before it is due a video frame is sent to the output.
+    int64_t getVideoReleaseAheadUs_l();
     void onDrainVideo_l();
 
     // This implements the onFrameAvailable callback from IConsumerListener.
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_TRANSCODER_H_
+#define MEDIA_TRANSCODER_H_
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/MediaMuxer.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+
+namespace android {
+
+struct ABuffer;
+struct ALooper;
+struct AMessage;
+struct MediaCodec;
+struct NuMediaExtractor;
+
+// MediaTranscoder runs a complete extractor -> decoder -> encoder -> muxer
+// graph natively. Video is passed from the decoder to the encoder through
+// the encoder's input surface, so that frames never reach the CPU. Audio
+// PCM is copied from decoder output to encoder input buffers. Tracks
+// selected without an output format are copied to the muxer untouched.
+// Each transcoded track runs its codecs on its own looper, so that the
+// audio and video pipelines progress in parallel.
+//
+// The expected calling order is:
+// setDataSource -> setOutput -> selectTrack+ -> start -> (kWhatDone) -> stop
+// The transcoder must be registered on a looper before start().
+struct MediaTranscoder : public AHandler {
+    enum {
+        // "progress" int32 percent of the input duration, "timeUs" int64.
+        kWhatProgress = 'prog',
+        // "err" int32, OK once the output is complete.
+        kWhatDone     = 'done',
+    };
+
+    struct Stats {
+        int64_t mElapsedUs;
+        int64_t mDurationUs;
+        int64_t mPositionUs;
+        int64_t mNumSamplesRead;
+        int64_t mNumFramesDecoded;
+        int64_t mNumFramesEncoded;
+        int64_t mNumSamplesWritten;
+        int64_t mNumBytesWritten;
+
+        Stats();
+    };
+
+    MediaTranscoder(const sp<AMessage> &notify);
+
+    status_t setDataSource(int fd, off64_t offset, off64_t length);
+    status_t setOutput(int fd, MediaMuxer::OutputFormat format);
+
+    size_t countTracks() const;
+    status_t getTrackFormat(size_t index, sp<AMessage> *format) const;
+
+    // Adds the track to the output. It is transcoded to outputFormat, which
+    // must at least carry a "mime", or copied as is if outputFormat is NULL.
+    // Missing video size, frame rate and audio layout are taken from the
+    // input. Tracks that are not selected are dropped.
+    status_t selectTrack(size_t index, const sp<AMessage> &outputFormat);
+
+    // Limits the output to [startUs, endUs), endUs < 0 meaning the end of
+    // the input. Reading starts at the last sync sample at or before
+    // startUs and stops at the first sync sample at or after endUs, so a
+    // range whose bounds are sync sample times is transcoded exactly.
+    // Audio samples before startUs are dropped.
+    status_t setTimeRange(int64_t startUs, int64_t endUs);
+
+    status_t start();
+    status_t stop();
+
+    void getStats(Stats *stats) const;
+
+protected:
+    virtual ~MediaTranscoder();
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatStart,
+        kWhatStop,
+        kWhatFeed,
+        kWhatDecoderNotify,
+        kWhatEncoderNotify,
+        kWhatSampleWritten,
+    };
+
+    // A sample that is waiting for the muxer, or decoded PCM waiting for
+    // encoder input buffers. mIndex is the codec's buffer index, or -1 for
+    // a sample read from the extractor into mBuffer.
+    struct Sample {
+        ssize_t mIndex;
+        sp<ABuffer> mBuffer;
+        size_t mOffset;
+        size_t mSize;
+        int64_t mTimeUs;
+        uint32_t mFlags;
+    };
+
+    struct Track {
+        size_t mTrackIndex;
+        bool mIsVideo;
+        bool mPassthrough;
+        sp<AMessage> mInputFormat;
+        sp<AMessage> mOutputFormat;
+        size_t mMaxInputSize;
+
+        sp<ALooper> mCodecLooper;
+        sp<MediaCodec> mDecoder;
+        sp<MediaCodec> mEncoder;
+
+        List<size_t> mDecoderInputs;
+        List<size_t> mEncoderInputs;
+        List<Sample> mDecodedSamples;
+        List<Sample> mMuxerSamples;
+
+        int32_t mChannelCount;
+        int32_t mSampleRate;
+
+        ssize_t mMuxerTrack;
+        bool mInputEOS;
+        bool mOutputEOS;
+    };
+
+    sp<AMessage> mNotify;
+    sp<NuMediaExtractor> mExtractor;
+    sp<MediaMuxer> mMuxer;
+    bool mMuxerStarted;
+    bool mStarted;
+    bool mDone;         // written under mStatsLock, for getStats()
+    bool mFeedPending;
+    int64_t mRangeStartUs;
+    int64_t mRangeEndUs;
+
+    KeyedVector<size_t, Track> mTracks;
+
+    mutable Mutex mStatsLock;
+    Stats mStats;
+    int64_t mStartTimeUs;
+    int32_t mLastProgress;
+
+    status_t onStart();
+    void onStop();
+    status_t configureTrack(size_t trackIndex, Track *track);
+    void releaseTrack(Track *track);
+
+    void onDecoderNotify(const sp<AMessage> &msg);
+    void onEncoderNotify(const sp<AMessage> &msg);
+
+    bool signalInputEOS(Track *track);
+    void feedDecoders();
+    void feedEncoder(size_t trackIndex, Track *track);
+    void queueMuxerSample(size_t trackIndex, Track *track, const Sample &sample);
+    status_t writeMuxerSample(size_t trackIndex, Track *track, const Sample &sample);
+    status_t maybeStartMuxer();
+    void maybeFinish();
+    void notifyDone(status_t err);
+    void updateProgress(int64_t timeUs);
+
+    DISALLOW_EVIL_CONSTRUCTORS(MediaTranscoder);
+};
+
+}  // namespace android
+
+#endif  // MEDIA_TRANSCODER_H_
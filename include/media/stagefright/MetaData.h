@@ -127,6 +127,10 @@ enum {
     kKeyTrackTimeStatus   = 'tktm',  // int64_t
 
     kKeyRealTimeRecording = 'rtrc',  // bool (int32_t)
+
+    // Set this key to author a fragmented file, with a moof/mdat pair per
+    // track about every given duration.
+    kKeyFragmentDurationUs = 'frgd',  // int64_t
     kKeyNumBuffers        = 'nbbf',  // int32_t
 
     // Ogg files can be tagged to be automatically looping...
@@ -204,6 +208,9 @@ enum {
     // H264 supplemental enhancement information offsets/sizes
     kKeySEI               = 'sei ', // raw data
 
+    // CEA-608 closed caption triplets already extracted from the SEI
+    kKeyCCData            = 'ccdt', // raw data
+
     kKeyPCMFormat         = 'pfmt',
     kKeyArbitraryMode     = 'ArbM',
 
@@ -298,14 +305,17 @@ protected:
     virtual ~MetaData();
 
 private:
+    // Plain data, so that items can be moved around with memmove(). The owner
+    // calls init() before use and clear() when done.
     struct typed_data {
-        typed_data();
-        ~typed_data();
-
-        typed_data(const MetaData::typed_data &);
-        typed_data &operator=(const MetaData::typed_data &);
+        enum {
+            // enough for an int64_t, a pointer, a Rect or a short string
+            kInlineSize = 16,
+        };
 
+        void init();
         void clear();
+        void copyFrom(const MetaData::typed_data &from);
         void setData(uint32_t type, const void *data, size_t size);
         void getData(uint32_t *type, const void **data, size_t *size) const;
         String8 asString() const;
@@ -316,7 +326,7 @@ private:
 
         union {
             void *ext_data;
-            float reservoir;
+            int64_t reservoir[kInlineSize / sizeof(int64_t)];
         } u;
 
         bool usesReservoir() const {
@@ -327,11 +337,11 @@ private:
         void freeStorage();
 
         void *storage() {
-            return usesReservoir() ? &u.reservoir : u.ext_data;
+            return usesReservoir() ? u.reservoir : u.ext_data;
         }
 
         const void *storage() const {
-            return usesReservoir() ? &u.reservoir : u.ext_data;
+            return usesReservoir() ? u.reservoir : u.ext_data;
         }
     };
 
@@ -339,7 +349,25 @@ private:
         int32_t mLeft, mTop, mRight, mBottom;
     };
 
-    KeyedVector<uint32_t, typed_data> mItems;
+    struct item {
+        uint32_t mKey;
+        typed_data mData;
+    };
+
+    enum {
+        // per sample metadata (time, sync flag, duration, ...) fits without allocating
+        kInlineItems = 6,
+    };
+
+    // Sorted by key. Points to mInlineItems until more than kInlineItems are set.
+    // clear() keeps the storage, so that MediaBuffer::reset() doesn't allocate.
+    item *mItems;
+    size_t mNumItems;
+    size_t mCapacity;
+    item mInlineItems[kInlineItems];
+
+    ssize_t indexOfKey(uint32_t key) const;
+    void copyItems(const MetaData &from);
 
     // MetaData &operator=(const MetaData &);
 };
@@ -75,6 +75,31 @@ struct NuMediaExtractor : public RefBase {
 
     bool getCachedDuration(int64_t *durationUs, bool *eos) const;
 
+    struct SampleInfo {
+        size_t mOffset;     // of the sample data in the caller's buffer
+        size_t mSize;
+        int64_t mTimeUs;
+        uint32_t mFlags;    // bitmask of "SampleFlags"
+    };
+
+    // Per track reading, independent of advance() and readSampleData() which
+    // must not be used at the same time on the same track.
+    // Copies up to maxSamples consecutive samples of the selected track
+    // trackIndex back to back into data, and describes them in infos.
+    // Different tracks may be read concurrently from different threads.
+    // A sample that does not fit in the remaining capacity is kept for the
+    // next call; -ENOMEM is returned if not even the first sample fits.
+    // Returns ERROR_END_OF_STREAM (or the read error) once no sample is left.
+    status_t readTrackSamples(
+            size_t trackIndex, uint8_t *data, size_t capacity,
+            SampleInfo *infos, size_t maxSamples, size_t *numSamples);
+
+    // Makes the next readTrackSamples() of trackIndex start at timeUs.
+    status_t seekTrackTo(
+            size_t trackIndex, int64_t timeUs,
+            MediaSource::ReadOptions::SeekMode mode =
+                MediaSource::ReadOptions::SEEK_CLOSEST_SYNC);
+
 protected:
     virtual ~NuMediaExtractor();
 
@@ -83,6 +108,28 @@ private:
         kIsVorbis       = 1,
     };
 
+    // State of readTrackSamples(), only accessed with its own lock held so
+    // that reading one track never blocks on the others.
+    struct TrackReader : public RefBase {
+        TrackReader(const sp<MediaSource> &source, bool isVorbis);
+
+        Mutex mLock;
+        sp<MediaSource> mSource;    // NULL once the track is unselected
+        bool mIsVorbis;
+        status_t mFinalResult;
+        MediaBuffer *mPending;      // read but did not fit in the last call
+        int64_t mSeekTimeUs;
+        MediaSource::ReadOptions::SeekMode mSeekMode;
+
+        void releasePending();
+
+    protected:
+        virtual ~TrackReader();
+
+    private:
+        DISALLOW_EVIL_CONSTRUCTORS(TrackReader);
+    };
+
     struct TrackInfo {
         sp<MediaSource> mSource;
         size_t mTrackIndex;
@@ -91,6 +138,8 @@ private:
         int64_t mSampleTimeUs;
 
         uint32_t mTrackFlags;  // bitmask of "TrackFlags"
+
+        sp<TrackReader> mReader;
     };
 
     mutable Mutex mLock;
@@ -111,6 +160,9 @@ private:
 
     void releaseTrackSamples();
 
+    sp<TrackReader> findTrackReader(size_t trackIndex);
+    static void stopTrackReader(const sp<TrackReader> &reader);
+
     bool getTotalBitrate(int64_t *bitRate) const;
     void updateDurationAndBitrate();
 
@@ -27,6 +27,7 @@ struct ProcessInfo : public ProcessInfoInterface {
     ProcessInfo();
 
     virtual bool getPriority(int pid, int* priority);
+    virtual bool getPriorities(const int* pids, size_t numPids, int* priorities);
 
 protected:
     virtual ~ProcessInfo();
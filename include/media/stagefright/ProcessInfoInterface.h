@@ -24,6 +24,20 @@ namespace android {
 struct ProcessInfoInterface : public RefBase {
     virtual bool getPriority(int pid, int* priority) = 0;
 
+    // Gets the priorities of numPids processes at once. The priority of a process that
+    // can't be queried is set to -1. Returns false if none could be queried.
+    virtual bool getPriorities(const int* pids, size_t numPids, int* priorities) {
+        bool found = false;
+        for (size_t i = 0; i < numPids; ++i) {
+            if (getPriority(pids[i], &priorities[i])) {
+                found = true;
+            } else {
+                priorities[i] = -1;
+            }
+        }
+        return found;
+    }
+
 protected:
     virtual ~ProcessInfoInterface() {}
 };
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEGMENTED_TRANSCODER_H_
+#define SEGMENTED_TRANSCODER_H_
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaTranscoder.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ALooper;
+struct AMessage;
+
+// SegmentedTranscoder splits a long input at video sync samples into
+// segments that are transcoded concurrently, each by its own
+// MediaTranscoder and hardware encoder instance, and then stitches the
+// segments into one MPEG-4 output without re-encoding. The number of
+// segments is bounded by the video encoder's "max-concurrent-instances"
+// limit in MediaCodecList.
+//
+// Stitching requires every segment to produce identical codec specific
+// data, which is the case when all segments use the same encoder and
+// output format; transcode() fails with ERROR_UNSUPPORTED otherwise.
+struct SegmentedTranscoder : public AHandler {
+    SegmentedTranscoder();
+
+    status_t setDataSource(int fd, off64_t offset, off64_t length);
+    status_t setOutput(int fd);
+
+    // Directory for the intermediate segment files, /data/local/tmp by default.
+    void setTempDir(const char *path);
+
+    // At most maxSegments segments, 0 to only use the encoder's limit.
+    void setMaxSegments(size_t maxSegments);
+
+    // Same as MediaTranscoder::selectTrack(). One video track must be
+    // transcoded, as its sync samples define the segments.
+    status_t selectTrack(size_t index, const sp<AMessage> &outputFormat);
+
+    // Blocks until the output is complete. stats is the sum over segments,
+    // with mElapsedUs covering the whole run including stitching.
+    status_t transcode(MediaTranscoder::Stats *stats);
+
+protected:
+    virtual ~SegmentedTranscoder();
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatSegmentNotify,
+    };
+
+    struct Segment {
+        int64_t mStartUs;
+        int64_t mEndUs;
+        AString mPath;
+        int mFd;
+        sp<ALooper> mLooper;
+        sp<MediaTranscoder> mTranscoder;
+        status_t mResult;
+        bool mDone;
+    };
+
+    int mInputFd;
+    off64_t mInputOffset;
+    off64_t mInputLength;
+    int mOutputFd;
+    AString mTempDir;
+    size_t mMaxSegments;
+
+    KeyedVector<size_t, sp<AMessage> > mTrackFormats;
+    ssize_t mVideoTrack;
+    sp<ALooper> mLooper;
+
+    Mutex mLock;
+    Condition mCondition;
+    Vector<Segment> mSegments;
+    size_t mNumPending;
+
+    size_t getEncoderInstanceLimit() const;
+    status_t findSegmentBounds(size_t numSegments, Vector<int64_t> *bounds);
+    status_t startSegment(size_t index);
+    status_t stitchSegments(MediaTranscoder::Stats *stats);
+    void releaseSegments();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SegmentedTranscoder);
+};
+
+}  // namespace android
+
+#endif  // SEGMENTED_TRANSCODER_H_
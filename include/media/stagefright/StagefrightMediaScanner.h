@@ -19,6 +19,10 @@
 #define STAGEFRIGHT_MEDIA_SCANNER_H_
 
 #include <media/mediascanner.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
 
 namespace android {
 
@@ -32,13 +36,84 @@ struct StagefrightMediaScanner : public MediaScanner {
 
     virtual MediaAlbumArt *extractAlbumArt(int fd);
 
+protected:
+    virtual void prefetchFile(const char *path, long long lastModified, long long fileSize);
+
 private:
+    enum {
+        // Most files whose extracted metadata is kept around, either
+        // prefetched and waiting for processFile() or already reported.
+        kMaxEntries = 256,
+        kMaxThreads = 4,
+    };
+
+    struct Tag {
+        String8 mName;
+        String8 mValue;
+    };
+
+    // The metadata of one file, extracted either by a scan thread ahead of
+    // processFile() or by processFile() itself. Entries are indexed by path, and
+    // reused for as long as the file's modification time and size don't change.
+    struct ScanEntry : public RefBase {
+        enum State {
+            QUEUED,
+            RUNNING,
+            DONE,
+        };
+
+        String8 mPath;
+        long long mLastModified;
+        long long mFileSize;
+        State mState;
+        uint32_t mGeneration;  // for eviction, bumped each time the entry is used
+
+        MediaScanResult mResult;
+        String8 mMimeType;
+        Vector<Tag> mTags;
+    };
+
+    struct ScanThread : public Thread {
+        ScanThread(StagefrightMediaScanner *scanner);
+
+    private:
+        StagefrightMediaScanner *mScanner;
+
+        virtual bool threadLoop();
+    };
+
+    Mutex mLock;
+    Condition mWorkCondition;
+    Condition mDoneCondition;
+    List<sp<ScanEntry> > mQueue;
+    KeyedVector<String8, sp<ScanEntry> > mEntries;
+    Vector<sp<ScanThread> > mThreads;
+    // idle charset detectors, reused across files so ICU state is set up once per scan
+    Vector<CharacterEncodingDetector *> mDetectors;
+    uint32_t mGeneration;
+    // files offered to prefetchFile() since the client last called processFile()
+    size_t mPrefetchCount;
+    bool mExit;
+
     StagefrightMediaScanner(const StagefrightMediaScanner &);
     StagefrightMediaScanner &operator=(const StagefrightMediaScanner &);
 
     MediaScanResult processFileInternal(
             const char *path, const char *mimeType,
             MediaScannerClient &client);
+
+    sp<ScanEntry> acquireEntry(const char *path);
+    sp<ScanEntry> addEntry_l(const char *path, long long lastModified, long long fileSize);
+    void trimEntries_l();
+    void startThreads_l();
+    bool runQueuedEntry();
+
+    CharacterEncodingDetector *acquireDetector();
+    void releaseDetector(CharacterEncodingDetector *detector);
+
+    void extractEntry(const sp<ScanEntry> &entry);
+    status_t extractTags(const sp<ScanEntry> &entry);
+    static status_t retrieveTags(const sp<ScanEntry> &entry);
 };
 
 }  // namespace android
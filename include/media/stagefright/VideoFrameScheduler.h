@@ -19,6 +19,7 @@
 
 #include <utils/RefBase.h>
 #include <utils/Timers.h>
+#include <utils/Vector.h>
 
 #include <media/stagefright/foundation/ABase.h>
 
@@ -42,6 +43,24 @@ struct VideoFrameScheduler : public RefBase {
     // returns the current frames-per-second, or 0.f if not primed
     float getFrameRate();
 
+    struct PacingStats {
+        PacingStats();
+
+        float   mFrameRate;             // estimated video frame rate, or 0.f
+        float   mRefreshRate;           // refresh rate of the main display, or 0.f
+        // highest refresh rate supported by the main display that is a whole
+        // multiple of mFrameRate, or 0.f if there is none
+        float   mPreferredRefreshRate;
+        // vsyncs per frame of a stable cadence, e.g. 3 and 2 for 3:2 pulldown
+        // of 24 fps video on a 60Hz display, or 0 if the cadence is irregular
+        uint32_t mCadence[2];
+        int64_t mNumFrames;             // frames scheduled on vsync
+        int64_t mNumJudderFrames;       // frames that did not follow the cadence
+    };
+
+    // returns frame pacing statistics since the last init()
+    void getPacingStats(PacingStats *stats) const;
+
     void release();
 
     static const size_t kHistorySize = 8;
@@ -82,6 +101,8 @@ private:
     };
 
     void updateVsync();
+    void updateRefreshRates();
+    void updateCadence(nsecs_t videoPeriod, size_t vsyncsForLastFrame);
 
     nsecs_t mVsyncTime;        // vsync timing from display
     nsecs_t mVsyncPeriod;
@@ -92,6 +113,14 @@ private:
 
     PLL mPll;                  // PLL for video frame rate based on render time
 
+    Vector<float> mRefreshRates;   // refresh rates supported by the main display
+    bool mRefreshRatesQueried;
+
+    uint32_t mCadence[2];      // detected cadence, see PacingStats
+    size_t mLastVsyncsPerFrame; // vsyncs spent by the previous frame, or 0
+    int64_t mNumFrames;
+    int64_t mNumJudderFrames;
+
     sp<ISurfaceComposer> mComposer;
 
     DISALLOW_EVIL_CONSTRUCTORS(VideoFrameScheduler);
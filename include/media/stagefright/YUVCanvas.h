@@ -67,9 +67,17 @@ public:
             int32_t skipX, int32_t skipY,
             const YUVImage &srcImage);
 
+    // Scales the whole srcImage to the size of the canvas' target image
+    // (mYUVImage) with bilinear filtering. Both images are expected to have
+    // even dimensions.
+    void resize(const YUVImage &srcImage);
+
 private:
     YUVImage& mYUVImage;
 
+    // Writes value to count chroma samples step bytes apart.
+    static void fillChroma(uint8_t *dest, int32_t step, int32_t count, uint8_t value);
+
     YUVCanvas(const YUVCanvas &);
     YUVCanvas &operator=(const YUVCanvas &);
 };
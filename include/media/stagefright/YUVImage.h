@@ -105,6 +105,15 @@ public:
             int32_t destStartX, int32_t destStartY,
             const YUVImage &srcImage, YUVImage &destImage);
 
+    // Row access for operations on whole rows of pixels.
+    // Returns the address of the Y, U or V data of pixel (0,y). Consecutive
+    // chroma values of a row are chromaStep() bytes apart, and each chroma
+    // value covers two pixels of two pixel rows.
+    uint8_t *getYRow(int32_t y) const;
+    uint8_t *getURow(int32_t y) const;
+    uint8_t *getVRow(int32_t y) const;
+    int32_t chromaStep() const;
+
     // Convert the given YUV value to RGB.
     void yuv2rgb(uint8_t yValue, uint8_t uValue, uint8_t vValue,
         uint8_t *r, uint8_t *g, uint8_t *b) const;
@@ -33,6 +33,10 @@ public:
     uint32_t getBits(size_t n);
     void skipBits(size_t n);
 
+    // Exp-Golomb coded ue(v) and se(v) values, as found in H.264 and HEVC headers.
+    uint32_t getUE();
+    int32_t getSE();
+
     void putBits(uint32_t x, size_t n);
 
     size_t numBitsLeft() const;
@@ -43,11 +47,14 @@ protected:
     const uint8_t *mData;
     size_t mSize;
 
-    uint32_t mReservoir;  // left-aligned bits
+    uint64_t mReservoir;  // left-aligned bits
     size_t mNumBitsLeft;
 
     virtual void fillReservoir();
 
+    // Drops n bytes of input past the reservoir, which must be empty.
+    virtual void skipBytes(size_t n);
+
     DISALLOW_EVIL_CONSTRUCTORS(ABitReader);
 };
 
@@ -61,6 +68,7 @@ private:
     int32_t mNumZeros;
 
     virtual void fillReservoir();
+    virtual void skipBytes(size_t n);
 
     DISALLOW_EVIL_CONSTRUCTORS(NALBitReader);
 };
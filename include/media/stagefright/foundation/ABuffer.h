@@ -46,6 +46,12 @@ struct ABuffer : public RefBase {
     // create buffer from dup of some memory block
     static sp<ABuffer> CreateAsCopy(const void *data, size_t capacity);
 
+    // Creates a buffer that references [offset, offset + size) of the parent's current
+    // range, without copying. The slice keeps the parent alive, and has its own range,
+    // meta data and int32 data.
+    static sp<ABuffer> CreateSlice(
+            const sp<ABuffer> &parent, size_t offset, size_t size);
+
     void setInt32Data(int32_t data) { mInt32Data = data; }
     int32_t int32Data() const { return mInt32Data; }
 
@@ -63,6 +69,9 @@ private:
 
     MediaBufferBase *mMediaBufferBase;
 
+    // the buffer a slice points into, if any
+    sp<ABuffer> mParent;
+
     void *mData;
     size_t mCapacity;
     size_t mRangeOffset;
@@ -72,6 +81,9 @@ private:
 
     bool mOwnsData;
 
+    // size class of the pooled allocation backing mData, or -1 if malloc'ed
+    int32_t mPoolIndex;
+
     DISALLOW_EVIL_CONSTRUCTORS(ABuffer);
 };
 
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_CPU_ACCOUNTING_H_
+#define A_CPU_ACCOUNTING_H_
+
+#include <binder/IMemory.h>
+#include <cpustats/ThreadCpuUsage.h>
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// Opt-in accounting of the CPU time of the threads of a process to named components,
+// e.g. looper names, published in shared memory for media.log to dump.
+//
+// A thread is accounted while an ACpuAccounting constructed on it lives: it calls update()
+// once per cycle, which costs a clock read unless a period elapsed, and destroys the object
+// on the same thread before exiting, or the CPU time of its last period is lost.
+// All of this is a no-op unless enable() was called before the thread started.
+struct ACpuAccounting {
+    // Allocates the table of the process, if needed. Returns its memory, for
+    // IMediaLogService::registerCpuAccounting(), or NULL on failure.
+    static sp<IMemory> enable();
+    static bool isEnabled();
+
+    explicit ACpuAccounting(const char *component);
+    ~ACpuAccounting();
+
+    void update() {
+        if (mSlot >= 0 && systemTime(SYSTEM_TIME_MONOTONIC) - mLastNs >= kPeriodNs) {
+            publish(false /* exiting */);
+        }
+    }
+
+private:
+    static const nsecs_t kPeriodNs = 1000000000ll;
+
+    ssize_t mSlot;      // -1 if not accounted
+    pid_t mTid;
+    nsecs_t mLastNs;
+    ThreadCpuUsage mCpuUsage;
+
+    void publish(bool exiting);
+
+    DISALLOW_EVIL_CONSTRUCTORS(ACpuAccounting);
+};
+
+}  // namespace android
+
+#endif  // A_CPU_ACCOUNTING_H_
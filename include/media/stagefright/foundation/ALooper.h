@@ -24,6 +24,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -58,6 +59,10 @@ struct ALooper : public RefBase {
         return mName.c_str();
     }
 
+    // Returns the kernel thread id of the looper thread, or -1 if the looper is not
+    // running on a thread of its own.
+    pid_t getTid();
+
 protected:
     virtual ~ALooper();
 
@@ -66,7 +71,20 @@ private:
 
     struct Event {
         int64_t mWhenUs;
+        uint64_t mSeq;      // keeps events posted for the same time in posting order
         sp<AMessage> mMessage;
+
+        bool isBefore(const Event &other) const {
+            return mWhenUs < other.mWhenUs
+                    || (mWhenUs == other.mWhenUs && mSeq < other.mSeq);
+        }
+    };
+
+    // what to do with pending messages of the same what() for the same handler
+    enum PostMode {
+        POST_ALWAYS,        // nothing, queue the new message as well
+        POST_COALESCE,      // keep the pending message, and drop the new one
+        POST_REPLACE,       // remove the pending messages, and queue the new one
     };
 
     Mutex mLock;
@@ -74,7 +92,9 @@ private:
 
     AString mName;
 
-    List<Event> mEventQueue;
+    // binary min-heap of events ordered by time, the storage is reused between events
+    Vector<Event> mEventQueue;
+    uint64_t mEventSeq;
 
     struct LooperThread;
     sp<LooperThread> mThread;
@@ -88,7 +108,7 @@ private:
     // START --- methods used only by AMessage
 
     // posts a message on this looper with the given timeout
-    void post(const sp<AMessage> &msg, int64_t delayUs);
+    void post(const sp<AMessage> &msg, int64_t delayUs, PostMode mode = POST_ALWAYS);
 
     // creates a reply token to be used with this looper
     sp<AReplyToken> createReplyToken();
@@ -103,6 +123,12 @@ private:
 
     bool loop();
 
+    // heap maintenance, called with mLock held
+    void siftUp_l(size_t index);
+    void siftDown_l(size_t index);
+    void removeEvent_l(size_t index);
+    ssize_t findPendingEvent_l(const sp<AMessage> &msg) const;
+
     DISALLOW_EVIL_CONSTRUCTORS(ALooper);
 };
 
@@ -107,6 +107,14 @@ struct AMessage : public RefBase {
 
     status_t post(int64_t delayUs = 0);
 
+    // Like post(), but if a message with the same what() is already pending for the
+    // same handler, the pending message is kept and this one is dropped.
+    status_t postCoalesced(int64_t delayUs = 0);
+
+    // Like post(), but any message with the same what() pending for the same handler
+    // is removed from the queue first, so that only this one is delivered.
+    status_t postReplacing(int64_t delayUs = 0);
+
     // Posts the message to its target and waits for a response (or error)
     // before returning.
     status_t postAndAwaitResponse(sp<AMessage> *response);
@@ -146,12 +154,19 @@ struct AMessage : public RefBase {
     size_t countEntries() const;
     const char *getEntryNameAt(size_t index, Type *type) const;
 
+    // Messages are recycled through a small free list, as most are short lived and
+    // all have the same size.
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
 protected:
     virtual ~AMessage();
 
 private:
     friend struct ALooper; // deliver()
 
+    status_t post(int64_t delayUs, ALooper::PostMode mode);
+
     uint32_t mWhat;
 
     // used only for debugging
@@ -164,6 +179,11 @@ private:
         int32_t mLeft, mTop, mRight, mBottom;
     };
 
+    enum {
+        // strings up to this length are stored in the item itself
+        kMaxInlineStringLength = sizeof(Rect) - 1,
+    };
+
     struct Item {
         union {
             int32_t int32Value;
@@ -175,11 +195,29 @@ private:
             RefBase *refValue;
             AString *stringValue;
             Rect rectValue;
+            char inlineString[kMaxInlineStringLength + 1];
         } u;
+        // Names set through the setters are interned with AAtomizer, so they are never
+        // allocated per item and can be shared by dup(). Names read from a parcel are
+        // owned by the item instead, to not grow the atom table from untrusted input.
         const char *mName;
         size_t      mNameLength;
+        uint32_t    mNameHash;
         Type mType;
-        void setName(const char *name, size_t len);
+        uint8_t     mFlags;
+        uint8_t     mInlineStringLength;
+
+        enum {
+            kFlagNameOwned      = 1,
+            kFlagInlineString   = 2,
+        };
+
+        void setName(const char *name, size_t len, uint32_t hash);
+        void setOwnedName(const char *name, size_t len, uint32_t hash);
+        void freeName();
+        void setStringValue(const char *s, size_t len);
+        const char *stringData() const;
+        size_t stringSize() const;
     };
 
     enum {
@@ -195,7 +233,7 @@ private:
     void setObjectInternal(
             const char *name, const sp<RefBase> &obj, Type type);
 
-    size_t findItemIndex(const char *name, size_t len) const;
+    size_t findItemIndex(const char *name, size_t len, uint32_t hash) const;
 
     void deliver();
 
@@ -27,6 +27,7 @@
 
 namespace android {
 
+struct ABuffer;
 struct AMessage;
 
 // Helper class to manage a number of live sockets (datagram and stream-based)
@@ -77,8 +78,40 @@ struct ANetworkSession : public RefBase {
             int32_t sessionID, const void *data, ssize_t size = -1,
             bool timeValid = false, int64_t timeUs = -1ll);
 
+    // Queues "buffer" without copying its payload, the caller must not
+    // modify it afterwards. Not supported on WebSocket sessions.
+    status_t sendRequest(
+            int32_t sessionID, const sp<ABuffer> &buffer,
+            bool timeValid = false, int64_t timeUs = -1ll);
+
+    // Sends "header" followed by payloadSize bytes at payloadOffset in
+    // "payload" as one datagram (or record, in TCP datagram mode), gathered
+    // from both buffers at send time. Neither buffer is copied or modified,
+    // the caller must leave them untouched until sent.
+    status_t sendRequest(
+            int32_t sessionID,
+            const sp<ABuffer> &header,
+            const sp<ABuffer> &payload, size_t payloadOffset, size_t payloadSize,
+            bool timeValid = false, int64_t timeUs = -1ll);
+
     status_t switchToWebSocketMode(int32_t sessionID);
 
+    struct SessionStats {
+        size_t mQueuedFragments;
+        size_t mQueuedBytes;
+        size_t mMaxQueuedFragments;
+        int64_t mNumFragmentsSent;
+        int64_t mNumBytesSent;
+
+        // Time from sendRequest() until the fragment was fully handed
+        // to the kernel.
+        int64_t mLastSendLatencyUs;
+        int64_t mMaxSendLatencyUs;
+        int64_t mTotalSendLatencyUs;
+    };
+
+    status_t getSessionStats(int32_t sessionID, SessionStats *stats);
+
     enum NotificationReason {
         kWhatError,
         kWhatConnected,
@@ -103,6 +136,7 @@ private:
     int32_t mNextSessionID;
 
     int mPipeFd[2];
+    int mEpollFd;
 
     KeyedVector<int32_t, sp<Session> > mSessions;
 
@@ -125,6 +159,8 @@ private:
     void threadLoop();
     void interrupt();
 
+    void updatePollEvents_l(const sp<Session> &session);
+
     static status_t MakeSocketNonBlocking(int s);
 
     DISALLOW_EVIL_CONSTRUCTORS(ANetworkSession);
@@ -164,6 +164,105 @@ media_status_t AMediaCodec_releaseOutputBuffer(AMediaCodec*, size_t idx, bool re
 media_status_t AMediaCodec_releaseOutputBufferAtTime(
         AMediaCodec *mData, size_t idx, int64_t timestampNs);
 
+enum {
+    AMEDIACODEC_IMAGE_FORMAT_YUV_420_888 = 0x23
+};
+
+/**
+ * One plane of an AMediaCodecImage.
+ * data points at the top-left sample of the crop rectangle in the plane.
+ */
+struct AMediaCodecImagePlane {
+    uint8_t *data;
+    int32_t rowStride;      // in bytes, between the starts of two consecutive rows
+    int32_t pixelStride;    // in bytes, between two consecutive samples of a row
+};
+typedef struct AMediaCodecImagePlane AMediaCodecImagePlane;
+
+/**
+ * The layout of a raw video output buffer, without copying it.
+ * The planes are Y, U (Cb) and V (Cr). The chroma planes of AMEDIACODEC_IMAGE_FORMAT_YUV_420_888
+ * are subsampled by 2 in both directions and may be interleaved: in that case the two
+ * chroma planes overlap, and their pixelStride is 2.
+ */
+struct AMediaCodecImage {
+    int32_t format;
+    int32_t width;          // width of the crop rectangle
+    int32_t height;         // height of the crop rectangle
+    int32_t cropLeft;       // position of the crop rectangle in the decoded frame
+    int32_t cropTop;
+    int32_t numPlanes;
+    AMediaCodecImagePlane planes[3];
+};
+typedef struct AMediaCodecImage AMediaCodecImage;
+
+/**
+ * Describe the planes of a dequeued raw video output buffer. The plane pointers stay valid
+ * until the buffer is released. Fails with AMEDIA_ERROR_UNSUPPORTED if the codec does not
+ * output a flexible YUV 4:2:0 8-bit layout, e.g. when it is configured with a surface.
+ */
+media_status_t AMediaCodec_getOutputImage(AMediaCodec*, size_t idx, AMediaCodecImage *image);
+
+/**
+ * Called when an input buffer becomes available.
+ * The specified index is the index of the available input buffer.
+ */
+typedef void (*AMediaCodecOnAsyncInputAvailable)(
+        AMediaCodec *codec,
+        void *userdata,
+        int32_t index);
+/**
+ * Called when an output buffer becomes available.
+ * The specified index is the index of the available output buffer.
+ * The specified bufferInfo contains information regarding the available output buffer.
+ */
+typedef void (*AMediaCodecOnAsyncOutputAvailable)(
+        AMediaCodec *codec,
+        void *userdata,
+        int32_t index,
+        AMediaCodecBufferInfo *bufferInfo);
+/**
+ * Called when the output format has changed.
+ * The specified format contains the new output format, and is deleted after the call.
+ */
+typedef void (*AMediaCodecOnAsyncFormatChanged)(
+        AMediaCodec *codec,
+        void *userdata,
+        AMediaFormat *format);
+/**
+ * Called when the MediaCodec encountered an error.
+ * The specified actionCode indicates if the codec can be recovered.
+ * The specified detail may contain more detailed messages about this error, or NULL.
+ */
+typedef void (*AMediaCodecOnAsyncError)(
+        AMediaCodec *codec,
+        void *userdata,
+        media_status_t error,
+        int32_t actionCode,
+        const char *detail);
+
+struct AMediaCodecOnAsyncNotifyCallback {
+      AMediaCodecOnAsyncInputAvailable  onAsyncInputAvailable;
+      AMediaCodecOnAsyncOutputAvailable onAsyncOutputAvailable;
+      AMediaCodecOnAsyncFormatChanged   onAsyncFormatChanged;
+      AMediaCodecOnAsyncError           onAsyncError;
+};
+typedef struct AMediaCodecOnAsyncNotifyCallback AMediaCodecOnAsyncNotifyCallback;
+
+/**
+ * Set an asynchronous callback for actionable AMediaCodec events.
+ * When asynchronous callback is enabled, the client should not call
+ * AMediaCodec_dequeueInputBuffer() or AMediaCodec_dequeueOutputBuffer(), and
+ * AMediaCodec_flush() must be followed by AMediaCodec_start() to resume receiving
+ * input buffers.
+ * This must be called before AMediaCodec_configure(). The callbacks are called on an
+ * internal thread of the codec.
+ */
+media_status_t AMediaCodec_setAsyncNotifyCallback(
+        AMediaCodec*,
+        AMediaCodecOnAsyncNotifyCallback callback,
+        void *userdata);
+
 
 typedef enum {
     AMEDIACODECRYPTOINFO_MODE_CLEAR = 0,
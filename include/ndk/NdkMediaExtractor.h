@@ -153,6 +153,64 @@ PsshInfo* AMediaExtractor_getPsshInfo(AMediaExtractor*);
 AMediaCodecCryptoInfo *AMediaExtractor_getSampleCryptoInfo(AMediaExtractor *);
 
 
+/**
+ * Position and properties of one sample returned by the per-track read functions.
+ */
+typedef struct AMediaExtractorSampleInfo {
+    size_t offset;              // of the sample data in the buffer
+    size_t size;
+    int64_t presentationTimeUs;
+    uint32_t flags;             // see definitions below
+} AMediaExtractorSampleInfo;
+
+/**
+ * Per-track reading. Each selected track is read on its own, in decode order, independently
+ * of the other tracks: different tracks may be read at the same time from different threads.
+ * This does not move the interleaved position of AMediaExtractor_advance() and
+ * AMediaExtractor_readSampleData(), which must not be used on a track read this way.
+ */
+
+/**
+ * Reads up to maxSamples consecutive samples of the selected track trackIdx, back to back
+ * into buffer, and describes them in info[]. A sample that does not fit in the remaining
+ * capacity is returned by the next call.
+ * Returns the number of samples read, 0 at end of stream, or a negative media_status_t;
+ * AMEDIA_ERROR_INVALID_PARAMETER if not even the first sample fits.
+ */
+ssize_t AMediaExtractor_readTrackSamples(AMediaExtractor*, size_t trackIdx,
+        uint8_t *buffer, size_t capacity, AMediaExtractorSampleInfo *info, size_t maxSamples);
+
+/**
+ * Makes the next read of the selected track trackIdx start at seekPosUs. Buffers queued
+ * before this call may contain samples from before or after the seek, dequeue them first.
+ */
+media_status_t AMediaExtractor_seekTrackTo(AMediaExtractor*, size_t trackIdx,
+        int64_t seekPosUs, SeekMode mode);
+
+/**
+ * Queues buffer to be filled ahead of time, as by AMediaExtractor_readTrackSamples(), by a
+ * pool of reader threads shared by all the extractors of the process. buffer and info must
+ * remain valid until returned by AMediaExtractor_dequeueTrackBuffer(). The buffers of a
+ * track are filled and returned in the order they were queued.
+ */
+media_status_t AMediaExtractor_queueTrackBuffer(AMediaExtractor*, size_t trackIdx,
+        uint8_t *buffer, size_t capacity, AMediaExtractorSampleInfo *info, size_t maxSamples);
+
+/**
+ * Waits up to timeoutUs (forever if negative) for the oldest buffer queued on track trackIdx
+ * to be filled, and returns it in *buffer and *info.
+ * Returns what AMediaExtractor_readTrackSamples() would have returned for that buffer,
+ * AMEDIAEXTRACTOR_INFO_TRY_AGAIN_LATER if it is not filled yet, or
+ * AMEDIA_ERROR_INVALID_PARAMETER if no buffer is queued on the track.
+ */
+ssize_t AMediaExtractor_dequeueTrackBuffer(AMediaExtractor*, size_t trackIdx,
+        int64_t timeoutUs, uint8_t **buffer, AMediaExtractorSampleInfo **info);
+
+enum {
+    AMEDIAEXTRACTOR_INFO_TRY_AGAIN_LATER = -1,
+};
+
+
 enum {
     AMEDIAEXTRACTOR_SAMPLE_FLAG_SYNC = 1,
     AMEDIAEXTRACTOR_SAMPLE_FLAG_ENCRYPTED = 2,
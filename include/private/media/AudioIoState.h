@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_IO_STATE_H
+#define ANDROID_AUDIO_IO_STATE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <system/audio.h>
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+// The state of one output stream published by its PlaybackThread.
+struct AudioIoStateData {
+    audio_io_handle_t   mIoHandle;      // AUDIO_IO_HANDLE_NONE if the slot is unused
+    uint32_t            mSampleRate;
+    uint32_t            mFrameCount;    // normal mix frame count, as AudioSystem::getFrameCount()
+    uint32_t            mLatencyMs;
+    int32_t             mRenderStatus;  // status of the render position below
+    uint32_t            mHalFrames;     // frames written to the HAL
+    uint32_t            mDspFrames;     // frames rendered by the DSP, as reported by the HAL
+    uint32_t            mReserved;
+    int64_t             mRenderTimeNs;  // CLOCK_MONOTONIC time of the render position, 0 if none
+    int64_t             mPeriodNs;      // nominal time between two render position updates
+};
+
+// One slot of the AudioIoStateTable, updated by a single writer in mediaserver and read
+// by any number of client processes through a read-only mapping.
+// The writer makes mSequence odd while it updates mData, and readers retry until they
+// copied mData between two reads of the same even sequence number.
+class AudioIoState {
+public:
+    static const int kMaxReadRetries = 8;
+
+    void init() {
+        atomic_init(&mSequence, 0u);
+        mData.mIoHandle = AUDIO_IO_HANDLE_NONE;
+        mData.mRenderTimeNs = 0;
+    }
+
+    // Writer API, called only by the owner of the slot, or by its allocator when the
+    // slot has no owner.
+    void write(const AudioIoStateData& data) {
+        const uint32_t sequence = atomic_load_explicit(&mSequence, memory_order_relaxed);
+        atomic_store_explicit(&mSequence, sequence + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        mData = data;
+        atomic_store_explicit(&mSequence, sequence + 2, memory_order_release);
+    }
+
+    // Reader API. Returns false if no consistent copy could be made, which only happens
+    // if the writer is updating the slot continuously.
+    bool read(AudioIoStateData *data) const {
+        for (int i = 0; i < kMaxReadRetries; i++) {
+            const uint32_t before = atomic_load_explicit(&mSequence, memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            *data = mData;
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&mSequence, memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    mutable atomic_uint_least32_t   mSequence;
+    AudioIoStateData                mData;
+};
+
+// The shared memory block holding the state of all outputs, see IAudioFlinger::getIoState().
+struct AudioIoStateTable {
+    static const size_t kNumSlots = 32;
+
+    void init() {
+        for (size_t i = 0; i < kNumSlots; i++) {
+            mSlots[i].init();
+        }
+    }
+
+    // Copies the state of ioHandle into data. Returns false if ioHandle has no slot.
+    bool read(audio_io_handle_t ioHandle, AudioIoStateData *data) const {
+        if (ioHandle == AUDIO_IO_HANDLE_NONE) {
+            return false;
+        }
+        for (size_t i = 0; i < kNumSlots; i++) {
+            if (mSlots[i].read(data) && data->mIoHandle == ioHandle) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    AudioIoState    mSlots[kNumSlots];
+};
+
+// ----------------------------------------------------------------------------
+
+}; // namespace android
+
+#endif // ANDROID_AUDIO_IO_STATE_H
@@ -26,6 +26,7 @@
 #include <utils/RefBase.h>
 #include <audio_utils/roundup.h>
 #include <media/AudioResamplerPublic.h>
+#include <media/AudioTimestamp.h>
 #include <media/SingleStateQueue.h>
 
 namespace android {
@@ -116,6 +117,9 @@ struct AudioTrackSharedStatic {
 
 typedef SingleStateQueue<AudioPlaybackRate> PlaybackRateQueue;
 
+// Presentation timestamps of a mixed AudioTrack, published by the server once per mix cycle.
+typedef SingleStateQueue<AudioTimestamp> TimestampQueue;
+
 // ----------------------------------------------------------------------------
 
 // Important: do not add any virtual methods, including ~
@@ -183,6 +187,9 @@ public:
                 } u;
 
                 // Cache line boundary (32 bytes)
+
+                // AudioTrack only: server write-only, client read-only
+                TimestampQueue::Shared mTimestampQueue;
 };
 
 // ----------------------------------------------------------------------------
@@ -319,7 +326,9 @@ public:
             size_t frameSize, bool clientInServer = false)
         : ClientProxy(cblk, buffers, frameCount, frameSize, true /*isOut*/,
           clientInServer),
-          mPlaybackRateMutator(&cblk->mPlaybackRateQueue) { }
+          mPlaybackRateMutator(&cblk->mPlaybackRateQueue),
+          mTimestampObserver(&cblk->mTimestampQueue),
+          mTimestampValid(false) { }
     virtual ~AudioTrackClientProxy() { }
 
     // No barriers on the following operations, so the ordering of loads/stores
@@ -355,8 +364,22 @@ public:
 
     status_t    waitStreamEndDone(const struct timespec *requested);
 
+    // Returns true and the latest timestamp published by the server, or false if none was
+    // published since the proxy was created or since the last clearTimestamp().
+    bool        getTimestamp(AudioTimestamp *timestamp);
+
+    // Discards the published timestamp, including one not yet observed, e.g. on start() where
+    // it may predate a stop or flush.
+    void        clearTimestamp() {
+        (void) mTimestampObserver.poll(mTimestamp);
+        mTimestampValid = false;
+    }
+
 private:
     PlaybackRateQueue::Mutator   mPlaybackRateMutator;
+    TimestampQueue::Observer     mTimestampObserver;
+    AudioTimestamp               mTimestamp;        // last observed timestamp
+    bool                         mTimestampValid;   // mTimestamp was published after last clear
 };
 
 class StaticAudioTrackClientProxy : public AudioTrackClientProxy {
@@ -472,7 +495,8 @@ public:
     AudioTrackServerProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount,
             size_t frameSize, bool clientInServer = false, uint32_t sampleRate = 0)
         : ServerProxy(cblk, buffers, frameCount, frameSize, true /*isOut*/, clientInServer),
-          mPlaybackRateObserver(&cblk->mPlaybackRateQueue) {
+          mPlaybackRateObserver(&cblk->mPlaybackRateQueue),
+          mTimestampMutator(&cblk->mTimestampQueue) {
         mCblk->mSampleRate = sampleRate;
         mPlaybackRate = AUDIO_PLAYBACK_RATE_DEFAULT;
     }
@@ -512,9 +536,15 @@ public:
     // Return the playback speed and pitch read atomically. Not multi-thread safe on server side.
     AudioPlaybackRate getPlaybackRate();
 
+    // Publish the presentation timestamp to the client. Not multi-thread safe on server side.
+    void        setTimestamp(const AudioTimestamp& timestamp) {
+        mTimestampMutator.push(timestamp);
+    }
+
 private:
     AudioPlaybackRate             mPlaybackRate;  // last observed playback rate
     PlaybackRateQueue::Observer   mPlaybackRateObserver;
+    TimestampQueue::Mutator       mTimestampMutator;
 };
 
 class StaticAudioTrackServerProxy : public AudioTrackServerProxy {
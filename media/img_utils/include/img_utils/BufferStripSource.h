@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMG_UTILS_BUFFER_STRIP_SOURCE_H
+#define IMG_UTILS_BUFFER_STRIP_SOURCE_H
+
+#include <img_utils/Output.h>
+#include <img_utils/StripSource.h>
+
+#include <cutils/compiler.h>
+#include <utils/Errors.h>
+
+#include <stdint.h>
+
+namespace android {
+namespace img_utils {
+
+/**
+ * StripSource for an image already in memory, such as a locked RAW16 gralloc
+ * buffer.  Rows are passed to the Output directly from the image buffer: when
+ * the row stride equals the row size the whole image is written with a single
+ * call, which an FdOutput writes without copying.
+ *
+ * Pixel bytes are written as-is, so the image must already be in the
+ * endianness of the TiffWriter output.  The buffer must stay valid until the
+ * TiffWriter has finished writing.
+ */
+class ANDROID_API BufferStripSource : public StripSource {
+    public:
+        /**
+         * Create a source for an image of the given width and height in pixels,
+         * with the given bytes per pixel and row stride in bytes.
+         */
+        BufferStripSource(uint32_t ifd, const uint8_t* pixels, uint32_t width,
+                uint32_t height, uint32_t bytesPerPixel, uint32_t rowStride);
+        virtual ~BufferStripSource();
+
+        /**
+         * Write count bytes to the stream, which must be exactly the image size.
+         *
+         * Returns OK on success, or a negative error code.
+         */
+        virtual status_t writeToStream(Output& stream, uint32_t count);
+
+        /**
+         * Return the source IFD.
+         */
+        virtual uint32_t getIfd() const;
+
+    private:
+        uint32_t mIfd;
+        const uint8_t* mPixels;
+        uint32_t mWidth;
+        uint32_t mHeight;
+        uint32_t mBytesPerPixel;
+        uint32_t mRowStride;
+};
+
+} /*namespace img_utils*/
+} /*namespace android*/
+
+#endif /*IMG_UTILS_BUFFER_STRIP_SOURCE_H*/
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMG_UTILS_FD_OUTPUT_H
+#define IMG_UTILS_FD_OUTPUT_H
+
+#include <img_utils/Output.h>
+#include <cutils/compiler.h>
+#include <utils/Errors.h>
+#include <stdint.h>
+
+namespace android {
+namespace img_utils {
+
+/**
+ * Utility class that writes to an already opened file descriptor.
+ *
+ * Small writes, such as the IFD entries of a TiffWriter, are collected in an
+ * aligned staging buffer.  Writes at least as large as the staging buffer, such
+ * as image strips, are not copied: they are written directly from the caller's
+ * memory together with any staged bytes in a single writev() call.  Bytes are
+ * always written sequentially, so the file descriptor may be a pipe or socket.
+ *
+ * The file descriptor is not owned, and is not closed by close().
+ */
+class ANDROID_API FdOutput : public Output {
+    public:
+        static const size_t kDefaultBufferSize = 64 * 1024;
+
+        explicit FdOutput(int fd, size_t bufferSize = kDefaultBufferSize);
+        virtual ~FdOutput();
+
+        /**
+         * Open this FdOutput, allocating the staging buffer.
+         *
+         * Returns OK on success, or a negative error code.
+         */
+        virtual status_t open();
+
+        /**
+         * Write bytes from the given buffer.  The number of bytes given in the count
+         * argument will be written.  Bytes will be written from the given buffer starting
+         * at the index given in the offset argument.
+         *
+         * Returns OK on success, or a negative error code.
+         */
+        virtual status_t write(const uint8_t* buf, size_t offset, size_t count);
+
+        /**
+         * Write any staged bytes to the file descriptor.
+         *
+         * Returns OK on success, or a negative error code.
+         */
+        virtual status_t flush();
+
+        /**
+         * Flush and close this FdOutput.  The file descriptor is left open.
+         *
+         * Returns OK on success, or a negative error code.
+         */
+        virtual status_t close();
+
+    private:
+        // Write the staged bytes followed by count bytes of buf, retrying short writes.
+        status_t writeFully(const uint8_t* buf, size_t count);
+
+        int mFd;
+        size_t mBufferSize;
+        uint8_t* mBuffer;
+        size_t mBuffered;
+        bool mOpen;
+};
+
+} /*namespace img_utils*/
+} /*namespace android*/
+
+#endif /*IMG_UTILS_FD_OUTPUT_H*/
@@ -20,6 +20,7 @@ LOCAL_SRC_FILES := \
   EndianUtils.cpp \
   FileInput.cpp \
   FileOutput.cpp \
+  FdOutput.cpp \
   SortedEntryVector.cpp \
   Input.cpp \
   Output.cpp \
@@ -32,6 +33,7 @@ LOCAL_SRC_FILES := \
   ByteArrayOutput.cpp \
   DngUtils.cpp \
   StripSource.cpp \
+  BufferStripSource.cpp \
 
 LOCAL_SHARED_LIBRARIES := \
   libexpat \
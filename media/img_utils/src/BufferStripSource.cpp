@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <img_utils/BufferStripSource.h>
+
+#include <utils/Log.h>
+
+#include <inttypes.h>
+
+namespace android {
+namespace img_utils {
+
+BufferStripSource::BufferStripSource(uint32_t ifd, const uint8_t* pixels, uint32_t width,
+        uint32_t height, uint32_t bytesPerPixel, uint32_t rowStride) : mIfd(ifd),
+        mPixels(pixels), mWidth(width), mHeight(height), mBytesPerPixel(bytesPerPixel),
+        mRowStride(rowStride) {}
+
+BufferStripSource::~BufferStripSource() {}
+
+status_t BufferStripSource::writeToStream(Output& stream, uint32_t count) {
+    uint64_t rowSize = static_cast<uint64_t>(mWidth) * mBytesPerPixel;
+    uint64_t fullSize = rowSize * mHeight;
+    if (fullSize != count) {
+        ALOGE("%s: Strip size %u does not match image size %" PRIu64 ".", __FUNCTION__,
+                count, fullSize);
+        return BAD_VALUE;
+    }
+    if (mPixels == NULL || mRowStride < rowSize) {
+        ALOGE("%s: Invalid pixel buffer, row stride %u, row size %" PRIu64 ".", __FUNCTION__,
+                mRowStride, rowSize);
+        return BAD_VALUE;
+    }
+
+    if (mRowStride == rowSize) {
+        return stream.write(mPixels, 0, count);
+    }
+
+    status_t res = OK;
+    for (uint32_t row = 0; row < mHeight; ++row) {
+        if ((res = stream.write(mPixels, static_cast<size_t>(row) * mRowStride,
+                static_cast<size_t>(rowSize))) != OK) {
+            ALOGE("%s: Could not write row %u, received %d.", __FUNCTION__, row, res);
+            return res;
+        }
+    }
+    return OK;
+}
+
+uint32_t BufferStripSource::getIfd() const {
+    return mIfd;
+}
+
+} /*namespace img_utils*/
+} /*namespace android*/
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <img_utils/FdOutput.h>
+
+#include <utils/Log.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+namespace android {
+namespace img_utils {
+
+// Matches the page size, so that the staged writes are page aligned in memory.
+static const size_t kBufferAlignment = 4096;
+
+FdOutput::FdOutput(int fd, size_t bufferSize) : mFd(fd), mBufferSize(bufferSize),
+        mBuffer(NULL), mBuffered(0), mOpen(false) {}
+
+FdOutput::~FdOutput() {
+    if (mOpen) {
+        ALOGW("%s: Destructor called with fd %d still open.", __FUNCTION__, mFd);
+        close();
+    }
+}
+
+status_t FdOutput::open() {
+    if (mOpen) {
+        ALOGW("%s: Open called when fd %d already open.", __FUNCTION__, mFd);
+        return OK;
+    }
+    if (mFd < 0 || mBufferSize == 0) {
+        ALOGE("%s: Invalid fd %d or buffer size %zu.", __FUNCTION__, mFd, mBufferSize);
+        return BAD_VALUE;
+    }
+    void* buffer = NULL;
+    if (posix_memalign(&buffer, kBufferAlignment, mBufferSize) != 0) {
+        ALOGE("%s: Could not allocate %zu byte staging buffer.", __FUNCTION__, mBufferSize);
+        return NO_MEMORY;
+    }
+    mBuffer = static_cast<uint8_t*>(buffer);
+    mBuffered = 0;
+    mOpen = true;
+    return OK;
+}
+
+status_t FdOutput::write(const uint8_t* buf, size_t offset, size_t count) {
+    if (!mOpen) {
+        ALOGE("%s: Could not write fd %d, not open.", __FUNCTION__, mFd);
+        return BAD_VALUE;
+    }
+
+    if (mBuffered + count <= mBufferSize) {
+        memcpy(mBuffer + mBuffered, buf + offset, count);
+        mBuffered += count;
+        if (mBuffered < mBufferSize) {
+            return OK;
+        }
+        return writeFully(NULL, 0);
+    }
+
+    if (count < mBufferSize) {
+        // Top up the staging buffer, so that the data written stays in large chunks.
+        size_t fill = mBufferSize - mBuffered;
+        memcpy(mBuffer + mBuffered, buf + offset, fill);
+        mBuffered = mBufferSize;
+        status_t res = writeFully(NULL, 0);
+        if (res != OK) {
+            return res;
+        }
+        memcpy(mBuffer, buf + offset + fill, count - fill);
+        mBuffered = count - fill;
+        return OK;
+    }
+
+    return writeFully(buf + offset, count);
+}
+
+status_t FdOutput::flush() {
+    if (!mOpen) {
+        ALOGE("%s: Could not flush fd %d, not open.", __FUNCTION__, mFd);
+        return BAD_VALUE;
+    }
+    return writeFully(NULL, 0);
+}
+
+status_t FdOutput::writeFully(const uint8_t* buf, size_t count) {
+    struct iovec iov[2];
+    int iovCount = 0;
+    if (mBuffered > 0) {
+        iov[iovCount].iov_base = mBuffer;
+        iov[iovCount].iov_len = mBuffered;
+        ++iovCount;
+    }
+    if (count > 0) {
+        iov[iovCount].iov_base = const_cast<uint8_t*>(buf);
+        iov[iovCount].iov_len = count;
+        ++iovCount;
+    }
+
+    struct iovec* next = iov;
+    while (iovCount > 0) {
+        ssize_t written = ::writev(mFd, next, iovCount);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("%s: Error %s (%d) while writing fd %d.", __FUNCTION__, strerror(errno),
+                    errno, mFd);
+            return BAD_VALUE;
+        }
+        size_t remaining = static_cast<size_t>(written);
+        while (iovCount > 0 && remaining >= next->iov_len) {
+            remaining -= next->iov_len;
+            ++next;
+            --iovCount;
+        }
+        if (iovCount > 0) {
+            next->iov_base = static_cast<uint8_t*>(next->iov_base) + remaining;
+            next->iov_len -= remaining;
+        }
+    }
+    mBuffered = 0;
+    return OK;
+}
+
+status_t FdOutput::close() {
+    if (!mOpen) {
+        ALOGW("%s: Close called when fd %d already closed.", __FUNCTION__, mFd);
+        return OK;
+    }
+    status_t ret = writeFully(NULL, 0);
+    free(mBuffer);
+    mBuffer = NULL;
+    mOpen = false;
+    return ret;
+}
+
+} /*namespace img_utils*/
+} /*namespace android*/
@@ -55,7 +55,7 @@ struct AVMediaServiceFactory {
 
     // RTSP extensions
     virtual sp<ARTSPConnection> createARTSPConnection(bool uidValid, uid_t uid);
-    virtual sp<ARTPConnection> createARTPConnection();
+    virtual sp<ARTPConnection> createARTPConnection(uint32_t flags = 0);
 
     // ----- NO TRESSPASSING BEYOND THIS LINE ------
     DECLARE_LOADABLE_SINGLETON(AVMediaServiceFactory);
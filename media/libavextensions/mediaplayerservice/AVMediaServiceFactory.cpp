@@ -53,8 +53,9 @@ sp<ARTSPConnection> AVMediaServiceFactory::createARTSPConnection(
     return new ARTSPConnection(uidValid, uid);
 }
 
-sp<ARTPConnection> AVMediaServiceFactory::createARTPConnection() {
-    return new ARTPConnection();
+sp<ARTPConnection> AVMediaServiceFactory::createARTPConnection(
+        uint32_t flags) {
+    return new ARTPConnection(flags);
 }
 
 // ----- NO TRESSPASSING BEYOND THIS LINE ------
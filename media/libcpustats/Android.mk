@@ -4,6 +4,7 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES :=     \
         CentralTendencyStatistics.cpp \
+        CpuAccountingTable.cpp \
         ThreadCpuUsage.cpp
 
 LOCAL_MODULE := libcpustats
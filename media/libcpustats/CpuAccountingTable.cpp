@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CpuAccountingTable"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <utils/Log.h>
+
+#include <cpustats/CpuAccountingTable.h>
+
+namespace android {
+
+void CpuAccountingTable::init()
+{
+    mMagic = kMagic;
+    mNumSlots = kNumSlots;
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        mStartNs = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    } else {
+        mStartNs = 0;
+    }
+    for (size_t i = 0; i < kNumSlots; i++) {
+        mSlots[i].init();
+    }
+}
+
+ssize_t CpuAccountingTable::getSlot(const char *name)
+{
+    for (size_t i = 0; i < kNumSlots; i++) {
+        const CpuAccountingData& data = mSlots[i].data();
+        if (data.mName[0] == '\0') {
+            // slots are never freed, so the first unused one ends the search
+            CpuAccountingData *newData = mSlots[i].beginWrite();
+            strncpy(newData->mName, name, sizeof(newData->mName) - 1);
+            newData->mName[sizeof(newData->mName) - 1] = '\0';
+            mSlots[i].endWrite();
+            return i;
+        }
+        if (strncmp(data.mName, name, sizeof(data.mName) - 1) == 0) {
+            return i;
+        }
+    }
+    ALOGW("no slot left for %s", name);
+    return -1;
+}
+
+void CpuAccountingTable::dump(int fd, int indent) const
+{
+    CpuAccountingData data[kNumSlots];
+    size_t count = 0;
+    int64_t cpuNs = 0;
+    for (size_t i = 0; i < kNumSlots; i++) {
+        if (mSlots[i].read(&data[count]) && data[count].mName[0] != '\0') {
+            data[count].mName[sizeof(data[count].mName) - 1] = '\0';
+            cpuNs += data[count].mCpuNs;
+            count++;
+        }
+    }
+
+    // by decreasing CPU time, insertion sort is fine for so few components
+    for (size_t i = 1; i < count; i++) {
+        for (size_t j = i; j > 0 && data[j].mCpuNs > data[j - 1].mCpuNs; j--) {
+            CpuAccountingData tmp = data[j];
+            data[j] = data[j - 1];
+            data[j - 1] = tmp;
+        }
+    }
+
+    int64_t elapsedNs = 0;
+    struct timespec ts;
+    if (mStartNs > 0 && clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        elapsedNs = ts.tv_sec * 1000000000LL + ts.tv_nsec - mStartNs;
+    }
+    dprintf(fd, "%*sCPU accounting over %.1f s, %.1f s of CPU (%.1f%% of one CPU):\n",
+            indent, "", elapsedNs * 1e-9, cpuNs * 1e-9,
+            elapsedNs > 0 ? cpuNs * 100.0 / elapsedNs : 0.0);
+    dprintf(fd, "%*s%-31s %7s %10s %10s %6s %6s %6s %6s\n", indent, "",
+            "component", "threads", "cpu ms", "wall ms", "load%", "mean%", "sd%", "max%");
+    for (size_t i = 0; i < count; i++) {
+        const CpuAccountingData& d = data[i];
+        const CentralTendencyStatistics& load = d.mLoad;
+        dprintf(fd, "%*s%-31s %3d/%-3d %10.1f %10.1f %6.1f %6.1f %6.1f %6.1f\n", indent, "",
+                d.mName, d.mThreads, d.mThreadsTotal, d.mCpuNs * 1e-6, d.mWallNs * 1e-6,
+                d.mWallNs > 0 ? d.mCpuNs * 100.0 / d.mWallNs : 0.0,
+                load.n() > 0 ? load.mean() * 100 : 0.0,
+                load.n() > 1 ? load.stddev() * 100 : 0.0,
+                load.n() > 0 ? load.maximum() * 100 : 0.0);
+    }
+}
+
+}   // namespace android
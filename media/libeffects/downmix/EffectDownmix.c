@@ -22,11 +22,13 @@
 #include <string.h>
 #include <stdbool.h>
 #include "EffectDownmix.h"
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DOWNMIX_NEON
+#endif
 
 // Do not submit with DOWNMIX_TEST_CHANNEL_INDEX defined, strictly for testing
 //#define DOWNMIX_TEST_CHANNEL_INDEX 0
-// Do not submit with DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER defined, strictly for testing
-//#define DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER 0
 
 #define MINUS_3_DB_IN_Q19_12 2896 // -3dB = 0.707 * 2^12 = 2896
 
@@ -85,8 +87,7 @@ const int kNbEffects = sizeof(gDescriptors) / sizeof(const effect_descriptor_t *
  * Test code
  *--------------------------------------------------------------------------*/
 #ifdef DOWNMIX_TEST_CHANNEL_INDEX
-// strictly for testing, logs the indices of the channels for a given mask,
-// uses the same code as Downmix_foldGeneric()
+// strictly for testing, logs the indices of the channels for a given mask
 void Downmix_testIndexComputation(uint32_t mask) {
     ALOGI("Testing index computation for 0x%" PRIx32 ":", mask);
     // check against unsupported channels
@@ -288,7 +289,6 @@ static int Downmix_Process(effect_handle_t self,
 
     const bool accumulate =
             (pDwmModule->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE);
-    const uint32_t downmixInputChannelMask = pDwmModule->config.inputCfg.channels;
 
     switch(pDownmixer->type) {
 
@@ -313,36 +313,8 @@ static int Downmix_Process(effect_handle_t self,
           break;
 
       case DOWNMIX_TYPE_FOLD:
-#ifdef DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER
-          // bypass the optimized downmix routines for the common formats
-          if (!Downmix_foldGeneric(
-                  downmixInputChannelMask, pSrc, pDst, numFrames, accumulate)) {
-              ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported", downmixInputChannelMask);
-              return -EINVAL;
-          }
-          break;
-#endif
-        // optimize for the common formats
-        switch((downmix_input_channel_mask_t)downmixInputChannelMask) {
-        case CHANNEL_MASK_QUAD_BACK:
-        case CHANNEL_MASK_QUAD_SIDE:
-            Downmix_foldFromQuad(pSrc, pDst, numFrames, accumulate);
-            break;
-        case CHANNEL_MASK_5POINT1_BACK:
-        case CHANNEL_MASK_5POINT1_SIDE:
-            Downmix_foldFrom5Point1(pSrc, pDst, numFrames, accumulate);
-            break;
-        case CHANNEL_MASK_7POINT1:
-            Downmix_foldFrom7Point1(pSrc, pDst, numFrames, accumulate);
-            break;
-        default:
-            if (!Downmix_foldGeneric(
-                    downmixInputChannelMask, pSrc, pDst, numFrames, accumulate)) {
-                ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported", downmixInputChannelMask);
-                return -EINVAL;
-            }
-            break;
-        }
+        // the coefficients are computed for the input channel mask by Downmix_Configure()
+        Downmix_foldMatrix(&pDownmixer->matrix, pSrc, pDst, numFrames, accumulate);
         break;
 
       default:
@@ -625,9 +597,7 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
         pDownmixer->input_channel_count = 8; // matches default input of AUDIO_CHANNEL_OUT_7POINT1
     } else {
         // when configuring the effect, do not allow a blank or unsupported channel mask
-        if ((pConfig->inputCfg.channels == 0) ||
-            (Downmix_foldGeneric(pConfig->inputCfg.channels,
-                                NULL, NULL, 0, false) == false)) {
+        if (Downmix_computeMatrix(pConfig->inputCfg.channels, NULL) == false) {
             ALOGE("Downmix_Configure error: input channel mask(0x%x) not supported",
                                                         pConfig->inputCfg.channels);
             return -EINVAL;
@@ -635,6 +605,7 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
         pDownmixer->input_channel_count =
                 audio_channel_count_from_out_mask(pConfig->inputCfg.channels);
     }
+    Downmix_computeMatrix(pDwmModule->config.inputCfg.channels, &pDownmixer->matrix);
 
     Downmix_Reset(pDownmixer, init);
 
@@ -771,193 +742,79 @@ int Downmix_getParameter(downmix_object_t *pDownmixer, int32_t param, uint32_t *
 
 
 /*----------------------------------------------------------------------------
- * Downmix_foldFromQuad()
+ * Downmix_computeMatrix()
  *----------------------------------------------------------------------------
  * Purpose:
- * downmix a quad signal to stereo
+ * compute the coefficients used to downmix to stereo a multichannel signal with the given
+ * positional channel mask:
+ *  - FL/FR, BL/BR, SL/SR, FLC/FRC are mixed in the same side at unity gain
+ *  - all top channels, and FC, LFE, BC are mixed at -3dB, in both sides if centered
+ * For the layouts previously handled by dedicated code, this gives bit-exact results.
  *
  * Inputs:
- *  pSrc       quad audio samples to downmix
- *  numFrames  the number of quad frames to downmix
- *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
- *               or overwrite pDst (when false)
+ *  mask       the channel mask of the signal to downmix
  *
  * Outputs:
- *  pDst       downmixed stereo audio samples
+ *  pMatrix    the downmix coefficients, in channel order
  *
- *----------------------------------------------------------------------------
- */
-void Downmix_foldFromQuad(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate) {
-    // sample at index 0 is FL
-    // sample at index 1 is FR
-    // sample at index 2 is RL
-    // sample at index 3 is RR
-    if (accumulate) {
-        while (numFrames) {
-            // FL + RL
-            pDst[0] = clamp16(pDst[0] + ((pSrc[0] + pSrc[2]) >> 1));
-            // FR + RR
-            pDst[1] = clamp16(pDst[1] + ((pSrc[1] + pSrc[3]) >> 1));
-            pSrc += 4;
-            pDst += 2;
-            numFrames--;
-        }
-    } else { // same code as above but without adding and clamping pDst[i] to itself
-        while (numFrames) {
-            // FL + RL
-            pDst[0] = clamp16((pSrc[0] + pSrc[2]) >> 1);
-            // FR + RR
-            pDst[1] = clamp16((pSrc[1] + pSrc[3]) >> 1);
-            pSrc += 4;
-            pDst += 2;
-            numFrames--;
-        }
-    }
-}
-
-
-/*----------------------------------------------------------------------------
- * Downmix_foldFrom5Point1()
- *----------------------------------------------------------------------------
- * Purpose:
- * downmix a 5.1 signal to stereo
- *
- * Inputs:
- *  pSrc       5.1 audio samples to downmix
- *  numFrames  the number of 5.1 frames to downmix
- *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
- *               or overwrite pDst (when false)
- *
- * Outputs:
- *  pDst       downmixed stereo audio samples
+ * Returns: false if the channel mask is not supported
  *
  *----------------------------------------------------------------------------
  */
-void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate) {
-    int32_t lt, rt, centerPlusLfeContrib; // samples in Q19.12 format
-    // sample at index 0 is FL
-    // sample at index 1 is FR
-    // sample at index 2 is FC
-    // sample at index 3 is LFE
-    // sample at index 4 is RL
-    // sample at index 5 is RR
-    // code is mostly duplicated between the two values of accumulate to avoid repeating the test
-    // for every sample
-    if (accumulate) {
-        while (numFrames) {
-            // centerPlusLfeContrib = FC(-3dB) + LFE(-3dB)
-            centerPlusLfeContrib = (pSrc[2] * MINUS_3_DB_IN_Q19_12)
-                    + (pSrc[3] * MINUS_3_DB_IN_Q19_12);
-            // FL + centerPlusLfeContrib + RL
-            lt = (pSrc[0] << 12) + centerPlusLfeContrib + (pSrc[4] << 12);
-            // FR + centerPlusLfeContrib + RR
-            rt = (pSrc[1] << 12) + centerPlusLfeContrib + (pSrc[5] << 12);
-            // accumulate in destination
-            pDst[0] = clamp16(pDst[0] + (lt >> 13));
-            pDst[1] = clamp16(pDst[1] + (rt >> 13));
-            pSrc += 6;
-            pDst += 2;
-            numFrames--;
-        }
-    } else { // same code as above but without adding and clamping pDst[i] to itself
-        while (numFrames) {
-            // centerPlusLfeContrib = FC(-3dB) + LFE(-3dB)
-            centerPlusLfeContrib = (pSrc[2] * MINUS_3_DB_IN_Q19_12)
-                    + (pSrc[3] * MINUS_3_DB_IN_Q19_12);
-            // FL + centerPlusLfeContrib + RL
-            lt = (pSrc[0] << 12) + centerPlusLfeContrib + (pSrc[4] << 12);
-            // FR + centerPlusLfeContrib + RR
-            rt = (pSrc[1] << 12) + centerPlusLfeContrib + (pSrc[5] << 12);
-            // store in destination
-            pDst[0] = clamp16(lt >> 13); // differs from when accumulate is true above
-            pDst[1] = clamp16(rt >> 13); // differs from when accumulate is true above
-            pSrc += 6;
-            pDst += 2;
-            numFrames--;
-        }
+bool Downmix_computeMatrix(uint32_t mask, downmix_matrix_t *pMatrix) {
+    // gain in Q19.12 (left, right) of each channel, in the order of the channel mask bits
+    static const int16_t kGains[][2] = {
+        { 1 << 12, 0 },                                         // FRONT_LEFT
+        { 0, 1 << 12 },                                         // FRONT_RIGHT
+        { MINUS_3_DB_IN_Q19_12, MINUS_3_DB_IN_Q19_12 },         // FRONT_CENTER
+        { MINUS_3_DB_IN_Q19_12, MINUS_3_DB_IN_Q19_12 },         // LOW_FREQUENCY
+        { 1 << 12, 0 },                                         // BACK_LEFT
+        { 0, 1 << 12 },                                         // BACK_RIGHT
+        { 1 << 12, 0 },                                         // FRONT_LEFT_OF_CENTER
+        { 0, 1 << 12 },                                         // FRONT_RIGHT_OF_CENTER
+        { MINUS_3_DB_IN_Q19_12, MINUS_3_DB_IN_Q19_12 },         // BACK_CENTER
+        { 1 << 12, 0 },                                         // SIDE_LEFT
+        { 0, 1 << 12 },                                         // SIDE_RIGHT
+        { MINUS_3_DB_IN_Q19_12, MINUS_3_DB_IN_Q19_12 },         // TOP_CENTER
+        { MINUS_3_DB_IN_Q19_12, 0 },                            // TOP_FRONT_LEFT
+        { MINUS_3_DB_IN_Q19_12, MINUS_3_DB_IN_Q19_12 },         // TOP_FRONT_CENTER
+        { 0, MINUS_3_DB_IN_Q19_12 },                            // TOP_FRONT_RIGHT
+        { MINUS_3_DB_IN_Q19_12, 0 },                            // TOP_BACK_LEFT
+        { MINUS_3_DB_IN_Q19_12, MINUS_3_DB_IN_Q19_12 },         // TOP_BACK_CENTER
+        { 0, MINUS_3_DB_IN_Q19_12 },                            // TOP_BACK_RIGHT
+    };
+
+    // only positional masks can be downmixed
+    if (mask == 0 || (mask & ~(uint32_t)AUDIO_CHANNEL_OUT_ALL) != 0) {
+        ALOGE("Unsupported channel mask 0x%" PRIx32, mask);
+        return false;
     }
-}
 
-
-/*----------------------------------------------------------------------------
- * Downmix_foldFrom7Point1()
- *----------------------------------------------------------------------------
- * Purpose:
- * downmix a 7.1 signal to stereo
- *
- * Inputs:
- *  pSrc       7.1 audio samples to downmix
- *  numFrames  the number of 7.1 frames to downmix
- *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
- *               or overwrite pDst (when false)
- *
- * Outputs:
- *  pDst       downmixed stereo audio samples
- *
- *----------------------------------------------------------------------------
- */
-void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate) {
-    int32_t lt, rt, centerPlusLfeContrib; // samples in Q19.12 format
-    // sample at index 0 is FL
-    // sample at index 1 is FR
-    // sample at index 2 is FC
-    // sample at index 3 is LFE
-    // sample at index 4 is RL
-    // sample at index 5 is RR
-    // sample at index 6 is SL
-    // sample at index 7 is SR
-    // code is mostly duplicated between the two values of accumulate to avoid repeating the test
-    // for every sample
-    if (accumulate) {
-        while (numFrames) {
-            // centerPlusLfeContrib = FC(-3dB) + LFE(-3dB)
-            centerPlusLfeContrib = (pSrc[2] * MINUS_3_DB_IN_Q19_12)
-                    + (pSrc[3] * MINUS_3_DB_IN_Q19_12);
-            // FL + centerPlusLfeContrib + SL + RL
-            lt = (pSrc[0] << 12) + centerPlusLfeContrib + (pSrc[6] << 12) + (pSrc[4] << 12);
-            // FR + centerPlusLfeContrib + SR + RR
-            rt = (pSrc[1] << 12) + centerPlusLfeContrib + (pSrc[7] << 12) + (pSrc[5] << 12);
-            //accumulate in destination
-            pDst[0] = clamp16(pDst[0] + (lt >> 13));
-            pDst[1] = clamp16(pDst[1] + (rt >> 13));
-            pSrc += 8;
-            pDst += 2;
-            numFrames--;
+    if (pMatrix == NULL) {
+        return true;
     }
-    } else { // same code as above but without adding and clamping pDst[i] to itself
-        while (numFrames) {
-            // centerPlusLfeContrib = FC(-3dB) + LFE(-3dB)
-            centerPlusLfeContrib = (pSrc[2] * MINUS_3_DB_IN_Q19_12)
-                    + (pSrc[3] * MINUS_3_DB_IN_Q19_12);
-            // FL + centerPlusLfeContrib + SL + RL
-            lt = (pSrc[0] << 12) + centerPlusLfeContrib + (pSrc[6] << 12) + (pSrc[4] << 12);
-            // FR + centerPlusLfeContrib + SR + RR
-            rt = (pSrc[1] << 12) + centerPlusLfeContrib + (pSrc[7] << 12) + (pSrc[5] << 12);
-            // store in destination
-            pDst[0] = clamp16(lt >> 13); // differs from when accumulate is true above
-            pDst[1] = clamp16(rt >> 13); // differs from when accumulate is true above
-            pSrc += 8;
-            pDst += 2;
-            numFrames--;
+    memset(pMatrix, 0, sizeof(downmix_matrix_t));
+    uint32_t channel = 0;
+    for (uint32_t bit = 0; bit < sizeof(kGains) / sizeof(kGains[0]); bit++) {
+        if (mask & (1 << bit)) {
+            pMatrix->coefs[2 * channel] = kGains[bit][0];
+            pMatrix->coefs[2 * channel + 1] = kGains[bit][1];
+            channel++;
         }
     }
+    pMatrix->channelCount = channel;
+    return true;
 }
 
 
 /*----------------------------------------------------------------------------
- * Downmix_foldGeneric()
+ * Downmix_foldMatrix()
  *----------------------------------------------------------------------------
  * Purpose:
- * downmix to stereo a multichannel signal whose format is:
- *  - has FL/FR
- *  - if using AUDIO_CHANNEL_OUT_SIDE*, it contains both left and right
- *  - if using AUDIO_CHANNEL_OUT_BACK*, it contains both left and right
- *  - doesn't use any of the AUDIO_CHANNEL_OUT_TOP* channels
- *  - doesn't use any of the AUDIO_CHANNEL_OUT_FRONT_*_OF_CENTER channels
- * Only handles channel masks not enumerated in downmix_input_channel_mask_t
+ * downmix a multichannel signal to stereo with precomputed coefficients
  *
  * Inputs:
- *  mask       the channel mask of pSrc
+ *  pMatrix    coefficients computed by Downmix_computeMatrix() for the channel mask of pSrc
  *  pSrc       multichannel audio buffer to downmix
  *  numFrames  the number of multichannel frames to downmix
  *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
@@ -966,119 +823,57 @@ void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
  * Outputs:
  *  pDst       downmixed stereo audio samples
  *
- * Returns: false if multichannel format is not supported
- *
  *----------------------------------------------------------------------------
  */
-bool Downmix_foldGeneric(
-        uint32_t mask, int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate) {
-    // check against unsupported channels
-    if (mask & kUnsupported) {
-        ALOGE("Unsupported channels (top or front left/right of center)");
-        return false;
-    }
-    // verify has FL/FR
-    if ((mask & AUDIO_CHANNEL_OUT_STEREO) != AUDIO_CHANNEL_OUT_STEREO) {
-        ALOGE("Front channels must be present");
-        return false;
-    }
-    // verify uses SIDE as a pair (ok if not using SIDE at all)
-    bool hasSides = false;
-    if ((mask & kSides) != 0) {
-        if ((mask & kSides) != kSides) {
-            ALOGE("Side channels must be used as a pair");
-            return false;
+void Downmix_foldMatrix(const downmix_matrix_t *pMatrix, int16_t *pSrc, int16_t *pDst,
+        size_t numFrames, bool accumulate) {
+    const uint32_t numChan = pMatrix->channelCount;
+    const int16_t *coefs = pMatrix->coefs;
+#ifdef DOWNMIX_NEON
+    // Each group of 8 channels of a frame is duplicated into (s0 s0 s1 s1 ...) and multiplied
+    // by the interleaved (left, right) coefficients. Coefficients past the last channel are 0,
+    // so the group may read into the next frame, but not past the end of the buffer.
+    const uint32_t numGroups = (numChan + 7) >> 3;
+    while (numFrames > 0 && numGroups * 8 <= numFrames * numChan) {
+        int32x4_t acc = vdupq_n_s32(0);
+        for (uint32_t g = 0; g < numGroups; g++) {
+            const int16x8_t s = vld1q_s16(pSrc + 8 * g);
+            const int16x8x2_t ss = vzipq_s16(s, s);
+            const int16_t *c = coefs + 16 * g;
+            acc = vmlal_s16(acc, vget_low_s16(ss.val[0]), vld1_s16(c));
+            acc = vmlal_s16(acc, vget_high_s16(ss.val[0]), vld1_s16(c + 4));
+            acc = vmlal_s16(acc, vget_low_s16(ss.val[1]), vld1_s16(c + 8));
+            acc = vmlal_s16(acc, vget_high_s16(ss.val[1]), vld1_s16(c + 12));
         }
-        hasSides = true;
-    }
-    // verify uses BACK as a pair (ok if not using BACK at all)
-    bool hasBacks = false;
-    if ((mask & kBacks) != 0) {
-        if ((mask & kBacks) != kBacks) {
-            ALOGE("Back channels must be used as a pair");
-            return false;
+        // (lt, rt) in Q19.12, then back to Q0.15 with the -6dB from the two sides
+        int32x2_t lr = vshr_n_s32(vadd_s32(vget_low_s32(acc), vget_high_s32(acc)), 13);
+        if (accumulate) {
+            lr = vadd_s32(lr, vset_lane_s32(pDst[1], vdup_n_s32(pDst[0]), 1));
         }
-        hasBacks = true;
+        const int16x4_t out = vqmovn_s32(vcombine_s32(lr, lr));
+        pDst[0] = vget_lane_s16(out, 0);
+        pDst[1] = vget_lane_s16(out, 1);
+        pSrc += numChan;
+        pDst += 2;
+        numFrames--;
     }
-
-    const int numChan = audio_channel_count_from_out_mask(mask);
-    const bool hasFC = ((mask & AUDIO_CHANNEL_OUT_FRONT_CENTER) == AUDIO_CHANNEL_OUT_FRONT_CENTER);
-    const bool hasLFE =
-            ((mask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY) == AUDIO_CHANNEL_OUT_LOW_FREQUENCY);
-    const bool hasBC = ((mask & AUDIO_CHANNEL_OUT_BACK_CENTER) == AUDIO_CHANNEL_OUT_BACK_CENTER);
-    // compute at what index each channel is: samples will be in the following order:
-    //   FL FR FC LFE BL BR BC SL SR
-    // when a channel is not present, its index is set to the same as the index of the preceding
-    // channel
-    const int indexFC  = hasFC    ? 2            : 1;        // front center
-    const int indexLFE = hasLFE   ? indexFC + 1  : indexFC;  // low frequency
-    const int indexBL  = hasBacks ? indexLFE + 1 : indexLFE; // back left
-    const int indexBR  = hasBacks ? indexBL + 1  : indexBL;  // back right
-    const int indexBC  = hasBC    ? indexBR + 1  : indexBR;  // back center
-    const int indexSL  = hasSides ? indexBC + 1  : indexBC;  // side left
-    const int indexSR  = hasSides ? indexSL + 1  : indexSL;  // side right
-
-    int32_t lt, rt, centersLfeContrib; // samples in Q19.12 format
-    // code is mostly duplicated between the two values of accumulate to avoid repeating the test
-    // for every sample
-    if (accumulate) {
-        while (numFrames) {
-            // compute contribution of FC, BC and LFE
-            centersLfeContrib = 0;
-            if (hasFC)  { centersLfeContrib += pSrc[indexFC]; }
-            if (hasLFE) { centersLfeContrib += pSrc[indexLFE]; }
-            if (hasBC)  { centersLfeContrib += pSrc[indexBC]; }
-            centersLfeContrib *= MINUS_3_DB_IN_Q19_12;
-            // always has FL/FR
-            lt = (pSrc[0] << 12);
-            rt = (pSrc[1] << 12);
-            // mix in sides and backs
-            if (hasSides) {
-                lt += pSrc[indexSL] << 12;
-                rt += pSrc[indexSR] << 12;
-            }
-            if (hasBacks) {
-                lt += pSrc[indexBL] << 12;
-                rt += pSrc[indexBR] << 12;
-            }
-            lt += centersLfeContrib;
-            rt += centersLfeContrib;
-            // accumulate in destination
+#endif
+    while (numFrames) {
+        int32_t lt = 0; // Q19.12
+        int32_t rt = 0;
+        for (uint32_t c = 0; c < numChan; c++) {
+            lt += pSrc[c] * coefs[2 * c];
+            rt += pSrc[c] * coefs[2 * c + 1];
+        }
+        if (accumulate) {
             pDst[0] = clamp16(pDst[0] + (lt >> 13));
             pDst[1] = clamp16(pDst[1] + (rt >> 13));
-            pSrc += numChan;
-            pDst += 2;
-            numFrames--;
-        }
-    } else {
-        while (numFrames) {
-            // compute contribution of FC, BC and LFE
-            centersLfeContrib = 0;
-            if (hasFC)  { centersLfeContrib += pSrc[indexFC]; }
-            if (hasLFE) { centersLfeContrib += pSrc[indexLFE]; }
-            if (hasBC)  { centersLfeContrib += pSrc[indexBC]; }
-            centersLfeContrib *= MINUS_3_DB_IN_Q19_12;
-            // always has FL/FR
-            lt = (pSrc[0] << 12);
-            rt = (pSrc[1] << 12);
-            // mix in sides and backs
-            if (hasSides) {
-                lt += pSrc[indexSL] << 12;
-                rt += pSrc[indexSR] << 12;
-            }
-            if (hasBacks) {
-                lt += pSrc[indexBL] << 12;
-                rt += pSrc[indexBR] << 12;
-            }
-            lt += centersLfeContrib;
-            rt += centersLfeContrib;
-            // store in destination
-            pDst[0] = clamp16(lt >> 13); // differs from when accumulate is true above
-            pDst[1] = clamp16(rt >> 13); // differs from when accumulate is true above
-            pSrc += numChan;
-            pDst += 2;
-            numFrames--;
+        } else {
+            pDst[0] = clamp16(lt >> 13);
+            pDst[1] = clamp16(rt >> 13);
         }
+        pSrc += numChan;
+        pDst += 2;
+        numFrames--;
     }
-    return true;
 }
@@ -34,12 +34,24 @@ typedef enum {
     DOWNMIX_STATE_ACTIVE,
 } downmix_state_t;
 
+// maximum number of input channels, rounded up to the 8 channels processed per NEON iteration
+#define DOWNMIX_MATRIX_MAX_CHANNELS 24
+
+/* coefficients of the fold downmix */
+typedef struct {
+    uint32_t channelCount;
+    // gain in Q19.12 of each input channel in the left and right outputs, interleaved:
+    // left0 right0 left1 right1 ..., zero past channelCount
+    int16_t coefs[2 * DOWNMIX_MATRIX_MAX_CHANNELS];
+} downmix_matrix_t;
+
 /* parameters for each downmixer */
 typedef struct {
     downmix_state_t state;
     downmix_type_t type;
     bool apply_volume_correction;
     uint8_t input_channel_count;
+    downmix_matrix_t matrix;
 } downmix_object_t;
 
 
@@ -96,10 +108,8 @@ int Downmix_Reset(downmix_object_t *pDownmixer, bool init);
 int Downmix_setParameter(downmix_object_t *pDownmixer, int32_t param, uint32_t size, void *pValue);
 int Downmix_getParameter(downmix_object_t *pDownmixer, int32_t param, uint32_t *pSize, void *pValue);
 
-void Downmix_foldFromQuad(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
-void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
-void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
-bool Downmix_foldGeneric(
-        uint32_t mask, int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
+bool Downmix_computeMatrix(uint32_t mask, downmix_matrix_t *pMatrix);
+void Downmix_foldMatrix(const downmix_matrix_t *pMatrix, int16_t *pSrc, int16_t *pDst,
+        size_t numFrames, bool accumulate);
 
 #endif /*ANDROID_EFFECTDOWNMIX_H_*/
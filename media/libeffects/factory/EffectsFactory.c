@@ -19,8 +19,10 @@
 
 #include "EffectsFactory.h"
 #include <string.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <dlfcn.h>
+#include <sys/stat.h>
 
 #include <cutils/misc.h>
 #include <cutils/config_utils.h>
@@ -39,6 +41,8 @@ static list_elem_t *gCurLib;    // current library in enumeration process
 static list_elem_t *gCurEffect; // current effect in enumeration process
 static uint32_t gCurEffectIdx;       // current effect index in enumeration process
 static lib_entry_t *gCachedLibrary;  // last library accessed by getLibrary()
+static list_elem_t *gDescriptorCache; // list of desc_cache_entry_t
+static int gDescriptorCacheDirty;    // a descriptor was added to the cache during init
 
 static int gInitDone; // true is global initialization has been preformed
 static int gCanQueryEffect; // indicates that call to EffectQueryEffect() is valid, i.e. that the list of effects
@@ -53,6 +57,14 @@ static int init();
 static int loadEffectConfigFile(const char *path);
 static int loadLibraries(cnode *root);
 static int loadLibrary(cnode *root, const char *name);
+static int openLibrary(lib_entry_t *lib);
+static int getLibraryDescriptor(lib_entry_t *lib,
+               const effect_uuid_t *uuid,
+               effect_descriptor_t *desc);
+static int openSubEffectLibraries(const effect_uuid_t *uuid);
+static void loadDescriptorCache(const char *path);
+static void saveDescriptorCache(const char *path);
+static void freeDescriptorCache();
 static int loadEffects(cnode *root);
 static int loadEffect(cnode *node);
 // To get and add the effect pointed by the passed node to the gSubEffectList
@@ -306,6 +318,16 @@ int EffectCreate(const effect_uuid_t *uuid, int32_t sessionId, int32_t ioId, eff
         }
     }
 
+    // libraries are only opened when one of their effects is first created
+    ret = openLibrary(l);
+    if (ret < 0) {
+        goto exit;
+    }
+    ret = openSubEffectLibraries(uuid);
+    if (ret < 0) {
+        goto exit;
+    }
+
     // create effect in library
     ret = l->desc->create_effect(uuid, sessionId, ioId, &itfe);
     if (ret != 0) {
@@ -450,12 +472,16 @@ int init() {
 
     // ignore effects or not?
     const bool ignoreFxConfFiles = property_get_bool(PROPERTY_IGNORE_EFFECTS, false);
+    const bool useDescriptorCache = property_get_bool(PROPERTY_EFFECTS_DESCRIPTOR_CACHE, true);
 
     pthread_mutex_init(&gLibLock, NULL);
 
     if (ignoreFxConfFiles) {
         ALOGI("Audio effects in configuration files will be ignored");
     } else {
+        if (useDescriptorCache) {
+            loadDescriptorCache(EFFECTS_DESCRIPTOR_CACHE_FILE);
+        }
         if (access(AUDIO_EFFECT_VENDOR_CONFIG_FILE2, R_OK) == 0) {
             loadEffectConfigFile(AUDIO_EFFECT_VENDOR_CONFIG_FILE2);
         } else if (access(AUDIO_EFFECT_VENDOR_CONFIG_FILE, R_OK) == 0) {
@@ -463,6 +489,10 @@ int init() {
         } else if (access(AUDIO_EFFECT_DEFAULT_CONFIG_FILE, R_OK) == 0) {
             loadEffectConfigFile(AUDIO_EFFECT_DEFAULT_CONFIG_FILE);
         }
+        if (useDescriptorCache) {
+            saveDescriptorCache(EFFECTS_DESCRIPTOR_CACHE_FILE);
+        }
+        freeDescriptorCache();
     }
 
     updateNumEffects();
@@ -510,13 +540,12 @@ int loadLibraries(cnode *root)
 int loadLibrary(cnode *root, const char *name)
 {
     cnode *node;
-    void *hdl;
-    audio_effect_library_t *desc;
     list_elem_t *e;
     lib_entry_t *l;
     char path[PATH_MAX];
     char *str;
     size_t len;
+    struct stat st;
 
     node = config_find(root, PATH_TAG);
     if (node == NULL) {
@@ -536,35 +565,20 @@ int loadLibrary(cnode *root, const char *name)
     if (strlen(path) >= PATH_MAX - 1)
         return -EINVAL;
 
-    hdl = dlopen(path, RTLD_NOW);
-    if (hdl == NULL) {
+    // the library itself is opened by openLibrary(), when needed
+    if (stat(path, &st) != 0) {
         ALOGW("loadLibrary() failed to open %s", path);
-        goto error;
-    }
-
-    desc = (audio_effect_library_t *)dlsym(hdl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
-    if (desc == NULL) {
-        ALOGW("loadLibrary() could not find symbol %s", AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
-        goto error;
-    }
-
-    if (AUDIO_EFFECT_LIBRARY_TAG != desc->tag) {
-        ALOGW("getLibrary() bad tag %08x in lib info struct", desc->tag);
-        goto error;
-    }
-
-    if (EFFECT_API_VERSION_MAJOR(desc->version) !=
-            EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION)) {
-        ALOGW("loadLibrary() bad lib version %08x", desc->version);
-        goto error;
+        return -EINVAL;
     }
 
     // add entry for library in gLibraryList
     l = malloc(sizeof(lib_entry_t));
     l->name = strndup(name, PATH_MAX);
     l->path = strndup(path, PATH_MAX);
-    l->handle = hdl;
-    l->desc = desc;
+    l->handle = NULL;
+    l->desc = NULL;
+    l->mtime = (int64_t)st.st_mtime;
+    l->size = (int64_t)st.st_size;
     l->effects = NULL;
     pthread_mutex_init(&l->lock, NULL);
 
@@ -577,6 +591,45 @@ int loadLibrary(cnode *root, const char *name)
     ALOGV("getLibrary() linked library %p for path %s", l, path);
 
     return 0;
+}
+
+// Opens the library if not already done. Returns 0 on success.
+int openLibrary(lib_entry_t *lib)
+{
+    void *hdl;
+    audio_effect_library_t *desc;
+
+    if (lib->handle != NULL) {
+        return 0;
+    }
+
+    hdl = dlopen(lib->path, RTLD_NOW);
+    if (hdl == NULL) {
+        ALOGW("openLibrary() failed to open %s", lib->path);
+        goto error;
+    }
+
+    desc = (audio_effect_library_t *)dlsym(hdl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+    if (desc == NULL) {
+        ALOGW("openLibrary() could not find symbol %s", AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+        goto error;
+    }
+
+    if (AUDIO_EFFECT_LIBRARY_TAG != desc->tag) {
+        ALOGW("openLibrary() bad tag %08x in lib info struct", desc->tag);
+        goto error;
+    }
+
+    if (EFFECT_API_VERSION_MAJOR(desc->version) !=
+            EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION)) {
+        ALOGW("openLibrary() bad lib version %08x", desc->version);
+        goto error;
+    }
+
+    lib->handle = hdl;
+    lib->desc = desc;
+    ALOGV("openLibrary() opened library %s", lib->path);
+    return 0;
 
 error:
     if (hdl != NULL) {
@@ -585,6 +638,192 @@ error:
     return -EINVAL;
 }
 
+// Opens the libraries of all the sub effects of the effect with the given uuid,
+// as the proxy effect accesses their library descriptors directly.
+int openSubEffectLibraries(const effect_uuid_t *uuid)
+{
+    list_sub_elem_t *e = gSubEffectList;
+
+    while (e != NULL) {
+        effect_descriptor_t *d = (effect_descriptor_t *)e->object;
+        if (memcmp(uuid, &d->uuid, sizeof(effect_uuid_t)) == 0) {
+            list_elem_t *subefx = e->sub_elem;
+            while (subefx != NULL) {
+                sub_effect_entry_t *subeffect = (sub_effect_entry_t *)subefx->object;
+                int ret = openLibrary(subeffect->lib);
+                if (ret < 0) {
+                    return ret;
+                }
+                subefx = subefx->next;
+            }
+            return 0;
+        }
+        e = e->next;
+    }
+    return 0;
+}
+
+// Gets the descriptor of an effect from the descriptor cache, or from the library
+// itself if the cache has no entry for this version of the library.
+int getLibraryDescriptor(lib_entry_t *lib,
+               const effect_uuid_t *uuid,
+               effect_descriptor_t *desc)
+{
+    list_elem_t *e;
+    desc_cache_entry_t *entry;
+
+    for (e = gDescriptorCache; e != NULL; e = e->next) {
+        entry = (desc_cache_entry_t *)e->object;
+        if (entry->mtime == lib->mtime && entry->size == lib->size &&
+                memcmp(&entry->uuid, uuid, sizeof(effect_uuid_t)) == 0 &&
+                strcmp(entry->path, lib->path) == 0) {
+            entry->used = 1;
+            *desc = entry->desc;
+            return 0;
+        }
+    }
+
+    if (openLibrary(lib) != 0 || lib->desc->get_descriptor(uuid, desc) != 0) {
+        return -EINVAL;
+    }
+
+    entry = malloc(sizeof(desc_cache_entry_t));
+    entry->path = strdup(lib->path);
+    entry->mtime = lib->mtime;
+    entry->size = lib->size;
+    entry->uuid = *uuid;
+    entry->desc = *desc;
+    entry->used = 1;
+    e = malloc(sizeof(list_elem_t));
+    e->object = entry;
+    e->next = gDescriptorCache;
+    gDescriptorCache = e;
+    gDescriptorCacheDirty = 1;
+    return 0;
+}
+
+// Cache file layout, in native byte order:
+//   uint32_t magic, version, number of entries
+//   for each entry: uint32_t path length, path (not terminated), int64_t mtime,
+//       int64_t size, effect_uuid_t uuid, effect_descriptor_t descriptor
+void loadDescriptorCache(const char *path)
+{
+    FILE *f;
+    uint32_t header[3];
+    uint32_t i;
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        return;
+    }
+    if (fread(header, sizeof(header), 1, f) != 1 ||
+            header[0] != EFFECTS_DESCRIPTOR_CACHE_MAGIC ||
+            header[1] != EFFECTS_DESCRIPTOR_CACHE_VERSION) {
+        ALOGW("loadDescriptorCache() ignoring invalid cache %s", path);
+        fclose(f);
+        return;
+    }
+    for (i = 0; i < header[2]; i++) {
+        uint32_t len;
+        desc_cache_entry_t *entry;
+        list_elem_t *e;
+
+        if (fread(&len, sizeof(len), 1, f) != 1 || len == 0 || len >= PATH_MAX) {
+            break;
+        }
+        entry = malloc(sizeof(desc_cache_entry_t));
+        entry->path = malloc(len + 1);
+        if (fread(entry->path, len, 1, f) != 1 ||
+                fread(&entry->mtime, sizeof(entry->mtime), 1, f) != 1 ||
+                fread(&entry->size, sizeof(entry->size), 1, f) != 1 ||
+                fread(&entry->uuid, sizeof(entry->uuid), 1, f) != 1 ||
+                fread(&entry->desc, sizeof(entry->desc), 1, f) != 1) {
+            free(entry->path);
+            free(entry);
+            break;
+        }
+        entry->path[len] = '\0';
+        entry->used = 0;
+        e = malloc(sizeof(list_elem_t));
+        e->object = entry;
+        e->next = gDescriptorCache;
+        gDescriptorCache = e;
+    }
+    if (i != header[2]) {
+        ALOGW("loadDescriptorCache() truncated cache %s", path);
+        freeDescriptorCache();
+    }
+    fclose(f);
+    ALOGV("loadDescriptorCache() read %u descriptors", i);
+}
+
+// Writes the descriptors queried by this init, if any was not in the cache already.
+// This prunes the entries of libraries that were updated or are no longer configured.
+void saveDescriptorCache(const char *path)
+{
+    char tmpPath[PATH_MAX];
+    FILE *f;
+    list_elem_t *e;
+    uint32_t header[3];
+    int ok;
+
+    if (!gDescriptorCacheDirty) {
+        return;
+    }
+    header[0] = EFFECTS_DESCRIPTOR_CACHE_MAGIC;
+    header[1] = EFFECTS_DESCRIPTOR_CACHE_VERSION;
+    header[2] = 0;
+    for (e = gDescriptorCache; e != NULL; e = e->next) {
+        if (((desc_cache_entry_t *)e->object)->used) {
+            header[2]++;
+        }
+    }
+
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    f = fopen(tmpPath, "wb");
+    if (f == NULL) {
+        ALOGW("saveDescriptorCache() could not create %s", tmpPath);
+        return;
+    }
+    ok = fwrite(header, sizeof(header), 1, f) == 1;
+    for (e = gDescriptorCache; e != NULL && ok; e = e->next) {
+        desc_cache_entry_t *entry = (desc_cache_entry_t *)e->object;
+        uint32_t len;
+        if (!entry->used) {
+            continue;
+        }
+        len = strlen(entry->path);
+        ok = fwrite(&len, sizeof(len), 1, f) == 1 &&
+                fwrite(entry->path, len, 1, f) == 1 &&
+                fwrite(&entry->mtime, sizeof(entry->mtime), 1, f) == 1 &&
+                fwrite(&entry->size, sizeof(entry->size), 1, f) == 1 &&
+                fwrite(&entry->uuid, sizeof(entry->uuid), 1, f) == 1 &&
+                fwrite(&entry->desc, sizeof(entry->desc), 1, f) == 1;
+    }
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+    if (!ok || rename(tmpPath, path) != 0) {
+        ALOGW("saveDescriptorCache() could not write %s", path);
+        unlink(tmpPath);
+        return;
+    }
+    ALOGV("saveDescriptorCache() wrote %u descriptors", header[2]);
+}
+
+void freeDescriptorCache()
+{
+    while (gDescriptorCache != NULL) {
+        list_elem_t *e = gDescriptorCache;
+        desc_cache_entry_t *entry = (desc_cache_entry_t *)e->object;
+        gDescriptorCache = e->next;
+        free(entry->path);
+        free(entry);
+        free(e);
+    }
+    gDescriptorCacheDirty = 0;
+}
+
 // This will find the library and UUID tags of the sub effect pointed by the
 // node, gets the effect descriptor and lib_entry_t and adds the subeffect -
 // sub_entry_t to the gSubEffectList
@@ -614,7 +853,7 @@ int addSubEffect(cnode *root)
         return -EINVAL;
     }
     d = malloc(sizeof(effect_descriptor_t));
-    if (l->desc->get_descriptor(&uuid, d) != 0) {
+    if (getLibraryDescriptor(l, &uuid, d) != 0) {
         char s[40];
         uuidToString(&uuid, s, 40);
         ALOGW("Error querying effect %s on lib %s", s, l->name);
@@ -696,7 +935,7 @@ int loadEffect(cnode *root)
     }
 
     d = malloc(sizeof(effect_descriptor_t));
-    if (l->desc->get_descriptor(&uuid, d) != 0) {
+    if (getLibraryDescriptor(l, &uuid, d) != 0) {
         char s[40];
         uuidToString(&uuid, s, 40);
         ALOGW("Error querying effect %s on lib %s", s, l->name);
@@ -993,7 +1232,7 @@ int EffectDumpEffects(int fd) {
     while (e) {
         l = (lib_entry_t *)e->object;
         list_elem_t *efx = l->effects;
-        dprintf(fd, "Library %s\n", l->name);
+        dprintf(fd, "Library %s%s\n", l->name, l->handle == NULL ? " (not loaded)" : "");
         if (!efx) {
             dprintf(fd, "  (no effects)\n");
         }
@@ -27,6 +27,14 @@ extern "C" {
 #endif
 
 #define PROPERTY_IGNORE_EFFECTS "ro.audio.ignore_effects"
+// set to false to always query effect descriptors from the libraries at init time
+#define PROPERTY_EFFECTS_DESCRIPTOR_CACHE "ro.audio.effects_descriptor_cache"
+
+// Descriptors queried from the effect libraries, keyed by library path, size and
+// modification time, so that libraries are only loaded when an effect is created.
+#define EFFECTS_DESCRIPTOR_CACHE_FILE "/data/misc/media/audio_effects_descriptors.bin"
+#define EFFECTS_DESCRIPTOR_CACHE_MAGIC 0x43584645   // 'EFXC'
+#define EFFECTS_DESCRIPTOR_CACHE_VERSION 1
 
 typedef struct list_elem_s {
     void *object;
@@ -43,14 +51,26 @@ typedef struct list_sub_elem_s {
 } list_sub_elem_t;
 
 typedef struct lib_entry_s {
-    audio_effect_library_t *desc;
+    audio_effect_library_t *desc;   // NULL until the library is opened
     char *name;
     char *path;
-    void *handle;
+    void *handle;                   // NULL until the library is opened
+    int64_t mtime;                  // modification time and size of the library file,
+    int64_t size;                   // identify it in the descriptor cache
     list_elem_t *effects; //list of effect_descriptor_t
     pthread_mutex_t lock;
 } lib_entry_t;
 
+// An entry of the descriptor cache
+typedef struct desc_cache_entry_s {
+    char *path;
+    int64_t mtime;
+    int64_t size;
+    effect_uuid_t uuid;
+    effect_descriptor_t desc;
+    int used;                       // queried during init, and kept when saving the cache
+} desc_cache_entry_t;
+
 typedef struct effect_entry_s {
     struct effect_interface_s *itfe;
     effect_handle_t subItfe;
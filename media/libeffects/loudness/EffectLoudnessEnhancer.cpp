@@ -280,17 +280,10 @@ int LE_process(
     }
 
     //ALOGV("LE about to process %d samples", inBuffer->frameCount);
-    uint16_t inIdx;
     float inputAmp = pow(10, pContext->mTargetGainmB/2000.0f);
-    float leftSample, rightSample;
-    for (inIdx = 0 ; inIdx < inBuffer->frameCount ; inIdx++) {
-        // makeup gain is applied on the input of the compressor
-        leftSample  = inputAmp * (float)inBuffer->s16[2*inIdx];
-        rightSample = inputAmp * (float)inBuffer->s16[2*inIdx +1];
-        pContext->mCompressor->Compress(&leftSample, &rightSample);
-        inBuffer->s16[2*inIdx]    = (int16_t) leftSample;
-        inBuffer->s16[2*inIdx +1] = (int16_t) rightSample;
-    }
+    // makeup gain is applied on the input of the compressor
+    pContext->mCompressor->CompressStereo(inBuffer->s16, inBuffer->s16,
+            inBuffer->frameCount, inputAmp);
 
     if (inBuffer->raw != outBuffer->raw) {
         if (pContext->mConfig.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
@@ -137,5 +137,54 @@ void AdaptiveDynamicRangeCompression::Compress(float *x1, float *x2) {
   }
 }
 
+void AdaptiveDynamicRangeCompression::CompressStereo(
+    const int16 *in, int16 *out, int frame_count, float input_gain) {
+  float x1[kBlockFrames];
+  float x2[kBlockFrames];
+  float cv[kBlockFrames];
+  float gain[kBlockFrames];
+  while (frame_count > 0) {
+    const int frames = std::min(frame_count, kBlockFrames);
+    // Level detection and static gain curve, independent for each frame
+    for (int i = 0; i < frames; ++i) {
+      x1[i] = input_gain * static_cast<float>(in[2 * i]);
+      x2[i] = input_gain * static_cast<float>(in[2 * i + 1]);
+      const float max_abs_x = std::max(std::fabs(x1[i]),
+        std::max(std::fabs(x2[i]), kMinLogAbsValue));
+      const float overshoot = math::fast_log(max_abs_x) - knee_threshold_;
+      cv[i] = std::max(overshoot, 0.0f) * slope_;
+    }
+    // Envelope detector, the only recursive part
+    for (int i = 0; i < frames; ++i) {
+      const float prev_state = state_;
+      if (cv[i] <= state_) {
+        state_ = alpha_attack_ * state_ + (1.0f - alpha_attack_) * cv[i];
+      } else {
+        state_ = alpha_release_ * state_ + (1.0f - alpha_release_) * cv[i];
+      }
+      gain[i] = state_ - prev_state;
+    }
+    for (int i = 0; i < frames; ++i) {
+      gain[i] = math::ExpApproximationViaTaylorExpansionOrder5(gain[i]);
+    }
+    for (int i = 0; i < frames; ++i) {
+      compressor_gain_ *= gain[i];
+      gain[i] = compressor_gain_;
+    }
+    // Gain application and saturation
+    for (int i = 0; i < frames; ++i) {
+      const float y1 = std::min(std::max(x1[i] * gain[i], -kFixedPointLimit),
+                                kFixedPointLimit);
+      const float y2 = std::min(std::max(x2[i] * gain[i], -kFixedPointLimit),
+                                kFixedPointLimit);
+      out[2 * i] = static_cast<int16>(y1);
+      out[2 * i + 1] = static_cast<int16>(y2);
+    }
+    in += 2 * frames;
+    out += 2 * frames;
+    frame_count -= frames;
+  }
+}
+
 }  // namespace le_fx
 
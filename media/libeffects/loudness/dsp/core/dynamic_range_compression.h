@@ -58,6 +58,16 @@ class AdaptiveDynamicRangeCompression {
   // Stereo channel version of the compressor
   void Compress(float *x1, float *x2);
 
+  // Block version of the stereo compressor. Scales `frame_count` interleaved
+  // stereo frames of `in` by `input_gain`, compresses them and writes them,
+  // truncated to 16 bit, to `out`, which may be the same buffer as `in`.
+  // The result is the same as calling Compress(float*, float*) on each frame,
+  // but the level detection, gain computation and gain application are done
+  // kBlockFrames frames at a time, so that only the envelope recursion itself
+  // is computed sample by sample.
+  void CompressStereo(const int16 *in, int16 *out, int frame_count,
+                      float input_gain);
+
   // This version is slower than Compress(.) but faster than CompressSlow(.)
   float CompressNormalSpeed(float x);
 
@@ -91,6 +101,8 @@ class AdaptiveDynamicRangeCompression {
   static const float kTauAttack;
   // The release time of the envelope detector
   static const float kTauRelease;
+  // Number of frames processed per iteration by CompressStereo()
+  static const int kBlockFrames = 8;
 
   float sampling_rate_;
   // the internal state of the envelope detector
@@ -0,0 +1,25 @@
+# Build the unit tests for the loudness enhancer
+
+#
+# dynamic range compression unit test and benchmark
+#
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+	libcutils \
+	liblog
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/..
+
+LOCAL_SRC_FILES := \
+	dynamic_range_compression_tests.cpp \
+	../dsp/core/dynamic_range_compression.cpp
+
+LOCAL_CFLAGS += -O2
+
+LOCAL_MODULE := dynamic_range_compression_tests
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_NATIVE_TEST)
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "dynamic_range_compression_tests"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include <cutils/log.h>
+#include <gtest/gtest.h>
+#include "dsp/core/dynamic_range_compression.h"
+
+static const float kSampleRate = 48000.0f;
+static const int kFrames = 48000 * 4;   // seconds of stereo audio
+static const int kBufferFrames = 240;   // a typical mixer buffer
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// A loud two tone signal with a level sweep, so that the compressor both
+// attacks and releases.
+static void makeSignal(std::vector<int16_t> *signal)
+{
+    signal->resize(kFrames * 2);
+    srand(42);
+    for (int i = 0; i < kFrames; i++) {
+        const float t = i / kSampleRate;
+        const float level = 0.5f + 0.5f * sinf(2 * M_PI * 0.7f * t);
+        const float noise = (rand() % 2001 - 1000) / 1000.0f;
+        const float l = level * (0.6f * sinf(2 * M_PI * 440.0f * t) + 0.1f * noise);
+        const float r = level * (0.6f * sinf(2 * M_PI * 660.0f * t) - 0.1f * noise);
+        (*signal)[2 * i] = (int16_t)(l * 32767);
+        (*signal)[2 * i + 1] = (int16_t)(r * 32767);
+    }
+}
+
+// the per frame loop used by the effect before CompressStereo()
+static void compressPerFrame(le_fx::AdaptiveDynamicRangeCompression *compressor,
+        int16_t *buffer, int frames, float inputAmp)
+{
+    for (int i = 0; i < frames; i++) {
+        float left = inputAmp * (float)buffer[2 * i];
+        float right = inputAmp * (float)buffer[2 * i + 1];
+        compressor->Compress(&left, &right);
+        buffer[2 * i] = (int16_t)left;
+        buffer[2 * i + 1] = (int16_t)right;
+    }
+}
+
+static int64_t run(bool block, float targetGain, std::vector<int16_t> *buffer)
+{
+    le_fx::AdaptiveDynamicRangeCompression compressor;
+    compressor.Initialize(targetGain, kSampleRate);
+    const float inputAmp = targetGain;
+    const int64_t start = nowNs();
+    for (int i = 0; i < kFrames; i += kBufferFrames) {
+        int16_t *buf = &(*buffer)[2 * i];
+        int frames = kFrames - i < kBufferFrames ? kFrames - i : kBufferFrames;
+        if (block) {
+            compressor.CompressStereo(buf, buf, frames, inputAmp);
+        } else {
+            compressPerFrame(&compressor, buf, frames, inputAmp);
+        }
+    }
+    return nowNs() - start;
+}
+
+TEST(loudness_dynamic_range_compression, block_matches_per_frame) {
+    std::vector<int16_t> signal;
+    makeSignal(&signal);
+    static const float kTargetGains[] = { 1.0f, 2.0f, 3.5f, 5.0f };
+    for (size_t g = 0; g < sizeof(kTargetGains) / sizeof(kTargetGains[0]); g++) {
+        std::vector<int16_t> reference(signal);
+        std::vector<int16_t> test(signal);
+        run(false, kTargetGains[g], &reference);
+        run(true, kTargetGains[g], &test);
+        for (size_t i = 0; i < signal.size(); i++) {
+            // within 0.01 dB, or one LSB for small samples
+            const float tolerance = fmaxf(1.0f, fabsf(reference[i]) * 0.00115f);
+            ASSERT_LE(fabsf((float)test[i] - reference[i]), tolerance)
+                    << "sample " << i << " target gain " << kTargetGains[g];
+        }
+    }
+}
+
+TEST(loudness_dynamic_range_compression, benchmark) {
+    std::vector<int16_t> signal;
+    makeSignal(&signal);
+    static const int kRuns = 5;
+    int64_t perFrameNs = INT64_MAX;
+    int64_t blockNs = INT64_MAX;
+    for (int i = 0; i < kRuns; i++) {
+        std::vector<int16_t> buffer(signal);
+        const int64_t ns = run(false, 3.0f, &buffer);
+        if (ns < perFrameNs) {
+            perFrameNs = ns;
+        }
+        buffer = signal;
+        const int64_t blockRunNs = run(true, 3.0f, &buffer);
+        if (blockRunNs < blockNs) {
+            blockNs = blockRunNs;
+        }
+    }
+    printf("per frame: %.2f ns/frame, block: %.2f ns/frame, speedup %.2fx\n",
+            (double)perFrameNs / kFrames, (double)blockNs / kFrames,
+            (double)perFrameNs / blockNs);
+}
@@ -103,6 +103,19 @@ LOCAL_SRC_FILES:= \
     Common/src/LVM_Timer.c \
     Common/src/LVM_Timer_Init.c
 
+# NEON kernels, used at run time when the CPU supports them
+LOCAL_SRC_FILES_arm64 += \
+    Common/src/LVM_Neon.c \
+    Common/src/BQ_2I_D16F32C15_TRC_WRA_01_NEON.c \
+    Common/src/PK_2I_D32F32C14G11_TRC_WRA_01_NEON.c
+
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_SRC_FILES_arm += \
+    Common/src/LVM_Neon.c \
+    Common/src/BQ_2I_D16F32C15_TRC_WRA_01_NEON.c \
+    Common/src/PK_2I_D32F32C14G11_TRC_WRA_01_NEON.c
+endif
+
 LOCAL_MODULE:= libmusicbundle
 
 LOCAL_C_INCLUDES += \
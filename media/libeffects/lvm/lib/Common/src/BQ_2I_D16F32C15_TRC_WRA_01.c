@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "BQ_2I_D16F32Css_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_Neon.h"
 
 /**************************************************************************
  ASSUMPTIONS:
@@ -46,6 +47,14 @@ void BQ_2I_D16F32C15_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
 
+#ifdef LVM_NEON
+        if (LVM_NeonAvailable())
+        {
+            BQ_2I_D16F32C15_TRC_WRA_01_NEON(pInstance, pDataIn, pDataOut, NrSamples);
+            return;
+        }
+#endif
+
          for (ii = NrSamples; ii != 0; ii--)
          {
 
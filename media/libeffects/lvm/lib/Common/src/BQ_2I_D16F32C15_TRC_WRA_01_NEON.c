@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LVM_Neon.h"
+
+#ifdef LVM_NEON
+
+#include <arm_neon.h>
+#include "BQ_2I_D16F32Css_TRC_WRA_01_Private.h"
+
+/**************************************************************************
+ NEON version of BQ_2I_D16F32C15_TRC_WRA_01, see there for the
+ coefficient and delay formats. Lane 0 is the left channel and lane 1
+ the right channel.
+***************************************************************************/
+
+void BQ_2I_D16F32C15_TRC_WRA_01_NEON (      Biquad_Instance_t       *pInstance,
+                                            LVM_INT16                    *pDataIn,
+                                            LVM_INT16                    *pDataOut,
+                                            LVM_INT16                    NrSamples)
+    {
+        PFilter_State pBiquadState = (PFilter_State) pInstance;
+        LVM_INT32 *pDelays = pBiquadState->pDelays;
+        const LVM_INT32 A2 = pBiquadState->coefs[0];
+        const LVM_INT32 A1 = pBiquadState->coefs[1];
+        const LVM_INT32 A0 = pBiquadState->coefs[2];
+        const LVM_INT32 B2 = pBiquadState->coefs[3];
+        const LVM_INT32 B1 = pBiquadState->coefs[4];
+        int32x2_t xn1 = vld1_s32(pDelays);          /* x(n-1) in Q0 */
+        int32x2_t xn2 = vld1_s32(pDelays + 2);      /* x(n-2) in Q0 */
+        int32x2_t yn1 = vld1_s32(pDelays + 4);      /* y(n-1) in Q16 */
+        int32x2_t yn2 = vld1_s32(pDelays + 6);      /* y(n-2) in Q16 */
+        LVM_INT16 ii;
+
+        for (ii = NrSamples; ii != 0; ii--)
+        {
+            /* x(n) widened to 32 bits */
+            int16x4_t in = vreinterpret_s16_s32(vld1_dup_s32((const int32_t *)pDataIn));
+            int32x2_t xn = vget_low_s32(vmovl_s16(in));
+            int32x2_t yn;
+
+            /* yn = A2 * x(n-2) + A1 * x(n-1) + A0 * x(n) in Q15 */
+            yn = vmul_n_s32(xn2, A2);
+            yn = vmla_n_s32(yn, xn1, A1);
+            yn = vmla_n_s32(yn, xn, A0);
+
+            /* yn += (-B2 * y(n-2)) >> 16 + (-B1 * y(n-1)) >> 16 in Q15 */
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(yn2, B2), 16));
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(yn1, B1), 16));
+
+            /* update the delays */
+            yn2 = yn1;
+            yn1 = vshl_n_s32(yn, 1);                /* y(n-1) in Q16 */
+            xn2 = xn1;
+            xn1 = xn;
+
+            /* write the output in Q0, truncated to 16 bits as the reference */
+            in = vmovn_s32(vcombine_s32(vshr_n_s32(yn, 15), yn));
+            vst1_lane_s32((int32_t *)pDataOut, vreinterpret_s32_s16(in), 0);
+
+            pDataIn += 2;
+            pDataOut += 2;
+        }
+
+        vst1_s32(pDelays, xn1);
+        vst1_s32(pDelays + 2, xn2);
+        vst1_s32(pDelays + 4, yn1);
+        vst1_s32(pDelays + 6, yn2);
+    }
+
+#endif /* LVM_NEON */
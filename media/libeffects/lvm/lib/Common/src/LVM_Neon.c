@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LVM_Neon.h"
+
+#ifdef LVM_NEON
+
+#if defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/**********************************************************************************
+   FUNCTION LVM_NeonAvailable
+***********************************************************************************/
+
+LVM_INT16 LVM_NeonAvailable(void)
+{
+#if defined(__arm__)
+    /* 32 bit ARM cores may lack NEON even when the library is built for it */
+    static volatile LVM_INT16 available = -1;
+    if (available < 0)
+    {
+        available = (getauxval(AT_HWCAP) & HWCAP_NEON) != 0 ? LVM_TRUE : LVM_FALSE;
+    }
+    return available;
+#else
+    /* NEON is mandatory on ARMv8 */
+    return LVM_TRUE;
+#endif
+}
+
+#endif /* LVM_NEON */
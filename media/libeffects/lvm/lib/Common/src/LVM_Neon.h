@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LVM_NEON_H_
+#define _LVM_NEON_H_
+
+#include "LVM_Types.h"
+#include "BIQUAD.h"
+
+/**********************************************************************************
+   NEON VARIANTS OF THE HOT FILTER KERNELS
+
+   The NEON kernels process the left and right channels in the two lanes of a
+   vector and produce bit-exact output against the C reference: the 32x16 bit
+   products of MUL32x16INTO32() are computed exactly in 64 bits before the shift,
+   and all additions wrap as in the reference. They are used by the reference
+   functions when LVM_NeonAvailable() returns LVM_TRUE.
+***********************************************************************************/
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define LVM_NEON
+#endif
+
+#ifdef LVM_NEON
+
+/* Returns LVM_TRUE if the CPU executing the library supports NEON */
+LVM_INT16 LVM_NeonAvailable(void);
+
+void BQ_2I_D16F32C15_TRC_WRA_01_NEON (      Biquad_Instance_t       *pInstance,
+                                            LVM_INT16                    *pDataIn,
+                                            LVM_INT16                    *pDataOut,
+                                            LVM_INT16                    NrSamples);
+
+void PK_2I_D32F32C14G11_TRC_WRA_01_NEON (   Biquad_Instance_t       *pInstance,
+                                            LVM_INT32                    *pDataIn,
+                                            LVM_INT32                    *pDataOut,
+                                            LVM_INT16                    NrSamples);
+
+#endif /* LVM_NEON */
+
+#endif /* _LVM_NEON_H_ */
@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "PK_2I_D32F32CssGss_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_Neon.h"
 
 /**************************************************************************
  ASSUMPTIONS:
@@ -47,6 +48,14 @@ void PK_2I_D32F32C14G11_TRC_WRA_01 ( Biquad_Instance_t       *pInstance,
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
 
+#ifdef LVM_NEON
+        if (LVM_NeonAvailable())
+        {
+            PK_2I_D32F32C14G11_TRC_WRA_01_NEON(pInstance, pDataIn, pDataOut, NrSamples);
+            return;
+        }
+#endif
+
          for (ii = NrSamples; ii != 0; ii--)
          {
 
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LVM_Neon.h"
+
+#ifdef LVM_NEON
+
+#include <arm_neon.h>
+#include "PK_2I_D32F32CssGss_TRC_WRA_01_Private.h"
+
+/**************************************************************************
+ NEON version of PK_2I_D32F32C14G11_TRC_WRA_01, see there for the
+ coefficient and delay formats. Lane 0 is the left channel and lane 1
+ the right channel.
+***************************************************************************/
+
+void PK_2I_D32F32C14G11_TRC_WRA_01_NEON (   Biquad_Instance_t       *pInstance,
+                                            LVM_INT32                    *pDataIn,
+                                            LVM_INT32                    *pDataOut,
+                                            LVM_INT16                    NrSamples)
+    {
+        PFilter_State pBiquadState = (PFilter_State) pInstance;
+        LVM_INT32 *pDelays = pBiquadState->pDelays;
+        const LVM_INT32 A0 = pBiquadState->coefs[0];
+        const LVM_INT32 B2 = pBiquadState->coefs[1];
+        const LVM_INT32 B1 = pBiquadState->coefs[2];
+        const LVM_INT32 G = pBiquadState->coefs[3];
+        int32x2_t xn1 = vld1_s32(pDelays);          /* x(n-1) in Q0 */
+        int32x2_t xn2 = vld1_s32(pDelays + 2);      /* x(n-2) in Q0 */
+        int32x2_t yn1 = vld1_s32(pDelays + 4);      /* y(n-1) in Q0 */
+        int32x2_t yn2 = vld1_s32(pDelays + 6);      /* y(n-2) in Q0 */
+        LVM_INT16 ii;
+
+        for (ii = NrSamples; ii != 0; ii--)
+        {
+            int32x2_t xn = vld1_s32(pDataIn);
+            int32x2_t yn, ynO;
+
+            /* yn = (A0 * (x(n) - x(n-2))) >> 14 in Q0 */
+            yn = vshrn_n_s64(vmull_n_s32(vsub_s32(xn, xn2), A0), 14);
+
+            /* yn += (-B2 * y(n-2)) >> 14 + (-B1 * y(n-1)) >> 14 in Q0 */
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(yn2, B2), 14));
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(yn1, B1), 14));
+
+            /* ynO = ((Gain * yn) >> 11) + x(n) in Q0 */
+            ynO = vadd_s32(vshrn_n_s64(vmull_n_s32(yn, G), 11), xn);
+
+            /* update the delays */
+            yn2 = yn1;
+            yn1 = yn;
+            xn2 = xn1;
+            xn1 = xn;
+
+            vst1_s32(pDataOut, ynO);
+
+            pDataIn += 2;
+            pDataOut += 2;
+        }
+
+        vst1_s32(pDelays, xn1);
+        vst1_s32(pDelays + 2, xn2);
+        vst1_s32(pDelays + 4, yn1);
+        vst1_s32(pDelays + 6, yn2);
+    }
+
+#endif /* LVM_NEON */
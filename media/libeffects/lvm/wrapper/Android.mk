@@ -36,7 +36,8 @@ include $(CLEAR_VARS)
 LOCAL_ARM_MODE := arm
 
 LOCAL_SRC_FILES:= \
-    Reverb/EffectReverb.cpp
+    Reverb/EffectReverb.cpp \
+    Reverb/ReverbConvolver.cpp
 
 LOCAL_CFLAGS += -fvisibility=hidden
 
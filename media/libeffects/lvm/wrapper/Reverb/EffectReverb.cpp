@@ -26,7 +26,9 @@
 #include <string.h>
 
 #include <cutils/log.h>
+#include <cutils/properties.h>
 #include "EffectReverb.h"
+#include "ReverbConvolver.h"
 // from Reverb/lib
 #include "LVREV.h"
 
@@ -161,6 +163,10 @@ struct ReverbContext{
     LVM_INT16                       prevLeftVolume;
     LVM_INT16                       prevRightVolume;
     int                             volumeMode;
+    // preset reverbs only: partition size of the convolution backend, 0 if disabled, and
+    // the convolver replacing LVREV for the current preset, if any
+    uint32_t                        convolutionBlockFrames;
+    ReverbConvolver                 *convolver;
 };
 
 enum {
@@ -186,6 +192,7 @@ int  Reverb_getParameter    (ReverbContext *pContext,
                              uint32_t      *pValueSize,
                              void          *pValue);
 int Reverb_LoadPreset       (ReverbContext   *pContext);
+void Reverb_updateConvolver (ReverbContext   *pContext);
 
 /* Effect Library Interface Implementation */
 
@@ -242,6 +249,22 @@ extern "C" int EffectCreate(const effect_uuid_t *uuid,
         ALOGV("\tEffectCreate - ENVIRONMENTAL");
     }
 
+    // The preset rooms can optionally be rendered by uniformly partitioned convolution with
+    // their impulse response, shared by all instances using the same preset. The partition
+    // size in frames, which is also the added latency, is given by the property.
+    pContext->convolutionBlockFrames = 0;
+    pContext->convolver = NULL;
+    if (pContext->preset) {
+        char value[PROPERTY_VALUE_MAX];
+        if (property_get("audio.reverb.convolution_block", value, NULL) > 0) {
+            uint32_t blockFrames = strtoul(value, NULL, 0);
+            if (ReverbKernel::isValidBlockSize(blockFrames)) {
+                pContext->convolutionBlockFrames = blockFrames;
+                ALOGV("\tEffectCreate - convolution block %u", blockFrames);
+            }
+        }
+    }
+
     ALOGV("\tEffectCreate - Calling Reverb_init");
     ret = Reverb_init(pContext);
 
@@ -291,6 +314,7 @@ extern "C" int EffectRelease(effect_handle_t handle){
     #endif
     free(pContext->InFrames32);
     free(pContext->OutFrames32);
+    delete pContext->convolver;
     Reverb_free(pContext);
     delete pContext;
     return 0;
@@ -468,11 +492,17 @@ int process( LVM_INT16     *pIn,
             ALOGV("\tZeroing %d samples per frame at the end of call", samplesPerFrame);
         }
 
-        /* Process the samples, producing a stereo output */
-        LvmStatus = LVREV_Process(pContext->hInstance,      /* Instance handle */
-                                  pContext->InFrames32,     /* Input buffer */
-                                  pContext->OutFrames32,    /* Output buffer */
-                                  frameCount);              /* Number of samples to read */
+        if (pContext->convolver != NULL) {
+            /* Convolve with the preset impulse response, with the same output format */
+            pContext->convolver->process(pContext->InFrames32, samplesPerFrame,
+                                         pContext->OutFrames32, frameCount);
+        } else {
+            /* Process the samples, producing a stereo output */
+            LvmStatus = LVREV_Process(pContext->hInstance,      /* Instance handle */
+                                      pContext->InFrames32,     /* Input buffer */
+                                      pContext->OutFrames32,    /* Output buffer */
+                                      frameCount);              /* Number of samples to read */
+        }
     }
 
     LVM_ERROR_CHECK(LvmStatus, "LVREV_Process", "process")
@@ -668,6 +698,11 @@ int Reverb_setConfig(ReverbContext *pContext, effect_config_t *pConfig){
         if(LvmStatus != LVREV_SUCCESS) return -EINVAL;
         //ALOGV("\tReverb_setConfig Succesfully called LVREV_SetControlParameters\n");
         pContext->SampleRate = SampleRate;
+
+        // the convolution kernel depends on the sampling rate: reload the preset
+        if (pContext->convolver != NULL) {
+            pContext->curPreset = REVERB_PRESET_LAST + 1;
+        }
     }else{
         //ALOGV("\tReverb_setConfig keep sampling rate at %d", SampleRate);
     }
@@ -1510,9 +1545,116 @@ int Reverb_LoadPreset(ReverbContext   *pContext)
         ReverbSetDensity(pContext, preset->density);
     }
 
+    if (pContext->convolutionBlockFrames != 0) {
+        Reverb_updateConvolver(pContext);
+    }
     return 0;
 }
 
+//----------------------------------------------------------------------------
+// Reverb_renderPresetImpulse()
+//----------------------------------------------------------------------------
+// Purpose:
+// Render the impulse response of a preset through a private LVREV instance, in
+// the 32 bit domain of InFrames32 and OutFrames32 (ReverbKernel::render_t)
+//
+//----------------------------------------------------------------------------
+size_t Reverb_renderPresetImpulse(const ReverbKernel::Key& key,
+                                  float *left, float *right, size_t maxFrames)
+{
+    // large enough for precision, small enough to never saturate LVREV
+    const LVM_INT32 kImpulse = 1 << 22;
+    // let the LVREV parameter smoothing settle before the impulse
+    const size_t settleFrames = key.sampleRate / 2;
+    const int samplesPerFrame = key.auxiliary ? 1 : 2;
+
+    ReverbContext context;
+    context.itfe = &gReverbInterface;
+    context.hInstance = NULL;
+    context.auxiliary = key.auxiliary;
+    context.preset = true;
+    context.curPreset = REVERB_PRESET_LAST + 1;
+    context.nextPreset = key.preset;
+    context.convolutionBlockFrames = 0;
+    context.convolver = NULL;
+    if (Reverb_init(&context) != 0) {
+        return 0;
+    }
+    effect_config_t config = context.config;
+    config.inputCfg.samplingRate = key.sampleRate;
+    config.outputCfg.samplingRate = key.sampleRate;
+    if (Reverb_setConfig(&context, &config) != 0) {
+        Reverb_free(&context);
+        return 0;
+    }
+    Reverb_LoadPreset(&context);
+
+    LVM_INT32 in[MAX_CALL_SIZE * 2];
+    LVM_INT32 out[MAX_CALL_SIZE * 2];
+    size_t rendered = 0;
+    size_t frame = 0;
+    while (rendered < maxFrames) {
+        size_t frames = MAX_CALL_SIZE;
+        if (frame < settleFrames && frame + frames > settleFrames) {
+            frames = settleFrames - frame;  // the impulse starts a call
+        } else if (frame >= settleFrames && frames > maxFrames - rendered) {
+            frames = maxFrames - rendered;
+        }
+        memset(in, 0, sizeof(in));
+        if (frame == settleFrames) {
+            for (int c = 0; c < samplesPerFrame; c++) {
+                in[c] = kImpulse;
+            }
+        }
+        if (LVREV_Process(context.hInstance, in, out, frames) != LVREV_SUCCESS) {
+            break;
+        }
+        if (frame >= settleFrames) {
+            for (size_t i = 0; i < frames; i++) {
+                left[rendered + i] = (float)out[2 * i] / kImpulse;
+                right[rendered + i] = (float)out[2 * i + 1] / kImpulse;
+            }
+            rendered += frames;
+        }
+        frame += frames;
+    }
+    Reverb_free(&context);
+    return rendered;
+}
+
+//----------------------------------------------------------------------------
+// Reverb_updateConvolver()
+//----------------------------------------------------------------------------
+// Purpose:
+// Switch the convolution backend to the current preset and sampling rate
+//
+//----------------------------------------------------------------------------
+void Reverb_updateConvolver(ReverbContext *pContext)
+{
+    ReverbKernel::Key key;
+    key.preset = pContext->curPreset;
+    key.auxiliary = pContext->auxiliary;
+    key.sampleRate = pContext->config.inputCfg.samplingRate;
+    key.blockFrames = pContext->convolutionBlockFrames;
+
+    if (pContext->convolver != NULL) {
+        const ReverbKernel::Key& current = pContext->convolver->key();
+        if (current.preset == key.preset && current.sampleRate == key.sampleRate) {
+            return;
+        }
+        delete pContext->convolver;
+        pContext->convolver = NULL;
+    }
+    if (key.preset == REVERB_PRESET_NONE) {
+        return;
+    }
+    // falls back to LVREV if the kernel cannot be rendered
+    ReverbKernel *kernel = ReverbKernel::acquire(key, Reverb_renderPresetImpulse);
+    if (kernel != NULL) {
+        pContext->convolver = new ReverbConvolver(kernel);
+    }
+}
+
 
 //----------------------------------------------------------------------------
 // Reverb_getParameter()
@@ -1950,6 +2092,9 @@ int Reverb_command(effect_handle_t  self,
             //ALOGV("\tReverb_command cmdCode Case: "
             //        "EFFECT_CMD_RESET start");
             Reverb_setConfig(pContext, &pContext->config);
+            if (pContext->convolver != NULL) {
+                pContext->convolver->reset();
+            }
             break;
 
         case EFFECT_CMD_GET_PARAM:{
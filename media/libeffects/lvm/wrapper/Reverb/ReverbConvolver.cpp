@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ReverbConvolver"
+//#define LOG_NDEBUG 0
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/log.h>
+#include "ReverbConvolver.h"
+
+namespace android {
+
+// In place radix-2 complex FFT on interleaved (re, im) samples.
+class ReverbFft {
+public:
+    explicit ReverbFft(uint32_t size);
+    ~ReverbFft();
+
+    // unnormalized, the inverse transform scales by size
+    void        transform(float *data, bool inverse) const;
+
+private:
+    const uint32_t  mSize;
+    float       *mTwiddles;         // cos and sin of 2 pi k / mSize, for k < mSize / 2
+    uint32_t    *mBitReverse;
+};
+
+ReverbFft::ReverbFft(uint32_t size)
+    : mSize(size),
+      mTwiddles(new float[size]),
+      mBitReverse(new uint32_t[size])
+{
+    for (uint32_t k = 0; k < size / 2; k++) {
+        const double phase = 2. * M_PI * k / size;
+        mTwiddles[2 * k] = cos(phase);
+        mTwiddles[2 * k + 1] = sin(phase);
+    }
+    uint32_t bits = 0;
+    while ((1u << bits) < size) {
+        bits++;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        mBitReverse[i] = r;
+    }
+}
+
+ReverbFft::~ReverbFft()
+{
+    delete[] mTwiddles;
+    delete[] mBitReverse;
+}
+
+void ReverbFft::transform(float *data, bool inverse) const
+{
+    for (uint32_t i = 0; i < mSize; i++) {
+        const uint32_t j = mBitReverse[i];
+        if (i < j) {
+            float t = data[2 * i];
+            data[2 * i] = data[2 * j];
+            data[2 * j] = t;
+            t = data[2 * i + 1];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j + 1] = t;
+        }
+    }
+    // forward is exp(-i 2 pi k n / N)
+    const float sign = inverse ? 1.f : -1.f;
+    for (uint32_t half = 1; half < mSize; half <<= 1) {
+        const uint32_t stride = mSize / (2 * half);
+        for (uint32_t start = 0; start < mSize; start += 2 * half) {
+            for (uint32_t k = 0; k < half; k++) {
+                const float wr = mTwiddles[2 * k * stride];
+                const float wi = sign * mTwiddles[2 * k * stride + 1];
+                float *a = &data[2 * (start + k)];
+                float *b = &data[2 * (start + k + half)];
+                const float tr = b[0] * wr - b[1] * wi;
+                const float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static pthread_mutex_t sKernelLock = PTHREAD_MUTEX_INITIALIZER;
+static ReverbKernel *sKernels;      // protected by sKernelLock
+
+static bool keyEquals(const ReverbKernel::Key& a, const ReverbKernel::Key& b)
+{
+    return a.preset == b.preset && a.auxiliary == b.auxiliary &&
+            a.sampleRate == b.sampleRate && a.blockFrames == b.blockFrames;
+}
+
+bool ReverbKernel::isValidBlockSize(uint32_t blockFrames)
+{
+    return blockFrames >= 64 && blockFrames <= 4096 && (blockFrames & (blockFrames - 1)) == 0;
+}
+
+ReverbKernel::ReverbKernel(const Key& key)
+    : mKey(key), mRefCount(1), mPartitions(0), mSpectra(NULL), mNext(NULL)
+{
+}
+
+ReverbKernel::~ReverbKernel()
+{
+    delete[] mSpectra;
+}
+
+bool ReverbKernel::init(render_t render)
+{
+    const size_t maxFrames = (size_t)mKey.sampleRate * kMaxImpulseMs / 1000;
+    float *left = new float[maxFrames];
+    float *right = new float[maxFrames];
+    size_t frames = render(mKey, left, right, maxFrames);
+
+    // drop the tail below -60 dB of the peak
+    float peak = 0.f;
+    for (size_t i = 0; i < frames; i++) {
+        peak = fmaxf(peak, fmaxf(fabsf(left[i]), fabsf(right[i])));
+    }
+    const float floor = peak * 1e-3f;
+    while (frames > 0 && fabsf(left[frames - 1]) <= floor && fabsf(right[frames - 1]) <= floor) {
+        frames--;
+    }
+    if (frames == 0) {
+        delete[] left;
+        delete[] right;
+        return false;
+    }
+
+    const uint32_t B = mKey.blockFrames;
+    const uint32_t N = 2 * B;
+    const size_t bins = 2 * (B + 1);    // floats per half spectrum
+    mPartitions = (frames + B - 1) / B;
+    mSpectra = new float[mPartitions * 2 * bins];
+
+    ReverbFft fft(N);
+    float *work = new float[2 * N];
+    for (size_t p = 0; p < mPartitions; p++) {
+        for (int channel = 0; channel < 2; channel++) {
+            const float *ir = channel == 0 ? left : right;
+            memset(work, 0, 2 * N * sizeof(float));
+            for (uint32_t i = 0; i < B && p * B + i < frames; i++) {
+                // fold the 1 / N scaling of the inverse transform into the kernel
+                work[2 * i] = ir[p * B + i] / N;
+            }
+            fft.transform(work, false /*inverse*/);
+            memcpy(&mSpectra[(2 * p + channel) * bins], work, bins * sizeof(float));
+        }
+    }
+    delete[] work;
+    delete[] left;
+    delete[] right;
+    ALOGV("kernel preset %u rate %u: %zu frames, %zu partitions of %u",
+            mKey.preset, mKey.sampleRate, frames, mPartitions, B);
+    return true;
+}
+
+ReverbKernel *ReverbKernel::acquire(const Key& key, render_t render)
+{
+    pthread_mutex_lock(&sKernelLock);
+    for (ReverbKernel *kernel = sKernels; kernel != NULL; kernel = kernel->mNext) {
+        if (keyEquals(kernel->mKey, key)) {
+            kernel->mRefCount++;
+            pthread_mutex_unlock(&sKernelLock);
+            return kernel;
+        }
+    }
+    // rendering is done with the lock held, so that a kernel is never rendered twice
+    ReverbKernel *kernel = new ReverbKernel(key);
+    if (!kernel->init(render)) {
+        ALOGW("cannot render preset %u at %u Hz", key.preset, key.sampleRate);
+        delete kernel;
+        kernel = NULL;
+    } else {
+        kernel->mNext = sKernels;
+        sKernels = kernel;
+    }
+    pthread_mutex_unlock(&sKernelLock);
+    return kernel;
+}
+
+void ReverbKernel::release(ReverbKernel *kernel)
+{
+    pthread_mutex_lock(&sKernelLock);
+    if (--kernel->mRefCount == 0) {
+        for (ReverbKernel **link = &sKernels; *link != NULL; link = &(*link)->mNext) {
+            if (*link == kernel) {
+                *link = kernel->mNext;
+                break;
+            }
+        }
+        delete kernel;
+    }
+    pthread_mutex_unlock(&sKernelLock);
+}
+
+// ----------------------------------------------------------------------------
+
+ReverbConvolver::ReverbConvolver(ReverbKernel *kernel)
+    : mKernel(kernel),
+      mBlockFrames(kernel->mKey.blockFrames),
+      mFftSize(2 * mBlockFrames),
+      mFftEngine(new ReverbFft(mFftSize)),
+      mInput(new float[mFftSize]),
+      mFft(new float[2 * mFftSize]),
+      mHistory(new float[kernel->mPartitions * 2 * (mBlockFrames + 1)]),
+      mAccumulator(new float[4 * (mBlockFrames + 1)]),
+      mOutput(new float[2 * mBlockFrames])
+{
+    reset();
+}
+
+ReverbConvolver::~ReverbConvolver()
+{
+    delete mFftEngine;
+    delete[] mInput;
+    delete[] mFft;
+    delete[] mHistory;
+    delete[] mAccumulator;
+    delete[] mOutput;
+    ReverbKernel::release(mKernel);
+}
+
+void ReverbConvolver::reset()
+{
+    memset(mInput, 0, mFftSize * sizeof(float));
+    memset(mHistory, 0, mKernel->mPartitions * 2 * (mBlockFrames + 1) * sizeof(float));
+    memset(mOutput, 0, 2 * mBlockFrames * sizeof(float));
+    mHistoryIndex = 0;
+    mPosition = 0;
+}
+
+void ReverbConvolver::process(const int32_t *in, int inChannels, int32_t *out, size_t frames)
+{
+    float *current = &mInput[mBlockFrames];
+    for (size_t i = 0; i < frames; i++) {
+        if (inChannels == 2) {
+            // same mono downmix as LVREV
+            current[mPosition] = (float)((in[2 * i] >> 1) + (in[2 * i + 1] >> 1));
+        } else {
+            current[mPosition] = (float)in[i];
+        }
+        out[2 * i] = (int32_t)mOutput[2 * mPosition];
+        out[2 * i + 1] = (int32_t)mOutput[2 * mPosition + 1];
+        if (++mPosition == mBlockFrames) {
+            processBlock();
+            mPosition = 0;
+        }
+    }
+}
+
+// Overlap-save: the spectrum of the last two input blocks is multiplied with each kernel
+// partition against the input spectrum as old as the partition, and the second half of the
+// inverse transform is the next output block.
+void ReverbConvolver::processBlock()
+{
+    const uint32_t B = mBlockFrames;
+    const uint32_t N = mFftSize;
+    const size_t bins = 2 * (B + 1);
+    const size_t partitions = mKernel->mPartitions;
+
+    for (uint32_t i = 0; i < N; i++) {
+        mFft[2 * i] = mInput[i];
+        mFft[2 * i + 1] = 0.f;
+    }
+    memmove(mInput, &mInput[B], B * sizeof(float));
+    mFftEngine->transform(mFft, false /*inverse*/);
+
+    mHistoryIndex = mHistoryIndex == 0 ? partitions - 1 : mHistoryIndex - 1;
+    memcpy(&mHistory[mHistoryIndex * bins], mFft, bins * sizeof(float));
+
+    float *accL = mAccumulator;
+    float *accR = &mAccumulator[bins];
+    memset(mAccumulator, 0, 2 * bins * sizeof(float));
+    size_t slot = mHistoryIndex;
+    for (size_t p = 0; p < partitions; p++) {
+        const float *x = &mHistory[slot * bins];
+        const float *hl = &mKernel->mSpectra[2 * p * bins];
+        const float *hr = hl + bins;
+        for (size_t k = 0; k < bins; k += 2) {
+            const float xr = x[k];
+            const float xi = x[k + 1];
+            accL[k] += xr * hl[k] - xi * hl[k + 1];
+            accL[k + 1] += xr * hl[k + 1] + xi * hl[k];
+            accR[k] += xr * hr[k] - xi * hr[k + 1];
+            accR[k + 1] += xr * hr[k + 1] + xi * hr[k];
+        }
+        if (++slot == partitions) {
+            slot = 0;
+        }
+    }
+
+    // Both outputs are real, so a single inverse transform of L + i R yields L in the real
+    // part and R in the imaginary part; bins above N / 2 follow from conjugate symmetry.
+    for (uint32_t k = 0; k <= B; k++) {
+        mFft[2 * k] = accL[2 * k] - accR[2 * k + 1];
+        mFft[2 * k + 1] = accL[2 * k + 1] + accR[2 * k];
+    }
+    for (uint32_t k = B + 1; k < N; k++) {
+        const uint32_t m = N - k;
+        mFft[2 * k] = accL[2 * m] + accR[2 * m + 1];
+        mFft[2 * k + 1] = -accL[2 * m + 1] + accR[2 * m];
+    }
+    mFftEngine->transform(mFft, true /*inverse*/);
+    for (uint32_t i = 0; i < B; i++) {
+        mOutput[2 * i] = mFft[2 * (B + i)];
+        mOutput[2 * i + 1] = mFft[2 * (B + i) + 1];
+    }
+}
+
+}   // namespace android
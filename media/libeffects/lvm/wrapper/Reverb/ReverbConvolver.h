@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_REVERB_CONVOLVER_H_
+#define ANDROID_REVERB_CONVOLVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+class ReverbFft;
+
+// Uniformly partitioned FFT convolution of a mono input with the stereo impulse response
+// of a reverb preset.  The frequency domain partitions of an impulse response are held by
+// a ReverbKernel, which is shared by all the convolvers using the same preset, sample rate
+// and block size.  Each convolver adds a latency of one block.
+
+class ReverbKernel {
+public:
+    struct Key {
+        uint16_t    preset;
+        bool        auxiliary;      // rendered through an auxiliary (mono input) reverb
+        uint32_t    sampleRate;
+        uint32_t    blockFrames;    // partition size, a power of 2
+    };
+
+    // Renders at most maxFrames of the preset impulse response, as the output for an
+    // input impulse of amplitude 1.0, and returns the number of frames rendered.
+    typedef size_t (*render_t)(const Key& key, float *left, float *right, size_t maxFrames);
+
+    // Returns the kernel for key, rendering it on first use, or NULL on failure.
+    // Must be balanced by release().
+    static ReverbKernel *acquire(const Key& key, render_t render);
+    static void release(ReverbKernel *kernel);
+
+    static bool isValidBlockSize(uint32_t blockFrames);
+
+    // maximum duration of an impulse response, longer tails are truncated
+    static const uint32_t kMaxImpulseMs = 3000;
+
+private:
+    friend class ReverbConvolver;
+
+    explicit ReverbKernel(const Key& key);
+    ~ReverbKernel();
+    bool init(render_t render);
+
+    const Key   mKey;
+    int         mRefCount;
+    size_t      mPartitions;
+    float       *mSpectra;          // per partition: left then right, (B + 1) complex bins each
+    ReverbKernel *mNext;            // in the list of cached kernels
+};
+
+class ReverbConvolver {
+public:
+    // Takes over the caller's reference to kernel.
+    explicit ReverbConvolver(ReverbKernel *kernel);
+    ~ReverbConvolver();
+
+    // in holds frames of inChannels (1 or 2, averaged) 32 bit samples, out receives frames of
+    // stereo 32 bit samples delayed by blockFrames(); in and out must not overlap.
+    void        process(const int32_t *in, int inChannels, int32_t *out, size_t frames);
+    void        reset();
+
+    uint32_t    blockFrames() const { return mBlockFrames; }
+    const ReverbKernel::Key& key() const { return mKernel->mKey; }
+
+private:
+    void        processBlock();
+
+    ReverbKernel * const mKernel;
+    const uint32_t  mBlockFrames;
+    const uint32_t  mFftSize;       // 2 * mBlockFrames
+    ReverbFft   *mFftEngine;
+    float       *mInput;            // previous and current input block, mFftSize real samples
+    float       *mFft;              // mFftSize complex work samples
+    float       *mHistory;          // mPartitions input spectra, (B + 1) complex bins each
+    float       *mAccumulator;      // left and right output spectra, (B + 1) complex bins each
+    float       *mOutput;           // last block output, stereo
+    size_t      mHistoryIndex;      // slot of the most recent input spectrum
+    uint32_t    mPosition;          // frames of the current block received so far
+};
+
+}   // namespace android
+
+#endif  // ANDROID_REVERB_CONVOLVER_H_
@@ -131,6 +131,9 @@ struct preproc_session_s {
     size_t revBufSize;                  // reverse channel input buffer size
     size_t framesRev;                   // number of frames in reverse channel input buffer
     SpeexResamplerState *revResampler;  // handle on reverse channel input speex resampler
+    uint32_t procFrameCnt;              // number of 10 ms frames processed since configuration
+    nsecs_t procTotalNs;                // total and longest time spent processing one frame,
+    nsecs_t procMaxNs;                  // including resampling
 };
 
 #ifdef DUAL_MIC_TEST
@@ -846,6 +849,12 @@ int Session_ReleaseEffect(preproc_session_t *session,
     ALOGW_IF(Effect_Release(fx) != 0, " Effect_Release() failed for proc ID %d", fx->procId);
     session->createdMsk &= ~(1<<fx->procId);
     if (session->createdMsk == 0) {
+        if (session->procFrameCnt != 0) {
+            ALOGD("session %d processed %u frames of %zu, mean %lld us, max %lld us",
+                  session->id, session->procFrameCnt, session->apmFrameCount,
+                  (long long)(session->procTotalNs / session->procFrameCnt / 1000),
+                  (long long)(session->procMaxNs / 1000));
+        }
         webrtc::AudioProcessing::Destroy(session->apm);
         session->apm = NULL;
         delete session->procFrame;
@@ -949,6 +958,9 @@ int Session_SetConfig(preproc_session_t *session, effect_config_t *config)
     session->outBufSize = 0;
     session->framesIn = 0;
     session->framesOut = 0;
+    session->procFrameCnt = 0;
+    session->procTotalNs = 0;
+    session->procMaxNs = 0;
 
 
     if (session->inResampler != NULL) {
@@ -1156,6 +1168,77 @@ const effect_descriptor_t *PreProc_GetDescriptor(const effect_uuid_t *uuid)
 
 extern "C" {
 
+//------------------------------------------------------------------------------
+// Session output staging
+//------------------------------------------------------------------------------
+
+// Appends the processed frame in procFrame to outBuf, resampling it if needed
+void Session_StageOutput(preproc_session_t *session)
+{
+    if (session->outBufSize < session->framesOut + session->frameCount) {
+        session->outBufSize = session->framesOut + session->frameCount;
+        session->outBuf = (int16_t *)realloc(session->outBuf,
+                          session->outBufSize * session->outChannelCount * sizeof(int16_t));
+    }
+
+    if (session->outResampler != NULL) {
+        spx_uint32_t frIn = session->apmFrameCount;
+        spx_uint32_t frOut = session->frameCount;
+        if (session->inChannelCount == 1) {
+            speex_resampler_process_int(session->outResampler,
+                                0,
+                                session->procFrame->_payloadData,
+                                &frIn,
+                                session->outBuf + session->framesOut * session->outChannelCount,
+                                &frOut);
+        } else {
+            speex_resampler_process_interleaved_int(session->outResampler,
+                                session->procFrame->_payloadData,
+                                &frIn,
+                                session->outBuf + session->framesOut * session->outChannelCount,
+                                &frOut);
+        }
+        session->framesOut += frOut;
+    } else {
+        memcpy(session->outBuf + session->framesOut * session->outChannelCount,
+               session->procFrame->_payloadData,
+               session->frameCount * session->outChannelCount * sizeof(int16_t));
+        session->framesOut += session->frameCount;
+    }
+}
+
+// Moves staged frames from outBuf to outBuffer, up to frame index limit of outBuffer
+void Session_WriteOutput(preproc_session_t *session,
+                         audio_buffer_t *outBuffer,
+                         size_t *framesWr,
+                         size_t limit)
+{
+    if (*framesWr >= limit || session->framesOut == 0) {
+        return;
+    }
+    size_t fr = session->framesOut;
+    if (limit - *framesWr < fr) {
+        fr = limit - *framesWr;
+    }
+    memcpy(outBuffer->s16 + *framesWr * session->outChannelCount,
+           session->outBuf,
+           fr * session->outChannelCount * sizeof(int16_t));
+    memmove(session->outBuf,
+            session->outBuf + fr * session->outChannelCount,
+            (session->framesOut - fr) * session->outChannelCount * sizeof(int16_t));
+    session->framesOut -= fr;
+    *framesWr += fr;
+}
+
+void Session_UpdateProcessStats(preproc_session_t *session, nsecs_t duration)
+{
+    session->procFrameCnt++;
+    session->procTotalNs += duration;
+    if (duration > session->procMaxNs) {
+        session->procMaxNs = duration;
+    }
+}
+
 //------------------------------------------------------------------------------
 // Effect Control Interface Implementation
 //------------------------------------------------------------------------------
@@ -1186,148 +1269,98 @@ int PreProcessingFx_Process(effect_handle_t     self,
 
     if ((session->processedMsk & session->enabledMsk) == session->enabledMsk) {
         effect->session->processedMsk = 0;
-        size_t framesRq = outBuffer->frameCount;
+        // All enabled pre processors of the session run in the same APM ProcessStream() call,
+        // made by the last effect of the round for every complete 10 ms frame of input.
+        // When possible the result is written directly to the output buffer; it is only
+        // staged in outBuf when resampling, or when it would overwrite unread input.
+        const bool inPlace = inBuffer->raw == outBuffer->raw;
+        const size_t framesRq = outBuffer->frameCount;
+        size_t framesRd = 0;
         size_t framesWr = 0;
-        if (session->framesOut) {
-            size_t fr = session->framesOut;
-            if (outBuffer->frameCount < fr) {
-                fr = outBuffer->frameCount;
-            }
-            memcpy(outBuffer->s16,
-                  session->outBuf,
-                  fr * session->outChannelCount * sizeof(int16_t));
-            memcpy(session->outBuf,
-                  session->outBuf + fr * session->outChannelCount,
-                  (session->framesOut - fr) * session->outChannelCount * sizeof(int16_t));
-            session->framesOut -= fr;
-            framesWr += fr;
-        }
-        outBuffer->frameCount = framesWr;
-        if (framesWr == framesRq) {
-            inBuffer->frameCount = 0;
-            return 0;
-        }
 
-        if (session->inResampler != NULL) {
+        while (framesRd < inBuffer->frameCount) {
             size_t fr = session->frameCount - session->framesIn;
-            if (inBuffer->frameCount < fr) {
-                fr = inBuffer->frameCount;
+            if (inBuffer->frameCount - framesRd < fr) {
+                fr = inBuffer->frameCount - framesRd;
             }
-            if (session->inBufSize < session->framesIn + fr) {
-                session->inBufSize = session->framesIn + fr;
-                session->inBuf = (int16_t *)realloc(session->inBuf,
+            const int16_t *in = inBuffer->s16 + framesRd * session->inChannelCount;
+            if (session->inResampler != NULL) {
+                if (session->inBufSize < session->framesIn + fr) {
+                    session->inBufSize = session->framesIn + fr;
+                    session->inBuf = (int16_t *)realloc(session->inBuf,
                                  session->inBufSize * session->inChannelCount * sizeof(int16_t));
-            }
-            memcpy(session->inBuf + session->framesIn * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
-#ifdef DUAL_MIC_TEST
-            pthread_mutex_lock(&gPcmDumpLock);
-            if (gPcmDumpFh != NULL) {
-                fwrite(inBuffer->raw,
-                       fr * session->inChannelCount * sizeof(int16_t), 1, gPcmDumpFh);
-            }
-            pthread_mutex_unlock(&gPcmDumpLock);
-#endif
-
-            session->framesIn += fr;
-            inBuffer->frameCount = fr;
-            if (session->framesIn < session->frameCount) {
-                return 0;
-            }
-            spx_uint32_t frIn = session->framesIn;
-            spx_uint32_t frOut = session->apmFrameCount;
-            if (session->inChannelCount == 1) {
-                speex_resampler_process_int(session->inResampler,
-                                            0,
-                                            session->inBuf,
-                                            &frIn,
-                                            session->procFrame->_payloadData,
-                                            &frOut);
+                }
+                memcpy(session->inBuf + session->framesIn * session->inChannelCount,
+                       in,
+                       fr * session->inChannelCount * sizeof(int16_t));
             } else {
-                speex_resampler_process_interleaved_int(session->inResampler,
-                                                        session->inBuf,
-                                                        &frIn,
-                                                        session->procFrame->_payloadData,
-                                                        &frOut);
-            }
-            memcpy(session->inBuf,
-                   session->inBuf + frIn * session->inChannelCount,
-                   (session->framesIn - frIn) * session->inChannelCount * sizeof(int16_t));
-            session->framesIn -= frIn;
-        } else {
-            size_t fr = session->frameCount - session->framesIn;
-            if (inBuffer->frameCount < fr) {
-                fr = inBuffer->frameCount;
+                memcpy(session->procFrame->_payloadData +
+                               session->framesIn * session->inChannelCount,
+                       in,
+                       fr * session->inChannelCount * sizeof(int16_t));
             }
-            memcpy(session->procFrame->_payloadData + session->framesIn * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
-
 #ifdef DUAL_MIC_TEST
             pthread_mutex_lock(&gPcmDumpLock);
             if (gPcmDumpFh != NULL) {
-                fwrite(inBuffer->raw,
-                       fr * session->inChannelCount * sizeof(int16_t), 1, gPcmDumpFh);
+                fwrite(in, fr * session->inChannelCount * sizeof(int16_t), 1, gPcmDumpFh);
             }
             pthread_mutex_unlock(&gPcmDumpLock);
 #endif
-
             session->framesIn += fr;
-            inBuffer->frameCount = fr;
+            framesRd += fr;
             if (session->framesIn < session->frameCount) {
-                return 0;
+                break;
             }
-            session->framesIn = 0;
-        }
-        session->procFrame->_payloadDataLengthInSamples =
-                session->apmFrameCount * session->inChannelCount;
-
-        effect->session->apm->ProcessStream(session->procFrame);
-
-        if (session->outBufSize < session->framesOut + session->frameCount) {
-            session->outBufSize = session->framesOut + session->frameCount;
-            session->outBuf = (int16_t *)realloc(session->outBuf,
-                              session->outBufSize * session->outChannelCount * sizeof(int16_t));
-        }
 
-        if (session->outResampler != NULL) {
-            spx_uint32_t frIn = session->apmFrameCount;
-            spx_uint32_t frOut = session->frameCount;
-            if (session->inChannelCount == 1) {
-                speex_resampler_process_int(session->outResampler,
-                                    0,
-                                    session->procFrame->_payloadData,
-                                    &frIn,
-                                    session->outBuf + session->framesOut * session->outChannelCount,
-                                    &frOut);
+            const nsecs_t start = systemTime();
+            if (session->inResampler != NULL) {
+                spx_uint32_t frIn = session->framesIn;
+                spx_uint32_t frOut = session->apmFrameCount;
+                if (session->inChannelCount == 1) {
+                    speex_resampler_process_int(session->inResampler,
+                                                0,
+                                                session->inBuf,
+                                                &frIn,
+                                                session->procFrame->_payloadData,
+                                                &frOut);
+                } else {
+                    speex_resampler_process_interleaved_int(session->inResampler,
+                                                            session->inBuf,
+                                                            &frIn,
+                                                            session->procFrame->_payloadData,
+                                                            &frOut);
+                }
+                memcpy(session->inBuf,
+                       session->inBuf + frIn * session->inChannelCount,
+                       (session->framesIn - frIn) * session->inChannelCount * sizeof(int16_t));
+                session->framesIn -= frIn;
             } else {
-                speex_resampler_process_interleaved_int(session->outResampler,
-                                    session->procFrame->_payloadData,
-                                    &frIn,
-                                    session->outBuf + session->framesOut * session->outChannelCount,
-                                    &frOut);
+                session->framesIn = 0;
             }
-            session->framesOut += frOut;
-        } else {
-            memcpy(session->outBuf + session->framesOut * session->outChannelCount,
-                   session->procFrame->_payloadData,
-                   session->frameCount * session->outChannelCount * sizeof(int16_t));
-            session->framesOut += session->frameCount;
-        }
-        size_t fr = session->framesOut;
-        if (framesRq - framesWr < fr) {
-            fr = framesRq - framesWr;
+            session->procFrame->_payloadDataLengthInSamples =
+                    session->apmFrameCount * session->inChannelCount;
+
+            session->apm->ProcessStream(session->procFrame);
+
+            if (session->outResampler == NULL && session->framesOut == 0 &&
+                    framesWr + session->frameCount <= framesRq &&
+                    (!inPlace || framesWr + session->frameCount <= framesRd)) {
+                memcpy(outBuffer->s16 + framesWr * session->outChannelCount,
+                       session->procFrame->_payloadData,
+                       session->frameCount * session->outChannelCount * sizeof(int16_t));
+                framesWr += session->frameCount;
+            } else {
+                Session_StageOutput(session);
+                // in place, only overwrite input already consumed
+                Session_WriteOutput(session, outBuffer, &framesWr,
+                                    inPlace && framesRd < framesRq ? framesRd : framesRq);
+            }
+            Session_UpdateProcessStats(session, systemTime() - start);
         }
-        memcpy(outBuffer->s16 + framesWr * session->outChannelCount,
-              session->outBuf,
-              fr * session->outChannelCount * sizeof(int16_t));
-        memcpy(session->outBuf,
-              session->outBuf + fr * session->outChannelCount,
-              (session->framesOut - fr) * session->outChannelCount * sizeof(int16_t));
-        session->framesOut -= fr;
-        outBuffer->frameCount += fr;
+        Session_WriteOutput(session, outBuffer, &framesWr, framesRq);
 
+        inBuffer->frameCount = framesRd;
+        outBuffer->frameCount = framesWr;
         return 0;
     } else {
         return -ENODATA;
@@ -1738,63 +1771,64 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
 
     if ((session->revProcessedMsk & session->revEnabledMsk) == session->revEnabledMsk) {
         effect->session->revProcessedMsk = 0;
-        if (session->revResampler != NULL) {
+        // analyze every complete 10 ms frame of far end reference available
+        size_t framesRd = 0;
+        while (framesRd < inBuffer->frameCount) {
             size_t fr = session->frameCount - session->framesRev;
-            if (inBuffer->frameCount < fr) {
-                fr = inBuffer->frameCount;
+            if (inBuffer->frameCount - framesRd < fr) {
+                fr = inBuffer->frameCount - framesRd;
             }
-            if (session->revBufSize < session->framesRev + fr) {
-                session->revBufSize = session->framesRev + fr;
-                session->revBuf = (int16_t *)realloc(session->revBuf,
+            const int16_t *in = inBuffer->s16 + framesRd * session->inChannelCount;
+            if (session->revResampler != NULL) {
+                if (session->revBufSize < session->framesRev + fr) {
+                    session->revBufSize = session->framesRev + fr;
+                    session->revBuf = (int16_t *)realloc(session->revBuf,
                                   session->revBufSize * session->inChannelCount * sizeof(int16_t));
+                }
+                memcpy(session->revBuf + session->framesRev * session->inChannelCount,
+                       in,
+                       fr * session->inChannelCount * sizeof(int16_t));
+            } else {
+                // the reference is copied only once, to the frame analyzed by the APM
+                memcpy(session->revFrame->_payloadData +
+                               session->framesRev * session->inChannelCount,
+                       in,
+                       fr * session->inChannelCount * sizeof(int16_t));
             }
-            memcpy(session->revBuf + session->framesRev * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
-
             session->framesRev += fr;
-            inBuffer->frameCount = fr;
+            framesRd += fr;
             if (session->framesRev < session->frameCount) {
-                return 0;
+                break;
             }
-            spx_uint32_t frIn = session->framesRev;
-            spx_uint32_t frOut = session->apmFrameCount;
-            if (session->inChannelCount == 1) {
-                speex_resampler_process_int(session->revResampler,
-                                            0,
-                                            session->revBuf,
-                                            &frIn,
-                                            session->revFrame->_payloadData,
-                                            &frOut);
+            if (session->revResampler != NULL) {
+                spx_uint32_t frIn = session->framesRev;
+                spx_uint32_t frOut = session->apmFrameCount;
+                if (session->inChannelCount == 1) {
+                    speex_resampler_process_int(session->revResampler,
+                                                0,
+                                                session->revBuf,
+                                                &frIn,
+                                                session->revFrame->_payloadData,
+                                                &frOut);
+                } else {
+                    speex_resampler_process_interleaved_int(session->revResampler,
+                                                            session->revBuf,
+                                                            &frIn,
+                                                            session->revFrame->_payloadData,
+                                                            &frOut);
+                }
+                memcpy(session->revBuf,
+                       session->revBuf + frIn * session->inChannelCount,
+                       (session->framesRev - frIn) * session->inChannelCount * sizeof(int16_t));
+                session->framesRev -= frIn;
             } else {
-                speex_resampler_process_interleaved_int(session->revResampler,
-                                                        session->revBuf,
-                                                        &frIn,
-                                                        session->revFrame->_payloadData,
-                                                        &frOut);
-            }
-            memcpy(session->revBuf,
-                   session->revBuf + frIn * session->inChannelCount,
-                   (session->framesRev - frIn) * session->inChannelCount * sizeof(int16_t));
-            session->framesRev -= frIn;
-        } else {
-            size_t fr = session->frameCount - session->framesRev;
-            if (inBuffer->frameCount < fr) {
-                fr = inBuffer->frameCount;
+                session->framesRev = 0;
             }
-            memcpy(session->revFrame->_payloadData + session->framesRev * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
-            session->framesRev += fr;
-            inBuffer->frameCount = fr;
-            if (session->framesRev < session->frameCount) {
-                return 0;
-            }
-            session->framesRev = 0;
+            session->revFrame->_payloadDataLengthInSamples =
+                    session->apmFrameCount * session->inChannelCount;
+            session->apm->AnalyzeReverseStream(session->revFrame);
         }
-        session->revFrame->_payloadDataLengthInSamples =
-                session->apmFrameCount * session->inChannelCount;
-        effect->session->apm->AnalyzeReverseStream(session->revFrame);
+        inBuffer->frameCount = framesRd;
         return 0;
     } else {
         return -ENODATA;
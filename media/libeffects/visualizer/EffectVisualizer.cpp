@@ -25,7 +25,12 @@
 #include <time.h>
 #include <math.h>
 #include <audio_effects/effect_visualizer.h>
+#include <cutils/atomic.h>
 #include <cutils/log.h>
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VISUALIZER_NEON
+#endif
 
 
 extern "C" {
@@ -72,7 +77,10 @@ struct BufferStats {
 struct VisualizerContext {
     const struct effect_interface_s *mItfe;
     effect_config_t mConfig;
-    uint32_t mCaptureIdx;
+    // write index in mCaptureBuf, only modified by the process thread and published
+    // with release semantics once the captured samples are in the buffer, so that
+    // VISUALIZER_CMD_CAPTURE can read any number of windows concurrently without a lock
+    volatile int32_t mCaptureIdx;
     uint32_t mCaptureSize;
     uint32_t mScalingMode;
     uint8_t mState;
@@ -88,9 +96,96 @@ struct VisualizerContext {
     BufferStats mPastMeasurements[MEASUREMENT_WINDOW_MAX_SIZE_IN_BUFFERS];
 };
 
+// Statistics of one buffer of interleaved 16 bit samples, all computed in a single pass
+struct SampleStats {
+    int16_t mPeak;          // largest absolute value, saturated to 32767
+    int16_t mPeakOnes;      // largest one's complement absolute value (-x - 1 for x < 0)
+    int64_t mSumSquares;    // sum of the squared samples
+};
+
 //
 //--- Local functions
 //
+
+#ifdef VISUALIZER_NEON
+static inline int16_t Visualizer_maxAcross(int16x8_t v) {
+#if defined(__aarch64__)
+    return vmaxvq_s16(v);
+#else
+    int16x4_t m = vpmax_s16(vget_low_s16(v), vget_high_s16(v));
+    m = vpmax_s16(m, m);
+    m = vpmax_s16(m, m);
+    return vget_lane_s16(m, 0);
+#endif
+}
+#endif
+
+void Visualizer_sampleStats(const int16_t *in, size_t count, SampleStats *stats) {
+    int16_t peak = 0;
+    int16_t peakOnes = 0;
+    int64_t sumSquares = 0;
+    size_t i = 0;
+#ifdef VISUALIZER_NEON
+    if (count >= 8) {
+        int16x8_t vPeak = vdupq_n_s16(0);
+        int16x8_t vPeakOnes = vdupq_n_s16(0);
+        int64x2_t vSum = vdupq_n_s64(0);
+        for (; i + 8 <= count; i += 8) {
+            const int16x8_t v = vld1q_s16(in + i);
+            vPeak = vmaxq_s16(vPeak, vqabsq_s16(v));
+            vPeakOnes = vmaxq_s16(vPeakOnes, veorq_s16(v, vshrq_n_s16(v, 15)));
+            // each square fits in 31 bits, accumulate pairs into 64 bit lanes
+            vSum = vpadalq_s32(vSum, vmull_s16(vget_low_s16(v), vget_low_s16(v)));
+            vSum = vpadalq_s32(vSum, vmull_s16(vget_high_s16(v), vget_high_s16(v)));
+        }
+        peak = Visualizer_maxAcross(vPeak);
+        peakOnes = Visualizer_maxAcross(vPeakOnes);
+        sumSquares = vgetq_lane_s64(vSum, 0) + vgetq_lane_s64(vSum, 1);
+    }
+#endif
+    for (; i < count; i++) {
+        const int32_t smp = in[i];
+        const int32_t ones = smp ^ (smp >> 31);
+        const int32_t mag = smp < 0 ? ones + (ones < 32767) : ones;
+        if (mag > peak) {
+            peak = mag;
+        }
+        if (ones > peakOnes) {
+            peakOnes = ones;
+        }
+        sumSquares += smp * smp;
+    }
+    stats->mPeak = peak;
+    stats->mPeakOnes = peakOnes;
+    stats->mSumSquares = sumSquares;
+}
+
+// Writes the mono 8 bit capture of frameCount stereo frames to buf, which must have room
+// for all of them: (left + right) >> shift, offset to unsigned.
+void Visualizer_captureFrames(const int16_t *in, size_t frameCount, int32_t shift,
+        uint8_t *buf) {
+    size_t i = 0;
+#ifdef VISUALIZER_NEON
+    const int32x4_t vShift = vdupq_n_s32(-shift);
+    const uint8x8_t vOffset = vdup_n_u8(0x80);
+    for (; i + 8 <= frameCount; i += 8) {
+        const int16x8x2_t lr = vld2q_s16(in + 2 * i);
+        int32x4_t lo = vaddl_s16(vget_low_s16(lr.val[0]), vget_low_s16(lr.val[1]));
+        int32x4_t hi = vaddl_s16(vget_high_s16(lr.val[0]), vget_high_s16(lr.val[1]));
+        lo = vshlq_s32(lo, vShift);
+        hi = vshlq_s32(hi, vShift);
+        // keep the low 8 bits, as the scalar cast to uint8_t does
+        const int16x8_t smp = vcombine_s16(vmovn_s32(lo), vmovn_s32(hi));
+        vst1_u8(buf + i, veor_u8(vreinterpret_u8_s8(vmovn_s16(smp)), vOffset));
+    }
+#endif
+    for (; i < frameCount; i++) {
+        int32_t smp = in[2 * i] + in[2 * i + 1];
+        smp = smp >> shift;
+        buf[i] = ((uint8_t)smp)^0x80;
+    }
+}
+
 uint32_t Visualizer_getDeltaTimeMsFromUpdatedTime(VisualizerContext* pContext) {
     uint32_t deltaMs = 0;
     if (pContext->mBufferUpdateTime.tv_sec != 0) {
@@ -321,24 +416,23 @@ int Visualizer_process(
         return -EINVAL;
     }
 
+    // the measurements and the capture scaling factor are derived from the same
+    // statistics, computed in a single pass over the buffer
+    const bool measure = (pContext->mMeasurementMode & MEASUREMENT_MODE_PEAK_RMS) != 0;
+    const bool normalize = pContext->mScalingMode == VISUALIZER_SCALING_MODE_NORMALIZED;
+    SampleStats stats;
+    if (measure || normalize) {
+        Visualizer_sampleStats(inBuffer->s16, inBuffer->frameCount * pContext->mChannelCount,
+                &stats);
+    }
+
     // perform measurements if needed
-    if (pContext->mMeasurementMode & MEASUREMENT_MODE_PEAK_RMS) {
-        // find the peak and RMS squared for the new buffer
-        uint32_t inIdx;
-        int16_t maxSample = 0;
-        float rmsSqAcc = 0;
-        for (inIdx = 0 ; inIdx < inBuffer->frameCount * pContext->mChannelCount ; inIdx++) {
-            if (inBuffer->s16[inIdx] > maxSample) {
-                maxSample = inBuffer->s16[inIdx];
-            } else if (-inBuffer->s16[inIdx] > maxSample) {
-                maxSample = -inBuffer->s16[inIdx];
-            }
-            rmsSqAcc += (inBuffer->s16[inIdx] * inBuffer->s16[inIdx]);
-        }
-        // store the measurement
-        pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mPeakU16 = (uint16_t)maxSample;
+    if (measure) {
+        // store the peak and RMS squared for the new buffer
+        pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mPeakU16 =
+                (uint16_t)stats.mPeak;
         pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mRmsSquared =
-                rmsSqAcc / (inBuffer->frameCount * pContext->mChannelCount);
+                (float)stats.mSumSquares / (inBuffer->frameCount * pContext->mChannelCount);
         pContext->mPastMeasurements[pContext->mMeasurementBufferIdx].mIsValid = true;
         if (++pContext->mMeasurementBufferIdx >= pContext->mMeasurementWindowSizeInBuffers) {
             pContext->mMeasurementBufferIdx = 0;
@@ -348,17 +442,11 @@ int Visualizer_process(
     // all code below assumes stereo 16 bit PCM output and input
     int32_t shift;
 
-    if (pContext->mScalingMode == VISUALIZER_SCALING_MODE_NORMALIZED) {
+    if (normalize) {
         // derive capture scaling factor from peak value in current buffer
         // this gives more interesting captures for display.
-        shift = 32;
-        int len = inBuffer->frameCount * 2;
-        for (int i = 0; i < len; i++) {
-            int32_t smp = inBuffer->s16[i];
-            if (smp < 0) smp = -smp - 1; // take care to keep the max negative in range
-            int32_t clz = __builtin_clz(smp);
-            if (shift > clz) shift = clz;
-        }
+        // the one's complement peak keeps the max negative in range
+        shift = stats.mPeakOnes == 0 ? 32 : __builtin_clz(stats.mPeakOnes);
         // A maximum amplitude signal will have 17 leading zeros, which we want to
         // translate to a shift of 8 (for converting 16 bit to 8 bit)
         shift = 25 - shift;
@@ -373,28 +461,28 @@ int Visualizer_process(
         shift = 9;
     }
 
-    uint32_t captIdx;
-    uint32_t inIdx;
-    uint8_t *buf = pContext->mCaptureBuf;
-    for (inIdx = 0, captIdx = pContext->mCaptureIdx;
-         inIdx < inBuffer->frameCount;
-         inIdx++, captIdx++) {
+    uint32_t captIdx = pContext->mCaptureIdx;
+    size_t framesIn = 0;
+    while (framesIn < inBuffer->frameCount) {
         if (captIdx >= CAPTURE_BUF_SIZE) {
             // wrap around
             captIdx = 0;
         }
-        int32_t smp = inBuffer->s16[2 * inIdx] + inBuffer->s16[2 * inIdx + 1];
-        smp = smp >> shift;
-        buf[captIdx] = ((uint8_t)smp)^0x80;
+        size_t frames = inBuffer->frameCount - framesIn;
+        if (frames > CAPTURE_BUF_SIZE - captIdx) {
+            frames = CAPTURE_BUF_SIZE - captIdx;
+        }
+        Visualizer_captureFrames(inBuffer->s16 + 2 * framesIn, frames, shift,
+                pContext->mCaptureBuf + captIdx);
+        framesIn += frames;
+        captIdx += frames;
     }
 
-    // XXX the following two should really be atomic, though it probably doesn't
-    // matter much for visualization purposes
-    pContext->mCaptureIdx = captIdx;
-    // update last buffer update time stamp
+    // update last buffer update time stamp, then publish the new samples
     if (clock_gettime(CLOCK_MONOTONIC, &pContext->mBufferUpdateTime) < 0) {
         pContext->mBufferUpdateTime.tv_sec = 0;
     }
+    android_atomic_release_store(captIdx, &pContext->mCaptureIdx);
 
     if (inBuffer->raw != outBuffer->raw) {
         if (pContext->mConfig.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
@@ -555,11 +643,12 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             return -EINVAL;
         }
         if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
+            const uint32_t captureIdx = android_atomic_acquire_load(&pContext->mCaptureIdx);
             const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
 
             // if audio framework has stopped playing audio although the effect is still
             // active we must clear the capture buffer to return silence
-            if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
+            if ((pContext->mLastCaptureIdx == captureIdx) &&
                     (pContext->mBufferUpdateTime.tv_sec != 0) &&
                     (deltaMs > MAX_STALL_TIME_MS)) {
                     ALOGV("capture going to idle");
@@ -573,7 +662,7 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
                 }
                 const uint32_t deltaSmpl =
                     pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
-                int32_t capturePoint = pContext->mCaptureIdx - captureSize - deltaSmpl;
+                int32_t capturePoint = captureIdx - captureSize - deltaSmpl;
 
                 if (capturePoint < 0) {
                     uint32_t size = -capturePoint;
@@ -592,7 +681,7 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
                        captureSize);
             }
 
-            pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+            pContext->mLastCaptureIdx = captureIdx;
         } else {
             memset(pReplyData, 0x80, captureSize);
         }
@@ -22,6 +22,7 @@
 #include <media/AudioSystem.h>
 #include <media/IAudioFlinger.h>
 #include <media/IAudioPolicyService.h>
+#include <private/media/AudioIoState.h>
 #include <math.h>
 
 #include <system/audio.h>
@@ -72,6 +73,7 @@ const sp<IAudioFlinger> AudioSystem::get_audio_flinger()
     }
     if (afc != 0) {
         af->registerClient(afc);
+        afc->setIoState(af->getIoState());
     }
     return af;
 }
@@ -160,6 +162,16 @@ status_t AudioSystem::setStreamVolume(audio_stream_type_t stream, float value,
     return NO_ERROR;
 }
 
+status_t AudioSystem::setStreamVolumes(const IAudioFlinger::StreamVolume *volumes, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (uint32_t(volumes[i].mStream) >= AUDIO_STREAM_CNT) return BAD_VALUE;
+    }
+    const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
+    if (af == 0) return PERMISSION_DENIED;
+    return af->setStreamVolumes(volumes, count);
+}
+
 status_t AudioSystem::setStreamMute(audio_stream_type_t stream, bool mute)
 {
     if (uint32_t(stream) >= AUDIO_STREAM_CNT) return BAD_VALUE;
@@ -376,6 +388,13 @@ status_t AudioSystem::setVoiceVolume(float value)
 status_t AudioSystem::getRenderPosition(audio_io_handle_t output, uint32_t *halFrames,
                                         uint32_t *dspFrames)
 {
+    const sp<AudioFlingerClient> afc = getAudioFlingerClient();
+    if (afc == 0) return PERMISSION_DENIED;
+    status_t status = afc->getRenderPosition(output, halFrames, dspFrames);
+    if (status != WOULD_BLOCK) {
+        return status;
+    }
+
     const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
     if (af == 0) return PERMISSION_DENIED;
 
@@ -441,6 +460,47 @@ void AudioSystem::AudioFlingerClient::clearIoCache()
     mInSamplingRate = 0;
     mInFormat = AUDIO_FORMAT_DEFAULT;
     mInChannelMask = AUDIO_CHANNEL_NONE;
+    mIoStateMemory.clear();
+    mIoStateTable = NULL;
+}
+
+void AudioSystem::AudioFlingerClient::setIoState(const sp<IMemory>& ioState)
+{
+    Mutex::Autolock _l(mLock);
+    mIoStateMemory.clear();
+    mIoStateTable = NULL;
+    if (ioState == 0 || ioState->pointer() == NULL ||
+            ioState->size() < sizeof(AudioIoStateTable)) {
+        ALOGW_IF(ioState != 0, "setIoState() invalid published state");
+        return;
+    }
+    mIoStateMemory = ioState;
+    mIoStateTable = (const AudioIoStateTable *) ioState->pointer();
+}
+
+status_t AudioSystem::AudioFlingerClient::getRenderPosition(audio_io_handle_t output,
+        uint32_t *halFrames, uint32_t *dspFrames)
+{
+    AudioIoStateData state;
+    {
+        Mutex::Autolock _l(mLock);
+        if (mIoStateTable == NULL || !mIoStateTable->read(output, &state)) {
+            return WOULD_BLOCK;
+        }
+    }
+    if (state.mRenderTimeNs == 0 || systemTime() - state.mRenderTimeNs > 2 * state.mPeriodNs) {
+        // the output is in standby, suspended, paused or waiting for its HAL
+        return WOULD_BLOCK;
+    }
+    if (state.mRenderStatus == NO_ERROR) {
+        if (halFrames != NULL) {
+            *halFrames = state.mHalFrames;
+        }
+        if (dspFrames != NULL) {
+            *dspFrames = state.mDspFrames;
+        }
+    }
+    return state.mRenderStatus;
 }
 
 void AudioSystem::AudioFlingerClient::binderDied(const wp<IBinder>& who __unused)
@@ -20,6 +20,7 @@
 
 #include <inttypes.h>
 #include <math.h>
+#include <stdlib.h>
 #include <sys/resource.h>
 
 #include <audio_utils/primitives.h>
@@ -493,6 +494,7 @@ status_t AudioTrack::set(
     mPosition = 0;
     mReleased = 0;
     mStartUs = 0;
+    mBatchPresentationTimeUs = kNoPresentationTime;
     AudioSystem::acquireAudioSessionId(mSessionId, mClientPid);
     mSequence = 1;
     mObservedSequence = mSequence;
@@ -515,6 +517,8 @@ status_t AudioTrack::start()
     }
 
     mInUnderrun = true;
+    // a timestamp published before a pause, stop or flush does not describe the new run
+    mProxy->clearTimestamp();
 
     State previousState = mState;
     if (previousState == STATE_PAUSED_STOPPING) {
@@ -611,6 +615,7 @@ void AudioTrack::stop()
         mState = STATE_STOPPED;
         mReleased = 0;
     }
+    mBatchPresentationTimeUs = kNoPresentationTime;
 
     mProxy->interrupt();
     mAudioTrack->stop();
@@ -665,6 +670,7 @@ void AudioTrack::flush_l()
 
     mState = STATE_FLUSHED;
     mReleased = 0;
+    mBatchPresentationTimeUs = kNoPresentationTime;
     if (isOffloaded_l()) {
         mProxy->interrupt();
     }
@@ -1671,6 +1677,115 @@ ssize_t AudioTrack::write(const void* buffer, size_t userSize, bool blocking)
     return written;
 }
 
+ssize_t AudioTrack::writeBatch(const BatchBuffer* buffers, size_t count, bool blocking)
+{
+    if (mTransfer != TRANSFER_SYNC || mIsTimed) {
+        return INVALID_OPERATION;
+    }
+
+    if (isDirect()) {
+        AutoMutex lock(mLock);
+        int32_t flags = android_atomic_and(
+                            ~(CBLK_UNDERRUN | CBLK_LOOP_CYCLE | CBLK_LOOP_FINAL | CBLK_BUFFER_END),
+                            &mCblk->mFlags);
+        if (flags & CBLK_INVALID) {
+            return DEAD_OBJECT;
+        }
+    }
+
+    if (buffers == NULL && count != 0) {
+        return BAD_VALUE;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (ssize_t(buffers[i].size) < 0 || (buffers[i].data == NULL && buffers[i].size != 0) ||
+                buffers[i].size % mFrameSize != 0 || ssize_t(total + buffers[i].size) < 0) {
+            ALOGE("AudioTrack::writeBatch(buffer %zu of %zu: data=%p, size=%zu)",
+                    i, count, buffers[i].data, buffers[i].size);
+            return BAD_VALUE;
+        }
+        total += buffers[i].size;
+    }
+
+    const bool pcm = audio_is_linear_pcm(mFormat);
+    const int silenceByte = mFormat == AUDIO_FORMAT_PCM_8_BIT ? 0x80 : 0;
+    size_t consumed = 0;    // bytes of the list consumed so far, the return value
+    size_t index = 0;       // buffer being written
+    size_t offset = 0;      // bytes of buffers[index] consumed so far
+    size_t silence = 0;     // bytes of silence to insert before the rest of buffers[index]
+    bool aligned = false;   // whether buffers[index] was placed according to its time
+    Buffer audioBuffer;
+
+    while (index < count) {
+        audioBuffer.frameCount = mFrameCount;
+        status_t err = obtainBuffer(&audioBuffer,
+                blocking ? &ClientProxy::kForever : &ClientProxy::kNonBlocking);
+        if (err < 0) {
+            if (consumed > 0) {
+                break;
+            }
+            return ssize_t(err);
+        }
+
+        uint8_t *dst = (uint8_t *) audioBuffer.i8;
+        size_t room = audioBuffer.size;
+        while (room > 0 && index < count) {
+            const BatchBuffer& buffer = buffers[index];
+            if (!aligned) {
+                aligned = true;
+                const int64_t durationUs =
+                        (int64_t) (buffer.size / mFrameSize) * 1000000 / mSampleRate;
+                if (pcm && buffer.presentationTimeUs != kNoPresentationTime) {
+                    if (mBatchPresentationTimeUs != kNoPresentationTime) {
+                        const int64_t deltaUs =
+                                buffer.presentationTimeUs - mBatchPresentationTimeUs;
+                        const size_t deltaBytes =
+                                (size_t) (llabs(deltaUs) * mSampleRate / 1000000) * mFrameSize;
+                        if (deltaUs > kBatchToleranceUs && deltaUs <= kBatchMaxGapUs) {
+                            silence = deltaBytes;
+                        } else if (deltaUs < -kBatchToleranceUs && deltaUs >= -kBatchMaxGapUs) {
+                            offset = deltaBytes < buffer.size ? deltaBytes : buffer.size;
+                            consumed += offset;
+                        }
+                    }
+                    mBatchPresentationTimeUs = buffer.presentationTimeUs + durationUs;
+                } else if (mBatchPresentationTimeUs != kNoPresentationTime) {
+                    mBatchPresentationTimeUs += durationUs;
+                }
+            }
+            if (silence > 0) {
+                size_t toWrite = silence < room ? silence : room;
+                memset(dst, silenceByte, toWrite);
+                dst += toWrite;
+                room -= toWrite;
+                silence -= toWrite;
+                continue;
+            }
+            size_t toWrite = buffer.size - offset;
+            if (toWrite > room) {
+                toWrite = room;
+            }
+            memcpy(dst, (const uint8_t *) buffer.data + offset, toWrite);
+            dst += toWrite;
+            room -= toWrite;
+            offset += toWrite;
+            consumed += toWrite;
+            if (offset == buffer.size) {
+                index++;
+                offset = 0;
+                aligned = false;
+            }
+        }
+
+        // release only the part that was filled
+        audioBuffer.size -= room;
+        audioBuffer.frameCount = audioBuffer.size / mFrameSize;
+        releaseBuffer(&audioBuffer);
+    }
+
+    return consumed;
+}
+
 // -------------------------------------------------------------------------
 
 TimedAudioTrack::TimedAudioTrack() {
@@ -2285,7 +2400,14 @@ status_t AudioTrack::getTimestamp(AudioTimestamp& timestamp)
         // The presented frame count must always lag behind the consumed frame count.
         // To avoid a race, read the presented frames first.  This ensures that presented <= consumed.
 
-        status = mAudioTrack->getTimestamp(timestamp);
+        // The server publishes the timestamps of mixed tracks in the control block once per
+        // mix cycle, ask it only until the first one or if the track is not mixed.
+        if (mState == STATE_ACTIVE && !isOffloadedOrDirect_l() &&
+                mProxy->getTimestamp(&timestamp)) {
+            status = NO_ERROR;
+        } else {
+            status = mAudioTrack->getTimestamp(timestamp);
+        }
         if (status != NO_ERROR) {
             ALOGV_IF(status != WOULD_BLOCK, "getTimestamp error:%#x", status);
             return status;
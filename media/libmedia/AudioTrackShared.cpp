@@ -383,6 +383,17 @@ void AudioTrackClientProxy::flush()
     android_atomic_release_store(newFlush, &cblk->u.mStreaming.mFlush);
 }
 
+bool AudioTrackClientProxy::getTimestamp(AudioTimestamp *timestamp)
+{
+    if (mTimestampObserver.poll(mTimestamp)) {
+        mTimestampValid = true;
+    }
+    if (mTimestampValid) {
+        *timestamp = mTimestamp;
+    }
+    return mTimestampValid;
+}
+
 bool AudioTrackClientProxy::clearStreamEndDone() {
     return (android_atomic_and(~CBLK_STREAM_END_DONE, &mCblk->mFlags) & CBLK_STREAM_END_DONE) != 0;
 }
@@ -30,7 +30,9 @@
 
 namespace android {
 
-CharacterEncodingDetector::CharacterEncodingDetector() {
+CharacterEncodingDetector::CharacterEncodingDetector()
+    : mCsd(NULL),
+      mNextConverter(0) {
 
     UErrorCode status = U_ZERO_ERROR;
     mUtf8Conv = ucnv_open("UTF-8", &status);
@@ -38,9 +40,21 @@ CharacterEncodingDetector::CharacterEncodingDetector() {
         ALOGE("could not create UConverter for UTF-8");
         mUtf8Conv = NULL;
     }
+    for (size_t i = 0; i < kMaxConverters; i++) {
+        mConverters[i].mName[0] = 0;
+        mConverters[i].mConv = NULL;
+    }
 }
 
 CharacterEncodingDetector::~CharacterEncodingDetector() {
+    for (size_t i = 0; i < kMaxConverters; i++) {
+        if (mConverters[i].mConv != NULL) {
+            ucnv_close(mConverters[i].mConv);
+        }
+    }
+    if (mCsd != NULL) {
+        ucsdet_close(mCsd);
+    }
     ucnv_close(mUtf8Conv);
 }
 
@@ -49,6 +63,13 @@ void CharacterEncodingDetector::addTag(const char *name, const char *value) {
     mValues.push_back(value);
 }
 
+void CharacterEncodingDetector::clear() {
+    for (int i = mNames.size() - 1; i >= 0; --i) {
+        mNames.erase(i);
+        mValues.erase(i);
+    }
+}
+
 size_t CharacterEncodingDetector::size() {
     return mNames.size();
 }
@@ -63,15 +84,122 @@ status_t CharacterEncodingDetector::getTag(int index, const char **name, const c
     return OK;
 }
 
-static bool isPrintableAscii(const char *value, size_t len) {
-    for (size_t i = 0; i < len; i++) {
-        if ((value[i] & 0x80) || value[i] < 0x20 || value[i] == 0x7f) {
+// Returns a converter for the named encoding, reset and ready to use. Converters are kept
+// across files, since the tags of a music collection are mostly in one or two encodings
+// and opening a converter means loading and parsing its mapping table.
+UConverter *CharacterEncodingDetector::openConverter(const char *name) {
+    for (size_t i = 0; i < kMaxConverters; i++) {
+        if (mConverters[i].mConv != NULL && !strcmp(mConverters[i].mName, name)) {
+            ucnv_reset(mConverters[i].mConv);
+            return mConverters[i].mConv;
+        }
+    }
+
+    UErrorCode status = U_ZERO_ERROR;
+    UConverter *conv = ucnv_open(name, &status);
+    if (U_FAILURE(status)) {
+        return NULL;
+    }
+
+    Converter &slot = mConverters[mNextConverter];
+    mNextConverter = (mNextConverter + 1) % kMaxConverters;
+    if (slot.mConv != NULL) {
+        ucnv_close(slot.mConv);
+    }
+    strlcpy(slot.mName, name, sizeof(slot.mName));
+    slot.mConv = conv;
+    return conv;
+}
+
+static const uint64_t kOnes = 0x0101010101010101ULL;
+static const uint64_t kHighBits = 0x8080808080808080ULL;
+
+static inline uint64_t load64(const uint8_t *p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+// Checks eight bytes at a time whether any of them is outside 0x20..0x7e.
+bool CharacterEncodingDetector::isPrintableAscii(const char *value, size_t len) {
+    const uint8_t *s = (const uint8_t *)value;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        const uint64_t word = load64(s + i);
+        const uint64_t del = word ^ (kOnes * 0x7f);
+        // high bit set, below 0x20, or equal to 0x7f
+        if ((word | ((word - kOnes * 0x20) & ~word) | ((del - kOnes) & ~del)) & kHighBits) {
+            return false;
+        }
+    }
+    for (; i < len; i++) {
+        if (s[i] >= 0x80 || s[i] < 0x20 || s[i] == 0x7f) {
             return false;
         }
     }
     return true;
 }
 
+// Strict UTF-8 validation, rejecting overlong forms, surrogates and code points past
+// U+10FFFF. Runs of ASCII are skipped eight bytes at a time.
+bool CharacterEncodingDetector::isValidUtf8(const char *value, size_t len) {
+    const uint8_t *s = (const uint8_t *)value;
+    size_t i = 0;
+    while (i < len) {
+        if (i + sizeof(uint64_t) <= len && (load64(s + i) & kHighBits) == 0) {
+            i += sizeof(uint64_t);
+            continue;
+        }
+        const uint8_t c = s[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+        size_t trailing;
+        uint32_t cp;
+        uint32_t min;
+        if ((c & 0xe0) == 0xc0) {
+            trailing = 1;
+            cp = c & 0x1f;
+            min = 0x80;
+        } else if ((c & 0xf0) == 0xe0) {
+            trailing = 2;
+            cp = c & 0x0f;
+            min = 0x800;
+        } else if ((c & 0xf8) == 0xf0) {
+            trailing = 3;
+            cp = c & 0x07;
+            min = 0x10000;
+        } else {
+            return false;
+        }
+        if (len - i <= trailing) {
+            return false;
+        }
+        for (size_t k = 1; k <= trailing; k++) {
+            const uint8_t b = s[i + k];
+            if ((b & 0xc0) != 0x80) {
+                return false;
+            }
+            cp = (cp << 6) | (b & 0x3f);
+        }
+        if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+            return false;
+        }
+        i += trailing + 1;
+    }
+    return true;
+}
+
+static bool isCombinedTag(const char *name) {
+    return !strcmp(name, "artist") ||
+            !strcmp(name, "albumartist") ||
+            !strcmp(name, "composer") ||
+            !strcmp(name, "genre") ||
+            !strcmp(name, "album") ||
+            !strcmp(name, "title");
+}
+
 void CharacterEncodingDetector::detectAndConvert() {
 
     int size = mNames.size();
@@ -83,27 +211,49 @@ void CharacterEncodingDetector::detectAndConvert() {
     if (size && mUtf8Conv) {
 
         UErrorCode status = U_ZERO_ERROR;
-        UCharsetDetector *csd = ucsdet_open(&status);
+        if (mCsd == NULL) {
+            mCsd = ucsdet_open(&status);
+            if (U_FAILURE(status)) {
+                ALOGE("could not create UCharsetDetector");
+                mCsd = NULL;
+                return;
+            }
+        }
+        UCharsetDetector *csd = mCsd;
         const UCharsetMatch *ucm;
 
+        // classify every tag once, most of them never need ICU
+        enum { TAG_ASCII, TAG_UTF8, TAG_NATIVE };
+        Vector<int> kinds;
+        kinds.resize(size);
+        for (int i = 0; i < size; i++) {
+            const char *value = mValues.getEntry(i);
+            const size_t len = strlen(value);
+            if (isPrintableAscii(value, len)) {
+                kinds.editItemAt(i) = TAG_ASCII;
+            } else if (isValidUtf8(value, len)) {
+                kinds.editItemAt(i) = TAG_UTF8;
+            } else {
+                kinds.editItemAt(i) = TAG_NATIVE;
+            }
+        }
+
         // try combined detection of artist/album/title etc.
         char buf[1024];
         buf[0] = 0;
         bool allprintable = true;
+        bool allutf8 = true;
         for (int i = 0; i < size; i++) {
             const char *name = mNames.getEntry(i);
             const char *value = mValues.getEntry(i);
-            if (!isPrintableAscii(value, strlen(value)) && (
-                        !strcmp(name, "artist") ||
-                        !strcmp(name, "albumartist") ||
-                        !strcmp(name, "composer") ||
-                        !strcmp(name, "genre") ||
-                        !strcmp(name, "album") ||
-                        !strcmp(name, "title"))) {
+            if (kinds[i] != TAG_ASCII && isCombinedTag(name)) {
                 strlcat(buf, value, sizeof(buf));
                 // separate tags by space so ICU's ngram detector can do its job
                 strlcat(buf, " ", sizeof(buf));
                 allprintable = false;
+                if (kinds[i] != TAG_UTF8) {
+                    allutf8 = false;
+                }
             }
         }
 
@@ -112,6 +262,10 @@ void CharacterEncodingDetector::detectAndConvert() {
             // since 'buf' is empty, ICU would return a UTF-8 matcher with low confidence, so
             // no need to even call it
             ALOGV("all tags are printable, assuming ascii (%zu)", strlen(buf));
+        } else if (allutf8) {
+            // legacy multibyte encodings practically never form valid UTF-8, and ICU's
+            // UTF-8 recognizer would report full confidence for this anyway
+            ALOGV("all tags are valid UTF-8 (%zu)", strlen(buf));
         } else {
             ucsdet_setText(csd, buf, strlen(buf), &status);
             int32_t matches;
@@ -134,7 +288,7 @@ void CharacterEncodingDetector::detectAndConvert() {
                 for (int i = 0; i < size; i++) {
                     const char *name = mNames.getEntry(i);
                     const char *value = mValues.getEntry(i);
-                    if (isPrintableAscii(value, strlen(value)) && (
+                    if (kinds[i] == TAG_ASCII && (
                                 !strcmp(name, "artist") ||
                                 !strcmp(name, "album") ||
                                 !strcmp(name, "title"))) {
@@ -171,21 +325,19 @@ void CharacterEncodingDetector::detectAndConvert() {
 
             ALOGV("@@@ checking %s", name);
             const char *s = mValues.getEntry(i);
-            int32_t inputLength = strlen(s);
+            int32_t inputLength = len;
             const char *enc;
 
-            if (!allprintable && (!strcmp(name, "artist") ||
-                    !strcmp(name, "albumartist") ||
-                    !strcmp(name, "composer") ||
-                    !strcmp(name, "genre") ||
-                    !strcmp(name, "album") ||
-                    !strcmp(name, "title"))) {
+            if (!allprintable && isCombinedTag(name)) {
                 // use encoding determined from the combination of artist/album/title etc.
                 enc = combinedenc;
             } else {
-                if (isPrintableAscii(s, inputLength)) {
+                if (kinds[i] == TAG_ASCII) {
                     enc = "UTF-8";
                     ALOGV("@@@@ %s is ascii", mNames.getEntry(i));
+                } else if (kinds[i] == TAG_UTF8) {
+                    enc = "UTF-8";
+                    ALOGV("@@@@ %s is valid UTF-8", mNames.getEntry(i));
                 } else {
                     ucsdet_setText(csd, s, inputLength, &status);
                     ucm = ucsdet_detect(csd, &status);
@@ -203,13 +355,12 @@ void CharacterEncodingDetector::detectAndConvert() {
                 // only convert if the source encoding isn't already UTF-8
                 ALOGV("@@@ using converter %s for %s", enc, mNames.getEntry(i));
                 status = U_ZERO_ERROR;
-                UConverter *conv = ucnv_open(enc, &status);
-                if (U_FAILURE(status)) {
-                    ALOGW("could not create UConverter for %s (%d), falling back to ISO-8859-1",
-                            enc, status);
-                    status = U_ZERO_ERROR;
-                    conv = ucnv_open("ISO-8859-1", &status);
-                    if (U_FAILURE(status)) {
+                UConverter *conv = openConverter(enc);
+                if (conv == NULL) {
+                    ALOGW("could not create UConverter for %s, falling back to ISO-8859-1",
+                            enc);
+                    conv = openConverter("ISO-8859-1");
+                    if (conv == NULL) {
                         ALOGW("could not create UConverter for ISO-8859-1 either");
                         continue;
                     }
@@ -225,7 +376,7 @@ void CharacterEncodingDetector::detectAndConvert() {
                 char* target = buffer;
 
                 ucnv_convertEx(mUtf8Conv, conv, &target, target + targetLength,
-                        &source, source + strlen(source),
+                        &source, source + len,
                         NULL, NULL, NULL, NULL, TRUE, TRUE, &status);
 
                 if (U_FAILURE(status)) {
@@ -247,8 +398,6 @@ void CharacterEncodingDetector::detectAndConvert() {
                 }
 
                 delete[] buffer;
-
-                ucnv_close(conv);
             }
         }
 
@@ -259,8 +408,6 @@ void CharacterEncodingDetector::detectAndConvert() {
                 mValues.erase(i);
             }
         }
-
-        ucsdet_close(csd);
     }
 }
 
@@ -335,11 +482,10 @@ const UCharsetMatch *CharacterEncodingDetector::getPreferred(
         }
 
         ALOGV("%zu: %s %d", i, encname, confidence);
-        status = U_ZERO_ERROR;
-        UConverter *conv = ucnv_open(encname, &status);
+        UConverter *conv = openConverter(encname);
         int demerit = 0;
-        if (U_FAILURE(status)) {
-            ALOGV("failed to open %s: %d", encname, status);
+        if (conv == NULL) {
+            ALOGV("failed to open %s", encname);
             confidence = 0;
             demerit += 1000;
         }
@@ -399,7 +545,6 @@ const UCharsetMatch *CharacterEncodingDetector::getPreferred(
         }
         ALOGV("%d-%d=%d", confidence, demerit, confidence - demerit);
         newconfidence.push_back(confidence - demerit);
-        ucnv_close(conv);
         if (i == 0 && (confidence - demerit) == 100) {
             // no need to check any further, we'll end up using this match anyway
             break;
@@ -81,7 +81,9 @@ enum {
     LIST_AUDIO_PATCHES,
     SET_AUDIO_PORT_CONFIG,
     GET_AUDIO_HW_SYNC,
-    SYSTEM_READY
+    SYSTEM_READY,
+    SET_STREAM_VOLUMES,
+    GET_IO_STATE,
 };
 
 #define MAX_ITEMS_PER_LIST 1024
@@ -347,6 +349,26 @@ public:
         return reply.readInt32();
     }
 
+    virtual status_t setStreamVolumes(const StreamVolume *volumes, size_t count)
+    {
+        if (volumes == NULL || count > MAX_ITEMS_PER_LIST) {
+            return BAD_VALUE;
+        }
+        Parcel data, reply;
+        data.writeInterfaceToken(IAudioFlinger::getInterfaceDescriptor());
+        data.writeInt32((int32_t) count);
+        for (size_t i = 0; i < count; i++) {
+            data.writeInt32((int32_t) volumes[i].mStream);
+            data.writeFloat(volumes[i].mVolume);
+            data.writeInt32((int32_t) volumes[i].mOutput);
+        }
+        status_t status = remote()->transact(SET_STREAM_VOLUMES, data, &reply);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        return reply.readInt32();
+    }
+
     virtual status_t setStreamMute(audio_stream_type_t stream, bool muted)
     {
         Parcel data, reply;
@@ -910,6 +932,16 @@ public:
         data.writeInterfaceToken(IAudioFlinger::getInterfaceDescriptor());
         return remote()->transact(SYSTEM_READY, data, &reply, IBinder::FLAG_ONEWAY);
     }
+    virtual sp<IMemory> getIoState() const
+    {
+        Parcel data, reply;
+        data.writeInterfaceToken(IAudioFlinger::getInterfaceDescriptor());
+        status_t status = remote()->transact(GET_IO_STATE, data, &reply);
+        if (status != NO_ERROR) {
+            return 0;
+        }
+        return interface_cast<IMemory>(reply.readStrongBinder());
+    }
 };
 
 IMPLEMENT_META_INTERFACE(AudioFlinger, "android.media.IAudioFlinger");
@@ -1035,6 +1067,22 @@ status_t BnAudioFlinger::onTransact(
             reply->writeInt32( setStreamVolume((audio_stream_type_t) stream, volume, output) );
             return NO_ERROR;
         } break;
+        case SET_STREAM_VOLUMES: {
+            CHECK_INTERFACE(IAudioFlinger, data, reply);
+            uint32_t count = data.readInt32();
+            if (count > MAX_ITEMS_PER_LIST) {
+                count = MAX_ITEMS_PER_LIST;
+            }
+            StreamVolume *volumes = new StreamVolume[count];
+            for (size_t i = 0; i < count; i++) {
+                volumes[i].mStream = (audio_stream_type_t) data.readInt32();
+                volumes[i].mVolume = data.readFloat();
+                volumes[i].mOutput = (audio_io_handle_t) data.readInt32();
+            }
+            reply->writeInt32(setStreamVolumes(volumes, count));
+            delete[] volumes;
+            return NO_ERROR;
+        } break;
         case SET_STREAM_MUTE: {
             CHECK_INTERFACE(IAudioFlinger, data, reply);
             int stream = data.readInt32();
@@ -1418,6 +1466,11 @@ status_t BnAudioFlinger::onTransact(
             systemReady();
             return NO_ERROR;
         } break;
+        case GET_IO_STATE: {
+            CHECK_INTERFACE(IAudioFlinger, data, reply);
+            reply->writeStrongBinder(IInterface::asBinder(getIoState()));
+            return NO_ERROR;
+        } break;
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -37,8 +37,28 @@ enum {
     DECRYPT,
     NOTIFY_RESOLUTION,
     SET_MEDIADRM_SESSION,
+    DECRYPT_TO_MEMORY,
 };
 
+// Returns false if the subsample sizes overflow or do not add up to totalSize.
+static bool checkSubSampleSizes(
+        const CryptoPlugin::SubSample *subSamples, int32_t numSubSamples,
+        size_t totalSize) {
+    size_t sumSubsampleSizes = 0;
+    for (int32_t i = 0; i < numSubSamples; ++i) {
+        const CryptoPlugin::SubSample &ss = subSamples[i];
+        if (sumSubsampleSizes > SIZE_MAX - ss.mNumBytesOfEncryptedData) {
+            return false;
+        }
+        sumSubsampleSizes += ss.mNumBytesOfEncryptedData;
+        if (sumSubsampleSizes > SIZE_MAX - ss.mNumBytesOfClearData) {
+            return false;
+        }
+        sumSubsampleSizes += ss.mNumBytesOfClearData;
+    }
+    return sumSubsampleSizes == totalSize;
+}
+
 struct BpCrypto : public BpInterface<ICrypto> {
     BpCrypto(const sp<IBinder> &impl)
         : BpInterface<ICrypto>(impl) {
@@ -155,6 +175,57 @@ struct BpCrypto : public BpInterface<ICrypto> {
         return result;
     }
 
+    virtual ssize_t decrypt(
+            const uint8_t key[16],
+            const uint8_t iv[16],
+            CryptoPlugin::Mode mode,
+            const sp<IMemory> &sharedBuffer, size_t offset,
+            const CryptoPlugin::SubSample *subSamples, size_t numSubSamples,
+            const sp<IMemory> &destBuffer,
+            AString *errorDetailMsg) {
+        Parcel data, reply;
+        data.writeInterfaceToken(ICrypto::getInterfaceDescriptor());
+        data.writeInt32(mode);
+
+        static const uint8_t kDummy[16] = { 0 };
+
+        if (key == NULL) {
+            key = kDummy;
+        }
+
+        if (iv == NULL) {
+            iv = kDummy;
+        }
+
+        data.write(key, 16);
+        data.write(iv, 16);
+
+        size_t totalSize = 0;
+        for (size_t i = 0; i < numSubSamples; ++i) {
+            totalSize += subSamples[i].mNumBytesOfEncryptedData;
+            totalSize += subSamples[i].mNumBytesOfClearData;
+        }
+
+        data.writeInt32(totalSize);
+        data.writeStrongBinder(IInterface::asBinder(sharedBuffer));
+        data.writeInt32(offset);
+
+        data.writeInt32(numSubSamples);
+        data.write(subSamples, sizeof(CryptoPlugin::SubSample) * numSubSamples);
+
+        data.writeStrongBinder(IInterface::asBinder(destBuffer));
+
+        remote()->transact(DECRYPT_TO_MEMORY, data, &reply);
+
+        ssize_t result = reply.readInt32();
+
+        if (isCryptoError(result)) {
+            errorDetailMsg->setTo(reply.readCString());
+        }
+
+        return result;
+    }
+
     virtual void notifyResolution(
         uint32_t width, uint32_t height) {
         Parcel data, reply;
@@ -307,23 +378,7 @@ status_t BnCrypto::onTransact(
             AString errorDetailMsg;
             ssize_t result;
 
-            size_t sumSubsampleSizes = 0;
-            bool overflow = false;
-            for (int32_t i = 0; i < numSubSamples; ++i) {
-                CryptoPlugin::SubSample &ss = subSamples[i];
-                if (sumSubsampleSizes <= SIZE_MAX - ss.mNumBytesOfEncryptedData) {
-                    sumSubsampleSizes += ss.mNumBytesOfEncryptedData;
-                } else {
-                    overflow = true;
-                }
-                if (sumSubsampleSizes <= SIZE_MAX - ss.mNumBytesOfClearData) {
-                    sumSubsampleSizes += ss.mNumBytesOfClearData;
-                } else {
-                    overflow = true;
-                }
-            }
-
-            if (overflow || sumSubsampleSizes != totalSize) {
+            if (!checkSubSampleSizes(subSamples, numSubSamples, totalSize)) {
                 result = -EINVAL;
             } else if (totalSize > sharedBuffer->size()) {
                 result = -EINVAL;
@@ -364,6 +419,75 @@ status_t BnCrypto::onTransact(
             return OK;
         }
 
+        case DECRYPT_TO_MEMORY:
+        {
+            CHECK_INTERFACE(ICrypto, data, reply);
+
+            CryptoPlugin::Mode mode = (CryptoPlugin::Mode)data.readInt32();
+
+            uint8_t key[16];
+            data.read(key, sizeof(key));
+
+            uint8_t iv[16];
+            data.read(iv, sizeof(iv));
+
+            size_t totalSize = data.readInt32();
+            sp<IMemory> sharedBuffer =
+                interface_cast<IMemory>(data.readStrongBinder());
+            int32_t offset = data.readInt32();
+
+            int32_t numSubSamples = data.readInt32();
+            if (numSubSamples < 0 || (size_t)numSubSamples
+                    > data.dataAvail() / sizeof(CryptoPlugin::SubSample)) {
+                reply->writeInt32(-EINVAL);
+                return OK;
+            }
+
+            CryptoPlugin::SubSample *subSamples =
+                new CryptoPlugin::SubSample[numSubSamples];
+
+            data.read(
+                    subSamples,
+                    sizeof(CryptoPlugin::SubSample) * numSubSamples);
+
+            sp<IMemory> destBuffer =
+                interface_cast<IMemory>(data.readStrongBinder());
+
+            AString errorDetailMsg;
+            ssize_t result;
+
+            if (sharedBuffer == NULL || destBuffer == NULL) {
+                result = -EINVAL;
+            } else if (!checkSubSampleSizes(subSamples, numSubSamples, totalSize)) {
+                result = -EINVAL;
+            } else if (totalSize > sharedBuffer->size()
+                    || totalSize > destBuffer->size()) {
+                result = -EINVAL;
+            } else if (offset < 0 || (size_t)offset > sharedBuffer->size() - totalSize) {
+                result = -EINVAL;
+            } else {
+                result = decrypt(
+                    key,
+                    iv,
+                    mode,
+                    sharedBuffer, offset,
+                    subSamples, numSubSamples,
+                    destBuffer,
+                    &errorDetailMsg);
+            }
+
+            reply->writeInt32(result);
+
+            if (isCryptoError(result)) {
+                reply->writeCString(errorDetailMsg.c_str());
+            }
+
+            delete[] subSamples;
+            subSamples = NULL;
+
+            return OK;
+        }
+
         case NOTIFY_RESOLUTION:
         {
             CHECK_INTERFACE(ICrypto, data, reply);
@@ -56,7 +56,9 @@ enum {
     SET_LISTENER,
     UNPROVISION_DEVICE,
     GET_SECURE_STOP,
-    RELEASE_ALL_SECURE_STOPS
+    RELEASE_ALL_SECURE_STOPS,
+    GET_KEY_REQUEST_ASYNC,
+    PROVIDE_KEY_RESPONSE_ASYNC
 };
 
 struct BpDrm : public BpInterface<IDrm> {
@@ -190,6 +192,51 @@ struct BpDrm : public BpInterface<IDrm> {
         return reply.readInt32();
     }
 
+    virtual status_t getKeyRequestAsync(uint32_t token,
+                                        Vector<uint8_t> const &sessionId,
+                                        Vector<uint8_t> const &initData,
+                                        String8 const &mimeType, DrmPlugin::KeyType keyType,
+                                        KeyedVector<String8, String8> const &optionalParameters) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IDrm::getInterfaceDescriptor());
+
+        data.writeInt32(token);
+        writeVector(data, sessionId);
+        writeVector(data, initData);
+        data.writeString8(mimeType);
+        data.writeInt32((uint32_t)keyType);
+
+        data.writeInt32(optionalParameters.size());
+        for (size_t i = 0; i < optionalParameters.size(); ++i) {
+            data.writeString8(optionalParameters.keyAt(i));
+            data.writeString8(optionalParameters.valueAt(i));
+        }
+
+        status_t status = remote()->transact(GET_KEY_REQUEST_ASYNC, data, &reply);
+        if (status != OK) {
+            return status;
+        }
+
+        return reply.readInt32();
+    }
+
+    virtual status_t provideKeyResponseAsync(uint32_t token,
+                                             Vector<uint8_t> const &sessionId,
+                                             Vector<uint8_t> const &response) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IDrm::getInterfaceDescriptor());
+        data.writeInt32(token);
+        writeVector(data, sessionId);
+        writeVector(data, response);
+
+        status_t status = remote()->transact(PROVIDE_KEY_RESPONSE_ASYNC, data, &reply);
+        if (status != OK) {
+            return status;
+        }
+
+        return reply.readInt32();
+    }
+
     virtual status_t removeKeys(Vector<uint8_t> const &keySetId) {
         Parcel data, reply;
         data.writeInterfaceToken(IDrm::getInterfaceDescriptor());
@@ -683,6 +730,42 @@ status_t BnDrm::onTransact(
             return OK;
         }
 
+        case GET_KEY_REQUEST_ASYNC:
+        {
+            CHECK_INTERFACE(IDrm, data, reply);
+            uint32_t token = data.readInt32();
+            Vector<uint8_t> sessionId, initData;
+
+            readVector(data, sessionId);
+            readVector(data, initData);
+            String8 mimeType = data.readString8();
+            DrmPlugin::KeyType keyType = (DrmPlugin::KeyType)data.readInt32();
+
+            KeyedVector<String8, String8> optionalParameters;
+            uint32_t count = data.readInt32();
+            for (size_t i = 0; i < count; ++i) {
+                String8 key, value;
+                key = data.readString8();
+                value = data.readString8();
+                optionalParameters.add(key, value);
+            }
+
+            reply->writeInt32(getKeyRequestAsync(token, sessionId, initData, mimeType,
+                    keyType, optionalParameters));
+            return OK;
+        }
+
+        case PROVIDE_KEY_RESPONSE_ASYNC:
+        {
+            CHECK_INTERFACE(IDrm, data, reply);
+            uint32_t token = data.readInt32();
+            Vector<uint8_t> sessionId, response;
+            readVector(data, sessionId);
+            readVector(data, response);
+            reply->writeInt32(provideKeyResponseAsync(token, sessionId, response));
+            return OK;
+        }
+
         case REMOVE_KEYS:
         {
             CHECK_INTERFACE(IDrm, data, reply);
@@ -30,6 +30,7 @@ namespace android {
 
 enum {
     NOTIFY = IBinder::FIRST_CALL_TRANSACTION,
+    NOTIFY_KEY_OPERATION,
 };
 
 class BpDrmClient: public BpInterface<IDrmClient>
@@ -51,6 +52,18 @@ public:
         }
         remote()->transact(NOTIFY, data, &reply, IBinder::FLAG_ONEWAY);
     }
+
+    virtual void notifyKeyOperation(uint32_t token, status_t status, const Parcel *obj)
+    {
+        Parcel data, reply;
+        data.writeInterfaceToken(IDrmClient::getInterfaceDescriptor());
+        data.writeInt32(token);
+        data.writeInt32(status);
+        if (obj && obj->dataSize() > 0) {
+            data.appendFrom(const_cast<Parcel *>(obj), 0, obj->dataSize());
+        }
+        remote()->transact(NOTIFY_KEY_OPERATION, data, &reply, IBinder::FLAG_ONEWAY);
+    }
 };
 
 IMPLEMENT_META_INTERFACE(DrmClient, "android.media.IDrmClient");
@@ -73,6 +86,18 @@ status_t BnDrmClient::onTransact(
             notify((DrmPlugin::EventType)eventType, extra, &obj);
             return NO_ERROR;
         } break;
+        case NOTIFY_KEY_OPERATION: {
+            CHECK_INTERFACE(IDrmClient, data, reply);
+            uint32_t token = data.readInt32();
+            status_t status = data.readInt32();
+            Parcel obj;
+            if (data.dataAvail() > 0) {
+                obj.appendFrom(const_cast<Parcel *>(&data), data.dataPosition(), data.dataAvail());
+            }
+
+            notifyKeyOperation(token, status, &obj);
+            return NO_ERROR;
+        } break;
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <binder/IMemory.h>
 #include <binder/Parcel.h>
 #include <media/stagefright/MediaCodecList.h>
 #include <media/IMediaCodecList.h>
@@ -33,6 +34,7 @@ enum {
     GET_GLOBAL_SETTINGS,
     FIND_CODEC_BY_TYPE,
     FIND_CODEC_BY_NAME,
+    GET_SERIALIZED_LIST,
 };
 
 class BpMediaCodecList: public BpInterface<IMediaCodecList>
@@ -102,6 +104,17 @@ public:
         remote()->transact(FIND_CODEC_BY_NAME, data, &reply);
         return static_cast<ssize_t>(reply.readInt32());
     }
+
+    virtual sp<IMemory> getSerializedList() const
+    {
+        Parcel data, reply;
+        data.writeInterfaceToken(IMediaCodecList::getInterfaceDescriptor());
+        status_t err = remote()->transact(GET_SERIALIZED_LIST, data, &reply);
+        if (err != OK || reply.readInt32() != OK) {
+            return NULL;
+        }
+        return interface_cast<IMemory>(reply.readStrongBinder());
+    }
 };
 
 IMPLEMENT_META_INTERFACE(MediaCodecList, "android.media.IMediaCodecList");
@@ -181,6 +194,20 @@ status_t BnMediaCodecList::onTransact(
         }
         break;
 
+        case GET_SERIALIZED_LIST:
+        {
+            CHECK_INTERFACE(IMediaCodecList, data, reply);
+            sp<IMemory> memory = getSerializedList();
+            if (memory != NULL) {
+                reply->writeInt32(OK);
+                reply->writeStrongBinder(IInterface::asBinder(memory));
+            } else {
+                reply->writeInt32(NAME_NOT_FOUND);
+            }
+            return NO_ERROR;
+        }
+        break;
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -70,6 +70,7 @@ enum {
     GET_FRAME_AT_TIME,
     EXTRACT_ALBUM_ART,
     EXTRACT_METADATA,
+    GET_SCALED_FRAME_AT_TIME,
 };
 
 class BpMediaMetadataRetriever: public BpInterface<IMediaMetadataRetriever>
@@ -154,6 +155,28 @@ public:
         return interface_cast<IMemory>(reply.readStrongBinder());
     }
 
+    sp<IMemory> getScaledFrameAtTime(
+            int64_t timeUs, int option, int32_t maxWidth, int32_t maxHeight)
+    {
+        ALOGV("getScaledFrameAtTime: time(%" PRId64 " us), option(%d), max %dx%d",
+                timeUs, option, maxWidth, maxHeight);
+        Parcel data, reply;
+        data.writeInterfaceToken(IMediaMetadataRetriever::getInterfaceDescriptor());
+        data.writeInt64(timeUs);
+        data.writeInt32(option);
+        data.writeInt32(maxWidth);
+        data.writeInt32(maxHeight);
+#ifndef DISABLE_GROUP_SCHEDULE_HACK
+        sendSchedPolicy(data);
+#endif
+        remote()->transact(GET_SCALED_FRAME_AT_TIME, data, &reply);
+        status_t ret = reply.readInt32();
+        if (ret != NO_ERROR) {
+            return NULL;
+        }
+        return interface_cast<IMemory>(reply.readStrongBinder());
+    }
+
     sp<IMemory> extractAlbumArt()
     {
         Parcel data, reply;
@@ -270,6 +293,29 @@ status_t BnMediaMetadataRetriever::onTransact(
             }
 #ifndef DISABLE_GROUP_SCHEDULE_HACK
             restoreSchedPolicy();
+#endif
+            return NO_ERROR;
+        } break;
+        case GET_SCALED_FRAME_AT_TIME: {
+            CHECK_INTERFACE(IMediaMetadataRetriever, data, reply);
+            int64_t timeUs = data.readInt64();
+            int option = data.readInt32();
+            int32_t maxWidth = data.readInt32();
+            int32_t maxHeight = data.readInt32();
+            ALOGV("getScaledFrameAtTime: time(%" PRId64 " us), option(%d), max %dx%d",
+                    timeUs, option, maxWidth, maxHeight);
+#ifndef DISABLE_GROUP_SCHEDULE_HACK
+            setSchedPolicy(data);
+#endif
+            sp<IMemory> bitmap = getScaledFrameAtTime(timeUs, option, maxWidth, maxHeight);
+            if (bitmap != 0) {  // Don't send NULL across the binder interface
+                reply->writeInt32(NO_ERROR);
+                reply->writeStrongBinder(IInterface::asBinder(bitmap));
+            } else {
+                reply->writeInt32(UNKNOWN_ERROR);
+            }
+#ifndef DISABLE_GROUP_SCHEDULE_HACK
+            restoreSchedPolicy();
 #endif
             return NO_ERROR;
         } break;
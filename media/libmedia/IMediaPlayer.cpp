@@ -69,6 +69,7 @@ enum {
     SET_NEXT_PLAYER,
     SUSPEND,
     RESUME,
+    GET_METRICS,
 };
 
 class BpMediaPlayer: public BpInterface<IMediaPlayer>
@@ -437,6 +438,17 @@ public:
         remote()->transact(RESUME, data, &reply);
         return reply.readInt32();
      }
+
+    status_t getMetrics(Parcel *reply)
+    {
+        Parcel data;
+        data.writeInterfaceToken(IMediaPlayer::getInterfaceDescriptor());
+        status_t err = remote()->transact(GET_METRICS, data, reply);
+        if (err != OK) {
+            return err;
+        }
+        return reply->readInt32();
+    }
 };
 
 IMPLEMENT_META_INTERFACE(MediaPlayer, "android.media.IMediaPlayer");
@@ -712,6 +724,17 @@ status_t BnMediaPlayer::onTransact(
             reply->writeInt32(ret);
             return NO_ERROR;
         } break;
+        case GET_METRICS: {
+            CHECK_INTERFACE(IMediaPlayer, data, reply);
+            // the status goes first, the metrics follow it if it is OK
+            Parcel metrics;
+            status_t ret = getMetrics(&metrics);
+            reply->writeInt32(ret);
+            if (ret == OK) {
+                reply->appendFrom(&metrics, 0, metrics.dataSize());
+            }
+            return NO_ERROR;
+        } break;
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -61,8 +61,39 @@ enum {
     SET_INTERNAL_OPTION,
     UPDATE_GRAPHIC_BUFFER_IN_META,
     CONFIGURE_VIDEO_TUNNEL_MODE,
+    FILL_BUFFERS,
+    EMPTY_BUFFERS,
 };
 
+// Upper bound on the number of buffers accepted in one FILL_BUFFERS or EMPTY_BUFFERS
+// transaction; codecs never have more buffers than this on a port.
+static const size_t kMaxBuffersPerBatch = 256;
+
+status_t IOMX::fillBuffers(node_id node, const Vector<BufferSubmission> &buffers) {
+    status_t result = OK;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        status_t err = fillBuffer(node, buffers[i].mBuffer, buffers[i].mFenceFd);
+        if (err != OK && result == OK) {
+            result = err;
+        }
+    }
+    return result;
+}
+
+status_t IOMX::emptyBuffers(node_id node, const Vector<BufferSubmission> &buffers) {
+    status_t result = OK;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        const BufferSubmission &b = buffers[i];
+        status_t err = emptyBuffer(
+                node, b.mBuffer, b.mRangeOffset, b.mRangeLength, b.mFlags, b.mTimestamp,
+                b.mFenceFd);
+        if (err != OK && result == OK) {
+            result = err;
+        }
+    }
+    return result;
+}
+
 class BpOMX : public BpInterface<IOMX> {
 public:
     BpOMX(const sp<IBinder> &impl)
@@ -552,6 +583,14 @@ public:
         return reply.readInt32();
     }
 
+    virtual status_t fillBuffers(node_id node, const Vector<BufferSubmission> &buffers) {
+        return submitBuffers(FILL_BUFFERS, node, buffers);
+    }
+
+    virtual status_t emptyBuffers(node_id node, const Vector<BufferSubmission> &buffers) {
+        return submitBuffers(EMPTY_BUFFERS, node, buffers);
+    }
+
     virtual status_t getExtensionIndex(
             node_id node,
             const char *parameter_name,
@@ -588,6 +627,40 @@ public:
         data.writeInt32(type);
         remote()->transact(SET_INTERNAL_OPTION, data, &reply);
 
+        return reply.readInt32();
+    }
+
+private:
+    // Sends all of |buffers| in one transaction instead of one round trip per buffer.
+    status_t submitBuffers(
+            uint32_t code, node_id node, const Vector<BufferSubmission> &buffers) {
+        if (buffers.size() > kMaxBuffersPerBatch) {
+            for (size_t i = 0; i < buffers.size(); ++i) {
+                if (buffers[i].mFenceFd >= 0) {
+                    ::close(buffers[i].mFenceFd);
+                }
+            }
+            return BAD_VALUE;
+        }
+
+        Parcel data, reply;
+        data.writeInterfaceToken(IOMX::getInterfaceDescriptor());
+        data.writeInt32((int32_t)node);
+        data.writeInt32((int32_t)buffers.size());
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            const BufferSubmission &b = buffers[i];
+            data.writeInt32((int32_t)b.mBuffer);
+            data.writeInt32(b.mRangeOffset);
+            data.writeInt32(b.mRangeLength);
+            data.writeInt32(b.mFlags);
+            data.writeInt64(b.mTimestamp);
+            data.writeInt32(b.mFenceFd >= 0);
+            if (b.mFenceFd >= 0) {
+                data.writeFileDescriptor(b.mFenceFd, true /* takeOwnership */);
+            }
+        }
+        remote()->transact(code, data, &reply);
+
         return reply.readInt32();
     }
 };
@@ -1119,6 +1192,38 @@ status_t BnOMX::onTransact(
             return NO_ERROR;
         }
 
+        case FILL_BUFFERS:
+        case EMPTY_BUFFERS:
+        {
+            CHECK_OMX_INTERFACE(IOMX, data, reply);
+
+            node_id node = (node_id)data.readInt32();
+            size_t count = (size_t)data.readInt32();
+            if (count > kMaxBuffersPerBatch) {
+                ALOGE("invalid batch of %zu buffers", count);
+                reply->writeInt32(BAD_VALUE);
+                return NO_ERROR;
+            }
+
+            Vector<BufferSubmission> buffers;
+            buffers.setCapacity(count);
+            for (size_t i = 0; i < count; ++i) {
+                BufferSubmission b;
+                b.mBuffer = (buffer_id)data.readInt32();
+                b.mRangeOffset = data.readInt32();
+                b.mRangeLength = data.readInt32();
+                b.mFlags = data.readInt32();
+                b.mTimestamp = data.readInt64();
+                bool haveFence = data.readInt32();
+                b.mFenceFd = haveFence ? ::dup(data.readFileDescriptor()) : -1;
+                buffers.push(b);
+            }
+            reply->writeInt32(code == FILL_BUFFERS
+                    ? fillBuffers(node, buffers) : emptyBuffers(node, buffers));
+
+            return NO_ERROR;
+        }
+
         case GET_EXTENSION_INDEX:
         {
             CHECK_OMX_INTERFACE(IOMX, data, reply);
@@ -33,6 +33,7 @@ enum {
     ADD_RESOURCE,
     REMOVE_RESOURCE,
     RECLAIM_RESOURCE,
+    RECLAIM_RESOURCE_DRY_RUN,
 };
 
 template <typename T>
@@ -107,6 +108,23 @@ public:
         }
         return ret;
     }
+
+    virtual bool reclaimResourceDryRun(
+            int callingPid, const Vector<MediaResource> &resources, bool *policyConflict) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IResourceManagerService::getInterfaceDescriptor());
+        data.writeInt32(callingPid);
+        writeToParcel(&data, resources);
+
+        bool ret = false;
+        *policyConflict = false;
+        status_t status = remote()->transact(RECLAIM_RESOURCE_DRY_RUN, data, &reply);
+        if (status == NO_ERROR) {
+            ret = (bool)reply.readInt32();
+            *policyConflict = (bool)reply.readInt32();
+        }
+        return ret;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(ResourceManagerService, "android.media.IResourceManagerService");
@@ -156,6 +174,18 @@ status_t BnResourceManagerService::onTransact(
             return NO_ERROR;
         } break;
 
+        case RECLAIM_RESOURCE_DRY_RUN: {
+            CHECK_INTERFACE(IResourceManagerService, data, reply);
+            int callingPid = data.readInt32();
+            Vector<MediaResource> resources;
+            readFromParcel(data, &resources);
+            bool policyConflict = false;
+            bool ret = reclaimResourceDryRun(callingPid, resources, &policyConflict);
+            reply->writeInt32(ret);
+            reply->writeInt32(policyConflict);
+            return NO_ERROR;
+        } break;
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
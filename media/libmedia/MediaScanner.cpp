@@ -159,18 +159,50 @@ MediaScanResult MediaScanner::doProcessDirectory(
         return MEDIA_SCAN_RESULT_SKIPPED;
     }
 
-    MediaScanResult result = MEDIA_SCAN_RESULT_OK;
+    // Read the whole directory up front, so that files can be offered to
+    // prefetchFile() ahead of the client, and so that we don't hold a directory
+    // stream open per level of recursion.
+    Vector<struct dirent> entries;
     while ((entry = readdir(dir))) {
-        if (doProcessDirectoryEntry(path, pathRemaining, client, noMedia, entry, fileSpot)
-                == MEDIA_SCAN_RESULT_ERROR) {
+        entries.push(*entry);
+    }
+    closedir(dir);
+
+    MediaScanResult result = MEDIA_SCAN_RESULT_OK;
+    size_t prefetched = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        // files in .nomedia directories are never processed, don't prefetch them
+        while (!noMedia && prefetched < entries.size() && prefetched < i + kPrefetchWindow) {
+            doPrefetchDirectoryEntry(&entries.editItemAt(prefetched++), path, pathRemaining,
+                    fileSpot);
+        }
+        if (doProcessDirectoryEntry(path, pathRemaining, client, noMedia,
+                &entries.editItemAt(i), fileSpot) == MEDIA_SCAN_RESULT_ERROR) {
             result = MEDIA_SCAN_RESULT_ERROR;
             break;
         }
     }
-    closedir(dir);
     return result;
 }
 
+void MediaScanner::doPrefetchDirectoryEntry(struct dirent* entry, char *path,
+        int pathRemaining, char* fileSpot) {
+    const char* name = entry->d_name;
+    if (name[0] == '.' || entry->d_type == DT_DIR) {
+        return;
+    }
+    if ((int)strlen(name) + 1 > pathRemaining) {
+        return;
+    }
+    strcpy(fileSpot, name);
+
+    struct stat statbuf;
+    if (stat(path, &statbuf) == 0 && S_ISREG(statbuf.st_mode)) {
+        prefetchFile(path, statbuf.st_mtime, statbuf.st_size);
+    }
+    fileSpot[0] = 0;
+}
+
 MediaScanResult MediaScanner::doProcessDirectoryEntry(
         char *path, int pathRemaining, MediaScannerClient &client, bool noMedia,
         struct dirent* entry, char* fileSpot) {
@@ -865,6 +865,7 @@ ToneGenerator::~ToneGenerator() {
         ALOGV("Delete Track: %p", mpAudioTrack.get());
         mpAudioTrack.clear();
     }
+    clearWaveGens();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1014,7 +1015,7 @@ void ToneGenerator::stopTone() {
         ALOGV("waiting cond");
         status_t lStatus = mWaitCbkCond.waitRelative(mLock, seconds(3));
         if (lStatus == NO_ERROR) {
-            // If the tone was restarted exit now before calling clearWaveGens();
+            // If the tone was restarted exit now
             if (mState != TONE_INIT) {
                 mLock.unlock();
                 return;
@@ -1025,7 +1026,6 @@ void ToneGenerator::stopTone() {
             mState = TONE_IDLE;
             mpAudioTrack->stop();
         }
-        clearWaveGens();
     }
 
     mLock.unlock();
@@ -1184,14 +1184,9 @@ void ToneGenerator::audioCallback(int event, void* user, void *info) {
             // If segment,  ON -> OFF transition : ramp volume down
             if (lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[0] != 0) {
                 lWaveCmd = WaveGenerator::WAVEGEN_STOP;
-                unsigned int lFreqIdx = 0;
-                unsigned short lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[lFreqIdx];
-
-                while (lFrequency != 0) {
-                    WaveGenerator *lpWaveGen = lpToneGen->mWaveGens.valueFor(lFrequency);
-                    lpWaveGen->getSamples(lpOut, lGenSmp, lWaveCmd);
-                    lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[++lFreqIdx];
-                }
+                WaveGenerator::getSamples(lpToneGen->mSegmentWaveGens[lpToneGen->mCurSegment],
+                        lpToneGen->mNumSegmentWaveGens[lpToneGen->mCurSegment],
+                        lpOut, lGenSmp, lWaveCmd);
                 ALOGV("ON->OFF, lGenSmp: %d, lReqSmp: %d", lGenSmp, lReqSmp);
             }
 
@@ -1269,15 +1264,10 @@ void ToneGenerator::audioCallback(int event, void* user, void *info) {
         }
 
         if (lGenSmp) {
-            // If samples must be generated, call all active wave generators and acumulate waves in lpOut
-            unsigned int lFreqIdx = 0;
-            unsigned short lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[lFreqIdx];
-
-            while (lFrequency != 0) {
-                WaveGenerator *lpWaveGen = lpToneGen->mWaveGens.valueFor(lFrequency);
-                lpWaveGen->getSamples(lpOut, lGenSmp, lWaveCmd);
-                lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[++lFreqIdx];
-            }
+            // If samples must be generated, run all active wave generators and acumulate waves in lpOut
+            WaveGenerator::getSamples(lpToneGen->mSegmentWaveGens[lpToneGen->mCurSegment],
+                    lpToneGen->mNumSegmentWaveGens[lpToneGen->mCurSegment],
+                    lpOut, lGenSmp, lWaveCmd);
         }
 
         lNumSmp -= lReqSmp;
@@ -1360,9 +1350,6 @@ bool ToneGenerator::prepareWave() {
         return false;
     }
 
-    // Remove existing wave generators if any
-    clearWaveGens();
-
     mpToneDesc = mpNewToneDesc;
 
     if (mDurationMs == -1) {
@@ -1382,18 +1369,25 @@ bool ToneGenerator::prepareWave() {
         unsigned int freqIdx = 0;
         unsigned int frequency = mpToneDesc->segments[segmentIdx].waveFreq[freqIdx];
         while (frequency) {
-            // Instantiate a wave generator if  ot already done for this frequency
-            if (mWaveGens.indexOfKey(frequency) == NAME_NOT_FOUND) {
-                ToneGenerator::WaveGenerator *lpWaveGen =
-                        new ToneGenerator::WaveGenerator((unsigned short)mSamplingRate,
-                                frequency,
-                                TONEGEN_GAIN/lNumWaves);
-                mWaveGens.add(frequency, lpWaveGen);
+            // Instantiate a wave generator if not already done for this frequency and gain
+            uint32_t key = (lNumWaves << 16) | frequency;
+            ssize_t index = mWaveGens.indexOfKey(key);
+            ToneGenerator::WaveGenerator *lpWaveGen;
+            if (index >= 0) {
+                lpWaveGen = mWaveGens.valueAt(index);
+            } else {
+                lpWaveGen = new ToneGenerator::WaveGenerator((unsigned short)mSamplingRate,
+                        frequency,
+                        TONEGEN_GAIN/lNumWaves);
+                mWaveGens.add(key, lpWaveGen);
             }
+            mSegmentWaveGens[segmentIdx][freqIdx] = lpWaveGen;
             frequency = mpNewToneDesc->segments[segmentIdx].waveFreq[++freqIdx];
         }
+        mNumSegmentWaveGens[segmentIdx] = freqIdx;
         segmentIdx++;
     }
+    mNumSegmentWaveGens[segmentIdx] = 0;
 
     // Initialize tone sequencer
     mTotalSmp = 0;
@@ -1568,54 +1562,102 @@ ToneGenerator::WaveGenerator::~WaveGenerator() {
 ////////////////////////////////////////////////////////////////////////////////
 void ToneGenerator::WaveGenerator::getSamples(short *outBuffer,
         unsigned int count, unsigned int command) {
-    long lS1, lS2;
-    long lA1, lAmplitude;
-    long Sample;  // current sample
+    WaveGenerator * const waveGen = this;
+    getSamples(&waveGen, 1, outBuffer, count, command);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        WaveGenerator::getSamples()
+//
+//    Description:    Generates count samples of each of several sine waves and accumulates
+//        their sum in outBuffer.  Each generator runs in a lane of a NUM_LANES wide vector,
+//        with unused lanes set to 0, so that the per sample loop over the lanes has a
+//        constant trip count and is vectorized.  The result is bit exact with running
+//        each generator separately.
+//
+//    Input:
+//        waveGens:       wave generators of the segment.
+//        numWaveGens:    number of wave generators, at most TONEGEN_MAX_WAVES.
+//        outBuffer:      Output buffer where to accumulate samples.
+//        count:          number of samples to produce.
+//        command:        special action requested (see enum gen_command).
+//
+//    Output:
+//        none
+//
+////////////////////////////////////////////////////////////////////////////////
+void ToneGenerator::WaveGenerator::getSamples(WaveGenerator * const waveGens[],
+        unsigned int numWaveGens, short *outBuffer, unsigned int count, unsigned int command) {
+    int32_t lS1[NUM_LANES], lS2[NUM_LANES];
+    int32_t lA1[NUM_LANES], lAmplitude[NUM_LANES], lDec[NUM_LANES];
+
+    if (numWaveGens > NUM_LANES) {
+        numWaveGens = NUM_LANES;
+    }
+    if (command == WAVEGEN_STOP && count == 0) {
+        return;
+    }
 
     // init local
-    if (command == WAVEGEN_START) {
-        lS1 = (long)0;
-        lS2 = (long)mS2_0;
-    } else {
-        lS1 = (long)mS1;
-        lS2 = (long)mS2;
+    for (unsigned int lane = 0; lane < NUM_LANES; lane++) {
+        if (lane >= numWaveGens) {
+            lS1[lane] = lS2[lane] = lA1[lane] = lAmplitude[lane] = lDec[lane] = 0;
+            continue;
+        }
+        const WaveGenerator *lpWaveGen = waveGens[lane];
+        if (command == WAVEGEN_START) {
+            lS1[lane] = 0;
+            lS2[lane] = lpWaveGen->mS2_0;
+        } else {
+            lS1[lane] = lpWaveGen->mS1;
+            lS2[lane] = lpWaveGen->mS2;
+        }
+        lA1[lane] = lpWaveGen->mA1_Q14;
+        lAmplitude[lane] = lpWaveGen->mAmplitude_Q15;
+        lDec[lane] = 0;
+        if (command == WAVEGEN_STOP) {
+            lAmplitude[lane] <<= 16;
+            lDec[lane] = lAmplitude[lane] / (int32_t)count;
+        }
     }
-    lA1 = (long)mA1_Q14;
-    lAmplitude = (long)mAmplitude_Q15;
 
     if (command == WAVEGEN_STOP) {
-        lAmplitude <<= 16;
-        if (count == 0) {
-            return;
-        }
-        long dec = lAmplitude/count;
-        // loop generation
+        // loop generation, ramping the amplitude down
         while (count) {
             count--;
-            Sample = ((lA1 * lS1) >> S_Q14) - lS2;
-            // shift delay
-            lS2 = lS1;
-            lS1 = Sample;
-            Sample = ((lAmplitude>>16) * Sample) >> S_Q15;
-            *(outBuffer++) += (short)Sample;  // put result in buffer
-            lAmplitude -= dec;
+            int32_t lSum = 0;
+            for (unsigned int lane = 0; lane < NUM_LANES; lane++) {
+                int32_t Sample = ((lA1[lane] * lS1[lane]) >> S_Q14) - lS2[lane];
+                // shift delay
+                lS2[lane] = lS1[lane];
+                lS1[lane] = Sample;
+                lSum += (short)(((lAmplitude[lane] >> 16) * Sample) >> S_Q15);
+                lAmplitude[lane] -= lDec[lane];
+            }
+            *(outBuffer++) += (short)lSum;  // put result in buffer
         }
     } else {
         // loop generation
         while (count) {
             count--;
-            Sample = ((lA1 * lS1) >> S_Q14) - lS2;
-            // shift delay
-            lS2 = lS1;
-            lS1 = Sample;
-            Sample = (lAmplitude * Sample) >> S_Q15;
-            *(outBuffer++) += (short)Sample;  // put result in buffer
+            int32_t lSum = 0;
+            for (unsigned int lane = 0; lane < NUM_LANES; lane++) {
+                int32_t Sample = ((lA1[lane] * lS1[lane]) >> S_Q14) - lS2[lane];
+                // shift delay
+                lS2[lane] = lS1[lane];
+                lS1[lane] = Sample;
+                lSum += (short)((lAmplitude[lane] * Sample) >> S_Q15);
+            }
+            *(outBuffer++) += (short)lSum;  // put result in buffer
         }
     }
 
     // save status
-    mS1 = (short)lS1;
-    mS2 = (short)lS2;
+    for (unsigned int lane = 0; lane < numWaveGens; lane++) {
+        waveGens[lane]->mS1 = (short)lS1[lane];
+        waveGens[lane]->mS2 = (short)lS2[lane];
+    }
 }
 
 }  // end namespace android
@@ -993,4 +993,15 @@ status_t MediaPlayer::resume() {
     return OK;
 }
 
+status_t MediaPlayer::getMetrics(Parcel *reply)
+{
+    ALOGV("MediaPlayer::getMetrics()");
+    Mutex::Autolock _l(mLock);
+    if (mPlayer != NULL) {
+        return mPlayer->getMetrics(reply);
+    }
+    ALOGV("getMetrics: no active player");
+    return INVALID_OPERATION;
+}
+
 }; // namespace android
@@ -24,6 +24,7 @@ LOCAL_SRC_FILES:=               \
 LOCAL_SHARED_LIBRARIES :=       \
     libbinder                   \
     libcamera_client            \
+    libcommon_time_client       \
     libcrypto                   \
     libcutils                   \
     libdrmframework             \
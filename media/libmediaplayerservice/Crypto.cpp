@@ -260,6 +260,24 @@ ssize_t Crypto::decrypt(
             errorDetailMsg);
 }
 
+ssize_t Crypto::decrypt(
+        const uint8_t key[16],
+        const uint8_t iv[16],
+        CryptoPlugin::Mode mode,
+        const sp<IMemory> &sharedBuffer, size_t offset,
+        const CryptoPlugin::SubSample *subSamples, size_t numSubSamples,
+        const sp<IMemory> &destBuffer,
+        AString *errorDetailMsg) {
+    void *dstPtr = destBuffer->pointer();
+    if (dstPtr == NULL) {
+        return -EINVAL;
+    }
+
+    return decrypt(
+            false /* secure */, key, iv, mode, sharedBuffer, offset,
+            subSamples, numSubSamples, dstPtr, errorDetailMsg);
+}
+
 void Crypto::notifyResolution(uint32_t width, uint32_t height) {
     Mutex::Autolock autoLock(mLock);
 
@@ -89,15 +89,43 @@ private:
     DISALLOW_EVIL_CONSTRUCTORS(DrmSessionClient);
 };
 
+struct Drm::KeyOperationThread : public Thread {
+    KeyOperationThread(Drm *drm)
+        : Thread(false /* canCallJava */),
+          mDrm(drm) {
+    }
+
+    virtual bool threadLoop() {
+        return mDrm->runKeyOperation();
+    }
+
+private:
+    // never outlives mDrm, see ~Drm()
+    Drm *mDrm;
+
+    DISALLOW_EVIL_CONSTRUCTORS(KeyOperationThread);
+};
+
 Drm::Drm()
     : mInitCheck(NO_INIT),
       mDrmSessionClient(new DrmSessionClient(this)),
       mListener(NULL),
+      mKeyOperationExit(false),
       mFactory(NULL),
       mPlugin(NULL) {
 }
 
 Drm::~Drm() {
+    sp<KeyOperationThread> thread;
+    {
+        Mutex::Autolock lock(mKeyOperationLock);
+        thread = mKeyOperationThread;
+        mKeyOperationExit = true;
+        mKeyOperationCondition.signal();
+    }
+    if (thread != NULL) {
+        thread->requestExitAndWait();
+    }
     DrmSessionManager::Instance()->removeDrm(mDrmSessionClient);
     delete mPlugin;
     mPlugin = NULL;
@@ -439,6 +467,108 @@ status_t Drm::provideKeyResponse(Vector<uint8_t> const &sessionId,
     return mPlugin->provideKeyResponse(sessionId, response, keySetId);
 }
 
+status_t Drm::getKeyRequestAsync(uint32_t token,
+                                 Vector<uint8_t> const &sessionId,
+                                 Vector<uint8_t> const &initData,
+                                 String8 const &mimeType, DrmPlugin::KeyType keyType,
+                                 KeyedVector<String8, String8> const &optionalParameters) {
+    KeyOperation operation;
+    operation.mIsResponse = false;
+    operation.mToken = token;
+    operation.mSessionId = sessionId;
+    operation.mData = initData;
+    operation.mMimeType = mimeType;
+    operation.mKeyType = keyType;
+    operation.mOptionalParameters = optionalParameters;
+    return queueKeyOperation(operation);
+}
+
+status_t Drm::provideKeyResponseAsync(uint32_t token,
+                                      Vector<uint8_t> const &sessionId,
+                                      Vector<uint8_t> const &response) {
+    KeyOperation operation;
+    operation.mIsResponse = true;
+    operation.mToken = token;
+    operation.mSessionId = sessionId;
+    operation.mData = response;
+    operation.mKeyType = DrmPlugin::kKeyType_Streaming;
+    return queueKeyOperation(operation);
+}
+
+status_t Drm::queueKeyOperation(const KeyOperation &operation) {
+    {
+        // the result could not be delivered
+        Mutex::Autolock lock(mEventLock);
+        if (mListener == NULL) {
+            return INVALID_OPERATION;
+        }
+    }
+
+    Mutex::Autolock lock(mKeyOperationLock);
+    if (mKeyOperationThread == NULL) {
+        sp<KeyOperationThread> thread = new KeyOperationThread(this);
+        status_t err = thread->run("DrmKeyOperation");
+        if (err != OK) {
+            ALOGE("failed to start key operation thread: %d", err);
+            return err;
+        }
+        mKeyOperationThread = thread;
+    }
+    mKeyOperations.push_back(operation);
+    mKeyOperationCondition.signal();
+    return OK;
+}
+
+bool Drm::runKeyOperation() {
+    KeyOperation operation;
+    {
+        Mutex::Autolock lock(mKeyOperationLock);
+        while (mKeyOperations.empty() && !mKeyOperationExit) {
+            mKeyOperationCondition.wait(mKeyOperationLock);
+        }
+        if (mKeyOperationExit) {
+            return false;
+        }
+        operation = *mKeyOperations.begin();
+        mKeyOperations.erase(mKeyOperations.begin());
+    }
+
+    Parcel obj;
+    writeByteArray(obj, &operation.mSessionId);
+
+    status_t err;
+    if (operation.mIsResponse) {
+        Vector<uint8_t> keySetId;
+        err = provideKeyResponse(operation.mSessionId, operation.mData, keySetId);
+        if (err == OK) {
+            writeByteArray(obj, &keySetId);
+        }
+    } else {
+        Vector<uint8_t> request;
+        String8 defaultUrl;
+        DrmPlugin::KeyRequestType keyRequestType = DrmPlugin::kKeyRequestType_Unknown;
+        err = getKeyRequest(operation.mSessionId, operation.mData, operation.mMimeType,
+                            operation.mKeyType, operation.mOptionalParameters,
+                            request, defaultUrl, &keyRequestType);
+        if (err == OK) {
+            writeByteArray(obj, &request);
+            obj.writeString8(defaultUrl);
+            obj.writeInt32(keyRequestType);
+        }
+    }
+    ALOGV("key operation %u done: %d", operation.mToken, err);
+
+    mEventLock.lock();
+    sp<IDrmClient> listener = mListener;
+    mEventLock.unlock();
+
+    if (listener != NULL) {
+        Mutex::Autolock lock(mNotifyLock);
+        listener->notifyKeyOperation(operation.mToken, err, &obj);
+    }
+    return true;
+}
+
 status_t Drm::removeKeys(Vector<uint8_t> const &keySetId) {
     Mutex::Autolock autoLock(mLock);
 
@@ -60,6 +60,16 @@ struct Drm : public BnDrm,
                                         Vector<uint8_t> const &response,
                                         Vector<uint8_t> &keySetId);
 
+    virtual status_t getKeyRequestAsync(uint32_t token,
+                                        Vector<uint8_t> const &sessionId,
+                                        Vector<uint8_t> const &initData,
+                                        String8 const &mimeType, DrmPlugin::KeyType keyType,
+                                        KeyedVector<String8, String8> const &optionalParameters);
+
+    virtual status_t provideKeyResponseAsync(uint32_t token,
+                                             Vector<uint8_t> const &sessionId,
+                                             Vector<uint8_t> const &response);
+
     virtual status_t removeKeys(Vector<uint8_t> const &keySetId);
 
     virtual status_t restoreKeys(Vector<uint8_t> const &sessionId,
@@ -143,6 +153,17 @@ struct Drm : public BnDrm,
     virtual void binderDied(const wp<IBinder> &the_late_who);
 
 private:
+    struct KeyOperation {
+        bool mIsResponse;       // provideKeyResponse() if true, getKeyRequest() otherwise
+        uint32_t mToken;
+        Vector<uint8_t> mSessionId;
+        Vector<uint8_t> mData;  // init data, or the key response
+        String8 mMimeType;
+        DrmPlugin::KeyType mKeyType;
+        KeyedVector<String8, String8> mOptionalParameters;
+    };
+    struct KeyOperationThread;
+
     static Mutex mLock;
 
     status_t mInitCheck;
@@ -153,6 +174,14 @@ private:
     mutable Mutex mEventLock;
     mutable Mutex mNotifyLock;
 
+    // Operations queued by getKeyRequestAsync() and provideKeyResponseAsync(), run in
+    // order on mKeyOperationThread, which is started by the first one.
+    Mutex mKeyOperationLock;
+    Condition mKeyOperationCondition;
+    List<KeyOperation> mKeyOperations;
+    sp<KeyOperationThread> mKeyOperationThread;
+    bool mKeyOperationExit;
+
     sp<SharedLibrary> mLibrary;
     DrmFactory *mFactory;
     DrmPlugin *mPlugin;
@@ -164,6 +193,8 @@ private:
     void findFactoryForScheme(const uint8_t uuid[16]);
     bool loadLibraryForScheme(const String8 &path, const uint8_t uuid[16]);
     void closeFactory();
+    status_t queueKeyOperation(const KeyOperation &operation);
+    bool runKeyOperation();
     void writeByteArray(Parcel &obj, Vector<uint8_t> const *array);
 
     DISALLOW_EVIL_CONSTRUCTORS(Drm);
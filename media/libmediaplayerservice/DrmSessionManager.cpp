@@ -50,6 +50,13 @@ bool isEqualSessionId(const Vector<uint8_t> &sessionId1, const Vector<uint8_t> &
     return true;
 }
 
+static bool operator<(const Vector<uint8_t> &lhs, const Vector<uint8_t> &rhs) {
+    if (lhs.size() != rhs.size()) {
+        return lhs.size() < rhs.size();
+    }
+    return memcmp(lhs.array(), rhs.array(), lhs.size()) < 0;
+}
+
 sp<DrmSessionManager> DrmSessionManager::Instance() {
     static sp<DrmSessionManager> drmSessionManager = new DrmSessionManager();
     return drmSessionManager;
@@ -75,6 +82,8 @@ void DrmSessionManager::addSession(
     info.drm = drm;
     info.sessionId = sessionId;
     info.timeStamp = getTime_l();
+    info.useCount = 0;
+    mSessionPids.add(sessionId, pid);
     ssize_t index = mSessionMap.indexOfKey(pid);
     if (index < 0) {
         // new pid
@@ -90,15 +99,21 @@ void DrmSessionManager::useSession(const Vector<uint8_t> &sessionId) {
     ALOGV("useSession(%s)", GetSessionIdString(sessionId).string());
 
     Mutex::Autolock lock(mLock);
-    for (size_t i = 0; i < mSessionMap.size(); ++i) {
-        SessionInfos& infos = mSessionMap.editValueAt(i);
-        for (size_t j = 0; j < infos.size(); ++j) {
-            SessionInfo& info = infos.editItemAt(j);
-            if (isEqualSessionId(sessionId, info.sessionId)) {
-                info.timeStamp = getTime_l();
-                return;
-            }
-        }
+    size_t index;
+    SessionInfos* infos = findSession_l(sessionId, &index);
+    if (infos == NULL) {
+        return;
+    }
+    SessionInfo info = infos->itemAt(index);
+    info.timeStamp = getTime_l();
+    ++info.useCount;
+    // keep the sessions of the process in use order, so that the least used one is
+    // always the first.
+    if (index + 1 < infos->size()) {
+        infos->removeAt(index);
+        infos->push_back(info);
+    } else {
+        infos->editItemAt(index) = info;
     }
 }
 
@@ -106,15 +121,13 @@ void DrmSessionManager::removeSession(const Vector<uint8_t> &sessionId) {
     ALOGV("removeSession(%s)", GetSessionIdString(sessionId).string());
 
     Mutex::Autolock lock(mLock);
-    for (size_t i = 0; i < mSessionMap.size(); ++i) {
-        SessionInfos& infos = mSessionMap.editValueAt(i);
-        for (size_t j = 0; j < infos.size(); ++j) {
-            if (isEqualSessionId(sessionId, infos[j].sessionId)) {
-                infos.removeAt(j);
-                return;
-            }
-        }
+    size_t index;
+    SessionInfos* infos = findSession_l(sessionId, &index);
+    if (infos == NULL) {
+        return;
     }
+    infos->removeAt(index);
+    mSessionPids.removeItem(sessionId);
 }
 
 void DrmSessionManager::removeDrm(sp<DrmSessionClientInterface> drm) {
@@ -127,6 +140,7 @@ void DrmSessionManager::removeDrm(sp<DrmSessionClientInterface> drm) {
         for (size_t j = 0; j < infos.size();) {
             if (infos[j].drm == drm) {
                 ALOGV("removed session (%s)", GetSessionIdString(infos[j].sessionId).string());
+                mSessionPids.removeItem(infos[j].sessionId);
                 j = infos.removeAt(j);
                 found = true;
             } else {
@@ -216,25 +230,35 @@ bool DrmSessionManager::getLeastUsedSession_l(
         return false;
     }
 
-    int leastUsedIndex = -1;
-    int64_t minTs = LLONG_MAX;
+    // sessions are kept in use order, see useSession().
     const SessionInfos& infos = mSessionMap.valueAt(index);
-    for (size_t j = 0; j < infos.size(); ++j) {
-        if (leastUsedIndex == -1) {
-            leastUsedIndex = j;
-            minTs = infos[j].timeStamp;
-        } else {
-            if (infos[j].timeStamp < minTs) {
-                leastUsedIndex = j;
-                minTs = infos[j].timeStamp;
-            }
-        }
+    if (infos.isEmpty()) {
+        return false;
     }
-    if (leastUsedIndex != -1) {
-        *drm = infos[leastUsedIndex].drm;
-        *sessionId = infos[leastUsedIndex].sessionId;
+    ALOGV("least used session (%s) used %u times",
+            GetSessionIdString(infos[0].sessionId).string(), infos[0].useCount);
+    *drm = infos[0].drm;
+    *sessionId = infos[0].sessionId;
+    return true;
+}
+
+SessionInfos* DrmSessionManager::findSession_l(const Vector<uint8_t>& sessionId, size_t* index) {
+    ssize_t pidIndex = mSessionPids.indexOfKey(sessionId);
+    if (pidIndex < 0) {
+        return NULL;
+    }
+    pidIndex = mSessionMap.indexOfKey(mSessionPids.valueAt(pidIndex));
+    if (pidIndex < 0) {
+        return NULL;
+    }
+    SessionInfos& infos = mSessionMap.editValueAt(pidIndex);
+    for (size_t j = infos.size(); j-- > 0;) {
+        if (isEqualSessionId(sessionId, infos[j].sessionId)) {
+            *index = j;
+            return &infos;
+        }
     }
-    return (leastUsedIndex != -1);
+    return NULL;
 }
 
 }  // namespace android
@@ -36,10 +36,13 @@ struct SessionInfo {
     sp<DrmSessionClientInterface> drm;
     Vector<uint8_t> sessionId;
     int64_t timeStamp;
+    uint32_t useCount;
 };
 
+// Sessions of one process, least recently used first.
 typedef Vector<SessionInfo > SessionInfos;
 typedef KeyedVector<int, SessionInfos > PidSessionInfosMap;
+typedef KeyedVector<Vector<uint8_t>, int> SessionPidMap;
 
 struct DrmSessionManager : public RefBase {
     static sp<DrmSessionManager> Instance();
@@ -63,10 +66,12 @@ private:
     bool getLowestPriority_l(int* lowestPriorityPid, int* lowestPriority);
     bool getLeastUsedSession_l(
             int pid, sp<DrmSessionClientInterface>* drm, Vector<uint8_t>* sessionId);
+    SessionInfos* findSession_l(const Vector<uint8_t>& sessionId, size_t* index);
 
     sp<ProcessInfoInterface> mProcessInfo;
     mutable Mutex mLock;
     PidSessionInfosMap mSessionMap;
+    SessionPidMap mSessionPids;  // owning pid of each session in mSessionMap
     int64_t mTime;
 
     DISALLOW_EVIL_CONSTRUCTORS(DrmSessionManager);
@@ -62,6 +62,7 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooperRoster.h>
 #include <mediautils/BatteryNotifier.h>
+#include <mediautils/MediaSchedulingPolicy.h>
 
 #include <system/audio.h>
 
@@ -538,6 +539,7 @@ status_t MediaPlayerService::dump(int fd, const Vector<String16>& args)
         }
 
         gLooperRoster.dump(fd, args);
+        MediaSchedulingPolicy::getInstance().dump(fd);
 
         bool dumpMem = false;
         for (size_t i = 0; i < args.size(); i++) {
@@ -1332,6 +1334,14 @@ status_t MediaPlayerService::Client::resume()
     return p->resume();
 }
 
+status_t MediaPlayerService::Client::getMetrics(Parcel *reply)
+{
+    ALOGV("[%d] getMetrics", mConnId);
+    sp<MediaPlayerBase> p = getPlayer();
+    if (p == NULL) return NO_INIT;
+    return p->getMetrics(reply);
+}
+
 #if CALLBACK_ANTAGONIZER
 const int Antagonizer::interval = 10000; // 10 msecs
 
@@ -1387,7 +1397,8 @@ MediaPlayerService::AudioOutput::AudioOutput(int sessionId, int uid, int pid,
       mPid(pid),
       mSendLevel(0.0),
       mAuxEffectId(0),
-      mFlags(AUDIO_OUTPUT_FLAG_NONE)
+      mFlags(AUDIO_OUTPUT_FLAG_NONE),
+      mOffloadBitRate(0)
 {
     ALOGV("AudioOutput(%d)", sessionId);
     if (attr != NULL) {
@@ -1476,6 +1487,26 @@ float MediaPlayerService::AudioOutput::msecsPerFrame() const
     return mMsecsPerFrame;
 }
 
+int64_t MediaPlayerService::AudioOutput::getBufferDurationInUs() const
+{
+    Mutex::Autolock lock(mLock);
+    if (mTrack == 0) return -1;
+    if (mFlags & AUDIO_OUTPUT_FLAG_COMPRESS_OFFLOAD) {
+        // the buffer holds compressed bytes
+        if (mOffloadBitRate == 0) return -1;
+        return (int64_t)mTrack->frameCount() * mTrack->frameSize() * 8000000ll / mOffloadBitRate;
+    }
+    if (mSampleRateHz == 0) return -1;
+    return (int64_t)mTrack->frameCount() * 1000000ll / mSampleRateHz;
+}
+
+uint32_t MediaPlayerService::AudioOutput::getUnderrunFrames() const
+{
+    Mutex::Autolock lock(mLock);
+    if (mTrack == 0) return 0;
+    return mTrack->getUnderrunFrames();
+}
+
 status_t MediaPlayerService::AudioOutput::getPosition(uint32_t *position) const
 {
     Mutex::Autolock lock(mLock);
@@ -1785,8 +1816,10 @@ status_t MediaPlayerService::AudioOutput::open(
 
     if (offloadInfo) {
         mBitWidth = offloadInfo->bit_width;
+        mOffloadBitRate = offloadInfo->bit_rate;
     } else {
         mBitWidth = 16;
+        mOffloadBitRate = 0;
     }
 
     uint32_t pos;
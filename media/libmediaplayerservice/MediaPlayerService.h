@@ -86,6 +86,8 @@ class MediaPlayerService : public BnMediaPlayerService
         virtual ssize_t         frameSize() const;
         virtual uint32_t        latency() const;
         virtual float           msecsPerFrame() const;
+        virtual int64_t         getBufferDurationInUs() const;
+        virtual uint32_t        getUnderrunFrames() const;
         virtual status_t        getPosition(uint32_t *position) const;
         virtual status_t        getTimestamp(AudioTimestamp &ts) const;
         virtual status_t        getFramesWritten(uint32_t *frameswritten) const;
@@ -161,6 +163,7 @@ class MediaPlayerService : public BnMediaPlayerService
         static bool             mIsOnEmulator;
         static int              mMinBufferCount;  // 12 for emulator; otherwise 4
         uint16_t                mBitWidth;
+        uint32_t                mOffloadBitRate; // of the compressed content, 0 if unknown
 
         // CallbackData is what is passed to the AudioTrack as the "user" data.
         // We need to be able to target this to a different Output on the fly,
@@ -337,6 +340,7 @@ private:
 
         virtual status_t        suspend();
         virtual status_t        resume();
+        virtual status_t        getMetrics(Parcel *reply);
 
     private:
         friend class MediaPlayerService;
@@ -109,6 +109,7 @@ status_t MetadataRetrieverClient::setDataSource(
 {
     ALOGV("setDataSource(%s)", url);
     Mutex::Autolock lock(mLock);
+    mSourceKey.clear();
     if (url == NULL) {
         return UNKNOWN_ERROR;
     }
@@ -135,6 +136,7 @@ status_t MetadataRetrieverClient::setDataSource(int fd, int64_t offset, int64_t
 {
     ALOGV("setDataSource fd=%d, offset=%" PRId64 ", length=%" PRId64 "", fd, offset, length);
     Mutex::Autolock lock(mLock);
+    mSourceKey.clear();
     struct stat sb;
     int ret = fstat(fd, &sb);
     if (ret != 0) {
@@ -167,7 +169,15 @@ status_t MetadataRetrieverClient::setDataSource(int fd, int64_t offset, int64_t
         return NO_INIT;
     }
     status_t status = p->setDataSource(fd, offset, length);
-    if (status == NO_ERROR) mRetriever = p;
+    if (status == NO_ERROR) {
+        mRetriever = p;
+        // a rewritten file changes its size or modification time
+        mSourceKey = String8::format("%" PRIu64 ":%" PRIu64 ":%" PRId64 ":%" PRId64
+                ":%" PRId64 ":%" PRId64,
+                static_cast<uint64_t>(sb.st_dev), static_cast<uint64_t>(sb.st_ino),
+                static_cast<int64_t>(sb.st_size), static_cast<int64_t>(sb.st_mtime),
+                offset, length);
+    }
     return status;
 }
 
@@ -176,6 +186,7 @@ status_t MetadataRetrieverClient::setDataSource(
 {
     ALOGV("setDataSource(IDataSource)");
     Mutex::Autolock lock(mLock);
+    mSourceKey.clear();
 
     sp<DataSource> dataSource = DataSource::CreateFromIDataSource(source);
     player_type playerType =
@@ -189,6 +200,32 @@ status_t MetadataRetrieverClient::setDataSource(
 }
 
 Mutex MetadataRetrieverClient::sLock;
+Vector<MetadataRetrieverClient::CachedFrame> MetadataRetrieverClient::sFrameCache;
+
+const VideoFrame *MetadataRetrieverClient::findCachedFrame(const String8 &key)
+{
+    for (size_t i = 0; i < sFrameCache.size(); ++i) {
+        if (sFrameCache[i].mKey == key) {
+            CachedFrame entry = sFrameCache[i];
+            sFrameCache.removeAt(i);
+            sFrameCache.push_back(entry);
+            return entry.mFrame;
+        }
+    }
+    return NULL;
+}
+
+void MetadataRetrieverClient::addCachedFrame(const String8 &key, VideoFrame *frame)
+{
+    if (sFrameCache.size() >= kMaxCachedFrames) {
+        delete sFrameCache[0].mFrame;
+        sFrameCache.removeAt(0);
+    }
+    CachedFrame entry;
+    entry.mKey = key;
+    entry.mFrame = frame;
+    sFrameCache.push_back(entry);
+}
 
 sp<IMemory> MetadataRetrieverClient::getFrameAtTime(int64_t timeUs, int option)
 {
@@ -205,17 +242,61 @@ sp<IMemory> MetadataRetrieverClient::getFrameAtTime(int64_t timeUs, int option)
         ALOGE("failed to capture a video frame");
         return NULL;
     }
+    sp<IMemory> thumbnail = setThumbnail(frame);
+    delete frame;  // Fix memory leakage
+    return thumbnail;
+}
+
+sp<IMemory> MetadataRetrieverClient::getScaledFrameAtTime(
+        int64_t timeUs, int option, int32_t maxWidth, int32_t maxHeight)
+{
+    ALOGV("getScaledFrameAtTime: time(%" PRId64 " us) option(%d) max %dx%d",
+            timeUs, option, maxWidth, maxHeight);
+    Mutex::Autolock lock(mLock);
+    Mutex::Autolock glock(sLock);
+    mThumbnail.clear();
+    if (mRetriever == NULL) {
+        ALOGE("retriever is not initialized");
+        return NULL;
+    }
+
+    String8 key;
+    if (!mSourceKey.isEmpty()) {
+        key = String8::format("%s@%" PRId64 ":%d:%dx%d",
+                mSourceKey.string(), timeUs, option, maxWidth, maxHeight);
+        const VideoFrame *cached = findCachedFrame(key);
+        if (cached != NULL) {
+            ALOGV("thumbnail cache hit");
+            // every client gets its own copy, so that none can modify another's frame
+            return setThumbnail(cached);
+        }
+    }
+
+    VideoFrame *frame = mRetriever->getScaledFrameAtTime(timeUs, option, maxWidth, maxHeight);
+    if (frame == NULL) {
+        ALOGE("failed to capture a video frame");
+        return NULL;
+    }
+    sp<IMemory> thumbnail = setThumbnail(frame);
+    if (thumbnail != NULL && !key.isEmpty()) {
+        addCachedFrame(key, frame);
+    } else {
+        delete frame;
+    }
+    return thumbnail;
+}
+
+sp<IMemory> MetadataRetrieverClient::setThumbnail(const VideoFrame *frame)
+{
     size_t size = sizeof(VideoFrame) + frame->mSize;
     sp<MemoryHeapBase> heap = new MemoryHeapBase(size, 0, "MetadataRetrieverClient");
     if (heap == NULL) {
         ALOGE("failed to create MemoryDealer");
-        delete frame;
         return NULL;
     }
     mThumbnail = new MemoryBase(heap, 0, size);
     if (mThumbnail == NULL) {
         ALOGE("not enough memory for VideoFrame size=%zu", size);
-        delete frame;
         return NULL;
     }
     VideoFrame *frameCopy = static_cast<VideoFrame *>(mThumbnail->pointer());
@@ -229,7 +310,6 @@ sp<IMemory> MetadataRetrieverClient::getFrameAtTime(int64_t timeUs, int option)
     frameCopy->mData = (uint8_t *)frameCopy + sizeof(VideoFrame);
     memcpy(frameCopy->mData, frame->mData, frame->mSize);
     frameCopy->mData = 0;
-    delete frame;  // Fix memory leakage
     return mThumbnail;
 }
 
@@ -51,6 +51,8 @@ public:
     virtual status_t                setDataSource(int fd, int64_t offset, int64_t length);
     virtual status_t                setDataSource(const sp<IDataSource>& source);
     virtual sp<IMemory>             getFrameAtTime(int64_t timeUs, int option);
+    virtual sp<IMemory>             getScaledFrameAtTime(
+            int64_t timeUs, int option, int32_t maxWidth, int32_t maxHeight);
     virtual sp<IMemory>             extractAlbumArt();
     virtual const char*             extractMetadata(int keyCode);
 
@@ -62,10 +64,29 @@ private:
     explicit MetadataRetrieverClient(pid_t pid);
     virtual ~MetadataRetrieverClient();
 
+    // Number of scaled thumbnails kept across clients, so that a gallery scrolling
+    // back over the same files does not decode them again.
+    static const size_t kMaxCachedFrames = 8;
+
+    struct CachedFrame {
+        String8     mKey;
+        VideoFrame *mFrame;
+    };
+
+    // Copies the frame into a new shared memory thumbnail, called with mLock held.
+    sp<IMemory> setThumbnail(const VideoFrame *frame);
+
+    // The cache is only used for file descriptor sources, and is guarded by sLock.
+    static const VideoFrame *findCachedFrame(const String8 &key);
+    static void addCachedFrame(const String8 &key, VideoFrame *frame);
+
     mutable Mutex                          mLock;
     static  Mutex                          sLock;
     sp<MediaMetadataRetrieverBase>         mRetriever;
     pid_t                                  mPid;
+    // Identifies the file of a file descriptor source, empty for other sources
+    String8                                mSourceKey;
+    static  Vector<CachedFrame>            sFrameCache;  // least recently used first
 
     // Keep the shared memory copy of album art and capture frame (for thumbnail)
     sp<IMemory>                            mAlbumArt;
@@ -49,6 +49,7 @@
 #include <camera/ICamera.h>
 #include <camera/CameraParameters.h>
 
+#include <cutils/properties.h>
 #include <utils/Errors.h>
 #include <sys/types.h>
 #include <ctype.h>
@@ -90,6 +91,7 @@ StagefrightRecorder::StagefrightRecorder(const String16 &opPackageName)
 StagefrightRecorder::~StagefrightRecorder() {
     ALOGV("Destructor");
     stop();
+    mWarmVideoEncoder.clear();
 
     if (mLooper != NULL) {
         mLooper->stop();
@@ -486,6 +488,23 @@ status_t StagefrightRecorder::setParamInterleaveDuration(int32_t durationUs) {
     return OK;
 }
 
+// If durationUs > 0, MPEG-4 output is fragmented with a fragment per track
+// about every durationUs; 0 turns fragmenting off.
+status_t StagefrightRecorder::setParamFragmentDuration(int64_t durationUs) {
+    ALOGV("setParamFragmentDuration: %" PRId64 " us", durationUs);
+    if (durationUs < 0 || (durationUs > 0 && durationUs < 100000)) {  // 100 ms
+        // Every fragment costs a moof, short ones waste space and writes.
+        ALOGE("Fragment duration is invalid or too small: %" PRId64 " us", durationUs);
+        return BAD_VALUE;
+    } else if (durationUs >= 10000000) {  // 10 seconds
+        // A fragment is held in memory until it is written out
+        ALOGE("Fragment duration is too large: %" PRId64 " us", durationUs);
+        return BAD_VALUE;
+    }
+    mFragmentDurationUs = durationUs;
+    return OK;
+}
+
 // If seconds <  0, only the first frame is I frame, and rest are all P frames
 // If seconds == 0, all frames are encoded as I frames. No P frames
 // If seconds >  0, it is the time spacing (seconds) between 2 neighboring I frames
@@ -649,6 +668,11 @@ status_t StagefrightRecorder::setParameter(
         if (safe_strtoi32(value.string(), &timeScale)) {
             return setParamMovieTimeScale(timeScale);
         }
+    } else if (key == "param-fragment-duration-us") {
+        int64_t durationUs;
+        if (safe_strtoi64(value.string(), &durationUs)) {
+            return setParamFragmentDuration(durationUs);
+        }
     } else if (key == "param-use-64bit-offset") {
         int32_t use64BitOffset;
         if (safe_strtoi32(value.string(), &use64BitOffset)) {
@@ -1533,13 +1557,13 @@ status_t StagefrightRecorder::setupCameraSource(
         mCameraSourceTimeLapse = AVFactory::get()->CreateCameraSourceTimeLapseFromCamera(
                 mCamera, mCameraProxy, mCameraId, mClientName, mClientUid,
                 videoSize, mFrameRate, mPreviewSurface,
-                mTimeBetweenCaptureUs);
+                mTimeBetweenCaptureUs, true /* storeMetaDataInVideoBuffers */);
         *cameraSource = mCameraSourceTimeLapse;
     } else {
         *cameraSource = AVFactory::get()->CreateCameraSourceFromCamera(
                 mCamera, mCameraProxy, mCameraId, mClientName, mClientUid,
                 videoSize, mFrameRate,
-                mPreviewSurface);
+                mPreviewSurface, true /* storeMetaDataInVideoBuffers */);
     }
     AVUtils::get()->cacheCaptureBuffers(mCamera, mVideoEncoder);
     mCamera.clear();
@@ -1569,6 +1593,10 @@ status_t StagefrightRecorder::setupCameraSource(
 
     mIsMetaDataStoredInVideoBuffers =
         (*cameraSource)->isMetaDataStoredInVideoBuffers();
+    if (!mIsMetaDataStoredInVideoBuffers) {
+        ALOGW("Camera does not support metadata in video buffers, "
+              "every frame will be copied into the encoder");
+    }
 
     return OK;
 }
@@ -1679,8 +1707,33 @@ status_t StagefrightRecorder::setupVideoEncoder(
         flags |= MediaCodecSource::FLAG_USE_SURFACE_INPUT;
     }
 
-    sp<MediaCodecSource> encoder = MediaCodecSource::Create(
-            mLooper, format, cameraSource, mPersistentSurface, flags);
+    // Back to back sessions on the same persistent surface can resume the
+    // previous session's encoder instead of allocating a new one.
+    bool reuseEncoder = cameraSource == NULL && mPersistentSurface != NULL
+            && property_get_bool("media.recorder.reuse-encoder", true);
+    AString formatString = format->debugString();
+
+    sp<MediaCodecSource> encoder;
+    if (reuseEncoder && mWarmVideoEncoder != NULL
+            && IInterface::asBinder(mWarmPersistentSurface)
+                    == IInterface::asBinder(mPersistentSurface)
+            && mWarmVideoFormat == formatString) {
+        ALOGV("reusing the video encoder of the previous session");
+        encoder = mWarmVideoEncoder;
+    } else {
+        mWarmVideoEncoder.clear();
+        mWarmPersistentSurface.clear();
+        if (reuseEncoder) {
+            flags |= MediaCodecSource::FLAG_REUSE_ENCODER;
+        }
+        encoder = MediaCodecSource::Create(
+                mLooper, format, cameraSource, mPersistentSurface, flags);
+        if (encoder != NULL && reuseEncoder) {
+            mWarmVideoEncoder = encoder;
+            mWarmPersistentSurface = mPersistentSurface;
+            mWarmVideoFormat = formatString;
+        }
+    }
     if (encoder == NULL) {
         ALOGE("Failed to create video encoder");
         // When the encoder fails to be created, we need
@@ -1824,6 +1877,9 @@ void StagefrightRecorder::setupMPEG4orWEBMMetaData(sp<MetaData> *meta) {
     }
     if (mOutputFormat != OUTPUT_FORMAT_WEBM) {
         (*meta)->setInt32(kKey64BitFileOffset, mUse64BitFileOffset);
+        if (mFragmentDurationUs > 0) {
+            (*meta)->setInt64(kKeyFragmentDurationUs, mFragmentDurationUs);
+        }
         if (mTrackEveryTimeDurationUs > 0) {
             (*meta)->setInt64(kKeyTrackTimeStatus, mTrackEveryTimeDurationUs);
         }
@@ -1947,6 +2003,7 @@ status_t StagefrightRecorder::reset() {
     mAudioChannels = 1;
     mAudioBitRate  = 12200;
     mInterleaveDurationUs = 0;
+    mFragmentDurationUs = 0;
     mIFramesIntervalSec = 1;
     mAudioSourceNode = 0;
     mUse64BitFileOffset = false;
@@ -2019,6 +2076,8 @@ status_t StagefrightRecorder::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     Interleave duration (us): %d\n", mInterleaveDurationUs);
     result.append(buffer);
+    snprintf(buffer, SIZE, "     Fragment duration (us): %" PRId64 "\n", mFragmentDurationUs);
+    result.append(buffer);
     snprintf(buffer, SIZE, "     Progress notification: %" PRId64 " us\n", mTrackEveryTimeDurationUs);
     result.append(buffer);
     snprintf(buffer, SIZE, "   Audio\n");
@@ -20,6 +20,7 @@
 
 #include <media/MediaRecorderBase.h>
 #include <camera/CameraParameters.h>
+#include <media/stagefright/foundation/AString.h>
 #include <utils/String8.h>
 
 #include <system/audio.h>
@@ -30,6 +31,7 @@ class Camera;
 class ICameraRecordingProxy;
 class CameraSource;
 class CameraSourceTimeLapse;
+struct MediaCodecSource;
 struct MediaSource;
 struct MediaWriter;
 class MetaData;
@@ -99,6 +101,7 @@ protected:
     int32_t mAudioChannels;
     int32_t mSampleRate;
     int32_t mInterleaveDurationUs;
+    int64_t mFragmentDurationUs;  // 0 unless recording a fragmented MPEG-4 file
     int32_t mIFramesIntervalSec;
     int32_t mCameraId;
     int32_t mVideoEncoderProfile;
@@ -135,6 +138,12 @@ protected:
     sp<IGraphicBufferProducer> mGraphicBufferProducer;
     sp<ALooper> mLooper;
 
+    // Video encoder kept across sessions that record from the same
+    // persistent input surface with the same format.
+    sp<MediaCodecSource> mWarmVideoEncoder;
+    sp<IGraphicBufferConsumer> mWarmPersistentSurface;
+    AString mWarmVideoFormat;
+
     static const int kMaxHighSpeedFps = 1000;
 
     virtual status_t prepareInternal();
@@ -176,6 +185,7 @@ protected:
     status_t setParamVideoRotation(int32_t degrees);
     status_t setParamTrackTimeStatus(int64_t timeDurationUs);
     status_t setParamInterleaveDuration(int32_t durationUs);
+    status_t setParamFragmentDuration(int64_t durationUs);
     status_t setParam64BitFileOffset(bool use64BitFileOffset);
     status_t setParamMaxFileDurationUs(int64_t timeUs);
     status_t setParamMaxFileSizeBytes(int64_t bytes);
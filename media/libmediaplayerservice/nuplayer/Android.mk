@@ -5,12 +5,15 @@ LOCAL_SRC_FILES:=                       \
         GenericSource.cpp               \
         HTTPLiveSource.cpp              \
         NuPlayer.cpp                    \
+        NuPlayerBufferingPolicy.cpp     \
         NuPlayerCCDecoder.cpp           \
         NuPlayerDecoder.cpp             \
         NuPlayerDecoderBase.cpp         \
         NuPlayerDecoderPassThrough.cpp  \
+        NuPlayerDecoderPool.cpp         \
         NuPlayerDriver.cpp              \
         NuPlayerRenderer.cpp            \
+        NuPlayerStats.cpp               \
         NuPlayerStreamListener.cpp      \
         RTSPSource.cpp                  \
         StreamingSource.cpp             \
@@ -21,9 +21,11 @@
 
 #include "AnotherPacketSource.h"
 
+#include <cutils/properties.h>
 #include <media/IMediaHTTPService.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
@@ -41,11 +43,6 @@
 
 namespace android {
 
-static int64_t kLowWaterMarkUs = 2000000ll;  // 2secs
-static int64_t kHighWaterMarkUs = 5000000ll;  // 5secs
-static const ssize_t kLowWaterMarkBytes = 40000;
-static const ssize_t kHighWaterMarkBytes = 200000;
-
 NuPlayer::GenericSource::GenericSource(
         const sp<AMessage> &notify,
         bool uidValid,
@@ -72,7 +69,9 @@ NuPlayer::GenericSource::GenericSource(
       mPendingReadBufferTypes(0),
       mBuffering(false),
       mPrepareBuffering(false),
-      mPrevBufferPercentage(-1) {
+      mPrevBufferPercentage(-1),
+      mFastStart(property_get_bool("media.stagefright.nuplayer-fast-start", false)),
+      mZeroCopyVideo(property_get_bool("media.stagefright.nuplayer-zero-copy", false)) {
     resetDataSource();
     DataSource::RegisterDefaultSniffers();
 }
@@ -299,6 +298,7 @@ status_t NuPlayer::GenericSource::initFromDataSource() {
     }
 
     mBitrate = totalBitrate;
+    mBufferingPolicy.setBitrate(mBitrate);
 
     return OK;
 }
@@ -425,6 +425,7 @@ void NuPlayer::GenericSource::onPrepareAsync() {
 
     if (mDataSource->flags() & DataSource::kIsCachingDataSource) {
         mCachedSource = static_cast<NuCachedSource2 *>(mDataSource.get());
+        mCachedSource->setMaxCacheSize(mBufferingPolicy.maxCacheBytes());
     }
 
     // For widevine or other cached streaming cases, we need to wait for
@@ -469,6 +470,7 @@ void NuPlayer::GenericSource::onPrepareAsync() {
         sp<AMessage> reply = new AMessage(kWhatSecureDecodersInstantiated, this);
         notifyInstantiateSecureDecoders(reply);
     } else {
+        notifyFormatsReady();
         finishPrepareAsync();
     }
 }
@@ -490,6 +492,13 @@ void NuPlayer::GenericSource::finishPrepareAsync() {
         return;
     }
 
+    if (mFastStart && !mIsWidevine && mVideoTrack.mSource != NULL) {
+        // Fetch the first video access units now, so that the decoder has its
+        // first keyframe as soon as the player starts.
+        mStopRead = false;
+        postReadBuffer(MEDIA_TRACK_TYPE_VIDEO);
+    }
+
     if (mIsStreaming) {
         mPrepareBuffering = true;
 
@@ -599,7 +608,8 @@ status_t NuPlayer::GenericSource::feedMoreTSData() {
 void NuPlayer::GenericSource::schedulePollBuffering() {
     sp<AMessage> msg = new AMessage(kWhatPollBuffering, this);
     msg->setInt32("generation", mPollBufferingGeneration);
-    msg->post(1000000ll);
+    // a poll from an earlier generation would be ignored anyway
+    msg->postReplacing(1000000ll);
 }
 
 void NuPlayer::GenericSource::cancelPollBuffering() {
@@ -701,7 +711,21 @@ void NuPlayer::GenericSource::ensureCacheIsFetching() {
     }
 }
 
+void NuPlayer::GenericSource::updateMemoryPressure() {
+    if (!mBufferingPolicy.updateMemoryPressure(ALooper::GetNowUs())) {
+        return;
+    }
+    if (mCachedSource != NULL) {
+        mCachedSource->setMaxCacheSize(mBufferingPolicy.maxCacheBytes());
+        if (mBufferingPolicy.isMemoryLow()) {
+            mCachedSource->trimCache();
+        }
+    }
+}
+
 void NuPlayer::GenericSource::onPollBuffering() {
+    updateMemoryPressure();
+
     status_t finalStatus = UNKNOWN_ERROR;
     int64_t cachedDurationUs = -1ll;
     ssize_t cachedDataRemaining = -1;
@@ -726,6 +750,12 @@ void NuPlayer::GenericSource::onPollBuffering() {
             }
             if (bitrate > 0) {
                 cachedDurationUs = cachedDataRemaining * 8000000ll / bitrate;
+                mBufferingPolicy.setBitrate(bitrate);
+            }
+
+            int32_t kbps;
+            if (mCachedSource->getEstimatedBandwidthKbps(&kbps) == OK) {
+                mBufferingPolicy.setBandwidthKbps(kbps);
             }
         }
     }
@@ -753,18 +783,18 @@ void NuPlayer::GenericSource::onPollBuffering() {
         ALOGV("onPollBuffering: cachedDurationUs %.1f sec",
                 cachedDurationUs / 1000000.0f);
 
-        if (cachedDurationUs < kLowWaterMarkUs) {
+        if (cachedDurationUs < mBufferingPolicy.lowWaterMarkUs()) {
             startBufferingIfNecessary();
-        } else if (cachedDurationUs > kHighWaterMarkUs) {
+        } else if (cachedDurationUs > mBufferingPolicy.highWaterMarkUs()) {
             stopBufferingIfNecessary();
         }
     } else if (cachedDataRemaining >= 0) {
         ALOGV("onPollBuffering: cachedDataRemaining %zd bytes",
                 cachedDataRemaining);
 
-        if (cachedDataRemaining < kLowWaterMarkBytes) {
+        if ((size_t)cachedDataRemaining < mBufferingPolicy.lowWaterMarkBytes()) {
             startBufferingIfNecessary();
-        } else if (cachedDataRemaining > kHighWaterMarkBytes) {
+        } else if ((size_t)cachedDataRemaining > mBufferingPolicy.highWaterMarkBytes()) {
             stopBufferingIfNecessary();
         }
     }
@@ -1395,7 +1425,8 @@ sp<ABuffer> NuPlayer::GenericSource::mediaBufferToABuffer(
         MediaBuffer* mb,
         media_track_type trackType,
         int64_t /* seekTimeUs */,
-        int64_t *actualTimeUs) {
+        int64_t *actualTimeUs,
+        const sp<ABuffer> &filled) {
     bool audio = trackType == MEDIA_TRACK_TYPE_AUDIO;
     size_t outLength = mb->range_length();
 
@@ -1409,6 +1440,10 @@ sp<ABuffer> NuPlayer::GenericSource::mediaBufferToABuffer(
         ab = new ABuffer(NULL, mb->range_length());
         mb->add_ref();
         ab->setMediaBufferBase(mb);
+    } else if (filled != NULL && mb->data() == filled->data()) {
+        // the source read the sample straight into our access unit
+        ab = filled;
+        ab->setRange(mb->range_offset(), mb->range_length());
     } else {
         ab = new ABuffer(outLength);
         memcpy(ab->data(),
@@ -1466,6 +1501,12 @@ sp<ABuffer> NuPlayer::GenericSource::mediaBufferToABuffer(
         meta->setBuffer("sei", sei);
     }
 
+    const void *ccData;
+    size_t ccLength;
+    if (mb->meta_data()->findData(kKeyCCData, &dataType, &ccData, &ccLength)) {
+        meta->setBuffer("cc-data", ABuffer::CreateAsCopy(ccData, ccLength));
+    }
+
     if (actualTimeUs) {
         *actualTimeUs = timeUs;
     }
@@ -1476,6 +1517,24 @@ sp<ABuffer> NuPlayer::GenericSource::mediaBufferToABuffer(
     return ab;
 }
 
+sp<ABuffer> NuPlayer::GenericSource::allocateAccessUnit(media_track_type trackType) {
+    if (!mZeroCopyVideo || trackType != MEDIA_TRACK_TYPE_VIDEO
+            || mIsSecure || mIsWidevine || mUseSetBuffers) {
+        return NULL;
+    }
+
+    // Large enough for any sample of the track. Only the pages the sample
+    // touches are ever faulted in, so this costs no more than a copy sized
+    // to the sample would.
+    int32_t maxInputSize;
+    if (!mVideoTrack.mSource->getFormat()->findInt32(kKeyMaxInputSize, &maxInputSize)
+            || maxInputSize <= 0) {
+        return NULL;
+    }
+
+    return new ABuffer(maxInputSize);
+}
+
 void NuPlayer::GenericSource::postReadBuffer(media_track_type trackType) {
     Mutex::Autolock _l(mReadBufferLock);
 
@@ -1559,9 +1618,31 @@ void NuPlayer::GenericSource::readBuffer(
         options.setNonBlocking();
     }
 
+    // stop short of maxBuffers once the track is read far enough ahead
+    int64_t readAheadUs = -1;
+    size_t readAheadBytes = 0;
+    if (trackType == MEDIA_TRACK_TYPE_AUDIO || trackType == MEDIA_TRACK_TYPE_VIDEO) {
+        updateMemoryPressure();
+        mBufferingPolicy.getReadAheadLimits(
+                trackType == MEDIA_TRACK_TYPE_AUDIO, &readAheadUs, &readAheadBytes);
+    }
+
     for (size_t numBuffers = 0; numBuffers < maxBuffers; ) {
         MediaBuffer *mbuf;
-        status_t err = track->mSource->read(&mbuf, &options);
+        status_t err = ERROR_UNSUPPORTED;
+        sp<ABuffer> filled = allocateAccessUnit(trackType);
+        if (filled != NULL) {
+            err = track->mSource->readInto(
+                    filled->data(), filled->capacity(), &mbuf, &options);
+            if (err == ERROR_UNSUPPORTED) {
+                ALOGV("video source does not support readInto");
+                mZeroCopyVideo = false;
+                filled.clear();
+            }
+        }
+        if (filled == NULL) {
+            err = track->mSource->read(&mbuf, &options);
+        }
 
         options.clearSeekTo();
 
@@ -1578,11 +1659,18 @@ void NuPlayer::GenericSource::readBuffer(
 
             sp<ABuffer> buffer = mediaBufferToABuffer(
                     mbuf, trackType, seekTimeUs,
-                    numBuffers == 0 ? actualTimeUs : NULL);
+                    numBuffers == 0 ? actualTimeUs : NULL, filled);
             track->mPackets->queueAccessUnit(buffer);
             formatChange = false;
             seeking = false;
             ++numBuffers;
+
+            status_t finalResult;  // ignored
+            if (readAheadUs >= 0
+                    && (track->mPackets->getBufferedDurationUs(&finalResult) >= readAheadUs
+                        || track->mPackets->getBufferedBytes() >= readAheadBytes)) {
+                break;
+            }
         } else if (err == WOULD_BLOCK) {
             break;
         } else if (err == INFO_FORMAT_CHANGED) {
@@ -19,6 +19,7 @@
 #define GENERIC_SOURCE_H_
 
 #include "NuPlayer.h"
+#include "NuPlayerBufferingPolicy.h"
 #include "NuPlayerSource.h"
 
 #include "ATSParser.h"
@@ -153,6 +154,11 @@ protected:
     bool mBuffering;
     bool mPrepareBuffering;
     int32_t mPrevBufferPercentage;
+    // read the first video access units during prepare
+    bool mFastStart;
+    // have the video source write samples straight into our access units
+    bool mZeroCopyVideo;
+    NuPlayerBufferingPolicy mBufferingPolicy;
 
     mutable Mutex mReadBufferLock;
     mutable Mutex mDisconnectLock;
@@ -197,7 +203,12 @@ protected:
             MediaBuffer *mbuf,
             media_track_type trackType,
             int64_t seekTimeUs,
-            int64_t *actualTimeUs = NULL);
+            int64_t *actualTimeUs = NULL,
+            const sp<ABuffer> &filled = NULL);
+
+    // Returns an empty access unit for the track's source to readInto(),
+    // or NULL if samples are to be read() and copied instead.
+    sp<ABuffer> allocateAccessUnit(media_track_type trackType);
 
     void postReadBuffer(media_track_type trackType);
     void onReadBuffer(sp<AMessage> msg);
@@ -212,6 +223,7 @@ protected:
     void cancelPollBuffering();
     void restartPollBuffering();
     void onPollBuffering();
+    void updateMemoryPressure();
     void notifyBufferingUpdate(int32_t percentage);
     void startBufferingIfNecessary();
     void stopBufferingIfNecessary();
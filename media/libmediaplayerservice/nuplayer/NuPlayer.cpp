@@ -28,6 +28,7 @@
 #include "NuPlayerDriver.h"
 #include "NuPlayerRenderer.h"
 #include "NuPlayerSource.h"
+#include "NuPlayerStats.h"
 #include "RTSPSource.h"
 #include "StreamingSource.h"
 #include "GenericSource.h"
@@ -38,6 +39,7 @@
 #include <cutils/properties.h>
 
 #include <media/AudioResamplerPublic.h>
+#include <media/AudioSystem.h>
 #include <media/AVSyncSettings.h>
 
 #include <media/stagefright/foundation/hexdump.h>
@@ -57,6 +59,7 @@
 #include "ESDS.h"
 #include <media/stagefright/Utils.h>
 #include "mediaplayerservice/AVNuExtensions.h"
+#include <mediautils/MediaSchedulingPolicy.h>
 
 namespace android {
 
@@ -206,13 +209,18 @@ NuPlayer::NuPlayer(pid_t pid)
       mVideoScalingMode(NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW),
       mPlaybackSettings(AUDIO_PLAYBACK_RATE_DEFAULT),
       mVideoFpsHint(-1.f),
+      mCommonTimeAnchorMediaUs(-1),
+      mCommonTimeAnchorUs(-1),
       mStarted(false),
       mResetting(false),
       mSourceStarted(false),
       mPaused(false),
       mPausedByClient(false),
-      mPausedForBuffering(false) {
+      mPausedForBuffering(false),
+      mFastStart(property_get_bool("media.stagefright.nuplayer-fast-start", false)),
+      mTunneledVideo(property_get_bool("media.stagefright.nuplayer-tunnel", false)) {
     clearFlushComplete();
+    mPlayerStats = new NuPlayerStats;
 }
 
 NuPlayer::~NuPlayer() {
@@ -413,6 +421,18 @@ status_t NuPlayer::getSyncSettings(
     return err;
 }
 
+status_t NuPlayer::setCommonTimeAnchor(int64_t mediaUs, int64_t commonUs) {
+    sp<AMessage> msg = new AMessage(kWhatSetCommonTimeAnchor, this);
+    msg->setInt64("mediaUs", mediaUs);
+    msg->setInt64("commonUs", commonUs);
+    sp<AMessage> response;
+    status_t err = msg->postAndAwaitResponse(&response);
+    if (err == OK && response != NULL) {
+        CHECK(response->findInt32("err", &err));
+    }
+    return err;
+}
+
 void NuPlayer::pause() {
     (new AMessage(kWhatPause, this))->post();
 }
@@ -487,6 +507,8 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
 
             CHECK(mSource == NULL);
 
+            mPlayerStats->reset();
+
             status_t err = OK;
             sp<RefBase> obj;
             CHECK(msg->findObject("source", &obj));
@@ -816,6 +838,33 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSetCommonTimeAnchor:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+            int64_t mediaUs, commonUs;
+            CHECK(msg->findInt64("mediaUs", &mediaUs));
+            CHECK(msg->findInt64("commonUs", &commonUs));
+            ALOGV("kWhatSetCommonTimeAnchor media %lld us at common %lld us",
+                    (long long)mediaUs, (long long)commonUs);
+            status_t err = OK;
+            if (commonUs >= 0 && mOffloadAudio) {
+                // the offloaded sink does not take the rate trims
+                ALOGW("cannot slave offloaded audio to common time");
+                err = INVALID_OPERATION;
+            } else if (mRenderer != NULL) {
+                mRenderer->setCommonTimeAnchor(mediaUs, commonUs);
+            }
+            if (err == OK) {
+                mCommonTimeAnchorMediaUs = mediaUs;
+                mCommonTimeAnchorUs = commonUs < 0 ? -1 : commonUs;
+            }
+            sp<AMessage> response = new AMessage;
+            response->setInt32("err", err);
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatGetSyncSettings:
         {
             sp<AReplyToken> replyID;
@@ -1001,6 +1050,9 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
                 finishFlushIfPossible();
             } else if (what == DecoderBase::kWhatResumeCompleted) {
                 finishResume();
+            } else if (what == DecoderBase::kWhatVideoRenderingStart) {
+                // tunneled video bypasses the renderer
+                notifyListener(MEDIA_INFO, MEDIA_INFO_RENDERING_START, 0);
             } else if (what == DecoderBase::kWhatError) {
                 status_t err;
                 if (!msg->findInt32("err", &err) || err == OK) {
@@ -1327,6 +1379,21 @@ status_t NuPlayer::onInstantiateSecureDecoders() {
     return OK;
 }
 
+void NuPlayer::onFormatsReady() {
+    // Secure decoders are instantiated by the source itself.
+    if (!mFastStart || mRenderer != NULL || (mSourceFlags & Source::FLAG_SECURE)) {
+        return;
+    }
+
+    // Allocate the video codec while the source finishes preparing. As for secure
+    // decoders, it does not request data until onStart() gives it the renderer.
+    // The audio decoder still waits, its type depends on the offload decision.
+    if (mSurface != NULL) {
+        status_t err = instantiateDecoder(false, &mVideoDecoder);
+        ALOGW_IF(err != OK, "failed to instantiate video decoder early: %d", err);
+    }
+}
+
 void NuPlayer::onStart(int64_t startPositionUs) {
     if (!mSourceStarted) {
         mSourceStarted = true;
@@ -1367,6 +1434,9 @@ void NuPlayer::onStart(int64_t startPositionUs) {
     if (!mOffloadAudio && (audioMeta != NULL)) {
         mOffloadDecodedPCM = mOffloadAudio = canOffloadDecodedPCMStream(audioMeta, (videoFormat != NULL), mSource->isStreaming(), streamType);
     }
+    if (mCommonTimeAnchorUs >= 0) {
+        mOffloadDecodedPCM = mOffloadAudio = false;
+    }
 
     if (mOffloadAudio) {
         flags |= Renderer::FLAG_OFFLOAD_AUDIO;
@@ -1379,7 +1449,10 @@ void NuPlayer::onStart(int64_t startPositionUs) {
     mRendererLooper = new ALooper;
     mRendererLooper->setName("NuPlayerRenderer");
     mRendererLooper->start(false, false, ANDROID_PRIORITY_AUDIO);
+    MediaSchedulingPolicy::getInstance().registerLooper(
+            mRendererLooper, MEDIA_LATENCY_CLASS_VIDEO_FRAME);
     mRendererLooper->registerHandler(mRenderer);
+    mRenderer->setPlayerStats(mPlayerStats);
 
     status_t err = mRenderer->setPlaybackSettings(mPlaybackSettings);
     if (err != OK) {
@@ -1394,6 +1467,10 @@ void NuPlayer::onStart(int64_t startPositionUs) {
         mRenderer->setVideoFrameRate(rate);
     }
 
+    if (mCommonTimeAnchorUs >= 0) {
+        mRenderer->setCommonTimeAnchor(mCommonTimeAnchorMediaUs, mCommonTimeAnchorUs);
+    }
+
     if (mVideoDecoder != NULL) {
         mVideoDecoder->setRenderer(mRenderer);
     }
@@ -1547,6 +1624,9 @@ void NuPlayer::determineAudioModeChange() {
     if (!canOffload) {
         mOffloadDecodedPCM = canOffload = canOffloadDecodedPCMStream(audioMeta, (videoFormat != NULL), mSource->isStreaming(), streamType);
     }
+    if (mCommonTimeAnchorUs >= 0) {
+        mOffloadDecodedPCM = canOffload = false;
+    }
     if (canOffload) {
         if (!mOffloadAudio) {
             mRenderer->signalEnableOffloadAudio();
@@ -1601,6 +1681,16 @@ status_t NuPlayer::instantiateDecoder(bool audio, sp<DecoderBase> *decoder) {
         if (rate > 0) {
             format->setFloat("operating-rate", rate * mPlaybackSettings.mSpeed);
         }
+
+        // Let the decoder tunnel the video if it finds a codec that can, the
+        // renderer then only plays the audio and the HW syncs the video to it.
+        if (mTunneledVideo && mAudioSink != NULL) {
+            audio_hw_sync_t hwSync = AudioSystem::getAudioHwSyncForSession(
+                    (audio_session_t)mAudioSink->getSessionId());
+            if (hwSync != AUDIO_HW_SYNC_INVALID) {
+                format->setInt32("audio-hw-sync", hwSync);
+            }
+        }
     }
 
     if (audio) {
@@ -1640,6 +1730,7 @@ status_t NuPlayer::instantiateDecoder(bool audio, sp<DecoderBase> *decoder) {
             }
         }
     }
+    (*decoder)->setPlayerStats(mPlayerStats);
     (*decoder)->init();
     (*decoder)->configure(format);
 
@@ -1889,6 +1980,13 @@ void NuPlayer::getStats(Vector<sp<AMessage> > *mTrackStats) {
     }
 }
 
+sp<NuPlayerStats> NuPlayer::getPlayerStats() {
+    if (mAudioSink != NULL) {
+        mPlayerStats->setAudioUnderrunFrames(mAudioSink->getUnderrunFrames());
+    }
+    return mPlayerStats;
+}
+
 sp<MetaData> NuPlayer::getFileMeta() {
     return mSource->getFileFormatMeta();
 }
@@ -1997,6 +2095,7 @@ void NuPlayer::performReset() {
         if (mRenderer != NULL) {
             mRendererLooper->unregisterHandler(mRenderer->id());
         }
+        MediaSchedulingPolicy::getInstance().unregisterThread(mRendererLooper->getTid());
         mRendererLooper->stop();
         mRendererLooper.clear();
     }
@@ -2111,6 +2210,17 @@ void NuPlayer::onSourceNotify(const sp<AMessage> &msg) {
             break;
         }
 
+        case Source::kWhatFormatsReady:
+        {
+            if (mSource == NULL) {
+                // stale notification from a source that was reset while preparing
+                break;
+            }
+
+            onFormatsReady();
+            break;
+        }
+
         case Source::kWhatPrepared:
         {
             if (mSource == NULL) {
@@ -2204,6 +2314,7 @@ void NuPlayer::onSourceNotify(const sp<AMessage> &msg) {
 
         case Source::kWhatBufferingStart:
         {
+            mPlayerStats->onRebufferingStart(ALooper::GetNowUs());
             notifyListener(MEDIA_INFO, MEDIA_INFO_BUFFERING_START, 0);
             break;
         }
@@ -2226,6 +2337,7 @@ void NuPlayer::onSourceNotify(const sp<AMessage> &msg) {
 
         case Source::kWhatBufferingEnd:
         {
+            mPlayerStats->onRebufferingEnd(ALooper::GetNowUs());
             notifyListener(MEDIA_INFO, MEDIA_INFO_BUFFERING_END, 0);
             break;
         }
@@ -2459,6 +2571,12 @@ void NuPlayer::Source::notifyInstantiateSecureDecoders(const sp<AMessage> &reply
     notify->post();
 }
 
+void NuPlayer::Source::notifyFormatsReady() {
+    sp<AMessage> notify = dupNotify();
+    notify->setInt32("what", kWhatFormatsReady);
+    notify->post();
+}
+
 void NuPlayer::Source::onMessageReceived(const sp<AMessage> & /* msg */) {
     TRESPASS();
 }
@@ -31,6 +31,7 @@ struct AVSyncSettings;
 class IDataSource;
 class MetaData;
 struct NuPlayerDriver;
+struct NuPlayerStats;
 
 struct NuPlayer : public AHandler {
     NuPlayer(pid_t pid);
@@ -60,6 +61,9 @@ struct NuPlayer : public AHandler {
     status_t getPlaybackSettings(AudioPlaybackRate *rate /* nonnull */);
     status_t setSyncSettings(const AVSyncSettings &sync, float videoFpsHint);
     status_t getSyncSettings(AVSyncSettings *sync /* nonnull */, float *videoFps /* nonnull */);
+    // Presents media time |mediaUs| at common time |commonUs|, both in microseconds,
+    // or follows the local clock again if |commonUs| is negative.
+    status_t setCommonTimeAnchor(int64_t mediaUs, int64_t commonUs);
 
     void start();
 
@@ -78,6 +82,7 @@ struct NuPlayer : public AHandler {
     status_t selectTrack(size_t trackIndex, bool select, int64_t timeUs);
     status_t getCurrentPosition(int64_t *mediaUs);
     void getStats(Vector<sp<AMessage> > *mTrackStats);
+    sp<NuPlayerStats> getPlayerStats();
 
     sp<MetaData> getFileMeta();
     float getFrameRate();
@@ -140,6 +145,7 @@ protected:
         kWhatGetTrackInfo               = 'gTrI',
         kWhatGetSelectedTrack           = 'gSel',
         kWhatSelectTrack                = 'selT',
+        kWhatSetCommonTimeAnchor        = 'sCTA',
     };
 
     wp<NuPlayerDriver> mDriver;
@@ -155,6 +161,7 @@ protected:
     bool mOffloadDecodedPCM;
     sp<DecoderBase> mAudioDecoder;
     sp<CCDecoder> mCCDecoder;
+    sp<NuPlayerStats> mPlayerStats;
     sp<Renderer> mRenderer;
     sp<ALooper> mRendererLooper;
     int32_t mAudioDecoderGeneration;
@@ -203,6 +210,8 @@ protected:
     AudioPlaybackRate mPlaybackSettings;
     AVSyncSettings mSyncSettings;
     float mVideoFpsHint;
+    int64_t mCommonTimeAnchorMediaUs;
+    int64_t mCommonTimeAnchorUs;    // -1 unless slaved to the common time service
     bool mStarted;
     bool mResetting;
     bool mSourceStarted;
@@ -218,6 +227,12 @@ protected:
     // Pause state as requested by source (internally) due to buffering
     bool mPausedForBuffering;
 
+    // Instantiate the video decoder while the source is still preparing.
+    bool mFastStart;
+
+    // Offer the audio HW A/V sync id to the video decoder for tunneled playback.
+    bool mTunneledVideo;
+
     inline const sp<DecoderBase> &getDecoder(bool audio) {
         return audio ? mAudioDecoder : mVideoDecoder;
     }
@@ -236,6 +251,7 @@ protected:
     virtual status_t instantiateDecoder(bool audio, sp<DecoderBase> *decoder);
 
     status_t onInstantiateSecureDecoders();
+    void onFormatsReady();
 
     void updateVideoSize(
             const sp<AMessage> &inputFormat,
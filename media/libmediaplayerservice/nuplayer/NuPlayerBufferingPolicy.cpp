@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NuPlayerBufferingPolicy"
+#include <utils/Log.h>
+
+#include "NuPlayerBufferingPolicy.h"
+
+#include <cutils/properties.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace android {
+
+static const int64_t kLowMemoryDeviceBytes = 1024ll * 1024 * 1024;
+static const int64_t kHighMemoryDeviceBytes = 3072ll * 1024 * 1024;
+
+// Memory is low when less than this fraction of RAM, and at least
+// kMinLowMemoryBytes, is available. It is no longer low once 1.5 times as much is.
+static const int64_t kLowMemoryFraction = 20;
+static const int64_t kMinLowMemoryBytes = 48ll * 1024 * 1024;
+static const int64_t kMemoryCheckIntervalUs = 5000000ll;
+
+static const int64_t kLowWaterMarkUs = 2000000ll;
+static const int64_t kSlowNetworkLowWaterMarkUs = 4000000ll;
+
+// Per memory class, in MemoryClass order.
+static const struct {
+    int64_t mHighWaterMarkUs;
+    size_t mLowWaterMarkBytes;
+    size_t mHighWaterMarkBytes;
+    size_t mMaxCacheBytes;
+    int64_t mReadAheadUs;
+    size_t mAudioReadAheadBytes;
+    size_t mVideoReadAheadBytes;
+} kLimits[] = {
+    { 4000000ll, 40000, 100000,  6 * 1024 * 1024, 1000000ll, 256 * 1024,  4 * 1024 * 1024 },
+    { 5000000ll, 40000, 200000, 40 * 1024 * 1024, 2000000ll, 512 * 1024,  8 * 1024 * 1024 },
+    { 8000000ll, 80000, 400000, 64 * 1024 * 1024, 4000000ll, 1024 * 1024, 16 * 1024 * 1024 },
+};
+
+static const size_t kLowMemoryMaxCacheBytes = 4 * 1024 * 1024;
+
+// Returns the available memory in bytes, or -1 if it cannot be read.
+static int64_t getAvailableMemoryBytes() {
+    int fd = open("/proc/meminfo", O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    char buffer[1024];
+    ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (n <= 0) {
+        return -1;
+    }
+    buffer[n] = '\0';
+
+    // MemAvailable is only reported by 3.14+ kernels.
+    long long availableKb, freeKb = -1, cachedKb = -1;
+    const char *s = strstr(buffer, "MemAvailable:");
+    if (s != NULL && sscanf(s, "MemAvailable: %lld kB", &availableKb) == 1) {
+        return availableKb * 1024;
+    }
+    s = strstr(buffer, "MemFree:");
+    if (s == NULL || sscanf(s, "MemFree: %lld kB", &freeKb) != 1) {
+        return -1;
+    }
+    s = strstr(buffer, "\nCached:");
+    if (s == NULL || sscanf(s, "\nCached: %lld kB", &cachedKb) != 1) {
+        cachedKb = 0;
+    }
+    return (freeKb + cachedKb) * 1024;
+}
+
+NuPlayerBufferingPolicy::NuPlayerBufferingPolicy()
+    : mMemoryClass(MEMORY_NORMAL),
+      mTotalMemoryBytes(-1),
+      mBitrate(-1),
+      mBandwidthKbps(-1),
+      mMemoryLow(false),
+      mLastMemoryCheckUs(-1) {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0) {
+        mTotalMemoryBytes = (int64_t)pages * pageSize;
+    }
+
+    if (property_get_bool("ro.config.low_ram", false)
+            || (mTotalMemoryBytes > 0 && mTotalMemoryBytes < kLowMemoryDeviceBytes)) {
+        mMemoryClass = MEMORY_LOW;
+    } else if (mTotalMemoryBytes >= kHighMemoryDeviceBytes) {
+        mMemoryClass = MEMORY_HIGH;
+    }
+    ALOGV("memory class %d, %lld bytes", mMemoryClass, (long long)mTotalMemoryBytes);
+}
+
+void NuPlayerBufferingPolicy::setBitrate(int64_t bitrate) {
+    mBitrate = bitrate;
+}
+
+void NuPlayerBufferingPolicy::setBandwidthKbps(int32_t kbps) {
+    mBandwidthKbps = kbps;
+}
+
+bool NuPlayerBufferingPolicy::isNetworkSlow() const {
+    return mBitrate > 0 && mBandwidthKbps > 0
+            && mBandwidthKbps * 1000ll * 2 < mBitrate * 3;
+}
+
+int64_t NuPlayerBufferingPolicy::lowWaterMarkUs() const {
+    return isNetworkSlow() && !mMemoryLow ? kSlowNetworkLowWaterMarkUs : kLowWaterMarkUs;
+}
+
+int64_t NuPlayerBufferingPolicy::highWaterMarkUs() const {
+    MemoryClass memoryClass = mMemoryLow ? MEMORY_LOW : mMemoryClass;
+    int64_t highUs = kLimits[memoryClass].mHighWaterMarkUs;
+    if (isNetworkSlow() && !mMemoryLow) {
+        // ride out the next dip in bandwidth
+        highUs *= 2;
+    }
+
+    // what the cache can hold, with room for the data behind the read position
+    if (mBitrate > 0) {
+        int64_t cacheUs = maxCacheBytes() * 3 / 4 * 8000000ll / mBitrate;
+        if (highUs > cacheUs) {
+            highUs = cacheUs;
+        }
+    }
+
+    int64_t lowUs = lowWaterMarkUs();
+    return highUs > lowUs + 1000000ll ? highUs : lowUs + 1000000ll;
+}
+
+size_t NuPlayerBufferingPolicy::lowWaterMarkBytes() const {
+    return kLimits[mMemoryLow ? MEMORY_LOW : mMemoryClass].mLowWaterMarkBytes;
+}
+
+size_t NuPlayerBufferingPolicy::highWaterMarkBytes() const {
+    return kLimits[mMemoryLow ? MEMORY_LOW : mMemoryClass].mHighWaterMarkBytes;
+}
+
+size_t NuPlayerBufferingPolicy::maxCacheBytes() const {
+    return mMemoryLow ? kLowMemoryMaxCacheBytes : kLimits[mMemoryClass].mMaxCacheBytes;
+}
+
+void NuPlayerBufferingPolicy::getReadAheadLimits(
+        bool audio, int64_t *durationUs, size_t *bytes) const {
+    MemoryClass memoryClass = mMemoryLow ? MEMORY_LOW : mMemoryClass;
+    *durationUs = kLimits[memoryClass].mReadAheadUs;
+    *bytes = audio ? kLimits[memoryClass].mAudioReadAheadBytes
+            : kLimits[memoryClass].mVideoReadAheadBytes;
+}
+
+bool NuPlayerBufferingPolicy::updateMemoryPressure(int64_t nowUs) {
+    if (mTotalMemoryBytes <= 0
+            || (mLastMemoryCheckUs >= 0 && nowUs < mLastMemoryCheckUs + kMemoryCheckIntervalUs)) {
+        return false;
+    }
+    mLastMemoryCheckUs = nowUs;
+
+    int64_t availableBytes = getAvailableMemoryBytes();
+    if (availableBytes < 0) {
+        return false;
+    }
+
+    int64_t lowBytes = mTotalMemoryBytes / kLowMemoryFraction;
+    if (lowBytes < kMinLowMemoryBytes) {
+        lowBytes = kMinLowMemoryBytes;
+    }
+
+    bool memoryLow = mMemoryLow ? availableBytes < lowBytes * 3 / 2 : availableBytes < lowBytes;
+    if (memoryLow == mMemoryLow) {
+        return false;
+    }
+    ALOGI("memory %s, %lld bytes available", memoryLow ? "low" : "recovered",
+            (long long)availableBytes);
+    mMemoryLow = memoryLow;
+    return true;
+}
+
+}  // namespace android
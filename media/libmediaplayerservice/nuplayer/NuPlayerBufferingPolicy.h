@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NUPLAYER_BUFFERING_POLICY_H_
+
+#define NUPLAYER_BUFFERING_POLICY_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// How much GenericSource buffers ahead of playback. The limits follow the
+// device's memory class, the content bitrate and the measured network
+// bandwidth, and shrink while the system is low on memory.
+struct NuPlayerBufferingPolicy {
+    enum MemoryClass {
+        MEMORY_LOW,     // ro.config.low_ram or less than 1 GB
+        MEMORY_NORMAL,
+        MEMORY_HIGH,    // 3 GB or more
+    };
+
+    NuPlayerBufferingPolicy();
+
+    MemoryClass memoryClass() const { return mMemoryClass; }
+
+    // Average bitrate of the content in bits per second, or <= 0 if unknown.
+    void setBitrate(int64_t bitrate);
+    // Estimated network bandwidth in kbps, or <= 0 if unknown.
+    void setBandwidthKbps(int32_t kbps);
+
+    // Playback pauses when less than the low watermark is cached, and resumes
+    // once more than the high watermark is.
+    int64_t lowWaterMarkUs() const;
+    int64_t highWaterMarkUs() const;
+    size_t lowWaterMarkBytes() const;
+    size_t highWaterMarkBytes() const;
+
+    // Bound of the NuCachedSource2 cache.
+    size_t maxCacheBytes() const;
+
+    // Bounds of the access units queued ahead of a decoder. At least one
+    // access unit is always queued.
+    void getReadAheadLimits(bool audio, int64_t *durationUs, size_t *bytes) const;
+
+    // Rereads the available system memory, at most every few seconds, and
+    // returns true if the low memory state changed.
+    bool updateMemoryPressure(int64_t nowUs);
+    bool isMemoryLow() const { return mMemoryLow; }
+
+private:
+    MemoryClass mMemoryClass;
+    int64_t mTotalMemoryBytes;
+    int64_t mBitrate;
+    int32_t mBandwidthKbps;
+    bool mMemoryLow;
+    int64_t mLastMemoryCheckUs;
+
+    // The network delivers less than 1.5 times the bitrate.
+    bool isNetworkSlow() const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(NuPlayerBufferingPolicy);
+};
+
+}  // namespace android
+
+#endif  // NUPLAYER_BUFFERING_POLICY_H_
@@ -22,7 +22,6 @@
 #include "avc_utils.h"
 #include "NuPlayerCCDecoder.h"
 
-#include <media/stagefright/foundation/ABitReader.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
@@ -187,147 +186,58 @@ int32_t NuPlayer::CCDecoder::getTrackIndex(size_t channel) const {
 
 // returns true if a new CC track is found
 bool NuPlayer::CCDecoder::extractFromSEI(const sp<ABuffer> &accessUnit) {
-    sp<ABuffer> sei;
-    if (!accessUnit->meta()->findBuffer("sei", &sei) || sei == NULL) {
-        return false;
-    }
-
     int64_t timeUs;
     CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
 
-    bool trackAdded = false;
-
-    const NALPosition *nal = (NALPosition *) sei->data();
+    // The demuxer normally extracts the byte pairs while assembling the
+    // access unit; only fall back to parsing the SEI ourselves if it did not.
+    sp<ABuffer> ccBuf;
+    if (!accessUnit->meta()->findBuffer("cc-data", &ccBuf) || ccBuf == NULL) {
+        sp<ABuffer> sei;
+        if (!accessUnit->meta()->findBuffer("sei", &sei) || sei == NULL) {
+            return false;
+        }
 
-    for (size_t i = 0; i < sei->size() / sizeof(NALPosition); ++i, ++nal) {
-        trackAdded |= parseSEINalUnit(
-                timeUs, accessUnit->data() + nal->nalOffset, nal->nalSize);
-    }
+        const NALPosition *nal = (NALPosition *) sei->data();
+        size_t numNals = sei->size() / sizeof(NALPosition);
 
-    return trackAdded;
-}
+        size_t seiBytes = 0;
+        for (size_t i = 0; i < numNals; ++i) {
+            seiBytes += nal[i].nalSize;
+        }
 
-// returns true if a new CC track is found
-bool NuPlayer::CCDecoder::parseSEINalUnit(
-        int64_t timeUs, const uint8_t *nalStart, size_t nalSize) {
-    unsigned nalType = nalStart[0] & 0x1f;
+        ccBuf = new ABuffer(seiBytes);
+        ccBuf->setRange(0, 0);
+        for (size_t i = 0; i < numNals; ++i) {
+            ExtractCEA608FromSEI(
+                    accessUnit->data() + nal[i].nalOffset, nal[i].nalSize, ccBuf);
+        }
+    }
 
-    // the buffer should only have SEI in it
-    if (nalType != 6) {
+    if (ccBuf->size() == 0) {
         return false;
     }
 
     bool trackAdded = false;
-    NALBitReader br(nalStart + 1, nalSize - 1);
-    // sei_message()
-    while (br.atLeastNumBitsLeft(16)) { // at least 16-bit for sei_message()
-        uint32_t payload_type = 0;
-        size_t payload_size = 0;
-        uint8_t last_byte;
-
-        do {
-            last_byte = br.getBits(8);
-            payload_type += last_byte;
-        } while (last_byte == 0xFF);
-
-        do {
-            last_byte = br.getBits(8);
-            payload_size += last_byte;
-        } while (last_byte == 0xFF);
-
-        if (payload_size > SIZE_MAX / 8
-                || !br.atLeastNumBitsLeft(payload_size * 8)) {
-            ALOGV("Malformed SEI payload");
-            break;
-        }
-
-        // sei_payload()
-        if (payload_type == 4) {
-            bool isCC = false;
-            if (payload_size > 1 + 2 + 4 + 1) {
-                // user_data_registered_itu_t_t35()
-
-                // ATSC A/72: 6.4.2
-                uint8_t itu_t_t35_country_code = br.getBits(8);
-                uint16_t itu_t_t35_provider_code = br.getBits(16);
-                uint32_t user_identifier = br.getBits(32);
-                uint8_t user_data_type_code = br.getBits(8);
-
-                payload_size -= 1 + 2 + 4 + 1;
-
-                isCC = itu_t_t35_country_code == 0xB5
-                        && itu_t_t35_provider_code == 0x0031
-                        && user_identifier == 'GA94'
-                        && user_data_type_code == 0x3;
-            }
-
-            if (isCC && payload_size > 2) {
-                // MPEG_cc_data()
-                // ATSC A/53 Part 4: 6.2.3.1
-                br.skipBits(1); //process_em_data_flag
-                bool process_cc_data_flag = br.getBits(1);
-                br.skipBits(1); //additional_data_flag
-                size_t cc_count = br.getBits(5);
-                br.skipBits(8); // em_data;
-                payload_size -= 2;
-
-                if (process_cc_data_flag) {
-                    AString out;
-
-                    sp<ABuffer> ccBuf = new ABuffer(cc_count * sizeof(CCData));
-                    ccBuf->setRange(0, 0);
-
-                    for (size_t i = 0; i < cc_count && payload_size >= 3; i++) {
-                        uint8_t marker = br.getBits(5);
-                        CHECK_EQ(marker, 0x1f);
-
-                        bool cc_valid = br.getBits(1);
-                        uint8_t cc_type = br.getBits(2);
-                        // remove odd parity bit
-                        uint8_t cc_data_1 = br.getBits(8) & 0x7f;
-                        uint8_t cc_data_2 = br.getBits(8) & 0x7f;
-
-                        payload_size -= 3;
-
-                        if (cc_valid
-                                && (cc_type == 0 || cc_type == 1)) {
-                            CCData cc(cc_type, cc_data_1, cc_data_2);
-                            if (!isNullPad(&cc)) {
-                                size_t channel;
-                                if (cc.getChannel(&channel) && getTrackIndex(channel) < 0) {
-                                    mTrackIndices[channel] = mFoundChannels.size();
-                                    mFoundChannels.push_back(channel);
-                                    trackAdded = true;
-                                }
-                                memcpy(ccBuf->data() + ccBuf->size(),
-                                        (void *)&cc, sizeof(cc));
-                                ccBuf->setRange(0, ccBuf->size() + sizeof(CCData));
-                            }
-                        }
-                    }
-
-                    mCCMap.add(timeUs, ccBuf);
-                    break;
-                }
-            } else {
-                ALOGV("Malformed SEI payload type 4");
-            }
-        } else {
-            ALOGV("Unsupported SEI payload type %d", payload_type);
+    size_t cc_count = ccBuf->size() / sizeof(CCData);
+    const CCData *cc_data = (const CCData *)ccBuf->data();
+    for (size_t i = 0; i < cc_count; ++i) {
+        size_t channel;
+        if (cc_data[i].getChannel(&channel) && getTrackIndex(channel) < 0) {
+            mTrackIndices[channel] = mFoundChannels.size();
+            mFoundChannels.push_back(channel);
+            trackAdded = true;
         }
-
-        // skipping remaining bits of this payload
-        br.skipBits(payload_size * 8);
     }
 
+    mCCMap.add(timeUs, ccBuf);
+
     return trackAdded;
 }
 
-sp<ABuffer> NuPlayer::CCDecoder::filterCCBuf(
-        const sp<ABuffer> &ccBuf, size_t index) {
-    sp<ABuffer> filteredCCBuf = new ABuffer(ccBuf->size());
-    filteredCCBuf->setRange(0, 0);
-
+// appends the byte pairs of ccBuf that belong to track |index| to out
+void NuPlayer::CCDecoder::filterCCBuf(
+        const sp<ABuffer> &ccBuf, size_t index, const sp<ABuffer> &out) {
     size_t cc_count = ccBuf->size() / sizeof(CCData);
     const CCData* cc_data = (const CCData*)ccBuf->data();
     for (size_t i = 0; i < cc_count; ++i) {
@@ -336,13 +246,11 @@ sp<ABuffer> NuPlayer::CCDecoder::filterCCBuf(
             mCurrentChannel = channel;
         }
         if (mCurrentChannel == mFoundChannels[index]) {
-            memcpy(filteredCCBuf->data() + filteredCCBuf->size(),
+            memcpy(out->data() + out->size(),
                     (void *)&cc_data[i], sizeof(CCData));
-            filteredCCBuf->setRange(0, filteredCCBuf->size() + sizeof(CCData));
+            out->setRange(0, out->size() + sizeof(CCData));
         }
     }
-
-    return filteredCCBuf;
 }
 
 void NuPlayer::CCDecoder::decode(const sp<ABuffer> &accessUnit) {
@@ -361,13 +269,25 @@ void NuPlayer::CCDecoder::display(int64_t timeUs) {
         return;
     }
 
-    ssize_t index = mCCMap.indexOfKey(timeUs);
-    if (index < 0) {
+    // Captions of every frame up to this one, including frames that were
+    // dropped before reaching the renderer, go out in a single batch.
+    size_t count = 0;
+    size_t totalSize = 0;
+    while (count < mCCMap.size() && mCCMap.keyAt(count) <= timeUs) {
+        totalSize += mCCMap.valueAt(count)->size();
+        ++count;
+    }
+
+    if (count == 0) {
         ALOGV("cc for timestamp %" PRId64 " not found", timeUs);
         return;
     }
 
-    sp<ABuffer> ccBuf = filterCCBuf(mCCMap.valueAt(index), mSelectedTrack);
+    sp<ABuffer> ccBuf = new ABuffer(totalSize);
+    ccBuf->setRange(0, 0);
+    for (size_t i = 0; i < count; ++i) {
+        filterCCBuf(mCCMap.valueAt(i), mSelectedTrack, ccBuf);
+    }
 
     if (ccBuf->size() > 0) {
 #if 0
@@ -384,8 +304,8 @@ void NuPlayer::CCDecoder::display(int64_t timeUs) {
         msg->post();
     }
 
-    // remove all entries before timeUs
-    mCCMap.removeItemsAt(0, index + 1);
+    // remove all entries up to timeUs
+    mCCMap.removeItemsAt(0, count);
 }
 
 void NuPlayer::CCDecoder::flush() {
@@ -21,6 +21,7 @@
 
 #include "NuPlayerCCDecoder.h"
 #include "NuPlayerDecoder.h"
+#include "NuPlayerDecoderPool.h"
 #include "NuPlayerRenderer.h"
 #include "NuPlayerSource.h"
 
@@ -28,9 +29,11 @@
 #include <media/ICrypto.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecList.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 
@@ -66,6 +69,7 @@ NuPlayer::Decoder::Decoder(
       mNumFramesTotal(0ll),
       mNumInputFramesDropped(0ll),
       mNumOutputFramesDropped(0ll),
+      mNumPredictedFramesDropped(0ll),
       mVideoWidth(0),
       mVideoHeight(0),
       mIsAudio(true),
@@ -75,12 +79,36 @@ NuPlayer::Decoder::Decoder(
       mTimeChangePending(false),
       mVideoFormatChangeDoFlushOnly(false),
       mResumePending(false),
+      mTunneled(false),
+      mTunneledRenderingStarted(false),
       mComponentName("decoder") {
     mCodecLooper = new ALooper;
     mCodecLooper->setName("NPDecoder-CL");
     mCodecLooper->start(false, false, ANDROID_PRIORITY_AUDIO);
 }
 
+// static
+bool NuPlayer::Decoder::findTunneledDecoder(const AString &mime, AString *name) {
+    sp<IMediaCodecList> list = MediaCodecList::getInstance();
+    if (list == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < list->countCodecs(); ++i) {
+        sp<MediaCodecInfo> info = list->getCodecInfo(i);
+        if (info == NULL || info->isEncoder()) {
+            continue;
+        }
+        const sp<MediaCodecInfo::Capabilities> caps = info->getCapabilitiesFor(mime.c_str());
+        int32_t tunneled;
+        if (caps != NULL
+                && caps->getDetails()->findInt32("feature-tunneled-playback", &tunneled)) {
+            name->setTo(info->getCodecName());
+            return true;
+        }
+    }
+    return false;
+}
+
 NuPlayer::Decoder::~Decoder() {
     if (mCodec != NULL) {
         mCodec->release();
@@ -92,6 +120,22 @@ sp<AMessage> NuPlayer::Decoder::getStats() const {
     mStats->setInt64("frames-total", mNumFramesTotal);
     mStats->setInt64("frames-dropped-input", mNumInputFramesDropped);
     mStats->setInt64("frames-dropped-output", mNumOutputFramesDropped);
+    mStats->setInt64("frames-dropped-predicted", mNumPredictedFramesDropped);
+
+    if (!mIsAudio && mRenderer != NULL) {
+        mRenderer->getVideoPacingStats(mStats);
+    }
+
+    sp<AMessage> codecStats;
+    if (mCodec != NULL && mCodec->getStats(&codecStats) == OK) {
+        int64_t value;
+        if (codecStats->findInt64("latency-avg-us", &value)) {
+            mStats->setInt64("decode-latency-avg-us", value);
+        }
+        if (codecStats->findInt64("latency-max-us", &value)) {
+            mStats->setInt64("decode-latency-max-us", value);
+        }
+    }
     return mStats;
 }
 
@@ -193,6 +237,17 @@ void NuPlayer::Decoder::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatTunneledFramesRendered:
+        {
+            if (mTunneled && !mTunneledRenderingStarted) {
+                mTunneledRenderingStarted = true;
+                sp<AMessage> notify = mNotify->dup();
+                notify->setInt32("what", kWhatVideoRenderingStart);
+                notify->post();
+            }
+            break;
+        }
+
         case kWhatSetVideoSurface:
         {
             sp<AReplyToken> replyID;
@@ -258,9 +313,46 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
     mComponentName.append(" decoder");
     ALOGV("[%s] onConfigure (surface=%p)", mComponentName.c_str(), mSurface.get());
 
+    const int64_t configureStartUs = ALooper::GetNowUs();
+
+    if (mCodecLooper == NULL) {
+        // the previous codec and its looper went to the decoder pool
+        mCodecLooper = new ALooper;
+        mCodecLooper->setName("NPDecoder-CL");
+        mCodecLooper->start(false, false, ANDROID_PRIORITY_AUDIO);
+    }
+
     mCodec = AVUtils::get()->createCustomComponentByName(mCodecLooper, mime.c_str(), false /* encoder */, format);
     FFMPEGSoftCodec::overrideComponentName(0, format, &mComponentName, &mime, false);
 
+    // NuPlayer offers the audio HW A/V sync id when tunneled video is enabled,
+    // the video then goes straight from the codec to a sideband stream.
+    mTunneled = false;
+    int32_t audioHwSync;
+    AString tunneledName;
+    if (mCodec == NULL && !mIsAudio && mSurface != NULL
+            && format->findInt32("audio-hw-sync", &audioHwSync)
+            && findTunneledDecoder(mime, &tunneledName)) {
+        mCodec = MediaCodec::CreateByComponentName(mCodecLooper, tunneledName.c_str());
+        if (mCodec != NULL) {
+            format->setInt32("feature-tunneled-playback", 1);
+            mTunneled = true;
+        }
+    }
+
+    // Only codecs created by type are pooled, vendor and ffmpeg overrides pick
+    // their component from the format.
+    mPoolKey.clear();
+    sp<NuPlayerDecoderPool> pool = NuPlayerDecoderPool::getInstance();
+    if (mCodec == NULL && pool != NULL && mComponentName.startsWith(mime.c_str())
+            && NuPlayerDecoderPool::getKey(format, &mPoolKey)) {
+        NuPlayerDecoderPool::setAdaptiveBounds(format);
+        sp<ALooper> looper;
+        if (pool->acquire(mPoolKey, &mCodec, &looper)) {
+            mCodecLooper = looper;
+        }
+    }
+
     if (mCodec == NULL) {
         if (!mComponentName.startsWith(mime.c_str())) {
             mCodec = MediaCodec::CreateByComponentName(mCodecLooper, mComponentName.c_str());
@@ -330,6 +422,13 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
     sp<AMessage> reply = new AMessage(kWhatCodecNotify, this);
     mCodec->setCallback(reply);
 
+    if (mTunneled) {
+        // no output buffers come back, learn about rendering from the codec
+        mTunneledRenderingStarted = false;
+        mCodec->setOnFrameRenderedNotification(
+                new AMessage(kWhatTunneledFramesRendered, this));
+    }
+
     err = mCodec->start();
     if (err != OK) {
         ALOGE("Failed to start %s decoder (err=%d)", mComponentName.c_str(), err);
@@ -341,6 +440,11 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
 
     releaseAndResetMediaBuffers();
 
+    // codec allocation, configure and start, for the startup timing in dumpsys
+    const int64_t nowUs = ALooper::GetNowUs();
+    mStats->setInt64("codec-configure-us", nowUs - configureStartUs);
+    mStats->setInt64("codec-ready-time-us", nowUs);
+
     mPaused = false;
     mResumePending = false;
 }
@@ -399,6 +503,7 @@ void NuPlayer::Decoder::doFlush(bool notifyComplete) {
         mCSDsToSubmit = mCSDsForCurrentFormat; // copy operator
         ++mBufferGeneration;
     }
+    mInputQueueTimesUs.clear();
 
     if (err != OK) {
         ALOGE("failed to flush %s (err=%d)", mComponentName.c_str(), err);
@@ -433,7 +538,15 @@ void NuPlayer::Decoder::onShutdown(bool notifyComplete) {
     notifyResumeCompleteIfNecessary();
 
     if (mCodec != NULL) {
-        err = mCodec->release();
+        sp<NuPlayerDecoderPool> pool;
+        if (!mPoolKey.empty() && (pool = NuPlayerDecoderPool::getInstance()) != NULL
+                && mCodec->stop() == OK) {
+            // keep the component allocated for the next item of the same kind
+            pool->add(mPoolKey, mCodec, mCodecLooper);
+            mCodecLooper.clear();
+        } else {
+            err = mCodec->release();
+        }
         mCodec = NULL;
         ++mBufferGeneration;
 
@@ -634,6 +747,17 @@ bool NuPlayer::Decoder::handleAnOutputBuffer(
 
     mNumFramesTotal += !mIsAudio;
 
+    if (mPlayerStats != NULL) {
+        ssize_t queuedIx = mInputQueueTimesUs.indexOfKey(timeUs);
+        if (queuedIx >= 0) {
+            mPlayerStats->addLatency(
+                    statsTrack(), NuPlayerStats::STAGE_DECODE,
+                    ALooper::GetNowUs() - mInputQueueTimesUs.valueAt(queuedIx));
+            mInputQueueTimesUs.removeItemsAt(queuedIx);
+        }
+        reply->setInt64("queuedUs", ALooper::GetNowUs());
+    }
+
     // wait until 1st frame comes out to signal resume complete
     notifyResumeCompleteIfNecessary();
 
@@ -681,6 +805,26 @@ void NuPlayer::Decoder::handleOutputFormatChange(const sp<AMessage> &format) {
     }
 }
 
+void NuPlayer::Decoder::onInputQueued(int64_t timeUs) {
+    if (mPlayerStats == NULL) {
+        return;
+    }
+
+    // Codecs that drop frames never produce output for some inputs, so only the latest
+    // presentation times are kept.
+    static const size_t kMaxPendingInputs = 64;
+    if (mInputQueueTimesUs.size() >= kMaxPendingInputs) {
+        mInputQueueTimesUs.removeItemsAt(0);
+    }
+    mInputQueueTimesUs.add(timeUs, ALooper::GetNowUs());
+
+    size_t depth = 0;
+    for (size_t i = 0; i < mInputBufferIsDequeued.size(); ++i) {
+        depth += !mInputBufferIsDequeued[i];
+    }
+    mPlayerStats->addCodecQueueDepth(statsTrack(), depth);
+}
+
 void NuPlayer::Decoder::releaseAndResetMediaBuffers() {
     for (size_t i = 0; i < mMediaBuffers.size(); i++) {
         if (mMediaBuffers[i] != NULL) {
@@ -721,8 +865,16 @@ status_t NuPlayer::Decoder::fetchInputData(sp<AMessage> &reply) {
     sp<ABuffer> accessUnit;
     bool dropAccessUnit;
     do {
+        int64_t readStartUs = ALooper::GetNowUs();
         status_t err = mSource->dequeueAccessUnit(mIsAudio, &accessUnit);
 
+        if (err == OK && mPlayerStats != NULL) {
+            mPlayerStats->addLatency(
+                    statsTrack(), NuPlayerStats::STAGE_SOURCE_READ,
+                    ALooper::GetNowUs() - readStartUs);
+            mPlayerStats->addBytesRead(statsTrack(), accessUnit->size());
+        }
+
         if (err == -EWOULDBLOCK) {
             return err;
         } else if (err != OK) {
@@ -789,14 +941,22 @@ status_t NuPlayer::Decoder::fetchInputData(sp<AMessage> &reply) {
             return ERROR_END_OF_STREAM;
         }
 
+        // Skip non-reference frames before they are decoded if video is, or
+        // is about to be, so late that the renderer would drop them anyway.
         dropAccessUnit = false;
         if (!mIsAudio
                 && !mIsSecure
-                && mRenderer->getVideoLateByUs() > 100000ll
                 && mIsVideoAVC
+                && mRenderer->getPredictedVideoLateByUs() > 100000ll
                 && !IsAVCReferenceFrame(accessUnit)) {
             dropAccessUnit = true;
             ++mNumInputFramesDropped;
+            if (mRenderer->getVideoLateByUs() <= 100000ll) {
+                ++mNumPredictedFramesDropped;
+            }
+            if (mPlayerStats != NULL) {
+                mPlayerStats->addDroppedFrames(statsTrack(), 1);
+            }
         }
     } while (dropAccessUnit);
 
@@ -875,6 +1035,9 @@ bool NuPlayer::Decoder::onInputBufferFetched(const sp<AMessage> &msg) {
                 MediaCodec::BUFFER_FLAG_EOS);
         if (err == OK) {
             mInputBufferIsDequeued.editItemAt(bufferIx) = false;
+            if (mTunneled) {
+                onTunneledInputEOS();
+            }
         } else if (streamErr == ERROR_END_OF_STREAM) {
             streamErr = err;
             // err will not be ERROR_END_OF_STREAM
@@ -937,11 +1100,29 @@ bool NuPlayer::Decoder::onInputBufferFetched(const sp<AMessage> &msg) {
                 CHECK(mMediaBuffers[bufferIx] == NULL);
                 mMediaBuffers.editItemAt(bufferIx) = mediaBuffer;
             }
+            onInputQueued(timeUs);
+            if (mTunneled) {
+                ++mNumFramesTotal;
+                notifyResumeCompleteIfNecessary();
+                if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                    onTunneledInputEOS();
+                }
+            }
         }
     }
     return true;
 }
 
+// A tunneled codec returns no output buffers, not even the one carrying EOS, so
+// input EOS stands in for it.
+void NuPlayer::Decoder::onTunneledInputEOS() {
+    if (isDiscontinuityPending()) {
+        finishHandleDiscontinuity(true /* flushOnTimeChange */);
+    } else if (mRenderer != NULL) {
+        mRenderer->queueEOS(mIsAudio, ERROR_END_OF_STREAM);
+    }
+}
+
 void NuPlayer::Decoder::onRenderBuffer(const sp<AMessage> &msg) {
     status_t err;
     int32_t render;
@@ -959,7 +1140,21 @@ void NuPlayer::Decoder::onRenderBuffer(const sp<AMessage> &msg) {
         }
     }
 
-    if (msg->findInt32("render", &render) && render) {
+    bool haveRender = msg->findInt32("render", &render);
+    if (mPlayerStats != NULL) {
+        int64_t queuedUs;
+        if (msg->findInt64("queuedUs", &queuedUs)) {
+            mPlayerStats->addLatency(
+                    statsTrack(), NuPlayerStats::STAGE_RENDER, ALooper::GetNowUs() - queuedUs);
+        }
+        if (!mIsAudio && !haveRender) {
+            mPlayerStats->addDroppedFrames(statsTrack(), 1);
+        } else if (!mIsAudio && !render) {
+            mPlayerStats->addLateFrame(statsTrack());
+        }
+    }
+
+    if (haveRender && render) {
         int64_t timestampNs;
         CHECK(msg->findInt64("timestampNs", &timestampNs));
         err = mCodec->renderOutputBufferAndRelease(bufferIx, timestampNs);
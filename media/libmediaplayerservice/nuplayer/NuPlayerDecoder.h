@@ -59,6 +59,7 @@ protected:
     enum {
         kWhatCodecNotify         = 'cdcN',
         kWhatRenderBuffer        = 'rndr',
+        kWhatTunneledFramesRendered = 'tnFR',
         kWhatSetVideoSurface     = 'sSur'
     };
 
@@ -82,12 +83,15 @@ protected:
     Vector<bool> mInputBufferIsDequeued;
     Vector<MediaBuffer *> mMediaBuffers;
     Vector<size_t> mDequeuedInputBuffers;
+    // queue time of the inputs whose output is pending, by presentation time
+    KeyedVector<int64_t, int64_t> mInputQueueTimesUs;
 
     const pid_t mPid;
     int64_t mSkipRenderingUntilMediaTimeUs;
     int64_t mNumFramesTotal;
     int64_t mNumInputFramesDropped;
     int64_t mNumOutputFramesDropped;
+    int64_t mNumPredictedFramesDropped; // input frames dropped ahead of lateness
     int32_t mVideoWidth;
     int32_t mVideoHeight;
     bool mIsAudio;
@@ -98,7 +102,13 @@ protected:
     bool mVideoFormatChangeDoFlushOnly;
 
     bool mResumePending;
+    bool mTunneled;     // video goes from the codec straight to a sideband stream
+    bool mTunneledRenderingStarted;
     AString mComponentName;
+    AString mPoolKey;   // empty if the codec is not returned to NuPlayerDecoderPool
+
+    static bool findTunneledDecoder(const AString &mime, AString *name);
+    void onTunneledInputEOS();
 
     void handleError(int32_t err);
     bool handleAnInputBuffer(size_t index);
@@ -110,6 +120,11 @@ protected:
             int32_t flags);
     virtual void handleOutputFormatChange(const sp<AMessage> &format);
 
+    NuPlayerStats::Track statsTrack() const {
+        return mIsAudio ? NuPlayerStats::TRACK_AUDIO : NuPlayerStats::TRACK_VIDEO;
+    }
+    void onInputQueued(int64_t timeUs);
+
     void releaseAndResetMediaBuffers();
     void requestCodecNotification();
     bool isStaleReply(const sp<AMessage> &msg);
@@ -19,6 +19,7 @@
 #define NUPLAYER_DECODER_BASE_H_
 
 #include "NuPlayer.h"
+#include "NuPlayerStats.h"
 
 #include <media/stagefright/foundation/AHandler.h>
 
@@ -40,6 +41,8 @@ struct NuPlayer::DecoderBase : public AHandler {
     void pause();
 
     void setRenderer(const sp<Renderer> &renderer);
+    // Must be called before init().
+    void setPlayerStats(const sp<NuPlayerStats> &stats) { mPlayerStats = stats; }
     virtual status_t setVideoSurface(const sp<Surface> &) { return INVALID_OPERATION; }
 
     status_t getInputBuffers(Vector<sp<ABuffer> > *dstBuffers) const;
@@ -59,6 +62,7 @@ struct NuPlayer::DecoderBase : public AHandler {
         kWhatResumeCompleted     = 'resC',
         kWhatEOS                 = 'eos ',
         kWhatError               = 'err ',
+        kWhatVideoRenderingStart = 'vdRS',  // tunneled video only
     };
 
 protected:
@@ -83,6 +87,7 @@ protected:
     int32_t mBufferGeneration;
     bool mPaused;
     sp<AMessage> mStats;
+    sp<NuPlayerStats> mPlayerStats;  // may be NULL
 
 private:
     enum {
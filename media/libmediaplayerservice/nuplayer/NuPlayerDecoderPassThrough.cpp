@@ -24,9 +24,11 @@
 #include "NuPlayerRenderer.h"
 #include "NuPlayerSource.h"
 
+#include <cutils/properties.h>
 #include <media/ICrypto.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaErrors.h>
 #include "mediaplayerservice/AVNuExtensions.h"
@@ -35,7 +37,18 @@
 
 namespace android {
 
-static const size_t kMaxCachedBytes = 200000;
+static const size_t kDefaultAggregateBufferSizeBytes = 24 * 1024;
+static const size_t kDefaultMaxCachedBytes = 200000;
+
+// With the sink's buffer duration and the bitrate known, a write covers a
+// quarter of the sink buffer, and two sink buffers, or at least
+// kMinCachedDurationUs, are queued ahead of it.
+static const int64_t kMinCachedDurationUs = 2000000ll;
+static const size_t kMaxAggregateBufferSizeBytes = 1024 * 1024;
+static const size_t kMaxMaxCachedBytes = 4 * 1024 * 1024;
+
+// In sleep friendly mode each write covers this much, for local playback.
+static const int64_t kSleepFriendlyWriteDurationUs = 4000000ll;
 
 NuPlayer::DecoderPassThrough::DecoderPassThrough(
         const sp<AMessage> &notify,
@@ -44,14 +57,16 @@ NuPlayer::DecoderPassThrough::DecoderPassThrough(
     : DecoderBase(notify),
       mSource(source),
       mRenderer(renderer),
-      // TODO optimize buffer size for power consumption
-      // The offload read buffer size is 32 KB but 24 KB uses less power.
-      mAggregateBufferSizeBytes(24 * 1024),
+      // The offload read buffer size is 32 KB but 24 KB uses less power,
+      // updateBufferSizes() adjusts this to the sink.
+      mAggregateBufferSizeBytes(kDefaultAggregateBufferSizeBytes),
       mSkipRenderingUntilMediaTimeUs(-1ll),
       mReachedEOS(true),
       mPendingAudioErr(OK),
       mPendingBuffersToDrain(0),
       mCachedBytes(0),
+      mMaxCachedBytes(kDefaultMaxCachedBytes),
+      mSleepFriendly(property_get_bool("media.stagefright.offload-sleep-friendly", false)),
       mComponentName("pass through decoder"),
       mPCMFormat(AUDIO_FORMAT_INVALID) {
     ALOGW_IF(renderer == NULL, "expect a non-NULL renderer");
@@ -89,7 +104,57 @@ void NuPlayer::DecoderPassThrough::onConfigure(const sp<AMessage> &format) {
             AUDIO_OUTPUT_FLAG_NONE /* flags */, NULL /* isOffloaded */, mSource->isStreaming());
     if (err != OK) {
         handleError(err);
+        return;
     }
+
+    updateBufferSizes(format);
+}
+
+void NuPlayer::DecoderPassThrough::updateBufferSizes(const sp<AMessage> &format) {
+    mAggregateBufferSizeBytes = kDefaultAggregateBufferSizeBytes;
+    mMaxCachedBytes = kDefaultMaxCachedBytes;
+
+    int32_t bitrate;
+    int64_t sinkUs = mRenderer->getAudioSinkBufferDurationUs();
+    if (!format->findInt32("bitrate", &bitrate) || bitrate <= 0 || sinkUs <= 0) {
+        ALOGV("[%s] bitrate or sink buffer duration unknown, using default sizes",
+                mComponentName.c_str());
+        return;
+    }
+
+    int64_t writeUs = sinkUs / 4;
+    if (mSleepFriendly && !mSource->isStreaming()) {
+        writeUs = kSleepFriendlyWriteDurationUs;
+    }
+    int64_t cachedUs = writeUs * 2 > sinkUs ? writeUs * 2 : sinkUs * 2;
+    if (cachedUs < kMinCachedDurationUs) {
+        cachedUs = kMinCachedDurationUs;
+    }
+
+    int64_t aggregateBytes = writeUs * bitrate / 8000000ll;
+    if (aggregateBytes < (int64_t)kDefaultAggregateBufferSizeBytes) {
+        aggregateBytes = kDefaultAggregateBufferSizeBytes;
+    } else if (aggregateBytes > (int64_t)kMaxAggregateBufferSizeBytes) {
+        aggregateBytes = kMaxAggregateBufferSizeBytes;
+    }
+    mAggregateBufferSizeBytes = aggregateBytes;
+
+    // always room for a couple of aggregates in flight
+    int64_t cachedBytes = cachedUs * bitrate / 8000000ll;
+    if (cachedBytes < 2 * aggregateBytes) {
+        cachedBytes = 2 * aggregateBytes;
+    }
+    if (cachedBytes < (int64_t)kDefaultMaxCachedBytes) {
+        cachedBytes = kDefaultMaxCachedBytes;
+    } else if (cachedBytes > (int64_t)kMaxMaxCachedBytes) {
+        cachedBytes = kMaxMaxCachedBytes;
+    }
+    mMaxCachedBytes = cachedBytes;
+
+    ALOGI("[%s] %d bps, sink buffer %lld us: aggregate %zu bytes, cache %zu bytes%s",
+            mComponentName.c_str(), bitrate, (long long)sinkUs,
+            mAggregateBufferSizeBytes, mMaxCachedBytes,
+            mSleepFriendly ? ", sleep friendly" : "");
 }
 
 void NuPlayer::DecoderPassThrough::onSetParameters(const sp<AMessage> &/*params*/) {
@@ -118,7 +183,7 @@ bool NuPlayer::DecoderPassThrough::isDoneFetching() const {
     ALOGV("[%s] mCachedBytes = %zu, mReachedEOS = %d mPaused = %d",
             mComponentName.c_str(), mCachedBytes, mReachedEOS, mPaused);
 
-    return mCachedBytes >= kMaxCachedBytes || mReachedEOS || mPaused;
+    return mCachedBytes >= mMaxCachedBytes || mReachedEOS || mPaused;
 }
 
 /*
@@ -151,7 +216,14 @@ status_t NuPlayer::DecoderPassThrough::dequeueAccessUnit(sp<ABuffer> *accessUnit
         err = mPendingAudioErr;
         ALOGV("feedDecoderInputData() use mPendingAudioAccessUnit");
     } else {
+        int64_t readStartUs = ALooper::GetNowUs();
         err = mSource->dequeueAccessUnit(true /* audio */, accessUnit);
+        if (err == OK && mPlayerStats != NULL) {
+            mPlayerStats->addLatency(
+                    NuPlayerStats::TRACK_AUDIO, NuPlayerStats::STAGE_SOURCE_READ,
+                    ALooper::GetNowUs() - readStartUs);
+            mPlayerStats->addBytesRead(NuPlayerStats::TRACK_AUDIO, (*accessUnit)->size());
+        }
     }
 
     if (err == INFO_DISCONTINUITY || err == ERROR_END_OF_STREAM) {
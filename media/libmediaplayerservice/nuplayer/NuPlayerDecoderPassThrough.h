@@ -69,11 +69,15 @@ private:
     // when the power investigation is done.
     size_t  mPendingBuffersToDrain;
     size_t  mCachedBytes;
+    size_t  mMaxCachedBytes;
+    // fill the DSP with long writes, so that the AP sleeps between them
+    bool    mSleepFriendly;
     AString mComponentName;
     audio_format_t mPCMFormat;
 
     bool isStaleReply(const sp<AMessage> &msg);
     bool isDoneFetching() const;
+    void updateBufferSizes(const sp<AMessage> &format);
 
     status_t dequeueAccessUnit(sp<ABuffer> *accessUnit);
     status_t fetchInputData(sp<AMessage> &reply);
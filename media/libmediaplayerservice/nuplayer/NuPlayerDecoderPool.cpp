@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NuPlayerDecoderPool"
+#include <utils/Log.h>
+
+#include "NuPlayerDecoderPool.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+
+namespace android {
+
+static const size_t kMaxIdleCodecs = 2;
+static const int64_t kIdleTimeoutUs = 5000000ll;
+
+// Resolution classes, in landscape orientation.
+static const struct {
+    int32_t mWidth;
+    int32_t mHeight;
+} kResolutionClasses[] = {
+    { 1280, 720 },
+    { 1920, 1088 },
+    { 4096, 2160 },
+};
+
+static const size_t kNumResolutionClasses =
+    sizeof(kResolutionClasses) / sizeof(kResolutionClasses[0]);
+
+static Mutex sInstanceLock;
+static sp<NuPlayerDecoderPool> sInstance;
+
+// static
+sp<NuPlayerDecoderPool> NuPlayerDecoderPool::getInstance() {
+    if (!property_get_bool("media.stagefright.nuplayer-decoder-pool", false)) {
+        return NULL;
+    }
+
+    Mutex::Autolock autoLock(sInstanceLock);
+    if (sInstance == NULL) {
+        sInstance = new NuPlayerDecoderPool;
+        sInstance->mLooper->registerHandler(sInstance);
+    }
+    return sInstance;
+}
+
+static ssize_t findResolutionClass(const sp<AMessage> &format) {
+    int32_t width, height;
+    if (!format->findInt32("width", &width) || !format->findInt32("height", &height)) {
+        return -1;
+    }
+    const int32_t longSide = width > height ? width : height;
+    const int32_t shortSide = width > height ? height : width;
+    for (size_t i = 0; i < kNumResolutionClasses; ++i) {
+        if (longSide <= kResolutionClasses[i].mWidth
+                && shortSide <= kResolutionClasses[i].mHeight) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// static
+bool NuPlayerDecoderPool::getKey(const sp<AMessage> &format, AString *key) {
+    AString mime;
+    int32_t secure;
+    if (!format->findString("mime", &mime)
+            || strncasecmp("video/", mime.c_str(), 6)
+            || (format->findInt32("secure", &secure) && secure != 0)) {
+        return false;
+    }
+
+    ssize_t resolutionClass = findResolutionClass(format);
+    if (resolutionClass < 0) {
+        return false;
+    }
+
+    key->setTo(mime);
+    key->append("@");
+    key->append(kResolutionClasses[resolutionClass].mHeight);
+    return true;
+}
+
+// static
+void NuPlayerDecoderPool::setAdaptiveBounds(const sp<AMessage> &format) {
+    int32_t maxWidth, maxHeight;
+    if (format->findInt32("max-width", &maxWidth)
+            && format->findInt32("max-height", &maxHeight)) {
+        return;
+    }
+
+    ssize_t resolutionClass = findResolutionClass(format);
+    if (resolutionClass < 0) {
+        return;
+    }
+
+    int32_t width, height;
+    CHECK(format->findInt32("width", &width));
+    CHECK(format->findInt32("height", &height));
+    maxWidth = kResolutionClasses[resolutionClass].mWidth;
+    maxHeight = kResolutionClasses[resolutionClass].mHeight;
+    if (width < height) {
+        int32_t tmp = maxWidth;
+        maxWidth = maxHeight;
+        maxHeight = tmp;
+    }
+    format->setInt32("max-width", maxWidth);
+    format->setInt32("max-height", maxHeight);
+}
+
+NuPlayerDecoderPool::NuPlayerDecoderPool()
+    : mLooper(new ALooper) {
+    mLooper->setName("NPDecoderPool");
+    mLooper->start(false, false, ANDROID_PRIORITY_DEFAULT);
+}
+
+NuPlayerDecoderPool::~NuPlayerDecoderPool() {
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        mEntries.editItemAt(i).mCodec->release();
+    }
+    mLooper->stop();
+}
+
+bool NuPlayerDecoderPool::acquire(
+        const AString &key, sp<MediaCodec> *codec, sp<ALooper> *looper) {
+    Mutex::Autolock autoLock(mLock);
+    for (size_t i = mEntries.size(); i-- > 0;) {
+        if (mEntries[i].mKey == key) {
+            *codec = mEntries[i].mCodec;
+            *looper = mEntries[i].mCodecLooper;
+            mEntries.removeAt(i);
+            ALOGV("reusing idle %s decoder, %zu left", key.c_str(), mEntries.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+void NuPlayerDecoderPool::add(
+        const AString &key, const sp<MediaCodec> &codec, const sp<ALooper> &looper) {
+    // keeps the codec looper running until the codec is released
+    Entry evicted;
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mEntries.size() >= kMaxIdleCodecs) {
+            evicted = mEntries[0];
+            mEntries.removeAt(0);
+        }
+        Entry entry;
+        entry.mKey = key;
+        entry.mCodec = codec;
+        entry.mCodecLooper = looper;
+        entry.mIdleSinceUs = ALooper::GetNowUs();
+        mEntries.push_back(entry);
+        ALOGV("keeping idle %s decoder, %zu idle", key.c_str(), mEntries.size());
+    }
+
+    // release outside of the lock, this waits for the component
+    if (evicted.mCodec != NULL) {
+        evicted.mCodec->release();
+    }
+
+    (new AMessage(kWhatExpire, this))->post(kIdleTimeoutUs);
+}
+
+void NuPlayerDecoderPool::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatExpire:
+        {
+            Vector<Entry> expired;
+            {
+                Mutex::Autolock autoLock(mLock);
+                const int64_t nowUs = ALooper::GetNowUs();
+                for (size_t i = mEntries.size(); i-- > 0;) {
+                    if (nowUs - mEntries[i].mIdleSinceUs >= kIdleTimeoutUs) {
+                        expired.push_back(mEntries[i]);
+                        mEntries.removeAt(i);
+                    }
+                }
+            }
+            for (size_t i = 0; i < expired.size(); ++i) {
+                ALOGV("releasing expired idle decoder");
+                expired.editItemAt(i).mCodec->release();
+            }
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NUPLAYER_DECODER_POOL_H_
+
+#define NUPLAYER_DECODER_POOL_H_
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ALooper;
+struct AMessage;
+struct MediaCodec;
+
+// Process wide set of idle video decoders, shared by all NuPlayer instances in
+// mediaserver. A decoder that shuts down leaves its codec here in the stopped but
+// allocated state, so that the next playlist item or ad of the same kind configures
+// it instead of allocating a new component. Idle codecs are released after a few
+// seconds, so that they do not hold on to hardware resources.
+struct NuPlayerDecoderPool : public AHandler {
+    // NULL unless "media.stagefright.nuplayer-decoder-pool" is set.
+    static sp<NuPlayerDecoderPool> getInstance();
+
+    // Pool key for a video track format, the mime type and a resolution class.
+    // Returns false if decoders for the format are not pooled.
+    static bool getKey(const sp<AMessage> &format, AString *key);
+
+    // Sets max-width and max-height to the bounds of the resolution class, so that
+    // adaptive playback switches within the class without reallocating buffers.
+    static void setAdaptiveBounds(const sp<AMessage> &format);
+
+    // Takes an idle codec, in the initialized state, and the looper it runs on.
+    bool acquire(const AString &key, sp<MediaCodec> *codec, sp<ALooper> *looper);
+
+    // Keeps a stopped codec, the least recently added codec is released if the
+    // pool is full.
+    void add(const AString &key, const sp<MediaCodec> &codec, const sp<ALooper> &looper);
+
+protected:
+    virtual ~NuPlayerDecoderPool();
+
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatExpire = 'expr',
+    };
+
+    struct Entry {
+        AString mKey;
+        sp<MediaCodec> mCodec;
+        sp<ALooper> mCodecLooper;
+        int64_t mIdleSinceUs;
+    };
+
+    Mutex mLock;
+    Vector<Entry> mEntries;     // least recently added first
+    sp<ALooper> mLooper;        // for expiring idle codecs
+
+    NuPlayerDecoderPool();
+
+    DISALLOW_EVIL_CONSTRUCTORS(NuPlayerDecoderPool);
+};
+
+}  // namespace android
+
+#endif  // NUPLAYER_DECODER_POOL_H_
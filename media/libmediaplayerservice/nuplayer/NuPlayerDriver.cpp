@@ -24,6 +24,7 @@
 
 #include "NuPlayer.h"
 #include "NuPlayerSource.h"
+#include "NuPlayerStats.h"
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -49,7 +50,11 @@ NuPlayerDriver::NuPlayerDriver(pid_t pid)
       mAtEOS(false),
       mLooping(false),
       mAutoLoop(false),
-      mStartupSeekTimeUs(-1) {
+      mStartupSeekTimeUs(-1),
+      mPrepareStartTimeUs(-1),
+      mPrepareDoneTimeUs(-1),
+      mStartTimeUs(-1),
+      mFirstFrameTimeUs(-1) {
     ALOGV("NuPlayerDriver(%p)", this);
     mLooper->setName("NuPlayerDriver Looper");
 
@@ -203,6 +208,7 @@ status_t NuPlayerDriver::prepare_l() {
             // failure information is only communicated through our result
             // code.
             mIsAsyncPrepare = false;
+            resetStartupTiming_l();
             mPlayer->prepareAsync();
             while (mState == STATE_PREPARING) {
                 mCondition.wait(mLock);
@@ -231,6 +237,7 @@ status_t NuPlayerDriver::prepareAsync() {
         case STATE_UNPREPARED:
             mState = STATE_PREPARING;
             mIsAsyncPrepare = true;
+            resetStartupTiming_l();
             mPlayer->prepareAsync();
             return OK;
         case STATE_STOPPED:
@@ -277,6 +284,9 @@ status_t NuPlayerDriver::start() {
         case STATE_PREPARED:
         {
             mAtEOS = false;
+            if (mStartTimeUs < 0) {
+                mStartTimeUs = ALooper::GetNowUs();
+            }
             mPlayer->start();
 
             if (mStartupSeekTimeUs >= 0) {
@@ -581,9 +591,20 @@ void NuPlayerDriver::setAudioSink(const sp<AudioSink> &audioSink) {
     mAudioSink = audioSink;
 }
 
-status_t NuPlayerDriver::setParameter(
-        int /* key */, const Parcel & /* request */) {
-    return INVALID_OPERATION;
+status_t NuPlayerDriver::setParameter(int key, const Parcel &request) {
+    switch (key) {
+        case KEY_PARAMETER_COMMON_TIME_ANCHOR:
+        {
+            int64_t mediaUs, commonUs;
+            if (request.readInt64(&mediaUs) != OK || request.readInt64(&commonUs) != OK) {
+                return BAD_VALUE;
+            }
+            return mPlayer->setCommonTimeAnchor(mediaUs, commonUs);
+        }
+
+        default:
+            return INVALID_OPERATION;
+    }
 }
 
 status_t NuPlayerDriver::getParameter(int /* key */, Parcel * /* reply */) {
@@ -673,9 +694,27 @@ status_t NuPlayerDriver::dump(
     Vector<sp<AMessage> > trackStats;
     mPlayer->getStats(&trackStats);
 
+    int64_t prepareStartTimeUs, prepareDoneTimeUs, startTimeUs, firstFrameTimeUs;
+    {
+        Mutex::Autolock autoLock(mLock);
+        prepareStartTimeUs = mPrepareStartTimeUs;
+        prepareDoneTimeUs = mPrepareDoneTimeUs;
+        startTimeUs = mStartTimeUs;
+        firstFrameTimeUs = mFirstFrameTimeUs;
+    }
+
     AString logString(" NuPlayer\n");
     char buf[256] = {0};
 
+    // startup phases, in ms since prepare, -1 if not reached
+    if (prepareStartTimeUs >= 0) {
+        snprintf(buf, sizeof(buf), "  startup(prepared %.1f, start %.1f, first frame %.1f ms)\n",
+                 prepareDoneTimeUs < 0 ? -1. : (prepareDoneTimeUs - prepareStartTimeUs) / 1E3,
+                 startTimeUs < 0 ? -1. : (startTimeUs - prepareStartTimeUs) / 1E3,
+                 firstFrameTimeUs < 0 ? -1. : (firstFrameTimeUs - prepareStartTimeUs) / 1E3);
+        logString.append(buf);
+    }
+
     for (size_t i = 0; i < trackStats.size(); ++i) {
         const sp<AMessage> &stats = trackStats.itemAt(i);
 
@@ -691,6 +730,15 @@ status_t NuPlayerDriver::dump(
             logString.append(buf);
         }
 
+        int64_t configureUs, readyTimeUs;
+        if (prepareStartTimeUs >= 0
+                && stats->findInt64("codec-configure-us", &configureUs)
+                && stats->findInt64("codec-ready-time-us", &readyTimeUs)) {
+            snprintf(buf, sizeof(buf), "    codecConfigure(%.1f ms, ready %.1f ms after prepare)\n",
+                     configureUs / 1E3, (readyTimeUs - prepareStartTimeUs) / 1E3);
+            logString.append(buf);
+        }
+
         if (mime.startsWith("video/")) {
             int32_t width, height;
             if (stats->findInt32("width", &width)
@@ -711,9 +759,44 @@ status_t NuPlayerDriver::dump(
                      numFramesTotal == 0
                             ? 0.0 : (double)(numFramesDropped * 100) / numFramesTotal);
             logString.append(buf);
+
+            int64_t latencyAvgUs, latencyMaxUs;
+            if (stats->findInt64("decode-latency-avg-us", &latencyAvgUs)
+                    && stats->findInt64("decode-latency-max-us", &latencyMaxUs)) {
+                snprintf(buf, sizeof(buf), "    decodeLatency(avg %lld us, max %lld us)\n",
+                         (long long)latencyAvgUs, (long long)latencyMaxUs);
+                logString.append(buf);
+            }
+
+            int64_t numFramesSkipped = 0;
+            int64_t numFramesPredicted = 0;
+            stats->findInt64("frames-dropped-input", &numFramesSkipped);
+            stats->findInt64("frames-dropped-predicted", &numFramesPredicted);
+            snprintf(buf, sizeof(buf), "    numFramesSkippedBeforeDecode(%lld, %lld predicted)\n",
+                     (long long)numFramesSkipped, (long long)numFramesPredicted);
+            logString.append(buf);
+
+            float frameRate, refreshRate, preferredRefreshRate;
+            int64_t numFramesPaced, numFramesJudder;
+            if (stats->findFloat("video-frame-rate", &frameRate)
+                    && stats->findFloat("refresh-rate", &refreshRate)
+                    && stats->findFloat("preferred-refresh-rate", &preferredRefreshRate)
+                    && stats->findInt64("frames-paced", &numFramesPaced)
+                    && stats->findInt64("frames-judder", &numFramesJudder)) {
+                AString cadence("none");
+                stats->findString("cadence", &cadence);
+                snprintf(buf, sizeof(buf), "    pacing(%.2f fps on %.2f Hz, cadence %s, "
+                         "judder %lld of %lld frames, preferred refresh %.2f Hz)\n",
+                         frameRate, refreshRate, cadence.c_str(),
+                         (long long)numFramesJudder, (long long)numFramesPaced,
+                         preferredRefreshRate);
+                logString.append(buf);
+            }
         }
     }
 
+    mPlayer->getPlayerStats()->dump(&logString);
+
     ALOGI("%s", logString.c_str());
 
     if (fd >= 0) {
@@ -726,6 +809,11 @@ status_t NuPlayerDriver::dump(
     return OK;
 }
 
+status_t NuPlayerDriver::getMetrics(Parcel *reply) {
+    mPlayer->getPlayerStats()->writeToParcel(reply);
+    return OK;
+}
+
 void NuPlayerDriver::notifyListener(
         int msg, int ext1, int ext2, const Parcel *in) {
     Mutex::Autolock autoLock(mLock);
@@ -779,6 +867,14 @@ void NuPlayerDriver::notifyListener_l(
             break;
         }
 
+        case MEDIA_INFO:
+        {
+            if (ext1 == MEDIA_INFO_RENDERING_START && mFirstFrameTimeUs < 0) {
+                mFirstFrameTimeUs = ALooper::GetNowUs();
+            }
+            break;
+        }
+
         default:
             break;
     }
@@ -812,6 +908,7 @@ void NuPlayerDriver::notifyPrepareCompleted(status_t err) {
     CHECK_EQ(mState, STATE_PREPARING);
 
     mAsyncResult = err;
+    mPrepareDoneTimeUs = ALooper::GetNowUs();
 
     if (err == OK) {
         // update state before notifying client, so that if client calls back into NuPlayerDriver
@@ -837,6 +934,13 @@ void NuPlayerDriver::notifyPrepareCompleted(status_t err) {
     mCondition.broadcast();
 }
 
+void NuPlayerDriver::resetStartupTiming_l() {
+    mPrepareStartTimeUs = ALooper::GetNowUs();
+    mPrepareDoneTimeUs = -1;
+    mStartTimeUs = -1;
+    mFirstFrameTimeUs = -1;
+}
+
 void NuPlayerDriver::notifyFlagsChanged(uint32_t flags) {
     Mutex::Autolock autoLock(mLock);
 
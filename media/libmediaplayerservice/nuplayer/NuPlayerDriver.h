@@ -68,6 +68,7 @@ struct NuPlayerDriver : public MediaPlayerInterface {
             const media::Metadata::Filter& ids, Parcel *records);
 
     virtual status_t dump(int fd, const Vector<String16> &args) const;
+    virtual status_t getMetrics(Parcel *reply);
 
     void notifySetDataSourceCompleted(status_t err);
     void notifyPrepareCompleted(status_t err);
@@ -124,7 +125,14 @@ private:
 
     int64_t mStartupSeekTimeUs;
 
+    // Startup timing for dumpsys, ALooper::GetNowUs() or -1. Protected by mLock.
+    int64_t mPrepareStartTimeUs;
+    int64_t mPrepareDoneTimeUs;
+    int64_t mStartTimeUs;
+    int64_t mFirstFrameTimeUs;
+
     status_t prepare_l();
+    void resetStartupTiming_l();
     void notifyListener_l(int msg, int ext1 = 0, int ext2 = 0, const Parcel *in = NULL);
 
     DISALLOW_EVIL_CONSTRUCTORS(NuPlayerDriver);
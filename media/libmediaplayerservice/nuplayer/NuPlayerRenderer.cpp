@@ -19,6 +19,8 @@
 #include <utils/Log.h>
 
 #include "NuPlayerRenderer.h"
+#include "NuPlayerStats.h"
+#include <common_time/cc_helper.h>
 #include <cutils/properties.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -33,6 +35,7 @@
 #include <media/stagefright/VideoFrameScheduler.h>
 
 #include <inttypes.h>
+#include <math.h>
 #include "mediaplayerservice/AVNuExtensions.h"
 #include "stagefright/AVExtensions.h"
 
@@ -72,6 +75,19 @@ static inline int32_t getAudioSinkPcmMsSetting() {
 // is closed to allow the audio DSP to power down.
 static const int64_t kOffloadPauseMaxUs = 10000000ll;
 
+// Common time sync: how often the skew from the common timeline is measured, the largest
+// audio rate trim, which inaudibly resamples, and how early audio may play before it is held
+// back instead. The trim follows a critically damped PI controller, which settles skew in
+// a few seconds and also cancels the steady drift between the local and the common clock.
+static const int64_t kCommonTimeSyncPeriodUs = 100000ll;
+static const int kCommonTimeOffsetSamples = 3;
+static const float kCommonTimeMaxTrim = 0.005f;
+static const int64_t kCommonTimeHoldSkewUs = 20000ll;
+static const int64_t kCommonTimeMaxVideoSkewUs = 500ll;
+static const double kCommonTimeSkewGain = 0.5 / 1E6;    // per us of skew
+static const double kCommonTimeSkewIntegralGain =
+        kCommonTimeSkewGain * kCommonTimeSkewGain / 4;  // per us^2 of skew over time
+
 // static
 const NuPlayer::Renderer::PcmInfo NuPlayer::Renderer::AUDIO_PCMINFO_INITIALIZER = {
         AUDIO_CHANNEL_NONE,
@@ -113,6 +129,7 @@ NuPlayer::Renderer::Renderer(
       mAnchorTimeMediaUs(-1),
       mAnchorNumFramesWritten(-1),
       mVideoLateByUs(0ll),
+      mVideoLateTrendUs(0ll),
       mHasAudio(false),
       mHasVideo(false),
       mFoundAudioEOS(false),
@@ -133,7 +150,15 @@ NuPlayer::Renderer::Renderer(
       mTotalBuffersQueued(0),
       mLastAudioBufferDrained(0),
       mUseAudioCallback(false),
-      mWakeLock(new AWakeLock()) {
+      mWakeLock(new AWakeLock()),
+      mCommonClock(NULL),
+      mCommonTimeAnchorMediaUs(-1),
+      mCommonTimeAnchorUs(-1),
+      mCommonTimeSyncGeneration(0),
+      mCommonTimeLastSyncUs(-1),
+      mCommonTimeSkewIntegral(0.),
+      mCommonTimeTrim(1.f),
+      mCommonTimeHolding(false) {
     mMediaClock = new MediaClock;
     mPlaybackRate = mPlaybackSettings.mSpeed;
     mMediaClock->setPlaybackRate(mPlaybackRate);
@@ -146,6 +171,7 @@ NuPlayer::Renderer::~Renderer() {
         mAudioSink->flush();
         mAudioSink->close();
     }
+    delete mCommonClock;
 }
 
 void NuPlayer::Renderer::queueBuffer(
@@ -194,14 +220,17 @@ status_t NuPlayer::Renderer::onConfigPlayback(const AudioPlaybackRate &rate /* s
     }
 
     if (mAudioSink != NULL && mAudioSink->ready()) {
-        status_t err = mAudioSink->setPlaybackRate(rate);
+        AudioPlaybackRate trimmed = rate;
+        trimmed.mSpeed *= mCommonTimeTrim;
+        trimmed.mPitch *= mCommonTimeTrim;
+        status_t err = mAudioSink->setPlaybackRate(trimmed);
         if (err != OK) {
             return err;
         }
     }
     mPlaybackSettings = rate;
     mPlaybackRate = rate.mSpeed;
-    mMediaClock->setPlaybackRate(mPlaybackRate);
+    mMediaClock->setPlaybackRate(mPlaybackRate * mCommonTimeTrim);
     return OK;
 }
 
@@ -219,7 +248,8 @@ status_t NuPlayer::Renderer::getPlaybackSettings(AudioPlaybackRate *rate /* nonn
 }
 
 status_t NuPlayer::Renderer::onGetPlaybackSettings(AudioPlaybackRate *rate /* nonnull */) {
-    if (mAudioSink != NULL && mAudioSink->ready()) {
+    // while trimmed to common time, the audiosink rate is not the one that was set
+    if (mAudioSink != NULL && mAudioSink->ready() && mCommonTimeTrim == 1.f) {
         status_t err = mAudioSink->getPlaybackRate(rate);
         if (err == OK) {
             if (!isAudioPlaybackRateEqual(*rate, mPlaybackSettings)) {
@@ -293,6 +323,7 @@ void NuPlayer::Renderer::flush(bool audio, bool notifyComplete) {
 
         clearAnchorTime_l();
         mVideoLateByUs = 0;
+        mVideoLateTrendUs = 0;
         mSyncQueues = false;
     }
 
@@ -327,6 +358,10 @@ void NuPlayer::Renderer::setVideoFrameRate(float fps) {
 }
 
 // Called on any threads.
+int64_t NuPlayer::Renderer::getAudioSinkBufferDurationUs() const {
+    return mAudioSink != NULL ? mAudioSink->getBufferDurationInUs() : -1;
+}
+
 status_t NuPlayer::Renderer::getCurrentPosition(int64_t *mediaUs) {
     return mMediaClock->getMediaTime(
             ALooper::GetNowUs(), mediaUs, (mHasAudio && mFoundAudioEOS));
@@ -353,6 +388,13 @@ void NuPlayer::Renderer::clearAnchorTime_l() {
 void NuPlayer::Renderer::setVideoLateByUs(int64_t lateUs) {
     Mutex::Autolock autoLock(mLock);
     mVideoLateByUs = lateUs;
+    mVideoLateTrendUs = 0;
+}
+
+void NuPlayer::Renderer::updateVideoLateByUs(int64_t lateUs) {
+    Mutex::Autolock autoLock(mLock);
+    mVideoLateTrendUs += (lateUs - mVideoLateByUs - mVideoLateTrendUs) / 8;
+    mVideoLateByUs = lateUs;
 }
 
 int64_t NuPlayer::Renderer::getVideoLateByUs() {
@@ -360,6 +402,36 @@ int64_t NuPlayer::Renderer::getVideoLateByUs() {
     return mVideoLateByUs;
 }
 
+int64_t NuPlayer::Renderer::getPredictedVideoLateByUs() {
+    // roughly the number of frames queued in the decoder and renderer
+    static const int64_t kVideoLatePredictionFrames = 8;
+
+    Mutex::Autolock autoLock(mLock);
+    if (mVideoLateTrendUs <= 0) {
+        return mVideoLateByUs;
+    }
+    return mVideoLateByUs + mVideoLateTrendUs * kVideoLatePredictionFrames;
+}
+
+// Called on any threads, but not on the renderer's.
+void NuPlayer::Renderer::getVideoPacingStats(const sp<AMessage> &stats) {
+    sp<AMessage> msg = new AMessage(kWhatGetVideoPacingStats, this);
+    msg->setMessage("stats", stats);
+    sp<AMessage> response;
+    msg->postAndAwaitResponse(&response);
+}
+
+void NuPlayer::Renderer::setPlayerStats(const sp<NuPlayerStats> &stats) {
+    mPlayerStats = stats;
+}
+
+void NuPlayer::Renderer::setCommonTimeAnchor(int64_t mediaUs, int64_t commonUs) {
+    sp<AMessage> msg = new AMessage(kWhatSetCommonTimeAnchor, this);
+    msg->setInt64("mediaUs", mediaUs);
+    msg->setInt64("commonUs", commonUs);
+    msg->post();
+}
+
 status_t NuPlayer::Renderer::openAudioSink(
         const sp<AMessage> &format,
         bool offloadOnly,
@@ -492,6 +564,9 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             mDrainVideoQueuePending = false;
 
             onDrainVideoQueue();
+            while (isNextVideoFrameDue()) {
+                onDrainVideoQueue();
+            }
 
             postDrainVideoQueue();
             break;
@@ -620,6 +695,45 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatGetVideoPacingStats:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            sp<AMessage> stats;
+            CHECK(msg->findMessage("stats", &stats));
+            onGetVideoPacingStats(stats);
+
+            sp<AMessage> response = new AMessage;
+            response->postReply(replyID);
+            break;
+        }
+
+        case kWhatSetCommonTimeAnchor:
+        {
+            int64_t mediaUs, commonUs;
+            CHECK(msg->findInt64("mediaUs", &mediaUs));
+            CHECK(msg->findInt64("commonUs", &commonUs));
+            onSetCommonTimeAnchor(mediaUs, commonUs);
+            break;
+        }
+
+        case kWhatCommonTimeSync:
+        case kWhatCommonTimeHoldEnd:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+            if (generation != mCommonTimeSyncGeneration) {
+                break;
+            }
+            if (msg->what() == kWhatCommonTimeSync) {
+                onCommonTimeSync();
+            } else {
+                onCommonTimeHoldEnd();
+            }
+            break;
+        }
+
         case kWhatAudioTearDown:
         {
             onAudioTearDown(kDueToError);
@@ -888,6 +1002,9 @@ bool NuPlayer::Renderer::onDrainAudioQueue() {
 
         if (entry->mBuffer == NULL) {
             // EOS
+            if (mNumFramesWritten != prevFramesWritten) {
+                onAudioFramesWritten();
+            }
             int64_t postEOSDelayUs = 0;
             if (mAudioSink->needsTrailingPadding()) {
                 postEOSDelayUs = getPendingAudioPlayoutDurationUs(ALooper::GetNowUs());
@@ -943,18 +1060,6 @@ bool NuPlayer::Renderer::onDrainAudioQueue() {
         size_t copiedFrames = written / mAudioSink->frameSize();
         mNumFramesWritten += copiedFrames;
 
-        {
-            Mutex::Autolock autoLock(mLock);
-            int64_t maxTimeMedia;
-            maxTimeMedia =
-                mAnchorTimeMediaUs +
-                        (int64_t)(max((long long)mNumFramesWritten - mAnchorNumFramesWritten, 0LL)
-                                * 1000LL * mAudioSink->msecsPerFrame());
-            mMediaClock->updateMaxTimeMedia(maxTimeMedia);
-
-            notifyIfMediaRenderingStarted_l();
-        }
-
         if (written != (ssize_t)copy) {
             // A short count was received from AudioSink::write()
             //
@@ -989,6 +1094,11 @@ bool NuPlayer::Renderer::onDrainAudioQueue() {
         }
     }
 
+    // once per drain rather than per buffer, the sink takes many small buffers at a time
+    if (mNumFramesWritten != prevFramesWritten) {
+        onAudioFramesWritten();
+    }
+
     // calculate whether we need to reschedule another write.
     bool reschedule = !mAudioQueue.empty()
             && (!mPaused
@@ -998,6 +1108,18 @@ bool NuPlayer::Renderer::onDrainAudioQueue() {
     return reschedule;
 }
 
+void NuPlayer::Renderer::onAudioFramesWritten() {
+    Mutex::Autolock autoLock(mLock);
+    int64_t maxTimeMedia;
+    maxTimeMedia =
+        mAnchorTimeMediaUs +
+                (int64_t)(max((long long)mNumFramesWritten - mAnchorNumFramesWritten, 0LL)
+                        * 1000LL * mAudioSink->msecsPerFrame());
+    mMediaClock->updateMaxTimeMedia(maxTimeMedia);
+
+    notifyIfMediaRenderingStarted_l();
+}
+
 int64_t NuPlayer::Renderer::getDurationUsIfPlayedAtSampleRate(uint32_t numFrames) {
     int32_t sampleRate = offloadingAudio() ?
             mCurrentOffloadInfo.sample_rate : mCurrentPcmInfo.mSampleRate;
@@ -1130,6 +1252,27 @@ void NuPlayer::Renderer::postDrainVideoQueue() {
     mDrainVideoQueuePending = true;
 }
 
+// True if the frame at the head of the video queue is due within a display refresh.
+// At frame rates near or above the refresh rate it is then released together with
+// the previous frame rather than after a wakeup of its own, and the display picks
+// the frame to show by timestamp.
+bool NuPlayer::Renderer::isNextVideoFrameDue() {
+    if (mVideoQueue.empty() || mPaused || !mVideoSampleReceived
+            || (mFlags & FLAG_REAL_TIME) || mVideoScheduler == NULL) {
+        return false;
+    }
+
+    QueueEntry &entry = *mVideoQueue.begin();
+    if (entry.mBuffer == NULL) {
+        return false;
+    }
+
+    int64_t mediaTimeUs;
+    CHECK(entry.mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
+    int64_t nowUs = ALooper::GetNowUs();
+    return getRealTimeUs(mediaTimeUs, nowUs) - nowUs < mVideoScheduler->getVsyncPeriod() / 1000;
+}
+
 void NuPlayer::Renderer::onDrainVideoQueue() {
     if (mVideoQueue.empty()) {
         return;
@@ -1163,7 +1306,7 @@ void NuPlayer::Renderer::onDrainVideoQueue() {
     bool tooLate = false;
 
     if (!mPaused) {
-        setVideoLateByUs(nowUs - realTimeUs);
+        updateVideoLateByUs(nowUs - realTimeUs);
         tooLate = (mVideoLateByUs > 40000);
 
         if (tooLate) {
@@ -1425,6 +1568,7 @@ void NuPlayer::Renderer::onFlush(const sp<AMessage> &msg) {
         }
 
         mDrainAudioQueuePending = false;
+        resetCommonTimeSync();
 
         if (offloadingAudio()) {
             mAudioSink->pause();
@@ -1557,6 +1701,8 @@ void NuPlayer::Renderer::onPause() {
         mMediaClock->setPlaybackRate(0.0);
     }
 
+    resetCommonTimeSync();
+
     mDrainAudioQueuePending = false;
     mDrainVideoQueuePending = false;
     mVideoRenderingStarted = false; // force-notify NOTE_INFO MEDIA_INFO_RENDERING_START after resume
@@ -1603,10 +1749,10 @@ void NuPlayer::Renderer::onResume() {
         }
         // configure audiosink as we did not do it when pausing
         if (mAudioSink != NULL && mAudioSink->ready()) {
-            mAudioSink->setPlaybackRate(mPlaybackSettings);
+            mAudioSink->setPlaybackRate(getTrimmedPlaybackSettings());
         }
 
-        mMediaClock->setPlaybackRate(mPlaybackRate);
+        mMediaClock->setPlaybackRate(mPlaybackRate * mCommonTimeTrim);
 
         if (!mAudioQueue.empty()) {
             postDrainAudioQueue_l();
@@ -1625,6 +1771,208 @@ void NuPlayer::Renderer::onSetVideoFrameRate(float fps) {
     mVideoScheduler->init(fps);
 }
 
+void NuPlayer::Renderer::onGetVideoPacingStats(const sp<AMessage> &stats) {
+    if (mVideoScheduler == NULL) {
+        return;
+    }
+
+    VideoFrameScheduler::PacingStats pacing;
+    mVideoScheduler->getPacingStats(&pacing);
+
+    stats->setFloat("video-frame-rate", pacing.mFrameRate);
+    stats->setFloat("refresh-rate", pacing.mRefreshRate);
+    stats->setFloat("preferred-refresh-rate", pacing.mPreferredRefreshRate);
+    if (pacing.mCadence[0] > 0) {
+        AString cadence = AStringPrintf("%u:%u", pacing.mCadence[0], pacing.mCadence[1]);
+        stats->setString("cadence", cadence.c_str());
+    }
+    stats->setInt64("frames-paced", pacing.mNumFrames);
+    stats->setInt64("frames-judder", pacing.mNumJudderFrames);
+}
+
+void NuPlayer::Renderer::onSetCommonTimeAnchor(int64_t mediaUs, int64_t commonUs) {
+    if (commonUs < 0) {
+        if (mCommonTimeAnchorUs >= 0) {
+            ALOGI("no longer slaved to common time");
+        }
+        mCommonTimeAnchorUs = -1;
+        resetCommonTimeSync();
+        mCommonTimeSkewIntegral = 0.;
+        if (mCommonTimeTrim != 1.f) {
+            applyCommonTimeTrim(1.f);
+        }
+        return;
+    }
+
+    if (offloadingAudio()) {
+        // the offloaded sink does not take the rate trims
+        ALOGW("cannot slave offloaded audio to common time");
+        return;
+    }
+
+    if (mCommonClock == NULL) {
+        mCommonClock = new CCHelper();
+    }
+    ALOGI("presenting media time %lld us at common time %lld us",
+            (long long)mediaUs, (long long)commonUs);
+    mCommonTimeAnchorMediaUs = mediaUs;
+    mCommonTimeAnchorUs = commonUs;
+    resetCommonTimeSync();
+}
+
+// Restarts measuring the skew, e.g. after a flush, and ends any hold.
+void NuPlayer::Renderer::resetCommonTimeSync() {
+    onCommonTimeHoldEnd();
+    ++mCommonTimeSyncGeneration;
+    if (mCommonTimeAnchorUs >= 0) {
+        postCommonTimeSync();
+    }
+}
+
+void NuPlayer::Renderer::postCommonTimeSync(int64_t delayUs) {
+    sp<AMessage> msg = new AMessage(kWhatCommonTimeSync, this);
+    msg->setInt32("generation", mCommonTimeSyncGeneration);
+    msg->post(delayUs);
+}
+
+// Estimates common time minus system time from the sample with the shortest round
+// trip to the common clock service, which then brackets it the most tightly.
+status_t NuPlayer::Renderer::getCommonTimeOffset(int64_t *offsetUs) {
+    int64_t bestRoundTripUs = INT64_MAX;
+    for (int i = 0; i < kCommonTimeOffsetSamples; ++i) {
+        int64_t beforeUs = ALooper::GetNowUs();
+        int64_t commonUs;
+        status_t err = mCommonClock->getCommonTime(&commonUs);
+        if (err != OK) {
+            return err;
+        }
+        int64_t afterUs = ALooper::GetNowUs();
+        if (afterUs - beforeUs < bestRoundTripUs) {
+            bestRoundTripUs = afterUs - beforeUs;
+            *offsetUs = commonUs - (beforeUs + afterUs) / 2;
+        }
+    }
+    return OK;
+}
+
+void NuPlayer::Renderer::onCommonTimeSync() {
+    postCommonTimeSync(kCommonTimeSyncPeriodUs);
+    if (mPaused || mCommonTimeHolding) {
+        return;
+    }
+
+    int64_t offsetUs;
+    if (getCommonTimeOffset(&offsetUs) != OK) {
+        // no common timeline, e.g. until a master is elected
+        mCommonTimeLastSyncUs = -1;
+        return;
+    }
+
+    int64_t nowUs = ALooper::GetNowUs();
+    int64_t mediaUs;
+    if (mMediaClock->getMediaTime(nowUs, &mediaUs) != OK) {
+        return;
+    }
+    const double speed = mPlaybackSettings.mSpeed;
+    const int64_t targetMediaUs = mCommonTimeAnchorMediaUs
+            + (int64_t)((nowUs + offsetUs - mCommonTimeAnchorUs) * speed);
+    // in real time, positive when playing out early
+    const int64_t skewUs = (int64_t)((mediaUs - targetMediaUs) / speed);
+    if (mPlayerStats != NULL) {
+        mPlayerStats->addSyncSkew(skewUs, mCommonTimeTrim);
+    }
+
+    if (!mHasAudio) {
+        // video only follows the media clock, which can be moved onto the common timeline
+        if (skewUs > kCommonTimeMaxVideoSkewUs || skewUs < -kCommonTimeMaxVideoSkewUs) {
+            mMediaClock->updateAnchor(targetMediaUs, nowUs);
+            if (mPlayerStats != NULL) {
+                mPlayerStats->addSyncCorrection();
+            }
+        }
+        return;
+    }
+
+    if (skewUs > kCommonTimeHoldSkewUs) {
+        // e.g. when starting ahead of the anchor, too far ahead for trimming the rate
+        ALOGV("holding audio for %lld us to meet common time", (long long)skewUs);
+        mCommonTimeHolding = true;
+        mAudioSink->pause();
+        mMediaClock->setPlaybackRate(0.0);
+        sp<AMessage> msg = new AMessage(kWhatCommonTimeHoldEnd, this);
+        msg->setInt32("generation", mCommonTimeSyncGeneration);
+        msg->post(skewUs);
+        if (mPlayerStats != NULL) {
+            mPlayerStats->addSyncHold(skewUs);
+        }
+        return;
+    }
+
+    const double dtUs =
+            mCommonTimeLastSyncUs < 0 ? 0. : (double)(nowUs - mCommonTimeLastSyncUs);
+    mCommonTimeLastSyncUs = nowUs;
+    const double integral = mCommonTimeSkewIntegral + skewUs * dtUs;
+    double trim = 1. - kCommonTimeSkewGain * skewUs - kCommonTimeSkewIntegralGain * integral;
+    if (trim > 1. + kCommonTimeMaxTrim) {
+        trim = 1. + kCommonTimeMaxTrim;
+    } else if (trim < 1. - kCommonTimeMaxTrim) {
+        trim = 1. - kCommonTimeMaxTrim;
+    } else {
+        // do not wind up while saturated, e.g. when catching up from far behind
+        mCommonTimeSkewIntegral = integral;
+    }
+
+    // smaller changes are not taken by the audio track
+    if (fabs(trim - mCommonTimeTrim) < AUDIO_TIMESTRETCH_PITCH_MIN_DELTA) {
+        return;
+    }
+    ALOGV("common time skew %lld us, trim %.6f", (long long)skewUs, trim);
+    if (applyCommonTimeTrim((float)trim) != OK) {
+        ALOGW("audio sink does not take rate trims, no longer slaved to common time");
+        mCommonTimeAnchorUs = -1;
+        ++mCommonTimeSyncGeneration;
+    }
+}
+
+void NuPlayer::Renderer::onCommonTimeHoldEnd() {
+    if (!mCommonTimeHolding) {
+        return;
+    }
+    mCommonTimeHolding = false;
+    mCommonTimeLastSyncUs = -1;
+    if (!mPaused) {
+        mAudioSink->start();
+        mMediaClock->setPlaybackRate(mPlaybackRate * mCommonTimeTrim);
+    }
+}
+
+status_t NuPlayer::Renderer::applyCommonTimeTrim(float trim) {
+    const float oldTrim = mCommonTimeTrim;
+    mCommonTimeTrim = trim;
+    if (mAudioSink != NULL && mAudioSink->ready()) {
+        // trimming the pitch as well resamples, rather than time stretches
+        status_t err = mAudioSink->setPlaybackRate(getTrimmedPlaybackSettings());
+        if (err != OK) {
+            mCommonTimeTrim = oldTrim;
+            return err;
+        }
+    }
+    if (!mPaused && !mCommonTimeHolding) {
+        mMediaClock->setPlaybackRate(mPlaybackRate * mCommonTimeTrim);
+    }
+    if (mPlayerStats != NULL) {
+        mPlayerStats->addSyncCorrection();
+    }
+    return OK;
+}
+
+AudioPlaybackRate NuPlayer::Renderer::getTrimmedPlaybackSettings() const {
+    AudioPlaybackRate rate = mPlaybackSettings;
+    rate.mSpeed *= mCommonTimeTrim;
+    rate.mPitch *= mCommonTimeTrim;
+    return rate;
+}
+
 int32_t NuPlayer::Renderer::getQueueGeneration(bool audio) {
     Mutex::Autolock autoLock(mLock);
     return (audio ? mAudioQueueGeneration : mVideoQueueGeneration);
@@ -1860,7 +2208,7 @@ status_t NuPlayer::Renderer::onOpenAudioSink(
                     &offloadInfo);
 
             if (err == OK) {
-                err = mAudioSink->setPlaybackRate(mPlaybackSettings);
+                err = mAudioSink->setPlaybackRate(getTrimmedPlaybackSettings());
             }
 
             if (err == OK) {
@@ -1941,7 +2289,7 @@ status_t NuPlayer::Renderer::onOpenAudioSink(
                     doNotReconnect,
                     frameCount);
         if (err == OK) {
-            err = mAudioSink->setPlaybackRate(mPlaybackSettings);
+            err = mAudioSink->setPlaybackRate(getTrimmedPlaybackSettings());
         }
         if (err != OK) {
             ALOGW("openAudioSink: non offloaded open failed status: %d", err);
@@ -27,7 +27,9 @@ namespace android {
 
 struct ABuffer;
 class  AWakeLock;
+class  CCHelper;
 struct MediaClock;
+struct NuPlayerStats;
 struct VideoFrameScheduler;
 
 struct NuPlayer::Renderer : public AHandler {
@@ -71,7 +73,21 @@ struct NuPlayer::Renderer : public AHandler {
     void setVideoFrameRate(float fps);
 
     status_t getCurrentPosition(int64_t *mediaUs);
+    // Duration of the content the audio sink buffers, or -1 if unknown.
+    int64_t getAudioSinkBufferDurationUs() const;
     int64_t getVideoLateByUs();
+    // How late video frames that are about to be decoded are expected to be,
+    // based on how the lateness of the rendered frames is trending.
+    int64_t getPredictedVideoLateByUs();
+    // Adds the frame pacing statistics of the video scheduler to stats.
+    void getVideoPacingStats(const sp<AMessage> &stats);
+    // Must be called before any buffer is queued.
+    void setPlayerStats(const sp<NuPlayerStats> &stats);
+
+    // Slaves audio to the common time service: media time |mediaUs| is played out at
+    // common time |commonUs|, and the audio sink rate is trimmed to keep it so.
+    // A negative |commonUs| returns to free running playback.
+    void setCommonTimeAnchor(int64_t mediaUs, int64_t commonUs);
 
     virtual audio_stream_type_t getAudioStreamType(){return AUDIO_STREAM_DEFAULT;}
 
@@ -125,6 +141,10 @@ protected:
         kWhatDisableOffloadAudio = 'noOA',
         kWhatEnableOffloadAudio  = 'enOA',
         kWhatSetVideoFrameRate   = 'sVFR',
+        kWhatGetVideoPacingStats = 'gVPS',
+        kWhatSetCommonTimeAnchor = 'sCTA',
+        kWhatCommonTimeSync      = 'cTSy',
+        kWhatCommonTimeHoldEnd   = 'cTHE',
     };
 
     struct QueueEntry {
@@ -164,6 +184,7 @@ protected:
     int64_t mAnchorTimeMediaUs;
     int64_t mAnchorNumFramesWritten;
     int64_t mVideoLateByUs;
+    int64_t mVideoLateTrendUs; // average change of mVideoLateByUs per frame
     bool mHasAudio;
     bool mHasVideo;
     bool mFoundAudioEOS;
@@ -205,6 +226,18 @@ protected:
 
     sp<AWakeLock> mWakeLock;
 
+    sp<NuPlayerStats> mPlayerStats;
+
+    // Common time sync, modified on only renderer's thread.
+    CCHelper *mCommonClock;
+    int64_t mCommonTimeAnchorMediaUs;
+    int64_t mCommonTimeAnchorUs;       // -1 unless slaved to common time
+    int32_t mCommonTimeSyncGeneration;
+    int64_t mCommonTimeLastSyncUs;     // -1 until the skew is measured
+    double mCommonTimeSkewIntegral;    // of the skew over time, in us^2
+    float mCommonTimeTrim;             // factor on the audio sink rate
+    bool mCommonTimeHolding;           // audio sink paused to let common time catch up
+
     status_t getCurrentPositionOnLooper(int64_t *mediaUs);
     status_t getCurrentPositionOnLooper(
             int64_t *mediaUs, int64_t nowUs, bool allowPastQueuedVideo = false);
@@ -215,6 +248,7 @@ protected:
     size_t fillAudioBuffer(void *buffer, size_t size);
 
     bool onDrainAudioQueue();
+    void onAudioFramesWritten();
     void drainAudioQueueUntilLastEOS();
     int64_t getPendingAudioPlayoutDurationUs(int64_t nowUs);
     int64_t getPlayedOutAudioDurationUs(int64_t nowUs);
@@ -224,11 +258,13 @@ protected:
     void clearAudioFirstAnchorTime_l();
     void setAudioFirstAnchorTimeIfNeeded_l(int64_t mediaUs);
     void setVideoLateByUs(int64_t lateUs);
+    void updateVideoLateByUs(int64_t lateUs);
 
     void onNewAudioMediaTime(int64_t mediaTimeUs);
     int64_t getRealTimeUs(int64_t mediaTimeUs, int64_t nowUs);
 
     void onDrainVideoQueue();
+    bool isNextVideoFrameDue();
     void postDrainVideoQueue();
 
     void prepareForMediaRenderingStart_l();
@@ -248,6 +284,15 @@ protected:
     void onPause();
     void onResume();
     void onSetVideoFrameRate(float fps);
+    void onGetVideoPacingStats(const sp<AMessage> &stats);
+    void onSetCommonTimeAnchor(int64_t mediaUs, int64_t commonUs);
+    void onCommonTimeSync();
+    void onCommonTimeHoldEnd();
+    void postCommonTimeSync(int64_t delayUs = 0);
+    void resetCommonTimeSync();
+    status_t getCommonTimeOffset(int64_t *offsetUs);
+    status_t applyCommonTimeTrim(float trim);
+    AudioPlaybackRate getTrimmedPlaybackSettings() const;
     int32_t getQueueGeneration(bool audio);
     int32_t getDrainGeneration(bool audio);
     bool getSyncQueues();
@@ -59,6 +59,7 @@ struct NuPlayer::Source : public AHandler {
         kWhatDrmNoLicense,
         kWhatInstantiateSecureDecoders,
         kWhatRTCPByeReceived,
+        kWhatFormatsReady,
     };
 
     // The provides message is used to notify the player about various
@@ -134,6 +135,8 @@ protected:
     void notifyFlagsChanged(uint32_t flags);
     void notifyVideoSizeChanged(const sp<AMessage> &format = NULL);
     void notifyInstantiateSecureDecoders(const sp<AMessage> &reply);
+    // The track formats are known, but the source is still preparing.
+    void notifyFormatsReady();
     virtual void notifyPrepared(status_t err = OK);
 
     sp<AMessage> mNotify;
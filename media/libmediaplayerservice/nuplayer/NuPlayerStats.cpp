@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NuPlayerStats"
+#include <utils/Log.h>
+
+#include "NuPlayerStats.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <binder/Parcel.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/String16.h>
+
+namespace android {
+
+static const char *kTrackNames[NuPlayerStats::NUM_TRACKS] = { "audio", "video" };
+static const char *kStageNames[NuPlayerStats::NUM_STAGES] = { "read", "decode", "render" };
+
+NuPlayerStats::Histogram::Histogram()
+    : mCount(0),
+      mSumUs(0),
+      mMaxUs(0) {
+    memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+void NuPlayerStats::Histogram::add(int64_t latencyUs) {
+    if (latencyUs < 0) {
+        latencyUs = 0;
+    }
+    ++mCount;
+    mSumUs += latencyUs;
+    if (latencyUs > mMaxUs) {
+        mMaxUs = latencyUs;
+    }
+    ++mBuckets[bucketOf(latencyUs)];
+}
+
+int64_t NuPlayerStats::Histogram::percentileUs(int percent) const {
+    if (mCount == 0) {
+        return 0;
+    }
+    int64_t target = (mCount * percent + 99) / 100;
+    int64_t seen = 0;
+    for (size_t i = 0; i < kNumLatencyBuckets; ++i) {
+        seen += mBuckets[i];
+        if (seen >= target) {
+            int64_t boundUs = bucketUpperBoundUs(i);
+            return boundUs < mMaxUs ? boundUs : mMaxUs;
+        }
+    }
+    return mMaxUs;
+}
+
+NuPlayerStats::TrackStats::TrackStats()
+    : mBytesRead(0),
+      mQueueDepthSamples(0),
+      mQueueDepthSum(0),
+      mQueueDepthMax(0),
+      mFramesDropped(0),
+      mFramesLate(0) {
+}
+
+NuPlayerStats::NuPlayerStats()
+    : mAudioUnderrunFrames(0),
+      mRebufferCount(0),
+      mRebufferTotalUs(0),
+      mRebufferMaxUs(0),
+      mRebufferStartUs(-1),
+      mSyncLastSkewUs(0),
+      mSyncTrimPpm(0),
+      mSyncTrimMaxPpm(0),
+      mSyncCorrections(0),
+      mSyncHolds(0),
+      mSyncHoldTotalUs(0) {
+}
+
+NuPlayerStats::~NuPlayerStats() {
+}
+
+// static
+size_t NuPlayerStats::bucketOf(int64_t latencyUs) {
+    if (latencyUs > kMaxLatencyUs) {
+        latencyUs = kMaxLatencyUs;
+    }
+    if (latencyUs < 4) {
+        return latencyUs;
+    }
+    int msb = 63 - __builtin_clzll(latencyUs);
+    return 4 * (msb - 1) + ((latencyUs >> (msb - 2)) & 3);
+}
+
+// static
+int64_t NuPlayerStats::bucketUpperBoundUs(size_t bucket) {
+    if (bucket < 4) {
+        return bucket + 1;
+    }
+    int msb = bucket / 4 + 1;
+    return (int64_t)(5 + bucket % 4) << (msb - 2);
+}
+
+void NuPlayerStats::reset() {
+    Mutex::Autolock autoLock(mLock);
+    for (size_t i = 0; i < NUM_TRACKS; ++i) {
+        mTracks[i] = TrackStats();
+    }
+    mAudioUnderrunFrames = 0;
+    mRebufferCount = 0;
+    mRebufferTotalUs = 0;
+    mRebufferMaxUs = 0;
+    mRebufferStartUs = -1;
+    mSyncSkew = Histogram();
+    mSyncLastSkewUs = 0;
+    mSyncTrimPpm = 0;
+    mSyncTrimMaxPpm = 0;
+    mSyncCorrections = 0;
+    mSyncHolds = 0;
+    mSyncHoldTotalUs = 0;
+}
+
+void NuPlayerStats::addLatency(Track track, Stage stage, int64_t latencyUs) {
+    Mutex::Autolock autoLock(mLock);
+    mTracks[track].mLatency[stage].add(latencyUs);
+}
+
+void NuPlayerStats::addBytesRead(Track track, size_t bytes) {
+    Mutex::Autolock autoLock(mLock);
+    mTracks[track].mBytesRead += bytes;
+}
+
+void NuPlayerStats::addCodecQueueDepth(Track track, size_t depth) {
+    Mutex::Autolock autoLock(mLock);
+    TrackStats &stats = mTracks[track];
+    ++stats.mQueueDepthSamples;
+    stats.mQueueDepthSum += depth;
+    if ((int64_t)depth > stats.mQueueDepthMax) {
+        stats.mQueueDepthMax = depth;
+    }
+}
+
+void NuPlayerStats::addDroppedFrames(Track track, size_t count) {
+    Mutex::Autolock autoLock(mLock);
+    mTracks[track].mFramesDropped += count;
+}
+
+void NuPlayerStats::addLateFrame(Track track) {
+    Mutex::Autolock autoLock(mLock);
+    ++mTracks[track].mFramesLate;
+}
+
+void NuPlayerStats::setAudioUnderrunFrames(uint32_t frames) {
+    Mutex::Autolock autoLock(mLock);
+    mAudioUnderrunFrames = frames;
+}
+
+void NuPlayerStats::onRebufferingStart(int64_t nowUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (mRebufferStartUs < 0) {
+        ++mRebufferCount;
+        mRebufferStartUs = nowUs;
+    }
+}
+
+void NuPlayerStats::onRebufferingEnd(int64_t nowUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (mRebufferStartUs >= 0) {
+        int64_t durationUs = nowUs - mRebufferStartUs;
+        mRebufferTotalUs += durationUs;
+        if (durationUs > mRebufferMaxUs) {
+            mRebufferMaxUs = durationUs;
+        }
+        mRebufferStartUs = -1;
+    }
+}
+
+void NuPlayerStats::addSyncSkew(int64_t skewUs, float trim) {
+    Mutex::Autolock autoLock(mLock);
+    mSyncSkew.add(skewUs < 0 ? -skewUs : skewUs);
+    mSyncLastSkewUs = skewUs;
+    mSyncTrimPpm = (int32_t)lrintf((trim - 1.f) * 1E6);
+    int32_t trimPpm = mSyncTrimPpm < 0 ? -mSyncTrimPpm : mSyncTrimPpm;
+    if (trimPpm > mSyncTrimMaxPpm) {
+        mSyncTrimMaxPpm = trimPpm;
+    }
+}
+
+void NuPlayerStats::addSyncCorrection() {
+    Mutex::Autolock autoLock(mLock);
+    ++mSyncCorrections;
+}
+
+void NuPlayerStats::addSyncHold(int64_t durationUs) {
+    Mutex::Autolock autoLock(mLock);
+    ++mSyncHolds;
+    mSyncHoldTotalUs += durationUs;
+}
+
+void NuPlayerStats::dump(AString *out) const {
+    Mutex::Autolock autoLock(mLock);
+
+    out->append(AStringPrintf(
+            "  rebuffering(%lld times, total %.1f ms, max %.1f ms%s), "
+            "audio underrun frames(%lld)\n",
+            (long long)mRebufferCount, mRebufferTotalUs / 1E3, mRebufferMaxUs / 1E3,
+            mRebufferStartUs >= 0 ? ", now" : "", (long long)mAudioUnderrunFrames));
+
+    if (mSyncSkew.mCount > 0) {
+        out->append(AStringPrintf(
+                "  common time skew(us): count %lld, p50 %lld, p90 %lld, p99 %lld, "
+                "max %lld, last %lld; trim %d ppm (max %d), corrections %lld, "
+                "holds %lld (total %.1f ms)\n",
+                (long long)mSyncSkew.mCount, (long long)mSyncSkew.percentileUs(50),
+                (long long)mSyncSkew.percentileUs(90), (long long)mSyncSkew.percentileUs(99),
+                (long long)mSyncSkew.mMaxUs, (long long)mSyncLastSkewUs,
+                mSyncTrimPpm, mSyncTrimMaxPpm, (long long)mSyncCorrections,
+                (long long)mSyncHolds, mSyncHoldTotalUs / 1E3));
+    }
+
+    for (size_t i = 0; i < NUM_TRACKS; ++i) {
+        const TrackStats &stats = mTracks[i];
+        out->append(AStringPrintf(
+                "  %s: read %lld bytes, dropped %lld, late %lld, "
+                "codec queue avg %.1f max %lld\n",
+                kTrackNames[i], (long long)stats.mBytesRead,
+                (long long)stats.mFramesDropped, (long long)stats.mFramesLate,
+                stats.mQueueDepthSamples > 0
+                        ? (double)stats.mQueueDepthSum / stats.mQueueDepthSamples : 0.,
+                (long long)stats.mQueueDepthMax));
+        for (size_t j = 0; j < NUM_STAGES; ++j) {
+            const Histogram &h = stats.mLatency[j];
+            if (h.mCount == 0) {
+                continue;
+            }
+            out->append(AStringPrintf(
+                    "    %-6s latency(us): count %lld, avg %lld, "
+                    "p50 %lld, p90 %lld, p99 %lld, max %lld\n",
+                    kStageNames[j], (long long)h.mCount, (long long)(h.mSumUs / h.mCount),
+                    (long long)h.percentileUs(50), (long long)h.percentileUs(90),
+                    (long long)h.percentileUs(99), (long long)h.mMaxUs));
+        }
+    }
+}
+
+static void writeMetric(Parcel *parcel, const AString &name, const int64_t *values, size_t n) {
+    parcel->writeString16(String16(name.c_str()));
+    parcel->writeInt32(n);
+    for (size_t i = 0; i < n; ++i) {
+        parcel->writeInt64(values[i]);
+    }
+}
+
+static void writeMetric(Parcel *parcel, const AString &name, int64_t value) {
+    writeMetric(parcel, name, &value, 1);
+}
+
+void NuPlayerStats::writeToParcel(Parcel *parcel) const {
+    Mutex::Autolock autoLock(mLock);
+
+    static const size_t kMetricsPerTrack = 6;
+    static const size_t kMetricsPerStage = 4;
+    static const size_t kNumMetrics = 13
+            + NUM_TRACKS * (kMetricsPerTrack + NUM_STAGES * kMetricsPerStage);
+
+    parcel->writeInt32(kNumMetrics);
+
+    int64_t bounds[kNumLatencyBuckets];
+    for (size_t i = 0; i < kNumLatencyBuckets; ++i) {
+        bounds[i] = bucketUpperBoundUs(i);
+    }
+    writeMetric(parcel, AString("latency-bounds-us"), bounds, kNumLatencyBuckets);
+
+    writeMetric(parcel, AString("rebuffer-count"), mRebufferCount);
+    writeMetric(parcel, AString("rebuffer-total-us"), mRebufferTotalUs);
+    writeMetric(parcel, AString("rebuffer-max-us"), mRebufferMaxUs);
+    writeMetric(parcel, AString("audio-underrun-frames"), mAudioUnderrunFrames);
+
+    writeMetric(parcel, AString("sync-skew-count"), mSyncSkew.mCount);
+    writeMetric(parcel, AString("sync-skew-max-us"), mSyncSkew.mMaxUs);
+    writeMetric(parcel, AString("sync-skew-last-us"), mSyncLastSkewUs);
+    writeMetric(parcel, AString("sync-skew-histogram"), mSyncSkew.mBuckets, kNumLatencyBuckets);
+    writeMetric(parcel, AString("sync-trim-ppm"), mSyncTrimPpm);
+    writeMetric(parcel, AString("sync-corrections"), mSyncCorrections);
+    writeMetric(parcel, AString("sync-holds"), mSyncHolds);
+    writeMetric(parcel, AString("sync-hold-total-us"), mSyncHoldTotalUs);
+
+    for (size_t i = 0; i < NUM_TRACKS; ++i) {
+        const TrackStats &stats = mTracks[i];
+        AString prefix = AStringPrintf("%s-", kTrackNames[i]);
+        writeMetric(parcel, AStringPrintf("%sbytes-read", prefix.c_str()), stats.mBytesRead);
+        writeMetric(parcel, AStringPrintf("%sframes-dropped", prefix.c_str()),
+                stats.mFramesDropped);
+        writeMetric(parcel, AStringPrintf("%sframes-late", prefix.c_str()), stats.mFramesLate);
+        writeMetric(parcel, AStringPrintf("%scodec-queue-samples", prefix.c_str()),
+                stats.mQueueDepthSamples);
+        writeMetric(parcel, AStringPrintf("%scodec-queue-sum", prefix.c_str()),
+                stats.mQueueDepthSum);
+        writeMetric(parcel, AStringPrintf("%scodec-queue-max", prefix.c_str()),
+                stats.mQueueDepthMax);
+
+        for (size_t j = 0; j < NUM_STAGES; ++j) {
+            const Histogram &h = stats.mLatency[j];
+            AString name = AStringPrintf("%s%s-latency", prefix.c_str(), kStageNames[j]);
+            writeMetric(parcel, AStringPrintf("%s-count", name.c_str()), h.mCount);
+            writeMetric(parcel, AStringPrintf("%s-sum-us", name.c_str()), h.mSumUs);
+            writeMetric(parcel, AStringPrintf("%s-max-us", name.c_str()), h.mMaxUs);
+            writeMetric(parcel, AStringPrintf("%s-histogram", name.c_str()),
+                    h.mBuckets, kNumLatencyBuckets);
+        }
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NUPLAYER_STATS_H_
+
+#define NUPLAYER_STATS_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+struct AString;
+class Parcel;
+
+// Playback statistics that the NuPlayer source, decoders and renderer report
+// into while playing, dumped by "dumpsys media.player" and returned by
+// IMediaPlayer::getMetrics(). Every report is O(1) and takes one short lock.
+struct NuPlayerStats : public RefBase {
+    enum Track {
+        TRACK_AUDIO,
+        TRACK_VIDEO,
+        NUM_TRACKS,
+    };
+
+    enum Stage {
+        STAGE_SOURCE_READ,  // dequeueing an access unit from the source
+        STAGE_DECODE,       // queueing an input buffer to its output buffer
+        STAGE_RENDER,       // queueing a decoded buffer to the renderer to its release
+        NUM_STAGES,
+    };
+
+    // Latencies are kept in 4 buckets per power of 2 microseconds, i.e.
+    // within 25%, and longer ones than kMaxLatencyUs (about 33s) in the last.
+    static const size_t kNumLatencyBuckets = 96;
+    static const int64_t kMaxLatencyUs = (1ll << 25) - 1;
+
+    NuPlayerStats();
+
+    void reset();
+
+    void addLatency(Track track, Stage stage, int64_t latencyUs);
+    void addBytesRead(Track track, size_t bytes);
+    // number of input buffers held by the codec after queueing one
+    void addCodecQueueDepth(Track track, size_t depth);
+    void addDroppedFrames(Track track, size_t count);
+    void addLateFrame(Track track);
+    // frames the audio sink has played as silence for lack of data
+    void setAudioUnderrunFrames(uint32_t frames);
+
+    void onRebufferingStart(int64_t nowUs);
+    void onRebufferingEnd(int64_t nowUs);
+
+    // Common time sync: the measured skew from the common timeline, positive
+    // when playing early, and the rate trim the renderer applies against it.
+    void addSyncSkew(int64_t skewUs, float trim);
+    void addSyncCorrection();
+    // audio held back to catch up with the common timeline at once
+    void addSyncHold(int64_t durationUs);
+
+    void dump(AString *out) const;
+
+    // Writes the number of metrics, then for each its name as a String16,
+    // its number of values as an int32 and the values as int64s. The
+    // exclusive upper bound of each histogram bucket is "latency-bounds-us".
+    void writeToParcel(Parcel *parcel) const;
+
+protected:
+    virtual ~NuPlayerStats();
+
+private:
+    struct Histogram {
+        int64_t mCount;
+        int64_t mSumUs;
+        int64_t mMaxUs;
+        int64_t mBuckets[kNumLatencyBuckets];
+        Histogram();
+        void add(int64_t latencyUs);
+        int64_t percentileUs(int percent) const;
+    };
+
+    struct TrackStats {
+        Histogram mLatency[NUM_STAGES];
+        int64_t mBytesRead;
+        int64_t mQueueDepthSamples;
+        int64_t mQueueDepthSum;
+        int64_t mQueueDepthMax;
+        int64_t mFramesDropped;
+        int64_t mFramesLate;
+        TrackStats();
+    };
+
+    mutable Mutex mLock;
+    TrackStats mTracks[NUM_TRACKS];
+    int64_t mAudioUnderrunFrames;
+    int64_t mRebufferCount;
+    int64_t mRebufferTotalUs;
+    int64_t mRebufferMaxUs;
+    int64_t mRebufferStartUs;   // -1 unless rebuffering
+    Histogram mSyncSkew;        // of the absolute skew
+    int64_t mSyncLastSkewUs;
+    int32_t mSyncTrimPpm;
+    int32_t mSyncTrimMaxPpm;    // of the absolute trim
+    int64_t mSyncCorrections;
+    int64_t mSyncHolds;
+    int64_t mSyncHoldTotalUs;
+
+    static size_t bucketOf(int64_t latencyUs);
+    static int64_t bucketUpperBoundUs(size_t bucket);
+
+    DISALLOW_EVIL_CONSTRUCTORS(NuPlayerStats);
+};
+
+}  // namespace android
+
+#endif  // NUPLAYER_STATS_H_
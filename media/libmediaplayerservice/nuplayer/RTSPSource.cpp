@@ -22,6 +22,7 @@
 
 #include "AnotherPacketSource.h"
 #include "MyHandler.h"
+#include "avc_utils.h"
 #include "SDPLoader.h"
 
 #include <cutils/properties.h>
@@ -35,6 +36,23 @@ namespace android {
 const int64_t kNearEOSTimeoutUs = 2000000ll; // 2 secs
 const uint32_t kMaxNumKeepDamagedAccessUnits = 30;
 
+// Low-latency live mode, selected by the "x-rtsp-low-latency: 1" header or
+// by appending kLowLatencyURLSuffix to an rtsp:// url.
+static const char kLowLatencyHeader[] = "x-rtsp-low-latency";
+static const char kLowLatencyURLSuffix[] = "#low-latency";
+
+// The jitter buffer: a video access unit is due this long after the arrival
+// of its RTP time.
+const int64_t kLivePlayoutDelayUs = 50000ll;
+// Video running later than the playout delay by more than this is played
+// up to a third faster until it has caught up...
+const int64_t kLiveCatchUpThresholdUs = 20000ll;
+// ...unless it is this far behind, then H.264 skips to the next IDR.
+const int64_t kLiveMaxExcessLatencyUs = 300000ll;
+// Audio isn't timed by the renderer in this mode, its latency is the depth
+// of the queue.
+const int64_t kLiveMaxAudioQueueUs = 200000ll;
+
 NuPlayer::RTSPSource::RTSPSource(
         const sp<AMessage> &notify,
         const sp<IMediaHTTPService> &httpService,
@@ -71,6 +89,28 @@ NuPlayer::RTSPSource::RTSPSource(
 
             mExtraHeaders.removeItemsAt(index);
         }
+
+        index = mExtraHeaders.indexOfKey(String8(kLowLatencyHeader));
+
+        if (index >= 0) {
+            const String8 &value = mExtraHeaders.valueAt(index);
+            if (value == "1" || !strcasecmp(value.string(), "true")) {
+                mFlags |= kFlagLowLatency;
+            }
+
+            mExtraHeaders.removeItemsAt(index);
+        }
+    }
+
+    if (!isSDP && mURL.endsWith(kLowLatencyURLSuffix)) {
+        mFlags |= kFlagLowLatency;
+
+        size_t suffixLength = strlen(kLowLatencyURLSuffix);
+        mURL.erase(mURL.size() - suffixLength, suffixLength);
+    }
+
+    if (mFlags & kFlagLowLatency) {
+        ALOGI("low-latency live mode");
     }
 }
 
@@ -106,7 +146,8 @@ void NuPlayer::RTSPSource::prepareAsync() {
         mSDPLoader->load(
                 mURL.c_str(), mExtraHeaders.isEmpty() ? NULL : &mExtraHeaders);
     } else {
-        mHandler = new MyHandler(mURL.c_str(), notify, mUIDValid, mUID);
+        mHandler = new MyHandler(
+                mURL.c_str(), notify, mUIDValid, mUID, handlerFlags());
         mLooper->registerHandler(mHandler);
 
         mHandler->connect();
@@ -261,9 +302,86 @@ status_t NuPlayer::RTSPSource::dequeueAccessUnit(
 
     setEOSTimeout(audio, 0);
 
+    if (audio && isRealTime()) {
+        // Drop the oldest audio to keep pace with the video.
+        while (source->getBufferedDurationUs(&finalResult)
+                > kLiveMaxAudioQueueUs) {
+            status_t err = source->dequeueAccessUnit(accessUnit);
+            if (err != OK) {
+                return err;
+            }
+            ALOGV("dropping late audio access unit");
+        }
+    }
+
     return source->dequeueAccessUnit(accessUnit);
 }
 
+bool NuPlayer::RTSPSource::isRealTime() const {
+    // The transport stream carries its own timestamps.
+    return (mFlags & kFlagLowLatency) && mTSParser == NULL;
+}
+
+uint32_t NuPlayer::RTSPSource::handlerFlags() const {
+    return (mFlags & kFlagLowLatency) ? MyHandler::kFlagLowLatency : 0;
+}
+
+// In low-latency mode the video timestamps are real (system) times, which the
+// renderer follows as they are. Each access unit is due kLivePlayoutDelayUs
+// after the arrival of its RTP time, as mapped by the first access unit; a
+// later arrival moves the mapping forward, and a backlog is worked off by
+// bringing it back, a little per frame. Returns false to drop the access unit.
+bool NuPlayer::RTSPSource::setLiveVideoTime(
+        TrackInfo *info, const sp<ABuffer> &accessUnit) {
+    if (info->mWaitForIDR) {
+        if (!IsIDR(accessUnit)) {
+            ALOGV("dropping video access unit, waiting for an IDR");
+            return false;
+        }
+
+        info->mWaitForIDR = false;
+        info->mLiveTimeValid = false;
+    }
+
+    uint32_t rtpTime;
+    CHECK(accessUnit->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
+
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (!info->mLiveTimeValid) {
+        info->mLiveTimeValid = true;
+        info->mLiveRTPTime = rtpTime;
+        info->mLiveRealTimeUs = nowUs + kLivePlayoutDelayUs;
+    }
+
+    // Relative to the previous access unit, so that RTP time wraps around.
+    int64_t deltaUs =
+        (int64_t)(int32_t)(rtpTime - info->mLiveRTPTime) * 1000000ll
+            / info->mTimeScale;
+
+    int64_t realTimeUs = info->mLiveRealTimeUs + deltaUs;
+    int64_t excessUs = realTimeUs - nowUs - kLivePlayoutDelayUs;
+
+    if (realTimeUs < nowUs) {
+        realTimeUs = nowUs + kLivePlayoutDelayUs;
+    } else if (excessUs > kLiveMaxExcessLatencyUs && info->mIsAVC) {
+        ALOGI("video is %lld us behind, skipping to the next IDR",
+              (long long)excessUs);
+
+        info->mWaitForIDR = true;
+        return false;
+    } else if (excessUs > kLiveCatchUpThresholdUs && deltaUs > 0) {
+        realTimeUs -= (excessUs < deltaUs / 4) ? excessUs : deltaUs / 4;
+    }
+
+    info->mLiveRTPTime = rtpTime;
+    info->mLiveRealTimeUs = realTimeUs;
+
+    accessUnit->meta()->setInt64("timeUs", realTimeUs);
+
+    return true;
+}
+
 sp<AnotherPacketSource> NuPlayer::RTSPSource::getSource(bool audio) {
     if (mTSParser != NULL) {
         sp<MediaSource> source = mTSParser->getSource(
@@ -490,6 +608,13 @@ void NuPlayer::RTSPSource::onMessageReceived(const sp<AMessage> &msg) {
             TrackInfo *info = &mTracks.editItemAt(trackIndex);
 
             sp<AnotherPacketSource> source = info->mSource;
+            if (source != NULL && source == mVideoTrack && isRealTime()) {
+                if (setLiveVideoTime(info, accessUnit)) {
+                    source->queueAccessUnit(accessUnit);
+                }
+                break;
+            }
+
             if (source != NULL) {
                 uint32_t rtpTime;
                 CHECK(accessUnit->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
@@ -644,6 +769,12 @@ void NuPlayer::RTSPSource::onConnected() {
         info.mRTPTime = 0;
         info.mNormalPlaytimeUs = 0ll;
         info.mNPTMappingValid = false;
+        info.mIsAVC = !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC);
+        // Decoding starts on an IDR, there is nothing to show before it.
+        info.mWaitForIDR = info.mIsAVC && (mFlags & kFlagLowLatency);
+        info.mLiveTimeValid = false;
+        info.mLiveRTPTime = 0;
+        info.mLiveRealTimeUs = 0ll;
 
         if ((isAudio && mAudioTrack == NULL)
                 || (isVideo && mVideoTrack == NULL)) {
@@ -687,7 +818,8 @@ void NuPlayer::RTSPSource::onSDPLoaded(const sp<AMessage> &msg) {
         } else {
             sp<AMessage> notify = new AMessage(kWhatNotify, this);
 
-            mHandler = new MyHandler(rtspUri.c_str(), notify, mUIDValid, mUID);
+            mHandler = new MyHandler(
+                    rtspUri.c_str(), notify, mUIDValid, mUID, handlerFlags());
             mLooper->registerHandler(mHandler);
 
             mHandler->loadSDP(desc);
@@ -756,6 +888,12 @@ void NuPlayer::RTSPSource::setError(status_t err) {
 }
 
 void NuPlayer::RTSPSource::startBufferingIfNecessary() {
+    if (mFlags & kFlagLowLatency) {
+        // Playback starts with the first access unit and never pauses to
+        // refill, a stall is better than added latency.
+        return;
+    }
+
     Mutex::Autolock _l(mBufferingLock);
 
     if (!mBuffering) {
@@ -53,6 +53,8 @@ struct NuPlayer::RTSPSource : public NuPlayer::Source {
     virtual status_t getDuration(int64_t *durationUs);
     virtual status_t seekTo(int64_t seekTimeUs);
 
+    virtual bool isRealTime() const;
+
     void onMessageReceived(const sp<AMessage> &msg);
 
 protected:
@@ -77,6 +79,8 @@ private:
     enum Flags {
         // Don't log any URLs.
         kFlagIncognito = 1,
+        // Live viewing at minimal latency, see setLiveVideoTime().
+        kFlagLowLatency = 2,
     };
 
     struct TrackInfo {
@@ -86,6 +90,13 @@ private:
         uint32_t mRTPTime;
         int64_t mNormalPlaytimeUs;
         bool mNPTMappingValid;
+
+        // Low-latency mode only.
+        bool mIsAVC;
+        bool mWaitForIDR;
+        bool mLiveTimeValid;
+        uint32_t mLiveRTPTime;
+        int64_t mLiveRealTimeUs;
     };
 
     sp<IMediaHTTPService> mHTTPService;
@@ -124,6 +135,9 @@ private:
 
     sp<AnotherPacketSource> getSource(bool audio);
 
+    uint32_t handlerFlags() const;
+    bool setLiveVideoTime(TrackInfo *info, const sp<ABuffer> &accessUnit);
+
     void onConnected();
     void onSDPLoaded(const sp<AMessage> &msg);
     void onDisconnected(const sp<AMessage> &msg);
@@ -179,6 +179,29 @@ TEST_F(DrmSessionManagerTest, useSession) {
     ExpectEqSessionInfo(infos2[1], mTestDrm2, mSessionId3, 4);
 }
 
+TEST_F(DrmSessionManagerTest, useSessionKeepsUseOrder) {
+    addSession();
+
+    mDrmSessionManager->useSession(mSessionId2);
+    mDrmSessionManager->useSession(mSessionId2);
+
+    // mSessionId2 is now the most recently used session of kTestPid2.
+    const SessionInfos& infos2 = sessionMap().valueFor(kTestPid2);
+    EXPECT_EQ(2u, infos2.size());
+    ExpectEqSessionInfo(infos2[0], mTestDrm2, mSessionId3, 2);
+    ExpectEqSessionInfo(infos2[1], mTestDrm2, mSessionId2, 4);
+    EXPECT_EQ(0u, infos2[0].useCount);
+    EXPECT_EQ(2u, infos2[1].useCount);
+
+    // unknown sessions are ignored.
+    const uint8_t ids[] = {42};
+    Vector<uint8_t> sessionId;
+    GetSessionId(ids, ARRAY_SIZE(ids), &sessionId);
+    mDrmSessionManager->useSession(sessionId);
+    mDrmSessionManager->removeSession(sessionId);
+    EXPECT_EQ(2u, sessionMap().valueFor(kTestPid2).size());
+}
+
 TEST_F(DrmSessionManagerTest, removeSession) {
     addSession();
 
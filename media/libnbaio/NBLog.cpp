@@ -147,6 +147,135 @@ void NBLog::Writer::logTimestamp(const struct timespec& ts)
     log(EVENT_TIMESTAMP, &ts, sizeof(struct timespec));
 }
 
+void NBLog::Writer::logFormat(const char *fmt, ...)
+{
+    if (!mEnabled) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    Writer::logVFormat(fmt, ap);    // the Writer:: is needed to avoid virtual dispatch
+    va_end(ap);
+}
+
+void NBLog::Writer::logVFormat(const char *fmt, va_list ap)
+{
+    if (!mEnabled) {
+        return;
+    }
+    size_t length = strlen(fmt);
+    if (length > 255) {
+        length = 255;
+    }
+    log(EVENT_START_FMT, fmt, length);
+    Writer::logTimestamp();
+
+    // Only walk the conversions to pull each argument off the va_list with its promoted
+    // type, the format string itself is interpreted by the Reader.
+    for (const char *p = fmt; *p != '\0'; ++p) {
+        if (*p != '%') {
+            continue;
+        }
+        ++p;
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+            ++p;
+        }
+        for (int field = 0; field < 2; ++field) {   // width, then precision
+            if (field == 1) {
+                if (*p != '.') {
+                    break;
+                }
+                ++p;
+            }
+            if (*p == '*') {
+                int32_t value = va_arg(ap, int);
+                log(EVENT_INTEGER, &value, sizeof(value));
+                ++p;
+            } else {
+                while (*p >= '0' && *p <= '9') {
+                    ++p;
+                }
+            }
+        }
+        size_t size = sizeof(int);
+        bool longDouble = false;
+        bool supported = true;
+        switch (*p) {
+        case 'h':
+            p += p[1] == 'h' ? 2 : 1;
+            break;
+        case 'l':
+            if (p[1] == 'l') {
+                size = sizeof(long long);
+                p += 2;
+            } else {
+                size = sizeof(long);
+                ++p;
+            }
+            break;
+        case 'j':
+            size = sizeof(intmax_t);
+            ++p;
+            break;
+        case 'z':
+            size = sizeof(size_t);
+            ++p;
+            break;
+        case 't':
+            size = sizeof(ptrdiff_t);
+            ++p;
+            break;
+        case 'L':
+            longDouble = true;
+            ++p;
+            break;
+        default:
+            break;
+        }
+        switch (*p) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+            if (size == sizeof(int64_t)) {
+                int64_t value = va_arg(ap, long long);
+                log(EVENT_INT64, &value, sizeof(value));
+            } else {
+                int32_t value = va_arg(ap, int);
+                log(EVENT_INTEGER, &value, sizeof(value));
+            }
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            double value = longDouble ? (double) va_arg(ap, long double) : va_arg(ap, double);
+            log(EVENT_DOUBLE, &value, sizeof(value));
+            } break;
+        case 's': {
+            const char *string = va_arg(ap, const char *);
+            if (string == NULL) {
+                string = "(null)";
+            }
+            size_t stringLength = strlen(string);
+            if (stringLength > 255) {
+                stringLength = 255;
+            }
+            log(EVENT_STRING, string, stringLength);
+            } break;
+        case 'p': {
+            int64_t value = (intptr_t) va_arg(ap, void *);
+            log(EVENT_INT64, &value, sizeof(value));
+            } break;
+        case '%':
+            break;
+        default:
+            // unsupported conversion or truncated format, the remaining arguments can't
+            // be located
+            supported = false;
+            break;
+        }
+        if (!supported) {
+            break;
+        }
+    }
+    log(EVENT_END_FMT, "", 0);
+}
+
 void NBLog::Writer::log(Event event, const void *data, size_t length)
 {
     if (!mEnabled) {
@@ -158,6 +287,11 @@ void NBLog::Writer::log(Event event, const void *data, size_t length)
     switch (event) {
     case EVENT_STRING:
     case EVENT_TIMESTAMP:
+    case EVENT_INTEGER:
+    case EVENT_INT64:
+    case EVENT_DOUBLE:
+    case EVENT_START_FMT:
+    case EVENT_END_FMT:
         break;
     case EVENT_RESERVED:
     default:
@@ -258,6 +392,21 @@ void NBLog::LockedWriter::logTimestamp(const struct timespec& ts)
     Writer::logTimestamp(ts);
 }
 
+void NBLog::LockedWriter::logFormat(const char *fmt, ...)
+{
+    Mutex::Autolock _l(mLock);
+    va_list ap;
+    va_start(ap, fmt);
+    Writer::logVFormat(fmt, ap);
+    va_end(ap);
+}
+
+void NBLog::LockedWriter::logVFormat(const char *fmt, va_list ap)
+{
+    Mutex::Autolock _l(mLock);
+    Writer::logVFormat(fmt, ap);
+}
+
 bool NBLog::LockedWriter::isEnabled() const
 {
     Mutex::Autolock _l(mLock);
@@ -416,6 +565,20 @@ void NBLog::Reader::dump(int fd, size_t indent)
                     (int) (ts.tv_nsec / 1000000));
             deferredTimestamp = true;
             } break;
+        case EVENT_START_FMT:
+            if (deferredTimestamp) {
+                dumpLine(timestamp, body);
+                deferredTimestamp = false;
+            }
+            i = dumpFormat(copy, i, avail, timestamp, body);
+            advance = 0;
+            break;
+        case EVENT_INTEGER:
+        case EVENT_INT64:
+        case EVENT_DOUBLE:
+        case EVENT_END_FMT:
+            // remainder of a format entry whose start was lost
+            break;
         case EVENT_RESERVED:
         default:
             body.appendFormat("warning: unknown event %d", event);
@@ -445,6 +608,162 @@ void NBLog::Reader::dumpLine(const String8& timestamp, String8& body)
     body.clear();
 }
 
+// Returns the data of the next argument of the format entry whose next entry is at
+// copy[*offset], or NULL if it is not of the expected type or there are no more arguments.
+static const uint8_t *nextArgument(const uint8_t *copy, size_t *offset, size_t avail,
+        int event, int event64 = -1)
+{
+    if (*offset >= avail) {
+        return NULL;
+    }
+    int actual = copy[*offset];
+    if (actual != event && actual != event64) {
+        return NULL;
+    }
+    const uint8_t *data = &copy[*offset + 2];
+    *offset += copy[*offset + 1] + 3;
+    return data;
+}
+
+size_t NBLog::Reader::dumpFormat(const uint8_t *copy, size_t offset, size_t avail,
+        String8& timestamp, String8& body)
+{
+    const char *fmt = (const char *) &copy[offset + 2];
+    const size_t fmtLength = copy[offset + 1];
+    size_t arg = offset + fmtLength + 3;
+    if (arg < avail && (Event) copy[arg] == EVENT_TIMESTAMP) {
+        // length already checked by dump()
+        struct timespec ts;
+        memcpy(&ts, &copy[arg + 2], sizeof(struct timespec));
+        timestamp.clear();
+        timestamp.appendFormat("[%d.%03d]", (int) ts.tv_sec, (int) (ts.tv_nsec / 1000000));
+        arg += sizeof(struct timespec) + 3;
+    }
+
+    size_t k = 0;
+    while (k < fmtLength) {
+        size_t literal = k;
+        while (k < fmtLength && fmt[k] != '%') {
+            ++k;
+        }
+        body.append(&fmt[literal], k - literal);
+        const size_t percent = k;
+        if (k++ >= fmtLength) {
+            break;
+        }
+
+        // copy flags, width and precision, replacing a '*' by the logged value
+        char spec[32];
+        size_t n = 0;
+        spec[n++] = '%';
+        while (k < fmtLength && fmt[k] != '\0' && strchr("-+ #0123456789.*", fmt[k]) != NULL) {
+            if (n < sizeof(spec) - 16) {
+                if (fmt[k] == '*') {
+                    const uint8_t *data = nextArgument(copy, &arg, avail, EVENT_INTEGER);
+                    int32_t value = 0;
+                    if (data != NULL) {
+                        memcpy(&value, data, sizeof(value));
+                    }
+                    n += snprintf(&spec[n], sizeof(spec) - n, "%d", value);
+                } else {
+                    spec[n++] = fmt[k];
+                }
+            }
+            ++k;
+        }
+        // the length modifiers are replaced by the logged argument type
+        while (k < fmtLength && fmt[k] != '\0' && strchr("hljztL", fmt[k]) != NULL) {
+            ++k;
+        }
+        if (k >= fmtLength) {
+            break;
+        }
+        const char conversion = fmt[k++];
+        const uint8_t *data = NULL;
+        switch (conversion) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c': {
+            size_t start = arg;
+            data = nextArgument(copy, &arg, avail, EVENT_INTEGER, EVENT_INT64);
+            if (data == NULL) {
+                break;
+            }
+            if ((Event) copy[start] == EVENT_INT64) {
+                int64_t value;
+                memcpy(&value, data, sizeof(value));
+                spec[n++] = 'l';
+                spec[n++] = 'l';
+                spec[n++] = conversion;
+                spec[n] = '\0';
+                body.appendFormat(spec, (long long) value);
+            } else {
+                int32_t value;
+                memcpy(&value, data, sizeof(value));
+                spec[n++] = conversion;
+                spec[n] = '\0';
+                body.appendFormat(spec, value);
+            }
+            } break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            data = nextArgument(copy, &arg, avail, EVENT_DOUBLE);
+            if (data == NULL) {
+                break;
+            }
+            double value;
+            memcpy(&value, data, sizeof(value));
+            spec[n++] = conversion;
+            spec[n] = '\0';
+            body.appendFormat(spec, value);
+            } break;
+        case 's': {
+            size_t start = arg;
+            data = nextArgument(copy, &arg, avail, EVENT_STRING);
+            if (data == NULL) {
+                break;
+            }
+            String8 string((const char *) data, copy[start + 1]);
+            spec[n++] = 's';
+            spec[n] = '\0';
+            body.appendFormat(spec, string.string());
+            } break;
+        case 'p': {
+            data = nextArgument(copy, &arg, avail, EVENT_INT64);
+            if (data == NULL) {
+                break;
+            }
+            int64_t value;
+            memcpy(&value, data, sizeof(value));
+            spec[n++] = 'p';
+            spec[n] = '\0';
+            body.appendFormat(spec, (void *) (intptr_t) value);
+            } break;
+        case '%':
+            body.append("%");
+            continue;
+        default:
+            // the writer stopped logging arguments here
+            body.append(&fmt[percent], fmtLength - percent);
+            k = fmtLength;
+            continue;
+        }
+        if (data == NULL) {
+            body.append("<?>");
+        }
+    }
+
+    // skip any arguments not consumed, up to and including the end of the entry
+    while (arg < avail) {
+        Event event = (Event) copy[arg];
+        if (event == EVENT_START_FMT) {
+            break;
+        }
+        arg += copy[arg + 1] + 3;
+        if (event == EVENT_END_FMT) {
+            break;
+        }
+    }
+    return arg;
+}
+
 bool NBLog::Reader::isIMemory(const sp<IMemory>& iMemory) const
 {
     return iMemory != 0 && mIMemory != 0 && iMemory->pointer() == mIMemory->pointer();
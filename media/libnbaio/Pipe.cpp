@@ -31,8 +31,13 @@ Pipe::Pipe(size_t maxFrames, const NBAIO_Format& format, void *buffer) :
         mBuffer(buffer == NULL ? malloc(mMaxFrames * Format_frameSize(format)) : buffer),
         mRear(0),
         mReaders(0),
-        mFreeBufferInDestructor(buffer == NULL)
+        mFreeBufferInDestructor(buffer == NULL),
+        mBlockingSlots(0),
+        mBlockingReaders(0)
 {
+    for (int i = 0; i < kMaxBlockingReaders; ++i) {
+        mBlockingFronts[i] = 0;
+    }
 }
 
 Pipe::~Pipe()
@@ -43,12 +48,40 @@ Pipe::~Pipe()
     }
 }
 
+ssize_t Pipe::availableToWrite() const
+{
+    int32_t readers = android_atomic_acquire_load(&mBlockingReaders);
+    if (CC_LIKELY(readers == 0)) {
+        return mMaxFrames;
+    }
+    // only the writer modifies mRear
+    size_t maxLag = 0;
+    for (int i = 0; i < kMaxBlockingReaders; ++i) {
+        if (readers & (1 << i)) {
+            size_t lag = mRear - android_atomic_acquire_load(&mBlockingFronts[i]);
+            if (lag > maxLag) {
+                maxLag = lag;
+            }
+        }
+    }
+    return maxLag < mMaxFrames ? mMaxFrames - maxLag : 0;
+}
+
 ssize_t Pipe::write(const void *buffer, size_t count)
 {
     // count == 0 is unlikely and not worth checking for
     if (CC_UNLIKELY(!mNegotiated)) {
         return NEGOTIATE;
     }
+    if (CC_UNLIKELY(android_atomic_acquire_load(&mBlockingReaders) != 0)) {
+        size_t avail = availableToWrite();
+        if (count > avail) {
+            count = avail;
+            if (count == 0) {
+                return 0;
+            }
+        }
+    }
     // write() is not multi-thread safe w.r.t. itself, so no mutex or atomic op needed to read mRear
     size_t rear = mRear & (mMaxFrames - 1);
     size_t written = mMaxFrames - rear;
@@ -70,4 +103,29 @@ ssize_t Pipe::write(const void *buffer, size_t count)
     return written;
 }
 
+int Pipe::addBlockingReader(int32_t front)
+{
+    for (int i = 0; i < kMaxBlockingReaders; ++i) {
+        int32_t slots = android_atomic_acquire_load(&mBlockingSlots);
+        if (slots & (1 << i)) {
+            continue;
+        }
+        if (android_atomic_cmpxchg(slots, slots | (1 << i), &mBlockingSlots) != 0) {
+            // lost a race with another reader, retry the same slot
+            --i;
+            continue;
+        }
+        android_atomic_release_store(front, &mBlockingFronts[i]);
+        android_atomic_or(1 << i, &mBlockingReaders);
+        return i;
+    }
+    return -1;
+}
+
+void Pipe::removeBlockingReader(int slot)
+{
+    android_atomic_and(~(1 << slot), &mBlockingReaders);
+    android_atomic_and(~(1 << slot), &mBlockingSlots);
+}
+
 }   // namespace android
@@ -23,19 +23,32 @@
 
 namespace android {
 
-PipeReader::PipeReader(Pipe& pipe) :
+PipeReader::PipeReader(Pipe& pipe, Policy policy) :
         NBAIO_Source(pipe.mFormat),
         mPipe(pipe),
         // any data already in the pipe is not visible to this PipeReader
         mFront(android_atomic_acquire_load(&pipe.mRear)),
         mFramesOverrun(0),
-        mOverruns(0)
+        mOverruns(0),
+        mFramesDropped(0),
+        mPolicy(policy),
+        mBlockingSlot(-1)
 {
     android_atomic_inc(&pipe.mReaders);
+    if (policy == POLICY_BLOCK_WRITER) {
+        mBlockingSlot = pipe.addBlockingReader(mFront);
+        if (mBlockingSlot < 0) {
+            ALOGW("too many blocking readers, falling back to drop oldest");
+            mPolicy = POLICY_DROP_OLDEST;
+        }
+    }
 }
 
 PipeReader::~PipeReader()
 {
+    if (mBlockingSlot >= 0) {
+        mPipe.removeBlockingReader(mBlockingSlot);
+    }
     int32_t readers = android_atomic_dec(&mPipe.mReaders);
     ALOG_ASSERT(readers > 0);
 }
@@ -59,12 +72,28 @@ ssize_t PipeReader::availableToRead()
     return avail;
 }
 
+size_t PipeReader::lag() const
+{
+    return (size_t) (android_atomic_acquire_load(&mPipe.mRear) - mFront);
+}
+
 ssize_t PipeReader::read(void *buffer, size_t count, int64_t readPTS __unused)
 {
     ssize_t avail = availableToRead();
     if (CC_UNLIKELY(avail <= 0)) {
         return avail;
     }
+    if (mPolicy == POLICY_CATCH_UP && (size_t) avail > (mPipe.mMaxFrames >> 1)) {
+        // drop at most 1/16 of each read, which keeps every discontinuity short
+        size_t skip = (size_t) avail - (mPipe.mMaxFrames >> 1);
+        size_t maxSkip = (count >> 4) > 0 ? count >> 4 : 1;
+        if (skip > maxSkip) {
+            skip = maxSkip;
+        }
+        mFront += skip;
+        mFramesDropped += skip;
+        avail -= skip;
+    }
     // An overrun can occur from here on and be silently ignored,
     // but it will be caught at next read()
     if (CC_LIKELY(count > (size_t) avail)) {
@@ -88,6 +117,9 @@ ssize_t PipeReader::read(void *buffer, size_t count, int64_t readPTS __unused)
         }
     }
     mFront += red;
+    if (mBlockingSlot >= 0) {
+        android_atomic_release_store(mFront, &mPipe.mBlockingFronts[mBlockingSlot]);
+    }
     mFramesRead += red;
     return red;
 }
@@ -116,14 +116,16 @@ static void InitOMXParams(T *params) {
     params->nVersion.s.nStep = 0;
 }
 
+// The messages of one IOMXObserver::onMessages() call, posted to ACodec as is. ACodec
+// dispatches them one by one, without translating each of them into an AMessage.
 struct MessageList : public RefBase {
     MessageList() {
     }
     virtual ~MessageList() {
     }
-    std::list<sp<AMessage> > &getList() { return mList; }
+    std::list<omx_message> &getList() { return mList; }
 private:
-    std::list<sp<AMessage> > mList;
+    std::list<omx_message> mList;
 
     DISALLOW_EVIL_CONSTRUCTORS(MessageList);
 };
@@ -142,70 +144,9 @@ struct CodecObserver : public BnOMXObserver {
         }
 
         sp<AMessage> notify = mNotify->dup();
-        bool first = true;
         sp<MessageList> msgList = new MessageList();
-        for (std::list<omx_message>::const_iterator it = messages.cbegin();
-              it != messages.cend(); ++it) {
-            const omx_message &omx_msg = *it;
-            if (first) {
-                notify->setInt32("node", omx_msg.node);
-                first = false;
-            }
-
-            sp<AMessage> msg = new AMessage;
-            msg->setInt32("type", omx_msg.type);
-            switch (omx_msg.type) {
-                case omx_message::EVENT:
-                {
-                    msg->setInt32("event", omx_msg.u.event_data.event);
-                    msg->setInt32("data1", omx_msg.u.event_data.data1);
-                    msg->setInt32("data2", omx_msg.u.event_data.data2);
-                    break;
-                }
-
-                case omx_message::EMPTY_BUFFER_DONE:
-                {
-                    msg->setInt32("buffer", omx_msg.u.buffer_data.buffer);
-                    msg->setInt32("fence_fd", omx_msg.fenceFd);
-                    break;
-                }
-
-                case omx_message::FILL_BUFFER_DONE:
-                {
-                    msg->setInt32(
-                            "buffer", omx_msg.u.extended_buffer_data.buffer);
-                    msg->setInt32(
-                            "range_offset",
-                            omx_msg.u.extended_buffer_data.range_offset);
-                    msg->setInt32(
-                            "range_length",
-                            omx_msg.u.extended_buffer_data.range_length);
-                    msg->setInt32(
-                            "flags",
-                            omx_msg.u.extended_buffer_data.flags);
-                    msg->setInt64(
-                            "timestamp",
-                            omx_msg.u.extended_buffer_data.timestamp);
-                    msg->setInt32(
-                            "fence_fd", omx_msg.fenceFd);
-                    break;
-                }
-
-                case omx_message::FRAME_RENDERED:
-                {
-                    msg->setInt64(
-                            "media_time_us", omx_msg.u.render_data.timestamp);
-                    msg->setInt64(
-                            "system_nano", omx_msg.u.render_data.nanoTime);
-                    break;
-                }
-
-                default:
-                    ALOGE("Unrecognized message type: %d", omx_msg.type);
-                    break;
-            }
-            msgList->getList().push_back(msg);
-        }
+        msgList->getList() = messages;
+        notify->setInt32("node", messages.front().node);
         notify->setObject("messages", msgList);
         notify->post();
     }
@@ -247,6 +188,7 @@ protected:
 private:
     // Handles an OMX message. Returns true iff message was handled.
     bool onOMXMessage(const sp<AMessage> &msg);
+    bool onOMXMessage(const omx_message &msg);
 
     // Handles a list of messages. Returns true iff messages were handled.
     bool onOMXMessageList(const sp<AMessage> &msg);
@@ -523,6 +465,7 @@ ACodec::ACodec()
       mMetadataBuffersToSubmit(0),
       mRepeatFrameDelayUs(-1ll),
       mMaxPtsGapUs(-1ll),
+      mMaxLatencyUs(-1ll),
       mMaxFps(-1),
       mTimePerFrameUs(-1ll),
       mTimePerCaptureUs(-1ll),
@@ -858,6 +801,7 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
 
                 if (mem != NULL) {
                     info.mData = new ABuffer(mem->pointer(), bufSize);
+                    info.mMemRef = mem;
                     if (type == kMetadataBufferTypeANWBuffer) {
                         ((VideoNativeMetadata *)mem->pointer())->nFenceFd = -1;
                     }
@@ -882,7 +826,7 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
     for (size_t i = 0; i < mBuffers[portIndex].size(); ++i) {
         const BufferInfo &info = mBuffers[portIndex][i];
 
-        desc->addBuffer(info.mBufferID, info.mData);
+        desc->addBuffer(info.mBufferID, info.mData, info.mMemRef);
     }
 
     notify->setObject("portDesc", desc);
@@ -1823,6 +1767,10 @@ status_t ACodec::configureCodec(
             mMaxFps = -1;
         }
 
+        if (!msg->findInt64("max-latency-to-encoder", &mMaxLatencyUs)) {
+            mMaxLatencyUs = -1ll;
+        }
+
         if (!msg->findInt64("time-lapse", &mTimePerCaptureUs)) {
             mTimePerCaptureUs = -1ll;
         }
@@ -2022,6 +1970,47 @@ status_t ACodec::configureCodec(
             return err;
         }
 
+        int32_t lowLatency;
+        if (!encoder && msg->findInt32("low-latency", &lowLatency) && lowLatency != 0) {
+            // Output every frame as soon as it is decoded. Not all components support this,
+            // so failure is not fatal.
+            OMX_INDEXTYPE index;
+            status_t temp = mOMX->getExtensionIndex(
+                    mNode, "OMX.google.android.index.lowLatency", &index);
+            if (temp == OK) {
+                OMX_CONFIG_BOOLEANTYPE params;
+                InitOMXParams(&params);
+                params.bEnabled = OMX_TRUE;
+                temp = mOMX->setParameter(mNode, index, &params, sizeof(params));
+            }
+            if (temp == OK) {
+                outputFormat->setInt32("low-latency", 1);
+            } else {
+                ALOGI("[%s] codec does not support low latency (err %d)",
+                        mComponentName.c_str(), temp);
+            }
+        }
+
+        int32_t threadCount;
+        if (!encoder && msg->findInt32("thread-count", &threadCount) && threadCount > 0) {
+            OMX_INDEXTYPE index;
+            status_t temp = mOMX->getExtensionIndex(
+                    mNode, "OMX.google.android.index.threadCount", &index);
+            if (temp == OK) {
+                OMX_PARAM_U32TYPE params;
+                InitOMXParams(&params);
+                params.nPortIndex = kPortIndexOutput;
+                params.nU32 = (OMX_U32)threadCount;
+                temp = mOMX->setParameter(mNode, index, &params, sizeof(params));
+            }
+            if (temp == OK) {
+                outputFormat->setInt32("thread-count", threadCount);
+            } else {
+                ALOGI("[%s] codec does not support a thread count (err %d)",
+                        mComponentName.c_str(), temp);
+            }
+        }
+
         if (haveNativeWindow) {
             mNativeWindow = static_cast<Surface *>(obj.get());
         }
@@ -2173,6 +2162,15 @@ status_t ACodec::configureCodec(
                 sampleRate = 8000;
             }
             err = setupG711Codec(encoder, sampleRate, numChannels);
+
+            // The software G.711 decoder can decode straight to float.
+            int32_t pcmFormat;
+            if (err == OK && !strncmp(mComponentName.c_str(), "OMX.google.", 11)
+                    && msg->findInt32("pcm-format", &pcmFormat)
+                    && pcmFormat == AUDIO_FORMAT_PCM_FLOAT) {
+                err = setupRawAudioFormatInternal(
+                        kPortIndexOutput, sampleRate, numChannels, 32 /* bitsPerSample */);
+            }
         }
     } else if (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_FLAC) && encoder) {
         int32_t numChannels = 0, sampleRate = 0, compressionLevel = -1;
@@ -2200,8 +2198,14 @@ status_t ACodec::configureCodec(
                     compressionLevel = 8;
                 }
             }
+            int32_t blockSize = 0, threadCount = 0;
+            if (encoder) {
+                msg->findInt32("flac-block-size", &blockSize);
+                msg->findInt32("thread-count", &threadCount);
+            }
             err = setupFlacCodec(
-                    encoder, numChannels, sampleRate, compressionLevel);
+                    encoder, numChannels, sampleRate, compressionLevel,
+                    blockSize, threadCount);
         }
     } else if (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_RAW)) {
         int32_t numChannels, sampleRate;
@@ -2213,6 +2217,16 @@ status_t ACodec::configureCodec(
             int32_t bitsPerSample = 16;
             msg->findInt32("bits-per-sample", &bitsPerSample);
             err = setupRawAudioFormatInternal(kPortIndexInput, sampleRate, numChannels, bitsPerSample);
+
+            // The software raw decoder converts 16 and 24 bit input to float.
+            int32_t pcmFormat;
+            if (err == OK && !strncmp(mComponentName.c_str(), "OMX.google.", 11)
+                    && (bitsPerSample == 16 || bitsPerSample == 24)
+                    && msg->findInt32("pcm-format", &pcmFormat)
+                    && pcmFormat == AUDIO_FORMAT_PCM_FLOAT) {
+                err = setupRawAudioFormatInternal(
+                        kPortIndexOutput, sampleRate, numChannels, 32 /* bitsPerSample */);
+            }
         }
     } else if (!strncmp(mComponentName.c_str(), "OMX.google.", 11)
             && !strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AC3)) {
@@ -2237,6 +2251,22 @@ status_t ACodec::configureCodec(
             msg->findInt32("bits-per-sample", &bitsPerSample);
             err = setupEAC3Codec(encoder, numChannels, sampleRate, bitsPerSample);
         }
+    } else if (!encoder && !strncmp(mComponentName.c_str(), "OMX.google.", 11)
+            && (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_VORBIS)
+                    || !strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_OPUS))) {
+        // The software Vorbis and Opus decoders can output float, which saves
+        // the mixer converting their 16 bit output back. 32 bits per sample
+        // on a PCM port means float, see getPCMFormat().
+        int32_t numChannels, sampleRate, pcmFormat;
+        if (msg->findInt32("pcm-format", &pcmFormat)
+                && pcmFormat == AUDIO_FORMAT_PCM_FLOAT
+                && msg->findInt32("channel-count", &numChannels)
+                && msg->findInt32("sample-rate", &sampleRate)) {
+            err = setupRawAudioFormatInternal(
+                    kPortIndexOutput, sampleRate, numChannels, 32 /* bitsPerSample */);
+        } else {
+            err = OK;
+        }
     } else {
         if (!strncmp(mComponentName.c_str(), "OMX.ffmpeg.", 11) && !mIsEncoder) {
             err = FFMPEGSoftCodec::setAudioFormat(
@@ -2717,7 +2747,8 @@ status_t ACodec::setupG711Codec(bool encoder, int32_t sampleRate, int32_t numCha
 }
 
 status_t ACodec::setupFlacCodec(
-        bool encoder, int32_t numChannels, int32_t sampleRate, int32_t compressionLevel) {
+        bool encoder, int32_t numChannels, int32_t sampleRate, int32_t compressionLevel,
+        int32_t blockSize, int32_t threadCount) {
 
     if (encoder) {
         OMX_AUDIO_PARAM_FLACTYPE def;
@@ -2736,6 +2767,33 @@ status_t ACodec::setupFlacCodec(
             ALOGE("setupFlacCodec(): Error %d setting OMX_IndexParamAudioFlac parameter", err);
             return err;
         }
+
+        // Optional, the software encoder can encode blocks on several threads.
+        const struct {
+            const char *mName;
+            int32_t mValue;
+        } kExtensions[] = {
+            { "OMX.google.android.index.flacBlockSize", blockSize },
+            { "OMX.google.android.index.threadCount", threadCount },
+        };
+        for (size_t i = 0; i < sizeof(kExtensions) / sizeof(kExtensions[0]); ++i) {
+            if (kExtensions[i].mValue <= 0) {
+                continue;
+            }
+            OMX_INDEXTYPE index;
+            status_t temp = mOMX->getExtensionIndex(mNode, kExtensions[i].mName, &index);
+            if (temp == OK) {
+                OMX_PARAM_U32TYPE params;
+                InitOMXParams(&params);
+                params.nPortIndex = kPortIndexOutput;
+                params.nU32 = (OMX_U32)kExtensions[i].mValue;
+                temp = mOMX->setParameter(mNode, index, &params, sizeof(params));
+            }
+            if (temp != OK) {
+                ALOGI("[%s] codec does not support %s (err %d)",
+                        mComponentName.c_str(), kExtensions[i].mName, temp);
+            }
+        }
     }
 
     return setupRawAudioFormat(
@@ -4384,6 +4442,20 @@ status_t ACodec::getPortFormat(OMX_U32 portIndex, sp<AMessage> &notify) {
                     notify->setString("mime", MEDIA_MIMETYPE_AUDIO_AAC);
                     notify->setInt32("channel-count", params.nChannels);
                     notify->setInt32("sample-rate", params.nSampleRate);
+
+                    // The encoder delay is the latency of the low delay
+                    // profiles; it is optional.
+                    OMX_INDEXTYPE index;
+                    if (mIsEncoder && mOMX->getExtensionIndex(
+                            mNode, "OMX.google.android.index.encoderDelay", &index) == OK) {
+                        OMX_PARAM_U32TYPE delayParams;
+                        InitOMXParams(&delayParams);
+                        delayParams.nPortIndex = portIndex;
+                        if (mOMX->getParameter(
+                                mNode, index, &delayParams, sizeof(delayParams)) == OK) {
+                            notify->setInt32("encoder-delay", delayParams.nU32);
+                        }
+                    }
                     break;
                 }
 
@@ -4681,9 +4753,11 @@ status_t ACodec::requestIDRFrame() {
 }
 
 void ACodec::PortDescription::addBuffer(
-        IOMX::buffer_id id, const sp<ABuffer> &buffer) {
+        IOMX::buffer_id id, const sp<ABuffer> &buffer,
+        const sp<IMemory> &memRef) {
     mBufferIDs.push_back(id);
     mBuffers.push_back(buffer);
+    mMemRefs.push_back(memRef);
 }
 
 size_t ACodec::PortDescription::countBuffers() {
@@ -4698,6 +4772,10 @@ sp<ABuffer> ACodec::PortDescription::bufferAt(size_t index) const {
     return mBuffers.itemAt(index);
 }
 
+sp<IMemory> ACodec::PortDescription::memRefAt(size_t index) const {
+    return mMemRefs.itemAt(index);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 ACodec::BaseState::BaseState(ACodec *codec, const sp<AState> &parentState)
@@ -4818,14 +4896,17 @@ bool ACodec::BaseState::onOMXMessageList(const sp<AMessage> &msg) {
     CHECK(msg->findObject("messages", &obj));
     sp<MessageList> msgList = static_cast<MessageList *>(obj.get());
 
+    // A single item message carries each omx_message in turn to whatever state is current
+    // at that point, as handling a message may change the state.
+    sp<AMessage> item = new AMessage;
+    item->setWhat(ACodec::kWhatOMXMessageItem);
+
     bool receivedRenderedEvents = false;
-    for (std::list<sp<AMessage>>::const_iterator it = msgList->getList().cbegin();
+    for (std::list<omx_message>::const_iterator it = msgList->getList().cbegin();
           it != msgList->getList().cend(); ++it) {
-        (*it)->setWhat(ACodec::kWhatOMXMessageItem);
-        mCodec->handleMessage(*it);
-        int32_t type;
-        CHECK((*it)->findInt32("type", &type));
-        if (type == omx_message::FRAME_RENDERED) {
+        item->setPointer("omx_message", (void *)&*it);
+        mCodec->handleMessage(item);
+        if (it->type == omx_message::FRAME_RENDERED) {
             receivedRenderedEvents = true;
         }
     }
@@ -4838,20 +4919,39 @@ bool ACodec::BaseState::onOMXMessageList(const sp<AMessage> &msg) {
 }
 
 bool ACodec::BaseState::onOMXMessage(const sp<AMessage> &msg) {
-    int32_t type;
+    void *ptr;
+    if (msg->findPointer("omx_message", &ptr)) {
+        return onOMXMessage(*static_cast<const omx_message *>(ptr));
+    }
+
+    // Messages posted by ACodec itself, which are always events.
+    int32_t type, event, data1, data2;
     CHECK(msg->findInt32("type", &type));
+    if (type != omx_message::EVENT) {
+        ALOGE("Unexpected message type: %d", type);
+        return false;
+    }
+    CHECK(msg->findInt32("event", &event));
+    CHECK(msg->findInt32("data1", &data1));
+    CHECK(msg->findInt32("data2", &data2));
 
-    switch (type) {
+    omx_message omxMsg;
+    omxMsg.type = omx_message::EVENT;
+    omxMsg.node = mCodec->mNode;
+    omxMsg.fenceFd = -1;
+    omxMsg.u.event_data.event = static_cast<OMX_EVENTTYPE>(event);
+    omxMsg.u.event_data.data1 = static_cast<OMX_U32>(data1);
+    omxMsg.u.event_data.data2 = static_cast<OMX_U32>(data2);
+    return onOMXMessage(omxMsg);
+}
+
+bool ACodec::BaseState::onOMXMessage(const omx_message &msg) {
+    switch (msg.type) {
         case omx_message::EVENT:
         {
-            int32_t event, data1, data2;
-            CHECK(msg->findInt32("event", &event));
-            CHECK(msg->findInt32("data1", &data1));
-            CHECK(msg->findInt32("data2", &data2));
-
-            if (event == OMX_EventCmdComplete
-                    && data1 == OMX_CommandFlush
-                    && data2 == (int32_t)OMX_ALL) {
+            if (msg.u.event_data.event == OMX_EventCmdComplete
+                    && msg.u.event_data.data1 == OMX_CommandFlush
+                    && msg.u.event_data.data2 == OMX_ALL) {
                 // Use of this notification is not consistent across
                 // implementations. We'll drop this notification and rely
                 // on flush-complete notifications on the individual port
@@ -4861,57 +4961,33 @@ bool ACodec::BaseState::onOMXMessage(const sp<AMessage> &msg) {
             }
 
             return onOMXEvent(
-                    static_cast<OMX_EVENTTYPE>(event),
-                    static_cast<OMX_U32>(data1),
-                    static_cast<OMX_U32>(data2));
+                    msg.u.event_data.event, msg.u.event_data.data1, msg.u.event_data.data2);
         }
 
         case omx_message::EMPTY_BUFFER_DONE:
         {
-            IOMX::buffer_id bufferID;
-            int32_t fenceFd;
-
-            CHECK(msg->findInt32("buffer", (int32_t*)&bufferID));
-            CHECK(msg->findInt32("fence_fd", &fenceFd));
-
-            return onOMXEmptyBufferDone(bufferID, fenceFd);
+            return onOMXEmptyBufferDone(msg.u.buffer_data.buffer, msg.fenceFd);
         }
 
         case omx_message::FILL_BUFFER_DONE:
         {
-            IOMX::buffer_id bufferID;
-            CHECK(msg->findInt32("buffer", (int32_t*)&bufferID));
-
-            int32_t rangeOffset, rangeLength, flags, fenceFd;
-            int64_t timeUs;
-
-            CHECK(msg->findInt32("range_offset", &rangeOffset));
-            CHECK(msg->findInt32("range_length", &rangeLength));
-            CHECK(msg->findInt32("flags", &flags));
-            CHECK(msg->findInt64("timestamp", &timeUs));
-            CHECK(msg->findInt32("fence_fd", &fenceFd));
-
             return onOMXFillBufferDone(
-                    bufferID,
-                    (size_t)rangeOffset, (size_t)rangeLength,
-                    (OMX_U32)flags,
-                    timeUs,
-                    fenceFd);
+                    msg.u.extended_buffer_data.buffer,
+                    (size_t)msg.u.extended_buffer_data.range_offset,
+                    (size_t)msg.u.extended_buffer_data.range_length,
+                    msg.u.extended_buffer_data.flags,
+                    msg.u.extended_buffer_data.timestamp,
+                    msg.fenceFd);
         }
 
         case omx_message::FRAME_RENDERED:
         {
-            int64_t mediaTimeUs, systemNano;
-
-            CHECK(msg->findInt64("media_time_us", &mediaTimeUs));
-            CHECK(msg->findInt64("system_nano", &systemNano));
-
             return onOMXFrameRendered(
-                    mediaTimeUs, systemNano);
+                    msg.u.render_data.timestamp, msg.u.render_data.nanoTime);
         }
 
         default:
-            ALOGE("Unexpected message type: %d", type);
+            ALOGE("Unexpected message type: %d", msg.type);
             return false;
     }
 }
@@ -6020,6 +6096,22 @@ status_t ACodec::LoadedState::setupInputSurface() {
         }
     }
 
+    if (mCodec->mMaxLatencyUs > 0ll) {
+        err = mCodec->mOMX->setInternalOption(
+                mCodec->mNode,
+                kPortIndexInput,
+                IOMX::INTERNAL_OPTION_MAX_LATENCY,
+                &mCodec->mMaxLatencyUs,
+                sizeof(mCodec->mMaxLatencyUs));
+
+        if (err != OK) {
+            ALOGE("[%s] Unable to configure max latency (err %d)",
+                    mCodec->mComponentName.c_str(),
+                    err);
+            return err;
+        }
+    }
+
     if (mCodec->mTimePerCaptureUs > 0ll
             && mCodec->mTimePerFrameUs > 0ll) {
         int64_t timeLapse[2];
@@ -6337,6 +6429,9 @@ void ACodec::ExecutingState::submitOutputMetaBuffers() {
 }
 
 void ACodec::ExecutingState::submitRegularOutputBuffers() {
+    // All output buffers are handed to the component together, in a single IOMX call.
+    Vector<IOMX::BufferSubmission> submissions;
+    Vector<BufferInfo *> submitted;
     bool failed = false;
     for (size_t i = 0; i < mCodec->mBuffers[kPortIndexOutput].size(); ++i) {
         BufferInfo *info = &mCodec->mBuffers[kPortIndexOutput].editItemAt(i);
@@ -6363,14 +6458,24 @@ void ACodec::ExecutingState::submitRegularOutputBuffers() {
         ALOGV("[%s] calling fillBuffer %u", mCodec->mComponentName.c_str(), info->mBufferID);
 
         info->checkWriteFence("submitRegularOutputBuffers");
-        status_t err = mCodec->mOMX->fillBuffer(mCodec->mNode, info->mBufferID, info->mFenceFd);
+        IOMX::BufferSubmission submission;
+        memset(&submission, 0, sizeof(submission));
+        submission.mBuffer = info->mBufferID;
+        submission.mFenceFd = info->mFenceFd;
         info->mFenceFd = -1;
+        submissions.push(submission);
+        submitted.push(info);
+    }
+
+    if (!submissions.isEmpty()) {
+        status_t err = mCodec->mOMX->fillBuffers(mCodec->mNode, submissions);
         if (err != OK) {
             failed = true;
-            break;
+        } else {
+            for (size_t i = 0; i < submitted.size(); ++i) {
+                submitted[i]->mStatus = BufferInfo::OWNED_BY_COMPONENT;
+            }
         }
-
-        info->mStatus = BufferInfo::OWNED_BY_COMPONENT;
     }
 
     if (failed) {
@@ -6589,6 +6694,23 @@ status_t ACodec::setParameters(const sp<AMessage> &params) {
         }
     }
 
+    int32_t resetInputEOS;
+    if (params->findInt32("reset-input-eos", &resetInputEOS) && resetInputEOS) {
+        bool reset = true;
+        status_t err =
+            mOMX->setInternalOption(
+                     mNode,
+                     kPortIndexInput,
+                     IOMX::INTERNAL_OPTION_RESET_END_OF_STREAM,
+                     &reset,
+                     sizeof(reset));
+
+        if (err != OK) {
+            ALOGE("Failed to set parameter 'reset-input-eos' (err %d)", err);
+            return err;
+        }
+    }
+
     int32_t dummy;
     if (params->findInt32("request-sync", &dummy)) {
         status_t err = requestIDRFrame();
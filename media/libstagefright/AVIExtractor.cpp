@@ -103,10 +103,9 @@ AVIExtractor::AVISource::~AVISource() {
 status_t AVIExtractor::AVISource::start(MetaData *params) {
     CHECK(!mBufferGroup);
 
-    mBufferGroup = new MediaBufferGroup;
-
-    mBufferGroup->add_buffer(new MediaBuffer(mTrack.mMaxSampleSize));
-    mBufferGroup->add_buffer(new MediaBuffer(mTrack.mMaxSampleSize));
+    // Buffers are sized for the samples actually read rather than for the
+    // largest chunk in the index, which is often a single outlier.
+    mBufferGroup = new MediaBufferGroup(2 /* growthLimit */);
     mSampleIndex = 0;
 
     const char *mime;
@@ -183,7 +182,8 @@ status_t AVIExtractor::AVISource::read(
         }
 
         MediaBuffer *out;
-        CHECK_EQ(mBufferGroup->acquire_buffer(&out), (status_t)OK);
+        CHECK_EQ(mBufferGroup->acquire_buffer(&out, false /* nonBlocking */, size),
+                 (status_t)OK);
 
         ssize_t n = mExtractor->mDataSource->readAt(offset, out->data(), size);
 
@@ -416,7 +416,7 @@ status_t AVIExtractor::parseHeaders() {
         return ERROR_MALFORMED;
     }
 
-    return OK;
+    return finishIndex();
 }
 
 ssize_t AVIExtractor::parseChunk(off64_t offset, off64_t size, int depth) {
@@ -509,6 +509,12 @@ ssize_t AVIExtractor::parseChunk(off64_t offset, off64_t size, int depth) {
                 break;
             }
 
+            case FOURCC('i', 'n', 'd', 'x'):
+            {
+                err = parseSuperIndex(offset + 8, chunkSize);
+                break;
+            }
+
             case FOURCC('i', 'd', 'x', '1'):
             {
                 err = parseIndex(offset + 8, chunkSize);
@@ -613,6 +619,7 @@ status_t AVIExtractor::parseStreamHeader(off64_t offset, size_t size) {
     uint32_t rate = U32LE_AT(&data[20]);
     uint32_t scale = U32LE_AT(&data[24]);
 
+    uint32_t suggestedBufferSize = U32LE_AT(&data[36]);
     uint32_t sampleSize = U32LE_AT(&data[44]);
 
     const char *mime = NULL;
@@ -656,10 +663,11 @@ status_t AVIExtractor::parseStreamHeader(off64_t offset, size_t size) {
     track->mScale = scale;
     track->mBytesPerSample = sampleSize;
     track->mKind = kind;
+    track->mLoadedSegment = -1;
+    track->mNumSamples = 0;
     track->mNumSyncSamples = 0;
-    track->mThumbnailSampleSize = 0;
-    track->mThumbnailSampleIndex = -1;
     track->mMaxSampleSize = 0;
+    track->mSuggestedBufferSize = suggestedBufferSize;
     track->mAvgChunkSize = 1.0;
     track->mFirstChunkSize = 0;
 
@@ -769,108 +777,357 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
         return ERROR_MALFORMED;
     }
 
-    sp<ABuffer> buffer = new ABuffer(size);
-    ssize_t n = mDataSource->readAt(offset, buffer->data(), buffer->size());
+    bool needed = false;
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        const Track &track = mTracks.itemAt(i);
+        if (track.mKind != Track::OTHER && track.mSegments.isEmpty()) {
+            needed = true;
+        }
+    }
 
-    if (n < (ssize_t)size) {
-        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    if (!needed) {
+        // idx1 only covers the first RIFF of an OpenDML file.
+        ALOGV("Using the OpenDML index");
+        return OK;
     }
 
-    const uint8_t *data = buffer->data();
+    // The index of a large file is several megabytes, read it in blocks.
+    static const size_t kNumEntriesPerRead = 4096;
+
+    sp<ABuffer> buffer = new ABuffer(
+            size < 16 * kNumEntriesPerRead ? size : 16 * kNumEntriesPerRead);
 
     while (size > 0) {
-        uint32_t chunkType = U32_AT(data);
+        size_t blockSize = size < buffer->capacity() ? size : buffer->capacity();
+        ssize_t n = mDataSource->readAt(offset, buffer->data(), blockSize);
+
+        if (n < (ssize_t)blockSize) {
+            return n < 0 ? (status_t)n : ERROR_MALFORMED;
+        }
 
-        uint8_t hi = chunkType >> 24;
-        uint8_t lo = (chunkType >> 16) & 0xff;
+        offset += blockSize;
+        size -= blockSize;
 
-        if (hi < '0' || hi > '9' || lo < '0' || lo > '9') {
-            return ERROR_MALFORMED;
+        for (const uint8_t *data = buffer->data();
+                data < buffer->data() + blockSize; data += 16) {
+            uint32_t chunkType = U32_AT(data);
+
+            uint8_t hi = chunkType >> 24;
+            uint8_t lo = (chunkType >> 16) & 0xff;
+
+            if (hi < '0' || hi > '9' || lo < '0' || lo > '9') {
+                return ERROR_MALFORMED;
+            }
+
+            size_t trackIndex = 10 * (hi - '0') + (lo - '0');
+
+            if (trackIndex >= mTracks.size()) {
+                return ERROR_MALFORMED;
+            }
+
+            Track *track = &mTracks.editItemAt(trackIndex);
+
+            if (!IsCorrectChunkType(-1, track->mKind, chunkType)) {
+                return ERROR_MALFORMED;
+            }
+
+            if (track->mKind == Track::OTHER || !track->mSegments.isEmpty()) {
+                continue;
+            }
+
+            uint32_t flags = U32LE_AT(&data[4]);
+            uint32_t chunkOffset = U32LE_AT(&data[8]);
+            uint32_t chunkSize = U32LE_AT(&data[12]);
+
+            if (chunkSize & kNotKeyFlag) {
+                return ERROR_MALFORMED;
+            }
+
+            if (chunkSize > track->mMaxSampleSize) {
+                track->mMaxSampleSize = chunkSize;
+            }
+
+            bool isKey = (flags & 0x10) != 0;
+
+            IndexEntry entry;
+            entry.mOffset = chunkOffset;
+            entry.mSize = chunkSize | (isKey ? 0 : kNotKeyFlag);
+
+            if (isKey) {
+                track->mSyncSamples.push(track->mSamples.size());
+                ++track->mNumSyncSamples;
+            }
+
+            track->mSamples.push(entry);
         }
+    }
 
-        size_t trackIndex = 10 * (hi - '0') + (lo - '0');
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        Track *track = &mTracks.editItemAt(i);
 
-        if (trackIndex >= mTracks.size()) {
-            return ERROR_MALFORMED;
+        if (!track->mSegments.isEmpty()) {
+            continue;
         }
 
-        Track *track = &mTracks.editItemAt(trackIndex);
+        track->mNumSamples = track->mSamples.size();
 
-        if (!IsCorrectChunkType(-1, track->mKind, chunkType)) {
-            return ERROR_MALFORMED;
+        if (track->mNumSyncSamples == track->mNumSamples) {
+            // Typically audio, any chunk is a seek point.
+            track->mSyncSamples.clear();
         }
+    }
 
-        if (track->mKind == Track::OTHER) {
-            data += 16;
-            size -= 16;
+    status_t err = checkIndexOffsets();
+
+    if (err != OK) {
+        return err;
+    }
+
+    mFoundIndex = true;
+
+    return OK;
+}
+
+// The idx1 chunk offsets are usually relative to the 'movi' list, but some
+// writers make them absolute: find out from the first chunk.
+status_t AVIExtractor::checkIndexOffsets() {
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        const Track &track = mTracks.itemAt(i);
+
+        if (!track.mSegments.isEmpty() || track.mSamples.isEmpty()) {
             continue;
         }
 
-        uint32_t flags = U32LE_AT(&data[4]);
-        uint32_t offset = U32LE_AT(&data[8]);
-        uint32_t chunkSize = U32LE_AT(&data[12]);
+        const IndexEntry &entry = track.mSamples.itemAt(0);
 
-        if (chunkSize > track->mMaxSampleSize) {
-            track->mMaxSampleSize = chunkSize;
+        for (size_t attempt = 0; attempt < 2; ++attempt) {
+            off64_t offset = entry.mOffset;
+            if (!mOffsetsAreAbsolute) {
+                offset += mMovieOffset + 8;
+            }
+
+            uint8_t tmp[8];
+            ssize_t n = mDataSource->readAt(offset, tmp, 8);
+
+            if (n == 8 && IsCorrectChunkType(i, track.mKind, U32_AT(tmp))) {
+                ALOGV("Chunk offsets are %s",
+                     mOffsetsAreAbsolute ? "absolute" : "movie-chunk relative");
+
+                return OK;
+            }
+
+            mOffsetsAreAbsolute = !mOffsetsAreAbsolute;
         }
 
-        track->mSamples.push();
+        return ERROR_MALFORMED;
+    }
 
-        SampleInfo *info =
-            &track->mSamples.editItemAt(track->mSamples.size() - 1);
+    return OK;
+}
 
-        info->mOffset = offset;
-        info->mIsKey = (flags & 0x10) != 0;
+// An OpenDML super index lists the standard indexes (ix##) of the track, one
+// per RIFF of the file. Only their headers are read here, the entries are
+// loaded when needed by loadSegment_l().
+status_t AVIExtractor::parseSuperIndex(off64_t offset, size_t size) {
+    if (mTracks.isEmpty()) {
+        return ERROR_MALFORMED;
+    }
 
-        if (info->mIsKey) {
-            static const size_t kMaxNumSyncSamplesToScan = 20;
+    Track *track = &mTracks.editItemAt(mTracks.size() - 1);
+
+    if (track->mKind == Track::OTHER) {
+        return OK;
+    }
 
-            if (track->mNumSyncSamples < kMaxNumSyncSamplesToScan) {
-                if (chunkSize > track->mThumbnailSampleSize) {
-                    track->mThumbnailSampleSize = chunkSize;
+    static const uint8_t kIndexOfIndexes = 0x00;
+    static const uint8_t kIndexOfChunks = 0x01;
+    static const size_t kMaxNumSegmentEntries = 1 << 22;
 
-                    track->mThumbnailSampleIndex =
-                        track->mSamples.size() - 1;
-                }
-            }
+    uint8_t header[24];
+    if (size < sizeof(header)) {
+        return ERROR_MALFORMED;
+    }
+
+    ssize_t n = mDataSource->readAt(offset, header, sizeof(header));
+
+    if (n < (ssize_t)sizeof(header)) {
+        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    }
+
+    uint16_t longsPerEntry = U16LE_AT(header);
+    uint8_t indexType = header[3];
+    uint32_t numEntries = U32LE_AT(&header[4]);
+
+    if (indexType != kIndexOfIndexes || longsPerEntry != 4) {
+        ALOGW("Ignoring stream index of type %u", indexType);
+        return OK;
+    }
+
+    if (numEntries > (size - sizeof(header)) / 16) {
+        return ERROR_MALFORMED;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(numEntries * 16);
+    n = mDataSource->readAt(offset + sizeof(header), buffer->data(), buffer->size());
+
+    if (n < (ssize_t)buffer->size()) {
+        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    }
+
+    Vector<IndexSegment> segments;
+    size_t numSamples = 0;
+
+    for (size_t i = 0; i < numEntries; ++i) {
+        const uint8_t *data = buffer->data() + 16 * i;
+
+        IndexSegment segment;
+        segment.mOffset = U64LE_AT(data);
+
+        uint8_t tmp[32];
+        n = mDataSource->readAt(segment.mOffset, tmp, sizeof(tmp));
 
-            ++track->mNumSyncSamples;
+        if (n < (ssize_t)sizeof(tmp)) {
+            return n < 0 ? (status_t)n : ERROR_MALFORMED;
+        }
+
+        uint32_t chunkSize = U32LE_AT(&tmp[4]);
+        uint16_t entryLongs = U16LE_AT(&tmp[8]);
+        uint32_t numChunks = U32LE_AT(&tmp[12]);
+
+        if ((U32_AT(tmp) >> 16) != FOURCC(0, 0, 'i', 'x')
+                || tmp[11] != kIndexOfChunks
+                || entryLongs < 2
+                || chunkSize < 24
+                || numChunks > kMaxNumSegmentEntries
+                || numChunks > (chunkSize - 24) / (entryLongs * 4)) {
+            return ERROR_MALFORMED;
         }
 
-        data += 16;
-        size -= 16;
+        segment.mBaseOffset = U64LE_AT(&tmp[20]);
+        segment.mEntrySize = entryLongs * 4;
+        segment.mFirstSample = numSamples;
+        segment.mNumSamples = numChunks;
+
+        segments.push(segment);
+        numSamples += numChunks;
     }
 
-    if (!mTracks.isEmpty()) {
-        off64_t offset;
-        size_t size;
-        bool isKey;
-        int64_t timeUs;
-        status_t err = getSampleInfo(0, 0, &offset, &size, &isKey, &timeUs);
+    ALOGV("OpenDML index of %zu samples in %zu segments",
+         numSamples, segments.size());
 
-        if (err != OK) {
-            mOffsetsAreAbsolute = !mOffsetsAreAbsolute;
-            err = getSampleInfo(0, 0, &offset, &size, &isKey, &timeUs);
+    track->mSegments = segments;
+    track->mNumSamples = numSamples;
+    track->mLoadedSegment = -1;
+    track->mSamples.clear();
 
-            if (err != OK) {
-                return err;
-            }
+    mFoundIndex = true;
+
+    return OK;
+}
+
+status_t AVIExtractor::loadSegment_l(Track *track, size_t segmentIndex) {
+    if (track->mLoadedSegment == (ssize_t)segmentIndex) {
+        return OK;
+    }
+
+    const IndexSegment &segment = track->mSegments.itemAt(segmentIndex);
+
+    sp<ABuffer> buffer = new ABuffer(segment.mNumSamples * segment.mEntrySize);
+    ssize_t n = mDataSource->readAt(
+            segment.mOffset + 32, buffer->data(), buffer->size());
+
+    if (n < (ssize_t)buffer->size()) {
+        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    }
+
+    track->mLoadedSegment = -1;
+    track->mSamples.clear();
+    track->mSamples.setCapacity(segment.mNumSamples);
+
+    const uint8_t *data = buffer->data();
+    for (size_t i = 0; i < segment.mNumSamples; ++i) {
+        IndexEntry entry;
+        entry.mOffset = U32LE_AT(data);
+        entry.mSize = U32LE_AT(&data[4]);
+
+        size_t chunkSize = entry.mSize & ~kNotKeyFlag;
+        if (chunkSize > track->mMaxSampleSize) {
+            track->mMaxSampleSize = chunkSize;
+        }
+
+        track->mSamples.push(entry);
+        data += segment.mEntrySize;
+    }
+
+    track->mLoadedSegment = segmentIndex;
+
+    ALOGV("Loaded index segment %zu, %zu samples",
+         segmentIndex, segment.mNumSamples);
+
+    return OK;
+}
+
+status_t AVIExtractor::getIndexEntry_l(
+        Track *track, size_t sampleIndex,
+        IndexEntry *entry, off64_t *offset) {
+    if (sampleIndex >= track->mNumSamples) {
+        return -ERANGE;
+    }
+
+    if (track->mSegments.isEmpty()) {
+        *entry = track->mSamples.itemAt(sampleIndex);
+
+        // Skip the chunk header.
+        *offset = entry->mOffset + 8;
+        if (!mOffsetsAreAbsolute) {
+            *offset += mMovieOffset + 8;
         }
 
-        ALOGV("Chunk offsets are %s",
-             mOffsetsAreAbsolute ? "absolute" : "movie-chunk relative");
+        return OK;
+    }
+
+    // The last segment starting at or before sampleIndex, which is never
+    // empty since sampleIndex < mNumSamples.
+    size_t lo = 0;
+    size_t hi = track->mSegments.size();
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (track->mSegments.itemAt(mid).mFirstSample <= sampleIndex) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
     }
 
+    status_t err = loadSegment_l(track, lo);
+
+    if (err != OK) {
+        return err;
+    }
+
+    const IndexSegment &segment = track->mSegments.itemAt(lo);
+
+    *entry = track->mSamples.itemAt(sampleIndex - segment.mFirstSample);
+    *offset = segment.mBaseOffset + entry->mOffset;
+
+    return OK;
+}
+
+status_t AVIExtractor::finishIndex() {
     for (size_t i = 0; i < mTracks.size(); ++i) {
         Track *track = &mTracks.editItemAt(i);
 
+        if (track->mNumSamples == 0) {
+            continue;
+        }
+
         if (track->mBytesPerSample > 0) {
             // Assume all chunks are roughly the same size for now.
 
             // Compute the avg. size of the first 128 chunks (if there are
             // that many), but exclude the size of the first one, since
             // it may be an outlier.
-            size_t numSamplesToAverage = track->mSamples.size();
+            size_t numSamplesToAverage = track->mNumSamples;
             if (numSamplesToAverage > 256) {
                 numSamplesToAverage = 256;
             }
@@ -907,25 +1164,53 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
 
         int64_t durationUs;
         CHECK_EQ((status_t)OK,
-                 getSampleTime(i, track->mSamples.size() - 1, &durationUs));
+                 getSampleTime(i, track->mNumSamples - 1, &durationUs));
 
         ALOGV("track %d duration = %.2f secs", i, durationUs / 1E6);
 
-        track->mMeta->setInt64(kKeyDuration, durationUs);
-        track->mMeta->setInt32(kKeyMaxInputSize, track->mMaxSampleSize);
-
         const char *tmp;
         CHECK(track->mMeta->findCString(kKeyMIMEType, &tmp));
 
         AString mime = tmp;
 
         if (!strncasecmp("video/", mime.c_str(), 6)) {
-            if (track->mThumbnailSampleIndex >= 0) {
-                int64_t thumbnailTimeUs;
-                CHECK_EQ((status_t)OK,
-                         getSampleTime(i, track->mThumbnailSampleIndex,
-                                       &thumbnailTimeUs));
+            // Use the largest of the first few key frames as the thumbnail.
+            static const size_t kMaxNumSyncSamplesToScan = 20;
+            static const size_t kMaxNumSamplesToScan = 10000;
 
+            size_t numSyncSamples = 0;
+            size_t thumbnailSampleSize = 0;
+            int64_t thumbnailTimeUs = -1ll;
+
+            for (size_t j = 0;
+                    j < track->mNumSamples && j < kMaxNumSamplesToScan
+                        && numSyncSamples < kMaxNumSyncSamplesToScan;
+                    ++j) {
+                off64_t offset;
+                size_t size;
+                bool isKey;
+                int64_t timeUs;
+
+                status_t err =
+                    getSampleInfo(i, j, &offset, &size, &isKey, &timeUs);
+
+                if (err != OK) {
+                    return err;
+                }
+
+                if (!isKey) {
+                    continue;
+                }
+
+                ++numSyncSamples;
+
+                if (size > thumbnailSampleSize) {
+                    thumbnailSampleSize = size;
+                    thumbnailTimeUs = timeUs;
+                }
+            }
+
+            if (thumbnailTimeUs >= 0ll) {
                 track->mMeta->setInt64(kKeyThumbnailTime, thumbnailTimeUs);
             }
 
@@ -941,9 +1226,16 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
                 return err;
             }
         }
-    }
 
-    mFoundIndex = true;
+        if (!track->mSegments.isEmpty()
+                && track->mSuggestedBufferSize > track->mMaxSampleSize) {
+            // Only the segments loaded so far were scanned.
+            track->mMaxSampleSize = track->mSuggestedBufferSize;
+        }
+
+        track->mMeta->setInt64(kKeyDuration, durationUs);
+        track->mMeta->setInt32(kKeyMaxInputSize, track->mMaxSampleSize);
+    }
 
     return OK;
 }
@@ -1109,53 +1401,35 @@ status_t AVIExtractor::getSampleInfo(
         return -ERANGE;
     }
 
-    const Track &track = mTracks.itemAt(trackIndex);
+    Mutex::Autolock autoLock(mLock);
 
-    if (sampleIndex >= track.mSamples.size()) {
-        return -ERANGE;
-    }
-
-    const SampleInfo &info = track.mSamples.itemAt(sampleIndex);
-
-    if (!mOffsetsAreAbsolute) {
-        *offset = info.mOffset + mMovieOffset + 8;
-    } else {
-        *offset = info.mOffset;
-    }
-
-    *size = 0;
-
-    uint8_t tmp[8];
-    ssize_t n = mDataSource->readAt(*offset, tmp, 8);
-
-    if (n < 8) {
-        return n < 0 ? (status_t)n : (status_t)ERROR_MALFORMED;
-    }
+    Track *track = &mTracks.editItemAt(trackIndex);
 
-    uint32_t chunkType = U32_AT(tmp);
+    // The chunk size is taken from the index, the chunk header in the file
+    // is not read.
+    IndexEntry entry;
+    status_t err = getIndexEntry_l(track, sampleIndex, &entry, offset);
 
-    if (!IsCorrectChunkType(trackIndex, track.mKind, chunkType)) {
-        return ERROR_MALFORMED;
+    if (err != OK) {
+        return err;
     }
 
-    *offset += 8;
-    *size = U32LE_AT(&tmp[4]);
+    *size = entry.mSize & ~kNotKeyFlag;
+    *isKey = (entry.mSize & kNotKeyFlag) == 0;
 
-    *isKey = info.mIsKey;
-
-    if (track.mBytesPerSample > 0) {
+    if (track->mBytesPerSample > 0) {
         size_t sampleStartInBytes;
         if (sampleIndex == 0) {
             sampleStartInBytes = 0;
         } else {
             sampleStartInBytes =
-                track.mFirstChunkSize + track.mAvgChunkSize * (sampleIndex - 1);
+                track->mFirstChunkSize + track->mAvgChunkSize * (sampleIndex - 1);
         }
 
-        sampleIndex = sampleStartInBytes / track.mBytesPerSample;
+        sampleIndex = sampleStartInBytes / track->mBytesPerSample;
     }
 
-    *sampleTimeUs = (sampleIndex * 1000000ll * track.mRate) / track.mScale;
+    *sampleTimeUs = (sampleIndex * 1000000ll * track->mRate) / track->mScale;
 
     return OK;
 }
@@ -1172,11 +1446,13 @@ status_t AVIExtractor::getSampleTime(
 status_t AVIExtractor::getSampleIndexAtTime(
         size_t trackIndex,
         int64_t timeUs, MediaSource::ReadOptions::SeekMode mode,
-        size_t *sampleIndex) const {
+        size_t *sampleIndex) {
     if (trackIndex >= mTracks.size()) {
         return -ERANGE;
     }
 
+    Mutex::Autolock autoLock(mLock);
+
     const Track &track = mTracks.itemAt(trackIndex);
 
     ssize_t closestSampleIndex;
@@ -1198,7 +1474,11 @@ status_t AVIExtractor::getSampleIndexAtTime(
         closestSampleIndex = timeUs / track.mRate * track.mScale / 1000000ll;
     }
 
-    ssize_t numSamples = track.mSamples.size();
+    ssize_t numSamples = track.mNumSamples;
+
+    if (numSamples == 0) {
+        return ERROR_END_OF_STREAM;
+    }
 
     if (closestSampleIndex < 0) {
         closestSampleIndex = 0;
@@ -1212,28 +1492,14 @@ status_t AVIExtractor::getSampleIndexAtTime(
         return OK;
     }
 
-    ssize_t prevSyncSampleIndex = closestSampleIndex;
-    while (prevSyncSampleIndex >= 0) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(prevSyncSampleIndex);
-
-        if (info.mIsKey) {
-            break;
-        }
-
-        --prevSyncSampleIndex;
-    }
-
-    ssize_t nextSyncSampleIndex = closestSampleIndex;
-    while (nextSyncSampleIndex < numSamples) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(nextSyncSampleIndex);
-
-        if (info.mIsKey) {
-            break;
-        }
+    ssize_t prevSyncSampleIndex;
+    ssize_t nextSyncSampleIndex;
+    status_t err = findSyncSamples_l(
+            &mTracks.editItemAt(trackIndex), closestSampleIndex,
+            &prevSyncSampleIndex, &nextSyncSampleIndex);
 
-        ++nextSyncSampleIndex;
+    if (err != OK) {
+        return err;
     }
 
     switch (mode) {
@@ -1282,6 +1548,85 @@ status_t AVIExtractor::getSampleIndexAtTime(
     }
 }
 
+// Finds the key frames at or before, and at or after sampleIndex: -1 and
+// mNumSamples respectively if there is none.
+status_t AVIExtractor::findSyncSamples_l(
+        Track *track, size_t sampleIndex,
+        ssize_t *prevSyncSampleIndex, ssize_t *nextSyncSampleIndex) {
+    ssize_t numSamples = track->mNumSamples;
+
+    if (track->mSegments.isEmpty()) {
+        if (track->mNumSyncSamples == track->mNumSamples) {
+            *prevSyncSampleIndex = sampleIndex;
+            *nextSyncSampleIndex = sampleIndex;
+            return OK;
+        }
+
+        // The first key frame after sampleIndex.
+        const Vector<uint32_t> &syncSamples = track->mSyncSamples;
+        size_t lo = 0;
+        size_t hi = syncSamples.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (syncSamples.itemAt(mid) <= sampleIndex) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        if (lo > 0 && syncSamples.itemAt(lo - 1) == sampleIndex) {
+            *prevSyncSampleIndex = sampleIndex;
+            *nextSyncSampleIndex = sampleIndex;
+        } else {
+            *prevSyncSampleIndex = lo > 0 ? (ssize_t)syncSamples.itemAt(lo - 1) : -1;
+            *nextSyncSampleIndex =
+                lo < syncSamples.size() ? (ssize_t)syncSamples.itemAt(lo) : numSamples;
+        }
+        return OK;
+    }
+
+    // OpenDML segments are scanned, loading the neighbouring segments only
+    // when the segment of sampleIndex has no key frame on that side.
+    IndexEntry entry;
+    off64_t offset;
+
+    ssize_t prev = sampleIndex;
+    while (prev >= 0) {
+        status_t err = getIndexEntry_l(track, prev, &entry, &offset);
+
+        if (err != OK) {
+            return err;
+        }
+
+        if ((entry.mSize & kNotKeyFlag) == 0) {
+            break;
+        }
+
+        --prev;
+    }
+
+    ssize_t next = sampleIndex;
+    while (next < numSamples) {
+        status_t err = getIndexEntry_l(track, next, &entry, &offset);
+
+        if (err != OK) {
+            return err;
+        }
+
+        if ((entry.mSize & kNotKeyFlag) == 0) {
+            break;
+        }
+
+        ++next;
+    }
+
+    *prevSyncSampleIndex = prev;
+    *nextSyncSampleIndex = next;
+
+    return OK;
+}
+
 bool SniffAVI(
         const sp<DataSource> &source, String8 *mimeType, float *confidence,
         sp<AMessage> *) {
@@ -106,6 +106,8 @@ AudioSource::~AudioSource() {
     if (mStarted) {
         reset();
     }
+    Mutex::Autolock autoLock(mLock);
+    releaseFreeBuffers_l();
 }
 
 status_t AudioSource::initCheck() const {
@@ -159,11 +161,59 @@ void AudioSource::releaseQueuedFrames_l() {
     List<MediaBuffer *>::iterator it;
     while (!mBuffersReceived.empty()) {
         it = mBuffersReceived.begin();
-        (*it)->release();
+        recycleBuffer_l(*it);
         mBuffersReceived.erase(it);
     }
 }
 
+MediaBuffer *AudioSource::acquireBuffer_l(size_t size) {
+    if (size <= kMaxBufferSize) {
+        if (!mFreeBuffers.empty()) {
+            MediaBuffer *buffer = *mFreeBuffers.begin();
+            mFreeBuffers.erase(mFreeBuffers.begin());
+            return buffer;
+        }
+        size = kMaxBufferSize;
+    }
+    return new MediaBuffer(size);
+}
+
+void AudioSource::recycleBuffer_l(MediaBuffer *buffer) {
+    if (buffer->size() != kMaxBufferSize || mFreeBuffers.size() >= kMaxFreeBuffers) {
+        buffer->release();
+        return;
+    }
+    buffer->meta_data()->clear();
+    buffer->set_range(0, buffer->size());
+    mFreeBuffers.push_back(buffer);
+}
+
+void AudioSource::releaseFreeBuffers_l() {
+    while (!mFreeBuffers.empty()) {
+        (*mFreeBuffers.begin())->release();
+        mFreeBuffers.erase(mFreeBuffers.begin());
+    }
+}
+
+void AudioSource::coalesceQueuedFrames_l(MediaBuffer *buffer) {
+    // The queued buffers are contiguous in time, the first timestamp and drift
+    // time apply to the merged buffer.
+    size_t length = buffer->range_length();
+    while (!mBuffersReceived.empty()) {
+        MediaBuffer *next = *mBuffersReceived.begin();
+        const size_t nextLength = next->range_length();
+        if (buffer->range_offset() + length + nextLength > buffer->size()) {
+            break;
+        }
+        memcpy((uint8_t *)buffer->data() + buffer->range_offset() + length,
+                (const uint8_t *)next->data() + next->range_offset(), nextLength);
+        length += nextLength;
+        mBuffersReceived.erase(mBuffersReceived.begin());
+        recycleBuffer_l(next);
+    }
+    buffer->set_range(buffer->range_offset(), length);
+}
+
 void AudioSource::waitOutstandingEncodingFrames_l() {
     ALOGV("waitOutstandingEncodingFrames_l: %" PRId64, mNumClientOwnedBuffers);
     while (mNumClientOwnedBuffers > 0) {
@@ -263,6 +313,12 @@ status_t AudioSource::read(
     int64_t timeUs;
     CHECK(buffer->meta_data()->findInt64(kKeyTime, &timeUs));
     int64_t elapsedTimeUs = timeUs - mStartTimeUs;
+    if (elapsedTimeUs >= kAutoRampStartUs + kAutoRampDurationUs) {
+        // When the encoder has fallen behind, hand it everything that is queued
+        // at once instead of one callback's worth per read. Not done during the
+        // ramp, which is applied per buffer.
+        coalesceQueuedFrames_l(buffer);
+    }
     if (elapsedTimeUs < kAutoRampStartUs) {
         memset((uint8_t *) buffer->data(), 0, buffer->range_length());
     } else if (elapsedTimeUs < kAutoRampStartUs + kAutoRampDurationUs) {
@@ -301,7 +357,7 @@ void AudioSource::signalBufferReturned(MediaBuffer *buffer) {
     Mutex::Autolock autoLock(mLock);
     --mNumClientOwnedBuffers;
     buffer->setObserver(0);
-    buffer->release();
+    recycleBuffer_l(buffer);
     mFrameEncodingCompletionCondition.signal();
     return;
 }
@@ -359,7 +415,7 @@ status_t AudioSource::dataCallback(const AudioRecord::Buffer& audioBuffer) {
         } else {
             numLostBytes = 0;
         }
-        MediaBuffer *lostAudioBuffer = new MediaBuffer(bufferSize);
+        MediaBuffer *lostAudioBuffer = acquireBuffer_l(bufferSize);
         memset(lostAudioBuffer->data(), 0, bufferSize);
         lostAudioBuffer->set_range(0, bufferSize);
         queueInputBuffer_l(lostAudioBuffer, timeUs);
@@ -371,7 +427,7 @@ status_t AudioSource::dataCallback(const AudioRecord::Buffer& audioBuffer) {
     }
 
     const size_t bufferSize = audioBuffer.size;
-    MediaBuffer *buffer = new MediaBuffer(bufferSize);
+    MediaBuffer *buffer = acquireBuffer_l(bufferSize);
     memcpy((uint8_t *) buffer->data(),
             audioBuffer.i16, audioBuffer.size);
     buffer->set_range(0, bufferSize);
@@ -384,7 +440,7 @@ void AudioSource::queueInputBuffer_l(MediaBuffer *buffer, int64_t timeUs) {
         if (!mBuffersReceived.empty()) {
             releaseQueuedFrames_l();
         }
-        buffer->release();
+        recycleBuffer_l(buffer);
         return;
     }
 
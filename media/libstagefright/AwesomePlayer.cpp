@@ -73,6 +73,16 @@ static int64_t kHighWaterMarkUs = 5000000ll;  // 5secs
 static const size_t kLowWaterMarkBytes = 40000;
 static const size_t kHighWaterMarkBytes = 200000;
 
+// Buffering updates are driven by the cache's status callbacks, which are
+// issued whenever this much data has been fetched or consumed, and are
+// reported at most once per kBufferingUpdateIntervalUs. The periodic update
+// only remains as a safety net, and is posted with a tolerance so that it
+// can share a wakeup with the other events.
+static const size_t kCacheStatusGranularityBytes = 256 * 1024;
+static const int64_t kBufferingUpdateIntervalUs = 1000000ll;
+static const int64_t kCacheStatusFallbackUs = 5000000ll;
+static const int64_t kPeriodicEventToleranceUs = 250000ll;
+
 // maximum time in paused state when offloading audio decompression. When elapsed, the AudioPlayer
 // is destroyed to allow the audio DSP to power down.
 static int64_t kOffloadPauseMaxUs = 10000000ll;
@@ -228,6 +238,10 @@ AwesomePlayer::AwesomePlayer()
     mStreamDoneEventPending = false;
     mBufferingEvent = new AwesomeEvent(this, &AwesomePlayer::onBufferingUpdate);
     mBufferingEventPending = false;
+    mBufferingEventTimeUs = -1;
+    mLastBufferingUpdateUs = -1;
+    mCacheStatusEvent = new AwesomeEvent(this, &AwesomePlayer::onCacheStatusChanged);
+    mCacheStatusEventPending = false;
     mVideoLagEvent = new AwesomeEvent(this, &AwesomePlayer::onVideoLagUpdate);
     mVideoLagEventPending = false;
 
@@ -276,6 +290,11 @@ void AwesomePlayer::cancelPlayerEvents(bool keepNotifications) {
 
         mQueue.cancelEvent(mBufferingEvent->eventID());
         mBufferingEventPending = false;
+        {
+            Mutex::Autolock autoLock(mCacheStatusLock);
+            mQueue.cancelEvent(mCacheStatusEvent->eventID());
+            mCacheStatusEventPending = false;
+        }
         mAudioTearDown = false;
     }
 }
@@ -565,6 +584,10 @@ void AwesomePlayer::reset_l() {
     cancelPlayerEvents();
 
     mWVMExtractor.clear();
+    if (mCachedSource != NULL) {
+        // The extractors may keep the source alive for a little longer.
+        mCachedSource->setStatusListener(NULL, NULL, 0);
+    }
     mCachedSource.clear();
     mAudioTrack.clear();
     mVideoTrack.clear();
@@ -724,6 +747,7 @@ void AwesomePlayer::onBufferingUpdate() {
         return;
     }
     mBufferingEventPending = false;
+    mLastBufferingUpdateUs = ALooper::GetNowUs();
 
     if (mCachedSource != NULL) {
         status_t finalStatus;
@@ -831,8 +855,59 @@ void AwesomePlayer::onBufferingUpdate() {
     }
 
     if (mFlags & (PLAYING | PREPARING | CACHE_UNDERRUN)) {
-        postBufferingEvent_l();
+        // The widevine extractor does its own caching and has to be polled.
+        postBufferingEvent_l(
+                mCachedSource != NULL ? kCacheStatusFallbackUs : kBufferingUpdateIntervalUs);
+    }
+}
+
+// static
+void AwesomePlayer::OnCacheStatus(void *cookie) {
+    static_cast<AwesomePlayer *>(cookie)->postCacheStatusEvent();
+}
+
+// Called on the cache's threads, which must not block on mLock, see
+// NuCachedSource2::setStatusListener().
+void AwesomePlayer::postCacheStatusEvent() {
+    Mutex::Autolock autoLock(mCacheStatusLock);
+    if (mCacheStatusEventPending) {
+        return;
+    }
+    mCacheStatusEventPending = true;
+    mQueue.postEvent(mCacheStatusEvent);
+}
+
+void AwesomePlayer::onCacheStatusChanged() {
+    {
+        Mutex::Autolock autoLock(mCacheStatusLock);
+        if (!mCacheStatusEventPending) {
+            return;
+        }
+        mCacheStatusEventPending = false;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    if (mCachedSource == NULL || !(mFlags & (PLAYING | PREPARING | CACHE_UNDERRUN))) {
+        return;
+    }
+
+    // Brings the next buffering update forward, but keeps it at most one per
+    // kBufferingUpdateIntervalUs while the cache fills quickly.
+    int64_t nowUs = ALooper::GetNowUs();
+    int64_t whenUs = nowUs;
+    if (mLastBufferingUpdateUs >= 0
+            && mLastBufferingUpdateUs + kBufferingUpdateIntervalUs > nowUs) {
+        whenUs = mLastBufferingUpdateUs + kBufferingUpdateIntervalUs;
+    }
+
+    if (mBufferingEventPending) {
+        if (mBufferingEventTimeUs <= whenUs) {
+            return;
+        }
+        mQueue.cancelEvent(mBufferingEvent->eventID());
+        mBufferingEventPending = false;
     }
+    postBufferingEvent_l(whenUs - nowUs);
 }
 
 void AwesomePlayer::sendCacheStats() {
@@ -2112,12 +2187,15 @@ void AwesomePlayer::postStreamDoneEvent_l(status_t status) {
     mQueue.postEvent(mStreamDoneEvent);
 }
 
-void AwesomePlayer::postBufferingEvent_l() {
+void AwesomePlayer::postBufferingEvent_l(int64_t delayUs) {
     if (mBufferingEventPending) {
         return;
     }
     mBufferingEventPending = true;
-    mQueue.postEventWithDelay(mBufferingEvent, 1000000ll);
+    mBufferingEventTimeUs = ALooper::GetNowUs() + delayUs;
+    // An update brought forward by the cache is posted without tolerance.
+    mQueue.postEventWithDelay(mBufferingEvent, delayUs,
+            delayUs < kBufferingUpdateIntervalUs ? 0 : kPeriodicEventToleranceUs);
 }
 
 void AwesomePlayer::postVideoLagEvent_l() {
@@ -2125,7 +2203,7 @@ void AwesomePlayer::postVideoLagEvent_l() {
         return;
     }
     mVideoLagEventPending = true;
-    mQueue.postEventWithDelay(mVideoLagEvent, 1000000ll);
+    mQueue.postEventWithDelay(mVideoLagEvent, 1000000ll, kPeriodicEventToleranceUs);
 }
 
 void AwesomePlayer::postCheckAudioStatusEvent(int64_t delayUs) {
@@ -2309,6 +2387,8 @@ status_t AwesomePlayer::finishSetDataSource_l() {
                     cacheConfig.isEmpty() ? NULL : cacheConfig.string(),
                     disconnectAtHighwatermark);
 #endif
+            mCachedSource->setStatusListener(
+                    &OnCacheStatus, this, kCacheStatusGranularityBytes);
 
             dataSource = mCachedSource;
         } else {
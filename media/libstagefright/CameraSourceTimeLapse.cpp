@@ -28,6 +28,7 @@
 #include <media/stagefright/MetaData.h>
 #include <camera/Camera.h>
 #include <camera/CameraParameters.h>
+#include <cutils/properties.h>
 #include <utils/String8.h>
 #include <utils/Vector.h>
 
@@ -93,6 +94,10 @@ CameraSourceTimeLapse::CameraSourceTimeLapse(
         mInitCheck = NO_INIT;
     }
 
+    if (OK == mInitCheck && property_get_bool("ro.camera.time_lapse_low_fps", false)) {
+        trySettingCaptureFpsRange();
+    }
+
     // Initialize quick stop variables.
     mQuickStop = false;
     mForceRead = false;
@@ -167,6 +172,59 @@ bool CameraSourceTimeLapse::trySettingVideoSize(
     return isSuccessful;
 }
 
+bool CameraSourceTimeLapse::trySettingCaptureFpsRange() {
+    ALOGV("trySettingCaptureFpsRange");
+    if (mTimeBetweenFrameCaptureUs <= mTimeBetweenTimeLapseVideoFramesUs) {
+        // Slow motion, or no time lapse at all.
+        return false;
+    }
+    // Smallest fps range maximum, in fps * 1000, that still produces one frame
+    // per capture interval.
+    const int64_t neededFps = (1000000000ll + mTimeBetweenFrameCaptureUs - 1)
+            / mTimeBetweenFrameCaptureUs;
+
+    int64_t token = IPCThreadState::self()->clearCallingIdentity();
+    CameraParameters params(mCamera->getParameters());
+
+    int currentMin = -1, currentMax = -1;
+    params.getPreviewFpsRange(&currentMin, &currentMax);
+
+    const char *ranges = params.get(CameraParameters::KEY_SUPPORTED_PREVIEW_FPS_RANGE);
+    int bestMin = -1, bestMax = -1;
+    while (ranges != NULL) {
+        int rangeMin, rangeMax;
+        ranges = strchr(ranges, '(');
+        if (ranges == NULL || sscanf(ranges, "(%d,%d)", &rangeMin, &rangeMax) != 2) {
+            break;
+        }
+        ++ranges;
+        if (rangeMax < neededFps) {
+            continue;
+        }
+        if (bestMax < 0 || rangeMax < bestMax
+                || (rangeMax == bestMax && rangeMin < bestMin)) {
+            bestMin = rangeMin;
+            bestMax = rangeMax;
+        }
+    }
+
+    bool isSuccessful = false;
+    if (bestMax > 0 && (currentMax < 0 || bestMax < currentMax)) {
+        String8 range = String8::format("%d,%d", bestMin, bestMax);
+        params.set(CameraParameters::KEY_PREVIEW_FPS_RANGE, range.string());
+        if (mCamera->setParameters(params.flatten()) == OK) {
+            ALOGI("time lapse capture at fps range (%s), was (%d,%d)",
+                    range.string(), currentMin, currentMax);
+            isSuccessful = true;
+        } else {
+            ALOGW("Failed to set preview fps range to (%s)", range.string());
+        }
+    }
+
+    IPCThreadState::self()->restoreCallingIdentity(token);
+    return isSuccessful;
+}
+
 void CameraSourceTimeLapse::signalBufferReturned(MediaBuffer* buffer) {
     ALOGV("signalBufferReturned");
     Mutex::Autolock autoLock(mQuickStopLock);
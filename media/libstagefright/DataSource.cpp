@@ -230,6 +230,19 @@ void DataSource::RegisterDefaultSniffers() {
     gSniffersRegistered = true;
 }
 
+// Number of concurrent range connections for progressive HTTP downloads,
+// "media.stagefright.http-connections", 1 (the default) reads serially.
+static void ConfigureParallelFetch(
+        MediaHTTP *source, const sp<IMediaHTTPService> &httpService) {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.http-connections", value, NULL)) {
+        long n = strtol(value, NULL, 10);
+        if (n > 1 && n <= 8) {
+            source->setParallelConnections(httpService, n);
+        }
+    }
+}
+
 // static
 sp<DataSource> DataSource::CreateFromURI(
         const sp<IMediaHTTPService> &httpService,
@@ -261,7 +274,11 @@ sp<DataSource> DataSource::CreateFromURI(
                 ALOGE("Failed to make http connection from http service!");
                 return NULL;
             }
-            httpSource = AVFactory::get()->createMediaHTTP(conn);
+            MediaHTTP *mediaHTTP = AVFactory::get()->createMediaHTTP(conn);
+            if (!isWidevine) {
+                ConfigureParallelFetch(mediaHTTP, httpService);
+            }
+            httpSource = mediaHTTP;
         }
 
         String8 tmp;
@@ -332,7 +349,9 @@ sp<DataSource> DataSource::CreateMediaHTTP(const sp<IMediaHTTPService> &httpServ
     if (conn == NULL) {
         return NULL;
     } else {
-        return AVFactory::get()->createMediaHTTP(conn);
+        MediaHTTP *mediaHTTP = AVFactory::get()->createMediaHTTP(conn);
+        ConfigureParallelFetch(mediaHTTP, httpService);
+        return mediaHTTP;
     }
 }
 
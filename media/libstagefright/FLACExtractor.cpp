@@ -31,9 +31,17 @@
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <utils/Vector.h>
 
 #include <system/audio.h>
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_FLAC_NEON (true)
+#else
+#define USE_FLAC_NEON (false)
+#endif
+
 namespace android {
 
 class FLACParser;
@@ -159,8 +167,23 @@ private:
     // most recent error reported by libFLAC parser
     FLAC__StreamDecoderErrorStatus mErrorStatus;
 
+    // Without a SEEKTABLE libFLAC seeks by bisection, decoding a frame at each step. Instead
+    // the start of a frame is remembered about every kSeekPointIntervalMs while decoding,
+    // and a seek close enough after one of those points decodes forward from it.
+    enum {
+        kSeekPointIntervalMs = 500,
+    };
+    struct SeekPoint {
+        FLAC__uint64 mSample;
+        FLAC__uint64 mOffset;
+    };
+    bool mHasSeekTable;
+    Vector<SeekPoint> mSeekPoints;  // sorted by sample
+
     status_t init();
     MediaBuffer *readBuffer(bool doSeek, FLAC__uint64 sample);
+    void addSeekPoint(FLAC__uint64 sample, FLAC__uint64 offset);
+    bool seekFromSeekPoint(FLAC__uint64 sample);
 
     // no copy constructor or assignment
     FLACParser(const FLACParser &);
@@ -382,6 +405,10 @@ void FLACParser::metadataCallback(const FLAC__StreamMetadata *metadata)
             mFileMetadata->setCString(kKeyAlbumArtMIME, p->mime_type);
         }
         break;
+    case FLAC__METADATA_TYPE_SEEKTABLE:
+        // libFLAC keeps its own copy and seeks with it
+        mHasSeekTable = metadata->data.seek_table.num_points > 0;
+        break;
     default:
         ALOGW("FLACParser::metadataCallback unexpected type %u", metadata->type);
         break;
@@ -394,33 +421,117 @@ void FLACParser::errorCallback(FLAC__StreamDecoderErrorStatus status)
     mErrorStatus = status;
 }
 
+// Interleaving kernels: 8 and 16 bit samples are output as 16 bit, 24 bit samples as the most
+// significant bits of 32 bit words, hence the shift.
+
+static void copyMono16(short *dst, const int *src, unsigned nSamples, int shift)
+{
+    for (unsigned i = 0; i < nSamples; ++i) {
+        dst[i] = src[i] << shift;
+    }
+}
+
+static void copyStereo16(
+        short *dst, const int *left, const int *right, unsigned nSamples, int shift)
+{
+    unsigned i = 0;
+#if USE_FLAC_NEON
+    const int32x4_t vshift = vdupq_n_s32(shift);
+    for (; i + 8 <= nSamples; i += 8) {
+        int16x8x2_t out;
+        out.val[0] = vcombine_s16(
+                vmovn_s32(vshlq_s32(vld1q_s32(left + i), vshift)),
+                vmovn_s32(vshlq_s32(vld1q_s32(left + i + 4), vshift)));
+        out.val[1] = vcombine_s16(
+                vmovn_s32(vshlq_s32(vld1q_s32(right + i), vshift)),
+                vmovn_s32(vshlq_s32(vld1q_s32(right + i + 4), vshift)));
+        vst2q_s16(dst + 2 * i, out);
+    }
+#endif
+    for (; i < nSamples; ++i) {
+        dst[2 * i] = left[i] << shift;
+        dst[2 * i + 1] = right[i] << shift;
+    }
+}
+
+static void copyMultiCh16(
+        short *dst, const int *const *src, unsigned nSamples, unsigned nChannels, int shift)
+{
+    for (unsigned c = 0; c < nChannels; ++c) {
+        const int *in = src[c];
+        short *out = dst + c;
+        for (unsigned i = 0; i < nSamples; ++i) {
+            *out = in[i] << shift;
+            out += nChannels;
+        }
+    }
+}
+
+static void copyMono24(int32_t *dst, const int *src, unsigned nSamples)
+{
+    for (unsigned i = 0; i < nSamples; ++i) {
+        dst[i] = src[i] << 8;
+    }
+}
+
+static void copyStereo24(int32_t *dst, const int *left, const int *right, unsigned nSamples)
+{
+    unsigned i = 0;
+#if USE_FLAC_NEON
+    for (; i + 4 <= nSamples; i += 4) {
+        int32x4x2_t out;
+        out.val[0] = vshlq_n_s32(vld1q_s32(left + i), 8);
+        out.val[1] = vshlq_n_s32(vld1q_s32(right + i), 8);
+        vst2q_s32(dst + 2 * i, out);
+    }
+#endif
+    for (; i < nSamples; ++i) {
+        dst[2 * i] = left[i] << 8;
+        dst[2 * i + 1] = right[i] << 8;
+    }
+}
+
+static void copyMultiCh24(
+        int32_t *dst, const int *const *src, unsigned nSamples, unsigned nChannels)
+{
+    for (unsigned c = 0; c < nChannels; ++c) {
+        const int *in = src[c];
+        int32_t *out = dst + c;
+        for (unsigned i = 0; i < nSamples; ++i) {
+            *out = in[i] << 8;
+            out += nChannels;
+        }
+    }
+}
+
 void FLACParser::copyBuffer(short *dst, const int *const *src, unsigned nSamples)
 {
     unsigned int nChannels = getChannels();
     unsigned int nBits = getBitsPerSample();
     switch (nBits) {
         case 8:
-            for (unsigned i = 0; i < nSamples; ++i) {
-                for (unsigned c = 0; c < nChannels; ++c) {
-                    *dst++ = src[c][i] << 8;
-                }
-            }
-            break;
         case 16:
-            for (unsigned i = 0; i < nSamples; ++i) {
-                for (unsigned c = 0; c < nChannels; ++c) {
-                    *dst++ = src[c][i];
-                }
+        {
+            const int shift = nBits == 8 ? 8 : 0;
+            if (nChannels == 1) {
+                copyMono16(dst, src[0], nSamples, shift);
+            } else if (nChannels == 2) {
+                copyStereo16(dst, src[0], src[1], nSamples, shift);
+            } else {
+                copyMultiCh16(dst, src, nSamples, nChannels, shift);
             }
             break;
+        }
         case 24:
         case 32:
         {
             int32_t *out = (int32_t *)dst;
-            for (unsigned i = 0; i < nSamples; ++i) {
-                for (unsigned c = 0; c < nChannels; ++c) {
-                    *out++ = src[c][i] << 8;
-                }
+            if (nChannels == 1) {
+                copyMono24(out, src[0], nSamples);
+            } else if (nChannels == 2) {
+                copyStereo24(out, src[0], src[1], nSamples);
+            } else {
+                copyMultiCh24(out, src, nSamples, nChannels);
             }
             break;
         }
@@ -447,7 +558,8 @@ FLACParser::FLACParser(
       mStreamInfoValid(false),
       mWriteRequested(false),
       mWriteCompleted(false),
-      mErrorStatus((FLAC__StreamDecoderErrorStatus) -1)
+      mErrorStatus((FLAC__StreamDecoderErrorStatus) -1),
+      mHasSeekTable(false)
 {
     ALOGV("FLACParser::FLACParser");
     memset(&mStreamInfo, 0, sizeof(mStreamInfo));
@@ -483,6 +595,8 @@ status_t FLACParser::init()
             mDecoder, FLAC__METADATA_TYPE_PICTURE);
     FLAC__stream_decoder_set_metadata_respond(
             mDecoder, FLAC__METADATA_TYPE_VORBIS_COMMENT);
+    FLAC__stream_decoder_set_metadata_respond(
+            mDecoder, FLAC__METADATA_TYPE_SEEKTABLE);
     FLAC__StreamDecoderInitStatus initStatus;
     initStatus = FLAC__stream_decoder_init_stream(
             mDecoder,
@@ -581,12 +695,19 @@ MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
     mWriteRequested = true;
     mWriteCompleted = false;
     if (doSeek) {
-        // We implement the seek callback, so this works without explicit flush
-        if (!FLAC__stream_decoder_seek_absolute(mDecoder, sample)) {
-            ALOGE("FLACParser::readBuffer seek to sample %lld failed", (long long)sample);
-            return NULL;
+        if (seekFromSeekPoint(sample)) {
+            ALOGV("FLACParser::readBuffer seek to sample %lld from seek point",
+                    (long long)sample);
+        } else {
+            mWriteRequested = true;
+            mWriteCompleted = false;
+            // We implement the seek callback, so this works without explicit flush
+            if (!FLAC__stream_decoder_seek_absolute(mDecoder, sample)) {
+                ALOGE("FLACParser::readBuffer seek to sample %lld failed", (long long)sample);
+                return NULL;
+            }
+            ALOGV("FLACParser::readBuffer seek to sample %lld succeeded", (long long)sample);
         }
-        ALOGV("FLACParser::readBuffer seek to sample %lld succeeded", (long long)sample);
     } else {
         if (!FLAC__stream_decoder_process_single(mDecoder)) {
             ALOGE("FLACParser::readBuffer process_single failed");
@@ -630,9 +751,97 @@ MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
     int64_t timeUs = (1000000LL * sampleNumber) / getSampleRate();
     buffer->meta_data()->setInt64(kKeyTime, timeUs);
     buffer->meta_data()->setInt32(kKeyIsSyncFrame, 1);
+
+    // The decode position is now the start of the frame following this one.
+    FLAC__uint64 nextFrameOffset;
+    if (!doSeek && !mHasSeekTable
+            && FLAC__stream_decoder_get_decode_position(mDecoder, &nextFrameOffset)) {
+        addSeekPoint(sampleNumber + blocksize, nextFrameOffset);
+    }
     return buffer;
 }
 
+void FLACParser::addSeekPoint(FLAC__uint64 sample, FLAC__uint64 offset)
+{
+    const FLAC__uint64 interval = (FLAC__uint64)getSampleRate() * kSeekPointIntervalMs / 1000;
+
+    // find the first point after sample
+    size_t lo = 0;
+    size_t hi = mSeekPoints.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mSeekPoints[mid].mSample <= sample) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if ((lo > 0 && sample - mSeekPoints[lo - 1].mSample < interval)
+            || (lo < mSeekPoints.size() && mSeekPoints[lo].mSample - sample < interval)) {
+        return;
+    }
+
+    SeekPoint point;
+    point.mSample = sample;
+    point.mOffset = offset;
+    mSeekPoints.insertAt(point, lo);
+}
+
+// Positions the decoder on the frame containing sample, decoding forward from the closest
+// preceding seek point, and leaves that frame trimmed to start at sample in mWriteHeader and
+// mWriteBuffer, as FLAC__stream_decoder_seek_absolute would. Returns false if there is no
+// seek point close enough before sample.
+bool FLACParser::seekFromSeekPoint(FLAC__uint64 sample)
+{
+    const FLAC__uint64 maxDistance =
+            (FLAC__uint64)getSampleRate() * kSeekPointIntervalMs * 2 / 1000;
+
+    // find the last point at or before sample
+    size_t lo = 0;
+    size_t hi = mSeekPoints.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mSeekPoints[mid].mSample <= sample) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0 || sample - mSeekPoints[lo - 1].mSample > maxDistance) {
+        return false;
+    }
+    const SeekPoint &point = mSeekPoints[lo - 1];
+
+    mCurrentPos = point.mOffset;
+    mEOF = false;
+    if (!FLAC__stream_decoder_flush(mDecoder)) {
+        return false;
+    }
+    for (;;) {
+        mWriteRequested = true;
+        mWriteCompleted = false;
+        if (!FLAC__stream_decoder_process_single(mDecoder) || !mWriteCompleted
+                || mWriteHeader.number_type != FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER) {
+            return false;
+        }
+        const FLAC__uint64 first = mWriteHeader.number.sample_number;
+        const unsigned blocksize = mWriteHeader.blocksize;
+        if (first > sample) {
+            // the seek point did not start a frame
+            return false;
+        }
+        if (sample < first + blocksize) {
+            const unsigned delta = sample - first;
+            for (unsigned channel = 0; channel < mWriteHeader.channels; ++channel) {
+                mWriteBuffer[channel] += delta;
+            }
+            mWriteHeader.blocksize -= delta;
+            mWriteHeader.number.sample_number = sample;
+            return true;
+        }
+    }
+}
+
 // FLACsource
 
 FLACSource::FLACSource(
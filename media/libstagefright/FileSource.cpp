@@ -18,16 +18,33 @@
 #define LOG_TAG "FileSource"
 #include <utils/Log.h>
 
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/FileSource.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
 namespace android {
 
+static const off64_t kPageSize = 4096;
+
+// reads up to kMaxCachedReadSize bytes are served from a kReadCacheSize cache
+static const size_t kReadCacheSize = 64 * 1024;
+static const size_t kMaxCachedReadSize = 16 * 1024;
+
+// after kSequentialReadsForReadahead forward reads, each landing within
+// kReadCacheSize of the end of the previous one, keep the kernel kReadaheadSize
+// ahead of the reader
+static const int32_t kSequentialReadsForReadahead = 4;
+static const off64_t kReadaheadSize = 1024 * 1024;
+
+// largest range mapped when the mmap backend is enabled
+static const int64_t kMaxMappedSize = 256 * 1024 * 1024;
+
 FileSource::FileSource(const char *filename)
     : mFd(-1),
       mUri(filename),
@@ -37,12 +54,22 @@ FileSource::FileSource(const char *filename)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL){
+      mDrmBuf(NULL),
+      mCache(NULL),
+      mCacheOffset(0),
+      mCacheSize(0),
+      mNextSequentialOffset(-1),
+      mSequentialReads(0),
+      mReadaheadEnd(0),
+      mMapping(NULL),
+      mMappingSize(0),
+      mMappedData(NULL) {
 
     mFd = open(filename, O_LARGEFILE | O_RDONLY);
 
     if (mFd >= 0) {
         mLength = lseek64(mFd, 0, SEEK_END);
+        init();
     } else {
         ALOGE("Failed to open file '%s'. (%s)", filename, strerror(errno));
     }
@@ -56,13 +83,60 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL){
+      mDrmBuf(NULL),
+      mCache(NULL),
+      mCacheOffset(0),
+      mCacheSize(0),
+      mNextSequentialOffset(-1),
+      mSequentialReads(0),
+      mReadaheadEnd(0),
+      mMapping(NULL),
+      mMappingSize(0),
+      mMappedData(NULL) {
     CHECK(offset >= 0);
     CHECK(length >= 0);
     fetchUriFromFd(fd);
+    init();
+}
+
+void FileSource::init() {
+    // Mapping the file saves the copy into the read cache, but a file truncated
+    // while mapped makes the reader fault, so it is opt-in and only used for regular
+    // files that hold the whole range.
+    if (!property_get_bool("media.stagefright.filesource-mmap", false)) {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(mFd, &st) != 0 || !S_ISREG(st.st_mode)
+            || mLength <= 0 || mLength > kMaxMappedSize
+            || mOffset + mLength > st.st_size) {
+        return;
+    }
+
+    off64_t mapOffset = mOffset & ~(kPageSize - 1);
+    size_t mapSize = mLength + (mOffset - mapOffset);
+    void *mapping = mmap64(NULL, mapSize, PROT_READ, MAP_SHARED, mFd, mapOffset);
+    if (mapping == MAP_FAILED) {
+        ALOGW("mmap of %s failed (%s)", mUri.string(), strerror(errno));
+        return;
+    }
+    madvise(mapping, mapSize, MADV_SEQUENTIAL);
+
+    mMapping = mapping;
+    mMappingSize = mapSize;
+    mMappedData = (const uint8_t *)mapping + (mOffset - mapOffset);
 }
 
 FileSource::~FileSource() {
+    if (mMapping != NULL) {
+        munmap(mMapping, mMappingSize);
+        mMapping = NULL;
+    }
+
+    free(mCache);
+    mCache = NULL;
+
     if (mFd >= 0) {
         close(mFd);
         mFd = -1;
@@ -110,15 +184,92 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
     if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
             == mDecryptHandle->decryptApiType) {
         return readAtDRM(offset, data, size);
-   } else {
-        off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
-        if (result == -1) {
-            ALOGE("seek to %lld failed", (long long)(offset + mOffset));
-            return UNKNOWN_ERROR;
+    } else if (mMappedData != NULL) {
+        // mLength is known, and size was clipped to it above
+        hintReadahead_l(offset + mOffset, size);
+        memcpy(data, mMappedData + offset, size);
+        return size;
+    } else {
+        return readAtCached_l(offset + mOffset, data, size);
+    }
+}
+
+ssize_t FileSource::readAtCached_l(off64_t fileOffset, void *data, size_t size) {
+    hintReadahead_l(fileOffset, size);
+
+    if (mCacheSize > 0 && fileOffset >= mCacheOffset
+            && fileOffset + (off64_t)size <= mCacheOffset + (off64_t)mCacheSize) {
+        memcpy(data, mCache + (fileOffset - mCacheOffset), size);
+        return size;
+    }
+
+    if (size > kMaxCachedReadSize) {
+        return pread64(mFd, data, size, fileOffset);
+    }
+
+    if (mCache == NULL) {
+        mCache = (uint8_t *)malloc(kReadCacheSize);
+        if (mCache == NULL) {
+            return pread64(mFd, data, size, fileOffset);
         }
+    }
+
+    off64_t cacheOffset = fileOffset & ~(kPageSize - 1);
+    ssize_t n = pread64(mFd, mCache, kReadCacheSize, cacheOffset);
+    if (n < 0) {
+        mCacheSize = 0;
+        return n;
+    }
+    mCacheOffset = cacheOffset;
+    mCacheSize = n;
 
-        return ::read(mFd, data, size);
+    if (fileOffset >= cacheOffset + n) {
+        return 0;  // read beyond EOF.
+    }
+    size_t available = cacheOffset + n - fileOffset;
+    if (size > available) {
+        size = available;
     }
+    memcpy(data, mCache + (fileOffset - cacheOffset), size);
+    return size;
+}
+
+void FileSource::hintReadahead_l(off64_t fileOffset, size_t size) {
+    if (mNextSequentialOffset >= 0 && fileOffset >= mNextSequentialOffset
+            && fileOffset - mNextSequentialOffset <= (off64_t)kReadCacheSize) {
+        if (mSequentialReads < kSequentialReadsForReadahead) {
+            ++mSequentialReads;
+        }
+    } else {
+        mSequentialReads = 0;
+        mReadaheadEnd = 0;
+    }
+    mNextSequentialOffset = fileOffset + size;
+
+    // renew the hint when the reader is half way through the last window
+    if (mSequentialReads < kSequentialReadsForReadahead
+            || mNextSequentialOffset + kReadaheadSize / 2 < mReadaheadEnd) {
+        return;
+    }
+
+    off64_t start = mNextSequentialOffset > mReadaheadEnd
+            ? mNextSequentialOffset : mReadaheadEnd;
+    off64_t end = mNextSequentialOffset + kReadaheadSize;
+    if (mLength >= 0 && end > mOffset + mLength) {
+        end = mOffset + mLength;
+    }
+    if (end <= start) {
+        return;
+    }
+
+    if (mMappedData != NULL) {
+        const uint8_t *base = mMappedData - mOffset;
+        uintptr_t from = (uintptr_t)(base + start) & ~(uintptr_t)(kPageSize - 1);
+        madvise((void *)from, (uintptr_t)(base + end) - from, MADV_WILLNEED);
+    } else {
+        posix_fadvise(mFd, start, end - start, POSIX_FADV_WILLNEED);
+    }
+    mReadaheadEnd = end;
 }
 
 status_t FileSource::getSize(off64_t *size) {
@@ -191,6 +342,28 @@ ssize_t FileSource::readAtDRM(off64_t offset, void *data, size_t size) {
     }
 }
 
+bool FileSource::getFileIdentity(FileIdentity *identity) {
+    Mutex::Autolock autoLock(mLock);
+
+    // DRM protected content is read through the DRM plugin
+    if (mFd < 0 || mDecryptHandle != NULL) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(mFd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+
+    identity->mDevice = st.st_dev;
+    identity->mInode = st.st_ino;
+    identity->mModifiedNs = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+    identity->mFileSize = st.st_size;
+    identity->mOffset = mOffset;
+    identity->mLength = mLength;
+    return true;
+}
+
 void FileSource::fetchUriFromFd(int fd) {
     ssize_t len = 0;
     char path[PATH_MAX] = {0};
@@ -22,6 +22,7 @@
 
 #include "include/avc_utils.h"
 #include "include/ID3.h"
+#include "include/MP3FrameIndex.h"
 #include "include/VBRISeeker.h"
 #include "include/XINGSeeker.h"
 
@@ -247,7 +248,7 @@ private:
 };
 
 MP3Extractor::MP3Extractor(
-        const sp<DataSource> &source, const sp<AMessage> &meta)
+        const sp<DataSource> &source, const sp<AMessage> &meta, bool metaDataOnly)
     : mInitCheck(NO_INIT),
       mDataSource(source),
       mFirstFramePos(-1),
@@ -316,6 +317,10 @@ MP3Extractor::MP3Extractor(
         }
         mFirstFramePos = pos;
         mFixedHeader = header;
+    } else if (!metaDataOnly) {
+        // Without a XING or VBRI table, index the frames rather than estimating positions
+        // and the duration from the first frame's bitrate, which is far off for VBR files.
+        mSeeker = MP3FrameIndex::CreateFromSource(mDataSource, mFirstFramePos, mFixedHeader);
     }
 
     size_t frame_size;
@@ -362,6 +367,11 @@ MP3Extractor::MP3Extractor(
 
     mInitCheck = OK;
 
+    if (metaDataOnly) {
+        // gapless info only matters to the decoder
+        return;
+    }
+
     // Get iTunes-style gapless info if present.
     // When getting the id3 tag, skip the V1 tags to prevent the source cache
     // from being iterated to the end of the file.
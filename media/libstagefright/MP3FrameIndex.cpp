@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MP3FrameIndex"
+#include <utils/Log.h>
+
+#include "include/MP3FrameIndex.h"
+
+#include "include/avc_utils.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/Utils.h>
+
+#include <inttypes.h>
+#include <pthread.h>
+
+namespace android {
+
+// As in MP3Extractor, every header bit but protection, bitrate, padding, private bits, mode,
+// mode extension, copyright bit, original bit and emphasis must match the first frame's.
+static const uint32_t kMask = 0xfffe0c00;
+
+static const size_t kScanBlockSize = 64 * 1024;
+static const size_t kTailHashSize = 4096;
+static const size_t kMaxCachedIndices = 8;
+
+static Mutex gCacheLock;
+static Vector<sp<MP3FrameIndex> > gCache;  // least recently used first
+
+bool MP3FrameIndex::Key::operator==(const Key &other) const {
+    return mFileSize == other.mFileSize
+            && mFirstFramePos == other.mFirstFramePos
+            && mFixedHeader == other.mFixedHeader
+            && mTailHash == other.mTailHash;
+}
+
+// static
+sp<MP3FrameIndex> MP3FrameIndex::CreateFromSource(
+        const sp<DataSource> &source, off64_t first_frame_pos, uint32_t fixed_header) {
+    if (!property_get_bool("media.stagefright.mp3-frame-index", false)) {
+        return NULL;
+    }
+
+    // Scanning a whole file is only cheap if it is on local storage.
+    if (source->flags()
+            & (DataSource::kIsCachingDataSource | DataSource::kIsHTTPBasedSource)) {
+        return NULL;
+    }
+
+    Key key;
+    if (source->getSize(&key.mFileSize) != OK || key.mFileSize <= first_frame_pos) {
+        return NULL;
+    }
+    key.mFirstFramePos = first_frame_pos;
+    key.mFixedHeader = fixed_header & kMask;
+
+    // FNV-1a of the end of the file, which tells apart files that only differ in the
+    // audio data, e.g. after a tag editor rewrote the ID3v1 tag.
+    uint8_t tail[kTailHashSize];
+    size_t tailSize = key.mFileSize < (off64_t)kTailHashSize ? key.mFileSize : kTailHashSize;
+    if (source->readAt(key.mFileSize - tailSize, tail, tailSize) != (ssize_t)tailSize) {
+        return NULL;
+    }
+    key.mTailHash = 2166136261u;
+    for (size_t i = 0; i < tailSize; ++i) {
+        key.mTailHash = (key.mTailHash ^ tail[i]) * 16777619u;
+    }
+
+    size_t frameSize;
+    int sampleRate;
+    int bitrate;
+    int samplesPerFrame;
+    if (!GetMPEGAudioFrameSize(
+                fixed_header, &frameSize, &sampleRate, NULL, &bitrate, &samplesPerFrame)) {
+        return NULL;
+    }
+
+    {
+        Mutex::Autolock autoLock(gCacheLock);
+        for (size_t i = 0; i < gCache.size(); ++i) {
+            if (gCache[i]->mKey == key) {
+                sp<MP3FrameIndex> index = gCache[i];
+                gCache.removeAt(i);
+                gCache.push(index);
+                return index;
+            }
+        }
+    }
+
+    sp<MP3FrameIndex> index = new MP3FrameIndex(key, sampleRate, samplesPerFrame, source);
+
+    // The scanning thread holds a reference of its own until it is done.
+    index->incStrong((void *)ThreadWrapper);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int err = pthread_create(&thread, &attr, ThreadWrapper, index.get());
+    pthread_attr_destroy(&attr);
+
+    if (err != 0) {
+        ALOGW("unable to start the frame index thread: %d", err);
+        index->decStrong((void *)ThreadWrapper);
+        return NULL;
+    }
+
+    Mutex::Autolock autoLock(gCacheLock);
+    if (gCache.size() >= kMaxCachedIndices) {
+        gCache.removeAt(0);
+    }
+    gCache.push(index);
+
+    return index;
+}
+
+MP3FrameIndex::MP3FrameIndex(
+        const Key &key, int sampleRate, int samplesPerFrame, const sp<DataSource> &source)
+    : mKey(key),
+      mSampleRate(sampleRate),
+      mSamplesPerFrame(samplesPerFrame),
+      mNumFrames(0),
+      mComplete(false),
+      mSource(source) {
+}
+
+MP3FrameIndex::~MP3FrameIndex() {
+}
+
+int64_t MP3FrameIndex::frameToTimeUs(int64_t frame) const {
+    return frame * mSamplesPerFrame * 1000000ll / mSampleRate;
+}
+
+bool MP3FrameIndex::getDuration(int64_t *durationUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mComplete) {
+        return false;
+    }
+    *durationUs = frameToTimeUs(mNumFrames);
+    return true;
+}
+
+bool MP3FrameIndex::getOffsetForTime(int64_t *timeUs, off64_t *pos) {
+    Mutex::Autolock autoLock(mLock);
+    if (mEntries.isEmpty()) {
+        return false;
+    }
+
+    const int64_t targetUs = *timeUs < 0 ? 0 : *timeUs;
+    size_t entry = targetUs * mSampleRate / 1000000ll / mSamplesPerFrame / kFramesPerEntry;
+    if (entry >= mEntries.size()) {
+        if (!mComplete) {
+            // Not scanned yet.
+            return false;
+        }
+        entry = mEntries.size() - 1;
+    }
+
+    *pos = mKey.mFirstFramePos + mEntries[entry];
+    *timeUs = frameToTimeUs((int64_t)entry * kFramesPerEntry);
+    return true;
+}
+
+// static
+void *MP3FrameIndex::ThreadWrapper(void *me) {
+    MP3FrameIndex *index = static_cast<MP3FrameIndex *>(me);
+    index->scan();
+    index->decStrong((void *)ThreadWrapper);
+    return NULL;
+}
+
+void MP3FrameIndex::publish(Vector<uint32_t> *entries, int64_t numFrames, bool complete) {
+    Mutex::Autolock autoLock(mLock);
+    mEntries.appendVector(*entries);
+    mNumFrames = numFrames;
+    mComplete = complete;
+    entries->clear();
+}
+
+void MP3FrameIndex::scan() {
+    const int64_t startUs = ALooper::GetNowUs();
+
+    uint8_t *buffer = new uint8_t[kScanBlockSize];
+    off64_t bufferPos = 0;
+    size_t bufferSize = 0;
+
+    Vector<uint32_t> entries;  // published once per block
+    int64_t numFrames = 0;
+    bool reachedEnd = false;
+    off64_t pos = mKey.mFirstFramePos;
+    // Entries are 32 bit offsets, anything beyond 4 GB is left to the bitrate estimate.
+    while (pos - mKey.mFirstFramePos <= (off64_t)0xffffffff) {
+        if (pos + 4 > bufferPos + (off64_t)bufferSize) {
+            publish(&entries, numFrames, false /* complete */);
+
+            ssize_t n = mSource->readAt(pos, buffer, kScanBlockSize);
+            if (n < 4) {
+                reachedEnd = true;
+                break;
+            }
+            bufferPos = pos;
+            bufferSize = n;
+        }
+
+        const uint32_t header = U32_AT(buffer + (pos - bufferPos));
+        size_t frameSize;
+        if ((header & kMask) != mKey.mFixedHeader
+                || !GetMPEGAudioFrameSize(header, &frameSize)) {
+            // Lost sync, or a trailing tag.
+            ++pos;
+            continue;
+        }
+
+        if ((numFrames % kFramesPerEntry) == 0) {
+            entries.push(pos - mKey.mFirstFramePos);
+        }
+        ++numFrames;
+        pos += frameSize;
+    }
+
+    delete[] buffer;
+    buffer = NULL;
+
+    publish(&entries, numFrames, reachedEnd);
+    mSource.clear();
+
+    ALOGV("indexed %" PRId64 " frames, %" PRId64 " us, in %" PRId64 " us",
+            numFrames, frameToTimeUs(numFrames), ALooper::GetNowUs() - startUs);
+}
+
+}  // namespace android
@@ -31,6 +31,7 @@
 #include <arpa/inet.h>
 
 #include "include/ESDS.h"
+#include "mpeg2ts/TSCrc32.h"
 
 namespace android {
 
@@ -498,8 +499,6 @@ MPEG2TSWriter::MPEG2TSWriter(
 void MPEG2TSWriter::init() {
     CHECK(mFile != NULL || mWriteFunc != NULL);
 
-    initCrcTable();
-
     mLooper = new ALooper;
     mLooper->setName("MPEG2TSWriter");
 
@@ -736,7 +735,7 @@ void MPEG2TSWriter::writeProgramAssociationTable() {
     }
     buffer->data()[3] |= mPATContinuityCounter;
 
-    uint32_t crc = htonl(crc32(&buffer->data()[5], 12));
+    uint32_t crc = htonl(ComputeTSCrc32(&buffer->data()[5], 12));
     memcpy(&buffer->data()[17], &crc, sizeof(crc));
 
     CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
@@ -812,7 +811,7 @@ void MPEG2TSWriter::writeProgramMap() {
         *ptr++ = 0x00;
     }
 
-    uint32_t crc = htonl(crc32(&buffer->data()[5], 12+mSources.size()*5));
+    uint32_t crc = htonl(ComputeTSCrc32(&buffer->data()[5], 12+mSources.size()*5));
     memcpy(&buffer->data()[17+mSources.size()*5], &crc, sizeof(crc));
 
     CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
@@ -855,8 +854,19 @@ void MPEG2TSWriter::writeAccessUnit(
     // reserved = b1
     // the first fragment of "buffer" follows
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
+    // All packets of the access unit are built in mPacketBuffer and written at once. The first
+    // packet carries up to 170 bytes of payload, every following one 184.
+    size_t numPackets = 1;
+    if (accessUnit->size() > 188 - 18) {
+        numPackets += (accessUnit->size() - (188 - 18) + 183) / 184;
+    }
+    if (mPacketBuffer == NULL || mPacketBuffer->capacity() < numPackets * 188) {
+        mPacketBuffer = new ABuffer(numPackets * 188);
+    }
+    mPacketBuffer->setRange(0, numPackets * 188);
+    memset(mPacketBuffer->data(), 0xff, mPacketBuffer->size());
+
+    uint8_t *packet = mPacketBuffer->data();
 
     const unsigned PID = 0x1e0 + sourceIndex + 1;
 
@@ -884,7 +894,7 @@ void MPEG2TSWriter::writeAccessUnit(
         PES_packet_length = 0;
     }
 
-    uint8_t *ptr = buffer->data();
+    uint8_t *ptr = packet;
     *ptr++ = 0x47;
     *ptr++ = 0x40 | (PID >> 8);
     *ptr++ = PID & 0xff;
@@ -912,15 +922,14 @@ void MPEG2TSWriter::writeAccessUnit(
     *ptr++ = (PTS >> 7) & 0xff;
     *ptr++ = ((PTS & 0x7f) << 1) | 1;
 
-    size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+    size_t sizeLeft = packet + 188 - ptr;
     size_t copy = accessUnit->size();
     if (copy > sizeLeft) {
         copy = sizeLeft;
     }
 
     memcpy(ptr, accessUnit->data(), copy);
-
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    packet += 188;
 
     size_t offset = copy;
     while (offset < accessUnit->size()) {
@@ -936,12 +945,10 @@ void MPEG2TSWriter::writeAccessUnit(
         // continuity_counter = b????
         // the fragment of "buffer" follows.
 
-        memset(buffer->data(), 0xff, buffer->size());
-
         const unsigned continuity_counter =
             mSources.editItemAt(sourceIndex)->incrementContinuityCounter();
 
-        ptr = buffer->data();
+        ptr = packet;
         *ptr++ = 0x47;
         *ptr++ = 0x00 | (PID >> 8);
         *ptr++ = PID & 0xff;
@@ -958,18 +965,23 @@ void MPEG2TSWriter::writeAccessUnit(
             }
         }
 
-        size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+        size_t sizeLeft = packet + 188 - ptr;
         size_t copy = accessUnit->size() - offset;
         if (copy > sizeLeft) {
             copy = sizeLeft;
         }
 
         memcpy(ptr, accessUnit->data() + offset, copy);
-        CHECK_EQ(internalWrite(buffer->data(), buffer->size()),
-                 buffer->size());
+        packet += 188;
 
         offset += copy;
     }
+
+    CHECK_EQ((size_t)(packet - mPacketBuffer->data()), mPacketBuffer->size());
+    CHECK_EQ(internalWrite(mPacketBuffer->data(), mPacketBuffer->size()),
+             mPacketBuffer->size());
+
+    mNumTSPacketsWritten += numPackets;
 }
 
 void MPEG2TSWriter::writeTS() {
@@ -981,33 +993,6 @@ void MPEG2TSWriter::writeTS() {
     }
 }
 
-void MPEG2TSWriter::initCrcTable() {
-    uint32_t poly = 0x04C11DB7;
-
-    for (int i = 0; i < 256; i++) {
-        uint32_t crc = i << 24;
-        for (int j = 0; j < 8; j++) {
-            crc = (crc << 1) ^ ((crc & 0x80000000) ? (poly) : 0);
-        }
-        mCrcTable[i] = crc;
-    }
-}
-
-/**
- * Compute CRC32 checksum for buffer starting at offset start and for length
- * bytes.
- */
-uint32_t MPEG2TSWriter::crc32(const uint8_t *p_start, size_t length) {
-    uint32_t crc = 0xFFFFFFFF;
-    const uint8_t *p;
-
-    for (p = p_start; p < p_start + length; p++) {
-        crc = (crc << 8) ^ mCrcTable[((crc >> 24) ^ *p) & 0xFF];
-    }
-
-    return crc;
-}
-
 ssize_t MPEG2TSWriter::internalWrite(const void *data, size_t size) {
     if (mFile != NULL) {
         return fwrite(data, 1, size, mFile);
@@ -27,6 +27,7 @@
 
 #include "include/MPEG4Extractor.h"
 #include "include/SampleTable.h"
+#include "include/SampleTableCache.h"
 #include "include/ESDS.h"
 
 #include <media/stagefright/foundation/ABitReader.h>
@@ -56,6 +57,8 @@ enum {
     kMaxAtomSize = 64 * 1024 * 1024,
 };
 
+struct MPEG4DataSource;
+
 class MPEG4Source : public MediaSource {
 public:
     // Caller retains ownership of both "dataSource" and "sampleTable".
@@ -75,6 +78,8 @@ public:
 
     virtual status_t read(MediaBuffer **buffer, const ReadOptions *options = NULL);
     virtual status_t fragmentedRead(MediaBuffer **buffer, const ReadOptions *options = NULL);
+    virtual status_t readInto(
+            void *data, size_t size, MediaBuffer **buffer, const ReadOptions *options = NULL);
 
 protected:
     virtual ~MPEG4Source();
@@ -94,7 +99,17 @@ private:
     const Trex *mTrex;
     off64_t mFirstMoofOffset;
     off64_t mCurrentMoofOffset;
-    off64_t mNextMoofOffset;
+
+    // Fragment headers are parsed from a copy of the whole moof box, read at once, in
+    // mFragmentSource; mHeaderSource is mFragmentSource for fragmented files and
+    // mDataSource otherwise.
+    sp<MPEG4DataSource> mFragmentSource;
+    sp<DataSource> mHeaderSource;
+
+    // Where to look for the moof following the current one, or -1. The search is only
+    // done once the current fragment is used up, so that a streamed source is not made
+    // to read past the mdat it is delivering, and a growing file can gain fragments.
+    off64_t mNextMoofSearchOffset;
     uint32_t mCurrentTime;
     int32_t mLastParsedTrackId;
     int32_t mTrackId;
@@ -122,12 +137,19 @@ private:
 
     MediaBuffer *mBuffer;
 
+    // Set by readInto() for the duration of one read, the next sample is
+    // written here instead of to a buffer from mGroup.
+    void *mCallerData;
+    size_t mCallerSize;
+
     bool mWantsNALFragments;
 
     uint8_t *mSrcBuffer;
 
     size_t parseNALSize(const uint8_t *data) const;
+    status_t acquireBuffer_l();
     status_t parseChunk(off64_t *offset);
+    status_t findNextMoof(off64_t *offset);
     status_t parseTrackFragmentHeader(off64_t offset, off64_t size);
     status_t parseTrackFragmentRun(off64_t offset, off64_t size);
     status_t parseSampleAuxiliaryInformationSizes(off64_t offset, off64_t size);
@@ -196,6 +218,7 @@ private:
     sp<DataSource> mSource;
     off64_t mCachedOffset;
     size_t mCachedSize;
+    size_t mCacheCapacity;
     uint8_t *mCache;
 
     void clearCache();
@@ -208,6 +231,7 @@ MPEG4DataSource::MPEG4DataSource(const sp<DataSource> &source)
     : mSource(source),
       mCachedOffset(0),
       mCachedSize(0),
+      mCacheCapacity(0),
       mCache(NULL) {
 }
 
@@ -223,6 +247,7 @@ void MPEG4DataSource::clearCache() {
 
     mCachedOffset = 0;
     mCachedSize = 0;
+    mCacheCapacity = 0;
 }
 
 status_t MPEG4DataSource::initCheck() const {
@@ -251,12 +276,16 @@ uint32_t MPEG4DataSource::flags() {
 status_t MPEG4DataSource::setCachedRange(off64_t offset, size_t size) {
     Mutex::Autolock autoLock(mLock);
 
-    clearCache();
+    // reuse the allocation when moving along fragments of similar size
+    if (mCache == NULL || size > mCacheCapacity) {
+        clearCache();
 
-    mCache = (uint8_t *)malloc(size);
+        mCache = (uint8_t *)malloc(size);
 
-    if (mCache == NULL) {
-        return -ENOMEM;
+        if (mCache == NULL) {
+            return -ENOMEM;
+        }
+        mCacheCapacity = size;
     }
 
     mCachedOffset = offset;
@@ -371,11 +400,12 @@ static bool AdjustChannelsAndRate(uint32_t fourcc, uint32_t *channels, uint32_t
     return false;
 }
 
-MPEG4Extractor::MPEG4Extractor(const sp<DataSource> &source)
+MPEG4Extractor::MPEG4Extractor(const sp<DataSource> &source, bool metaDataOnly)
     : mMoofOffset(0),
       mMoofFound(false),
       mMdatFound(false),
       mDataSource(source),
+      mMetaDataOnly(metaDataOnly),
       mInitCheck(NO_INIT),
       mHasVideo(false),
       mHeaderTimescale(0),
@@ -384,6 +414,9 @@ MPEG4Extractor::MPEG4Extractor(const sp<DataSource> &source)
       mFileMetaData(new MetaData),
       mFirstSINF(NULL),
       mIsDrm(false) {
+    if (!mMetaDataOnly) {
+        mSampleTableCache = SampleTableCache::Create(source);
+    }
 }
 
 MPEG4Extractor::~MPEG4Extractor() {
@@ -471,7 +504,7 @@ sp<MetaData> MPEG4Extractor::getTrackMetaData(
         const char *mime;
         CHECK(track->meta->findCString(kKeyMIMEType, &mime));
         if (!strncasecmp("video/", mime, 6)) {
-            if (mMoofOffset > 0) {
+            if (mMoofOffset > 0 || mMetaDataOnly) {
                 int64_t duration;
                 if (track->meta->findInt64(kKeyDuration, &duration)) {
                     // nothing fancy, just pick a frame near 1/4th of the duration
@@ -538,6 +571,10 @@ status_t MPEG4Extractor::readMetaData() {
         } else {
             mFileMetaData->setCString(kKeyMIMEType, "audio/mp4");
         }
+
+        if (mSampleTableCache != NULL) {
+            mSampleTableCache->save();
+        }
     } else {
         mInitCheck = err;
     }
@@ -879,6 +916,24 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
         return OK;
     }
 
+    if (mMetaDataOnly) {
+        switch (chunk_type) {
+            case FOURCC('s', 't', 'c', 'o'):
+            case FOURCC('c', 'o', '6', '4'):
+            case FOURCC('s', 't', 's', 'c'):
+            case FOURCC('s', 't', 's', 'z'):
+            case FOURCC('s', 't', 'z', '2'):
+            case FOURCC('s', 't', 't', 's'):
+            case FOURCC('c', 't', 't', 's'):
+            case FOURCC('s', 't', 's', 's'):
+                // sample tables are only needed to read samples
+                *offset += chunk_size;
+                return OK;
+            default:
+                break;
+        }
+    }
+
     switch(chunk_type) {
         case FOURCC('m', 'o', 'o', 'v'):
         case FOURCC('t', 'r', 'a', 'k'):
@@ -909,9 +964,9 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
             if (chunk_type == FOURCC('s', 't', 'b', 'l')) {
                 ALOGV("sampleTable chunk is %" PRIu64 " bytes long.", chunk_size);
 
-                if (mDataSource->flags()
+                if (!mMetaDataOnly && (mDataSource->flags()
                         & (DataSource::kWantsPrefetching
-                            | DataSource::kIsCachingDataSource)) {
+                            | DataSource::kIsCachingDataSource))) {
                     sp<MPEG4DataSource> cachedSource =
                         new MPEG4DataSource(mDataSource);
 
@@ -923,7 +978,8 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 if (mLastTrack == NULL)
                     return ERROR_MALFORMED;
 
-                mLastTrack->sampleTable = new SampleTable(mDataSource);
+                mLastTrack->sampleTable =
+                    new SampleTable(mDataSource, mSampleTableCache);
             }
 
             bool isTrack = false;
@@ -2900,6 +2956,11 @@ void MPEG4Extractor::parseID3v2MetaData(off64_t offset) {
 }
 
 sp<MediaSource> MPEG4Extractor::getTrack(size_t index) {
+    if (mMetaDataOnly) {
+        ALOGE("getTrack() on a meta data only extractor");
+        return NULL;
+    }
+
     status_t err;
     if ((err = readMetaData()) != OK) {
         return NULL;
@@ -2942,7 +3003,6 @@ sp<MediaSource> MPEG4Extractor::getTrack(size_t index) {
             mSidxEntries, trex, mMoofOffset);
 }
 
-// static
 status_t MPEG4Extractor::verifyTrack(Track *track) {
     const char *mime;
     CHECK(track->meta->findCString(kKeyMIMEType, &mime));
@@ -2969,7 +3029,8 @@ status_t MPEG4Extractor::verifyTrack(Track *track) {
         }
     }
 
-    if (track->sampleTable == NULL || !track->sampleTable->isValid()) {
+    if (!mMetaDataOnly
+            && (track->sampleTable == NULL || !track->sampleTable->isValid())) {
         // Make sure we have all the metadata we need.
         ALOGE("stbl atom missing/invalid.");
         return ERROR_MALFORMED;
@@ -3336,6 +3397,9 @@ MPEG4Source::MPEG4Source(
       mTrex(trex),
       mFirstMoofOffset(firstMoofOffset),
       mCurrentMoofOffset(firstMoofOffset),
+      mFragmentSource(firstMoofOffset != 0 ? new MPEG4DataSource(dataSource) : NULL),
+      mHeaderSource(dataSource),
+      mNextMoofSearchOffset(-1),
       mCurrentTime(0),
       mCurrentSampleInfoAllocSize(0),
       mCurrentSampleInfoSizes(NULL),
@@ -3347,6 +3411,8 @@ MPEG4Source::MPEG4Source(
       mStarted(false),
       mGroup(NULL),
       mBuffer(NULL),
+      mCallerData(NULL),
+      mCallerSize(0),
       mWantsNALFragments(false),
       mSrcBuffer(NULL) {
 
@@ -3403,6 +3469,7 @@ MPEG4Source::MPEG4Source(
     CHECK(format->findInt32(kKeyTrackID, &mTrackId));
 
     if (mFirstMoofOffset != 0) {
+        mHeaderSource = mFragmentSource;
         off64_t offset = mFirstMoofOffset;
         parseChunk(&offset);
     }
@@ -3479,7 +3546,7 @@ status_t MPEG4Source::stop() {
 
 status_t MPEG4Source::parseChunk(off64_t *offset) {
     uint32_t hdr[2];
-    if (mDataSource->readAt(*offset, hdr, 8) < 8) {
+    if (mHeaderSource->readAt(*offset, hdr, 8) < 8) {
         return ERROR_IO;
     }
     uint64_t chunk_size = ntohl(hdr[0]);
@@ -3487,7 +3554,7 @@ status_t MPEG4Source::parseChunk(off64_t *offset) {
     off64_t data_offset = *offset + 8;
 
     if (chunk_size == 1) {
-        if (mDataSource->readAt(*offset + 8, &chunk_size, 8) < 8) {
+        if (mHeaderSource->readAt(*offset + 8, &chunk_size, 8) < 8) {
             return ERROR_IO;
         }
         chunk_size = ntoh64(chunk_size);
@@ -3512,6 +3579,15 @@ status_t MPEG4Source::parseChunk(off64_t *offset) {
 
         case FOURCC('t', 'r', 'a', 'f'):
         case FOURCC('m', 'o', 'o', 'f'): {
+            static const uint64_t kMaxCachedMoofSize = 1024 * 1024;
+            if (chunk_type == FOURCC('m', 'o', 'o', 'f')) {
+                mNextMoofSearchOffset = -1;
+                if (mFragmentSource != NULL && chunk_size <= kMaxCachedMoofSize) {
+                    // on failure, the boxes are read from the source one by one
+                    mFragmentSource->setCachedRange(*offset, chunk_size);
+                }
+            }
+
             off64_t stop_offset = *offset + chunk_size;
             *offset = data_offset;
             while (*offset < stop_offset) {
@@ -3521,20 +3597,9 @@ status_t MPEG4Source::parseChunk(off64_t *offset) {
                 }
             }
             if (chunk_type == FOURCC('m', 'o', 'o', 'f')) {
-                // *offset points to the box following this moof. Find the next moof from there.
-
-                while (true) {
-                    if (mDataSource->readAt(*offset, hdr, 8) < 8) {
-                        return ERROR_END_OF_STREAM;
-                    }
-                    chunk_size = ntohl(hdr[0]);
-                    chunk_type = ntohl(hdr[1]);
-                    if (chunk_type == FOURCC('m', 'o', 'o', 'f')) {
-                        mNextMoofOffset = *offset;
-                        break;
-                    }
-                    *offset += chunk_size;
-                }
+                // *offset points to the box following this moof, the next moof is
+                // looked for from there by findNextMoof().
+                mNextMoofSearchOffset = *offset;
             }
             break;
         }
@@ -3593,12 +3658,51 @@ status_t MPEG4Source::parseChunk(off64_t *offset) {
     return OK;
 }
 
+status_t MPEG4Source::findNextMoof(off64_t *offset) {
+    if (mNextMoofSearchOffset < 0) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    off64_t searchOffset = mNextMoofSearchOffset;
+    while (true) {
+        uint32_t hdr[2];
+        if (mDataSource->readAt(searchOffset, hdr, 8) < 8) {
+            return ERROR_END_OF_STREAM;
+        }
+        uint64_t chunk_size = ntohl(hdr[0]);
+        uint32_t chunk_type = ntohl(hdr[1]);
+        if (chunk_type == FOURCC('m', 'o', 'o', 'f')) {
+            break;
+        }
+        if (chunk_size == 1) {
+            if (mDataSource->readAt(searchOffset + 8, &chunk_size, 8) < 8) {
+                return ERROR_END_OF_STREAM;
+            }
+            chunk_size = ntoh64(chunk_size);
+        }
+        if (chunk_size < 8) {
+            // a box extending to the end of the file, or a broken one
+            return ERROR_END_OF_STREAM;
+        }
+        searchOffset += chunk_size;
+
+        // skip the boxes looked at, if a later call has to look again
+        mNextMoofSearchOffset = searchOffset;
+    }
+
+    if (searchOffset <= mCurrentMoofOffset) {
+        return ERROR_END_OF_STREAM;
+    }
+    *offset = searchOffset;
+    return OK;
+}
+
 status_t MPEG4Source::parseSampleAuxiliaryInformationSizes(
         off64_t offset, off64_t /* size */) {
     ALOGV("parseSampleAuxiliaryInformationSizes");
     // 14496-12 8.7.12
     uint8_t version;
-    if (mDataSource->readAt(
+    if (mHeaderSource->readAt(
             offset, &version, sizeof(version))
             < (ssize_t)sizeof(version)) {
         return ERROR_IO;
@@ -3610,19 +3714,19 @@ status_t MPEG4Source::parseSampleAuxiliaryInformationSizes(
     offset++;
 
     uint32_t flags;
-    if (!mDataSource->getUInt24(offset, &flags)) {
+    if (!mHeaderSource->getUInt24(offset, &flags)) {
         return ERROR_IO;
     }
     offset += 3;
 
     if (flags & 1) {
         uint32_t tmp;
-        if (!mDataSource->getUInt32(offset, &tmp)) {
+        if (!mHeaderSource->getUInt32(offset, &tmp)) {
             return ERROR_MALFORMED;
         }
         mCurrentAuxInfoType = tmp;
         offset += 4;
-        if (!mDataSource->getUInt32(offset, &tmp)) {
+        if (!mHeaderSource->getUInt32(offset, &tmp)) {
             return ERROR_MALFORMED;
         }
         mCurrentAuxInfoTypeParameter = tmp;
@@ -3630,14 +3734,14 @@ status_t MPEG4Source::parseSampleAuxiliaryInformationSizes(
     }
 
     uint8_t defsize;
-    if (mDataSource->readAt(offset, &defsize, 1) != 1) {
+    if (mHeaderSource->readAt(offset, &defsize, 1) != 1) {
         return ERROR_MALFORMED;
     }
     mCurrentDefaultSampleInfoSize = defsize;
     offset++;
 
     uint32_t smplcnt;
-    if (!mDataSource->getUInt32(offset, &smplcnt)) {
+    if (!mHeaderSource->getUInt32(offset, &smplcnt)) {
         return ERROR_MALFORMED;
     }
     mCurrentSampleInfoCount = smplcnt;
@@ -3652,7 +3756,7 @@ status_t MPEG4Source::parseSampleAuxiliaryInformationSizes(
         mCurrentSampleInfoAllocSize = smplcnt;
     }
 
-    mDataSource->readAt(offset, mCurrentSampleInfoSizes, smplcnt);
+    mHeaderSource->readAt(offset, mCurrentSampleInfoSizes, smplcnt);
     return OK;
 }
 
@@ -3661,19 +3765,19 @@ status_t MPEG4Source::parseSampleAuxiliaryInformationOffsets(
     ALOGV("parseSampleAuxiliaryInformationOffsets");
     // 14496-12 8.7.13
     uint8_t version;
-    if (mDataSource->readAt(offset, &version, sizeof(version)) != 1) {
+    if (mHeaderSource->readAt(offset, &version, sizeof(version)) != 1) {
         return ERROR_IO;
     }
     offset++;
 
     uint32_t flags;
-    if (!mDataSource->getUInt24(offset, &flags)) {
+    if (!mHeaderSource->getUInt24(offset, &flags)) {
         return ERROR_IO;
     }
     offset += 3;
 
     uint32_t entrycount;
-    if (!mDataSource->getUInt32(offset, &entrycount)) {
+    if (!mHeaderSource->getUInt32(offset, &entrycount)) {
         return ERROR_IO;
     }
     offset += 4;
@@ -3701,14 +3805,14 @@ status_t MPEG4Source::parseSampleAuxiliaryInformationOffsets(
     for (size_t i = 0; i < entrycount; i++) {
         if (version == 0) {
             uint32_t tmp;
-            if (!mDataSource->getUInt32(offset, &tmp)) {
+            if (!mHeaderSource->getUInt32(offset, &tmp)) {
                 return ERROR_IO;
             }
             mCurrentSampleInfoOffsets[i] = tmp;
             offset += 4;
         } else {
             uint64_t tmp;
-            if (!mDataSource->getUInt64(offset, &tmp)) {
+            if (!mHeaderSource->getUInt64(offset, &tmp)) {
                 return ERROR_IO;
             }
             mCurrentSampleInfoOffsets[i] = tmp;
@@ -3738,7 +3842,7 @@ status_t MPEG4Source::parseSampleAuxiliaryInformationOffsets(
         Sample *smpl = &mCurrentSamples.editItemAt(i);
 
         memset(smpl->iv, 0, 16);
-        if (mDataSource->readAt(drmoffset, smpl->iv, ivlength) != ivlength) {
+        if (mHeaderSource->readAt(drmoffset, smpl->iv, ivlength) != ivlength) {
             return ERROR_IO;
         }
 
@@ -3750,18 +3854,18 @@ status_t MPEG4Source::parseSampleAuxiliaryInformationOffsets(
         }
         if (smplinfosize > ivlength) {
             uint16_t numsubsamples;
-            if (!mDataSource->getUInt16(drmoffset, &numsubsamples)) {
+            if (!mHeaderSource->getUInt16(drmoffset, &numsubsamples)) {
                 return ERROR_IO;
             }
             drmoffset += 2;
             for (size_t j = 0; j < numsubsamples; j++) {
                 uint16_t numclear;
                 uint32_t numencrypted;
-                if (!mDataSource->getUInt16(drmoffset, &numclear)) {
+                if (!mHeaderSource->getUInt16(drmoffset, &numclear)) {
                     return ERROR_IO;
                 }
                 drmoffset += 2;
-                if (!mDataSource->getUInt32(drmoffset, &numencrypted)) {
+                if (!mHeaderSource->getUInt32(drmoffset, &numencrypted)) {
                     return ERROR_IO;
                 }
                 drmoffset += 4;
@@ -3785,7 +3889,7 @@ status_t MPEG4Source::parseTrackFragmentHeader(off64_t offset, off64_t size) {
     }
 
     uint32_t flags;
-    if (!mDataSource->getUInt32(offset, &flags)) { // actually version + flags
+    if (!mHeaderSource->getUInt32(offset, &flags)) { // actually version + flags
         return ERROR_MALFORMED;
     }
 
@@ -3793,7 +3897,7 @@ status_t MPEG4Source::parseTrackFragmentHeader(off64_t offset, off64_t size) {
         return -EINVAL;
     }
 
-    if (!mDataSource->getUInt32(offset + 4, (uint32_t*)&mLastParsedTrackId)) {
+    if (!mHeaderSource->getUInt32(offset + 4, (uint32_t*)&mLastParsedTrackId)) {
         return ERROR_MALFORMED;
     }
 
@@ -3814,7 +3918,7 @@ status_t MPEG4Source::parseTrackFragmentHeader(off64_t offset, off64_t size) {
             return -EINVAL;
         }
 
-        if (!mDataSource->getUInt64(offset, &mTrackFragmentHeaderInfo.mBaseDataOffset)) {
+        if (!mHeaderSource->getUInt64(offset, &mTrackFragmentHeaderInfo.mBaseDataOffset)) {
             return ERROR_MALFORMED;
         }
         offset += 8;
@@ -3826,7 +3930,7 @@ status_t MPEG4Source::parseTrackFragmentHeader(off64_t offset, off64_t size) {
             return -EINVAL;
         }
 
-        if (!mDataSource->getUInt32(offset, &mTrackFragmentHeaderInfo.mSampleDescriptionIndex)) {
+        if (!mHeaderSource->getUInt32(offset, &mTrackFragmentHeaderInfo.mSampleDescriptionIndex)) {
             return ERROR_MALFORMED;
         }
         offset += 4;
@@ -3838,7 +3942,7 @@ status_t MPEG4Source::parseTrackFragmentHeader(off64_t offset, off64_t size) {
             return -EINVAL;
         }
 
-        if (!mDataSource->getUInt32(offset, &mTrackFragmentHeaderInfo.mDefaultSampleDuration)) {
+        if (!mHeaderSource->getUInt32(offset, &mTrackFragmentHeaderInfo.mDefaultSampleDuration)) {
             return ERROR_MALFORMED;
         }
         offset += 4;
@@ -3850,7 +3954,7 @@ status_t MPEG4Source::parseTrackFragmentHeader(off64_t offset, off64_t size) {
             return -EINVAL;
         }
 
-        if (!mDataSource->getUInt32(offset, &mTrackFragmentHeaderInfo.mDefaultSampleSize)) {
+        if (!mHeaderSource->getUInt32(offset, &mTrackFragmentHeaderInfo.mDefaultSampleSize)) {
             return ERROR_MALFORMED;
         }
         offset += 4;
@@ -3862,7 +3966,7 @@ status_t MPEG4Source::parseTrackFragmentHeader(off64_t offset, off64_t size) {
             return -EINVAL;
         }
 
-        if (!mDataSource->getUInt32(offset, &mTrackFragmentHeaderInfo.mDefaultSampleFlags)) {
+        if (!mHeaderSource->getUInt32(offset, &mTrackFragmentHeaderInfo.mDefaultSampleFlags)) {
             return ERROR_MALFORMED;
         }
         offset += 4;
@@ -3894,7 +3998,7 @@ status_t MPEG4Source::parseTrackFragmentRun(off64_t offset, off64_t size) {
     };
 
     uint32_t flags;
-    if (!mDataSource->getUInt32(offset, &flags)) {
+    if (!mHeaderSource->getUInt32(offset, &flags)) {
         return ERROR_MALFORMED;
     }
     ALOGV("fragment run flags: %08x", flags);
@@ -3909,7 +4013,7 @@ status_t MPEG4Source::parseTrackFragmentRun(off64_t offset, off64_t size) {
     }
 
     uint32_t sampleCount;
-    if (!mDataSource->getUInt32(offset + 4, &sampleCount)) {
+    if (!mHeaderSource->getUInt32(offset + 4, &sampleCount)) {
         return ERROR_MALFORMED;
     }
     offset += 8;
@@ -3925,7 +4029,7 @@ status_t MPEG4Source::parseTrackFragmentRun(off64_t offset, off64_t size) {
         }
 
         int32_t dataOffsetDelta;
-        if (!mDataSource->getUInt32(offset, (uint32_t*)&dataOffsetDelta)) {
+        if (!mHeaderSource->getUInt32(offset, (uint32_t*)&dataOffsetDelta)) {
             return ERROR_MALFORMED;
         }
 
@@ -3940,7 +4044,7 @@ status_t MPEG4Source::parseTrackFragmentRun(off64_t offset, off64_t size) {
             return -EINVAL;
         }
 
-        if (!mDataSource->getUInt32(offset, &firstSampleFlags)) {
+        if (!mHeaderSource->getUInt32(offset, &firstSampleFlags)) {
             return ERROR_MALFORMED;
         }
         offset += 4;
@@ -3988,31 +4092,33 @@ status_t MPEG4Source::parseTrackFragmentRun(off64_t offset, off64_t size) {
         return -EINVAL;
     }
 
+    mCurrentSamples.setCapacity(mCurrentSamples.size() + sampleCount);
+
     Sample tmp;
     for (uint32_t i = 0; i < sampleCount; ++i) {
         if (flags & kSampleDurationPresent) {
-            if (!mDataSource->getUInt32(offset, &sampleDuration)) {
+            if (!mHeaderSource->getUInt32(offset, &sampleDuration)) {
                 return ERROR_MALFORMED;
             }
             offset += 4;
         }
 
         if (flags & kSampleSizePresent) {
-            if (!mDataSource->getUInt32(offset, &sampleSize)) {
+            if (!mHeaderSource->getUInt32(offset, &sampleSize)) {
                 return ERROR_MALFORMED;
             }
             offset += 4;
         }
 
         if (flags & kSampleFlagsPresent) {
-            if (!mDataSource->getUInt32(offset, &sampleFlags)) {
+            if (!mHeaderSource->getUInt32(offset, &sampleFlags)) {
                 return ERROR_MALFORMED;
             }
             offset += 4;
         }
 
         if (flags & kSampleCompositionTimeOffsetPresent) {
-            if (!mDataSource->getUInt32(offset, &sampleCtsOffset)) {
+            if (!mHeaderSource->getUInt32(offset, &sampleCtsOffset)) {
                 return ERROR_MALFORMED;
             }
             offset += 4;
@@ -4174,7 +4280,7 @@ status_t MPEG4Source::read(
             return err;
         }
 
-        err = mGroup->acquire_buffer(&mBuffer);
+        err = acquireBuffer_l();
 
         if (err != OK) {
             CHECK(mBuffer == NULL);
@@ -4359,6 +4465,53 @@ status_t MPEG4Source::read(
     }
 }
 
+status_t MPEG4Source::readInto(
+        void *data, size_t size, MediaBuffer **out, const ReadOptions *options) {
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        CHECK(mStarted);
+
+        if (mWantsNALFragments) {
+            // fragments are clones of one buffer, which must stay ours
+            return ERROR_UNSUPPORTED;
+        }
+
+        // a sample left behind by a failed read is simply read again
+        if (mBuffer != NULL) {
+            mBuffer->release();
+            mBuffer = NULL;
+        }
+
+        mCallerData = data;
+        mCallerSize = size;
+    }
+
+    status_t err = read(out, options);
+
+    Mutex::Autolock autoLock(mLock);
+    mCallerData = NULL;
+    mCallerSize = 0;
+
+    // never keep the caller's memory past this call, e.g. for a sample
+    // that did not fit
+    if (mBuffer != NULL && mBuffer->data() == data) {
+        mBuffer->release();
+        mBuffer = NULL;
+    }
+
+    return err;
+}
+
+status_t MPEG4Source::acquireBuffer_l() {
+    if (mCallerData != NULL) {
+        mBuffer = new MediaBuffer(mCallerData, mCallerSize);
+        mCallerData = NULL;
+        return OK;
+    }
+    return mGroup->acquire_buffer(&mBuffer);
+}
+
 status_t MPEG4Source::fragmentedRead(
         MediaBuffer **out, const ReadOptions *options) {
 
@@ -4428,10 +4581,10 @@ status_t MPEG4Source::fragmentedRead(
 
         if (mCurrentSampleIndex >= mCurrentSamples.size()) {
             // move to next fragment if there is one
-            if (mNextMoofOffset <= mCurrentMoofOffset) {
+            off64_t nextMoof;
+            if (findNextMoof(&nextMoof) != OK) {
                 return ERROR_END_OF_STREAM;
             }
-            off64_t nextMoof = mNextMoofOffset;
             mCurrentMoofOffset = nextMoof;
             mCurrentSamples.clear();
             mCurrentSampleIndex = 0;
@@ -4448,7 +4601,7 @@ status_t MPEG4Source::fragmentedRead(
         mCurrentTime += smpl->duration;
         isSyncSample = (mCurrentSampleIndex == 0); // XXX
 
-        status_t err = mGroup->acquire_buffer(&mBuffer);
+        status_t err = acquireBuffer_l();
 
         if (err != OK) {
             CHECK(mBuffer == NULL);
@@ -20,6 +20,7 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <linux/falloc.h>
 #include <pthread.h>
 #include <sys/prctl.h>
 #include <sys/stat.h>
@@ -42,6 +43,7 @@
 #include <cutils/properties.h>
 
 #include "include/ESDS.h"
+#include "include/avc_utils.h"
 #include <stagefright/AVExtensions.h>
 
 #ifndef __predict_false
@@ -89,6 +91,8 @@ public:
     int64_t getEstimatedTrackSizeBytes() const;
     void writeTrackHeader(bool use32BitOffset = true);
     void bufferChunk(int64_t timestampUs);
+    void writeFragment(Chunk *chunk, uint32_t sequenceNumber);
+    bool hasData() const { return mMdatSizeBytes > 0; }
     bool isAvc() const { return mIsAvc; }
     bool isAudio() const { return mIsAudio; }
     bool isMPEG4() const { return mIsMPEG4; }
@@ -112,6 +116,7 @@ private:
             mEntryCapacity(entryCapacity),
             mTotalNumTableEntries(0),
             mNumValuesInCurrEntry(0),
+            mNumTrimmedElements(0),
             mCurrTableEntriesElement(NULL) {
             CHECK_GT(mElementCapacity, 0);
             CHECK_GT(mEntryCapacity, 0);
@@ -137,6 +142,8 @@ private:
 
             typename List<TYPE *>::iterator it = mTableEntryList.begin();
             uint32_t iterations = (pos / (mElementCapacity * mEntryCapacity));
+            CHECK_GE(iterations, mNumTrimmedElements);
+            iterations -= mNumTrimmedElements;
             while (it != mTableEntryList.end() && iterations > 0) {
                 ++it;
                 --iterations;
@@ -158,6 +165,10 @@ private:
 
             typename List<TYPE *>::iterator it = mTableEntryList.begin();
             uint32_t iterations = (pos / (mElementCapacity * mEntryCapacity));
+            if (iterations < mNumTrimmedElements) {
+                return false;
+            }
+            iterations -= mNumTrimmedElements;
             while (it != mTableEntryList.end() && iterations > 0) {
                 ++it;
                 --iterations;
@@ -197,6 +208,7 @@ private:
         // @arg writer the writer to actual write to the storage
         void write(MPEG4Writer *writer) const {
             CHECK_EQ(mNumValuesInCurrEntry % mEntryCapacity, 0);
+            CHECK_EQ(mNumTrimmedElements, 0);
             uint32_t nEntries = mTotalNumTableEntries;
             writer->writeInt32(nEntries);
             for (typename List<TYPE *>::iterator it = mTableEntryList.begin();
@@ -215,11 +227,24 @@ private:
         // Return the number of entries in the table.
         uint32_t count() const { return mTotalNumTableEntries; }
 
+        // Free all but the element being filled, for tables that are never
+        // written; count() and add() keep working.
+        void trim() {
+            while (!mTableEntryList.empty()
+                    && *mTableEntryList.begin() != mCurrTableEntriesElement) {
+                typename List<TYPE *>::iterator it = mTableEntryList.begin();
+                delete[] (*it);
+                mTableEntryList.erase(it);
+                ++mNumTrimmedElements;
+            }
+        }
+
     private:
         uint32_t         mElementCapacity;  // # entries in an element
         uint32_t         mEntryCapacity;    // # of values in each entry
         uint32_t         mTotalNumTableEntries;
         uint32_t         mNumValuesInCurrEntry;  // up to mEntryCapacity
+        uint32_t         mNumTrimmedElements;
         TYPE             *mCurrTableEntriesElement;
         mutable List<TYPE *>     mTableEntryList;
 
@@ -251,6 +276,9 @@ private:
 
 
     List<MediaBuffer *> mChunkSamples;
+    Vector<FragmentSample> mFragmentSamples;
+    int64_t mFirstCompositionOffset;       // of the first sample, in ticks
+    int64_t mLastFragmentSampleDuration;   // in ticks, used by the writer thread
 
     bool                mSamplesHaveSameSize;
     ListTableEntries<uint32_t> *mStszTableEntries;
@@ -324,6 +352,7 @@ private:
     int32_t mHFRRatio;
 
     void updateTrackSizeEstimate();
+    void trimTableEntries();
     void addOneStscTableEntry(size_t chunkId, size_t sampleId);
     void addOneStssTableEntry(size_t sampleId);
 
@@ -363,6 +392,322 @@ private:
     Track &operator=(const Track &);
 };
 
+// Collects the sample data into two large, page aligned buffers, one of
+// which is filled while the other is written to the file on a thread of its
+// own. A slow write() then stalls the producer only once both buffers are
+// full, instead of on every sample. File space is preallocated ahead of the
+// writes, and the batches may optionally bypass the page cache (O_DIRECT)
+// when they are aligned.
+class MPEG4Writer::BatchWriter {
+public:
+    // Data is written from |offset| on; |preallocateBytes| is the size of
+    // each preallocation, none if 0, which never extends past |maxOffset|
+    // if that is positive.
+    BatchWriter(int fd, off64_t offset,
+            int64_t preallocateBytes, off64_t maxOffset, bool directIO);
+
+    // Writes out the data that is still buffered.
+    ~BatchWriter();
+
+    status_t initCheck() const { return mInitCheck; }
+
+    // Not thread safe, there is a single producer at a time.
+    void write(const void *data, size_t size);
+    void flush();
+
+    void dump(String8 *result) const;
+
+private:
+    static const size_t kBatchSize = 1024 * 1024;
+    static const size_t kAlignment = 4096;
+
+    struct Batch {
+        uint8_t *mData;
+        size_t mSize;
+        size_t mCapacity;  // less than kBatchSize for the first, unaligned batch
+        off64_t mOffset;
+    };
+
+    int mFd;
+    int mFileFlags;
+    bool mDirectIO;
+    status_t mInitCheck;
+
+    int64_t mPreallocateBytes;
+    off64_t mMaxOffset;
+    off64_t mPreallocatedOffset;
+
+    Batch mBatches[2];
+    Batch *mFilling;     // owned by the producer
+    Batch *mInFlight;    // owned by the I/O thread while not NULL
+
+    mutable Mutex mLock;
+    Condition mWorkCondition;
+    Condition mDoneCondition;
+    bool mDone;
+    pthread_t mThread;
+
+    // Stats
+    status_t mError;
+    size_t mNumBatches;
+    int64_t mBytesWritten;
+    nsecs_t mTotalWriteNs;
+    nsecs_t mMaxWriteNs;
+    size_t mNumStalls;
+    nsecs_t mTotalStallNs;
+
+    void submit();
+    void waitForInFlight_l();
+
+    static void *ThreadWrapper(void *me);
+    void threadFunc();
+    status_t writeBatch(const Batch *batch);
+    void preallocate(off64_t end);
+
+    BatchWriter(const BatchWriter &);
+    BatchWriter &operator=(const BatchWriter &);
+};
+
+MPEG4Writer::BatchWriter::BatchWriter(int fd, off64_t offset,
+        int64_t preallocateBytes, off64_t maxOffset, bool directIO)
+    : mFd(fd),
+      mFileFlags(fcntl(fd, F_GETFL)),
+      mDirectIO(directIO && mFileFlags >= 0),
+      mInitCheck(NO_INIT),
+      mPreallocateBytes(preallocateBytes),
+      mMaxOffset(maxOffset),
+      mPreallocatedOffset(offset),
+      mFilling(&mBatches[0]),
+      mInFlight(NULL),
+      mDone(false),
+      mError(OK),
+      mNumBatches(0),
+      mBytesWritten(0),
+      mTotalWriteNs(0),
+      mMaxWriteNs(0),
+      mNumStalls(0),
+      mTotalStallNs(0) {
+    for (size_t i = 0; i < 2; ++i) {
+        void *data;
+        if (posix_memalign(&data, kAlignment, kBatchSize) != 0) {
+            data = NULL;
+        }
+        mBatches[i].mData = (uint8_t *)data;
+        mBatches[i].mSize = 0;
+        mBatches[i].mCapacity = kBatchSize;
+        mBatches[i].mOffset = 0;
+    }
+    if (mBatches[0].mData == NULL || mBatches[1].mData == NULL) {
+        return;
+    }
+
+    // End the first batch on an aligned offset, so that all full batches
+    // are aligned in offset and size.
+    mFilling->mOffset = offset;
+    mFilling->mCapacity = kBatchSize - (offset % kAlignment);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    if (pthread_create(&mThread, &attr, ThreadWrapper, this) == 0) {
+        mInitCheck = OK;
+    }
+    pthread_attr_destroy(&attr);
+}
+
+MPEG4Writer::BatchWriter::~BatchWriter() {
+    if (mInitCheck == OK) {
+        flush();
+
+        {
+            Mutex::Autolock autoLock(mLock);
+            mDone = true;
+            mWorkCondition.signal();
+        }
+
+        void *dummy;
+        pthread_join(mThread, &dummy);
+    }
+
+    if (mDirectIO) {
+        fcntl(mFd, F_SETFL, mFileFlags);
+    }
+
+    free(mBatches[0].mData);
+    free(mBatches[1].mData);
+}
+
+void MPEG4Writer::BatchWriter::write(const void *data, size_t size) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    while (size > 0) {
+        size_t copy = mFilling->mCapacity - mFilling->mSize;
+        if (copy > size) {
+            copy = size;
+        }
+        memcpy(mFilling->mData + mFilling->mSize, ptr, copy);
+        mFilling->mSize += copy;
+        ptr += copy;
+        size -= copy;
+
+        if (mFilling->mSize == mFilling->mCapacity) {
+            submit();
+        }
+    }
+}
+
+void MPEG4Writer::BatchWriter::flush() {
+    if (mFilling->mSize > 0) {
+        submit();
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    waitForInFlight_l();
+}
+
+void MPEG4Writer::BatchWriter::submit() {
+    Batch *batch = mFilling;
+    {
+        Mutex::Autolock autoLock(mLock);
+        waitForInFlight_l();
+        mInFlight = batch;
+        mWorkCondition.signal();
+    }
+
+    mFilling = (batch == &mBatches[0]) ? &mBatches[1] : &mBatches[0];
+    mFilling->mOffset = batch->mOffset + batch->mSize;
+    mFilling->mSize = 0;
+    mFilling->mCapacity = kBatchSize;
+}
+
+void MPEG4Writer::BatchWriter::waitForInFlight_l() {
+    if (mInFlight == NULL) {
+        return;
+    }
+
+    nsecs_t startNs = systemTime();
+    while (mInFlight != NULL) {
+        mDoneCondition.wait(mLock);
+    }
+    ++mNumStalls;
+    mTotalStallNs += systemTime() - startNs;
+}
+
+// static
+void *MPEG4Writer::BatchWriter::ThreadWrapper(void *me) {
+    static_cast<BatchWriter *>(me)->threadFunc();
+    return NULL;
+}
+
+void MPEG4Writer::BatchWriter::threadFunc() {
+    prctl(PR_SET_NAME, (unsigned long)"MPEG4WriterIO", 0, 0, 0);
+
+    Mutex::Autolock autoLock(mLock);
+    for (;;) {
+        while (mInFlight == NULL && !mDone) {
+            mWorkCondition.wait(mLock);
+        }
+        if (mInFlight == NULL) {
+            break;
+        }
+
+        const Batch *batch = mInFlight;
+        mLock.unlock();
+        nsecs_t startNs = systemTime();
+        status_t err = writeBatch(batch);
+        nsecs_t writeNs = systemTime() - startNs;
+        mLock.lock();
+
+        if (err != OK && mError == OK) {
+            mError = err;
+        }
+        ++mNumBatches;
+        mBytesWritten += batch->mSize;
+        mTotalWriteNs += writeNs;
+        if (writeNs > mMaxWriteNs) {
+            mMaxWriteNs = writeNs;
+        }
+
+        mInFlight = NULL;
+        mDoneCondition.signal();
+    }
+}
+
+status_t MPEG4Writer::BatchWriter::writeBatch(const Batch *batch) {
+    preallocate(batch->mOffset + batch->mSize);
+
+    // Only whole pages at page offsets may bypass the page cache; the
+    // last, partial batch is always written through it.
+    if (mDirectIO) {
+        bool aligned = (batch->mOffset % kAlignment) == 0
+                && (batch->mSize % kAlignment) == 0;
+        fcntl(mFd, F_SETFL, aligned ? (mFileFlags | O_DIRECT) : mFileFlags);
+    }
+
+    const uint8_t *ptr = batch->mData;
+    off64_t offset = batch->mOffset;
+    size_t size = batch->mSize;
+    while (size > 0) {
+        ssize_t n = pwrite64(mFd, ptr, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EINVAL && mDirectIO) {
+            ALOGW("direct I/O is not supported, writing through the page cache");
+            fcntl(mFd, F_SETFL, mFileFlags);
+            mDirectIO = false;
+            continue;
+        }
+        if (n <= 0) {
+            ALOGE("failed to write %zu bytes at %lld: %s",
+                    size, (long long)offset, strerror(errno));
+            return ERROR_IO;
+        }
+        ptr += n;
+        offset += n;
+        size -= n;
+    }
+    return OK;
+}
+
+void MPEG4Writer::BatchWriter::preallocate(off64_t end) {
+    if (mPreallocateBytes <= 0 || end <= mPreallocatedOffset) {
+        return;
+    }
+
+    off64_t size = mPreallocateBytes;
+    if (mMaxOffset > 0 && mPreallocatedOffset + size > mMaxOffset) {
+        size = mMaxOffset - mPreallocatedOffset;
+    }
+    if (size < end - mPreallocatedOffset) {
+        size = end - mPreallocatedOffset;
+    }
+
+    // Keep the file size, so that nothing has to be trimmed at the end.
+    if (fallocate64(mFd, FALLOC_FL_KEEP_SIZE, mPreallocatedOffset, size) != 0) {
+        ALOGV("fallocate failed: %s, not preallocating", strerror(errno));
+        mPreallocateBytes = 0;
+        return;
+    }
+    mPreallocatedOffset += size;
+}
+
+void MPEG4Writer::BatchWriter::dump(String8 *result) const {
+    Mutex::Autolock autoLock(mLock);
+    result->appendFormat("     batches written: %zu, %" PRId64 " bytes%s%s\n",
+            mNumBatches, mBytesWritten, mDirectIO ? ", direct I/O" : "",
+            mError != OK ? ", write error" : "");
+    if (mNumBatches > 0) {
+        result->appendFormat("       write latency: mean %.1f ms, max %.1f ms\n",
+                mTotalWriteNs / 1E6 / mNumBatches, mMaxWriteNs / 1E6);
+    }
+    result->appendFormat("       producer stalls: %zu, %.1f ms in total\n",
+            mNumStalls, mTotalStallNs / 1E6);
+    if (mPreallocateBytes > 0) {
+        result->appendFormat("       preallocated up to: %lld\n",
+                (long long)mPreallocatedOffset);
+    }
+}
+
 MPEG4Writer::MPEG4Writer(int fd)
     : mFd(dup(fd)),
       mInitCheck(mFd < 0? NO_INIT: OK),
@@ -376,6 +721,7 @@ MPEG4Writer::MPEG4Writer(int fd)
       mOffset(0),
       mMdatOffset(0),
       mMoovBoxBuffer(NULL),
+      mMoovBoxBufferSize(0),
       mMoovBoxBufferOffset(0),
       mWriteMoovBoxToMemory(false),
       mFreeBoxOffset(0),
@@ -389,8 +735,14 @@ MPEG4Writer::MPEG4Writer(int fd)
       mLongitudex10000(0),
       mAreGeoTagsAvailable(false),
       mStartTimeOffsetMs(-1),
+      mBitRate(-1),
+      mFragmentDurationUs(0),
+      mFragmentSequenceNumber(0),
+      mWroteFragmentedMoov(false),
+      mMehdOffset(0),
       mMetaKeys(new AMessage()),
       mIsVideoHEVC(false),
+      mBatchWriter(NULL),
       mIsAudioAMR(false),
       mHFRRatio(1) {
     addDeviceMeta();
@@ -424,6 +776,25 @@ status_t MPEG4Writer::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     mStarted: %s\n", mStarted? "true": "false");
     result.append(buffer);
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mBatchWriter != NULL) {
+            mBatchWriter->dump(&result);
+        }
+        for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+             it != mChunkInfos.end(); ++it) {
+            result.appendFormat("     %s track chunks: %zu queued, %zu at most, "
+                    "%zu written",
+                    it->mTrack->isAudio()? "Audio": "Video", it->mQueueDepth,
+                    it->mMaxQueueDepth, it->mNumChunksWritten);
+            if (it->mNumChunksWritten > 0) {
+                result.appendFormat(" in %.2f ms on average, %.2f ms at most",
+                        it->mTotalWriteNs / 1E6 / it->mNumChunksWritten,
+                        it->mMaxWriteNs / 1E6);
+            }
+            result.append("\n");
+        }
+    }
     ::write(fd, result.string(), result.size());
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
@@ -729,55 +1100,56 @@ status_t MPEG4Writer::start(MetaData *param) {
          mMaxFileSizeLimitBytes >= kMinStreamableFileSizeInBytes);
 
     /*
-     * mWriteMoovBoxToMemory is true if the amount of data in moov box is
-     * smaller than the reserved free space at the beginning of a file, AND
-     * when the content of moov box is constructed. Note that video/audio
-     * frame data is always written to the file but not in the memory.
+     * A fragmented file has a moov without samples up front, followed by
+     * a moof/mdat pair for each chunk, so that the sample tables need not
+     * be kept in memory and an interrupted recording is still playable.
+     * The chunks then last the fragment duration.
+     */
+    int64_t fragmentDurationUs;
+    if (param && param->findInt64(kKeyFragmentDurationUs, &fragmentDurationUs)
+            && fragmentDurationUs > 0) {
+        if (fragmentDurationUs > INT32_MAX) {
+            fragmentDurationUs = INT32_MAX;
+        }
+        mFragmentDurationUs = fragmentDurationUs;
+        mInterleaveDurationUs = fragmentDurationUs;
+        mFragmentSequenceNumber = 0;
+        mWroteFragmentedMoov = false;
+        mStreamableFile = false;
+    }
+
+    /*
+     * mWriteMoovBoxToMemory is true while the moov box is constructed,
+     * which happens in an in-memory cache, mMoovBoxBuffer, that grows as
+     * needed. Note that video/audio frame data is always written to the
+     * file but not in the memory.
      *
      * Before stop()/reset() is called, mWriteMoovBoxToMemory is always
-     * false. When reset() is called at the end of a recording session,
-     * Moov box needs to be constructed.
+     * false. Once the moov box is complete, it is written in a single shot:
      *
-     * 1) Right before a moov box is constructed, mWriteMoovBoxToMemory
-     * to set to mStreamableFile so that if
-     * the file is intended to be streamable, it is set to true;
-     * otherwise, it is set to false. When the value is set to false,
-     * all the content of the moov box is written immediately to
-     * the end of the file. When the value is set to true, all the
-     * content of the moov box is written to an in-memory cache,
-     * mMoovBoxBuffer, util the following condition happens. Note
-     * that the size of the in-memory cache is the same as the
-     * reserved free space at the beginning of the file.
+     * 1) to the reserved free space at the beginning of the file, if the
+     * file is intended to be streamable and the moov box fits;
      *
-     * 2) While the data of the moov box is written to an in-memory
-     * cache, the data size is checked against the reserved space.
-     * If the data size surpasses the reserved space, subsequent moov
-     * data could no longer be hold in the in-memory cache. This also
-     * indicates that the reserved space was too small. At this point,
-     * _all_ moov data must be written to the end of the file.
-     * mWriteMoovBoxToMemory must be set to false to direct the write
-     * to the file.
+     * 2) otherwise, if faststart is enabled, in front of the media data,
+     * which is moved back by the size of the moov box;
      *
-     * 3) If the data size in moov box is smaller than the reserved
-     * space after moov box is completely constructed, the in-memory
-     * cache copy of the moov box is written to the reserved free
-     * space. Thus, immediately after the moov is completedly
-     * constructed, mWriteMoovBoxToMemory is always set to false.
+     * 3) otherwise to the end of the file.
      */
     mWriteMoovBoxToMemory = false;
     mMoovBoxBuffer = NULL;
+    mMoovBoxBufferSize = 0;
     mMoovBoxBufferOffset = 0;
 
     writeFtypBox(param);
 
     mFreeBoxOffset = mOffset;
 
+    mBitRate = -1;
+    if (param) {
+        param->findInt32(kKeyBitRate, &mBitRate);
+    }
     if (mEstimatedMoovBoxSize == 0) {
-        int32_t bitRate = -1;
-        if (param) {
-            param->findInt32(kKeyBitRate, &bitRate);
-        }
-        mEstimatedMoovBoxSize = estimateMoovBoxSize(bitRate);
+        mEstimatedMoovBoxSize = estimateMoovBoxSize(mBitRate);
     }
     CHECK_GE(mEstimatedMoovBoxSize, 8);
     if (mStreamableFile) {
@@ -792,7 +1164,9 @@ status_t MPEG4Writer::start(MetaData *param) {
 
     mOffset = mMdatOffset;
     lseek64(mFd, mMdatOffset, SEEK_SET);
-    if (mUse32BitOffset) {
+    if (isFragmented()) {
+        // Each fragment comes with its own mdat
+    } else if (mUse32BitOffset) {
         write("????mdat", 8);
     } else {
         write("\x00\x00\x00\x01mdat????????", 16);
@@ -848,6 +1222,15 @@ void MPEG4Writer::stopWriterThread() {
     void *dummy;
     pthread_join(mThread, &dummy);
     mWriterThreadStarted = false;
+
+    // Write out what is still buffered before the headers are fixed up.
+    BatchWriter *batchWriter;
+    {
+        Mutex::Autolock autolock(mLock);
+        batchWriter = mBatchWriter;
+        mBatchWriter = NULL;
+    }
+    delete batchWriter;
     ALOGD("Writer thread stopped");
 }
 
@@ -958,6 +1341,19 @@ status_t MPEG4Writer::reset() {
         return err;
     }
 
+    // The fragments are complete on their own, only the duration is left.
+    if (isFragmented()) {
+        if (mWroteFragmentedMoov) {
+            uint64_t duration = (maxDurationUs * mTimeScale + 5E5) / 1E6;
+            duration = hton64(duration);
+            if (pwrite64(mFd, &duration, 8, mMehdOffset) != 8) {
+                ALOGW("failed to write the fragment duration");
+            }
+        }
+        release();
+        return OK;
+    }
+
     // Fix up the size of the 'mdat' chunk.
     if (mUse32BitOffset) {
         lseek64(mFd, mMdatOffset, SEEK_SET);
@@ -971,27 +1367,16 @@ status_t MPEG4Writer::reset() {
     }
     lseek64(mFd, mOffset, SEEK_SET);
 
-    // Construct moov box now
-    mMoovBoxBufferOffset = 0;
-    mWriteMoovBoxToMemory = mStreamableFile;
-    if (mWriteMoovBoxToMemory) {
-        // There is no need to allocate in-memory cache
-        // for moov box if the file is not streamable.
-
-        mMoovBoxBuffer = (uint8_t *) malloc(mEstimatedMoovBoxSize);
-        CHECK(mMoovBoxBuffer != NULL);
-    }
+    // Construct moov box now, always in memory: writing it piecemeal to
+    // the file costs a write() per field and two lseek()s per box.
+    beginMoovBoxInMemory(mStreamableFile ? mEstimatedMoovBoxSize : 64 * 1024);
     writeMoovBox(maxDurationUs);
+    mWriteMoovBoxToMemory = false;
 
-    // mWriteMoovBoxToMemory could be set to false in
-    // MPEG4Writer::write() method
-    if (mWriteMoovBoxToMemory) {
-        mWriteMoovBoxToMemory = false;
+    if (mStreamableFile && mMoovBoxBufferOffset + 8 <= mEstimatedMoovBoxSize) {
         // Content of the moov box is saved in the cache, and the in-memory
         // moov box needs to be written to the file in a single shot.
 
-        CHECK_LE(mMoovBoxBufferOffset + 8, mEstimatedMoovBoxSize);
-
         // Moov box
         lseek64(mFd, mFreeBoxOffset, SEEK_SET);
         mOffset = mFreeBoxOffset;
@@ -1001,7 +1386,12 @@ status_t MPEG4Writer::reset() {
         lseek64(mFd, mOffset, SEEK_SET);
         writeInt32(mEstimatedMoovBoxSize - mMoovBoxBufferOffset);
         write("free", 4);
+    } else if (property_get_bool("media.stagefright.mp4writer-faststart", false)
+            && relocateMoovBox()) {
+        ALOGI("Moved the moov box in front of the media data");
     } else {
+        // The reserved space, if any, stays in place as a free box.
+        write(mMoovBoxBuffer, 1, mMoovBoxBufferOffset);
         ALOGI("The mp4 file will not be streamable.");
     }
 
@@ -1068,14 +1458,197 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
         it != mTracks.end(); ++it, ++id) {
         (*it)->writeTrackHeader(mUse32BitOffset);
     }
+    if (isFragmented()) {
+        writeMvexBox();
+    }
     endBox();  // moov
 }
 
+void MPEG4Writer::writeMvexBox() {
+    beginBox("mvex");
+
+    beginBox("mehd");
+    writeInt32(0x01000000);    // version=1, flags=0
+    mMehdOffset = mWriteMoovBoxToMemory ? mMoovBoxBufferOffset : mOffset;
+    writeInt64(0);             // fragment duration, written in reset()
+    endBox();  // mehd
+
+    for (List<Track *>::iterator it = mTracks.begin();
+         it != mTracks.end(); ++it) {
+        if (!(*it)->hasData()) {
+            continue;
+        }
+        beginBox("trex");
+        writeInt32(0);             // version=0, flags=0
+        writeInt32((*it)->getTrackId());
+        writeInt32(1);             // default sample description index
+        writeInt32(0);             // default sample duration
+        writeInt32(0);             // default sample size
+        writeInt32(0);             // default sample flags
+        endBox();  // trex
+    }
+
+    endBox();  // mvex
+}
+
+void MPEG4Writer::beginMoovBoxInMemory(size_t size) {
+    CHECK(mMoovBoxBuffer == NULL);
+    mMoovBoxBuffer = (uint8_t *) malloc(size);
+    CHECK(mMoovBoxBuffer != NULL);
+    mMoovBoxBufferSize = size;
+    mMoovBoxBufferOffset = 0;
+    mWriteMoovBoxToMemory = true;
+}
+
+// Adds |delta| to the chunk offsets in the stco and co64 boxes found in
+// |size| bytes of boxes at |data|. Only checks that they can be shifted if
+// |apply| is false; 32-bit offsets must not overflow.
+static bool ShiftChunkOffsets(uint8_t *data, size_t size, int64_t delta, bool apply) {
+    while (size >= 8) {
+        size_t boxSize = U32_AT(data);
+        uint32_t type = U32_AT(data + 4);
+        if (boxSize < 8 || boxSize > size) {
+            return false;
+        }
+
+        uint8_t *payload = data + 8;
+        size_t payloadSize = boxSize - 8;
+        switch (type) {
+            case FOURCC('m', 'o', 'o', 'v'):
+            case FOURCC('t', 'r', 'a', 'k'):
+            case FOURCC('m', 'd', 'i', 'a'):
+            case FOURCC('m', 'i', 'n', 'f'):
+            case FOURCC('s', 't', 'b', 'l'):
+                if (!ShiftChunkOffsets(payload, payloadSize, delta, apply)) {
+                    return false;
+                }
+                break;
+
+            case FOURCC('s', 't', 'c', 'o'):
+            case FOURCC('c', 'o', '6', '4'):
+            {
+                const bool is64Bit = (type == FOURCC('c', 'o', '6', '4'));
+                const size_t entrySize = is64Bit ? 8 : 4;
+                if (payloadSize < 8) {
+                    return false;
+                }
+                uint32_t numEntries = U32_AT(payload + 4);
+                if (numEntries > (payloadSize - 8) / entrySize) {
+                    return false;
+                }
+                uint8_t *entry = payload + 8;
+                for (uint32_t i = 0; i < numEntries; ++i, entry += entrySize) {
+                    if (is64Bit) {
+                        uint64_t offset = U64_AT(entry) + delta;
+                        if (apply) {
+                            offset = hton64(offset);
+                            memcpy(entry, &offset, 8);
+                        }
+                    } else {
+                        uint64_t offset = (uint64_t)U32_AT(entry) + delta;
+                        if (offset > UINT32_MAX) {
+                            return false;
+                        }
+                        if (apply) {
+                            uint32_t x = htonl((uint32_t)offset);
+                            memcpy(entry, &x, 4);
+                        }
+                    }
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        data += boxSize;
+        size -= boxSize;
+    }
+    return true;
+}
+
+// Moves the media data back by the size of the complete moov box in memory,
+// which then goes in front of it, in place of the reserved free box if there
+// is one. The file is not playable while the data is being moved.
+bool MPEG4Writer::relocateMoovBox() {
+    static const size_t kCopyBlockSize = 4 * 1024 * 1024;
+
+    const off64_t dataStart = mMdatOffset;
+    const off64_t dataEnd = mOffset;
+    const int64_t delta = (int64_t)mMoovBoxBufferOffset - (mMdatOffset - mFreeBoxOffset);
+    if (delta <= 0
+            || !ShiftChunkOffsets(mMoovBoxBuffer, mMoovBoxBufferOffset, delta, false)) {
+        return false;
+    }
+
+    uint8_t *block = (uint8_t *) malloc(kCopyBlockSize);
+    if (block == NULL) {
+        return false;
+    }
+
+    // Back to front, so that no data is overwritten before it is moved.
+    int64_t startNs = systemTime();
+    off64_t end = dataEnd;
+    while (end > dataStart) {
+        size_t size = kCopyBlockSize;
+        if (end - dataStart < (off64_t)size) {
+            size = end - dataStart;
+        }
+        off64_t from = end - size;
+        if (pread64(mFd, block, size, from) != (ssize_t)size
+                || pwrite64(mFd, block, size, from + delta) != (ssize_t)size) {
+            // The data is partially moved, there is no way back.
+            ALOGE("failed to move %zu bytes at %lld: %s",
+                    size, (long long)from, strerror(errno));
+            break;
+        }
+        end = from;
+    }
+    free(block);
+
+    ShiftChunkOffsets(mMoovBoxBuffer, mMoovBoxBufferOffset, delta, true);
+    lseek64(mFd, mFreeBoxOffset, SEEK_SET);
+    mOffset = mFreeBoxOffset;
+    write(mMoovBoxBuffer, 1, mMoovBoxBufferOffset);
+    mOffset = dataEnd + delta;
+
+    ALOGV("moved %lld bytes of media data in %lld ms",
+            (long long)(dataEnd - dataStart), (long long)((systemTime() - startNs) / 1000000));
+    return true;
+}
+
+// Called on the writer thread before the first fragment. The moov is
+// constructed in memory, like the one of a streamable file, and then goes
+// out with the sample data.
+void MPEG4Writer::writeFragmentedMoovBox() {
+    off64_t moovOffset = mOffset;
+    beginMoovBoxInMemory(64 * 1024);
+
+    writeMoovBox(0);
+
+    mWriteMoovBoxToMemory = false;
+    mMehdOffset += moovOffset;
+
+    writeSampleData_l(mMoovBoxBuffer, mMoovBoxBufferOffset);
+
+    free(mMoovBoxBuffer);
+    mMoovBoxBuffer = NULL;
+    mMoovBoxBufferOffset = 0;
+    mWroteFragmentedMoov = true;
+}
+
 void MPEG4Writer::writeFtypBox(MetaData *param) {
     beginBox("ftyp");
 
     int32_t fileType;
-    if (mIsVideoHEVC) {
+    if (isFragmented()) {
+        writeFourcc("iso6");
+        writeInt32(0);
+        writeFourcc("isom");
+        writeFourcc("iso6");
+        writeFourcc(mIsVideoHEVC ? "hvc1" : "mp42");
+    } else if (mIsVideoHEVC) {
         AVUtils::get()->HEVCMuxerUtils().writeHEVCFtypBox(this);
     } else if (mIsAudioAMR || (param && param->findInt32(kKeyFileType, &fileType) &&
         fileType != OUTPUT_FORMAT_MPEG_4)) {
@@ -1136,15 +1709,22 @@ void MPEG4Writer::unlock() {
     mLock.unlock();
 }
 
+void MPEG4Writer::writeSampleData_l(const void *data, size_t size) {
+    if (mBatchWriter != NULL) {
+        mBatchWriter->write(data, size);
+    } else {
+        ::write(mFd, data, size);
+    }
+    mOffset += size;
+}
+
 off64_t MPEG4Writer::addSample_l(MediaBuffer *buffer) {
     off64_t old_offset = mOffset;
 
-    ::write(mFd,
+    writeSampleData_l(
           (const uint8_t *)buffer->data() + buffer->range_offset(),
           buffer->range_length());
 
-    mOffset += buffer->range_length();
-
     return old_offset;
 }
 
@@ -1168,30 +1748,22 @@ off64_t MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
     size_t length = buffer->range_length();
 
     if (mUse4ByteNalLength) {
-        uint8_t x = length >> 24;
-        ::write(mFd, &x, 1);
-        x = (length >> 16) & 0xff;
-        ::write(mFd, &x, 1);
-        x = (length >> 8) & 0xff;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-
-        ::write(mFd,
-              (const uint8_t *)buffer->data() + buffer->range_offset(),
-              length);
-
-        mOffset += length + 4;
+        uint8_t x[4];
+        x[0] = length >> 24;
+        x[1] = (length >> 16) & 0xff;
+        x[2] = (length >> 8) & 0xff;
+        x[3] = length & 0xff;
+        writeSampleData_l(x, 4);
     } else {
         CHECK_LT(length, 65536);
 
-        uint8_t x = length >> 8;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-        ::write(mFd, (const uint8_t *)buffer->data() + buffer->range_offset(), length);
-        mOffset += length + 2;
+        uint8_t x[2];
+        x[0] = length >> 8;
+        x[1] = length & 0xff;
+        writeSampleData_l(x, 2);
     }
+    writeSampleData_l(
+            (const uint8_t *)buffer->data() + buffer->range_offset(), length);
 
     return old_offset;
 }
@@ -1201,32 +1773,20 @@ size_t MPEG4Writer::write(
 
     const size_t bytes = size * nmemb;
     if (mWriteMoovBoxToMemory) {
-
-        off64_t moovBoxSize = 8 + mMoovBoxBufferOffset + bytes;
-        if (moovBoxSize > mEstimatedMoovBoxSize) {
-            // The reserved moov box at the beginning of the file
-            // is not big enough. Moov box should be written to
-            // the end of the file from now on, but not to the
-            // in-memory cache.
-
-            // We write partial moov box that is in the memory to
-            // the file first.
-            for (List<off64_t>::iterator it = mBoxes.begin();
-                 it != mBoxes.end(); ++it) {
-                (*it) += mOffset;
+        if (mMoovBoxBufferOffset + bytes > mMoovBoxBufferSize) {
+            // Whether the moov still fits the reserved space at the
+            // beginning of the file is decided once it is complete.
+            size_t newSize = mMoovBoxBufferSize * 2;
+            if (newSize < mMoovBoxBufferOffset + bytes) {
+                newSize = mMoovBoxBufferOffset + bytes;
             }
-            lseek64(mFd, mOffset, SEEK_SET);
-            ::write(mFd, mMoovBoxBuffer, mMoovBoxBufferOffset);
-            ::write(mFd, ptr, bytes);
-            mOffset += (bytes + mMoovBoxBufferOffset);
-
-            // All subsequent moov box content will be written
-            // to the end of the file.
-            mWriteMoovBoxToMemory = false;
-        } else {
-            memcpy(mMoovBoxBuffer + mMoovBoxBufferOffset, ptr, bytes);
-            mMoovBoxBufferOffset += bytes;
+            uint8_t *buffer = (uint8_t *) realloc(mMoovBoxBuffer, newSize);
+            CHECK(buffer != NULL);
+            mMoovBoxBuffer = buffer;
+            mMoovBoxBufferSize = newSize;
         }
+        memcpy(mMoovBoxBuffer + mMoovBoxBufferOffset, ptr, bytes);
+        mMoovBoxBufferOffset += bytes;
     } else {
         ::write(mFd, ptr, size * nmemb);
         mOffset += bytes;
@@ -1473,6 +2033,8 @@ MPEG4Writer::Track::Track(
       mTrackId(trackId),
       mTrackDurationUs(0),
       mEstimatedTrackSizeBytes(0),
+      mFirstCompositionOffset(-1),
+      mLastFragmentSampleDuration(0),
       mSamplesHaveSameSize(true),
       mStszTableEntries(new ListTableEntries<uint32_t>(1000, 1)),
       mStcoTableEntries(new ListTableEntries<uint32_t>(1000, 1)),
@@ -1680,6 +2242,9 @@ void MPEG4Writer::bufferChunk(const Chunk& chunk) {
 
         if (chunk.mTrack == it->mTrack) {  // Found owner
             it->mChunks.push_back(chunk);
+            if (++it->mQueueDepth > it->mMaxQueueDepth) {
+                it->mMaxQueueDepth = it->mQueueDepth;
+            }
             mChunkReadyCondition.signal();
             return;
         }
@@ -1692,6 +2257,14 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
     ALOGV("writeChunkToFile: %" PRId64 " from %s track",
         chunk->mTimeStampUs, chunk->mTrack->isAudio()? "audio": "video");
 
+    if (isFragmented()) {
+        if (!mWroteFragmentedMoov) {
+            writeFragmentedMoovBox();
+        }
+        chunk->mTrack->writeFragment(chunk, ++mFragmentSequenceNumber);
+        return;
+    }
+
     int32_t isFirstSample = true;
     while (!chunk->mSamples.empty()) {
         List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
@@ -1748,6 +2321,17 @@ bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
         return false;
     }
 
+    // The moov of a fragmented file needs the codec specific data of every
+    // track, which is there once a track has buffered its first chunk.
+    if (isFragmented() && !mWroteFragmentedMoov && !mDone) {
+        for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+             it != mChunkInfos.end(); ++it) {
+            if (it->mChunks.empty() && !it->mTrack->reachedEOS()) {
+                return false;
+            }
+        }
+    }
+
     if (mIsFirstChunk) {
         mIsFirstChunk = false;
     }
@@ -1757,6 +2341,7 @@ bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
         if (it->mTrack == track) {
             *chunk = *(it->mChunks.begin());
             it->mChunks.erase(it->mChunks.begin());
+            --it->mQueueDepth;
             CHECK_EQ(chunk->mTrack, track);
 
             int64_t interChunkTimeUs =
@@ -1794,16 +2379,33 @@ void MPEG4Writer::threadFunc() {
             if (mIsRealTimeRecording) {
                 mLock.unlock();
             }
+            nsecs_t startNs = systemTime();
             writeChunkToFile(&chunk);
+            nsecs_t writeNs = systemTime() - startNs;
             if (mIsRealTimeRecording) {
                 mLock.lock();
             }
+            noteChunkWritten_l(chunk.mTrack, writeNs);
         }
     }
 
     writeAllChunks();
 }
 
+void MPEG4Writer::noteChunkWritten_l(Track *track, nsecs_t writeNs) {
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+         it != mChunkInfos.end(); ++it) {
+        if (it->mTrack == track) {
+            ++it->mNumChunksWritten;
+            it->mTotalWriteNs += writeNs;
+            if (writeNs > it->mMaxWriteNs) {
+                it->mMaxWriteNs = writeNs;
+            }
+            return;
+        }
+    }
+}
+
 status_t MPEG4Writer::startWriterThread() {
     ALOGV("startWriterThread");
 
@@ -1816,9 +2418,29 @@ status_t MPEG4Writer::startWriterThread() {
         info.mTrack = *it;
         info.mPrevChunkTimestampUs = 0;
         info.mMaxInterChunkDurUs = 0;
+        info.mQueueDepth = 0;
+        info.mMaxQueueDepth = 0;
+        info.mNumChunksWritten = 0;
+        info.mTotalWriteNs = 0;
+        info.mMaxWriteNs = 0;
         mChunkInfos.push_back(info);
     }
 
+    // Preallocate a few seconds worth of the requested bitrate at a time.
+    static const int64_t kMinPreallocateBytes = 4 * 1024 * 1024;
+    static const int64_t kPreallocateDurationSecs = 4;
+    int64_t preallocateBytes = kMinPreallocateBytes;
+    if (mBitRate > 0 && mBitRate / 8 * kPreallocateDurationSecs > preallocateBytes) {
+        preallocateBytes = mBitRate / 8 * kPreallocateDurationSecs;
+    }
+    mBatchWriter = new BatchWriter(mFd, mOffset, preallocateBytes, mMaxFileSizeLimitBytes,
+            property_get_bool("media.stagefright.mp4writer-directio", false));
+    if (mBatchWriter->initCheck() != OK) {
+        ALOGW("failed to set up batched writes, writing samples directly");
+        delete mBatchWriter;
+        mBatchWriter = NULL;
+    }
+
     pthread_attr_t attr;
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -1963,15 +2585,19 @@ static const uint8_t *findNextStartCode(
 
     ALOGV("findNextStartCode: %p %zu", data, length);
 
-    size_t bytesLeft = length;
-    while (bytesLeft > 4  &&
-            memcmp("\x00\x00\x00\x01", &data[length - bytesLeft], 4)) {
-        --bytesLeft;
-    }
-    if (bytesLeft <= 4) {
-        bytesLeft = 0; // Last parameter set
+    // looking for 00 00 00 01, that is a 00 00 01 prefix after a zero byte
+    size_t offset = 0;
+    while (offset < length) {
+        size_t prefix = offset + findStartCodePrefix(&data[offset], length - offset);
+        if (prefix >= length) {
+            break;
+        }
+        if (prefix > 0 && data[prefix - 1] == 0x00 && length - (prefix - 1) > 4) {
+            return &data[prefix - 1];
+        }
+        offset = prefix + 1;
     }
-    return &data[length - bytesLeft];
+    return &data[length]; // Last parameter set
 }
 
 const uint8_t *MPEG4Writer::Track::parseParamSet(
@@ -2218,7 +2844,8 @@ void MPEG4Writer::Track::updateDriftTime(const sp<MetaData>& meta) {
 status_t MPEG4Writer::Track::threadEntry() {
     int32_t count = 0;
     const int64_t interleaveDurationUs = mOwner->interleaveDuration();
-    const bool hasMultipleTracks = (mOwner->numTracks() > 1);
+    // Fragments are made from chunks, even with a single track.
+    const bool hasMultipleTracks = (mOwner->numTracks() > 1) || mOwner->isFragmented();
     int64_t chunkTimestampUs = 0;
     int32_t nChunks = 0;
     int32_t nZeroLengthFrames = 0;
@@ -2512,6 +3139,15 @@ status_t MPEG4Writer::Track::threadEntry() {
             addOneStssTableEntry(mStszTableEntries->count());
         }
 
+        if (mOwner->isFragmented()) {
+            FragmentSample sample;
+            sample.mSize = sampleSize;
+            sample.mIsSync = (isSync != 0);
+            sample.mDecodingTime = (timestampUs * mTimeScale + 500000LL) / 1000000LL;
+            sample.mCompositionOffset = currCttsOffsetTimeTicks;
+            mFragmentSamples.push(sample);
+        }
+
         if (mTrackingProgressStatus) {
             if (mPreviousTrackTimeUs <= 0) {
                 mPreviousTrackTimeUs = mStartTimestampUs;
@@ -2759,10 +3395,137 @@ void MPEG4Writer::Track::bufferChunk(int64_t timestampUs) {
     ALOGV("bufferChunk");
 
     Chunk chunk(this, timestampUs, mChunkSamples);
+    if (mOwner->isFragmented()) {
+        chunk.mFragmentSamples = mFragmentSamples;
+        mFragmentSamples.clear();
+
+        // The sample tables are never written, bound their memory use.
+        trimTableEntries();
+    }
     mOwner->bufferChunk(chunk);
     mChunkSamples.clear();
 }
 
+void MPEG4Writer::Track::trimTableEntries() {
+    mStszTableEntries->trim();
+    mStcoTableEntries->trim();
+    mCo64TableEntries->trim();
+    mStscTableEntries->trim();
+    mStssTableEntries->trim();
+    mSttsTableEntries->trim();
+    mCttsTableEntries->trim();
+}
+
+static uint8_t *WriteUInt32(uint8_t *ptr, uint32_t x) {
+    ptr[0] = x >> 24;
+    ptr[1] = (x >> 16) & 0xff;
+    ptr[2] = (x >> 8) & 0xff;
+    ptr[3] = x & 0xff;
+    return ptr + 4;
+}
+
+static uint8_t *WriteUInt64(uint8_t *ptr, uint64_t x) {
+    ptr = WriteUInt32(ptr, x >> 32);
+    return WriteUInt32(ptr, x & 0xffffffff);
+}
+
+static uint8_t *WriteBoxHeader(uint8_t *ptr, size_t size, const char *fourcc) {
+    ptr = WriteUInt32(ptr, size);
+    memcpy(ptr, fourcc, 4);
+    return ptr + 4;
+}
+
+// Writes the chunk as a moof with a single traf, followed by its mdat. Called
+// on the writer thread; the moof is laid out in memory since boxes are only
+// fixed up in place in the file outside of recording.
+void MPEG4Writer::Track::writeFragment(Chunk *chunk, uint32_t sequenceNumber) {
+    const Vector<FragmentSample> &samples = chunk->mFragmentSamples;
+    const size_t numSamples = samples.size();
+    CHECK_EQ(numSamples, chunk->mSamples.size());
+    if (numSamples == 0) {
+        return;
+    }
+
+    if (mFirstCompositionOffset < 0) {
+        mFirstCompositionOffset = samples[0].mCompositionOffset;
+    }
+
+    // data offset, sample duration, size, flags and composition time offset
+    static const uint32_t kTrunFlags = 0x000001 | 0x000100 | 0x000200 | 0x000400 | 0x000800;
+    static const uint32_t kSyncSampleFlags = 0x02000000;     // depends on no other sample
+    static const uint32_t kNonSyncSampleFlags = 0x01010000;  // depends on others, non sync
+
+    const size_t trunSize = 8 + 4 + 4 + 4 + numSamples * 16;
+    const size_t trafSize = 8 + 16 + 20 + trunSize;
+    const size_t moofSize = 8 + 16 + trafSize;
+
+    uint8_t *moof = (uint8_t *)malloc(moofSize);
+    CHECK(moof != NULL);
+
+    uint8_t *ptr = WriteBoxHeader(moof, moofSize, "moof");
+
+    ptr = WriteBoxHeader(ptr, 16, "mfhd");
+    ptr = WriteUInt32(ptr, 0);                      // version=0, flags=0
+    ptr = WriteUInt32(ptr, sequenceNumber);
+
+    ptr = WriteBoxHeader(ptr, trafSize, "traf");
+
+    ptr = WriteBoxHeader(ptr, 16, "tfhd");
+    ptr = WriteUInt32(ptr, 0x020000);               // default-base-is-moof
+    ptr = WriteUInt32(ptr, mTrackId);
+
+    ptr = WriteBoxHeader(ptr, 20, "tfdt");
+    ptr = WriteUInt32(ptr, 0x01000000);             // version=1, flags=0
+    ptr = WriteUInt64(ptr, samples[0].mDecodingTime + getStartTimeOffsetScaledTime());
+
+    size_t mdatSize = 8;
+    ptr = WriteBoxHeader(ptr, trunSize, "trun");
+    ptr = WriteUInt32(ptr, 0x01000000 | kTrunFlags);  // version=1: signed offsets
+    ptr = WriteUInt32(ptr, numSamples);
+    ptr = WriteUInt32(ptr, moofSize + 8);           // data offset, past the mdat header
+    for (size_t i = 0; i < numSamples; ++i) {
+        const FragmentSample &sample = samples[i];
+
+        // The last sample lasts as long as the one before it, the next
+        // fragment's tfdt corrects any difference.
+        int64_t duration = mLastFragmentSampleDuration;
+        if (i + 1 < numSamples) {
+            duration = samples[i + 1].mDecodingTime - sample.mDecodingTime;
+        } else if (i > 0) {
+            duration = sample.mDecodingTime - samples[i - 1].mDecodingTime;
+        }
+        mLastFragmentSampleDuration = duration;
+
+        ptr = WriteUInt32(ptr, duration);
+        ptr = WriteUInt32(ptr, sample.mSize);
+        ptr = WriteUInt32(ptr, sample.mIsSync ? kSyncSampleFlags : kNonSyncSampleFlags);
+        ptr = WriteUInt32(ptr, (int32_t)(sample.mCompositionOffset - mFirstCompositionOffset));
+        mdatSize += sample.mSize;
+    }
+    CHECK_EQ((size_t)(ptr - moof), moofSize);
+
+    mOwner->writeSampleData_l(moof, moofSize);
+    free(moof);
+
+    uint8_t mdatHeader[8];
+    WriteBoxHeader(mdatHeader, mdatSize, "mdat");
+    mOwner->writeSampleData_l(mdatHeader, sizeof(mdatHeader));
+
+    while (!chunk->mSamples.empty()) {
+        List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+
+        if (mIsAvc || mIsHEVC) {
+            mOwner->addLengthPrefixedSample_l(*it);
+        } else {
+            mOwner->addSample_l(*it);
+        }
+
+        (*it)->release();
+        (*it) = NULL;
+        chunk->mSamples.erase(it);
+    }
+}
+
 int64_t MPEG4Writer::Track::getDurationUs() const {
     return mTrackDurationUs;
 }
@@ -2833,6 +3596,23 @@ void MPEG4Writer::Track::writeStblBox(bool use32BitOffset) {
         writeVideoFourCCBox();
     }
     mOwner->endBox();  // stsd
+    if (mOwner->isFragmented()) {
+        // The samples are all in the fragments.
+        static const char *kEmptyTables[] = { "stts", "stsc", "stco" };
+        for (size_t i = 0; i < sizeof(kEmptyTables) / sizeof(kEmptyTables[0]); ++i) {
+            mOwner->beginBox(kEmptyTables[i]);
+            mOwner->writeInt32(0);  // version=0, flags=0
+            mOwner->writeInt32(0);  // entry count
+            mOwner->endBox();
+        }
+        mOwner->beginBox("stsz");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // sample size
+        mOwner->writeInt32(0);  // sample count
+        mOwner->endBox();  // stsz
+        mOwner->endBox();  // stbl
+        return;
+    }
     writeSttsBox();
     writeCttsBox();
     if (!mIsAudio) {
@@ -3026,7 +3806,8 @@ void MPEG4Writer::Track::writeTkhdBox(uint32_t now) {
     mOwner->writeInt32(now);           // modification time
     mOwner->writeInt32(mTrackId);      // track id starts with 1
     mOwner->writeInt32(0);             // reserved
-    int64_t trakDurationUs = getDurationUs();
+    // The moov of a fragmented file holds no samples.
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     int32_t mvhdTimeScale = mOwner->getTimeScale();
     int32_t tkhdDuration =
         (trakDurationUs * mvhdTimeScale + 5E5) / 1E6;
@@ -3087,7 +3868,7 @@ void MPEG4Writer::Track::writeHdlrBox() {
 }
 
 void MPEG4Writer::Track::writeMdhdBox(uint32_t now) {
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     mOwner->beginBox("mdhd");
     mOwner->writeInt32(0);             // version=0, flags=0
     mOwner->writeInt32(now);           // creation time
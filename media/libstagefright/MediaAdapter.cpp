@@ -19,13 +19,19 @@
 #include <utils/Log.h>
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaAdapter.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
 
 namespace android {
 
+// How long stop() waits for the writer to drain queued buffers.
+static const int64_t kDrainTimeoutNs = 1000000000ll;
+
 MediaAdapter::MediaAdapter(const sp<MetaData> &meta)
-    : mCurrentMediaBuffer(NULL),
+    : mQueuedBytes(0),
+      mMaxQueuedBytes(kDefaultMaxQueuedBytes),
       mStarted(false),
       mOutputFormat(meta),
       mStatus(OK) {
@@ -34,7 +40,7 @@ MediaAdapter::MediaAdapter(const sp<MetaData> &meta)
 MediaAdapter::~MediaAdapter() {
     Mutex::Autolock autoLock(mAdapterLock);
     mOutputFormat.clear();
-    CHECK(mCurrentMediaBuffer == NULL);
+    CHECK(mQueuedBuffers.empty());
 }
 
 status_t MediaAdapter::start(MetaData * /* params */) {
@@ -48,18 +54,30 @@ status_t MediaAdapter::start(MetaData * /* params */) {
 status_t MediaAdapter::stop() {
     Mutex::Autolock autoLock(mAdapterLock);
     if (mStarted) {
+        // Give the writer a chance to consume what queueBuffer() queued.
+        while (!mQueuedBuffers.empty() && mStatus == OK) {
+            if (mBufferReturnedCond.waitRelative(mAdapterLock, kDrainTimeoutNs) != OK) {
+                ALOGW("dropping %zu queued buffers at stop", mQueuedBuffers.size());
+                break;
+            }
+        }
+
         mStarted = false;
         // If stop() happens immediately after a pushBuffer(), we should
-        // clean up the mCurrentMediaBuffer
-        if (mCurrentMediaBuffer != NULL) {
-            mCurrentMediaBuffer->setObserver(this);
-            mCurrentMediaBuffer->claim();
-            mCurrentMediaBuffer->setObserver(0);
-            mCurrentMediaBuffer->release();
-            mCurrentMediaBuffer = NULL;
+        // clean up the queued buffers
+        while (!mQueuedBuffers.empty()) {
+            MediaBuffer *buffer = *mQueuedBuffers.begin();
+            mQueuedBuffers.erase(mQueuedBuffers.begin());
+            mQueuedBytes -= buffer->range_length();
+            complete_l(buffer, ERROR_END_OF_STREAM);
+            buffer->setObserver(this);
+            buffer->claim();
+            buffer->setObserver(0);
+            buffer->release();
         }
         // While read() is still waiting, we should signal it to finish.
         mBufferReadCond.signal();
+        mBufferReturnedCond.broadcast();
     }
     return OK;
 }
@@ -72,10 +90,24 @@ sp<MetaData> MediaAdapter::getFormat() {
 void MediaAdapter::signalBufferReturned(MediaBuffer *buffer) {
     Mutex::Autolock autoLock(mAdapterLock);
     CHECK(buffer != NULL);
+    complete_l(buffer, OK);
     buffer->setObserver(0);
     buffer->release();
     ALOGV("buffer returned %p", buffer);
-    mBufferReturnedCond.signal();
+    mBufferReturnedCond.broadcast();
+}
+
+void MediaAdapter::complete_l(MediaBuffer *buffer, status_t err) {
+    ssize_t index = mPendingBuffers.indexOfKey(buffer);
+    if (index < 0) {
+        return;
+    }
+    sp<AMessage> notify = mPendingBuffers.valueAt(index);
+    mPendingBuffers.removeItemsAt(index);
+    if (notify != NULL) {
+        notify->setInt32("err", err);
+        notify->post();
+    }
 }
 
 status_t MediaAdapter::read(
@@ -86,33 +118,28 @@ status_t MediaAdapter::read(
         return ERROR_END_OF_STREAM;
     }
 
-    while (mCurrentMediaBuffer == NULL && mStarted) {
+    while (mQueuedBuffers.empty() && mStarted) {
         ALOGV("waiting @ read()");
         mBufferReadCond.wait(mAdapterLock);
     }
 
     if (!mStarted) {
         ALOGV("read interrupted after stop");
-        CHECK(mCurrentMediaBuffer == NULL);
+        CHECK(mQueuedBuffers.empty());
         return ERROR_END_OF_STREAM;
     }
 
-    CHECK(mCurrentMediaBuffer != NULL);
-
-    *buffer = mCurrentMediaBuffer;
-    mCurrentMediaBuffer = NULL;
+    *buffer = *mQueuedBuffers.begin();
+    mQueuedBuffers.erase(mQueuedBuffers.begin());
+    mQueuedBytes -= (*buffer)->range_length();
     (*buffer)->setObserver(this);
+    // Room for queueBuffer() callers waiting on the byte budget.
+    mBufferReturnedCond.broadcast();
 
     return OK;
 }
 
-status_t MediaAdapter::pushBuffer(MediaBuffer *buffer) {
-    if (buffer == NULL) {
-        ALOGE("pushBuffer get an NULL buffer");
-        return -EINVAL;
-    }
-
-    Mutex::Autolock autoLock(mAdapterLock);
+status_t MediaAdapter::enqueue_l(MediaBuffer *buffer, const sp<AMessage> &notify) {
     if (!mStarted) {
         ALOGE("pushBuffer called before start");
         return INVALID_OPERATION;
@@ -121,19 +148,69 @@ status_t MediaAdapter::pushBuffer(MediaBuffer *buffer) {
         ALOGE("pushBuffer called when MediaAdapter in error status");
         return mStatus;
     }
-    mCurrentMediaBuffer = buffer;
+    mPendingBuffers.add(buffer, notify);
+    mQueuedBuffers.push_back(buffer);
+    mQueuedBytes += buffer->range_length();
     mBufferReadCond.signal();
+    return OK;
+}
+
+status_t MediaAdapter::pushBuffer(MediaBuffer *buffer) {
+    if (buffer == NULL) {
+        ALOGE("pushBuffer get an NULL buffer");
+        return -EINVAL;
+    }
+
+    Mutex::Autolock autoLock(mAdapterLock);
+    status_t err = enqueue_l(buffer, NULL);
+    if (err != OK) {
+        return err;
+    }
 
     ALOGV("wait for the buffer returned @ pushBuffer! %p", buffer);
-    mBufferReturnedCond.wait(mAdapterLock);
+    while (mPendingBuffers.indexOfKey(buffer) >= 0 && mStarted && mStatus == OK) {
+        mBufferReturnedCond.wait(mAdapterLock);
+    }
 
     return mStatus;
 }
 
+status_t MediaAdapter::queueBuffer(MediaBuffer *buffer, const sp<AMessage> &notify) {
+    if (buffer == NULL) {
+        ALOGE("queueBuffer get an NULL buffer");
+        return -EINVAL;
+    }
+
+    Mutex::Autolock autoLock(mAdapterLock);
+    // Always accept one buffer, however large, so that the budget cannot
+    // deadlock a writer that is waiting for data.
+    while (!mQueuedBuffers.empty()
+            && mQueuedBytes + buffer->range_length() > mMaxQueuedBytes
+            && mStarted && mStatus == OK) {
+        ALOGV("queued bytes %zu over budget @ queueBuffer", mQueuedBytes);
+        mBufferReturnedCond.wait(mAdapterLock);
+    }
+
+    status_t err = enqueue_l(buffer, notify);
+    if (err != OK) {
+        // The caller took a reference for the writer, drop it here.
+        buffer->setObserver(this);
+        buffer->claim();
+        buffer->setObserver(0);
+        buffer->release();
+    }
+    return err;
+}
+
+void MediaAdapter::setMaxQueuedBytes(size_t maxQueuedBytes) {
+    Mutex::Autolock autoLock(mAdapterLock);
+    mMaxQueuedBytes = maxQueuedBytes;
+}
+
 void MediaAdapter::notifyError(status_t err) {
     Mutex::Autolock autoLock(mAdapterLock);
     mStatus = err;
-    mBufferReturnedCond.signal();
+    mBufferReturnedCond.broadcast();
 }
 
 }  // namespace android
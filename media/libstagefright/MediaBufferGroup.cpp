@@ -17,18 +17,46 @@
 #define LOG_TAG "MediaBufferGroup"
 #include <utils/Log.h>
 
+#include <stdio.h>
+
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaBufferGroup.h>
 
 namespace android {
 
-MediaBufferGroup::MediaBufferGroup()
+// Smallest buffer acquire_buffer() allocates for a request, larger ones are
+// rounded up to a power of 2 so that a replaced buffer fits the next few requests.
+static const size_t kMinBufferSize = 4096;
+
+MediaBufferGroup::Stats::Stats()
+    : mAcquires(0),
+      mWouldBlock(0),
+      mWaits(0),
+      mWaitNs(0),
+      mMaxWaitNs(0),
+      mGrowths(0),
+      mReplacements(0),
+      mHighWater(0) {
+}
+
+MediaBufferGroup::MediaBufferGroup(size_t growthLimit)
     : mFirstBuffer(NULL),
-      mLastBuffer(NULL) {
+      mLastBuffer(NULL),
+      mNumBuffers(0),
+      mGrowthLimit(growthLimit),
+      mFreeBuffers(NULL) {
+    atomic_init(&mReturnedBuffers, (uintptr_t)0);
+    atomic_init(&mWaiters, 0);
+    atomic_init(&mInUse, 0);
 }
 
 MediaBufferGroup::~MediaBufferGroup() {
+    ALOGV("%zu buffers, %u acquires, %u waits (%lld us), %u grown, %u replaced, "
+            "high water %u",
+            mNumBuffers, mStats.mAcquires, mStats.mWaits, (long long)(mStats.mWaitNs / 1000),
+            mStats.mGrowths, mStats.mReplacements, mStats.mHighWater);
+
     MediaBuffer *next;
     for (MediaBuffer *buffer = mFirstBuffer; buffer != NULL;
          buffer = next) {
@@ -44,6 +72,10 @@ MediaBufferGroup::~MediaBufferGroup() {
 void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
     Mutex::Autolock autoLock(mLock);
 
+    addBuffer_l(buffer);
+}
+
+void MediaBufferGroup::addBuffer_l(MediaBuffer *buffer) {
     buffer->setObserver(this);
 
     if (mLastBuffer) {
@@ -53,40 +85,175 @@ void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
     }
 
     mLastBuffer = buffer;
+    ++mNumBuffers;
+
+    if (buffer->refcount() == 0) {
+        buffer->mNextFree = mFreeBuffers;
+        mFreeBuffers = buffer;
+    } else {
+        // it comes back through signalBufferReturned()
+        atomic_fetch_add(&mInUse, 1);
+    }
+}
+
+// The buffer must be unused and already taken off the free list.
+void MediaBufferGroup::removeBuffer_l(MediaBuffer *buffer) {
+    MediaBuffer *prev = NULL;
+    for (MediaBuffer *b = mFirstBuffer; b != NULL; prev = b, b = b->nextBuffer()) {
+        if (b == buffer) {
+            if (prev != NULL) {
+                prev->setNextBuffer(b->nextBuffer());
+            } else {
+                mFirstBuffer = b->nextBuffer();
+            }
+            if (mLastBuffer == b) {
+                mLastBuffer = prev;
+            }
+            break;
+        }
+    }
+    --mNumBuffers;
+
+    buffer->setNextBuffer(NULL);
+    buffer->setObserver(NULL);
+    buffer->release();
+}
+
+void MediaBufferGroup::collectReturnedBuffers_l() {
+    MediaBuffer *buffer = (MediaBuffer *)atomic_exchange(&mReturnedBuffers, (uintptr_t)0);
+    while (buffer != NULL) {
+        MediaBuffer *next = buffer->mNextFree;
+        buffer->mNextFree = mFreeBuffers;
+        mFreeBuffers = buffer;
+        buffer = next;
+    }
+}
+
+// Unlinks and returns the most recently freed buffer holding at least
+// requestedSize bytes, its data is the most likely to still be cached.
+MediaBuffer *MediaBufferGroup::takeFreeBuffer_l(size_t requestedSize) {
+    for (MediaBuffer **link = &mFreeBuffers; *link != NULL; link = &(*link)->mNextFree) {
+        MediaBuffer *buffer = *link;
+        if (requestedSize == 0 || buffer->size() >= requestedSize) {
+            *link = buffer->mNextFree;
+            buffer->mNextFree = NULL;
+            return buffer;
+        }
+    }
+    return NULL;
+}
+
+// static
+size_t MediaBufferGroup::sizeClass(size_t size) {
+    size_t rounded = kMinBufferSize;
+    while (rounded < size && rounded <= SIZE_MAX / 2) {
+        rounded *= 2;
+    }
+    return rounded < size ? size : rounded;
+}
+
+size_t MediaBufferGroup::buffers() const {
+    Mutex::Autolock autoLock(mLock);
+    return mNumBuffers;
 }
 
 status_t MediaBufferGroup::acquire_buffer(
-        MediaBuffer **out, bool nonBlocking) {
+        MediaBuffer **out, bool nonBlocking, size_t requestedSize) {
     Mutex::Autolock autoLock(mLock);
 
     for (;;) {
-        for (MediaBuffer *buffer = mFirstBuffer;
-             buffer != NULL; buffer = buffer->nextBuffer()) {
-            if (buffer->refcount() == 0) {
-                buffer->add_ref();
-                buffer->reset();
-
-                *out = buffer;
-                goto exit;
+        collectReturnedBuffers_l();
+
+        MediaBuffer *buffer = takeFreeBuffer_l(requestedSize);
+        if (buffer == NULL && requestedSize > 0 && mFreeBuffers != NULL
+                && (mGrowthLimit == 0 || mNumBuffers >= mGrowthLimit)) {
+            // only smaller buffers are free, trade one in for a larger one
+            MediaBuffer *small = mFreeBuffers;
+            mFreeBuffers = small->mNextFree;
+            small->mNextFree = NULL;
+            removeBuffer_l(small);
+            buffer = new MediaBuffer(sizeClass(requestedSize));
+            addBuffer_l(buffer);
+            buffer = takeFreeBuffer_l(requestedSize);
+            ++mStats.mReplacements;
+        } else if (buffer == NULL && mNumBuffers < mGrowthLimit
+                && (requestedSize > 0 || mFirstBuffer != NULL)) {
+            buffer = new MediaBuffer(
+                    requestedSize > 0 ? sizeClass(requestedSize) : mFirstBuffer->size());
+            addBuffer_l(buffer);
+            buffer = takeFreeBuffer_l(requestedSize);
+            ++mStats.mGrowths;
+        }
+
+        if (buffer != NULL) {
+            buffer->add_ref();
+            buffer->reset();
+
+            ++mStats.mAcquires;
+            uint32_t inUse = atomic_fetch_add(&mInUse, 1) + 1;
+            if (inUse > mStats.mHighWater) {
+                mStats.mHighWater = inUse;
             }
+
+            *out = buffer;
+            return OK;
         }
 
         if (nonBlocking) {
+            ++mStats.mWouldBlock;
             *out = NULL;
             return WOULD_BLOCK;
         }
 
         // All buffers are in use. Block until one of them is returned to us.
-        mCondition.wait(mLock);
+        // Announcing the wait before checking for returned buffers pairs with
+        // signalBufferReturned() pushing before it checks for waiters.
+        nsecs_t start = systemTime();
+        atomic_fetch_add(&mWaiters, 1);
+        if (atomic_load(&mReturnedBuffers) == 0) {
+            mCondition.wait(mLock);
+        }
+        atomic_fetch_sub(&mWaiters, 1);
+        nsecs_t waitNs = systemTime() - start;
+        ++mStats.mWaits;
+        mStats.mWaitNs += waitNs;
+        if (waitNs > mStats.mMaxWaitNs) {
+            mStats.mMaxWaitNs = waitNs;
+        }
     }
+}
 
-exit:
-    return OK;
+void MediaBufferGroup::signalBufferReturned(MediaBuffer *buffer) {
+    atomic_fetch_sub(&mInUse, 1);
+
+    uintptr_t head = atomic_load(&mReturnedBuffers);
+    do {
+        buffer->mNextFree = (MediaBuffer *)head;
+    } while (!atomic_compare_exchange_weak(&mReturnedBuffers, &head, (uintptr_t)buffer));
+
+    if (atomic_load(&mWaiters) > 0) {
+        Mutex::Autolock autoLock(mLock);
+        mCondition.signal();
+    }
 }
 
-void MediaBufferGroup::signalBufferReturned(MediaBuffer *) {
+void MediaBufferGroup::dump(int fd) const {
     Mutex::Autolock autoLock(mLock);
-    mCondition.signal();
+    size_t bytes = 0;
+    for (MediaBuffer *buffer = mFirstBuffer; buffer != NULL; buffer = buffer->nextBuffer()) {
+        bytes += buffer->size();
+    }
+    dprintf(fd, "  MediaBufferGroup %p: %zu buffers (%zu bytes), %d in use, high water %u",
+            this, mNumBuffers, bytes, atomic_load(&mInUse), mStats.mHighWater);
+    if (mGrowthLimit != 0) {
+        dprintf(fd, ", growth limit %zu", mGrowthLimit);
+    }
+    dprintf(fd, "\n");
+    dprintf(fd, "    acquires %u, would block %u, waits %u, wait mean %.1f us max %.1f us\n",
+            mStats.mAcquires, mStats.mWouldBlock, mStats.mWaits,
+            mStats.mWaits > 0 ? mStats.mWaitNs * 1e-3 / mStats.mWaits : 0.,
+            mStats.mMaxWaitNs * 1e-3);
+    dprintf(fd, "    grown %u, replaced %u\n", mStats.mGrowths, mStats.mReplacements);
 }
 
 }  // namespace android
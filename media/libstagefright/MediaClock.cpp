@@ -25,26 +25,93 @@
 
 namespace android {
 
-MediaClock::MediaClock()
-    : mAnchorTimeMediaUs(-1),
-      mAnchorTimeRealUs(-1),
-      mMaxTimeMediaUs(INT64_MAX),
-      mStartingTimeMediaUs(-1),
-      mPlaybackRate(1.0) {
+static uint32_t floatToBits(float value) {
+    union { float f; uint32_t u; } bits;
+    bits.f = value;
+    return bits.u;
+}
+
+static float bitsToFloat(uint32_t value) {
+    union { float f; uint32_t u; } bits;
+    bits.u = value;
+    return bits.f;
+}
+
+MediaClock::MediaClock() {
+    mState.mAnchorTimeMediaUs = -1;
+    mState.mAnchorTimeRealUs = -1;
+    mState.mMaxTimeMediaUs = INT64_MAX;
+    mState.mStartingTimeMediaUs = -1;
+    mState.mPlaybackRate = 1.0;
+
+    atomic_init(&mSeq, 0u);
+    atomic_init(&mSnapAnchorTimeMediaUs, mState.mAnchorTimeMediaUs);
+    atomic_init(&mSnapAnchorTimeRealUs, mState.mAnchorTimeRealUs);
+    atomic_init(&mSnapMaxTimeMediaUs, mState.mMaxTimeMediaUs);
+    atomic_init(&mSnapStartingTimeMediaUs, mState.mStartingTimeMediaUs);
+    atomic_init(&mSnapPlaybackRateBits, floatToBits(mState.mPlaybackRate));
 }
 
 MediaClock::~MediaClock() {
 }
 
+void MediaClock::publish_l() {
+    uint32_t seq = atomic_load_explicit(&mSeq, memory_order_relaxed);
+    atomic_store_explicit(&mSeq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&mSnapAnchorTimeMediaUs,
+            mState.mAnchorTimeMediaUs, memory_order_relaxed);
+    atomic_store_explicit(&mSnapAnchorTimeRealUs,
+            mState.mAnchorTimeRealUs, memory_order_relaxed);
+    atomic_store_explicit(&mSnapMaxTimeMediaUs,
+            mState.mMaxTimeMediaUs, memory_order_relaxed);
+    atomic_store_explicit(&mSnapStartingTimeMediaUs,
+            mState.mStartingTimeMediaUs, memory_order_relaxed);
+    atomic_store_explicit(&mSnapPlaybackRateBits,
+            floatToBits(mState.mPlaybackRate), memory_order_relaxed);
+
+    atomic_store_explicit(&mSeq, seq + 2, memory_order_release);
+}
+
+void MediaClock::readSnapshot(State *state) const {
+    for (;;) {
+        uint32_t seq = atomic_load_explicit(&mSeq, memory_order_acquire);
+        if (seq & 1) {
+            // a setter is in the middle of publish_l(), which only takes a
+            // handful of stores.
+            continue;
+        }
+
+        state->mAnchorTimeMediaUs =
+            atomic_load_explicit(&mSnapAnchorTimeMediaUs, memory_order_relaxed);
+        state->mAnchorTimeRealUs =
+            atomic_load_explicit(&mSnapAnchorTimeRealUs, memory_order_relaxed);
+        state->mMaxTimeMediaUs =
+            atomic_load_explicit(&mSnapMaxTimeMediaUs, memory_order_relaxed);
+        state->mStartingTimeMediaUs =
+            atomic_load_explicit(&mSnapStartingTimeMediaUs, memory_order_relaxed);
+        state->mPlaybackRate = bitsToFloat(
+                atomic_load_explicit(&mSnapPlaybackRateBits, memory_order_relaxed));
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&mSeq, memory_order_relaxed) == seq) {
+            return;
+        }
+    }
+}
+
 void MediaClock::setStartingTimeMedia(int64_t startingTimeMediaUs) {
     Mutex::Autolock autoLock(mLock);
-    mStartingTimeMediaUs = startingTimeMediaUs;
+    mState.mStartingTimeMediaUs = startingTimeMediaUs;
+    publish_l();
 }
 
 void MediaClock::clearAnchor() {
     Mutex::Autolock autoLock(mLock);
-    mAnchorTimeMediaUs = -1;
-    mAnchorTimeRealUs = -1;
+    mState.mAnchorTimeMediaUs = -1;
+    mState.mAnchorTimeRealUs = -1;
+    publish_l();
 }
 
 void MediaClock::updateAnchor(
@@ -59,42 +126,46 @@ void MediaClock::updateAnchor(
     Mutex::Autolock autoLock(mLock);
     int64_t nowUs = ALooper::GetNowUs();
     int64_t nowMediaUs =
-        anchorTimeMediaUs + (nowUs - anchorTimeRealUs) * (double)mPlaybackRate;
+        anchorTimeMediaUs + (nowUs - anchorTimeRealUs) * (double)mState.mPlaybackRate;
     if (nowMediaUs < 0) {
         ALOGW("reject anchor time since it leads to negative media time.");
         return;
     }
-    mAnchorTimeRealUs = nowUs;
-    mAnchorTimeMediaUs = nowMediaUs;
-    mMaxTimeMediaUs = maxTimeMediaUs;
+    mState.mAnchorTimeRealUs = nowUs;
+    mState.mAnchorTimeMediaUs = nowMediaUs;
+    mState.mMaxTimeMediaUs = maxTimeMediaUs;
+    publish_l();
 }
 
 void MediaClock::updateMaxTimeMedia(int64_t maxTimeMediaUs) {
     Mutex::Autolock autoLock(mLock);
-    mMaxTimeMediaUs = maxTimeMediaUs;
+    mState.mMaxTimeMediaUs = maxTimeMediaUs;
+    publish_l();
 }
 
 void MediaClock::setPlaybackRate(float rate) {
     CHECK_GE(rate, 0.0);
     Mutex::Autolock autoLock(mLock);
-    if (mAnchorTimeRealUs == -1) {
-        mPlaybackRate = rate;
+    if (mState.mAnchorTimeRealUs == -1) {
+        mState.mPlaybackRate = rate;
+        publish_l();
         return;
     }
 
     int64_t nowUs = ALooper::GetNowUs();
-    mAnchorTimeMediaUs += (nowUs - mAnchorTimeRealUs) * (double)mPlaybackRate;
-    if (mAnchorTimeMediaUs < 0) {
+    mState.mAnchorTimeMediaUs +=
+        (nowUs - mState.mAnchorTimeRealUs) * (double)mState.mPlaybackRate;
+    if (mState.mAnchorTimeMediaUs < 0) {
         ALOGW("setRate: anchor time should not be negative, set to 0.");
-        mAnchorTimeMediaUs = 0;
+        mState.mAnchorTimeMediaUs = 0;
     }
-    mAnchorTimeRealUs = nowUs;
-    mPlaybackRate = rate;
+    mState.mAnchorTimeRealUs = nowUs;
+    mState.mPlaybackRate = rate;
+    publish_l();
 }
 
 float MediaClock::getPlaybackRate() const {
-    Mutex::Autolock autoLock(mLock);
-    return mPlaybackRate;
+    return bitsToFloat(atomic_load_explicit(&mSnapPlaybackRateBits, memory_order_acquire));
 }
 
 status_t MediaClock::getMediaTime(
@@ -103,23 +174,26 @@ status_t MediaClock::getMediaTime(
         return BAD_VALUE;
     }
 
-    Mutex::Autolock autoLock(mLock);
-    return getMediaTime_l(realUs, outMediaUs, allowPastMaxTime);
+    State state;
+    readSnapshot(&state);
+    return computeMediaTime(state, realUs, outMediaUs, allowPastMaxTime);
 }
 
-status_t MediaClock::getMediaTime_l(
-        int64_t realUs, int64_t *outMediaUs, bool allowPastMaxTime) const {
-    if (mAnchorTimeRealUs == -1) {
+// static
+status_t MediaClock::computeMediaTime(
+        const State &state,
+        int64_t realUs, int64_t *outMediaUs, bool allowPastMaxTime) {
+    if (state.mAnchorTimeRealUs == -1) {
         return NO_INIT;
     }
 
-    int64_t mediaUs = mAnchorTimeMediaUs
-            + (realUs - mAnchorTimeRealUs) * (double)mPlaybackRate;
-    if (mediaUs > mMaxTimeMediaUs && !allowPastMaxTime) {
-        mediaUs = mMaxTimeMediaUs;
+    int64_t mediaUs = state.mAnchorTimeMediaUs
+            + (realUs - state.mAnchorTimeRealUs) * (double)state.mPlaybackRate;
+    if (mediaUs > state.mMaxTimeMediaUs && !allowPastMaxTime) {
+        mediaUs = state.mMaxTimeMediaUs;
     }
-    if (mediaUs < mStartingTimeMediaUs) {
-        mediaUs = mStartingTimeMediaUs;
+    if (mediaUs < state.mStartingTimeMediaUs) {
+        mediaUs = state.mStartingTimeMediaUs;
     }
     if (mediaUs < 0) {
         mediaUs = 0;
@@ -130,23 +204,32 @@ status_t MediaClock::getMediaTime_l(
 
 status_t MediaClock::getRealTimeFor(
         int64_t targetMediaUs, int64_t *outRealUs) const {
-    if (outRealUs == NULL) {
+    return getRealTimesFor(&targetMediaUs, outRealUs, 1);
+}
+
+status_t MediaClock::getRealTimesFor(
+        const int64_t *targetMediaUs, int64_t *outRealUs, size_t count) const {
+    if (targetMediaUs == NULL || outRealUs == NULL) {
         return BAD_VALUE;
     }
 
-    Mutex::Autolock autoLock(mLock);
-    if (mPlaybackRate == 0.0) {
+    State state;
+    readSnapshot(&state);
+    if (state.mPlaybackRate == 0.0) {
         return NO_INIT;
     }
 
     int64_t nowUs = ALooper::GetNowUs();
     int64_t nowMediaUs;
     status_t status =
-            getMediaTime_l(nowUs, &nowMediaUs, true /* allowPastMaxTime */);
+            computeMediaTime(state, nowUs, &nowMediaUs, true /* allowPastMaxTime */);
     if (status != OK) {
         return status;
     }
-    *outRealUs = (targetMediaUs - nowMediaUs) / (double)mPlaybackRate + nowUs;
+    for (size_t i = 0; i < count; ++i) {
+        outRealUs[i] =
+            (targetMediaUs[i] - nowMediaUs) / (double)state.mPlaybackRate + nowUs;
+    }
     return OK;
 }
 
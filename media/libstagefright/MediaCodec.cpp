@@ -32,6 +32,7 @@
 #include <media/IResourceManagerService.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/hexdump.h>
@@ -48,6 +49,7 @@
 #include <media/stagefright/PersistentSurface.h>
 #include <media/stagefright/SurfaceUtils.h>
 #include <mediautils/BatteryNotifier.h>
+#include <mediautils/MediaSchedulingPolicy.h>
 #include <private/android_filesystem_config.h>
 #include <utils/Log.h>
 #include <utils/Singleton.h>
@@ -170,6 +172,16 @@ bool MediaCodec::ResourceManagerServiceProxy::reclaimResource(
     return mService->reclaimResource(mPid, resources);
 }
 
+bool MediaCodec::ResourceManagerServiceProxy::reclaimResourceDryRun(
+        const Vector<MediaResource> &resources, bool *policyConflict) {
+    Mutex::Autolock _l(mLock);
+    *policyConflict = false;
+    if (mService == NULL) {
+        return false;
+    }
+    return mService->reclaimResourceDryRun(mPid, resources, policyConflict);
+}
+
 // static
 sp<MediaCodec> MediaCodec::CreateByType(
         const sp<ALooper> &looper, const char *mime, bool encoder, status_t *err, pid_t pid) {
@@ -255,6 +267,8 @@ MediaCodec::MediaCodec(const sp<ALooper> &looper, pid_t pid)
       mResourceManagerClient(new ResourceManagerClient(this)),
       mResourceManagerService(new ResourceManagerServiceProxy(pid)),
       mBatteryStatNotified(false),
+      mSchedulingSessionId(0),
+      mFrameRate(0),
       mIsVideo(false),
       mVideoWidth(0),
       mVideoHeight(0),
@@ -264,11 +278,17 @@ MediaCodec::MediaCodec(const sp<ALooper> &looper, pid_t pid)
       mDequeueOutputTimeoutGeneration(0),
       mDequeueOutputReplyID(0),
       mHaveInputSurface(false),
-      mHavePendingInputBuffers(false) {
+      mHavePendingInputBuffers(false),
+      mNumLatencySamples(0),
+      mTotalLatencyUs(0),
+      mMaxLatencyUs(0) {
 }
 
 MediaCodec::~MediaCodec() {
     CHECK_EQ(mState, UNINITIALIZED);
+    if (mCodecLooper != NULL) {
+        MediaSchedulingPolicy::getInstance().unregisterThread(mCodecLooper->getTid());
+    }
     mResourceManagerService->removeResource(getId(mResourceManagerClient));
 }
 
@@ -356,6 +376,8 @@ status_t MediaCodec::init(const AString &name, bool nameIsType, bool encoder) {
             mCodecLooper = new ALooper;
             mCodecLooper->setName("CodecLooper");
             mCodecLooper->start(false, false, ANDROID_PRIORITY_AUDIO);
+            MediaSchedulingPolicy::getInstance().registerLooper(
+                    mCodecLooper, MEDIA_LATENCY_CLASS_VIDEO_FRAME);
         }
 
         mCodecLooper->registerHandler(mCodec);
@@ -380,6 +402,16 @@ status_t MediaCodec::init(const AString &name, bool nameIsType, bool encoder) {
     const char *type = secureCodec ? kResourceSecureCodec : kResourceNonSecureCodec;
     const char *subtype = mIsVideo ? kResourceVideoCodec : kResourceAudioCodec;
     resources.push_back(MediaResource(String8(type), String8(subtype), 1));
+
+    // If the codec policies don't allow this codec next to the ones already allocated,
+    // allocating it is bound to fail, and for secure codecs that can be costly.  Reclaim
+    // before the first try then.
+    bool policyConflict;
+    if (mResourceManagerService->reclaimResourceDryRun(resources, &policyConflict)
+            && policyConflict) {
+        mResourceManagerService->reclaimResource(resources);
+    }
+
     for (int i = 0; i <= kMaxRetry; ++i) {
         if (i > 0) {
             // Don't try to reclaim resource for the first time.
@@ -823,6 +855,19 @@ status_t MediaCodec::getName(AString *name) const {
     return OK;
 }
 
+status_t MediaCodec::getStats(sp<AMessage> *stats) const {
+    sp<AMessage> msg = new AMessage(kWhatGetStats, this);
+
+    sp<AMessage> response;
+    status_t err;
+    if ((err = PostAndAwaitResponse(msg, &response)) != OK) {
+        return err;
+    }
+
+    *stats = response;
+    return OK;
+}
+
 status_t MediaCodec::getWidevineLegacyBuffers(Vector<sp<ABuffer> > *buffers) const {
     sp<AMessage> msg = new AMessage(kWhatGetBuffers, this);
     msg->setInt32("portIndex", kPortIndexInput);
@@ -1305,7 +1350,10 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                         }
                     }
 
-                    if (totalSize) {
+                    // All buffers of the previous allocation are gone by now,
+                    // so the heap is reused whenever it is large enough.
+                    if (totalSize > 0 && (mDealer == NULL
+                            || mDealer->getMemoryHeap()->getSize() < totalSize)) {
                         mDealer = new MemoryDealer(totalSize, "MediaCodec");
                     }
 
@@ -1320,6 +1368,15 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                             info.mEncryptedData =
                                 new ABuffer(mem->pointer(), info.mData->capacity());
                             info.mSharedEncryptedBuffer = mem;
+
+                            // Non-secure codecs get the decrypted data written
+                            // straight into their input buffer.
+                            sp<IMemory> dest = portDesc->memRefAt(i);
+                            if (!(mFlags & kFlagIsSecure) && dest != NULL
+                                    && dest->pointer() == info.mData->base()
+                                    && dest->size() >= info.mData->capacity()) {
+                                info.mSharedDecryptedBuffer = dest;
+                            }
                         }
 
                         buffers->push_back(info);
@@ -1470,6 +1527,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
 
                     sp<ABuffer> buffer;
                     CHECK(msg->findBuffer("buffer", &buffer));
+                    onOutputAvailable(buffer);
 
                     int32_t omxFlags;
                     CHECK(msg->findInt32("flags", &omxFlags));
@@ -1690,6 +1748,11 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                 mFlags |= kFlagIsEncoder;
             }
 
+            int32_t frameRateInt;
+            if (!format->findFloat("frame-rate", &mFrameRate)) {
+                mFrameRate = format->findInt32("frame-rate", &frameRateInt) ? frameRateInt : 0;
+            }
+
             extractCSD(format);
 
             mCodec->initiateConfigureComponent(format);
@@ -2120,6 +2183,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             mReplyID = replyID;
             // TODO: skip flushing if already FLUSHED
             setState(FLUSHING);
+            mInputQueueTimesUs.clear();
 
             mCodec->signalFlush();
             returnBuffersToCodec();
@@ -2183,6 +2247,20 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatGetStats:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            sp<AMessage> response = new AMessage;
+            response->setInt64("latency-count", mNumLatencySamples);
+            response->setInt64("latency-avg-us",
+                    mNumLatencySamples > 0 ? mTotalLatencyUs / mNumLatencySamples : 0);
+            response->setInt64("latency-max-us", mMaxLatencyUs);
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatSetParameters:
         {
             sp<AReplyToken> replyID;
@@ -2270,6 +2348,8 @@ void MediaCodec::setState(State newState) {
 
         mActivityNotify.clear();
         mCallback.clear();
+
+        resetLatencyStats();
     }
 
     if (newState == UNINITIALIZED) {
@@ -2287,6 +2367,43 @@ void MediaCodec::setState(State newState) {
     cancelPendingDequeueOperations();
 
     updateBatteryStat();
+    updateSchedulingSession();
+}
+
+void MediaCodec::resetLatencyStats() {
+    mInputQueueTimesUs.clear();
+    mNumLatencySamples = 0;
+    mTotalLatencyUs = 0;
+    mMaxLatencyUs = 0;
+}
+
+void MediaCodec::onInputQueued(int64_t timeUs) {
+    // Codecs that drop frames never produce output for some inputs, so only the latest
+    // presentation times are kept.
+    static const size_t kMaxPendingInputs = 64;
+    if (mInputQueueTimesUs.size() >= kMaxPendingInputs) {
+        mInputQueueTimesUs.removeItemsAt(0);
+    }
+    mInputQueueTimesUs.add(timeUs, ALooper::GetNowUs());
+}
+
+void MediaCodec::onOutputAvailable(const sp<ABuffer> &buffer) {
+    int64_t timeUs;
+    if (!buffer->meta()->findInt64("timeUs", &timeUs)) {
+        return;
+    }
+    ssize_t index = mInputQueueTimesUs.indexOfKey(timeUs);
+    if (index < 0) {
+        return;
+    }
+    int64_t latencyUs = ALooper::GetNowUs() - mInputQueueTimesUs.valueAt(index);
+    mInputQueueTimesUs.removeItemsAt(index);
+
+    ++mNumLatencySamples;
+    mTotalLatencyUs += latencyUs;
+    if (latencyUs > mMaxLatencyUs) {
+        mMaxLatencyUs = latencyUs;
+    }
 }
 
 void MediaCodec::returnBuffersToCodec() {
@@ -2424,6 +2541,9 @@ status_t MediaCodec::onQueueInputBuffer(const sp<AMessage> &msg) {
     sp<AMessage> reply = info->mNotify;
     info->mData->setRange(offset, size);
     info->mData->meta()->setInt64("timeUs", timeUs);
+    if (!(flags & BUFFER_FLAG_CODECCONFIG)) {
+        onInputQueued(timeUs);
+    }
 
     if (flags & BUFFER_FLAG_EOS) {
         info->mData->meta()->setInt32("eos", true);
@@ -2441,17 +2561,31 @@ status_t MediaCodec::onQueueInputBuffer(const sp<AMessage> &msg) {
         AString *errorDetailMsg;
         CHECK(msg->findPointer("errorDetailMsg", (void **)&errorDetailMsg));
 
-        ssize_t result = mCrypto->decrypt(
-                (mFlags & kFlagIsSecure) != 0,
-                key,
-                iv,
-                mode,
-                info->mSharedEncryptedBuffer,
-                offset,
-                subSamples,
-                numSubSamples,
-                info->mData->base(),
-                errorDetailMsg);
+        ssize_t result;
+        if (info->mSharedDecryptedBuffer != NULL) {
+            result = mCrypto->decrypt(
+                    key,
+                    iv,
+                    mode,
+                    info->mSharedEncryptedBuffer,
+                    offset,
+                    subSamples,
+                    numSubSamples,
+                    info->mSharedDecryptedBuffer,
+                    errorDetailMsg);
+        } else {
+            result = mCrypto->decrypt(
+                    (mFlags & kFlagIsSecure) != 0,
+                    key,
+                    iv,
+                    mode,
+                    info->mSharedEncryptedBuffer,
+                    offset,
+                    subSamples,
+                    numSubSamples,
+                    info->mData->base(),
+                    errorDetailMsg);
+        }
 
         if (result < 0) {
             return result;
@@ -2832,4 +2966,15 @@ void MediaCodec::updateBatteryStat() {
     }
 }
 
+void MediaCodec::updateSchedulingSession() {
+    bool active = mState == STARTED || mState == FLUSHING || mState == FLUSHED;
+    if (active && mSchedulingSessionId == 0) {
+        mSchedulingSessionId = MediaSchedulingPolicy::getInstance().startSession(
+                mIsVideo, (mFlags & kFlagIsEncoder) != 0, mFrameRate);
+    } else if (!active && mSchedulingSessionId != 0) {
+        MediaSchedulingPolicy::getInstance().stopSession(mSchedulingSessionId);
+        mSchedulingSessionId = 0;
+    }
+}
+
 }  // namespace android
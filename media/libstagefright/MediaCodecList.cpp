@@ -21,6 +21,8 @@
 #include "MediaCodecListOverrides.h"
 
 #include <binder/IServiceManager.h>
+#include <binder/MemoryBase.h>
+#include <binder/MemoryHeapBase.h>
 
 #include <media/IMediaCodecList.h>
 #include <media/IMediaPlayerService.h>
@@ -28,6 +30,7 @@
 #include <media/MediaCodecInfo.h>
 #include <media/MediaResourcePolicy.h>
 
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaCodecList.h>
@@ -35,7 +38,10 @@
 #include <media/stagefright/OMXClient.h>
 #include <media/stagefright/OMXCodec.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <utils/threads.h>
 
 #include <cutils/properties.h>
@@ -46,8 +52,41 @@ namespace android {
 
 const char *kMaxEncoderInputBuffers = "max-video-encoder-input-buffers";
 
+static const char *kCodecListCache = "/data/misc/media/media_codecs_cache.bin";
+
+// Header of a serialized list, followed by mSize bytes of parcel data.
+struct SerializedCodecListHeader {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mSize;
+    uint32_t mChecksum;     // of the parcel data
+};
+
+static const uint32_t kSerializedCodecListMagic = 0x4d434c53;  // 'MCLS'
+static const uint32_t kSerializedCodecListVersion = 1;
+
 static Mutex sInitMutex;
 
+// FNV-1a, enough to reject a truncated or corrupted cache file.
+static uint32_t checksum(const uint8_t *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void getFileStamp(const char *path, int64_t *size, int64_t *modifiedTime) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        *size = -1;
+        *modifiedTime = -1;
+        return;
+    }
+    *size = st.st_size;
+    *modifiedTime = st.st_mtime;
+}
+
 static bool parseBoolean(const char *s) {
     if (!strcasecmp(s, "true") || !strcasecmp(s, "yes") || !strcasecmp(s, "y")) {
         return true;
@@ -103,6 +142,7 @@ void *MediaCodecList::profilerThreadWrapper(void * /*arg*/) {
     profileCodecs(infos);
     ALOGV("Codec profiling completed.");
     codecList->parseTopLevelXMLFile(kProfilingResults, true /* ignore_errors */);
+    codecList->saveCache();
 
     {
         Mutex::Autolock autoLock(sInitMutex);
@@ -119,6 +159,9 @@ sp<IMediaCodecList> MediaCodecList::getLocalInstance() {
         MediaCodecList *codecList = new MediaCodecList;
         if (codecList->initCheck() == OK) {
             sCodecList = codecList;
+            if (!codecList->mLoadedFromCache) {
+                codecList->saveCache();
+            }
 
             if (isProfilingNeeded()) {
                 ALOGV("Codec profiling needed, will be run in separated thread.");
@@ -161,6 +204,21 @@ sp<IMediaCodecList> MediaCodecList::getInstance() {
             if (sRemoteList != NULL) {
                 sBinderDeathObserver = new BinderDeathObserver();
                 binder->linkToDeath(sBinderDeathObserver.get());
+
+                // Answer queries from a local copy of the list, rather than with a
+                // transaction each. The copy is kept until mediaserver dies.
+                sp<IMemory> serialized;
+                if (IInterface::asBinder(sRemoteList)->localBinder() == NULL) {
+                    serialized = sRemoteList->getSerializedList();
+                }
+                if (serialized != NULL) {
+                    MediaCodecList *codecList = new MediaCodecList(serialized);
+                    if (codecList->initCheck() == OK) {
+                        sRemoteList = codecList;
+                    } else {
+                        delete codecList;
+                    }
+                }
             }
         }
         if (sRemoteList == NULL) {
@@ -173,13 +231,37 @@ sp<IMediaCodecList> MediaCodecList::getInstance() {
 
 MediaCodecList::MediaCodecList()
     : mInitCheck(NO_INIT),
+      mLoadedFromCache(false),
       mUpdate(false),
       mGlobalSettings(new AMessage()) {
+    if (loadCache()) {
+        // the codecs were already probed, with the same build and configuration
+        ALOGV("loaded %zu codecs from %s", mCodecInfos.size(), kCodecListCache);
+        mInitCheck = OK;
+        mLoadedFromCache = true;
+        configureResourceManager();
+        return;
+    }
     parseTopLevelXMLFile(AVUtils::get()->getCustomCodecsLocation());
     parseTopLevelXMLFile("/etc/media_codecs_performance.xml", true/* ignore_errors */);
     parseTopLevelXMLFile(kProfilingResults, true/* ignore_errors */);
 }
 
+MediaCodecList::MediaCodecList(const sp<IMemory> &serialized)
+    : mInitCheck(NO_INIT),
+      mLoadedFromCache(true),
+      mUpdate(false),
+      mGlobalSettings(new AMessage()) {
+    if (serialized->pointer() != NULL && deserialize(
+            (const uint8_t *)serialized->pointer(), serialized->size(),
+            false /* checkConfigFiles */)) {
+        mInitCheck = OK;
+    } else {
+        ALOGW("malformed serialized codec list");
+        mInitCheck = ERROR_MALFORMED;
+    }
+}
+
 void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml, bool ignore_errors) {
     // get href_base
     char *href_base_end = strrchr(codecs_xml, '/');
@@ -209,30 +291,7 @@ void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml, bool ignore_er
         return;
     }
 
-    Vector<MediaResourcePolicy> policies;
-    AString value;
-    if (mGlobalSettings->findString(kPolicySupportsMultipleSecureCodecs, &value)) {
-        policies.push_back(
-                MediaResourcePolicy(
-                        String8(kPolicySupportsMultipleSecureCodecs),
-                        String8(value.c_str())));
-    }
-    if (mGlobalSettings->findString(kPolicySupportsSecureWithNonSecureCodec, &value)) {
-        policies.push_back(
-                MediaResourcePolicy(
-                        String8(kPolicySupportsSecureWithNonSecureCodec),
-                        String8(value.c_str())));
-    }
-    if (policies.size() > 0) {
-        sp<IServiceManager> sm = defaultServiceManager();
-        sp<IBinder> binder = sm->getService(String16("media.resource_manager"));
-        sp<IResourceManagerService> service = interface_cast<IResourceManagerService>(binder);
-        if (service == NULL) {
-            ALOGE("MediaCodecList: failed to get ResourceManagerService");
-        } else {
-            service->config(policies);
-        }
-    }
+    configureResourceManager();
 
     for (size_t i = mCodecInfos.size(); i > 0;) {
         i--;
@@ -322,7 +381,203 @@ status_t MediaCodecList::initCheck() const {
     return mInitCheck;
 }
 
+void MediaCodecList::configureResourceManager() const {
+    Vector<MediaResourcePolicy> policies;
+    AString value;
+    if (mGlobalSettings->findString(kPolicySupportsMultipleSecureCodecs, &value)) {
+        policies.push_back(
+                MediaResourcePolicy(
+                        String8(kPolicySupportsMultipleSecureCodecs),
+                        String8(value.c_str())));
+    }
+    if (mGlobalSettings->findString(kPolicySupportsSecureWithNonSecureCodec, &value)) {
+        policies.push_back(
+                MediaResourcePolicy(
+                        String8(kPolicySupportsSecureWithNonSecureCodec),
+                        String8(value.c_str())));
+    }
+    if (policies.size() > 0) {
+        sp<IServiceManager> sm = defaultServiceManager();
+        sp<IBinder> binder = sm->getService(String16("media.resource_manager"));
+        sp<IResourceManagerService> service = interface_cast<IResourceManagerService>(binder);
+        if (service == NULL) {
+            ALOGE("MediaCodecList: failed to get ResourceManagerService");
+        } else {
+            service->config(policies);
+        }
+    }
+
+}
+
+void MediaCodecList::addConfigFile(const char *path) {
+    ConfigFile file;
+    file.mPath = path;
+    getFileStamp(path, &file.mSize, &file.mModifiedTime);
+    for (size_t i = 0; i < mConfigFiles.size(); ++i) {
+        if (mConfigFiles[i].mPath == file.mPath) {
+            mConfigFiles.editItemAt(i) = file;
+            return;
+        }
+    }
+    mConfigFiles.push_back(file);
+}
+
+sp<ABuffer> MediaCodecList::serialize() const {
+    Parcel parcel;
+    char fingerprint[PROPERTY_VALUE_MAX];
+    property_get("ro.build.fingerprint", fingerprint, "");
+    parcel.writeCString(fingerprint);
+    parcel.writeInt32(mConfigFiles.size());
+    for (size_t i = 0; i < mConfigFiles.size(); ++i) {
+        parcel.writeCString(mConfigFiles[i].mPath.c_str());
+        parcel.writeInt64(mConfigFiles[i].mSize);
+        parcel.writeInt64(mConfigFiles[i].mModifiedTime);
+    }
+    mGlobalSettings->writeToParcel(&parcel);
+    parcel.writeInt32(mCodecInfos.size());
+    for (size_t i = 0; i < mCodecInfos.size(); ++i) {
+        mCodecInfos[i]->writeToParcel(&parcel);
+    }
+
+    SerializedCodecListHeader header;
+    header.mMagic = kSerializedCodecListMagic;
+    header.mVersion = kSerializedCodecListVersion;
+    header.mSize = parcel.dataSize();
+    header.mChecksum = checksum(parcel.data(), parcel.dataSize());
+
+    sp<ABuffer> buffer = new ABuffer(sizeof(header) + parcel.dataSize());
+    memcpy(buffer->data(), &header, sizeof(header));
+    memcpy(buffer->data() + sizeof(header), parcel.data(), parcel.dataSize());
+    return buffer;
+}
+
+bool MediaCodecList::deserialize(const uint8_t *data, size_t size, bool checkConfigFiles) {
+    SerializedCodecListHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.mMagic != kSerializedCodecListMagic
+            || header.mVersion != kSerializedCodecListVersion
+            || header.mSize != size - sizeof(header)
+            || header.mChecksum != checksum(data + sizeof(header), header.mSize)) {
+        return false;
+    }
+
+    Parcel parcel;
+    parcel.setData(data + sizeof(header), header.mSize);
+
+    const char *fingerprint = parcel.readCString();
+    if (fingerprint == NULL) {
+        return false;
+    }
+    if (checkConfigFiles) {
+        char currentFingerprint[PROPERTY_VALUE_MAX];
+        property_get("ro.build.fingerprint", currentFingerprint, "");
+        if (strcmp(fingerprint, currentFingerprint)) {
+            ALOGV("codec list was built by %s", fingerprint);
+            return false;
+        }
+    }
+
+    Vector<ConfigFile> configFiles;
+    size_t numConfigFiles = parcel.readInt32();
+    for (size_t i = 0; i < numConfigFiles; ++i) {
+        const char *path = parcel.readCString();
+        if (path == NULL) {
+            return false;
+        }
+        ConfigFile file;
+        file.mPath = path;
+        file.mSize = parcel.readInt64();
+        file.mModifiedTime = parcel.readInt64();
+        if (checkConfigFiles) {
+            int64_t currentSize, currentModifiedTime;
+            getFileStamp(path, &currentSize, &currentModifiedTime);
+            if (currentSize != file.mSize || currentModifiedTime != file.mModifiedTime) {
+                ALOGV("%s changed since the codec list was built", path);
+                return false;
+            }
+        }
+        configFiles.push_back(file);
+    }
+
+    sp<AMessage> globalSettings = AMessage::FromParcel(parcel);
+    Vector<sp<MediaCodecInfo> > codecInfos;
+    size_t numCodecs = parcel.readInt32();
+    for (size_t i = 0; i < numCodecs && parcel.dataAvail() > 0; ++i) {
+        sp<MediaCodecInfo> info = MediaCodecInfo::FromParcel(parcel);
+        if (info == NULL) {
+            return false;
+        }
+        codecInfos.push_back(info);
+    }
+    if (globalSettings == NULL || codecInfos.size() != numCodecs) {
+        return false;
+    }
+
+    mConfigFiles = configFiles;
+    mGlobalSettings = globalSettings;
+    mCodecInfos = codecInfos;
+    return true;
+}
+
+bool MediaCodecList::loadCache() {
+    int fd = open(kCodecListCache, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    bool loaded = deserialize((const uint8_t *)data, st.st_size, true /* checkConfigFiles */);
+    munmap(data, st.st_size);
+    return loaded;
+}
+
+void MediaCodecList::saveCache() const {
+    sp<ABuffer> buffer = serialize();
+
+    // write a temporary file and rename it, so that the cache is never seen half written
+    AString tmpPath = AStringPrintf("%s.%d", kCodecListCache, gettid());
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        ALOGV("unable to create %s", tmpPath.c_str());
+        return;
+    }
+    ssize_t written = write(fd, buffer->data(), buffer->size());
+    close(fd);
+    if (written != (ssize_t)buffer->size() || rename(tmpPath.c_str(), kCodecListCache) != 0) {
+        ALOGW("unable to write %s", kCodecListCache);
+        unlink(tmpPath.c_str());
+    }
+}
+
+sp<IMemory> MediaCodecList::getSerializedList() const {
+    Mutex::Autolock autoLock(mSerializedLock);
+    if (mSerialized == NULL) {
+        sp<ABuffer> buffer = serialize();
+        // writable here, but read-only once mapped by clients
+        sp<MemoryHeapBase> heap = new MemoryHeapBase(
+                buffer->size(), MemoryHeapBase::READ_ONLY, "MediaCodecList");
+        if (heap->getHeapID() < 0 || heap->getBase() == MAP_FAILED) {
+            return NULL;
+        }
+        memcpy(heap->getBase(), buffer->data(), buffer->size());
+        mSerialized = new MemoryBase(heap, 0, buffer->size());
+    }
+    return mSerialized;
+}
+
 void MediaCodecList::parseXMLFile(const char *path) {
+    addConfigFile(path);
     FILE *file = fopen(path, "r");
 
     if (file == NULL) {
@@ -346,6 +346,8 @@ MediaCodecSource::MediaCodecSource(
       mIsVideo(false),
       mStarted(false),
       mStopping(false),
+      mParked(false),
+      mCodecConfigSent(false),
       mDoMoreWorkPending(false),
       mSetEncoderFormat(false),
       mEncoderFormat(0),
@@ -532,7 +534,12 @@ void MediaCodecSource::signalEOS(status_t err) {
             mOutputBufferCond.signal();
         }
 
-        releaseEncoder();
+        if ((mFlags & FLAG_REUSE_ENCODER) && (mFlags & FLAG_USE_SURFACE_INPUT)
+                && mStopping && err == ERROR_END_OF_STREAM && mEncoder != NULL) {
+            parkEncoder();
+        } else {
+            releaseEncoder();
+        }
     }
     if (mStopping && mEncoderReachedEOS) {
         ALOGI("encoder (%s) stopped", mIsVideo ? "video" : "audio");
@@ -547,6 +554,63 @@ void MediaCodecSource::signalEOS(status_t err) {
     }
 }
 
+void MediaCodecSource::parkEncoder() {
+    // Drop frames until the next start(), and get the encoder out of its
+    // end of stream state while keeping the component and buffers.
+    suspend();
+    status_t err = mEncoder->flush();
+    if (err != OK) {
+        ALOGW("encoder (%s) cannot be kept (%d)", mIsVideo ? "video" : "audio", err);
+        releaseEncoder();
+        return;
+    }
+    mAvailEncoderInputIndices.clear();
+    mDecodingTimeQueue.clear();
+    mParked = true;
+    mStarted = false;
+    ALOGI("encoder (%s) parked", mIsVideo ? "video" : "audio");
+}
+
+status_t MediaCodecSource::restartEncoder() {
+    mParked = false;
+
+    status_t err = mEncoder->start();
+    if (err == OK) {
+        sp<AMessage> params = new AMessage;
+        params->setInt32("reset-input-eos", true);
+        err = mEncoder->setParameters(params);
+    }
+    if (err != OK) {
+        ALOGE("encoder (%s) failed to restart (%d)", mIsVideo ? "video" : "audio", err);
+        releaseEncoder();
+        return err;
+    }
+
+    {
+        Mutex::Autolock autoLock(mOutputBufferLock);
+        mEncoderReachedEOS = false;
+        mErrorCode = OK;
+
+        // The writer of the new session needs the codec specific data
+        // first, and the encoder does not emit it again after a flush.
+        if (mCodecConfig != NULL) {
+            MediaBuffer *mbuf = new MediaBuffer(mCodecConfig->size());
+            memcpy(mbuf->data(), mCodecConfig->data(), mCodecConfig->size());
+            mbuf->meta_data()->setInt32(kKeyIsCodecConfig, true);
+            mbuf->setObserver(this);
+            mbuf->add_ref();
+            mOutputBufferQueue.push_back(mbuf);
+            mOutputBufferCond.signal();
+        }
+    }
+    mCodecConfigSent = mCodecConfig != NULL;
+
+    // The new file has to start with a sync frame.
+    mEncoder->requestIDRFrame();
+    ALOGI("encoder (%s) restarted", mIsVideo ? "video" : "audio");
+    return OK;
+}
+
 void MediaCodecSource::suspend() {
     CHECK(mFlags & FLAG_USE_SURFACE_INPUT);
     if (mEncoder != NULL) {
@@ -614,14 +678,25 @@ status_t MediaCodecSource::feedEncoderInputBuffers() {
             }
 
             size = mbuf->size();
+            if (size > inbuf->capacity()) {
+                ALOGE("input buffer of %zu bytes does not fit encoder buffer of %zu bytes",
+                        size, inbuf->capacity());
+                mbuf->release();
+                signalEOS(ERROR_BUFFER_TOO_SMALL);
+                break;
+            }
 
+            // In metadata mode this only copies the buffer handle, the pixel data
+            // stays in the camera buffer until the encoder releases it.
             memcpy(inbuf->data(), mbuf->data(), size);
 
-            if (mIsVideo) {
+            if (mIsVideo && (mFlags & FLAG_USE_METADATA_INPUT)) {
                 // video encoder will release MediaBuffer when done
                 // with underlying data.
                 inbuf->setMediaBufferBase(mbuf);
             } else {
+                // The frame has been copied, return it to the source right away
+                // instead of holding a camera buffer for the encoder's latency.
                 mbuf->release();
             }
         } else {
@@ -645,6 +720,13 @@ status_t MediaCodecSource::onStart(MetaData *params) {
         return INVALID_OPERATION;
     }
 
+    if (mParked) {
+        status_t err = restartEncoder();
+        if (err != OK) {
+            return err;
+        }
+    }
+
     if (mStarted) {
         ALOGI("MediaCodecSource (%s) resuming", mIsVideo ? "video" : "audio");
         if (mFlags & FLAG_USE_SURFACE_INPUT) {
@@ -807,6 +889,16 @@ void MediaCodecSource::onMessageReceived(const sp<AMessage> &msg) {
                 }
                 mbuf->meta_data()->setInt64(kKeyTime, timeUs);
             } else {
+                if (mFlags & FLAG_REUSE_ENCODER) {
+                    if (mCodecConfigSent) {
+                        // Already replayed by restartEncoder().
+                        mbuf->release();
+                        mEncoder->releaseOutputBuffer(index);
+                        break;
+                    }
+                    mCodecConfig = ABuffer::CreateAsCopy(outbuf->data(), outbuf->size());
+                    mCodecConfigSent = true;
+                }
                 mbuf->meta_data()->setInt32(kKeyIsCodecConfig, true);
             }
             if (flags & MediaCodec::BUFFER_FLAG_SYNCFRAME) {
@@ -101,9 +101,13 @@ sp<MediaExtractor> MediaExtractor::Create(
         }
     }
 
+    const bool metaDataOnly = (flags & kMetaDataOnly) != 0;
+    const uint32_t extendedFlags = flags & ~kMetaDataOnly;
+
     sp<MediaExtractor> ret;
     AString extractorName;
-    if ((ret = AVFactory::get()->createExtendedExtractor(source, mime, meta, flags)) != NULL) {
+    if ((ret = AVFactory::get()->createExtendedExtractor(
+            source, mime, meta, extendedFlags)) != NULL) {
         ALOGI("Using extended extractor");
     } else if (meta.get() && meta->findString("extended-extractor-use", &extractorName)
             && sPlugin.create) {
@@ -111,9 +115,9 @@ sp<MediaExtractor> MediaExtractor::Create(
         ret = sPlugin.create(source, mime, meta);
     } else if (!strcasecmp(mime, MEDIA_MIMETYPE_CONTAINER_MPEG4)
             || !strcasecmp(mime, "audio/mp4")) {
-        ret = new MPEG4Extractor(source);
+        ret = new MPEG4Extractor(source, metaDataOnly);
     } else if (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_MPEG)) {
-        ret = new MP3Extractor(source, meta);
+        ret = new MP3Extractor(source, meta, metaDataOnly);
     } else if (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AMR_NB)
             || !strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AMR_WB)) {
         ret = new AMRExtractor(source);
@@ -124,7 +128,7 @@ sp<MediaExtractor> MediaExtractor::Create(
     } else if (!strcasecmp(mime, MEDIA_MIMETYPE_CONTAINER_OGG)) {
         ret = new OggExtractor(source);
     } else if (!strcasecmp(mime, MEDIA_MIMETYPE_CONTAINER_MATROSKA)) {
-        ret = new MatroskaExtractor(source);
+        ret = new MatroskaExtractor(source, metaDataOnly);
     } else if (!strcasecmp(mime, MEDIA_MIMETYPE_CONTAINER_MPEG2TS)) {
         ret = new MPEG2TSExtractor(source);
     } else if (!strcasecmp(mime, MEDIA_MIMETYPE_CONTAINER_WVM)) {
@@ -140,7 +144,7 @@ sp<MediaExtractor> MediaExtractor::Create(
         ret = sPlugin.create(source, mime, meta);
     }
 
-    ret = AVFactory::get()->updateExtractor(ret, source, mime, meta, flags);
+    ret = AVFactory::get()->updateExtractor(ret, source, mime, meta, extendedFlags);
     if (ret != NULL) {
        if (isDrm) {
            ret->setDrmFlag(true);
@@ -41,8 +41,10 @@ namespace android {
 
 MediaMuxer::MediaMuxer(int fd, OutputFormat format)
     : mFormat(format),
+      mMaxQueuedBytes(MediaAdapter::kDefaultMaxQueuedBytes),
       mState(UNINITIALIZED) {
-    if (format == OUTPUT_FORMAT_MPEG_4) {
+    if (format == OUTPUT_FORMAT_MPEG_4
+            || format == OUTPUT_FORMAT_FRAGMENTED_MPEG_4) {
         mWriter = AVFactory::get()->CreateMPEG4Writer(fd);
     } else if (format == OUTPUT_FORMAT_WEBM) {
         mWriter = new WebmWriter(fd);
@@ -80,6 +82,7 @@ ssize_t MediaMuxer::addTrack(const sp<AMessage> &format) {
     convertMessageToMetaData(format, trackMeta);
 
     sp<MediaAdapter> newTrack = new MediaAdapter(trackMeta);
+    newTrack->setMaxQueuedBytes(mMaxQueuedBytes);
     status_t result = mWriter->addSource(newTrack);
     if (result == OK) {
         return mTrackList.add(newTrack);
@@ -109,7 +112,8 @@ status_t MediaMuxer::setLocation(int latitude, int longitude) {
         ALOGE("setLocation() must be called before start().");
         return INVALID_OPERATION;
     }
-    if (mFormat != OUTPUT_FORMAT_MPEG_4) {
+    if (mFormat != OUTPUT_FORMAT_MPEG_4
+            && mFormat != OUTPUT_FORMAT_FRAGMENTED_MPEG_4) {
         ALOGE("setLocation() is only supported for .mp4 output.");
         return INVALID_OPERATION;
     }
@@ -123,6 +127,9 @@ status_t MediaMuxer::start() {
     if (mState == INITIALIZED) {
         mState = STARTED;
         mFileMeta->setInt32(kKeyRealTimeRecording, false);
+        if (mFormat == OUTPUT_FORMAT_FRAGMENTED_MPEG_4) {
+            mFileMeta->setInt64(kKeyFragmentDurationUs, 1000000ll);
+        }
         return mWriter->start(mFileMeta.get());
     } else {
         ALOGE("start() is called in invalid state %d", mState);
@@ -147,10 +154,7 @@ status_t MediaMuxer::stop() {
     }
 }
 
-status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
-                                     int64_t timeUs, uint32_t flags) {
-    Mutex::Autolock autoLock(mMuxerLock);
-
+status_t MediaMuxer::checkSampleData_l(const sp<ABuffer> &buffer, size_t trackIndex) {
     if (buffer.get() == NULL) {
         ALOGE("WriteSampleData() get an NULL buffer.");
         return -EINVAL;
@@ -166,6 +170,12 @@ status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackInde
         return -EINVAL;
     }
 
+    return OK;
+}
+
+MediaBuffer *MediaMuxer::createSampleBuffer_l(const sp<ABuffer> &buffer,
+                                              int64_t timeUs, uint32_t flags) {
+    // Wraps the ABuffer, the sample data itself is never copied.
     MediaBuffer* mediaBuffer = new MediaBuffer(buffer);
 
     mediaBuffer->add_ref(); // Released in MediaAdapter::signalBufferReturned().
@@ -180,9 +190,51 @@ status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackInde
         sampleMetaData->setInt32(kKeyIsSyncFrame, true);
     }
 
+    return mediaBuffer;
+}
+
+status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
+                                     int64_t timeUs, uint32_t flags) {
+    Mutex::Autolock autoLock(mMuxerLock);
+
+    status_t err = checkSampleData_l(buffer, trackIndex);
+    if (err != OK) {
+        return err;
+    }
+
+    MediaBuffer* mediaBuffer = createSampleBuffer_l(buffer, timeUs, flags);
+
     sp<MediaAdapter> currentTrack = mTrackList[trackIndex];
     // This pushBuffer will wait until the mediaBuffer is consumed.
     return currentTrack->pushBuffer(mediaBuffer);
 }
 
+status_t MediaMuxer::writeSampleDataAsync(const sp<ABuffer> &buffer, size_t trackIndex,
+                                          int64_t timeUs, uint32_t flags,
+                                          const sp<AMessage> &notify) {
+    Mutex::Autolock autoLock(mMuxerLock);
+
+    status_t err = checkSampleData_l(buffer, trackIndex);
+    if (err != OK) {
+        return err;
+    }
+
+    MediaBuffer* mediaBuffer = createSampleBuffer_l(buffer, timeUs, flags);
+
+    sp<MediaAdapter> currentTrack = mTrackList[trackIndex];
+    return currentTrack->queueBuffer(mediaBuffer, notify);
+}
+
+status_t MediaMuxer::setMaxQueuedBytes(size_t maxQueuedBytes) {
+    Mutex::Autolock autoLock(mMuxerLock);
+    if (maxQueuedBytes == 0) {
+        return -EINVAL;
+    }
+    mMaxQueuedBytes = maxQueuedBytes;
+    for (size_t i = 0; i < mTrackList.size(); ++i) {
+        mTrackList[i]->setMaxQueuedBytes(maxQueuedBytes);
+    }
+    return OK;
+}
+
 }  // namespace android
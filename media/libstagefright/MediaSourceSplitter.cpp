@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaSourceSplitter"
+#include <utils/Log.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaSourceSplitter.h>
+#include <media/stagefright/MetaData.h>
+
+namespace android {
+
+// MediaBuffer::release() deletes buffers that have no observer on the first release,
+// so they cannot be shared as is.  Such buffers are given this observer while they
+// are shared, which deletes them once the last client releases them.  It is a static
+// so that it outlives any splitter whose buffers are still held by an encoder.
+struct SharedBufferDeleter : public MediaBufferObserver {
+    virtual void signalBufferReturned(MediaBuffer *buffer) {
+        buffer->setObserver(NULL);
+        buffer->release();
+    }
+};
+
+static SharedBufferDeleter sSharedBufferDeleter;
+
+struct MediaSourceSplitter::Client : public MediaSource {
+    Client(const sp<MediaSourceSplitter> &splitter)
+        : mSplitter(splitter),
+          mStarted(false),
+          mLastGeneration(0) {
+    }
+
+    virtual status_t start(MetaData *params) {
+        if (mStarted) {
+            return OK;
+        }
+        status_t err = mSplitter->startClient(params, &mLastGeneration);
+        if (err == OK) {
+            mStarted = true;
+        }
+        return err;
+    }
+
+    virtual status_t stop() {
+        if (!mStarted) {
+            return OK;
+        }
+        mStarted = false;
+        return mSplitter->stopClient(mLastGeneration);
+    }
+
+    virtual sp<MetaData> getFormat() {
+        return mSplitter->mSource->getFormat();
+    }
+
+    virtual status_t read(MediaBuffer **buffer, const ReadOptions *options) {
+        *buffer = NULL;
+        if (!mStarted) {
+            return INVALID_OPERATION;
+        }
+        return mSplitter->readClient(&mLastGeneration, buffer, options);
+    }
+
+protected:
+    virtual ~Client() {
+        stop();
+    }
+
+private:
+    sp<MediaSourceSplitter> mSplitter;
+    bool mStarted;
+    int64_t mLastGeneration;
+
+    DISALLOW_EVIL_CONSTRUCTORS(Client);
+};
+
+MediaSourceSplitter::MediaSourceSplitter(const sp<MediaSource> &source)
+    : mSource(source),
+      mNumStarted(0),
+      mSourceStarted(false),
+      mReading(false),
+      mBuffer(NULL),
+      mReadStatus(OK),
+      mGeneration(0),
+      mNumReadCurrent(0) {
+    CHECK(source != NULL);
+}
+
+MediaSourceSplitter::~MediaSourceSplitter() {
+    CHECK(mBuffer == NULL);
+    CHECK(!mSourceStarted);
+}
+
+sp<MediaSource> MediaSourceSplitter::createClient() {
+    return new Client(this);
+}
+
+status_t MediaSourceSplitter::startClient(MetaData *params, int64_t *generation) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mSourceStarted) {
+        status_t err = mSource->start(params);
+        if (err != OK) {
+            ALOGE("failed to start source: %d", err);
+            return err;
+        }
+        mSourceStarted = true;
+        mReadStatus = OK;
+    }
+    ++mNumStarted;
+    // A new client must only see buffers read after it started.
+    if (mBuffer != NULL) {
+        ++mNumReadCurrent;
+    }
+    *generation = mGeneration;
+    return OK;
+}
+
+status_t MediaSourceSplitter::stopClient(int64_t lastGeneration) {
+    Mutex::Autolock autoLock(mLock);
+    CHECK_GT(mNumStarted, 0u);
+    --mNumStarted;
+    if (lastGeneration == mGeneration && mNumReadCurrent > 0) {
+        // This client had read the current buffer, it is no longer waited for.
+        --mNumReadCurrent;
+    }
+    releaseCurrentIfDone_l();
+    mCondition.broadcast();
+
+    if (mNumStarted > 0) {
+        return OK;
+    }
+
+    // Let a client blocked in mSource->read() return before stopping the source.
+    mSourceStarted = false;
+    mLock.unlock();
+    status_t err = mSource->stop();
+    mLock.lock();
+    while (mReading) {
+        mCondition.wait(mLock);
+    }
+    if (mBuffer != NULL) {
+        mBuffer->release();
+        mBuffer = NULL;
+    }
+    return err;
+}
+
+status_t MediaSourceSplitter::readClient(int64_t *lastGeneration, MediaBuffer **buffer,
+        const MediaSource::ReadOptions *options) {
+    Mutex::Autolock autoLock(mLock);
+
+    while (*lastGeneration == mGeneration) {
+        if (!mSourceStarted) {
+            return ERROR_END_OF_STREAM;
+        }
+        if (mReadStatus != OK) {
+            return mReadStatus;
+        }
+        if (mReading || mBuffer != NULL) {
+            // Wait until the others have read the current buffer, or another client
+            // has pulled the next one.
+            mCondition.wait(mLock);
+            continue;
+        }
+
+        mReading = true;
+        MediaBuffer *next = NULL;
+        mLock.unlock();
+        status_t err = mSource->read(&next, options);
+        mLock.lock();
+        mReading = false;
+
+        if (err == OK && next != NULL && next->refcount() == 0) {
+            // A buffer without an observer, see SharedBufferDeleter.
+            next->setObserver(&sSharedBufferDeleter);
+            next->add_ref();
+        }
+        if (!mSourceStarted) {
+            if (next != NULL) {
+                next->release();
+            }
+            mCondition.broadcast();
+            return ERROR_END_OF_STREAM;
+        }
+
+        mBuffer = (err == OK) ? next : NULL;
+        mReadStatus = err;
+        mNumReadCurrent = 0;
+        ++mGeneration;
+        mCondition.broadcast();
+    }
+
+    *lastGeneration = mGeneration;
+    if (mReadStatus != OK) {
+        return mReadStatus;
+    }
+    CHECK(mBuffer != NULL);
+    mBuffer->add_ref();
+    *buffer = mBuffer;
+    ++mNumReadCurrent;
+    releaseCurrentIfDone_l();
+    return OK;
+}
+
+void MediaSourceSplitter::releaseCurrentIfDone_l() {
+    if (mBuffer != NULL && mNumReadCurrent >= mNumStarted) {
+        // The clients now hold the only references.
+        mBuffer->release();
+        mBuffer = NULL;
+        mCondition.broadcast();
+    }
+}
+
+}  // namespace android
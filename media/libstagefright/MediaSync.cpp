@@ -36,6 +36,18 @@
 // frame arrives later than this number, it will be discarded without rendering.
 static const int64_t kMaxAllowedVideoLateTimeUs = 40000ll;
 
+// Video frames are sent to the output this many display refreshes before they
+// are due, with their presentation time set, so that the output paces them on
+// vsync and one drain can release every frame that is due by then.
+static const int64_t kVideoReleaseAheadVsyncs = 3;
+
+// Largest number of pending video frames converted to real time at once.
+static const size_t kMaxVideoFramesPerDrain = 8;
+
+// An audio timestamp is extrapolated for this long before the audio track is
+// queried again.
+static const int64_t kAudioTimestampRefreshUs = 50000ll;
+
 namespace android {
 
 // static
@@ -56,6 +68,7 @@ MediaSync::MediaSync()
         mNativeSampleRateInHz(0),
         mNumFramesWritten(0),
         mHasAudio(false),
+        mAudioTimestampFetchedUs(-1),
         mNextBufferItemMediaUs(-1),
         mPlaybackRate(0.0) {
     mMediaClock = new MediaClock;
@@ -246,6 +259,7 @@ void MediaSync::updatePlaybackRate_l(float rate) {
         mNextBufferItemMediaUs = -1;
     }
     mPlaybackRate = rate;
+    mAudioTimestampFetchedUs = -1;
     // TODO: update frame scheduler with this info
     mMediaClock->setPlaybackRate(rate);
     onDrainVideo_l();
@@ -352,6 +366,7 @@ void MediaSync::flush() {
     }
     mNextBufferItemMediaUs = -1;
     mNumFramesWritten = 0;
+    mAudioTimestampFetchedUs = -1;
     mReturnPendingInputFrame = true;
     mReleaseCondition.signal();
     mMediaClock->clearAnchor();
@@ -482,7 +497,22 @@ int64_t MediaSync::getPlayedOutAudioDurationMedia_l(int64_t nowUs) {
     AudioTimestamp ts;
     static const int64_t kStaleTimestamp100ms = 100000;
 
-    status_t res = mAudioTrack->getTimestamp(ts);
+    // The timestamp is only reused at normal speed, where the extrapolation
+    // below holds.
+    status_t res;
+    if (mAudioTimestampFetchedUs >= 0 && mPlaybackRate == 1.0f
+            && nowUs - mAudioTimestampFetchedUs < kAudioTimestampRefreshUs) {
+        ts = mAudioTimestamp;
+        res = OK;
+    } else {
+        res = mAudioTrack->getTimestamp(ts);
+        if (res == OK) {
+            mAudioTimestamp = ts;
+            mAudioTimestampFetchedUs = nowUs;
+        } else {
+            mAudioTimestampFetchedUs = -1;
+        }
+    }
     if (res == OK) {
         // case 1: mixing audio tracks.
         numFramesPlayed = ts.mPosition;
@@ -545,23 +575,55 @@ int64_t MediaSync::getPlayedOutAudioDurationMedia_l(int64_t nowUs) {
     return durationUs;
 }
 
+int64_t MediaSync::getVideoReleaseAheadUs_l() {
+    if (mFrameScheduler == NULL) {
+        return 0;
+    }
+    return kVideoReleaseAheadVsyncs * (mFrameScheduler->getVsyncPeriod() / 1000);
+}
+
 void MediaSync::onDrainVideo_l() {
     if (!isPlaying()) {
         return;
     }
 
+    const int64_t releaseAheadUs = getVideoReleaseAheadUs_l();
+
+    int64_t mediaTimesUs[kMaxVideoFramesPerDrain];
+    int64_t realTimesUs[kMaxVideoFramesPerDrain];
+    size_t numConverted = 0;
+    size_t next = 0;
+    int64_t nowUs = 0;
+
     while (!mBufferItems.empty()) {
-        int64_t nowUs = ALooper::GetNowUs();
+        if (next == numConverted) {
+            // Converts the pending frames against a single clock snapshot.
+            nowUs = ALooper::GetNowUs();
+            numConverted = 0;
+            for (List<BufferItem>::iterator it = mBufferItems.begin();
+                    it != mBufferItems.end() && numConverted < kMaxVideoFramesPerDrain;
+                    ++it) {
+                mediaTimesUs[numConverted++] = (*it).mTimestamp / 1000;
+            }
+            if (mMediaClock->getRealTimesFor(
+                    mediaTimesUs, realTimesUs, numConverted) != OK) {
+                // If failed to get current position, e.g. due to audio clock is
+                // not ready, then just play out video immediately without delay.
+                for (size_t i = 0; i < numConverted; ++i) {
+                    realTimesUs[i] = nowUs;
+                }
+            }
+            next = 0;
+        }
+
         BufferItem *bufferItem = &*mBufferItems.begin();
-        int64_t itemMediaUs = bufferItem->mTimestamp / 1000;
-        int64_t itemRealUs = getRealTime(itemMediaUs, nowUs);
+        int64_t itemMediaUs = mediaTimesUs[next];
 
         // adjust video frame PTS based on vsync
-        itemRealUs = mFrameScheduler->schedule(itemRealUs * 1000) / 1000;
-        int64_t twoVsyncsUs = 2 * (mFrameScheduler->getVsyncPeriod() / 1000);
+        int64_t itemRealUs = mFrameScheduler->schedule(realTimesUs[next] * 1000) / 1000;
+        ++next;
 
-        // post 2 display refreshes before rendering is due
-        if (itemRealUs <= nowUs + twoVsyncsUs) {
+        if (itemRealUs <= nowUs + releaseAheadUs) {
             ALOGV("adjusting PTS from %lld to %lld",
                     (long long)bufferItem->mTimestamp / 1000, (long long)itemRealUs);
             bufferItem->mTimestamp = itemRealUs * 1000;
@@ -583,6 +645,9 @@ void MediaSync::onDrainVideo_l() {
                 // smooth out videos >= 10fps
                 mMediaClock->updateAnchor(
                         itemMediaUs, nowUs, itemMediaUs + 100000);
+
+                // the remaining frames follow the new anchor
+                next = numConverted;
             }
 
             mBufferItems.erase(mBufferItems.begin());
@@ -591,7 +656,7 @@ void MediaSync::onDrainVideo_l() {
             if (mNextBufferItemMediaUs == -1
                     || mNextBufferItemMediaUs > itemMediaUs) {
                 sp<AMessage> msg = new AMessage(kWhatDrainVideo, this);
-                msg->post(itemRealUs - nowUs - twoVsyncsUs);
+                msg->post(itemRealUs - nowUs - releaseAheadUs);
                 mNextBufferItemMediaUs = itemMediaUs;
             }
             break;
@@ -800,14 +865,15 @@ void MediaSync::onMessageReceived(const sp<AMessage> &msg) {
             Mutex::Autolock lock(mMutex);
             if (mNextBufferItemMediaUs != -1) {
                 int64_t nowUs = ALooper::GetNowUs();
-                int64_t itemRealUs = getRealTime(mNextBufferItemMediaUs, nowUs);
+                int64_t releaseUs = getRealTime(mNextBufferItemMediaUs, nowUs)
+                        - getVideoReleaseAheadUs_l();
 
                 // The message could arrive earlier than expected due to
                 // various reasons, e.g., media clock has been changed because
                 // of new anchor time or playback rate. In such cases, the
                 // message needs to be re-posted.
-                if (itemRealUs > nowUs) {
-                    msg->post(itemRealUs - nowUs);
+                if (releaseUs > nowUs) {
+                    msg->post(releaseUs - nowUs);
                     break;
                 }
             }
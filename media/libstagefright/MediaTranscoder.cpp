@@ -0,0 +1,928 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaTranscoder"
+#include <utils/Log.h>
+
+#include <gui/Surface.h>
+#include <media/openmax/OMX_IVCommon.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaTranscoder.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/NuMediaExtractor.h>
+
+namespace android {
+
+static const size_t kDefaultMaxInputSize = 64 * 1024;
+static const int32_t kDefaultVideoBitRate = 4000000;
+static const int32_t kDefaultAudioBitRate = 128000;
+static const int32_t kDefaultFrameRate = 30;
+static const int32_t kDefaultIFrameInterval = 1;
+// Samples read per message, so that passthrough-only work still lets
+// stop() and codec callbacks through.
+static const size_t kMaxSamplesPerFeed = 64;
+
+MediaTranscoder::Stats::Stats()
+    : mElapsedUs(0),
+      mDurationUs(0),
+      mPositionUs(0),
+      mNumSamplesRead(0),
+      mNumFramesDecoded(0),
+      mNumFramesEncoded(0),
+      mNumSamplesWritten(0),
+      mNumBytesWritten(0) {
+}
+
+MediaTranscoder::MediaTranscoder(const sp<AMessage> &notify)
+    : mNotify(notify),
+      mMuxerStarted(false),
+      mStarted(false),
+      mDone(false),
+      mFeedPending(false),
+      mRangeStartUs(0ll),
+      mRangeEndUs(-1ll),
+      mStartTimeUs(-1ll),
+      mLastProgress(-1) {
+}
+
+MediaTranscoder::~MediaTranscoder() {
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        releaseTrack(&mTracks.editValueAt(i));
+    }
+}
+
+status_t MediaTranscoder::setDataSource(int fd, off64_t offset, off64_t length) {
+    if (mExtractor != NULL) {
+        return INVALID_OPERATION;
+    }
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    status_t err = extractor->setDataSource(fd, offset, length);
+    if (err != OK) {
+        ALOGE("unable to instantiate extractor (%d)", err);
+        return err;
+    }
+    mExtractor = extractor;
+    return OK;
+}
+
+status_t MediaTranscoder::setOutput(int fd, MediaMuxer::OutputFormat format) {
+    if (mMuxer != NULL) {
+        return INVALID_OPERATION;
+    }
+    mMuxer = new MediaMuxer(fd, format);
+    return OK;
+}
+
+size_t MediaTranscoder::countTracks() const {
+    return mExtractor == NULL ? 0 : mExtractor->countTracks();
+}
+
+status_t MediaTranscoder::getTrackFormat(size_t index, sp<AMessage> *format) const {
+    if (mExtractor == NULL) {
+        return NO_INIT;
+    }
+    return mExtractor->getTrackFormat(index, format);
+}
+
+status_t MediaTranscoder::selectTrack(size_t index, const sp<AMessage> &outputFormat) {
+    if (mExtractor == NULL || mStarted) {
+        return INVALID_OPERATION;
+    }
+    if (index >= mExtractor->countTracks() || mTracks.indexOfKey(index) >= 0) {
+        return -EINVAL;
+    }
+
+    sp<AMessage> inputFormat;
+    status_t err = mExtractor->getTrackFormat(index, &inputFormat);
+    if (err != OK) {
+        return err;
+    }
+
+    AString mime;
+    CHECK(inputFormat->findString("mime", &mime));
+
+    Track track;
+    track.mTrackIndex = index;
+    track.mIsVideo = !strncasecmp(mime.c_str(), "video/", 6);
+    track.mPassthrough = outputFormat == NULL;
+    track.mInputFormat = inputFormat;
+    track.mChannelCount = 0;
+    track.mSampleRate = 0;
+    track.mMuxerTrack = -1;
+    track.mInputEOS = false;
+    track.mOutputEOS = false;
+
+    int32_t maxInputSize;
+    track.mMaxInputSize = kDefaultMaxInputSize;
+    if (inputFormat->findInt32("max-input-size", &maxInputSize) && maxInputSize > 0) {
+        track.mMaxInputSize = maxInputSize;
+    }
+
+    if (!track.mPassthrough) {
+        AString outputMime;
+        if (!outputFormat->findString("mime", &outputMime)) {
+            ALOGE("no output mime for track %zu", index);
+            return -EINVAL;
+        }
+        bool isAudio = !strncasecmp(mime.c_str(), "audio/", 6);
+        if (!track.mIsVideo && !isAudio) {
+            ALOGE("cannot transcode track %zu of type %s", index, mime.c_str());
+            return ERROR_UNSUPPORTED;
+        }
+
+        sp<AMessage> format = outputFormat->dup();
+        int32_t value;
+        if (track.mIsVideo) {
+            static const char *kVideoKeys[] = { "width", "height", "frame-rate" };
+            for (size_t i = 0; i < sizeof(kVideoKeys) / sizeof(kVideoKeys[0]); ++i) {
+                if (!format->findInt32(kVideoKeys[i], &value)
+                        && inputFormat->findInt32(kVideoKeys[i], &value)) {
+                    format->setInt32(kVideoKeys[i], value);
+                }
+            }
+            if (!format->findInt32("frame-rate", &value)) {
+                format->setInt32("frame-rate", kDefaultFrameRate);
+            }
+            if (!format->findInt32("i-frame-interval", &value)) {
+                format->setInt32("i-frame-interval", kDefaultIFrameInterval);
+            }
+            if (!format->findInt32("bitrate", &value)) {
+                format->setInt32("bitrate", kDefaultVideoBitRate);
+            }
+            // Frames come from the decoder through the encoder's input surface.
+            format->setInt32("color-format", OMX_COLOR_FormatAndroidOpaque);
+        } else {
+            static const char *kAudioKeys[] = { "channel-count", "sample-rate" };
+            for (size_t i = 0; i < sizeof(kAudioKeys) / sizeof(kAudioKeys[0]); ++i) {
+                if (!format->findInt32(kAudioKeys[i], &value)
+                        && inputFormat->findInt32(kAudioKeys[i], &value)) {
+                    format->setInt32(kAudioKeys[i], value);
+                }
+            }
+            if (!format->findInt32("bitrate", &value)) {
+                format->setInt32("bitrate", kDefaultAudioBitRate);
+            }
+            inputFormat->findInt32("channel-count", &track.mChannelCount);
+            inputFormat->findInt32("sample-rate", &track.mSampleRate);
+        }
+        track.mOutputFormat = format;
+    }
+
+    err = mExtractor->selectTrack(index);
+    if (err != OK) {
+        return err;
+    }
+
+    int64_t durationUs;
+    if (inputFormat->findInt64("durationUs", &durationUs)) {
+        Mutex::Autolock autoLock(mStatsLock);
+        if (durationUs > mStats.mDurationUs) {
+            mStats.mDurationUs = durationUs;
+        }
+    }
+
+    mTracks.add(index, track);
+    return OK;
+}
+
+status_t MediaTranscoder::setTimeRange(int64_t startUs, int64_t endUs) {
+    if (mStarted || startUs < 0 || (endUs >= 0 && endUs <= startUs)) {
+        return -EINVAL;
+    }
+    mRangeStartUs = startUs;
+    mRangeEndUs = endUs;
+    return OK;
+}
+
+status_t MediaTranscoder::start() {
+    sp<AMessage> msg = new AMessage(kWhatStart, this);
+    sp<AMessage> response;
+    status_t err = msg->postAndAwaitResponse(&response);
+    if (err == OK && !response->findInt32("err", &err)) {
+        err = OK;
+    }
+    return err;
+}
+
+status_t MediaTranscoder::stop() {
+    sp<AMessage> msg = new AMessage(kWhatStop, this);
+    sp<AMessage> response;
+    return msg->postAndAwaitResponse(&response);
+}
+
+void MediaTranscoder::getStats(Stats *stats) const {
+    Mutex::Autolock autoLock(mStatsLock);
+    *stats = mStats;
+    if (mStartTimeUs >= 0 && !mDone) {
+        stats->mElapsedUs = ALooper::GetNowUs() - mStartTimeUs;
+    }
+}
+
+status_t MediaTranscoder::configureTrack(size_t trackIndex, Track *track) {
+    if (track->mPassthrough) {
+        track->mMuxerTrack = mMuxer->addTrack(track->mInputFormat);
+        return track->mMuxerTrack < 0 ? (status_t)track->mMuxerTrack : OK;
+    }
+
+    AString inputMime, outputMime;
+    CHECK(track->mInputFormat->findString("mime", &inputMime));
+    CHECK(track->mOutputFormat->findString("mime", &outputMime));
+
+    track->mCodecLooper = new ALooper;
+    track->mCodecLooper->setName(track->mIsVideo ? "TranscoderVideo" : "TranscoderAudio");
+    track->mCodecLooper->start();
+
+    status_t err;
+    track->mDecoder = MediaCodec::CreateByType(
+            track->mCodecLooper, inputMime.c_str(), false /* encoder */, &err);
+    if (track->mDecoder == NULL) {
+        ALOGE("no decoder for %s", inputMime.c_str());
+        return err;
+    }
+    track->mEncoder = MediaCodec::CreateByType(
+            track->mCodecLooper, outputMime.c_str(), true /* encoder */, &err);
+    if (track->mEncoder == NULL) {
+        ALOGE("no encoder for %s", outputMime.c_str());
+        return err;
+    }
+
+    sp<AMessage> encoderNotify = new AMessage(kWhatEncoderNotify, this);
+    encoderNotify->setSize("track", trackIndex);
+    track->mEncoder->setCallback(encoderNotify);
+
+    err = track->mEncoder->configure(
+            track->mOutputFormat, NULL /* nativeWindow */, NULL /* crypto */,
+            MediaCodec::CONFIGURE_FLAG_ENCODE);
+    if (err != OK) {
+        ALOGE("unable to configure %s encoder (%d)", outputMime.c_str(), err);
+        return err;
+    }
+
+    sp<Surface> surface;
+    if (track->mIsVideo) {
+        sp<IGraphicBufferProducer> bufferProducer;
+        err = track->mEncoder->createInputSurface(&bufferProducer);
+        if (err != OK) {
+            return err;
+        }
+        surface = new Surface(bufferProducer);
+    }
+
+    sp<AMessage> decoderNotify = new AMessage(kWhatDecoderNotify, this);
+    decoderNotify->setSize("track", trackIndex);
+    track->mDecoder->setCallback(decoderNotify);
+
+    err = track->mDecoder->configure(
+            track->mInputFormat, surface, NULL /* crypto */, 0 /* flags */);
+    if (err != OK) {
+        ALOGE("unable to configure %s decoder (%d)", inputMime.c_str(), err);
+        return err;
+    }
+
+    err = track->mEncoder->start();
+    if (err == OK) {
+        err = track->mDecoder->start();
+    }
+    return err;
+}
+
+void MediaTranscoder::releaseTrack(Track *track) {
+    if (track->mDecoder != NULL) {
+        track->mDecoder->release();
+        track->mDecoder.clear();
+    }
+    if (track->mEncoder != NULL) {
+        track->mEncoder->release();
+        track->mEncoder.clear();
+    }
+    if (track->mCodecLooper != NULL) {
+        track->mCodecLooper->stop();
+        track->mCodecLooper.clear();
+    }
+    track->mDecoderInputs.clear();
+    track->mEncoderInputs.clear();
+    track->mDecodedSamples.clear();
+    track->mMuxerSamples.clear();
+}
+
+status_t MediaTranscoder::onStart() {
+    if (mStarted) {
+        return INVALID_OPERATION;
+    }
+    if (mExtractor == NULL || mMuxer == NULL || mTracks.isEmpty()) {
+        return NO_INIT;
+    }
+
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        status_t err = configureTrack(mTracks.keyAt(i), &mTracks.editValueAt(i));
+        if (err != OK) {
+            for (size_t j = 0; j < mTracks.size(); ++j) {
+                releaseTrack(&mTracks.editValueAt(j));
+            }
+            return err;
+        }
+    }
+
+    if (mRangeStartUs > 0) {
+        status_t err = mExtractor->seekTo(
+                mRangeStartUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    mStarted = true;
+    {
+        Mutex::Autolock autoLock(mStatsLock);
+        mStartTimeUs = ALooper::GetNowUs();
+        if (mRangeEndUs >= 0 && mRangeEndUs < mStats.mDurationUs) {
+            mStats.mDurationUs = mRangeEndUs;
+        }
+        mStats.mDurationUs -= mRangeStartUs;
+        mStats.mPositionUs = mRangeStartUs;
+    }
+
+    status_t err = maybeStartMuxer();
+    if (err != OK) {
+        return err;
+    }
+    feedDecoders();
+    return OK;
+}
+
+void MediaTranscoder::onStop() {
+    if (!mStarted) {
+        return;
+    }
+    if (mMuxerStarted) {
+        mMuxer->stop();
+        mMuxerStarted = false;
+    }
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        releaseTrack(&mTracks.editValueAt(i));
+    }
+    if (!mDone) {
+        notifyDone(ERROR_END_OF_STREAM);
+    }
+    mStarted = false;
+}
+
+status_t MediaTranscoder::maybeStartMuxer() {
+    if (mMuxerStarted) {
+        return OK;
+    }
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        if (mTracks.valueAt(i).mMuxerTrack < 0) {
+            // Still waiting for an encoder's output format.
+            return OK;
+        }
+    }
+
+    status_t err = mMuxer->start();
+    if (err != OK) {
+        ALOGE("unable to start muxer (%d)", err);
+        notifyDone(err);
+        return err;
+    }
+    mMuxerStarted = true;
+
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        Track *track = &mTracks.editValueAt(i);
+        while (!track->mMuxerSamples.empty()) {
+            Sample sample = *track->mMuxerSamples.begin();
+            track->mMuxerSamples.erase(track->mMuxerSamples.begin());
+            err = writeMuxerSample(mTracks.keyAt(i), track, sample);
+            if (err != OK) {
+                notifyDone(err);
+                return err;
+            }
+        }
+    }
+    maybeFinish();
+    return OK;
+}
+
+bool MediaTranscoder::signalInputEOS(Track *track) {
+    if (track->mInputEOS) {
+        return true;
+    }
+    if (track->mPassthrough) {
+        track->mInputEOS = true;
+        track->mOutputEOS = true;
+        return true;
+    }
+    if (track->mDecoderInputs.empty()) {
+        // Retried on the decoder's next CB_INPUT_AVAILABLE.
+        return false;
+    }
+    size_t index = *track->mDecoderInputs.begin();
+    track->mDecoderInputs.erase(track->mDecoderInputs.begin());
+    track->mDecoder->queueInputBuffer(index, 0, 0, 0ll, MediaCodec::BUFFER_FLAG_EOS);
+    track->mInputEOS = true;
+    return true;
+}
+
+void MediaTranscoder::feedDecoders() {
+    size_t numSamples = 0;
+    while (!mDone) {
+        size_t trackIndex;
+        if (mExtractor->getSampleTrackIndex(&trackIndex) != OK) {
+            for (size_t i = 0; i < mTracks.size(); ++i) {
+                signalInputEOS(&mTracks.editValueAt(i));
+            }
+            maybeFinish();
+            return;
+        }
+
+        if (numSamples++ == kMaxSamplesPerFeed) {
+            if (!mFeedPending) {
+                mFeedPending = true;
+                (new AMessage(kWhatFeed, this))->post();
+            }
+            return;
+        }
+
+        Track *track = &mTracks.editValueFor(trackIndex);
+
+        int64_t timeUs;
+        CHECK_EQ(mExtractor->getSampleTime(&timeUs), (status_t)OK);
+
+        uint32_t flags = 0;
+        sp<MetaData> meta;
+        int32_t isSync;
+        if (mExtractor->getSampleMeta(&meta) == OK
+                && meta->findInt32(kKeyIsSyncFrame, &isSync) && isSync) {
+            flags |= MediaCodec::BUFFER_FLAG_SYNCFRAME;
+        }
+
+        if (track->mInputEOS
+                || (!track->mIsVideo && timeUs < mRangeStartUs)) {
+            // Past this track's end, or audio before the range's first
+            // video sync sample.
+            mExtractor->advance();
+            continue;
+        }
+
+        if (mRangeEndUs >= 0 && timeUs >= mRangeEndUs
+                && (flags & MediaCodec::BUFFER_FLAG_SYNCFRAME)) {
+            // Ends at a sync sample, so that the range covers whole GOPs.
+            if (!signalInputEOS(track)) {
+                return;
+            }
+            bool allEOS = true;
+            for (size_t i = 0; i < mTracks.size(); ++i) {
+                allEOS = allEOS && mTracks.valueAt(i).mInputEOS;
+            }
+            if (allEOS) {
+                maybeFinish();
+                return;
+            }
+            continue;
+        }
+
+        sp<ABuffer> buffer;
+        ssize_t inputIndex = -1;
+        if (track->mPassthrough) {
+            buffer = new ABuffer(track->mMaxInputSize);
+        } else if (track->mDecoderInputs.empty()) {
+            // Resumed by the decoder's next CB_INPUT_AVAILABLE.
+            return;
+        } else {
+            inputIndex = *track->mDecoderInputs.begin();
+            track->mDecoderInputs.erase(track->mDecoderInputs.begin());
+            if (track->mDecoder->getInputBuffer(inputIndex, &buffer) != OK) {
+                notifyDone(UNKNOWN_ERROR);
+                return;
+            }
+        }
+
+        status_t err = mExtractor->readSampleData(buffer);
+        while (err == -ENOMEM && track->mPassthrough) {
+            track->mMaxInputSize *= 2;
+            buffer = new ABuffer(track->mMaxInputSize);
+            err = mExtractor->readSampleData(buffer);
+        }
+        if (err != OK) {
+            ALOGE("unable to read sample of track %zu (%d)", trackIndex, err);
+            notifyDone(err);
+            return;
+        }
+
+        if (track->mPassthrough) {
+            Sample sample;
+            sample.mIndex = -1;
+            sample.mBuffer = buffer;
+            sample.mOffset = 0;
+            sample.mSize = buffer->size();
+            sample.mTimeUs = timeUs;
+            sample.mFlags = flags;
+            queueMuxerSample(trackIndex, track, sample);
+        } else {
+            err = track->mDecoder->queueInputBuffer(
+                    inputIndex, 0, buffer->size(), timeUs, 0 /* flags */);
+            if (err != OK) {
+                notifyDone(err);
+                return;
+            }
+        }
+
+        {
+            Mutex::Autolock autoLock(mStatsLock);
+            ++mStats.mNumSamplesRead;
+        }
+        updateProgress(timeUs);
+        mExtractor->advance();
+    }
+}
+
+void MediaTranscoder::feedEncoder(size_t trackIndex, Track *track) {
+    const size_t frameSize = 2 * track->mChannelCount;
+    while (!mDone && !track->mDecodedSamples.empty() && !track->mEncoderInputs.empty()) {
+        Sample *pcm = &*track->mDecodedSamples.begin();
+        size_t inputIndex = *track->mEncoderInputs.begin();
+
+        sp<ABuffer> src, dst;
+        if (track->mDecoder->getOutputBuffer(pcm->mIndex, &src) != OK
+                || track->mEncoder->getInputBuffer(inputIndex, &dst) != OK) {
+            ALOGE("lost codec buffers of track %zu", trackIndex);
+            notifyDone(UNKNOWN_ERROR);
+            return;
+        }
+        track->mEncoderInputs.erase(track->mEncoderInputs.begin());
+
+        // Decoded buffers may be larger than the encoder's, so split them.
+        size_t size = pcm->mSize < dst->capacity() ? pcm->mSize : dst->capacity();
+        memcpy(dst->base(), src->base() + pcm->mOffset, size);
+
+        int64_t timeUs = pcm->mTimeUs;
+        uint32_t flags = 0;
+        pcm->mOffset += size;
+        pcm->mSize -= size;
+        if (frameSize > 0 && track->mSampleRate > 0) {
+            pcm->mTimeUs += (size / frameSize) * 1000000ll / track->mSampleRate;
+        }
+        if (pcm->mSize == 0) {
+            if (pcm->mFlags & MediaCodec::BUFFER_FLAG_EOS) {
+                flags |= MediaCodec::BUFFER_FLAG_EOS;
+            }
+            track->mDecoder->releaseOutputBuffer(pcm->mIndex);
+            track->mDecodedSamples.erase(track->mDecodedSamples.begin());
+        }
+
+        status_t err = track->mEncoder->queueInputBuffer(inputIndex, 0, size, timeUs, flags);
+        if (err != OK) {
+            notifyDone(err);
+            return;
+        }
+    }
+}
+
+void MediaTranscoder::queueMuxerSample(
+        size_t trackIndex, Track *track, const Sample &sample) {
+    if (!mMuxerStarted) {
+        track->mMuxerSamples.push_back(sample);
+        return;
+    }
+    status_t err = writeMuxerSample(trackIndex, track, sample);
+    if (err != OK) {
+        notifyDone(err);
+    }
+}
+
+status_t MediaTranscoder::writeMuxerSample(
+        size_t trackIndex, Track *track, const Sample &sample) {
+    sp<ABuffer> buffer = sample.mBuffer;
+    sp<AMessage> notify;
+    if (sample.mIndex >= 0) {
+        status_t err = track->mEncoder->getOutputBuffer(sample.mIndex, &buffer);
+        if (err != OK) {
+            return err;
+        }
+        // The encoder's buffer goes to the writer as is, and is handed back
+        // to the encoder once the sample has been written.
+        notify = new AMessage(kWhatSampleWritten, this);
+        notify->setSize("track", trackIndex);
+        notify->setSize("index", sample.mIndex);
+    }
+
+    status_t err = mMuxer->writeSampleDataAsync(
+            buffer, track->mMuxerTrack, sample.mTimeUs,
+            sample.mFlags & MediaCodec::BUFFER_FLAG_SYNCFRAME, notify);
+    if (err != OK) {
+        if (sample.mIndex >= 0) {
+            track->mEncoder->releaseOutputBuffer(sample.mIndex);
+        }
+        return err;
+    }
+
+    Mutex::Autolock autoLock(mStatsLock);
+    ++mStats.mNumSamplesWritten;
+    mStats.mNumBytesWritten += buffer->size();
+    return OK;
+}
+
+void MediaTranscoder::onDecoderNotify(const sp<AMessage> &msg) {
+    size_t trackIndex;
+    CHECK(msg->findSize("track", &trackIndex));
+    Track *track = &mTracks.editValueFor(trackIndex);
+    if (mDone || track->mDecoder == NULL) {
+        return;
+    }
+
+    int32_t cbID;
+    CHECK(msg->findInt32("callbackID", &cbID));
+    switch (cbID) {
+        case MediaCodec::CB_INPUT_AVAILABLE:
+        {
+            int32_t index;
+            CHECK(msg->findInt32("index", &index));
+            track->mDecoderInputs.push_back(index);
+            feedDecoders();
+            break;
+        }
+
+        case MediaCodec::CB_OUTPUT_AVAILABLE:
+        {
+            Sample sample;
+            int32_t index;
+            int32_t flags;
+            CHECK(msg->findInt32("index", &index));
+            CHECK(msg->findSize("offset", &sample.mOffset));
+            CHECK(msg->findSize("size", &sample.mSize));
+            CHECK(msg->findInt64("timeUs", &sample.mTimeUs));
+            CHECK(msg->findInt32("flags", &flags));
+            sample.mIndex = index;
+            sample.mFlags = flags;
+
+            if (sample.mSize > 0) {
+                Mutex::Autolock autoLock(mStatsLock);
+                ++mStats.mNumFramesDecoded;
+            }
+
+            if (track->mIsVideo) {
+                if (sample.mSize > 0) {
+                    track->mDecoder->renderOutputBufferAndRelease(
+                            index, sample.mTimeUs * 1000ll);
+                } else {
+                    track->mDecoder->releaseOutputBuffer(index);
+                }
+                if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                    track->mEncoder->signalEndOfInputStream();
+                }
+            } else {
+                track->mDecodedSamples.push_back(sample);
+                feedEncoder(trackIndex, track);
+            }
+            break;
+        }
+
+        case MediaCodec::CB_OUTPUT_FORMAT_CHANGED:
+        {
+            sp<AMessage> format;
+            CHECK(msg->findMessage("format", &format));
+            if (!track->mIsVideo) {
+                format->findInt32("channel-count", &track->mChannelCount);
+                format->findInt32("sample-rate", &track->mSampleRate);
+            }
+            break;
+        }
+
+        case MediaCodec::CB_ERROR:
+        {
+            status_t err;
+            CHECK(msg->findInt32("err", &err));
+            ALOGE("decoder of track %zu failed (%d)", trackIndex, err);
+            notifyDone(err);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void MediaTranscoder::onEncoderNotify(const sp<AMessage> &msg) {
+    size_t trackIndex;
+    CHECK(msg->findSize("track", &trackIndex));
+    Track *track = &mTracks.editValueFor(trackIndex);
+    if (mDone || track->mEncoder == NULL) {
+        return;
+    }
+
+    int32_t cbID;
+    CHECK(msg->findInt32("callbackID", &cbID));
+    switch (cbID) {
+        case MediaCodec::CB_INPUT_AVAILABLE:
+        {
+            int32_t index;
+            CHECK(msg->findInt32("index", &index));
+            track->mEncoderInputs.push_back(index);
+            feedEncoder(trackIndex, track);
+            break;
+        }
+
+        case MediaCodec::CB_OUTPUT_AVAILABLE:
+        {
+            Sample sample;
+            int32_t index;
+            int32_t flags;
+            CHECK(msg->findInt32("index", &index));
+            CHECK(msg->findSize("offset", &sample.mOffset));
+            CHECK(msg->findSize("size", &sample.mSize));
+            CHECK(msg->findInt64("timeUs", &sample.mTimeUs));
+            CHECK(msg->findInt32("flags", &flags));
+            sample.mIndex = index;
+            sample.mFlags = flags;
+
+            if ((flags & MediaCodec::BUFFER_FLAG_CODECCONFIG) || sample.mSize == 0) {
+                // The muxer takes the codec specific data from the output format.
+                track->mEncoder->releaseOutputBuffer(index);
+            } else {
+                {
+                    Mutex::Autolock autoLock(mStatsLock);
+                    ++mStats.mNumFramesEncoded;
+                }
+                queueMuxerSample(trackIndex, track, sample);
+            }
+
+            if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                track->mOutputEOS = true;
+                maybeFinish();
+            }
+            break;
+        }
+
+        case MediaCodec::CB_OUTPUT_FORMAT_CHANGED:
+        {
+            sp<AMessage> format;
+            CHECK(msg->findMessage("format", &format));
+            if (mMuxerStarted) {
+                ALOGW("ignoring output format change of track %zu", trackIndex);
+                break;
+            }
+            track->mMuxerTrack = mMuxer->addTrack(format);
+            if (track->mMuxerTrack < 0) {
+                notifyDone((status_t)track->mMuxerTrack);
+                break;
+            }
+            maybeStartMuxer();
+            break;
+        }
+
+        case MediaCodec::CB_ERROR:
+        {
+            status_t err;
+            CHECK(msg->findInt32("err", &err));
+            ALOGE("encoder of track %zu failed (%d)", trackIndex, err);
+            notifyDone(err);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void MediaTranscoder::maybeFinish() {
+    if (mDone || !mMuxerStarted) {
+        return;
+    }
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        if (!mTracks.valueAt(i).mOutputEOS) {
+            return;
+        }
+    }
+
+    // Waits for the writer to drain the queued samples.
+    status_t err = mMuxer->stop();
+    mMuxerStarted = false;
+    notifyDone(err);
+}
+
+void MediaTranscoder::notifyDone(status_t err) {
+    if (mDone) {
+        return;
+    }
+
+    if (err != OK && mMuxerStarted) {
+        mMuxer->stop();
+        mMuxerStarted = false;
+    }
+
+    {
+        Mutex::Autolock autoLock(mStatsLock);
+        mDone = true;
+        if (mStartTimeUs >= 0) {
+            mStats.mElapsedUs = ALooper::GetNowUs() - mStartTimeUs;
+        }
+    }
+
+    ALOGV("done (%d)", err);
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatDone);
+    notify->setInt32("err", err);
+    notify->post();
+}
+
+void MediaTranscoder::updateProgress(int64_t timeUs) {
+    int32_t progress = -1;
+    {
+        Mutex::Autolock autoLock(mStatsLock);
+        if (timeUs > mStats.mPositionUs) {
+            mStats.mPositionUs = timeUs;
+        }
+        if (mStats.mDurationUs > 0) {
+            progress = (mStats.mPositionUs - mRangeStartUs) * 100 / mStats.mDurationUs;
+        }
+    }
+    if (progress > mLastProgress) {
+        mLastProgress = progress;
+        sp<AMessage> notify = mNotify->dup();
+        notify->setInt32("what", kWhatProgress);
+        notify->setInt32("progress", progress);
+        notify->setInt64("timeUs", timeUs);
+        notify->post();
+    }
+}
+
+void MediaTranscoder::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatStart:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            sp<AMessage> response = new AMessage;
+            response->setInt32("err", onStart());
+            response->postReply(replyID);
+            break;
+        }
+
+        case kWhatStop:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            onStop();
+            (new AMessage)->postReply(replyID);
+            break;
+        }
+
+        case kWhatFeed:
+        {
+            mFeedPending = false;
+            feedDecoders();
+            break;
+        }
+
+        case kWhatDecoderNotify:
+        {
+            onDecoderNotify(msg);
+            break;
+        }
+
+        case kWhatEncoderNotify:
+        {
+            onEncoderNotify(msg);
+            break;
+        }
+
+        case kWhatSampleWritten:
+        {
+            size_t trackIndex, index;
+            CHECK(msg->findSize("track", &trackIndex));
+            CHECK(msg->findSize("index", &index));
+            Track *track = &mTracks.editValueFor(trackIndex);
+            if (track->mEncoder != NULL) {
+                track->mEncoder->releaseOutputBuffer(index);
+            }
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+}  // namespace android
@@ -29,34 +29,81 @@
 
 namespace android {
 
-MetaData::MetaData() {
+MetaData::MetaData()
+    : mItems(mInlineItems),
+      mNumItems(0),
+      mCapacity(kInlineItems) {
 }
 
 MetaData::MetaData(const MetaData &from)
     : RefBase(),
-      mItems(from.mItems) {
+      mItems(mInlineItems),
+      mNumItems(0),
+      mCapacity(kInlineItems) {
+    copyItems(from);
 }
 
 MetaData::~MetaData() {
     clear();
+    if (mItems != mInlineItems) {
+        free(mItems);
+    }
+}
+
+void MetaData::copyItems(const MetaData &from) {
+    if (from.mNumItems > mCapacity) {
+        item *items = (item *)malloc(from.mNumItems * sizeof(item));
+        CHECK(items != NULL);
+        mItems = items;
+        mCapacity = from.mNumItems;
+    }
+    for (size_t i = 0; i < from.mNumItems; ++i) {
+        mItems[i].mKey = from.mItems[i].mKey;
+        mItems[i].mData.init();
+        mItems[i].mData.copyFrom(from.mItems[i].mData);
+    }
+    mNumItems = from.mNumItems;
 }
 
 void MetaData::clear() {
-    mItems.clear();
+    for (size_t i = 0; i < mNumItems; ++i) {
+        mItems[i].mData.clear();
+    }
+    mNumItems = 0;
 }
 
 bool MetaData::remove(uint32_t key) {
-    ssize_t i = mItems.indexOfKey(key);
+    ssize_t i = indexOfKey(key);
 
     if (i < 0) {
         return false;
     }
 
-    mItems.removeItemsAt(i);
+    mItems[i].mData.clear();
+    memmove(&mItems[i], &mItems[i + 1], (mNumItems - i - 1) * sizeof(item));
+    --mNumItems;
 
     return true;
 }
 
+ssize_t MetaData::indexOfKey(uint32_t key) const {
+    size_t lo = 0;
+    size_t hi = mNumItems;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (mItems[mid].mKey < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < mNumItems && mItems[lo].mKey == key) {
+        return lo;
+    }
+    // the insertion point, encoded so that it is negative
+    return -(ssize_t)lo - 1;
+}
+
 bool MetaData::setCString(uint32_t key, const char *value) {
     return setData(key, TYPE_C_STRING, value, strlen(value) + 1);
 }
@@ -192,38 +239,53 @@ bool MetaData::setData(
         uint32_t key, uint32_t type, const void *data, size_t size) {
     bool overwrote_existing = true;
 
-    ssize_t i = mItems.indexOfKey(key);
+    ssize_t i = indexOfKey(key);
     if (i < 0) {
-        typed_data item;
-        i = mItems.add(key, item);
+        i = -i - 1;
+        if (mNumItems == mCapacity) {
+            size_t capacity = mCapacity * 2;
+            item *items;
+            if (mItems == mInlineItems) {
+                items = (item *)malloc(capacity * sizeof(item));
+                if (items != NULL) {
+                    memcpy(items, mInlineItems, mNumItems * sizeof(item));
+                }
+            } else {
+                items = (item *)realloc(mItems, capacity * sizeof(item));
+            }
+            CHECK(items != NULL);
+            mItems = items;
+            mCapacity = capacity;
+        }
+        memmove(&mItems[i + 1], &mItems[i], (mNumItems - i) * sizeof(item));
+        ++mNumItems;
+
+        mItems[i].mKey = key;
+        mItems[i].mData.init();
 
         overwrote_existing = false;
     }
 
-    typed_data &item = mItems.editValueAt(i);
-
-    item.setData(type, data, size);
+    mItems[i].mData.setData(type, data, size);
 
     return overwrote_existing;
 }
 
 bool MetaData::findData(uint32_t key, uint32_t *type,
                         const void **data, size_t *size) const {
-    ssize_t i = mItems.indexOfKey(key);
+    ssize_t i = indexOfKey(key);
 
     if (i < 0) {
         return false;
     }
 
-    const typed_data &item = mItems.valueAt(i);
-
-    item.getData(type, data, size);
+    mItems[i].mData.getData(type, data, size);
 
     return true;
 }
 
 bool MetaData::hasData(uint32_t key) const {
-    ssize_t i = mItems.indexOfKey(key);
+    ssize_t i = indexOfKey(key);
 
     if (i < 0) {
         return false;
@@ -232,27 +294,12 @@ bool MetaData::hasData(uint32_t key) const {
     return true;
 }
 
-MetaData::typed_data::typed_data()
-    : mType(0),
-      mSize(0) {
-}
-
-MetaData::typed_data::~typed_data() {
-    clear();
-}
-
-MetaData::typed_data::typed_data(const typed_data &from)
-    : mType(from.mType),
-      mSize(0) {
-
-    void *dst = allocateStorage(from.mSize);
-    if (dst) {
-        memcpy(dst, from.storage(), mSize);
-    }
+void MetaData::typed_data::init() {
+    mType = 0;
+    mSize = 0;
 }
 
-MetaData::typed_data &MetaData::typed_data::operator=(
-        const MetaData::typed_data &from) {
+void MetaData::typed_data::copyFrom(const MetaData::typed_data &from) {
     if (this != &from) {
         clear();
         mType = from.mType;
@@ -261,8 +308,6 @@ MetaData::typed_data &MetaData::typed_data::operator=(
             memcpy(dst, from.storage(), mSize);
         }
     }
-
-    return *this;
 }
 
 void MetaData::typed_data::clear() {
@@ -294,7 +339,7 @@ void *MetaData::typed_data::allocateStorage(size_t size) {
     mSize = size;
 
     if (usesReservoir()) {
-        return &u.reservoir;
+        return u.reservoir;
     }
 
     u.ext_data = malloc(mSize);
@@ -368,11 +413,11 @@ static void MakeFourCCString(uint32_t x, char *s) {
 }
 
 void MetaData::dumpToLog() const {
-    for (int i = mItems.size(); --i >= 0;) {
-        int32_t key = mItems.keyAt(i);
+    for (int i = mNumItems; --i >= 0;) {
+        int32_t key = mItems[i].mKey;
         char cc[5];
         MakeFourCCString(key, cc);
-        const typed_data &item = mItems.valueAt(i);
+        const typed_data &item = mItems[i].mData;
         ALOGI("%s: %s", cc, item.asString().string());
     }
 }
@@ -21,18 +21,91 @@
 #include "include/MidiExtractor.h"
 
 #include <media/MidiIoWrapper.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/MediaBufferGroup.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/MediaSource.h>
 #include <libsonivox/eas_reverb.h>
+#include <utils/List.h>
+#include <utils/threads.h>
 
 namespace android {
 
 // how many Sonivox output buffers to aggregate into one MediaBuffer
 static const int NUM_COMBINE_BUFFERS = 4;
 
+// Short files, ringtones and notifications, are rendered in one go when the
+// track is started, and the PCM is kept in a small LRU cache keyed by the
+// file content, so that repeated plays do not run the synthesizer at all.
+static const EAS_I32 kMaxPrerenderDurationMs = 20000;
+static const EAS_I32 kMaxPrerenderTailMs = 2000;    // reverb and release after the last note
+static const int kMaxPrerenderFileSize = 256 * 1024;
+static const size_t kRenderCacheCapacity = 4 * 1024 * 1024;  // bytes of PCM
+
+class MidiRenderCache {
+public:
+    static sp<ABuffer> lookup(uint64_t key);
+    static void insert(uint64_t key, const sp<ABuffer> &pcm);
+
+private:
+    struct Entry {
+        uint64_t mKey;
+        sp<ABuffer> mPcm;
+    };
+
+    static Mutex sLock;
+    static List<Entry> sEntries;    // most recently used first
+    static size_t sSize;            // bytes of PCM in sEntries
+};
+
+Mutex MidiRenderCache::sLock;
+List<MidiRenderCache::Entry> MidiRenderCache::sEntries;
+size_t MidiRenderCache::sSize = 0;
+
+// static
+sp<ABuffer> MidiRenderCache::lookup(uint64_t key) {
+    Mutex::Autolock autoLock(sLock);
+    for (List<Entry>::iterator it = sEntries.begin(); it != sEntries.end(); ++it) {
+        if (it->mKey == key) {
+            Entry entry = *it;
+            sEntries.erase(it);
+            sEntries.push_front(entry);
+            return entry.mPcm;
+        }
+    }
+    return NULL;
+}
+
+// static
+void MidiRenderCache::insert(uint64_t key, const sp<ABuffer> &pcm) {
+    if (pcm->size() > kRenderCacheCapacity) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(sLock);
+    for (List<Entry>::iterator it = sEntries.begin(); it != sEntries.end(); ++it) {
+        if (it->mKey == key) {
+            // rendered concurrently by another engine
+            return;
+        }
+    }
+
+    while (sSize + pcm->size() > kRenderCacheCapacity) {
+        List<Entry>::iterator last = --sEntries.end();
+        sSize -= last->mPcm->size();
+        sEntries.erase(last);
+    }
+
+    Entry entry;
+    entry.mKey = key;
+    entry.mPcm = pcm;
+    sEntries.push_front(entry);
+    sSize += pcm->size();
+}
+
 class MidiSource : public MediaSource {
 
 public:
@@ -148,7 +221,9 @@ MidiEngine::MidiEngine(const sp<DataSource> &dataSource,
             mEasData(NULL),
             mEasHandle(NULL),
             mEasConfig(NULL),
-            mIsInitialized(false) {
+            mIsInitialized(false),
+            mDurationMs(0),
+            mPcmOffset(0) {
     mIoWrapper = new MidiIoWrapper(dataSource);
     // spin up a new EAS engine
     EAS_I32 temp;
@@ -168,6 +243,8 @@ MidiEngine::MidiEngine(const sp<DataSource> &dataSource,
         return;
     }
 
+    mDurationMs = temp;
+
     if (fileMetadata != NULL) {
         fileMetadata->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_MIDI);
     }
@@ -207,22 +284,142 @@ status_t MidiEngine::allocateBuffers() {
             * mEasConfig->mixBufferSize * mEasConfig->numChannels * NUM_COMBINE_BUFFERS;
     ALOGV("using %d byte buffer", bufsize);
     mGroup->add_buffer(new MediaBuffer(bufsize));
+
+    prerender();
     return OK;
 }
 
 status_t MidiEngine::releaseBuffers() {
     delete mGroup;
     mGroup = NULL;
+    mPcm.clear();
     return OK;
 }
 
+// FNV-1a of the file content and of the output format.
+bool MidiEngine::computeCacheKey(uint64_t *key) {
+    int size = mIoWrapper->size();
+    if (size <= 0 || size > kMaxPrerenderFileSize) {
+        return false;
+    }
+
+    sp<ABuffer> data = new ABuffer(size);
+    if (mIoWrapper->readAt(data->data(), 0, size) != size) {
+        return false;
+    }
+
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < size; i++) {
+        hash ^= data->data()[i];
+        hash *= 1099511628211ull;
+    }
+
+    const uint32_t format[] = {
+        (uint32_t)size, (uint32_t)mEasConfig->sampleRate, (uint32_t)mEasConfig->numChannels };
+    const uint8_t *p = (const uint8_t *)format;
+    for (size_t i = 0; i < sizeof(format); i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+
+    *key = hash;
+    return true;
+}
+
+void MidiEngine::prerender() {
+    mPcm.clear();
+    mPcmOffset = 0;
+
+    if (mDurationMs <= 0 || mDurationMs > kMaxPrerenderDurationMs) {
+        return;
+    }
+
+    uint64_t key;
+    if (!computeCacheKey(&key)) {
+        return;
+    }
+
+    mPcm = MidiRenderCache::lookup(key);
+    if (mPcm != NULL) {
+        ALOGV("prerender: %zu bytes from the cache", mPcm->size());
+        return;
+    }
+
+    const size_t frameSize = sizeof(EAS_PCM) * mEasConfig->numChannels;
+    const size_t chunkSize = mEasConfig->mixBufferSize * frameSize;
+    const size_t maxBytes = (size_t)(mDurationMs + kMaxPrerenderTailMs)
+            * mEasConfig->sampleRate / 1000 * frameSize + chunkSize;
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    sp<ABuffer> pcm = new ABuffer(maxBytes);
+    pcm->setRange(0, 0);
+    for (;;) {
+        EAS_STATE state;
+        EAS_State(mEasData, mEasHandle, &state);
+        if ((state == EAS_STATE_STOPPED) || (state == EAS_STATE_ERROR)) {
+            break;
+        }
+        if (pcm->size() + chunkSize > pcm->capacity()) {
+            // Longer than its duration says, a loop for instance: play it in real time.
+            ALOGW("prerender: giving up after %zu bytes", pcm->size());
+            EAS_Locate(mEasData, mEasHandle, 0, false);
+            return;
+        }
+        EAS_I32 numRendered;
+        EAS_RESULT result = EAS_Render(mEasData,
+                (EAS_PCM *)(pcm->data() + pcm->size()), mEasConfig->mixBufferSize, &numRendered);
+        if (result != EAS_SUCCESS) {
+            ALOGE("EAS_Render returned %ld", result);
+            EAS_Locate(mEasData, mEasHandle, 0, false);
+            return;
+        }
+        pcm->setRange(0, pcm->size() + numRendered * frameSize);
+    }
+
+    ALOGV("prerender: %zu bytes in %lld us",
+            pcm->size(), (long long)(ALooper::GetNowUs() - startUs));
+
+    MidiRenderCache::insert(key, pcm);
+    mPcm = pcm;
+}
+
 status_t MidiEngine::seekTo(int64_t positionUs) {
     ALOGV("seekTo %lld", (long long)positionUs);
+    if (mPcm != NULL) {
+        const size_t frameSize = sizeof(EAS_PCM) * mEasConfig->numChannels;
+        size_t offset = positionUs * mEasConfig->sampleRate / 1000000ll * frameSize;
+        mPcmOffset = offset < mPcm->size() ? offset : mPcm->size();
+        return OK;
+    }
     EAS_RESULT result = EAS_Locate(mEasData, mEasHandle, positionUs / 1000, false);
     return result == EAS_SUCCESS ? OK : UNKNOWN_ERROR;
 }
 
 MediaBuffer* MidiEngine::readBuffer() {
+    if (mPcm != NULL) {
+        if (mPcmOffset >= mPcm->size()) {
+            return NULL;
+        }
+        MediaBuffer *buffer;
+        status_t err = mGroup->acquire_buffer(&buffer);
+        if (err != OK) {
+            ALOGE("readBuffer: no buffer");
+            return NULL;
+        }
+        const size_t frameSize = sizeof(EAS_PCM) * mEasConfig->numChannels;
+        size_t size = mPcm->size() - mPcmOffset;
+        if (size > buffer->size()) {
+            size = buffer->size();
+        }
+        memcpy(buffer->data(), mPcm->data() + mPcmOffset, size);
+        buffer->set_range(0, size);
+        buffer->meta_data()->setInt64(kKeyTime,
+                mPcmOffset / frameSize * 1000000ll / mEasConfig->sampleRate);
+        mPcmOffset += size;
+        return buffer;
+    }
+
     EAS_STATE state;
     EAS_State(mEasData, mEasHandle, &state);
     if ((state == EAS_STATE_STOPPED) || (state == EAS_STATE_ERROR)) {
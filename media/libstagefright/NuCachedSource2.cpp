@@ -30,6 +30,49 @@
 
 namespace android {
 
+// Page memory is handed back to a process wide pool when a cache goes away or
+// holds on to too many unused pages, so that consecutive sessions and sources
+// reuse it instead of going back to malloc.
+static const size_t kMaxPooledPages = 128;
+static const size_t kMaxLocalFreePages = 16;
+
+static Mutex gPagePoolLock;
+static List<void *> gPagePool;
+static size_t gNumPooledPages = 0;
+
+static void *acquirePoolPage(size_t pageSize) {
+    {
+        Mutex::Autolock autoLock(gPagePoolLock);
+        if (gNumPooledPages > 0) {
+            List<void *>::iterator it = gPagePool.begin();
+            void *data = *it;
+            gPagePool.erase(it);
+            --gNumPooledPages;
+            return data;
+        }
+    }
+    return malloc(pageSize);
+}
+
+static void trimPagePool() {
+    Mutex::Autolock autoLock(gPagePoolLock);
+    for (List<void *>::iterator it = gPagePool.begin(); it != gPagePool.end(); ++it) {
+        free(*it);
+    }
+    gPagePool.clear();
+    gNumPooledPages = 0;
+}
+
+static void releasePoolPage(void *data) {
+    Mutex::Autolock autoLock(gPagePoolLock);
+    if (gNumPooledPages >= kMaxPooledPages) {
+        free(data);
+        return;
+    }
+    gPagePool.push_back(data);
+    ++gNumPooledPages;
+}
+
 struct PageCache {
     PageCache(size_t pageSize);
     ~PageCache();
@@ -45,6 +88,9 @@ struct PageCache {
     void appendPage(Page *page);
     size_t releaseFromStart(size_t maxBytes);
 
+    // Frees the pages kept for reuse.
+    void freeUnusedPages();
+
     size_t totalSize() const {
         return mTotalSize;
     }
@@ -57,6 +103,7 @@ private:
 
     List<Page *> mActivePages;
     List<Page *> mFreePages;
+    size_t mNumFreePages;
 
     void freePages(List<Page *> *list);
 
@@ -65,7 +112,8 @@ private:
 
 PageCache::PageCache(size_t pageSize)
     : mPageSize(pageSize),
-      mTotalSize(0) {
+      mTotalSize(0),
+      mNumFreePages(0) {
 }
 
 PageCache::~PageCache() {
@@ -78,7 +126,7 @@ void PageCache::freePages(List<Page *> *list) {
     while (it != list->end()) {
         Page *page = *it;
 
-        free(page->mData);
+        releasePoolPage(page->mData);
         delete page;
         page = NULL;
 
@@ -91,20 +139,28 @@ PageCache::Page *PageCache::acquirePage() {
         List<Page *>::iterator it = mFreePages.begin();
         Page *page = *it;
         mFreePages.erase(it);
+        --mNumFreePages;
 
         return page;
     }
 
     Page *page = new Page;
-    page->mData = malloc(mPageSize);
+    page->mData = acquirePoolPage(mPageSize);
     page->mSize = 0;
 
     return page;
 }
 
 void PageCache::releasePage(Page *page) {
+    if (mNumFreePages >= kMaxLocalFreePages) {
+        releasePoolPage(page->mData);
+        delete page;
+        return;
+    }
+
     page->mSize = 0;
     mFreePages.push_back(page);
+    ++mNumFreePages;
 }
 
 void PageCache::appendPage(Page *page) {
@@ -136,6 +192,15 @@ size_t PageCache::releaseFromStart(size_t maxBytes) {
     return bytesReleased;
 }
 
+void PageCache::freeUnusedPages() {
+    for (List<Page *>::iterator it = mFreePages.begin(); it != mFreePages.end(); ++it) {
+        free((*it)->mData);
+        delete *it;
+    }
+    mFreePages.clear();
+    mNumFreePages = 0;
+}
+
 void PageCache::copy(size_t from, void *data, size_t size) {
     ALOGV("copy from %zu size %zu", from, size);
 
@@ -198,7 +263,19 @@ NuCachedSource2::NuCachedSource2(
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
       mKeepAliveIntervalUs(kDefaultKeepAliveIntervalUs),
       mDisconnectAtHighwatermark(disconnectAtHighwatermark),
-      mSuspended(false) {
+      mSuspended(false),
+      mAdaptiveWatermarks(true),
+      mFetchBytesPerSec(0),
+      mConsumeBytesPerSec(0),
+      mRateSampleTimeUs(-1),
+      mRateSamplePos(0),
+      mSeekTargetCacheSize(0),
+      mMaxHighwaterThresholdBytes(kMaxHighWaterThreshold),
+      mStatusCallback(NULL),
+      mStatusCookie(NULL),
+      mStatusGranularityBytes(0),
+      mLastStatusRemaining(0),
+      mLastStatusFinalStatus(OK) {
     // We are NOT going to support disconnect-at-highwatermark indefinitely
     // and we are not guaranteeing support for client-specified cache
     // parameters. Both of these are temporary measures to solve a specific
@@ -312,6 +389,12 @@ void NuCachedSource2::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatTrim:
+        {
+            onTrim();
+            break;
+        }
+
         default:
             TRESPASS();
     }
@@ -358,11 +441,19 @@ void NuCachedSource2::fetchInternal() {
 
     PageCache::Page *page = mCache->acquirePage();
 
+    int64_t startUs = ALooper::GetNowUs();
     ssize_t n = mSource->readAt(
             mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
 
     Mutex::Autolock autoLock(mLock);
 
+    if (n > 0 && elapsedUs > 0) {
+        double bytesPerSec = n * 1E6 / elapsedUs;
+        mFetchBytesPerSec = mFetchBytesPerSec > 0
+                ? 0.9 * mFetchBytesPerSec + 0.1 * bytesPerSec : bytesPerSec;
+    }
+
     if (n == 0 || mDisconnecting) {
         ALOGI("caching reached eos.");
 
@@ -392,9 +483,57 @@ void NuCachedSource2::fetchInternal() {
     }
 }
 
+bool NuCachedSource2::fetchSeekTarget() {
+    off64_t offset = -1;
+    size_t size = 0;
+    {
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i < mSeekTargets.size(); ++i) {
+            const SeekTarget &target = mSeekTargets.itemAt(i);
+            if (target.mData == NULL
+                    && mSeekTargetCacheSize + target.mSize <= kMaxSeekTargetCacheSize) {
+                offset = target.mOffset;
+                size = target.mSize;
+                break;
+            }
+        }
+    }
+
+    if (offset < 0) {
+        return false;
+    }
+
+    sp<ABuffer> data = new ABuffer(size);
+    ssize_t n = mSource->readAt(offset, data->data(), size);
+
+    Mutex::Autolock autoLock(mLock);
+    for (size_t i = 0; i < mSeekTargets.size(); ++i) {
+        SeekTarget *target = &mSeekTargets.editItemAt(i);
+        if (target->mOffset != offset || target->mData != NULL) {
+            continue;
+        }
+        if (n <= 0) {
+            // give up on this one rather than retrying it forever
+            mSeekTargets.removeAt(i);
+        } else {
+            data->setRange(0, n);
+            target->mSize = n;
+            target->mData = data;
+            mSeekTargetCacheSize += n;
+        }
+        break;
+    }
+    return true;
+}
+
 void NuCachedSource2::onFetch() {
     ALOGV("onFetch");
 
+    {
+        Mutex::Autolock autoLock(mLock);
+        updateRates_l();
+    }
+
     if (mFinalStatus != OK && mNumRetriesLeft == 0) {
         ALOGV("EOS reached, done prefetching for now");
         mFetching = false;
@@ -412,6 +551,7 @@ void NuCachedSource2::onFetch() {
         }
 
         fetchInternal();
+        notifyStatusIfChanged();
 
         mLastFetchTimeUs = ALooper::GetNowUs();
 
@@ -431,8 +571,15 @@ void NuCachedSource2::onFetch() {
         restartPrefetcherIfNecessary_l();
     }
 
+    // Seek targets are only fetched while the main cache is idle, as each of
+    // them moves the source away from the end of the cache.
+    bool fetchedSeekTarget = false;
+    if (!mFetching && mFinalStatus == OK && !mSuspended) {
+        fetchedSeekTarget = fetchSeekTarget();
+    }
+
     int64_t delayUs;
-    if (mFetching) {
+    if (mFetching || fetchedSeekTarget) {
         if (mFinalStatus != OK && mNumRetriesLeft > 0) {
             // We failed this time and will try again in 3 seconds.
             delayUs = 3000000ll;
@@ -486,6 +633,146 @@ void NuCachedSource2::onRead(const sp<AMessage> &msg) {
     mCondition.signal();
 }
 
+void NuCachedSource2::updateRates_l() {
+    static const int64_t kRateSampleIntervalUs = 1000000ll;
+
+    int64_t nowUs = ALooper::GetNowUs();
+    if (mRateSampleTimeUs < 0 || mLastAccessPos < mRateSamplePos) {
+        // first sample, or the reader went back
+        mRateSampleTimeUs = nowUs;
+        mRateSamplePos = mLastAccessPos;
+        return;
+    }
+
+    int64_t elapsedUs = nowUs - mRateSampleTimeUs;
+    if (elapsedUs < kRateSampleIntervalUs) {
+        return;
+    }
+
+    off64_t consumed = mLastAccessPos - mRateSamplePos;
+    mRateSampleTimeUs = nowUs;
+    mRateSamplePos = mLastAccessPos;
+
+    if (consumed > (off64_t)kMaxHighWaterThreshold) {
+        // a seek forward, not playback
+        return;
+    }
+
+    double bytesPerSec = consumed * 1E6 / elapsedUs;
+    if (bytesPerSec <= 0) {
+        // paused, keep the last rate
+        return;
+    }
+    mConsumeBytesPerSec = mConsumeBytesPerSec > 0
+            ? 0.8 * mConsumeBytesPerSec + 0.2 * bytesPerSec : bytesPerSec;
+
+    updateWatermarks_l();
+}
+
+void NuCachedSource2::updateWatermarks_l() {
+    // Cache a minute of content, and refetch when less than 10 seconds are left,
+    // or 30 seconds if the network is not at least twice as fast as playback.
+    static const double kHighWaterDurationSecs = 60;
+    static const double kLowWaterDurationSecs = 10;
+    static const double kSlowNetworkLowWaterDurationSecs = 30;
+
+    if (!mAdaptiveWatermarks || mConsumeBytesPerSec <= 0) {
+        return;
+    }
+
+    double highwater = mConsumeBytesPerSec * kHighWaterDurationSecs;
+    if (highwater < kMinHighWaterThreshold) {
+        highwater = kMinHighWaterThreshold;
+    }
+    if (highwater > mMaxHighwaterThresholdBytes) {
+        highwater = mMaxHighwaterThresholdBytes;
+    }
+
+    bool slowNetwork = mFetchBytesPerSec > 0 && mFetchBytesPerSec < 2 * mConsumeBytesPerSec;
+    double lowwater = mConsumeBytesPerSec
+            * (slowNetwork ? kSlowNetworkLowWaterDurationSecs : kLowWaterDurationSecs);
+    if (lowwater < kMinLowWaterThreshold) {
+        lowwater = kMinLowWaterThreshold;
+    } else if (lowwater > highwater / 2) {
+        lowwater = highwater / 2;
+    }
+
+    if ((size_t)highwater != mHighwaterThresholdBytes
+            || (size_t)lowwater != mLowwaterThresholdBytes) {
+        mHighwaterThresholdBytes = highwater;
+        mLowwaterThresholdBytes = lowwater;
+        ALOGV("consume %.0f B/s, fetch %.0f B/s: lowwater %zu, highwater %zu",
+                mConsumeBytesPerSec, mFetchBytesPerSec,
+                mLowwaterThresholdBytes, mHighwaterThresholdBytes);
+    }
+}
+
+void NuCachedSource2::clampWatermarks_l() {
+    if (mHighwaterThresholdBytes > mMaxHighwaterThresholdBytes) {
+        mHighwaterThresholdBytes = mMaxHighwaterThresholdBytes;
+    }
+    if (mLowwaterThresholdBytes > mHighwaterThresholdBytes / 2) {
+        mLowwaterThresholdBytes = mHighwaterThresholdBytes / 2;
+    }
+}
+
+void NuCachedSource2::setMaxCacheSize(size_t maxBytes) {
+    Mutex::Autolock autoLock(mLock);
+    if (maxBytes < kMinCacheSizeLimit) {
+        maxBytes = kMinCacheSizeLimit;
+    }
+    if (maxBytes == mMaxHighwaterThresholdBytes) {
+        return;
+    }
+    mMaxHighwaterThresholdBytes = maxBytes;
+    updateWatermarks_l();
+    clampWatermarks_l();
+    ALOGV("max cache size %zu: lowwater %zu, highwater %zu",
+            maxBytes, mLowwaterThresholdBytes, mHighwaterThresholdBytes);
+}
+
+void NuCachedSource2::trimCache() {
+    // The fetcher touches the pages without holding mLock, hence on its looper.
+    (new AMessage(kWhatTrim, mReflector))->post();
+}
+
+void NuCachedSource2::onTrim() {
+    Mutex::Autolock autoLock(mLock);
+    if (mLastAccessPos > mCacheOffset) {
+        size_t released = mCache->releaseFromStart(mLastAccessPos - mCacheOffset);
+        mCacheOffset += released;
+        ALOGI("trimmed %zu bytes, totalSize = %zu", released, mCache->totalSize());
+    }
+    mCache->freeUnusedPages();
+    trimPagePool();
+}
+
+void NuCachedSource2::addSeekTargets(const Vector<off64_t> &offsets, size_t size) {
+    if (size > kMaxSeekTargetSize) {
+        size = kMaxSeekTargetSize;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        SeekTarget target;
+        target.mOffset = offsets.itemAt(i);
+        target.mSize = size;
+        mSeekTargets.push(target);
+    }
+}
+
+ssize_t NuCachedSource2::readFromSeekTargets_l(off64_t offset, void *data, size_t size) {
+    for (size_t i = 0; i < mSeekTargets.size(); ++i) {
+        const SeekTarget &target = mSeekTargets.itemAt(i);
+        if (target.mData != NULL && offset >= target.mOffset
+                && offset + size <= target.mOffset + target.mData->size()) {
+            memcpy(data, target.mData->data() + (offset - target.mOffset), size);
+            return size;
+        }
+    }
+    return -ENOENT;
+}
+
 void NuCachedSource2::restartPrefetcherIfNecessary_l(
         bool ignoreLowWaterThreshold, bool force) {
     static const size_t kGrayArea = 1024 * 1024;
@@ -518,8 +805,16 @@ void NuCachedSource2::restartPrefetcherIfNecessary_l(
 }
 
 ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
-    Mutex::Autolock autoSerializer(mSerializer);
+    ssize_t n;
+    {
+        Mutex::Autolock autoSerializer(mSerializer);
+        n = readAtSerialized(offset, data, size);
+    }
+    notifyStatusIfChanged();
+    return n;
+}
 
+ssize_t NuCachedSource2::readAtSerialized(off64_t offset, void *data, size_t size) {
     ALOGV("readAt offset %lld, size %zu", (long long)offset, size);
 
     Mutex::Autolock autoLock(mLock);
@@ -593,6 +888,45 @@ size_t NuCachedSource2::approxDataRemaining_l(status_t *finalStatus) const {
     return 0;
 }
 
+void NuCachedSource2::setStatusListener(
+        StatusCallback callback, void *cookie, size_t granularityBytes) {
+    Mutex::Autolock autoStatusLock(mStatusLock);
+    Mutex::Autolock autoLock(mLock);
+    mStatusCallback = callback;
+    mStatusCookie = cookie;
+    mStatusGranularityBytes = granularityBytes;
+    mLastStatusRemaining = approxDataRemaining_l(&mLastStatusFinalStatus);
+}
+
+bool NuCachedSource2::statusChanged_l() {
+    if (mStatusCallback == NULL) {
+        return false;
+    }
+
+    status_t finalStatus;
+    size_t remaining = approxDataRemaining_l(&finalStatus);
+    size_t delta = remaining > mLastStatusRemaining
+            ? remaining - mLastStatusRemaining : mLastStatusRemaining - remaining;
+    if (finalStatus == mLastStatusFinalStatus && delta < mStatusGranularityBytes) {
+        return false;
+    }
+
+    mLastStatusRemaining = remaining;
+    mLastStatusFinalStatus = finalStatus;
+    return true;
+}
+
+void NuCachedSource2::notifyStatusIfChanged() {
+    Mutex::Autolock autoStatusLock(mStatusLock);
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (!statusChanged_l()) {
+            return;
+        }
+    }
+    (*mStatusCallback)(mStatusCookie);
+}
+
 ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
     CHECK_LE(size, (size_t)mHighwaterThresholdBytes);
 
@@ -618,6 +952,16 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
             || offset >= (off64_t)(mCacheOffset + mCache->totalSize())) {
         static const off64_t kPadding = 256 * 1024;
 
+        // A seek a little past the end of the cache is served by the fetch
+        // in progress, rather than dropping the cache and reconnecting.
+        off64_t gap = offset - (off64_t)(mCacheOffset + mCache->totalSize());
+        if (mFinalStatus == OK && gap >= 0 && gap <= kPadding
+                && mCache->totalSize() + gap + size <= mHighwaterThresholdBytes) {
+            mLastAccessPos = offset;
+            mFetching = true;
+            return -EAGAIN;
+        }
+
         // In the presence of multiple decoded streams, once of them will
         // trigger this seek request, the other one will request data "nearby"
         // soon, adjust the seek position so that that subsequent request
@@ -625,6 +969,13 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
         off64_t seekOffset = (offset > kPadding) ? offset - kPadding : 0;
 
         seekInternal_l(seekOffset);
+
+        // a prefetched seek target answers right away, the cache catches up
+        ssize_t n = readFromSeekTargets_l(offset, data, size);
+        if (n >= 0) {
+            mLastAccessPos = offset + n;
+            return n;
+        }
     }
 
     size_t delta = offset - mCacheOffset;
@@ -718,6 +1069,9 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
         return;
     }
 
+    // explicitly configured watermarks are left alone
+    mAdaptiveWatermarks = false;
+
     if (lowwaterMarkKb >= 0) {
         mLowwaterThresholdBytes = lowwaterMarkKb * 1024;
     } else {
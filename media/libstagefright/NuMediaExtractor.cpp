@@ -51,6 +51,7 @@ NuMediaExtractor::~NuMediaExtractor() {
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
         TrackInfo *info = &mSelectedTracks.editItemAt(i);
 
+        stopTrackReader(info->mReader);
         CHECK_EQ((status_t)OK, info->mSource->stop());
     }
 
@@ -299,6 +300,8 @@ status_t NuMediaExtractor::selectTrack(size_t index) {
         info->mTrackFlags |= kIsVorbis;
     }
 
+    info->mReader = new TrackReader(source, info->mTrackFlags & kIsVorbis);
+
     return OK;
 }
 
@@ -336,6 +339,8 @@ status_t NuMediaExtractor::unselectTrack(size_t index) {
         info->mSampleTimeUs = -1ll;
     }
 
+    // Waits for a readTrackSamples() in progress on this track.
+    stopTrackReader(info->mReader);
     CHECK_EQ((status_t)OK, info->mSource->stop());
 
     mSelectedTracks.removeAt(i);
@@ -535,6 +540,183 @@ status_t NuMediaExtractor::getSampleMeta(sp<MetaData> *sampleMeta) {
     return OK;
 }
 
+NuMediaExtractor::TrackReader::TrackReader(
+        const sp<MediaSource> &source, bool isVorbis)
+    : mSource(source),
+      mIsVorbis(isVorbis),
+      mFinalResult(OK),
+      mPending(NULL),
+      mSeekTimeUs(-1ll),
+      mSeekMode(MediaSource::ReadOptions::SEEK_CLOSEST_SYNC) {
+}
+
+NuMediaExtractor::TrackReader::~TrackReader() {
+    releasePending();
+}
+
+void NuMediaExtractor::TrackReader::releasePending() {
+    if (mPending != NULL) {
+        mPending->release();
+        mPending = NULL;
+    }
+}
+
+sp<NuMediaExtractor::TrackReader> NuMediaExtractor::findTrackReader(
+        size_t trackIndex) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
+        const TrackInfo &info = mSelectedTracks.itemAt(i);
+
+        if (info.mTrackIndex == trackIndex) {
+            return info.mReader;
+        }
+    }
+
+    return NULL;
+}
+
+// static
+void NuMediaExtractor::stopTrackReader(const sp<TrackReader> &reader) {
+    Mutex::Autolock autoLock(reader->mLock);
+
+    reader->releasePending();
+    reader->mSource.clear();
+}
+
+status_t NuMediaExtractor::readTrackSamples(
+        size_t trackIndex, uint8_t *data, size_t capacity,
+        SampleInfo *infos, size_t maxSamples, size_t *numSamples) {
+    *numSamples = 0;
+
+    // mLock is only held to find the track, the reads themselves only
+    // serialize with other reads of the same track.
+    sp<TrackReader> reader = findTrackReader(trackIndex);
+    if (reader == NULL) {
+        return -EINVAL;
+    }
+
+    Mutex::Autolock autoLock(reader->mLock);
+
+    if (reader->mSource == NULL) {
+        // Unselected in the meantime.
+        return -EINVAL;
+    }
+
+    size_t offset = 0;
+    size_t count = 0;
+    while (count < maxSamples) {
+        if (reader->mPending == NULL) {
+            if (reader->mFinalResult != OK) {
+                break;
+            }
+
+            MediaSource::ReadOptions options;
+            if (reader->mSeekTimeUs >= 0ll) {
+                options.setSeekTo(reader->mSeekTimeUs, reader->mSeekMode);
+                reader->mSeekTimeUs = -1ll;
+            }
+
+            status_t err = reader->mSource->read(&reader->mPending, &options);
+            if (err != OK) {
+                CHECK(reader->mPending == NULL);
+
+                if (err != ERROR_END_OF_STREAM) {
+                    ALOGW("read on track %zu failed with error %d",
+                          trackIndex, err);
+                }
+                reader->mFinalResult = err;
+                break;
+            }
+        }
+
+        MediaBuffer *sample = reader->mPending;
+        size_t sampleSize = sample->range_length();
+
+        if (reader->mIsVorbis) {
+            // Same layout as readSampleData().
+            sampleSize += sizeof(int32_t);
+        }
+
+        if (sampleSize > capacity - offset) {
+            if (count == 0) {
+                return -ENOMEM;
+            }
+            break;
+        }
+
+        memcpy(data + offset,
+               (const uint8_t *)sample->data() + sample->range_offset(),
+               sample->range_length());
+
+        sp<MetaData> meta = sample->meta_data();
+
+        if (reader->mIsVorbis) {
+            int32_t numPageSamples;
+            if (!meta->findInt32(kKeyValidSamples, &numPageSamples)) {
+                numPageSamples = -1;
+            }
+
+            memcpy(data + offset + sample->range_length(),
+                   &numPageSamples,
+                   sizeof(numPageSamples));
+        }
+
+        SampleInfo *info = &infos[count];
+        info->mOffset = offset;
+        info->mSize = sampleSize;
+        CHECK(meta->findInt64(kKeyTime, &info->mTimeUs));
+
+        info->mFlags = 0;
+        int32_t isSync;
+        if (meta->findInt32(kKeyIsSyncFrame, &isSync) && isSync != 0) {
+            info->mFlags |= SAMPLE_FLAG_SYNC;
+        }
+
+        uint32_t type;
+        const void *encryptedSizes;
+        size_t size;
+        if (meta->findData(kKeyEncryptedSizes, &type, &encryptedSizes, &size)) {
+            info->mFlags |= SAMPLE_FLAG_ENCRYPTED;
+        }
+
+        offset += sampleSize;
+        ++count;
+
+        reader->releasePending();
+    }
+
+    *numSamples = count;
+
+    if (count == 0 && maxSamples > 0) {
+        return reader->mFinalResult;
+    }
+
+    return OK;
+}
+
+status_t NuMediaExtractor::seekTrackTo(
+        size_t trackIndex, int64_t timeUs,
+        MediaSource::ReadOptions::SeekMode mode) {
+    if (timeUs < 0ll) {
+        return -EINVAL;
+    }
+
+    sp<TrackReader> reader = findTrackReader(trackIndex);
+    if (reader == NULL) {
+        return -EINVAL;
+    }
+
+    Mutex::Autolock autoLock(reader->mLock);
+
+    reader->releasePending();
+    reader->mFinalResult = OK;
+    reader->mSeekTimeUs = timeUs;
+    reader->mSeekMode = mode;
+
+    return OK;
+}
+
 bool NuMediaExtractor::getTotalBitrate(int64_t *bitrate) const {
     if (mTotalBitrate >= 0) {
         *bitrate = mTotalBitrate;
@@ -133,6 +133,10 @@ struct MuxOMX : public IOMX {
             OMX_U32 range_offset, OMX_U32 range_length,
             OMX_U32 flags, OMX_TICKS timestamp, int fenceFd);
 
+    virtual status_t fillBuffers(node_id node, const Vector<BufferSubmission> &buffers);
+
+    virtual status_t emptyBuffers(node_id node, const Vector<BufferSubmission> &buffers);
+
     virtual status_t getExtensionIndex(
             node_id node,
             const char *parameter_name,
@@ -400,6 +404,14 @@ status_t MuxOMX::emptyBuffer(
             node, buffer, range_offset, range_length, flags, timestamp, fenceFd);
 }
 
+status_t MuxOMX::fillBuffers(node_id node, const Vector<BufferSubmission> &buffers) {
+    return getOMX(node)->fillBuffers(node, buffers);
+}
+
+status_t MuxOMX::emptyBuffers(node_id node, const Vector<BufferSubmission> &buffers) {
+    return getOMX(node)->emptyBuffers(node, buffers);
+}
+
 status_t MuxOMX::getExtensionIndex(
         node_id node,
         const char *parameter_name,
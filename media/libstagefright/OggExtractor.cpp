@@ -105,6 +105,10 @@ protected:
         int64_t mTimeUs;
     };
 
+    // Enough for a complete page header including its lacing values.
+    static const size_t kMaxPageHeaderSize = 27 + 255;
+    static const size_t kReadCacheSize = 8192;
+
     sp<DataSource> mSource;
     off64_t mOffset;
     Page mCurrentPage;
@@ -121,16 +125,31 @@ protected:
 
     off64_t mFirstDataOffset;
 
+    // Only known, and seeks only bisect the file, if it is cheap to read
+    // the end of the stream.
+    off64_t mFileSize;
+
+    // Page headers and page searches are served from this cache rather
+    // than with a readAt() per field, or per byte.
+    uint8_t mReadCache[kReadCacheSize];
+    off64_t mReadCacheOffset;
+    size_t mReadCacheSize;
+
     vorbis_info mVi;
     vorbis_comment mVc;
 
     sp<MetaData> mMeta;
     sp<MetaData> mFileMeta;
 
+    // Pages visited by previous seeks, sorted by offset; used to narrow
+    // down the range the next seek has to bisect.
     Vector<TOCEntry> mTableOfContents;
 
+    ssize_t fillReadCache(off64_t offset, size_t size);
     ssize_t readPage(off64_t offset, Page *page);
     status_t findNextPage(off64_t startOffset, off64_t *pageOffset);
+    status_t findGranulePage(
+            off64_t startOffset, off64_t *pageOffset, Page *page, ssize_t *pageSize);
 
     virtual int64_t getTimeUsOfGranule(uint64_t granulePos) const = 0;
 
@@ -157,7 +176,8 @@ protected:
 
     status_t findPrevGranulePosition(off64_t pageOffset, uint64_t *granulePos);
 
-    void buildTableOfContents();
+    status_t seekByBisection(int64_t timeUs);
+    void addTOCEntry(off64_t pageOffset, int64_t timeUs);
 
     MyOggExtractor(const MyOggExtractor &);
     MyOggExtractor &operator=(const MyOggExtractor &);
@@ -309,7 +329,10 @@ MyOggExtractor::MyOggExtractor(
       mMimeType(mimeType),
       mNumHeaders(numHeaders),
       mSeekPreRollUs(seekPreRollUs),
-      mFirstDataOffset(-1) {
+      mFirstDataOffset(-1),
+      mFileSize(-1),
+      mReadCacheOffset(0),
+      mReadCacheSize(0) {
     mCurrentPage.mNumSegments = 0;
 
     vorbis_info_init(&mVi);
@@ -325,13 +348,35 @@ sp<MetaData> MyOggExtractor::getFormat() const {
     return mMeta;
 }
 
+// Makes the read cache hold the data at |offset|, reading |size| bytes if it
+// does not already hold that many. Returns the number of bytes available in
+// the cache at |offset|, which is less than |size| only at the end of stream.
+ssize_t MyOggExtractor::fillReadCache(off64_t offset, size_t size) {
+    CHECK_LE(size, kReadCacheSize);
+
+    if (offset >= mReadCacheOffset
+            && offset + (off64_t)size <= mReadCacheOffset + (off64_t)mReadCacheSize) {
+        return mReadCacheOffset + mReadCacheSize - offset;
+    }
+
+    ssize_t n = mSource->readAt(offset, mReadCache, size);
+    if (n < 0) {
+        mReadCacheSize = 0;
+        return n;
+    }
+
+    mReadCacheOffset = offset;
+    mReadCacheSize = n;
+
+    return n;
+}
+
 status_t MyOggExtractor::findNextPage(
         off64_t startOffset, off64_t *pageOffset) {
     *pageOffset = startOffset;
 
     for (;;) {
-        char signature[4];
-        ssize_t n = mSource->readAt(*pageOffset, &signature, 4);
+        ssize_t n = fillReadCache(*pageOffset, kReadCacheSize);
 
         if (n < 4) {
             *pageOffset = 0;
@@ -339,16 +384,51 @@ status_t MyOggExtractor::findNextPage(
             return (n < 0) ? n : (status_t)ERROR_END_OF_STREAM;
         }
 
-        if (!memcmp(signature, "OggS", 4)) {
-            if (*pageOffset > startOffset) {
-                ALOGV("skipped %lld bytes of junk to reach next frame",
-                     (long long)(*pageOffset - startOffset));
+        const uint8_t *data = mReadCache + (*pageOffset - mReadCacheOffset);
+        const uint8_t *end = data + n - 3;
+        for (const uint8_t *ptr = data; ptr < end; ++ptr) {
+            ptr = (const uint8_t *)memchr(ptr, 'O', end - ptr);
+            if (ptr == NULL) {
+                break;
             }
 
+            if (!memcmp(ptr, "OggS", 4)) {
+                *pageOffset += ptr - data;
+
+                if (*pageOffset > startOffset) {
+                    ALOGV("skipped %lld bytes of junk to reach next frame",
+                         (long long)(*pageOffset - startOffset));
+                }
+
+                return OK;
+            }
+        }
+
+        // The last 3 bytes may start a signature that straddles the cache.
+        *pageOffset += n - 3;
+    }
+}
+
+// Finds the first page at or after |startOffset| that completes a packet,
+// i.e. has a valid granule position.
+status_t MyOggExtractor::findGranulePage(
+        off64_t startOffset, off64_t *pageOffset, Page *page, ssize_t *pageSize) {
+    status_t err = findNextPage(startOffset, pageOffset);
+    if (err != OK) {
+        return err;
+    }
+
+    for (;;) {
+        *pageSize = readPage(*pageOffset, page);
+        if (*pageSize <= 0) {
+            return *pageSize < 0 ? (status_t)*pageSize : ERROR_END_OF_STREAM;
+        }
+
+        if (page->mGranulePosition != (uint64_t)-1) {
             return OK;
         }
 
-        ++*pageOffset;
+        *pageOffset += *pageSize;
     }
 }
 
@@ -416,46 +496,122 @@ status_t MyOggExtractor::seekToTime(int64_t timeUs) {
         timeUs = 0;
     }
 
-    if (mTableOfContents.isEmpty()) {
-        // Perform approximate seeking based on avg. bitrate.
-        uint64_t bps = approxBitrate();
-        if (bps <= 0) {
-            return INVALID_OPERATION;
-        }
+    if (mFileSize >= 0) {
+        return seekByBisection(timeUs);
+    }
 
-        off64_t pos = timeUs * bps / 8000000ll;
+    // Perform approximate seeking based on avg. bitrate.
+    uint64_t bps = approxBitrate();
+    if (bps <= 0) {
+        return INVALID_OPERATION;
+    }
+
+    off64_t pos = timeUs * bps / 8000000ll;
 
-        ALOGV("seeking to offset %lld", (long long)pos);
-        return seekToOffset(pos);
+    ALOGV("seeking to offset %lld", (long long)pos);
+    return seekToOffset(pos);
+}
+
+// Seeks to the first page that ends at or after |timeUs|, the classic Ogg
+// bisection over file offsets. The range to bisect starts out narrowed down
+// by the pages that previous seeks have visited.
+status_t MyOggExtractor::seekByBisection(int64_t timeUs) {
+    // Below this the remaining pages are walked, which is cheaper than
+    // locating a page from an arbitrary offset.
+    static const off64_t kMinBisectionRange = 64 * 1024;
+
+    // The first page at or after |low| ends before |timeUs|, or |low| is
+    // the start of the data; the first page at or after |high| ends at or
+    // after |timeUs|, or |high| is the end of the file.
+    off64_t low = mFirstDataOffset;
+    off64_t high = mFileSize;
+
+    for (size_t i = 0; i < mTableOfContents.size(); ++i) {
+        const TOCEntry &entry = mTableOfContents.itemAt(i);
+        if (entry.mTimeUs < timeUs) {
+            if (entry.mPageOffset > low) {
+                low = entry.mPageOffset;
+            }
+        } else {
+            high = entry.mPageOffset;
+            break;
+        }
     }
 
-    size_t left = 0;
-    size_t right_plus_one = mTableOfContents.size();
-    while (left < right_plus_one) {
-        size_t center = left + (right_plus_one - left) / 2;
+    size_t numProbes = 0;
+    while (high - low > kMinBisectionRange) {
+        off64_t mid = low + (high - low) / 2;
+
+        off64_t pageOffset;
+        Page page;
+        ssize_t pageSize;
+        ++numProbes;
+        if (findGranulePage(mid, &pageOffset, &page, &pageSize) != OK
+                || pageOffset >= high) {
+            high = mid;
+            continue;
+        }
 
-        const TOCEntry &entry = mTableOfContents.itemAt(center);
+        int64_t pageTimeUs = getTimeUsOfGranule(page.mGranulePosition);
+        addTOCEntry(pageOffset, pageTimeUs);
 
-        if (timeUs < entry.mTimeUs) {
-            right_plus_one = center;
-        } else if (timeUs > entry.mTimeUs) {
-            left = center + 1;
+        if (pageTimeUs < timeUs) {
+            low = pageOffset + pageSize;
         } else {
-            left = center;
+            high = mid;
+        }
+    }
+
+    off64_t offset;
+    Page page;
+    ssize_t pageSize;
+    status_t err;
+    while ((err = findGranulePage(low, &offset, &page, &pageSize)) == OK) {
+        if (getTimeUsOfGranule(page.mGranulePosition) >= timeUs) {
             break;
         }
+        low = offset + pageSize;
     }
 
-    if (left == mTableOfContents.size()) {
-        --left;
+    if (err != OK) {
+        // Seeking past the last page: play out the last one.
+        offset = low;
     }
 
-    const TOCEntry &entry = mTableOfContents.itemAt(left);
+    ALOGV("seeking to %lld us at offset %lld after %zu probes",
+            (long long)timeUs, (long long)offset, numProbes);
+
+    return seekToOffset(offset);
+}
 
-    ALOGV("seeking to entry %zu / %zu at offset %lld",
-         left, mTableOfContents.size(), (long long)entry.mPageOffset);
+void MyOggExtractor::addTOCEntry(off64_t pageOffset, int64_t timeUs) {
+    // Limit the maximum amount of RAM we spend on the table of contents;
+    // it is only a hint, so once it's full further pages are not added.
+    static const size_t kMaxTOCSize = 8192;
+    static const size_t kMaxNumTOCEntries = kMaxTOCSize / sizeof(TOCEntry);
 
-    return seekToOffset(entry.mPageOffset);
+    size_t left = 0;
+    size_t right = mTableOfContents.size();
+    while (left < right) {
+        size_t center = left + (right - left) / 2;
+        off64_t centerOffset = mTableOfContents.itemAt(center).mPageOffset;
+        if (centerOffset == pageOffset) {
+            return;
+        } else if (centerOffset < pageOffset) {
+            left = center + 1;
+        } else {
+            right = center;
+        }
+    }
+
+    if (mTableOfContents.size() >= kMaxNumTOCEntries) {
+        return;
+    }
+
+    TOCEntry entry;
+    entry.mPageOffset = pageOffset;
+    entry.mTimeUs = timeUs;
+    mTableOfContents.insertAt(entry, left);
 }
 
 status_t MyOggExtractor::seekToOffset(off64_t offset) {
@@ -492,12 +648,13 @@ status_t MyOggExtractor::seekToOffset(off64_t offset) {
 }
 
 ssize_t MyOggExtractor::readPage(off64_t offset, Page *page) {
-    uint8_t header[27];
-    ssize_t n;
-    if ((n = mSource->readAt(offset, header, sizeof(header)))
-            < (ssize_t)sizeof(header)) {
+    static const size_t kHeaderSize = 27;
+
+    // Read the header and the lacing values in one go.
+    ssize_t n = fillReadCache(offset, kMaxPageHeaderSize);
+    if (n < (ssize_t)kHeaderSize) {
         ALOGV("failed to read %zu bytes at offset %#016llx, got %zd bytes",
-                sizeof(header), (long long)offset, n);
+                kHeaderSize, (long long)offset, n);
 
         if (n < 0) {
             return n;
@@ -508,6 +665,8 @@ ssize_t MyOggExtractor::readPage(off64_t offset, Page *page) {
         }
     }
 
+    const uint8_t *header = mReadCache + (offset - mReadCacheOffset);
+
     if (memcmp(header, "OggS", 4)) {
         return ERROR_MALFORMED;
     }
@@ -536,11 +695,10 @@ ssize_t MyOggExtractor::readPage(off64_t offset, Page *page) {
     page->mPageNo = U32LE_AT(&header[18]);
 
     page->mNumSegments = header[26];
-    if (mSource->readAt(
-                offset + sizeof(header), page->mLace, page->mNumSegments)
-            < (ssize_t)page->mNumSegments) {
+    if (n < (ssize_t)(kHeaderSize + page->mNumSegments)) {
         return ERROR_IO;
     }
+    memcpy(page->mLace, &header[kHeaderSize], page->mNumSegments);
 
     size_t totalSize = 0;;
     for (size_t i = 0; i < page->mNumSegments; ++i) {
@@ -559,7 +717,7 @@ ssize_t MyOggExtractor::readPage(off64_t offset, Page *page) {
     ALOGV("%c %s", page->mFlags & 1 ? '+' : ' ', tmp.string());
 #endif
 
-    return sizeof(header) + page->mNumSegments + totalSize;
+    return kHeaderSize + page->mNumSegments + totalSize;
 }
 
 status_t MyOpusExtractor::readNextPacket(MediaBuffer **out) {
@@ -846,51 +1004,14 @@ status_t MyOggExtractor::init() {
 
         mMeta->setInt64(kKeyDuration, durationUs);
 
-        buildTableOfContents();
+        // Seeks bisect the file from here on, nothing needs to be scanned
+        // up front.
+        mFileSize = size;
     }
 
     return OK;
 }
 
-void MyOggExtractor::buildTableOfContents() {
-    off64_t offset = mFirstDataOffset;
-    Page page;
-    ssize_t pageSize;
-    while ((pageSize = readPage(offset, &page)) > 0) {
-        mTableOfContents.push();
-
-        TOCEntry &entry =
-            mTableOfContents.editItemAt(mTableOfContents.size() - 1);
-
-        entry.mPageOffset = offset;
-        entry.mTimeUs = getTimeUsOfGranule(page.mGranulePosition);
-
-        offset += (size_t)pageSize;
-    }
-
-    // Limit the maximum amount of RAM we spend on the table of contents,
-    // if necessary thin out the table evenly to trim it down to maximum
-    // size.
-
-    static const size_t kMaxTOCSize = 8192;
-    static const size_t kMaxNumTOCEntries = kMaxTOCSize / sizeof(TOCEntry);
-
-    size_t numerator = mTableOfContents.size();
-
-    if (numerator > kMaxNumTOCEntries) {
-        size_t denom = numerator - kMaxNumTOCEntries;
-
-        size_t accum = 0;
-        for (ssize_t i = mTableOfContents.size() - 1; i >= 0; --i) {
-            accum += denom;
-            if (accum >= numerator) {
-                mTableOfContents.removeAt(i);
-                accum -= numerator;
-            }
-        }
-    }
-}
-
 int32_t MyOggExtractor::getPacketBlockSize(MediaBuffer *buffer) {
     const uint8_t *data =
         (const uint8_t *)buffer->data() + buffer->range_offset();
@@ -22,6 +22,7 @@
 
 #include <binder/IProcessInfoService.h>
 #include <binder/IServiceManager.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -48,6 +49,33 @@ bool ProcessInfo::getPriority(int pid, int* priority) {
     return true;
 }
 
+bool ProcessInfo::getPriorities(const int* pids, size_t numPids, int* priorities) {
+    if (numPids == 0) {
+        return false;
+    }
+    sp<IBinder> binder = defaultServiceManager()->getService(String16("processinfo"));
+    sp<IProcessInfoService> service = interface_cast<IProcessInfoService>(binder);
+
+    // one call for all of them, the states are written straight into priorities.
+    Vector<int32_t> pidsCopy;
+    pidsCopy.appendArray(pids, numPids);
+    status_t err = service->getProcessStatesFromPids(numPids, pidsCopy.editArray(), priorities);
+    if (err != OK) {
+        ALOGE("getProcessStatesFromPids failed");
+        return false;
+    }
+    bool found = false;
+    for (size_t i = 0; i < numPids; ++i) {
+        ALOGV("pid %d states %d", pids[i], priorities[i]);
+        if (priorities[i] < 0) {
+            priorities[i] = -1;
+        } else {
+            found = true;
+        }
+    }
+    return found;
+}
+
 ProcessInfo::~ProcessInfo() {}
 
 }  // namespace android
@@ -20,6 +20,8 @@
 
 #include "include/SampleIterator.h"
 
+#include <algorithm>
+
 #include <arpa/inet.h>
 
 #include <media/stagefright/foundation/ADebug.h>
@@ -166,6 +168,20 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
 status_t SampleIterator::findChunkRange(uint32_t sampleIndex) {
     CHECK(sampleIndex >= mFirstChunkSampleIndex);
 
+    // Skip ahead to the last indexed entry starting at or before sampleIndex, the
+    // loop below then only has to process that one.
+    const uint32_t numStarts = mTable->mNumSampleToChunkStartSamples;
+    if (numStarts > mSampleToChunkIndex + 1) {
+        const uint32_t *starts = mTable->mSampleToChunkStartSamples;
+        const uint32_t entry =
+            std::upper_bound(starts + mSampleToChunkIndex, starts + numStarts, sampleIndex)
+                - starts - 1;
+        if (entry > mSampleToChunkIndex) {
+            mSampleToChunkIndex = entry;
+            mStopChunkSampleIndex = starts[entry];
+        }
+    }
+
     while (sampleIndex >= mStopChunkSampleIndex) {
         if (mSampleToChunkIndex == mTable->mNumSampleToChunkOffsets) {
             return ERROR_OUT_OF_RANGE;
@@ -331,6 +347,19 @@ status_t SampleIterator::findSampleTimeAndDuration(
         return ERROR_OUT_OF_RANGE;
     }
 
+    if (sampleIndex >= mTTSSampleIndex + mTTSCount
+            && mTable->mNumTimeToSampleStarts > mTimeToSampleIndex + 1) {
+        // skip ahead to the entry holding the sample, see findChunkRange()
+        const uint32_t entry = mTable->findTimeToSampleEntry(sampleIndex);
+        if (entry > mTimeToSampleIndex) {
+            mTimeToSampleIndex = entry;
+            mTTSSampleIndex = mTable->mTimeToSampleStarts[entry].mSampleIndex;
+            mTTSSampleTime = mTable->mTimeToSampleStarts[entry].mSampleTime;
+            mTTSCount = 0;
+            mTTSDuration = 0;
+        }
+    }
+
     while (sampleIndex >= mTTSSampleIndex + mTTSCount) {
         if (mTimeToSampleIndex == mTable->mTimeToSampleCount) {
             return ERROR_OUT_OF_RANGE;
@@ -18,10 +18,12 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <algorithm>
 #include <limits>
 
 #include "include/SampleTable.h"
 #include "include/SampleIterator.h"
+#include "include/SampleTableCache.h"
 
 #include <arpa/inet.h>
 
@@ -109,8 +111,11 @@ uint32_t SampleTable::CompositionDeltaLookup::getCompositionTimeOffset(
 
 ////////////////////////////////////////////////////////////////////////////////
 
-SampleTable::SampleTable(const sp<DataSource> &source)
+SampleTable::SampleTable(
+        const sp<DataSource> &source, const sp<SampleTableCache> &cache)
     : mDataSource(source),
+      mCache(cache),
+      mCachedTables(0),
       mChunkOffsetOffset(-1),
       mChunkOffsetType(0),
       mNumChunkOffsets(0),
@@ -123,7 +128,10 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mHasTimeToSample(false),
       mTimeToSampleCount(0),
       mTimeToSample(NULL),
+      mTimeToSampleStarts(NULL),
+      mNumTimeToSampleStarts(0),
       mSampleTimeEntries(NULL),
+      mHasMonotonicSampleTimes(false),
       mCompositionTimeDeltaEntries(NULL),
       mNumCompositionTimeDeltaEntries(0),
       mCompositionDeltaLookup(new CompositionDeltaLookup),
@@ -132,20 +140,41 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mSyncSamples(NULL),
       mLastSyncSampleIndex(0),
       mSampleToChunkEntries(NULL),
+      mSampleToChunkStartSamples(NULL),
+      mNumSampleToChunkStartSamples(0),
       mTotalSize(0) {
     mSampleIterator = new SampleIterator(this);
 }
 
 SampleTable::~SampleTable() {
+    if (mCachedTables & kCachedSampleToChunk) {
+        mSampleToChunkEntries = NULL;
+    }
+    if (mCachedTables & kCachedSyncSamples) {
+        mSyncSamples = NULL;
+    }
+    if (mCachedTables & kCachedTimeToSample) {
+        mTimeToSample = NULL;
+    }
+    if (mCachedTables & kCachedCompositionTimeDeltas) {
+        mCompositionTimeDeltaEntries = NULL;
+    }
+
     delete[] mSampleToChunkEntries;
     mSampleToChunkEntries = NULL;
 
+    delete[] mSampleToChunkStartSamples;
+    mSampleToChunkStartSamples = NULL;
+
     delete[] mSyncSamples;
     mSyncSamples = NULL;
 
     delete[] mTimeToSample;
     mTimeToSample = NULL;
 
+    delete[] mTimeToSampleStarts;
+    mTimeToSampleStarts = NULL;
+
     delete mCompositionDeltaLookup;
     mCompositionDeltaLookup = NULL;
 
@@ -159,6 +188,28 @@ SampleTable::~SampleTable() {
     mSampleIterator = NULL;
 }
 
+const void *SampleTable::lookupCachedTable(
+        uint32_t type, off64_t data_offset, size_t data_size,
+        uint32_t numEntries, size_t entrySize, uint32_t flag) {
+    if (mCache == NULL) {
+        return NULL;
+    }
+    const void *table =
+        mCache->lookup(type, data_offset, data_size, numEntries, entrySize);
+    if (table != NULL) {
+        mCachedTables |= flag;
+    }
+    return table;
+}
+
+void SampleTable::addCachedTable(
+        uint32_t type, off64_t data_offset, size_t data_size,
+        const void *data, uint32_t numEntries, size_t entrySize) {
+    if (mCache != NULL) {
+        mCache->add(type, data_offset, data_size, data, numEntries, entrySize);
+    }
+}
+
 bool SampleTable::isValid() const {
     return mChunkOffsetOffset >= 0
         && mSampleToChunkOffset >= 0
@@ -261,6 +312,15 @@ status_t SampleTable::setSampleToChunkParams(
         return ERROR_OUT_OF_RANGE;
     }
 
+    // cached tables are never written to
+    mSampleToChunkEntries = (SampleToChunkEntry *)lookupCachedTable(
+            FOURCC('s', 't', 's', 'c'), data_offset, data_size,
+            mNumSampleToChunkOffsets, sizeof(SampleToChunkEntry), kCachedSampleToChunk);
+    if (mSampleToChunkEntries != NULL) {
+        buildSampleToChunkStartSamples();
+        return OK;
+    }
+
     mSampleToChunkEntries =
         new (std::nothrow) SampleToChunkEntry[mNumSampleToChunkOffsets];
     if (!mSampleToChunkEntries) {
@@ -279,35 +339,95 @@ status_t SampleTable::setSampleToChunkParams(
         return ERROR_MALFORMED;
     }
 
-    for (uint32_t i = 0; i < mNumSampleToChunkOffsets; ++i) {
-        uint8_t buffer[sizeof(SampleToChunkEntry)];
+    if ((SIZE_MAX - 8 - ((mNumSampleToChunkOffsets - 1) * 12))
+            < (size_t)mSampleToChunkOffset) {
+        return ERROR_MALFORMED;
+    }
 
-        if ((SIZE_MAX - 8 - (i * 12)) < (size_t)mSampleToChunkOffset) {
-            return ERROR_MALFORMED;
+    // Read the table in blocks rather than one entry at a time; long recordings have
+    // tens of thousands of entries.
+    static const uint32_t kEntriesPerRead = 256;
+    uint8_t buffer[kEntriesPerRead * sizeof(SampleToChunkEntry)];
+
+    for (uint32_t i = 0; i < mNumSampleToChunkOffsets; i += kEntriesPerRead) {
+        uint32_t numEntries = mNumSampleToChunkOffsets - i;
+        if (numEntries > kEntriesPerRead) {
+            numEntries = kEntriesPerRead;
         }
+        const size_t readSize = numEntries * sizeof(SampleToChunkEntry);
 
         if (mDataSource->readAt(
                     mSampleToChunkOffset + 8 + i * sizeof(SampleToChunkEntry),
                     buffer,
-                    sizeof(buffer))
-                != (ssize_t)sizeof(buffer)) {
+                    readSize)
+                != (ssize_t)readSize) {
             return ERROR_IO;
         }
-        // chunk index is 1 based in the spec.
-        if (U32_AT(buffer) < 1) {
-            ALOGE("b/23534160");
-            return ERROR_OUT_OF_RANGE;
-        }
 
-        // We want the chunk index to be 0-based.
-        mSampleToChunkEntries[i].startChunk = U32_AT(buffer) - 1;
-        mSampleToChunkEntries[i].samplesPerChunk = U32_AT(&buffer[4]);
-        mSampleToChunkEntries[i].chunkDesc = U32_AT(&buffer[8]);
+        for (uint32_t j = 0; j < numEntries; ++j) {
+            const uint8_t *entry = &buffer[j * sizeof(SampleToChunkEntry)];
+
+            // chunk index is 1 based in the spec.
+            if (U32_AT(entry) < 1) {
+                ALOGE("b/23534160");
+                return ERROR_OUT_OF_RANGE;
+            }
+
+            // We want the chunk index to be 0-based.
+            mSampleToChunkEntries[i + j].startChunk = U32_AT(entry) - 1;
+            mSampleToChunkEntries[i + j].samplesPerChunk = U32_AT(&entry[4]);
+            mSampleToChunkEntries[i + j].chunkDesc = U32_AT(&entry[8]);
+        }
     }
 
+    buildSampleToChunkStartSamples();
+
+    addCachedTable(FOURCC('s', 't', 's', 'c'), data_offset, data_size,
+            mSampleToChunkEntries, mNumSampleToChunkOffsets, sizeof(SampleToChunkEntry));
+
     return OK;
 }
 
+void SampleTable::buildSampleToChunkStartSamples() {
+    uint64_t allocSize = (uint64_t)mNumSampleToChunkOffsets * sizeof(uint32_t);
+    if (mTotalSize + allocSize > kMaxTotalSize) {
+        // the iterator walks the table instead
+        return;
+    }
+
+    mSampleToChunkStartSamples = new (std::nothrow) uint32_t[mNumSampleToChunkOffsets];
+    if (!mSampleToChunkStartSamples) {
+        return;
+    }
+    mTotalSize += allocSize;
+
+    // Same arithmetic and checks as SampleIterator::findChunkRange(), which still
+    // handles the entries past the first one that fails them.
+    uint32_t startSample = 0;
+    uint32_t i = 0;
+    for (; i < mNumSampleToChunkOffsets; ++i) {
+        mSampleToChunkStartSamples[i] = startSample;
+
+        if (i + 1 == mNumSampleToChunkOffsets) {
+            ++i;
+            break;
+        }
+
+        const SampleToChunkEntry *entry = &mSampleToChunkEntries[i];
+        const uint32_t firstChunk = entry->startChunk;
+        const uint32_t stopChunk = entry[1].startChunk;
+        if (entry->samplesPerChunk == 0 || stopChunk < firstChunk ||
+            (stopChunk - firstChunk) > UINT32_MAX / entry->samplesPerChunk ||
+            ((stopChunk - firstChunk) * entry->samplesPerChunk >
+             UINT32_MAX - startSample)) {
+            ++i;
+            break;
+        }
+        startSample += (stopChunk - firstChunk) * entry->samplesPerChunk;
+    }
+    mNumSampleToChunkStartSamples = i;
+}
+
 status_t SampleTable::setSampleSizeParams(
         uint32_t type, off64_t data_offset, size_t data_size) {
     if (mSampleSizeOffset >= 0) {
@@ -416,6 +536,15 @@ status_t SampleTable::setTimeToSampleParams(
         return ERROR_OUT_OF_RANGE;
     }
 
+    mTimeToSample = (uint32_t *)lookupCachedTable(
+            FOURCC('s', 't', 't', 's'), data_offset, data_size,
+            mTimeToSampleCount, 2 * sizeof(uint32_t), kCachedTimeToSample);
+    if (mTimeToSample != NULL) {
+        buildTimeToSampleStarts();
+        mHasTimeToSample = true;
+        return OK;
+    }
+
     mTimeToSample = new (std::nothrow) uint32_t[mTimeToSampleCount * 2];
     if (!mTimeToSample) {
         ALOGE("Cannot allocate time-to-sample table with %llu entries.",
@@ -433,10 +562,72 @@ status_t SampleTable::setTimeToSampleParams(
         mTimeToSample[i] = ntohl(mTimeToSample[i]);
     }
 
+    buildTimeToSampleStarts();
+
+    addCachedTable(FOURCC('s', 't', 't', 's'), data_offset, data_size,
+            mTimeToSample, mTimeToSampleCount, 2 * sizeof(uint32_t));
+
     mHasTimeToSample = true;
     return OK;
 }
 
+void SampleTable::buildTimeToSampleStarts() {
+    uint64_t allocSize =
+        ((uint64_t)mTimeToSampleCount + 1) * sizeof(TimeToSampleStart);
+    if (mTotalSize + allocSize > kMaxTotalSize) {
+        // the iterator walks the table instead
+        return;
+    }
+
+    mTimeToSampleStarts =
+        new (std::nothrow) TimeToSampleStart[mTimeToSampleCount + 1];
+    if (!mTimeToSampleStarts) {
+        return;
+    }
+    mTotalSize += allocSize;
+
+    uint64_t sampleIndex = 0;
+    uint64_t sampleTime = 0;
+    uint32_t i = 0;
+    for (; i <= mTimeToSampleCount; ++i) {
+        mTimeToSampleStarts[i].mSampleIndex = sampleIndex;
+        mTimeToSampleStarts[i].mSampleTime = sampleTime;
+
+        if (i == mTimeToSampleCount) {
+            ++i;
+            break;
+        }
+
+        sampleIndex += mTimeToSample[2 * i];
+        sampleTime += (uint64_t)mTimeToSample[2 * i] * mTimeToSample[2 * i + 1];
+        if (sampleIndex > UINT32_MAX || sampleTime > UINT32_MAX) {
+            ++i;
+            break;
+        }
+    }
+    mNumTimeToSampleStarts = i;
+}
+
+uint32_t SampleTable::findTimeToSampleEntry(uint32_t sampleIndex) const {
+    // the last start of a complete index is the end of the table, not an entry
+    uint32_t right_plus_one = mNumTimeToSampleStarts;
+    if (right_plus_one > mTimeToSampleCount) {
+        right_plus_one = mTimeToSampleCount;
+    }
+
+    // find the last entry starting at or before sampleIndex
+    uint32_t left = 0;
+    while (left + 1 < right_plus_one) {
+        uint32_t center = left + (right_plus_one - left) / 2;
+        if (mTimeToSampleStarts[center].mSampleIndex <= sampleIndex) {
+            left = center;
+        } else {
+            right_plus_one = center;
+        }
+    }
+    return left;
+}
+
 status_t SampleTable::setCompositionTimeToSampleParams(
         off64_t data_offset, size_t data_size) {
     ALOGI("There are reordered frames present.");
@@ -482,6 +673,15 @@ status_t SampleTable::setCompositionTimeToSampleParams(
         return ERROR_OUT_OF_RANGE;
     }
 
+    mCompositionTimeDeltaEntries = (uint32_t *)lookupCachedTable(
+            FOURCC('c', 't', 't', 's'), data_offset, data_size,
+            numEntries, 2 * sizeof(uint32_t), kCachedCompositionTimeDeltas);
+    if (mCompositionTimeDeltaEntries != NULL) {
+        mCompositionDeltaLookup->setEntries(
+                mCompositionTimeDeltaEntries, mNumCompositionTimeDeltaEntries);
+        return OK;
+    }
+
     mCompositionTimeDeltaEntries = new (std::nothrow) uint32_t[2 * numEntries];
     if (!mCompositionTimeDeltaEntries) {
         ALOGE("Cannot allocate composition-time-to-sample table with %llu "
@@ -501,6 +701,9 @@ status_t SampleTable::setCompositionTimeToSampleParams(
         mCompositionTimeDeltaEntries[i] = ntohl(mCompositionTimeDeltaEntries[i]);
     }
 
+    addCachedTable(FOURCC('c', 't', 't', 's'), data_offset, data_size,
+            mCompositionTimeDeltaEntries, numEntries, 2 * sizeof(uint32_t));
+
     mCompositionDeltaLookup->setEntries(
             mCompositionTimeDeltaEntries, mNumCompositionTimeDeltaEntries);
 
@@ -549,6 +752,13 @@ status_t SampleTable::setSyncSampleParams(off64_t data_offset, size_t data_size)
         return ERROR_OUT_OF_RANGE;
     }
 
+    mSyncSamples = (uint32_t *)lookupCachedTable(
+            FOURCC('s', 't', 's', 's'), data_offset, data_size,
+            mNumSyncSamples, sizeof(uint32_t), kCachedSyncSamples);
+    if (mSyncSamples != NULL) {
+        return OK;
+    }
+
     mSyncSamples = new (std::nothrow) uint32_t[mNumSyncSamples];
     if (!mSyncSamples) {
         ALOGE("Cannot allocate sync sample table with %llu entries.",
@@ -565,6 +775,9 @@ status_t SampleTable::setSyncSampleParams(off64_t data_offset, size_t data_size)
         mSyncSamples[i] = ntohl(mSyncSamples[i]) - 1;
     }
 
+    addCachedTable(FOURCC('s', 't', 's', 's'), data_offset, data_size,
+            mSyncSamples, mNumSyncSamples, sizeof(uint32_t));
+
     return OK;
 }
 
@@ -602,23 +815,36 @@ uint32_t abs_difference(uint32_t time1, uint32_t time2) {
 }
 
 // static
-int SampleTable::CompareIncreasingTime(const void *_a, const void *_b) {
-    const SampleTimeEntry *a = (const SampleTimeEntry *)_a;
-    const SampleTimeEntry *b = (const SampleTimeEntry *)_b;
+bool SampleTable::IsEarlier(const SampleTimeEntry &a, const SampleTimeEntry &b) {
+    return a.mCompositionTime < b.mCompositionTime;
+}
 
-    if (a->mCompositionTime < b->mCompositionTime) {
-        return -1;
-    } else if (a->mCompositionTime > b->mCompositionTime) {
-        return 1;
+uint32_t SampleTable::getSortedSampleTime(uint32_t i) const {
+    if (mSampleTimeEntries != NULL) {
+        return mSampleTimeEntries[i].mCompositionTime;
     }
+    uint32_t entry = findTimeToSampleEntry(i);
+    const TimeToSampleStart &start = mTimeToSampleStarts[entry];
+    return start.mSampleTime + (i - start.mSampleIndex) * mTimeToSample[2 * entry + 1];
+}
 
-    return 0;
+uint32_t SampleTable::getSortedSampleIndex(uint32_t i) const {
+    return mSampleTimeEntries != NULL ? mSampleTimeEntries[i].mSampleIndex : i;
 }
 
 void SampleTable::buildSampleEntriesTable() {
     Mutex::Autolock autoLock(mLock);
 
-    if (mSampleTimeEntries != NULL || mNumSampleSizes == 0) {
+    if (mSampleTimeEntries != NULL || mHasMonotonicSampleTimes || mNumSampleSizes == 0) {
+        return;
+    }
+
+    // Without reordering, sample times are increasing and the time-to-sample index is
+    // enough to binary search them, if it covers every sample.
+    if (mCompositionTimeDeltaEntries == NULL
+            && mNumTimeToSampleStarts == mTimeToSampleCount + 1
+            && mTimeToSampleStarts[mTimeToSampleCount].mSampleIndex >= mNumSampleSizes) {
+        mHasMonotonicSampleTimes = true;
         return;
     }
 
@@ -644,33 +870,60 @@ void SampleTable::buildSampleEntriesTable() {
     uint32_t sampleIndex = 0;
     uint32_t sampleTime = 0;
 
-    for (uint32_t i = 0; i < mTimeToSampleCount; ++i) {
+    // walk the composition offsets along with the samples, rather than looking up
+    // each sample's offset
+    const uint32_t *deltaEntries = mCompositionTimeDeltaEntries;
+    const size_t numDeltaEntries =
+        deltaEntries != NULL ? mNumCompositionTimeDeltaEntries : 0;
+    size_t deltaEntry = 0;
+    uint32_t deltaSamplesLeft = numDeltaEntries > 0 ? deltaEntries[0] : 0;
+
+    for (uint32_t i = 0; i < mTimeToSampleCount && sampleIndex < mNumSampleSizes; ++i) {
         uint32_t n = mTimeToSample[2 * i];
         uint32_t delta = mTimeToSample[2 * i + 1];
 
-        for (uint32_t j = 0; j < n; ++j) {
-            if (sampleIndex < mNumSampleSizes) {
-                // Technically this should always be the case if the file
-                // is well-formed, but you know... there's (gasp) malformed
-                // content out there.
-
-                mSampleTimeEntries[sampleIndex].mSampleIndex = sampleIndex;
+        // Technically the samples should always fit if the file is well-formed,
+        // but you know... there's (gasp) malformed content out there.
+        if (n > mNumSampleSizes - sampleIndex) {
+            n = mNumSampleSizes - sampleIndex;
+        }
 
-                uint32_t compTimeDelta =
-                    mCompositionDeltaLookup->getCompositionTimeOffset(
-                            sampleIndex);
+        for (uint32_t j = 0; j < n; ++j) {
+            while (deltaSamplesLeft == 0 && deltaEntry < numDeltaEntries) {
+                if (++deltaEntry < numDeltaEntries) {
+                    deltaSamplesLeft = deltaEntries[2 * deltaEntry];
+                }
+            }
 
-                mSampleTimeEntries[sampleIndex].mCompositionTime =
-                    sampleTime + compTimeDelta;
+            uint32_t compTimeDelta = 0;
+            if (deltaEntry < numDeltaEntries) {
+                compTimeDelta = deltaEntries[2 * deltaEntry + 1];
+                --deltaSamplesLeft;
             }
 
+            mSampleTimeEntries[sampleIndex].mSampleIndex = sampleIndex;
+            mSampleTimeEntries[sampleIndex].mCompositionTime =
+                sampleTime + compTimeDelta;
+
             ++sampleIndex;
             sampleTime += delta;
         }
     }
 
-    qsort(mSampleTimeEntries, mNumSampleSizes, sizeof(SampleTimeEntry),
-          CompareIncreasingTime);
+    // samples missing from the time-to-sample table
+    for (; sampleIndex < mNumSampleSizes; ++sampleIndex) {
+        mSampleTimeEntries[sampleIndex].mSampleIndex = sampleIndex;
+        mSampleTimeEntries[sampleIndex].mCompositionTime = sampleTime;
+    }
+
+    // reordering is usually local, and a good share of tracks is in order already
+    bool sorted = true;
+    for (uint32_t i = 1; i < mNumSampleSizes && sorted; ++i) {
+        sorted = !IsEarlier(mSampleTimeEntries[i], mSampleTimeEntries[i - 1]);
+    }
+    if (!sorted) {
+        std::sort(mSampleTimeEntries, mSampleTimeEntries + mNumSampleSizes, IsEarlier);
+    }
 }
 
 status_t SampleTable::findSampleAtTime(
@@ -678,7 +931,7 @@ status_t SampleTable::findSampleAtTime(
         uint32_t *sample_index, uint32_t flags) {
     buildSampleEntriesTable();
 
-    if (mSampleTimeEntries == NULL) {
+    if (mSampleTimeEntries == NULL && !mHasMonotonicSampleTimes) {
         return ERROR_OUT_OF_RANGE;
     }
 
@@ -694,7 +947,7 @@ status_t SampleTable::findSampleAtTime(
         } else if (req_time > centerTime) {
             left = center + 1;
         } else {
-            *sample_index = mSampleTimeEntries[center].mSampleIndex;
+            *sample_index = getSortedSampleIndex(center);
             return OK;
         }
     }
@@ -743,7 +996,7 @@ status_t SampleTable::findSampleAtTime(
         }
     }
 
-    *sample_index = mSampleTimeEntries[closestIndex].mSampleIndex;
+    *sample_index = getSortedSampleIndex(closestIndex);
     return OK;
 }
 
@@ -932,7 +1185,16 @@ status_t SampleTable::getMetaDataForSample(
                     && (mSyncSamples[mLastSyncSampleIndex] <= sampleIndex)
                 ? mLastSyncSampleIndex : 0;
 
+            // reading in order only ever moves by a sync sample or so, after a seek
+            // binary search for it
+            static const size_t kMaxLinearSteps = 4;
+            size_t steps = 0;
             while (i < mNumSyncSamples && mSyncSamples[i] < sampleIndex) {
+                if (++steps > kMaxLinearSteps) {
+                    i = std::lower_bound(mSyncSamples + i, mSyncSamples + mNumSyncSamples,
+                            sampleIndex) - mSyncSamples;
+                    break;
+                }
                 ++i;
             }
 
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SampleTableCache"
+#include <utils/Log.h>
+
+#include "include/SampleTableCache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+static const char kCacheDir[] = "/data/misc/media/mp4index";
+static const uint32_t kCacheMagic = 0x43425453;     // 'STBC'
+static const uint32_t kCacheVersion = 1;
+
+// Files whose tables are smaller than this parse fast enough without a cache.
+static const size_t kMinCachedBytes = 64 * 1024;
+
+// Beyond this many cache files, the least recently written ones are removed.
+static const size_t kMaxCacheFiles = 32;
+
+struct SampleTableCache::Header {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    DataSource::FileIdentity mIdentity;
+    uint32_t mNumTables;
+    uint32_t mReserved;
+};
+
+struct SampleTableCache::TableEntry {
+    uint32_t mType;
+    uint32_t mEntrySize;
+    uint64_t mBoxOffset;
+    uint64_t mBoxSize;
+    uint32_t mNumEntries;
+    uint32_t mReserved;
+    uint64_t mDataOffset;   // from the start of the file, 8 byte aligned
+};
+
+static size_t align8(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+// static
+sp<SampleTableCache> SampleTableCache::Create(const sp<DataSource> &source) {
+    if (!property_get_bool("media.stagefright.mp4-index-cache", false)) {
+        return NULL;
+    }
+
+    DataSource::FileIdentity identity;
+    memset(&identity, 0, sizeof(identity));
+    if (!source->getFileIdentity(&identity)) {
+        return NULL;
+    }
+
+    // FNV-1a of the identity names the cache file; the header holds the full identity.
+    uint64_t hash = 14695981039346656037ull;
+    const uint8_t *bytes = (const uint8_t *)&identity;
+    for (size_t i = 0; i < sizeof(identity); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+
+    String8 path = String8::format("%s/%016llx.stbl", kCacheDir, (unsigned long long)hash);
+    sp<SampleTableCache> cache = new SampleTableCache(identity, path);
+    cache->map();
+    return cache;
+}
+
+SampleTableCache::SampleTableCache(
+        const DataSource::FileIdentity &identity, const String8 &path)
+    : mIdentity(identity),
+      mPath(path),
+      mMapping(NULL),
+      mMappingSize(0),
+      mTables(NULL),
+      mNumTables(0) {
+}
+
+SampleTableCache::~SampleTableCache() {
+    clearPending_l();
+    if (mMapping != NULL) {
+        munmap(mMapping, mMappingSize);
+        mMapping = NULL;
+    }
+}
+
+void SampleTableCache::map() {
+    int fd = open(mPath.string(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+        close(fd);
+        return;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return;
+    }
+
+    const size_t size = st.st_size;
+    const Header *header = (const Header *)mapping;
+    bool valid = header->mMagic == kCacheMagic
+            && header->mVersion == kCacheVersion
+            && !memcmp(&header->mIdentity, &mIdentity, sizeof(mIdentity))
+            && header->mNumTables <= (size - sizeof(Header)) / sizeof(TableEntry);
+
+    const TableEntry *tables = (const TableEntry *)(header + 1);
+    for (uint32_t i = 0; valid && i < header->mNumTables; ++i) {
+        const TableEntry &table = tables[i];
+        const uint64_t dataSize = (uint64_t)table.mNumEntries * table.mEntrySize;
+        valid = (table.mDataOffset & 7) == 0
+                && table.mDataOffset <= size
+                && dataSize <= size - table.mDataOffset;
+    }
+
+    if (!valid) {
+        ALOGV("ignoring stale or invalid %s", mPath.string());
+        munmap(mapping, size);
+        return;
+    }
+
+    mMapping = mapping;
+    mMappingSize = size;
+    mTables = tables;
+    mNumTables = header->mNumTables;
+    ALOGV("mapped %u tables from %s", mNumTables, mPath.string());
+}
+
+const void *SampleTableCache::lookup(
+        uint32_t type, off64_t boxOffset, size_t boxSize,
+        uint32_t numEntries, size_t entrySize) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (uint32_t i = 0; i < mNumTables; ++i) {
+        const TableEntry &table = mTables[i];
+        if (table.mType == type
+                && table.mBoxOffset == (uint64_t)boxOffset
+                && table.mBoxSize == boxSize) {
+            if (table.mNumEntries != numEntries || table.mEntrySize != entrySize) {
+                return NULL;
+            }
+            return (const uint8_t *)mMapping + table.mDataOffset;
+        }
+    }
+    return NULL;
+}
+
+void SampleTableCache::add(
+        uint32_t type, off64_t boxOffset, size_t boxSize,
+        const void *data, uint32_t numEntries, size_t entrySize) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mMapping != NULL || data == NULL) {
+        return;
+    }
+
+    // the table may be freed before save(), with a track that turns out to be invalid
+    const size_t size = numEntries * entrySize;
+    void *copy = malloc(size > 0 ? size : 1);
+    if (copy == NULL) {
+        return;
+    }
+    memcpy(copy, data, size);
+
+    PendingTable table;
+    table.mType = type;
+    table.mBoxOffset = boxOffset;
+    table.mBoxSize = boxSize;
+    table.mData = copy;
+    table.mNumEntries = numEntries;
+    table.mEntrySize = entrySize;
+    mPending.push(table);
+}
+
+void SampleTableCache::save() {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mPending.isEmpty()) {
+        return;
+    }
+
+    size_t dataOffset = align8(sizeof(Header) + mPending.size() * sizeof(TableEntry));
+    size_t tableBytes = 0;
+    for (size_t i = 0; i < mPending.size(); ++i) {
+        tableBytes += mPending[i].mNumEntries * mPending[i].mEntrySize;
+    }
+    if (tableBytes < kMinCachedBytes) {
+        clearPending_l();
+        return;
+    }
+
+    mkdir(kCacheDir, 0700);
+
+    String8 tmpPath = mPath;
+    tmpPath.append(".tmp");
+    FILE *file = fopen(tmpPath.string(), "we");
+    if (file == NULL) {
+        ALOGV("cannot write %s: %s", tmpPath.string(), strerror(errno));
+        clearPending_l();
+        return;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.mMagic = kCacheMagic;
+    header.mVersion = kCacheVersion;
+    header.mIdentity = mIdentity;
+    header.mNumTables = mPending.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (size_t i = 0; ok && i < mPending.size(); ++i) {
+        const PendingTable &pending = mPending[i];
+        TableEntry table;
+        memset(&table, 0, sizeof(table));
+        table.mType = pending.mType;
+        table.mEntrySize = pending.mEntrySize;
+        table.mBoxOffset = pending.mBoxOffset;
+        table.mBoxSize = pending.mBoxSize;
+        table.mNumEntries = pending.mNumEntries;
+        table.mDataOffset = dataOffset;
+        dataOffset = align8(dataOffset + pending.mNumEntries * pending.mEntrySize);
+        ok = fwrite(&table, sizeof(table), 1, file) == 1;
+    }
+
+    static const uint8_t kPadding[8] = { 0 };
+    for (size_t i = 0; ok && i < mPending.size(); ++i) {
+        const PendingTable &pending = mPending[i];
+        const size_t size = pending.mNumEntries * pending.mEntrySize;
+        size_t padding = align8(ftell(file)) - ftell(file);
+        ok = (padding == 0 || fwrite(kPadding, padding, 1, file) == 1)
+                && (size == 0 || fwrite(pending.mData, size, 1, file) == 1);
+    }
+
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmpPath.string(), mPath.string()) != 0) {
+        ALOGW("failed to write %s", mPath.string());
+        unlink(tmpPath.string());
+    } else {
+        ALOGV("cached %zu tables, %zu bytes, in %s",
+                mPending.size(), tableBytes, mPath.string());
+        evictOldFiles();
+    }
+    clearPending_l();
+}
+
+void SampleTableCache::clearPending_l() {
+    for (size_t i = 0; i < mPending.size(); ++i) {
+        free(mPending[i].mData);
+    }
+    mPending.clear();
+}
+
+// static
+void SampleTableCache::evictOldFiles() {
+    DIR *dir = opendir(kCacheDir);
+    if (dir == NULL) {
+        return;
+    }
+
+    for (;;) {
+        size_t numFiles = 0;
+        time_t oldestTime = 0;
+        String8 oldestPath;
+
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            String8 path = String8::format("%s/%s", kCacheDir, entry->d_name);
+            struct stat st;
+            if (stat(path.string(), &st) != 0) {
+                continue;
+            }
+            if (numFiles++ == 0 || st.st_mtime < oldestTime) {
+                oldestTime = st.st_mtime;
+                oldestPath = path;
+            }
+        }
+
+        if (numFiles <= kMaxCacheFiles) {
+            break;
+        }
+        unlink(oldestPath.string());
+        rewinddir(dir);
+    }
+
+    closedir(dir);
+}
+
+}  // namespace android
@@ -0,0 +1,495 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SegmentedTranscoder"
+#include <utils/Log.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <media/IMediaCodecList.h>
+#include <media/MediaCodecInfo.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecList.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaMuxer.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <media/stagefright/SegmentedTranscoder.h>
+
+namespace android {
+
+// Used when the encoder does not declare a concurrent instance limit.
+static const size_t kDefaultMaxSegments = 4;
+static const size_t kInitialSampleSize = 256 * 1024;
+
+static bool sameCodecData(const sp<AMessage> &a, const sp<AMessage> &b) {
+    static const char *kKeys[] = { "csd-0", "csd-1", "csd-2" };
+    for (size_t i = 0; i < sizeof(kKeys) / sizeof(kKeys[0]); ++i) {
+        sp<ABuffer> bufA, bufB;
+        bool hasA = a->findBuffer(kKeys[i], &bufA);
+        bool hasB = b->findBuffer(kKeys[i], &bufB);
+        if (hasA != hasB) {
+            return false;
+        }
+        if (hasA && (bufA->size() != bufB->size()
+                || memcmp(bufA->data(), bufB->data(), bufA->size()))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SegmentedTranscoder::SegmentedTranscoder()
+    : mInputFd(-1),
+      mInputOffset(0),
+      mInputLength(0),
+      mOutputFd(-1),
+      mTempDir("/data/local/tmp"),
+      mMaxSegments(0),
+      mVideoTrack(-1),
+      mNumPending(0) {
+}
+
+SegmentedTranscoder::~SegmentedTranscoder() {
+    releaseSegments();
+    if (mInputFd >= 0) {
+        close(mInputFd);
+        mInputFd = -1;
+    }
+}
+
+status_t SegmentedTranscoder::setDataSource(int fd, off64_t offset, off64_t length) {
+    if (mInputFd >= 0) {
+        return INVALID_OPERATION;
+    }
+    mInputFd = dup(fd);
+    if (mInputFd < 0) {
+        return -errno;
+    }
+    mInputOffset = offset;
+    mInputLength = length;
+    return OK;
+}
+
+status_t SegmentedTranscoder::setOutput(int fd) {
+    if (mOutputFd >= 0) {
+        return INVALID_OPERATION;
+    }
+    mOutputFd = fd;
+    return OK;
+}
+
+void SegmentedTranscoder::setTempDir(const char *path) {
+    mTempDir = path;
+}
+
+void SegmentedTranscoder::setMaxSegments(size_t maxSegments) {
+    mMaxSegments = maxSegments;
+}
+
+status_t SegmentedTranscoder::selectTrack(size_t index, const sp<AMessage> &outputFormat) {
+    if (mInputFd < 0) {
+        return NO_INIT;
+    }
+    if (mTrackFormats.indexOfKey(index) >= 0) {
+        return -EINVAL;
+    }
+
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    status_t err = extractor->setDataSource(mInputFd, mInputOffset, mInputLength);
+    if (err != OK) {
+        return err;
+    }
+    sp<AMessage> format;
+    err = extractor->getTrackFormat(index, &format);
+    if (err != OK) {
+        return err;
+    }
+
+    AString mime;
+    CHECK(format->findString("mime", &mime));
+    if (outputFormat != NULL && mVideoTrack < 0
+            && !strncasecmp(mime.c_str(), "video/", 6)) {
+        mVideoTrack = index;
+    }
+
+    mTrackFormats.add(index, outputFormat);
+    return OK;
+}
+
+size_t SegmentedTranscoder::getEncoderInstanceLimit() const {
+    AString mime;
+    CHECK(mTrackFormats.valueFor(mVideoTrack)->findString("mime", &mime));
+
+    sp<IMediaCodecList> list = MediaCodecList::getInstance();
+    if (list == NULL) {
+        return 1;
+    }
+    ssize_t index = list->findCodecByType(mime.c_str(), true /* encoder */);
+    if (index < 0) {
+        return 1;
+    }
+    sp<MediaCodecInfo> info = list->getCodecInfo(index);
+    if (info == NULL) {
+        return 1;
+    }
+    sp<MediaCodecInfo::Capabilities> caps = info->getCapabilitiesFor(mime.c_str());
+
+    AString max;
+    if (caps != NULL && caps->getDetails()->findString("max-concurrent-instances", &max)) {
+        int limit = atoi(max.c_str());
+        ALOGV("%s allows %d concurrent instances", info->getCodecName(), limit);
+        return limit > 0 ? limit : 1;
+    }
+    return kDefaultMaxSegments;
+}
+
+status_t SegmentedTranscoder::findSegmentBounds(size_t numSegments, Vector<int64_t> *bounds) {
+    bounds->clear();
+    bounds->push(0ll);
+
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    status_t err = extractor->setDataSource(mInputFd, mInputOffset, mInputLength);
+    if (err == OK) {
+        err = extractor->selectTrack(mVideoTrack);
+    }
+    if (err != OK) {
+        return err;
+    }
+
+    sp<AMessage> format;
+    CHECK_EQ(extractor->getTrackFormat(mVideoTrack, &format), (status_t)OK);
+    int64_t durationUs;
+    if (!format->findInt64("durationUs", &durationUs) || durationUs <= 0) {
+        numSegments = 1;
+    }
+
+    // The extractor's previous sync seek ends up in the container's sync
+    // sample table, e.g. SampleTable::findSyncSampleNear() for MPEG-4, so
+    // every bound is the exact time of a sync sample.
+    for (size_t i = 1; i < numSegments; ++i) {
+        int64_t timeUs;
+        if (extractor->seekTo(durationUs * i / numSegments,
+                MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC) != OK
+                || extractor->getSampleTime(&timeUs) != OK) {
+            break;
+        }
+        if (timeUs > bounds->top()) {
+            bounds->push(timeUs);
+        }
+    }
+    bounds->push(-1ll);
+    return OK;
+}
+
+status_t SegmentedTranscoder::startSegment(size_t index) {
+    Segment *segment = &mSegments.editItemAt(index);
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/segment-XXXXXX", mTempDir.c_str());
+    segment->mFd = mkstemp(path);
+    if (segment->mFd < 0) {
+        ALOGE("unable to create a segment file in %s", mTempDir.c_str());
+        return -errno;
+    }
+    segment->mPath = path;
+
+    segment->mLooper = new ALooper;
+    segment->mLooper->setName("SegmentTranscoder");
+    segment->mLooper->start();
+
+    sp<AMessage> notify = new AMessage(kWhatSegmentNotify, this);
+    notify->setSize("segment", index);
+    segment->mTranscoder = new MediaTranscoder(notify);
+    segment->mLooper->registerHandler(segment->mTranscoder);
+
+    status_t err = segment->mTranscoder->setDataSource(mInputFd, mInputOffset, mInputLength);
+    if (err == OK) {
+        err = segment->mTranscoder->setOutput(segment->mFd, MediaMuxer::OUTPUT_FORMAT_MPEG_4);
+    }
+    for (size_t i = 0; err == OK && i < mTrackFormats.size(); ++i) {
+        err = segment->mTranscoder->selectTrack(mTrackFormats.keyAt(i), mTrackFormats.valueAt(i));
+    }
+    if (err == OK) {
+        err = segment->mTranscoder->setTimeRange(segment->mStartUs, segment->mEndUs);
+    }
+    if (err == OK) {
+        err = segment->mTranscoder->start();
+    }
+    return err;
+}
+
+status_t SegmentedTranscoder::transcode(MediaTranscoder::Stats *stats) {
+    if (mInputFd < 0 || mOutputFd < 0) {
+        return NO_INIT;
+    }
+    if (mVideoTrack < 0) {
+        ALOGE("segments need a transcoded video track");
+        return INVALID_OPERATION;
+    }
+
+    const int64_t startTimeUs = ALooper::GetNowUs();
+
+    size_t numSegments = getEncoderInstanceLimit();
+    if (mMaxSegments > 0 && mMaxSegments < numSegments) {
+        numSegments = mMaxSegments;
+    }
+
+    Vector<int64_t> bounds;
+    status_t err = findSegmentBounds(numSegments, &bounds);
+    if (err != OK) {
+        return err;
+    }
+    ALOGV("transcoding %zu segments", bounds.size() - 1);
+
+    mLooper = new ALooper;
+    mLooper->setName("SegmentedTranscoder");
+    mLooper->start();
+    mLooper->registerHandler(this);
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+            Segment segment;
+            segment.mStartUs = bounds[i];
+            segment.mEndUs = bounds[i + 1];
+            segment.mFd = -1;
+            segment.mResult = OK;
+            segment.mDone = false;
+            mSegments.push(segment);
+        }
+        mNumPending = mSegments.size();
+    }
+
+    for (size_t i = 0; i < mSegments.size(); ++i) {
+        err = startSegment(i);
+        if (err != OK) {
+            Mutex::Autolock autoLock(mLock);
+            // Never started, so it will not report kWhatDone.
+            mSegments.editItemAt(i).mResult = err;
+            mSegments.editItemAt(i).mDone = true;
+            mNumPending -= mSegments.size() - i;
+            for (size_t j = i + 1; j < mSegments.size(); ++j) {
+                mSegments.editItemAt(j).mDone = true;
+            }
+            break;
+        }
+    }
+
+    if (err != OK) {
+        // Abort the segments that did start, each then reports kWhatDone.
+        for (size_t i = 0; i < mSegments.size(); ++i) {
+            if (mSegments[i].mTranscoder != NULL) {
+                mSegments[i].mTranscoder->stop();
+            }
+        }
+    }
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (mNumPending > 0) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    *stats = MediaTranscoder::Stats();
+    for (size_t i = 0; i < mSegments.size(); ++i) {
+        const Segment &segment = mSegments[i];
+        if (err == OK && segment.mResult != OK) {
+            ALOGE("segment %zu failed (%d)", i, segment.mResult);
+            err = segment.mResult;
+        }
+        if (segment.mTranscoder == NULL) {
+            continue;
+        }
+        segment.mTranscoder->stop();
+
+        MediaTranscoder::Stats segmentStats;
+        segment.mTranscoder->getStats(&segmentStats);
+        stats->mDurationUs += segmentStats.mDurationUs;
+        stats->mNumSamplesRead += segmentStats.mNumSamplesRead;
+        stats->mNumFramesDecoded += segmentStats.mNumFramesDecoded;
+        stats->mNumFramesEncoded += segmentStats.mNumFramesEncoded;
+    }
+
+    if (err == OK) {
+        err = stitchSegments(stats);
+    }
+
+    releaseSegments();
+    mLooper->unregisterHandler(id());
+    mLooper->stop();
+    mLooper.clear();
+
+    stats->mElapsedUs = ALooper::GetNowUs() - startTimeUs;
+    return err;
+}
+
+status_t SegmentedTranscoder::stitchSegments(MediaTranscoder::Stats *stats) {
+    Vector<sp<NuMediaExtractor> > extractors;
+    for (size_t i = 0; i < mSegments.size(); ++i) {
+        off64_t size = lseek64(mSegments[i].mFd, 0, SEEK_END);
+        sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+        status_t err = extractor->setDataSource(mSegments[i].mFd, 0, size);
+        if (err != OK) {
+            return err;
+        }
+        if (i > 0 && extractor->countTracks() != extractors[0]->countTracks()) {
+            return ERROR_MALFORMED;
+        }
+        for (size_t t = 0; t < extractor->countTracks(); ++t) {
+            if (i > 0) {
+                sp<AMessage> first, format;
+                CHECK_EQ(extractors[0]->getTrackFormat(t, &first), (status_t)OK);
+                CHECK_EQ(extractor->getTrackFormat(t, &format), (status_t)OK);
+                if (!sameCodecData(first, format)) {
+                    ALOGE("segment %zu track %zu has different codec data", i, t);
+                    return ERROR_UNSUPPORTED;
+                }
+            }
+            extractor->selectTrack(t);
+        }
+        extractors.push(extractor);
+    }
+
+    sp<MediaMuxer> muxer = new MediaMuxer(mOutputFd, MediaMuxer::OUTPUT_FORMAT_MPEG_4);
+    Vector<ssize_t> muxerTracks;
+    for (size_t t = 0; t < extractors[0]->countTracks(); ++t) {
+        sp<AMessage> format;
+        CHECK_EQ(extractors[0]->getTrackFormat(t, &format), (status_t)OK);
+        ssize_t muxerTrack = muxer->addTrack(format);
+        if (muxerTrack < 0) {
+            return muxerTrack;
+        }
+        muxerTracks.push(muxerTrack);
+    }
+
+    status_t err = muxer->start();
+    if (err != OK) {
+        return err;
+    }
+
+    // Segments are copied sample by sample, so nothing is decoded again.
+    sp<ABuffer> buffer = new ABuffer(kInitialSampleSize);
+    for (size_t i = 0; err == OK && i < extractors.size(); ++i) {
+        const sp<NuMediaExtractor> &extractor = extractors[i];
+
+        int64_t firstTimeUs;
+        if (extractor->getSampleTime(&firstTimeUs) != OK) {
+            continue;
+        }
+        // Each segment may have been rebased to zero by its writer.
+        const int64_t offsetUs = mSegments[i].mStartUs - firstTimeUs;
+
+        size_t trackIndex;
+        while (err == OK && extractor->getSampleTrackIndex(&trackIndex) == OK) {
+            err = extractor->readSampleData(buffer);
+            while (err == -ENOMEM) {
+                buffer = new ABuffer(buffer->capacity() * 2);
+                err = extractor->readSampleData(buffer);
+            }
+            if (err != OK) {
+                break;
+            }
+
+            int64_t timeUs;
+            CHECK_EQ(extractor->getSampleTime(&timeUs), (status_t)OK);
+
+            uint32_t flags = 0;
+            sp<MetaData> meta;
+            int32_t isSync;
+            if (extractor->getSampleMeta(&meta) == OK
+                    && meta->findInt32(kKeyIsSyncFrame, &isSync) && isSync) {
+                flags |= MediaCodec::BUFFER_FLAG_SYNCFRAME;
+            }
+
+            err = muxer->writeSampleData(
+                    buffer, muxerTracks[trackIndex], timeUs + offsetUs, flags);
+            ++stats->mNumSamplesWritten;
+            stats->mNumBytesWritten += buffer->size();
+            extractor->advance();
+        }
+    }
+
+    status_t stopErr = muxer->stop();
+    return err != OK ? err : stopErr;
+}
+
+void SegmentedTranscoder::releaseSegments() {
+    for (size_t i = 0; i < mSegments.size(); ++i) {
+        Segment *segment = &mSegments.editItemAt(i);
+        if (segment->mTranscoder != NULL) {
+            segment->mLooper->unregisterHandler(segment->mTranscoder->id());
+            segment->mTranscoder.clear();
+        }
+        if (segment->mLooper != NULL) {
+            segment->mLooper->stop();
+            segment->mLooper.clear();
+        }
+        if (segment->mFd >= 0) {
+            close(segment->mFd);
+            unlink(segment->mPath.c_str());
+        }
+    }
+    Mutex::Autolock autoLock(mLock);
+    mSegments.clear();
+}
+
+void SegmentedTranscoder::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatSegmentNotify:
+        {
+            size_t index;
+            int32_t what;
+            CHECK(msg->findSize("segment", &index));
+            CHECK(msg->findInt32("what", &what));
+            if (what != MediaTranscoder::kWhatDone) {
+                break;
+            }
+
+            status_t err;
+            CHECK(msg->findInt32("err", &err));
+
+            Mutex::Autolock autoLock(mLock);
+            if (index >= mSegments.size()) {
+                // Late notification of an aborted segment.
+                break;
+            }
+            Segment *segment = &mSegments.editItemAt(index);
+            if (!segment->mDone) {
+                ALOGV("segment %zu done (%d)", index, err);
+                segment->mResult = err;
+                segment->mDone = true;
+                --mNumPending;
+                mCondition.signal();
+            }
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+}  // namespace android
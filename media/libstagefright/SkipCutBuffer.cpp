@@ -170,6 +170,8 @@ size_t SkipCutBuffer::read(char *dst, size_t num) {
     if (available < int32_t(num)) {
         num = available;
     }
+    // the destination may be smaller than what is available
+    size_t copied = num;
 
     size_t copyfirst = (mCapacity - mReadHead);
     if (copyfirst > num) copyfirst = num;
@@ -185,7 +187,7 @@ size_t SkipCutBuffer::read(char *dst, size_t num) {
             mReadHead += num;
         }
     }
-    return available;
+    return copied;
 }
 
 size_t SkipCutBuffer::size() {
@@ -18,23 +18,49 @@
 #define LOG_TAG "StagefrightMediaScanner"
 #include <utils/Log.h>
 
+#include <inttypes.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include <media/stagefright/StagefrightMediaScanner.h>
 
 #include <media/IMediaHTTPService.h>
 #include <media/mediametadataretriever.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MetaData.h>
 #include <private/media/VideoFrame.h>
 
+#include <CharacterEncodingDetector.h>
+
 #include <stagefright/AVExtensions.h>
 
 namespace android {
 
-StagefrightMediaScanner::StagefrightMediaScanner() {}
+StagefrightMediaScanner::StagefrightMediaScanner()
+    : mGeneration(0),
+      mPrefetchCount(kPrefetchWindow),
+      mExit(false) {
+}
 
-StagefrightMediaScanner::~StagefrightMediaScanner() {}
+StagefrightMediaScanner::~StagefrightMediaScanner() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mExit = true;
+        mWorkCondition.broadcast();
+    }
+    for (size_t i = 0; i < mThreads.size(); ++i) {
+        mThreads[i]->requestExitAndWait();
+    }
+    for (size_t i = 0; i < mDetectors.size(); ++i) {
+        delete mDetectors[i];
+    }
+}
 
 static bool FileHasAcceptableExtension(const char *extension) {
     static const char *kValidExtensions[] = {
@@ -60,6 +86,73 @@ static bool FileHasAcceptableExtension(const char *extension) {
     return false;
 }
 
+static bool PathHasAcceptableExtension(const char *path) {
+    const char *extension = strrchr(path, '.');
+
+    if (!extension) {
+        return false;
+    }
+
+    return FileHasAcceptableExtension(extension)
+        || AVUtils::get()->isEnhancedExtension(extension);
+}
+
+static bool IsASCII(const char *s) {
+    for (; *s != '\0'; ++s) {
+        if ((uint8_t)*s >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The tags reported to the client, in the order they are reported.
+// metaKey is the MetaData key the tag-only path reads the tag from, tags
+// without one are derived from the tracks.
+struct TagMap {
+    const char *tag;
+    int key;
+    uint32_t metaKey;
+    bool detectCharset;
+};
+static const TagMap kTagMap[] = {
+    { "tracknumber", METADATA_KEY_CD_TRACK_NUMBER, kKeyCDTrackNumber, true },
+    { "discnumber", METADATA_KEY_DISC_NUMBER, kKeyDiscNumber, true },
+    { "album", METADATA_KEY_ALBUM, kKeyAlbum, true },
+    { "artist", METADATA_KEY_ARTIST, kKeyArtist, true },
+    { "albumartist", METADATA_KEY_ALBUMARTIST, kKeyAlbumArtist, true },
+    { "composer", METADATA_KEY_COMPOSER, kKeyComposer, true },
+    { "genre", METADATA_KEY_GENRE, kKeyGenre, true },
+    { "title", METADATA_KEY_TITLE, kKeyTitle, true },
+    { "year", METADATA_KEY_YEAR, kKeyYear, true },
+    { "date", METADATA_KEY_DATE, kKeyDate, false },
+    { "duration", METADATA_KEY_DURATION, 0, false },
+    { "writer", METADATA_KEY_WRITER, kKeyWriter, true },
+    { "compilation", METADATA_KEY_COMPILATION, kKeyCompilation, true },
+    { "isdrm", METADATA_KEY_IS_DRM, 0, false },
+    { "width", METADATA_KEY_VIDEO_WIDTH, 0, false },
+    { "height", METADATA_KEY_VIDEO_HEIGHT, 0, false },
+};
+static const size_t kNumTagMapEntries = sizeof(kTagMap) / sizeof(kTagMap[0]);
+
+static ssize_t FindTag(const char *tag) {
+    for (size_t i = 0; i < kNumTagMapEntries; ++i) {
+        if (!strcmp(kTagMap[i].tag, tag)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+StagefrightMediaScanner::ScanThread::ScanThread(StagefrightMediaScanner *scanner)
+    : Thread(false /* canCallJava */),
+      mScanner(scanner) {
+}
+
+bool StagefrightMediaScanner::ScanThread::threadLoop() {
+    return mScanner->runQueuedEntry();
+}
+
 MediaScanResult StagefrightMediaScanner::processFile(
         const char *path, const char *mimeType,
         MediaScannerClient &client) {
@@ -75,19 +168,373 @@ MediaScanResult StagefrightMediaScanner::processFile(
 MediaScanResult StagefrightMediaScanner::processFileInternal(
         const char *path, const char * /* mimeType */,
         MediaScannerClient &client) {
-    const char *extension = strrchr(path, '.');
-
-    if (!extension) {
+    if (!PathHasAcceptableExtension(path)) {
         return MEDIA_SCAN_RESULT_SKIPPED;
     }
 
-    if (!FileHasAcceptableExtension(extension)
-        && !AVUtils::get()->isEnhancedExtension(extension)) {
-        return MEDIA_SCAN_RESULT_SKIPPED;
+    sp<ScanEntry> entry = acquireEntry(path);
+    if (entry->mResult != MEDIA_SCAN_RESULT_OK) {
+        return entry->mResult;
+    }
+
+    status_t status;
+    if (!entry->mMimeType.isEmpty()) {
+        status = client.setMimeType(entry->mMimeType.string());
+        if (status) {
+            return MEDIA_SCAN_RESULT_ERROR;
+        }
+    }
+
+    for (size_t i = 0; i < entry->mTags.size(); ++i) {
+        const Tag &tag = entry->mTags[i];
+        status = client.addStringTag(tag.mName.string(), tag.mValue.string());
+        if (status != OK) {
+            return MEDIA_SCAN_RESULT_ERROR;
+        }
+    }
+
+    return MEDIA_SCAN_RESULT_OK;
+}
+
+void StagefrightMediaScanner::prefetchFile(
+        const char *path, long long lastModified, long long fileSize) {
+    Mutex::Autolock autoLock(mLock);
+
+    // Only run ahead of a client that is actually extracting files; when it
+    // is walking a tree that hasn't changed, it won't ask for any of them.
+    if (mExit || mPrefetchCount++ >= kPrefetchWindow) {
+        return;
+    }
+
+    if (!PathHasAcceptableExtension(path)) {
+        return;
+    }
+
+    ssize_t index = mEntries.indexOfKey(String8(path));
+    if (index >= 0) {
+        const sp<ScanEntry> &entry = mEntries.valueAt(index);
+        if (entry->mState != ScanEntry::DONE
+                || (entry->mLastModified == lastModified && entry->mFileSize == fileSize)) {
+            return;
+        }
+        mEntries.removeItemsAt(index);
+    }
+
+    if (mThreads.isEmpty()) {
+        startThreads_l();
+        if (mThreads.isEmpty()) {
+            return;
+        }
+    }
+
+    sp<ScanEntry> entry = addEntry_l(path, lastModified, fileSize);
+    mQueue.push_back(entry);
+    mWorkCondition.signal();
+}
+
+sp<StagefrightMediaScanner::ScanEntry> StagefrightMediaScanner::acquireEntry(
+        const char *path) {
+    long long lastModified = -1;
+    long long fileSize = -1;
+    struct stat statbuf;
+    if (stat(path, &statbuf) == 0) {
+        lastModified = statbuf.st_mtime;
+        fileSize = statbuf.st_size;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    mPrefetchCount = 0;
+
+    sp<ScanEntry> entry;
+    for (;;) {
+        ssize_t index = mEntries.indexOfKey(String8(path));
+        if (index < 0) {
+            entry = addEntry_l(path, lastModified, fileSize);
+            break;
+        }
+
+        entry = mEntries.valueAt(index);
+        if (entry->mState == ScanEntry::QUEUED) {
+            // Nobody has picked it up yet, extract it here rather than wait
+            // for a scan thread.
+            for (List<sp<ScanEntry> >::iterator it = mQueue.begin(); it != mQueue.end(); ++it) {
+                if (*it == entry) {
+                    mQueue.erase(it);
+                    break;
+                }
+            }
+            entry->mLastModified = lastModified;
+            entry->mFileSize = fileSize;
+            break;
+        } else if (entry->mState == ScanEntry::RUNNING) {
+            mDoneCondition.wait(mLock);
+        } else if (entry->mLastModified == lastModified && entry->mFileSize == fileSize) {
+            entry->mGeneration = ++mGeneration;
+            return entry;
+        } else {
+            // the file changed since it was extracted
+            mEntries.removeItemsAt(index);
+        }
+    }
+
+    entry->mState = ScanEntry::RUNNING;
+    mLock.unlock();
+    extractEntry(entry);
+    mLock.lock();
+    entry->mState = ScanEntry::DONE;
+    mDoneCondition.broadcast();
+
+    return entry;
+}
+
+sp<StagefrightMediaScanner::ScanEntry> StagefrightMediaScanner::addEntry_l(
+        const char *path, long long lastModified, long long fileSize) {
+    trimEntries_l();
+
+    sp<ScanEntry> entry = new ScanEntry;
+    entry->mPath = path;
+    entry->mLastModified = lastModified;
+    entry->mFileSize = fileSize;
+    entry->mState = ScanEntry::QUEUED;
+    entry->mGeneration = ++mGeneration;
+    entry->mResult = MEDIA_SCAN_RESULT_ERROR;
+    mEntries.add(entry->mPath, entry);
+    return entry;
+}
+
+void StagefrightMediaScanner::trimEntries_l() {
+    while (mEntries.size() >= kMaxEntries) {
+        // evict the least recently used entry that nobody is waiting for
+        ssize_t oldest = -1;
+        for (size_t i = 0; i < mEntries.size(); ++i) {
+            const sp<ScanEntry> &entry = mEntries.valueAt(i);
+            if (entry->mState == ScanEntry::DONE && (oldest < 0
+                    || entry->mGeneration < mEntries.valueAt(oldest)->mGeneration)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            break;
+        }
+        mEntries.removeItemsAt(oldest);
+    }
+}
+
+void StagefrightMediaScanner::startThreads_l() {
+    // The client's thread extracts too, whenever it asks for a file nobody
+    // has picked up yet, so leave it a core.
+    long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t numThreads = numCpus > 1 ? numCpus - 1 : 1;
+    if (numThreads > kMaxThreads) {
+        numThreads = kMaxThreads;
+    }
+
+    for (size_t i = 0; i < numThreads; ++i) {
+        sp<ScanThread> thread = new ScanThread(this);
+        status_t err = thread->run("MediaScanWorker", ANDROID_PRIORITY_BACKGROUND);
+        if (err != OK) {
+            ALOGW("failed to start scan thread: %d", err);
+            break;
+        }
+        mThreads.push(thread);
+    }
+    ALOGV("started %zu scan threads", mThreads.size());
+}
+
+bool StagefrightMediaScanner::runQueuedEntry() {
+    sp<ScanEntry> entry;
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (mQueue.empty() && !mExit) {
+            mWorkCondition.wait(mLock);
+        }
+        if (mExit) {
+            return false;
+        }
+        entry = *mQueue.begin();
+        mQueue.erase(mQueue.begin());
+        entry->mState = ScanEntry::RUNNING;
+    }
+
+    extractEntry(entry);
+
+    Mutex::Autolock autoLock(mLock);
+    entry->mState = ScanEntry::DONE;
+    mDoneCondition.broadcast();
+    return true;
+}
+
+// static
+CharacterEncodingDetector *StagefrightMediaScanner::acquireDetector() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (!mDetectors.isEmpty()) {
+            CharacterEncodingDetector *detector = mDetectors.top();
+            mDetectors.pop();
+            return detector;
+        }
+    }
+    return new CharacterEncodingDetector();
+}
+
+void StagefrightMediaScanner::releaseDetector(CharacterEncodingDetector *detector) {
+    detector->clear();
+    Mutex::Autolock autoLock(mLock);
+    mDetectors.push(detector);
+}
+
+void StagefrightMediaScanner::extractEntry(const sp<ScanEntry> &entry) {
+    ALOGV("extracting '%s'", entry->mPath.string());
+
+    status_t err = extractTags(entry);
+    if (err != OK) {
+        entry->mMimeType.clear();
+        entry->mTags.clear();
+        err = retrieveTags(entry);
     }
+    entry->mResult = err == OK ? MEDIA_SCAN_RESULT_OK : MEDIA_SCAN_RESULT_ERROR;
+}
+
+// Reads the container level metadata and the track formats in process,
+// without setting up a metadata retriever in the media server or any
+// decoder. Returns an error for anything it can't handle, the caller then
+// falls back to retrieveTags().
+// static
+status_t StagefrightMediaScanner::extractTags(const sp<ScanEntry> &entry) {
+    DataSource::RegisterDefaultSniffers();
 
+    sp<DataSource> source = new FileSource(entry->mPath.string());
+    status_t err = source->initCheck();
+    if (err != OK) {
+        return err;
+    }
+
+    sp<MediaExtractor> extractor =
+        MediaExtractor::Create(source, NULL, MediaExtractor::kMetaDataOnly);
+    if (extractor == NULL) {
+        return UNKNOWN_ERROR;
+    }
+
+    if (extractor->getDrmFlag()) {
+        // protected content has to be opened by the media server
+        return ERROR_UNSUPPORTED;
+    }
+
+    sp<MetaData> meta = extractor->getMetaData();
+    if (meta == NULL) {
+        return UNKNOWN_ERROR;
+    }
+
+    bool found[kNumTagMapEntries];
+    String8 values[kNumTagMapEntries];
+    bool detectCharset = false;
+    for (size_t i = 0; i < kNumTagMapEntries; ++i) {
+        const char *value;
+        found[i] = kTagMap[i].metaKey != 0 && meta->findCString(kTagMap[i].metaKey, &value);
+        if (found[i]) {
+            values[i] = value;
+            if (kTagMap[i].detectCharset && !IsASCII(value)) {
+                detectCharset = true;
+            }
+        }
+    }
+
+    // Plain ASCII tags come out of the detector unchanged, only pay for it
+    // when some tag could be in a legacy encoding.
+    if (detectCharset) {
+        CharacterEncodingDetector *detector = acquireDetector();
+        for (size_t i = 0; i < kNumTagMapEntries; ++i) {
+            if (found[i] && kTagMap[i].detectCharset) {
+                detector->addTag(kTagMap[i].tag, values[i].string());
+            }
+        }
+        detector->detectAndConvert();
+        int size = detector->size();
+        for (int i = 0; i < size; ++i) {
+            const char *name;
+            const char *value;
+            if (detector->getTag(i, &name, &value) != OK) {
+                continue;
+            }
+            ssize_t index = FindTag(name);
+            if (index >= 0) {
+                values[index] = value;
+            }
+        }
+        releaseDetector(detector);
+    }
+
+    const char *fileMIME;
+    if (meta->findCString(kKeyMIMEType, &fileMIME)) {
+        entry->mMimeType = fileMIME;
+    }
+
+    size_t numTracks = extractor->countTracks();
+    if (numTracks > 0) {
+        bool hasVideo = false;
+        int32_t videoWidth = -1;
+        int32_t videoHeight = -1;
+
+        // The overall duration is the duration of the longest track.
+        int64_t maxDurationUs = 0;
+        for (size_t i = 0; i < numTracks; ++i) {
+            sp<MetaData> trackMeta = extractor->getTrackMetaData(i);
+            if (trackMeta == NULL) {
+                continue;
+            }
+
+            int64_t durationUs;
+            if (trackMeta->findInt64(kKeyDuration, &durationUs) && durationUs > maxDurationUs) {
+                maxDurationUs = durationUs;
+            }
+
+            const char *mime;
+            if (!hasVideo && trackMeta->findCString(kKeyMIMEType, &mime)
+                    && !strncasecmp("video/", mime, 6)) {
+                hasVideo = trackMeta->findInt32(kKeyWidth, &videoWidth)
+                        && trackMeta->findInt32(kKeyHeight, &videoHeight);
+            } else if (numTracks == 1 && trackMeta->findCString(kKeyMIMEType, &mime)
+                    && !strncasecmp("audio/", mime, 6)
+                    && !strcasecmp(entry->mMimeType.string(), "video/x-matroska")) {
+                // The matroska file only contains a single audio track,
+                // rewrite its mime type.
+                entry->mMimeType = "audio/x-matroska";
+            }
+        }
+
+        // The duration value is a string representing the duration in ms.
+        ssize_t index = FindTag("duration");
+        found[index] = true;
+        values[index] = String8::format("%" PRId64, (maxDurationUs + 500) / 1000);
+
+        if (hasVideo) {
+            index = FindTag("width");
+            found[index] = true;
+            values[index] = String8::format("%d", videoWidth);
+
+            index = FindTag("height");
+            found[index] = true;
+            values[index] = String8::format("%d", videoHeight);
+        }
+    }
+
+    for (size_t i = 0; i < kNumTagMapEntries; ++i) {
+        if (found[i]) {
+            Tag tag;
+            tag.mName = kTagMap[i].tag;
+            tag.mValue = values[i];
+            entry->mTags.push(tag);
+        }
+    }
+
+    return OK;
+}
+
+// static
+status_t StagefrightMediaScanner::retrieveTags(const sp<ScanEntry> &entry) {
     sp<MediaMetadataRetriever> mRetriever(new MediaMetadataRetriever);
 
+    const char *path = entry->mPath.string();
     int fd = open(path, O_RDONLY | O_LARGEFILE);
     status_t status;
     if (fd < 0) {
@@ -99,53 +546,25 @@ MediaScanResult StagefrightMediaScanner::processFileInternal(
     }
 
     if (status) {
-        return MEDIA_SCAN_RESULT_ERROR;
+        return status;
     }
 
     const char *value;
     if ((value = mRetriever->extractMetadata(
                     METADATA_KEY_MIMETYPE)) != NULL) {
-        status = client.setMimeType(value);
-        if (status) {
-            return MEDIA_SCAN_RESULT_ERROR;
-        }
+        entry->mMimeType = value;
     }
 
-    struct KeyMap {
-        const char *tag;
-        int key;
-    };
-    static const KeyMap kKeyMap[] = {
-        { "tracknumber", METADATA_KEY_CD_TRACK_NUMBER },
-        { "discnumber", METADATA_KEY_DISC_NUMBER },
-        { "album", METADATA_KEY_ALBUM },
-        { "artist", METADATA_KEY_ARTIST },
-        { "albumartist", METADATA_KEY_ALBUMARTIST },
-        { "composer", METADATA_KEY_COMPOSER },
-        { "genre", METADATA_KEY_GENRE },
-        { "title", METADATA_KEY_TITLE },
-        { "year", METADATA_KEY_YEAR },
-        { "date", METADATA_KEY_DATE },
-        { "duration", METADATA_KEY_DURATION },
-        { "writer", METADATA_KEY_WRITER },
-        { "compilation", METADATA_KEY_COMPILATION },
-        { "isdrm", METADATA_KEY_IS_DRM },
-        { "width", METADATA_KEY_VIDEO_WIDTH },
-        { "height", METADATA_KEY_VIDEO_HEIGHT },
-    };
-    static const size_t kNumEntries = sizeof(kKeyMap) / sizeof(kKeyMap[0]);
-
-    for (size_t i = 0; i < kNumEntries; ++i) {
-        const char *value;
-        if ((value = mRetriever->extractMetadata(kKeyMap[i].key)) != NULL) {
-            status = client.addStringTag(kKeyMap[i].tag, value);
-            if (status != OK) {
-                return MEDIA_SCAN_RESULT_ERROR;
-            }
+    for (size_t i = 0; i < kNumTagMapEntries; ++i) {
+        if ((value = mRetriever->extractMetadata(kTagMap[i].key)) != NULL) {
+            Tag tag;
+            tag.mName = kTagMap[i].tag;
+            tag.mValue = value;
+            entry->mTags.push(tag);
         }
     }
 
-    return MEDIA_SCAN_RESULT_OK;
+    return OK;
 }
 
 MediaAlbumArt *StagefrightMediaScanner::extractAlbumArt(int fd) {
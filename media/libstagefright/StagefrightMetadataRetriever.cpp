@@ -55,7 +55,8 @@ static const int64_t kBufferTimeOutUs = 30000ll; // 30 msec
 static const size_t kRetryCount = 20; // must be >0
 
 StagefrightMetadataRetriever::StagefrightMetadataRetriever()
-    : mParsedMetaData(false),
+    : mMetaDataOnly(false),
+      mParsedMetaData(false),
       mAlbumArt(NULL) {
     ALOGV("StagefrightMetadataRetriever()");
 
@@ -89,7 +90,8 @@ status_t StagefrightMetadataRetriever::setDataSource(
         return UNKNOWN_ERROR;
     }
 
-    mExtractor = MediaExtractor::Create(mSource);
+    mExtractor = MediaExtractor::Create(mSource, NULL, MediaExtractor::kMetaDataOnly);
+    mMetaDataOnly = true;
 
     if (mExtractor == NULL) {
         ALOGE("Unable to instantiate an extractor for '%s'.", uri);
@@ -120,7 +122,8 @@ status_t StagefrightMetadataRetriever::setDataSource(
         return err;
     }
 
-    mExtractor = MediaExtractor::Create(mSource);
+    mExtractor = MediaExtractor::Create(mSource, NULL, MediaExtractor::kMetaDataOnly);
+    mMetaDataOnly = true;
 
     if (mExtractor == NULL) {
         mSource.clear();
@@ -137,7 +140,8 @@ status_t StagefrightMetadataRetriever::setDataSource(
 
     clearMetadata();
     mSource = source;
-    mExtractor = MediaExtractor::Create(mSource);
+    mExtractor = MediaExtractor::Create(mSource, NULL, MediaExtractor::kMetaDataOnly);
+    mMetaDataOnly = true;
 
     if (mExtractor == NULL) {
         ALOGE("Failed to instantiate a MediaExtractor.");
@@ -148,12 +152,100 @@ status_t StagefrightMetadataRetriever::setDataSource(
     return OK;
 }
 
+// Averages factor x factor blocks of an 8-bit plane. The steps are the distances
+// between horizontally adjacent samples, so that interleaved chroma can be scaled
+// one component at a time.
+static void downscalePlane(
+        const uint8_t *src, size_t srcStride, size_t srcStep,
+        uint8_t *dst, size_t dstStride, size_t dstStep,
+        size_t dstWidth, size_t dstHeight, size_t factor) {
+    const uint32_t area = factor * factor;
+    for (size_t y = 0; y < dstHeight; ++y) {
+        const uint8_t *srcRow = src + y * factor * srcStride;
+        uint8_t *dstRow = dst + y * dstStride;
+        for (size_t x = 0; x < dstWidth; ++x) {
+            const uint8_t *block = srcRow + x * factor * srcStep;
+            uint32_t sum = 0;
+            for (size_t j = 0; j < factor; ++j) {
+                for (size_t i = 0; i < factor; ++i) {
+                    sum += block[j * srcStride + i * srcStep];
+                }
+            }
+            dstRow[x * dstStep] = (sum + area / 2) / area;
+        }
+    }
+}
+
+// Box filters the cropped region of a decoded 4:2:0 frame down by an integer factor
+// into a tightly packed frame of the same color format, of *width x *height pixels,
+// so that only the pixels of the thumbnail need to be color converted.
+// Returns NULL if the color format is not one of the 4:2:0 layouts this handles.
+static uint8_t *downscaleYUV420(
+        int32_t srcFormat, const uint8_t *src, int32_t stride, int32_t sliceHeight,
+        int32_t cropLeft, int32_t cropTop, size_t factor,
+        int32_t *width, int32_t *height) {
+    bool planar;
+    switch (srcFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+            planar = true;
+            break;
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+            planar = false;
+            break;
+        default:
+            return NULL;
+    }
+
+    // keep the chroma subsampling intact
+    const size_t dstWidth = (*width / factor) & ~1;
+    const size_t dstHeight = (*height / factor) & ~1;
+    if (dstWidth == 0 || dstHeight == 0) {
+        return NULL;
+    }
+
+    uint8_t *dst = new uint8_t[dstWidth * dstHeight * 3 / 2];
+
+    downscalePlane(
+            src + cropTop * stride + cropLeft, stride, 1,
+            dst, dstWidth, 1,
+            dstWidth, dstHeight, factor);
+
+    const uint8_t *srcChroma = src + stride * sliceHeight;
+    uint8_t *dstChroma = dst + dstWidth * dstHeight;
+    if (planar) {
+        const size_t chromaStride = stride / 2;
+        const size_t chromaSize = chromaStride * (sliceHeight / 2);
+        const size_t chromaOffset = (cropTop / 2) * chromaStride + cropLeft / 2;
+        for (size_t plane = 0; plane < 2; ++plane) {
+            downscalePlane(
+                    srcChroma + plane * chromaSize + chromaOffset, chromaStride, 1,
+                    dstChroma + plane * (dstWidth / 2) * (dstHeight / 2), dstWidth / 2, 1,
+                    dstWidth / 2, dstHeight / 2, factor);
+        }
+    } else {
+        const size_t chromaOffset = (cropTop / 2) * stride + (cropLeft & ~1);
+        for (size_t component = 0; component < 2; ++component) {
+            downscalePlane(
+                    srcChroma + chromaOffset + component, stride, 2,
+                    dstChroma + component, dstWidth, 2,
+                    dstWidth / 2, dstHeight / 2, factor);
+        }
+    }
+
+    *width = dstWidth;
+    *height = dstHeight;
+    return dst;
+}
+
 static VideoFrame *extractVideoFrame(
         const char *componentName,
         const sp<MetaData> &trackMeta,
         const sp<MediaSource> &source,
         int64_t frameTimeUs,
-        int seekMode) {
+        int seekMode,
+        int32_t maxWidth,
+        int32_t maxHeight) {
 
     sp<MetaData> format = source->getFormat();
 
@@ -383,9 +475,47 @@ static VideoFrame *extractVideoFrame(
         rotationAngle = 0;  // By default, no rotation
     }
 
+    int32_t srcFormat;
+    CHECK(outputFormat->findInt32("color-format", &srcFormat));
+
+    const uint8_t *srcData = (const uint8_t *)videoFrameBuffer->data();
+    int32_t frameWidth = crop_right - crop_left + 1;
+    int32_t frameHeight = crop_bottom - crop_top + 1;
+
+    // The requested size is in display orientation.
+    if (rotationAngle == 90 || rotationAngle == 270) {
+        int32_t tmp = maxWidth;
+        maxWidth = maxHeight;
+        maxHeight = tmp;
+    }
+
+    // Scale down by the largest integer factor that keeps the frame at least as large
+    // as requested, the caller does any final fractional scaling.
+    uint8_t *scaledData = NULL;
+    if (maxWidth > 0 && maxHeight > 0) {
+        size_t factor = frameWidth / maxWidth;
+        if (frameHeight / maxHeight < (int32_t)factor) {
+            factor = frameHeight / maxHeight;
+        }
+        if (factor >= 2) {
+            scaledData = downscaleYUV420(
+                    srcFormat, srcData, stride, slice_height, crop_left, crop_top, factor,
+                    &frameWidth, &frameHeight);
+        }
+        if (scaledData != NULL) {
+            ALOGV("downscaled thumbnail by %zu to %dx%d", factor, frameWidth, frameHeight);
+            srcData = scaledData;
+            stride = frameWidth;
+            slice_height = frameHeight;
+            crop_left = crop_top = 0;
+            crop_right = frameWidth - 1;
+            crop_bottom = frameHeight - 1;
+        }
+    }
+
     VideoFrame *frame = new VideoFrame;
-    frame->mWidth = crop_right - crop_left + 1;
-    frame->mHeight = crop_bottom - crop_top + 1;
+    frame->mWidth = frameWidth;
+    frame->mHeight = frameHeight;
     frame->mDisplayWidth = frame->mWidth;
     frame->mDisplayHeight = frame->mHeight;
     frame->mSize = frame->mWidth * frame->mHeight * 2;
@@ -399,14 +529,11 @@ static VideoFrame *extractVideoFrame(
         frame->mDisplayWidth = (frame->mDisplayWidth * sarWidth) / sarHeight;
     }
 
-    int32_t srcFormat;
-    CHECK(outputFormat->findInt32("color-format", &srcFormat));
-
     ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, OMX_COLOR_Format16bitRGB565);
 
     if (converter.isValid()) {
         err = converter.convert(
-                (const uint8_t *)videoFrameBuffer->data(),
+                srcData,
                 stride, slice_height,
                 crop_left, crop_top, crop_right, crop_bottom,
                 frame->mData,
@@ -419,6 +546,7 @@ static VideoFrame *extractVideoFrame(
         err = ERROR_UNSUPPORTED;
     }
 
+    delete[] scaledData;
     videoFrameBuffer.clear();
     source->stop();
     decoder->releaseOutputBuffer(index);
@@ -437,14 +565,32 @@ static VideoFrame *extractVideoFrame(
 
 VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
         int64_t timeUs, int option) {
+    return getScaledFrameAtTime(timeUs, option, 0, 0);
+}
 
-    ALOGV("getFrameAtTime: %" PRId64 " us option: %d", timeUs, option);
+VideoFrame *StagefrightMetadataRetriever::getScaledFrameAtTime(
+        int64_t timeUs, int option, int32_t maxWidth, int32_t maxHeight) {
+
+    ALOGV("getScaledFrameAtTime: %" PRId64 " us option: %d max %dx%d",
+            timeUs, option, maxWidth, maxHeight);
 
     if (mExtractor.get() == NULL) {
         ALOGV("no extractor.");
         return NULL;
     }
 
+    if (mMetaDataOnly) {
+        // Most clients only ask for metadata, so the extractor starts out
+        // without sample tables. Decoding a frame needs a complete one.
+        sp<MediaExtractor> extractor = MediaExtractor::Create(mSource);
+        if (extractor == NULL) {
+            ALOGV("unable to instantiate an extractor for frame extraction.");
+            return NULL;
+        }
+        mExtractor = extractor;
+        mMetaDataOnly = false;
+    }
+
     sp<MetaData> fileMeta = mExtractor->getMetaData();
 
     if (fileMeta == NULL) {
@@ -520,7 +666,8 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
         }
 
         VideoFrame *frame =
-            extractVideoFrame(componentName, trackMeta, source, timeUs, option);
+            extractVideoFrame(componentName, trackMeta, source, timeUs, option,
+                    maxWidth, maxHeight);
 
         if (frame != NULL) {
             return frame;
@@ -42,7 +42,8 @@ namespace android {
 static int64_t kWakelockMinDelay = 100000ll;  // 100ms
 
 TimedEventQueue::TimedEventQueue()
-    : mNextEventID(1),
+    : mNextSeq(0),
+      mNextEventID(1),
       mRunning(false),
       mStopped(false),
       mDeathRecipient(new PMDeathRecipient(this)),
@@ -109,36 +110,41 @@ TimedEventQueue::event_id TimedEventQueue::postEventToBack(
 }
 
 TimedEventQueue::event_id TimedEventQueue::postEventWithDelay(
-        const sp<Event> &event, int64_t delay_us) {
+        const sp<Event> &event, int64_t delay_us, int64_t tolerance_us) {
     CHECK(delay_us >= 0);
-    return postTimedEvent(event, ALooper::GetNowUs() + delay_us);
+    return postTimedEvent(event, ALooper::GetNowUs() + delay_us, tolerance_us);
 }
 
 TimedEventQueue::event_id TimedEventQueue::postTimedEvent(
-        const sp<Event> &event, int64_t realtime_us) {
+        const sp<Event> &event, int64_t realtime_us, int64_t tolerance_us) {
     Mutex::Autolock autoLock(mLock);
 
     event->setEventID(mNextEventID++);
 
-    List<QueueItem>::iterator it = mQueue.begin();
-    while (it != mQueue.end() && realtime_us >= (*it).realtime_us) {
-        ++it;
-    }
-
     QueueItem item;
     item.event = event;
     item.realtime_us = realtime_us;
+    item.deadline_us = realtime_us;
+    item.seq = mNextSeq++;
     item.has_wakelock = false;
 
-    if (it == mQueue.begin()) {
-        mQueueHeadChangedCondition.signal();
+    // The front and back of the queue are not real times.
+    if (tolerance_us > 0 && realtime_us >= 0 && realtime_us < INT64_MAX) {
+        item.deadline_us = realtime_us < INT64_MAX - 1 - tolerance_us
+                ? realtime_us + tolerance_us : INT64_MAX - 1;
     }
 
     if (realtime_us > ALooper::GetNowUs() + kWakelockMinDelay) {
         acquireWakeLock_l();
         item.has_wakelock = true;
     }
-    mQueue.insert(it, item);
+
+    mQueue.push(item);
+    siftUp_l(mQueue.size() - 1);
+
+    if (mQueue[0].seq == item.seq) {
+        mQueueHeadChangedCondition.signal();
+    }
 
     mQueueNotEmptyCondition.signal();
 
@@ -178,28 +184,48 @@ void TimedEventQueue::cancelEvents(
         bool stopAfterFirstMatch) {
     Mutex::Autolock autoLock(mLock);
 
-    List<QueueItem>::iterator it = mQueue.begin();
-    while (it != mQueue.end()) {
-        if (!(*predicate)(cookie, (*it).event)) {
-            ++it;
+    // Compacts the items that stay, the heap is rebuilt afterwards if any
+    // item was cancelled.
+    size_t kept = 0;
+    for (size_t i = 0; i < mQueue.size(); ++i) {
+        const QueueItem &item = mQueue[i];
+        if (!(*predicate)(cookie, item.event)) {
+            if (kept != i) {
+                mQueue.editItemAt(kept) = item;
+            }
+            ++kept;
             continue;
         }
 
-        if (it == mQueue.begin()) {
-            mQueueHeadChangedCondition.signal();
-        }
-
-        ALOGV("cancelling event %d", (*it).event->eventID());
+        ALOGV("cancelling event %d", item.event->eventID());
 
-        (*it).event->setEventID(0);
-        if ((*it).has_wakelock) {
+        item.event->setEventID(0);
+        if (item.has_wakelock) {
             releaseWakeLock_l();
         }
-        it = mQueue.erase(it);
+
         if (stopAfterFirstMatch) {
-            return;
+            // Only this item goes, its slot can be refilled in place.
+            for (size_t j = i + 1; j < mQueue.size(); ++j) {
+                if (kept != j) {
+                    mQueue.editItemAt(kept) = mQueue[j];
+                }
+                ++kept;
+            }
+            break;
         }
     }
+
+    if (kept == mQueue.size()) {
+        return;
+    }
+
+    mQueue.removeItemsAt(kept, mQueue.size() - kept);
+    for (size_t i = mQueue.size() / 2; i-- > 0;) {
+        siftDown_l(i);
+    }
+
+    mQueueHeadChangedCondition.signal();
 }
 
 // static
@@ -239,23 +265,20 @@ void TimedEventQueue::threadEntry() {
                     break;
                 }
 
-                List<QueueItem>::iterator it = mQueue.begin();
-                eventID = (*it).event->eventID();
-
                 now_us = ALooper::GetNowUs();
-                int64_t when_us = (*it).realtime_us;
-
-                int64_t delay_us;
-                if (when_us < 0 || when_us == INT64_MAX) {
-                    delay_us = 0;
-                } else {
-                    delay_us = when_us - now_us;
-                }
 
-                if (delay_us <= 0) {
+                ssize_t index = findDueItem_l(now_us);
+                if (index >= 0) {
+                    eventID = mQueue[index].event->eventID();
                     break;
                 }
 
+                // Nothing is due yet, sleep until the head's deadline. Items
+                // with a tolerance that become due meanwhile fire on the same
+                // wakeup, see findDueItem_l().
+                eventID = mQueue[0].event->eventID();
+                int64_t delay_us = mQueue[0].deadline_us - now_us;
+
                 static int64_t kMaxTimeoutUs = 10000000ll;  // 10 secs
                 bool timeoutCapped = false;
                 if (delay_us > kMaxTimeoutUs) {
@@ -273,8 +296,7 @@ void TimedEventQueue::threadEntry() {
                         mLock, delay_us * 1000ll);
 
                 if (!timeoutCapped && err == -ETIMEDOUT) {
-                    // We finally hit the time this event is supposed to
-                    // trigger.
+                    // We finally hit the deadline of the head of the queue.
                     now_us = ALooper::GetNowUs();
                     break;
                 }
@@ -301,13 +323,12 @@ void TimedEventQueue::threadEntry() {
 
 sp<TimedEventQueue::Event> TimedEventQueue::removeEventFromQueue_l(
         event_id id, bool *wakeLocked) {
-    for (List<QueueItem>::iterator it = mQueue.begin();
-         it != mQueue.end(); ++it) {
-        if ((*it).event->eventID() == id) {
-            sp<Event> event = (*it).event;
+    for (size_t i = 0; i < mQueue.size(); ++i) {
+        if (mQueue[i].event->eventID() == id) {
+            sp<Event> event = mQueue[i].event;
             event->setEventID(0);
-            *wakeLocked = (*it).has_wakelock;
-            mQueue.erase(it);
+            *wakeLocked = mQueue[i].has_wakelock;
+            removeItemAt_l(i);
             return event;
         }
     }
@@ -317,6 +338,81 @@ sp<TimedEventQueue::Event> TimedEventQueue::removeEventFromQueue_l(
     return NULL;
 }
 
+// Returns the index of the item to fire at now_us, or -1 if nothing is due.
+// That is the head once its time has come, otherwise the earliest deadline
+// among the items whose time has come but whose tolerance has not run out,
+// so that these fire while the thread is awake anyway.
+ssize_t TimedEventQueue::findDueItem_l(int64_t now_us) const {
+    const int64_t when_us = mQueue[0].realtime_us;
+    if (when_us < 0 || when_us == INT64_MAX || when_us <= now_us) {
+        return 0;
+    }
+
+    ssize_t due = -1;
+    for (size_t i = 1; i < mQueue.size(); ++i) {
+        const QueueItem &item = mQueue[i];
+        if (item.realtime_us < 0 || item.realtime_us == INT64_MAX
+                || item.realtime_us > now_us) {
+            continue;
+        }
+        if (due < 0 || item < mQueue[due]) {
+            due = i;
+        }
+    }
+    return due;
+}
+
+void TimedEventQueue::removeItemAt_l(size_t index) {
+    const size_t last = mQueue.size() - 1;
+    if (index == 0) {
+        mQueueHeadChangedCondition.signal();
+    }
+    if (index != last) {
+        mQueue.editItemAt(index) = mQueue[last];
+    }
+    mQueue.removeAt(last);
+    if (index < mQueue.size()) {
+        if (index > 0 && mQueue[index] < mQueue[(index - 1) / 2]) {
+            siftUp_l(index);
+        } else {
+            siftDown_l(index);
+        }
+    }
+}
+
+void TimedEventQueue::siftUp_l(size_t index) {
+    QueueItem item = mQueue[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!(item < mQueue[parent])) {
+            break;
+        }
+        mQueue.editItemAt(index) = mQueue[parent];
+        index = parent;
+    }
+    mQueue.editItemAt(index) = item;
+}
+
+void TimedEventQueue::siftDown_l(size_t index) {
+    const size_t size = mQueue.size();
+    QueueItem item = mQueue[index];
+    for (;;) {
+        size_t child = 2 * index + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && mQueue[child + 1] < mQueue[child]) {
+            ++child;
+        }
+        if (!(mQueue[child] < item)) {
+            break;
+        }
+        mQueue.editItemAt(index) = mQueue[child];
+        index = child;
+    }
+    mQueue.editItemAt(index) = item;
+}
+
 void TimedEventQueue::acquireWakeLock_l()
 {
     if (mWakeLockCount == 0) {
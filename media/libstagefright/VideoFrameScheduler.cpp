@@ -20,10 +20,12 @@
 #define ATRACE_TAG ATRACE_TAG_VIDEO
 #include <utils/Trace.h>
 
+#include <math.h>
 #include <sys/time.h>
 
 #include <binder/IServiceManager.h>
 #include <gui/ISurfaceComposer.h>
+#include <ui/DisplayInfo.h>
 #include <ui/DisplayStatInfo.h>
 
 #include <media/stagefright/foundation/ADebug.h>
@@ -325,13 +327,29 @@ nsecs_t VideoFrameScheduler::PLL::getPeriod() const {
 
 static const nsecs_t kDefaultVsyncPeriod = kNanosIn1s / 60;  // 60Hz
 static const nsecs_t kVsyncRefreshPeriod = kNanosIn1s;       // 1 sec
+static const float kCadenceTolerance = 0.05f;                // of a vsync period
+static const float kRefreshRateTolerance = 0.002f;           // 0.2%
+
+VideoFrameScheduler::PacingStats::PacingStats()
+    : mFrameRate(0.f),
+      mRefreshRate(0.f),
+      mPreferredRefreshRate(0.f),
+      mNumFrames(0),
+      mNumJudderFrames(0) {
+    mCadence[0] = mCadence[1] = 0;
+}
 
 VideoFrameScheduler::VideoFrameScheduler()
     : mVsyncTime(0),
       mVsyncPeriod(0),
       mVsyncRefreshAt(0),
       mLastVsyncTime(-1),
-      mTimeCorrection(0) {
+      mTimeCorrection(0),
+      mRefreshRatesQueried(false),
+      mLastVsyncsPerFrame(0),
+      mNumFrames(0),
+      mNumJudderFrames(0) {
+    mCadence[0] = mCadence[1] = 0;
 }
 
 void VideoFrameScheduler::updateVsync() {
@@ -357,23 +375,122 @@ void VideoFrameScheduler::updateVsync() {
         } else {
             ALOGW("getDisplayStats returned %d", res);
         }
+        if (!mRefreshRatesQueried) {
+            updateRefreshRates();
+        }
     } else {
         ALOGW("could not get surface mComposer service");
     }
 }
 
+void VideoFrameScheduler::updateRefreshRates() {
+    mRefreshRatesQueried = true;
+    mRefreshRates.clear();
+
+    sp<IBinder> display = mComposer->getBuiltInDisplay(ISurfaceComposer::eDisplayIdMain);
+    Vector<DisplayInfo> configs;
+    if (display == NULL || mComposer->getDisplayConfigs(display, &configs) != OK) {
+        ALOGW("could not get display configs");
+        return;
+    }
+    for (size_t i = 0; i < configs.size(); ++i) {
+        float fps = configs[i].fps;
+        bool found = fps <= 0.f;
+        for (size_t j = 0; !found && j < mRefreshRates.size(); ++j) {
+            found = mRefreshRates[j] == fps;
+        }
+        if (!found) {
+            mRefreshRates.push(fps);
+        }
+    }
+}
+
+// Tracks how many vsyncs each frame stays on screen.  A frame rate that is a
+// whole multiple of the refresh rate shows every frame for the same number of
+// vsyncs; one that is half way between (24 fps on 60Hz) alternates between two
+// counts, i.e. 3:2 pulldown.  Anything else has no stable cadence, and only
+// frames that stay for more or less than the two nearest counts are judder.
+void VideoFrameScheduler::updateCadence(nsecs_t videoPeriod, size_t vsyncsForLastFrame) {
+    const float ratio = videoPeriod / (float)mVsyncPeriod;
+    const uint32_t whole = (uint32_t)ratio;
+    const float fraction = ratio - whole;
+
+    if (fraction < kCadenceTolerance || fraction > 1.f - kCadenceTolerance) {
+        mCadence[0] = mCadence[1] = (uint32_t)(ratio + 0.5f);
+    } else if (fraction > 0.5f - kCadenceTolerance && fraction < 0.5f + kCadenceTolerance) {
+        mCadence[0] = whole + 1;
+        mCadence[1] = whole;
+    } else {
+        mCadence[0] = mCadence[1] = 0;
+    }
+
+    bool judder;
+    if (mCadence[0] == 0) {
+        judder = vsyncsForLastFrame < whole || vsyncsForLastFrame > whole + 1;
+    } else if (mCadence[0] == mCadence[1]) {
+        judder = vsyncsForLastFrame != mCadence[0];
+    } else {
+        judder = (vsyncsForLastFrame != mCadence[0] && vsyncsForLastFrame != mCadence[1])
+                || vsyncsForLastFrame == mLastVsyncsPerFrame;
+    }
+
+    ++mNumFrames;
+    if (judder && mLastVsyncsPerFrame > 0) {
+        ++mNumJudderFrames;
+        ATRACE_INT("FRAME_JUDDER", (int32_t)mNumJudderFrames);
+    }
+    mLastVsyncsPerFrame = vsyncsForLastFrame;
+}
+
+void VideoFrameScheduler::getPacingStats(PacingStats *stats) const {
+    const nsecs_t videoPeriod = mPll.getPeriod();
+    stats->mFrameRate = videoPeriod > 0 ? 1e9 / videoPeriod : 0.f;
+    stats->mRefreshRate = mVsyncPeriod > 0 ? 1e9 / mVsyncPeriod : 0.f;
+    stats->mCadence[0] = mCadence[0];
+    stats->mCadence[1] = mCadence[1];
+    stats->mNumFrames = mNumFrames;
+    stats->mNumJudderFrames = mNumJudderFrames;
+
+    // Prefer the current mode if it already matches, so that a display mode
+    // switch is only suggested when it would remove judder.
+    stats->mPreferredRefreshRate = 0.f;
+    if (stats->mFrameRate <= 0.f) {
+        return;
+    }
+    for (size_t i = 0; i < mRefreshRates.size(); ++i) {
+        const float rate = mRefreshRates[i];
+        const float multiple = (int32_t)(rate / stats->mFrameRate + 0.5f) * stats->mFrameRate;
+        if (multiple <= 0.f || fabsf(rate - multiple) > rate * kRefreshRateTolerance) {
+            continue;
+        }
+        if (fabsf(rate - stats->mRefreshRate) <= rate * kRefreshRateTolerance) {
+            stats->mPreferredRefreshRate = rate;
+            return;
+        }
+        if (rate > stats->mPreferredRefreshRate) {
+            stats->mPreferredRefreshRate = rate;
+        }
+    }
+}
+
 void VideoFrameScheduler::init(float videoFps) {
     updateVsync();
 
     mLastVsyncTime = -1;
     mTimeCorrection = 0;
 
+    mCadence[0] = mCadence[1] = 0;
+    mLastVsyncsPerFrame = 0;
+    mNumFrames = 0;
+    mNumJudderFrames = 0;
+
     mPll.reset(videoFps);
 }
 
 void VideoFrameScheduler::restart() {
     mLastVsyncTime = -1;
     mTimeCorrection = 0;
+    mLastVsyncsPerFrame = 0;
 
     mPll.restart();
 }
@@ -471,6 +588,7 @@ nsecs_t VideoFrameScheduler::schedule(nsecs_t renderTime) {
                     ++vsyncsForLastFrame;
             }
             ATRACE_INT("FRAME_VSYNCS", vsyncsForLastFrame);
+            updateCadence(videoPeriod, vsyncsForLastFrame);
         }
         mLastVsyncTime = nextVsyncTime;
     }
@@ -28,6 +28,7 @@
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
 #include <utils/String8.h>
+#include <audio_utils/primitives.h>
 #include <cutils/bitops.h>
 #include <system/audio.h>
 
@@ -37,6 +38,7 @@ namespace android {
 
 enum {
     WAVE_FORMAT_PCM        = 0x0001,
+    WAVE_FORMAT_IEEE_FLOAT = 0x0003,
     WAVE_FORMAT_ALAW       = 0x0006,
     WAVE_FORMAT_MULAW      = 0x0007,
     WAVE_FORMAT_MSGSM      = 0x0031,
@@ -74,6 +76,7 @@ protected:
 
 private:
     static const size_t kMaxFrameSize;
+    static const size_t kMaxBufferSize;
 
     sp<DataSource> mDataSource;
     sp<MetaData> mMeta;
@@ -87,6 +90,17 @@ private:
     MediaBufferGroup *mGroup;
     off64_t mCurrentPos;
 
+    // AUDIO_FORMAT_INVALID unless linear PCM. The samples are converted in
+    // place in the buffer they are read into, and only if the formats differ.
+    audio_format_t mInputFormat;
+    audio_format_t mOutputFormat;
+    size_t mBufferSize;
+
+    static audio_format_t GetDefaultOutputFormat(audio_format_t inputFormat);
+    static void ConvertInPlace(
+            void *data, audio_format_t outputFormat, audio_format_t inputFormat,
+            size_t numSamples);
+
     WAVSource(const WAVSource &);
     WAVSource &operator=(const WAVSource &);
 };
@@ -178,6 +192,7 @@ status_t WAVExtractor::init() {
 
             mWaveFormat = U16_LE_AT(formatSpec);
             if (mWaveFormat != WAVE_FORMAT_PCM
+                    && mWaveFormat != WAVE_FORMAT_IEEE_FLOAT
                     && mWaveFormat != WAVE_FORMAT_ALAW
                     && mWaveFormat != WAVE_FORMAT_MULAW
                     && mWaveFormat != WAVE_FORMAT_MSGSM
@@ -218,7 +233,11 @@ status_t WAVExtractor::init() {
             if (mWaveFormat == WAVE_FORMAT_PCM
                     || mWaveFormat == WAVE_FORMAT_EXTENSIBLE) {
                 if (mBitsPerSample != 8 && mBitsPerSample != 16
-                    && mBitsPerSample != 24) {
+                    && mBitsPerSample != 24 && mBitsPerSample != 32) {
+                    return ERROR_UNSUPPORTED;
+                }
+            } else if (mWaveFormat == WAVE_FORMAT_IEEE_FLOAT) {
+                if (mBitsPerSample != 32) {
                     return ERROR_UNSUPPORTED;
                 }
             } else if (mWaveFormat == WAVE_FORMAT_MSGSM) {
@@ -265,6 +284,7 @@ status_t WAVExtractor::init() {
                 // the sample format, using the same definitions as a regular WAV header
                 mWaveFormat = U16_LE_AT(&formatSpec[24]);
                 if (mWaveFormat != WAVE_FORMAT_PCM
+                        && !(mWaveFormat == WAVE_FORMAT_IEEE_FLOAT && mBitsPerSample == 32)
                         && mWaveFormat != WAVE_FORMAT_ALAW
                         && mWaveFormat != WAVE_FORMAT_MULAW) {
                     return ERROR_UNSUPPORTED;
@@ -285,6 +305,9 @@ status_t WAVExtractor::init() {
 
                 switch (mWaveFormat) {
                     case WAVE_FORMAT_PCM:
+                    case WAVE_FORMAT_IEEE_FLOAT:
+                        // 32 bit integer samples are delivered as float,
+                        // which is what 32 bits per sample means downstream.
                         mTrackMeta->setCString(
                                 kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_RAW);
                         mTrackMeta->setInt32(kKeyBitsPerSample, mBitsPerSample);
@@ -341,6 +364,7 @@ status_t WAVExtractor::init() {
 }
 
 const size_t WAVSource::kMaxFrameSize = 32768;
+const size_t WAVSource::kMaxBufferSize = 1024 * 1024;
 
 WAVSource::WAVSource(
         const sp<DataSource> &dataSource,
@@ -357,33 +381,122 @@ WAVSource::WAVSource(
       mOffset(offset),
       mSize(size),
       mStarted(false),
-      mGroup(NULL) {
+      mGroup(NULL),
+      mInputFormat(AUDIO_FORMAT_INVALID),
+      mOutputFormat(AUDIO_FORMAT_INVALID),
+      mBufferSize(kMaxFrameSize) {
     CHECK(mMeta->findInt32(kKeySampleRate, &mSampleRate));
     CHECK(mMeta->findInt32(kKeyChannelCount, &mNumChannels));
 
+    if (mWaveFormat == WAVE_FORMAT_PCM) {
+        switch (mBitsPerSample) {
+            case 8:  mInputFormat = AUDIO_FORMAT_PCM_8_BIT; break;
+            case 16: mInputFormat = AUDIO_FORMAT_PCM_16_BIT; break;
+            case 24: mInputFormat = AUDIO_FORMAT_PCM_24_BIT_PACKED; break;
+            default: mInputFormat = AUDIO_FORMAT_PCM_32_BIT; break;
+        }
+    } else if (mWaveFormat == WAVE_FORMAT_IEEE_FLOAT) {
+        mInputFormat = AUDIO_FORMAT_PCM_FLOAT;
+    }
+
     mMeta->setInt32(kKeyMaxInputSize, kMaxFrameSize);
 }
 
+// What the raw decoder expects for each bits per sample.
+// static
+audio_format_t WAVSource::GetDefaultOutputFormat(audio_format_t inputFormat) {
+    switch (inputFormat) {
+        case AUDIO_FORMAT_PCM_8_BIT:
+            return AUDIO_FORMAT_PCM_16_BIT;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+            // left justified in 32 bits
+            return AUDIO_FORMAT_PCM_32_BIT;
+        case AUDIO_FORMAT_PCM_32_BIT:
+            return AUDIO_FORMAT_PCM_FLOAT;
+        default:
+            return inputFormat;
+    }
+}
+
+// The output samples are never narrower than the input ones, so the
+// conversions run from the end of the buffer.
+// static
+void WAVSource::ConvertInPlace(
+        void *data, audio_format_t outputFormat, audio_format_t inputFormat,
+        size_t numSamples) {
+    if (outputFormat == inputFormat) {
+        return;
+    }
+
+    if (inputFormat == AUDIO_FORMAT_PCM_8_BIT) {
+        memcpy_to_i16_from_u8((int16_t *)data, (const uint8_t *)data, numSamples);
+        inputFormat = AUDIO_FORMAT_PCM_16_BIT;
+    }
+
+    if (outputFormat == AUDIO_FORMAT_PCM_FLOAT) {
+        switch (inputFormat) {
+            case AUDIO_FORMAT_PCM_16_BIT:
+                memcpy_to_float_from_i16((float *)data, (const int16_t *)data, numSamples);
+                break;
+            case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+                memcpy_to_float_from_p24((float *)data, (const uint8_t *)data, numSamples);
+                break;
+            case AUDIO_FORMAT_PCM_32_BIT:
+                memcpy_to_float_from_i32((float *)data, (const int32_t *)data, numSamples);
+                break;
+            default:
+                break;
+        }
+    } else if (outputFormat == AUDIO_FORMAT_PCM_32_BIT
+            && inputFormat == AUDIO_FORMAT_PCM_24_BIT_PACKED) {
+        const uint8_t *src = (const uint8_t *)data;
+        int32_t *dst = (int32_t *)data;
+        for (size_t i = numSamples; i-- > 0; ) {
+            dst[i] = (uint32_t)src[3 * i] << 8
+                    | (uint32_t)src[3 * i + 1] << 16
+                    | (uint32_t)src[3 * i + 2] << 24;
+        }
+    }
+}
+
 WAVSource::~WAVSource() {
     if (mStarted) {
         stop();
     }
 }
 
-status_t WAVSource::start(MetaData * /* params */) {
+status_t WAVSource::start(MetaData *params) {
 
     if (mStarted) {
         return OK;
     }
 
-    mGroup = new MediaBufferGroup;
-    mGroup->add_buffer(new MediaBuffer(kMaxFrameSize));
+    // A consumer that handles them may ask, with kKeyPCMFormat, for the samples
+    // as stored (bit perfect) or as float, and with kKeyMaxInputSize for reads
+    // as large as its input buffers.
+    mOutputFormat = GetDefaultOutputFormat(mInputFormat);
+    mBufferSize = kMaxFrameSize;
+
+    int32_t value;
+    if (params != NULL && mInputFormat != AUDIO_FORMAT_INVALID
+            && params->findInt32(kKeyPCMFormat, &value)) {
+        audio_format_t format = (audio_format_t)value;
+        if (format == mInputFormat || format == AUDIO_FORMAT_PCM_FLOAT) {
+            mOutputFormat = format;
+        } else {
+            ALOGW("unsupported output format %#x, using %#x", format, mOutputFormat);
+        }
+        mMeta->setInt32(kKeyPCMFormat, mOutputFormat);
+    }
 
-    if (mBitsPerSample == 8 || mBitsPerSample == 24) {
-        // As a temporary buffer for 8->16/24->32 bit conversion.
-        mGroup->add_buffer(new MediaBuffer(kMaxFrameSize));
+    if (params != NULL && params->findInt32(kKeyMaxInputSize, &value)
+            && value > (int32_t)kMaxFrameSize) {
+        mBufferSize = (size_t)value < kMaxBufferSize ? (size_t)value : kMaxBufferSize;
     }
 
+    mGroup = new MediaBufferGroup;
+    mGroup->add_buffer(new MediaBuffer(mBufferSize));
+
     mCurrentPos = mOffset;
 
     mStarted = true;
@@ -439,16 +552,16 @@ status_t WAVSource::read(
         return err;
     }
 
-    // make sure that maxBytesToRead is multiple of 3, in 24-bit case
-    size_t maxBytesToRead;
-    if(8 == mBitsPerSample)
-        maxBytesToRead = kMaxFrameSize / 2;
-    else if (24 == mBitsPerSample) {
-        maxBytesToRead = 3*(kMaxFrameSize/4);
-    } else
-        maxBytesToRead = kMaxFrameSize;
-    ALOGV("%s mBitsPerSample %d, kMaxFrameSize %zu, ",
-          __func__, mBitsPerSample, kMaxFrameSize);
+    // Leave room for the conversion to wider samples.
+    size_t inputSampleSize = 1;
+    size_t outputSampleSize = 1;
+    if (mInputFormat != AUDIO_FORMAT_INVALID) {
+        inputSampleSize = audio_bytes_per_sample(mInputFormat);
+        outputSampleSize = audio_bytes_per_sample(mOutputFormat);
+    }
+    size_t maxBytesToRead = mBufferSize / outputSampleSize * inputSampleSize;
+    ALOGV("%s mBitsPerSample %d, mBufferSize %zu, ",
+          __func__, mBitsPerSample, mBufferSize);
 
     size_t maxBytesAvailable =
         (mCurrentPos - mOffset >= (off64_t)mSize)
@@ -482,50 +595,12 @@ status_t WAVSource::read(
         return ERROR_END_OF_STREAM;
     }
 
-    buffer->set_range(0, n);
-
-    if (mWaveFormat == WAVE_FORMAT_PCM || mWaveFormat == WAVE_FORMAT_EXTENSIBLE) {
-        if (mBitsPerSample == 8) {
-            // Convert 8-bit unsigned samples to 16-bit signed.
-
-            MediaBuffer *tmp;
-            CHECK_EQ(mGroup->acquire_buffer(&tmp), (status_t)OK);
-
-            // The new buffer holds the sample number of samples, but each
-            // one is 2 bytes wide.
-            tmp->set_range(0, 2 * n);
-
-            int16_t *dst = (int16_t *)tmp->data();
-            const uint8_t *src = (const uint8_t *)buffer->data();
-            ssize_t numBytes = n;
-
-            while (numBytes-- > 0) {
-                *dst++ = ((int16_t)(*src) - 128) * 256;
-                ++src;
-            }
-
-            buffer->release();
-            buffer = tmp;
-        } else if (mBitsPerSample == 24) {
-            // Padding done here to convert to 32-bit samples
-            MediaBuffer *tmp;
-            CHECK_EQ(mGroup->acquire_buffer(&tmp), (status_t)OK);
-            ssize_t numBytes = buffer->range_length() / 3;
-            tmp->set_range(0, 4 * numBytes);
-            int8_t *dst = (int8_t *)tmp->data();
-            const uint8_t *src = (const uint8_t *)buffer->data();
-            ALOGV("numBytes = %zd", numBytes);
-            while(numBytes-- > 0) {
-               *dst++ = 0x0;
-               *dst++ = src[0];
-               *dst++ = src[1];
-               *dst++ = src[2];
-               src += 3;
-            }
-            buffer->release();
-            buffer = tmp;
-            ALOGV("length = %zu", buffer->range_length());
-        }
+    if (mInputFormat != AUDIO_FORMAT_INVALID) {
+        size_t numSamples = n / inputSampleSize;
+        ConvertInPlace(buffer->data(), mOutputFormat, mInputFormat, numSamples);
+        buffer->set_range(0, numSamples * outputSampleSize);
+    } else {
+        buffer->set_range(0, n);
     }
 
     int64_t timeStampUs = 0;
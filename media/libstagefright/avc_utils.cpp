@@ -29,23 +29,20 @@
 #include <media/stagefright/MetaData.h>
 #include <utils/misc.h>
 
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace android {
 
 unsigned parseUE(ABitReader *br) {
-    unsigned numZeroes = 0;
-    while (br->getBits(1) == 0) {
-        ++numZeroes;
-    }
-
-    unsigned x = br->getBits(numZeroes);
-
-    return x + (1u << numZeroes) - 1;
+    return br->getUE();
 }
 
 signed parseSE(ABitReader *br) {
-    unsigned codeNum = parseUE(br);
-
-    return (codeNum & 1) ? (codeNum + 1) / 2 : -(codeNum / 2);
+    return br->getSE();
 }
 
 static void skipScalingList(ABitReader *br, size_t sizeOfScalingList) {
@@ -228,6 +225,64 @@ void FindAVCDimensions(
     }
 }
 
+// Returns the index of the first zero byte among the 16 at data, or 16 if none.
+static inline size_t findZeroByte16(const uint8_t *data) {
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+    uint64x2_t zeros = vreinterpretq_u64_u8(vceqq_u8(vld1q_u8(data), vdupq_n_u8(0)));
+    uint64_t lo = vgetq_lane_u64(zeros, 0);
+    if (lo != 0) {
+        return __builtin_ctzll(lo) / 8;
+    }
+    uint64_t hi = vgetq_lane_u64(zeros, 1);
+    return hi != 0 ? 8 + __builtin_ctzll(hi) / 8 : 16;
+#elif defined(__SSE2__)
+    __m128i v = _mm_loadu_si128((const __m128i *)data);
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return mask != 0 ? __builtin_ctz(mask) : 16;
+#else
+    // a byte's high bit is set in t if it is zero, or if a lower byte is
+    static const uint64_t kOnes = 0x0101010101010101ULL;
+    for (size_t i = 0; i < 16; i += 8) {
+        uint64_t x;
+        memcpy(&x, data + i, sizeof(x));
+        uint64_t t = (x - kOnes) & ~x & (kOnes << 7);
+        if (t != 0) {
+            return i + __builtin_ctzll(t) / 8;
+        }
+    }
+    return 16;
+#endif
+}
+
+size_t findStartCodePrefix(const uint8_t *data, size_t size) {
+    size_t offset = 0;
+    while (offset + 2 < size) {
+        // a start code prefix can only begin at a zero byte
+        if (offset + 16 <= size) {
+            size_t zero = findZeroByte16(data + offset);
+            if (zero == 16) {
+                offset += 16;
+                continue;
+            }
+            offset += zero;
+            if (offset + 2 >= size) {
+                break;
+            }
+        }
+
+        if (data[offset] == 0x00 && data[offset + 1] == 0x00) {
+            if (data[offset + 2] == 0x01) {
+                return offset;
+            }
+            // 00 00 00 ... may still become a start code one byte later
+            ++offset;
+        } else {
+            offset += data[offset + 1] == 0x00 ? 1 : 2;
+        }
+    }
+    return size;
+}
+
 status_t getNextNALUnit(
         const uint8_t **_data, size_t *_size,
         const uint8_t **nalStart, size_t *nalSize,
@@ -242,17 +297,10 @@ status_t getNextNALUnit(
         return -EAGAIN;
     }
 
-    size_t offset = 0;
-
     // A valid startcode consists of at least two 0x00 bytes followed by 0x01.
-    for (; offset + 2 < size; ++offset) {
-        if (data[offset + 2] == 0x01 && data[offset] == 0x00
-                && data[offset + 1] == 0x00) {
-            break;
-        }
-    }
-    if (offset + 2 >= size) {
-        *_data = &data[offset];
+    size_t offset = findStartCodePrefix(data, size);
+    if (offset == size) {
+        *_data = &data[size - 2];
         *_size = 2;
         return -EAGAIN;
     }
@@ -260,25 +308,15 @@ status_t getNextNALUnit(
 
     size_t startOffset = offset;
 
-    for (;;) {
-        while (offset < size && data[offset] != 0x01) {
-            ++offset;
-        }
-
-        if (offset == size) {
-            if (startCodeFollows) {
-                offset = size + 2;
-                break;
-            }
-
+    // offset ends up at the 0x01 of the next start code
+    size_t next = findStartCodePrefix(&data[startOffset], size - startOffset);
+    if (next == size - startOffset) {
+        if (!startCodeFollows) {
             return -EAGAIN;
         }
-
-        if (data[offset - 1] == 0x00 && data[offset - 2] == 0x00) {
-            break;
-        }
-
-        ++offset;
+        offset = size + 2;
+    } else {
+        offset = startOffset + next + 2;
     }
 
     size_t endOffset = offset - 2;
@@ -474,6 +512,91 @@ bool IsAVCReferenceFrame(const sp<ABuffer> &accessUnit) {
     return bIsReferenceFrame;
 }
 
+size_t ExtractCEA608FromSEI(const uint8_t *nal, size_t nalSize, const sp<ABuffer> &ccData) {
+    if (nalSize < 1 || (nal[0] & 0x1f) != 6) {
+        return 0;
+    }
+
+    size_t numPairs = 0;
+    NALBitReader br(nal + 1, nalSize - 1);
+    // sei_message()
+    while (br.atLeastNumBitsLeft(16)) {
+        uint32_t payload_type = 0;
+        size_t payload_size = 0;
+        uint8_t last_byte;
+
+        do {
+            last_byte = br.getBits(8);
+            payload_type += last_byte;
+        } while (last_byte == 0xFF && br.atLeastNumBitsLeft(8));
+
+        do {
+            last_byte = br.getBits(8);
+            payload_size += last_byte;
+        } while (last_byte == 0xFF && br.atLeastNumBitsLeft(8));
+
+        if (payload_size > SIZE_MAX / 8
+                || !br.atLeastNumBitsLeft(payload_size * 8)) {
+            ALOGV("Malformed SEI payload");
+            break;
+        }
+
+        if (payload_type == 4 && payload_size > 1 + 2 + 4 + 1) {
+            // user_data_registered_itu_t_t35(), ATSC A/72: 6.4.2
+            uint8_t itu_t_t35_country_code = br.getBits(8);
+            uint16_t itu_t_t35_provider_code = br.getBits(16);
+            uint32_t user_identifier = br.getBits(32);
+            uint8_t user_data_type_code = br.getBits(8);
+            payload_size -= 1 + 2 + 4 + 1;
+
+            if (itu_t_t35_country_code == 0xB5
+                    && itu_t_t35_provider_code == 0x0031
+                    && user_identifier == 'GA94'
+                    && user_data_type_code == 0x3
+                    && payload_size > 2) {
+                // MPEG_cc_data(), ATSC A/53 Part 4: 6.2.3.1
+                br.skipBits(1); // process_em_data_flag
+                bool process_cc_data_flag = br.getBits(1);
+                br.skipBits(1); // additional_data_flag
+                size_t cc_count = br.getBits(5);
+                br.skipBits(8); // em_data
+                payload_size -= 2;
+
+                for (size_t i = 0; process_cc_data_flag && i < cc_count && payload_size >= 3;
+                        ++i) {
+                    uint8_t marker = br.getBits(5);
+                    bool cc_valid = br.getBits(1);
+                    uint8_t cc_type = br.getBits(2);
+                    // remove odd parity bit
+                    uint8_t cc_data_1 = br.getBits(8) & 0x7f;
+                    uint8_t cc_data_2 = br.getBits(8) & 0x7f;
+                    payload_size -= 3;
+
+                    if (marker != 0x1f || !cc_valid || cc_type > 1
+                            || (cc_data_1 < 0x10 && cc_data_2 < 0x10)) {
+                        // malformed, 708 data or null padding
+                        continue;
+                    }
+                    if (ccData->size() + 3 > ccData->capacity()) {
+                        break;
+                    }
+                    uint8_t *dst = ccData->data() + ccData->size();
+                    dst[0] = cc_type;
+                    dst[1] = cc_data_1;
+                    dst[2] = cc_data_2;
+                    ccData->setRange(ccData->offset(), ccData->size() + 3);
+                    ++numPairs;
+                }
+            }
+        }
+
+        // skipping remaining bits of this payload
+        br.skipBits(payload_size * 8);
+    }
+
+    return numPairs;
+}
+
 sp<MetaData> MakeAACCodecSpecificData(
         unsigned profile, unsigned sampling_freq_index,
         unsigned channel_configuration) {
@@ -28,6 +28,7 @@
 #include <media/stagefright/MediaErrors.h>
 
 #include <math.h>
+#include <stdlib.h>
 
 #define FILEREAD_MAX_LAYERS 2
 
@@ -46,6 +47,20 @@
 
 namespace android {
 
+// Number of decoded frames to return per output buffer. Larger values cut the
+// number of buffer round trips through the client during long playback, at the
+// cost of output latency.
+static int32_t GetFramesPerBuffer() {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.audio-batch", value, NULL)) {
+        int frames = atoi(value);
+        if (frames >= 1 && frames <= 16) {
+            return frames;
+        }
+    }
+    return 1;
+}
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -70,7 +85,10 @@ SoftAAC2::SoftAAC2(
       mLastInHeader(NULL),
       mLastHeaderTimeUs(-1),
       mNextOutBufferTimeUs(0),
-      mOutputPortSettingsChange(NONE) {
+      mOutputPortSettingsChange(NONE),
+      mFramesPerBuffer(GetFramesPerBuffer()),
+      mLowPower(false),
+      mFramesUntilPowerModeCheck(0) {
     initPorts();
     CHECK_EQ(initDecoder(), (status_t)OK);
 }
@@ -106,7 +124,7 @@ void SoftAAC2::initPorts() {
     def.eDir = OMX_DirOutput;
     def.nBufferCountMin = kNumOutputBuffers;
     def.nBufferCountActual = def.nBufferCountMin;
-    def.nBufferSize = 4096 * MAX_CHANNEL_COUNT;
+    def.nBufferSize = 4096 * MAX_CHANNEL_COUNT * mFramesPerBuffer;
     def.bEnabled = OMX_TRUE;
     def.bPopulated = OMX_FALSE;
     def.eDomain = OMX_PortDomainAudio;
@@ -134,9 +152,12 @@ status_t SoftAAC2::initDecoder() {
 
     mEndOfInput = false;
     mEndOfOutput = false;
+    mLowPower = false;
+    mFramesUntilPowerModeCheck = 0;
     mOutputDelayCompensated = 0;
-    mOutputDelayRingBufferSize = 2048 * MAX_CHANNEL_COUNT * kNumDelayBlocksMax;
-    mOutputDelayRingBuffer = new short[mOutputDelayRingBufferSize];
+    mOutputDelayRingBufferSize =
+            2048 * MAX_CHANNEL_COUNT * (kNumDelayBlocksMax + mFramesPerBuffer);
+    mOutputDelayRingBuffer = new INT_PCM[mOutputDelayRingBufferSize];
     mOutputDelayRingBufferWritePos = 0;
     mOutputDelayRingBufferReadPos = 0;
     mOutputDelayRingBufferFilled = 0;
@@ -439,6 +460,31 @@ void SoftAAC2::configureDownmix() const {
     }
 }
 
+// The platform can ask for lower power decoding, e.g. while on battery with the
+// screen off. FDK then uses real valued QMF banks for SBR, and skips parametric
+// stereo, which needs complex ones, so HE-AACv2 streams decode to mono. The
+// property is checked again every kPowerModeCheckFrames frames, so that a
+// long running stream follows it.
+void SoftAAC2::updatePowerMode(bool force) {
+    if (!force && --mFramesUntilPowerModeCheck > 0) {
+        return;
+    }
+    mFramesUntilPowerModeCheck = kPowerModeCheckFrames;
+
+    char value[PROPERTY_VALUE_MAX];
+    bool lowPower = property_get("media.aac_low_power", value, NULL)
+            && (!strcmp(value, "1") || !strcasecmp(value, "true"));
+    if (lowPower == mLowPower && !force) {
+        return;
+    }
+
+    ALOGI("%s power decoding", lowPower ? "low" : "full");
+    if (aacDecoder_SetParam(mAACDecoder, AAC_QMF_LOWPOWER, lowPower ? 1 : -1)
+            == AAC_DEC_OK) {
+        mLowPower = lowPower;
+    }
+}
+
 bool SoftAAC2::outputDelayRingBufferPutSamples(INT_PCM *samples, int32_t numSamples) {
     if (numSamples == 0) {
         return true;
@@ -447,27 +493,19 @@ bool SoftAAC2::outputDelayRingBufferPutSamples(INT_PCM *samples, int32_t numSamp
         ALOGE("RING BUFFER WOULD OVERFLOW");
         return false;
     }
-    if (mOutputDelayRingBufferWritePos + numSamples <= mOutputDelayRingBufferSize
-            && (mOutputDelayRingBufferReadPos <= mOutputDelayRingBufferWritePos
-                    || mOutputDelayRingBufferReadPos > mOutputDelayRingBufferWritePos + numSamples)) {
-        // faster memcopy loop without checks, if the preconditions allow this
-        for (int32_t i = 0; i < numSamples; i++) {
-            mOutputDelayRingBuffer[mOutputDelayRingBufferWritePos++] = samples[i];
-        }
 
-        if (mOutputDelayRingBufferWritePos >= mOutputDelayRingBufferSize) {
-            mOutputDelayRingBufferWritePos -= mOutputDelayRingBufferSize;
-        }
-    } else {
-        ALOGV("slow SoftAAC2::outputDelayRingBufferPutSamples()");
+    // at most two block copies, the second one after wrapping around
+    int32_t first = mOutputDelayRingBufferSize - mOutputDelayRingBufferWritePos;
+    if (first > numSamples) {
+        first = numSamples;
+    }
+    memcpy(mOutputDelayRingBuffer + mOutputDelayRingBufferWritePos, samples,
+            first * sizeof(INT_PCM));
+    memcpy(mOutputDelayRingBuffer, samples + first, (numSamples - first) * sizeof(INT_PCM));
 
-        for (int32_t i = 0; i < numSamples; i++) {
-            mOutputDelayRingBuffer[mOutputDelayRingBufferWritePos] = samples[i];
-            mOutputDelayRingBufferWritePos++;
-            if (mOutputDelayRingBufferWritePos >= mOutputDelayRingBufferSize) {
-                mOutputDelayRingBufferWritePos -= mOutputDelayRingBufferSize;
-            }
-        }
+    mOutputDelayRingBufferWritePos += numSamples;
+    if (mOutputDelayRingBufferWritePos >= mOutputDelayRingBufferSize) {
+        mOutputDelayRingBufferWritePos -= mOutputDelayRingBufferSize;
     }
     mOutputDelayRingBufferFilled += numSamples;
     return true;
@@ -480,32 +518,20 @@ int32_t SoftAAC2::outputDelayRingBufferGetSamples(INT_PCM *samples, int32_t numS
         return -1;
     }
 
-    if (mOutputDelayRingBufferReadPos + numSamples <= mOutputDelayRingBufferSize
-            && (mOutputDelayRingBufferWritePos < mOutputDelayRingBufferReadPos
-                    || mOutputDelayRingBufferWritePos >= mOutputDelayRingBufferReadPos + numSamples)) {
-        // faster memcopy loop without checks, if the preconditions allow this
-        if (samples != 0) {
-            for (int32_t i = 0; i < numSamples; i++) {
-                samples[i] = mOutputDelayRingBuffer[mOutputDelayRingBufferReadPos++];
-            }
-        } else {
-            mOutputDelayRingBufferReadPos += numSamples;
-        }
-        if (mOutputDelayRingBufferReadPos >= mOutputDelayRingBufferSize) {
-            mOutputDelayRingBufferReadPos -= mOutputDelayRingBufferSize;
+    // samples is NULL to discard
+    if (samples != 0) {
+        int32_t first = mOutputDelayRingBufferSize - mOutputDelayRingBufferReadPos;
+        if (first > numSamples) {
+            first = numSamples;
         }
-    } else {
-        ALOGV("slow SoftAAC2::outputDelayRingBufferGetSamples()");
+        memcpy(samples, mOutputDelayRingBuffer + mOutputDelayRingBufferReadPos,
+                first * sizeof(INT_PCM));
+        memcpy(samples + first, mOutputDelayRingBuffer, (numSamples - first) * sizeof(INT_PCM));
+    }
 
-        for (int32_t i = 0; i < numSamples; i++) {
-            if (samples != 0) {
-                samples[i] = mOutputDelayRingBuffer[mOutputDelayRingBufferReadPos];
-            }
-            mOutputDelayRingBufferReadPos++;
-            if (mOutputDelayRingBufferReadPos >= mOutputDelayRingBufferSize) {
-                mOutputDelayRingBufferReadPos -= mOutputDelayRingBufferSize;
-            }
-        }
+    mOutputDelayRingBufferReadPos += numSamples;
+    if (mOutputDelayRingBufferReadPos >= mOutputDelayRingBufferSize) {
+        mOutputDelayRingBufferReadPos -= mOutputDelayRingBufferSize;
     }
     mOutputDelayRingBufferFilled -= numSamples;
     return numSamples;
@@ -595,6 +621,7 @@ void SoftAAC2::onQueueFilled(OMX_U32 /* portIndex */) {
                 inHeader = NULL;
 
                 configureDownmix();
+                updatePowerMode(true /* force */);
                 // Only send out port settings changed event if both sample rate
                 // and numChannels are valid.
                 if (mStreamInfo->sampleRate && mStreamInfo->numChannels) {
@@ -713,6 +740,8 @@ void SoftAAC2::onQueueFilled(OMX_U32 /* portIndex */) {
                     break;
                 }
 
+                updatePowerMode(false /* force */);
+
                 int numConsumed = mStreamInfo->numTotalBytes;
                 decoderErr = aacDecoder_DecodeFrame(mAACDecoder,
                                            tmpOutBuffer,
@@ -885,7 +914,8 @@ void SoftAAC2::onQueueFilled(OMX_U32 /* portIndex */) {
 
         while (!outQueue.empty()
                 && outputDelayRingBufferSamplesAvailable()
-                        >= mStreamInfo->frameSize * mStreamInfo->numChannels) {
+                        >= mStreamInfo->frameSize * mStreamInfo->numChannels
+                                * framesToBatch((*outQueue.begin())->mHeader)) {
             BufferInfo *outInfo = *outQueue.begin();
             OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
@@ -939,6 +969,8 @@ void SoftAAC2::onQueueFilled(OMX_U32 /* portIndex */) {
                                 (long long) *nextTimeStamp, *currentBufLeft);
                     } else {
                         // move to next timestamp in list
+                        int64_t expectedTimeUs = *nextTimeStamp + mStreamInfo->aacSamplesPerFrame *
+                                1000000ll / mStreamInfo->aacSampleRate;
                         if (mBufferTimestamps.size() > 0) {
                             mBufferTimestamps.removeAt(0);
                             nextTimeStamp = &mBufferTimestamps.editItemAt(0);
@@ -953,6 +985,13 @@ void SoftAAC2::onQueueFilled(OMX_U32 /* portIndex */) {
                         // at most 4 decoded units in the corresponding output buffer)
                         // This is optional. Remove the next three lines to fill the output
                         // buffer with as many units as available.
+                        // When batching, keep going as long as the next input buffer
+                        // continues this one in time, as only the first frame in the
+                        // output buffer carries a timestamp.
+                        if (mFramesPerBuffer > 1 && i + 1 < numFrames
+                                && llabs(*nextTimeStamp - expectedTimeUs) <= kMaxBatchJitterUs) {
+                            continue;
+                        }
                         numFrames = i + 1;
                         numSamples = numFrames * mStreamInfo->frameSize * mStreamInfo->numChannels;
                         break;
@@ -1026,6 +1065,21 @@ void SoftAAC2::onQueueFilled(OMX_U32 /* portIndex */) {
     }
 }
 
+int32_t SoftAAC2::framesToBatch(const OMX_BUFFERHEADERTYPE *outHeader) const {
+    if (mFramesPerBuffer <= 1 || mEndOfInput) {
+        return 1;
+    }
+    int32_t frameBytes = mStreamInfo->frameSize * mStreamInfo->numChannels * sizeof(int16_t);
+    if (frameBytes <= 0) {
+        return 1;
+    }
+    int32_t fit = outHeader->nAllocLen / frameBytes;
+    if (fit < 1) {
+        return 1;
+    }
+    return fit < mFramesPerBuffer ? fit : mFramesPerBuffer;
+}
+
 void SoftAAC2::onPortFlushCompleted(OMX_U32 portIndex) {
     if (portIndex == 0) {
         // Make sure that the next buffer output does not still
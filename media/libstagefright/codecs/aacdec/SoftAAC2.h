@@ -49,6 +49,9 @@ private:
         kNumInputBuffers        = 4,
         kNumOutputBuffers       = 4,
         kNumDelayBlocksMax      = 8,
+        kMaxBatchJitterUs       = 1000,
+        // decoded frames between checks of the power saving property
+        kPowerModeCheckFrames   = 256,
     };
 
     HANDLE_AACDECODER mAACDecoder;
@@ -73,18 +76,28 @@ private:
         AWAITING_ENABLED
     } mOutputPortSettingsChange;
 
+    // decoded frames per output buffer
+    int32_t mFramesPerBuffer;
+
+    // low power (real valued) QMF processing, which also skips parametric stereo
+    bool mLowPower;
+    int32_t mFramesUntilPowerModeCheck;
+
     void initPorts();
     status_t initDecoder();
     bool isConfigured() const;
     void configureDownmix() const;
+    void updatePowerMode(bool force);
     void drainDecoder();
+    // frames to wait for before filling outHeader
+    int32_t framesToBatch(const OMX_BUFFERHEADERTYPE *outHeader) const;
 
 //      delay compensation
     bool mEndOfInput;
     bool mEndOfOutput;
     int32_t mOutputDelayCompensated;
     int32_t mOutputDelayRingBufferSize;
-    short *mOutputDelayRingBuffer;
+    INT_PCM *mOutputDelayRingBuffer;
     int32_t mOutputDelayRingBufferWritePos;
     int32_t mOutputDelayRingBufferReadPos;
     int32_t mOutputDelayRingBufferFilled;
@@ -48,9 +48,13 @@ SoftAACEncoder2::SoftAACEncoder2(
       mSBRMode(-1),
       mSBRRatio(0),
       mAACProfile(OMX_AUDIO_AACObjectLC),
+      mFrameLength(0),
+      mNumSamplesPerFrame(kNumSamplesPerFrame),
+      mEncoderDelay(0),
       mSentCodecSpecificData(false),
       mInputSize(0),
       mInputFrame(NULL),
+      mInputFrameCapacity(0),
       mInputTimeUs(-1ll),
       mSawInputEOS(false),
       mSignalledError(false) {
@@ -165,7 +169,7 @@ OMX_ERRORTYPE SoftAACEncoder2::internalGetParameter(
 
             aacParams->nChannels = mNumChannels;
             aacParams->nSampleRate = mSampleRate;
-            aacParams->nFrameLength = 0;
+            aacParams->nFrameLength = mFrameLength;
 
             switch (mSBRMode) {
             case 1: // sbr on
@@ -232,6 +236,30 @@ OMX_ERRORTYPE SoftAACEncoder2::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kEncoderDelayIndex:
+        {
+            OMX_PARAM_U32TYPE *delayParams = (OMX_PARAM_U32TYPE *)params;
+
+            if (!isValidOMXParam(delayParams)) {
+                return OMX_ErrorBadParameter;
+            }
+
+            if (delayParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            // The delay depends on the whole configuration, so this
+            // initializes the encoder with the current parameters.
+            AACENC_InfoStruct encInfo;
+            if (initEncoderInfo(&encInfo) != OK) {
+                return OMX_ErrorUndefined;
+            }
+
+            delayParams->nU32 = mEncoderDelay;
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -304,6 +332,7 @@ OMX_ERRORTYPE SoftAACEncoder2::internalSetParameter(
             if (aacParams->eAACProfile != OMX_AUDIO_AACObjectNull) {
                 mAACProfile = aacParams->eAACProfile;
             }
+            mFrameLength = aacParams->nFrameLength;
 
             if (!(aacParams->nAACtools & OMX_AUDIO_AACToolAndroidSSBR)
                     && !(aacParams->nAACtools & OMX_AUDIO_AACToolAndroidDSBR)) {
@@ -356,6 +385,16 @@ OMX_ERRORTYPE SoftAACEncoder2::internalSetParameter(
     }
 }
 
+OMX_ERRORTYPE SoftAACEncoder2::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, "OMX.google.android.index.encoderDelay")) {
+        *(int32_t*)index = kEncoderDelayIndex;
+        return OMX_ErrorNone;
+    }
+
+    return SimpleSoftOMXComponent::getExtensionIndex(name, index);
+}
+
 static CHANNEL_MODE getChannelMode(OMX_U32 nChannels) {
     CHANNEL_MODE chMode = MODE_INVALID;
     switch (nChannels) {
@@ -436,6 +475,40 @@ status_t SoftAACEncoder2::setAudioParams() {
         return UNKNOWN_ERROR;
     }
 
+    // The low delay profiles code 480 or 512 sample frames, the others
+    // always use 1024.
+    if (mFrameLength != 0
+            && (mAACProfile == OMX_AUDIO_AACObjectLD
+                || mAACProfile == OMX_AUDIO_AACObjectELD)) {
+        if (AACENC_OK != aacEncoder_SetParam(
+                mAACEncoder, AACENC_GRANULE_LENGTH, mFrameLength)) {
+            ALOGE("Failed to set AAC encoder frame length %u", mFrameLength);
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    return OK;
+}
+
+status_t SoftAACEncoder2::initEncoderInfo(AACENC_InfoStruct *encInfo) {
+    if (AACENC_OK != aacEncEncode(mAACEncoder, NULL, NULL, NULL, NULL)) {
+        ALOGE("Unable to initialize encoder for profile / sample-rate / bit-rate / channels");
+        return UNKNOWN_ERROR;
+    }
+
+    if (AACENC_OK != aacEncInfo(mAACEncoder, encInfo)) {
+        ALOGE("Failed to get AAC encoder info");
+        return UNKNOWN_ERROR;
+    }
+
+    // One access unit per output buffer: this is the core frame length,
+    // or twice that with dual-rate SBR.
+    mNumSamplesPerFrame = encInfo->frameLength;
+    mEncoderDelay = encInfo->encoderDelay;
+
+    ALOGV("%zu samples per frame, encoder delay %u samples",
+            mNumSamplesPerFrame, mEncoderDelay);
+
     return OK;
 }
 
@@ -456,8 +529,8 @@ void SoftAACEncoder2::onQueueFilled(OMX_U32 /* portIndex */) {
             return;
         }
 
-        if (AACENC_OK != aacEncEncode(mAACEncoder, NULL, NULL, NULL, NULL)) {
-            ALOGE("Unable to initialize encoder for profile / sample-rate / bit-rate / channels");
+        AACENC_InfoStruct encInfo;
+        if (initEncoderInfo(&encInfo) != OK) {
             notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
             mSignalledError = true;
             return;
@@ -468,14 +541,6 @@ void SoftAACEncoder2::onQueueFilled(OMX_U32 /* portIndex */) {
             ALOGW("Requested bitrate %u unsupported, using %u", mBitRate, actualBitRate);
         }
 
-        AACENC_InfoStruct encInfo;
-        if (AACENC_OK != aacEncInfo(mAACEncoder, &encInfo)) {
-            ALOGE("Failed to get AAC encoder info");
-            notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
-            mSignalledError = true;
-            return;
-        }
-
         BufferInfo *outInfo = *outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
         outHeader->nFilledLen = encInfo.confSize;
@@ -492,17 +557,28 @@ void SoftAACEncoder2::onQueueFilled(OMX_U32 /* portIndex */) {
     }
 
     size_t numBytesPerInputFrame =
-        mNumChannels * kNumSamplesPerFrame * sizeof(int16_t);
-
-    // Limit input size so we only get one ELD frame
-    if (mAACProfile == OMX_AUDIO_AACObjectELD && numBytesPerInputFrame > 512) {
-        numBytesPerInputFrame = 512;
-    }
+        mNumChannels * mNumSamplesPerFrame * sizeof(int16_t);
 
     for (;;) {
         // We do the following until we run out of buffers.
 
-        while (mInputSize < numBytesPerInputFrame) {
+        // If no partial frame is pending and the next input buffer holds
+        // a whole frame, the encoder reads it in place.
+        OMX_BUFFERHEADERTYPE *directHeader = NULL;
+        const int16_t *inputFrame = mInputFrame;
+
+        if (mInputSize == 0 && !mSawInputEOS && !inQueue.empty()) {
+            OMX_BUFFERHEADERTYPE *inHeader = (*inQueue.begin())->mHeader;
+            const uint8_t *inData = inHeader->pBuffer + inHeader->nOffset;
+
+            if (inHeader->nFilledLen >= numBytesPerInputFrame
+                    && ((uintptr_t)inData % sizeof(int16_t)) == 0) {
+                directHeader = inHeader;
+                inputFrame = (const int16_t *)inData;
+            }
+        }
+
+        while (directHeader == NULL && mInputSize < numBytesPerInputFrame) {
             // As long as there's still input data to be read we
             // will drain "kNumSamplesPerFrame * mNumChannels" samples
             // into the "mInputFrame" buffer and then encode those
@@ -522,8 +598,15 @@ void SoftAACEncoder2::onQueueFilled(OMX_U32 /* portIndex */) {
                 copy = inHeader->nFilledLen;
             }
 
-            if (mInputFrame == NULL) {
-                mInputFrame = new int16_t[numBytesPerInputFrame / sizeof(int16_t)];
+            if (mInputFrameCapacity < numBytesPerInputFrame) {
+                int16_t *frame = new int16_t[numBytesPerInputFrame / sizeof(int16_t)];
+                if (mInputSize > 0) {
+                    memcpy(frame, mInputFrame, mInputSize);
+                }
+                delete[] mInputFrame;
+                mInputFrame = frame;
+                mInputFrameCapacity = numBytesPerInputFrame;
+                inputFrame = mInputFrame;
             }
 
             if (mInputSize == 0) {
@@ -572,6 +655,10 @@ void SoftAACEncoder2::onQueueFilled(OMX_U32 /* portIndex */) {
             return;
         }
 
+        if (directHeader != NULL) {
+            mInputTimeUs = directHeader->nTimeStamp;
+        }
+
         BufferInfo *outInfo = *outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
@@ -584,7 +671,7 @@ void SoftAACEncoder2::onQueueFilled(OMX_U32 /* portIndex */) {
         memset(&outargs, 0, sizeof(outargs));
         inargs.numInSamples = numBytesPerInputFrame / sizeof(int16_t);
 
-        void* inBuffer[]        = { (unsigned char *)mInputFrame };
+        void* inBuffer[]        = { (unsigned char *)inputFrame };
         INT   inBufferIds[]     = { IN_AUDIO_DATA };
         INT   inBufferSize[]    = { (INT)numBytesPerInputFrame };
         INT   inBufferElSize[]  = { sizeof(int16_t) };
@@ -608,7 +695,8 @@ void SoftAACEncoder2::onQueueFilled(OMX_U32 /* portIndex */) {
         outBufDesc.bufSizes          = outBufferSize;
         outBufDesc.bufElSizes        = outBufferElSize;
 
-        // Encode the mInputFrame, which is treated as a modulo buffer
+        // Encode the frame, pointing the encoder past whatever it consumed
+        // until it has taken all of it
         AACENC_ERROR encoderErr = AACENC_OK;
         size_t nOutputBytes = 0;
 
@@ -629,17 +717,33 @@ void SoftAACEncoder2::onQueueFilled(OMX_U32 /* portIndex */) {
                 nOutputBytes += outargs.numOutBytes;
 
                 if (outargs.numInSamples > 0) {
-                    int numRemainingSamples = inargs.numInSamples - outargs.numInSamples;
-                    if (numRemainingSamples > 0) {
-                        memmove(mInputFrame,
-                                &mInputFrame[outargs.numInSamples],
-                                sizeof(int16_t) * numRemainingSamples);
-                    }
+                    inputFrame += outargs.numInSamples;
+                    inBuffer[0] = (unsigned char *)inputFrame;
+                    inBufferSize[0] -= outargs.numInSamples * sizeof(int16_t);
                     inargs.numInSamples -= outargs.numInSamples;
                 }
             }
         } while (encoderErr == AACENC_OK && inargs.numInSamples > 0);
 
+        if (directHeader != NULL) {
+            directHeader->nOffset += numBytesPerInputFrame;
+            directHeader->nFilledLen -= numBytesPerInputFrame;
+            directHeader->nTimeStamp +=
+                (mNumSamplesPerFrame * 1000000ll) / mSampleRate;
+
+            if (directHeader->nFilledLen == 0) {
+                if (directHeader->nFlags & OMX_BUFFERFLAG_EOS) {
+                    mSawInputEOS = true;
+                }
+
+                BufferInfo *inInfo = *inQueue.begin();
+                inQueue.erase(inQueue.begin());
+                inInfo->mOwnedByUs = false;
+                notifyEmptyBufferDone(directHeader);
+            }
+            directHeader = NULL;
+        }
+
         outHeader->nFilledLen = nOutputBytes;
 
         outHeader->nFlags = OMX_BUFFERFLAG_ENDOFFRAME;
@@ -40,6 +40,9 @@ protected:
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
 
 private:
@@ -56,10 +59,15 @@ private:
     OMX_S32 mSBRMode;
     OMX_S32 mSBRRatio;
     OMX_U32 mAACProfile;
+    OMX_U32 mFrameLength;           // requested LD/ELD core frame length, 0 for default
+
+    size_t mNumSamplesPerFrame;     // input samples per channel of one access unit
+    OMX_U32 mEncoderDelay;          // in samples per channel
 
     bool mSentCodecSpecificData;
     size_t mInputSize;
     int16_t *mInputFrame;
+    size_t mInputFrameCapacity;
     int64_t mInputTimeUs;
 
     bool mSawInputEOS;
@@ -70,6 +78,7 @@ private:
     status_t initEncoder();
 
     status_t setAudioParams();
+    status_t initEncoderInfo(AACENC_InfoStruct *encInfo);
 
     DISALLOW_EVIL_CONSTRUCTORS(SoftAACEncoder2);
 };
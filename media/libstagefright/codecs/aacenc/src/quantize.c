@@ -20,6 +20,10 @@
 
 *******************************************************************************/
 
+/* arm_neon.h goes before the local headers, which redefine __inline */
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 #include "typedef.h"
 #include "basic_op.h"
 #include "oper_32b.h"
@@ -92,6 +96,44 @@ static Word16 quantizeSingleLine(const Word16 gain, const Word32 absSpectrum)
   return qua;
 }
 
+#if defined(__aarch64__)
+/*****************************************************************************
+*
+* function name:quantizeLines4
+* description: arm64 NEON version of the table lookup part of quantizeLines,
+*              for 4 lines with a non negative shift g < 32
+*  returns: 0, with nothing stored, if one of the lines needs the full
+*           quantizeSingleLine() and the caller has to do the 4 lines in C
+*
+*****************************************************************************/
+static Word32 quantizeLines4(const Word32 g,
+                             const Word16 *pquat,
+                             const Word32 *mdctSpectrum,
+                             Word16 *quaSpectrum)
+{
+  int32x4_t spec = vld1q_s32(mdctSpectrum);
+  int32x4_t saShft = vshlq_s32(vqabsq_s32(spec), vdupq_n_s32(-g));
+  uint32x4_t above0, above1, above2;
+  int32x4_t negQua;
+
+  /* saShft >= pquat[3] goes through quantizeSingleLine() */
+  if (vmaxvq_u32(vcgeq_s32(saShft, vdupq_n_s32(pquat[3]))))
+    return 0;
+
+  /* the borders are increasing, so the magnitude is the number of borders
+     crossed, and each all ones compare mask counts -1 */
+  above0 = vcgtq_s32(saShft, vdupq_n_s32(pquat[0]));
+  above1 = vcgeq_s32(saShft, vdupq_n_s32(pquat[1]));
+  above2 = vcgeq_s32(saShft, vdupq_n_s32(pquat[2]));
+  negQua = vreinterpretq_s32_u32(vaddq_u32(vaddq_u32(above0, above1), above2));
+
+  negQua = vbslq_s32(vcltzq_s32(spec), negQua, vnegq_s32(negQua));
+  vst1_s16(quaSpectrum, vmovn_s32(negQua));
+
+  return 1;
+}
+#endif
+
 /*****************************************************************************
 *
 * function name:quantizeLines
@@ -123,6 +165,15 @@ static void quantizeLines(const Word16 gain,
 	  Word32 qua;
 	  qua = 0;
 
+#if defined(__aarch64__)
+	  /* sfb widths are multiples of 4 */
+	  if ((line & 3) == 0 && line + 4 <= noOfLines && g < 32 &&
+		  quantizeLines4(g, pquat, mdctSpectrum + line, quaSpectrum + line)) {
+		line += 3;
+		continue;
+	  }
+#endif
+
 	  mdctSpeL = mdctSpectrum[line];
 
 	  if (mdctSpeL) {
@@ -20,6 +20,10 @@
 
 *******************************************************************************/
 
+/* arm_neon.h goes before the local headers, which redefine __inline */
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 #include "basic_op.h"
 #include "psy_const.h"
 #include "transform.h"
@@ -179,6 +183,199 @@ static void Radix8First(int *buf, int num)
 	}
 }
 
+#if defined(__aarch64__)
+
+/* MULHIGH() on four lanes; vqdmulh only saturates for MIN_32 * MIN_32, which
+   no twiddle factor reaches, so this matches the C reference bit for bit */
+__inline int32x4_t MulHigh4(int32x4_t a, int32x4_t b)
+{
+	return vshrq_n_s32(vqdmulhq_s32(a, b), 1);
+}
+
+__inline int32x4_t Reverse4(int32x4_t a)
+{
+	a = vrev64q_s32(a);
+	return vextq_s32(a, a, 2);
+}
+
+/* deinterleaves the {cos, sin} pair k of four consecutive 6 word twiddle entries */
+__inline void LoadTwiddles4(const int *csptr, int32x4_t *cos1, int32x4_t *sin1,
+							int32x4_t *cos2, int32x4_t *sin2,
+							int32x4_t *cos3, int32x4_t *sin3)
+{
+	int64x2x3_t a = vld3q_s64((const int64_t *)csptr);
+	int64x2x3_t b = vld3q_s64((const int64_t *)(csptr + 12));
+
+	*cos1 = vuzp1q_s32(vreinterpretq_s32_s64(a.val[0]), vreinterpretq_s32_s64(b.val[0]));
+	*sin1 = vuzp2q_s32(vreinterpretq_s32_s64(a.val[0]), vreinterpretq_s32_s64(b.val[0]));
+	*cos2 = vuzp1q_s32(vreinterpretq_s32_s64(a.val[1]), vreinterpretq_s32_s64(b.val[1]));
+	*sin2 = vuzp2q_s32(vreinterpretq_s32_s64(a.val[1]), vreinterpretq_s32_s64(b.val[1]));
+	*cos3 = vuzp1q_s32(vreinterpretq_s32_s64(a.val[2]), vreinterpretq_s32_s64(b.val[2]));
+	*sin3 = vuzp2q_s32(vreinterpretq_s32_s64(a.val[2]), vreinterpretq_s32_s64(b.val[2]));
+}
+
+/*****************************************************************************
+*
+* function name: Radix4FFT
+* description:  Radix 4 point fft core function, arm64 NEON version
+*               four butterflies at a time, bgn is always a multiple of 4
+*
+**********************************************************************************/
+static void Radix4FFT(int *buf, int num, int bgn, int *twidTab)
+{
+	int32x4x2_t x0, x1, x2, x3;
+	int32x4_t cos1, sin1, cos2, sin2, cos3, sin3;
+	int32x4_t r0, r1, r2, r3, r4, r5, r6, r7;
+	int32x4_t t0, t1;
+	int i, j, step;
+	int *xptr, *csptr;
+
+	for (num >>= 2; num != 0; num >>= 2)
+	{
+		step = 2*bgn;
+		xptr = buf;
+
+		for (i = num; i != 0; i--)
+		{
+			csptr = twidTab;
+
+			for (j = bgn; j != 0; j -= 4)
+			{
+				LoadTwiddles4(csptr, &cos1, &sin1, &cos2, &sin2, &cos3, &sin3);
+				csptr += 24;
+
+				x0 = vld2q_s32(xptr);
+				x1 = vld2q_s32(xptr + step);
+				x2 = vld2q_s32(xptr + 2*step);
+				x3 = vld2q_s32(xptr + 3*step);
+
+				r2 = vaddq_s32(MulHigh4(cos1, x1.val[0]), MulHigh4(sin1, x1.val[1]));
+				r3 = vsubq_s32(MulHigh4(cos1, x1.val[1]), MulHigh4(sin1, x1.val[0]));
+
+				t0 = vshrq_n_s32(x0.val[0], 2);
+				t1 = vshrq_n_s32(x0.val[1], 2);
+				r0 = vsubq_s32(t0, r2);
+				r1 = vsubq_s32(t1, r3);
+				r2 = vaddq_s32(t0, r2);
+				r3 = vaddq_s32(t1, r3);
+
+				r4 = vaddq_s32(MulHigh4(cos2, x2.val[0]), MulHigh4(sin2, x2.val[1]));
+				r5 = vsubq_s32(MulHigh4(cos2, x2.val[1]), MulHigh4(sin2, x2.val[0]));
+				r6 = vaddq_s32(MulHigh4(cos3, x3.val[0]), MulHigh4(sin3, x3.val[1]));
+				r7 = vsubq_s32(MulHigh4(cos3, x3.val[1]), MulHigh4(sin3, x3.val[0]));
+
+				t0 = r4;
+				t1 = r5;
+				r4 = vaddq_s32(t0, r6);
+				r5 = vsubq_s32(r7, t1);
+				r6 = vsubq_s32(t0, r6);
+				r7 = vaddq_s32(r7, t1);
+
+				x3.val[0] = vaddq_s32(r0, r5);
+				x3.val[1] = vaddq_s32(r1, r6);
+				x2.val[0] = vsubq_s32(r2, r4);
+				x2.val[1] = vsubq_s32(r3, r7);
+				x1.val[0] = vsubq_s32(r0, r5);
+				x1.val[1] = vsubq_s32(r1, r6);
+				x0.val[0] = vaddq_s32(r2, r4);
+				x0.val[1] = vaddq_s32(r3, r7);
+
+				vst2q_s32(xptr, x0);
+				vst2q_s32(xptr + step, x1);
+				vst2q_s32(xptr + 2*step, x2);
+				vst2q_s32(xptr + 3*step, x3);
+				xptr += 8;
+			}
+			xptr += 3*step;
+		}
+		twidTab += 3*step;
+		bgn <<= 2;
+	}
+}
+
+/*********************************************************************************
+*
+* function name: PreMDCT
+* description:  prepare MDCT process for next FFT compute, arm64 NEON version
+*               four iterations of the C loop at a time, num is a multiple of 16
+*
+**********************************************************************************/
+static void PreMDCT(int *buf0, int num, const int *csptr)
+{
+	int i;
+	int32x4x4_t cs;
+	int32x4x2_t lo, hi;
+	int32x4_t tr1, ti1, tr2, ti2;
+	int *buf1;
+
+	buf1 = buf0 + num - 8;
+
+	for(i = num >> 4; i != 0; i--)
+	{
+		cs = vld4q_s32(csptr);				/* cosa, sina, cosb, sinb */
+		csptr += 16;
+
+		lo = vld2q_s32(buf0);
+		hi = vld2q_s32(buf1);
+		tr1 = lo.val[0];
+		ti2 = lo.val[1];
+		tr2 = Reverse4(hi.val[0]);
+		ti1 = Reverse4(hi.val[1]);
+
+		lo.val[0] = vaddq_s32(MulHigh4(cs.val[0], tr1), MulHigh4(cs.val[1], ti1));
+		lo.val[1] = vsubq_s32(MulHigh4(cs.val[0], ti1), MulHigh4(cs.val[1], tr1));
+		hi.val[1] = Reverse4(vsubq_s32(MulHigh4(cs.val[2], ti2), MulHigh4(cs.val[3], tr2)));
+		hi.val[0] = Reverse4(vaddq_s32(MulHigh4(cs.val[2], tr2), MulHigh4(cs.val[3], ti2)));
+
+		vst2q_s32(buf0, lo);
+		vst2q_s32(buf1, hi);
+		buf0 += 8;
+		buf1 -= 8;
+	}
+}
+
+/*********************************************************************************
+*
+* function name: PostMDCT
+* description:   post MDCT process after next FFT for MDCT, arm64 NEON version
+*
+**********************************************************************************/
+static void PostMDCT(int *buf0, int num, const int *csptr)
+{
+	int i;
+	int32x4x4_t cs;
+	int32x4x2_t lo, hi;
+	int32x4_t tr1, ti1, tr2, ti2;
+	int *buf1;
+
+	buf1 = buf0 + num - 8;
+
+	for(i = num >> 4; i != 0; i--)
+	{
+		cs = vld4q_s32(csptr);				/* cosa, sina, cosb, sinb */
+		csptr += 16;
+
+		lo = vld2q_s32(buf0);
+		hi = vld2q_s32(buf1);
+		tr1 = lo.val[0];
+		ti1 = lo.val[1];
+		tr2 = Reverse4(hi.val[0]);
+		ti2 = Reverse4(hi.val[1]);
+
+		lo.val[0] = vaddq_s32(MulHigh4(cs.val[0], tr1), MulHigh4(cs.val[1], ti1));
+		hi.val[1] = Reverse4(vsubq_s32(MulHigh4(cs.val[1], tr1), MulHigh4(cs.val[0], ti1)));
+		lo.val[1] = vsubq_s32(MulHigh4(cs.val[3], tr2), MulHigh4(cs.val[2], ti2));
+		hi.val[0] = Reverse4(vaddq_s32(MulHigh4(cs.val[2], tr2), MulHigh4(cs.val[3], ti2)));
+
+		vst2q_s32(buf0, lo);
+		vst2q_s32(buf1, hi);
+		buf0 += 8;
+		buf1 -= 8;
+	}
+}
+
+#else
+
 /*****************************************************************************
 *
 * function name: Radix4FFT
@@ -339,6 +536,7 @@ static void PostMDCT(int *buf0, int num, const int *csptr)
 		*buf1-- = MULHIGH(cosb, tr2) + MULHIGH(sinb, ti2);
 	}
 }
+#endif /* __aarch64__ */
 #else
 void Radix4First(int *buf, int num);
 void Radix8First(int *buf, int num);
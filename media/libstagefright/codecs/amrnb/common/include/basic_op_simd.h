@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Vector versions of the multiply-accumulate loops that the encoder and the
+ * post filter run per sample.
+ *
+ * These loops already accumulate with plain, non-saturating 32 bit
+ * arithmetic (amrnb_fxp_mac_16_by_16bb). A vector sum of the same full
+ * precision products is therefore bit exact with them, because only the
+ * order of the additions changes. Define AMRNB_NO_SIMD to build the scalar
+ * loops instead.
+ */
+
+#ifndef BASIC_OP_SIMD_H
+#define BASIC_OP_SIMD_H
+
+#include "typedef.h"
+
+#if !defined(AMRNB_NO_SIMD)
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AMRNB_SIMD
+#define AMRNB_SIMD_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AMRNB_SIMD
+#define AMRNB_SIMD_SSE2
+#endif
+#endif
+
+#ifdef AMRNB_SIMD
+
+/* Returns the sum of x[i] * y[i] for 0 <= i < n. */
+static inline Word32 amrnb_dot_16x16(const Word16 *x, const Word16 *y, Word16 n)
+{
+    Word16 i;
+    Word32 s;
+#ifdef AMRNB_SIMD_NEON
+    int32x4_t acc = vdupq_n_s32(0);
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        int16x8_t a = vld1q_s16(x + i);
+        int16x8_t b = vld1q_s16(y + i);
+        acc = vmlal_s16(acc, vget_low_s16(a), vget_low_s16(b));
+        acc = vmlal_s16(acc, vget_high_s16(a), vget_high_s16(b));
+    }
+    int32x2_t sum2 = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+    s = vget_lane_s32(vpadd_s32(sum2, sum2), 0);
+#else
+    __m128i acc = _mm_setzero_si128();
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(y + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(a, b));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4e));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xb1));
+    s = _mm_cvtsi128_si32(acc);
+#endif
+    for (; i < n; i++)
+    {
+        s += (Word32) x[i] * y[i];
+    }
+    return s;
+}
+
+#endif /* AMRNB_SIMD */
+
+#endif /* BASIC_OP_SIMD_H */
@@ -73,6 +73,7 @@ terms listed above has been obtained from the copyright holder.
 #include "residu.h"
 #include "typedef.h"
 #include "cnst.h"
+#include "basic_op_simd.h"
 
 /*----------------------------------------------------------------------------
 ; MACROS
@@ -90,6 +91,61 @@ terms listed above has been obtained from the copyright holder.
 ; Function Prototype declaration
 ----------------------------------------------------------------------------*/
 
+#ifdef AMRNB_SIMD
+/* Residu() for input_len a multiple of 8, eight outputs per iteration */
+static void Residu_x8(
+    Word16 coef_ptr[],
+    Word16 input_ptr[],
+    Word16 residual_ptr[],
+    Word16 input_len)
+{
+    Word16 i, j;
+
+    for (i = 0; i < input_len; i += 8)
+    {
+        Word16 *p_input = &input_ptr[i];
+#ifdef AMRNB_SIMD_NEON
+        int32x4_t lo = vdupq_n_s32(0x0000800L);
+        int32x4_t hi = vdupq_n_s32(0x0000800L);
+
+        for (j = 0; j <= M; j++)
+        {
+            int16x8_t in = vld1q_s16(p_input - j);
+            lo = vmlal_n_s16(lo, vget_low_s16(in), coef_ptr[j]);
+            hi = vmlal_n_s16(hi, vget_high_s16(in), coef_ptr[j]);
+        }
+        vst1q_s16(&residual_ptr[i], vcombine_s16(vshrn_n_s32(lo, 12), vshrn_n_s32(hi, 12)));
+#else
+        __m128i lo = _mm_set1_epi32(0x0000800L);
+        __m128i hi = _mm_set1_epi32(0x0000800L);
+        __m128i in0;
+        __m128i in1;
+        __m128i coef;
+
+        /* taps j and j + 1 at once: (x[n - j], x[n - j - 1]) . (a[j], a[j + 1]) */
+        for (j = 0; j < M; j += 2)
+        {
+            in0 = _mm_loadu_si128((const __m128i *)(p_input - j));
+            in1 = _mm_loadu_si128((const __m128i *)(p_input - j - 1));
+            coef = _mm_set1_epi32((Word32)((UWord16)coef_ptr[j]) |
+                                  ((Word32)coef_ptr[j + 1] << 16));
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(in0, in1), coef));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(in0, in1), coef));
+        }
+        in0 = _mm_loadu_si128((const __m128i *)(p_input - M));
+        coef = _mm_set1_epi32((UWord16)coef_ptr[M]);
+        lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(in0, _mm_setzero_si128()), coef));
+        hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(in0, _mm_setzero_si128()), coef));
+
+        /* keep the low 16 bits of s >> 12 without saturating */
+        lo = _mm_srai_epi32(_mm_slli_epi32(lo, 4), 16);
+        hi = _mm_srai_epi32(_mm_slli_epi32(hi, 4), 16);
+        _mm_storeu_si128((__m128i *)&residual_ptr[i], _mm_packs_epi32(lo, hi));
+#endif
+    }
+}
+#endif
+
 /*----------------------------------------------------------------------------
 ; LOCAL STORE/BUFFER/POINTER DEFINITIONS
 ; Variable declaration - defined here and used outside this module
@@ -215,6 +271,14 @@ void Residu(
     Word16 *p_residual_ptr = &residual_ptr[input_len-1];
     Word16 *p_input_ptr    = &input_ptr[input_len-1-M];
 
+#ifdef AMRNB_SIMD
+    if ((input_len & 7) == 0)
+    {
+        Residu_x8(coef_ptr, input_ptr, residual_ptr, input_len);
+        return;
+    }
+#endif
+
     for (i = input_len >> 2; i != 0; i--)
     {
         s1       = 0x0000800L;
@@ -72,6 +72,7 @@ terms listed above has been obtained from the copyright holder.
 ----------------------------------------------------------------------------*/
 #include "calc_cor.h"
 #include "basic_op.h"
+#include "basic_op_simd.h"
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module specific macros here
@@ -219,10 +220,12 @@ void comp_corr(
 
 
     Word16 i;
+#ifndef AMRNB_SIMD
     Word16 j;
     Word16 *p;
     Word16 *p1;
     Word16 *p2;
+#endif
     Word16 *p_scal_sig;
     Word32 t1;
     Word32 t2;
@@ -234,6 +237,13 @@ void comp_corr(
 
     for (i = ((lag_max - lag_min) >> 2) + 1; i > 0; i--)
     {
+#ifdef AMRNB_SIMD
+        t1 = amrnb_dot_16x16(scal_sig, p_scal_sig, L_frame);
+        t2 = amrnb_dot_16x16(scal_sig, p_scal_sig + 1, L_frame);
+        t3 = amrnb_dot_16x16(scal_sig, p_scal_sig + 2, L_frame);
+        t4 = amrnb_dot_16x16(scal_sig, p_scal_sig + 3, L_frame);
+        p_scal_sig += 4;
+#else
         t1 = 0;
         t2 = 0;
         t3 = 0;
@@ -255,6 +265,7 @@ void comp_corr(
             t3 = amrnb_fxp_mac_16_by_16bb((Word32) * (p), (Word32) * (p2++), t3);
             t4 = amrnb_fxp_mac_16_by_16bb((Word32) * (p++), (Word32) * (p2), t4);
         }
+#endif
 
         *(corr++) = t1 << 1;
         *(corr++) = t2 << 1;
@@ -83,6 +83,8 @@ terms listed above has been obtained from the copyright holder.
 #include "typedef.h"
 #include "convolve.h"
 #include "basic_op.h"
+#include "basic_op_simd.h"
+#include "cnst.h"
 
 /*----------------------------------------------------------------------------
 ; MACROS
@@ -215,6 +217,32 @@ void Convolve(
     Word16 i, n;
     Word32 s1, s2;
 
+#ifdef AMRNB_SIMD
+    if (L <= L_SUBFR)
+    {
+        /* y[n] is the product of x[0..n] with h[n..0]: reverse h[] and pad */
+        /* both vectors with zeros so that every sum runs over whole vectors */
+        Word16 hr[L_SUBFR + 8];
+        Word16 xp[L_SUBFR + 8];
+
+        for (i = 0; i < L; i++)
+        {
+            hr[i] = h[L - 1 - i];
+            xp[i] = x[i];
+        }
+        for (; i < L + 8; i++)
+        {
+            hr[i] = 0;
+            xp[i] = 0;
+        }
+        for (n = 0; n < L; n++)
+        {
+            s1 = amrnb_dot_16x16(xp, &hr[L - 1 - n], (n + 8) & ~7);
+            y[n] = (Word16)(s1 >> 12);
+        }
+        return;
+    }
+#endif
 
     for (n = 1; n < L; n = n + 2)
     {
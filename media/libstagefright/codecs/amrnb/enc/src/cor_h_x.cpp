@@ -74,6 +74,7 @@ terms listed above has been obtained from the copyright holder.
 #include "cnst.h"
 #include "cor_h_x.h"
 #include "basic_op.h"
+#include "basic_op_simd.h"
 
 /*----------------------------------------------------------------------------
 ; MACROS
@@ -258,7 +259,9 @@ void cor_h_x(
     Word32 max;
     Word32 tot;
 
+#ifndef AMRNB_SIMD
     Word16 *p_x;
+#endif
     Word16 *p_ptr;
     Word32 *p_y32;
 
@@ -269,6 +272,9 @@ void cor_h_x(
         max = 0;
         for (i = k; i < L_CODE; i += STEP)      /* L_CODE = 40; STEP = 5 */
         {
+#ifdef AMRNB_SIMD
+            s = amrnb_dot_16x16(&x[i], h, L_CODE - i) << 1;
+#else
             s = 0;
             p_x = &x[i];
             p_ptr = h;
@@ -285,6 +291,7 @@ void cor_h_x(
             {
                 s += ((Word32) * (p_x++) * *(p_ptr++)) << 1;
             }
+#endif
 
             y32[i] = s;
 
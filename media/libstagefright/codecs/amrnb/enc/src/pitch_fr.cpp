@@ -96,6 +96,7 @@ terms listed above has been obtained from the copyright holder.
 #include "convolve.h"
 
 #include "basic_op.h"
+#include "basic_op_simd.h"
 
 
 /*----------------------------------------------------------------------------
@@ -335,7 +336,9 @@ static void Norm_Corr(Word16 exc[],
     Word16 *p_s_excf;
     Word16 *p_excf;
     Word16  temp;
+#ifndef AMRNB_SIMD
     Word16 *p_x;
+#endif
     Word16 *p_h;
 
     k = -t_min;
@@ -380,6 +383,10 @@ static void Norm_Corr(Word16 exc[],
     {
         /* Compute 1/sqrt(energy of excf[]) */
 
+#ifdef AMRNB_SIMD
+        s  = amrnb_dot_16x16(xn, s_excf, L_subfr);
+        s2 = amrnb_dot_16x16(s_excf, s_excf, L_subfr);
+#else
         s   = s2 = 0;
         p_x      = xn;
         p_s_excf = s_excf;
@@ -394,6 +401,7 @@ static void Norm_Corr(Word16 exc[],
             s2 += ((Word32)(*(p_s_excf)) * (*(p_s_excf)));
             p_s_excf++;
         }
+#endif
 
         s2     = s2 << 1;
         s2     = Inv_sqrt(s2, pOverflow);
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Vector versions of the inner loops shared by the encoder's correlation and
+ * filtering kernels, used on targets without the ARM assembly (ASM_OPT).
+ *
+ * Each helper is bit exact with the C loop it replaces: products are formed
+ * at full 32 bit precision and summed with the same wrap-around arithmetic,
+ * so only the order of the additions changes.  Define AMRWBENC_NO_SIMD to
+ * build the plain C loops instead.
+ */
+
+#ifndef __SIMD_OP_H__
+#define __SIMD_OP_H__
+
+#include "typedef.h"
+
+#if !defined(ASM_OPT) && !defined(AMRWBENC_NO_SIMD)
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define SIMD_OPT
+#define SIMD_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_OPT
+#define SIMD_SSE2
+#endif
+#endif
+
+#ifdef SIMD_OPT
+
+/* Returns the sum of x[i] * y[i] for 0 <= i < n. */
+static __inline Word32 vo_dot_product(const Word16 *x, const Word16 *y, Word32 n)
+{
+    Word32 i, s;
+#ifdef SIMD_NEON
+    int32x4_t acc = vdupq_n_s32(0);
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        int16x8_t a = vld1q_s16(x + i);
+        int16x8_t b = vld1q_s16(y + i);
+        acc = vmlal_s16(acc, vget_low_s16(a), vget_low_s16(b));
+        acc = vmlal_high_s16(acc, a, b);
+    }
+    s = vaddvq_s32(acc);
+#else
+    __m128i acc = _mm_setzero_si128();
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(y + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(a, b));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4e));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xb1));
+    s = _mm_cvtsi128_si32(acc);
+#endif
+    for (; i < n; i++)
+    {
+        s += x[i] * y[i];
+    }
+    return s;
+}
+
+/* y[i] = vo_mult_r(x[i], w[i]) for 0 <= i < n, n a multiple of 8. */
+static __inline void vo_mult_r_vec(Word16 *y, const Word16 *x, const Word16 *w, Word32 n)
+{
+    Word32 i;
+    for (i = 0; i < n; i += 8)
+    {
+#ifdef SIMD_NEON
+        int16x8_t a = vld1q_s16(x + i);
+        int16x8_t b = vld1q_s16(w + i);
+        int16x4_t lo = vrshrn_n_s32(vmull_s16(vget_low_s16(a), vget_low_s16(b)), 15);
+        int16x4_t hi = vrshrn_n_s32(vmull_high_s16(a, b), 15);
+        vst1q_s16(y + i, vcombine_s16(lo, hi));
+#else
+        /* (x, 1) . (w, 0x4000) = x * w + 0x4000, then keep the low 16 bits of >> 15 */
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i round = _mm_set1_epi16(0x4000);
+        __m128i a = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(w + i));
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a, one), _mm_unpacklo_epi16(b, round));
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a, one), _mm_unpackhi_epi16(b, round));
+        lo = _mm_srai_epi32(_mm_slli_epi32(lo, 1), 16);
+        hi = _mm_srai_epi32(_mm_slli_epi32(hi, 1), 16);
+        _mm_storeu_si128((__m128i *)(y + i), _mm_packs_epi32(lo, hi));
+#endif
+    }
+}
+
+/* Returns the sum of vo_L_mult(x[i], x[i]) >> 8 for 0 <= i < n, n a multiple of 8. */
+static __inline Word32 vo_energy_shr8(const Word16 *x, Word32 n)
+{
+    Word32 i;
+#ifdef SIMD_NEON
+    int32x4_t acc = vdupq_n_s32(0);
+    for (i = 0; i < n; i += 8)
+    {
+        int16x8_t a = vld1q_s16(x + i);
+        int32x4_t lo = vmull_s16(vget_low_s16(a), vget_low_s16(a));
+        int32x4_t hi = vmull_high_s16(a, a);
+        acc = vaddq_s32(acc, vshrq_n_s32(vshlq_n_s32(lo, 1), 8));
+        acc = vaddq_s32(acc, vshrq_n_s32(vshlq_n_s32(hi, 1), 8));
+    }
+    return vaddvq_s32(acc);
+#else
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    for (i = 0; i < n; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i lo = _mm_unpacklo_epi16(a, zero);
+        __m128i hi = _mm_unpackhi_epi16(a, zero);
+        lo = _mm_madd_epi16(lo, lo);
+        hi = _mm_madd_epi16(hi, hi);
+        acc = _mm_add_epi32(acc, _mm_srai_epi32(_mm_slli_epi32(lo, 1), 8));
+        acc = _mm_add_epi32(acc, _mm_srai_epi32(_mm_slli_epi32(hi, 1), 8));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4e));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xb1));
+    return _mm_cvtsi128_si32(acc);
+#endif
+}
+
+/* x[i] = vo_shr_r(x[i], shift) for 0 <= i < n, 0 < shift < 16, n a multiple of 8. */
+static __inline void vo_shr_r_vec(Word16 *x, Word32 shift, Word32 n)
+{
+    Word32 i;
+#ifdef SIMD_NEON
+    const int16x8_t s = vdupq_n_s16((int16_t)-shift);
+    for (i = 0; i < n; i += 8)
+    {
+        vst1q_s16(x + i, vrshlq_s16(vld1q_s16(x + i), s));
+    }
+#else
+    /* (x + (1 << (shift - 1))) >> shift is x >> shift plus bit (shift - 1) of x */
+    const __m128i s = _mm_cvtsi32_si128(shift);
+    const __m128i s1 = _mm_cvtsi32_si128(shift - 1);
+    const __m128i one = _mm_set1_epi16(1);
+    for (i = 0; i < n; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i r = _mm_and_si128(_mm_sra_epi16(a, s1), one);
+        _mm_storeu_si128((__m128i *)(x + i), _mm_add_epi16(_mm_sra_epi16(a, s), r));
+    }
+#endif
+}
+
+/*
+ * y[i] = vo_mult(a, h[i]) + x[i] for 0 <= i < n, n a multiple of 8.  The
+ * blocks are processed from the end, so y may alias x + 1 for an in place
+ * shift of a filter memory.
+ */
+static __inline void vo_mult_add_vec(Word16 *y, const Word16 *x, Word16 a, const Word16 *h, Word32 n)
+{
+    Word32 i;
+#ifdef SIMD_NEON
+    const int16x4_t va = vdup_n_s16(a);
+    for (i = n - 8; i >= 0; i -= 8)
+    {
+        int16x8_t b = vld1q_s16(h + i);
+        int16x8_t c = vld1q_s16(x + i);
+        int16x4_t lo = vshrn_n_s32(vmull_s16(va, vget_low_s16(b)), 15);
+        int16x4_t hi = vshrn_n_s32(vmull_s16(va, vget_high_s16(b)), 15);
+        vst1q_s16(y + i, vaddq_s16(vcombine_s16(lo, hi), c));
+    }
+#else
+    const __m128i va = _mm_set1_epi16(a);
+    for (i = n - 8; i >= 0; i -= 8)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i *)(h + i));
+        __m128i c = _mm_loadu_si128((const __m128i *)(x + i));
+        /* low 16 bits of (a * h) >> 15, from the high and low halves of the product */
+        __m128i p = _mm_or_si128(_mm_slli_epi16(_mm_mulhi_epi16(va, b), 1),
+                                 _mm_srli_epi16(_mm_mullo_epi16(va, b), 15));
+        _mm_storeu_si128((__m128i *)(y + i), _mm_add_epi16(p, c));
+    }
+#endif
+}
+
+#endif /* SIMD_OPT */
+
+#endif /* __SIMD_OP_H__ */
@@ -26,6 +26,7 @@
 #include "basic_op.h"
 #include "oper_32b.h"
 #include "acelp.h"
+#include "simd_op.h"
 #include "ham_wind.tab"
 
 #define UNUSED(x) (void)(x)
@@ -39,12 +40,18 @@ void Autocorr(
 {
     Word32 i, norm, shift;
     Word16 y[L_WINDOW];
-    Word32 L_sum, L_sum1, L_tmp, F_LEN;
+    Word32 L_sum, L_sum1;
+#ifndef SIMD_OPT
+    Word32 L_tmp, F_LEN;
     Word16 *p1,*p2,*p3;
     const Word16 *p4;
+#endif
         UNUSED(m);
 
     /* Windowing of signal */
+#ifdef SIMD_OPT
+    vo_mult_r_vec(y, x, vo_window, L_WINDOW);
+#else
     p1 = x;
     p4 = vo_window;
     p3 = y;
@@ -56,19 +63,33 @@ void Autocorr(
         *p3++ = vo_mult_r((*p1++), (*p4++));
         *p3++ = vo_mult_r((*p1++), (*p4++));
     }
+#endif
 
     /* calculate energy of signal */
     L_sum = vo_L_deposit_h(16);               /* sqrt(256), avoid overflow after rounding */
+#ifdef SIMD_OPT
+    L_sum += vo_energy_shr8(y, L_WINDOW);
+#else
     for (i = 0; i < L_WINDOW; i++)
     {
         L_tmp = vo_L_mult(y[i], y[i]);
         L_tmp = (L_tmp >> 8);
         L_sum += L_tmp;
     }
+#endif
 
     /* scale signal to avoid overflow in autocorrelation */
     norm = norm_l(L_sum);
     shift = 4 - (norm >> 1);
+#ifdef SIMD_OPT
+    if(shift > 0)
+    {
+        vo_shr_r_vec(y, shift, L_WINDOW);
+    }
+
+    /* Compute and normalize r[0] */
+    L_sum = 1 + (vo_dot_product(y, y, L_WINDOW) << 1);
+#else
     if(shift > 0)
     {
         p1 = y;
@@ -94,6 +115,7 @@ void Autocorr(
         L_sum += vo_L_mult(y[i+2], y[i+2]);
         L_sum += vo_L_mult(y[i+3], y[i+3]);
     }
+#endif
 
     norm = norm_l(L_sum);
     L_sum = (L_sum << norm);
@@ -104,6 +126,10 @@ void Autocorr(
     /* Compute r[1] to r[m] */
     for (i = 1; i <= 8; i++)
     {
+#ifdef SIMD_OPT
+        L_sum1 = vo_dot_product(y, y + (2*i)-1, L_WINDOW - (2*i) + 1);
+        L_sum = vo_dot_product(y, y + (2*i), L_WINDOW - (2*i));
+#else
         L_sum1 = 0;
         L_sum = 0;
         F_LEN = (Word32)(L_WINDOW - 2*i);
@@ -115,6 +141,7 @@ void Autocorr(
         }while(--F_LEN!=0);
 
         L_sum1 += *p1 * *p2++;
+#endif
 
         L_sum1 = L_sum1<<norm;
         L_sum = L_sum<<norm;
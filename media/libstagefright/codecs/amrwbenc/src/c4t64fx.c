@@ -44,6 +44,7 @@
 #include "math_op.h"
 #include "acelp.h"
 #include "cnst.h"
+#include "simd_op.h"
 
 #include "q_pulse.h"
 
@@ -841,8 +842,12 @@ void cor_h_vec_30(
         Word16 cor_2[]                        /* (o) result of correlation (NB_POS elements) */
         )
 {
-    Word32 i, j, pos, corr;
-    Word16 *p0, *p1, *p2,*p3,*cor_x,*cor_y;
+    Word32 i, pos, corr;
+    Word16 *p0, *p3,*cor_x,*cor_y;
+#ifndef SIMD_OPT
+    Word32 j;
+    Word16 *p1, *p2;
+#endif
     Word32 L_sum1,L_sum2;
     cor_x = cor_1;
     cor_y = cor_2;
@@ -852,6 +857,10 @@ void cor_h_vec_30(
 
     for (i = 0; i < NB_POS; i+=2)
     {
+#ifdef SIMD_OPT
+        L_sum1 = vo_dot_product(h, &vec[pos], L_SUBFR - pos);
+        L_sum2 = vo_dot_product(h, &vec[pos - 3], L_SUBFR + 3 - pos);
+#else
         L_sum1 = L_sum2 = 0L;
         p1 = h;
         p2 = &vec[pos];
@@ -866,6 +875,7 @@ void cor_h_vec_30(
         L_sum2 += *p1++ * *p2++;
         L_sum2 += *p1++ * *p2++;
         L_sum2 += *p1++ * *p2++;
+#endif
 
         L_sum1 = (L_sum1 << 2);
         L_sum2 = (L_sum2 << 2);
@@ -876,6 +886,10 @@ void cor_h_vec_30(
         *cor_y++ = vo_mult(corr, sign[pos-3]) + (*p3++);
         pos += STEP;
 
+#ifdef SIMD_OPT
+        L_sum1 = vo_dot_product(h, &vec[pos], L_SUBFR - pos);
+        L_sum2 = vo_dot_product(h, &vec[pos - 3], L_SUBFR + 3 - pos);
+#else
         L_sum1 = L_sum2 = 0L;
         p1 = h;
         p2 = &vec[pos];
@@ -890,6 +904,7 @@ void cor_h_vec_30(
         L_sum2 += *p1++ * *p2++;
         L_sum2 += *p1++ * *p2++;
         L_sum2 += *p1++ * *p2++;
+#endif
 
         L_sum1 = (L_sum1 << 2);
         L_sum2 = (L_sum2 << 2);
@@ -913,8 +928,12 @@ void cor_h_vec_012(
         Word16 cor_2[]                        /* (o) result of correlation (NB_POS elements) */
         )
 {
-    Word32 i, j, pos, corr;
-    Word16 *p0, *p1, *p2,*p3,*cor_x,*cor_y;
+    Word32 i, pos, corr;
+    Word16 *p0, *p3,*cor_x,*cor_y;
+#ifndef SIMD_OPT
+    Word32 j;
+    Word16 *p1, *p2;
+#endif
     Word32 L_sum1,L_sum2;
     cor_x = cor_1;
     cor_y = cor_2;
@@ -924,6 +943,10 @@ void cor_h_vec_012(
 
     for (i = 0; i < NB_POS; i+=2)
     {
+#ifdef SIMD_OPT
+        L_sum1 = vo_dot_product(h, &vec[pos], L_SUBFR - pos);
+        L_sum2 = vo_dot_product(h, &vec[pos + 1], L_SUBFR - 1 - pos);
+#else
         L_sum1 = L_sum2 = 0L;
         p1 = h;
         p2 = &vec[pos];
@@ -933,6 +956,7 @@ void cor_h_vec_012(
             L_sum2 += *p1++ * *p2;
         }
         L_sum1 += *p1 * *p2;
+#endif
         L_sum1 = (L_sum1 << 2);
         L_sum2 = (L_sum2 << 2);
 
@@ -942,15 +966,20 @@ void cor_h_vec_012(
         cor_y[i] = vo_mult(corr, sign[pos + 1]) + (*p3++);
         pos += STEP;
 
+#ifdef SIMD_OPT
+        L_sum1 = vo_dot_product(h, &vec[pos], L_SUBFR - pos);
+        L_sum2 = vo_dot_product(h, &vec[pos + 1], L_SUBFR - 1 - pos);
+#else
         L_sum1 = L_sum2 = 0L;
         p1 = h;
         p2 = &vec[pos];
-        for (j= 62-pos;j >= 0; j--)
+        for (j=62-pos ;j >= 0; j--)
         {
             L_sum1 += *p1 * *p2++;
             L_sum2 += *p1++ * *p2;
         }
         L_sum1 += *p1 * *p2;
+#endif
         L_sum1 = (L_sum1 << 2);
         L_sum2 = (L_sum2 << 2);
 
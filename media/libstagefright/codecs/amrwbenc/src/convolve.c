@@ -24,6 +24,7 @@
 
 #include "typedef.h"
 #include "basic_op.h"
+#include "simd_op.h"
 
 #define UNUSED(x) (void)(x)
 
@@ -35,10 +36,33 @@ void Convolve (
           )
 {
     Word32  i, n;
+#ifdef SIMD_OPT
+    Word16 hr[64 + 8], xp[64 + 8];
+#else
     Word16 *tmpH,*tmpX;
+#endif
     Word32 s;
         UNUSED(L);
 
+#ifdef SIMD_OPT
+    /* y[n] is the product of x[] with h[n..0]; reverse h[] and pad both with zeros
+       so that every sum runs over whole vectors */
+    for (i = 0; i < 64; i++)
+    {
+        hr[i] = h[63 - i];
+        xp[i] = x[i];
+    }
+    for (i = 64; i < 64 + 8; i++)
+    {
+        hr[i] = 0;
+        xp[i] = 0;
+    }
+    for (n = 0; n < 64; n++)
+    {
+        s = vo_dot_product(xp, &hr[63 - n], (n + 8) & ~7);
+        y[n] = ((s<<1) + 0x8000)>>16;
+    }
+#else
     for (n = 0; n < 64;)
     {
         tmpH = h+n;
@@ -106,6 +130,7 @@ void Convolve (
         y[n] = ((s<<1) + 0x8000)>>16;
         n++;
     }
+#endif
     return;
 }
 
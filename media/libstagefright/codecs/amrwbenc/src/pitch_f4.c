@@ -27,6 +27,7 @@
 #include "math_op.h"
 #include "acelp.h"
 #include "cnst.h"
+#include "simd_op.h"
 
 #define UP_SAMP      4
 #define L_INTERPOL1  4
@@ -185,6 +186,9 @@ static void Norm_Corr(
 #endif
 
     /* Compute rounded down 1/sqrt(energy of xn[]) */
+#ifdef SIMD_OPT
+    L_tmp = vo_dot_product(xn, xn, 64);
+#else
     L_tmp = 0;
     for (i = 0; i < 64; i+=4)
     {
@@ -193,6 +197,7 @@ static void Norm_Corr(
         L_tmp += (xn[i+2] * xn[i+2]);
         L_tmp += (xn[i+3] * xn[i+3]);
     }
+#endif
 
     L_tmp = (L_tmp << 1) + 1;
     exp = norm_l(L_tmp);
@@ -205,6 +210,10 @@ static void Norm_Corr(
     for (t = t_min; t <= t_max; t++)
     {
         /* Compute correlation between xn[] and excf[] */
+#ifdef SIMD_OPT
+        L_tmp  = vo_dot_product(xn, excf, 64);
+        L_tmp1 = vo_dot_product(excf, excf, 64);
+#else
         L_tmp  = 0;
         L_tmp1 = 0;
         for (i = 0; i < 64; i+=4)
@@ -218,6 +227,7 @@ static void Norm_Corr(
             L_tmp  += (xn[i+3] * excf[i+3]);
             L_tmp1 += (excf[i+3] * excf[i+3]);
         }
+#endif
 
         L_tmp = (L_tmp << 1) + 1;
         L_tmp1 = (L_tmp1 << 1) + 1;
@@ -256,7 +266,12 @@ static void Norm_Corr(
         {
             k = -(t + 1);
             tmp = exc[k];
+#ifdef SIMD_OPT
+            vo_mult_add_vec(&excf[8], &excf[7], tmp, &h[8], 56);
+            for (i = 7; i > 0; i--)
+#else
             for (i = 63; i > 0; i--)
+#endif
             {
                 excf[i] = add1(vo_mult(tmp, h[i]), excf[i - 1]);
             }
@@ -74,3 +74,24 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_CFLAGS += -Werror
 
 include $(BUILD_SHARED_LIBRARY)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        test/sad_bench.cpp
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/src \
+        $(LOCAL_PATH)/../common/include
+
+LOCAL_CFLAGS := \
+    -DOSCL_IMPORT_REF= -D"OSCL_UNUSED_ARG(x)=(void)(x)" -DOSCL_EXPORT_REF=
+
+LOCAL_CFLAGS += -Werror
+
+LOCAL_MODULE := libstagefright_avcenc_sad_bench
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
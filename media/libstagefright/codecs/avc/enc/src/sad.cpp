@@ -17,6 +17,7 @@
  */
 #include "avcenc_lib.h"
 #include "sad_inline.h"
+#include "sad_simd.h"
 
 #define Cached_lx 176
 
@@ -69,7 +70,11 @@ int AVCSAD_Macroblock_C(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info)
 
     NUM_SAD_MB_CALL();
 
+#if USE_SAD_VECTOR
+    x10 = sad_mb_vec(ref, blk, dmin, lx);
+#else
     x10 = simd_sad_mb(ref, blk, dmin, lx);
+#endif
 
     return x10;
 }
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SAD_SIMD_H_
+#define _SAD_SIMD_H_
+
+/* 128-bit vector versions of the 16x16 integer and half-pel SAD. They return exactly
+ * what the C versions return, including the partial sum when the early dropout after
+ * a row triggers, so that mode decisions and the bitstream do not change. */
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_SAD_NEON 1
+#define USE_SAD_SSE2 0
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SAD_NEON 0
+#define USE_SAD_SSE2 1
+#else
+#define USE_SAD_NEON 0
+#define USE_SAD_SSE2 0
+#endif
+
+#define USE_SAD_VECTOR (USE_SAD_NEON || USE_SAD_SSE2)
+
+#if USE_SAD_NEON
+
+/* ref is a row of the picture with stride lx, blk is the 16x16 current MB with stride 16 */
+static inline int32 sad_mb_neon_row(uint16x8_t *acc, uint8x16_t ref, const uint8 *blk)
+{
+    uint8x16_t cur = vld1q_u8(blk);
+    *acc = vabal_u8(*acc, vget_low_u8(ref), vget_low_u8(cur));
+    *acc = vabal_u8(*acc, vget_high_u8(ref), vget_high_u8(cur));
+
+    uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(*acc));
+    return (int32)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+}
+
+static inline int32 sad_mb_vec(const uint8 *ref, const uint8 *blk, int dmin, int lx)
+{
+    uint16x8_t acc = vdupq_n_u16(0);
+    int32 sad = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        sad = sad_mb_neon_row(&acc, vld1q_u8(ref), blk);
+        if (sad > dmin)
+            break;
+        ref += lx;
+        blk += 16;
+    }
+    return sad;
+}
+
+static inline int32 sad_mb_xh_vec(const uint8 *ref, const uint8 *blk, int dmin, int rx)
+{
+    uint16x8_t acc = vdupq_n_u16(0);
+    int32 sad = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        /* vrhadd is (a + b + 1) >> 1 */
+        uint8x16_t pred = vrhaddq_u8(vld1q_u8(ref), vld1q_u8(ref + 1));
+        sad = sad_mb_neon_row(&acc, pred, blk);
+        if (sad > dmin)
+            break;
+        ref += rx;
+        blk += 16;
+    }
+    return sad;
+}
+
+static inline int32 sad_mb_yh_vec(const uint8 *ref, const uint8 *blk, int dmin, int rx)
+{
+    uint16x8_t acc = vdupq_n_u16(0);
+    int32 sad = 0;
+    uint8x16_t top = vld1q_u8(ref);
+    for (int i = 0; i < 16; i++)
+    {
+        uint8x16_t bottom = vld1q_u8(ref + rx);
+        sad = sad_mb_neon_row(&acc, vrhaddq_u8(top, bottom), blk);
+        if (sad > dmin)
+            break;
+        top = bottom;
+        ref += rx;
+        blk += 16;
+    }
+    return sad;
+}
+
+static inline int32 sad_mb_xhyh_vec(const uint8 *ref, const uint8 *blk, int dmin, int rx)
+{
+    uint16x8_t acc = vdupq_n_u16(0);
+    int32 sad = 0;
+    uint8x16_t a = vld1q_u8(ref);
+    uint8x16_t b = vld1q_u8(ref + 1);
+    uint16x8_t topLo = vaddl_u8(vget_low_u8(a), vget_low_u8(b));
+    uint16x8_t topHi = vaddl_u8(vget_high_u8(a), vget_high_u8(b));
+    for (int i = 0; i < 16; i++)
+    {
+        uint8x16_t c = vld1q_u8(ref + rx);
+        uint8x16_t d = vld1q_u8(ref + rx + 1);
+        uint16x8_t bottomLo = vaddl_u8(vget_low_u8(c), vget_low_u8(d));
+        uint16x8_t bottomHi = vaddl_u8(vget_high_u8(c), vget_high_u8(d));
+        /* vrshrn #2 is (sum + 2) >> 2 */
+        uint8x16_t pred = vcombine_u8(vrshrn_n_u16(vaddq_u16(topLo, bottomLo), 2),
+                                      vrshrn_n_u16(vaddq_u16(topHi, bottomHi), 2));
+        sad = sad_mb_neon_row(&acc, pred, blk);
+        if (sad > dmin)
+            break;
+        topLo = bottomLo;
+        topHi = bottomHi;
+        ref += rx;
+        blk += 16;
+    }
+    return sad;
+}
+
+#elif USE_SAD_SSE2
+
+static inline int32 sad_mb_sse2_row(__m128i *acc, __m128i ref, const uint8 *blk)
+{
+    __m128i cur = _mm_loadu_si128((const __m128i *)blk);
+    *acc = _mm_add_epi64(*acc, _mm_sad_epu8(ref, cur));
+    return _mm_cvtsi128_si32(*acc) + _mm_cvtsi128_si32(_mm_srli_si128(*acc, 8));
+}
+
+static inline int32 sad_mb_vec(const uint8 *ref, const uint8 *blk, int dmin, int lx)
+{
+    __m128i acc = _mm_setzero_si128();
+    int32 sad = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        sad = sad_mb_sse2_row(&acc, _mm_loadu_si128((const __m128i *)ref), blk);
+        if (sad > dmin)
+            break;
+        ref += lx;
+        blk += 16;
+    }
+    return sad;
+}
+
+static inline int32 sad_mb_xh_vec(const uint8 *ref, const uint8 *blk, int dmin, int rx)
+{
+    __m128i acc = _mm_setzero_si128();
+    int32 sad = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        /* pavgb is (a + b + 1) >> 1 */
+        __m128i pred = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)ref),
+                                    _mm_loadu_si128((const __m128i *)(ref + 1)));
+        sad = sad_mb_sse2_row(&acc, pred, blk);
+        if (sad > dmin)
+            break;
+        ref += rx;
+        blk += 16;
+    }
+    return sad;
+}
+
+static inline int32 sad_mb_yh_vec(const uint8 *ref, const uint8 *blk, int dmin, int rx)
+{
+    __m128i acc = _mm_setzero_si128();
+    int32 sad = 0;
+    __m128i top = _mm_loadu_si128((const __m128i *)ref);
+    for (int i = 0; i < 16; i++)
+    {
+        __m128i bottom = _mm_loadu_si128((const __m128i *)(ref + rx));
+        sad = sad_mb_sse2_row(&acc, _mm_avg_epu8(top, bottom), blk);
+        if (sad > dmin)
+            break;
+        top = bottom;
+        ref += rx;
+        blk += 16;
+    }
+    return sad;
+}
+
+static inline int32 sad_mb_xhyh_vec(const uint8 *ref, const uint8 *blk, int dmin, int rx)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    __m128i acc = _mm_setzero_si128();
+    int32 sad = 0;
+    __m128i a = _mm_loadu_si128((const __m128i *)ref);
+    __m128i b = _mm_loadu_si128((const __m128i *)(ref + 1));
+    __m128i topLo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+    __m128i topHi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+    for (int i = 0; i < 16; i++)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)(ref + rx));
+        __m128i d = _mm_loadu_si128((const __m128i *)(ref + rx + 1));
+        __m128i bottomLo = _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero));
+        __m128i bottomHi = _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero));
+        __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(topLo, bottomLo), two), 2);
+        __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(topHi, bottomHi), two), 2);
+        sad = sad_mb_sse2_row(&acc, _mm_packus_epi16(lo, hi), blk);
+        if (sad > dmin)
+            break;
+        topLo = bottomLo;
+        topHi = bottomHi;
+        ref += rx;
+        blk += 16;
+    }
+    return sad;
+}
+
+#endif
+
+#endif /* _SAD_SIMD_H_ */
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Checks that the vector SAD kernels of the encoder return exactly what the C versions
+// return, and measures how much faster they are.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "avcenc_lib.h"
+#include "sad_inline.h"
+#include "sad_simd.h"
+
+static const int kWidth = 176 + 32;     // matches the padded QCIF reference frame
+static const int kHeight = 144 + 32;
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// The C versions, including the early dropout after each row.
+static int32 sadC(uint8 *ref, uint8 *blk, int dmin, int lx)
+{
+    return simd_sad_mb(ref, blk, dmin, lx);
+}
+
+static int32 sadHalfPelC(uint8 *ref, uint8 *blk, int dmin, int rx, int xh, int yh)
+{
+    int sad = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        for (int j = 0; j < 16; j++)
+        {
+            int pred;
+            if (xh && yh)
+                pred = (ref[j] + ref[j + 1] + ref[j + rx] + ref[j + rx + 1] + 2) >> 2;
+            else if (xh)
+                pred = (ref[j] + ref[j + 1] + 1) >> 1;
+            else
+                pred = (ref[j] + ref[j + rx] + 1) >> 1;
+            sad += AVC_ABS(pred - blk[j]);
+        }
+        if (sad > dmin)
+            return sad;
+        ref += rx;
+        blk += 16;
+    }
+    return sad;
+}
+
+#if USE_SAD_VECTOR
+static int32 sadHalfPelVec(uint8 *ref, uint8 *blk, int dmin, int rx, int xh, int yh)
+{
+    if (xh && yh)
+        return sad_mb_xhyh_vec(ref, blk, dmin, rx);
+    if (xh)
+        return sad_mb_xh_vec(ref, blk, dmin, rx);
+    return sad_mb_yh_vec(ref, blk, dmin, rx);
+}
+#endif
+
+struct Candidate
+{
+    int offset;
+    int dmin;
+    int xh;
+    int yh;
+};
+
+int main(int argc, char **argv)
+{
+    int numCandidates = 1000000;
+    int res;
+    while ((res = getopt(argc, argv, "n:")) >= 0)
+    {
+        if (res == 'n' && atoi(optarg) > 0)
+        {
+            numCandidates = atoi(optarg);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n <number of candidates>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+#if !USE_SAD_VECTOR
+    printf("no vector SAD kernels for this architecture\n");
+    return 0;
+#else
+    uint8 *frame = (uint8 *)malloc(kWidth * kHeight);
+    uint8 blk[256];
+    Candidate *candidates = (Candidate *)malloc(numCandidates * sizeof(Candidate));
+
+    // A smooth picture with noise, so that SADs and early dropouts are realistic.
+    srand(1);
+    for (int y = 0; y < kHeight; y++)
+    {
+        for (int x = 0; x < kWidth; x++)
+        {
+            frame[y * kWidth + x] = (uint8)((x * 3 + y * 2 + rand() % 24) & 0xFF);
+        }
+    }
+    for (int i = 0; i < 256; i++)
+    {
+        blk[i] = frame[40 * kWidth + 40 + (i / 16) * kWidth + i % 16] ^ (rand() % 8);
+    }
+    for (int i = 0; i < numCandidates; i++)
+    {
+        candidates[i].offset = (rand() % (kHeight - 17)) * kWidth + rand() % (kWidth - 17);
+        candidates[i].dmin = rand() % 8 == 0 ? 65535 : 500 + rand() % 3000;
+        candidates[i].xh = rand() % 2;
+        candidates[i].yh = candidates[i].xh ? rand() % 2 : 1;
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < numCandidates; i++)
+    {
+        const Candidate &c = candidates[i];
+        if (sadC(frame + c.offset, blk, c.dmin, kWidth)
+                != sad_mb_vec(frame + c.offset, blk, c.dmin, kWidth)
+                || sadHalfPelC(frame + c.offset, blk, c.dmin, kWidth, c.xh, c.yh)
+                != sadHalfPelVec(frame + c.offset, blk, c.dmin, kWidth, c.xh, c.yh))
+        {
+            mismatches++;
+        }
+    }
+
+    int64_t sum = 0;
+    int64_t start = nowNs();
+    for (int i = 0; i < numCandidates; i++)
+    {
+        sum += sadC(frame + candidates[i].offset, blk, candidates[i].dmin, kWidth);
+    }
+    const int64_t intCNs = nowNs() - start;
+
+    start = nowNs();
+    for (int i = 0; i < numCandidates; i++)
+    {
+        sum += sad_mb_vec(frame + candidates[i].offset, blk, candidates[i].dmin, kWidth);
+    }
+    const int64_t intVecNs = nowNs() - start;
+
+    start = nowNs();
+    for (int i = 0; i < numCandidates; i++)
+    {
+        const Candidate &c = candidates[i];
+        sum += sadHalfPelC(frame + c.offset, blk, c.dmin, kWidth, c.xh, c.yh);
+    }
+    const int64_t halfCNs = nowNs() - start;
+
+    start = nowNs();
+    for (int i = 0; i < numCandidates; i++)
+    {
+        const Candidate &c = candidates[i];
+        sum += sadHalfPelVec(frame + c.offset, blk, c.dmin, kWidth, c.xh, c.yh);
+    }
+    const int64_t halfVecNs = nowNs() - start;
+
+    printf("%s, %d candidates, %d mismatches (checksum %lld)\n",
+           USE_SAD_NEON ? "NEON" : "SSE2", numCandidates, mismatches, (long long)sum);
+    printf("integer SAD:  C %.1f ns, vector %.1f ns, speedup %.2fx\n",
+           (double)intCNs / numCandidates, (double)intVecNs / numCandidates,
+           (double)intCNs / intVecNs);
+    printf("half-pel SAD: C %.1f ns, vector %.1f ns, speedup %.2fx\n",
+           (double)halfCNs / numCandidates, (double)halfVecNs / numCandidates,
+           (double)halfCNs / halfVecNs);
+
+    free(candidates);
+    free(frame);
+    return mismatches != 0;
+#endif
+}
@@ -120,7 +120,8 @@ SoftAVC::SoftAVC(
       mIvColorFormat(IV_YUV_420P),
       mChangingResolution(false),
       mSignalledError(false),
-      mStride(mWidth){
+      mStride(mWidth),
+      mDecodeOrderOutput(false){
     initPorts(
             kNumBuffers, INPUT_BUF_SIZE, kNumBuffers, CODEC_MIME_TYPE);
 
@@ -192,7 +193,8 @@ status_t SoftAVC::setParams(size_t stride) {
     s_ctl_ip.u4_disp_wd = (UWORD32)stride;
     s_ctl_ip.e_frm_skip_mode = IVD_SKIP_NONE;
 
-    s_ctl_ip.e_frm_out_mode = IVD_DISPLAY_FRAME_OUT;
+    // In low latency mode the decoder does not hold frames back for reordering.
+    s_ctl_ip.e_frm_out_mode = mLowLatency ? IVD_DECODE_FRAME_OUT : IVD_DISPLAY_FRAME_OUT;
     s_ctl_ip.e_vid_dec_mode = IVD_DECODE_FRAME;
     s_ctl_ip.e_cmd = IVD_CMD_VIDEO_CTL;
     s_ctl_ip.e_sub_cmd = IVD_CMD_CTL_SETPARAMS;
@@ -200,6 +202,7 @@ status_t SoftAVC::setParams(size_t stride) {
     s_ctl_op.u4_size = sizeof(ivd_ctl_set_config_op_t);
 
     ALOGV("Set the run-time (dynamic) parameters stride = %zu", stride);
+    mDecodeOrderOutput = mLowLatency;
     status = ivdec_api_function(mCodecCtx, (void *)&s_ctl_ip, (void *)&s_ctl_op);
 
     if (status != IV_SUCCESS) {
@@ -294,7 +297,10 @@ status_t SoftAVC::setFlushMode() {
 status_t SoftAVC::initDecoder() {
     IV_API_CALL_STATUS_T status;
 
-    mNumCores = GetCPUCoreCount();
+    mNumCores = mThreadCount > 0 ? mThreadCount : threadBudget();
+    if (mNumCores == 0) {
+        mNumCores = GetCPUCoreCount();
+    }
     mCodecCtx = NULL;
 
     mStride = outputBufferWidth();
@@ -488,7 +494,14 @@ void SoftAVC::onQueueFilled(OMX_U32 portIndex) {
             return;
         }
     }
-    if (outputBufferWidth() != mStride) {
+    uint32_t numCores = mThreadCount > 0 ? mThreadCount : threadBudget();
+    if (numCores > 0 && numCores != mNumCores) {
+        /* The thread count was configured, or the share of the CPUs changed,
+         * after the decoder was created */
+        mNumCores = numCores;
+        setNumCores();
+    }
+    if (outputBufferWidth() != mStride || mLowLatency != mDecodeOrderOutput) {
         /* Set the run-time (dynamic) parameters */
         mStride = outputBufferWidth();
         setParams(mStride);
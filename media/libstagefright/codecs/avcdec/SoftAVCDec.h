@@ -98,6 +98,7 @@ private:
     bool mFlushNeeded;
     bool mSignalledError;
     size_t mStride;
+    bool mDecodeOrderOutput; // frames are output in decode order, see mLowLatency
 
     status_t initDecoder();
     status_t deInitDecoder();
@@ -2,6 +2,7 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
+        FlacEncoderPool.cpp \
         SoftFlacEncoder.cpp
 
 LOCAL_C_INCLUDES := \
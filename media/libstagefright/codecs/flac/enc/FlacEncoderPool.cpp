@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FlacEncoderPool"
+#include <utils/Log.h>
+
+#include "FlacEncoderPool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/ThreadDefs.h>
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace android {
+
+// CRC-8 (x^8 + x^2 + x + 1) of the frame header and CRC-16
+// (x^16 + x^15 + x^2 + 1) of the whole frame, as defined by FLAC.
+static uint8_t gCrc8Table[256];
+static uint16_t gCrc16Table[256];
+static pthread_once_t gCrcTablesOnce = PTHREAD_ONCE_INIT;
+
+static void InitCrcTables() {
+    for (unsigned i = 0; i < 256; ++i) {
+        uint8_t crc8 = i;
+        uint16_t crc16 = i << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc8 = (crc8 & 0x80) ? (crc8 << 1) ^ 0x07 : crc8 << 1;
+            crc16 = (crc16 & 0x8000) ? (crc16 << 1) ^ 0x8005 : crc16 << 1;
+        }
+        gCrc8Table[i] = crc8;
+        gCrc16Table[i] = crc16;
+    }
+}
+
+static uint8_t Crc8(const uint8_t *data, size_t size) {
+    uint8_t crc = 0;
+    while (size-- > 0) {
+        crc = gCrc8Table[crc ^ *data++];
+    }
+    return crc;
+}
+
+static uint16_t Crc16(uint16_t crc, const uint8_t *data, size_t size) {
+    while (size-- > 0) {
+        crc = (crc << 8) ^ gCrc16Table[(crc >> 8) ^ *data++];
+    }
+    return crc;
+}
+
+// Writes a frame number with the UTF-8 like coding of FLAC frame headers and
+// returns the number of bytes used, at most 6 for numbers below 2^31.
+static size_t WriteFrameNumber(uint8_t *out, uint32_t number) {
+    if (number < 0x80) {
+        out[0] = number;
+        return 1;
+    }
+
+    size_t size = number < 0x800 ? 2
+            : number < 0x10000 ? 3
+            : number < 0x200000 ? 4
+            : number < 0x4000000 ? 5
+            : 6;
+    for (size_t i = size - 1; i > 0; --i) {
+        out[i] = 0x80 | (number & 0x3f);
+        number >>= 6;
+    }
+    out[0] = (0xff00 >> size) | number;
+    return size;
+}
+
+// Returns the size of the coded frame number starting with the given byte,
+// or 0 if it is not a valid first byte.
+static size_t FrameNumberSize(uint8_t first) {
+    if (!(first & 0x80)) {
+        return 1;
+    }
+    for (size_t size = 2; size <= 6; ++size) {
+        if ((first & (0xff80 >> size)) == (uint8_t)(0xff00 >> size)) {
+            return size;
+        }
+    }
+    return 0;
+}
+
+FlacEncoderPool::WorkerThread::WorkerThread(FlacEncoderPool *pool)
+    : Thread(false /* canCallJava */),
+      mPool(pool),
+      mEncoder(FLAC__stream_encoder_new()),
+      mJob(NULL) {
+}
+
+FlacEncoderPool::WorkerThread::~WorkerThread() {
+    if (mEncoder != NULL) {
+        FLAC__stream_encoder_delete(mEncoder);
+        mEncoder = NULL;
+    }
+}
+
+status_t FlacEncoderPool::WorkerThread::initCheck() const {
+    return mEncoder != NULL ? OK : NO_MEMORY;
+}
+
+bool FlacEncoderPool::WorkerThread::threadLoop() {
+    Job *job = mPool->acquireJobToEncode();
+    if (job == NULL) {
+        return false;
+    }
+
+    encode(job);
+
+    Mutex::Autolock autoLock(mPool->mLock);
+    job->mState = Job::DONE;
+    mPool->mDoneCondition.signal();
+    return true;
+}
+
+void FlacEncoderPool::WorkerThread::encode(Job *job) {
+    mJob = job;
+    job->mEncoded.clear();
+
+    // The encoder is set up again for every job, FLAC__stream_encoder_finish()
+    // reverts it to the defaults.
+    FLAC__bool ok = true;
+    ok = ok && FLAC__stream_encoder_set_channels(mEncoder, mPool->mNumChannels);
+    ok = ok && FLAC__stream_encoder_set_sample_rate(mEncoder, mPool->mSampleRate);
+    ok = ok && FLAC__stream_encoder_set_bits_per_sample(mEncoder, 16);
+    ok = ok && FLAC__stream_encoder_set_compression_level(mEncoder, mPool->mCompressionLevel);
+    ok = ok && FLAC__stream_encoder_set_blocksize(mEncoder, mPool->mBlockSize);
+    ok = ok && FLAC__stream_encoder_set_verify(mEncoder, false);
+    ok = ok && FLAC__STREAM_ENCODER_INIT_STATUS_OK ==
+            FLAC__stream_encoder_init_stream(mEncoder,
+                    WriteCallback /*write_callback*/,
+                    NULL /*seek_callback*/,
+                    NULL /*tell_callback*/,
+                    NULL /*metadata_callback*/,
+                    (void *) this /*client_data*/);
+    ok = ok && FLAC__stream_encoder_process_interleaved(mEncoder, job->mPcm, job->mNumFrames);
+
+    // This also encodes the last block, which is short at the end of the stream.
+    if (!FLAC__stream_encoder_finish(mEncoder) || !ok) {
+        ALOGE("error encoding %zu frames at sample %llu",
+                job->mNumFrames, (unsigned long long)job->mFirstSample);
+    }
+
+    mJob = NULL;
+}
+
+// static
+FLAC__StreamEncoderWriteStatus FlacEncoderPool::WorkerThread::WriteCallback(
+        const FLAC__StreamEncoder * /* encoder */,
+        const FLAC__byte buffer[],
+        size_t bytes,
+        unsigned samples,
+        unsigned current_frame,
+        void *client_data) {
+    if (samples == 0) {
+        // the stream header of each job, not part of the output
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+    }
+
+    WorkerThread *me = (WorkerThread *)client_data;
+    const FlacEncoderPool *pool = me->mPool;
+    Job *job = me->mJob;
+
+    EncodedFrame frame;
+    frame.mFirstSample = job->mFirstSample + (uint64_t)current_frame * pool->mBlockSize;
+    frame.mData = Renumber(buffer, bytes, frame.mFirstSample / pool->mBlockSize);
+    if (frame.mData == NULL) {
+        ALOGE("unexpected frame header");
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+    }
+    job->mEncoded.push_back(frame);
+
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+FlacEncoderPool::FlacEncoderPool(
+        size_t numThreads, unsigned numChannels, unsigned sampleRate,
+        unsigned compressionLevel, unsigned blockSize)
+    : mNumChannels(numChannels),
+      mSampleRate(sampleRate),
+      mCompressionLevel(compressionLevel),
+      mBlockSize(blockSize),
+      mJobFrames(blockSize * kBlocksPerJob),
+      mNumThreads(0),
+      mNumJobs(2 * (numThreads < kMaxThreads ? numThreads : kMaxThreads)),
+      mFilling(0),
+      mNextToEncode(0),
+      mNextToRead(0),
+      mNumFramesWritten(0),
+      mExit(false),
+      mInitCheck(OK) {
+    pthread_once(&gCrcTablesOnce, InitCrcTables);
+
+    for (size_t i = 0; i < mNumJobs; ++i) {
+        Job *job = &mJobs[i];
+        job->mState = Job::FREE;
+        job->mFirstSample = 0;
+        job->mNumFrames = 0;
+        job->mPcm = (FLAC__int32 *)malloc(sizeof(FLAC__int32) * mJobFrames * mNumChannels);
+        if (job->mPcm == NULL) {
+            mInitCheck = NO_MEMORY;
+        }
+    }
+
+    for (size_t i = 0; i < mNumJobs / 2 && mInitCheck == OK; ++i) {
+        sp<WorkerThread> thread = new WorkerThread(this);
+        mInitCheck = thread->initCheck();
+        if (mInitCheck == OK) {
+            mInitCheck = thread->run("FlacEncoder", ANDROID_PRIORITY_AUDIO);
+        }
+        if (mInitCheck == OK) {
+            mThreads[mNumThreads++] = thread;
+        }
+    }
+    ALOGV("%zu threads, %zu frames per job", mNumThreads, mJobFrames);
+}
+
+FlacEncoderPool::~FlacEncoderPool() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mExit = true;
+        mWorkCondition.broadcast();
+    }
+    for (size_t i = 0; i < mNumThreads; ++i) {
+        mThreads[i]->requestExitAndWait();
+        mThreads[i].clear();
+    }
+    for (size_t i = 0; i < mNumJobs; ++i) {
+        free(mJobs[i].mPcm);
+        mJobs[i].mPcm = NULL;
+    }
+}
+
+status_t FlacEncoderPool::initCheck() const {
+    return mInitCheck;
+}
+
+void FlacEncoderPool::write(const int16_t *pcm, size_t numFrames) {
+    while (numFrames > 0) {
+        Job *job = &mJobs[mFilling];
+        if (job->mState != Job::FILLING) {
+            Mutex::Autolock autoLock(mLock);
+            for (;;) {
+                collect_l();
+                if (job->mState == Job::FREE) {
+                    break;
+                }
+                mDoneCondition.wait(mLock);
+            }
+            job->mState = Job::FILLING;
+            job->mFirstSample = mNumFramesWritten;
+            job->mNumFrames = 0;
+        }
+
+        size_t n = mJobFrames - job->mNumFrames;
+        if (n > numFrames) {
+            n = numFrames;
+        }
+        ConvertPcm16(job->mPcm + job->mNumFrames * mNumChannels, pcm, n * mNumChannels);
+        job->mNumFrames += n;
+        mNumFramesWritten += n;
+        pcm += n * mNumChannels;
+        numFrames -= n;
+
+        if (job->mNumFrames == mJobFrames) {
+            hand(job);
+        }
+    }
+}
+
+void FlacEncoderPool::flush() {
+    Job *job = &mJobs[mFilling];
+    if (job->mState == Job::FILLING) {
+        hand(job);
+    }
+}
+
+bool FlacEncoderPool::read(sp<ABuffer> *frame, uint64_t *firstSample, bool wait) {
+    Mutex::Autolock autoLock(mLock);
+    collect_l();
+    while (wait && mFrames.empty()
+            && (mJobs[mNextToRead].mState == Job::QUEUED
+                    || mJobs[mNextToRead].mState == Job::ENCODING)) {
+        mDoneCondition.wait(mLock);
+        collect_l();
+    }
+
+    if (mFrames.empty()) {
+        return false;
+    }
+
+    *frame = mFrames.begin()->mData;
+    *firstSample = mFrames.begin()->mFirstSample;
+    mFrames.erase(mFrames.begin());
+    return true;
+}
+
+bool FlacEncoderPool::idle() const {
+    Mutex::Autolock autoLock(mLock);
+    return mFrames.empty() && mJobs[mNextToRead].mState == Job::FREE;
+}
+
+void FlacEncoderPool::reset() {
+    Mutex::Autolock autoLock(mLock);
+    for (size_t i = 0; i < mNumJobs; ++i) {
+        if (mJobs[i].mState == Job::QUEUED) {
+            mJobs[i].mState = Job::FREE;
+        }
+    }
+    for (size_t i = 0; i < mNumJobs; ++i) {
+        while (mJobs[i].mState == Job::ENCODING) {
+            mDoneCondition.wait(mLock);
+        }
+        mJobs[i].mState = Job::FREE;
+        mJobs[i].mEncoded.clear();
+    }
+    mFrames.clear();
+    mFilling = 0;
+    mNextToEncode = 0;
+    mNextToRead = 0;
+    mNumFramesWritten = 0;
+}
+
+FlacEncoderPool::Job *FlacEncoderPool::acquireJobToEncode() {
+    Mutex::Autolock autoLock(mLock);
+    while (!mExit && mJobs[mNextToEncode].mState != Job::QUEUED) {
+        mWorkCondition.wait(mLock);
+    }
+    if (mExit) {
+        return NULL;
+    }
+
+    Job *job = &mJobs[mNextToEncode];
+    job->mState = Job::ENCODING;
+    mNextToEncode = (mNextToEncode + 1) % mNumJobs;
+    return job;
+}
+
+void FlacEncoderPool::hand(Job *job) {
+    Mutex::Autolock autoLock(mLock);
+    job->mState = Job::QUEUED;
+    mFilling = (mFilling + 1) % mNumJobs;
+    mWorkCondition.signal();
+}
+
+// Moves the frames of the jobs done, in stream order, to mFrames.
+void FlacEncoderPool::collect_l() {
+    while (mJobs[mNextToRead].mState == Job::DONE) {
+        Job *job = &mJobs[mNextToRead];
+        while (!job->mEncoded.empty()) {
+            mFrames.push_back(*job->mEncoded.begin());
+            job->mEncoded.erase(job->mEncoded.begin());
+        }
+        job->mState = Job::FREE;
+        mNextToRead = (mNextToRead + 1) % mNumJobs;
+    }
+}
+
+// Each job's encoder numbers its frames from 0. Rewrites the frame number of a
+// fixed block size frame, which changes the size of the header, and the two
+// CRCs that cover it.
+// static
+sp<ABuffer> FlacEncoderPool::Renumber(
+        const FLAC__byte *frame, size_t size, uint32_t frameNumber) {
+    // sync code, block size and sample rate, channels and sample size
+    static const size_t kFixedHeaderSize = 4;
+
+    if (size < kFixedHeaderSize + 1 + 1 + 2
+            || frame[0] != 0xff || frame[1] != 0xf8 /* fixed block size */) {
+        return NULL;
+    }
+
+    const size_t numberSize = FrameNumberSize(frame[kFixedHeaderSize]);
+    if (numberSize == 0) {
+        return NULL;
+    }
+
+    // optional block size and sample rate, stored after the frame number
+    const unsigned blockSizeCode = frame[2] >> 4;
+    const unsigned sampleRateCode = frame[2] & 0x0f;
+    size_t extraSize = blockSizeCode == 6 ? 1 : blockSizeCode == 7 ? 2 : 0;
+    extraSize += sampleRateCode == 12 ? 1 : (sampleRateCode == 13 || sampleRateCode == 14) ? 2 : 0;
+
+    const size_t headerSize = kFixedHeaderSize + numberSize + extraSize;
+    if (size < headerSize + 1 + 2) {
+        return NULL;
+    }
+    const size_t bodySize = size - headerSize - 1 - 2;
+
+    uint8_t header[kFixedHeaderSize + 6 + 4 + 1];
+    memcpy(header, frame, kFixedHeaderSize);
+    size_t newHeaderSize = kFixedHeaderSize;
+    newHeaderSize += WriteFrameNumber(header + newHeaderSize, frameNumber);
+    memcpy(header + newHeaderSize, frame + kFixedHeaderSize + numberSize, extraSize);
+    newHeaderSize += extraSize;
+    header[newHeaderSize] = Crc8(header, newHeaderSize);
+    ++newHeaderSize;
+
+    sp<ABuffer> out = new ABuffer(newHeaderSize + bodySize + 2);
+    uint8_t *dst = out->data();
+    memcpy(dst, header, newHeaderSize);
+    memcpy(dst + newHeaderSize, frame + headerSize + 1, bodySize);
+
+    const uint16_t crc = Crc16(0, dst, newHeaderSize + bodySize);
+    dst[newHeaderSize + bodySize] = crc >> 8;
+    dst[newHeaderSize + bodySize + 1] = crc & 0xff;
+    return out;
+}
+
+// static
+void FlacEncoderPool::ConvertPcm16(FLAC__int32 *dst, const int16_t *src, size_t count) {
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+    for (; count >= 8; count -= 8, src += 8, dst += 8) {
+        const int16x8_t v = vld1q_s16(src);
+        vst1q_s32(dst, vmovl_s16(vget_low_s16(v)));
+        vst1q_s32(dst + 4, vmovl_s16(vget_high_s16(v)));
+    }
+#elif defined(__SSE2__)
+    for (; count >= 8; count -= 8, src += 8, dst += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst),
+                _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4),
+                _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+    }
+#endif
+    while (count-- > 0) {
+        *dst++ = *src++;
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FLAC_ENCODER_POOL_H_
+
+#define FLAC_ENCODER_POOL_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <utils/Condition.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+#include <utils/Thread.h>
+
+#include "FLAC/stream_encoder.h"
+
+namespace android {
+
+// Encodes a FLAC stream on several threads. The input is cut into jobs of
+// kBlocksPerJob blocks, each job is encoded by its own libFLAC stream encoder
+// on a worker thread, and the frames come back in stream order with their
+// headers renumbered as if a single encoder had produced them. FLAC frames are
+// independent, so the result is a valid fixed block size stream.
+//
+// All methods are called from the component's thread only.
+struct FlacEncoderPool {
+    enum {
+        kMaxThreads = 8,
+        kBlocksPerJob = 8,
+    };
+
+    // blockSize must be set, as the frame numbering depends on it.
+    FlacEncoderPool(size_t numThreads, unsigned numChannels, unsigned sampleRate,
+            unsigned compressionLevel, unsigned blockSize);
+    ~FlacEncoderPool();
+
+    status_t initCheck() const;
+
+    // Appends interleaved 16 bit frames to the stream, and hands out each job
+    // as it fills. Blocks while every job is waiting to be encoded.
+    void write(const int16_t *pcm, size_t numFrames);
+
+    // Hands out the frames written since the last full job, ending the stream.
+    void flush();
+
+    // Returns the next encoded FLAC frame and the index of its first sample
+    // in the stream. Returns false if no frame is ready, after waiting for the
+    // encoders if wait is true.
+    bool read(sp<ABuffer> *frame, uint64_t *firstSample, bool wait);
+
+    // True if every frame written so far has been read.
+    bool idle() const;
+
+    // Drops all encoded and pending data and starts a new stream.
+    void reset();
+
+    // Widens 16 bit samples to the 32 bit samples libFLAC takes.
+    static void ConvertPcm16(FLAC__int32 *dst, const int16_t *src, size_t count);
+
+private:
+    struct EncodedFrame {
+        sp<ABuffer> mData;
+        uint64_t mFirstSample;
+    };
+
+    struct Job {
+        enum State {
+            FREE,
+            FILLING,
+            QUEUED,
+            ENCODING,
+            DONE,
+        };
+
+        State mState;
+        uint64_t mFirstSample;
+        size_t mNumFrames;
+        FLAC__int32 *mPcm;
+        List<EncodedFrame> mEncoded;
+    };
+
+    struct WorkerThread : public Thread {
+        WorkerThread(FlacEncoderPool *pool);
+        virtual ~WorkerThread();
+
+        status_t initCheck() const;
+
+    private:
+        FlacEncoderPool *mPool;
+        FLAC__StreamEncoder *mEncoder;
+        Job *mJob;
+
+        virtual bool threadLoop();
+
+        void encode(Job *job);
+
+        static FLAC__StreamEncoderWriteStatus WriteCallback(
+                const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[],
+                size_t bytes, unsigned samples, unsigned current_frame, void *client_data);
+
+        DISALLOW_EVIL_CONSTRUCTORS(WorkerThread);
+    };
+
+    friend struct WorkerThread;
+
+    const unsigned mNumChannels;
+    const unsigned mSampleRate;
+    const unsigned mCompressionLevel;
+    const unsigned mBlockSize;
+    const size_t mJobFrames;
+
+    size_t mNumThreads;
+    sp<WorkerThread> mThreads[kMaxThreads];
+
+    // Twice as many jobs as threads, so that one can fill while the workers
+    // are busy.
+    size_t mNumJobs;
+    Job mJobs[2 * kMaxThreads];
+
+    // The job taking written frames, the next one to hand to a worker and the
+    // next one to read from, as indices into mJobs which are used in turn.
+    size_t mFilling;
+    size_t mNextToEncode;
+    size_t mNextToRead;
+    uint64_t mNumFramesWritten;
+
+    // Encoded frames of the jobs read so far, in stream order.
+    List<EncodedFrame> mFrames;
+
+    mutable Mutex mLock;
+    Condition mWorkCondition;
+    Condition mDoneCondition;
+    bool mExit;
+
+    status_t mInitCheck;
+
+    Job *acquireJobToEncode();
+    void hand(Job *job);
+    void collect_l();
+
+    static sp<ABuffer> Renumber(
+            const FLAC__byte *frame, size_t size, uint32_t frameNumber);
+
+    DISALLOW_EVIL_CONSTRUCTORS(FlacEncoderPool);
+};
+
+}  // namespace android
+
+#endif  // FLAC_ENCODER_POOL_H_
@@ -54,6 +54,12 @@ SoftFlacEncoder::SoftFlacEncoder(
       mNumChannels(1),
       mSampleRate(44100),
       mCompressionLevel(FLAC_COMPRESSION_LEVEL_DEFAULT),
+      mBlockSize(0),
+      mNumThreads(1),
+      mEncoderPool(NULL),
+      mSawInputEOS(false),
+      mAnchorTimeValid(false),
+      mAnchorTimeUs(0),
       mEncoderWriteData(false),
       mEncoderReturnedEncodedData(false),
       mEncoderReturnedNbBytes(0),
@@ -83,6 +89,8 @@ SoftFlacEncoder::SoftFlacEncoder(
 
 SoftFlacEncoder::~SoftFlacEncoder() {
     ALOGV("SoftFlacEncoder::~SoftFlacEncoder()");
+    delete mEncoderPool;
+    mEncoderPool = NULL;
     if (mFlacStreamEncoder != NULL) {
         FLAC__stream_encoder_delete(mFlacStreamEncoder);
         mFlacStreamEncoder = NULL;
@@ -262,6 +270,39 @@ OMX_ERRORTYPE SoftFlacEncoder::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kFlacBlockSizeIndex:
+        {
+            const OMX_PARAM_U32TYPE *blockSizeParams = (const OMX_PARAM_U32TYPE *)params;
+
+            if (!isValidOMXParam(blockSizeParams)) {
+                return OMX_ErrorBadParameter;
+            }
+
+            if (blockSizeParams->nU32 != 0 && (blockSizeParams->nU32 < kMinBlockSize
+                    || blockSizeParams->nU32 > kMaxBlockSize)) {
+                ALOGE("block size must be between %d and %d", kMinBlockSize, kMaxBlockSize);
+                return OMX_ErrorUnsupportedSetting;
+            }
+
+            mBlockSize = blockSizeParams->nU32;
+            return OMX_ErrorNone;
+        }
+
+        case kThreadCountIndex:
+        {
+            const OMX_PARAM_U32TYPE *threadCountParams = (const OMX_PARAM_U32TYPE *)params;
+
+            if (!isValidOMXParam(threadCountParams)) {
+                return OMX_ErrorBadParameter;
+            }
+
+            mNumThreads = threadCountParams->nU32;
+            if (mNumThreads > FlacEncoderPool::kMaxThreads) {
+                mNumThreads = FlacEncoderPool::kMaxThreads;
+            }
+            return OMX_ErrorNone;
+        }
+
         case OMX_IndexParamPortDefinition:
         {
             OMX_PARAM_PORTDEFINITIONTYPE *defParams =
@@ -288,6 +329,21 @@ OMX_ERRORTYPE SoftFlacEncoder::internalSetParameter(
     }
 }
 
+OMX_ERRORTYPE SoftFlacEncoder::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, "OMX.google.android.index.flacBlockSize")) {
+        *(int32_t*)index = kFlacBlockSizeIndex;
+        return OMX_ErrorNone;
+    }
+
+    if (!strcmp(name, "OMX.google.android.index.threadCount")) {
+        *(int32_t*)index = kThreadCountIndex;
+        return OMX_ErrorNone;
+    }
+
+    return SimpleSoftOMXComponent::getExtensionIndex(name, index);
+}
+
 void SoftFlacEncoder::onQueueFilled(OMX_U32 portIndex) {
     UNUSED_UNLESS_VERBOSE(portIndex);
     ALOGV("SoftFlacEncoder::onQueueFilled(portIndex=%d)", portIndex);
@@ -296,6 +352,11 @@ void SoftFlacEncoder::onQueueFilled(OMX_U32 portIndex) {
         return;
     }
 
+    if (mNumThreads > 1) {
+        onQueueFilledParallel();
+        return;
+    }
+
     List<BufferInfo *> &inQueue = getPortQueue(0);
     List<BufferInfo *> &outQueue = getPortQueue(1);
 
@@ -339,9 +400,7 @@ void SoftFlacEncoder::onQueueFilled(OMX_U32 portIndex) {
         const OMX_S16 * const pcm16 = reinterpret_cast<OMX_S16 *>(inHeader->pBuffer);
 
         CHECK_LE(nbInputSamples, 2 * kMaxNumSamplesPerFrame);
-        for (unsigned i=0 ; i < nbInputSamples ; i++) {
-            mInputBufferPcm32[i] = (FLAC__int32) pcm16[i];
-        }
+        FlacEncoderPool::ConvertPcm16(mInputBufferPcm32, pcm16, nbInputSamples);
         ALOGV(" about to encode %u samples per channel", nbInputFrames);
         FLAC__bool ok = FLAC__stream_encoder_process_interleaved(
                         mFlacStreamEncoder,
@@ -375,6 +434,120 @@ void SoftFlacEncoder::onQueueFilled(OMX_U32 portIndex) {
     }
 }
 
+void SoftFlacEncoder::onQueueFilledParallel() {
+    List<BufferInfo *> &inQueue = getPortQueue(0);
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+
+    if (mEncoderPool == NULL) {
+        mEncoderPool = new FlacEncoderPool(
+                mNumThreads, mNumChannels, mSampleRate, mCompressionLevel, blockSize());
+        if (mEncoderPool->initCheck() != OK) {
+            ALOGE("error starting the encoder threads");
+            mSignalledError = true;
+            notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+            return;
+        }
+    }
+
+    for (;;) {
+        // Return encoded frames first, one per output buffer. Once the input has
+        // ended, wait for the workers to finish the last blocks.
+        while (!outQueue.empty()) {
+            sp<ABuffer> frame;
+            uint64_t firstSample;
+            if (!mEncoderPool->read(&frame, &firstSample, mSawInputEOS /* wait */)) {
+                break;
+            }
+
+            BufferInfo *outInfo = *outQueue.begin();
+            OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+            if (frame->size() > outHeader->nAllocLen) {
+                ALOGE("output buffer too small (%u) for %zu bytes",
+                        outHeader->nAllocLen, frame->size());
+                mSignalledError = true;
+                notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+                return;
+            }
+
+            memcpy(outHeader->pBuffer, frame->data(), frame->size());
+            outHeader->nOffset = 0;
+            outHeader->nFilledLen = frame->size();
+            outHeader->nFlags = 0;
+            outHeader->nTimeStamp = mAnchorTimeUs + firstSample * 1000000ll / mSampleRate;
+
+            outQueue.erase(outQueue.begin());
+            outInfo->mOwnedByUs = false;
+            notifyFillBufferDone(outHeader);
+        }
+
+        if (mSawInputEOS) {
+            if (!outQueue.empty() && mEncoderPool->idle()) {
+                BufferInfo *outInfo = *outQueue.begin();
+                OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+                outHeader->nFilledLen = 0;
+                outHeader->nFlags = OMX_BUFFERFLAG_EOS;
+
+                outQueue.erase(outQueue.begin());
+                outInfo->mOwnedByUs = false;
+                notifyFillBufferDone(outHeader);
+                mSawInputEOS = false;
+            }
+            return;
+        }
+
+        if (inQueue.empty()) {
+            return;
+        }
+
+        BufferInfo *inInfo = *inQueue.begin();
+        OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+
+        if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
+            // Unlike the single encoder, the last, partial, block is encoded.
+            mEncoderPool->flush();
+            mSawInputEOS = true;
+        } else if (inHeader->nFilledLen > kMaxInputBufferSize) {
+            ALOGE("input buffer too large (%d).", inHeader->nFilledLen);
+            mSignalledError = true;
+            notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+            return;
+        } else {
+            // Output timestamps are computed from the sample count, from the
+            // first input buffer on.
+            if (!mAnchorTimeValid) {
+                mAnchorTimeUs = inHeader->nTimeStamp;
+                mAnchorTimeValid = true;
+            }
+            mEncoderPool->write(
+                    reinterpret_cast<const int16_t *>(inHeader->pBuffer + inHeader->nOffset),
+                    inHeader->nFilledLen / (sizeof(int16_t) * mNumChannels));
+        }
+
+        inQueue.erase(inQueue.begin());
+        inInfo->mOwnedByUs = false;
+        notifyEmptyBufferDone(inHeader);
+    }
+}
+
+void SoftFlacEncoder::onPortFlushCompleted(OMX_U32 portIndex) {
+    if (portIndex == 0 && mEncoderPool != NULL) {
+        // the flushed input starts a new stream
+        mEncoderPool->reset();
+        mSawInputEOS = false;
+        mAnchorTimeValid = false;
+    }
+}
+
+void SoftFlacEncoder::onReset() {
+    // The pool is started again with the configuration of the next session.
+    delete mEncoderPool;
+    mEncoderPool = NULL;
+    mSawInputEOS = false;
+    mAnchorTimeValid = false;
+}
+
 FLAC__StreamEncoderWriteStatus SoftFlacEncoder::onEncodedFlacAvailable(
             const FLAC__byte buffer[],
             size_t bytes, unsigned samples,
@@ -452,6 +625,9 @@ OMX_ERRORTYPE SoftFlacEncoder::configureEncoder() {
     ok = ok && FLAC__stream_encoder_set_bits_per_sample(mFlacStreamEncoder, 16);
     ok = ok && FLAC__stream_encoder_set_compression_level(mFlacStreamEncoder,
             (unsigned)mCompressionLevel);
+    if (mBlockSize != 0) {
+        ok = ok && FLAC__stream_encoder_set_blocksize(mFlacStreamEncoder, mBlockSize);
+    }
     ok = ok && FLAC__stream_encoder_set_verify(mFlacStreamEncoder, false);
     if (!ok) { goto return_result; }
 
@@ -474,6 +650,14 @@ return_result:
 }
 
 
+unsigned SoftFlacEncoder::blockSize() const {
+    if (mBlockSize != 0) {
+        return mBlockSize;
+    }
+    // what FLAC__stream_encoder_set_compression_level() selects
+    return mCompressionLevel <= 2 ? 1152 : 4096;
+}
+
 // static
 FLAC__StreamEncoderWriteStatus SoftFlacEncoder::flacEncoderWriteCallback(
             const FLAC__StreamEncoder * /* encoder */,
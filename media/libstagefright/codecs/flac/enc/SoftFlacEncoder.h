@@ -22,6 +22,8 @@
 
 #include "FLAC/stream_encoder.h"
 
+#include "FlacEncoderPool.h"
+
 // use this symbol to have the first output buffer start with FLAC frame header so a dump of
 // all the output buffers can be opened as a .flac file
 //#define WRITE_FLAC_HEADER_IN_FIRST_BUFFER
@@ -45,7 +47,12 @@ protected:
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
+    virtual void onPortFlushCompleted(OMX_U32 portIndex);
+    virtual void onReset();
 
 private:
 
@@ -54,6 +61,10 @@ private:
         kMaxNumSamplesPerFrame = 1152,
         kMaxInputBufferSize = kMaxNumSamplesPerFrame * sizeof(int16_t) * 2,
         kMaxOutputBufferSize = 65536,    //TODO check if this can be reduced
+        // FLAC subset limit up to 48 kHz, a 16 bit stereo frame then always fits an
+        // output buffer
+        kMinBlockSize = 16,
+        kMaxBlockSize = 4608,
     };
 
     bool mSignalledError;
@@ -62,6 +73,19 @@ private:
     OMX_U32 mSampleRate;
     OMX_U32 mCompressionLevel;
 
+    // Set through OMX.google.android.index.flacBlockSize, 0 lets libFLAC pick
+    // the block size for the compression level.
+    OMX_U32 mBlockSize;
+
+    // Set through OMX.google.android.index.threadCount. With more than one
+    // thread, blocks are encoded in parallel by mEncoderPool instead of
+    // mFlacStreamEncoder.
+    OMX_U32 mNumThreads;
+    FlacEncoderPool *mEncoderPool;
+    bool mSawInputEOS;
+    bool mAnchorTimeValid;
+    OMX_TICKS mAnchorTimeUs;
+
     // should the data received by the callback be written to the output port
     bool        mEncoderWriteData;
     bool        mEncoderReturnedEncodedData;
@@ -73,6 +97,9 @@ private:
     void initPorts();
 
     OMX_ERRORTYPE configureEncoder();
+    unsigned blockSize() const;
+
+    void onQueueFilledParallel();
 
     // FLAC encoder callbacks
     // maps to encoderEncodeFlac()
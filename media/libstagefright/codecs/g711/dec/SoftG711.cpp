@@ -23,6 +23,14 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaDefs.h>
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define G711_SIMD_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define G711_SIMD_SSE2
+#endif
+
 namespace android {
 
 template<class T>
@@ -43,7 +51,8 @@ SoftG711::SoftG711(
       mIsMLaw(true),
       mSignalledError(false),
       mNumChannels(1),
-      mSamplingRate(8000) {
+      mSamplingRate(8000),
+      mFloatOutput(false) {
     if (!strcmp(name, "OMX.google.g711.alaw.decoder")) {
         mIsMLaw = false;
     } else {
@@ -121,7 +130,8 @@ OMX_ERRORTYPE SoftG711::internalGetParameter(
             pcmParams->eNumData = OMX_NumericalDataSigned;
             pcmParams->eEndian = OMX_EndianBig;
             pcmParams->bInterleaved = OMX_TRUE;
-            pcmParams->nBitPerSample = 16;
+            pcmParams->nBitPerSample =
+                pcmParams->nPortIndex == 1 && mFloatOutput ? 32 : 16;
             if (pcmParams->nPortIndex == 0) {
                 // input port
                 pcmParams->ePCMMode = mIsMLaw ? OMX_AUDIO_PCMModeMULaw
@@ -166,6 +176,14 @@ OMX_ERRORTYPE SoftG711::internalSetParameter(
 
             if(pcmParams->nPortIndex == 0) {
                 mNumChannels = pcmParams->nChannels;
+            } else {
+                // 16 bit integer or, as 32 bits, float output.
+                if (pcmParams->nBitPerSample != 16 && pcmParams->nBitPerSample != 32) {
+                    return OMX_ErrorUnsupportedSetting;
+                }
+
+                mFloatOutput = pcmParams->nBitPerSample == 32;
+                editPortInfo(1)->mDef.nBufferSize = kMaxNumSamplesPerFrame * sampleSize();
             }
 
             mSamplingRate = pcmParams->nSamplingRate;
@@ -204,6 +222,10 @@ OMX_ERRORTYPE SoftG711::internalSetParameter(
     }
 }
 
+size_t SoftG711::sampleSize() const {
+    return mFloatOutput ? sizeof(float) : sizeof(int16_t);
+}
+
 void SoftG711::onQueueFilled(OMX_U32 /* portIndex */) {
     if (mSignalledError) {
         return;
@@ -240,7 +262,7 @@ void SoftG711::onQueueFilled(OMX_U32 /* portIndex */) {
             mSignalledError = true;
         }
 
-        if (inHeader->nFilledLen * sizeof(int16_t) > outHeader->nAllocLen) {
+        if (inHeader->nFilledLen * sampleSize() > outHeader->nAllocLen) {
             ALOGE("output buffer too small (%d).", outHeader->nAllocLen);
             android_errorWriteLog(0x534e4554, "27793163");
 
@@ -251,19 +273,25 @@ void SoftG711::onQueueFilled(OMX_U32 /* portIndex */) {
 
         const uint8_t *inputptr = inHeader->pBuffer + inHeader->nOffset;
 
-        if (mIsMLaw) {
-            DecodeMLaw(
-                    reinterpret_cast<int16_t *>(outHeader->pBuffer),
-                    inputptr, inHeader->nFilledLen);
+        if (mFloatOutput) {
+            float *outputptr = reinterpret_cast<float *>(outHeader->pBuffer);
+            if (mIsMLaw) {
+                DecodeMLaw(outputptr, inputptr, inHeader->nFilledLen);
+            } else {
+                DecodeALaw(outputptr, inputptr, inHeader->nFilledLen);
+            }
         } else {
-            DecodeALaw(
-                    reinterpret_cast<int16_t *>(outHeader->pBuffer),
-                    inputptr, inHeader->nFilledLen);
+            int16_t *outputptr = reinterpret_cast<int16_t *>(outHeader->pBuffer);
+            if (mIsMLaw) {
+                DecodeMLaw(outputptr, inputptr, inHeader->nFilledLen);
+            } else {
+                DecodeALaw(outputptr, inputptr, inHeader->nFilledLen);
+            }
         }
 
         outHeader->nTimeStamp = inHeader->nTimeStamp;
         outHeader->nOffset = 0;
-        outHeader->nFilledLen = inHeader->nFilledLen * sizeof(int16_t);
+        outHeader->nFilledLen = inHeader->nFilledLen * sampleSize();
         outHeader->nFlags = 0;
 
         inInfo->mOwnedByUs = false;
@@ -280,48 +308,207 @@ void SoftG711::onQueueFilled(OMX_U32 /* portIndex */) {
     }
 }
 
-// static
-void SoftG711::DecodeALaw(
-        int16_t *out, const uint8_t *in, size_t inSize) {
-    while (inSize-- > 0) {
-        int32_t x = *in++;
+static inline int16_t ALawToLinear(int32_t x) {
+    int32_t ix = x ^ 0x55;
+    ix &= 0x7f;
 
-        int32_t ix = x ^ 0x55;
-        ix &= 0x7f;
+    int32_t iexp = ix >> 4;
+    int32_t mant = ix & 0x0f;
 
-        int32_t iexp = ix >> 4;
-        int32_t mant = ix & 0x0f;
+    if (iexp > 0) {
+        mant += 16;
+    }
 
-        if (iexp > 0) {
-            mant += 16;
-        }
+    mant = (mant << 4) + 8;
 
-        mant = (mant << 4) + 8;
+    if (iexp > 1) {
+        mant = mant << (iexp - 1);
+    }
 
-        if (iexp > 1) {
-            mant = mant << (iexp - 1);
-        }
+    return (x > 127) ? mant : -mant;
+}
+
+static inline int16_t MLawToLinear(int32_t x) {
+    int32_t mantissa = ~x;
+    int32_t exponent = (mantissa >> 4) & 7;
+    int32_t segment = exponent + 1;
+    mantissa &= 0x0f;
+
+    int32_t step = 4 << segment;
+
+    int32_t abs = (0x80l << exponent) + step * mantissa + step / 2 - 4 * 33;
+
+    return (x < 0x80) ? -abs : abs;
+}
+
+static const float kFloatScale = 1.0f / (1 << 15);
+
+// The vector versions evaluate the expressions above on 8 codes at a time,
+// without branches or lookup tables, and are bit exact with them.
+// A-law is ((mant << 4) + 8 + (iexp > 0 ? 256 : 0)) << max(iexp - 1, 0),
+// mu-law is (((mantissa << 3) + 0x84) << exponent) - 0x84.
+
+#if defined(G711_SIMD_NEON)
+
+#define G711_SIMD
+
+static inline int16x8_t DecodeALaw8(const uint8_t *in) {
+    const int16x8_t x = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(in)));
+    const int16x8_t ix = vandq_s16(veorq_s16(x, vdupq_n_s16(0x55)), vdupq_n_s16(0x7f));
+    const int16x8_t iexp = vshrq_n_s16(ix, 4);
+
+    int16x8_t mant = vshlq_n_s16(vandq_s16(ix, vdupq_n_s16(0x0f)), 4);
+    mant = vaddq_s16(mant, vdupq_n_s16(8));
+    mant = vaddq_s16(mant, vandq_s16(
+            vreinterpretq_s16_u16(vcgtq_s16(iexp, vdupq_n_s16(0))), vdupq_n_s16(16 << 4)));
+    mant = vshlq_s16(mant, vmaxq_s16(vsubq_s16(iexp, vdupq_n_s16(1)), vdupq_n_s16(0)));
+
+    const uint16x8_t negative = vceqq_s16(vandq_s16(x, vdupq_n_s16(0x80)), vdupq_n_s16(0));
+    return vbslq_s16(negative, vnegq_s16(mant), mant);
+}
+
+static inline int16x8_t DecodeMLaw8(const uint8_t *in) {
+    const int16x8_t x = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(in)));
+    const int16x8_t inv = veorq_s16(x, vdupq_n_s16(0xff));
+    const int16x8_t exponent = vandq_s16(vshrq_n_s16(inv, 4), vdupq_n_s16(7));
+    const int16x8_t mantissa = vandq_s16(inv, vdupq_n_s16(0x0f));
+
+    int16x8_t abs = vaddq_s16(vshlq_n_s16(mantissa, 3), vdupq_n_s16(4 * 33));
+    abs = vsubq_s16(vshlq_s16(abs, exponent), vdupq_n_s16(4 * 33));
+
+    const uint16x8_t negative = vcltq_s16(x, vdupq_n_s16(0x80));
+    return vbslq_s16(negative, vnegq_s16(abs), abs);
+}
+
+static inline void Store8(int16_t *out, int16x8_t v) {
+    vst1q_s16(out, v);
+}
+
+static inline void Store8(float *out, int16x8_t v) {
+    const float32x4_t scale = vdupq_n_f32(kFloatScale);
+    vst1q_f32(out, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+    vst1q_f32(out + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+}
 
-        *out++ = (x > 127) ? mant : -mant;
+#elif defined(G711_SIMD_SSE2)
+
+#define G711_SIMD
+
+static inline __m128i Load8(const uint8_t *in) {
+    return _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in)), _mm_setzero_si128());
+}
+
+// SSE2 has no per lane 16 bit shift, shift by each bit of the count in 0..7.
+static inline __m128i ShiftLeft8(__m128i v, __m128i count) {
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i four = _mm_set1_epi16(4);
+
+    __m128i m = _mm_cmpeq_epi16(_mm_and_si128(count, one), one);
+    v = _mm_add_epi16(v, _mm_and_si128(m, v));
+    m = _mm_cmpeq_epi16(_mm_and_si128(count, two), two);
+    v = _mm_or_si128(_mm_andnot_si128(m, v), _mm_and_si128(m, _mm_slli_epi16(v, 2)));
+    m = _mm_cmpeq_epi16(_mm_and_si128(count, four), four);
+    v = _mm_or_si128(_mm_andnot_si128(m, v), _mm_and_si128(m, _mm_slli_epi16(v, 4)));
+    return v;
+}
+
+// negative is all ones in the lanes to negate
+static inline __m128i Negate8(__m128i v, __m128i negative) {
+    return _mm_sub_epi16(_mm_xor_si128(v, negative), negative);
+}
+
+static inline __m128i DecodeALaw8(const uint8_t *in) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i x = Load8(in);
+    const __m128i ix = _mm_and_si128(_mm_xor_si128(x, _mm_set1_epi16(0x55)), _mm_set1_epi16(0x7f));
+    const __m128i iexp = _mm_srli_epi16(ix, 4);
+
+    __m128i mant = _mm_slli_epi16(_mm_and_si128(ix, _mm_set1_epi16(0x0f)), 4);
+    mant = _mm_add_epi16(mant, _mm_set1_epi16(8));
+    mant = _mm_add_epi16(mant, _mm_andnot_si128(
+            _mm_cmpeq_epi16(iexp, zero), _mm_set1_epi16(16 << 4)));
+    mant = ShiftLeft8(mant, _mm_subs_epu16(iexp, _mm_set1_epi16(1)));
+
+    return Negate8(mant, _mm_cmpeq_epi16(_mm_and_si128(x, _mm_set1_epi16(0x80)), zero));
+}
+
+static inline __m128i DecodeMLaw8(const uint8_t *in) {
+    const __m128i x = Load8(in);
+    const __m128i inv = _mm_xor_si128(x, _mm_set1_epi16(0xff));
+    const __m128i exponent = _mm_and_si128(_mm_srli_epi16(inv, 4), _mm_set1_epi16(7));
+    const __m128i mantissa = _mm_and_si128(inv, _mm_set1_epi16(0x0f));
+
+    __m128i abs = _mm_add_epi16(_mm_slli_epi16(mantissa, 3), _mm_set1_epi16(4 * 33));
+    abs = _mm_sub_epi16(ShiftLeft8(abs, exponent), _mm_set1_epi16(4 * 33));
+
+    return Negate8(abs, _mm_cmplt_epi16(x, _mm_set1_epi16(0x80)));
+}
+
+static inline void Store8(int16_t *out, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), v);
+}
+
+static inline void Store8(float *out, __m128i v) {
+    const __m128 scale = _mm_set1_ps(kFloatScale);
+    const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(out + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+}
+
+#endif
+
+// static
+void SoftG711::DecodeALaw(
+        int16_t *out, const uint8_t *in, size_t inSize) {
+#ifdef G711_SIMD
+    for (; inSize >= 8; inSize -= 8, in += 8, out += 8) {
+        Store8(out, DecodeALaw8(in));
+    }
+#endif
+    while (inSize-- > 0) {
+        *out++ = ALawToLinear(*in++);
     }
 }
 
 // static
 void SoftG711::DecodeMLaw(
         int16_t *out, const uint8_t *in, size_t inSize) {
+#ifdef G711_SIMD
+    for (; inSize >= 8; inSize -= 8, in += 8, out += 8) {
+        Store8(out, DecodeMLaw8(in));
+    }
+#endif
     while (inSize-- > 0) {
-        int32_t x = *in++;
-
-        int32_t mantissa = ~x;
-        int32_t exponent = (mantissa >> 4) & 7;
-        int32_t segment = exponent + 1;
-        mantissa &= 0x0f;
-
-        int32_t step = 4 << segment;
+        *out++ = MLawToLinear(*in++);
+    }
+}
 
-        int32_t abs = (0x80l << exponent) + step * mantissa + step / 2 - 4 * 33;
+// static
+void SoftG711::DecodeALaw(
+        float *out, const uint8_t *in, size_t inSize) {
+#ifdef G711_SIMD
+    for (; inSize >= 8; inSize -= 8, in += 8, out += 8) {
+        Store8(out, DecodeALaw8(in));
+    }
+#endif
+    while (inSize-- > 0) {
+        *out++ = ALawToLinear(*in++) * kFloatScale;
+    }
+}
 
-        *out++ = (x < 0x80) ? -abs : abs;
+// static
+void SoftG711::DecodeMLaw(
+        float *out, const uint8_t *in, size_t inSize) {
+#ifdef G711_SIMD
+    for (; inSize >= 8; inSize -= 8, in += 8, out += 8) {
+        Store8(out, DecodeMLaw8(in));
+    }
+#endif
+    while (inSize-- > 0) {
+        *out++ = MLawToLinear(*in++) * kFloatScale;
     }
 }
 
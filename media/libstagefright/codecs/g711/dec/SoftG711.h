@@ -50,10 +50,17 @@ private:
     OMX_U32 mNumChannels;
     int32_t mSamplingRate;
 
+    // Output float samples rather than int16, selected by a 32 bits
+    // per sample OMX_IndexParamAudioPcm on the output port.
+    bool mFloatOutput;
+
     void initPorts();
+    size_t sampleSize() const;
 
     static void DecodeALaw(int16_t *out, const uint8_t *in, size_t inSize);
     static void DecodeMLaw(int16_t *out, const uint8_t *in, size_t inSize);
+    static void DecodeALaw(float *out, const uint8_t *in, size_t inSize);
+    static void DecodeMLaw(float *out, const uint8_t *in, size_t inSize);
 
     DISALLOW_EVIL_CONSTRUCTORS(SoftG711);
 };
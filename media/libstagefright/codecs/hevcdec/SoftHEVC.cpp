@@ -74,7 +74,8 @@ SoftHEVC::SoftHEVC(
       mIvColorFormat(IV_YUV_420P),
       mChangingResolution(false),
       mSignalledError(false),
-      mStride(mWidth) {
+      mStride(mWidth),
+      mDecodeOrderOutput(false) {
     const size_t kMinCompressionRatio = 4 /* compressionRatio (for Level 4+) */;
     const size_t kMaxOutputBufferSize = 2048 * 2048 * 3 / 2;
     // INPUT_BUF_SIZE is given by HEVC codec as minimum input size
@@ -149,7 +150,8 @@ status_t SoftHEVC::setParams(size_t stride) {
     s_ctl_ip.u4_disp_wd = (UWORD32)stride;
     s_ctl_ip.e_frm_skip_mode = IVD_SKIP_NONE;
 
-    s_ctl_ip.e_frm_out_mode = IVD_DISPLAY_FRAME_OUT;
+    // In low latency mode the decoder does not hold frames back for reordering.
+    s_ctl_ip.e_frm_out_mode = mLowLatency ? IVD_DECODE_FRAME_OUT : IVD_DISPLAY_FRAME_OUT;
     s_ctl_ip.e_vid_dec_mode = IVD_DECODE_FRAME;
     s_ctl_ip.e_cmd = IVD_CMD_VIDEO_CTL;
     s_ctl_ip.e_sub_cmd = IVD_CMD_CTL_SETPARAMS;
@@ -157,6 +159,7 @@ status_t SoftHEVC::setParams(size_t stride) {
     s_ctl_op.u4_size = sizeof(ivd_ctl_set_config_op_t);
 
     ALOGV("Set the run-time (dynamic) parameters stride = %zu", stride);
+    mDecodeOrderOutput = mLowLatency;
     status = ivdec_api_function(mCodecCtx, (void *)&s_ctl_ip,
             (void *)&s_ctl_op);
 
@@ -255,7 +258,10 @@ status_t SoftHEVC::setFlushMode() {
 status_t SoftHEVC::initDecoder() {
     IV_API_CALL_STATUS_T status;
 
-    mNumCores = GetCPUCoreCount();
+    mNumCores = mThreadCount > 0 ? mThreadCount : threadBudget();
+    if (mNumCores == 0) {
+        mNumCores = GetCPUCoreCount();
+    }
     mCodecCtx = NULL;
 
     mStride = outputBufferWidth();
@@ -450,7 +456,14 @@ void SoftHEVC::onQueueFilled(OMX_U32 portIndex) {
             return;
         }
     }
-    if (outputBufferWidth() != mStride) {
+    uint32_t numCores = mThreadCount > 0 ? mThreadCount : threadBudget();
+    if (numCores > 0 && numCores != mNumCores) {
+        /* The thread count was configured, or the share of the CPUs changed,
+         * after the decoder was created */
+        mNumCores = numCores;
+        setNumCores();
+    }
+    if (outputBufferWidth() != mStride || mLowLatency != mDecodeOrderOutput) {
         /* Set the run-time (dynamic) parameters */
         mStride = outputBufferWidth();
         setParams(mStride);
@@ -77,3 +77,26 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_CFLAGS += -Werror
 
 include $(BUILD_SHARED_LIBRARY)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        src/dct.cpp \
+        test/dct_bench.cpp
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/src \
+        $(LOCAL_PATH)/include
+
+LOCAL_CFLAGS := \
+    -DBX_RC -DM4VENC_C_DCT \
+    -DOSCL_IMPORT_REF= -D"OSCL_UNUSED_ARG(x)=(void)(x)" -DOSCL_EXPORT_REF=
+
+LOCAL_CFLAGS += -Werror
+
+LOCAL_MODULE := libstagefright_m4vh263enc_dct_bench
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
@@ -18,9 +18,17 @@
 #include "mp4enc_lib.h"
 #include "mp4lib_int.h"
 #include "dct_inline.h"
+#include "dct_simd.h"
 
 #define FDCT_SHIFT 10
 
+/* the conformance test builds this file with -DM4VENC_C_DCT to get the C versions */
+#if USE_DCT_VECTOR && !defined(M4VENC_C_DCT)
+#define USE_BLOCK_DCT_VECTOR 1
+#else
+#define USE_BLOCK_DCT_VECTOR 0
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -47,6 +55,11 @@ extern "C"
         Int tmp, tmp2;
         Int ColTh;
 
+#if USE_BLOCK_DCT_VECTOR
+        block_dct_aan_vec(out, cur, pred, width);
+        return ;
+#endif
+
         dst = out + 64 ;
         ColTh = *dst;
         out += 128;
@@ -663,6 +676,11 @@ extern "C"
 
         OSCL_UNUSED_ARG(dummy2);
 
+#if USE_BLOCK_DCT_VECTOR
+        block_dct_aan_vec(out, cur, NULL, width);
+        return ;
+#endif
+
         dst = out + 64 ;
         ColTh = *dst;
         out += 128;
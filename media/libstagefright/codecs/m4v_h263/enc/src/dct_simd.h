@@ -0,0 +1,442 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _DCT_SIMD_H_
+#define _DCT_SIMD_H_
+
+/* 128-bit vector version of the 8x8 AAN forward DCT used by BlockDCT_AANwSub() and
+ * BlockDCT_AANIntra(). The coefficients, including the 0x7fff marker of a column below
+ * ColTh, are bit-exact:
+ *
+ * - the horizontal pass works on eight 16-bit lanes. Its input is a difference of 8-bit
+ *   pixels, so every operand of a multiply stays below 4096 and the products are formed
+ *   in 32 bits; all the other operations wrap like the truncation to Short in C.
+ * - the vertical pass gets arbitrary 16-bit input and works on 32-bit lanes like C. */
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_DCT_NEON 1
+#define USE_DCT_SSE2 0
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_DCT_NEON 0
+#define USE_DCT_SSE2 1
+#else
+#define USE_DCT_NEON 0
+#define USE_DCT_SSE2 0
+#endif
+
+#define USE_DCT_VECTOR (USE_DCT_NEON || USE_DCT_SSE2)
+
+#if USE_DCT_NEON
+
+typedef int16x8_t dct_row;  /* eight 16-bit coefficients */
+typedef int32x4_t dct_vec;  /* four 32-bit intermediates */
+
+#define DCT_ROW_SHL(a, n) vshlq_n_s16(a, n)
+#define DCT_SRA(a, n) vshrq_n_s32(a, n)
+#define DCT_SHL(a, n) vshlq_n_s32(a, n)
+
+static inline dct_row dct_row_add(dct_row a, dct_row b) { return vaddq_s16(a, b); }
+static inline dct_row dct_row_sub(dct_row a, dct_row b) { return vsubq_s16(a, b); }
+
+/* (a * ca + b * cb + (1 << 9)) >> 10 */
+static inline dct_row dct_row_rotate(dct_row a, int16 ca, dct_row b, int16 cb)
+{
+    int32x4_t lo = vmlal_n_s16(vmull_n_s16(vget_low_s16(a), ca), vget_low_s16(b), cb);
+    int32x4_t hi = vmlal_n_s16(vmull_n_s16(vget_high_s16(a), ca), vget_high_s16(b), cb);
+    return vcombine_s16(vrshrn_n_s32(lo, 10), vrshrn_n_s32(hi, 10));
+}
+
+/* (a * c + (1 << 9)) >> 10 */
+static inline dct_row dct_row_scale(dct_row a, int16 c)
+{
+    return vcombine_s16(vrshrn_n_s32(vmull_n_s16(vget_low_s16(a), c), 10),
+                        vrshrn_n_s32(vmull_n_s16(vget_high_s16(a), c), 10));
+}
+
+static inline dct_vec dct_add(dct_vec a, dct_vec b) { return vaddq_s32(a, b); }
+static inline dct_vec dct_sub(dct_vec a, dct_vec b) { return vsubq_s32(a, b); }
+static inline dct_vec dct_xor(dct_vec a, dct_vec b) { return veorq_s32(a, b); }
+static inline dct_vec dct_abs(dct_vec a) { return vabsq_s32(a); }
+static inline dct_vec dct_dup(int32 c) { return vdupq_n_s32(c); }
+
+/* acc + a * c */
+static inline dct_vec dct_mla(dct_vec acc, dct_vec a, int32 c)
+{
+    return vmlaq_n_s32(acc, a, c);
+}
+
+/* where a < b, take x, else y */
+static inline dct_vec dct_select_lt(dct_vec a, dct_vec b, dct_vec x, dct_vec y)
+{
+    return vbslq_s32(vcltq_s32(a, b), x, y);
+}
+
+static inline bool dct_all_lt(dct_vec a, dct_vec b)
+{
+    uint32x4_t lt = vcltq_s32(a, b);
+    uint32x2_t both = vand_u32(vget_low_u32(lt), vget_high_u32(lt));
+    return (vget_lane_u32(both, 0) & vget_lane_u32(both, 1)) != 0;
+}
+
+static inline dct_vec dct_widen_lo(dct_row r) { return vmovl_s16(vget_low_s16(r)); }
+static inline dct_vec dct_widen_hi(dct_row r) { return vmovl_s16(vget_high_s16(r)); }
+
+/* keeps the low 16 bits of each lane, like the store to a Short in C */
+static inline dct_row dct_narrow(dct_vec lo, dct_vec hi)
+{
+    return vcombine_s16(vmovn_s32(lo), vmovn_s32(hi));
+}
+
+/* 2 * cur - 2 * pred, or 2 * cur if pred is NULL */
+static inline dct_row dct_load_row(const UChar *cur, const UChar *pred)
+{
+    int16x8_t r = vreinterpretq_s16_u16(vshll_n_u8(vld1_u8(cur), 1));
+    if (pred)
+    {
+        r = vsubq_s16(r, vreinterpretq_s16_u16(vshll_n_u8(vld1_u8(pred), 1)));
+    }
+    return r;
+}
+
+static inline void dct_store_row(Short *out, dct_row r)
+{
+    vst1q_s16(out, r);
+}
+
+static inline void dct_transpose(dct_row r[8])
+{
+    int16x8x2_t t0 = vtrnq_s16(r[0], r[1]);
+    int16x8x2_t t1 = vtrnq_s16(r[2], r[3]);
+    int16x8x2_t t2 = vtrnq_s16(r[4], r[5]);
+    int16x8x2_t t3 = vtrnq_s16(r[6], r[7]);
+
+    int32x4x2_t u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]), vreinterpretq_s32_s16(t1.val[0]));
+    int32x4x2_t u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]), vreinterpretq_s32_s16(t1.val[1]));
+    int32x4x2_t u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]), vreinterpretq_s32_s16(t3.val[0]));
+    int32x4x2_t u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]), vreinterpretq_s32_s16(t3.val[1]));
+
+    r[0] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[0]), vget_low_s32(u2.val[0])));
+    r[1] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[0]), vget_low_s32(u3.val[0])));
+    r[2] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u0.val[1]), vget_low_s32(u2.val[1])));
+    r[3] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(u1.val[1]), vget_low_s32(u3.val[1])));
+    r[4] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[0]), vget_high_s32(u2.val[0])));
+    r[5] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[0]), vget_high_s32(u3.val[0])));
+    r[6] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u0.val[1]), vget_high_s32(u2.val[1])));
+    r[7] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(u1.val[1]), vget_high_s32(u3.val[1])));
+}
+
+#elif USE_DCT_SSE2
+
+typedef __m128i dct_row;
+typedef __m128i dct_vec;
+
+#define DCT_ROW_SHL(a, n) _mm_slli_epi16(a, n)
+#define DCT_SRA(a, n) _mm_srai_epi32(a, n)
+#define DCT_SHL(a, n) _mm_slli_epi32(a, n)
+
+static inline dct_row dct_row_add(dct_row a, dct_row b) { return _mm_add_epi16(a, b); }
+static inline dct_row dct_row_sub(dct_row a, dct_row b) { return _mm_sub_epi16(a, b); }
+
+/* (a * ca + b * cb + (1 << 9)) >> 10, the result fits in 16 bits for the horizontal pass */
+static inline dct_row dct_row_rotate(dct_row a, int16 ca, dct_row b, int16 cb)
+{
+    const __m128i c = _mm_set1_epi32(((int32)cb << 16) | (uint16)ca);
+    const __m128i round = _mm_set1_epi32(1 << 9);
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), c), round);
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), c), round);
+    return _mm_packs_epi32(_mm_srai_epi32(lo, 10), _mm_srai_epi32(hi, 10));
+}
+
+/* (a * c + (1 << 9)) >> 10 */
+static inline dct_row dct_row_scale(dct_row a, int16 c)
+{
+    return dct_row_rotate(a, c, _mm_setzero_si128(), 0);
+}
+
+static inline dct_vec dct_add(dct_vec a, dct_vec b) { return _mm_add_epi32(a, b); }
+static inline dct_vec dct_sub(dct_vec a, dct_vec b) { return _mm_sub_epi32(a, b); }
+static inline dct_vec dct_xor(dct_vec a, dct_vec b) { return _mm_xor_si128(a, b); }
+static inline dct_vec dct_dup(int32 c) { return _mm_set1_epi32(c); }
+
+static inline dct_vec dct_abs(dct_vec a)
+{
+    dct_vec sign = _mm_srai_epi32(a, 31);
+    return _mm_sub_epi32(_mm_xor_si128(a, sign), sign);
+}
+
+/* acc + a * c; SSE2 has no 32-bit multiply low, the low halves of the two 32x32->64
+ * products are the same for signed and unsigned operands */
+static inline dct_vec dct_mla(dct_vec acc, dct_vec a, int32 c)
+{
+    __m128i b = _mm_set1_epi32(c);
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), b);
+    __m128i prod = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    return _mm_add_epi32(acc, prod);
+}
+
+static inline dct_vec dct_select_lt(dct_vec a, dct_vec b, dct_vec x, dct_vec y)
+{
+    __m128i mask = _mm_cmplt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y));
+}
+
+static inline bool dct_all_lt(dct_vec a, dct_vec b)
+{
+    return _mm_movemask_epi8(_mm_cmplt_epi32(a, b)) == 0xFFFF;
+}
+
+static inline dct_vec dct_widen_lo(dct_row r) { return _mm_srai_epi32(_mm_unpacklo_epi16(r, r), 16); }
+static inline dct_vec dct_widen_hi(dct_row r) { return _mm_srai_epi32(_mm_unpackhi_epi16(r, r), 16); }
+
+/* sign extending the low 16 bits first makes the saturating pack a plain truncation */
+static inline dct_row dct_narrow(dct_vec lo, dct_vec hi)
+{
+    lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+    return _mm_packs_epi32(lo, hi);
+}
+
+static inline dct_row dct_load_row(const UChar *cur, const UChar *pred)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i r = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)cur), zero);
+    if (pred)
+    {
+        r = _mm_sub_epi16(r, _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)pred), zero));
+    }
+    return _mm_slli_epi16(r, 1);
+}
+
+static inline void dct_store_row(Short *out, dct_row r)
+{
+    _mm_storeu_si128((__m128i *)out, r);
+}
+
+static inline void dct_transpose(dct_row r[8])
+{
+    __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]);
+    __m128i a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]);
+    __m128i a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]);
+    __m128i a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]);
+    __m128i a7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+    __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+    __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+    __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+    r[0] = _mm_unpacklo_epi64(b0, b4);
+    r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5);
+    r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6);
+    r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7);
+    r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+#endif
+
+#if USE_DCT_VECTOR
+
+/* The vertical pass of the C version on four columns, one per lane. */
+static inline void fdct_aan_vec(dct_vec k[8])
+{
+    const int shift = 10;   /* FDCT_SHIFT */
+    const dct_vec round = dct_dup(1 << (shift - 1));
+    dct_vec k0 = k[0], k1 = k[1], k2 = k[2], k3 = k[3];
+    dct_vec k4 = k[4], k5 = k[5], k6 = k[6], k7 = k[7];
+
+    /* fdct_1 */
+    k0 = dct_add(k0, k7);
+    k7 = dct_sub(k0, DCT_SHL(k7, 1));
+    k1 = dct_add(k1, k6);
+    k6 = dct_sub(k1, DCT_SHL(k6, 1));
+    k2 = dct_add(k2, k5);
+    k5 = dct_sub(k2, DCT_SHL(k5, 1));
+    k3 = dct_add(k3, k4);
+    k4 = dct_sub(k3, DCT_SHL(k4, 1));
+
+    k0 = dct_add(k0, k3);
+    k3 = dct_sub(k0, DCT_SHL(k3, 1));
+    k1 = dct_add(k1, k2);
+    k2 = dct_sub(k1, DCT_SHL(k2, 1));
+
+    k0 = dct_add(k0, k1);
+    k1 = dct_sub(k0, DCT_SHL(k1, 1));
+    k[0] = k0;
+    k[4] = k1;
+
+    /* fdct_2 */
+    k4 = dct_add(k4, k5);
+    k5 = dct_add(k5, k6);
+    k6 = dct_add(k6, k7);
+    k2 = dct_add(k2, k3);
+    k5 = DCT_SRA(dct_mla(round, k5, 724), 10);
+    k2 = DCT_SRA(dct_mla(round, k2, 724), 10);
+    k2 = dct_add(k2, k3);
+    k3 = dct_sub(DCT_SHL(k3, 1), k2);
+    k[2] = k2;
+    k[6] = DCT_SHL(k3, 1);
+
+    /* fdct_3 */
+    k1 = dct_mla(round, dct_sub(k4, k6), 392);
+    k0 = dct_mla(k1, k4, 554);
+    k1 = dct_mla(k1, k6, 1338);
+    k4 = DCT_SRA(k0, 10);
+    k6 = DCT_SRA(k1, 10);
+
+    k5 = dct_add(k5, k7);
+    k7 = dct_sub(DCT_SHL(k7, 1), k5);
+    k4 = dct_add(k4, k7);
+    k7 = dct_sub(DCT_SHL(k7, 1), k4);
+    k5 = dct_add(k5, k6);
+    k6 = dct_sub(k5, DCT_SHL(k6, 1));
+    k[5] = DCT_SHL(k4, 1);
+    k[1] = k5;
+    k[7] = DCT_SHL(k6, 2);
+    k[3] = k7;
+}
+
+/* The horizontal pass of the C version on eight rows, one per lane. */
+static inline void fdct_aan_row_vec(dct_row k[8])
+{
+    dct_row k0 = k[0], k1 = k[1], k2 = k[2], k3 = k[3];
+    dct_row k4 = k[4], k5 = k[5], k6 = k[6], k7 = k[7];
+
+    /* fdct_1 */
+    k0 = dct_row_add(k0, k7);
+    k7 = dct_row_sub(k0, DCT_ROW_SHL(k7, 1));
+    k1 = dct_row_add(k1, k6);
+    k6 = dct_row_sub(k1, DCT_ROW_SHL(k6, 1));
+    k2 = dct_row_add(k2, k5);
+    k5 = dct_row_sub(k2, DCT_ROW_SHL(k5, 1));
+    k3 = dct_row_add(k3, k4);
+    k4 = dct_row_sub(k3, DCT_ROW_SHL(k4, 1));
+
+    k0 = dct_row_add(k0, k3);
+    k3 = dct_row_sub(k0, DCT_ROW_SHL(k3, 1));
+    k1 = dct_row_add(k1, k2);
+    k2 = dct_row_sub(k1, DCT_ROW_SHL(k2, 1));
+
+    k0 = dct_row_add(k0, k1);
+    k1 = dct_row_sub(k0, DCT_ROW_SHL(k1, 1));
+    k[0] = k0;
+    k[4] = k1;
+
+    /* fdct_2 */
+    k4 = dct_row_add(k4, k5);
+    k5 = dct_row_add(k5, k6);
+    k6 = dct_row_add(k6, k7);
+    k2 = dct_row_add(k2, k3);
+    k5 = dct_row_scale(k5, 724);
+    k2 = dct_row_scale(k2, 724);
+    k2 = dct_row_add(k2, k3);
+    k3 = dct_row_sub(DCT_ROW_SHL(k3, 1), k2);
+    k[2] = k2;
+    k[6] = DCT_ROW_SHL(k3, 1);
+
+    /* fdct_3 */
+    k0 = dct_row_sub(k4, k6);
+    k4 = dct_row_rotate(k0, 392, k4, 554);
+    k6 = dct_row_rotate(k0, 392, k6, 1338);
+
+    k5 = dct_row_add(k5, k7);
+    k7 = dct_row_sub(DCT_ROW_SHL(k7, 1), k5);
+    k4 = dct_row_add(k4, k7);
+    k7 = dct_row_sub(DCT_ROW_SHL(k7, 1), k4);
+    k5 = dct_row_add(k5, k6);
+    k6 = dct_row_sub(k5, DCT_ROW_SHL(k6, 1));
+    k[5] = DCT_ROW_SHL(k4, 1);
+    k[1] = k5;
+    k[7] = DCT_ROW_SHL(k6, 2);
+    k[3] = k7;
+}
+
+/* In the C version the first term is not corrected by the carry. */
+static inline dct_vec dct_sum_abs(const dct_vec k[8])
+{
+    dct_vec abs_sum = dct_xor(k[0], DCT_SRA(k[0], 31));
+    for (int i = 1; i < 8; i++)
+    {
+        abs_sum = dct_add(abs_sum, dct_abs(k[i]));
+    }
+    return abs_sum;
+}
+
+/* Same interface as BlockDCT_AANwSub(): ColTh is read from out[64] and the coefficients
+ * are written to out[64..127]. pred has a stride of 16, or is NULL for intra blocks. */
+static inline void block_dct_aan_vec(Short *out, const UChar *cur, const UChar *pred, Int width)
+{
+    const dct_vec colTh = dct_dup(out[64]);
+    const dct_vec skipped = dct_dup(0x7fff);
+    dct_row r[8];
+    dct_vec lo[8], hi[8];
+    dct_vec inLo[8], inHi[8];
+
+    for (int i = 0; i < 8; i++)
+    {
+        r[i] = dct_load_row(cur, pred);
+        cur += width;
+        if (pred)
+            pred += 16;
+    }
+
+    /* horizontal pass, one lane per row */
+    dct_transpose(r);
+    fdct_aan_row_vec(r);
+
+    /* vertical pass, one lane per column */
+    dct_transpose(r);
+    for (int i = 0; i < 8; i++)
+    {
+        lo[i] = inLo[i] = dct_widen_lo(r[i]);
+        hi[i] = inHi[i] = dct_widen_hi(r[i]);
+    }
+
+    /* a column below the deadzone threshold keeps its horizontal coefficients, with
+     * 0x7fff in row 0; most inter blocks skip at least four columns */
+    const dct_vec sumLo = dct_sum_abs(inLo);
+    const dct_vec sumHi = dct_sum_abs(inHi);
+    if (!dct_all_lt(sumLo, colTh))
+        fdct_aan_vec(lo);
+    if (!dct_all_lt(sumHi, colTh))
+        fdct_aan_vec(hi);
+    for (int i = 0; i < 8; i++)
+    {
+        dct_vec keepLo = i == 0 ? skipped : inLo[i];
+        dct_vec keepHi = i == 0 ? skipped : inHi[i];
+        dct_store_row(out + 64 + 8 * i,
+                      dct_narrow(dct_select_lt(sumLo, colTh, keepLo, lo[i]),
+                                 dct_select_lt(sumHi, colTh, keepHi, hi[i])));
+    }
+}
+
+#endif /* USE_DCT_VECTOR */
+
+#endif /* _DCT_SIMD_H_ */
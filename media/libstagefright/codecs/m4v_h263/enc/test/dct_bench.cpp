@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Checks that the vector forward DCT of the encoder produces exactly the coefficients of
+// the C versions, which this test is built with, and measures how much faster it is.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mp4enc_lib.h"
+#include "mp4lib_int.h"
+#include "dct.h"
+#include "dct_simd.h"
+
+static const int kWidth = 176;      // QCIF luma
+static const int kHeight = 144;
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct Block
+{
+    int offset;
+    int predOffset;
+    int colTh;
+};
+
+// out[64] carries ColTh in, and the block is written to out[64..127]
+static void runC(Short *out, UChar *frame, UChar *pred, const Block &b)
+{
+    out[64] = b.colTh;
+    if (b.predOffset < 0)
+        BlockDCT_AANIntra(out, frame + b.offset, NULL, kWidth);
+    else
+        BlockDCT_AANwSub(out, frame + b.offset, pred + b.predOffset, kWidth);
+}
+
+#if USE_DCT_VECTOR
+static void runVec(Short *out, UChar *frame, UChar *pred, const Block &b)
+{
+    out[64] = b.colTh;
+    block_dct_aan_vec(out, frame + b.offset, b.predOffset < 0 ? NULL : pred + b.predOffset,
+                      kWidth);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    int numBlocks = 1000000;
+    int res;
+    while ((res = getopt(argc, argv, "n:")) >= 0)
+    {
+        if (res == 'n' && atoi(optarg) > 0)
+        {
+            numBlocks = atoi(optarg);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n <number of blocks>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+#if !USE_DCT_VECTOR
+    printf("no vector DCT for this architecture\n");
+    return 0;
+#else
+    UChar *frame = (UChar *)malloc(kWidth * kHeight);
+    UChar *pred = (UChar *)malloc(16 * 16 * 16);
+    Block *blocks = (Block *)malloc(numBlocks * sizeof(Block));
+    Short outC[128];
+    Short outVec[128];
+
+    // A smooth picture with noise, and a few saturated areas for the extreme residuals.
+    // The deadzone thresholds are the ones the encoder uses for a random QP.
+    srand(1);
+    for (int y = 0; y < kHeight; y++)
+    {
+        for (int x = 0; x < kWidth; x++)
+        {
+            int v = (x * 3 + y * 2 + rand() % 24) & 0xFF;
+            if ((x / 8 + y / 8) % 13 == 0)
+                v = (x + y) & 8 ? 255 : 0;
+            frame[y * kWidth + x] = (UChar)v;
+        }
+    }
+    for (int i = 0; i < 16 * 16 * 16; i++)
+    {
+        pred[i] = i % 7 == 0 ? (UChar)(rand() & 0xFF) : frame[i % (kWidth * kHeight)] ^ (rand() % 16);
+    }
+    for (int i = 0; i < numBlocks; i++)
+    {
+        blocks[i].offset = (rand() % (kHeight - 8)) * kWidth + (rand() % (kWidth / 4 - 2)) * 4;
+        blocks[i].predOffset = rand() % 4 == 0 ? -1 : (rand() % (16 * 15 - 8)) & ~3;
+        const int qp = 1 + rand() % 31;
+        blocks[i].colTh = blocks[i].predOffset < 0 ? ColThIntra[qp] : ColThInter[qp];
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < numBlocks; i++)
+    {
+        memset(outC, 0, sizeof(outC));
+        memset(outVec, 0, sizeof(outVec));
+        runC(outC, frame, pred, blocks[i]);
+        runVec(outVec, frame, pred, blocks[i]);
+        if (memcmp(outC, outVec, sizeof(outC)))
+        {
+            mismatches++;
+        }
+    }
+
+    int64_t sum = 0;
+    int64_t start = nowNs();
+    for (int i = 0; i < numBlocks; i++)
+    {
+        runC(outC, frame, pred, blocks[i]);
+        sum += outC[64];
+    }
+    const int64_t cNs = nowNs() - start;
+
+    start = nowNs();
+    for (int i = 0; i < numBlocks; i++)
+    {
+        runVec(outVec, frame, pred, blocks[i]);
+        sum += outVec[64];
+    }
+    const int64_t vecNs = nowNs() - start;
+
+    printf("%s, %d blocks, %d mismatches (checksum %lld)\n",
+           USE_DCT_NEON ? "NEON" : "SSE2", numBlocks, mismatches, (long long)sum);
+    printf("8x8 forward DCT: C %.1f ns, vector %.1f ns, speedup %.2fx\n",
+           (double)cNs / numBlocks, (double)vecNs / numBlocks, (double)cNs / vecNs);
+
+    free(blocks);
+    free(pred);
+    free(frame);
+    return mismatches != 0;
+#endif
+}
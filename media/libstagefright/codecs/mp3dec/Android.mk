@@ -77,7 +77,8 @@ LOCAL_C_INCLUDES := \
 LOCAL_CFLAGS += -Werror
 
 LOCAL_SHARED_LIBRARIES := \
-        libstagefright libstagefright_omx libstagefright_foundation libutils liblog
+        libstagefright libstagefright_omx libstagefright_foundation libutils liblog \
+        libcutils
 
 LOCAL_STATIC_LIBRARIES := \
         libstagefright_mp3dec
@@ -86,3 +87,27 @@ LOCAL_MODULE := libstagefright_soft_mp3dec
 LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        test/mp3dec_bench.cpp
+
+LOCAL_C_INCLUDES := \
+        frameworks/av/media/libstagefright/include \
+        $(LOCAL_PATH)/include
+
+LOCAL_CFLAGS += -Werror -Wall
+
+LOCAL_SHARED_LIBRARIES := \
+        libstagefright libstagefright_foundation libutils liblog
+
+LOCAL_STATIC_LIBRARIES := \
+        libstagefright_mp3dec
+
+LOCAL_MODULE := mp3dec_bench
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
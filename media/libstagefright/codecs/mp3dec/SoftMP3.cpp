@@ -20,6 +20,9 @@
 
 #include "SoftMP3.h"
 
+#include <stdlib.h>
+
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaDefs.h>
 
@@ -27,6 +30,20 @@
 
 namespace android {
 
+// Number of decoded frames to return per output buffer. Larger values cut the
+// number of buffer round trips through the client during long playback, at the
+// cost of output latency.
+static size_t GetFramesPerBuffer() {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.audio-batch", value, NULL)) {
+        int frames = atoi(value);
+        if (frames >= 1 && frames <= 16) {
+            return frames;
+        }
+    }
+    return 1;
+}
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -53,7 +70,9 @@ SoftMP3::SoftMP3(
       mSignalledOutputEos(false),
       mOutputPortSettingsChange(NONE),
       mLastAnchorTimeUs(-1),
-      mNextOutBufferTimeUs(0) {
+      mNextOutBufferTimeUs(0),
+      mFramesPerBuffer(GetFramesPerBuffer()),
+      mBatchedFrames(0) {
     initPorts();
     initDecoder();
 }
@@ -96,7 +115,9 @@ void SoftMP3::initPorts() {
     def.eDir = OMX_DirOutput;
     def.nBufferCountMin = kNumBuffers;
     def.nBufferCountActual = def.nBufferCountMin;
-    def.nBufferSize = kOutputBufferSize;
+    // a frame of 1152 stereo samples takes half of kOutputBufferSize, and the
+    // decoder needs all of kOutputBufferSize to be free before each frame
+    def.nBufferSize = kOutputBufferSize + (mFramesPerBuffer - 1) * kOutputBufferSize / 2;
     def.bEnabled = OMX_TRUE;
     def.bPopulated = OMX_FALSE;
     def.eDomain = OMX_PortDomainAudio;
@@ -122,15 +143,16 @@ void SoftMP3::initDecoder() {
     mIsFirst = true;
 }
 
-void *SoftMP3::memsetSafe(OMX_BUFFERHEADERTYPE *outHeader, int c, size_t len) {
-    if (len > outHeader->nAllocLen) {
-        ALOGE("memset buffer too small: got %u, expected %zu", outHeader->nAllocLen, len);
+void *SoftMP3::memsetSafe(OMX_BUFFERHEADERTYPE *outHeader, size_t offset, int c, size_t len) {
+    if (offset > outHeader->nAllocLen || len > outHeader->nAllocLen - offset) {
+        ALOGE("memset buffer too small: got %u, expected %zu",
+                outHeader->nAllocLen, offset + len);
         android_errorWriteLog(0x534e4554, "29422022");
         notify(OMX_EventError, OMX_ErrorUndefined, OUTPUT_BUFFER_TOO_SMALL, NULL);
         mSignalledError = true;
         return NULL;
     }
-    return memset(outHeader->pBuffer, c, len);
+    return memset(outHeader->pBuffer + offset, c, len);
 }
 
 OMX_ERRORTYPE SoftMP3::internalGetParameter(
@@ -252,7 +274,16 @@ void SoftMP3::onQueueFilled(OMX_U32 /* portIndex */) {
 
         BufferInfo *outInfo = *outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
-        outHeader->nFlags = 0;
+
+        // When batching, the frame is appended to the ones already in the output buffer.
+        size_t outOffset = 0;
+        if (mBatchedFrames == 0) {
+            outHeader->nFlags = 0;
+            outHeader->nOffset = 0;
+            outHeader->nFilledLen = 0;
+        } else {
+            outOffset = outHeader->nOffset + outHeader->nFilledLen;
+        }
 
         if (inHeader) {
             if (inHeader->nOffset == 0 && inHeader->nFilledLen) {
@@ -263,13 +294,27 @@ void SoftMP3::onQueueFilled(OMX_U32 /* portIndex */) {
                 //If input buffer timestamp is same as last input buffer timestamp then
                 //treat this as a erroneous timestamp and ignore new input buffer
                 //timestamp and use last output buffer timestamp as Anchor Time.
+                int64_t anchorTimeUs = mNextOutBufferTimeUs;
                 if ((mLastAnchorTimeUs != inHeader->nTimeStamp)) {
-                    mAnchorTimeUs = inHeader->nTimeStamp;
-                    mLastAnchorTimeUs = inHeader->nTimeStamp;
-                } else {
-                    mAnchorTimeUs = mNextOutBufferTimeUs;
+                    anchorTimeUs = inHeader->nTimeStamp;
+                }
+
+                // Frames in one output buffer must be contiguous in time, as only the
+                // first one carries a timestamp.
+                if (mBatchedFrames > 0) {
+                    int64_t expectedTimeUs =
+                        mAnchorTimeUs + (mNumFramesOutput * 1000000ll) / mSamplingRate;
+                    if (mLastAnchorTimeUs == inHeader->nTimeStamp) {
+                        anchorTimeUs = expectedTimeUs;
+                    } else if (llabs(anchorTimeUs - expectedTimeUs) > kMaxBatchJitterUs) {
+                        tmpTime = outHeader->nTimeStamp;
+                        returnOutputBuffer();
+                        continue;
+                    }
                 }
 
+                mAnchorTimeUs = anchorTimeUs;
+                mLastAnchorTimeUs = inHeader->nTimeStamp;
                 mNumFramesOutput = 0;
             }
 
@@ -289,7 +334,7 @@ void SoftMP3::onQueueFilled(OMX_U32 /* portIndex */) {
         mConfig->inputBufferUsedLength = 0;
 
         mConfig->outputFrameSize = kOutputBufferSize / sizeof(int16_t);
-        if ((int32)outHeader->nAllocLen < mConfig->outputFrameSize) {
+        if ((int32)(outHeader->nAllocLen - outOffset) < mConfig->outputFrameSize) {
             ALOGE("input buffer too small: got %u, expected %u",
                 outHeader->nAllocLen, mConfig->outputFrameSize);
             android_errorWriteLog(0x534e4554, "27793371");
@@ -299,7 +344,11 @@ void SoftMP3::onQueueFilled(OMX_U32 /* portIndex */) {
         }
 
         mConfig->pOutputBuffer =
-            reinterpret_cast<int16_t *>(outHeader->pBuffer);
+            reinterpret_cast<int16_t *>(outHeader->pBuffer + outOffset);
+
+        // nOffset and nFilledLen of the output buffer once this frame is in it
+        OMX_U32 outFilledOffset = outHeader->nOffset;
+        OMX_U32 outFilledLen = outHeader->nFilledLen;
 
         ERROR_CODE decoderErr;
         if ((decoderErr = pvmp3_framedecoder(mConfig, mDecoderBuf))
@@ -326,13 +375,11 @@ void SoftMP3::onQueueFilled(OMX_U32 /* portIndex */) {
                 if (!mIsFirst) {
                     // pad the end of the stream with 529 samples, since that many samples
                     // were trimmed off the beginning when decoding started
-                    outHeader->nOffset = 0;
-                    outHeader->nFilledLen = kPVMP3DecoderDelay * mNumChannels * sizeof(int16_t);
-
-                    if (!memsetSafe(outHeader, 0, outHeader->nFilledLen)) {
+                    size_t padLen = kPVMP3DecoderDelay * mNumChannels * sizeof(int16_t);
+                    if (!memsetSafe(outHeader, outOffset, 0, padLen)) {
                         return;
                     }
-
+                    outFilledLen += padLen;
                 }
                 outHeader->nFlags = OMX_BUFFERFLAG_EOS;
                 mSignalledOutputEos = true;
@@ -344,7 +391,8 @@ void SoftMP3::onQueueFilled(OMX_U32 /* portIndex */) {
                 // if mIsFirst is true as we may not have a valid
                 // mConfig->samplingRate and mConfig->num_channels?
                 ALOGV_IF(mIsFirst, "insufficient data for first frame, sending silence");
-                if (!memsetSafe(outHeader, 0, mConfig->outputFrameSize * sizeof(int16_t))) {
+                if (!memsetSafe(outHeader, outOffset, 0,
+                        mConfig->outputFrameSize * sizeof(int16_t))) {
                     return;
                 }
 
@@ -354,11 +402,20 @@ void SoftMP3::onQueueFilled(OMX_U32 /* portIndex */) {
             }
         } else if (mConfig->samplingRate != mSamplingRate
                 || mConfig->num_channels != mNumChannels) {
+            // The frames already batched are in the old format, send them first.
+            if (mBatchedFrames > 0) {
+                tmpTime = outHeader->nTimeStamp;
+                returnOutputBuffer();
+            }
+
             mSamplingRate = mConfig->samplingRate;
             mNumChannels = mConfig->num_channels;
 
             notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
             mOutputPortSettingsChange = AWAITING_DISABLED;
+            if (tmpTime > 0) {
+                mNextOutBufferTimeUs = tmpTime;
+            }
             return;
         }
 
@@ -367,19 +424,22 @@ void SoftMP3::onQueueFilled(OMX_U32 /* portIndex */) {
             // The decoder delay is 529 samples, so trim that many samples off
             // the start of the first output buffer. This essentially makes this
             // decoder have zero delay, which the rest of the pipeline assumes.
-            outHeader->nOffset =
+            outFilledOffset =
                 kPVMP3DecoderDelay * mNumChannels * sizeof(int16_t);
 
-            outHeader->nFilledLen =
-                mConfig->outputFrameSize * sizeof(int16_t) - outHeader->nOffset;
+            outFilledLen =
+                mConfig->outputFrameSize * sizeof(int16_t) - outFilledOffset;
         } else if (!mSignalledOutputEos) {
-            outHeader->nOffset = 0;
-            outHeader->nFilledLen = mConfig->outputFrameSize * sizeof(int16_t);
+            outFilledLen += mConfig->outputFrameSize * sizeof(int16_t);
         }
 
-        outHeader->nTimeStamp =
-            mAnchorTimeUs + (mNumFramesOutput * 1000000ll) / mSamplingRate;
-        tmpTime = outHeader->nTimeStamp;
+        outHeader->nOffset = outFilledOffset;
+        outHeader->nFilledLen = outFilledLen;
+
+        if (mBatchedFrames == 0) {
+            outHeader->nTimeStamp =
+                mAnchorTimeUs + (mNumFramesOutput * 1000000ll) / mSamplingRate;
+        }
         if (inHeader) {
             CHECK_GE(inHeader->nFilledLen, mConfig->inputBufferUsedLength);
 
@@ -397,12 +457,18 @@ void SoftMP3::onQueueFilled(OMX_U32 /* portIndex */) {
         }
 
         mNumFramesOutput += mConfig->outputFrameSize / mNumChannels;
+        ++mBatchedFrames;
+
+        // Keep filling the buffer while it has room for another full decoder output.
+        if (!mSignalledOutputEos
+                && mBatchedFrames < mFramesPerBuffer
+                && outHeader->nAllocLen - (outHeader->nOffset + outHeader->nFilledLen)
+                        >= (OMX_U32)kOutputBufferSize) {
+            continue;
+        }
 
-        outInfo->mOwnedByUs = false;
-        outQueue.erase(outQueue.begin());
-        outInfo = NULL;
-        notifyFillBufferDone(outHeader);
-        outHeader = NULL;
+        tmpTime = outHeader->nTimeStamp;
+        returnOutputBuffer();
     }
 
     if (tmpTime > 0) {
@@ -410,7 +476,21 @@ void SoftMP3::onQueueFilled(OMX_U32 /* portIndex */) {
     }
 }
 
+void SoftMP3::returnOutputBuffer() {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+    BufferInfo *outInfo = *outQueue.begin();
+
+    mBatchedFrames = 0;
+
+    outInfo->mOwnedByUs = false;
+    outQueue.erase(outQueue.begin());
+    notifyFillBufferDone(outInfo->mHeader);
+}
+
 void SoftMP3::onPortFlushCompleted(OMX_U32 portIndex) {
+    // a partially batched output buffer was handed back by the flush
+    mBatchedFrames = 0;
+
     if (portIndex == 0) {
         // Make sure that the next buffer output does not still
         // depend on fragments from the last one decoded.
@@ -459,6 +539,7 @@ void SoftMP3::onReset() {
     mOutputPortSettingsChange = NONE;
     mLastAnchorTimeUs = -1;
     mNextOutBufferTimeUs = 0;
+    mBatchedFrames = 0;
 }
 
 }  // namespace android
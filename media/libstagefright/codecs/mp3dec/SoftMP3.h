@@ -48,7 +48,8 @@ private:
     enum {
         kNumBuffers = 4,
         kOutputBufferSize = 4608 * 2,
-        kPVMP3DecoderDelay = 529 // frames
+        kPVMP3DecoderDelay = 529, // frames
+        kMaxBatchJitterUs = 1000,
     };
 
     tPVMP3DecoderExternal *mConfig;
@@ -73,9 +74,15 @@ private:
     int64_t mLastAnchorTimeUs;
     int64_t mNextOutBufferTimeUs;
 
+    // Decoded frames per output buffer, and how many are in the output buffer
+    // at the head of the queue.
+    size_t mFramesPerBuffer;
+    size_t mBatchedFrames;
+
     void initPorts();
     void initDecoder();
-    void *memsetSafe(OMX_BUFFERHEADERTYPE *outHeader, int c, size_t len);
+    void returnOutputBuffer();
+    void *memsetSafe(OMX_BUFFERHEADERTYPE *outHeader, size_t offset, int c, size_t len);
 
     DISALLOW_EVIL_CONSTRUCTORS(SoftMP3);
 };
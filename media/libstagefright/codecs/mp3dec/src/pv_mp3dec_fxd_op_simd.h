@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Four-lane versions of the fixed point operations in pv_mp3dec_fxd_op_c_equivalent.h,
+ * for arm64 NEON and x86 SSE2.
+ *
+ * Every lane produces exactly the value the scalar operation would: products are formed
+ * at full 64-bit precision and then shifted, so kernels built on these helpers are
+ * bit-exact with the C path.  32-bit ARM keeps using the hand-written assembly in asm/.
+ *
+ * Define PV_MP3DEC_NO_SIMD to force the C path, e.g. to produce reference output.
+ */
+
+#ifndef PV_MP3DEC_FXD_OP_SIMD_H
+#define PV_MP3DEC_FXD_OP_SIMD_H
+
+#include "pvmp3_audio_type_defs.h"
+
+#if !defined(PV_MP3DEC_NO_SIMD)
+#if defined(__aarch64__)
+#define PV_MP3DEC_NEON
+#elif defined(__SSE2__)
+#define PV_MP3DEC_SSE2
+#endif
+#endif
+
+#if defined(PV_MP3DEC_NEON) || defined(PV_MP3DEC_SSE2)
+#define PV_MP3DEC_SIMD
+#endif
+
+#if defined(PV_MP3DEC_NEON)
+
+#include <arm_neon.h>
+
+typedef int32x4_t pv_vec4;
+
+static inline pv_vec4 pv_vld(const int32 *p)
+{
+    return vld1q_s32(p);
+}
+
+static inline void pv_vst(int32 *p, pv_vec4 v)
+{
+    vst1q_s32(p, v);
+}
+
+static inline pv_vec4 pv_vdup(int32 a)
+{
+    return vdupq_n_s32(a);
+}
+
+static inline pv_vec4 pv_vadd(pv_vec4 a, pv_vec4 b)
+{
+    return vaddq_s32(a, b);
+}
+
+static inline pv_vec4 pv_vsub(pv_vec4 a, pv_vec4 b)
+{
+    return vsubq_s32(a, b);
+}
+
+/* a << n for n >= 0, arithmetic a >> -n otherwise; |n| < 32 */
+static inline pv_vec4 pv_vshl(pv_vec4 a, int32 n)
+{
+    return vshlq_s32(a, vdupq_n_s32(n));
+}
+
+/* { a[3], a[2], a[1], a[0] } */
+static inline pv_vec4 pv_vrev(pv_vec4 a)
+{
+    pv_vec4 v = vrev64q_s32(a);
+    return vcombine_s32(vget_high_s32(v), vget_low_s32(v));
+}
+
+/* (Int32)(((int64)a * b) >> q) in each lane, 0 < q <= 32 */
+static inline pv_vec4 pv_vmul_q(pv_vec4 a, pv_vec4 b, int32 q)
+{
+    const int64x2_t shift = vdupq_n_s64(-q);
+    int64x2_t lo = vshlq_s64(vmull_s32(vget_low_s32(a), vget_low_s32(b)), shift);
+    int64x2_t hi = vshlq_s64(vmull_s32(vget_high_s32(a), vget_high_s32(b)), shift);
+    return vcombine_s32(vmovn_s64(lo), vmovn_s64(hi));
+}
+
+/* r[i] lane j becomes r[j] lane i */
+static inline void pv_vtranspose(pv_vec4 r[4])
+{
+    int32x4x2_t t01 = vtrnq_s32(r[0], r[1]);
+    int32x4x2_t t23 = vtrnq_s32(r[2], r[3]);
+    r[0] = vcombine_s32(vget_low_s32(t01.val[0]), vget_low_s32(t23.val[0]));
+    r[1] = vcombine_s32(vget_low_s32(t01.val[1]), vget_low_s32(t23.val[1]));
+    r[2] = vcombine_s32(vget_high_s32(t01.val[0]), vget_high_s32(t23.val[0]));
+    r[3] = vcombine_s32(vget_high_s32(t01.val[1]), vget_high_s32(t23.val[1]));
+}
+
+#elif defined(PV_MP3DEC_SSE2)
+
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+typedef __m128i pv_vec4;
+
+static inline pv_vec4 pv_vld(const int32 *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void pv_vst(int32 *p, pv_vec4 v)
+{
+    _mm_storeu_si128((__m128i *)p, v);
+}
+
+static inline pv_vec4 pv_vdup(int32 a)
+{
+    return _mm_set1_epi32(a);
+}
+
+static inline pv_vec4 pv_vadd(pv_vec4 a, pv_vec4 b)
+{
+    return _mm_add_epi32(a, b);
+}
+
+static inline pv_vec4 pv_vsub(pv_vec4 a, pv_vec4 b)
+{
+    return _mm_sub_epi32(a, b);
+}
+
+/* a << n for n >= 0, arithmetic a >> -n otherwise; |n| < 32 */
+static inline pv_vec4 pv_vshl(pv_vec4 a, int32 n)
+{
+    if (n >= 0)
+    {
+        return _mm_sll_epi32(a, _mm_cvtsi32_si128(n));
+    }
+    return _mm_sra_epi32(a, _mm_cvtsi32_si128(-n));
+}
+
+/* { a[3], a[2], a[1], a[0] } */
+static inline pv_vec4 pv_vrev(pv_vec4 a)
+{
+    return _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+/* signed 64-bit products of lanes 0 and 2 */
+static inline __m128i pv_vmull_even(__m128i a, __m128i b)
+{
+#if defined(__SSE4_1__)
+    return _mm_mul_epi32(a, b);
+#else
+    /* the unsigned product, less b << 32 if a < 0 and a << 32 if b < 0 */
+    __m128i p = _mm_mul_epu32(a, b);
+    __m128i c = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b),
+                              _mm_and_si128(_mm_srai_epi32(b, 31), a));
+    return _mm_sub_epi64(p, _mm_slli_epi64(c, 32));
+#endif
+}
+
+/* (Int32)(((int64)a * b) >> q) in each lane, 0 < q <= 32 */
+static inline pv_vec4 pv_vmul_q(pv_vec4 a, pv_vec4 b, int32 q)
+{
+    const __m128i shift = _mm_cvtsi32_si128(q);
+    /* only the low 32 bits of each shifted product are kept, so a logical shift will do */
+    __m128i even = _mm_srl_epi64(pv_vmull_even(a, b), shift);
+    __m128i odd = _mm_srl_epi64(pv_vmull_even(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32)), shift);
+    return _mm_or_si128(_mm_and_si128(even, _mm_set_epi32(0, -1, 0, -1)),
+                        _mm_slli_epi64(odd, 32));
+}
+
+/* r[i] lane j becomes r[j] lane i */
+static inline void pv_vtranspose(pv_vec4 r[4])
+{
+    __m128i t0 = _mm_unpacklo_epi32(r[0], r[1]);
+    __m128i t1 = _mm_unpacklo_epi32(r[2], r[3]);
+    __m128i t2 = _mm_unpackhi_epi32(r[0], r[1]);
+    __m128i t3 = _mm_unpackhi_epi32(r[2], r[3]);
+    r[0] = _mm_unpacklo_epi64(t0, t1);
+    r[1] = _mm_unpackhi_epi64(t0, t1);
+    r[2] = _mm_unpacklo_epi64(t2, t3);
+    r[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+#endif
+
+#endif  /* PV_MP3DEC_FXD_OP_SIMD_H */
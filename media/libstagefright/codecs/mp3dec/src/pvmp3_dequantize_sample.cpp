@@ -96,6 +96,7 @@ Input
 #include "pvmp3_normalize.h"
 #include "mp3_mem_funcs.h"
 #include "pvmp3_tables.h"
+#include "pv_mp3dec_fxd_op_simd.h"
 
 /*----------------------------------------------------------------------------
 ; MACROS
@@ -178,6 +179,48 @@ int32 power_1_third(int32 xx)
 }
 
 
+#if defined(PV_MP3DEC_SIMD)
+
+/*
+ *  Scales n quantized values of one long block band, as the scalar loops in
+ *  pvmp3_dequantize_sample() do: shifted left by shift, or right by -shift.
+ *  Zero values stay zero, so they need no special casing. |shift| < 32.
+ */
+static void pvmp3_dequantize_lines(int32 *is,
+                                   int32 n,
+                                   int32 two_raise_one_fourth,
+                                   int32 shift)
+{
+    pv_vec4 gain = pv_vdup(two_raise_one_fourth);
+    int32 ss = 0;
+
+    for (; ss + 4 <= n; ss += 4)
+    {
+        int32 power[4];
+        power[0] = power_1_third(pv_abs(is[ss    ]));
+        power[1] = power_1_third(pv_abs(is[ss + 1]));
+        power[2] = power_1_third(pv_abs(is[ss + 2]));
+        power[3] = power_1_third(pv_abs(is[ss + 3]));
+
+        pv_vec4 tmp = pv_vmul_q(pv_vshl(pv_vld(&is[ss]), 16), pv_vld(power), 30);
+        pv_vst(&is[ss], pv_vshl(pv_vmul_q(tmp, gain, 30), shift));
+    }
+
+    for (; ss < n; ss++)
+    {
+        int32 tmp = is[ss];
+        if (tmp)
+        {
+            tmp = fxp_mul32_Q30((tmp << 16), power_1_third(pv_abs(tmp)));
+            tmp = fxp_mul32_Q30(tmp, two_raise_one_fourth);
+            is[ss] = (shift < 0) ? (tmp >> -shift) : (tmp << shift);
+        }
+    }
+}
+
+#endif
+
+
 /*----------------------------------------------------------------------------
 ; FUNCTION CODE
 ----------------------------------------------------------------------------*/
@@ -342,6 +385,16 @@ void pvmp3_dequantize_sample(int32 is[SUBBANDS_NUMBER*FILTERBANK_BANDS],
 
             if (used_freq_lines >= mp3_sfBandIndex[sfreq].l[cb+1])
             {
+#if defined(PV_MP3DEC_SIMD)
+                if (global_gain > -32 && global_gain < 32)
+                {
+                    pvmp3_dequantize_lines(&is[mp3_sfBandIndex[sfreq].l[cb]],
+                                           mp3_sfBandIndex[sfreq].l[cb+1] - mp3_sfBandIndex[sfreq].l[cb],
+                                           two_raise_one_fourth,
+                                           global_gain);
+                }
+                else
+#endif
                 if (global_gain <= 0)
                 {
                     global_gain = - global_gain;
@@ -392,6 +445,17 @@ void pvmp3_dequantize_sample(int32 is[SUBBANDS_NUMBER*FILTERBANK_BANDS],
             }
             else
             {
+#if defined(PV_MP3DEC_SIMD)
+                if (global_gain > -32 && global_gain < 32)
+                {
+                    /* lines past used_freq_lines are cleared below */
+                    pvmp3_dequantize_lines(&is[mp3_sfBandIndex[sfreq].l[cb]],
+                                           used_freq_lines - mp3_sfBandIndex[sfreq].l[cb],
+                                           two_raise_one_fourth,
+                                           global_gain);
+                }
+                else
+#endif
                 if (global_gain <= 0)
                 {
                     global_gain = - global_gain;
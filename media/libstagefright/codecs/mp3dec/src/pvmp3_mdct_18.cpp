@@ -70,6 +70,7 @@ Returns
 
 #include "pv_mp3dec_fxd_op.h"
 #include "pvmp3_mdct_18.h"
+#include "pv_mp3dec_fxd_op_simd.h"
 
 
 /*----------------------------------------------------------------------------
@@ -146,8 +147,26 @@ void pvmp3_mdct_18(int32 vec[], int32 *history, const int32 *window)
     int32 *pt_vec   =  vec;
     int32 *pt_vec_o = &vec[17];
 
+    i = 9;
 
-    for (i = 9; i != 0; i--)
+#if defined(PV_MP3DEC_SIMD)
+    for (; i > 1; i -= 4)
+    {
+        pv_vec4 v  = pv_vld(pt_vec);
+        pv_vec4 v1 = pv_vrev(pv_vld(pt_vec_o - 3));
+        pv_vec4 t  = pv_vmul_q(pv_vshl(v, 1), pv_vld(pt_cos), 32);
+        pv_vec4 t1 = pv_vmul_q(v1, pv_vrev(pv_vld(pt_cos_x - 3)), 27);
+        pv_vst(pt_vec, pv_vadd(t, t1));
+        pv_vst(pt_vec_o - 3, pv_vrev(pv_vmul_q(pv_vsub(t, t1), pv_vld(pt_cos_split), 28)));
+        pt_vec += 4;
+        pt_vec_o -= 4;
+        pt_cos += 4;
+        pt_cos_x -= 4;
+        pt_cos_split += 4;
+    }
+#endif
+
+    for (; i != 0; i--)
     {
         tmp  = *(pt_vec);
         tmp1 = *(pt_vec_o);
@@ -243,6 +262,24 @@ void pvmp3_mdct_18(int32 vec[], int32 *history, const int32 *window)
 
     /* next iteration overlap */
 
+#if defined(PV_MP3DEC_SIMD)
+    {
+        /* history[k] and history[17-k] both scale the old history[8-k] */
+        pv_vec4 h0 = pv_vshl(pv_vld(&history[0]), 1);
+        pv_vec4 h4 = pv_vshl(pv_vld(&history[4]), 1);
+        pv_vec4 h1 = pv_vshl(pv_vld(&history[1]), 1);
+        pv_vec4 h5 = pv_vshl(pv_vld(&history[5]), 1);
+        tmp  = history[0] << 1;
+        tmp1 = history[8] << 1;
+
+        pv_vst(&history[ 0], pv_vmul_q(pv_vrev(h5), pv_vld(&window[18]), 32));
+        pv_vst(&history[ 4], pv_vmul_q(pv_vrev(h1), pv_vld(&window[22]), 32));
+        history[ 8] = fxp_mul32_Q32(tmp,  window[26]);
+        pv_vst(&history[ 9], pv_vmul_q(h0, pv_vld(&window[27]), 32));
+        pv_vst(&history[13], pv_vmul_q(h4, pv_vld(&window[31]), 32));
+        history[17] = fxp_mul32_Q32(tmp1, window[35]);
+    }
+#else
     tmp1 = history[ 8];
     tmp3 = history[ 7];
     tmp2 = history[ 1];
@@ -284,6 +321,7 @@ void pvmp3_mdct_18(int32 vec[], int32 *history, const int32 *window)
     history[12] = fxp_mul32_Q32(tmp2, window[30]);
     history[ 6] = fxp_mul32_Q32(tmp,  window[24]);
     history[11] = fxp_mul32_Q32(tmp,  window[29]);
+#endif
 }
 
 #endif // If not assembly
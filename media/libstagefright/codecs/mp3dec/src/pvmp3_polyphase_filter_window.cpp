@@ -75,6 +75,7 @@ Input
 #include "pv_mp3dec_fxd_op.h"
 #include "pvmp3_dec_defs.h"
 #include "pvmp3_tables.h"
+#include "pv_mp3dec_fxd_op_simd.h"
 
 /*----------------------------------------------------------------------------
 ; MACROS
@@ -108,6 +109,64 @@ Input
 ; Declare variables used in this module_x but defined elsewhere
 ----------------------------------------------------------------------------*/
 
+#if defined(PV_MP3DEC_SIMD)
+
+/*
+ *  Phases j .. j+3 of the main loop below, one phase per lane. Valid while the
+ *  inner loop over i runs once, i.e. HAN_SIZE == SUBBANDS_NUMBER << 4.
+ */
+static void pvmp3_polyphase_filter_window_x4(const int32 *synth_buffer,
+        int16 *outPcm,
+        int32 numChannels,
+        int32 j,
+        const int32 *winPtr)
+{
+    const int32 *pt_1 = &synth_buffer[(SUBBANDS_NUMBER >> 1) + j];
+    const int32 *pt_2 = &synth_buffer[(SUBBANDS_NUMBER >> 1) - j - 3];
+    pv_vec4 sum1 = pv_vdup(0x00000020);
+    pv_vec4 sum2 = pv_vdup(0x00000020);
+
+    for (int32 n = 0; n < 16; n += 4)
+    {
+        /* coefficients n .. n+3 of the four phases, one vector per coefficient */
+        pv_vec4 w[4];
+        w[0] = pv_vld(&winPtr[n]);
+        w[1] = pv_vld(&winPtr[n + 16]);
+        w[2] = pv_vld(&winPtr[n + 32]);
+        w[3] = pv_vld(&winPtr[n + 48]);
+        pv_vtranspose(w);
+
+        int32 m = n >> 1;
+        pv_vec4 temp1 = pv_vld(&pt_1[ SUBBANDS_NUMBER*m]);
+        pv_vec4 temp3 = pv_vrev(pv_vld(&pt_2[ SUBBANDS_NUMBER*(15 - m)]));
+        pv_vec4 temp2 = pv_vrev(pv_vld(&pt_2[ SUBBANDS_NUMBER*(m + 1)]));
+        pv_vec4 temp4 = pv_vld(&pt_1[ SUBBANDS_NUMBER*(14 - m)]);
+
+        sum1 = pv_vadd(sum1, pv_vmul_q(temp1, w[0], 32));
+        sum2 = pv_vadd(sum2, pv_vmul_q(temp3, w[0], 32));
+        sum2 = pv_vadd(sum2, pv_vmul_q(temp1, w[1], 32));
+        sum1 = pv_vsub(sum1, pv_vmul_q(temp3, w[1], 32));
+        sum1 = pv_vadd(sum1, pv_vmul_q(temp2, w[2], 32));
+        sum2 = pv_vsub(sum2, pv_vmul_q(temp4, w[2], 32));
+        sum2 = pv_vadd(sum2, pv_vmul_q(temp2, w[3], 32));
+        sum1 = pv_vadd(sum1, pv_vmul_q(temp4, w[3], 32));
+    }
+
+    int32 s1[4];
+    int32 s2[4];
+    pv_vst(s1, sum1);
+    pv_vst(s2, sum2);
+
+    for (int32 l = 0; l < 4; l++)
+    {
+        int32 k = (j + l) << (numChannels - 1);
+        outPcm[k] = saturate16(s1[l] >> 6);
+        outPcm[(numChannels<<5) - k] = saturate16(s2[l] >> 6);
+    }
+}
+
+#endif
+
 /*----------------------------------------------------------------------------
 ; FUNCTION CODE
 ----------------------------------------------------------------------------*/
@@ -120,9 +179,17 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
     int32 sum2;
     const int32 *winPtr = pqmfSynthWin;
     int32 i;
+    int16 j = 1;
 
+#if defined(PV_MP3DEC_SIMD)
+    for (; j + 4 <= SUBBANDS_NUMBER / 2; j += 4)
+    {
+        pvmp3_polyphase_filter_window_x4(synth_buffer, outPcm, numChannels, j, winPtr);
+        winPtr += 64;
+    }
+#endif
 
-    for (int16 j = 1; j < SUBBANDS_NUMBER / 2; j++)
+    for (; j < SUBBANDS_NUMBER / 2; j++)
     {
         sum1 = 0x00000020;
         sum2 = 0x00000020;
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures PV MP3 decoder throughput on a set of files.
+//
+// Access units come from MP3Extractor and are fed to pvmp3_framedecoder() with the
+// configuration and output buffer size that SoftMP3 uses. The checksum of the decoded
+// PCM lets a build with PV_MP3DEC_NO_SIMD confirm the SIMD kernels are bit-exact.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "mp3dec_bench"
+#include <utils/Log.h>
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Vector.h>
+
+#include "pvmp3decoder_api.h"
+
+using namespace android;
+
+static const int32_t kOutputBufferSize = 4608 * 2;  // as in SoftMP3
+
+struct DecodeResult {
+    int64_t mDecodeUs;
+    int64_t mNumFrames;        // per channel
+    int32_t mSampleRate;
+    int32_t mNumChannels;
+    uint32_t mChecksum;
+    bool mError;
+};
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n <runs>] <mp3 file> [<mp3 file> ...]\n", me);
+    fprintf(stderr, "       -n number of times to decode each file, default 3\n");
+    exit(1);
+}
+
+static bool readAccessUnits(const char *path, Vector<sp<ABuffer> > *accessUnits) {
+    sp<MediaExtractor> extractor =
+        MediaExtractor::Create(new FileSource(path), MEDIA_MIMETYPE_AUDIO_MPEG);
+    if (extractor == NULL || extractor->countTracks() == 0) {
+        return false;
+    }
+
+    sp<MediaSource> source = extractor->getTrack(0);
+    if (source == NULL || source->start() != OK) {
+        return false;
+    }
+
+    MediaBuffer *buffer;
+    while (source->read(&buffer) == OK) {
+        sp<ABuffer> accessUnit = new ABuffer(buffer->range_length());
+        memcpy(accessUnit->data(),
+               (const uint8_t *)buffer->data() + buffer->range_offset(),
+               buffer->range_length());
+        accessUnits->push(accessUnit);
+        buffer->release();
+    }
+    source->stop();
+
+    return !accessUnits->isEmpty();
+}
+
+// FNV-1a over the PCM bytes.
+static uint32_t checksum(uint32_t hash, const int16_t *pcm, size_t numSamples) {
+    const uint8_t *p = (const uint8_t *)pcm;
+    for (size_t i = 0; i < numSamples * sizeof(int16_t); ++i) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void decode(const Vector<sp<ABuffer> > &accessUnits, void *decoderBuf,
+        int16_t *pcm, DecodeResult *result) {
+    tPVMP3DecoderExternal config;
+    memset(&config, 0, sizeof(config));
+    config.equalizerType = flat;
+    config.crcEnabled = false;
+    pvmp3_InitDecoder(&config, decoderBuf);
+
+    memset(result, 0, sizeof(*result));
+    result->mChecksum = 2166136261u;
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    for (size_t i = 0; i < accessUnits.size(); ++i) {
+        const sp<ABuffer> &accessUnit = accessUnits.itemAt(i);
+        size_t offset = 0;
+
+        while (offset < accessUnit->size()) {
+            config.pInputBuffer = accessUnit->data() + offset;
+            config.inputBufferCurrentLength = accessUnit->size() - offset;
+            config.inputBufferMaxLength = 0;
+            config.inputBufferUsedLength = 0;
+            config.outputFrameSize = kOutputBufferSize / sizeof(int16_t);
+            config.pOutputBuffer = pcm;
+
+            ERROR_CODE err = pvmp3_framedecoder(&config, decoderBuf);
+            if (err != NO_DECODING_ERROR) {
+                // SoftMP3 plays silence for the recoverable errors and drops the rest
+                // of the access unit.
+                if (err != NO_ENOUGH_MAIN_DATA_ERROR && err != SIDE_INFO_ERROR
+                        && err != SYNCH_LOST_ERROR) {
+                    ALOGE("mp3 decoder returned error %d", err);
+                    result->mError = true;
+                }
+                break;
+            }
+
+            result->mSampleRate = config.samplingRate;
+            result->mNumChannels = config.num_channels;
+            if (config.num_channels > 0) {
+                result->mNumFrames += config.outputFrameSize / config.num_channels;
+            }
+            result->mChecksum = checksum(result->mChecksum, pcm, config.outputFrameSize);
+
+            if (config.inputBufferUsedLength == 0) {
+                break;
+            }
+            offset += config.inputBufferUsedLength;
+        }
+
+        if (result->mError) {
+            break;
+        }
+    }
+
+    result->mDecodeUs = ALooper::GetNowUs() - startUs;
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    int numRuns = 3;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:")) >= 0) {
+        switch (res) {
+            case 'n':
+            {
+                numRuns = atoi(optarg);
+                if (numRuns < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1) {
+        usage(me);
+    }
+
+    DataSource::RegisterDefaultSniffers();
+
+    void *decoderBuf = malloc(pvmp3_decoderMemRequirements());
+    int16_t *pcm = (int16_t *)malloc(kOutputBufferSize);
+
+    int64_t totalDecodeUs = 0;
+    double totalAudioSecs = 0;
+    int failures = 0;
+
+    for (int i = 0; i < argc; ++i) {
+        Vector<sp<ABuffer> > accessUnits;
+        if (!readAccessUnits(argv[i], &accessUnits)) {
+            fprintf(stderr, "unable to extract mp3 frames from '%s'\n", argv[i]);
+            ++failures;
+            continue;
+        }
+
+        DecodeResult best;
+        memset(&best, 0, sizeof(best));
+        best.mDecodeUs = -1;
+        for (int run = 0; run < numRuns; ++run) {
+            DecodeResult result;
+            decode(accessUnits, decoderBuf, pcm, &result);
+            if (best.mDecodeUs < 0 || result.mDecodeUs < best.mDecodeUs) {
+                best = result;
+            }
+        }
+
+        if (best.mError) {
+            fprintf(stderr, "decode error in '%s'\n", argv[i]);
+            ++failures;
+        }
+        if (best.mDecodeUs <= 0) {
+            best.mDecodeUs = 1;
+        }
+
+        const double audioSecs =
+            best.mSampleRate > 0 ? (double)best.mNumFrames / best.mSampleRate : 0;
+        totalAudioSecs += audioSecs;
+        totalDecodeUs += best.mDecodeUs;
+
+        printf("%s: %d Hz %d ch, %.2f s of audio in %.2f ms, %.1fx realtime, checksum %08x\n",
+               argv[i], best.mSampleRate, best.mNumChannels, audioSecs,
+               best.mDecodeUs / 1E3, audioSecs * 1E6 / best.mDecodeUs, best.mChecksum);
+    }
+
+    free(pcm);
+    free(decoderBuf);
+
+    if (argc > 1 && totalDecodeUs > 0) {
+        printf("total: %.2f s of audio in %.2f ms, %.1fx realtime\n",
+               totalAudioSecs, totalDecodeUs / 1E3, totalAudioSecs * 1E6 / totalDecodeUs);
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -77,7 +77,10 @@ status_t SoftVPX::initDecoder() {
     vpx_codec_flags_t flags;
     memset(&cfg, 0, sizeof(vpx_codec_dec_cfg_t));
     memset(&flags, 0, sizeof(vpx_codec_flags_t));
-    cfg.threads = GetCPUCoreCount();
+    cfg.threads = threadBudget();
+    if (cfg.threads == 0) {
+        cfg.threads = GetCPUCoreCount();
+    }
 
     if (mFrameParallelMode) {
         flags |= VPX_CODEC_USE_FRAME_THREADING;
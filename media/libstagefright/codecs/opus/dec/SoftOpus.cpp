@@ -62,6 +62,7 @@ SoftOpus::SoftOpus(
       mSeekPreRoll(0),
       mAnchorTimeUs(0),
       mNumFramesOutput(0),
+      mFloatOutput(false),
       mOutputPortSettingsChange(NONE) {
     initPorts();
     CHECK_EQ(initDecoder(), (status_t)OK);
@@ -171,7 +172,7 @@ OMX_ERRORTYPE SoftOpus::internalGetParameter(
             pcmParams->eNumData = OMX_NumericalDataSigned;
             pcmParams->eEndian = OMX_EndianBig;
             pcmParams->bInterleaved = OMX_TRUE;
-            pcmParams->nBitPerSample = 16;
+            pcmParams->nBitPerSample = mFloatOutput ? 32 : 16;
             pcmParams->ePCMMode = OMX_AUDIO_PCMModeLinear;
             pcmParams->eChannelMapping[0] = OMX_AUDIO_ChannelLF;
             pcmParams->eChannelMapping[1] = OMX_AUDIO_ChannelRF;
@@ -228,6 +229,32 @@ OMX_ERRORTYPE SoftOpus::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case OMX_IndexParamAudioPcm:
+        {
+            const OMX_AUDIO_PARAM_PCMMODETYPE *pcmParams =
+                (const OMX_AUDIO_PARAM_PCMMODETYPE *)params;
+
+            if (!isValidOMXParam(pcmParams)) {
+                return OMX_ErrorBadParameter;
+            }
+
+            if (pcmParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            // The channel count and sample rate come from the stream, only the
+            // sample format can be chosen: 16 bit integer or, as 32 bits, float.
+            if (pcmParams->nBitPerSample != 16 && pcmParams->nBitPerSample != 32) {
+                return OMX_ErrorUnsupportedSetting;
+            }
+
+            mFloatOutput = pcmParams->nBitPerSample == 32;
+            editPortInfo(1)->mDef.nBufferSize =
+                kMaxNumSamplesPerBuffer * sampleSize() * kMaxChannels;
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
@@ -237,6 +264,10 @@ bool SoftOpus::isConfigured() const {
     return mInputBufferCount >= 1;
 }
 
+size_t SoftOpus::sampleSize() const {
+    return mFloatOutput ? sizeof(float) : sizeof(int16_t);
+}
+
 static uint16_t ReadLE16(const uint8_t *data, size_t data_size,
                          uint32_t read_offset) {
     if (read_offset + 1 > data_size)
@@ -459,17 +490,28 @@ void SoftOpus::onQueueFilled(OMX_U32 portIndex) {
         const uint8_t *data = inHeader->pBuffer + inHeader->nOffset;
         const uint32_t size = inHeader->nFilledLen;
         size_t frameSize = kMaxOpusOutputPacketSizeSamples;
-        if (frameSize > outHeader->nAllocLen / sizeof(int16_t) / mHeader->channels) {
-            frameSize = outHeader->nAllocLen / sizeof(int16_t) / mHeader->channels;
+        if (frameSize > outHeader->nAllocLen / sampleSize() / mHeader->channels) {
+            frameSize = outHeader->nAllocLen / sampleSize() / mHeader->channels;
             android_errorWriteLog(0x534e4554, "27833616");
         }
 
-        int numFrames = opus_multistream_decode(mDecoder,
+        // In float mode the decoder's own output is passed on unquantized.
+        int numFrames;
+        if (mFloatOutput) {
+            numFrames = opus_multistream_decode_float(mDecoder,
+                                                      data,
+                                                      size,
+                                                      (float *)outHeader->pBuffer,
+                                                      frameSize,
+                                                      0);
+        } else {
+            numFrames = opus_multistream_decode(mDecoder,
                                                 data,
                                                 size,
                                                 (int16_t *)outHeader->pBuffer,
                                                 frameSize,
                                                 0);
+        }
         if (numFrames < 0) {
             ALOGE("opus_multistream_decode returned %d", numFrames);
             notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
@@ -483,13 +525,13 @@ void SoftOpus::onQueueFilled(OMX_U32 portIndex) {
                 numFrames = 0;
             } else {
                 numFrames -= mSamplesToDiscard;
-                outHeader->nOffset = mSamplesToDiscard * sizeof(int16_t) *
+                outHeader->nOffset = mSamplesToDiscard * sampleSize() *
                                      mHeader->channels;
                 mSamplesToDiscard = 0;
             }
         }
 
-        outHeader->nFilledLen = numFrames * sizeof(int16_t) * mHeader->channels;
+        outHeader->nFilledLen = numFrames * sampleSize() * mHeader->channels;
         outHeader->nFlags = 0;
 
         outHeader->nTimeStamp = mAnchorTimeUs +
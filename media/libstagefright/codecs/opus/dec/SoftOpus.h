@@ -76,6 +76,10 @@ private:
     int64_t mAnchorTimeUs;
     int64_t mNumFramesOutput;
 
+    // Output float samples rather than int16, selected by a 32 bits
+    // per sample OMX_IndexParamAudioPcm on the output port.
+    bool mFloatOutput;
+
     enum {
         NONE,
         AWAITING_DISABLED,
@@ -85,6 +89,7 @@ private:
     void initPorts();
     status_t initDecoder();
     bool isConfigured() const;
+    size_t sampleSize() const;
 
     DISALLOW_EVIL_CONSTRUCTORS(SoftOpus);
 };
@@ -6,12 +6,14 @@ LOCAL_SRC_FILES := \
 
 LOCAL_C_INCLUDES := \
         frameworks/av/media/libstagefright/include \
-        frameworks/native/include/media/openmax
+        frameworks/native/include/media/openmax \
+        $(call include-path-for, audio-utils)
 
 LOCAL_CFLAGS += -Werror
 
 LOCAL_SHARED_LIBRARIES := \
-        libstagefright_omx libstagefright_foundation libutils liblog
+        libstagefright_omx libstagefright_foundation libutils liblog \
+        libaudioutils
 
 LOCAL_MODULE := libstagefright_soft_rawdec
 LOCAL_MODULE_TAGS := optional
@@ -20,6 +20,7 @@
 
 #include "SoftRaw.h"
 
+#include <audio_utils/primitives.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/hexdump.h>
 
@@ -34,6 +35,12 @@ static void InitOMXParams(T *params) {
     params->nVersion.s.nStep = 0;
 }
 
+// Size in bytes of a sample in a buffer with the given bits per sample.
+// 24 bit samples arrive left justified in 32 bits, see getPCMFormat().
+static size_t SampleSize(int32_t bitsPerSample) {
+    return bitsPerSample == 24 ? sizeof(int32_t) : bitsPerSample / 8;
+}
+
 SoftRaw::SoftRaw(
         const char *name,
         const OMX_CALLBACKTYPE *callbacks,
@@ -43,7 +50,8 @@ SoftRaw::SoftRaw(
       mSignalledError(false),
       mChannelCount(2),
       mSampleRate(44100),
-      mBitsPerSample(16) {
+      mBitsPerSample(16),
+      mOutputBitsPerSample(16) {
     initPorts();
     CHECK_EQ(initDecoder(), (status_t)OK);
 }
@@ -115,7 +123,8 @@ OMX_ERRORTYPE SoftRaw::internalGetParameter(
             pcmParams->eNumData = OMX_NumericalDataSigned;
             pcmParams->eEndian = OMX_EndianBig;
             pcmParams->bInterleaved = OMX_TRUE;
-            pcmParams->nBitPerSample = mBitsPerSample;
+            pcmParams->nBitPerSample =
+                pcmParams->nPortIndex == 0 ? mBitsPerSample : mOutputBitsPerSample;
             pcmParams->ePCMMode = OMX_AUDIO_PCMModeLinear;
             pcmParams->eChannelMapping[0] = OMX_AUDIO_ChannelLF;
             pcmParams->eChannelMapping[1] = OMX_AUDIO_ChannelRF;
@@ -161,6 +170,20 @@ OMX_ERRORTYPE SoftRaw::internalSetParameter(
                 return OMX_ErrorBadParameter;
             }
 
+            if (pcmParams->nPortIndex == 1) {
+                // Only the sample format of the output can be chosen, the
+                // channel count and sample rate follow the input.
+                if (!canConvert(pcmParams->nBitPerSample)) {
+                    return OMX_ErrorUnsupportedSetting;
+                }
+
+                mOutputBitsPerSample = pcmParams->nBitPerSample;
+                editPortInfo(1)->mDef.nBufferSize =
+                    outputSize(editPortInfo(0)->mDef.nBufferSize);
+
+                return OMX_ErrorNone;
+            }
+
             if (pcmParams->nPortIndex != 0) {
                 return OMX_ErrorUndefined;
             }
@@ -169,6 +192,10 @@ OMX_ERRORTYPE SoftRaw::internalSetParameter(
             mSampleRate = pcmParams->nSamplingRate;
             mBitsPerSample = pcmParams->nBitPerSample;
 
+            // Setting the input format cancels any earlier conversion.
+            mOutputBitsPerSample = mBitsPerSample;
+            editPortInfo(1)->mDef.nBufferSize = editPortInfo(0)->mDef.nBufferSize;
+
             return OMX_ErrorNone;
         }
 
@@ -177,6 +204,56 @@ OMX_ERRORTYPE SoftRaw::internalSetParameter(
     }
 }
 
+bool SoftRaw::canConvert(int32_t outputBitsPerSample) const {
+    if (outputBitsPerSample == mBitsPerSample) {
+        return true;
+    }
+    switch (mBitsPerSample) {
+        case 16:
+            return outputBitsPerSample == 32;
+        case 24:
+            return outputBitsPerSample == 16 || outputBitsPerSample == 32;
+        case 32:
+            return outputBitsPerSample == 16;
+        default:
+            return false;
+    }
+}
+
+size_t SoftRaw::outputSize(size_t inputSize) const {
+    if (mOutputBitsPerSample == mBitsPerSample) {
+        return inputSize;
+    }
+    return inputSize / SampleSize(mBitsPerSample) * SampleSize(mOutputBitsPerSample);
+}
+
+// Converts srcSize bytes of input samples to the output format.
+void SoftRaw::convert(void *dst, const void *src, size_t srcSize) const {
+    if (mOutputBitsPerSample == mBitsPerSample) {
+        memcpy(dst, src, srcSize);
+        return;
+    }
+
+    const size_t count = srcSize / SampleSize(mBitsPerSample);
+    switch (mBitsPerSample) {
+        case 16:
+            memcpy_to_float_from_i16((float *)dst, (const int16_t *)src, count);
+            break;
+        case 24:
+            if (mOutputBitsPerSample == 16) {
+                memcpy_to_i16_from_i32((int16_t *)dst, (const int32_t *)src, count);
+            } else {
+                memcpy_to_float_from_i32((float *)dst, (const int32_t *)src, count);
+            }
+            break;
+        case 32:
+            memcpy_to_i16_from_float((int16_t *)dst, (const float *)src, count);
+            break;
+        default:
+            TRESPASS();
+    }
+}
+
 void SoftRaw::onQueueFilled(OMX_U32 /* portIndex */) {
     if (mSignalledError) {
         return;
@@ -192,14 +269,15 @@ void SoftRaw::onQueueFilled(OMX_U32 /* portIndex */) {
         BufferInfo *outInfo = *outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
-        CHECK_GE(outHeader->nAllocLen, inHeader->nFilledLen);
-        memcpy(outHeader->pBuffer,
-               inHeader->pBuffer + inHeader->nOffset,
-               inHeader->nFilledLen);
+        const size_t outSize = outputSize(inHeader->nFilledLen);
+        CHECK_GE(outHeader->nAllocLen, outSize);
+        convert(outHeader->pBuffer,
+                inHeader->pBuffer + inHeader->nOffset,
+                inHeader->nFilledLen);
 
         outHeader->nFlags = inHeader->nFlags;
         outHeader->nOffset = 0;
-        outHeader->nFilledLen = inHeader->nFilledLen;
+        outHeader->nFilledLen = outSize;
         outHeader->nTimeStamp = inHeader->nTimeStamp;
 
         bool sawEOS = (inHeader->nFlags & OMX_BUFFERFLAG_EOS) != 0;
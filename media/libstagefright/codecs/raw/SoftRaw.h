@@ -52,8 +52,16 @@ private:
     int32_t mSampleRate;
     int32_t mBitsPerSample;
 
+    // Bits per sample of the output port. Follows the input unless a PCM
+    // format conversion is selected on the output port: 16 is int16 and
+    // 32 is float, as on the input.
+    int32_t mOutputBitsPerSample;
+
     void initPorts();
     status_t initDecoder();
+    bool canConvert(int32_t outputBitsPerSample) const;
+    size_t outputSize(size_t inputSize) const;
+    void convert(void *dst, const void *src, size_t srcSize) const;
 
     DISALLOW_EVIL_CONSTRUCTORS(SoftRaw);
 };
@@ -6,12 +6,13 @@ LOCAL_SRC_FILES := \
 
 LOCAL_C_INCLUDES := \
         external/tremolo \
+        $(call include-path-for, audio-utils) \
         frameworks/av/media/libstagefright/include \
         frameworks/native/include/media/openmax \
 
 LOCAL_SHARED_LIBRARIES := \
         libvorbisidec libstagefright libstagefright_omx \
-        libstagefright_foundation libutils liblog
+        libstagefright_foundation libutils liblog libaudioutils
 
 LOCAL_MODULE := libstagefright_soft_vorbisdec
 LOCAL_MODULE_TAGS := optional
@@ -22,6 +22,7 @@
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaDefs.h>
+#include <audio_utils/primitives.h>
 
 extern "C" {
     #include <Tremolo/codec_internal.h>
@@ -56,6 +57,7 @@ SoftVorbis::SoftVorbis(
       mNumFramesLeftOnPage(-1),
       mSawInputEos(false),
       mSignalledOutputEos(false),
+      mFloatOutput(false),
       mOutputPortSettingsChange(NONE),
       mSignalledError(false) {
     initPorts();
@@ -177,7 +179,7 @@ OMX_ERRORTYPE SoftVorbis::internalGetParameter(
             pcmParams->eNumData = OMX_NumericalDataSigned;
             pcmParams->eEndian = OMX_EndianBig;
             pcmParams->bInterleaved = OMX_TRUE;
-            pcmParams->nBitPerSample = 16;
+            pcmParams->nBitPerSample = mFloatOutput ? 32 : 16;
             pcmParams->ePCMMode = OMX_AUDIO_PCMModeLinear;
             pcmParams->eChannelMapping[0] = OMX_AUDIO_ChannelLF;
             pcmParams->eChannelMapping[1] = OMX_AUDIO_ChannelRF;
@@ -235,6 +237,31 @@ OMX_ERRORTYPE SoftVorbis::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case OMX_IndexParamAudioPcm:
+        {
+            const OMX_AUDIO_PARAM_PCMMODETYPE *pcmParams =
+                (const OMX_AUDIO_PARAM_PCMMODETYPE *)params;
+
+            if (!isValidOMXParam(pcmParams)) {
+                return OMX_ErrorBadParameter;
+            }
+
+            if (pcmParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            // The channel count and sample rate come from the stream, only the
+            // sample format can be chosen: 16 bit integer or, as 32 bits, float.
+            if (pcmParams->nBitPerSample != 16 && pcmParams->nBitPerSample != 32) {
+                return OMX_ErrorUnsupportedSetting;
+            }
+
+            mFloatOutput = pcmParams->nBitPerSample == 32;
+            editPortInfo(1)->mDef.nBufferSize = kMaxNumSamplesPerBuffer * sampleSize();
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
@@ -244,6 +271,10 @@ bool SoftVorbis::isConfigured() const {
     return mInputBufferCount >= 2;
 }
 
+size_t SoftVorbis::sampleSize() const {
+    return mFloatOutput ? sizeof(float) : sizeof(int16_t);
+}
+
 static void makeBitReader(
         const void *data, size_t size,
         ogg_buffer *buf, ogg_reference *ref, oggpack_buffer *bits) {
@@ -397,8 +428,8 @@ void SoftVorbis::onQueueFilled(OMX_U32 portIndex) {
 #endif
         } else {
             size_t numSamplesPerBuffer = kMaxNumSamplesPerBuffer;
-            if (numSamplesPerBuffer > outHeader->nAllocLen / sizeof(int16_t)) {
-                numSamplesPerBuffer = outHeader->nAllocLen / sizeof(int16_t);
+            if (numSamplesPerBuffer > outHeader->nAllocLen / sampleSize()) {
+                numSamplesPerBuffer = outHeader->nAllocLen / sampleSize();
                 android_errorWriteLog(0x534e4554, "27833616");
             }
             numFrames = vorbis_dsp_pcmout(
@@ -408,6 +439,10 @@ void SoftVorbis::onQueueFilled(OMX_U32 portIndex) {
             if (numFrames < 0) {
                 ALOGE("vorbis_dsp_pcmout returned %d", numFrames);
                 numFrames = 0;
+            } else if (mFloatOutput) {
+                // Tremolo only produces int16; widen in place, back to front.
+                memcpy_to_float_from_i16((float *)outHeader->pBuffer,
+                        (const int16_t *)outHeader->pBuffer, numFrames * mVi->channels);
             }
         }
 
@@ -424,7 +459,7 @@ void SoftVorbis::onQueueFilled(OMX_U32 portIndex) {
             mNumFramesLeftOnPage -= numFrames;
         }
 
-        outHeader->nFilledLen = numFrames * sizeof(int16_t) * mVi->channels;
+        outHeader->nFilledLen = numFrames * sampleSize() * mVi->channels;
         outHeader->nOffset = 0;
 
         outHeader->nTimeStamp =
@@ -62,6 +62,10 @@ private:
     bool mSawInputEos;
     bool mSignalledOutputEos;
 
+    // Output float samples rather than int16, selected by a 32 bits
+    // per sample OMX_IndexParamAudioPcm on the output port.
+    bool mFloatOutput;
+
     enum {
         NONE,
         AWAITING_DISABLED,
@@ -73,6 +77,7 @@ private:
     void initPorts();
     status_t initDecoder();
     bool isConfigured() const;
+    size_t sampleSize() const;
 
     DISALLOW_EVIL_CONSTRUCTORS(SoftVorbis);
 };
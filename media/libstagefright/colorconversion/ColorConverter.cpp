@@ -22,8 +22,165 @@
 #include <media/stagefright/ColorConverter.h>
 #include <media/stagefright/MediaErrors.h>
 
+#include <string.h>
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON_CONVERSION 1
+#define USE_SSE2_CONVERSION 0
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_NEON_CONVERSION 0
+#define USE_SSE2_CONVERSION 1
+#else
+#define USE_NEON_CONVERSION 0
+#define USE_SSE2_CONVERSION 0
+#endif
+
 namespace android {
 
+// Layout of the chroma samples of a 4:2:0 row.
+enum ChromaLayout {
+    kChromaPlanar,      // separate U and V rows, src_u and src_v
+    kChromaUV,          // interleaved in src_u, U first
+    kChromaVU,          // interleaved in src_u, V first
+};
+
+// Converts eight pixels at a time, computing exactly what the per pixel loops below compute:
+// the sums are the same, and clipping x / 256 is the same as clipping x >> 8 since both are
+// <= 0 for any negative x. Returns the number of pixels converted, a multiple of 8, the
+// caller converts the rest. With swapRB blue goes to the high bits, like the semi planar
+// formats do.
+static size_t convertRowToRGB565(
+        const uint8_t *src_y, const uint8_t *src_u, const uint8_t *src_v,
+        ChromaLayout layout, bool swapRB, uint16_t *dst_ptr, size_t width) {
+    size_t x = 0;
+
+#if USE_NEON_CONVERSION
+    const int16x8_t kYOffset = vdupq_n_s16(16);
+    const int16x4_t kUVOffset = vdup_n_s16(128);
+
+    for (; x + 8 <= width; x += 8) {
+        int16x8_t y = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src_y + x))), kYOffset);
+
+        uint8x8_t u8, v8;
+        if (layout == kChromaPlanar) {
+            uint32_t u4, v4;    // four samples each
+            memcpy(&u4, src_u + x / 2, sizeof(u4));
+            memcpy(&v4, src_v + x / 2, sizeof(v4));
+            u8 = vreinterpret_u8_u32(vdup_n_u32(u4));
+            v8 = vreinterpret_u8_u32(vdup_n_u32(v4));
+        } else {
+            uint8x8x2_t uv = vuzp_u8(vld1_u8(src_u + x), vld1_u8(src_u + x));
+            u8 = uv.val[layout == kChromaUV ? 0 : 1];
+            v8 = uv.val[layout == kChromaUV ? 1 : 0];
+        }
+        int16x4_t u = vsub_s16(vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(u8))), kUVOffset);
+        int16x4_t v = vsub_s16(vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(v8))), kUVOffset);
+
+        int32x4_t u_b = vmull_n_s16(u, 517);
+        int32x4_t uv_g = vmlal_n_s16(vmull_n_s16(u, -100), v, -208);
+        int32x4_t v_r = vmull_n_s16(v, 409);
+
+        // each chroma sample is shared by two pixels
+        int32x4x2_t b2 = vzipq_s32(u_b, u_b);
+        int32x4x2_t g2 = vzipq_s32(uv_g, uv_g);
+        int32x4x2_t r2 = vzipq_s32(v_r, v_r);
+
+        int32x4_t tmpLo = vmull_n_s16(vget_low_s16(y), 298);
+        int32x4_t tmpHi = vmull_n_s16(vget_high_s16(y), 298);
+
+        uint8x8_t b = vqmovn_u16(vcombine_u16(
+                vqshrun_n_s32(vaddq_s32(tmpLo, b2.val[0]), 8),
+                vqshrun_n_s32(vaddq_s32(tmpHi, b2.val[1]), 8)));
+        uint8x8_t g = vqmovn_u16(vcombine_u16(
+                vqshrun_n_s32(vaddq_s32(tmpLo, g2.val[0]), 8),
+                vqshrun_n_s32(vaddq_s32(tmpHi, g2.val[1]), 8)));
+        uint8x8_t r = vqmovn_u16(vcombine_u16(
+                vqshrun_n_s32(vaddq_s32(tmpLo, r2.val[0]), 8),
+                vqshrun_n_s32(vaddq_s32(tmpHi, r2.val[1]), 8)));
+
+        uint16x8_t rgb = vshll_n_u8(swapRB ? b : r, 8);
+        rgb = vsriq_n_u16(rgb, vshll_n_u8(g, 8), 5);
+        rgb = vsriq_n_u16(rgb, vshll_n_u8(swapRB ? r : b, 8), 11);
+        vst1q_u16(dst_ptr + x, rgb);
+    }
+#elif USE_SSE2_CONVERSION
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i kYOffset = _mm_set1_epi16(16);
+    const __m128i kUVOffset = _mm_set1_epi32(128);
+    const __m128i kMax = _mm_set1_epi16(255);
+    // pairs of 16-bit coefficients for _mm_madd_epi16()
+    const __m128i kY = _mm_set1_epi32(298);
+    const __m128i kUB = _mm_set1_epi32(517);
+    const __m128i kVR = _mm_set1_epi32(409);
+    const __m128i kUVG = _mm_set1_epi32((-208 << 16) | (-100 & 0xffff));
+
+    for (; x + 8 <= width; x += 8) {
+        __m128i y = _mm_sub_epi16(
+                _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src_y + x)), zero),
+                kYOffset);
+
+        // one chroma sample in the low half of each 32-bit lane
+        __m128i u, v;
+        if (layout == kChromaPlanar) {
+            int32_t u4, v4;
+            memcpy(&u4, src_u + x / 2, sizeof(u4));
+            memcpy(&v4, src_v + x / 2, sizeof(v4));
+            u = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(u4), zero), zero);
+            v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v4), zero), zero);
+        } else {
+            __m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src_u + x)), zero);
+            __m128i even = _mm_and_si128(uv, _mm_set1_epi32(0xffff));
+            __m128i odd = _mm_srli_epi32(uv, 16);
+            u = layout == kChromaUV ? even : odd;
+            v = layout == kChromaUV ? odd : even;
+        }
+        u = _mm_sub_epi32(u, kUVOffset);
+        v = _mm_sub_epi32(v, kUVOffset);
+
+        __m128i u_b = _mm_madd_epi16(u, kUB);
+        __m128i v_r = _mm_madd_epi16(v, kVR);
+        __m128i uv_g = _mm_madd_epi16(_mm_or_si128(
+                _mm_and_si128(u, _mm_set1_epi32(0xffff)), _mm_slli_epi32(v, 16)), kUVG);
+
+        __m128i tmpLo = _mm_madd_epi16(_mm_unpacklo_epi16(y, zero), kY);
+        __m128i tmpHi = _mm_madd_epi16(_mm_unpackhi_epi16(y, zero), kY);
+
+        // sums >> 8 fit in 16 bits, clipped to 0..255
+        __m128i b = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_add_epi32(tmpLo, _mm_unpacklo_epi32(u_b, u_b)), 8),
+                _mm_srai_epi32(_mm_add_epi32(tmpHi, _mm_unpackhi_epi32(u_b, u_b)), 8));
+        __m128i g = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_add_epi32(tmpLo, _mm_unpacklo_epi32(uv_g, uv_g)), 8),
+                _mm_srai_epi32(_mm_add_epi32(tmpHi, _mm_unpackhi_epi32(uv_g, uv_g)), 8));
+        __m128i r = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_add_epi32(tmpLo, _mm_unpacklo_epi32(v_r, v_r)), 8),
+                _mm_srai_epi32(_mm_add_epi32(tmpHi, _mm_unpackhi_epi32(v_r, v_r)), 8));
+        b = _mm_min_epi16(_mm_max_epi16(b, zero), kMax);
+        g = _mm_min_epi16(_mm_max_epi16(g, zero), kMax);
+        r = _mm_min_epi16(_mm_max_epi16(r, zero), kMax);
+
+        __m128i hi = swapRB ? b : r;
+        __m128i lo = swapRB ? r : b;
+        __m128i rgb = _mm_or_si128(
+                _mm_slli_epi16(_mm_srli_epi16(hi, 3), 11),
+                _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(g, 2), 5), _mm_srli_epi16(lo, 3)));
+        _mm_storeu_si128((__m128i *)(dst_ptr + x), rgb);
+    }
+#else
+    (void)src_y;
+    (void)src_u;
+    (void)src_v;
+    (void)layout;
+    (void)swapRB;
+    (void)dst_ptr;
+    (void)width;
+#endif
+
+    return x;
+}
+
 ColorConverter::ColorConverter(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
@@ -220,7 +377,9 @@ status_t ColorConverter::convertYUV420Planar(
         src_u + (src.mWidth / 2) * (src.mHeight / 2);
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
+        size_t x = convertRowToRGB565(
+                src_y, src_u, src_v, kChromaPlanar, false, dst_ptr, src.cropWidth());
+        for (; x < src.cropWidth(); x += 2) {
             // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
             // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
             // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
@@ -311,7 +470,9 @@ status_t ColorConverter::convertQCOMYUV420SemiPlanar(
         + src.mCropTop * src.mWidth + src.mCropLeft;
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
+        size_t x = convertRowToRGB565(
+                src_y, src_u, NULL, kChromaUV, true, dst_ptr, src.cropWidth());
+        for (; x < src.cropWidth(); x += 2) {
             signed y1 = (signed)src_y[x] - 16;
             signed y2 = (signed)src_y[x + 1] - 16;
 
@@ -385,7 +546,9 @@ status_t ColorConverter::convertYUV420SemiPlanar(
         + src.mCropTop * src.mWidth + src.mCropLeft;
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
+        size_t x = convertRowToRGB565(
+                src_y, src_u, NULL, kChromaVU, true, dst_ptr, src.cropWidth());
+        for (; x < src.cropWidth(); x += 2) {
             signed y1 = (signed)src_y[x] - 16;
             signed y2 = (signed)src_y[x + 1] - 16;
 
@@ -455,7 +618,9 @@ status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
         (const uint8_t *)src_y + src.mWidth * (src.mHeight - src.mCropTop / 2);
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
+        size_t x = convertRowToRGB565(
+                src_y, src_u, NULL, kChromaUV, false, dst_ptr, src.cropWidth());
+        for (; x < src.cropWidth(); x += 2) {
             signed y1 = (signed)src_y[x] - 16;
             signed y2 = (signed)src_y[x + 1] - 16;
 
@@ -33,6 +33,14 @@ static bool runningInEmulator() {
     return (property_get("ro.kernel.qemu", prop, NULL) > 0);
 }
 
+// YUV frames are handed to the display as YV12, which every device must be
+// able to compose or texture from, unless media.stagefright.swrender-yuv is
+// false; they are converted to RGB565 on the CPU otherwise.
+static bool yuvRenderingEnabled() {
+    return !runningInEmulator()
+            && property_get_bool("media.stagefright.swrender-yuv", true);
+}
+
 static int ALIGN(int x, int y) {
     // y must be a power of 2.
     return (x + y - 1) & ~(y - 1);
@@ -100,6 +108,10 @@ void SoftwareRenderer::resetFormatIfChanged(const sp<AMessage> &format) {
     mCropWidth = mCropRight - mCropLeft + 1;
     mCropHeight = mCropBottom - mCropTop + 1;
 
+    delete mConverter;
+    mConverter = NULL;
+    mYUVMode = None;
+
     // by default convert everything to RGB565
     int halFormat = HAL_PIXEL_FORMAT_RGB_565;
     size_t bufWidth = mCropWidth;
@@ -108,17 +120,20 @@ void SoftwareRenderer::resetFormatIfChanged(const sp<AMessage> &format) {
     // hardware has YUV12 and RGBA8888 support, so convert known formats
     if (!runningInEmulator()) {
         switch (mColorFormat) {
-#if 0
             case OMX_COLOR_FormatYUV420Planar:
             case OMX_COLOR_FormatYUV420SemiPlanar:
             case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
             {
+                if (!yuvRenderingEnabled()) {
+                    break;
+                }
                 halFormat = HAL_PIXEL_FORMAT_YV12;
                 bufWidth = (mCropWidth + 1) & ~1;
                 bufHeight = (mCropHeight + 1) & ~1;
+                mYUVMode = mColorFormat == OMX_COLOR_FormatYUV420Planar
+                        ? YV12FromPlanar : YV12FromSemiPlanar;
                 break;
             }
-#endif
             case OMX_COLOR_Format24bitRGB888:
             {
                 halFormat = HAL_PIXEL_FORMAT_RGB_888;
@@ -252,7 +267,7 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
                 dst,
                 buf->stride, buf->height,
                 0, 0, mCropWidth - 1, mCropHeight - 1);
-    } else if (mColorFormat == OMX_COLOR_FormatYUV420Planar) {
+    } else if (mYUVMode == YV12FromPlanar) {
         if ((size_t)mWidth * mHeight * 3 / 2 > size) {
             goto skip_copying;
         }
@@ -274,24 +289,34 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
         uint8_t *dst_v = dst_y + dst_y_size;
         uint8_t *dst_u = dst_v + dst_c_size;
 
-        for (int y = 0; y < mCropHeight; ++y) {
-            memcpy(dst_y, src_y, mCropWidth);
+        // A whole plane is copied at once when the strides match, as they
+        // usually do for software decoders.
+        if (mCropWidth == mWidth && buf->stride == mWidth) {
+            memcpy(dst_y, src_y, (size_t)mWidth * mCropHeight);
+        } else {
+            for (int y = 0; y < mCropHeight; ++y) {
+                memcpy(dst_y, src_y, mCropWidth);
 
-            src_y += mWidth;
-            dst_y += buf->stride;
+                src_y += mWidth;
+                dst_y += buf->stride;
+            }
         }
 
-        for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
-            memcpy(dst_u, src_u, (mCropWidth + 1) / 2);
-            memcpy(dst_v, src_v, (mCropWidth + 1) / 2);
-
-            src_u += mWidth / 2;
-            src_v += mWidth / 2;
-            dst_u += dst_c_stride;
-            dst_v += dst_c_stride;
+        if (mCropWidth == mWidth && dst_c_stride == (size_t)mWidth / 2) {
+            memcpy(dst_u, src_u, dst_c_stride * ((mCropHeight + 1) / 2));
+            memcpy(dst_v, src_v, dst_c_stride * ((mCropHeight + 1) / 2));
+        } else {
+            for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
+                memcpy(dst_u, src_u, (mCropWidth + 1) / 2);
+                memcpy(dst_v, src_v, (mCropWidth + 1) / 2);
+
+                src_u += mWidth / 2;
+                src_v += mWidth / 2;
+                dst_u += dst_c_stride;
+                dst_v += dst_c_stride;
+            }
         }
-    } else if (mColorFormat == OMX_TI_COLOR_FormatYUV420PackedSemiPlanar
-            || mColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
+    } else if (mYUVMode == YV12FromSemiPlanar) {
         if ((size_t)mWidth * mHeight * 3 / 2 > size) {
             goto skip_copying;
         }
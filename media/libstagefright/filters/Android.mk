@@ -6,6 +6,7 @@ LOCAL_SRC_FILES := \
         GraphicBufferListener.cpp \
         IntrinsicBlurFilter.cpp   \
         MediaFilter.cpp           \
+        RSAllocationCache.cpp     \
         RSFilter.cpp              \
         SaturationFilter.cpp      \
         saturationARGB.rs         \
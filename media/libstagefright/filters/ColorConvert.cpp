@@ -16,6 +16,8 @@
 
 #include "ColorConvert.h"
 
+#include <string.h>
+
 #ifndef max
 #define max(a,b) ((a) > (b) ? (a) : (b))
 #endif
@@ -45,64 +47,66 @@ void YUVToRGB(
     *b >>= 10;
 }
 
+// Converts one row, computing the chroma terms once for the two pixels that
+// share them. Matches YUVToRGB() exactly.
+template<bool kAlpha>
+static inline void convertYUV420spRow(
+        const uint8_t *pY, const uint8_t *pUV, int32_t width, uint8_t *dest) {
+    for (int32_t j = 0; j < width; j += 2) {
+        int32_t u = pUV[j] - 128;
+        int32_t v = pUV[j + 1] - 128;
+
+        int32_t bTerm = 2066 * u;
+        int32_t gTerm = -833 * v - 400 * u;
+        int32_t rTerm = 1634 * v;
+
+        int32_t count = min(2, width - j);
+        for (int32_t k = 0; k < count; ++k) {
+            int32_t y = 1192 * (pY[j + k] - 16);
+
+            if (kAlpha) {
+                *dest++ = 0xFF;
+            }
+            *dest++ = min(262143, max(0, y + rTerm)) >> 10;
+            *dest++ = min(262143, max(0, y + gTerm)) >> 10;
+            *dest++ = min(262143, max(0, y + bTerm)) >> 10;
+        }
+    }
+}
+
 void convertYUV420spToARGB(
         uint8_t *pY, uint8_t *pUV, int32_t width, int32_t height,
         uint8_t *dest) {
-    const int32_t bytes_per_pixel = 2;
-
     for (int32_t i = 0; i < height; i++) {
-        for (int32_t j = 0; j < width; j++) {
-            int32_t y = *(pY + i * width + j);
-            int32_t u = *(pUV + (i/2) * width + bytes_per_pixel * (j/2));
-            int32_t v = *(pUV + (i/2) * width + bytes_per_pixel * (j/2) + 1);
-
-            int32_t r, g, b;
-            YUVToRGB(y, u, v, &r, &g, &b);
-
-            *dest++ = 0xFF;
-            *dest++ = r;
-            *dest++ = g;
-            *dest++ = b;
-        }
+        convertYUV420spRow<true>(
+                pY + i * width, pUV + (i / 2) * width, width, dest);
+        dest += width * 4;
     }
 }
 
 void convertYUV420spToRGB888(
         uint8_t *pY, uint8_t *pUV, int32_t width, int32_t height,
         uint8_t *dest) {
-    const int32_t bytes_per_pixel = 2;
-
     for (int32_t i = 0; i < height; i++) {
-        for (int32_t j = 0; j < width; j++) {
-            int32_t y = *(pY + i * width + j);
-            int32_t u = *(pUV + (i/2) * width + bytes_per_pixel * (j/2));
-            int32_t v = *(pUV + (i/2) * width + bytes_per_pixel * (j/2) + 1);
-
-            int32_t r, g, b;
-            YUVToRGB(y, u, v, &r, &g, &b);
-
-            *dest++ = r;
-            *dest++ = g;
-            *dest++ = b;
-        }
+        convertYUV420spRow<false>(
+                pY + i * width, pUV + (i / 2) * width, width, dest);
+        dest += width * 3;
     }
 }
 
-// HACK - not even slightly optimized
 // TODO: remove when RGBA support is added to SoftwareRenderer
 void convertRGBAToARGB(
         uint8_t *src, int32_t width, int32_t height, uint32_t stride,
         uint8_t *dest) {
     for (int32_t i = 0; i < height; ++i) {
         for (int32_t j = 0; j < width; ++j) {
-            uint8_t r = *src++;
-            uint8_t g = *src++;
-            uint8_t b = *src++;
-            uint8_t a = *src++;
-            *dest++ = a;
-            *dest++ = r;
-            *dest++ = g;
-            *dest++ = b;
+            // as a little endian word, RGBA to ARGB is a rotation by a byte
+            uint32_t pixel;
+            memcpy(&pixel, src, 4);
+            pixel = (pixel << 8) | (pixel >> 24);
+            memcpy(dest, &pixel, 4);
+            src += 4;
+            dest += 4;
         }
         src += (stride - width) * 4;
     }
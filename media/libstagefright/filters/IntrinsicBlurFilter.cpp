@@ -58,20 +58,18 @@ status_t IntrinsicBlurFilter::start() {
     tb.setY(mHeight);
     RSC::sp<const RSC::Type> t = tb.create();
 
-    mAllocIn = RSC::Allocation::createTyped(mRS, t);
-    mAllocOut = RSC::Allocation::createTyped(mRS, t);
+    mAllocations.init(mRS, t);
 
     mBlur = RSC::ScriptIntrinsicBlur::create(mRS, e);
     mBlur->setRadius(mBlurRadius);
-    mBlur->setInput(mAllocIn);
 
     return OK;
 }
 
 void IntrinsicBlurFilter::reset() {
     mBlur.clear();
-    mAllocOut.clear();
-    mAllocIn.clear();
+    mAllocations.clear();
+    mBlurInput.clear();
     mRS.clear();
 }
 
@@ -89,9 +87,14 @@ status_t IntrinsicBlurFilter::setParameters(const sp<AMessage> &msg) {
 
 status_t IntrinsicBlurFilter::processBuffers(
         const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer) {
-    mAllocIn->copy1DRangeFrom(0, mWidth * mHeight, srcBuffer->data());
-    mBlur->forEach(mAllocOut);
-    mAllocOut->copy1DRangeTo(0, mWidth * mHeight, outBuffer->data());
+    RSC::sp<RSC::Allocation> in = mAllocations.getInput(srcBuffer);
+    if (in != mBlurInput) {
+        mBlur->setInput(in);
+        mBlurInput = in;
+    }
+    RSC::sp<RSC::Allocation> out = mAllocations.getOutput(outBuffer);
+    mBlur->forEach(out);
+    mAllocations.finishOutput(out, outBuffer);
 
     return OK;
 }
@@ -18,6 +18,7 @@
 #define INTRINSIC_BLUR_FILTER_H_
 
 #include "RenderScript.h"
+#include "RSAllocationCache.h"
 #include "SimpleFilter.h"
 
 namespace android {
@@ -39,8 +40,8 @@ protected:
 private:
     AString mCacheDir;
     RSC::sp<RSC::RS> mRS;
-    RSC::sp<RSC::Allocation> mAllocIn;
-    RSC::sp<RSC::Allocation> mAllocOut;
+    RSAllocationCache mAllocations;
+    RSC::sp<RSC::Allocation> mBlurInput;
     RSC::sp<RSC::ScriptIntrinsicBlur> mBlur;
     float mBlurRadius;
 };
@@ -25,6 +25,7 @@
 #include <media/stagefright/BufferProducerWrapper.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 
 #include <media/stagefright/MediaDefs.h>
@@ -48,7 +49,10 @@ static const size_t kBufferCountActual = 4;
 MediaFilter::MediaFilter()
     : mState(UNINITIALIZED),
       mGeneration(0),
-      mGraphicBufferListener(NULL) {
+      mGraphicBufferListener(NULL),
+      mNumFramesProcessed(0),
+      mTotalProcessTimeUs(0),
+      mMaxProcessTimeUs(0) {
 }
 
 MediaFilter::~MediaFilter() {
@@ -406,8 +410,17 @@ void MediaFilter::processBuffers() {
     BufferInfo *outputInfo = mAvailableOutputBuffers[0];
     mAvailableOutputBuffers.removeAt(0);
 
+    int64_t startUs = ALooper::GetNowUs();
     status_t err;
     err = mFilter->processBuffers(inputInfo->mData, outputInfo->mData);
+    int64_t processTimeUs = ALooper::GetNowUs() - startUs;
+
+    ++mNumFramesProcessed;
+    mTotalProcessTimeUs += processTimeUs;
+    if (processTimeUs > mMaxProcessTimeUs) {
+        mMaxProcessTimeUs = processTimeUs;
+    }
+
     if (err != (status_t)OK) {
         outputInfo->mData->meta()->setInt32("err", err);
     }
@@ -430,6 +443,7 @@ void MediaFilter::processBuffers() {
                 outputInfo->mBufferID, outputInfo->mData->size());
 
     if (mGraphicBufferListener != NULL) {
+        releaseSurfaceFrame(inputInfo->mData);
         delete inputInfo;
     } else {
         postFillThisBuffer(inputInfo);
@@ -673,12 +687,28 @@ void MediaFilter::onOutputBufferDrained(const sp<AMessage> &msg) {
             bufferID);
 }
 
+void MediaFilter::logStats() {
+    if (mNumFramesProcessed > 0) {
+        ALOGI("%s processed %" PRId64 " frames, %.2f ms average, %.2f ms max",
+                mComponentName.c_str(), mNumFramesProcessed,
+                mTotalProcessTimeUs / 1E3 / mNumFramesProcessed,
+                mMaxProcessTimeUs / 1E3);
+    }
+
+    mNumFramesProcessed = 0;
+    mTotalProcessTimeUs = 0;
+    mMaxProcessTimeUs = 0;
+}
+
 void MediaFilter::onShutdown(const sp<AMessage> &msg) {
     mGeneration++;
 
+    logStats();
+
     if (mState != UNINITIALIZED) {
         mFilter->reset();
     }
+    mFreeSurfaceFrames.clear();
 
     int32_t keepComponentAllocated;
     CHECK(msg->findInt32("keepComponentAllocated", &keepComponentAllocated));
@@ -768,7 +798,7 @@ void MediaFilter::onInputFrameAvailable() {
     // TODO: check input format and convert only if necessary
     // copy RGBA graphic buffer into temporary ARGB input buffer
     BufferInfo *inputInfo = new BufferInfo;
-    inputInfo->mData = new ABuffer(buf->getWidth() * buf->getHeight() * 4);
+    inputInfo->mData = acquireSurfaceFrame(buf->getWidth() * buf->getHeight() * 4);
     ALOGV("Copying surface data into temp buffer.");
     convertRGBAToARGB(
             (uint8_t*)bufPtr, buf->getWidth(), buf->getHeight(),
@@ -786,6 +816,28 @@ void MediaFilter::onInputFrameAvailable() {
     signalProcessBuffers();
 }
 
+sp<ABuffer> MediaFilter::acquireSurfaceFrame(size_t size) {
+    while (!mFreeSurfaceFrames.empty()) {
+        sp<ABuffer> frame = mFreeSurfaceFrames.top();
+        mFreeSurfaceFrames.pop();
+        if (frame->capacity() == size) {
+            frame->setRange(0, size);
+            frame->meta()->clear();
+            return frame;
+        }
+    }
+
+    return new ABuffer(size);
+}
+
+void MediaFilter::releaseSurfaceFrame(const sp<ABuffer> &frame) {
+    // keeping the frame also keeps its address, which lets the filter
+    // reuse what it set up for it
+    if (mFreeSurfaceFrames.size() < kBufferCountActual) {
+        mFreeSurfaceFrames.push(frame);
+    }
+}
+
 void MediaFilter::onSignalEndOfInputStream() {
     // if using input surface, need to send an EOS output buffer
     if (mGraphicBufferListener != NULL) {
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "RSAllocationCache"
+
+#include <utils/Log.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+#include "RSAllocationCache.h"
+
+namespace android {
+
+// Shared allocations must be aligned like the driver's own.
+static const uintptr_t kSharedAlignment = 16;
+
+RSAllocationCache::RSAllocationCache()
+    : mNumElements(0),
+      mFrameSize(0),
+      mSharingFailed(false) {
+}
+
+void RSAllocationCache::init(
+        const RSC::sp<RSC::RS> &rs, const RSC::sp<const RSC::Type> &type) {
+    clear();
+
+    mRS = rs;
+    mType = type;
+    mNumElements = type->getCount();
+    mFrameSize = mNumElements * type->getElement()->getSizeBytes();
+    mSharingFailed = false;
+}
+
+void RSAllocationCache::clear() {
+    mShared.clear();
+    mCopyIn.clear();
+    mCopyOut.clear();
+    mType.clear();
+    mRS.clear();
+}
+
+RSC::sp<RSC::Allocation> RSAllocationCache::getShared(const sp<ABuffer> &buffer) {
+    if (buffer->capacity() - buffer->offset() < mFrameSize) {
+        return NULL;
+    }
+
+    ssize_t index = mShared.indexOfKey(buffer->data());
+    if (index >= 0) {
+        return mShared.valueAt(index);
+    }
+
+    if (mSharingFailed
+            || mShared.size() >= kMaxSharedAllocations
+            || ((uintptr_t)buffer->data() & (kSharedAlignment - 1))) {
+        return NULL;
+    }
+
+    RSC::sp<RSC::Allocation> alloc = RSC::Allocation::createTyped(
+            mRS, mType, RS_ALLOCATION_MIPMAP_NONE,
+            RS_ALLOCATION_USAGE_SCRIPT | RS_ALLOCATION_USAGE_SHARED,
+            buffer->data());
+    if (alloc == NULL) {
+        ALOGI("RenderScript cannot share codec buffers, copying frames.");
+        mSharingFailed = true;
+        return NULL;
+    }
+
+    ALOGV("sharing buffer %p", buffer->data());
+    mShared.add(buffer->data(), alloc);
+    return alloc;
+}
+
+RSC::sp<RSC::Allocation> RSAllocationCache::getInput(const sp<ABuffer> &buffer) {
+    RSC::sp<RSC::Allocation> alloc = getShared(buffer);
+    if (alloc != NULL) {
+        // the codec wrote the pixels behind the driver's back
+        alloc->syncAll(RS_ALLOCATION_USAGE_SHARED);
+        return alloc;
+    }
+
+    if (mCopyIn == NULL) {
+        mCopyIn = RSC::Allocation::createTyped(mRS, mType);
+    }
+    mCopyIn->copy1DRangeFrom(0, mNumElements, buffer->data());
+    return mCopyIn;
+}
+
+RSC::sp<RSC::Allocation> RSAllocationCache::getOutput(const sp<ABuffer> &buffer) {
+    RSC::sp<RSC::Allocation> alloc = getShared(buffer);
+    if (alloc != NULL) {
+        return alloc;
+    }
+
+    if (mCopyOut == NULL) {
+        mCopyOut = RSC::Allocation::createTyped(mRS, mType);
+    }
+    return mCopyOut;
+}
+
+void RSAllocationCache::finishOutput(
+        const RSC::sp<RSC::Allocation> &alloc, const sp<ABuffer> &buffer) {
+    if (alloc == mCopyOut) {
+        // copying out waits for the script
+        alloc->copy1DRangeTo(0, mNumElements, buffer->data());
+    } else {
+        mRS->finish();
+    }
+}
+
+}   // namespace android
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RS_ALLOCATION_CACHE_H_
+#define RS_ALLOCATION_CACHE_H_
+
+#include <RenderScript.h>
+
+#include <utils/KeyedVector.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+struct ABuffer;
+
+// Hands out RenderScript allocations for the frames of a filter. Where the
+// RenderScript driver supports it, an allocation is backed by the memory of
+// the codec buffer itself, and kept for as long as the buffer is reused, so
+// that frames are not copied in and out of the script. Otherwise frames are
+// copied through a pair of private allocations.
+struct RSAllocationCache {
+    RSAllocationCache();
+
+    void init(const RSC::sp<RSC::RS> &rs, const RSC::sp<const RSC::Type> &type);
+    void clear();
+
+    // Returns the allocation holding the pixels of |buffer|, which has been
+    // filled from the buffer if they are not shared.
+    RSC::sp<RSC::Allocation> getInput(const sp<ABuffer> &buffer);
+
+    // Returns the allocation a script writes the pixels of |buffer| to, to
+    // be passed to finishOutput() once the script has been launched.
+    RSC::sp<RSC::Allocation> getOutput(const sp<ABuffer> &buffer);
+
+    // Waits for the script and copies the pixels to |buffer| if they are
+    // not shared.
+    void finishOutput(const RSC::sp<RSC::Allocation> &alloc, const sp<ABuffer> &buffer);
+
+    size_t numShared() const { return mShared.size(); }
+
+private:
+    enum {
+        // Codec filters cycle through a handful of buffers.
+        kMaxSharedAllocations = 16,
+    };
+
+    RSC::sp<RSC::RS> mRS;
+    RSC::sp<const RSC::Type> mType;
+    size_t mNumElements;
+    size_t mFrameSize;
+    bool mSharingFailed;
+
+    KeyedVector<const void *, RSC::sp<RSC::Allocation> > mShared;
+    RSC::sp<RSC::Allocation> mCopyIn;
+    RSC::sp<RSC::Allocation> mCopyOut;
+
+    RSC::sp<RSC::Allocation> getShared(const sp<ABuffer> &buffer);
+
+    RSAllocationCache(const RSAllocationCache &);
+    RSAllocationCache &operator=(const RSAllocationCache &);
+};
+
+}   // namespace android
+
+#endif  // RS_ALLOCATION_CACHE_H_
@@ -67,16 +67,14 @@ status_t RSFilter::start() {
     tb.setY(mHeight);
     RSC::sp<const RSC::Type> t = tb.create();
 
-    mAllocIn = RSC::Allocation::createTyped(mRS, t);
-    mAllocOut = RSC::Allocation::createTyped(mRS, t);
+    mAllocations.init(mRS, t);
 
     return OK;
 }
 
 void RSFilter::reset() {
     mCallback.clear();
-    mAllocOut.clear();
-    mAllocIn.clear();
+    mAllocations.clear();
     mRS.clear();
 }
 
@@ -86,9 +84,10 @@ status_t RSFilter::setParameters(const sp<AMessage> &msg) {
 
 status_t RSFilter::processBuffers(
         const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer) {
-    mAllocIn->copy1DRangeFrom(0, mWidth * mHeight, srcBuffer->data());
-    mCallback->processBuffers(mAllocIn.get(), mAllocOut.get());
-    mAllocOut->copy1DRangeTo(0, mWidth * mHeight, outBuffer->data());
+    RSC::sp<RSC::Allocation> in = mAllocations.getInput(srcBuffer);
+    RSC::sp<RSC::Allocation> out = mAllocations.getOutput(outBuffer);
+    mCallback->processBuffers(in.get(), out.get());
+    mAllocations.finishOutput(out, outBuffer);
 
     return OK;
 }
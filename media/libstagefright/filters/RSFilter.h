@@ -20,6 +20,7 @@
 #include <media/stagefright/RenderScriptWrapper.h>
 #include <RenderScript.h>
 
+#include "RSAllocationCache.h"
 #include "SimpleFilter.h"
 
 namespace android {
@@ -44,8 +45,7 @@ private:
     AString mCacheDir;
     sp<RenderScriptWrapper::RSFilterCallback> mCallback;
     RSC::sp<RSC::RS> mRS;
-    RSC::sp<RSC::Allocation> mAllocIn;
-    RSC::sp<RSC::Allocation> mAllocOut;
+    RSAllocationCache mAllocations;
 };
 
 }   // namespace android
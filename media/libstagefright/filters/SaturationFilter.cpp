@@ -58,8 +58,7 @@ status_t SaturationFilter::start() {
     tb.setY(mHeight);
     RSC::sp<const RSC::Type> t = tb.create();
 
-    mAllocIn = RSC::Allocation::createTyped(mRS, t);
-    mAllocOut = RSC::Allocation::createTyped(mRS, t);
+    mAllocations.init(mRS, t);
 
     mScript = new ScriptC_saturationARGB(mRS);
 
@@ -70,8 +69,7 @@ status_t SaturationFilter::start() {
 
 void SaturationFilter::reset() {
     mScript.clear();
-    mAllocOut.clear();
-    mAllocIn.clear();
+    mAllocations.clear();
     mRS.clear();
 }
 
@@ -89,9 +87,10 @@ status_t SaturationFilter::setParameters(const sp<AMessage> &msg) {
 
 status_t SaturationFilter::processBuffers(
         const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer) {
-    mAllocIn->copy1DRangeFrom(0, mWidth * mHeight, srcBuffer->data());
-    mScript->forEach_root(mAllocIn, mAllocOut);
-    mAllocOut->copy1DRangeTo(0, mWidth * mHeight, outBuffer->data());
+    RSC::sp<RSC::Allocation> in = mAllocations.getInput(srcBuffer);
+    RSC::sp<RSC::Allocation> out = mAllocations.getOutput(outBuffer);
+    mScript->forEach_root(in, out);
+    mAllocations.finishOutput(out, outBuffer);
 
     return OK;
 }
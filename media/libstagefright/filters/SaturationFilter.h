@@ -19,6 +19,7 @@
 
 #include <RenderScript.h>
 
+#include "RSAllocationCache.h"
 #include "ScriptC_saturationARGB.h"
 #include "SimpleFilter.h"
 
@@ -41,8 +42,7 @@ protected:
 private:
     AString mCacheDir;
     RSC::sp<RSC::RS> mRS;
-    RSC::sp<RSC::Allocation> mAllocIn;
-    RSC::sp<RSC::Allocation> mAllocOut;
+    RSAllocationCache mAllocations;
     RSC::sp<ScriptC_saturationARGB> mScript;
     float mSaturation;
 };
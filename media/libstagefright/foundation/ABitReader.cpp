@@ -18,8 +18,20 @@
 
 #include <media/stagefright/foundation/ADebug.h>
 
+#include <endian.h>
+#include <string.h>
+
 namespace android {
 
+static inline uint64_t loadBigEndian64(const uint8_t *data) {
+    uint64_t x;
+    memcpy(&x, data, sizeof(x));
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    x = __builtin_bswap64(x);
+#endif
+    return x;
+}
+
 ABitReader::ABitReader(const uint8_t *data, size_t size)
     : mData(data),
       mSize(size),
@@ -33,9 +45,17 @@ ABitReader::~ABitReader() {
 void ABitReader::fillReservoir() {
     CHECK_GT(mSize, 0u);
 
+    if (mSize >= sizeof(mReservoir)) {
+        mReservoir = loadBigEndian64(mData);
+        mData += sizeof(mReservoir);
+        mSize -= sizeof(mReservoir);
+        mNumBitsLeft = 64;
+        return;
+    }
+
     mReservoir = 0;
     size_t i;
-    for (i = 0; mSize > 0 && i < 4; ++i) {
+    for (i = 0; mSize > 0 && i < 8; ++i) {
         mReservoir = (mReservoir << 8) | *mData;
 
         ++mData;
@@ -43,12 +63,23 @@ void ABitReader::fillReservoir() {
     }
 
     mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
+    mReservoir <<= 64 - mNumBitsLeft;
 }
 
 uint32_t ABitReader::getBits(size_t n) {
     CHECK_LE(n, 32u);
 
+    if (n == 0) {
+        return 0;
+    }
+
+    if (n <= mNumBitsLeft) {
+        uint32_t result = mReservoir >> (64 - n);
+        mReservoir <<= n;
+        mNumBitsLeft -= n;
+        return result;
+    }
+
     uint32_t result = 0;
     while (n > 0) {
         if (mNumBitsLeft == 0) {
@@ -60,7 +91,7 @@ uint32_t ABitReader::getBits(size_t n) {
             m = mNumBitsLeft;
         }
 
-        result = (result << m) | (mReservoir >> (32 - m));
+        result = (result << m) | (uint32_t)(mReservoir >> (64 - m));
         mReservoir <<= m;
         mNumBitsLeft -= m;
 
@@ -71,26 +102,70 @@ uint32_t ABitReader::getBits(size_t n) {
 }
 
 void ABitReader::skipBits(size_t n) {
-    while (n > 32) {
-        getBits(32);
-        n -= 32;
+    if (n <= mNumBitsLeft) {
+        mReservoir = n < 64 ? mReservoir << n : 0;
+        mNumBitsLeft -= n;
+        return;
+    }
+
+    n -= mNumBitsLeft;
+    mReservoir = 0;
+    mNumBitsLeft = 0;
+
+    skipBytes(n / 8);
+
+    if (n % 8 > 0) {
+        getBits(n % 8);
+    }
+}
+
+void ABitReader::skipBytes(size_t n) {
+    CHECK_LE(n, mSize);
+
+    mData += n;
+    mSize -= n;
+}
+
+uint32_t ABitReader::getUE() {
+    // the whole code is usually in the reservoir: count the leading zeros
+    // and take 2 * zeros + 1 bits at once
+    if (mReservoir != 0) {
+        size_t numZeros = __builtin_clzll(mReservoir);
+        size_t numBits = 2 * numZeros + 1;
+        if (numZeros < 32 && numBits <= mNumBitsLeft) {
+            uint64_t code = mReservoir >> (64 - numBits);
+            mReservoir = numBits < 64 ? mReservoir << numBits : 0;
+            mNumBitsLeft -= numBits;
+            return (uint32_t)(code - 1);
+        }
     }
 
-    if (n > 0) {
-        getBits(n);
+    unsigned numZeroes = 0;
+    while (getBits(1) == 0) {
+        ++numZeroes;
     }
+
+    uint32_t x = getBits(numZeroes);
+
+    return x + (1u << numZeroes) - 1;
+}
+
+int32_t ABitReader::getSE() {
+    uint32_t codeNum = getUE();
+
+    return (codeNum & 1) ? (codeNum + 1) / 2 : -(codeNum / 2);
 }
 
 void ABitReader::putBits(uint32_t x, size_t n) {
     CHECK_LE(n, 32u);
 
-    while (mNumBitsLeft + n > 32) {
+    while (mNumBitsLeft + n > 64) {
         mNumBitsLeft -= 8;
         --mData;
         ++mSize;
     }
 
-    mReservoir = (mReservoir >> n) | (x << (32 - n));
+    mReservoir = (mReservoir >> n) | ((uint64_t)x << (64 - n));
     mNumBitsLeft += n;
 }
 
@@ -142,9 +217,24 @@ bool NALBitReader::atLeastNumBitsLeft(size_t n) const {
 void NALBitReader::fillReservoir() {
     CHECK_GT(mSize, 0u);
 
+    // Without a zero byte among the next 8 there can't be an emulation prevention
+    // byte among them either, except right after zeros from the previous fill.
+    if (mSize >= sizeof(mReservoir) && !(mNumZeros >= 2 && *mData == 3)) {
+        const uint64_t word = loadBigEndian64(mData);
+        const uint64_t kOnes = 0x0101010101010101ULL;
+        if (((word - kOnes) & ~word & (kOnes << 7)) == 0) {
+            mReservoir = word;
+            mData += sizeof(mReservoir);
+            mSize -= sizeof(mReservoir);
+            mNumBitsLeft = 64;
+            mNumZeros = 0;
+            return;
+        }
+    }
+
     mReservoir = 0;
     size_t i = 0;
-    while (mSize > 0 && i < 4) {
+    while (mSize > 0 && i < 8) {
         bool isEmulationPreventionByte = (mNumZeros >= 2 && *mData == 3);
 
         if (*mData == 0) {
@@ -164,7 +254,29 @@ void NALBitReader::fillReservoir() {
     }
 
     mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
+    mReservoir = mNumBitsLeft > 0 ? mReservoir << (64 - mNumBitsLeft) : 0;
+}
+
+void NALBitReader::skipBytes(size_t n) {
+    // emulation prevention bytes don't count
+    while (n > 0) {
+        CHECK_GT(mSize, 0u);
+
+        bool isEmulationPreventionByte = (mNumZeros >= 2 && *mData == 3);
+
+        if (*mData == 0) {
+            ++mNumZeros;
+        } else {
+            mNumZeros = 0;
+        }
+
+        if (!isEmulationPreventionByte) {
+            --n;
+        }
+
+        ++mData;
+        --mSize;
+    }
 }
 
 }  // namespace android
@@ -21,14 +21,80 @@
 #include "AMessage.h"
 #include "MediaBufferBase.h"
 
+#include <utils/Mutex.h>
+
 namespace android {
 
+namespace {
+
+// Small and medium buffers are carved from power of 2 size classes, and freed blocks are
+// kept on a per class free list up to a total of kMaxPooledBytes. Parsers allocate and
+// free these at packet rate; reusing the blocks keeps them from fragmenting the heap.
+const size_t kMinPoolClassSize = 256;
+const int32_t kNumPoolClasses = 9;      // 256 bytes to 64 KB
+const size_t kMaxPooledBytes = 1024 * 1024;
+
+struct PooledBlock {
+    PooledBlock *mNext;
+};
+
+Mutex gPoolLock;
+PooledBlock *gPool[kNumPoolClasses];
+size_t gPooledBytes = 0;
+
+inline size_t poolClassSize(int32_t index) {
+    return kMinPoolClassSize << index;
+}
+
+// returns the smallest size class holding capacity bytes, or -1 if it is too large
+int32_t poolIndexFor(size_t capacity) {
+    for (int32_t index = 0; index < kNumPoolClasses; ++index) {
+        if (capacity <= poolClassSize(index)) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+void *allocateData(size_t capacity, int32_t *poolIndex) {
+    *poolIndex = poolIndexFor(capacity);
+    if (*poolIndex < 0) {
+        return malloc(capacity);
+    }
+    {
+        Mutex::Autolock autoLock(gPoolLock);
+        PooledBlock *block = gPool[*poolIndex];
+        if (block != NULL) {
+            gPool[*poolIndex] = block->mNext;
+            gPooledBytes -= poolClassSize(*poolIndex);
+            return block;
+        }
+    }
+    return malloc(poolClassSize(*poolIndex));
+}
+
+void freeData(void *data, int32_t poolIndex) {
+    if (poolIndex >= 0) {
+        Mutex::Autolock autoLock(gPoolLock);
+        if (gPooledBytes + poolClassSize(poolIndex) <= kMaxPooledBytes) {
+            PooledBlock *block = static_cast<PooledBlock *>(data);
+            block->mNext = gPool[poolIndex];
+            gPool[poolIndex] = block;
+            gPooledBytes += poolClassSize(poolIndex);
+            return;
+        }
+    }
+    free(data);
+}
+
+}  // namespace
+
 ABuffer::ABuffer(size_t capacity)
     : mMediaBufferBase(NULL),
       mRangeOffset(0),
       mInt32Data(0),
       mOwnsData(true) {
-    mData = malloc(capacity);
+    mData = allocateData(capacity, &mPoolIndex);
     CHECK(mData != NULL);
     mCapacity = capacity;
     mRangeLength = capacity;
@@ -41,7 +107,8 @@ ABuffer::ABuffer(void *data, size_t capacity)
       mRangeOffset(0),
       mRangeLength(capacity),
       mInt32Data(0),
-      mOwnsData(false) {
+      mOwnsData(false),
+      mPoolIndex(-1) {
 }
 
 // static
@@ -55,10 +122,22 @@ sp<ABuffer> ABuffer::CreateAsCopy(const void *data, size_t capacity)
     return res;
 }
 
+// static
+sp<ABuffer> ABuffer::CreateSlice(
+        const sp<ABuffer> &parent, size_t offset, size_t size) {
+    CHECK_LE(offset, parent->size());
+    CHECK_LE(size, parent->size() - offset);
+
+    sp<ABuffer> slice = new ABuffer(parent->data() + offset, size);
+    // slices of slices reference the buffer that owns the memory
+    slice->mParent = parent->mParent != NULL ? parent->mParent : parent;
+    return slice;
+}
+
 ABuffer::~ABuffer() {
     if (mOwnsData) {
         if (mData != NULL) {
-            free(mData);
+            freeData(mData, mPoolIndex);
             mData = NULL;
         }
     }
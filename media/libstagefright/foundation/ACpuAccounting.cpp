@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ACpuAccounting"
+#include <utils/Log.h>
+
+#include "ACpuAccounting.h"
+
+#include <new>
+
+#include <binder/MemoryBase.h>
+#include <binder/MemoryHeapBase.h>
+#include <cpustats/CpuAccountingTable.h>
+#include <utils/AndroidThreads.h>
+#include <utils/Mutex.h>
+
+namespace android {
+
+// serializes the writers of sTable, which is never freed once allocated
+static Mutex sLock;
+static sp<IMemory> sMemory;
+static CpuAccountingTable *sTable = NULL;
+
+// static
+sp<IMemory> ACpuAccounting::enable() {
+    Mutex::Autolock autoLock(sLock);
+    if (sMemory == NULL) {
+        sp<MemoryHeapBase> heap =
+                new MemoryHeapBase(sizeof(CpuAccountingTable), 0, "ACpuAccounting");
+        if (heap->getHeapID() < 0) {
+            ALOGE("could not allocate the CPU accounting table");
+            return NULL;
+        }
+        sp<IMemory> memory = new MemoryBase(heap, 0, sizeof(CpuAccountingTable));
+        CpuAccountingTable *table = new (memory->pointer()) CpuAccountingTable;
+        table->init();
+        sMemory = memory;
+        sTable = table;
+    }
+    return sMemory;
+}
+
+// static
+bool ACpuAccounting::isEnabled() {
+    Mutex::Autolock autoLock(sLock);
+    return sTable != NULL;
+}
+
+ACpuAccounting::ACpuAccounting(const char *component)
+    : mSlot(-1),
+      mTid(androidGetTid()),
+      mLastNs(0) {
+    Mutex::Autolock autoLock(sLock);
+    if (sTable == NULL) {
+        return;
+    }
+    mSlot = sTable->getSlot(component);
+    if (mSlot < 0) {
+        return;
+    }
+    CpuAccountingSlot &slot = sTable->mSlots[mSlot];
+    CpuAccountingData *data = slot.beginWrite();
+    ++data->mThreads;
+    ++data->mThreadsTotal;
+    slot.endWrite();
+
+    // the first sample only starts tracking
+    double cpuNs;
+    mCpuUsage.sampleAndEnable(cpuNs);
+    mLastNs = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+ACpuAccounting::~ACpuAccounting() {
+    if (mSlot >= 0) {
+        publish(true /* exiting */);
+    }
+}
+
+void ACpuAccounting::publish(bool exiting) {
+    double cpuNs = 0.;
+    if (mTid == androidGetTid()) {
+        if (!mCpuUsage.sampleAndEnable(cpuNs)) {
+            cpuNs = 0.;
+        }
+    } else {
+        // the CPU time of another thread cannot be read here, so its last period is lost
+        ALOGV("accounting of thread %d ended on another thread", mTid);
+    }
+    const nsecs_t nowNs = systemTime(SYSTEM_TIME_MONOTONIC);
+    const nsecs_t wallNs = nowNs - mLastNs;
+    mLastNs = nowNs;
+
+    Mutex::Autolock autoLock(sLock);
+    CpuAccountingSlot &slot = sTable->mSlots[mSlot];
+    CpuAccountingData *data = slot.beginWrite();
+    data->mCpuNs += (int64_t)cpuNs;
+    data->mWallNs += wallNs;
+    // a partial period at exit would only add noise to the load statistics
+    if (!exiting && wallNs > 0) {
+        data->mLoad.sample(cpuNs / wallNs);
+    }
+    if (exiting) {
+        --data->mThreads;
+    }
+    slot.endWrite();
+}
+
+}  // namespace android
@@ -25,6 +25,7 @@
 
 #include "ALooper.h"
 
+#include "ACpuAccounting.h"
 #include "AHandler.h"
 #include "ALooperRoster.h"
 #include "AMessage.h"
@@ -37,17 +38,33 @@ struct ALooper::LooperThread : public Thread {
     LooperThread(ALooper *looper, bool canCallJava)
         : Thread(canCallJava),
           mLooper(looper),
-          mThreadId(NULL) {
+          mThreadId(NULL),
+          mCpuAccounting(NULL) {
     }
 
     virtual status_t readyToRun() {
         mThreadId = androidGetThreadId();
 
+        if (ACpuAccounting::isEnabled()) {
+            const char *name = mLooper->getName();
+            mCpuAccounting = new ACpuAccounting(*name != '\0' ? name : "ALooper");
+        }
+
         return Thread::readyToRun();
     }
 
     virtual bool threadLoop() {
-        return mLooper->loop();
+        bool keepGoing = mLooper->loop();
+        if (mCpuAccounting != NULL) {
+            if (keepGoing && !exitPending()) {
+                mCpuAccounting->update();
+            } else {
+                // the thread exits next, and only it can account its last period
+                delete mCpuAccounting;
+                mCpuAccounting = NULL;
+            }
+        }
+        return keepGoing;
     }
 
     bool isCurrentThread() const {
@@ -55,11 +72,14 @@ struct ALooper::LooperThread : public Thread {
     }
 
 protected:
-    virtual ~LooperThread() {}
+    virtual ~LooperThread() {
+        delete mCpuAccounting;
+    }
 
 private:
     ALooper *mLooper;
     android_thread_id_t mThreadId;
+    ACpuAccounting *mCpuAccounting;
 
     DISALLOW_EVIL_CONSTRUCTORS(LooperThread);
 };
@@ -70,7 +90,8 @@ int64_t ALooper::GetNowUs() {
 }
 
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mEventSeq(0),
+      mRunningLocally(false) {
     // clean up stale AHandlers. Doing it here instead of in the destructor avoids
     // the side effect of objects being deleted from the unregister function recursively.
     gLooperRoster.unregisterStaleHandlers();
@@ -129,6 +150,11 @@ status_t ALooper::start(
     return err;
 }
 
+pid_t ALooper::getTid() {
+    Mutex::Autolock autoLock(mLock);
+    return mThread != NULL ? mThread->getTid() : -1;
+}
+
 status_t ALooper::stop() {
     sp<LooperThread> thread;
     bool runningLocally;
@@ -165,7 +191,7 @@ status_t ALooper::stop() {
     return OK;
 }
 
-void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
+void ALooper::post(const sp<AMessage> &msg, int64_t delayUs, PostMode mode) {
     Mutex::Autolock autoLock(mLock);
 
     int64_t whenUs;
@@ -175,20 +201,85 @@ void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
         whenUs = GetNowUs();
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
+    if (mode == POST_COALESCE) {
+        if (findPendingEvent_l(msg) >= 0) {
+            return;
+        }
+    } else if (mode == POST_REPLACE) {
+        ssize_t index;
+        while ((index = findPendingEvent_l(msg)) >= 0) {
+            removeEvent_l(index);
+        }
     }
 
     Event event;
     event.mWhenUs = whenUs;
+    event.mSeq = mEventSeq++;
     event.mMessage = msg;
 
-    if (it == mEventQueue.begin()) {
+    mEventQueue.push(event);
+    siftUp_l(mEventQueue.size() - 1);
+
+    if (mEventQueue[0].mSeq == event.mSeq) {
         mQueueChangedCondition.signal();
     }
+}
+
+void ALooper::siftUp_l(size_t index) {
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!mEventQueue[index].isBefore(mEventQueue[parent])) {
+            break;
+        }
+        Event tmp = mEventQueue[index];
+        mEventQueue.editItemAt(index) = mEventQueue[parent];
+        mEventQueue.editItemAt(parent) = tmp;
+        index = parent;
+    }
+}
+
+void ALooper::siftDown_l(size_t index) {
+    const size_t size = mEventQueue.size();
+    for (;;) {
+        size_t first = index;
+        size_t child = 2 * index + 1;
+        if (child < size && mEventQueue[child].isBefore(mEventQueue[first])) {
+            first = child;
+        }
+        ++child;
+        if (child < size && mEventQueue[child].isBefore(mEventQueue[first])) {
+            first = child;
+        }
+        if (first == index) {
+            break;
+        }
+        Event tmp = mEventQueue[index];
+        mEventQueue.editItemAt(index) = mEventQueue[first];
+        mEventQueue.editItemAt(first) = tmp;
+        index = first;
+    }
+}
 
-    mEventQueue.insert(it, event);
+void ALooper::removeEvent_l(size_t index) {
+    const size_t last = mEventQueue.size() - 1;
+    if (index != last) {
+        mEventQueue.editItemAt(index) = mEventQueue[last];
+    }
+    mEventQueue.removeAt(last);
+    if (index < mEventQueue.size()) {
+        siftUp_l(index);
+        siftDown_l(index);
+    }
+}
+
+ssize_t ALooper::findPendingEvent_l(const sp<AMessage> &msg) const {
+    for (size_t i = 0; i < mEventQueue.size(); ++i) {
+        const sp<AMessage> &pending = mEventQueue[i].mMessage;
+        if (pending->mWhat == msg->mWhat && pending->mTarget == msg->mTarget) {
+            return i;
+        }
+    }
+    return -1;
 }
 
 bool ALooper::loop() {
@@ -203,7 +294,7 @@ bool ALooper::loop() {
             mQueueChangedCondition.wait(mLock);
             return true;
         }
-        int64_t whenUs = (*mEventQueue.begin()).mWhenUs;
+        int64_t whenUs = mEventQueue[0].mWhenUs;
         int64_t nowUs = GetNowUs();
 
         if (whenUs > nowUs) {
@@ -213,8 +304,8 @@ bool ALooper::loop() {
             return true;
         }
 
-        event = *mEventQueue.begin();
-        mEventQueue.erase(mEventQueue.begin());
+        event = mEventQueue[0];
+        removeEvent_l(0);
     }
 
     event.mMessage->deliver();
@@ -32,11 +32,40 @@
 
 #include <binder/Parcel.h>
 #include <media/stagefright/foundation/hexdump.h>
+#include <utils/Mutex.h>
 
 namespace android {
 
 extern ALooperRoster gLooperRoster;
 
+namespace {
+
+// Freed messages are kept on a free list and handed out again by operator new, so that
+// the steady stream of short lived messages between codecs and players does not go
+// through the allocator.
+struct PooledMessage {
+    PooledMessage *mNext;
+};
+
+const size_t kMaxPooledMessages = 32;
+
+Mutex gMessagePoolLock;
+PooledMessage *gMessagePool = NULL;
+size_t gMessagePoolSize = 0;
+
+// Returns the hash of a 0-terminated name, and its length, in a single pass.
+inline uint32_t hashName(const char *name, size_t *len) {
+    uint32_t hash = 2166136261u;    // FNV-1a
+    const char *s = name;
+    for (; *s != '\0'; ++s) {
+        hash = (hash ^ (uint8_t)*s) * 16777619u;
+    }
+    *len = s - name;
+    return hash;
+}
+
+}  // namespace
+
 status_t AReplyToken::setReply(const sp<AMessage> &reply) {
     if (mReplied) {
         ALOGE("trying to post a duplicate reply");
@@ -64,6 +93,38 @@ AMessage::~AMessage() {
     clear();
 }
 
+// static
+void *AMessage::operator new(size_t size) {
+    if (size == sizeof(AMessage)) {
+        Mutex::Autolock autoLock(gMessagePoolLock);
+        PooledMessage *msg = gMessagePool;
+        if (msg != NULL) {
+            gMessagePool = msg->mNext;
+            --gMessagePoolSize;
+            return msg;
+        }
+    }
+    return ::operator new(size);
+}
+
+// static
+void AMessage::operator delete(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    if (size == sizeof(AMessage)) {
+        Mutex::Autolock autoLock(gMessagePoolLock);
+        if (gMessagePoolSize < kMaxPooledMessages) {
+            PooledMessage *msg = static_cast<PooledMessage *>(ptr);
+            msg->mNext = gMessagePool;
+            gMessagePool = msg;
+            ++gMessagePoolSize;
+            return;
+        }
+    }
+    ::operator delete(ptr);
+}
+
 void AMessage::setWhat(uint32_t what) {
     mWhat = what;
 }
@@ -87,9 +148,8 @@ void AMessage::setTarget(const sp<const AHandler> &handler) {
 void AMessage::clear() {
     for (size_t i = 0; i < mNumItems; ++i) {
         Item *item = &mItems[i];
-        delete[] item->mName;
-        item->mName = NULL;
         freeItemValue(item);
+        item->freeName();
     }
     mNumItems = 0;
 }
@@ -98,7 +158,9 @@ void AMessage::freeItemValue(Item *item) {
     switch (item->mType) {
         case kTypeString:
         {
-            delete item->u.stringValue;
+            if (!(item->mFlags & Item::kFlagInlineString)) {
+                delete item->u.stringValue;
+            }
             break;
         }
 
@@ -147,19 +209,21 @@ static void reportStats() {
 }
 #endif
 
-inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
+inline size_t AMessage::findItemIndex(
+        const char *name, size_t len, uint32_t hash) const {
 #ifdef DUMP_STATS
     size_t memchecks = 0;
 #endif
     size_t i = 0;
     for (; i < mNumItems; i++) {
-        if (len != mItems[i].mNameLength) {
+        const Item &item = mItems[i];
+        if (hash != item.mNameHash || len != item.mNameLength) {
             continue;
         }
 #ifdef DUMP_STATS
         ++memchecks;
 #endif
-        if (!memcmp(mItems[i].mName, name, len)) {
+        if (item.mName == name || !memcmp(item.mName, name, len)) {
             break;
         }
     }
@@ -177,15 +241,57 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
 }
 
 // assumes item's name was uninitialized or NULL
-void AMessage::Item::setName(const char *name, size_t len) {
+void AMessage::Item::setName(const char *name, size_t len, uint32_t hash) {
+    mName = AAtomizer::Atomize(name);
     mNameLength = len;
-    mName = new char[len + 1];
-    memcpy((void*)mName, name, len + 1);
+    mNameHash = hash;
+    mFlags &= ~kFlagNameOwned;
+}
+
+// assumes item's name was uninitialized or NULL
+void AMessage::Item::setOwnedName(const char *name, size_t len, uint32_t hash) {
+    char *copy = new char[len + 1];
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    mName = copy;
+    mNameLength = len;
+    mNameHash = hash;
+    mFlags |= kFlagNameOwned;
+}
+
+void AMessage::Item::freeName() {
+    if (mFlags & kFlagNameOwned) {
+        delete[] mName;
+    }
+    mName = NULL;
+    mFlags &= ~kFlagNameOwned;
+}
+
+// assumes the previous value, if any, has been freed
+void AMessage::Item::setStringValue(const char *s, size_t len) {
+    if (len <= kMaxInlineStringLength) {
+        memcpy(u.inlineString, s, len);
+        u.inlineString[len] = '\0';
+        mInlineStringLength = len;
+        mFlags |= kFlagInlineString;
+    } else {
+        u.stringValue = new AString(s, len);
+        mFlags &= ~kFlagInlineString;
+    }
+}
+
+const char *AMessage::Item::stringData() const {
+    return (mFlags & kFlagInlineString) ? u.inlineString : u.stringValue->c_str();
+}
+
+size_t AMessage::Item::stringSize() const {
+    return (mFlags & kFlagInlineString) ? mInlineStringLength : u.stringValue->size();
 }
 
 AMessage::Item *AMessage::allocateItem(const char *name) {
-    size_t len = strlen(name);
-    size_t i = findItemIndex(name, len);
+    size_t len;
+    uint32_t hash = hashName(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     Item *item;
 
     if (i < mNumItems) {
@@ -195,7 +301,8 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
         CHECK(mNumItems < kMaxNumItems);
         i = mNumItems++;
         item = &mItems[i];
-        item->setName(name, len);
+        item->mFlags = 0;
+        item->setName(name, len, hash);
     }
 
     return item;
@@ -203,7 +310,9 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
 
 const AMessage::Item *AMessage::findItem(
         const char *name, Type type) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t len;
+    uint32_t hash = hashName(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     if (i < mNumItems) {
         const Item *item = &mItems[i];
         return item->mType == type ? item : NULL;
@@ -213,7 +322,9 @@ const AMessage::Item *AMessage::findItem(
 }
 
 bool AMessage::contains(const char *name) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t len;
+    uint32_t hash = hashName(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     return i < mNumItems;
 }
 
@@ -247,7 +358,7 @@ void AMessage::setString(
         const char *name, const char *s, ssize_t len) {
     Item *item = allocateItem(name);
     item->mType = kTypeString;
-    item->u.stringValue = new AString(s, len < 0 ? strlen(s) : len);
+    item->setStringValue(s, len < 0 ? strlen(s) : len);
 }
 
 void AMessage::setString(
@@ -295,7 +406,7 @@ void AMessage::setRect(
 bool AMessage::findString(const char *name, AString *value) const {
     const Item *item = findItem(name, kTypeString);
     if (item) {
-        *value = *item->u.stringValue;
+        value->setTo(item->stringData(), item->stringSize());
         return true;
     }
     return false;
@@ -355,13 +466,25 @@ void AMessage::deliver() {
 }
 
 status_t AMessage::post(int64_t delayUs) {
+    return post(delayUs, ALooper::POST_ALWAYS);
+}
+
+status_t AMessage::postCoalesced(int64_t delayUs) {
+    return post(delayUs, ALooper::POST_COALESCE);
+}
+
+status_t AMessage::postReplacing(int64_t delayUs) {
+    return post(delayUs, ALooper::POST_REPLACE);
+}
+
+status_t AMessage::post(int64_t delayUs, ALooper::PostMode mode) {
     sp<ALooper> looper = mLooper.promote();
     if (looper == NULL) {
         ALOGW("failed to post message as target looper for handler %d is gone.", mTarget);
         return -ENOENT;
     }
 
-    looper->post(this, delayUs);
+    looper->post(this, delayUs, mode);
     return OK;
 }
 
@@ -429,14 +552,20 @@ sp<AMessage> AMessage::dup() const {
         const Item *from = &mItems[i];
         Item *to = &msg->mItems[i];
 
-        to->setName(from->mName, from->mNameLength);
+        to->mFlags = 0;
+        if (from->mFlags & Item::kFlagNameOwned) {
+            to->setOwnedName(from->mName, from->mNameLength, from->mNameHash);
+        } else {
+            to->mName = from->mName;
+            to->mNameLength = from->mNameLength;
+            to->mNameHash = from->mNameHash;
+        }
         to->mType = from->mType;
 
         switch (from->mType) {
             case kTypeString:
             {
-                to->u.stringValue =
-                    new AString(*from->u.stringValue);
+                to->setStringValue(from->stringData(), from->stringSize());
                 break;
             }
 
@@ -540,7 +669,7 @@ AString AMessage::debugString(int32_t indent) const {
                 tmp = AStringPrintf(
                         "string %s = \"%s\"",
                         item.mName,
-                        item.u.stringValue->c_str());
+                        item.stringData());
                 break;
             case kTypeObject:
                 tmp = AStringPrintf(
@@ -617,7 +746,8 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel) {
         }
 
         item->mType = static_cast<Type>(parcel.readInt32());
-        // setName() happens below so that we don't leak memory when parsing
+        item->mFlags = 0;
+        // setOwnedName() happens below so that we don't leak memory when parsing
         // is aborted in the middle.
         switch (item->mType) {
             case kTypeInt32:
@@ -660,7 +790,7 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel) {
                     continue;
                     // The loop will terminate subsequently.
                 } else {
-                    item->u.stringValue = new AString(stringValue);
+                    item->setStringValue(stringValue, strlen(stringValue));
                 }
                 break;
             }
@@ -681,7 +811,9 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel) {
             }
         }
 
-        item->setName(name, strlen(name));
+        size_t len;
+        uint32_t hash = hashName(name, &len);
+        item->setOwnedName(name, len, hash);
     }
 
     return msg;
@@ -730,7 +862,7 @@ void AMessage::writeToParcel(Parcel *parcel) const {
 
             case kTypeString:
             {
-                parcel->writeCString(item.u.stringValue->c_str());
+                parcel->writeCString(item.stringData());
                 break;
             }
 
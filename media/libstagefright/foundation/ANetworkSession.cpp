@@ -27,8 +27,10 @@
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -52,6 +54,14 @@ static uint64_t U64_AT(const uint8_t *ptr) {
 static const size_t kMaxUDPSize = 1500;
 static const int32_t kMaxUDPRetries = 200;
 
+// Number of queued fragments handed to a single sendmmsg() or writev().
+static const size_t kMaxFragmentsPerSend = 16;
+
+static const int kMaxEventsPerWait = 32;
+
+// epoll_event data identifying the wakeup pipe, session IDs start at 1.
+static const uint32_t kPipeEventID = 0;
+
 struct ANetworkSession::NetworkThread : public Thread {
     NetworkThread(ANetworkSession *session);
 
@@ -102,6 +112,21 @@ struct ANetworkSession::Session : public RefBase {
     status_t sendRequest(
             const void *data, ssize_t size, bool timeValid, int64_t timeUs);
 
+    status_t sendRequest(
+            const sp<ABuffer> &buffer, bool timeValid, int64_t timeUs);
+
+    status_t sendRequest(
+            const sp<ABuffer> &header,
+            const sp<ABuffer> &payload, size_t payloadOffset, size_t payloadSize,
+            bool timeValid, int64_t timeUs);
+
+    void getStats(SessionStats *stats) const;
+
+    // The events this session's socket is registered for in the epoll set,
+    // 0 if it isn't registered.
+    uint32_t pollEvents() const;
+    void setPollEvents(uint32_t events);
+
     void setMode(Mode mode);
 
     status_t switchToWebSocketMode();
@@ -112,11 +137,22 @@ protected:
 private:
     enum {
         FRAGMENT_FLAG_TIME_VALID = 1,
+        // The datagram continues with the next fragment.
+        FRAGMENT_FLAG_MORE       = 2,
     };
     struct Fragment {
         uint32_t mFlags;
         int64_t mTimeUs;
+        int64_t mQueuedUs;
+
+        // mSize bytes at mBuffer->data() + mStart. The buffer itself is
+        // left untouched, it may be shared with the client.
         sp<ABuffer> mBuffer;
+        size_t mStart;
+        size_t mSize;
+
+        // Bytes already written to a stream socket.
+        size_t mOffset;
     };
 
     int32_t mSessionID;
@@ -128,6 +164,9 @@ private:
     int32_t mUDPRetries;
 
     List<Fragment> mOutFragments;
+    SessionStats mStats;
+
+    uint32_t mPollEvents;
 
     AString mInBuffer;
 
@@ -136,6 +175,13 @@ private:
     void notifyError(bool send, status_t err, const char *detail);
     void notify(NotificationReason reason);
 
+    void queueFragment(
+            const sp<ABuffer> &buffer, bool timeValid, int64_t timeUs);
+    void queueFragment(
+            const sp<ABuffer> &buffer, size_t start, size_t size, bool more,
+            bool timeValid, int64_t timeUs);
+    void onFragmentSent(const Fragment &frag, int64_t nowUs);
+
     void dumpFragmentStats(const Fragment &frag);
 
     DISALLOW_EVIL_CONSTRUCTORS(Session);
@@ -170,7 +216,10 @@ ANetworkSession::Session::Session(
       mSawReceiveFailure(false),
       mSawSendFailure(false),
       mUDPRetries(kMaxUDPRetries),
+      mPollEvents(0),
       mLastStallReportUs(-1ll) {
+    memset(&mStats, 0, sizeof(mStats));
+
     if (mState == CONNECTED) {
         struct sockaddr_in localAddr;
         socklen_t localAddrLen = sizeof(localAddr);
@@ -228,6 +277,18 @@ int ANetworkSession::Session::socket() const {
     return mSocket;
 }
 
+uint32_t ANetworkSession::Session::pollEvents() const {
+    return mPollEvents;
+}
+
+void ANetworkSession::Session::setPollEvents(uint32_t events) {
+    mPollEvents = events;
+}
+
+void ANetworkSession::Session::getStats(SessionStats *stats) const {
+    *stats = mStats;
+}
+
 void ANetworkSession::Session::setMode(Mode mode) {
     mMode = mode;
 }
@@ -554,22 +615,69 @@ status_t ANetworkSession::Session::writeMore() {
 
         status_t err;
         do {
-            const Fragment &frag = *mOutFragments.begin();
-            const sp<ABuffer> &datagram = frag.mBuffer;
+            struct mmsghdr msgs[kMaxFragmentsPerSend];
+            struct iovec iovs[kMaxFragmentsPerSend];
+            size_t numFragments[kMaxFragmentsPerSend];
+
+            // Each datagram is a run of fragments flagged MORE and the one
+            // that ends it, gathered into a single message.
+            size_t count = 0;
+            size_t numIovs = 0;
+            List<Fragment>::iterator it = mOutFragments.begin();
+            while (it != mOutFragments.end() && numIovs < kMaxFragmentsPerSend) {
+                size_t first = numIovs;
+                bool complete = false;
+
+                List<Fragment>::iterator next = it;
+                while (next != mOutFragments.end()
+                        && numIovs < kMaxFragmentsPerSend) {
+                    const Fragment &frag = *next++;
+
+                    iovs[numIovs].iov_base = frag.mBuffer->data() + frag.mStart;
+                    iovs[numIovs].iov_len = frag.mSize;
+                    ++numIovs;
+
+                    if (!(frag.mFlags & FRAGMENT_FLAG_MORE)) {
+                        complete = true;
+                        break;
+                    }
+                }
+
+                if (!complete) {
+                    break;
+                }
+
+                memset(&msgs[count], 0, sizeof(msgs[count]));
+                msgs[count].msg_hdr.msg_iov = &iovs[first];
+                msgs[count].msg_hdr.msg_iovlen = numIovs - first;
+                numFragments[count] = numIovs - first;
+                ++count;
+
+                it = next;
+            }
+            CHECK_GT(count, 0u);
 
             int n;
             do {
-                n = send(mSocket, datagram->data(), datagram->size(), 0);
+                n = sendmmsg(mSocket, msgs, count, 0);
             } while (n < 0 && errno == EINTR);
 
             err = OK;
 
             if (n > 0) {
-                if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
-                    dumpFragmentStats(frag);
-                }
+                int64_t nowUs = ALooper::GetNowUs();
+                for (int i = 0; i < n; ++i) {
+                    for (size_t j = 0; j < numFragments[i]; ++j) {
+                        const Fragment &frag = *mOutFragments.begin();
 
-                mOutFragments.erase(mOutFragments.begin());
+                        if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
+                            dumpFragmentStats(frag);
+                        }
+
+                        onFragmentSent(frag, nowUs);
+                        mOutFragments.erase(mOutFragments.begin());
+                    }
+                }
             } else if (n < 0) {
                 err = -errno;
             } else if (n == 0) {
@@ -625,28 +733,53 @@ status_t ANetworkSession::Session::writeMore() {
 
     ssize_t n = -1;
     while (!mOutFragments.empty()) {
-        const Fragment &frag = *mOutFragments.begin();
+        struct iovec iovs[kMaxFragmentsPerSend];
+
+        size_t count = 0;
+        size_t numBytes = 0;
+        for (List<Fragment>::iterator it = mOutFragments.begin();
+                it != mOutFragments.end() && count < kMaxFragmentsPerSend;
+                ++it, ++count) {
+            iovs[count].iov_base =
+                (*it).mBuffer->data() + (*it).mStart + (*it).mOffset;
+            iovs[count].iov_len = (*it).mSize - (*it).mOffset;
+            numBytes += iovs[count].iov_len;
+        }
 
         do {
-            n = send(mSocket, frag.mBuffer->data(), frag.mBuffer->size(), 0);
+            n = writev(mSocket, iovs, count);
         } while (n < 0 && errno == EINTR);
 
         if (n <= 0) {
             break;
         }
 
-        frag.mBuffer->setRange(
-                frag.mBuffer->offset() + n, frag.mBuffer->size() - n);
+        int64_t nowUs = ALooper::GetNowUs();
 
-        if (frag.mBuffer->size() > 0) {
-            break;
-        }
+        size_t remaining = n;
+        while (remaining > 0) {
+            Fragment &frag = *mOutFragments.begin();
+
+            size_t left = frag.mSize - frag.mOffset;
+            if (remaining < left) {
+                frag.mOffset += remaining;
+                break;
+            }
 
-        if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
-            dumpFragmentStats(frag);
+            remaining -= left;
+
+            if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
+                dumpFragmentStats(frag);
+            }
+
+            onFragmentSent(frag, nowUs);
+            mOutFragments.erase(mOutFragments.begin());
         }
 
-        mOutFragments.erase(mOutFragments.begin());
+        if ((size_t)n < numBytes) {
+            // The socket buffer is full.
+            break;
+        }
     }
 
     status_t err = OK;
@@ -762,6 +895,89 @@ status_t ANetworkSession::Session::sendRequest(
         memcpy(buffer->data(), data, size);
     }
 
+    queueFragment(buffer, timeValid, timeUs);
+
+    return OK;
+}
+
+status_t ANetworkSession::Session::sendRequest(
+        const sp<ABuffer> &buffer, bool timeValid, int64_t timeUs) {
+    CHECK(mState == CONNECTED || mState == DATAGRAM);
+
+    if (mState == CONNECTED && mMode == MODE_WEBSOCKET) {
+        return INVALID_OPERATION;
+    }
+
+    if (buffer->size() == 0) {
+        return OK;
+    }
+
+    if (mState == CONNECTED && mMode == MODE_DATAGRAM) {
+        if (buffer->size() > 65535) {
+            return -EMSGSIZE;
+        }
+
+        // The length prefix goes out as its own fragment, writev() joins
+        // it with the payload.
+        sp<ABuffer> header = new ABuffer(2);
+        header->data()[0] = buffer->size() >> 8;
+        header->data()[1] = buffer->size() & 0xff;
+
+        queueFragment(header, false /* timeValid */, -1ll);
+    }
+
+    queueFragment(buffer, timeValid, timeUs);
+
+    return OK;
+}
+
+status_t ANetworkSession::Session::sendRequest(
+        const sp<ABuffer> &header,
+        const sp<ABuffer> &payload, size_t payloadOffset, size_t payloadSize,
+        bool timeValid, int64_t timeUs) {
+    CHECK(mState == CONNECTED || mState == DATAGRAM);
+    CHECK_LE(payloadOffset + payloadSize, payload->size());
+
+    if (mState == CONNECTED && mMode == MODE_WEBSOCKET) {
+        return INVALID_OPERATION;
+    }
+
+    size_t size = header->size() + payloadSize;
+
+    if (mState == CONNECTED && mMode == MODE_DATAGRAM) {
+        if (size > 65535) {
+            return -EMSGSIZE;
+        }
+
+        sp<ABuffer> length = new ABuffer(2);
+        length->data()[0] = size >> 8;
+        length->data()[1] = size & 0xff;
+
+        queueFragment(length, 0, 2, true /* more */, false /* timeValid */, -1ll);
+    }
+
+    queueFragment(
+            header, 0, header->size(), payloadSize > 0 /* more */,
+            timeValid && payloadSize == 0, timeUs);
+
+    if (payloadSize > 0) {
+        queueFragment(
+                payload, payloadOffset, payloadSize,
+                false /* more */, timeValid, timeUs);
+    }
+
+    return OK;
+}
+
+void ANetworkSession::Session::queueFragment(
+        const sp<ABuffer> &buffer, bool timeValid, int64_t timeUs) {
+    queueFragment(
+            buffer, 0, buffer->size(), false /* more */, timeValid, timeUs);
+}
+
+void ANetworkSession::Session::queueFragment(
+        const sp<ABuffer> &buffer, size_t start, size_t size, bool more,
+        bool timeValid, int64_t timeUs) {
     Fragment frag;
 
     frag.mFlags = 0;
@@ -770,11 +986,39 @@ status_t ANetworkSession::Session::sendRequest(
         frag.mTimeUs = timeUs;
     }
 
+    if (more) {
+        frag.mFlags |= FRAGMENT_FLAG_MORE;
+    }
+
+    frag.mQueuedUs = ALooper::GetNowUs();
     frag.mBuffer = buffer;
+    frag.mStart = start;
+    frag.mSize = size;
+    frag.mOffset = 0;
 
     mOutFragments.push_back(frag);
 
-    return OK;
+    ++mStats.mQueuedFragments;
+    mStats.mQueuedBytes += size;
+    if (mStats.mQueuedFragments > mStats.mMaxQueuedFragments) {
+        mStats.mMaxQueuedFragments = mStats.mQueuedFragments;
+    }
+}
+
+void ANetworkSession::Session::onFragmentSent(
+        const Fragment &frag, int64_t nowUs) {
+    --mStats.mQueuedFragments;
+    mStats.mQueuedBytes -= frag.mSize;
+
+    ++mStats.mNumFragmentsSent;
+    mStats.mNumBytesSent += frag.mSize;
+
+    int64_t latencyUs = nowUs - frag.mQueuedUs;
+    mStats.mLastSendLatencyUs = latencyUs;
+    mStats.mTotalSendLatencyUs += latencyUs;
+    if (latencyUs > mStats.mMaxSendLatencyUs) {
+        mStats.mMaxSendLatencyUs = latencyUs;
+    }
 }
 
 void ANetworkSession::Session::notifyError(
@@ -798,7 +1042,8 @@ void ANetworkSession::Session::notify(NotificationReason reason) {
 ////////////////////////////////////////////////////////////////////////////////
 
 ANetworkSession::ANetworkSession()
-    : mNextSessionID(1) {
+    : mNextSessionID(1),
+      mEpollFd(-1) {
     mPipeFd[0] = mPipeFd[1] = -1;
 }
 
@@ -817,6 +1062,29 @@ status_t ANetworkSession::start() {
         return -errno;
     }
 
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = kPipeEventID;
+
+    if (mEpollFd < 0
+            || epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mPipeFd[0], &ev) < 0) {
+        status_t err = -errno;
+
+        if (mEpollFd >= 0) {
+            close(mEpollFd);
+            mEpollFd = -1;
+        }
+
+        close(mPipeFd[0]);
+        close(mPipeFd[1]);
+        mPipeFd[0] = mPipeFd[1] = -1;
+
+        return err;
+    }
+
     mThread = new NetworkThread(this);
 
     status_t err = mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
@@ -824,6 +1092,9 @@ status_t ANetworkSession::start() {
     if (err != OK) {
         mThread.clear();
 
+        close(mEpollFd);
+        mEpollFd = -1;
+
         close(mPipeFd[0]);
         close(mPipeFd[1]);
         mPipeFd[0] = mPipeFd[1] = -1;
@@ -845,6 +1116,18 @@ status_t ANetworkSession::stop() {
 
     mThread.clear();
 
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        // The sessions are registered again with the next epoll set.
+        for (size_t i = 0; i < mSessions.size(); ++i) {
+            mSessions.valueAt(i)->setPollEvents(0);
+        }
+    }
+
+    close(mEpollFd);
+    mEpollFd = -1;
+
     close(mPipeFd[0]);
     close(mPipeFd[1]);
     mPipeFd[0] = mPipeFd[1] = -1;
@@ -937,6 +1220,12 @@ status_t ANetworkSession::destroySession(int32_t sessionID) {
         return -ENOENT;
     }
 
+    const sp<Session> session = mSessions.valueAt(index);
+    if (session->pollEvents() != 0) {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, session->socket(), NULL);
+        session->setPollEvents(0);
+    }
+
     mSessions.removeItemsAt(index);
 
     interrupt();
@@ -1222,6 +1511,64 @@ status_t ANetworkSession::sendRequest(
     return err;
 }
 
+status_t ANetworkSession::sendRequest(
+        int32_t sessionID, const sp<ABuffer> &buffer,
+        bool timeValid, int64_t timeUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSessions.indexOfKey(sessionID);
+
+    if (index < 0) {
+        return -ENOENT;
+    }
+
+    const sp<Session> session = mSessions.valueAt(index);
+
+    status_t err = session->sendRequest(buffer, timeValid, timeUs);
+
+    interrupt();
+
+    return err;
+}
+
+status_t ANetworkSession::sendRequest(
+        int32_t sessionID,
+        const sp<ABuffer> &header,
+        const sp<ABuffer> &payload, size_t payloadOffset, size_t payloadSize,
+        bool timeValid, int64_t timeUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSessions.indexOfKey(sessionID);
+
+    if (index < 0) {
+        return -ENOENT;
+    }
+
+    const sp<Session> session = mSessions.valueAt(index);
+
+    status_t err = session->sendRequest(
+            header, payload, payloadOffset, payloadSize, timeValid, timeUs);
+
+    interrupt();
+
+    return err;
+}
+
+status_t ANetworkSession::getSessionStats(
+        int32_t sessionID, SessionStats *stats) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSessions.indexOfKey(sessionID);
+
+    if (index < 0) {
+        return -ENOENT;
+    }
+
+    mSessions.valueAt(index)->getStats(stats);
+
+    return OK;
+}
+
 status_t ANetworkSession::switchToWebSocketMode(int32_t sessionID) {
     Mutex::Autolock autoLock(mLock);
 
@@ -1248,43 +1595,56 @@ void ANetworkSession::interrupt() {
     }
 }
 
-void ANetworkSession::threadLoop() {
-    fd_set rs, ws;
-    FD_ZERO(&rs);
-    FD_ZERO(&ws);
+void ANetworkSession::updatePollEvents_l(const sp<Session> &session) {
+    uint32_t events = 0;
+    if (session->socket() >= 0) {
+        if (session->wantsToRead()) {
+            events |= EPOLLIN;
+        }
+        if (session->wantsToWrite()) {
+            events |= EPOLLOUT;
+        }
+    }
 
-    FD_SET(mPipeFd[0], &rs);
-    int maxFd = mPipeFd[0];
+    uint32_t oldEvents = session->pollEvents();
+    if (events == oldEvents) {
+        return;
+    }
 
-    {
-        Mutex::Autolock autoLock(mLock);
+    // A session that wants neither is taken out of the set altogether,
+    // epoll would otherwise keep reporting EPOLLHUP on a dead socket.
+    int op = EPOLL_CTL_MOD;
+    if (oldEvents == 0) {
+        op = EPOLL_CTL_ADD;
+    } else if (events == 0) {
+        op = EPOLL_CTL_DEL;
+    }
 
-        for (size_t i = 0; i < mSessions.size(); ++i) {
-            const sp<Session> &session = mSessions.valueAt(i);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u32 = session->sessionID();
 
-            int s = session->socket();
+    if (epoll_ctl(mEpollFd, op, session->socket(), &ev) < 0) {
+        ALOGE("epoll_ctl on socket %d failed w/ error %d (%s)",
+              session->socket(), errno, strerror(errno));
+        return;
+    }
 
-            if (s < 0) {
-                continue;
-            }
+    session->setPollEvents(events);
+}
 
-            if (session->wantsToRead()) {
-                FD_SET(s, &rs);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
+void ANetworkSession::threadLoop() {
+    {
+        Mutex::Autolock autoLock(mLock);
 
-            if (session->wantsToWrite()) {
-                FD_SET(s, &ws);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
+        for (size_t i = 0; i < mSessions.size(); ++i) {
+            updatePollEvents_l(mSessions.valueAt(i));
         }
     }
 
-    int res = select(maxFd + 1, &rs, &ws, NULL, NULL /* tv */);
+    struct epoll_event events[kMaxEventsPerWait];
+    int res = epoll_wait(mEpollFd, events, kMaxEventsPerWait, -1 /* timeout */);
 
     if (res == 0) {
         return;
@@ -1295,32 +1655,36 @@ void ANetworkSession::threadLoop() {
             return;
         }
 
-        ALOGE("select failed w/ error %d (%s)", errno, strerror(errno));
+        ALOGE("epoll_wait failed w/ error %d (%s)", errno, strerror(errno));
         return;
     }
 
-    if (FD_ISSET(mPipeFd[0], &rs)) {
-        char c;
-        ssize_t n;
-        do {
-            n = read(mPipeFd[0], &c, 1);
-        } while (n < 0 && errno == EINTR);
-
-        if (n < 0) {
-            ALOGW("Error reading from pipe (%s)", strerror(errno));
-        }
-
-        --res;
-    }
-
     {
         Mutex::Autolock autoLock(mLock);
 
         List<sp<Session> > sessionsToAdd;
 
-        for (size_t i = mSessions.size(); res > 0 && i > 0;) {
-            i--;
-            const sp<Session> &session = mSessions.valueAt(i);
+        for (int i = 0; i < res; ++i) {
+            if (events[i].data.u32 == kPipeEventID) {
+                char c;
+                ssize_t n;
+                do {
+                    n = read(mPipeFd[0], &c, 1);
+                } while (n < 0 && errno == EINTR);
+
+                if (n < 0) {
+                    ALOGW("Error reading from pipe (%s)", strerror(errno));
+                }
+                continue;
+            }
+
+            ssize_t index = mSessions.indexOfKey(events[i].data.u32);
+            if (index < 0) {
+                // Destroyed after epoll_wait() returned.
+                continue;
+            }
+
+            const sp<Session> session = mSessions.valueAt(index);
 
             int s = session->socket();
 
@@ -1328,11 +1692,16 @@ void ANetworkSession::threadLoop() {
                 continue;
             }
 
-            if (FD_ISSET(s, &rs) || FD_ISSET(s, &ws)) {
-                --res;
+            // Like select(), report errors and hangups to whichever
+            // direction the session is waiting on.
+            uint32_t wanted = session->pollEvents();
+            uint32_t ready = events[i].events;
+            if (ready & (EPOLLERR | EPOLLHUP)) {
+                ready |= EPOLLIN | EPOLLOUT;
             }
+            ready &= wanted;
 
-            if (FD_ISSET(s, &rs)) {
+            if (ready & EPOLLIN) {
                 if (session->isRTSPServer() || session->isTCPDatagramServer()) {
                     struct sockaddr_in remoteAddr;
                     socklen_t remoteAddrLen = sizeof(remoteAddr);
@@ -1389,7 +1758,7 @@ void ANetworkSession::threadLoop() {
                 }
             }
 
-            if (FD_ISSET(s, &ws)) {
+            if (ready & EPOLLOUT) {
                 status_t err = session->writeMore();
                 if (err != OK) {
                     ALOGE("writeMore on socket %d failed w/ error %d (%s)",
@@ -5,6 +5,7 @@ LOCAL_SRC_FILES:=                 \
     AAtomizer.cpp                 \
     ABitReader.cpp                \
     ABuffer.cpp                   \
+    ACpuAccounting.cpp            \
     ADebug.cpp                    \
     AHandler.cpp                  \
     AHierarchicalStateMachine.cpp \
@@ -29,6 +30,9 @@ LOCAL_SHARED_LIBRARIES := \
         liblog            \
         libpowermanager
 
+LOCAL_STATIC_LIBRARIES := \
+        libcpustats
+
 LOCAL_CFLAGS += -Wno-multichar -Werror -Wall
 LOCAL_CLANG := true
 
@@ -21,26 +21,66 @@
 #include <media/stagefright/MediaHTTP.h>
 
 #include <binder/IServiceManager.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/Utils.h>
 
 #include <media/IMediaHTTPConnection.h>
+#include <media/IMediaHTTPService.h>
 
 namespace android {
 
+// limit the buffer sizes transferred across binder boundaries
+// to avoid spurious transaction failures.
+static const size_t kMaxTransferSize = 64 * 1024;
+
+// Fetches pending chunks over its own connection.
+struct MediaHTTP::Fetcher : public Thread {
+    Fetcher(MediaHTTP *owner, const sp<IMediaHTTPConnection> &conn)
+        : Thread(false /* canCallJava */),
+          mOwner(owner),
+          mConnection(conn),
+          mConnected(false) {
+    }
+
+    MediaHTTP *mOwner;
+    sp<IMediaHTTPConnection> mConnection;
+    bool mConnected;
+
+private:
+    virtual bool threadLoop() {
+        return mOwner->fetchChunk(this);
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(Fetcher);
+};
+
 MediaHTTP::MediaHTTP(const sp<IMediaHTTPConnection> &conn)
     : mInitCheck((conn != NULL) ? OK : NO_INIT),
       mHTTPConnection(conn),
       mCachedSizeValid(false),
       mCachedSize(0ll),
-      mDrmManagerClient(NULL) {
+      mDrmManagerClient(NULL),
+      mNumParallelConnections(0),
+      mStopFetchers(false),
+      mLastFetchCompletedUs(-1ll) {
 }
 
 MediaHTTP::~MediaHTTP() {
+    stopFetchers();
     clearDRMState_l();
 }
 
+void MediaHTTP::setParallelConnections(
+        const sp<IMediaHTTPService> &service, size_t numConnections) {
+    stopFetchers();
+
+    Mutex::Autolock autoLock(mParallelLock);
+    mHTTPService = service;
+    mNumParallelConnections = (service != NULL) ? numConnections : 0;
+}
+
 status_t MediaHTTP::connect(
         const char *uri,
         const KeyedVector<String8, String8> *headers,
@@ -49,6 +89,8 @@ status_t MediaHTTP::connect(
         return mInitCheck;
     }
 
+    stopFetchers();
+
     KeyedVector<String8, String8> extHeaders;
     if (headers != NULL) {
         extHeaders = *headers;
@@ -73,6 +115,8 @@ void MediaHTTP::disconnect() {
         return;
     }
 
+    stopFetchers();
+
     mHTTPConnection->disconnect();
 }
 
@@ -85,16 +129,24 @@ ssize_t MediaHTTP::readAt(off64_t offset, void *data, size_t size) {
         return mInitCheck;
     }
 
+    off64_t contentSize;
+    if (mNumParallelConnections > 1
+            && getSize(&contentSize) == OK && contentSize > 0) {
+        return readAtParallel(offset, data, size, contentSize);
+    }
+
+    return readAtSerial(offset, data, size);
+}
+
+ssize_t MediaHTTP::readAtSerial(off64_t offset, void *data, size_t size) {
     int64_t startTimeUs = ALooper::GetNowUs();
 
     size_t numBytesRead = 0;
     while (numBytesRead < size) {
         size_t copy = size - numBytesRead;
 
-        if (copy > 64 * 1024) {
-            // limit the buffer sizes transferred across binder boundaries
-            // to avoid spurious transaction failures.
-            copy = 64 * 1024;
+        if (copy > kMaxTransferSize) {
+            copy = kMaxTransferSize;
         }
 
         ssize_t n = mHTTPConnection->readAt(
@@ -116,6 +168,283 @@ ssize_t MediaHTTP::readAt(off64_t offset, void *data, size_t size) {
     return numBytesRead;
 }
 
+ssize_t MediaHTTP::readAtParallel(
+        off64_t offset, void *data, size_t size, off64_t contentSize) {
+    size_t numBytesRead = 0;
+
+    Mutex::Autolock autoLock(mParallelLock);
+
+    startFetchers_l();
+
+    while (numBytesRead < size) {
+        off64_t pos = offset + numBytesRead;
+        if (pos >= contentSize) {
+            break;
+        }
+
+        int64_t index = pos / kParallelChunkSize;
+        fillWindow_l(index, contentSize);
+
+        // Without fetchers (stopped by a disconnect, or none could be
+        // started) pending chunks are read below instead.
+        ssize_t i;
+        while ((i = mChunks.indexOfKey(index)) >= 0
+                && !mFetchers.isEmpty()
+                && (mChunks.valueAt(i).mState == CHUNK_PENDING
+                    || mChunks.valueAt(i).mState == CHUNK_FETCHING)) {
+            mParallelCondition.wait(mParallelLock);
+        }
+
+        size_t chunkOffset = pos - index * kParallelChunkSize;
+        size_t copy = size - numBytesRead;
+
+        if (i < 0 || mChunks.valueAt(i).mState != CHUNK_DONE) {
+            // Fall back to the primary connection for the rest of this
+            // chunk, the fetcher's connection might have gone bad.
+            if (copy > kParallelChunkSize - chunkOffset) {
+                copy = kParallelChunkSize - chunkOffset;
+            }
+
+            mParallelLock.unlock();
+            ssize_t n = readAtSerial(
+                    pos, (uint8_t *)data + numBytesRead, copy);
+            mParallelLock.lock();
+
+            if (n < 0) {
+                return numBytesRead > 0 ? (ssize_t)numBytesRead : n;
+            } else if (n == 0) {
+                break;
+            }
+
+            numBytesRead += n;
+            continue;
+        }
+
+        const sp<ABuffer> &chunk = mChunks.valueAt(i).mData;
+        if (chunkOffset >= chunk->size()) {
+            // The server delivered less than the content length promised.
+            break;
+        }
+
+        if (copy > chunk->size() - chunkOffset) {
+            copy = chunk->size() - chunkOffset;
+        }
+
+        memcpy((uint8_t *)data + numBytesRead, chunk->data() + chunkOffset, copy);
+        numBytesRead += copy;
+    }
+
+    return numBytesRead;
+}
+
+void MediaHTTP::startFetchers_l() {
+    if (!mFetchers.isEmpty()) {
+        return;
+    }
+
+    mStopFetchers = false;
+    mLastFetchCompletedUs = -1ll;
+
+    // The primary connection only serves fallback reads.
+    for (size_t i = 0; i < mNumParallelConnections; ++i) {
+        sp<IMediaHTTPConnection> conn = mHTTPService->makeHTTPConnection();
+        if (conn == NULL) {
+            break;
+        }
+
+        sp<Fetcher> fetcher = new Fetcher(this, conn);
+        if (fetcher->run("MediaHTTPFetcher") != OK) {
+            break;
+        }
+
+        mFetchers.push(fetcher);
+    }
+
+    ALOGV("started %zu fetchers", mFetchers.size());
+}
+
+void MediaHTTP::stopFetchers() {
+    Vector<sp<Fetcher> > fetchers;
+
+    {
+        Mutex::Autolock autoLock(mParallelLock);
+        if (mFetchers.isEmpty()) {
+            return;
+        }
+
+        fetchers = mFetchers;
+        mFetchers.clear();
+
+        mStopFetchers = true;
+        mParallelCondition.broadcast();
+    }
+
+    for (size_t i = 0; i < fetchers.size(); ++i) {
+        fetchers[i]->requestExit();
+
+        // Aborts a transfer that is in progress.
+        fetchers[i]->mConnection->disconnect();
+    }
+
+    for (size_t i = 0; i < fetchers.size(); ++i) {
+        fetchers[i]->requestExitAndWait();
+    }
+
+    Mutex::Autolock autoLock(mParallelLock);
+    mChunks.clear();
+    mParallelCondition.broadcast();
+}
+
+void MediaHTTP::fillWindow_l(int64_t index, off64_t contentSize) {
+    int64_t windowEnd = index + 2 * mNumParallelConnections;
+
+    // Reads are sequential in practice (NuCachedSource2 keeps its own
+    // cache), chunks before the read position are not needed again.
+    size_t i = 0;
+    while (i < mChunks.size()) {
+        int64_t key = mChunks.keyAt(i);
+        if (key < index
+                || (key >= windowEnd
+                    && mChunks.valueAt(i).mState != CHUNK_FETCHING)) {
+            mChunks.removeItemsAt(i);
+        } else {
+            ++i;
+        }
+    }
+
+    int64_t numChunks =
+        (contentSize + kParallelChunkSize - 1) / kParallelChunkSize;
+
+    bool added = false;
+    for (int64_t key = index; key < windowEnd && key < numChunks; ++key) {
+        if (mChunks.indexOfKey(key) < 0) {
+            Chunk chunk;
+            chunk.mState = CHUNK_PENDING;
+            mChunks.add(key, chunk);
+            added = true;
+        }
+    }
+
+    if (added) {
+        mParallelCondition.broadcast();
+    }
+}
+
+bool MediaHTTP::fetchChunk(Fetcher *fetcher) {
+    int64_t index;
+    off64_t offset;
+    size_t size;
+    AString uri;
+    KeyedVector<String8, String8> headers;
+
+    {
+        Mutex::Autolock autoLock(mParallelLock);
+
+        ssize_t i = -1;
+        for (;;) {
+            if (mStopFetchers) {
+                return false;
+            }
+
+            // Lowest index first, that's the one the reader waits for.
+            for (size_t j = 0; j < mChunks.size(); ++j) {
+                if (mChunks.valueAt(j).mState == CHUNK_PENDING) {
+                    i = j;
+                    break;
+                }
+            }
+
+            if (i >= 0) {
+                break;
+            }
+
+            mParallelCondition.wait(mParallelLock);
+        }
+
+        mChunks.editValueAt(i).mState = CHUNK_FETCHING;
+
+        index = mChunks.keyAt(i);
+        offset = index * kParallelChunkSize;
+        size = kParallelChunkSize;
+        if (offset + (off64_t)size > mCachedSize) {
+            size = mCachedSize - offset;
+        }
+
+        if (!fetcher->mConnected) {
+            uri = mLastURI;
+            headers = mLastHeaders;
+        }
+    }
+
+    if (!fetcher->mConnected) {
+        fetcher->mConnected =
+            fetcher->mConnection->connect(uri.c_str(), &headers);
+    }
+
+    int64_t startTimeUs = ALooper::GetNowUs();
+
+    sp<ABuffer> data = new ABuffer(size);
+    size_t numBytesRead = 0;
+    status_t err = fetcher->mConnected ? OK : UNKNOWN_ERROR;
+    while (err == OK && numBytesRead < size) {
+        size_t copy = size - numBytesRead;
+        if (copy > kMaxTransferSize) {
+            copy = kMaxTransferSize;
+        }
+
+        ssize_t n = fetcher->mConnection->readAt(
+                offset + numBytesRead, data->data() + numBytesRead, copy);
+
+        if (n < 0) {
+            err = n;
+        } else if (n == 0) {
+            break;
+        } else {
+            numBytesRead += n;
+        }
+    }
+    data->setRange(0, numBytesRead);
+
+    int64_t nowUs = ALooper::GetNowUs();
+    int64_t delayUs = 0ll;
+
+    {
+        Mutex::Autolock autoLock(mParallelLock);
+
+        ssize_t i = mChunks.indexOfKey(index);
+        if (i >= 0 && mChunks.valueAt(i).mState == CHUNK_FETCHING) {
+            Chunk *chunk = &mChunks.editValueAt(i);
+            chunk->mState = (err == OK) ? CHUNK_DONE : CHUNK_FAILED;
+            chunk->mData = data;
+        }
+
+        // Transfers overlap, so only count the time since the previous one
+        // completed: the sum of the delays is then the time the pipe was
+        // busy and the estimate reflects the aggregate throughput.
+        if (err == OK) {
+            int64_t sinceUs = startTimeUs;
+            if (mLastFetchCompletedUs > sinceUs) {
+                sinceUs = mLastFetchCompletedUs;
+            }
+            delayUs = nowUs - sinceUs;
+            mLastFetchCompletedUs = nowUs;
+        } else {
+            ALOGW("fetching chunk %lld failed (%d)", (long long)index, err);
+
+            // Reconnect for the next chunk.
+            fetcher->mConnected = false;
+        }
+
+        mParallelCondition.broadcast();
+    }
+
+    if (err == OK && numBytesRead > 0) {
+        addBandwidthMeasurement(numBytesRead, delayUs);
+    }
+
+    return true;
+}
+
 status_t MediaHTTP::getSize(off64_t *size) {
     if (mInitCheck != OK) {
         return mInitCheck;
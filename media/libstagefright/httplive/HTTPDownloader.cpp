@@ -218,7 +218,8 @@ ssize_t HTTPDownloader::fetchFile(
 }
 
 sp<M3UParser> HTTPDownloader::fetchPlaylist(
-        const char *url, uint8_t *curPlaylistHash, bool *unchanged) {
+        const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+        const sp<M3UParser> &previousPlaylist) {
     ALOGV("fetchPlaylist '%s'", url);
 
     *unchanged = false;
@@ -258,8 +259,8 @@ sp<M3UParser> HTTPDownloader::fetchPlaylist(
     }
 #endif
 
-    sp<M3UParser> playlist =
-        new M3UParser(actualUrl.string(), buffer->data(), buffer->size());
+    sp<M3UParser> playlist = new M3UParser(
+            actualUrl.string(), buffer->data(), buffer->size(), previousPlaylist);
 
     if (playlist->initCheck() != OK) {
         ALOGE("failed to parse .m3u8 playlist");
@@ -223,6 +223,75 @@ bool LiveSession::BandwidthEstimator::estimateBandwidth(
     return true;
 }
 
+// Default variant selection, mixing throughput and buffer level. The share of
+// the estimated throughput a variant may use grows from 70% with an almost
+// empty buffer to 90% once the buffer is above the up switch mark, and the
+// buffer trend is used to switch down before the buffer actually runs low.
+struct LiveSession::HybridAdaptationPolicy : public LiveSession::AdaptationPolicy {
+    HybridAdaptationPolicy() {}
+
+    virtual ssize_t pickVariant(
+            const AdaptationState &state, const Vector<VariantInfo> &variants);
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(HybridAdaptationPolicy);
+};
+
+ssize_t LiveSession::HybridAdaptationPolicy::pickVariant(
+        const AdaptationState &state, const Vector<VariantInfo> &variants) {
+    static const double kMinThroughputShare = 0.7;
+    static const double kMaxThroughputShare = 0.9;
+
+    int32_t bandwidthBps = state.mBandwidthBps;
+    // the long term average lags behind a sudden drop
+    if (!state.mIsStable && state.mShortTermBps < bandwidthBps) {
+        bandwidthBps = state.mShortTermBps;
+    }
+
+    double share = kMinThroughputShare;
+    if (state.mBufferedDurationUs >= state.mUpSwitchMarkUs) {
+        share = kMaxThroughputShare;
+    } else if (state.mBufferedDurationUs > kUnderflowMarkUs
+            && state.mUpSwitchMarkUs > kUnderflowMarkUs) {
+        share += (kMaxThroughputShare - kMinThroughputShare)
+                * (state.mBufferedDurationUs - kUnderflowMarkUs)
+                / (state.mUpSwitchMarkUs - kUnderflowMarkUs);
+    }
+
+    ssize_t index = -1;
+    for (ssize_t i = variants.size() - 1; i >= 0; --i) {
+        if (!variants[i].mValid) {
+            continue;
+        }
+        index = i;  // ends up at the lowest valid variant if none fits
+        if (variants[i].mBandwidthBps <= bandwidthBps * share) {
+            break;
+        }
+    }
+    if (index < 0) {
+        // all blacklisted, stay and hope it recovers
+        return state.mCurIndex;
+    }
+
+    if (index > state.mCurIndex) {
+        return state.mBufferHigh ? index : state.mCurIndex;
+    }
+
+    if (index < state.mCurIndex) {
+        // The switch itself takes about two segments, so go down early if the
+        // buffer is going to reach the down switch mark by then.
+        int64_t leadUs = state.mTargetDurationUs > 0
+                ? 2 * state.mTargetDurationUs : state.mDownSwitchMarkUs;
+        int64_t predictedUs = state.mBufferedDurationUs
+                + state.mBufferTrendUs * leadUs / 1000000ll;
+        bool draining = state.mBufferTrendUs < 0
+                && predictedUs < state.mDownSwitchMarkUs;
+        return (state.mBufferLow || draining) ? index : state.mCurIndex;
+    }
+
+    return state.mCurIndex;
+}
+
 //static
 const char *LiveSession::getKeyForStream(StreamType type) {
     switch (type) {
@@ -288,6 +357,12 @@ LiveSession::LiveSession(
       mLastBandwidthBps(-1ll),
       mLastBandwidthStable(false),
       mBandwidthEstimator(new BandwidthEstimator()),
+      mAdaptationPolicy(new HybridAdaptationPolicy()),
+      mMinBufferedDurationUs(-1ll),
+      mLastBufferPollUs(-1ll),
+      mLastBufferedDurationUs(-1ll),
+      mBufferTrendUs(0ll),
+      mTargetDurationUs(-1ll),
       mMaxWidth(720),
       mMaxHeight(480),
       mStreamMask(0),
@@ -492,9 +567,27 @@ status_t LiveSession::getStreamFormat(StreamType stream, sp<AMessage> *format) {
 }
 
 sp<HTTPDownloader> LiveSession::getHTTPDownloader() {
+    {
+        Mutex::Autolock autoLock(mHTTPDownloaderLock);
+        if (!mIdleHTTPDownloaders.isEmpty()) {
+            sp<HTTPDownloader> downloader = mIdleHTTPDownloaders.top();
+            mIdleHTTPDownloaders.pop();
+            downloader->reconnect();
+            return downloader;
+        }
+    }
     return new HTTPDownloader(mHTTPService, mExtraHeaders);
 }
 
+void LiveSession::releaseHTTPDownloader(const sp<HTTPDownloader> &downloader) {
+    static const size_t kMaxIdleHTTPDownloaders = 4;
+
+    Mutex::Autolock autoLock(mHTTPDownloaderLock);
+    if (downloader != NULL && mIdleHTTPDownloaders.size() < kMaxIdleHTTPDownloaders) {
+        mIdleHTTPDownloaders.push(downloader);
+    }
+}
+
 void LiveSession::connectAsync(
         const char *url, const KeyedVector<String8, String8> *headers) {
     sp<AMessage> msg = new AMessage(kWhatConnect, this);
@@ -719,6 +812,7 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
                 {
                     int64_t targetDurationUs;
                     CHECK(msg->findInt64("targetDurationUs", &targetDurationUs));
+                    mTargetDurationUs = targetDurationUs;
                     mUpSwitchMark = min(kUpSwitchMarkUs, targetDurationUs * 7 / 4);
                     mDownSwitchMark = min(kDownSwitchMarkUs, targetDurationUs * 9 / 4);
                     mUpSwitchMargin = min(kUpSwitchMarginUs, targetDurationUs);
@@ -884,6 +978,36 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
                     break;
                 }
 
+                case PlaylistFetcher::kWhatSegmentDownloaded:
+                {
+                    AString uri;
+                    CHECK(msg->findString("uri", &uri));
+                    size_t bytes;
+                    CHECK(msg->findSize("bytes", &bytes));
+                    int64_t durationUs;
+                    CHECK(msg->findInt64("durationUs", &durationUs));
+                    if (durationUs <= 0 || mPlaylist == NULL) {
+                        break;
+                    }
+
+                    // only variant fetchers count, not alternate renditions
+                    for (size_t i = 0; i < mBandwidthItems.size(); ++i) {
+                        BandwidthItem *item = &mBandwidthItems.editItemAt(i);
+                        AString variantUri;
+                        if (!mPlaylist->itemAt(item->mPlaylistIndex, &variantUri)
+                                || variantUri != uri) {
+                            continue;
+                        }
+                        double bps = bytes * 8E6 / durationUs;
+                        item->mMeasuredBps = item->mMeasuredBps > 0
+                                ? 0.7 * item->mMeasuredBps + 0.3 * bps : bps;
+                        ALOGV("variant %zu: segment at %.0f bps, average %.0f, declared %lu",
+                                i, bps, item->mMeasuredBps, item->mBandwidth);
+                        break;
+                    }
+                    break;
+                }
+
                 case PlaylistFetcher::kWhatMetadataDetected:
                 {
                     if (!mHasMetadata) {
@@ -1044,6 +1168,7 @@ void LiveSession::onMasterPlaylistFetched(const sp<AMessage> &msg) {
 
             item.mPlaylistIndex = i;
             item.mLastFailureUs = -1ll;
+            item.mMeasuredBps = 0;
 
             sp<AMessage> meta;
             AString uri;
@@ -1090,6 +1215,7 @@ void LiveSession::onMasterPlaylistFetched(const sp<AMessage> &msg) {
         BandwidthItem item;
         item.mPlaylistIndex = 0;
         item.mBandwidth = 0;
+        item.mMeasuredBps = 0;
         mBandwidthItems.push(item);
     }
 
@@ -2052,6 +2178,8 @@ void LiveSession::cancelPollBuffering() {
 }
 
 void LiveSession::restartPollBuffering() {
+    // the buffers may have been swapped, start the trend over
+    mLastBufferedDurationUs = -1ll;
     cancelPollBuffering();
     onPollBuffering();
 }
@@ -2149,6 +2277,7 @@ bool LiveSession::checkBuffering(
     size_t activeCount, underflowCount, readyCount, downCount, upCount;
     activeCount = underflowCount = readyCount = downCount = upCount =0;
     int32_t minBufferPercent = -1;
+    int64_t minBufferedDurationUs = -1ll;
     int64_t durationUs;
     if (getDuration(&durationUs) != OK) {
         durationUs = -1;
@@ -2185,6 +2314,12 @@ bool LiveSession::checkBuffering(
             }
         }
 
+        if (!mPacketSources[i]->isFinished(0)
+                && (minBufferedDurationUs < 0
+                        || bufferedDurationUs < minBufferedDurationUs)) {
+            minBufferedDurationUs = bufferedDurationUs;
+        }
+
         ++activeCount;
         int64_t readyMark = mInPreparationPhase ? kPrepareMarkUs : kReadyMarkUs;
         if (bufferedDurationUs > readyMark
@@ -2208,6 +2343,8 @@ bool LiveSession::checkBuffering(
         notifyBufferingUpdate(minBufferPercent);
     }
 
+    updateBufferTrend(minBufferedDurationUs);
+
     if (activeCount > 0) {
         up        = (upCount == activeCount);
         down      = (downCount > 0);
@@ -2317,6 +2454,53 @@ bool LiveSession::switchBandwidthIfNeeded(bool bufferHigh, bool bufferLow) {
         return false;
     }
 
+    char value[PROPERTY_VALUE_MAX];
+    if (mAdaptationPolicy != NULL
+            && !property_get("media.httplive.bw-index", value, NULL)) {
+        AdaptationState state;
+        state.mCurIndex = mCurBandwidthIndex;
+        state.mBandwidthBps = bandwidthBps;
+        state.mShortTermBps = shortTermBps;
+        state.mIsStable = isStable;
+        state.mBufferedDurationUs = mMinBufferedDurationUs;
+        state.mBufferTrendUs = mBufferTrendUs;
+        state.mTargetDurationUs = mTargetDurationUs;
+        state.mUpSwitchMarkUs = mUpSwitchMark;
+        state.mDownSwitchMarkUs = mDownSwitchMark;
+        state.mBufferHigh = bufferHigh;
+        state.mBufferLow = bufferLow;
+
+        if (property_get("media.httplive.max-bw", value, NULL)) {
+            long maxBw = strtol(value, NULL, 10);
+            if (maxBw > 0 && state.mBandwidthBps > maxBw) {
+                state.mBandwidthBps = maxBw;
+            }
+            if (maxBw > 0 && state.mShortTermBps > maxBw) {
+                state.mShortTermBps = maxBw;
+            }
+        }
+
+        Vector<VariantInfo> variants;
+        for (size_t i = 0; i < mBandwidthItems.size(); ++i) {
+            const BandwidthItem &item = mBandwidthItems.itemAt(i);
+            VariantInfo info;
+            info.mBandwidthBps = item.mMeasuredBps > 0
+                    ? (int32_t)item.mMeasuredBps : (int32_t)item.mBandwidth;
+            info.mValid = isBandwidthValid(item);
+            variants.push(info);
+        }
+
+        ssize_t bandwidthIndex = mAdaptationPolicy->pickVariant(state, variants);
+        if (bandwidthIndex >= 0 && bandwidthIndex != mCurBandwidthIndex
+                && (size_t)bandwidthIndex < mBandwidthItems.size()) {
+            // if not yet prepared, just restart again with new bw index.
+            changeConfiguration(
+                    mInPreparationPhase ? 0 : -1ll, bandwidthIndex);
+            return true;
+        }
+        return false;
+    }
+
     int32_t curBandwidth = mBandwidthItems.itemAt(mCurBandwidthIndex).mBandwidth;
     // canSwithDown and canSwitchUp can't both be true.
     // we only want to switch up when measured bw is 120% higher than current variant,
@@ -2355,6 +2539,22 @@ bool LiveSession::switchBandwidthIfNeeded(bool bufferHigh, bool bufferLow) {
     return false;
 }
 
+void LiveSession::updateBufferTrend(int64_t bufferedDurationUs) {
+    int64_t nowUs = ALooper::GetNowUs();
+    if (bufferedDurationUs >= 0 && mLastBufferedDurationUs >= 0
+            && mLastBufferPollUs >= 0 && nowUs > mLastBufferPollUs) {
+        int64_t trendUs = (bufferedDurationUs - mLastBufferedDurationUs)
+                * 1000000ll / (nowUs - mLastBufferPollUs);
+        // smooth out the steps of whole segments arriving
+        mBufferTrendUs = (mBufferTrendUs * 3 + trendUs) / 4;
+    } else {
+        mBufferTrendUs = 0;
+    }
+    mMinBufferedDurationUs = bufferedDurationUs;
+    mLastBufferedDurationUs = bufferedDurationUs;
+    mLastBufferPollUs = nowUs;
+}
+
 void LiveSession::postError(status_t err) {
     // if we reached EOS, notify buffering of 100%
     if (err == ERROR_END_OF_STREAM) {
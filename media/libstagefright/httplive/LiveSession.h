@@ -21,7 +21,9 @@
 #include <media/stagefright/foundation/AHandler.h>
 #include <media/mediaplayer.h>
 
+#include <utils/Mutex.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 #include "mpeg2ts/ATSParser.h"
 
@@ -77,7 +79,10 @@ struct LiveSession : public AHandler {
 
     status_t getStreamFormat(StreamType stream, sp<AMessage> *format);
 
+    // Downloaders are pooled across fetchers and segment prefetches, so that
+    // switching variants or tracks reuses existing HTTP connections.
     sp<HTTPDownloader> getHTTPDownloader();
+    void releaseHTTPDownloader(const sp<HTTPDownloader> &downloader);
 
     void connectAsync(
             const char *url,
@@ -154,8 +159,36 @@ protected:
         size_t mPlaylistIndex;
         unsigned long mBandwidth;
         int64_t mLastFailureUs;
+        // average bitrate of the segments downloaded from this variant, 0 if none
+        double mMeasuredBps;
     };
 
+    // Variant selection, consulted on every buffer poll. Variants are in the
+    // order of mBandwidthItems, i.e. sorted by declared bandwidth.
+    struct VariantInfo {
+        int32_t mBandwidthBps;  // measured bitrate if known, otherwise the declared one
+        bool mValid;            // not blacklisted
+    };
+    struct AdaptationState {
+        ssize_t mCurIndex;
+        int32_t mBandwidthBps;          // long term throughput estimate
+        int32_t mShortTermBps;
+        bool mIsStable;
+        int64_t mBufferedDurationUs;    // least buffered of audio and video
+        int64_t mBufferTrendUs;         // buffer gained (lost if < 0) per second
+        int64_t mTargetDurationUs;
+        int64_t mUpSwitchMarkUs;
+        int64_t mDownSwitchMarkUs;
+        bool mBufferHigh;               // every stream is above the up switch mark
+        bool mBufferLow;                // some stream is below the down switch mark
+    };
+    struct AdaptationPolicy : public RefBase {
+        // returns the index of the variant to play, state.mCurIndex to stay
+        virtual ssize_t pickVariant(
+                const AdaptationState &state, const Vector<VariantInfo> &variants) = 0;
+    };
+    struct HybridAdaptationPolicy;
+
     struct FetcherInfo {
         sp<PlaylistFetcher> mFetcher;
         int64_t mDurationUs;
@@ -194,6 +227,9 @@ protected:
     uint32_t mFlags;
     sp<IMediaHTTPService> mHTTPService;
 
+    Mutex mHTTPDownloaderLock;
+    Vector<sp<HTTPDownloader> > mIdleHTTPDownloaders;
+
     bool mBuffering;
     bool mInPreparationPhase;
     int32_t mPollBufferingGeneration;
@@ -209,6 +245,14 @@ protected:
     int32_t mLastBandwidthBps;
     bool mLastBandwidthStable;
     sp<BandwidthBaseEstimator> mBandwidthEstimator;
+    sp<AdaptationPolicy> mAdaptationPolicy;
+
+    // buffer level seen by the last checkBuffering(), and how fast it changes
+    int64_t mMinBufferedDurationUs;
+    int64_t mLastBufferPollUs;
+    int64_t mLastBufferedDurationUs;
+    int64_t mBufferTrendUs;
+    int64_t mTargetDurationUs;
 
     sp<M3UParser> mPlaylist;
     int32_t mMaxWidth;
@@ -305,6 +349,7 @@ protected:
     void restartPollBuffering();
     virtual void onPollBuffering();
     bool checkBuffering(bool &underflow, bool &ready, bool &down, bool &up);
+    void updateBufferTrend(int64_t bufferedDurationUs);
     void startBufferingIfNecessary();
     void stopBufferingIfNecessary();
     void notifyBufferingUpdate(int32_t percentage);
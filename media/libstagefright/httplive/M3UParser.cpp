@@ -243,7 +243,8 @@ bool M3UParser::MediaGroup::getActiveURI(AString *uri) const {
 ////////////////////////////////////////////////////////////////////////////////
 
 M3UParser::M3UParser(
-        const char *baseURI, const void *data, size_t size)
+        const char *baseURI, const void *data, size_t size,
+        const sp<M3UParser> &previous)
     : mInitCheck(NO_INIT),
       mBaseURI(baseURI),
       mIsExtM3U(false),
@@ -256,7 +257,27 @@ M3UParser::M3UParser(
       mDiscontinuitySeq(0),
       mDiscontinuityCount(0),
       mSelectedIndex(-1) {
-    mInitCheck = parse(data, size);
+    const M3UParser *prev = previous.get();
+    if (prev != NULL && (prev->mInitCheck != OK || prev->mIsVariantPlaylist
+            || prev->mItems.isEmpty() || prev->mBaseURI != mBaseURI)) {
+        prev = NULL;
+    }
+
+    mInitCheck = parse(data, size, prev);
+
+    if (mInitCheck == -EAGAIN) {
+        // the segments don't line up with the previous playlist, start over
+        ALOGV("playlist %s changed, parsing it again", mBaseURI.c_str());
+        mIsExtM3U = mIsVariantPlaylist = mIsComplete = mIsEvent = false;
+        mFirstSeqNumber = mLastSeqNumber = -1;
+        mTargetDurationUs = -1ll;
+        mDiscontinuitySeq = 0;
+        mDiscontinuityCount = 0;
+        mMeta.clear();
+        mItems.clear();
+        mMediaGroups.clear();
+        mInitCheck = parse(data, size, NULL);
+    }
 }
 
 M3UParser::~M3UParser() {
@@ -307,6 +328,36 @@ size_t M3UParser::size() {
     return mItems.size();
 }
 
+int64_t M3UParser::getItemDurationUs(size_t index) const {
+    CHECK_LT(index, mItems.size());
+    return mItems.itemAt(index).mDurationUs;
+}
+
+int64_t M3UParser::getItemStartTimeUs(size_t index) const {
+    CHECK_LT(index, mItems.size());
+    return mItems.itemAt(index).mStartTimeUs;
+}
+
+int64_t M3UParser::getTotalDurationUs() const {
+    if (mItems.isEmpty()) {
+        return 0;
+    }
+    const Item &item = mItems.itemAt(mItems.size() - 1);
+    return item.mStartTimeUs + item.mDurationUs;
+}
+
+void M3UParser::appendItem(
+        const AString &uri, const sp<AMessage> &meta, int64_t durationUs) {
+    int64_t startTimeUs = getTotalDurationUs();
+
+    mItems.push();
+    Item *item = &mItems.editItemAt(mItems.size() - 1);
+    item->mURI = uri;
+    item->mMeta = meta;
+    item->mDurationUs = durationUs;
+    item->mStartTimeUs = startTimeUs;
+}
+
 bool M3UParser::itemAt(size_t index, AString *uri, sp<AMessage> *meta) {
     if (uri) {
         uri->clear();
@@ -544,18 +595,84 @@ static bool MakeURL(const char *baseURL, const char *url, AString *out) {
     return true;
 }
 
-status_t M3UParser::parse(const void *_data, size_t size) {
+static bool LineStartsWith(const char *line, size_t length, const char *prefix) {
+    size_t prefixLength = strlen(prefix);
+    return length >= prefixLength && !memcmp(line, prefix, prefixLength);
+}
+
+status_t M3UParser::parse(const void *_data, size_t size, const M3UParser *previous) {
     int32_t lineNo = 0;
 
     sp<AMessage> itemMeta;
 
+    // Once past the playlist header, segments that are also in "previous" are
+    // taken over from it: their lines are only scanned for the few tags that
+    // affect the playlist as a whole.
+    bool pastHeader = false;
+    bool checkedReuse = false;
+
     const char *data = (const char *)_data;
     size_t offset = 0;
     uint64_t segmentRangeOffset = 0;
     while (offset < size) {
-        size_t offsetLF = offset;
-        while (offsetLF < size && data[offsetLF] != '\n') {
-            ++offsetLF;
+        const char *lineStart = &data[offset];
+        const char *lineEnd = (const char *)memchr(lineStart, '\n', size - offset);
+        size_t offsetLF = lineEnd != NULL ? lineEnd - data : size;
+
+        int32_t seqNumber = -1;
+        if (previous != NULL && pastHeader && !mIsVariantPlaylist) {
+            int32_t firstSeqNumber = 0;
+            if (mMeta != NULL) {
+                mMeta->findInt32("media-sequence", &firstSeqNumber);
+            }
+            seqNumber = firstSeqNumber + mItems.size();
+        }
+
+        if (previous != NULL && seqNumber >= previous->mFirstSeqNumber
+                && seqNumber <= previous->mLastSeqNumber) {
+            size_t length = offsetLF - offset;
+            if (length > 0 && lineStart[length - 1] == '\r') {
+                --length;
+            }
+
+            if (length == 0) {
+                // skip empty line
+            } else if (lineStart[0] != '#') {
+                const Item &prevItem =
+                        previous->mItems.itemAt(seqNumber - previous->mFirstSeqNumber);
+                if (!checkedReuse) {
+                    // Sequence numbers must not be reused for other segments;
+                    // check that once, rather than trusting every server.
+                    AString uri;
+                    AString line(lineStart, length);
+                    if (!MakeURL(mBaseURI.c_str(), line.c_str(), &uri)
+                            || uri != prevItem.mURI) {
+                        return -EAGAIN;
+                    }
+                    checkedReuse = true;
+                }
+                appendItem(prevItem.mURI, prevItem.mMeta, prevItem.mDurationUs);
+
+                int64_t rangeOffset, rangeLength;
+                if (prevItem.mMeta != NULL
+                        && prevItem.mMeta->findInt64("range-offset", &rangeOffset)
+                        && prevItem.mMeta->findInt64("range-length", &rangeLength)) {
+                    segmentRangeOffset = rangeOffset + rangeLength;
+                }
+                itemMeta.clear();
+                ++lineNo;
+            } else {
+                if (LineStartsWith(lineStart, length, "#EXT-X-DISCONTINUITY")
+                        && !LineStartsWith(lineStart, length, "#EXT-X-DISCONTINUITY-")) {
+                    ++mDiscontinuityCount;
+                } else if (LineStartsWith(lineStart, length, "#EXT-X-ENDLIST")) {
+                    mIsComplete = true;
+                }
+                ++lineNo;
+            }
+
+            offset = offsetLF + 1;
+            continue;
         }
 
         AString line;
@@ -603,6 +720,7 @@ status_t M3UParser::parse(const void *_data, size_t size) {
                     return ERROR_MALFORMED;
                 }
                 err = parseMetaDataDuration(line, &itemMeta, "durationUs");
+                pastHeader = true;
             } else if (line.startsWith("#EXT-X-DISCONTINUITY")) {
                 if (mIsVariantPlaylist) {
                     return ERROR_MALFORMED;
@@ -655,8 +773,8 @@ status_t M3UParser::parse(const void *_data, size_t size) {
         }
 
         if (!line.startsWith("#")) {
+            int64_t durationUs = 0;
             if (!mIsVariantPlaylist) {
-                int64_t durationUs;
                 if (itemMeta == NULL
                         || !itemMeta->findInt64("durationUs", &durationUs)) {
                     return ERROR_MALFORMED;
@@ -665,14 +783,12 @@ status_t M3UParser::parse(const void *_data, size_t size) {
                         mDiscontinuitySeq + mDiscontinuityCount);
             }
 
-            mItems.push();
-            Item *item = &mItems.editItemAt(mItems.size() - 1);
-
-            CHECK(MakeURL(mBaseURI.c_str(), line.c_str(), &item->mURI));
-
-            item->mMeta = itemMeta;
+            AString uri;
+            CHECK(MakeURL(mBaseURI.c_str(), line.c_str(), &uri));
+            appendItem(uri, itemMeta, durationUs);
 
             itemMeta.clear();
+            pastHeader = true;
         }
 
         offset = offsetLF + 1;
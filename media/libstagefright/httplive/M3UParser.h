@@ -27,7 +27,11 @@
 namespace android {
 
 struct M3UParser : public RefBase {
-    M3UParser(const char *baseURI, const void *data, size_t size);
+    // If given the previous version of the same media playlist, segments it
+    // already has are taken over instead of being parsed again, so that refreshing
+    // a live playlist only costs parsing the segments added since.
+    M3UParser(const char *baseURI, const void *data, size_t size,
+            const sp<M3UParser> &previous = NULL);
 
     status_t initCheck() const;
 
@@ -45,6 +49,12 @@ struct M3UParser : public RefBase {
     size_t size();
     bool itemAt(size_t index, AString *uri, sp<AMessage> *meta = NULL);
 
+    // Duration of an item, and its start time relative to the first item,
+    // without looking up its meta data. Only valid for media playlists.
+    int64_t getItemDurationUs(size_t index) const;
+    int64_t getItemStartTimeUs(size_t index) const;
+    int64_t getTotalDurationUs() const;
+
     void pickRandomMediaItems();
     status_t selectTrack(size_t index, bool select);
     size_t getTrackCount() const;
@@ -64,6 +74,8 @@ private:
     struct Item {
         AString mURI;
         sp<AMessage> mMeta;
+        int64_t mDurationUs;
+        int64_t mStartTimeUs;
     };
 
     status_t mInitCheck;
@@ -86,7 +98,8 @@ private:
     // Media groups keyed by group ID.
     KeyedVector<AString, sp<MediaGroup> > mMediaGroups;
 
-    status_t parse(const void *data, size_t size);
+    status_t parse(const void *data, size_t size, const M3UParser *previous);
+    void appendItem(const AString &uri, const sp<AMessage> &meta, int64_t durationUs);
 
     static status_t parseMetaData(
             const AString &line, sp<AMessage> *meta, const char *key);
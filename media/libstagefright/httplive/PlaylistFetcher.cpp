@@ -34,6 +34,9 @@
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
 
+#include <cutils/properties.h>
+#include <utils/Thread.h>
+
 #include <ctype.h>
 #include <inttypes.h>
 #include <openssl/aes.h>
@@ -136,6 +139,167 @@ void PlaylistFetcher::DownloadState::saveState(
     mLastSeqNumberInPlaylist = lastSeqNumberInPlaylist;
 }
 
+// Downloads one segment ahead of the fetcher, on a connection of its own. The
+// fetcher takes the data over block by block through fetchBlock(), whether the
+// download has completed or is still running, so access units of a prefetched
+// segment reach the packet sources as soon as they arrive.
+struct PlaylistFetcher::SegmentPrefetch : public Thread {
+    SegmentPrefetch(
+            const sp<LiveSession> &session,
+            int32_t seqNumber,
+            const AString &uri,
+            int64_t rangeOffset,
+            int64_t rangeLength,
+            bool measureBandwidth);
+
+    int32_t seqNumber() const {
+        return mSeqNumber;
+    }
+
+    bool matches(int32_t seqNumber, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength) const {
+        return seqNumber == mSeqNumber && uri == mUri
+                && rangeOffset == mRangeOffset && rangeLength == mRangeLength;
+    }
+
+    // Same contract as HTTPDownloader::fetchBlock() for a sequential download:
+    // appends up to blockSize bytes to *out, waiting for them if necessary, and
+    // returns the number of bytes appended, 0 at the end of the segment or an
+    // error. Gives up with ERROR_NOT_CONNECTED if owner is disconnected.
+    ssize_t fetchBlock(
+            sp<ABuffer> *out, size_t blockSize, const sp<HTTPDownloader> &owner);
+
+    // Aborts the download and waits for the thread.
+    void cancel();
+
+protected:
+    virtual ~SegmentPrefetch();
+
+private:
+    sp<LiveSession> mSession;
+    sp<HTTPDownloader> mDownloader;
+    const int32_t mSeqNumber;
+    const AString mUri;
+    const int64_t mRangeOffset;
+    const int64_t mRangeLength;
+    const bool mMeasureBandwidth;
+
+    Mutex mLock;
+    Condition mCondition;
+    sp<ABuffer> mBuffer;    // downloaded so far, mAvailable bytes of it are valid
+    size_t mAvailable;
+    bool mDone;
+    status_t mFinalStatus;
+
+    virtual bool threadLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SegmentPrefetch);
+};
+
+PlaylistFetcher::SegmentPrefetch::SegmentPrefetch(
+        const sp<LiveSession> &session,
+        int32_t seqNumber,
+        const AString &uri,
+        int64_t rangeOffset,
+        int64_t rangeLength,
+        bool measureBandwidth)
+    : Thread(false /* canCallJava */),
+      mSession(session),
+      mDownloader(session->getHTTPDownloader()),
+      mSeqNumber(seqNumber),
+      mUri(uri),
+      mRangeOffset(rangeOffset),
+      mRangeLength(rangeLength),
+      mMeasureBandwidth(measureBandwidth),
+      mAvailable(0),
+      mDone(false),
+      mFinalStatus(OK) {
+}
+
+PlaylistFetcher::SegmentPrefetch::~SegmentPrefetch() {
+    mSession->releaseHTTPDownloader(mDownloader);
+}
+
+bool PlaylistFetcher::SegmentPrefetch::threadLoop() {
+    sp<ABuffer> buffer;
+    bool connectHTTP = true;
+    ssize_t bytesRead;
+    do {
+        int64_t startUs = ALooper::GetNowUs();
+        bytesRead = mDownloader->fetchBlock(
+                mUri.c_str(), &buffer, mRangeOffset, mRangeLength, kDownloadBlockSize,
+                NULL /* actualURL */, connectHTTP);
+        int64_t delayUs = ALooper::GetNowUs() - startUs;
+        connectHTTP = false;
+
+        if (bytesRead > 0 && mMeasureBandwidth) {
+            mSession->addBandwidthMeasurement(bytesRead, delayUs);
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        if (bytesRead < 0) {
+            mFinalStatus = bytesRead;
+        } else if (bytesRead > 0) {
+            // fetchBlock() only writes past the bytes already published, or
+            // into a new buffer, so the reader can copy out of mBuffer safely.
+            mBuffer = buffer;
+            mAvailable = buffer->size();
+        }
+        mDone = bytesRead <= 0;
+        mCondition.signal();
+    } while (bytesRead > 0);
+
+    return false;
+}
+
+ssize_t PlaylistFetcher::SegmentPrefetch::fetchBlock(
+        sp<ABuffer> *out, size_t blockSize, const sp<HTTPDownloader> &owner) {
+    static const int64_t kPollIntervalNs = 100000000ll;
+
+    Mutex::Autolock autoLock(mLock);
+
+    size_t consumed = *out != NULL ? (*out)->size() : 0;
+    while (!mDone && mAvailable <= consumed) {
+        if (owner->isDisconnecting()) {
+            return ERROR_NOT_CONNECTED;
+        }
+        mCondition.waitRelative(mLock, kPollIntervalNs);
+    }
+
+    if (mAvailable <= consumed) {
+        return mFinalStatus;
+    }
+
+    size_t n = mAvailable - consumed;
+    if (n > blockSize) {
+        n = blockSize;
+    }
+
+    sp<ABuffer> buffer = *out;
+    if (buffer == NULL || buffer->capacity() < consumed + n) {
+        // size the copy like the download buffer, so it is rarely reallocated
+        size_t capacity = mBuffer->capacity();
+        if (capacity < consumed + n) {
+            capacity = consumed + n;
+        }
+        buffer = new ABuffer(capacity);
+        if (*out != NULL) {
+            // the meta data is set again by decryptBuffer()
+            memcpy(buffer->data(), (*out)->data(), consumed);
+        }
+    }
+    memcpy(buffer->data() + consumed, mBuffer->data() + consumed, n);
+    buffer->setRange(0, consumed + n);
+
+    *out = buffer;
+    return n;
+}
+
+void PlaylistFetcher::SegmentPrefetch::cancel() {
+    mDownloader->disconnect();
+    requestExitAndWait();
+}
+
 PlaylistFetcher::PlaylistFetcher(
         const sp<AMessage> &notify,
         const sp<LiveSession> &session,
@@ -169,12 +333,25 @@ PlaylistFetcher::PlaylistFetcher(
       mVideoBuffer(new AnotherPacketSource(NULL)),
       mThresholdRatio(-1.0f),
       mDownloadState(new DownloadState()),
-      mHasMetadata(false) {
+      mHasMetadata(false),
+      mMaxPrefetchSegments(0) {
     memset(mPlaylistHash, 0, sizeof(mPlaylistHash));
     mHTTPDownloader = mSession->getHTTPDownloader();
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.prefetch-segments", value, "1")) {
+        mMaxPrefetchSegments = atoi(value);
+        if (mMaxPrefetchSegments < 0) {
+            mMaxPrefetchSegments = 0;
+        } else if (mMaxPrefetchSegments > 4) {
+            mMaxPrefetchSegments = 4;
+        }
+    }
 }
 
 PlaylistFetcher::~PlaylistFetcher() {
+    cancelPrefetches();
+    mSession->releaseHTTPDownloader(mHTTPDownloader);
 }
 
 int32_t PlaylistFetcher::getFetcherID() const {
@@ -191,20 +368,7 @@ int64_t PlaylistFetcher::getSegmentStartTimeUs(int32_t seqNumber) const {
     CHECK_GE(seqNumber, firstSeqNumberInPlaylist);
     CHECK_LE(seqNumber, lastSeqNumberInPlaylist);
 
-    int64_t segmentStartUs = 0ll;
-    for (int32_t index = 0;
-            index < seqNumber - firstSeqNumberInPlaylist; ++index) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        segmentStartUs += itemDurationUs;
-    }
-
-    return segmentStartUs;
+    return mPlaylist->getItemStartTimeUs(seqNumber - firstSeqNumberInPlaylist);
 }
 
 int64_t PlaylistFetcher::getSegmentDurationUs(int32_t seqNumber) const {
@@ -217,15 +381,7 @@ int64_t PlaylistFetcher::getSegmentDurationUs(int32_t seqNumber) const {
     CHECK_GE(seqNumber, firstSeqNumberInPlaylist);
     CHECK_LE(seqNumber, lastSeqNumberInPlaylist);
 
-    int32_t index = seqNumber - firstSeqNumberInPlaylist;
-    sp<AMessage> itemMeta;
-    CHECK(mPlaylist->itemAt(
-                index, NULL /* uri */, &itemMeta));
-
-    int64_t itemDurationUs;
-    CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-    return itemDurationUs;
+    return mPlaylist->getItemDurationUs(seqNumber - firstSeqNumberInPlaylist);
 }
 
 int64_t PlaylistFetcher::delayUsToRefreshPlaylist() const {
@@ -703,6 +859,7 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
         mSeqNumber = -1;
         mTimeChangeSignaled = false;
         mDownloadState->resetState();
+        cancelPrefetches();
     }
 
     postMonitorQueue();
@@ -730,12 +887,99 @@ void PlaylistFetcher::onStop(const sp<AMessage> &msg) {
     }
 
     mDownloadState->resetState();
+    cancelPrefetches();
     mPacketSources.clear();
     mStreamTypeMask = 0;
 
     resetStoppingThreshold(true /* disconnect */);
 }
 
+void PlaylistFetcher::startPrefetches() {
+    if (mMaxPrefetchSegments == 0 || mPlaylist == NULL || mStopParams != NULL) {
+        // resumeUntil stops at a point we don't know the segment of in advance
+        return;
+    }
+
+    int32_t firstSeqNumberInPlaylist, lastSeqNumberInPlaylist;
+    mPlaylist->getSeqNumberRange(&firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
+
+    // during startup or a switch more than one connection is open anyway,
+    // keep those samples out of the estimate as onDownloadNext() does
+    bool measureBandwidth = !mStartup
+            && (mStreamTypeMask
+                    & (LiveSession::STREAMTYPE_AUDIO | LiveSession::STREAMTYPE_VIDEO));
+
+    for (int32_t seqNumber = mSeqNumber;
+            seqNumber < mSeqNumber + mMaxPrefetchSegments
+                && seqNumber <= lastSeqNumberInPlaylist;
+            ++seqNumber) {
+        if (seqNumber < firstSeqNumberInPlaylist) {
+            continue;
+        }
+
+        bool pending = false;
+        for (size_t i = 0; i < mPrefetches.size(); ++i) {
+            if (mPrefetches[i]->seqNumber() == seqNumber) {
+                pending = true;
+                break;
+            }
+        }
+        if (pending) {
+            continue;
+        }
+
+        AString uri;
+        sp<AMessage> itemMeta;
+        CHECK(mPlaylist->itemAt(seqNumber - firstSeqNumberInPlaylist, &uri, &itemMeta));
+
+        int64_t rangeOffset, rangeLength;
+        if (!itemMeta->findInt64("range-offset", &rangeOffset)
+                || !itemMeta->findInt64("range-length", &rangeLength)) {
+            rangeOffset = 0;
+            rangeLength = -1;
+        }
+
+        sp<SegmentPrefetch> prefetch = new SegmentPrefetch(
+                mSession, seqNumber, uri, rangeOffset, rangeLength, measureBandwidth);
+        if (prefetch->run("HLSSegmentPrefetch") != OK) {
+            break;
+        }
+        FLOGV("prefetching segment %d", seqNumber);
+        mPrefetches.push(prefetch);
+    }
+}
+
+sp<PlaylistFetcher::SegmentPrefetch> PlaylistFetcher::takePrefetch(
+        int32_t seqNumber, const AString &uri, int64_t rangeOffset, int64_t rangeLength) {
+    sp<SegmentPrefetch> found;
+    for (size_t i = 0; i < mPrefetches.size();) {
+        sp<SegmentPrefetch> prefetch = mPrefetches[i];
+        if (prefetch->matches(seqNumber, uri, rangeOffset, rangeLength)) {
+            found = prefetch;
+            mPrefetches.removeAt(i);
+        } else if (prefetch->seqNumber() <= seqNumber) {
+            // skipped, or the playlist changed under it
+            prefetch->cancel();
+            mPrefetches.removeAt(i);
+        } else {
+            ++i;
+        }
+    }
+    return found;
+}
+
+void PlaylistFetcher::cancelPrefetches() {
+    for (size_t i = 0; i < mPrefetches.size(); ++i) {
+        mPrefetches[i]->cancel();
+    }
+    mPrefetches.clear();
+
+    if (mCurrentPrefetch != NULL) {
+        mCurrentPrefetch->cancel();
+        mCurrentPrefetch.clear();
+    }
+}
+
 // Resume until we have reached the boundary timestamps listed in `msg`; when
 // the remaining time is too short (within a resume threshold) stop immediately
 // instead.
@@ -851,7 +1095,7 @@ status_t PlaylistFetcher::refreshPlaylist() {
     if (delayUsToRefreshPlaylist() <= 0) {
         bool unchanged;
         sp<M3UParser> playlist = mHTTPDownloader->fetchPlaylist(
-                mURI.c_str(), mPlaylistHash, &unchanged);
+                mURI.c_str(), mPlaylistHash, &unchanged, mPlaylist);
 
         if (playlist == NULL) {
             if (unchanged) {
@@ -1216,7 +1460,8 @@ void PlaylistFetcher::onDownloadNext() {
     int32_t lastSeqNumberInPlaylist = 0;
     bool connectHTTP = true;
 
-    if (mDownloadState->hasSavedState()) {
+    bool resuming = mDownloadState->hasSavedState();
+    if (resuming) {
         mDownloadState->restoreState(
                 uri,
                 itemMeta,
@@ -1227,6 +1472,10 @@ void PlaylistFetcher::onDownloadNext() {
         connectHTTP = false;
         FLOGV("resuming: '%s'", uri.c_str());
     } else {
+        if (mCurrentPrefetch != NULL) {
+            mCurrentPrefetch->cancel();
+            mCurrentPrefetch.clear();
+        }
         if (!initDownloadState(
                 uri,
                 itemMeta,
@@ -1244,19 +1493,38 @@ void PlaylistFetcher::onDownloadNext() {
         range_length = -1;
     }
 
+    if (!resuming) {
+        mCurrentPrefetch = takePrefetch(mSeqNumber, uri, range_offset, range_length);
+        if (mCurrentPrefetch != NULL) {
+            FLOGV("segment %d was prefetched", mSeqNumber);
+        }
+    }
+
     // block-wise download
     bool shouldPause = false;
     ssize_t bytesRead;
     do {
         int64_t startUs = ALooper::GetNowUs();
-        bytesRead = mHTTPDownloader->fetchBlock(
-                uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize,
-                NULL /* actualURL */, connectHTTP);
+        if (mCurrentPrefetch != NULL) {
+            bytesRead = mCurrentPrefetch->fetchBlock(
+                    &buffer, kDownloadBlockSize, mHTTPDownloader);
+        } else {
+            bytesRead = mHTTPDownloader->fetchBlock(
+                    uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize,
+                    NULL /* actualURL */, connectHTTP);
+        }
         int64_t delayUs = ALooper::GetNowUs() - startUs;
 
         if (bytesRead == ERROR_NOT_CONNECTED) {
             return;
         }
+        if (bytesRead < 0 && mCurrentPrefetch != NULL && buffer == NULL) {
+            // nothing was taken from the prefetch yet, download it directly
+            FLOGV("prefetch of segment %d failed, retrying", mSeqNumber);
+            mCurrentPrefetch->cancel();
+            mCurrentPrefetch.clear();
+            continue;
+        }
         if (bytesRead < 0) {
             status_t err = bytesRead;
             ALOGE("failed to fetch .ts segment at url '%s'", uri.c_str());
@@ -1268,6 +1536,7 @@ void PlaylistFetcher::onDownloadNext() {
         // its too small), or during startup/resumeUntil (when we could have more than
         // one connection open which affects bandwidth)
         if (!mStartup && mStopParams == NULL && bytesRead > 0
+                && mCurrentPrefetch == NULL
                 && (mStreamTypeMask
                         & (LiveSession::STREAMTYPE_AUDIO
                         | LiveSession::STREAMTYPE_VIDEO))) {
@@ -1420,12 +1689,29 @@ void PlaylistFetcher::onDownloadNext() {
         }
     }
 
+    if (buffer != NULL && (mStreamTypeMask
+            & (LiveSession::STREAMTYPE_AUDIO | LiveSession::STREAMTYPE_VIDEO))) {
+        // lets the session learn the real bitrate of this variant
+        sp<AMessage> msg = mNotify->dup();
+        msg->setInt32("what", kWhatSegmentDownloaded);
+        msg->setSize("bytes", buffer->size());
+        msg->setInt64("durationUs", getSegmentDurationUs(mSeqNumber));
+        msg->post();
+    }
+
     if (checkSwitchBandwidth()) {
         return;
     }
 
+    if (mCurrentPrefetch != NULL) {
+        mCurrentPrefetch->cancel();
+        mCurrentPrefetch.clear();
+    }
+
     ++mSeqNumber;
 
+    startPrefetches();
+
     // if adapting, pause after found the next starting point
     if (mSeekMode != LiveSession::kSeekModeExactPosition && startUp != mStartup) {
         CHECK(mStartTimeUsNotify != NULL);
@@ -1468,27 +1754,13 @@ bool PlaylistFetcher::adjustSeqNumberWithAnchorTime(int64_t anchorTimeUs) {
     if (diffUs > maxDiffUs) {
         while (index > 0 && diffUs > maxDiffUs) {
             --index;
-
-            sp<AMessage> itemMeta;
-            CHECK(mPlaylist->itemAt(index, NULL /* uri */, &itemMeta));
-
-            int64_t itemDurationUs;
-            CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-            diffUs -= itemDurationUs;
+            diffUs -= mPlaylist->getItemDurationUs(index);
         }
     } else if (diffUs < minDiffUs) {
         while (index + 1 < (ssize_t) mPlaylist->size()
                 && diffUs < minDiffUs) {
             ++index;
-
-            sp<AMessage> itemMeta;
-            CHECK(mPlaylist->itemAt(index, NULL /* uri */, &itemMeta));
-
-            int64_t itemDurationUs;
-            CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-            diffUs += itemDurationUs;
+            diffUs += mPlaylist->getItemDurationUs(index);
         }
     }
 
@@ -1527,24 +1799,20 @@ int32_t PlaylistFetcher::getSeqNumberForDiscontinuity(size_t discontinuitySeq) c
 }
 
 int32_t PlaylistFetcher::getSeqNumberForTime(int64_t timeUs) const {
-    size_t index = 0;
-    int64_t segmentStartUs = 0;
-    while (index < mPlaylist->size()) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        if (timeUs < segmentStartUs + itemDurationUs) {
-            break;
+    // binary search for the first segment ending after timeUs
+    size_t lo = 0;
+    size_t hi = mPlaylist->size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (timeUs < mPlaylist->getItemStartTimeUs(mid)
+                + mPlaylist->getItemDurationUs(mid)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
         }
-
-        segmentStartUs += itemDurationUs;
-        ++index;
     }
 
+    size_t index = lo;
     if (index >= mPlaylist->size()) {
         index = mPlaylist->size() - 1;
     }
@@ -2074,17 +2342,7 @@ status_t PlaylistFetcher::extractAndQueueAccessUnits(
 }
 
 void PlaylistFetcher::updateDuration() {
-    int64_t durationUs = 0ll;
-    for (size_t index = 0; index < mPlaylist->size(); ++index) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        durationUs += itemDurationUs;
-    }
+    int64_t durationUs = mPlaylist->getTotalDurationUs();
 
     sp<AMessage> msg = mNotify->dup();
     msg->setInt32("what", kWhatDurationUpdate);
@@ -51,6 +51,7 @@ struct PlaylistFetcher : public AHandler {
         kWhatStopReached,
         kWhatPlaylistFetched,
         kWhatMetadataDetected,
+        kWhatSegmentDownloaded,
     };
 
     PlaylistFetcher(
@@ -104,6 +105,7 @@ protected:
     };
 
     struct DownloadState;
+    struct SegmentPrefetch;
 
     static const int64_t kMaxMonitorDelayUs;
     static const int32_t kNumSkipFrames;
@@ -181,6 +183,12 @@ protected:
 
     sp<DownloadState> mDownloadState;
 
+    // Segments downloading ahead of mSeqNumber, at most mMaxPrefetchSegments, and
+    // the one the current (possibly paused) download is reading from, if any.
+    int32_t mMaxPrefetchSegments;
+    Vector<sp<SegmentPrefetch> > mPrefetches;
+    sp<SegmentPrefetch> mCurrentPrefetch;
+
     bool mHasMetadata;
 
     // Set first to true if decrypting the first segment of a playlist segment. When
@@ -246,6 +254,12 @@ protected:
     int32_t getSeqNumberForDiscontinuity(size_t discontinuitySeq) const;
     int32_t getSeqNumberForTime(int64_t timeUs) const;
 
+    void startPrefetches();
+    sp<SegmentPrefetch> takePrefetch(
+            int32_t seqNumber, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength);
+    void cancelPrefetches();
+
     void updateDuration();
     void updateTargetDuration();
     virtual bool checkSwitchBandwidth() { return false; }
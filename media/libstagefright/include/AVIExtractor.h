@@ -21,6 +21,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/MediaExtractor.h>
 #include <media/stagefright/MediaSource.h>
+#include <utils/threads.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -44,14 +45,42 @@ private:
     struct AVISource;
     struct MP3Splitter;
 
-    struct SampleInfo {
+    // One chunk of a track, from the idx1 index or from an OpenDML standard
+    // index (ix##).
+    struct IndexEntry {
+        // idx1: of the chunk header, from the 'movi' list unless
+        // mOffsetsAreAbsolute. ix##: of the chunk data, from mBaseOffset.
         uint32_t mOffset;
-        bool mIsKey;
+        uint32_t mSize;     // of the chunk data, with kNotKeyFlag
+    };
+
+    enum {
+        kNotKeyFlag = 0x80000000,   // same bit as in ix## entries
+    };
+
+    // An OpenDML standard index listed by the super index (indx) of a track.
+    struct IndexSegment {
+        off64_t mOffset;            // of the ix## chunk
+        uint64_t mBaseOffset;
+        uint32_t mEntrySize;        // in bytes
+        size_t mFirstSample;
+        size_t mNumSamples;
     };
 
     struct Track {
         sp<MetaData> mMeta;
-        Vector<SampleInfo> mSamples;
+
+        // With an idx1 index, all the chunks of the track. With a super index,
+        // only those of mSegments[mLoadedSegment], loaded on demand: large
+        // OpenDML files are neither indexed in full at open nor kept in memory.
+        Vector<IndexEntry> mSamples;
+        Vector<IndexSegment> mSegments;
+        ssize_t mLoadedSegment;
+        size_t mNumSamples;
+
+        // Key frames of an idx1 index, empty if every chunk is a key frame.
+        Vector<uint32_t> mSyncSamples;
+
         uint32_t mRate;
         uint32_t mScale;
 
@@ -68,9 +97,8 @@ private:
         } mKind;
 
         size_t mNumSyncSamples;
-        size_t mThumbnailSampleSize;
-        ssize_t mThumbnailSampleIndex;
         size_t mMaxSampleSize;
+        size_t mSuggestedBufferSize;
 
         // If mBytesPerSample > 0:
         double mAvgChunkSize;
@@ -79,6 +107,10 @@ private:
 
     sp<DataSource> mDataSource;
     status_t mInitCheck;
+
+    // Protects the on demand loading of the OpenDML index segments, the
+    // tracks may be read from different threads.
+    Mutex mLock;
     Vector<Track> mTracks;
 
     off64_t mMovieOffset;
@@ -89,6 +121,14 @@ private:
     status_t parseStreamHeader(off64_t offset, size_t size);
     status_t parseStreamFormat(off64_t offset, size_t size);
     status_t parseIndex(off64_t offset, size_t size);
+    status_t parseSuperIndex(off64_t offset, size_t size);
+    status_t checkIndexOffsets();
+    status_t finishIndex();
+
+    status_t loadSegment_l(Track *track, size_t segmentIndex);
+    status_t getIndexEntry_l(
+            Track *track, size_t sampleIndex,
+            IndexEntry *entry, off64_t *offset);
 
     status_t parseHeaders();
 
@@ -103,7 +143,11 @@ private:
     status_t getSampleIndexAtTime(
             size_t trackIndex,
             int64_t timeUs, MediaSource::ReadOptions::SeekMode mode,
-            size_t *sampleIndex) const;
+            size_t *sampleIndex);
+
+    status_t findSyncSamples_l(
+            Track *track, size_t sampleIndex,
+            ssize_t *prevSyncSampleIndex, ssize_t *nextSyncSampleIndex);
 
     status_t addMPEG4CodecSpecificData(size_t trackIndex);
     status_t addH264CodecSpecificData(size_t trackIndex);
@@ -152,6 +152,7 @@ private:
     mutable Mutex mLock;
     Mutex mMiscStateLock;
     mutable Mutex mStatsLock;
+    Mutex mCacheStatusLock;
     Mutex mAudioLock;
 
     OMXClient mClient;
@@ -222,6 +223,10 @@ private:
     bool mStreamDoneEventPending;
     sp<TimedEventQueue::Event> mBufferingEvent;
     bool mBufferingEventPending;
+    int64_t mBufferingEventTimeUs;
+    int64_t mLastBufferingUpdateUs;
+    sp<TimedEventQueue::Event> mCacheStatusEvent;
+    bool mCacheStatusEventPending;  // protected by mCacheStatusLock
     sp<TimedEventQueue::Event> mCheckAudioStatusEvent;
     bool mAudioStatusEventPending;
     sp<TimedEventQueue::Event> mVideoLagEvent;
@@ -235,7 +240,8 @@ private:
     status_t mStreamDoneStatus;
 
     void postVideoEvent_l(int64_t delayUs = -1);
-    void postBufferingEvent_l();
+    void postBufferingEvent_l(int64_t delayUs = 1000000ll);
+    void postCacheStatusEvent();
     void postStreamDoneEvent_l(status_t status);
     void postCheckAudioStatusEvent(int64_t delayUs);
     void postVideoLagEvent_l();
@@ -289,6 +295,8 @@ private:
 
     void onVideoEvent();
     void onBufferingUpdate();
+    void onCacheStatusChanged();
+    static void OnCacheStatus(void *cookie);
     void onCheckAudioStatus();
     void onPrepareAsyncEvent();
     void abortPrepare(status_t err);
@@ -31,7 +31,10 @@ class String8;
 class MP3Extractor : public MediaExtractor {
 public:
     // Extractor assumes ownership of "source".
-    MP3Extractor(const sp<DataSource> &source, const sp<AMessage> &meta);
+    // With metaDataOnly, files without a XING or VBRI header are not indexed,
+    // their duration is estimated from the first frame's bitrate.
+    MP3Extractor(const sp<DataSource> &source, const sp<AMessage> &meta,
+            bool metaDataOnly = false);
 
     virtual size_t countTracks();
     virtual sp<MediaSource> getTrack(size_t index);
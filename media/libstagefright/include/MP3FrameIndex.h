@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef MP3_FRAME_INDEX_H_
+
+#define MP3_FRAME_INDEX_H_
+
+#include "include/MP3Seeker.h"
+
+#include <utils/Mutex.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+class DataSource;
+
+// Time to offset table for MP3 files without a XING or VBRI header, built by scanning the
+// frame headers of the file on a background thread. Seeks within the part of the file that
+// has been scanned land on a frame at most kFramesPerEntry frames before the requested time,
+// and report that frame's exact time; until the scan has reached the requested time the
+// caller falls back to its constant bitrate estimate.
+//
+// Completed indices are kept in a small process wide cache keyed by the file's size, its
+// first frame and a hash of its tail, so that e.g. the metadata retriever and the player
+// share one scan and both report the exact duration.
+struct MP3FrameIndex : public MP3Seeker {
+    // Returns NULL unless "media.stagefright.mp3-frame-index" is set and the source is a
+    // local file.
+    static sp<MP3FrameIndex> CreateFromSource(
+            const sp<DataSource> &source, off64_t first_frame_pos, uint32_t fixed_header);
+
+    // Only succeeds once the whole file has been scanned.
+    virtual bool getDuration(int64_t *durationUs);
+    virtual bool getOffsetForTime(int64_t *timeUs, off64_t *pos);
+
+protected:
+    virtual ~MP3FrameIndex();
+
+private:
+    struct Key {
+        off64_t mFileSize;
+        off64_t mFirstFramePos;
+        uint32_t mFixedHeader;
+        uint32_t mTailHash;
+
+        bool operator==(const Key &other) const;
+    };
+
+    enum {
+        kFramesPerEntry = 8,
+    };
+
+    const Key mKey;
+    const int mSampleRate;
+    const int mSamplesPerFrame;
+
+    Mutex mLock;
+    // Offset, relative to the first frame, of every kFramesPerEntry-th frame.
+    Vector<uint32_t> mEntries;
+    int64_t mNumFrames;
+    bool mComplete;
+
+    sp<DataSource> mSource;     // only used by the scanning thread
+
+    MP3FrameIndex(const Key &key, int sampleRate, int samplesPerFrame,
+            const sp<DataSource> &source);
+
+    int64_t frameToTimeUs(int64_t frame) const;
+
+    static void *ThreadWrapper(void *me);
+    void scan();
+    void publish(Vector<uint32_t> *entries, int64_t numFrames, bool complete);
+
+    DISALLOW_EVIL_CONSTRUCTORS(MP3FrameIndex);
+};
+
+}  // namespace android
+
+#endif  // MP3_FRAME_INDEX_H_
@@ -27,6 +27,7 @@
 
 namespace android {
 
+struct ABuffer;
 struct AMessage;
 struct AnotherPacketSource;
 struct ATSParser;
@@ -63,13 +64,36 @@ private:
 
     off64_t mOffset;
 
+    // the last block read from mDataSource, starting at mReadBufferOffset
+    sp<ABuffer> mReadBuffer;
+    off64_t mReadBufferOffset;
+    size_t mReadBufferSize;
+
+    // true while mSyncPoints cover the stream from its start, i.e. until
+    // the first seek by bisection
+    bool mSyncPointsFromStart;
+
+    // PID of the seek reference track, and the PTS and media time of one of
+    // its sync points, used to map PTS to media time when bisecting the file.
+    int32_t mSeekPID;
+    uint64_t mSeekBasePTS;
+    int64_t mSeekBaseTimeUs;
+
     void init();
+    status_t fillReadBuffer();
     status_t feedMore();
     status_t seek(int64_t seekTimeUs,
             const MediaSource::ReadOptions::SeekMode& seekMode);
     status_t queueDiscontinuityForSeek(int64_t actualSeekTimeUs);
     status_t seekBeyond(int64_t seekTimeUs);
 
+    bool shouldSeekByBisection(int64_t seekTimeUs);
+    status_t findPESAt(
+            off64_t offset, size_t maxBytes,
+            off64_t *pesOffset, uint64_t *PTS, unsigned *PID);
+    status_t calibrateSeekPTS();
+    status_t seekByBisection(int64_t seekTimeUs);
+
     status_t feedUntilBufferAvailable(const sp<AnotherPacketSource> &impl);
 
     DISALLOW_EVIL_CONSTRUCTORS(MPEG2TSExtractor);
@@ -32,6 +32,7 @@ namespace android {
 struct AMessage;
 class DataSource;
 class SampleTable;
+struct SampleTableCache;
 class String8;
 
 struct SidxEntry {
@@ -50,7 +51,8 @@ struct Trex {
 class MPEG4Extractor : public MediaExtractor {
 public:
     // Extractor assumes ownership of "source".
-    MPEG4Extractor(const sp<DataSource> &source);
+    // With metaDataOnly, the sample tables are skipped and getTrack() fails.
+    MPEG4Extractor(const sp<DataSource> &source, bool metaDataOnly = false);
 
     virtual size_t countTracks();
     virtual sp<MediaSource> getTrack(size_t index);
@@ -91,6 +93,8 @@ private:
     Vector<Trex> mTrex;
 
     sp<DataSource> mDataSource;
+    sp<SampleTableCache> mSampleTableCache;
+    bool mMetaDataOnly;
     status_t mInitCheck;
     bool mHasVideo;
     uint32_t mHeaderTimescale;
@@ -117,7 +121,7 @@ private:
     status_t updateAudioTrackInfoFromESDS_MPEG4Audio(
             const void *esds_data, size_t esds_size);
 
-    static status_t verifyTrack(Track *track);
+    status_t verifyTrack(Track *track);
 
     struct SINF {
         SINF *next;
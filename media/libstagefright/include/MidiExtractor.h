@@ -27,6 +27,8 @@
 
 namespace android {
 
+struct ABuffer;
+
 class MidiEngine : public RefBase {
 public:
     MidiEngine(const sp<DataSource> &dataSource,
@@ -47,6 +49,14 @@ private:
     EAS_HANDLE mEasHandle;
     const S_EAS_LIB_CONFIG* mEasConfig;
     bool mIsInitialized;
+    EAS_I32 mDurationMs;
+
+    // The whole file rendered by prerender(), or NULL when rendering in real time.
+    sp<ABuffer> mPcm;
+    size_t mPcmOffset;
+
+    void prerender();
+    bool computeCacheKey(uint64_t *key);
 };
 
 class MidiExtractor : public MediaExtractor {
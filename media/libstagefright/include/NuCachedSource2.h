@@ -19,8 +19,10 @@
 #define NU_CACHED_SOURCE_2_H_
 
 #include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/DataSource.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -55,12 +57,37 @@ struct NuCachedSource2 : public DataSource {
 
     void resumeFetchingIfNecessary();
 
+    // Calls callback(cookie) whenever approxDataRemaining() has moved by at
+    // least granularityBytes since the last call, or its final status has
+    // changed, so that a player need not poll the cache. The callback runs on
+    // the thread that fetched or read the data, with no lock of the source
+    // held, and must not block. Passing a NULL callback removes the listener
+    // and waits for a callback in progress to return.
+    typedef void (*StatusCallback)(void *cookie);
+    void setStatusListener(
+            StatusCallback callback, void *cookie, size_t granularityBytes);
+
     // The following methods are supported only if the
     // data source is HTTP-based; otherwise, ERROR_UNSUPPORTED
     // is returned.
     status_t getEstimatedBandwidthKbps(int32_t *kbps);
     status_t setCacheStatCollectFreq(int32_t freqMs);
 
+    // Registers byte ranges a seek is likely to land on, e.g. the sync samples of
+    // the extractor's index. They are fetched into a small side cache while the
+    // main cache is full, so that a seek to one of them returns data at once
+    // while the main cache refills from the new position.
+    void addSeekTargets(const Vector<off64_t> &offsets, size_t size);
+
+    // Bounds the cache, e.g. by the device's memory or while the system is low
+    // on it, but never below kMinCacheSizeLimit. The default bound is
+    // kMaxHighWaterThreshold.
+    void setMaxCacheSize(size_t maxBytes);
+
+    // Gives back the memory of the data behind the read position and of the
+    // unused pages, to be called while the system is low on memory.
+    void trimCache();
+
     static void RemoveCacheSpecificHeaders(
             KeyedVector<String8, String8> *headers,
             String8 *cacheConfig,
@@ -85,6 +112,20 @@ protected:
         kDefaultHighWaterThreshold      = 20 * 1024 * 1024,
         kDefaultLowWaterThreshold       = 4 * 1024 * 1024,
 
+        // Bounds of the watermarks sized from the measured rates, unless the
+        // watermarks were configured explicitly.
+        kMinHighWaterThreshold          = 8 * 1024 * 1024,
+        kMaxHighWaterThreshold          = 40 * 1024 * 1024,
+        kMinLowWaterThreshold           = 512 * 1024,
+
+        // Smallest bound accepted by setMaxCacheSize(), as a single read
+        // must fit in the cache.
+        kMinCacheSizeLimit              = 4 * 1024 * 1024,
+
+        // Seek target side cache.
+        kMaxSeekTargetSize              = 256 * 1024,
+        kMaxSeekTargetCacheSize         = 2 * 1024 * 1024,
+
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
         kDefaultKeepAliveIntervalUs     = 15000000,
@@ -93,6 +134,7 @@ protected:
     enum {
         kWhatFetchMore  = 'fetc',
         kWhatRead       = 'read',
+        kWhatTrim       = 'trim',
     };
 
     enum {
@@ -128,16 +170,53 @@ protected:
 
     bool mSuspended;
 
+    // Whether the watermarks follow the measured rates, see updateWatermarks_l().
+    bool mAdaptiveWatermarks;
+    // Smoothed rates in bytes per second, 0 until measured.
+    double mFetchBytesPerSec;
+    double mConsumeBytesPerSec;
+    int64_t mRateSampleTimeUs;
+    off64_t mRateSamplePos;
+
+    struct SeekTarget {
+        off64_t mOffset;
+        size_t mSize;
+        sp<ABuffer> mData;  // NULL until fetched
+    };
+    Vector<SeekTarget> mSeekTargets;
+    size_t mSeekTargetCacheSize;
+
+    size_t mMaxHighwaterThresholdBytes;
+
+    // Serializes the status callback against setStatusListener().
+    Mutex mStatusLock;
+    StatusCallback mStatusCallback;
+    void *mStatusCookie;
+    size_t mStatusGranularityBytes;
+    size_t mLastStatusRemaining;
+    status_t mLastStatusFinalStatus;
+
     void onMessageReceived(const sp<AMessage> &msg);
     void onFetch();
     void onRead(const sp<AMessage> &msg);
+    void onTrim();
 
     void fetchInternal();
+    bool fetchSeekTarget();
     ssize_t readInternal(off64_t offset, void *data, size_t size);
+    ssize_t readAtSerialized(off64_t offset, void *data, size_t size);
     status_t seekInternal_l(off64_t offset);
+    ssize_t readFromSeekTargets_l(off64_t offset, void *data, size_t size);
+
+    void updateRates_l();
+    void updateWatermarks_l();
+    void clampWatermarks_l();
 
     size_t approxDataRemaining_l(status_t *finalStatus) const;
 
+    bool statusChanged_l();
+    void notifyStatusIfChanged();
+
     void restartPrefetcherIfNecessary_l(
             bool ignoreLowWaterThreshold = false, bool force = false);
 
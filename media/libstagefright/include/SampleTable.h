@@ -29,10 +29,14 @@ namespace android {
 
 class DataSource;
 struct SampleIterator;
+struct SampleTableCache;
 
 class SampleTable : public RefBase {
 public:
-    SampleTable(const sp<DataSource> &source);
+    // Tables found in cache are mapped from it instead of being read from source, and
+    // the others are added to it.
+    SampleTable(const sp<DataSource> &source,
+            const sp<SampleTableCache> &cache = NULL);
 
     bool isValid() const;
 
@@ -101,6 +105,17 @@ private:
     sp<DataSource> mDataSource;
     Mutex mLock;
 
+    sp<SampleTableCache> mCache;
+
+    // tables that point into mCache, and must not be freed
+    enum {
+        kCachedTimeToSample             = 1,
+        kCachedCompositionTimeDeltas    = 2,
+        kCachedSyncSamples              = 4,
+        kCachedSampleToChunk            = 8,
+    };
+    uint32_t mCachedTables;
+
     off64_t mChunkOffsetOffset;
     uint32_t mChunkOffsetType;
     uint32_t mNumChunkOffsets;
@@ -117,12 +132,27 @@ private:
     uint32_t mTimeToSampleCount;
     uint32_t* mTimeToSample;
 
+    // First sample and its decoding time of every time-to-sample entry, followed by the
+    // end of the last entry, so that the entry of a sample is found by binary search
+    // instead of walking the table. Only the first mNumTimeToSampleStarts are valid; the
+    // index stops at an entry that overflows 32 bit sample indices or times.
+    struct TimeToSampleStart {
+        uint32_t mSampleIndex;
+        uint32_t mSampleTime;
+    };
+    TimeToSampleStart *mTimeToSampleStarts;
+    uint32_t mNumTimeToSampleStarts;
+
     struct SampleTimeEntry {
         uint32_t mSampleIndex;
         uint32_t mCompositionTime;
     };
     SampleTimeEntry *mSampleTimeEntries;
 
+    // Without composition offsets, presentation order is decoding order and sample
+    // times are computed from mTimeToSampleStarts instead of mSampleTimeEntries.
+    bool mHasMonotonicSampleTimes;
+
     uint32_t *mCompositionTimeDeltaEntries;
     size_t mNumCompositionTimeDeltaEntries;
     CompositionDeltaLookup *mCompositionDeltaLookup;
@@ -141,6 +171,11 @@ private:
     };
     SampleToChunkEntry *mSampleToChunkEntries;
 
+    // First sample of each sample-to-chunk entry, valid for the first
+    // mNumSampleToChunkStartSamples entries, for the same purpose as mTimeToSampleStarts.
+    uint32_t *mSampleToChunkStartSamples;
+    uint32_t mNumSampleToChunkStartSamples;
+
     // Approximate size of all tables combined.
     uint64_t mTotalSize;
 
@@ -149,15 +184,31 @@ private:
     // normally we don't round
     inline uint64_t getSampleTime(
             size_t sample_index, uint64_t scale_num, uint64_t scale_den) const {
-        return (sample_index < (size_t)mNumSampleSizes && mSampleTimeEntries != NULL
+        return (sample_index < (size_t)mNumSampleSizes
+                && (mSampleTimeEntries != NULL || mHasMonotonicSampleTimes)
                 && scale_den != 0)
-                ? (mSampleTimeEntries[sample_index].mCompositionTime * scale_num) / scale_den : 0;
+                ? (getSortedSampleTime(sample_index) * scale_num) / scale_den : 0;
     }
 
+    // composition time and index of the sample at position i in presentation order
+    uint32_t getSortedSampleTime(uint32_t i) const;
+    uint32_t getSortedSampleIndex(uint32_t i) const;
+
+    // index of the time-to-sample entry holding sampleIndex, among the indexed ones
+    uint32_t findTimeToSampleEntry(uint32_t sampleIndex) const;
+
+    void buildTimeToSampleStarts();
+
+    const void *lookupCachedTable(uint32_t type, off64_t data_offset, size_t data_size,
+            uint32_t numEntries, size_t entrySize, uint32_t flag);
+    void addCachedTable(uint32_t type, off64_t data_offset, size_t data_size,
+            const void *data, uint32_t numEntries, size_t entrySize);
+    void buildSampleToChunkStartSamples();
+
     status_t getSampleSize_l(uint32_t sample_index, size_t *sample_size);
     uint32_t getCompositionTimeOffset(uint32_t sampleIndex);
 
-    static int CompareIncreasingTime(const void *, const void *);
+    static bool IsEarlier(const SampleTimeEntry &a, const SampleTimeEntry &b);
 
     void buildSampleEntriesTable();
 
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SAMPLE_TABLE_CACHE_H_
+
+#define SAMPLE_TABLE_CACHE_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#include <media/stagefright/DataSource.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Persistent cache of the decoded sample tables of a local MP4 file, so that opening the
+// file again maps the tables instead of reading and byte swapping them. Every extractor
+// of the file, whoever creates it, shares the same cache file.
+//
+// Tables are keyed by the offset and size of their box, and the cache file by the
+// identity of the media file, so a file that changed in any way gets a new cache.
+// Cache files are in native byte order and only valid on the device that wrote them.
+struct SampleTableCache : public RefBase {
+    // Returns NULL if caching is disabled or the source is not a local file.
+    static sp<SampleTableCache> Create(const sp<DataSource> &source);
+
+    // Returns the cached table for the box, or NULL if there is none with numEntries
+    // entries of entrySize bytes. The table is read-only, and valid as long as the cache.
+    const void *lookup(uint32_t type, off64_t boxOffset, size_t boxSize,
+            uint32_t numEntries, size_t entrySize);
+
+    // Queues a copy of a table, to be written by save().
+    void add(uint32_t type, off64_t boxOffset, size_t boxSize,
+            const void *data, uint32_t numEntries, size_t entrySize);
+
+    // Writes the queued tables, if the cache file was missing or stale.
+    void save();
+
+protected:
+    virtual ~SampleTableCache();
+
+private:
+    struct Header;
+    struct TableEntry;
+
+    struct PendingTable {
+        uint32_t mType;
+        off64_t mBoxOffset;
+        size_t mBoxSize;
+        void *mData;    // malloc'ed copy
+        uint32_t mNumEntries;
+        size_t mEntrySize;
+    };
+
+    Mutex mLock;
+    DataSource::FileIdentity mIdentity;
+    String8 mPath;
+
+    // the mapped cache file, if it is valid for the media file
+    void *mMapping;
+    size_t mMappingSize;
+    const TableEntry *mTables;
+    uint32_t mNumTables;
+
+    Vector<PendingTable> mPending;
+
+    SampleTableCache(const DataSource::FileIdentity &identity, const String8 &path);
+
+    void map();
+    void clearPending_l();
+    static void evictOldFiles();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SampleTableCache);
+};
+
+}  // namespace android
+
+#endif  // SAMPLE_TABLE_CACHE_H_
@@ -61,6 +61,10 @@ protected:
     enum {
         kStoreMetaDataExtensionIndex = OMX_IndexVendorStartUnused + 1,
         kPrepareForAdaptivePlaybackIndex,
+        kLowLatencyIndex,
+        kThreadCountIndex,
+        kFlacBlockSizeIndex,
+        kEncoderDelayIndex,
     };
 
     void addPort(const OMX_PARAM_PORTDEFINITIONTYPE &def);
@@ -80,15 +84,26 @@ protected:
 
     PortInfo *editPortInfo(OMX_U32 portIndex);
 
+    // Number of worker threads the codec should use when the component shares its looper
+    // with the other components of the process, or 0 if it is free to use one per CPU.
+    uint32_t threadBudget() const;
+
+    virtual ~SimpleSoftOMXComponent();
+
 private:
     enum {
         kWhatSendCommand,
         kWhatEmptyThisBuffer,
         kWhatFillThisBuffer,
+        kWhatBarrier,
     };
 
     Mutex mLock;
 
+    // If set, mLooper comes from SoftOMXLooperPool and is shared with other components.
+    bool mPooledLooper;
+    bool mDestroying;
+
     sp<ALooper> mLooper;
     sp<AHandlerReflector<SimpleSoftOMXComponent> > mHandler;
 
@@ -82,6 +82,10 @@ protected:
             uint8_t *dst, const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV,
             size_t srcYStride, size_t srcUStride, size_t srcVStride);
 
+    static void copyPlane(
+            uint8_t *dst, size_t dstStride, const uint8_t *src, size_t srcStride,
+            size_t width, size_t height);
+
     enum {
         kInputPortIndex  = 0,
         kOutputPortIndex = 1,
@@ -89,6 +93,12 @@ protected:
     };
 
     bool mIsAdaptive;
+    // Set through OMX.google.android.index.lowLatency: output each frame as soon as it is
+    // decoded, in decode order, instead of waiting for the reorder depth of the stream.
+    bool mLowLatency;
+    // Set through OMX.google.android.index.threadCount: number of threads the decoder
+    // library should use, or 0 to pick one from the number of CPU cores.
+    uint32_t mThreadCount;
     uint32_t mAdaptiveMaxWidth, mAdaptiveMaxHeight;
     uint32_t mWidth, mHeight;
     uint32_t mCropLeft, mCropTop, mCropWidth, mCropHeight;
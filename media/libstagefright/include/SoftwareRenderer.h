@@ -44,6 +44,10 @@ public:
 private:
     enum YUVMode {
         None,
+        // The frame is copied into a YV12 buffer as is, and the GPU or the
+        // hardware composer does the color conversion.
+        YV12FromPlanar,
+        YV12FromSemiPlanar,
     };
 
     OMX_COLOR_FORMATTYPE mColorFormat;
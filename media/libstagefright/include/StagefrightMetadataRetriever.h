@@ -41,6 +41,8 @@ struct StagefrightMetadataRetriever : public MediaMetadataRetrieverInterface {
     virtual status_t setDataSource(const sp<DataSource>& source);
 
     virtual VideoFrame *getFrameAtTime(int64_t timeUs, int option);
+    virtual VideoFrame *getScaledFrameAtTime(
+            int64_t timeUs, int option, int32_t maxWidth, int32_t maxHeight);
     virtual MediaAlbumArt *extractAlbumArt();
     virtual const char *extractMetadata(int keyCode);
 
@@ -48,6 +50,8 @@ private:
     OMXClient mClient;
     sp<DataSource> mSource;
     sp<MediaExtractor> mExtractor;
+    // mExtractor was created with MediaExtractor::kMetaDataOnly
+    bool mMetaDataOnly;
 
     bool mParsedMetaData;
     KeyedVector<int, String8> mMetaData;
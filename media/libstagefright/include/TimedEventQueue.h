@@ -20,9 +20,9 @@
 
 #include <pthread.h>
 
-#include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 #include <powermanager/IPowerManager.h>
 
 namespace android {
@@ -91,11 +91,16 @@ struct TimedEventQueue {
     event_id postEventToBack(const sp<Event> &event);
 
     // It is an error to post an event with a negative delay.
-    event_id postEventWithDelay(const sp<Event> &event, int64_t delay_us);
+    // An event posted with a tolerance may fire up to tolerance_us late, so
+    // that it can share a wakeup with another event instead of causing its
+    // own, e.g. a periodic status check.
+    event_id postEventWithDelay(
+            const sp<Event> &event, int64_t delay_us, int64_t tolerance_us = 0);
 
     // If the event is to be posted at a time that has already passed,
     // it will fire as soon as possible.
-    event_id postTimedEvent(const sp<Event> &event, int64_t realtime_us);
+    event_id postTimedEvent(
+            const sp<Event> &event, int64_t realtime_us, int64_t tolerance_us = 0);
 
     // Returns true iff event is currently in the queue and has been
     // successfully cancelled. In this case the event will have been
@@ -117,8 +122,15 @@ struct TimedEventQueue {
 private:
     struct QueueItem {
         sp<Event> event;
-        int64_t realtime_us;
+        int64_t realtime_us;    // earliest time to fire
+        int64_t deadline_us;    // latest time to fire, realtime_us + tolerance
+        uint64_t seq;           // keeps items with the same deadline in posting order
         bool has_wakelock;
+
+        bool operator<(const QueueItem &other) const {
+            return deadline_us < other.deadline_us
+                    || (deadline_us == other.deadline_us && seq < other.seq);
+        }
     };
 
     struct StopEvent : public TimedEventQueue::Event {
@@ -128,7 +140,10 @@ private:
     };
 
     pthread_t mThread;
-    List<QueueItem> mQueue;
+    // Binary min-heap ordered by deadline, the head is the next item to
+    // wait for.
+    Vector<QueueItem> mQueue;
+    uint64_t mNextSeq;
     Mutex mLock;
     Condition mQueueNotEmptyCondition;
     Condition mQueueHeadChangedCondition;
@@ -147,6 +162,11 @@ private:
 
     sp<Event> removeEventFromQueue_l(event_id id, bool *wakeLocked);
 
+    ssize_t findDueItem_l(int64_t now_us) const;
+    void removeItemAt_l(size_t index);
+    void siftUp_l(size_t index);
+    void siftDown_l(size_t index);
+
     void acquireWakeLock_l();
     void releaseWakeLock_l(bool force = false);
 
@@ -49,6 +49,11 @@ void FindAVCDimensions(
 
 unsigned parseUE(ABitReader *br);
 
+// Returns the offset of the first 00 00 01 start code prefix in data, or size if
+// there is none. All start code scans over H.264/HEVC byte streams should go through
+// this, it skips blocks of bytes without a zero byte using vector compares.
+size_t findStartCodePrefix(const uint8_t *data, size_t size);
+
 status_t getNextNALUnit(
         const uint8_t **_data, size_t *_size,
         const uint8_t **nalStart, size_t *nalSize,
@@ -60,6 +65,13 @@ sp<MetaData> MakeAVCCodecSpecificData(const sp<ABuffer> &accessUnit);
 bool IsIDR(const sp<ABuffer> &accessUnit);
 bool IsAVCReferenceFrame(const sp<ABuffer> &accessUnit);
 
+// Appends the CEA-608 byte pairs carried by an H.264 SEI NAL unit, in the
+// cc_data() of its ATSC A/53 user_data_registered_itu_t_t35() payloads, to
+// ccData. Each valid pair that is not padding is stored as 3 bytes: cc_type,
+// then both data bytes without their parity bits. ccData needs room for
+// nalSize more bytes. Returns the number of pairs appended.
+size_t ExtractCEA608FromSEI(const uint8_t *nal, size_t nalSize, const sp<ABuffer> &ccData);
+
 const char *AVCProfileToString(uint8_t profile);
 
 sp<MetaData> MakeAACCodecSpecificData(
@@ -25,6 +25,7 @@
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaBufferGroup.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MediaSource.h>
@@ -34,12 +35,15 @@
 #include <media/stagefright/foundation/ABitReader.h>
 
 #include <inttypes.h>
+#include <unistd.h>
 
 namespace android {
 
 struct DataSourceReader : public mkvparser::IMkvReader {
     DataSourceReader(const sp<DataSource> &source)
-        : mSource(source) {
+        : mSource(source),
+          mChunkOffset(-1),
+          mChunkSize(0) {
     }
 
     virtual int Read(long long position, long length, unsigned char* buffer) {
@@ -50,13 +54,34 @@ struct DataSourceReader : public mkvparser::IMkvReader {
             return 0;
         }
 
-        ssize_t n = mSource->readAt(position, buffer, length);
+        // mkvparser reads element ids and sizes a few bytes at a time, serve
+        // those from an aligned chunk rather than with a readAt() each.
+        if (length <= (long)kMaxCachedReadSize) {
+            Mutex::Autolock autoLock(mLock);
+
+            if (mChunkOffset < 0 || position < mChunkOffset
+                    || position + length > mChunkOffset + (long long)mChunkSize) {
+                off64_t chunkOffset = position & ~(off64_t)(kChunkSize - 1);
+                ssize_t n = mSource->readAt(chunkOffset, mChunk, kChunkSize);
+                if (n < 0) {
+                    mChunkOffset = -1;
+                    return -1;
+                }
+                mChunkOffset = chunkOffset;
+                mChunkSize = n;
 
-        if (n <= 0) {
-            return -1;
+                if (position + length > mChunkOffset + (long long)mChunkSize) {
+                    // straddles the chunk boundary or the end of the data
+                    mChunkOffset = -1;
+                    return readDirect(position, length, buffer);
+                }
+            }
+
+            memcpy(buffer, mChunk + (position - mChunkOffset), length);
+            return 0;
         }
 
-        return 0;
+        return readDirect(position, length, buffer);
     }
 
     virtual int Length(long long* total, long long* available) {
@@ -80,14 +105,75 @@ struct DataSourceReader : public mkvparser::IMkvReader {
     }
 
 private:
+    enum {
+        kChunkSize = 32768,
+        kMaxCachedReadSize = 4096,
+    };
+
     sp<DataSource> mSource;
 
+    // frames are read by the sources without holding the extractor lock
+    Mutex mLock;
+    uint8_t mChunk[kChunkSize];
+    long long mChunkOffset;
+    size_t mChunkSize;
+
+    int readDirect(long long position, long length, unsigned char* buffer) {
+        ssize_t n = mSource->readAt(position, buffer, length);
+
+        if (n <= 0) {
+            return -1;
+        }
+
+        return 0;
+    }
+
     DataSourceReader(const DataSourceReader &);
     DataSourceReader &operator=(const DataSourceReader &);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 
+struct ClusterSampler : public Thread {
+    ClusterSampler(MatroskaExtractor *extractor)
+        : Thread(false /* canCallJava */),
+          mExtractor(extractor) {
+    }
+
+private:
+    enum {
+        kClustersPerPass = 16,
+        kPassIntervalUs = 20000,
+    };
+
+    MatroskaExtractor *mExtractor;
+
+    virtual bool threadLoop() {
+        {
+            Mutex::Autolock autoLock(mExtractor->mLock);
+            for (int i = 0; i < kClustersPerPass; ++i) {
+                long long pos;
+                long len;
+                long res = mExtractor->mSegment->LoadCluster(pos, len);
+                if (res != 0) {
+                    ALOGV("cluster sampler done (%ld), %ld clusters",
+                            res, mExtractor->mSegment->GetCount());
+                    return false;
+                }
+            }
+        }
+
+        // leave the lock and the data source to playback most of the time
+        usleep(kPassIntervalUs);
+        return true;
+    }
+
+    ClusterSampler(const ClusterSampler &);
+    ClusterSampler &operator=(const ClusterSampler &);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 struct BlockIterator {
     BlockIterator(MatroskaExtractor *extractor, unsigned long trackNum, unsigned long index);
 
@@ -114,6 +200,11 @@ private:
 
     void advance_l();
 
+    void seekWithoutCues_l(
+            long long seekTimeNs, bool isAudio, int64_t *actualFrameTimeUs);
+    bool seekToKeyFrameInCluster_l(
+            const mkvparser::Cluster *cluster, long long seekTimeNs);
+
     BlockIterator(const BlockIterator &);
     BlockIterator &operator=(const BlockIterator &);
 };
@@ -150,10 +241,18 @@ private:
 
     List<MediaBuffer *> mPendingFrames;
 
+    // Frames are read into buffers of this group once the track's frame
+    // sizes are known.
+    MediaBufferGroup *mBufferGroup;
+    size_t mGroupBufferSize;
+    size_t mMaxFrameSize;
+    size_t mNumFramesRead;
+
     status_t advance();
 
     status_t readBlock();
     void clearPendingFrames();
+    MediaBuffer *acquireBuffer(size_t size);
 
     MatroskaSource(const MatroskaSource &);
     MatroskaSource &operator=(const MatroskaSource &);
@@ -215,7 +314,11 @@ MatroskaSource::MatroskaSource(
       mBlockIter(mExtractor.get(),
                  mExtractor->mTracks.itemAt(index).mTrackNum,
                  index),
-      mNALSizeLen(0) {
+      mNALSizeLen(0),
+      mBufferGroup(NULL),
+      mGroupBufferSize(0),
+      mMaxFrameSize(0),
+      mNumFramesRead(0) {
     sp<MetaData> meta = mExtractor->mTracks.itemAt(index).mMeta;
 
     const char *mime;
@@ -255,9 +358,13 @@ MatroskaSource::MatroskaSource(
 
 MatroskaSource::~MatroskaSource() {
     clearPendingFrames();
+
+    delete mBufferGroup;
+    mBufferGroup = NULL;
 }
 
 status_t MatroskaSource::start(MetaData * /* params */) {
+    mExtractor->startClusterSampler();
     mBlockIter.reset();
 
     return OK;
@@ -266,9 +373,47 @@ status_t MatroskaSource::start(MetaData * /* params */) {
 status_t MatroskaSource::stop() {
     clearPendingFrames();
 
+    delete mBufferGroup;
+    mBufferGroup = NULL;
+    mGroupBufferSize = 0;
+    mMaxFrameSize = 0;
+    mNumFramesRead = 0;
+
     return OK;
 }
 
+MediaBuffer *MatroskaSource::acquireBuffer(size_t size) {
+    // the group is sized after the largest of the first frames
+    static const size_t kFramesBeforeGroup = 16;
+    static const size_t kNumGroupBuffers = 8;
+    static const size_t kMaxGroupBufferSize = 4 * 1024 * 1024;
+
+    if (size > mMaxFrameSize) {
+        mMaxFrameSize = size;
+    }
+
+    if (mBufferGroup == NULL && ++mNumFramesRead >= kFramesBeforeGroup) {
+        mGroupBufferSize = min(
+                align(mMaxFrameSize * 2, 4096), kMaxGroupBufferSize);
+        mBufferGroup = new MediaBufferGroup;
+        for (size_t i = 0; i < kNumGroupBuffers; ++i) {
+            mBufferGroup->add_buffer(new MediaBuffer(mGroupBufferSize));
+        }
+        ALOGV("track %zu: %zu buffers of %zu bytes",
+                mTrackIndex, kNumGroupBuffers, mGroupBufferSize);
+    }
+
+    MediaBuffer *buffer;
+    if (mBufferGroup != NULL && size <= mGroupBufferSize
+            && mBufferGroup->acquire_buffer(&buffer, true /* nonBlocking */) == OK) {
+        buffer->set_range(0, size);
+        return buffer;
+    }
+
+    // all buffers are downstream, or the frame is unusually large
+    return new MediaBuffer(size);
+}
+
 sp<MetaData> MatroskaSource::getFormat() {
     return mExtractor->mTracks.itemAt(mTrackIndex).mMeta;
 }
@@ -417,12 +562,14 @@ void BlockIterator::seek(
         }
 
         if (!pCues) {
-            ALOGE("No Cues in file");
+            ALOGV("No Cues in file");
+            seekWithoutCues_l(seekTimeNs, isAudio, actualFrameTimeUs);
             return;
         }
     }
     else if (!pSH) {
-        ALOGE("No SeekHead");
+        ALOGV("No SeekHead");
+        seekWithoutCues_l(seekTimeNs, isAudio, actualFrameTimeUs);
         return;
     }
 
@@ -499,6 +646,112 @@ void BlockIterator::seek(
     }
 }
 
+void BlockIterator::seekWithoutCues_l(
+        long long seekTimeNs, bool isAudio, int64_t *actualFrameTimeUs) {
+    mkvparser::Segment* const pSegment = mExtractor->mSegment;
+
+    // Make sure the cluster containing the target is loaded. The cluster
+    // sampler usually has done this already; mkvparser only reads the
+    // headers of the clusters it loads.
+    for (;;) {
+        const mkvparser::Cluster *last = pSegment->GetLast();
+        if (last != NULL && !last->EOS() && last->GetTime() > seekTimeNs) {
+            break;
+        }
+
+        long long pos;
+        long len;
+        if (pSegment->LoadCluster(pos, len) != 0) {
+            break;  // no more clusters, or error
+        }
+    }
+
+    // Binary search of the loaded clusters.
+    const mkvparser::Cluster *cluster = pSegment->FindCluster(seekTimeNs);
+    if (cluster == NULL || cluster->EOS()) {
+        ALOGE("No cluster to seek to");
+        return;
+    }
+
+    const mkvparser::Track *thisTrack =
+        pSegment->GetTracks()->GetTrackByNumber(mTrackNum);
+    if (!isAudio && thisTrack->GetType() == 1) { // video
+        // Use the last key frame before the target, which may be a few
+        // clusters back if clusters don't start with one.
+        static const int kMaxClustersBack = 8;
+        for (int i = 0; i < kMaxClustersBack; ++i) {
+            if (seekToKeyFrameInCluster_l(cluster, seekTimeNs)) {
+                *actualFrameTimeUs = (block()->GetTime(mCluster) + 500LL) / 1000LL;
+                ALOGV("Requested seek point: %" PRId64 " actual: %" PRId64,
+                      seekTimeNs / 1000, *actualFrameTimeUs);
+                return;
+            }
+
+            long long clusterTimeNs = cluster->GetTime();
+            const mkvparser::Cluster *prev = pSegment->FindCluster(clusterTimeNs - 1);
+            if (prev == NULL || prev->EOS() || prev == cluster) {
+                break;
+            }
+            cluster = prev;
+        }
+    }
+
+    // Otherwise take the first (key) frame at or after the target.
+    mCluster = cluster;
+    mBlockEntryIndex = 0;
+    for (;;) {
+        advance_l();
+
+        if (eos()) break;
+
+        if (isAudio || block()->IsKey()) {
+            int64_t frameTimeUs = (block()->GetTime(mCluster) + 500LL) / 1000LL;
+            if (frameTimeUs * 1000ll >= seekTimeNs) {
+                *actualFrameTimeUs = frameTimeUs;
+                break;
+            }
+        }
+    }
+}
+
+bool BlockIterator::seekToKeyFrameInCluster_l(
+        const mkvparser::Cluster *cluster, long long seekTimeNs) {
+    long keyIndex = -1;
+    for (long index = 0;;) {
+        const mkvparser::BlockEntry *entry;
+        long res = cluster->GetEntry(index, entry);
+        if (res < 0) {
+            long long pos;
+            long len;
+            if (cluster->Parse(pos, len) < 0) {
+                break;
+            }
+            continue;
+        } else if (res == 0) {
+            break;
+        }
+
+        const mkvparser::Block *block = entry->GetBlock();
+        if (block->GetTrackNumber() == mTrackNum && block->IsKey()) {
+            if (block->GetTime(cluster) > seekTimeNs) {
+                break;
+            }
+            keyIndex = index;
+        }
+        ++index;
+    }
+
+    if (keyIndex < 0) {
+        return false;
+    }
+
+    // advance_l() stops at the first block of the track from mBlockEntryIndex
+    mCluster = cluster;
+    mBlockEntryIndex = keyIndex;
+    advance_l();
+    return !eos();
+}
+
 const mkvparser::Block *BlockIterator::block() const {
     CHECK(!eos());
 
@@ -537,23 +790,61 @@ status_t MatroskaSource::readBlock() {
     int64_t timeUs = mBlockIter.blockTimeUs();
     int frameCount = block->GetFrameCount();
 
+    // Laced frames are stored back to back: read them with a single read,
+    // and hand them out as slices of that buffer.
+    long long blockPos = block->GetFrame(0).pos;
+    size_t blockSize = 0;
+    bool contiguous = true;
     for (int i = 0; i < frameCount; ++i) {
         const mkvparser::Block::Frame &frame = block->GetFrame(i);
+        if (frame.pos != blockPos + (long long)blockSize) {
+            contiguous = false;
+        }
+        blockSize += frame.len;
+    }
 
-        MediaBuffer *mbuf = new MediaBuffer(frame.len);
-        mbuf->meta_data()->setInt64(kKeyTime, timeUs);
-        mbuf->meta_data()->setInt32(kKeyIsSyncFrame, block->IsKey());
-
-        long n = frame.Read(mExtractor->mReader, (unsigned char *)mbuf->data());
-        if (n != 0) {
-            mPendingFrames.clear();
-
+    if (frameCount > 1 && contiguous) {
+        MediaBuffer *mbuf = acquireBuffer(blockSize);
+        if (mExtractor->mReader->Read(
+                    blockPos, blockSize, (unsigned char *)mbuf->data()) != 0) {
             mBlockIter.advance();
             mbuf->release();
             return ERROR_IO;
         }
 
-        mPendingFrames.push_back(mbuf);
+        mbuf->meta_data()->setInt64(kKeyTime, timeUs);
+        mbuf->meta_data()->setInt32(kKeyIsSyncFrame, block->IsKey());
+
+        size_t offset = 0;
+        for (int i = 0; i < frameCount; ++i) {
+            size_t len = block->GetFrame(i).len;
+            MediaBuffer *slice = mbuf->clone();
+            slice->set_range(offset, len);
+            mPendingFrames.push_back(slice);
+            offset += len;
+        }
+
+        // the slices keep the buffer until they are all released
+        mbuf->release();
+    } else {
+        for (int i = 0; i < frameCount; ++i) {
+            const mkvparser::Block::Frame &frame = block->GetFrame(i);
+
+            MediaBuffer *mbuf = acquireBuffer(frame.len);
+            mbuf->meta_data()->setInt64(kKeyTime, timeUs);
+            mbuf->meta_data()->setInt32(kKeyIsSyncFrame, block->IsKey());
+
+            long n = frame.Read(mExtractor->mReader, (unsigned char *)mbuf->data());
+            if (n != 0) {
+                clearPendingFrames();
+
+                mBlockIter.advance();
+                mbuf->release();
+                return ERROR_IO;
+            }
+
+            mPendingFrames.push_back(mbuf);
+        }
     }
 
     mBlockIter.advance();
@@ -733,11 +1024,12 @@ status_t MatroskaSource::read(
 
 ////////////////////////////////////////////////////////////////////////////////
 
-MatroskaExtractor::MatroskaExtractor(const sp<DataSource> &source)
+MatroskaExtractor::MatroskaExtractor(const sp<DataSource> &source, bool metaDataOnly)
     : mDataSource(source),
       mReader(new DataSourceReader(mDataSource)),
       mSegment(NULL),
       mExtractedThumbnails(false),
+      mMetaDataOnly(metaDataOnly),
       mIsWebm(false),
       mSeekPreRollNs(0) {
     off64_t size;
@@ -767,7 +1059,7 @@ MatroskaExtractor::MatroskaExtractor(const sp<DataSource> &source)
 
     // from mkvparser::Segment::Load(), but stop at first cluster
     ret = mSegment->ParseHeaders();
-    if (ret == 0) {
+    if (ret == 0 && !mMetaDataOnly) {
         long len;
         ret = mSegment->LoadCluster(pos, len);
         if (ret >= 1) {
@@ -802,6 +1094,11 @@ MatroskaExtractor::MatroskaExtractor(const sp<DataSource> &source)
 }
 
 MatroskaExtractor::~MatroskaExtractor() {
+    if (mClusterSampler != NULL) {
+        mClusterSampler->requestExitAndWait();
+        mClusterSampler.clear();
+    }
+
     delete mSegment;
     mSegment = NULL;
 
@@ -814,7 +1111,7 @@ size_t MatroskaExtractor::countTracks() {
 }
 
 sp<MediaSource> MatroskaExtractor::getTrack(size_t index) {
-    if (index >= mTracks.size()) {
+    if (index >= mTracks.size() || mMetaDataOnly) {
         return NULL;
     }
 
@@ -828,7 +1125,7 @@ sp<MetaData> MatroskaExtractor::getTrackMetaData(
     }
 
     if ((flags & kIncludeExtensiveMetaData) && !mExtractedThumbnails
-            && !isLiveStreaming()) {
+            && !isLiveStreaming() && !mMetaDataOnly) {
         findThumbnails();
         mExtractedThumbnails = true;
     }
@@ -840,6 +1137,32 @@ bool MatroskaExtractor::isLiveStreaming() const {
     return mIsLiveStreaming;
 }
 
+void MatroskaExtractor::startClusterSampler() {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mClusterSampler != NULL || mSegment == NULL || isLiveStreaming()
+            || (mDataSource->flags() & DataSource::kIsCachingDataSource)) {
+        // reading ahead of playback would compete with it for the network
+        return;
+    }
+
+    if (mSegment->GetCues() != NULL) {
+        return;
+    }
+
+    const mkvparser::SeekHead *pSH = mSegment->GetSeekHead();
+    if (pSH != NULL) {
+        for (long index = 0; index < pSH->GetCount(); ++index) {
+            if (pSH->GetEntry(index)->id == 0x0C53BB6B) { // Cues ID
+                return;
+            }
+        }
+    }
+
+    mClusterSampler = new ClusterSampler(this);
+    mClusterSampler->run("MatroskaClusterSampler", ANDROID_PRIORITY_BACKGROUND);
+}
+
 static int bytesForSize(size_t size) {
     // use at most 28 bits (4 times 7)
     CHECK(size <= 0xfffffff);
@@ -29,11 +29,13 @@ namespace android {
 struct AMessage;
 class String8;
 
+struct ClusterSampler;
 struct DataSourceReader;
 struct MatroskaSource;
 
 struct MatroskaExtractor : public MediaExtractor {
-    MatroskaExtractor(const sp<DataSource> &source);
+    // With metaDataOnly, no cluster is loaded and getTrack() fails.
+    MatroskaExtractor(const sp<DataSource> &source, bool metaDataOnly = false);
 
     virtual size_t countTracks();
 
@@ -52,6 +54,7 @@ protected:
 private:
     friend struct MatroskaSource;
     friend struct BlockIterator;
+    friend struct ClusterSampler;
 
     struct TrackInfo {
         unsigned long mTrackNum;
@@ -70,12 +73,18 @@ private:
     DataSourceReader *mReader;
     mkvparser::Segment *mSegment;
     bool mExtractedThumbnails;
+    bool mMetaDataOnly;
     bool mIsLiveStreaming;
     bool mIsWebm;
     int64_t mSeekPreRollNs;
 
+    // Loads the cluster headers of files without Cues in the background, so
+    // that seeking can binary search them.
+    sp<ClusterSampler> mClusterSampler;
+
     int addTracks();
     void findThumbnails();
+    void startClusterSampler();
 
     bool isLiveStreaming() const;
 
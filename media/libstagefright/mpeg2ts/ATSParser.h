@@ -100,6 +100,10 @@ struct ATSParser : public RefBase {
     status_t feedTSPacket(
             const void *data, size_t size, SyncEvent *event = NULL);
 
+    // Returns the offset of the first sync byte in data that is followed by
+    // sync bytes at the start of the next packets, or -1 if there is none.
+    static ssize_t FindSync(const void *data, size_t size);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -158,6 +162,12 @@ private:
 
     size_t mNumTSPacketsParsed;
 
+    // Bitmap of the PIDs with a PSI section or an elementary stream, so that
+    // packets of other PIDs are dropped without looking them up.
+    enum { kNumPIDs = 8192 };
+    uint32_t mPIDsInUse[kNumPIDs / 32];
+    void updatePIDsInUse();
+
     void parseProgramAssociationTable(ABitReader *br);
     void parseProgramMap(ABitReader *br);
     // Parse PES packet where br is pointing to. If the PES contains a sync
@@ -177,8 +187,8 @@ private:
         SyncEvent *event);
 
     status_t parseAdaptationField(ABitReader *br, unsigned PID);
-    // see feedTSPacket().
-    status_t parseTS(ABitReader *br, SyncEvent *event);
+    // see feedTSPacket(). packet is kTSPacketSize bytes long.
+    status_t parseTS(const uint8_t *packet, SyncEvent *event);
 
     void updatePCR(unsigned PID, uint64_t PCR, size_t byteOffsetFromStart);
 
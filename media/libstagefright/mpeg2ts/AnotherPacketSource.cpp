@@ -216,6 +216,12 @@ status_t AnotherPacketSource::read(
             mediaBuffer->meta_data()->setData(kKeySEI, 0, sei->data(), sei->size());
         }
 
+        sp<ABuffer> ccData;
+        if (buffer->meta()->findBuffer("cc-data", &ccData) && ccData != NULL) {
+            mediaBuffer->meta_data()->setData(
+                    kKeyCCData, 0, ccData->data(), ccData->size());
+        }
+
         *out = mediaBuffer;
         return OK;
     }
@@ -408,6 +414,16 @@ size_t AnotherPacketSource::getAvailableBufferCount(status_t *finalResult) {
     return 0;
 }
 
+size_t AnotherPacketSource::getBufferedBytes() {
+    Mutex::Autolock autoLock(mLock);
+
+    size_t bytes = 0;
+    for (List<sp<ABuffer> >::iterator it = mBuffers.begin(); it != mBuffers.end(); ++it) {
+        bytes += (*it)->size();
+    }
+    return bytes;
+}
+
 int64_t AnotherPacketSource::getBufferedDurationUs(status_t *finalResult) {
     Mutex::Autolock autoLock(mLock);
     *finalResult = mEOSResult;
@@ -48,7 +48,7 @@ sp<MetaData> ElementaryStreamQueue::getFormat() {
 
 void ElementaryStreamQueue::clear(bool clearFormat) {
     if (mBuffer != NULL) {
-        mBuffer->setRange(0, 0);
+        consume(mBuffer->size());
     }
 
     mRangeInfos.clear();
@@ -265,11 +265,9 @@ status_t ElementaryStreamQueue::appendData(
                 uint8_t *ptr = (uint8_t *)data;
 
                 ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
+                size_t prefix = findStartCodePrefix(ptr, size);
+                if (prefix < size) {
+                    startOffset = prefix;
                 }
 
                 if (startOffset < 0) {
@@ -298,11 +296,9 @@ status_t ElementaryStreamQueue::appendData(
                 uint8_t *ptr = (uint8_t *)data;
 
                 ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
+                size_t prefix = findStartCodePrefix(ptr, size);
+                if (prefix < size) {
+                    startOffset = prefix;
                 }
 
                 if (startOffset < 0) {
@@ -428,25 +424,40 @@ status_t ElementaryStreamQueue::appendData(
         }
     }
 
-    size_t neededSize = (mBuffer == NULL ? 0 : mBuffer->size()) + size;
-    if (mBuffer == NULL || neededSize > mBuffer->capacity()) {
-        neededSize = (neededSize + 65535) & ~65535;
+    // Data is only ever appended past the end of mBuffer's range, as access
+    // units taken from the queue may still reference the bytes before it.
+    if (mBuffer == NULL
+            || mBuffer->offset() + mBuffer->size() + size > mBuffer->capacity()) {
+        size_t neededSize = (mBuffer == NULL ? 0 : mBuffer->size()) + size;
 
-        ALOGV("resizing buffer to size %zu", neededSize);
-
-        sp<ABuffer> buffer = new ABuffer(neededSize);
-        if (mBuffer != NULL) {
-            memcpy(buffer->data(), mBuffer->data(), mBuffer->size());
-            buffer->setRange(0, mBuffer->size());
+        if (mBuffer != NULL && mBuffer->getStrongCount() == 1
+                && neededSize <= mBuffer->capacity()) {
+            // No access unit references this buffer anymore, move the
+            // partial access unit left over to the front and reuse it.
+            memmove(mBuffer->base(), mBuffer->data(), mBuffer->size());
+            mBuffer->setRange(0, mBuffer->size());
         } else {
-            buffer->setRange(0, 0);
-        }
+            neededSize = (neededSize + 65535) & ~65535;
+            if (mBuffer != NULL && neededSize < mBuffer->capacity()) {
+                neededSize = mBuffer->capacity();
+            }
 
-        mBuffer = buffer;
+            ALOGV("allocating buffer of size %zu", neededSize);
+
+            sp<ABuffer> buffer = new ABuffer(neededSize);
+            if (mBuffer != NULL) {
+                memcpy(buffer->data(), mBuffer->data(), mBuffer->size());
+                buffer->setRange(0, mBuffer->size());
+            } else {
+                buffer->setRange(0, 0);
+            }
+
+            mBuffer = buffer;
+        }
     }
 
     memcpy(mBuffer->data() + mBuffer->size(), data, size);
-    mBuffer->setRange(0, mBuffer->size() + size);
+    mBuffer->setRange(mBuffer->offset(), mBuffer->size() + size);
 
     RangeInfo info;
     info.mLength = size;
@@ -472,16 +483,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
         RangeInfo info = *mRangeInfos.begin();
         mRangeInfos.erase(mRangeInfos.begin());
 
-        sp<ABuffer> accessUnit = new ABuffer(info.mLength);
-        memcpy(accessUnit->data(), mBuffer->data(), info.mLength);
+        sp<ABuffer> accessUnit = takeAccessUnit(info.mLength);
         accessUnit->meta()->setInt64("timeUs", info.mTimestampUs);
 
-        memmove(mBuffer->data(),
-                mBuffer->data() + info.mLength,
-                mBuffer->size() - info.mLength);
-
-        mBuffer->setRange(0, mBuffer->size() - info.mLength);
-
         if (mFormat == NULL) {
             mFormat = MakeAVCCodecSpecificData(accessUnit);
         }
@@ -541,24 +545,16 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAC3() {
         mFormat = format;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(syncStartPos + payloadSize);
-    memcpy(accessUnit->data(), mBuffer->data(), syncStartPos + payloadSize);
-
     int64_t timeUs = fetchTimestamp(syncStartPos + payloadSize);
     if (timeUs < 0ll) {
         ALOGE("negative timeUs");
         return NULL;
     }
+
+    sp<ABuffer> accessUnit = takeAccessUnit(syncStartPos + payloadSize);
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + syncStartPos + payloadSize,
-            mBuffer->size() - syncStartPos - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - syncStartPos - payloadSize);
-
     return accessUnit;
 }
 
@@ -603,14 +599,16 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(payloadSize);
-    memcpy(accessUnit->data(), mBuffer->data() + 4, payloadSize);
-
     int64_t timeUs = fetchTimestamp(payloadSize + 4);
     if (timeUs < 0ll) {
         ALOGE("Negative timeUs");
         return NULL;
     }
+
+    // the samples are byte swapped in place, the queue is done with them
+    sp<ABuffer> accessUnit = ABuffer::CreateSlice(mBuffer, 4, payloadSize);
+    consume(4 + payloadSize);
+
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
@@ -619,13 +617,6 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         ptr[i] = ntohs(ptr[i]);
     }
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + 4 + payloadSize,
-            mBuffer->size() - 4 - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - 4 - payloadSize);
-
     return accessUnit;
 }
 
@@ -737,12 +728,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
 
     int64_t timeUs = fetchTimestamp(offset);
 
-    sp<ABuffer> accessUnit = new ABuffer(offset);
-    memcpy(accessUnit->data(), mBuffer->data(), offset);
-
-    memmove(mBuffer->data(), mBuffer->data() + offset,
-            mBuffer->size() - offset);
-    mBuffer->setRange(0, mBuffer->size() - offset);
+    sp<ABuffer> accessUnit = takeAccessUnit(offset);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
@@ -750,6 +736,16 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
     return accessUnit;
 }
 
+void ElementaryStreamQueue::consume(size_t size) {
+    mBuffer->setRange(mBuffer->offset() + size, mBuffer->size() - size);
+}
+
+sp<ABuffer> ElementaryStreamQueue::takeAccessUnit(size_t size) {
+    sp<ABuffer> accessUnit = ABuffer::CreateSlice(mBuffer, 0, size);
+    consume(size);
+    return accessUnit;
+}
+
 int64_t ElementaryStreamQueue::fetchTimestamp(size_t size) {
     int64_t timeUs = -1;
     bool first = true;
@@ -793,6 +789,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
 
     size_t totalSize = 0;
     size_t seiCount = 0;
+    size_t seiBytes = 0;
 
     status_t err;
     const uint8_t *nalStart;
@@ -829,6 +826,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
         } else if (nalType == 6 && nalSize > 0) {
             // found non-zero sized SEI
             ++seiCount;
+            seiBytes += nalSize;
         }
 
         if (flush) {
@@ -836,12 +834,34 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             // the current one, separated by 0x00 0x00 0x00 0x01 startcodes.
 
             size_t auSize = 4 * nals.size() + totalSize;
-            sp<ABuffer> accessUnit = new ABuffer(auSize);
+
+            // If every nal unit already has a 4 byte startcode and they are
+            // back to back, the access unit is a slice of mBuffer as is.
+            const NALPosition &firstPos = nals.itemAt(0);
+            size_t auOffset = firstPos.nalOffset - 4;
+            bool contiguous = firstPos.nalOffset >= 4;
+            for (size_t i = 0, expected = auOffset; contiguous && i < nals.size(); ++i) {
+                const NALPosition &pos = nals.itemAt(i);
+                contiguous = pos.nalOffset == expected + 4
+                        && !memcmp(mBuffer->data() + expected, "\x00\x00\x00\x01", 4);
+                expected = pos.nalOffset + pos.nalSize;
+            }
+
+            sp<ABuffer> accessUnit = contiguous
+                    ? ABuffer::CreateSlice(mBuffer, auOffset, auSize)
+                    : new ABuffer(auSize);
             sp<ABuffer> sei;
+            sp<ABuffer> ccData;
 
             if (seiCount > 0) {
                 sei = new ABuffer(seiCount * sizeof(NALPosition));
                 accessUnit->meta()->setBuffer("sei", sei);
+
+                // Pull out the closed captions while the SEI is in cache,
+                // so that the player does not have to parse it again.
+                ccData = new ABuffer(seiBytes);
+                ccData->setRange(0, 0);
+                accessUnit->meta()->setBuffer("cc-data", ccData);
             }
 
 #if !LOG_NDEBUG
@@ -863,6 +883,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
                     NALPosition &seiPos = ((NALPosition *)sei->data())[seiIndex++];
                     seiPos.nalOffset = dstOffset + 4;
                     seiPos.nalSize = pos.nalSize;
+
+                    ExtractCEA608FromSEI(
+                            mBuffer->data() + pos.nalOffset, pos.nalSize, ccData);
                 }
 
 #if !LOG_NDEBUG
@@ -874,11 +897,13 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
                 out.append(tmp);
 #endif
 
-                memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
+                if (!contiguous) {
+                    memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
 
-                memcpy(accessUnit->data() + dstOffset + 4,
-                       mBuffer->data() + pos.nalOffset,
-                       pos.nalSize);
+                    memcpy(accessUnit->data() + dstOffset + 4,
+                           mBuffer->data() + pos.nalOffset,
+                           pos.nalSize);
+                }
 
                 dstOffset += pos.nalSize + 4;
             }
@@ -890,11 +915,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             const NALPosition &pos = nals.itemAt(nals.size() - 1);
             size_t nextScan = pos.nalOffset + pos.nalSize;
 
-            memmove(mBuffer->data(),
-                    mBuffer->data() + nextScan,
-                    mBuffer->size() - nextScan);
-
-            mBuffer->setRange(0, mBuffer->size() - nextScan);
+            consume(nextScan);
 
             int64_t timeUs = fetchTimestamp(nextScan);
             if (timeUs < 0ll) {
@@ -955,14 +976,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGAudio() {
 
     unsigned layer = 4 - ((header >> 17) & 3);
 
-    sp<ABuffer> accessUnit = new ABuffer(frameSize);
-    memcpy(accessUnit->data(), data, frameSize);
-
-    memmove(mBuffer->data(),
-            mBuffer->data() + frameSize,
-            mBuffer->size() - frameSize);
-
-    mBuffer->setRange(0, mBuffer->size() - frameSize);
+    sp<ABuffer> accessUnit = takeAccessUnit(frameSize);
 
     int64_t timeUs = fetchTimestamp(frameSize);
     if (timeUs < 0ll) {
@@ -1067,11 +1081,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
         currentStartCode = data[offset + 3];
 
         if (currentStartCode == 0xb3 && mFormat == NULL) {
-            memmove(mBuffer->data(), mBuffer->data() + offset, size - offset);
+            consume(offset);
+            data = mBuffer->data();
             size -= offset;
             (void)fetchTimestamp(offset);
             offset = 0;
-            mBuffer->setRange(0, size);
         }
 
         if ((prevStartCode == 0xb3 && currentStartCode != 0xb5)
@@ -1100,11 +1114,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> csd = new ABuffer(offset);
                 memcpy(csd->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                consume(offset);
+                data = mBuffer->data();
                 size -= offset;
                 (void)fetchTimestamp(offset);
                 offset = 0;
@@ -1132,14 +1143,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
             if (!sawPictureStart) {
                 sawPictureStart = true;
             } else {
-                sp<ABuffer> accessUnit = new ABuffer(offset);
-                memcpy(accessUnit->data(), data, offset);
-
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                sp<ABuffer> accessUnit = takeAccessUnit(offset);
 
                 int64_t timeUs = fetchTimestamp(offset);
                 if (timeUs < 0ll) {
@@ -1313,12 +1317,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
                     offset += chunkSize;
 
-                    sp<ABuffer> accessUnit = new ABuffer(offset);
-                    memcpy(accessUnit->data(), data, offset);
-
-                    memmove(data, &data[offset], size - offset);
-                    size -= offset;
-                    mBuffer->setRange(0, size);
+                    sp<ABuffer> accessUnit = takeAccessUnit(offset);
 
                     int64_t timeUs = fetchTimestamp(offset);
                     if (timeUs < 0ll) {
@@ -1354,10 +1353,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
         if (discard) {
             (void)fetchTimestamp(offset);
-            memmove(data, &data[offset], size - offset);
+            consume(offset);
+            data = mBuffer->data();
             size -= offset;
             offset = 0;
-            mBuffer->setRange(0, size);
         } else {
             offset += chunkSize;
         }
@@ -1384,13 +1383,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMetadata() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(size);
     int64_t timeUs = fetchTimestamp(size);
+    sp<ABuffer> accessUnit = takeAccessUnit(size);
     accessUnit->meta()->setInt64("timeUs", timeUs);
 
-    memcpy(accessUnit->data(), mBuffer->data(), size);
-    mBuffer->setRange(0, 0);
-
     if (mFormat == NULL) {
         mFormat = new MetaData;
         mFormat->setCString(kKeyMIMEType, MEDIA_MIMETYPE_DATA_TIMED_ID3);
@@ -82,6 +82,13 @@ private:
     // returns its timestamp in us (or -1 if no time information).
     int64_t fetchTimestamp(size_t size);
 
+    // Drops the first "size" bytes of mBuffer without moving the rest.
+    void consume(size_t size);
+
+    // Returns the first "size" bytes of mBuffer as an access unit referencing
+    // mBuffer's memory, and drops them from the queue.
+    sp<ABuffer> takeAccessUnit(size_t size);
+
     DISALLOW_EVIL_CONSTRUCTORS(ElementaryStreamQueue);
 };
 
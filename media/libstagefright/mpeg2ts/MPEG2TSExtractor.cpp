@@ -41,6 +41,23 @@ namespace android {
 
 static const size_t kTSPacketSize = 188;
 
+// Packets are read from the data source this many at a time.
+static const size_t kReadBlockSize = 128 * kTSPacketSize;
+
+// Seeks this far past the scanned part of the stream locate their target by
+// bisecting the file on PTS, instead of demuxing everything in between.
+static const int64_t kMinBisectionSeekUs = 10000000ll;
+
+// Bisection lands this far before the target, so that the sync frame
+// preceding it is scanned.
+static const int64_t kBisectionMarginUs = 3000000ll;
+
+// Bisection stops once the range left is this small.
+static const off64_t kMinBisectionRange = 256 * 1024;
+
+// Maximum number of bytes scanned for a PES header at a bisection point.
+static const size_t kMaxPESSearchSize = 1024 * 1024;
+
 struct MPEG2TSSource : public MediaSource {
     MPEG2TSSource(
             const sp<MPEG2TSExtractor> &extractor,
@@ -112,7 +129,14 @@ status_t MPEG2TSSource::read(
 MPEG2TSExtractor::MPEG2TSExtractor(const sp<DataSource> &source)
     : mDataSource(source),
       mParser(new ATSParser),
-      mOffset(0) {
+      mOffset(0),
+      mReadBuffer(new ABuffer(kReadBlockSize)),
+      mReadBufferOffset(0),
+      mReadBufferSize(0),
+      mSyncPointsFromStart(true),
+      mSeekPID(-1),
+      mSeekBasePTS(0),
+      mSeekBaseTimeUs(0) {
     init();
 }
 
@@ -245,22 +269,56 @@ void MPEG2TSExtractor::init() {
             haveAudio, haveVideo, ALooper::GetNowUs() - startTime);
 }
 
+status_t MPEG2TSExtractor::fillReadBuffer() {
+    if (mOffset >= mReadBufferOffset
+            && mOffset + (off64_t)kTSPacketSize
+                <= mReadBufferOffset + (off64_t)mReadBufferSize) {
+        return OK;
+    }
+
+    ssize_t n = mDataSource->readAt(mOffset, mReadBuffer->data(), kReadBlockSize);
+
+    if (n < 0) {
+        mReadBufferSize = 0;
+        return n;
+    }
+
+    mReadBufferOffset = mOffset;
+    mReadBufferSize = n;
+
+    return (n < (ssize_t)kTSPacketSize) ? ERROR_END_OF_STREAM : OK;
+}
+
 status_t MPEG2TSExtractor::feedMore() {
     Mutex::Autolock autoLock(mLock);
 
-    uint8_t packet[kTSPacketSize];
-    ssize_t n = mDataSource->readAt(mOffset, packet, kTSPacketSize);
-
-    if (n < (ssize_t)kTSPacketSize) {
-        if (n >= 0) {
+    status_t err = fillReadBuffer();
+    if (err != OK) {
+        if (err == ERROR_END_OF_STREAM) {
             mParser->signalEOS(ERROR_END_OF_STREAM);
         }
-        return (n < 0) ? (status_t)n : ERROR_END_OF_STREAM;
+        return err;
+    }
+
+    const uint8_t *packet = mReadBuffer->data() + (mOffset - mReadBufferOffset);
+
+    if (packet[0] != 0x47) {
+        // Lost sync, skip ahead to where the packets resume instead of
+        // failing the whole stream.
+        size_t available = mReadBufferOffset + mReadBufferSize - mOffset;
+        ssize_t skip = ATSParser::FindSync(packet, available);
+        if (skip < 0) {
+            skip = available;
+        }
+        ALOGW("lost sync at offset %lld, skipping %zd bytes",
+                (long long)mOffset, skip);
+        mOffset += skip;
+        return OK;
     }
 
     ATSParser::SyncEvent event(mOffset);
-    mOffset += n;
-    status_t err = mParser->feedTSPacket(packet, kTSPacketSize, &event);
+    mOffset += kTSPacketSize;
+    err = mParser->feedTSPacket(packet, kTSPacketSize, &event);
     if (event.isInit()) {
         for (size_t i = 0; i < mSourceImpls.size(); ++i) {
             if (mSourceImpls[i].get() == event.getMediaSource().get()) {
@@ -296,6 +354,16 @@ status_t MPEG2TSExtractor::seek(int64_t seekTimeUs,
         return OK;
     }
 
+    if (shouldSeekByBisection(seekTimeUs)) {
+        status_t err = seekByBisection(seekTimeUs);
+        if (err != OK) {
+            return err;
+        }
+        if (mSeekSyncPoints->isEmpty()) {
+            return ERROR_END_OF_STREAM;
+        }
+    }
+
     // Determine whether we're seeking beyond the known area.
     bool shouldSeekBeyond =
             (seekTimeUs > mSeekSyncPoints->keyAt(mSeekSyncPoints->size() - 1));
@@ -444,6 +512,194 @@ status_t MPEG2TSExtractor::seekBeyond(int64_t seekTimeUs) {
     return OK;
 }
 
+bool MPEG2TSExtractor::shouldSeekByBisection(int64_t seekTimeUs) {
+    off64_t size;
+    if (mDataSource->getSize(&size) != OK) {
+        return false;
+    }
+
+    if (seekTimeUs > mSeekSyncPoints->keyAt(mSeekSyncPoints->size() - 1)
+            + kMinBisectionSeekUs) {
+        return true;
+    }
+
+    // sync points since the last bisection don't tell what precedes them
+    return !mSyncPointsFromStart && seekTimeUs < mSeekSyncPoints->keyAt(0);
+}
+
+status_t MPEG2TSExtractor::findPESAt(
+        off64_t offset, size_t maxBytes,
+        off64_t *pesOffset, uint64_t *PTS, unsigned *PID) {
+    sp<ABuffer> buffer = new ABuffer(kReadBlockSize);
+
+    size_t scanned = 0;
+    while (scanned < maxBytes) {
+        ssize_t n = mDataSource->readAt(offset, buffer->data(), kReadBlockSize);
+        if (n < (ssize_t)kTSPacketSize) {
+            return n < 0 ? (status_t)n : ERROR_END_OF_STREAM;
+        }
+
+        const uint8_t *data = buffer->data();
+        ssize_t start = ATSParser::FindSync(data, n);
+        if (start < 0) {
+            start = n - kTSPacketSize + 1;
+        }
+
+        size_t pos = start;
+        for (; pos + kTSPacketSize <= (size_t)n; pos += kTSPacketSize) {
+            const uint8_t *packet = &data[pos];
+            if (packet[0] != 0x47) {
+                break;
+            }
+
+            unsigned packetPID = ((packet[1] & 0x1f) << 8) | packet[2];
+            bool payloadStart = (packet[1] & 0x40) != 0;
+            unsigned adaptationFieldControl = (packet[3] >> 4) & 3;
+            if ((packet[1] & 0x80) || !payloadStart || !(adaptationFieldControl & 1)
+                    || (mSeekPID >= 0 && packetPID != (unsigned)mSeekPID)) {
+                continue;
+            }
+
+            size_t headerSize = 4;
+            if (adaptationFieldControl & 2) {
+                headerSize += 1 + packet[4];
+            }
+            if (headerSize + 14 > kTSPacketSize) {
+                continue;
+            }
+
+            const uint8_t *pes = packet + headerSize;
+            if (memcmp(pes, "\x00\x00\x01", 3)
+                    || (pes[6] & 0xc0) != 0x80      // no optional PES header
+                    || !(pes[7] & 0x80)) {          // no PTS
+                continue;
+            }
+
+            *PTS = ((uint64_t)((pes[9] >> 1) & 7) << 30)
+                | ((uint64_t)pes[10] << 22)
+                | ((uint64_t)(pes[11] >> 1) << 15)
+                | ((uint64_t)pes[12] << 7)
+                | (pes[13] >> 1);
+            *pesOffset = offset + pos;
+            *PID = packetPID;
+            return OK;
+        }
+
+        offset += pos;
+        scanned += pos;
+    }
+
+    return NAME_NOT_FOUND;
+}
+
+status_t MPEG2TSExtractor::calibrateSeekPTS() {
+    // The sync points recorded by feedMore() are the offsets of the PES
+    // packets starting sync frames of the seek reference track.
+    off64_t offset = mSeekSyncPoints->valueAt(0);
+    off64_t pesOffset;
+    uint64_t PTS;
+    unsigned PID;
+    status_t err = findPESAt(offset, kTSPacketSize, &pesOffset, &PTS, &PID);
+    if (err != OK || pesOffset != offset) {
+        ALOGW("no PES header at sync point offset %lld", (long long)offset);
+        return err != OK ? err : ERROR_MALFORMED;
+    }
+
+    mSeekPID = PID;
+    mSeekBasePTS = PTS;
+    mSeekBaseTimeUs = mSeekSyncPoints->keyAt(0);
+    return OK;
+}
+
+status_t MPEG2TSExtractor::seekByBisection(int64_t seekTimeUs) {
+    if (mSeekPID < 0) {
+        status_t err = calibrateSeekPTS();
+        if (err != OK) {
+            return OK;  // fall back to scanning
+        }
+    }
+
+    off64_t size;
+    if (mDataSource->getSize(&size) != OK) {
+        return OK;
+    }
+
+    int64_t targetTimeUs = seekTimeUs - kBisectionMarginUs;
+
+    off64_t lo = 0;
+    off64_t hi = size;
+    off64_t landingOffset = -1;
+    int64_t landingTimeUs = 0;
+    size_t numReads = 0;
+    while (hi - lo > kMinBisectionRange) {
+        off64_t mid = lo + (hi - lo) / 2;
+
+        off64_t pesOffset;
+        uint64_t PTS;
+        unsigned PID;
+        ++numReads;
+        if (findPESAt(mid, kMaxPESSearchSize, &pesOffset, &PTS, &PID) != OK
+                || pesOffset >= hi) {
+            hi = mid;
+            continue;
+        }
+
+        // 33 bit PTS difference from the calibration point, in [-2^32, 2^32)
+        int64_t diff = (int64_t)(((PTS - mSeekBasePTS) + (1ull << 32))
+                & ((1ull << 33) - 1)) - (1ll << 32);
+        int64_t timeUs = mSeekBaseTimeUs + diff * 100 / 9;
+
+        if (timeUs <= targetTimeUs) {
+            landingOffset = pesOffset;
+            landingTimeUs = timeUs;
+            lo = pesOffset + kTSPacketSize;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (landingOffset < 0) {
+        // the target precedes everything probed, start over
+        off64_t pesOffset;
+        uint64_t PTS;
+        unsigned PID;
+        if (findPESAt(0, kMaxPESSearchSize, &pesOffset, &PTS, &PID) != OK) {
+            return OK;
+        }
+        int64_t diff = (int64_t)(((PTS - mSeekBasePTS) + (1ull << 32))
+                & ((1ull << 33) - 1)) - (1ll << 32);
+        landingOffset = pesOffset;
+        landingTimeUs = mSeekBaseTimeUs + diff * 100 / 9;
+    }
+
+    ALOGV("bisection seek to %lld us: landed at %lld us, offset %lld after %zu reads",
+            (long long)seekTimeUs, (long long)landingTimeUs,
+            (long long)landingOffset, numReads);
+
+    // What was known about sync points no longer connects to where the
+    // stream is demuxed from now on.
+    for (size_t i = 0; i < mSyncPoints.size(); ++i) {
+        mSyncPoints.editItemAt(i).clear();
+    }
+    mSyncPointsFromStart = landingOffset == 0;
+
+    mOffset = landingOffset;
+    status_t err = queueDiscontinuityForSeek(landingTimeUs);
+    if (err != OK) {
+        return err;
+    }
+
+    // seek() continues from the first sync point after the landing point
+    while (mSeekSyncPoints->isEmpty()) {
+        err = feedMore();
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    return OK;
+}
+
 status_t MPEG2TSExtractor::feedUntilBufferAvailable(
         const sp<AnotherPacketSource> &impl) {
     status_t finalResult;
@@ -465,10 +721,12 @@ status_t MPEG2TSExtractor::feedUntilBufferAvailable(
 bool SniffMPEG2TS(
         const sp<DataSource> &source, String8 *mimeType, float *confidence,
         sp<AMessage> *) {
+    uint8_t header[kTSPacketSize * 4 + 1];
+    if (source->readAt(0, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        return false;
+    }
     for (int i = 0; i < 5; ++i) {
-        char header;
-        if (source->readAt(kTSPacketSize * i, &header, 1) != 1
-                || header != 0x47) {
+        if (header[kTSPacketSize * i] != 0x47) {
             return false;
         }
     }
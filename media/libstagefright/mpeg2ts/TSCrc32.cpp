@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "TSCrc32.h"
+
+#include <pthread.h>
+
+namespace android {
+
+static const uint32_t kPolynomial = 0x04C11DB7;
+
+// sTables[k][b] is the CRC of the byte b followed by k zero bytes.
+static uint32_t sTables[4][256];
+static pthread_once_t sTablesOnce = PTHREAD_ONCE_INIT;
+
+static void initTables() {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i << 24;
+        for (int j = 0; j < 8; ++j) {
+            crc = (crc << 1) ^ ((crc & 0x80000000) ? kPolynomial : 0);
+        }
+        sTables[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (int k = 1; k < 4; ++k) {
+            const uint32_t prev = sTables[k - 1][i];
+            sTables[k][i] = (prev << 8) ^ sTables[0][prev >> 24];
+        }
+    }
+}
+
+uint32_t ComputeTSCrc32(const uint8_t *data, size_t size) {
+    pthread_once(&sTablesOnce, initTables);
+
+    uint32_t crc = 0xffffffff;
+    for (; size >= 4; data += 4, size -= 4) {
+        crc ^= ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16)
+                | ((uint32_t)data[2] << 8) | data[3];
+        crc = sTables[3][crc >> 24] ^ sTables[2][(crc >> 16) & 0xff]
+                ^ sTables[1][(crc >> 8) & 0xff] ^ sTables[0][crc & 0xff];
+    }
+    for (; size > 0; ++data, --size) {
+        crc = (crc << 8) ^ sTables[0][((crc >> 24) ^ *data) & 0xff];
+    }
+    return crc;
+}
+
+}  // namespace android
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TS_CRC32_H_
+
+#define TS_CRC32_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// CRC32 of the MPEG-2 systems spec (polynomial 0x04C11DB7, initial value 0xffffffff, no
+// reflection, no final xor), used by the PSI sections of transport streams. Running it over a
+// complete section, including its trailing CRC, yields 0.
+//
+// This is the MSB first variant, so the CRC32 instructions of ARMv8 and SSE4.2, which compute
+// the reflected CRC32 and CRC32C, cannot be used. Four bytes are consumed per step with
+// slicing-by-4 tables instead.
+uint32_t ComputeTSCrc32(const uint8_t *data, size_t size);
+
+}  // namespace android
+
+#endif  // TS_CRC32_H_
@@ -9,6 +9,7 @@ LOCAL_SRC_FILES:=                     \
         OMXNodeInstance.cpp           \
         SimpleSoftOMXComponent.cpp    \
         SoftOMXComponent.cpp          \
+        SoftOMXLooperPool.cpp         \
         SoftOMXPlugin.cpp             \
         SoftVideoDecoderOMXComponent.cpp \
         SoftVideoEncoderOMXComponent.cpp \
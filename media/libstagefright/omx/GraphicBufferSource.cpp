@@ -127,6 +127,11 @@ GraphicBufferSource::GraphicBufferSource(
     mPrevOriginalTimeUs(-1ll),
     mPrevModifiedTimeUs(-1ll),
     mSkipFramesBeforeNs(-1ll),
+    mMaxLatencyUs(-1ll),
+    mNumFramesSubmitted(0),
+    mNumFramesRepeated(0),
+    mNumFramesDroppedForRate(0),
+    mNumFramesDroppedForLatency(0),
     mRepeatAfterUs(-1ll),
     mRepeatLastFrameGeneration(0),
     mRepeatLastFrameTimestamp(-1ll),
@@ -193,6 +198,11 @@ GraphicBufferSource::GraphicBufferSource(
 }
 
 GraphicBufferSource::~GraphicBufferSource() {
+    if (mNumFramesSubmitted > 0) {
+        ALOGI("frames submitted %u, repeated %u, dropped for rate %u, dropped for latency %u",
+                mNumFramesSubmitted, mNumFramesRepeated,
+                mNumFramesDroppedForRate, mNumFramesDroppedForLatency);
+    }
     if (mLatestBufferId >= 0) {
         releaseBuffer(
                 mLatestBufferId, mLatestBufferFrameNum,
@@ -540,6 +550,8 @@ bool GraphicBufferSource::fillCodecBuffer_l() {
     // is queued after the specified start time
     bool dropped = false;
     if (mSkipFramesBeforeNs < 0ll || item.mTimestamp >= mSkipFramesBeforeNs) {
+        const int64_t queuedNs = item.mTimestamp;
+
         // if start time is set, offset time stamp by start time
         if (mSkipFramesBeforeNs > 0) {
             item.mTimestamp -= mSkipFramesBeforeNs;
@@ -551,8 +563,17 @@ bool GraphicBufferSource::fillCodecBuffer_l() {
             // set err to OK so that the skipped frame can still be saved as the lastest frame
             err = OK;
             dropped = true;
+            ++mNumFramesDroppedForRate;
+        } else if (isFrameLate_l(queuedNs)) {
+            ALOGV("skipping frame (%lld) to meet max latency", static_cast<long long>(timeUs));
+            err = OK;
+            dropped = true;
+            ++mNumFramesDroppedForLatency;
         } else {
             err = submitBuffer_l(item, cbi);
+            if (err == OK) {
+                ++mNumFramesSubmitted;
+            }
         }
     }
 
@@ -612,6 +633,7 @@ bool GraphicBufferSource::repeatLatestBuffer_l() {
     }
 
     ++mLatestBufferUseCount;
+    ++mNumFramesRepeated;
 
     /* repeat last frame up to kRepeatLastFrameCount times.
      * in case of static scene, a single repeat might not get rid of encoder
@@ -967,6 +989,46 @@ status_t GraphicBufferSource::setMaxFps(float maxFps) {
     return OK;
 }
 
+status_t GraphicBufferSource::setMaxLatencyUs(int64_t maxLatencyUs) {
+    Mutex::Autolock autoLock(mMutex);
+
+    if (mExecuting) {
+        return INVALID_OPERATION;
+    }
+
+    mMaxLatencyUs = maxLatencyUs;
+    return OK;
+}
+
+bool GraphicBufferSource::isFrameLate_l(int64_t queuedNs) const {
+    // The newest frame is always encoded, only frames that newer ones have
+    // already caught up with are dropped.
+    if (mMaxLatencyUs <= 0 || mNumFramesAvailable == 0) {
+        return false;
+    }
+    // Producers normally stamp frames with the monotonic clock. Timestamps
+    // that are in the future or implausibly old come from another time base,
+    // and say nothing about latency.
+    static const int64_t kMaxPlausibleAgeNs = 10000000000ll;
+    const int64_t ageNs = systemTime(SYSTEM_TIME_MONOTONIC) - queuedNs;
+    return ageNs > mMaxLatencyUs * 1000ll && ageNs < kMaxPlausibleAgeNs;
+}
+
+void GraphicBufferSource::resetEndOfStream() {
+    Mutex::Autolock autoLock(mMutex);
+    ALOGV("resetEndOfStream: eos=%d eosSent=%d", mEndOfStream, mEndOfStreamSent);
+
+    mEndOfStream = false;
+    mEndOfStreamSent = false;
+
+    // The next stream starts over, so do not cap or rebase its timestamps
+    // against the previous one.
+    mPrevOriginalTimeUs = -1ll;
+    mPrevModifiedTimeUs = -1ll;
+    mPrevCaptureUs = -1ll;
+    mPrevFrameUs = -1ll;
+}
+
 void GraphicBufferSource::setSkipFramesBeforeUs(int64_t skipFramesBeforeUs) {
     Mutex::Autolock autoLock(mMutex);
 
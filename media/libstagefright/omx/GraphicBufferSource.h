@@ -105,6 +105,10 @@ public:
     // have a codec buffer ready, we just set the mEndOfStream flag.
     status_t signalEndOfInputStream();
 
+    // Clears a previous signalEndOfInputStream() once the codec has been
+    // flushed, so that the same encoder and buffers can take a new stream.
+    void resetEndOfStream();
+
     // If suspend is true, all incoming buffers (including those currently
     // in the BufferQueue) will be discarded until the suspension is lifted.
     void suspend(bool suspend);
@@ -130,6 +134,12 @@ public:
     // When set, the max frame rate fed to the encoder will be capped at maxFps.
     status_t setMaxFps(float maxFps);
 
+    // When set, a frame that has been queued for longer than maxLatencyUs is
+    // dropped if newer frames are already waiting, so that a busy encoder
+    // catches up with the producer instead of accumulating latency.  This is
+    // meant for live sources such as screen recording and Wi-Fi Display.
+    status_t setMaxLatencyUs(int64_t maxLatencyUs);
+
     // Sets the time lapse (or slow motion) parameters.
     // data[0] is the time (us) between two frames for playback
     // data[1] is the time (us) between two frames for capture
@@ -238,6 +248,10 @@ private:
     bool repeatLatestBuffer_l();
     int64_t getTimestamp(const BufferItem &item);
 
+    // Returns true if a frame queued at queuedNs exceeds the max latency
+    // while newer frames are waiting.
+    bool isFrameLate_l(int64_t queuedNs) const;
+
     // Lock, covers all member variables.
     mutable Mutex mMutex;
 
@@ -297,6 +311,14 @@ private:
 
     sp<FrameDropper> mFrameDropper;
 
+    int64_t mMaxLatencyUs;
+
+    // Frame statistics, logged when the source is destroyed.
+    uint32_t mNumFramesSubmitted;
+    uint32_t mNumFramesRepeated;
+    uint32_t mNumFramesDroppedForRate;
+    uint32_t mNumFramesDroppedForLatency;
+
     sp<ALooper> mLooper;
     sp<AHandlerReflector<GraphicBufferSource> > mReflector;
 
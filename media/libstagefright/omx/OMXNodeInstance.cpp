@@ -1461,6 +1461,8 @@ inline static const char *asString(IOMX::InternalOptionType i, const char *def =
         case IOMX::INTERNAL_OPTION_MAX_FPS:           return "MAX_FPS";
         case IOMX::INTERNAL_OPTION_START_TIME:        return "START_TIME";
         case IOMX::INTERNAL_OPTION_TIME_LAPSE:        return "TIME_LAPSE";
+        case IOMX::INTERNAL_OPTION_MAX_LATENCY:       return "MAX_LATENCY";
+        case IOMX::INTERNAL_OPTION_RESET_END_OF_STREAM: return "RESET_END_OF_STREAM";
         default:                                      return def;
     }
 }
@@ -1479,6 +1481,8 @@ status_t OMXNodeInstance::setInternalOption(
         case IOMX::INTERNAL_OPTION_MAX_FPS:
         case IOMX::INTERNAL_OPTION_START_TIME:
         case IOMX::INTERNAL_OPTION_TIME_LAPSE:
+        case IOMX::INTERNAL_OPTION_MAX_LATENCY:
+        case IOMX::INTERNAL_OPTION_RESET_END_OF_STREAM:
         {
             const sp<GraphicBufferSource> &bufferSource =
                 getGraphicBufferSource();
@@ -1530,6 +1534,21 @@ status_t OMXNodeInstance::setInternalOption(
                 int64_t skipFramesBeforeUs = *(int64_t *)data;
                 CLOG_CONFIG(setInternalOption, "beforeUs=%lld", (long long)skipFramesBeforeUs);
                 bufferSource->setSkipFramesBeforeUs(skipFramesBeforeUs);
+            } else if (type == IOMX::INTERNAL_OPTION_MAX_LATENCY) {
+                if (size != sizeof(int64_t)) {
+                    return INVALID_OPERATION;
+                }
+
+                int64_t maxLatencyUs = *(int64_t *)data;
+                CLOG_CONFIG(setInternalOption, "maxLatencyUs=%lld", (long long)maxLatencyUs);
+                return bufferSource->setMaxLatencyUs(maxLatencyUs);
+            } else if (type == IOMX::INTERNAL_OPTION_RESET_END_OF_STREAM) {
+                if (size != sizeof(bool)) {
+                    return INVALID_OPERATION;
+                }
+
+                CLOG_CONFIG(setInternalOption, "resetEndOfStream");
+                bufferSource->resetEndOfStream();
             } else { // IOMX::INTERNAL_OPTION_TIME_LAPSE
                 if (size != sizeof(int64_t) * 2) {
                     return INVALID_OPERATION;
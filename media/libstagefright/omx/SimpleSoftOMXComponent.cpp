@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include "include/SimpleSoftOMXComponent.h"
+#include "SoftOMXLooperPool.h"
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -32,10 +33,18 @@ SimpleSoftOMXComponent::SimpleSoftOMXComponent(
         OMX_PTR appData,
         OMX_COMPONENTTYPE **component)
     : SoftOMXComponent(name, callbacks, appData, component),
-      mLooper(new ALooper),
+      mPooledLooper(SoftOMXLooperPool::isEnabled()),
+      mDestroying(false),
       mHandler(new AHandlerReflector<SimpleSoftOMXComponent>(this)),
       mState(OMX_StateLoaded),
       mTargetState(OMX_StateLoaded) {
+    if (mPooledLooper) {
+        mLooper = SoftOMXLooperPool::getInstance()->acquire();
+        mLooper->registerHandler(mHandler);
+        return;
+    }
+
+    mLooper = new ALooper;
     mLooper->setName(name);
     mLooper->registerHandler(mHandler);
 
@@ -45,15 +54,44 @@ SimpleSoftOMXComponent::SimpleSoftOMXComponent(
             ANDROID_PRIORITY_FOREGROUND);
 }
 
+SimpleSoftOMXComponent::~SimpleSoftOMXComponent() {
+    // Only if the component failed to initialize and prepareForDestruction() was not called.
+    if (mPooledLooper) {
+        mLooper->unregisterHandler(mHandler->id());
+        SoftOMXLooperPool::getInstance()->release(mLooper);
+    }
+}
+
 void SimpleSoftOMXComponent::prepareForDestruction() {
     // The looper's queue may still contain messages referencing this
     // object. Make sure those are flushed before returning so that
     // a subsequent dlunload() does not pull out the rug from under us.
 
+    if (mPooledLooper) {
+        // The looper keeps running for the other components on it, so drop the messages
+        // still queued for this one and wait until none of them is being handled.
+        {
+            Mutex::Autolock autoLock(mLock);
+            mDestroying = true;
+        }
+
+        sp<AMessage> response;
+        (new AMessage(kWhatBarrier, mHandler))->postAndAwaitResponse(&response);
+
+        mLooper->unregisterHandler(mHandler->id());
+        SoftOMXLooperPool::getInstance()->release(mLooper);
+        mPooledLooper = false;
+        return;
+    }
+
     mLooper->unregisterHandler(mHandler->id());
     mLooper->stop();
 }
 
+uint32_t SimpleSoftOMXComponent::threadBudget() const {
+    return mPooledLooper ? SoftOMXLooperPool::getInstance()->threadBudget() : 0;
+}
+
 OMX_ERRORTYPE SimpleSoftOMXComponent::sendCommand(
         OMX_COMMANDTYPE cmd, OMX_U32 param, OMX_PTR data) {
     CHECK(data == NULL);
@@ -343,6 +381,16 @@ void SimpleSoftOMXComponent::onMessageReceived(const sp<AMessage> &msg) {
     Mutex::Autolock autoLock(mLock);
     uint32_t msgType = msg->what();
     ALOGV("msgType = %d", msgType);
+
+    if (msgType == kWhatBarrier) {
+        sp<AReplyToken> replyID;
+        CHECK(msg->senderAwaitsResponse(&replyID));
+        (new AMessage)->postReply(replyID);
+        return;
+    } else if (mDestroying) {
+        return;
+    }
+
     switch (msgType) {
         case kWhatSendCommand:
         {
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SoftOMXLooperPool"
+#include <utils/Log.h>
+
+#include "SoftOMXLooperPool.h"
+
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AString.h>
+
+namespace android {
+
+static Mutex sInstanceLock;
+static sp<SoftOMXLooperPool> sInstance;
+
+// static
+sp<SoftOMXLooperPool> SoftOMXLooperPool::getInstance() {
+    Mutex::Autolock autoLock(sInstanceLock);
+    if (sInstance == NULL) {
+        sInstance = new SoftOMXLooperPool;
+    }
+    return sInstance;
+}
+
+// static
+bool SoftOMXLooperPool::isEnabled() {
+    return property_get_bool("media.stagefright.omx-looper-pool", false);
+}
+
+static size_t GetCPUCoreCount() {
+    long cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpuCoreCount >= 1 ? cpuCoreCount : 1;
+}
+
+SoftOMXLooperPool::SoftOMXLooperPool()
+    : mNumCpus(GetCPUCoreCount()),
+      mNumComponents(0) {
+}
+
+SoftOMXLooperPool::~SoftOMXLooperPool() {
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        mEntries.editItemAt(i).mLooper->stop();
+    }
+}
+
+sp<ALooper> SoftOMXLooperPool::acquire() {
+    Mutex::Autolock autoLock(mLock);
+
+    // Idle loopers are kept running, a new one is only started while there are fewer
+    // loopers than CPUs and every existing one is in use.
+    ssize_t best = -1;
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        if (best < 0 || mEntries[i].mNumComponents < mEntries[best].mNumComponents) {
+            best = i;
+        }
+    }
+
+    if (best < 0 || (mEntries[best].mNumComponents > 0 && mEntries.size() < mNumCpus)) {
+        Entry entry;
+        entry.mLooper = new ALooper;
+        entry.mLooper->setName(AStringPrintf("SoftOMXPool%zu", mEntries.size()).c_str());
+        entry.mLooper->start(
+                false, // runOnCallingThread
+                false, // canCallJava
+                ANDROID_PRIORITY_FOREGROUND);
+        entry.mNumComponents = 0;
+        best = mEntries.add(entry);
+    }
+
+    Entry &entry = mEntries.editItemAt(best);
+    ++entry.mNumComponents;
+    ++mNumComponents;
+
+    ALOGV("looper %zd now has %zu components, %zu in total",
+            best, entry.mNumComponents, mNumComponents);
+
+    return entry.mLooper;
+}
+
+void SoftOMXLooperPool::release(const sp<ALooper> &looper) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        Entry &entry = mEntries.editItemAt(i);
+        if (entry.mLooper == looper) {
+            CHECK_GT(entry.mNumComponents, 0u);
+            --entry.mNumComponents;
+            --mNumComponents;
+            return;
+        }
+    }
+
+    ALOGW("released a looper that is not in the pool");
+}
+
+uint32_t SoftOMXLooperPool::threadBudget() const {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mNumComponents <= 1) {
+        return mNumCpus;
+    }
+    return mNumCpus > mNumComponents ? mNumCpus / mNumComponents : 1;
+}
+
+}  // namespace android
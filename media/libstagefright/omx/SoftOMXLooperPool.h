@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SOFT_OMX_LOOPER_POOL_H_
+
+#define SOFT_OMX_LOOPER_POOL_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ALooper;
+
+// Process wide set of loopers shared by the software OMX components, at most one per CPU.
+// A component gets the looper with the fewest components on it, so that many simultaneous
+// sessions no longer mean one looper thread each on top of the codec's own threads.
+struct SoftOMXLooperPool : public RefBase {
+    static sp<SoftOMXLooperPool> getInstance();
+
+    // True if "media.stagefright.omx-looper-pool" is set.
+    static bool isEnabled();
+
+    sp<ALooper> acquire();
+    void release(const sp<ALooper> &looper);
+
+    // Number of worker threads a codec should use, so that the components in the pool
+    // together use about one thread per CPU.
+    uint32_t threadBudget() const;
+
+protected:
+    virtual ~SoftOMXLooperPool();
+
+private:
+    struct Entry {
+        sp<ALooper> mLooper;
+        size_t mNumComponents;
+    };
+
+    mutable Mutex mLock;
+    const size_t mNumCpus;
+    Vector<Entry> mEntries;
+    size_t mNumComponents;
+
+    SoftOMXLooperPool();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SoftOMXLooperPool);
+};
+
+}  // namespace android
+
+#endif  // SOFT_OMX_LOOPER_POOL_H_
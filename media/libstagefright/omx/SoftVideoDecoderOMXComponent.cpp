@@ -53,6 +53,8 @@ SoftVideoDecoderOMXComponent::SoftVideoDecoderOMXComponent(
         OMX_COMPONENTTYPE **component)
         : SimpleSoftOMXComponent(name, callbacks, appData, component),
         mIsAdaptive(false),
+        mLowLatency(false),
+        mThreadCount(0),
         mAdaptiveMaxWidth(0),
         mAdaptiveMaxHeight(0),
         mWidth(width),
@@ -235,24 +237,34 @@ void SoftVideoDecoderOMXComponent::copyYV12FrameToOutputBuffer(
     size_t dstHeight = outputBufferHeight();
     uint8_t *dstStart = dst;
 
-    for (size_t i = 0; i < mHeight; ++i) {
-         memcpy(dst, srcY, mWidth);
-         srcY += srcYStride;
-         dst += dstYStride;
-    }
+    copyPlane(dst, dstYStride, srcY, srcYStride, mWidth, mHeight);
 
     dst = dstStart + dstYStride * dstHeight;
-    for (size_t i = 0; i < mHeight / 2; ++i) {
-         memcpy(dst, srcU, mWidth / 2);
-         srcU += srcUStride;
-         dst += dstUVStride;
-    }
+    copyPlane(dst, dstUVStride, srcU, srcUStride, mWidth / 2, mHeight / 2);
 
     dst = dstStart + (5 * dstYStride * dstHeight) / 4;
-    for (size_t i = 0; i < mHeight / 2; ++i) {
-         memcpy(dst, srcV, mWidth / 2);
-         srcV += srcVStride;
-         dst += dstUVStride;
+    copyPlane(dst, dstUVStride, srcV, srcVStride, mWidth / 2, mHeight / 2);
+}
+
+// static
+void SoftVideoDecoderOMXComponent::copyPlane(
+        uint8_t *dst, size_t dstStride, const uint8_t *src, size_t srcStride,
+        size_t width, size_t height) {
+    if (height == 0) {
+        return;
+    }
+
+    // With the same stride the padding in between rows can be copied along, which turns
+    // a call per row into a single large copy.
+    if (srcStride == dstStride) {
+        memcpy(dst, src, dstStride * (height - 1) + width);
+        return;
+    }
+
+    for (size_t i = 0; i < height; ++i) {
+         memcpy(dst, src, width);
+         src += srcStride;
+         dst += dstStride;
     }
 }
 
@@ -398,6 +410,31 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kLowLatencyIndex:
+        {
+            const OMX_CONFIG_BOOLEANTYPE *lowLatencyParams =
+                    (const OMX_CONFIG_BOOLEANTYPE *)params;
+
+            if (!isValidOMXParam(lowLatencyParams)) {
+                return OMX_ErrorBadParameter;
+            }
+
+            mLowLatency = lowLatencyParams->bEnabled;
+            return OMX_ErrorNone;
+        }
+
+        case kThreadCountIndex:
+        {
+            const OMX_PARAM_U32TYPE *threadCountParams = (const OMX_PARAM_U32TYPE *)params;
+
+            if (!isValidOMXParam(threadCountParams)) {
+                return OMX_ErrorBadParameter;
+            }
+
+            mThreadCount = threadCountParams->nU32;
+            return OMX_ErrorNone;
+        }
+
         case OMX_IndexParamPortDefinition:
         {
             OMX_PARAM_PORTDEFINITIONTYPE *newParams =
@@ -475,6 +512,16 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::getExtensionIndex(
         return OMX_ErrorNone;
     }
 
+    if (!strcmp(name, "OMX.google.android.index.lowLatency")) {
+        *(int32_t*)index = kLowLatencyIndex;
+        return OMX_ErrorNone;
+    }
+
+    if (!strcmp(name, "OMX.google.android.index.threadCount")) {
+        *(int32_t*)index = kThreadCountIndex;
+        return OMX_ErrorNone;
+    }
+
     return SimpleSoftOMXComponent::getExtensionIndex(name, index);
 }
 
@@ -31,13 +31,18 @@
 
 namespace android {
 
+static const size_t kMinAccessUnitSize = 16384;
+
 // static
 AAVCAssembler::AAVCAssembler(const sp<AMessage> &notify)
     : mNotifyMsg(notify),
       mAccessUnitRTPTime(0),
       mNextExpectedSeqNoValid(false),
       mNextExpectedSeqNo(0),
-      mAccessUnitDamaged(false) {
+      mAccessUnitDamaged(false),
+      mNumNALUnits(0),
+      mAccessUnitSeqNo(0),
+      mAccessUnitSizeHint(kMinAccessUnitSize) {
 }
 
 AAVCAssembler::~AAVCAssembler() {
@@ -129,15 +134,52 @@ void AAVCAssembler::addSingleNALUnit(const sp<ABuffer> &buffer) {
     hexdump(buffer->data(), buffer->size());
 #endif
 
+    uint8_t *dst = appendNALUnit(buffer, buffer->size());
+    memcpy(dst, buffer->data(), buffer->size());
+}
+
+uint8_t *AAVCAssembler::appendNALUnit(
+        const sp<ABuffer> &buffer, size_t size) {
     uint32_t rtpTime;
     CHECK(buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
 
-    if (!mNALUnits.empty() && rtpTime != mAccessUnitRTPTime) {
+    if (mNumNALUnits > 0 && rtpTime != mAccessUnitRTPTime) {
         submitAccessUnit();
     }
     mAccessUnitRTPTime = rtpTime;
 
-    mNALUnits.push_back(buffer);
+    size_t needed = 4 + size;
+    if (mAccessUnit == NULL) {
+        size_t capacity = mAccessUnitSizeHint;
+        if (capacity < needed) {
+            capacity = needed;
+        }
+        mAccessUnit = new ABuffer(capacity);
+        mAccessUnit->setRange(0, 0);
+    } else if (mAccessUnit->size() + needed > mAccessUnit->capacity()) {
+        size_t capacity = 2 * mAccessUnit->capacity();
+        if (capacity < mAccessUnit->size() + needed) {
+            capacity = mAccessUnit->size() + needed;
+        }
+
+        ALOGV("growing access unit to %zu bytes", capacity);
+
+        sp<ABuffer> accessUnit = new ABuffer(capacity);
+        memcpy(accessUnit->data(), mAccessUnit->data(), mAccessUnit->size());
+        accessUnit->setRange(0, mAccessUnit->size());
+        mAccessUnit = accessUnit;
+    }
+
+    if (mNumNALUnits++ == 0) {
+        mAccessUnitSeqNo = (uint32_t)buffer->int32Data();
+    }
+
+    uint8_t *dst = mAccessUnit->data() + mAccessUnit->size();
+    memcpy(dst, "\x00\x00\x00\x01", 4);
+
+    mAccessUnit->setRange(0, mAccessUnit->size() + needed);
+
+    return dst + 4;
 }
 
 bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
@@ -159,12 +201,8 @@ bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
             return false;
         }
 
-        sp<ABuffer> unit = new ABuffer(nalSize);
-        memcpy(unit->data(), &data[2], nalSize);
-
-        CopyTimes(unit, buffer);
-
-        addSingleNALUnit(unit);
+        uint8_t *dst = appendNALUnit(buffer, nalSize);
+        memcpy(dst, data + 2, nalSize);
 
         data += 2 + nalSize;
         size -= 2 + nalSize;
@@ -284,10 +322,11 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
     // header byte.
     ++totalSize;
 
-    sp<ABuffer> unit = new ABuffer(totalSize);
-    CopyTimes(unit, *queue->begin());
+    // The fragments are copied straight into the access unit, behind the
+    // NAL header reconstructed from the FU indicator and header.
+    uint8_t *dst = appendNALUnit(*queue->begin(), totalSize);
 
-    unit->data()[0] = (nri << 5) | nalType;
+    dst[0] = (nri << 5) | nalType;
 
     size_t offset = 1;
     List<sp<ABuffer> >::iterator it = queue->begin();
@@ -299,15 +338,13 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
         hexdump(buffer->data(), buffer->size());
 #endif
 
-        memcpy(unit->data() + offset, buffer->data() + 2, buffer->size() - 2);
+        memcpy(dst + offset, buffer->data() + 2, buffer->size() - 2);
         offset += buffer->size() - 2;
 
         it = queue->erase(it);
     }
 
-    unit->setRange(0, totalSize);
-
-    addSingleNALUnit(unit);
+    CHECK_EQ(offset, totalSize);
 
     ALOGV("successfully assembled a NAL unit from fragments.");
 
@@ -315,29 +352,21 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
 }
 
 void AAVCAssembler::submitAccessUnit() {
-    CHECK(!mNALUnits.empty());
-
-    ALOGV("Access unit complete (%zu nal units)", mNALUnits.size());
+    CHECK_GT(mNumNALUnits, 0u);
 
-    size_t totalSize = 0;
-    for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
-         it != mNALUnits.end(); ++it) {
-        totalSize += 4 + (*it)->size();
-    }
+    ALOGV("Access unit complete (%zu nal units)", mNumNALUnits);
 
-    sp<ABuffer> accessUnit = new ABuffer(totalSize);
-    size_t offset = 0;
-    for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
-         it != mNALUnits.end(); ++it) {
-        memcpy(accessUnit->data() + offset, "\x00\x00\x00\x01", 4);
-        offset += 4;
+    sp<ABuffer> accessUnit = mAccessUnit;
+    mAccessUnit.clear();
 
-        sp<ABuffer> nal = *it;
-        memcpy(accessUnit->data() + offset, nal->data(), nal->size());
-        offset += nal->size();
-    }
+    // Size the next access unit from this one. Downstream queues hold on
+    // to access units for a while, so this deliberately doesn't remember
+    // the largest one, an occasional IDR frame grows its buffer instead.
+    size_t hint = accessUnit->size() + accessUnit->size() / 8;
+    mAccessUnitSizeHint = hint < kMinAccessUnitSize ? kMinAccessUnitSize : hint;
 
-    CopyTimes(accessUnit, *mNALUnits.begin());
+    accessUnit->meta()->setInt32("rtp-time", mAccessUnitRTPTime);
+    accessUnit->setInt32Data(mAccessUnitSeqNo);
 
 #if 0
     printf(mAccessUnitDamaged ? "X" : ".");
@@ -348,7 +377,7 @@ void AAVCAssembler::submitAccessUnit() {
         accessUnit->meta()->setInt32("damaged", true);
     }
 
-    mNALUnits.clear();
+    mNumNALUnits = 0;
     mAccessUnitDamaged = false;
 
     sp<AMessage> msg = mNotifyMsg->dup();
@@ -45,10 +45,21 @@ private:
     bool mNextExpectedSeqNoValid;
     uint32_t mNextExpectedSeqNo;
     bool mAccessUnitDamaged;
-    List<sp<ABuffer> > mNALUnits;
+
+    // NAL units are written straight into the access unit, each prefixed
+    // with a start code, mAccessUnitSizeHint sizes the next one from the
+    // previous one.
+    sp<ABuffer> mAccessUnit;
+    size_t mNumNALUnits;
+    uint32_t mAccessUnitSeqNo;
+    size_t mAccessUnitSizeHint;
 
     AssemblyStatus addNALUnit(const sp<ARTPSource> &source);
     void addSingleNALUnit(const sp<ABuffer> &buffer);
+
+    // Returns where to write a NAL unit of "size" bytes. "buffer" is the
+    // packet carrying (the start of) it, and decides the access unit.
+    uint8_t *appendNALUnit(const sp<ABuffer> &buffer, size_t size);
     AssemblyStatus addFragmentedNALUnit(List<sp<ABuffer> > *queue);
     bool addSingleTimeAggregationPacket(const sp<ABuffer> &buffer);
 
@@ -350,8 +350,8 @@ ARTPAssembler::AssemblyStatus AMPEG4ElementaryAssembler::addPacket(
                 return MALFORMED_PACKET;
             }
 
-            sp<ABuffer> accessUnit = new ABuffer(header.mSize);
-            memcpy(accessUnit->data(), buffer->data() + offset, header.mSize);
+            sp<ABuffer> accessUnit =
+                ABuffer::CreateSlice(buffer, offset, header.mSize);
 
             offset += header.mSize;
 
@@ -20,6 +20,7 @@
 
 #include "ARTPAssembler.h"
 #include "ARTPConnection.h"
+#include "ARTPPoller.h"
 
 #include "ARTPSource.h"
 #include "ASessionDescription.h"
@@ -37,6 +38,16 @@ namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+static const size_t kMaxDatagramSize = 65536;
+static const size_t kReceiveBatchSize = 8;
+
+// Upper bound on the datagrams drained per readable event, so that one busy
+// socket can't starve the other streams sharing this looper.
+static const size_t kMaxBatchesPerEvent = 4;
+
+// The loss timeout of every source in kLowLatency mode never exceeds this.
+static const int64_t kLowLatencyMaxLossTimeoutUs = 40000ll;
+
 static uint16_t u16at(const uint8_t *data) {
     return data[0] << 8 | data[1];
 }
@@ -50,7 +61,7 @@ static uint64_t u64at(const uint8_t *data) {
 }
 
 // static
-const int64_t ARTPConnection::kSelectTimeoutUs = 1000ll;
+const int64_t ARTPConnection::kReceiverReportIntervalUs = 5000000ll;
 
 struct ARTPConnection::StreamInfo {
     int mRTPSocket;
@@ -65,15 +76,27 @@ struct ARTPConnection::StreamInfo {
     struct sockaddr_in mRemoteRTCPAddr;
 
     bool mIsInjected;
+
+    int32_t mGeneration;
+    int32_t mRTPPollerID;
+    int32_t mRTCPPollerID;
+
+    // The payload type of RFC 5109 FEC packets, -1 if not announced.
+    int32_t mFECPayloadType;
 };
 
 ARTPConnection::ARTPConnection(uint32_t flags)
     : mFlags(flags),
-      mPollEventPending(false),
+      mStreamGeneration(0),
+      mReceiverReportGeneration(0),
       mLastReceiverReportTimeUs(-1) {
 }
 
 ARTPConnection::~ARTPConnection() {
+    for (List<StreamInfo>::iterator it = mStreams.begin();
+         it != mStreams.end(); ++it) {
+        removeSocketsFromPoller(&*it);
+    }
 }
 
 void ARTPConnection::addStream(
@@ -165,9 +188,9 @@ void ARTPConnection::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
-        case kWhatPollStreams:
+        case kWhatSocketReadable:
         {
-            onPollStreams();
+            onSocketReadable(msg);
             break;
         }
 
@@ -177,6 +200,17 @@ void ARTPConnection::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSendReceiverReports:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            if (generation == mReceiverReportGeneration) {
+                onSendReceiverReports();
+            }
+            break;
+        }
+
         default:
         {
             TRESPASS();
@@ -211,8 +245,22 @@ void ARTPConnection::onAddStream(const sp<AMessage> &msg) {
     info->mNumRTPPacketsReceived = 0;
     memset(&info->mRemoteRTCPAddr, 0, sizeof(info->mRemoteRTCPAddr));
 
+    info->mGeneration = ++mStreamGeneration;
+    info->mRTPPollerID = -1;
+    info->mRTCPPollerID = -1;
+
+    unsigned long fecPT;
+    info->mFECPayloadType = -1;
+    if (info->mSessionDesc->findPayloadType(info->mIndex, "ulpfec/", &fecPT)) {
+        info->mFECPayloadType = fecPT;
+    }
+
     if (!injected) {
-        postPollEvent();
+        addSocketsToPoller(info);
+    }
+
+    if (mStreams.size() == 1) {
+        scheduleReceiverReports(kReceiverReportIntervalUs);
     }
 }
 
@@ -231,148 +279,127 @@ void ARTPConnection::onRemoveStream(const sp<AMessage> &msg) {
         return;
     }
 
+    removeSocketsFromPoller(&*it);
     mStreams.erase(it);
 }
 
-void ARTPConnection::postPollEvent() {
-    if (mPollEventPending) {
-        return;
-    }
+void ARTPConnection::addSocketsToPoller(StreamInfo *info) {
+    sp<ARTPPoller> poller = ARTPPoller::Get();
 
-    sp<AMessage> msg = new AMessage(kWhatPollStreams, this);
-    msg->post();
+    sp<AMessage> notify = new AMessage(kWhatSocketReadable, this);
+    notify->setInt32("generation", info->mGeneration);
+    notify->setInt32("rtp", true);
+    info->mRTPPollerID = poller->addSocket(info->mRTPSocket, notify);
 
-    mPollEventPending = true;
+    notify = notify->dup();
+    notify->setInt32("rtp", false);
+    info->mRTCPPollerID = poller->addSocket(info->mRTCPSocket, notify);
 }
 
-void ARTPConnection::onPollStreams() {
-    mPollEventPending = false;
-
-    if (mStreams.empty()) {
+void ARTPConnection::removeSocketsFromPoller(StreamInfo *info) {
+    if (info->mIsInjected) {
         return;
     }
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = kSelectTimeoutUs;
-
-    fd_set rs;
-    FD_ZERO(&rs);
-
-    int maxSocket = -1;
-    for (List<StreamInfo>::iterator it = mStreams.begin();
-         it != mStreams.end(); ++it) {
-        if ((*it).mIsInjected) {
-            continue;
-        }
+    sp<ARTPPoller> poller = ARTPPoller::Get();
+    if (info->mRTPPollerID >= 0) {
+        poller->removeSocket(info->mRTPPollerID);
+        info->mRTPPollerID = -1;
+    }
+    if (info->mRTCPPollerID >= 0) {
+        poller->removeSocket(info->mRTCPPollerID);
+        info->mRTCPPollerID = -1;
+    }
+}
 
-        FD_SET(it->mRTPSocket, &rs);
-        FD_SET(it->mRTCPSocket, &rs);
+void ARTPConnection::onSocketReadable(const sp<AMessage> &msg) {
+    int32_t generation, rtp;
+    CHECK(msg->findInt32("generation", &generation));
+    CHECK(msg->findInt32("rtp", &rtp));
 
-        if (it->mRTPSocket > maxSocket) {
-            maxSocket = it->mRTPSocket;
-        }
-        if (it->mRTCPSocket > maxSocket) {
-            maxSocket = it->mRTCPSocket;
-        }
+    List<StreamInfo>::iterator it = mStreams.begin();
+    while (it != mStreams.end() && it->mGeneration != generation) {
+        ++it;
     }
 
-    if (maxSocket == -1) {
+    if (it == mStreams.end()) {
+        // The stream was removed after the poller reported its socket.
         return;
     }
 
-    int res = select(maxSocket + 1, &rs, NULL, NULL, &tv);
+    status_t err = receive(&*it, rtp);
 
-    if (res > 0) {
-        List<StreamInfo>::iterator it = mStreams.begin();
-        while (it != mStreams.end()) {
-            if ((*it).mIsInjected) {
-                ++it;
-                continue;
-            }
+    if (err == -ECONNRESET) {
+        // socket failure, this stream is dead, Jim.
 
-            status_t err = OK;
-            if (FD_ISSET(it->mRTPSocket, &rs)) {
-                err = receive(&*it, true);
-            }
-            if (err == OK && FD_ISSET(it->mRTCPSocket, &rs)) {
-                err = receive(&*it, false);
-            }
+        ALOGW("failed to receive RTP/RTCP datagram.");
+        removeSocketsFromPoller(&*it);
+        mStreams.erase(it);
+        return;
+    }
 
-            if (err == -ECONNRESET) {
-                // socket failure, this stream is dead, Jim.
+    ARTPPoller::Get()->rearm(rtp ? it->mRTPPollerID : it->mRTCPPollerID);
+}
 
-                ALOGW("failed to receive RTP/RTCP datagram.");
-                it = mStreams.erase(it);
-                continue;
-            }
+void ARTPConnection::scheduleReceiverReports(int64_t delayUs) {
+    sp<AMessage> msg = new AMessage(kWhatSendReceiverReports, this);
+    msg->setInt32("generation", ++mReceiverReportGeneration);
+    msg->post(delayUs);
+}
 
-            ++it;
-        }
+void ARTPConnection::onSendReceiverReports() {
+    if (mStreams.empty()) {
+        return;
     }
 
     int64_t nowUs = ALooper::GetNowUs();
-    if (mLastReceiverReportTimeUs <= 0
-            || mLastReceiverReportTimeUs + 5000000ll <= nowUs) {
-        sp<ABuffer> buffer = new ABuffer(kMaxUDPSize);
-        List<StreamInfo>::iterator it = mStreams.begin();
-        while (it != mStreams.end()) {
-            StreamInfo *s = &*it;
-
-            if (s->mIsInjected) {
-                ++it;
-                continue;
-            }
 
-            if (s->mNumRTCPPacketsReceived == 0) {
-                // We have never received any RTCP packets on this stream,
-                // we don't even know where to send a report.
-                ++it;
-                continue;
-            }
-
-            buffer->setRange(0, 0);
-
-            for (size_t i = 0; i < s->mSources.size(); ++i) {
-                sp<ARTPSource> source = s->mSources.valueAt(i);
+    sp<ABuffer> buffer = new ABuffer(kMaxUDPSize);
+    List<StreamInfo>::iterator it = mStreams.begin();
+    while (it != mStreams.end()) {
+        StreamInfo *s = &*it;
 
-                source->addReceiverReport(buffer);
+        if (s->mIsInjected) {
+            ++it;
+            continue;
+        }
 
-                if (mFlags & kRegularlyRequestFIR) {
-                    source->addFIR(buffer);
-                }
-            }
+        if (s->mNumRTCPPacketsReceived == 0) {
+            // We have never received any RTCP packets on this stream,
+            // we don't even know where to send a report.
+            ++it;
+            continue;
+        }
 
-            if (buffer->size() > 0) {
-                ALOGV("Sending RR...");
+        buffer->setRange(0, 0);
 
-                ssize_t n;
-                do {
-                    n = sendto(
-                        s->mRTCPSocket, buffer->data(), buffer->size(), 0,
-                        (const struct sockaddr *)&s->mRemoteRTCPAddr,
-                        sockAddrSize());
-                } while (n < 0 && errno == EINTR);
+        for (size_t i = 0; i < s->mSources.size(); ++i) {
+            sp<ARTPSource> source = s->mSources.valueAt(i);
 
-                if (n <= 0) {
-                    ALOGW("failed to send RTCP receiver report (%s).",
-                         n == 0 ? "connection gone" : strerror(errno));
+            source->addReceiverReport(buffer);
 
-                    it = mStreams.erase(it);
-                    continue;
-                }
+            if (mFlags & kRegularlyRequestFIR) {
+                source->addFIR(buffer);
+            }
+        }
 
-                CHECK_EQ(n, (ssize_t)buffer->size());
+        if (buffer->size() > 0) {
+            ALOGV("Sending RR...");
 
-                mLastReceiverReportTimeUs = nowUs;
+            if (sendRTCP(s, buffer) != OK) {
+                removeSocketsFromPoller(s);
+                it = mStreams.erase(it);
+                continue;
             }
 
-            ++it;
+            mLastReceiverReportTimeUs = nowUs;
         }
+
+        ++it;
     }
 
     if (!mStreams.empty()) {
-        postPollEvent();
+        scheduleReceiverReports(kReceiverReportIntervalUs);
     }
 }
 
@@ -381,39 +408,88 @@ status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
 
     CHECK(!s->mIsInjected);
 
-    sp<ABuffer> buffer = new ABuffer(65536);
+    if (mReceiveBuffer == NULL) {
+        // Pages are only committed as datagrams are actually written
+        // into them.
+        mReceiveBuffer = new ABuffer(kReceiveBatchSize * kMaxDatagramSize);
+    }
 
-    socklen_t remoteAddrLen =
-        (!receiveRTP && s->mNumRTCPPacketsReceived == 0)
-            ? sizeof(s->mRemoteRTCPAddr) : 0;
+    struct mmsghdr msgs[kReceiveBatchSize];
+    struct iovec iovs[kReceiveBatchSize];
+    struct sockaddr_storage addrs[kReceiveBatchSize];
 
-    ssize_t nbytes;
-    do {
-        nbytes = recvfrom(
-            receiveRTP ? s->mRTPSocket : s->mRTCPSocket,
-            buffer->data(),
-            buffer->capacity(),
-            0,
-            remoteAddrLen > 0 ? (struct sockaddr *)&s->mRemoteRTCPAddr : NULL,
-            remoteAddrLen > 0 ? &remoteAddrLen : NULL);
-    } while (nbytes < 0 && errno == EINTR);
-
-    if (nbytes <= 0) {
-        return -ECONNRESET;
+    for (size_t i = 0; i < kReceiveBatchSize; ++i) {
+        iovs[i].iov_base = mReceiveBuffer->data() + i * kMaxDatagramSize;
+        iovs[i].iov_len = kMaxDatagramSize;
+
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+
+        if (!receiveRTP) {
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
     }
 
-    buffer->setRange(0, nbytes);
+    int sock = receiveRTP ? s->mRTPSocket : s->mRTCPSocket;
 
-    // ALOGI("received %d bytes.", buffer->size());
+    for (size_t batch = 0; batch < kMaxBatchesPerEvent; ++batch) {
+        int n;
+        do {
+            n = recvmmsg(sock, msgs, kReceiveBatchSize, MSG_DONTWAIT, NULL);
+        } while (n < 0 && errno == EINTR);
 
-    status_t err;
-    if (receiveRTP) {
-        err = parseRTP(s, buffer);
-    } else {
-        err = parseRTCP(s, buffer);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -ECONNRESET;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            size_t nbytes = msgs[i].msg_len;
+            if (nbytes == 0) {
+                return -ECONNRESET;
+            }
+
+            if (!receiveRTP && s->mNumRTCPPacketsReceived == 0) {
+                socklen_t addrLen = msgs[i].msg_hdr.msg_namelen;
+                if (addrLen > sizeof(s->mRemoteRTCPAddr)) {
+                    addrLen = sizeof(s->mRemoteRTCPAddr);
+                }
+                memcpy(&s->mRemoteRTCPAddr, &addrs[i], addrLen);
+            }
+
+            // Hand the parsers a right-sized copy, the sources and
+            // assemblers hold on to their packets for reordering.
+            sp<ABuffer> buffer = new ABuffer(nbytes);
+            memcpy(buffer->data(), iovs[i].iov_base, nbytes);
+
+            // ALOGI("received %d bytes.", buffer->size());
+
+            if (receiveRTP) {
+                parseRTP(s, buffer);
+            } else {
+                parseRTCP(s, buffer);
+
+                if (mLastReceiverReportTimeUs < 0) {
+                    // Answer the first sender report right away rather
+                    // than at the next regular interval.
+                    scheduleReceiverReports(0);
+                }
+            }
+
+            // Restore the slot for the next batch.
+            msgs[i].msg_hdr.msg_namelen = receiveRTP ? 0 : sizeof(addrs[i]);
+        }
+
+        if ((size_t)n < kReceiveBatchSize) {
+            break;
+        }
     }
 
-    return err;
+    return OK;
 }
 
 status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
@@ -482,6 +558,11 @@ status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
         payloadOffset += 4 + extensionLength;
     }
 
+    if ((data[1] & 0x7f) == s->mFECPayloadType) {
+        parseFEC(s, &data[payloadOffset], size - payloadOffset);
+        return OK;
+    }
+
     uint32_t srcId = u32at(&data[8]);
 
     sp<ARTPSource> source = findSource(s, srcId);
@@ -494,14 +575,83 @@ status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
     meta->setInt32("PT", data[1] & 0x7f);
     meta->setInt32("M", data[1] >> 7);
 
+    if (source->usesFEC() && buffer->offset() == 0) {
+        // The header stays in front of the payload for the FEC decoder.
+        meta->setInt32("rtp-length", buffer->size());
+    }
+
     buffer->setInt32Data(u16at(&data[2]));
     buffer->setRange(payloadOffset, size - payloadOffset);
 
     source->processRTPPacket(buffer);
 
+    if (source->hasPendingNACKs()) {
+        sendNACK(s, source);
+    }
+
+    return OK;
+}
+
+void ARTPConnection::parseFEC(
+        StreamInfo *s, const uint8_t *data, size_t size) {
+    // FEC travels on an SSRC of its own, its media is that of the one
+    // source of this stream.
+    if (s->mSources.size() != 1) {
+        return;
+    }
+
+    sp<ARTPSource> source = s->mSources.valueAt(0);
+
+    List<sp<ABuffer> > recovered;
+    source->processFECPacket(data, size, &recovered);
+
+    for (List<sp<ABuffer> >::iterator it = recovered.begin();
+         it != recovered.end(); ++it) {
+        parseRTP(s, *it);
+    }
+}
+
+status_t ARTPConnection::sendRTCP(
+        StreamInfo *s, const sp<ABuffer> &buffer) {
+    ssize_t n;
+    do {
+        n = sendto(
+            s->mRTCPSocket, buffer->data(), buffer->size(), 0,
+            (const struct sockaddr *)&s->mRemoteRTCPAddr,
+            sockAddrSize());
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        ALOGW("failed to send RTCP packet (%s).",
+             n == 0 ? "connection gone" : strerror(errno));
+        return -ECONNRESET;
+    }
+
+    CHECK_EQ(n, (ssize_t)buffer->size());
+
     return OK;
 }
 
+void ARTPConnection::sendNACK(
+        StreamInfo *s, const sp<ARTPSource> &source) {
+    if (s->mIsInjected || s->mNumRTCPPacketsReceived == 0) {
+        // Nowhere to send it to.
+        return;
+    }
+
+    // Feedback must be part of a compound packet starting with a report.
+    sp<ABuffer> buffer = new ABuffer(kMaxUDPSize);
+    buffer->setRange(0, 0);
+
+    source->addReceiverReport(buffer);
+    source->addNACK(buffer);
+
+    ALOGV("Sending NACK...");
+
+    // A failure is picked up by the next regular receiver report.
+    sendRTCP(s, buffer);
+}
+
 status_t ARTPConnection::parseRTCP(StreamInfo *s, const sp<ABuffer> &buffer) {
     if (s->mNumRTCPPacketsReceived++ == 0) {
         sp<AMessage> notify = s->mNotifyMsg->dup();
@@ -636,6 +786,10 @@ sp<ARTPSource> ARTPConnection::findSource(StreamInfo *info, uint32_t srcId) {
         source = new ARTPSource(
                 srcId, info->mSessionDesc, info->mIndex, info->mNotifyMsg);
 
+        if (mFlags & kLowLatency) {
+            source->setMaxLossTimeoutUs(kLowLatencyMaxLossTimeoutUs);
+        }
+
         info->mSources.add(srcId, source);
     } else {
         source = info->mSources.valueAt(index);
@@ -30,6 +30,9 @@ struct ASessionDescription;
 struct ARTPConnection : public AHandler {
     enum Flags {
         kRegularlyRequestFIR = 2,
+        // Bound the time spent waiting for missing packets, for live
+        // viewing at the lowest possible latency.
+        kLowLatency          = 4,
     };
 
     ARTPConnection(uint32_t flags = 0);
@@ -59,36 +62,48 @@ protected:
     enum {
         kWhatAddStream,
         kWhatRemoveStream,
-        kWhatPollStreams,
+        kWhatSocketReadable,
         kWhatInjectPacket,
+        kWhatSendReceiverReports,
     };
 
-    static const int64_t kSelectTimeoutUs;
+    static const int64_t kReceiverReportIntervalUs;
 
     uint32_t mFlags;
 
     struct StreamInfo;
     List<StreamInfo> mStreams;
 
-    bool mPollEventPending;
+    int32_t mStreamGeneration;
+    int32_t mReceiverReportGeneration;
     int64_t mLastReceiverReportTimeUs;
 
+    // Scratch space for a batch of datagrams, allocated on first use and
+    // only ever touched by this connection's looper.
+    sp<ABuffer> mReceiveBuffer;
+
     virtual void onAddStream(const sp<AMessage> &msg);
     void onRemoveStream(const sp<AMessage> &msg);
-    void onPollStreams();
+    void onSocketReadable(const sp<AMessage> &msg);
     void onInjectPacket(const sp<AMessage> &msg);
     void onSendReceiverReports();
 
     status_t receive(StreamInfo *info, bool receiveRTP);
 
     status_t parseRTP(StreamInfo *info, const sp<ABuffer> &buffer);
+    void parseFEC(StreamInfo *info, const uint8_t *data, size_t size);
     status_t parseRTCP(StreamInfo *info, const sp<ABuffer> &buffer);
     status_t parseSR(StreamInfo *info, const uint8_t *data, size_t size);
     status_t parseBYE(StreamInfo *info, const uint8_t *data, size_t size);
 
     sp<ARTPSource> findSource(StreamInfo *info, uint32_t id);
 
-    void postPollEvent();
+    void addSocketsToPoller(StreamInfo *info);
+    void removeSocketsFromPoller(StreamInfo *info);
+    void scheduleReceiverReports(int64_t delayUs);
+
+    status_t sendRTCP(StreamInfo *info, const sp<ABuffer> &buffer);
+    void sendNACK(StreamInfo *info, const sp<ARTPSource> &source);
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPConnection);
 };
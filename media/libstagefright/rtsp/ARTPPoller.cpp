@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ARTPPoller"
+#include <utils/Log.h>
+
+#include "ARTPPoller.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+namespace android {
+
+static const int kMaxEventsPerWait = 16;
+
+struct ARTPPoller::PollerThread : public Thread {
+    PollerThread(ARTPPoller *poller)
+        : Thread(false /* canCallJava */),
+          mPoller(poller) {
+    }
+
+protected:
+    virtual ~PollerThread() {}
+
+private:
+    // The poller is a process-wide singleton and is never destroyed while
+    // its thread is running.
+    ARTPPoller *mPoller;
+
+    virtual bool threadLoop() {
+        return mPoller->threadLoop();
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(PollerThread);
+};
+
+// static
+sp<ARTPPoller> ARTPPoller::Get() {
+    static Mutex sLock;
+    static sp<ARTPPoller> sPoller;
+
+    Mutex::Autolock autoLock(sLock);
+    if (sPoller == NULL) {
+        sPoller = new ARTPPoller;
+    }
+    return sPoller;
+}
+
+ARTPPoller::ARTPPoller()
+    : mEpollFd(epoll_create1(EPOLL_CLOEXEC)),
+      mNextID(1) {
+    CHECK_GE(mEpollFd, 0);
+
+    mThread = new PollerThread(this);
+    CHECK_EQ(mThread->run("ARTPPoller", ANDROID_PRIORITY_AUDIO), (status_t)OK);
+}
+
+ARTPPoller::~ARTPPoller() {
+    // Only reached if the singleton was never handed out.
+    close(mEpollFd);
+    mEpollFd = -1;
+}
+
+int32_t ARTPPoller::addSocket(int s, const sp<AMessage> &notify) {
+    Mutex::Autolock autoLock(mLock);
+
+    int32_t id = mNextID++;
+    if (mNextID < 0) {
+        mNextID = 1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.u32 = id;
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, s, &ev) < 0) {
+        int err = -errno;
+        ALOGE("failed to add socket %d (%s)", s, strerror(errno));
+        return err;
+    }
+
+    Registration reg;
+    reg.mSocket = s;
+    reg.mNotify = notify;
+    mRegistrations.add(id, reg);
+    mSocketOwners.replaceValueFor(s, id);
+
+    return id;
+}
+
+void ARTPPoller::rearm(int32_t id) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mRegistrations.indexOfKey(id);
+    if (index < 0) {
+        return;
+    }
+
+    int s = mRegistrations.valueAt(index).mSocket;
+    if (mSocketOwners.valueFor(s) != id) {
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.u32 = id;
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_MOD, s, &ev) < 0) {
+        ALOGW("failed to rearm socket %d (%s)", s, strerror(errno));
+    }
+}
+
+void ARTPPoller::removeSocket(int32_t id) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mRegistrations.indexOfKey(id);
+    if (index < 0) {
+        return;
+    }
+
+    int s = mRegistrations.valueAt(index).mSocket;
+    mRegistrations.removeItemsAt(index);
+
+    ssize_t ownerIndex = mSocketOwners.indexOfKey(s);
+    if (ownerIndex >= 0 && mSocketOwners.valueAt(ownerIndex) == id) {
+        mSocketOwners.removeItemsAt(ownerIndex);
+
+        // Fails harmlessly if the socket was closed already, closing it
+        // removed it from the epoll set.
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, s, NULL);
+    }
+}
+
+bool ARTPPoller::threadLoop() {
+    struct epoll_event events[kMaxEventsPerWait];
+
+    int n = epoll_wait(mEpollFd, events, kMaxEventsPerWait, -1 /* timeout */);
+    if (n < 0) {
+        if (errno != EINTR) {
+            ALOGE("epoll_wait failed (%s)", strerror(errno));
+            usleep(10000ll);
+        }
+        return true;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        int32_t id = events[i].data.u32;
+
+        sp<AMessage> notify;
+        {
+            Mutex::Autolock autoLock(mLock);
+            ssize_t index = mRegistrations.indexOfKey(id);
+            if (index < 0) {
+                // Removed while the event was being delivered.
+                continue;
+            }
+            notify = mRegistrations.valueAt(index).mNotify->dup();
+        }
+
+        notify->setInt32("poller-id", id);
+        notify->post();
+    }
+
+    return true;
+}
+
+}  // namespace android
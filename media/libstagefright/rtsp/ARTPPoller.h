@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_RTP_POLLER_H_
+
+#define A_RTP_POLLER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/KeyedVector.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+
+namespace android {
+
+struct AMessage;
+
+// Waits for incoming datagrams on the sockets of all ARTPConnections in the
+// process on a single thread, instead of every connection polling its own
+// sockets with select().  Sockets are armed one-shot: once a socket became
+// readable its notification is posted (with "poller-id" set) and the socket
+// is not reported again until its owner drained it and called rearm().
+struct ARTPPoller : public RefBase {
+    static sp<ARTPPoller> Get();
+
+    // Returns an id identifying the registration, or a negative error.
+    int32_t addSocket(int s, const sp<AMessage> &notify);
+    void rearm(int32_t id);
+
+    // Safe to call after the socket was already closed.
+    void removeSocket(int32_t id);
+
+protected:
+    virtual ~ARTPPoller();
+
+private:
+    struct PollerThread;
+
+    struct Registration {
+        int mSocket;
+        sp<AMessage> mNotify;
+    };
+
+    Mutex mLock;
+    int mEpollFd;
+    int32_t mNextID;
+    KeyedVector<int32_t, Registration> mRegistrations;
+
+    // The registration currently owning each socket in the epoll set;
+    // a socket number may be reused by a new registration before the
+    // previous owner removed its (closed) socket.
+    KeyedVector<int, int32_t> mSocketOwners;
+
+    sp<PollerThread> mThread;
+
+    ARTPPoller();
+
+    bool threadLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(ARTPPoller);
+};
+
+}  // namespace android
+
+#endif  // A_RTP_POLLER_H_
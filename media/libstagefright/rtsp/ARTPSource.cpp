@@ -28,6 +28,7 @@
 #include "AMPEG4ElementaryAssembler.h"
 #include "ARawAudioAssembler.h"
 #include "ASessionDescription.h"
+#include "AULPFECDecoder.h"
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -37,13 +38,37 @@ namespace android {
 
 static const uint32_t kSourceID = 0xdeadbeef;
 
+// Bounds of ARTPSource::lossTimeoutUs(), the lower one is the fixed wait
+// the assemblers used before the timeout adapted to the network.
+static const int64_t kMinLossTimeoutUs = 10000ll;
+static const int64_t kMaxLossTimeoutUs = 500000ll;
+
+// Until a retransmission was seen.
+static const int64_t kInitialNACKRoundTripUs = 50000ll;
+static const int64_t kMinNACKIntervalUs = 20000ll;
+static const int32_t kMaxNACKsPerPacket = 2;
+
+// A larger jump in sequence numbers is more likely a sender restart than
+// a burst loss, nothing is requested for it.
+static const uint32_t kMaxNACKGap = 128;
+
 ARTPSource::ARTPSource(
         uint32_t id,
         const sp<ASessionDescription> &sessionDesc, size_t index,
         const sp<AMessage> &notify)
     : mID(id),
       mHighestSeqNumber(0),
+      mBaseSeqNumber(0),
       mNumBuffersReceived(0),
+      mExpectedPrior(0),
+      mReceivedPrior(0),
+      mClockRate(0),
+      mLastTransitValid(false),
+      mLastTransit(0),
+      mJitter(0.0),
+      mNACKEnabled(false),
+      mNACKRoundTripUs(kInitialNACKRoundTripUs),
+      mMaxLossTimeoutUs(kMaxLossTimeoutUs),
       mLastNTPTime(0),
       mLastNTPTimeUpdateUs(0),
       mIssueFIRRequests(false),
@@ -79,6 +104,24 @@ ARTPSource::ARTPSource(
     } else {
         TRESPASS();
     }
+
+    int32_t numChannels;
+    ASessionDescription::ParseFormatDesc(
+            desc.c_str(), &mClockRate, &numChannels);
+
+    AString value;
+    char key[40];
+    snprintf(key, sizeof(key), "a=rtcp-fb:%lu nack", PT);
+    mNACKEnabled = sessionDesc->findAttribute(index, key, &value)
+            || sessionDesc->findAttribute(index, "a=rtcp-fb:* nack", &value);
+
+    unsigned long fecPT;
+    if (sessionDesc->findPayloadType(index, "ulpfec/", &fecPT)) {
+        mFECDecoder = new AULPFECDecoder;
+    }
+
+    ALOGV("source 0x%08x: clock rate %d, nack %d, fec %d",
+          mID, mClockRate, mNACKEnabled, mFECDecoder != NULL);
 }
 
 static uint32_t AbsDiff(uint32_t seq1, uint32_t seq2) {
@@ -86,6 +129,14 @@ static uint32_t AbsDiff(uint32_t seq1, uint32_t seq2) {
 }
 
 void ARTPSource::processRTPPacket(const sp<ABuffer> &buffer) {
+    if (mFECDecoder != NULL) {
+        // ARTPConnection leaves the RTP header in front of the payload.
+        int32_t rtpLength;
+        if (buffer->meta()->findInt32("rtp-length", &rtpLength)) {
+            mFECDecoder->addMediaPacket(buffer->base(), rtpLength);
+        }
+    }
+
     if (queuePacket(buffer) && mAssembler != NULL) {
         mAssembler->onPacketReceived(this);
     }
@@ -102,11 +153,87 @@ void ARTPSource::timeUpdate(uint32_t rtpTime, uint64_t ntpTime) {
     notify->post();
 }
 
+void ARTPSource::processFECPacket(
+        const uint8_t *data, size_t size, List<sp<ABuffer> > *recovered) {
+    if (mFECDecoder != NULL) {
+        mFECDecoder->addFECPacket(data, size, recovered);
+    }
+}
+
+void ARTPSource::updateJitter(const sp<ABuffer> &buffer, int64_t nowUs) {
+    if (mClockRate <= 0) {
+        return;
+    }
+
+    uint32_t rtpTime;
+    CHECK(buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
+
+    uint32_t arrival = (uint32_t)(nowUs * mClockRate / 1000000ll);
+    uint32_t transit = arrival - rtpTime;
+
+    if (mLastTransitValid) {
+        int32_t d = (int32_t)(transit - mLastTransit);
+        if (d < 0) {
+            d = -d;
+        }
+        mJitter += (d - mJitter) / 16.0;
+    }
+
+    mLastTransit = transit;
+    mLastTransitValid = true;
+}
+
+bool ARTPSource::updateMissingPackets(
+        uint32_t seqNum, uint32_t prevHighestSeqNumber, int64_t nowUs) {
+    if (!mNACKEnabled) {
+        return false;
+    }
+
+    ssize_t index = mMissingPackets.indexOfKey(seqNum);
+    if (index >= 0) {
+        const MissingPacket &missing = mMissingPackets.valueAt(index);
+        if (missing.mFirstNACKUs >= 0) {
+            int64_t roundTripUs = nowUs - missing.mFirstNACKUs;
+            mNACKRoundTripUs = (7 * mNACKRoundTripUs + roundTripUs) / 8;
+        }
+        mMissingPackets.removeItemsAt(index);
+
+        // A late or retransmitted packet, it says nothing about jitter.
+        return true;
+    }
+
+    if (seqNum <= prevHighestSeqNumber + 1) {
+        return false;
+    }
+
+    if (seqNum - prevHighestSeqNumber - 1 > kMaxNACKGap) {
+        ALOGV("not requesting %u missing packets",
+              seqNum - prevHighestSeqNumber - 1);
+        return false;
+    }
+
+    MissingPacket missing;
+    missing.mDetectedUs = nowUs;
+    missing.mFirstNACKUs = -1;
+    missing.mLastNACKUs = -1;
+    missing.mNumNACKs = 0;
+
+    for (uint32_t s = prevHighestSeqNumber + 1; s < seqNum; ++s) {
+        mMissingPackets.add(s, missing);
+    }
+
+    return false;
+}
+
 bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
     uint32_t seqNum = (uint32_t)buffer->int32Data();
 
+    int64_t nowUs = ALooper::GetNowUs();
+
     if (mNumBuffersReceived++ == 0) {
         mHighestSeqNumber = seqNum;
+        mBaseSeqNumber = seqNum;
+        updateJitter(buffer, nowUs);
         mQueue.push_back(buffer);
         return true;
     }
@@ -138,12 +265,17 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
         seqNum = seq3;
     }
 
+    uint32_t prevHighestSeqNumber = mHighestSeqNumber;
     if (seqNum > mHighestSeqNumber) {
         mHighestSeqNumber = seqNum;
     }
 
     buffer->setInt32Data(seqNum);
 
+    if (!updateMissingPackets(seqNum, prevHighestSeqNumber, nowUs)) {
+        updateJitter(buffer, nowUs);
+    }
+
     List<sp<ABuffer> >::iterator it = mQueue.begin();
     while (it != mQueue.end() && (uint32_t)(*it)->int32Data() < seqNum) {
         ++it;
@@ -151,6 +283,7 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     if (it != mQueue.end() && (uint32_t)(*it)->int32Data() == seqNum) {
         ALOGW("Discarding duplicate buffer");
+        --mNumBuffersReceived;
         return false;
     }
 
@@ -235,21 +368,45 @@ void ARTPSource::addReceiverReport(const sp<ABuffer> &buffer) {
     data[10] = (mID >> 8) & 0xff;
     data[11] = mID & 0xff;
 
-    data[12] = 0x00;  // fraction lost
+    uint32_t expected = mHighestSeqNumber - mBaseSeqNumber + 1;
+    if (mNumBuffersReceived == 0) {
+        expected = 0;
+    }
+
+    int32_t lost = (int32_t)(expected - (uint32_t)mNumBuffersReceived);
+    if (lost > 0x7fffff) {
+        lost = 0x7fffff;
+    } else if (lost < -0x800000) {
+        lost = -0x800000;
+    }
+
+    uint32_t expectedInterval = expected - mExpectedPrior;
+    int32_t receivedInterval = mNumBuffersReceived - mReceivedPrior;
+    int64_t lostInterval = (int64_t)expectedInterval - receivedInterval;
+    mExpectedPrior = expected;
+    mReceivedPrior = mNumBuffersReceived;
 
-    data[13] = 0x00;  // cumulative lost
-    data[14] = 0x00;
-    data[15] = 0x00;
+    uint8_t fraction = 0;
+    if (expectedInterval > 0 && lostInterval > 0) {
+        fraction = (uint8_t)((lostInterval << 8) / expectedInterval);
+    }
+
+    data[12] = fraction;  // fraction lost
+
+    data[13] = (lost >> 16) & 0xff;  // cumulative lost
+    data[14] = (lost >> 8) & 0xff;
+    data[15] = lost & 0xff;
 
     data[16] = mHighestSeqNumber >> 24;
     data[17] = (mHighestSeqNumber >> 16) & 0xff;
     data[18] = (mHighestSeqNumber >> 8) & 0xff;
     data[19] = mHighestSeqNumber & 0xff;
 
-    data[20] = 0x00;  // Interarrival jitter
-    data[21] = 0x00;
-    data[22] = 0x00;
-    data[23] = 0x00;
+    uint32_t jitter = (uint32_t)mJitter;
+    data[20] = jitter >> 24;  // Interarrival jitter
+    data[21] = (jitter >> 16) & 0xff;
+    data[22] = (jitter >> 8) & 0xff;
+    data[23] = jitter & 0xff;
 
     uint32_t LSR = 0;
     uint32_t DLSR = 0;
@@ -273,6 +430,142 @@ void ARTPSource::addReceiverReport(const sp<ABuffer> &buffer) {
     buffer->setRange(buffer->offset(), buffer->size() + 32);
 }
 
+int64_t ARTPSource::lossTimeoutUs() const {
+    int64_t timeoutUs = kMinLossTimeoutUs;
+
+    if (mClockRate > 0) {
+        timeoutUs += 4 * (int64_t)(mJitter * 1E6 / mClockRate);
+    }
+
+    if (mNACKEnabled) {
+        // Leave time for a retransmission and one retry.
+        timeoutUs += 2 * mNACKRoundTripUs;
+    }
+
+    return timeoutUs < mMaxLossTimeoutUs ? timeoutUs : mMaxLossTimeoutUs;
+}
+
+bool ARTPSource::hasPendingNACKs() {
+    if (mMissingPackets.isEmpty()) {
+        return false;
+    }
+
+    int64_t nowUs = ALooper::GetNowUs();
+    int64_t timeoutUs = lossTimeoutUs();
+    int64_t intervalUs = mNACKRoundTripUs > kMinNACKIntervalUs
+            ? mNACKRoundTripUs : kMinNACKIntervalUs;
+
+    bool pending = false;
+    for (size_t i = mMissingPackets.size(); i > 0;) {
+        --i;
+        const MissingPacket &missing = mMissingPackets.valueAt(i);
+
+        if (nowUs - missing.mDetectedUs >= timeoutUs) {
+            // The assembler has given up on it by now.
+            mMissingPackets.removeItemsAt(i);
+            continue;
+        }
+
+        if (missing.mNumNACKs < kMaxNACKsPerPacket
+                && (missing.mLastNACKUs < 0
+                    || nowUs - missing.mLastNACKUs >= intervalUs)) {
+            pending = true;
+        }
+    }
+
+    return pending;
+}
+
+void ARTPSource::addNACK(const sp<ABuffer> &buffer) {
+    if (buffer->size() + 16 > buffer->capacity()) {
+        ALOGW("RTCP buffer too small to accomodate NACK.");
+        return;
+    }
+
+    int64_t nowUs = ALooper::GetNowUs();
+    int64_t intervalUs = mNACKRoundTripUs > kMinNACKIntervalUs
+            ? mNACKRoundTripUs : kMinNACKIntervalUs;
+
+    size_t maxFCIs = (buffer->capacity() - buffer->size() - 12) / 4;
+
+    uint8_t *data = buffer->data() + buffer->size();
+    size_t numFCIs = 0;
+
+    // Each FCI requests its packet ID and, through the bitmask, any of
+    // the 16 packets following it.
+    size_t i = 0;
+    while (i < mMissingPackets.size() && numFCIs < maxFCIs) {
+        MissingPacket *missing = &mMissingPackets.editValueAt(i);
+        uint32_t pid = mMissingPackets.keyAt(i);
+        ++i;
+
+        if (missing->mNumNACKs >= kMaxNACKsPerPacket
+                || (missing->mLastNACKUs >= 0
+                    && nowUs - missing->mLastNACKUs < intervalUs)) {
+            continue;
+        }
+
+        uint16_t blp = 0;
+        for (;;) {
+            if (missing->mFirstNACKUs < 0) {
+                missing->mFirstNACKUs = nowUs;
+            }
+            missing->mLastNACKUs = nowUs;
+            ++missing->mNumNACKs;
+
+            // Find the next packet that is due within the bitmask range.
+            missing = NULL;
+            while (i < mMissingPackets.size()
+                    && mMissingPackets.keyAt(i) - pid <= 16) {
+                MissingPacket *next = &mMissingPackets.editValueAt(i);
+                uint32_t seqNum = mMissingPackets.keyAt(i);
+                ++i;
+
+                if (next->mNumNACKs < kMaxNACKsPerPacket
+                        && (next->mLastNACKUs < 0
+                            || nowUs - next->mLastNACKUs >= intervalUs)) {
+                    blp |= 1 << (seqNum - pid - 1);
+                    missing = next;
+                    break;
+                }
+            }
+
+            if (missing == NULL) {
+                break;
+            }
+        }
+
+        uint8_t *fci = &data[12 + 4 * numFCIs];
+        fci[0] = (pid >> 8) & 0xff;
+        fci[1] = pid & 0xff;
+        fci[2] = blp >> 8;
+        fci[3] = blp & 0xff;
+        ++numFCIs;
+    }
+
+    if (numFCIs == 0) {
+        return;
+    }
+
+    data[0] = 0x80 | 1;  // FMT=1, generic NACK
+    data[1] = 205;  // RTPFB
+    data[2] = 0;
+    data[3] = 2 + numFCIs;
+    data[4] = kSourceID >> 24;
+    data[5] = (kSourceID >> 16) & 0xff;
+    data[6] = (kSourceID >> 8) & 0xff;
+    data[7] = kSourceID & 0xff;
+
+    data[8] = mID >> 24;
+    data[9] = (mID >> 16) & 0xff;
+    data[10] = (mID >> 8) & 0xff;
+    data[11] = mID & 0xff;
+
+    buffer->setRange(buffer->offset(), buffer->size() + 12 + 4 * numFCIs);
+
+    ALOGV("Added NACK with %zu entries.", numFCIs);
+}
+
 }  // namespace android
 
 
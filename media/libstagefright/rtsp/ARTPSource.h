@@ -21,6 +21,7 @@
 #include <stdint.h>
 
 #include <media/stagefright/foundation/ABase.h>
+#include <utils/KeyedVector.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
 
@@ -30,6 +31,7 @@ struct ABuffer;
 struct AMessage;
 struct ARTPAssembler;
 struct ASessionDescription;
+struct AULPFECDecoder;
 
 struct ARTPSource : public RefBase {
     ARTPSource(
@@ -46,11 +48,52 @@ struct ARTPSource : public RefBase {
     void addReceiverReport(const sp<ABuffer> &buffer);
     void addFIR(const sp<ABuffer> &buffer);
 
+    // How long the assembler should wait for a missing packet before
+    // giving up on it, derived from the measured interarrival jitter and,
+    // if the sender retransmits, the NACK round trip time.
+    int64_t lossTimeoutUs() const;
+
+    // Caps lossTimeoutUs(), a live viewer would rather see a damaged
+    // access unit than wait for a late packet.
+    void setMaxLossTimeoutUs(int64_t timeoutUs) { mMaxLossTimeoutUs = timeoutUs; }
+
+    // Generic NACKs (RFC 4585), only if the session description announced
+    // "a=rtcp-fb:<pt> nack".
+    bool hasPendingNACKs();
+    void addNACK(const sp<ABuffer> &buffer);
+
+    bool usesFEC() const { return mFECDecoder != NULL; }
+    void processFECPacket(
+            const uint8_t *data, size_t size, List<sp<ABuffer> > *recovered);
+
 private:
+    struct MissingPacket {
+        int64_t mDetectedUs;
+        int64_t mFirstNACKUs;
+        int64_t mLastNACKUs;
+        int32_t mNumNACKs;
+    };
+
     uint32_t mID;
     uint32_t mHighestSeqNumber;
+    uint32_t mBaseSeqNumber;
     int32_t mNumBuffersReceived;
 
+    // Receiver report state, RFC 3550 appendix A.3 and A.8.
+    uint32_t mExpectedPrior;
+    int32_t mReceivedPrior;
+    int32_t mClockRate;
+    bool mLastTransitValid;
+    uint32_t mLastTransit;
+    double mJitter;  // in units of mClockRate
+
+    bool mNACKEnabled;
+    int64_t mNACKRoundTripUs;
+    int64_t mMaxLossTimeoutUs;
+    KeyedVector<uint32_t, MissingPacket> mMissingPackets;
+
+    sp<AULPFECDecoder> mFECDecoder;
+
     List<sp<ABuffer> > mQueue;
     sp<ARTPAssembler> mAssembler;
 
@@ -65,6 +108,10 @@ private:
 
     bool queuePacket(const sp<ABuffer> &buffer);
 
+    void updateJitter(const sp<ABuffer> &buffer, int64_t nowUs);
+    bool updateMissingPackets(
+            uint32_t seqNum, uint32_t prevHighestSeqNumber, int64_t nowUs);
+
     DISALLOW_EVIL_CONSTRUCTORS(ARTPSource);
 };
 
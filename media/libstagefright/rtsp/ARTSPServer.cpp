@@ -0,0 +1,1402 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ARTSPServer"
+#include <utils/Log.h>
+
+#include "ARTSPServer.h"
+
+#include "include/avc_utils.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+#include <time.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/ANetworkSession.h>
+#include <media/stagefright/foundation/ParsedMessage.h>
+#include <media/stagefright/foundation/base64.h>
+#include <media/stagefright/Utils.h>
+
+namespace android {
+
+const int64_t ARTSPServer::kSRIntervalUs;
+const int64_t ARTSPServer::kReaperIntervalUs;
+const int64_t ARTSPServer::kClientTimeoutSecs;
+const int64_t ARTSPServer::kClientTimeoutUs;
+const int64_t ARTSPServer::kMinIDRRequestIntervalUs;
+
+static const size_t kMaxPortAttempts = 16;
+
+// Picks an even port in range [1024, 65534).
+static int32_t PickRandomRTPPort() {
+    static const size_t kRange = (65534 - 1024) / 2;
+
+    return (int32_t)(((float)(kRange + 1) * rand()) / RAND_MAX) * 2 + 1024;
+}
+
+static status_t PostAndAwaitResponse(
+        const sp<AMessage> &msg, sp<AMessage> *response) {
+    status_t err = msg->postAndAwaitResponse(response);
+
+    if (err != OK) {
+        return err;
+    }
+
+    if (response == NULL || !(*response)->findInt32("err", &err)) {
+        err = OK;
+    }
+
+    return err;
+}
+
+ARTSPServer::ARTSPServer(
+        const sp<ANetworkSession> &netSession, const sp<AMessage> &notify)
+    : mNetSession(netSession),
+      mNotify(notify),
+      mStarted(false),
+      mSessionID(0),
+      mMulticastEnabled(false),
+      mMulticastPort(0),
+      mMulticastRTPSessionID(0),
+      mMulticastRTCPSessionID(0),
+      mNumMulticastClients(0),
+      mMulticastWaitForIDR(false),
+      mSourceID(0),
+      mSeqNo(0),
+      mRTPTimeBase(0),
+      mNumRTPSent(0),
+      mNumRTPOctetsSent(0),
+      mLastRTPTime(0),
+      mLastNTPTime(0),
+      mLastIDRRequestUs(-1ll),
+      mSRPending(false),
+      mReaperPending(false) {
+}
+
+ARTSPServer::~ARTSPServer() {
+    CHECK(!mStarted);
+}
+
+status_t ARTSPServer::start(
+        const char *iface, const char *multicastGroup, unsigned multicastPort) {
+    sp<AMessage> msg = new AMessage(kWhatStart, this);
+    msg->setString("iface", iface);
+    if (multicastGroup != NULL) {
+        msg->setString("multicastGroup", multicastGroup);
+        msg->setInt32("multicastPort", multicastPort);
+    }
+
+    sp<AMessage> response;
+    return PostAndAwaitResponse(msg, &response);
+}
+
+status_t ARTSPServer::stop() {
+    sp<AMessage> msg = new AMessage(kWhatStop, this);
+
+    sp<AMessage> response;
+    return PostAndAwaitResponse(msg, &response);
+}
+
+void ARTSPServer::queueAccessUnit(const sp<ABuffer> &accessUnit) {
+    sp<AMessage> msg = new AMessage(kWhatAccessUnit, this);
+    msg->setBuffer("accessUnit", accessUnit);
+    msg->post();
+}
+
+void ARTSPServer::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatStart:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            status_t err = onStart(msg);
+
+            sp<AMessage> response = new AMessage;
+            response->setInt32("err", err);
+            response->postReply(replyID);
+            break;
+        }
+
+        case kWhatStop:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            onStop();
+
+            sp<AMessage> response = new AMessage;
+            response->setInt32("err", OK);
+            response->postReply(replyID);
+            break;
+        }
+
+        case kWhatAccessUnit:
+        {
+            if (!mStarted) {
+                break;
+            }
+
+            sp<ABuffer> accessUnit;
+            CHECK(msg->findBuffer("accessUnit", &accessUnit));
+
+            onAccessUnit(accessUnit);
+            break;
+        }
+
+        case kWhatRTSPNotify:
+        {
+            onRTSPNotify(msg);
+            break;
+        }
+
+        case kWhatRTPNotify:
+        case kWhatRTCPNotify:
+        {
+            onUDPNotify(msg->what() == kWhatRTPNotify, msg);
+            break;
+        }
+
+        case kWhatSendSR:
+        {
+            mSRPending = false;
+
+            if (mStarted) {
+                sendSR();
+            }
+            break;
+        }
+
+        case kWhatReapDeadClients:
+        {
+            mReaperPending = false;
+
+            if (mStarted) {
+                reapDeadClients();
+            }
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+status_t ARTSPServer::onStart(const sp<AMessage> &msg) {
+    if (mStarted) {
+        return INVALID_OPERATION;
+    }
+
+    AString iface;
+    CHECK(msg->findString("iface", &iface));
+
+    unsigned long port = kDefaultPort;
+
+    ssize_t colonPos = iface.find(":");
+    if (colonPos >= 0) {
+        const char *s = iface.c_str() + colonPos + 1;
+
+        char *end;
+        port = strtoul(s, &end, 10);
+
+        if (end == s || *end != '\0' || port > 65535) {
+            return -EINVAL;
+        }
+
+        iface.erase(colonPos, iface.size() - colonPos);
+    }
+
+    struct in_addr addr;
+    if (inet_aton(iface.c_str(), &addr) == 0) {
+        return -EINVAL;
+    }
+
+    mMulticastEnabled = false;
+    if (msg->findString("multicastGroup", &mMulticastGroup)) {
+        int32_t multicastPort;
+        CHECK(msg->findInt32("multicastPort", &multicastPort));
+
+        struct in_addr groupAddr;
+        if (inet_aton(mMulticastGroup.c_str(), &groupAddr) == 0
+                || !IN_MULTICAST(ntohl(groupAddr.s_addr))
+                || multicastPort <= 0 || multicastPort >= 65535
+                || (multicastPort & 1)) {
+            return -EINVAL;
+        }
+
+        mMulticastEnabled = true;
+        mMulticastPort = multicastPort;
+    }
+
+    sp<AMessage> notify = new AMessage(kWhatRTSPNotify, this);
+
+    status_t err = mNetSession->createRTSPServer(
+            addr, port, notify, &mSessionID);
+
+    if (err != OK) {
+        return err;
+    }
+
+    mSourceID = rand();
+    mSeqNo = rand() & 0xffff;
+    mRTPTimeBase = rand();
+    mNumRTPSent = 0;
+    mNumRTPOctetsSent = 0;
+    mLastRTPTime = 0;
+    mLastNTPTime = 0;
+    mLastIDRRequestUs = -1ll;
+
+    mStarted = true;
+
+    ALOGI("serving rtsp://%s:%lu/", iface.c_str(), port);
+
+    return OK;
+}
+
+void ARTSPServer::onStop() {
+    if (!mStarted) {
+        return;
+    }
+
+    while (!mClients.isEmpty()) {
+        removeClient(mClients.keyAt(0));
+    }
+
+    if (mMulticastRTCPSessionID != 0) {
+        mNetSession->destroySession(mMulticastRTCPSessionID);
+        mMulticastRTCPSessionID = 0;
+    }
+
+    if (mMulticastRTPSessionID != 0) {
+        mNetSession->destroySession(mMulticastRTPSessionID);
+        mMulticastRTPSessionID = 0;
+    }
+
+    mNetSession->destroySession(mSessionID);
+    mSessionID = 0;
+
+    for (size_t i = 0; i < kMaxHistorySize; ++i) {
+        mHistory[i] = Packet();
+    }
+
+    mSPS.clear();
+    mPPS.clear();
+
+    mStarted = false;
+}
+
+// static
+uint64_t ARTSPServer::GetNowNTP() {
+    uint64_t nowUs = ALooper::GetNowUs();
+
+    nowUs += ((70ll * 365 + 17) * 24) * 60 * 60 * 1000000ll;
+
+    uint64_t hi = nowUs / 1000000ll;
+    uint64_t lo = ((1ll << 32) * (nowUs % 1000000ll)) / 1000000ll;
+
+    return (hi << 32) | lo;
+}
+
+// static
+void ARTSPServer::PacketizeNALUnit(
+        List<Packet> *packets,
+        const sp<ABuffer> &buffer, size_t offset, size_t size) {
+    if (12 + size <= kMaxPacketSize) {
+        // Single NAL unit packet.
+        Packet packet;
+        packet.mHeader = new ABuffer(12);
+        packet.mPayload = buffer;
+        packet.mOffset = offset;
+        packet.mSize = size;
+        packets->push_back(packet);
+        return;
+    }
+
+    // FU-A, the NAL unit header becomes the FU indicator and header.
+    uint8_t nalHeader = buffer->data()[offset];
+
+    size_t srcOffset = 1;
+    while (srcOffset < size) {
+        size_t copy = kMaxPacketSize - 12 - 2;
+        if (copy > size - srcOffset) {
+            copy = size - srcOffset;
+        }
+
+        Packet packet;
+        packet.mHeader = new ABuffer(12 + 2);
+        packet.mPayload = buffer;
+        packet.mOffset = offset + srcOffset;
+        packet.mSize = copy;
+
+        uint8_t *dst = packet.mHeader->data() + 12;
+        dst[0] = (nalHeader & 0xe0) | 28;
+        dst[1] = nalHeader & 0x1f;
+
+        if (srcOffset == 1) {
+            dst[1] |= 0x80;
+        }
+
+        if (srcOffset + copy == size) {
+            dst[1] |= 0x40;
+        }
+
+        srcOffset += copy;
+
+        packets->push_back(packet);
+    }
+}
+
+void ARTSPServer::onAccessUnit(const sp<ABuffer> &accessUnit) {
+    bool hasSlices = false;
+    bool hasParameterSets = false;
+    bool isIDR = false;
+
+    const uint8_t *data = accessUnit->data();
+    size_t size = accessUnit->size();
+    const uint8_t *nalStart;
+    size_t nalSize;
+    while (getNextNALUnit(
+                &data, &size, &nalStart, &nalSize,
+                true /* startCodeFollows */) == OK) {
+        if (nalSize == 0) {
+            continue;
+        }
+
+        unsigned nalType = nalStart[0] & 0x1f;
+
+        if (nalType == 7 || nalType == 8) {
+            sp<ABuffer> nal = new ABuffer(nalSize);
+            memcpy(nal->data(), nalStart, nalSize);
+
+            if (nalType == 7) {
+                mSPS = nal;
+            } else {
+                mPPS = nal;
+            }
+
+            hasParameterSets = true;
+        } else if (nalType >= 1 && nalType <= 5) {
+            hasSlices = true;
+
+            if (nalType == 5) {
+                isIDR = true;
+            }
+        }
+    }
+
+    if (!hasSlices || numPlayingClients() == 0) {
+        return;
+    }
+
+    if (isIDR) {
+        for (size_t i = 0; i < mClients.size(); ++i) {
+            mClients.editValueAt(i).mWaitForIDR = false;
+        }
+        mMulticastWaitForIDR = false;
+    }
+
+    List<Packet> packets;
+
+    if (isIDR && !hasParameterSets && mSPS != NULL && mPPS != NULL) {
+        // Encoders emit the parameter sets only once, as codec specific
+        // data, clients that just joined need them in-band.
+        PacketizeNALUnit(&packets, mSPS, 0, mSPS->size());
+        PacketizeNALUnit(&packets, mPPS, 0, mPPS->size());
+    }
+
+    data = accessUnit->data();
+    size = accessUnit->size();
+    while (getNextNALUnit(
+                &data, &size, &nalStart, &nalSize,
+                true /* startCodeFollows */) == OK) {
+        if (nalSize > 0) {
+            PacketizeNALUnit(
+                    &packets, accessUnit, nalStart - accessUnit->data(), nalSize);
+        }
+    }
+
+    int64_t timeUs;
+    CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
+
+    uint32_t rtpTime = mRTPTimeBase + (timeUs * 9 / 100ll);
+
+    while (!packets.empty()) {
+        Packet packet = *packets.begin();
+        packets.erase(packets.begin());
+
+        bool last = packets.empty();
+
+        packet.mSeqNo = mSeqNo;
+
+        uint8_t *dst = packet.mHeader->data();
+        dst[0] = 0x80;
+        dst[1] = kPayloadType;
+        if (last) {
+            dst[1] |= 1 << 7;  // M-bit
+        }
+        dst[2] = (mSeqNo >> 8) & 0xff;
+        dst[3] = mSeqNo & 0xff;
+        dst[4] = rtpTime >> 24;
+        dst[5] = (rtpTime >> 16) & 0xff;
+        dst[6] = (rtpTime >> 8) & 0xff;
+        dst[7] = rtpTime & 0xff;
+        dst[8] = mSourceID >> 24;
+        dst[9] = (mSourceID >> 16) & 0xff;
+        dst[10] = (mSourceID >> 8) & 0xff;
+        dst[11] = mSourceID & 0xff;
+
+        ++mSeqNo;
+
+        mHistory[packet.mSeqNo & (kMaxHistorySize - 1)] = packet;
+
+        sendPacket(packet);
+
+        ++mNumRTPSent;
+        mNumRTPOctetsSent += packet.mHeader->size() - 12 + packet.mSize;
+    }
+
+    mLastRTPTime = rtpTime;
+    mLastNTPTime = GetNowNTP();
+}
+
+void ARTSPServer::sendPacket(const Packet &packet) {
+    for (size_t i = 0; i < mClients.size(); ++i) {
+        const Client &client = mClients.valueAt(i);
+
+        if (client.mState == PLAYING
+                && !client.mMulticast && !client.mWaitForIDR) {
+            sendPacketTo(packet, client.mRTPSessionID);
+        }
+    }
+
+    if (mNumMulticastClients > 0 && !mMulticastWaitForIDR) {
+        sendPacketTo(packet, mMulticastRTPSessionID);
+    }
+}
+
+void ARTSPServer::sendPacketTo(const Packet &packet, int32_t rtpSessionID) {
+    // Failures are reported through the session's notify.
+    mNetSession->sendRequest(
+            rtpSessionID,
+            packet.mHeader, packet.mPayload, packet.mOffset, packet.mSize);
+}
+
+void ARTSPServer::onRTSPNotify(const sp<AMessage> &msg) {
+    int32_t reason;
+    CHECK(msg->findInt32("reason", &reason));
+
+    int32_t sessionID;
+    CHECK(msg->findInt32("sessionID", &sessionID));
+
+    switch (reason) {
+        case ANetworkSession::kWhatError:
+        {
+            int32_t err;
+            CHECK(msg->findInt32("err", &err));
+
+            AString detail;
+            CHECK(msg->findString("detail", &detail));
+
+            ALOGW("An error occurred in session %d (%d, '%s/%s').",
+                  sessionID,
+                  err,
+                  detail.c_str(),
+                  strerror(-err));
+
+            if (sessionID == mSessionID) {
+                notifyError(err);
+            } else if (mClients.indexOfKey(sessionID) >= 0) {
+                removeClient(sessionID);
+            } else {
+                mNetSession->destroySession(sessionID);
+            }
+            break;
+        }
+
+        case ANetworkSession::kWhatClientConnected:
+        {
+            Client client;
+            client.mState = INIT;
+            CHECK(msg->findString("client-ip", &client.mRemoteIP));
+            CHECK(msg->findString("server-ip", &client.mLocalIP));
+            client.mPlaybackSessionID = -1;
+            client.mMulticast = false;
+            client.mRTPSessionID = 0;
+            client.mRTCPSessionID = 0;
+            client.mLocalRTPPort = 0;
+            client.mWaitForIDR = true;
+            client.mLastSeenUs = ALooper::GetNowUs();
+            client.mFractionLost = 0;
+
+            mClients.add(sessionID, client);
+
+            ALOGI("client %d connected from %s",
+                  sessionID, client.mRemoteIP.c_str());
+
+            scheduleReaper();
+            break;
+        }
+
+        case ANetworkSession::kWhatData:
+        {
+            onReceiveClientData(msg);
+            break;
+        }
+
+        case ANetworkSession::kWhatNetworkStall:
+        {
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+void ARTSPServer::onUDPNotify(bool isRTP, const sp<AMessage> &msg) {
+    int32_t reason;
+    CHECK(msg->findInt32("reason", &reason));
+
+    int32_t clientID;
+    CHECK(msg->findInt32("clientID", &clientID));
+
+    switch (reason) {
+        case ANetworkSession::kWhatError:
+        {
+            int32_t err;
+            CHECK(msg->findInt32("err", &err));
+
+            ALOGW("%s error %d (%s) for client %d",
+                  isRTP ? "RTP" : "RTCP", err, strerror(-err), clientID);
+
+            if (clientID == 0) {
+                notifyError(err);
+            } else if (mClients.indexOfKey(clientID) >= 0) {
+                // Most likely the client went away without a TEARDOWN.
+                removeClient(clientID);
+            }
+            break;
+        }
+
+        case ANetworkSession::kWhatDatagram:
+        {
+            sp<ABuffer> data;
+            CHECK(msg->findBuffer("data", &data));
+
+            if (!isRTP && clientID != 0) {
+                onRTCPData(clientID, data);
+            }
+            break;
+        }
+
+        case ANetworkSession::kWhatNetworkStall:
+        {
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+status_t ARTSPServer::onReceiveClientData(const sp<AMessage> &msg) {
+    int32_t sessionID;
+    CHECK(msg->findInt32("sessionID", &sessionID));
+
+    sp<RefBase> obj;
+    CHECK(msg->findObject("data", &obj));
+
+    sp<ParsedMessage> data =
+        static_cast<ParsedMessage *>(obj.get());
+
+    ALOGV("session %d received '%s'",
+          sessionID, data->debugString().c_str());
+
+    ssize_t index = mClients.indexOfKey(sessionID);
+    if (index < 0) {
+        return -ENOENT;
+    }
+
+    mClients.editValueAt(index).mLastSeenUs = ALooper::GetNowUs();
+
+    AString method;
+    data->getRequestField(0, &method);
+
+    int32_t cseq;
+    if (!data->findInt32("cseq", &cseq)) {
+        sendErrorResponse(sessionID, "400 Bad Request", -1 /* cseq */);
+        return ERROR_MALFORMED;
+    }
+
+    AString version;
+    data->getRequestField(2, &version);
+    if (!(version == AString("RTSP/1.0"))) {
+        sendErrorResponse(sessionID, "505 RTSP Version not supported", cseq);
+        return ERROR_UNSUPPORTED;
+    }
+
+    status_t err;
+    if (method == "OPTIONS") {
+        err = onOptionsRequest(sessionID, cseq, data);
+    } else if (method == "DESCRIBE") {
+        err = onDescribeRequest(sessionID, cseq, data);
+    } else if (method == "SETUP") {
+        err = onSetupRequest(sessionID, cseq, data);
+    } else if (method == "PLAY") {
+        err = onPlayRequest(sessionID, cseq, data);
+    } else if (method == "TEARDOWN") {
+        err = onTeardownRequest(sessionID, cseq, data);
+    } else if (method == "GET_PARAMETER") {
+        err = onGetParameterRequest(sessionID, cseq, data);
+    } else {
+        sendErrorResponse(sessionID, "405 Method Not Allowed", cseq);
+
+        err = ERROR_UNSUPPORTED;
+    }
+
+    return err;
+}
+
+ARTSPServer::Client *ARTSPServer::findClient(
+        int32_t sessionID, const sp<ParsedMessage> &data, bool *badSession) {
+    *badSession = false;
+
+    ssize_t index = mClients.indexOfKey(sessionID);
+    CHECK_GE(index, 0);
+
+    Client *client = &mClients.editValueAt(index);
+
+    int32_t playbackSessionID;
+    if (data->findInt32("session", &playbackSessionID)
+            && playbackSessionID != client->mPlaybackSessionID) {
+        *badSession = true;
+    }
+
+    return client;
+}
+
+status_t ARTSPServer::onOptionsRequest(
+        int32_t sessionID,
+        int32_t cseq,
+        const sp<ParsedMessage> & /* data */) {
+    AString response = "RTSP/1.0 200 OK\r\n";
+    AppendCommonResponse(&response, cseq);
+
+    response.append(
+            "Public: OPTIONS, DESCRIBE, SETUP, PLAY, TEARDOWN, "
+            "GET_PARAMETER\r\n");
+
+    response.append("\r\n");
+
+    return mNetSession->sendRequest(sessionID, response.c_str());
+}
+
+status_t ARTSPServer::onDescribeRequest(
+        int32_t sessionID,
+        int32_t cseq,
+        const sp<ParsedMessage> &data) {
+    if (mSPS == NULL || mPPS == NULL || mSPS->size() < 4) {
+        // Nothing has been encoded yet.
+        sendErrorResponse(sessionID, "503 Service Unavailable", cseq);
+        return -EAGAIN;
+    }
+
+    const Client &client = mClients.valueFor(sessionID);
+
+    AString uri;
+    data->getRequestField(1, &uri);
+
+    uint64_t ntp = GetNowNTP();
+
+    AString sdp = "v=0\r\n";
+    sdp.append(AStringPrintf(
+                "o=- %llu %llu IN IP4 %s\r\n",
+                (unsigned long long)ntp,
+                (unsigned long long)ntp,
+                client.mLocalIP.c_str()));
+    sdp.append(
+            "s=Live\r\n"
+            "c=IN IP4 0.0.0.0\r\n"
+            "t=0 0\r\n"
+            "a=range:npt=now-\r\n"
+            "a=control:*\r\n");
+
+    sdp.append(AStringPrintf(
+                "m=video 0 RTP/AVP %d\r\n"
+                "a=rtpmap:%d H264/90000\r\n",
+                kPayloadType, kPayloadType));
+
+    AString sps, pps;
+    encodeBase64(mSPS->data(), mSPS->size(), &sps);
+    encodeBase64(mPPS->data(), mPPS->size(), &pps);
+
+    sdp.append(AStringPrintf(
+                "a=fmtp:%d packetization-mode=1;profile-level-id=%02X%02X%02X;"
+                "sprop-parameter-sets=%s,%s\r\n",
+                kPayloadType,
+                mSPS->data()[1], mSPS->data()[2], mSPS->data()[3],
+                sps.c_str(), pps.c_str()));
+
+    sdp.append("a=control:trackID=0\r\n");
+
+    AString response = "RTSP/1.0 200 OK\r\n";
+    AppendCommonResponse(&response, cseq);
+
+    response.append("Content-Type: application/sdp\r\n");
+
+    if (!uri.endsWith("/")) {
+        uri.append("/");
+    }
+    response.append(AStringPrintf("Content-Base: %s\r\n", uri.c_str()));
+
+    response.append(AStringPrintf("Content-Length: %zu\r\n", sdp.size()));
+    response.append("\r\n");
+    response.append(sdp);
+
+    return mNetSession->sendRequest(sessionID, response.c_str());
+}
+
+status_t ARTSPServer::onSetupRequest(
+        int32_t sessionID,
+        int32_t cseq,
+        const sp<ParsedMessage> &data) {
+    bool badSession;
+    Client *client = findClient(sessionID, data, &badSession);
+
+    if (client->mState != INIT) {
+        // A single track per client.
+        sendErrorResponse(
+                sessionID, "455 Method Not Valid in This State", cseq);
+        return INVALID_OPERATION;
+    }
+
+    AString transport;
+    if (!data->findString("transport", &transport)) {
+        sendErrorResponse(sessionID, "400 Bad Request", cseq);
+        return ERROR_MALFORMED;
+    }
+
+    if (!transport.startsWith("RTP/AVP;")
+            && !transport.startsWith("RTP/AVP/UDP;")) {
+        sendErrorResponse(sessionID, "461 Unsupported Transport", cseq);
+        return ERROR_UNSUPPORTED;
+    }
+
+    bool multicast = strstr(transport.c_str(), ";multicast") != NULL;
+
+    AString response = "RTSP/1.0 200 OK\r\n";
+
+    if (multicast) {
+        if (!mMulticastEnabled) {
+            sendErrorResponse(sessionID, "461 Unsupported Transport", cseq);
+            return ERROR_UNSUPPORTED;
+        }
+
+        status_t err = setupMulticast();
+        if (err != OK) {
+            sendErrorResponse(sessionID, "500 Internal Server Error", cseq);
+            return err;
+        }
+
+        client->mMulticast = true;
+
+        response.append(AStringPrintf(
+                    "Transport: RTP/AVP;multicast;destination=%s;port=%u-%u;"
+                    "ttl=1;ssrc=%08X\r\n",
+                    mMulticastGroup.c_str(),
+                    mMulticastPort, mMulticastPort + 1,
+                    mSourceID));
+    } else {
+        int clientRtp, clientRtcp;
+
+        AString clientPort;
+        if (!ParsedMessage::GetAttribute(
+                    transport.c_str(), "client_port", &clientPort)) {
+            sendErrorResponse(sessionID, "400 Bad Request", cseq);
+            return ERROR_MALFORMED;
+        } else if (sscanf(clientPort.c_str(), "%d-%d",
+                          &clientRtp, &clientRtcp) == 2) {
+        } else if (sscanf(clientPort.c_str(), "%d", &clientRtp) == 1) {
+            // No RTCP.
+            clientRtcp = -1;
+        } else {
+            sendErrorResponse(sessionID, "400 Bad Request", cseq);
+            return ERROR_MALFORMED;
+        }
+
+        status_t err = UNKNOWN_ERROR;
+        int32_t localRTPPort = 0;
+        for (size_t attempt = 0; attempt < kMaxPortAttempts; ++attempt) {
+            localRTPPort = PickRandomRTPPort();
+
+            sp<AMessage> rtpNotify = new AMessage(kWhatRTPNotify, this);
+            rtpNotify->setInt32("clientID", sessionID);
+
+            err = mNetSession->createUDPSession(
+                    localRTPPort,
+                    client->mRemoteIP.c_str(),
+                    clientRtp,
+                    rtpNotify,
+                    &client->mRTPSessionID);
+
+            if (err != OK) {
+                continue;
+            }
+
+            if (clientRtcp < 0) {
+                break;
+            }
+
+            sp<AMessage> rtcpNotify = new AMessage(kWhatRTCPNotify, this);
+            rtcpNotify->setInt32("clientID", sessionID);
+
+            err = mNetSession->createUDPSession(
+                    localRTPPort + 1,
+                    client->mRemoteIP.c_str(),
+                    clientRtcp,
+                    rtcpNotify,
+                    &client->mRTCPSessionID);
+
+            if (err == OK) {
+                break;
+            }
+
+            mNetSession->destroySession(client->mRTPSessionID);
+            client->mRTPSessionID = 0;
+        }
+
+        if (err != OK) {
+            sendErrorResponse(sessionID, "500 Internal Server Error", cseq);
+            return err;
+        }
+
+        client->mMulticast = false;
+        client->mLocalRTPPort = localRTPPort;
+
+        if (clientRtcp >= 0) {
+            response.append(AStringPrintf(
+                        "Transport: RTP/AVP;unicast;client_port=%d-%d;"
+                        "server_port=%d-%d;ssrc=%08X\r\n",
+                        clientRtp, clientRtcp,
+                        localRTPPort, localRTPPort + 1,
+                        mSourceID));
+        } else {
+            response.append(AStringPrintf(
+                        "Transport: RTP/AVP;unicast;client_port=%d;"
+                        "server_port=%d;ssrc=%08X\r\n",
+                        clientRtp, localRTPPort, mSourceID));
+        }
+    }
+
+    if (!badSession && client->mPlaybackSessionID < 0) {
+        client->mPlaybackSessionID = rand() & 0x7fffffff;
+    }
+
+    client->mState = READY;
+
+    AppendCommonResponse(&response, cseq, client->mPlaybackSessionID);
+    response.append("\r\n");
+
+    return mNetSession->sendRequest(sessionID, response.c_str());
+}
+
+status_t ARTSPServer::onPlayRequest(
+        int32_t sessionID,
+        int32_t cseq,
+        const sp<ParsedMessage> &data) {
+    bool badSession;
+    Client *client = findClient(sessionID, data, &badSession);
+
+    if (badSession) {
+        sendErrorResponse(sessionID, "454 Session Not Found", cseq);
+        return -ENOENT;
+    }
+
+    if (client->mState == INIT) {
+        sendErrorResponse(
+                sessionID, "455 Method Not Valid in This State", cseq);
+        return INVALID_OPERATION;
+    }
+
+    AString response = "RTSP/1.0 200 OK\r\n";
+    AppendCommonResponse(&response, cseq, client->mPlaybackSessionID);
+    response.append("Range: npt=now-\r\n");
+    response.append("\r\n");
+
+    status_t err = mNetSession->sendRequest(sessionID, response.c_str());
+
+    if (err == OK && client->mState != PLAYING) {
+        startPlaying(client);
+    }
+
+    return err;
+}
+
+status_t ARTSPServer::onTeardownRequest(
+        int32_t sessionID,
+        int32_t cseq,
+        const sp<ParsedMessage> &data) {
+    bool badSession;
+    Client *client = findClient(sessionID, data, &badSession);
+
+    if (badSession) {
+        sendErrorResponse(sessionID, "454 Session Not Found", cseq);
+        return -ENOENT;
+    }
+
+    AString response = "RTSP/1.0 200 OK\r\n";
+    AppendCommonResponse(&response, cseq, client->mPlaybackSessionID);
+    response.append("Connection: close\r\n");
+    response.append("\r\n");
+
+    status_t err = mNetSession->sendRequest(sessionID, response.c_str());
+
+    stopPlaying(client);
+
+    if (client->mRTCPSessionID != 0) {
+        mNetSession->destroySession(client->mRTCPSessionID);
+        client->mRTCPSessionID = 0;
+    }
+
+    if (client->mRTPSessionID != 0) {
+        mNetSession->destroySession(client->mRTPSessionID);
+        client->mRTPSessionID = 0;
+    }
+
+    client->mState = INIT;
+    client->mMulticast = false;
+    client->mPlaybackSessionID = -1;
+
+    return err;
+}
+
+status_t ARTSPServer::onGetParameterRequest(
+        int32_t sessionID,
+        int32_t cseq,
+        const sp<ParsedMessage> &data) {
+    // Only used as a keep-alive.
+    bool badSession;
+    Client *client = findClient(sessionID, data, &badSession);
+
+    if (badSession) {
+        sendErrorResponse(sessionID, "454 Session Not Found", cseq);
+        return -ENOENT;
+    }
+
+    AString response = "RTSP/1.0 200 OK\r\n";
+    AppendCommonResponse(&response, cseq, client->mPlaybackSessionID);
+    response.append("\r\n");
+
+    return mNetSession->sendRequest(sessionID, response.c_str());
+}
+
+status_t ARTSPServer::setupMulticast() {
+    if (mMulticastRTPSessionID != 0) {
+        return OK;
+    }
+
+    sp<AMessage> rtpNotify = new AMessage(kWhatRTPNotify, this);
+    rtpNotify->setInt32("clientID", 0);
+
+    status_t err = mNetSession->createUDPSession(
+            mMulticastPort,
+            mMulticastGroup.c_str(),
+            mMulticastPort,
+            rtpNotify,
+            &mMulticastRTPSessionID);
+
+    if (err != OK) {
+        return err;
+    }
+
+    sp<AMessage> rtcpNotify = new AMessage(kWhatRTCPNotify, this);
+    rtcpNotify->setInt32("clientID", 0);
+
+    err = mNetSession->createUDPSession(
+            mMulticastPort + 1,
+            mMulticastGroup.c_str(),
+            mMulticastPort + 1,
+            rtcpNotify,
+            &mMulticastRTCPSessionID);
+
+    if (err != OK) {
+        mNetSession->destroySession(mMulticastRTPSessionID);
+        mMulticastRTPSessionID = 0;
+    }
+
+    return err;
+}
+
+void ARTSPServer::startPlaying(Client *client) {
+    client->mState = PLAYING;
+
+    if (client->mMulticast) {
+        if (mNumMulticastClients++ == 0) {
+            mMulticastWaitForIDR = true;
+            requestIDR();
+        }
+    } else {
+        client->mWaitForIDR = true;
+        requestIDR();
+    }
+
+    if (!mSRPending) {
+        mSRPending = true;
+        (new AMessage(kWhatSendSR, this))->post(kSRIntervalUs);
+    }
+
+    notifyClientsChanged();
+}
+
+void ARTSPServer::stopPlaying(Client *client) {
+    if (client->mState != PLAYING) {
+        return;
+    }
+
+    client->mState = READY;
+
+    if (client->mMulticast) {
+        CHECK_GT(mNumMulticastClients, 0u);
+        --mNumMulticastClients;
+    }
+
+    notifyClientsChanged();
+}
+
+void ARTSPServer::removeClient(int32_t sessionID) {
+    ssize_t index = mClients.indexOfKey(sessionID);
+    CHECK_GE(index, 0);
+
+    Client *client = &mClients.editValueAt(index);
+
+    stopPlaying(client);
+
+    if (client->mRTCPSessionID != 0) {
+        mNetSession->destroySession(client->mRTCPSessionID);
+    }
+
+    if (client->mRTPSessionID != 0) {
+        mNetSession->destroySession(client->mRTPSessionID);
+    }
+
+    mNetSession->destroySession(sessionID);
+
+    ALOGI("client %d removed", sessionID);
+
+    mClients.removeItemsAt(index);
+}
+
+void ARTSPServer::onRTCPData(int32_t sessionID, const sp<ABuffer> &buffer) {
+    ssize_t index = mClients.indexOfKey(sessionID);
+    if (index < 0) {
+        return;
+    }
+
+    mClients.editValueAt(index).mLastSeenUs = ALooper::GetNowUs();
+
+    const uint8_t *data = buffer->data();
+    size_t size = buffer->size();
+
+    while (size >= 8) {
+        if ((data[0] >> 6) != 2) {
+            // Unsupported version.
+            return;
+        }
+
+        size_t headerLength = 4 * (U16_AT(&data[2]) + 1);
+
+        if (size < headerLength) {
+            // Only received a partial packet?
+            return;
+        }
+
+        switch (data[1]) {
+            case 200:
+            case 201:  // RR
+                parseReceiverReport(sessionID, data, headerLength);
+                break;
+
+            case 205:  // TSFB (transport layer specific feedback)
+                if ((data[0] & 0x1f) == 1) {
+                    parseNACK(sessionID, data, headerLength);
+                }
+                break;
+
+            case 206:  // PSFB (payload specific feedback)
+                if ((data[0] & 0x1f) == 1 || (data[0] & 0x1f) == 4) {
+                    // Picture loss indication or full intra request.
+                    requestIDR();
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        data += headerLength;
+        size -= headerLength;
+    }
+}
+
+void ARTSPServer::parseReceiverReport(
+        int32_t sessionID, const uint8_t *data, size_t size) {
+    size_t offset = (data[1] == 200) ? 28 : 8;
+    size_t numBlocks = data[0] & 0x1f;
+
+    for (size_t i = 0; i < numBlocks; ++i, offset += 24) {
+        if (offset + 24 > size) {
+            return;
+        }
+
+        if (U32_AT(&data[offset]) != mSourceID) {
+            continue;
+        }
+
+        int32_t fractionLost = data[offset + 4];
+        uint32_t jitter = U32_AT(&data[offset + 12]);
+
+        mClients.editValueFor(sessionID).mFractionLost = fractionLost;
+
+        int32_t worstFractionLost = 0;
+        for (size_t j = 0; j < mClients.size(); ++j) {
+            const Client &client = mClients.valueAt(j);
+            if (client.mState == PLAYING
+                    && client.mFractionLost > worstFractionLost) {
+                worstFractionLost = client.mFractionLost;
+            }
+        }
+
+        sp<AMessage> notify = mNotify->dup();
+        notify->setInt32("what", kWhatClientFeedback);
+        notify->setInt32("clientID", sessionID);
+        notify->setInt32("fractionLost", fractionLost);
+        notify->setInt32("jitter", jitter);
+        notify->setInt32("worstFractionLost", worstFractionLost);
+        notify->post();
+    }
+}
+
+void ARTSPServer::parseNACK(
+        int32_t sessionID, const uint8_t *data, size_t size) {
+    if (size < 12 || U32_AT(&data[8]) != mSourceID) {
+        return;
+    }
+
+    for (size_t i = 12; i + 4 <= size; i += 4) {
+        uint16_t seqNo = U16_AT(&data[i]);
+        uint16_t blp = U16_AT(&data[i + 2]);
+
+        retransmit(sessionID, seqNo);
+
+        for (size_t j = 0; j < 16; ++j) {
+            if (blp & (1 << j)) {
+                retransmit(sessionID, (seqNo + j + 1) & 0xffff);
+            }
+        }
+    }
+}
+
+void ARTSPServer::retransmit(int32_t sessionID, uint16_t seqNo) {
+    const Client &client = mClients.valueFor(sessionID);
+
+    if (client.mState != PLAYING || client.mMulticast) {
+        return;
+    }
+
+    const Packet &packet = mHistory[seqNo & (kMaxHistorySize - 1)];
+
+    if (packet.mHeader == NULL || packet.mSeqNo != seqNo) {
+        ALOGV("seqNo %d is no longer available for retransmission", seqNo);
+        return;
+    }
+
+    ALOGV("retransmitting seqNo %d to client %d", seqNo, sessionID);
+
+    sendPacketTo(packet, client.mRTPSessionID);
+}
+
+void ARTSPServer::sendSR() {
+    if (numPlayingClients() == 0) {
+        return;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(28);
+    uint8_t *data = buffer->data();
+
+    data[0] = 0x80 | 0;
+    data[1] = 200;  // SR
+    data[2] = 0;
+    data[3] = 6;
+    data[4] = mSourceID >> 24;
+    data[5] = (mSourceID >> 16) & 0xff;
+    data[6] = (mSourceID >> 8) & 0xff;
+    data[7] = mSourceID & 0xff;
+
+    data[8] = mLastNTPTime >> (64 - 8);
+    data[9] = (mLastNTPTime >> (64 - 16)) & 0xff;
+    data[10] = (mLastNTPTime >> (64 - 24)) & 0xff;
+    data[11] = (mLastNTPTime >> 32) & 0xff;
+    data[12] = (mLastNTPTime >> 24) & 0xff;
+    data[13] = (mLastNTPTime >> 16) & 0xff;
+    data[14] = (mLastNTPTime >> 8) & 0xff;
+    data[15] = mLastNTPTime & 0xff;
+
+    data[16] = (mLastRTPTime >> 24) & 0xff;
+    data[17] = (mLastRTPTime >> 16) & 0xff;
+    data[18] = (mLastRTPTime >> 8) & 0xff;
+    data[19] = mLastRTPTime & 0xff;
+
+    data[20] = mNumRTPSent >> 24;
+    data[21] = (mNumRTPSent >> 16) & 0xff;
+    data[22] = (mNumRTPSent >> 8) & 0xff;
+    data[23] = mNumRTPSent & 0xff;
+
+    data[24] = mNumRTPOctetsSent >> 24;
+    data[25] = (mNumRTPOctetsSent >> 16) & 0xff;
+    data[26] = (mNumRTPOctetsSent >> 8) & 0xff;
+    data[27] = mNumRTPOctetsSent & 0xff;
+
+    for (size_t i = 0; i < mClients.size(); ++i) {
+        const Client &client = mClients.valueAt(i);
+
+        if (client.mState == PLAYING && client.mRTCPSessionID != 0) {
+            mNetSession->sendRequest(client.mRTCPSessionID, buffer);
+        }
+    }
+
+    if (mNumMulticastClients > 0) {
+        mNetSession->sendRequest(mMulticastRTCPSessionID, buffer);
+    }
+
+    mSRPending = true;
+    (new AMessage(kWhatSendSR, this))->post(kSRIntervalUs);
+}
+
+void ARTSPServer::scheduleReaper() {
+    if (mReaperPending) {
+        return;
+    }
+
+    mReaperPending = true;
+    (new AMessage(kWhatReapDeadClients, this))->post(kReaperIntervalUs);
+}
+
+void ARTSPServer::reapDeadClients() {
+    int64_t nowUs = ALooper::GetNowUs();
+
+    size_t i = 0;
+    while (i < mClients.size()) {
+        if (mClients.valueAt(i).mLastSeenUs + kClientTimeoutUs < nowUs) {
+            ALOGI("client %d timed out", mClients.keyAt(i));
+            removeClient(mClients.keyAt(i));
+        } else {
+            ++i;
+        }
+    }
+
+    if (!mClients.isEmpty()) {
+        scheduleReaper();
+    }
+}
+
+void ARTSPServer::requestIDR() {
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (mLastIDRRequestUs >= 0ll
+            && nowUs < mLastIDRRequestUs + kMinIDRRequestIntervalUs) {
+        return;
+    }
+
+    mLastIDRRequestUs = nowUs;
+
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatRequestIDR);
+    notify->post();
+}
+
+void ARTSPServer::notifyClientsChanged() {
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatClientsChanged);
+    notify->setSize("numClients", numPlayingClients());
+    notify->post();
+}
+
+void ARTSPServer::notifyError(status_t err) {
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatError);
+    notify->setInt32("err", err);
+    notify->post();
+}
+
+size_t ARTSPServer::numPlayingClients() const {
+    size_t n = 0;
+    for (size_t i = 0; i < mClients.size(); ++i) {
+        if (mClients.valueAt(i).mState == PLAYING) {
+            ++n;
+        }
+    }
+
+    return n;
+}
+
+// static
+void ARTSPServer::AppendCommonResponse(
+        AString *response, int32_t cseq, int32_t playbackSessionID) {
+    time_t now = time(NULL);
+    struct tm *now2 = gmtime(&now);
+    char buf[128];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S %z", now2);
+
+    response->append("Date: ");
+    response->append(buf);
+    response->append("\r\n");
+
+    response->append(
+            AStringPrintf("Server: %s\r\n", MakeUserAgent().c_str()));
+
+    if (cseq >= 0) {
+        response->append(AStringPrintf("CSeq: %d\r\n", cseq));
+    }
+
+    if (playbackSessionID >= 0) {
+        response->append(
+                AStringPrintf(
+                    "Session: %d;timeout=%lld\r\n",
+                    playbackSessionID, (long long)kClientTimeoutSecs));
+    }
+}
+
+void ARTSPServer::sendErrorResponse(
+        int32_t sessionID,
+        const char *errorDetail,
+        int32_t cseq) {
+    AString response;
+    response.append("RTSP/1.0 ");
+    response.append(errorDetail);
+    response.append("\r\n");
+
+    AppendCommonResponse(&response, cseq);
+
+    response.append("\r\n");
+
+    mNetSession->sendRequest(sessionID, response.c_str());
+}
+
+}  // namespace android
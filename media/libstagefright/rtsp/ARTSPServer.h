@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_RTSP_SERVER_H_
+
+#define A_RTSP_SERVER_H_
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
+
+#include <netinet/in.h>
+
+namespace android {
+
+struct ABuffer;
+struct ANetworkSession;
+struct ParsedMessage;
+
+// Serves one live H.264 stream to any number of RTSP clients. Each access
+// unit is packetized once, the resulting RTP packets are shared by all
+// playing clients and sent without copying through ANetworkSession.
+//
+// Every unicast client has its own RTCP channel: receiver reports are
+// forwarded as congestion feedback, NACKs are served from a short history
+// and picture loss indications ask the owner for an IDR frame. A joining
+// client only starts receiving at the next IDR frame, which is requested
+// as it starts to play.
+//
+// If a multicast group is configured, clients asking for multicast
+// transport all share a single stream to that group; their reports are not
+// received.
+struct ARTSPServer : public AHandler {
+    enum {
+        kWhatError,
+        // Queue an IDR frame as soon as possible.
+        kWhatRequestIDR,
+        // "clientID", "fractionLost" (out of 256), "jitter" (in RTP time
+        // units) from a receiver report, "worstFractionLost" over all
+        // playing clients.
+        kWhatClientFeedback,
+        // "numClients" playing clients, unicast and multicast.
+        kWhatClientsChanged,
+    };
+
+    ARTSPServer(
+            const sp<ANetworkSession> &netSession, const sp<AMessage> &notify);
+
+    // Listens for RTSP connections on "iface" ("ip[:port]"). "multicastGroup"
+    // may be NULL, otherwise multicast RTP/RTCP go to multicastPort and
+    // multicastPort + 1 of that group.
+    status_t start(
+            const char *iface,
+            const char *multicastGroup = NULL, unsigned multicastPort = 0);
+
+    status_t stop();
+
+    // "accessUnit" is an annex-B H.264 access unit with "timeUs" in its meta
+    // data. Access units without any slices, i.e. codec specific data, only
+    // update the parameter sets. The buffer must not be modified afterwards.
+    void queueAccessUnit(const sp<ABuffer> &accessUnit);
+
+protected:
+    virtual ~ARTSPServer();
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatStart,
+        kWhatStop,
+        kWhatAccessUnit,
+        kWhatRTSPNotify,
+        kWhatRTPNotify,
+        kWhatRTCPNotify,
+        kWhatSendSR,
+        kWhatReapDeadClients,
+    };
+
+    enum {
+        kDefaultPort            = 554,
+        kMaxPacketSize          = 1472,
+        kMaxHistorySize         = 512,  // must be a power of 2
+        kPayloadType            = 96,
+    };
+
+    static const int64_t kSRIntervalUs = 1000000ll;
+    static const int64_t kReaperIntervalUs = 5000000ll;
+    static const int64_t kClientTimeoutSecs = 60;
+    static const int64_t kClientTimeoutUs = kClientTimeoutSecs * 1000000ll;
+    static const int64_t kMinIDRRequestIntervalUs = 500000ll;
+
+    enum State {
+        INIT,
+        READY,
+        PLAYING,
+    };
+
+    struct Client {
+        State mState;
+        AString mRemoteIP;
+        AString mLocalIP;
+        int32_t mPlaybackSessionID;
+        bool mMulticast;
+        int32_t mRTPSessionID;
+        int32_t mRTCPSessionID;
+        int32_t mLocalRTPPort;
+        bool mWaitForIDR;
+        int64_t mLastSeenUs;
+        int32_t mFractionLost;
+    };
+
+    // An RTP packet is its header, including the FU indicator and header
+    // for fragments, followed by mSize bytes at mOffset in mPayload.
+    struct Packet {
+        uint16_t mSeqNo;
+        sp<ABuffer> mHeader;
+        sp<ABuffer> mPayload;
+        size_t mOffset;
+        size_t mSize;
+    };
+
+    sp<ANetworkSession> mNetSession;
+    sp<AMessage> mNotify;
+
+    bool mStarted;
+    int32_t mSessionID;
+
+    KeyedVector<int32_t, Client> mClients;
+
+    bool mMulticastEnabled;
+    AString mMulticastGroup;
+    unsigned mMulticastPort;
+    int32_t mMulticastRTPSessionID;
+    int32_t mMulticastRTCPSessionID;
+    size_t mNumMulticastClients;
+    bool mMulticastWaitForIDR;
+
+    uint32_t mSourceID;
+    uint32_t mSeqNo;
+    uint32_t mRTPTimeBase;
+    uint32_t mNumRTPSent;
+    uint32_t mNumRTPOctetsSent;
+    uint32_t mLastRTPTime;
+    uint64_t mLastNTPTime;
+
+    sp<ABuffer> mSPS;
+    sp<ABuffer> mPPS;
+
+    Packet mHistory[kMaxHistorySize];
+
+    int64_t mLastIDRRequestUs;
+    bool mSRPending;
+    bool mReaperPending;
+
+    static uint64_t GetNowNTP();
+
+    status_t onStart(const sp<AMessage> &msg);
+    void onStop();
+
+    static void PacketizeNALUnit(
+            List<Packet> *packets,
+            const sp<ABuffer> &buffer, size_t offset, size_t size);
+
+    void onAccessUnit(const sp<ABuffer> &accessUnit);
+    void sendPacket(const Packet &packet);
+    void sendPacketTo(const Packet &packet, int32_t rtpSessionID);
+
+    void onRTSPNotify(const sp<AMessage> &msg);
+    void onUDPNotify(bool isRTP, const sp<AMessage> &msg);
+
+    status_t onReceiveClientData(const sp<AMessage> &msg);
+    status_t onOptionsRequest(
+            int32_t sessionID, int32_t cseq, const sp<ParsedMessage> &data);
+    status_t onDescribeRequest(
+            int32_t sessionID, int32_t cseq, const sp<ParsedMessage> &data);
+    status_t onSetupRequest(
+            int32_t sessionID, int32_t cseq, const sp<ParsedMessage> &data);
+    status_t onPlayRequest(
+            int32_t sessionID, int32_t cseq, const sp<ParsedMessage> &data);
+    status_t onTeardownRequest(
+            int32_t sessionID, int32_t cseq, const sp<ParsedMessage> &data);
+    status_t onGetParameterRequest(
+            int32_t sessionID, int32_t cseq, const sp<ParsedMessage> &data);
+
+    Client *findClient(
+            int32_t sessionID, const sp<ParsedMessage> &data, bool *badSession);
+
+    status_t setupMulticast();
+    void startPlaying(Client *client);
+    void stopPlaying(Client *client);
+    void removeClient(int32_t sessionID);
+
+    void onRTCPData(int32_t sessionID, const sp<ABuffer> &data);
+    void parseReceiverReport(
+            int32_t sessionID, const uint8_t *data, size_t size);
+    void parseNACK(int32_t sessionID, const uint8_t *data, size_t size);
+    void retransmit(int32_t sessionID, uint16_t seqNo);
+
+    void sendSR();
+    void scheduleReaper();
+    void reapDeadClients();
+
+    void requestIDR();
+    void notifyClientsChanged();
+    void notifyError(status_t err);
+
+    size_t numPlayingClients() const;
+
+    static void AppendCommonResponse(
+            AString *response, int32_t cseq, int32_t playbackSessionID = -1);
+    void sendErrorResponse(
+            int32_t sessionID, const char *errorDetail, int32_t cseq);
+
+    DISALLOW_EVIL_CONSTRUCTORS(ARTSPServer);
+};
+
+}  // namespace android
+
+#endif  // A_RTSP_SERVER_H_
@@ -25,6 +25,7 @@
 #include <media/stagefright/foundation/AString.h>
 #include <mediaplayerservice/AVMediaServiceExtensions.h>
 #include <stdlib.h>
+#include <strings.h>
 
 namespace android {
 
@@ -116,6 +117,14 @@ bool ASessionDescription::parse(const void *data, size_t size) {
                     }
 
                     value.setTo(line, colonPos + 1, line.size() - colonPos - 1);
+
+                    if (key == "a=rtcp-fb") {
+                        // A payload type usually carries several feedback
+                        // attributes, keep each one as a key of its own,
+                        // i.e. "a=rtcp-fb:96 nack".
+                        key = line;
+                        value.clear();
+                    }
                 }
 
                 key.trim();
@@ -196,6 +205,44 @@ bool ASessionDescription::findAttribute(
     return true;
 }
 
+bool ASessionDescription::findPayloadType(
+        size_t index, const char *encoding, unsigned long *PT) const {
+    AString format;
+    getFormat(index, &format);
+
+    // "<media> <port> <proto> <fmt> ...", skip to the first payload type.
+    const char *s = format.c_str();
+    for (int i = 0; i < 3 && s != NULL; ++i) {
+        s = strchr(s, ' ');
+        if (s != NULL) {
+            ++s;
+        }
+    }
+
+    size_t encodingLen = strlen(encoding);
+    while (s != NULL && *s != '\0') {
+        char *end;
+        unsigned long x = strtoul(s, &end, 10);
+        if (end == s) {
+            break;
+        }
+
+        char key[32];
+        snprintf(key, sizeof(key), "a=rtpmap:%lu", x);
+
+        AString desc;
+        if (findAttribute(index, key, &desc)
+                && !strncasecmp(desc.c_str(), encoding, encodingLen)) {
+            *PT = x;
+            return true;
+        }
+
+        s = (*end == ' ') ? end + 1 : NULL;
+    }
+
+    return false;
+}
+
 void ASessionDescription::getFormatType(
         size_t index, unsigned long *PT,
         AString *desc, AString *params) const {
@@ -210,13 +257,28 @@ void ASessionDescription::getFormatType(
     CHECK_GT(end, lastSpacePos + 1);
     CHECK_EQ(*end, '\0');
 
-    *PT = x;
-
     char key[32];
     snprintf(key, sizeof(key), "a=rtpmap:%lu", x);
 
     CHECK(findAttribute(index, key, desc));
 
+    if (!strncasecmp(desc->c_str(), "ulpfec/", 7)) {
+        // The media format is listed before the FEC stream protecting it.
+        const char *prevTokenPos = lastSpacePos;
+        while (prevTokenPos > format.c_str() && prevTokenPos[-1] != ' ') {
+            --prevTokenPos;
+        }
+        CHECK_GT(prevTokenPos, format.c_str());
+
+        x = strtoul(prevTokenPos, &end, 10);
+        CHECK_EQ(end, lastSpacePos);
+
+        snprintf(key, sizeof(key), "a=rtpmap:%lu", x);
+        CHECK(findAttribute(index, key, desc));
+    }
+
+    *PT = x;
+
     snprintf(key, sizeof(key), "a=fmtp:%lu", x);
     if (!findAttribute(index, key, params)) {
         params->clear();
@@ -55,6 +55,11 @@ struct ASessionDescription : public RefBase {
 
     bool findAttribute(size_t index, const char *key, AString *value) const;
 
+    // Finds the payload type of track "index" whose rtpmap encoding name
+    // starts with "encoding", i.e. "ulpfec/".
+    bool findPayloadType(
+            size_t index, const char *encoding, unsigned long *PT) const;
+
     // parses strings of the form
     //   npt      := npt-time "-" npt-time? | "-" npt-time
     //   npt-time := "now" | [0-9]+("." [0-9]*)?
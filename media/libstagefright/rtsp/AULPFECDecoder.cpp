@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AULPFECDecoder"
+#include <utils/Log.h>
+
+#include "AULPFECDecoder.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+static const size_t kRTPHeaderSize = 12;
+static const size_t kFECHeaderSize = 10;
+
+static uint16_t u16at(const uint8_t *data) {
+    return data[0] << 8 | data[1];
+}
+
+AULPFECDecoder::AULPFECDecoder() {
+    for (size_t i = 0; i < kNumSlots; ++i) {
+        mSlots[i].mSeqNo = 0;
+    }
+}
+
+AULPFECDecoder::~AULPFECDecoder() {
+}
+
+sp<ABuffer> AULPFECDecoder::findPacket(uint16_t seqNo) const {
+    const Slot &slot = mSlots[seqNo % kNumSlots];
+    if (slot.mPacket == NULL || slot.mSeqNo != seqNo) {
+        return NULL;
+    }
+    return slot.mPacket;
+}
+
+void AULPFECDecoder::storePacket(uint16_t seqNo, const sp<ABuffer> &packet) {
+    Slot *slot = &mSlots[seqNo % kNumSlots];
+    slot->mSeqNo = seqNo;
+    slot->mPacket = packet;
+}
+
+void AULPFECDecoder::addMediaPacket(const uint8_t *packet, size_t size) {
+    if (size < kRTPHeaderSize) {
+        return;
+    }
+
+    // The payload is handed on to the assembler, which may consume or
+    // modify it, keep a copy of our own.
+    sp<ABuffer> copy = new ABuffer(size);
+    memcpy(copy->data(), packet, size);
+
+    storePacket(u16at(&packet[2]), copy);
+}
+
+void AULPFECDecoder::addFECPacket(
+        const uint8_t *data, size_t size, List<sp<ABuffer> > *recovered) {
+    if (size < kFECHeaderSize) {
+        return;
+    }
+
+    // The L bit selects the 48 bit instead of the 16 bit mask.
+    bool longMask = (data[0] & 0x40) != 0;
+    size_t levelHeaderSize = longMask ? 8 : 4;
+    size_t numMaskBits = longMask ? 48 : 16;
+
+    if (size < kFECHeaderSize + levelHeaderSize) {
+        return;
+    }
+
+    uint16_t seqNoBase = u16at(&data[2]);
+    const uint8_t *levelHeader = &data[kFECHeaderSize];
+    size_t protectionLength = u16at(levelHeader);
+
+    const uint8_t *fecPayload = levelHeader + levelHeaderSize;
+    if (size - kFECHeaderSize - levelHeaderSize < protectionLength) {
+        return;
+    }
+
+    size_t numMissing = 0;
+    uint16_t missingSeqNo = 0;
+    sp<ABuffer> present;
+    for (size_t i = 0; i < numMaskBits; ++i) {
+        if (!(levelHeader[2 + i / 8] & (0x80 >> (i % 8)))) {
+            continue;
+        }
+
+        uint16_t seqNo = seqNoBase + i;
+        sp<ABuffer> packet = findPacket(seqNo);
+        if (packet == NULL) {
+            if (++numMissing > 1) {
+                return;
+            }
+            missingSeqNo = seqNo;
+        } else {
+            present = packet;
+        }
+    }
+
+    if (numMissing != 1 || present == NULL) {
+        // Either there's nothing to recover or too much was lost.
+        return;
+    }
+
+    // The header fields protected by the "FEC bit string": the first two
+    // bytes of the RTP header, its timestamp and the length of everything
+    // following the fixed header.
+    uint8_t bits[8];
+    bits[0] = data[0];
+    bits[1] = data[1];
+    memcpy(&bits[2], &data[4], 4);
+    memcpy(&bits[6], &data[8], 2);
+
+    sp<ABuffer> payload = new ABuffer(protectionLength);
+    memcpy(payload->data(), fecPayload, protectionLength);
+
+    for (size_t i = 0; i < numMaskBits; ++i) {
+        if (!(levelHeader[2 + i / 8] & (0x80 >> (i % 8)))) {
+            continue;
+        }
+
+        uint16_t seqNo = seqNoBase + i;
+        if (seqNo == missingSeqNo) {
+            continue;
+        }
+
+        sp<ABuffer> packet = findPacket(seqNo);
+        const uint8_t *p = packet->data();
+        size_t length = packet->size() - kRTPHeaderSize;
+
+        bits[0] ^= p[0];
+        bits[1] ^= p[1];
+        for (size_t j = 0; j < 4; ++j) {
+            bits[2 + j] ^= p[4 + j];
+        }
+        bits[6] ^= length >> 8;
+        bits[7] ^= length & 0xff;
+
+        size_t n = length < protectionLength ? length : protectionLength;
+        uint8_t *dst = payload->data();
+        for (size_t j = 0; j < n; ++j) {
+            dst[j] ^= p[kRTPHeaderSize + j];
+        }
+    }
+
+    size_t recoveredLength = u16at(&bits[6]);
+    if (recoveredLength > protectionLength) {
+        // Only the first protectionLength bytes are covered at level 0.
+        ALOGV("can't recover packet %u, %zu bytes > %zu protected",
+              missingSeqNo, recoveredLength, protectionLength);
+        return;
+    }
+
+    sp<ABuffer> packet = new ABuffer(kRTPHeaderSize + recoveredLength);
+    uint8_t *out = packet->data();
+    out[0] = 0x80 | (bits[0] & 0x3f);  // V=2, P, X, CC
+    out[1] = bits[1];                   // M, PT
+    out[2] = missingSeqNo >> 8;
+    out[3] = missingSeqNo & 0xff;
+    memcpy(&out[4], &bits[2], 4);
+    memcpy(&out[8], present->data() + 8, 4);  // SSRC
+    memcpy(&out[kRTPHeaderSize], payload->data(), recoveredLength);
+
+    ALOGV("recovered packet %u (%zu bytes)", missingSeqNo, packet->size());
+
+    storePacket(missingSeqNo, packet);
+    recovered->push_back(packet);
+}
+
+}  // namespace android
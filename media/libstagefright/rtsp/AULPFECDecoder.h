@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_ULPFEC_DECODER_H_
+
+#define A_ULPFEC_DECODER_H_
+
+#include <stdint.h>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+struct ABuffer;
+
+// Recovers single lost RTP packets from RFC 5109 ULPFEC level 0 protection.
+// Keeps a copy of the most recent media packets, a FEC packet can recover
+// one packet of its protected set if all others were received.
+struct AULPFECDecoder : public RefBase {
+    AULPFECDecoder();
+
+    // "packet" is a complete RTP packet including its header.
+    void addMediaPacket(const uint8_t *packet, size_t size);
+
+    // "data" is the payload of an RTP packet carrying ULPFEC. Recovered
+    // RTP packets, if any, are appended to "recovered".
+    void addFECPacket(
+            const uint8_t *data, size_t size, List<sp<ABuffer> > *recovered);
+
+protected:
+    virtual ~AULPFECDecoder();
+
+private:
+    enum {
+        // Larger than the 48 packets a single FEC packet may protect.
+        kNumSlots = 64,
+    };
+
+    struct Slot {
+        uint16_t mSeqNo;
+        sp<ABuffer> mPacket;
+    };
+
+    Slot mSlots[kNumSlots];
+
+    sp<ABuffer> findPacket(uint16_t seqNo) const;
+    void storePacket(uint16_t seqNo, const sp<ABuffer> &packet);
+
+    DISALLOW_EVIL_CONSTRUCTORS(AULPFECDecoder);
+};
+
+}  // namespace android
+
+#endif  // A_ULPFEC_DECODER_H_
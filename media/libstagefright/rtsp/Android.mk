@@ -13,10 +13,13 @@ LOCAL_SRC_FILES:=       \
         ARawAudioAssembler.cpp      \
         ARTPAssembler.cpp           \
         ARTPConnection.cpp          \
+        ARTPPoller.cpp              \
         ARTPSource.cpp              \
         ARTPWriter.cpp              \
         ARTSPConnection.cpp         \
+        ARTSPServer.cpp             \
         ASessionDescription.cpp     \
+        AULPFECDecoder.cpp          \
         SDPLoader.cpp               \
 
 LOCAL_SHARED_LIBRARIES += libcrypto
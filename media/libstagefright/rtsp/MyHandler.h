@@ -115,13 +115,21 @@ struct MyHandler : public AHandler {
         kWhatByeReceived                = 'byeR',
     };
 
+    enum Flags {
+        // Live viewing: deliver access units as soon as they are assembled
+        // instead of waiting for a sender report on every track.
+        kFlagLowLatency = 1,
+    };
+
     MyHandler(
             const char *url,
             const sp<AMessage> &notify,
-            bool uidValid = false, uid_t uid = 0)
+            bool uidValid = false, uid_t uid = 0,
+            uint32_t flags = 0)
         : mNotify(notify),
           mUIDValid(uidValid),
           mUID(uid),
+          mFlags(flags),
           mNetLooper(new ALooper),
           mOriginalSessionURL(url),
           mSessionURL(url),
@@ -148,7 +156,8 @@ struct MyHandler : public AHandler {
           mPlayResponseParsed(false) {
         mConn = AVMediaServiceFactory::get()->createARTSPConnection(
                 mUIDValid, uid);
-        mRTPConn = AVMediaServiceFactory::get()->createARTPConnection();
+        mRTPConn = AVMediaServiceFactory::get()->createARTPConnection(
+                (mFlags & kFlagLowLatency) ? ARTPConnection::kLowLatency : 0);
         mNetLooper->setName("rtsp net");
         mNetLooper->start(false /* runOnCallingThread */,
                           false /* canCallJava */,
@@ -1025,6 +1034,13 @@ struct MyHandler : public AHandler {
                     CHECK(msg->findInt32("rtp-time", (int32_t *)&rtpTime));
                     CHECK(msg->findInt64("ntp-time", (int64_t *)&ntpTime));
 
+                    if ((mFlags & kFlagLowLatency)
+                            && mTracks.editItemAt(trackIndex).mNTPAnchorUs >= 0) {
+                        // Remapping now would make the timestamps jump.
+                        ALOGV("ignoring sender report, track already mapped");
+                        break;
+                    }
+
                     onTimeUpdate(trackIndex, rtpTime, ntpTime);
                     break;
                 }
@@ -1598,6 +1614,7 @@ private:
     sp<AMessage> mNotify;
     bool mUIDValid;
     uid_t mUID;
+    uint32_t mFlags;
     sp<ALooper> mNetLooper;
     sp<ARTSPConnection> mConn;
     sp<ARTPConnection> mRTPConn;
@@ -1759,6 +1776,11 @@ private:
         return true;
     }
 
+    static uint64_t NTPTimeFromUs(int64_t timeUs) {
+        return ((uint64_t)(timeUs / 1000000ll) << 32)
+            | (((uint64_t)(timeUs % 1000000ll) << 32) / 1000000ll);
+    }
+
     void fakeTimestamps() {
         mNTPAnchorUs = -1ll;
         for (size_t i = 0; i < mTracks.size(); ++i) {
@@ -1870,6 +1892,17 @@ private:
         if (!mAllTracksHaveTime) {
             ALOGV("storing accessUnit, no time established yet");
             track->mPackets.push_back(accessUnit);
+
+            if ((mFlags & kFlagLowLatency) && track->mNTPAnchorUs < 0) {
+                // Map the track to the arrival time of its first access unit,
+                // a sender report can take seconds to come in.
+                uint32_t rtpTime;
+                CHECK(accessUnit->meta()->findInt32(
+                            "rtp-time", (int32_t *)&rtpTime));
+
+                onTimeUpdate(
+                        trackIndex, rtpTime, NTPTimeFromUs(ALooper::GetNowUs()));
+            }
             return;
         }
 
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ABitReader_test"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+
+#include <media/stagefright/foundation/ABitReader.h>
+
+namespace android {
+
+class ABitReaderTest : public ::testing::Test {
+};
+
+// reference reader, one bit at a time
+static uint32_t referenceBits(const uint8_t *data, size_t *pos, size_t n) {
+    uint32_t x = 0;
+    for (size_t i = 0; i < n; ++i, ++*pos) {
+        x = (x << 1) | ((data[*pos / 8] >> (7 - *pos % 8)) & 1);
+    }
+    return x;
+}
+
+TEST_F(ABitReaderTest, GetAndSkipBitsMatchReference) {
+    uint8_t data[257];
+    srand(42);
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = rand();
+    }
+
+    ABitReader br(data, sizeof(data));
+    size_t pos = 0;
+    while (pos + 100 < sizeof(data) * 8) {
+        size_t n = rand() % 33;
+        if (rand() % 4 == 0) {
+            n = rand() % 90;
+            br.skipBits(n);
+            pos += n;
+            continue;
+        }
+        ASSERT_EQ(referenceBits(data, &pos, n), br.getBits(n)) << "at bit " << pos;
+        ASSERT_EQ(sizeof(data) * 8 - pos, br.numBitsLeft());
+    }
+}
+
+TEST_F(ABitReaderTest, PutBitsUndoesGetBits) {
+    static const uint8_t data[] = { 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x0f };
+    ABitReader br(data, sizeof(data));
+    br.skipBits(60);
+    uint32_t x = br.getBits(11);
+    br.putBits(x, 11);
+    ASSERT_EQ(x, br.getBits(11));
+    ASSERT_EQ(1u, br.numBitsLeft());
+}
+
+TEST_F(ABitReaderTest, ExpGolomb) {
+    // ue(v) 0, 1, 2, 3, 7, then se(v) -1, +2, then ue(v) 65534 with a long prefix
+    // 1 010 011 00100 0001000 011 00100 000000000000000 1111111111111111
+    static const uint8_t data[] = {
+        0xa6, 0x41, 0x0c, 0x80, 0x00, 0x3f, 0xff, 0xc0,
+    };
+    ABitReader br(data, sizeof(data));
+    ASSERT_EQ(0u, br.getUE());
+    ASSERT_EQ(1u, br.getUE());
+    ASSERT_EQ(2u, br.getUE());
+    ASSERT_EQ(3u, br.getUE());
+    ASSERT_EQ(7u, br.getUE());
+    ASSERT_EQ(-1, br.getSE());
+    ASSERT_EQ(2, br.getSE());
+    ASSERT_EQ(65534u, br.getUE());
+}
+
+TEST_F(ABitReaderTest, NALSkipsEmulationPrevention) {
+    static const uint8_t data[] = {
+        0x11, 0x22, 0x00, 0x00, 0x03, 0x01, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99,
+    };
+    NALBitReader br(data, sizeof(data));
+    ASSERT_EQ(0x11220000u, br.getBits(32));
+    ASSERT_EQ(0x01u, br.getBits(8));
+    br.skipBits(16);
+    ASSERT_EQ(0x5566u, br.getBits(16));
+
+    NALBitReader skip(data, sizeof(data));
+    skip.skipBits(8 * 5);
+    ASSERT_EQ(0x3344u, skip.getBits(16));
+}
+
+}  // namespace android
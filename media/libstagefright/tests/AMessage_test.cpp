@@ -0,0 +1,222 @@
+/*
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AMessage_test"
+
+#include <gtest/gtest.h>
+#include <binder/Parcel.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+
+namespace android {
+
+class AMessageTest : public ::testing::Test {
+};
+
+TEST_F(AMessageTest, SetFindReplace) {
+    sp<AMessage> msg = new AMessage;
+    msg->setInt32("index", 3);
+    msg->setInt64("timeUs", 1234567890123ll);
+    msg->setString("mime", "video/avc");
+    msg->setRect("crop", 1, 2, 3, 4);
+
+    // names are compared by value, not by address
+    char name[] = "index";
+    int32_t index;
+    ASSERT_TRUE(msg->findInt32(name, &index));
+    ASSERT_EQ(3, index);
+    ASSERT_FALSE(msg->findInt32("timeUs", &index));
+    ASSERT_FALSE(msg->contains("indexx"));
+    ASSERT_FALSE(msg->contains("inde"));
+
+    msg->setInt32("index", 4);
+    ASSERT_EQ(4u, msg->countEntries());
+    ASSERT_TRUE(msg->findInt32("index", &index));
+    ASSERT_EQ(4, index);
+
+    // replacing a value with one of another type
+    msg->setString("index", "a string longer than the inline storage");
+    ASSERT_FALSE(msg->findInt32("index", &index));
+    AString s;
+    ASSERT_TRUE(msg->findString("index", &s));
+    ASSERT_STREQ("a string longer than the inline storage", s.c_str());
+
+    int32_t left, top, right, bottom;
+    ASSERT_TRUE(msg->findRect("crop", &left, &top, &right, &bottom));
+    ASSERT_EQ(1, left);
+    ASSERT_EQ(4, bottom);
+}
+
+TEST_F(AMessageTest, Strings) {
+    static const char *kStrings[] = {
+        "", "a", "audio/mp4a-latm", "audio/mp4a-latm2", "video/x-vnd.on2.vp8",
+    };
+    sp<AMessage> msg = new AMessage;
+    for (size_t i = 0; i < sizeof(kStrings) / sizeof(kStrings[0]); ++i) {
+        msg->setString("mime", kStrings[i]);
+        AString s;
+        ASSERT_TRUE(msg->findString("mime", &s));
+        ASSERT_STREQ(kStrings[i], s.c_str());
+        ASSERT_EQ(strlen(kStrings[i]), s.size());
+    }
+
+    // embedded 0 bytes are kept
+    msg->setString("bytes", "ab\0cd", 5);
+    AString s;
+    ASSERT_TRUE(msg->findString("bytes", &s));
+    ASSERT_EQ(5u, s.size());
+    ASSERT_EQ(0, memcmp("ab\0cd", s.c_str(), 5));
+}
+
+TEST_F(AMessageTest, DupAndParcel) {
+    sp<AMessage> sub = new AMessage;
+    sub->setString("language", "und");
+    sp<AMessage> msg = new AMessage('test', NULL);
+    msg->setInt32("width", 1920);
+    msg->setFloat("frame-rate", 29.97f);
+    msg->setString("mime", "video/avc");
+    msg->setString("path", "/sdcard/Movies/a_rather_long_file_name.mp4");
+    msg->setMessage("format", sub);
+
+    Parcel parcel;
+    msg->writeToParcel(&parcel);
+    parcel.setDataPosition(0);
+    sp<AMessage> fromParcel = AMessage::FromParcel(parcel);
+
+    // a dup of a message read from a parcel has names owned by the message
+    sp<AMessage> copies[] = { msg->dup(), fromParcel, fromParcel->dup() };
+    for (size_t i = 0; i < sizeof(copies) / sizeof(copies[0]); ++i) {
+        const sp<AMessage> &copy = copies[i];
+        ASSERT_EQ(msg->what(), copy->what());
+        ASSERT_EQ(msg->countEntries(), copy->countEntries());
+        int32_t width;
+        ASSERT_TRUE(copy->findInt32("width", &width));
+        ASSERT_EQ(1920, width);
+        AString s;
+        ASSERT_TRUE(copy->findString("mime", &s));
+        ASSERT_STREQ("video/avc", s.c_str());
+        ASSERT_TRUE(copy->findString("path", &s));
+        ASSERT_STREQ("/sdcard/Movies/a_rather_long_file_name.mp4", s.c_str());
+        sp<AMessage> format;
+        ASSERT_TRUE(copy->findMessage("format", &format));
+        ASSERT_NE(sub.get(), format.get());
+        ASSERT_TRUE(format->findString("language", &s));
+        ASSERT_STREQ("und", s.c_str());
+    }
+    fromParcel.clear();
+    copies[2]->clear();
+    ASSERT_EQ(0u, copies[2]->countEntries());
+}
+
+// Receives the messages of the benchmark below, and reads back the fields the way a
+// codec or player handler does.
+struct BenchmarkHandler : public AHandler {
+    enum {
+        kWhatBuffer = 'buff',
+    };
+
+    BenchmarkHandler()
+        : mReceived(0),
+          mExpected(0) {
+    }
+
+    void expect(size_t count) {
+        Mutex::Autolock autoLock(mLock);
+        mReceived = 0;
+        mExpected = count;
+    }
+
+    void waitForAll() {
+        Mutex::Autolock autoLock(mLock);
+        while (mReceived < mExpected) {
+            mCondition.wait(mLock);
+        }
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        int32_t index;
+        int64_t timeUs;
+        size_t size;
+        AString mime;
+        sp<ABuffer> buffer;
+        CHECK(msg->findInt32("index", &index));
+        CHECK(msg->findInt64("timeUs", &timeUs));
+        CHECK(msg->findSize("size", &size));
+        CHECK(msg->findString("mime", &mime));
+        CHECK(msg->findBuffer("buffer", &buffer));
+        msg->contains("eos");
+
+        Mutex::Autolock autoLock(mLock);
+        if (++mReceived == mExpected) {
+            mCondition.signal();
+        }
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    size_t mReceived;
+    size_t mExpected;
+};
+
+TEST_F(AMessageTest, PostDeliverBenchmark) {
+    static const size_t kMessages = 100000;
+    static const int kRuns = 5;
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("AMessage_test");
+    sp<BenchmarkHandler> handler = new BenchmarkHandler;
+    looper->registerHandler(handler);
+    ASSERT_EQ(OK, looper->start());
+
+    sp<ABuffer> buffer = new ABuffer(16);
+    nsecs_t best = INT64_MAX;
+    for (int run = 0; run < kRuns; ++run) {
+        handler->expect(kMessages);
+        const nsecs_t start = systemTime();
+        for (size_t i = 0; i < kMessages; ++i) {
+            sp<AMessage> msg = new AMessage(BenchmarkHandler::kWhatBuffer, handler);
+            msg->setInt32("index", i);
+            msg->setInt64("timeUs", i * 33333ll);
+            msg->setSize("size", buffer->size());
+            msg->setString("mime", "video/avc");
+            msg->setBuffer("buffer", buffer);
+            msg->dup()->post();
+        }
+        handler->waitForAll();
+        const nsecs_t elapsed = systemTime() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    looper->stop();
+    looper->unregisterHandler(handler->id());
+
+    printf("post/deliver: %.1f ns per message, %.0f messages per second\n",
+            (double)best / kMessages, kMessages * 1e9 / best);
+}
+
+}  // namespace android
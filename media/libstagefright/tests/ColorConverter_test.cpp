@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ColorConverter_test"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <media/stagefright/ColorConverter.h>
+#include <media/stagefright/MediaErrors.h>
+
+namespace android {
+
+static const size_t kWidth = 176;
+static const size_t kHeight = 144;
+
+enum Layout {
+    PLANAR,     // I420
+    UV,         // NV12
+    VU,         // NV21
+};
+
+// The conversion of one pixel, as the per pixel loops of ColorConverter do it.
+static uint16_t referenceRGB565(int y, int u, int v, bool swapRB) {
+    const int tmp = (y - 16) * 298;
+    const int b = (tmp + (u - 128) * 517) / 256;
+    const int g = (tmp - (v - 128) * 208 - (u - 128) * 100) / 256;
+    const int r = (tmp + (v - 128) * 409) / 256;
+    const int cb = b < 0 ? 0 : b > 255 ? 255 : b;
+    const int cg = g < 0 ? 0 : g > 255 ? 255 : g;
+    const int cr = r < 0 ? 0 : r > 255 ? 255 : r;
+    const int hi = swapRB ? cb : cr;
+    const int lo = swapRB ? cr : cb;
+    return ((hi >> 3) << 11) | ((cg >> 2) << 5) | (lo >> 3);
+}
+
+class ColorConverterTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        // Mostly noise, with runs of extreme values so that every channel gets clipped.
+        srand(42);
+        mFrame.resize(kWidth * kHeight * 3 / 2);
+        for (size_t i = 0; i < mFrame.size(); ++i) {
+            mFrame[i] = (i / 61) % 5 == 0 ? ((i / 7) % 2 ? 255 : 0) : rand() % 256;
+        }
+    }
+
+    // Converts the top left cropWidth x cropHeight pixels of the frame.
+    void check(OMX_COLOR_FORMATTYPE format, Layout layout, bool swapRB,
+            size_t cropWidth, size_t cropHeight) {
+        ColorConverter converter(format, OMX_COLOR_Format16bitRGB565);
+        ASSERT_TRUE(converter.isValid());
+
+        std::vector<uint16_t> out(cropWidth * cropHeight, 0xdead);
+        ASSERT_EQ(OK, converter.convert(
+                &mFrame[0], kWidth, kHeight,
+                0, 0, cropWidth - 1, cropHeight - 1,
+                &out[0], cropWidth, cropHeight,
+                0, 0, cropWidth - 1, cropHeight - 1));
+
+        const uint8_t *chroma = &mFrame[kWidth * kHeight];
+        for (size_t y = 0; y < cropHeight; ++y) {
+            for (size_t x = 0; x < cropWidth; ++x) {
+                int u, v;
+                if (layout == PLANAR) {
+                    const size_t offset = (y / 2) * (kWidth / 2) + x / 2;
+                    u = chroma[offset];
+                    v = chroma[(kWidth / 2) * (kHeight / 2) + offset];
+                } else {
+                    const uint8_t *uv = chroma + (y / 2) * kWidth + (x & ~1);
+                    u = uv[layout == UV ? 0 : 1];
+                    v = uv[layout == UV ? 1 : 0];
+                }
+                ASSERT_EQ(referenceRGB565(mFrame[y * kWidth + x], u, v, swapRB),
+                        out[y * cropWidth + x])
+                        << "pixel " << x << "," << y << " of " << cropWidth << "x" << cropHeight;
+            }
+        }
+    }
+
+    void checkCrops(OMX_COLOR_FORMATTYPE format, Layout layout, bool swapRB) {
+        check(format, layout, swapRB, kWidth, kHeight);
+        // widths that are not a multiple of 8 leave pixels for the per pixel loop
+        check(format, layout, swapRB, 13, 10);
+        check(format, layout, swapRB, kWidth - 6, kHeight - 1);
+        check(format, layout, swapRB, 1, 3);
+    }
+
+    std::vector<uint8_t> mFrame;
+};
+
+TEST_F(ColorConverterTest, YUV420Planar) {
+    checkCrops(OMX_COLOR_FormatYUV420Planar, PLANAR, false);
+}
+
+TEST_F(ColorConverterTest, YUV420SemiPlanar) {
+    checkCrops(OMX_COLOR_FormatYUV420SemiPlanar, VU, true);
+}
+
+TEST_F(ColorConverterTest, QCOMYUV420SemiPlanar) {
+    checkCrops(OMX_QCOM_COLOR_FormatYVU420SemiPlanar, UV, true);
+}
+
+TEST_F(ColorConverterTest, TIYUV420PackedSemiPlanar) {
+    checkCrops(OMX_TI_COLOR_FormatYUV420PackedSemiPlanar, UV, false);
+}
+
+}  // namespace android
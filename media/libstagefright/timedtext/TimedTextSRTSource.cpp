@@ -35,7 +35,11 @@ namespace android {
 TimedTextSRTSource::TimedTextSRTSource(const sp<DataSource>& dataSource)
         : mSource(dataSource),
           mMetaData(new MetaData),
-          mIndex(0) {
+          mOrdered(true),
+          mReadOffset(0),
+          mIndex(0),
+          mReadBufferOffset(0),
+          mReadBufferSize(0) {
     // TODO: Need to detect the language, because SRT doesn't give language
     // information explicitly.
     mMetaData->setCString(kKeyMediaLanguage, "und");
@@ -53,8 +57,12 @@ status_t TimedTextSRTSource::start() {
 }
 
 void TimedTextSRTSource::reset() {
+    mCheckpoints.clear();
+    mReadOffset = 0;
     mTextVector.clear();
     mIndex = 0;
+    mReadBufferOffset = 0;
+    mReadBufferSize = 0;
 }
 
 status_t TimedTextSRTSource::stop() {
@@ -83,6 +91,49 @@ sp<MetaData> TimedTextSRTSource::getFormat() {
 }
 
 status_t TimedTextSRTSource::scanFile() {
+    off64_t offset = 0;
+    int64_t startTimeUs;
+    int64_t prevStartTimeUs = -1;
+    int64_t prevEndTimeUs = 0;
+    size_t count = 0;
+
+    mOrdered = true;
+    while (true) {
+        const off64_t subtitleOffset = offset;
+        TextInfo info;
+        status_t err = getNextSubtitleInfo(&offset, &startTimeUs, &info);
+        if (err == ERROR_END_OF_STREAM) {
+            break;
+        } else if (err != OK) {
+            return err;
+        }
+        // Subtitles with the same start time replace each other in mTextVector,
+        // keep doing so.
+        if (startTimeUs <= prevStartTimeUs || info.endTimeUs < prevEndTimeUs) {
+            ALOGV("subtitle at %lld is out of order, indexing all subtitles",
+                    (long long)subtitleOffset);
+            mOrdered = false;
+            mCheckpoints.clear();
+            return indexAllSubtitles();
+        }
+        if (count % kCheckpointInterval == 0) {
+            Checkpoint checkpoint;
+            checkpoint.offset = subtitleOffset;
+            checkpoint.prevEndTimeUs = prevEndTimeUs;
+            mCheckpoints.push(checkpoint);
+        }
+        prevStartTimeUs = startTimeUs;
+        prevEndTimeUs = info.endTimeUs;
+        count++;
+    }
+    if (count == 0) {
+        return ERROR_MALFORMED;
+    }
+    mReadOffset = 0;
+    return OK;
+}
+
+status_t TimedTextSRTSource::indexAllSubtitles() {
     off64_t offset = 0;
     int64_t startTimeUs;
     bool endOfFile = false;
@@ -174,12 +225,27 @@ status_t TimedTextSRTSource::getNextSubtitleInfo(
     return OK;
 }
 
+ssize_t TimedTextSRTSource::readChar(off64_t offset, char *character) {
+    if (offset < mReadBufferOffset ||
+            offset >= mReadBufferOffset + (off64_t)mReadBufferSize) {
+        ssize_t readSize = mSource->readAt(offset, mReadBuffer, sizeof(mReadBuffer));
+        if (readSize <= 0) {
+            mReadBufferSize = 0;
+            return readSize;
+        }
+        mReadBufferOffset = offset;
+        mReadBufferSize = readSize;
+    }
+    *character = mReadBuffer[offset - mReadBufferOffset];
+    return 1;
+}
+
 status_t TimedTextSRTSource::readNextLine(off64_t *offset, AString *data) {
     data->clear();
     while (true) {
         ssize_t readSize;
         char character;
-        if ((readSize = mSource->readAt(*offset, &character, 1)) < 1) {
+        if ((readSize = readChar(*offset, &character)) < 1) {
             if (readSize == 0) {
                 return ERROR_END_OF_STREAM;
             }
@@ -192,7 +258,7 @@ status_t TimedTextSRTSource::readNextLine(off64_t *offset, AString *data) {
         if (character == 10) {
             break;
         } else if (character == 13) {
-            if ((readSize = mSource->readAt(*offset, &character, 1)) < 1) {
+            if ((readSize = readChar(*offset, &character)) < 1) {
                 if (readSize == 0) {  // end of the stream
                     return OK;
                 }
@@ -213,6 +279,9 @@ status_t TimedTextSRTSource::readNextLine(off64_t *offset, AString *data) {
 status_t TimedTextSRTSource::getText(
         const MediaSource::ReadOptions *options,
         AString *text, int64_t *startTimeUs, int64_t *endTimeUs) {
+    if (mOrdered) {
+        return getOrderedText(options, text, startTimeUs, endTimeUs);
+    }
     if (mTextVector.size() == 0) {
         return ERROR_END_OF_STREAM;
     }
@@ -256,6 +325,53 @@ status_t TimedTextSRTSource::getText(
     *endTimeUs = info.endTimeUs;
     mIndex++;
 
+    return readText(info, text);
+}
+
+status_t TimedTextSRTSource::getOrderedText(
+        const MediaSource::ReadOptions *options,
+        AString *text, int64_t *startTimeUs, int64_t *endTimeUs) {
+    text->clear();
+    off64_t offset = mReadOffset;
+    int64_t timeUs;
+    TextInfo info;
+    status_t err;
+    int64_t seekTimeUs;
+    MediaSource::ReadOptions::SeekMode mode;
+    if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
+        if (seekTimeUs < 0) {
+            return ERROR_OUT_OF_RANGE;
+        }
+        // find the last checkpoint whose extended range starts at or before seekTimeUs
+        size_t low = 0;
+        size_t high = mCheckpoints.size();
+        while (high - low > 1) {
+            size_t mid = low + (high - low) / 2;
+            if (mCheckpoints[mid].prevEndTimeUs <= seekTimeUs) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        // then the first subtitle after it which ends after seekTimeUs, as the end times
+        // increase this is the one whose extended range contains seekTimeUs
+        offset = mCheckpoints[low].offset;
+        do {
+            if ((err = getNextSubtitleInfo(&offset, &timeUs, &info)) != OK) {
+                return err;
+            }
+        } while (info.endTimeUs <= seekTimeUs);
+    } else if ((err = getNextSubtitleInfo(&offset, &timeUs, &info)) != OK) {
+        return err;
+    }
+    *startTimeUs = timeUs;
+    *endTimeUs = info.endTimeUs;
+    mReadOffset = offset;
+
+    return readText(info, text);
+}
+
+status_t TimedTextSRTSource::readText(const TextInfo &info, AString *text) {
     char *str = new char[info.textLen];
     if (mSource->readAt(info.offset, str, info.textLen) < info.textLen) {
         delete[] str;
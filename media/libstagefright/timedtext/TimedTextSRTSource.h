@@ -20,6 +20,7 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MediaSource.h>
 #include <utils/Compat.h>  // off64_t
+#include <utils/Vector.h>
 
 #include "TimedTextSource.h"
 
@@ -56,21 +57,54 @@ private:
         int textLen;
     };
 
+    // A subtitle of the file and the end time of the one before it, see
+    // compareExtendedRangeAndTime().
+    struct Checkpoint {
+        off64_t offset;
+        int64_t prevEndTimeUs;
+    };
+
+    // Number of subtitles between two checkpoints.
+    static const size_t kCheckpointInterval = 32;
+    static const size_t kReadBufferSize = 4096;
+
+    // When the start and end times of the subtitles increase through the file, which is
+    // the common case, subtitles are parsed in file order when they are read and only one
+    // checkpoint every kCheckpointInterval subtitles is kept for seeking.
+    // Otherwise every subtitle is indexed in mTextVector, sorted by start time.
+    bool mOrdered;
+
+    // mOrdered == true
+    Vector<Checkpoint> mCheckpoints;
+    off64_t mReadOffset;    // offset of the next subtitle to read
+
+    // mOrdered == false
     size_t mIndex;
     KeyedVector<int64_t, TextInfo> mTextVector;
 
+    // the last chunk of the file read by readNextLine()
+    char mReadBuffer[kReadBufferSize];
+    off64_t mReadBufferOffset;
+    size_t mReadBufferSize;
+
     void reset();
     status_t scanFile();
+    status_t indexAllSubtitles();
     status_t getNextSubtitleInfo(
             off64_t *offset, int64_t *startTimeUs, TextInfo *info);
+    ssize_t readChar(off64_t offset, char *character);
     status_t readNextLine(off64_t *offset, AString *data);
     status_t getText(
             const MediaSource::ReadOptions *options,
             AString *text, int64_t *startTimeUs, int64_t *endTimeUs);
+    status_t getOrderedText(
+            const MediaSource::ReadOptions *options,
+            AString *text, int64_t *startTimeUs, int64_t *endTimeUs);
+    status_t readText(const TextInfo &info, AString *text);
     status_t extractAndAppendLocalDescriptions(
             int64_t timeUs, const AString &text, Parcel *parcel);
 
-    // Compares the time range of the subtitle at index to the given timeUs.
+    // Compares the time range of the subtitle at index of mTextVector to the given timeUs.
     // The time range of the subtitle to match with given timeUs is extended to
     // [endTimeUs of the previous subtitle, endTimeUs of current subtitle).
     //
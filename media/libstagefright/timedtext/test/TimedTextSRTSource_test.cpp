@@ -220,5 +220,58 @@ TEST_F(TimedTextSRTSourceTest, checkEdgeCase) {
     CheckDataEquals(parcel, subtitle.c_str());
 }
 
+// Many more subtitles than one seek checkpoint covers.
+TEST(TimedTextSRTSourceLargeFileTest, seekAndReadAll) {
+    static const int kNumSubtitles = 1000;
+    AString srt;
+    for (int i = 0; i < kNumSubtitles; i++) {
+        srt.append(AStringPrintf("%d\r\n00:%02d:%02d,000 --> 00:%02d:%02d,500\r\n%d\r\n\r\n",
+                i + 1, i / 60, i % 60, i / 60, i % 60, i));
+    }
+    sp<TimedTextSource> source = new TimedTextSRTSource(
+            new SRTDataSourceStub(srt.c_str(), srt.size()));
+    ASSERT_EQ(OK, source->start());
+
+    int64_t startTimeUs;
+    int64_t endTimeUs;
+    Parcel parcel;
+    for (int i = kNumSubtitles - 1; i >= 0; i -= 37) {
+        MediaSource::ReadOptions options;
+        options.setSeekTo(i * kSecToUsec + 100, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+        ASSERT_EQ(OK, source->read(&startTimeUs, &endTimeUs, &parcel, &options));
+        EXPECT_EQ(i * kSecToUsec, startTimeUs);
+        EXPECT_EQ(i * kSecToUsec + 500000, endTimeUs);
+    }
+
+    MediaSource::ReadOptions options;
+    options.setSeekTo(0, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+    ASSERT_EQ(OK, source->read(&startTimeUs, &endTimeUs, &parcel, &options));
+    for (int i = 1; i < kNumSubtitles; i++) {
+        ASSERT_EQ(OK, source->read(&startTimeUs, &endTimeUs, &parcel));
+        EXPECT_EQ(i * kSecToUsec, startTimeUs);
+    }
+    EXPECT_EQ(ERROR_END_OF_STREAM, source->read(&startTimeUs, &endTimeUs, &parcel));
+}
+
+// Subtitles which are not in time order in the file are still read in time order.
+TEST(TimedTextSRTSourceOutOfOrderTest, readAll) {
+    static const char *kOutOfOrderSRTString =
+        "1\n00:00:3,000 --> 00:00:3,500\n3\n\n"
+        "2\n00:00:1,000 --> 00:00:1,500\n1\n\n"
+        "3\n00:00:2,000 --> 00:00:2,500\n2\n\n";
+    sp<TimedTextSource> source = new TimedTextSRTSource(
+            new SRTDataSourceStub(kOutOfOrderSRTString, strlen(kOutOfOrderSRTString)));
+    ASSERT_EQ(OK, source->start());
+
+    int64_t startTimeUs;
+    int64_t endTimeUs;
+    Parcel parcel;
+    for (int i = 1; i <= 3; i++) {
+        ASSERT_EQ(OK, source->read(&startTimeUs, &endTimeUs, &parcel));
+        EXPECT_EQ(i * kSecToUsec, startTimeUs);
+    }
+    EXPECT_EQ(ERROR_END_OF_STREAM, source->read(&startTimeUs, &endTimeUs, &parcel));
+}
+
 }  // namespace test
 }  // namespace android
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WEBMFRAMEQUEUE_H_
+#define WEBMFRAMEQUEUE_H_
+
+#include "WebmFrame.h"
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+namespace android {
+
+// Bounded single producer (a source thread) and single consumer (the sink thread) ring of
+// frames. Neither side takes a lock while the ring is neither empty nor full; the mutex and
+// conditions are only used to park the consumer on an empty ring or the producer on a full
+// one.
+//
+// A side about to sleep first publishes its waiting flag and then re-reads the other side's
+// index; the other side publishes its index and then reads the flag. Both use sequentially
+// consistent accesses, so at least one of them sees the other's store and no wakeup is lost.
+class WebmFrameQueue {
+public:
+    // Must be a power of 2. Large enough for more than a minute of audio frames while the
+    // video encoder produces nothing, e.g. on a static screen.
+    static const uint32_t kCapacity = 4096;
+
+    WebmFrameQueue() {
+        atomic_init(&mFront, 0u);
+        atomic_init(&mRear, 0u);
+        atomic_init(&mConsumerWaiting, false);
+        atomic_init(&mProducerWaiting, false);
+    }
+
+    // Consumer API.
+    bool empty() {
+        return atomic_load_explicit(&mFront, memory_order_relaxed)
+                == atomic_load_explicit(&mRear, memory_order_acquire);
+    }
+
+    // Returns the oldest frame without removing it, blocking while the ring is empty.
+    sp<WebmFrame> peek() {
+        const uint32_t front = atomic_load_explicit(&mFront, memory_order_relaxed);
+        waitForFrame(front);
+        return mFrames[front & (kCapacity - 1)];
+    }
+
+    // Removes and returns the oldest frame, blocking while the ring is empty.
+    sp<WebmFrame> take() {
+        const uint32_t front = atomic_load_explicit(&mFront, memory_order_relaxed);
+        waitForFrame(front);
+        sp<WebmFrame> frame = mFrames[front & (kCapacity - 1)];
+        mFrames[front & (kCapacity - 1)].clear();
+        atomic_store(&mFront, front + 1);
+        if (atomic_load(&mProducerWaiting)) {
+            Mutex::Autolock autolock(mLock);
+            mNotFullCondition.signal();
+        }
+        return frame;
+    }
+
+    // Only called once both the producer and the consumer have stopped.
+    void clear() {
+        uint32_t front = atomic_load_explicit(&mFront, memory_order_relaxed);
+        const uint32_t rear = atomic_load_explicit(&mRear, memory_order_relaxed);
+        for (; front != rear; ++front) {
+            mFrames[front & (kCapacity - 1)].clear();
+        }
+        atomic_store(&mFront, front);
+    }
+
+    // Producer API. Blocks while the ring is full.
+    void push(const sp<WebmFrame> &frame) {
+        const uint32_t rear = atomic_load_explicit(&mRear, memory_order_relaxed);
+        if (rear - atomic_load_explicit(&mFront, memory_order_acquire) >= kCapacity) {
+            Mutex::Autolock autolock(mLock);
+            for (;;) {
+                atomic_store(&mProducerWaiting, true);
+                if (rear - atomic_load(&mFront) < kCapacity) {
+                    break;
+                }
+                mNotFullCondition.wait(mLock);
+            }
+            atomic_store_explicit(&mProducerWaiting, false, memory_order_relaxed);
+        }
+        mFrames[rear & (kCapacity - 1)] = frame;
+        atomic_store(&mRear, rear + 1);
+        if (atomic_load(&mConsumerWaiting)) {
+            Mutex::Autolock autolock(mLock);
+            mNotEmptyCondition.signal();
+        }
+    }
+
+private:
+    sp<WebmFrame> mFrames[kCapacity];
+    atomic_uint_least32_t mFront;   // next frame to take, written by the consumer only
+    atomic_uint_least32_t mRear;    // next slot to push, written by the producer only
+    atomic_bool mConsumerWaiting;
+    atomic_bool mProducerWaiting;
+
+    Mutex mLock;
+    Condition mNotEmptyCondition;
+    Condition mNotFullCondition;
+
+    void waitForFrame(uint32_t front) {
+        if (front != atomic_load_explicit(&mRear, memory_order_acquire)) {
+            return;
+        }
+        Mutex::Autolock autolock(mLock);
+        for (;;) {
+            atomic_store(&mConsumerWaiting, true);
+            if (front != atomic_load(&mRear)) {
+                break;
+            }
+            mNotEmptyCondition.wait(mLock);
+        }
+        atomic_store_explicit(&mConsumerWaiting, false, memory_order_relaxed);
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(WebmFrameQueue);
+};
+
+} /* namespace android */
+#endif /* WEBMFRAMEQUEUE_H_ */
@@ -17,6 +17,7 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "WebmFrameThread"
 
+#include "EbmlUtil.h"
 #include "WebmConstants.h"
 #include "WebmFrameThread.h"
 
@@ -24,10 +25,57 @@
 #include <media/stagefright/foundation/ADebug.h>
 
 #include <utils/Log.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
 
 using namespace webm;
 
+namespace {
+
+// Largest EBML header of a cluster: a 4-byte id and an 8-byte size.
+const size_t kClusterHeaderSpace = 12;
+const size_t kInitialClusterBufferSize = 256 * 1024;
+const size_t kInitialCuePointsSize = 4096;
+
+// Extends the range of |buf| by |size| bytes, reallocating it if it is full, and returns a
+// pointer to the added bytes. The storage only ever grows, so once a recording reaches its
+// largest cluster no further allocations are made.
+uint8_t *extendRange(android::sp<android::ABuffer>& buf, size_t size) {
+    const size_t used = buf->offset() + buf->size();
+    if (used + size > buf->capacity()) {
+        size_t capacity = buf->capacity() * 2;
+        while (capacity < used + size) {
+            capacity *= 2;
+        }
+        android::sp<android::ABuffer> grown = new android::ABuffer(capacity);
+        memcpy(grown->base(), buf->base(), used);
+        grown->setRange(buf->offset(), buf->size());
+        buf = grown;
+    }
+    buf->setRange(buf->offset(), buf->size() + size);
+    return buf->base() + used;
+}
+
+bool writeFully(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("write failed; errno = %d", errno);
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+}
+
 namespace android {
 
 void *WebmFrameThread::wrap(void *arg) {
@@ -55,7 +103,7 @@ status_t WebmFrameThread::stop() {
 
 WebmFrameSourceThread::WebmFrameSourceThread(
     int type,
-    LinkedBlockingQueue<const sp<WebmFrame> >& sink)
+    WebmFrameQueue& sink)
     : mType(type), mSink(sink) {
 }
 
@@ -65,27 +113,29 @@ WebmFrameSinkThread::WebmFrameSinkThread(
         const int& fd,
         const uint64_t& off,
         sp<WebmFrameSourceThread> videoThread,
-        sp<WebmFrameSourceThread> audioThread,
-        List<sp<WebmElement> >& cues)
+        sp<WebmFrameSourceThread> audioThread)
     : mFd(fd),
       mSegmentDataStart(off),
       mVideoFrames(videoThread->mSink),
       mAudioFrames(audioThread->mSink),
-      mCues(cues),
+      mClusterBuffer(new ABuffer(kInitialClusterBufferSize)),
+      mNumClusterBlocks(0),
+      mCuePoints(new ABuffer(kInitialCuePointsSize)),
       mDone(true) {
 }
 
 WebmFrameSinkThread::WebmFrameSinkThread(
         const int& fd,
         const uint64_t& off,
-        LinkedBlockingQueue<const sp<WebmFrame> >& videoSource,
-        LinkedBlockingQueue<const sp<WebmFrame> >& audioSource,
-        List<sp<WebmElement> >& cues)
+        WebmFrameQueue& videoSource,
+        WebmFrameQueue& audioSource)
     : mFd(fd),
       mSegmentDataStart(off),
       mVideoFrames(videoSource),
       mAudioFrames(audioSource),
-      mCues(cues),
+      mClusterBuffer(new ABuffer(kInitialClusterBufferSize)),
+      mNumClusterBlocks(0),
+      mCuePoints(new ABuffer(kInitialCuePointsSize)),
       mDone(true) {
 }
 
@@ -98,32 +148,46 @@ WebmFrameSinkThread::WebmFrameSinkThread(
 //   the starting timecode of the cluster; this is the timecode of the first
 //   frame since frames are ordered by timestamp.
 //
-// children:
-//   list to hold child elements in a webm cluster (start timecode and
-//   simple blocks).
-//
-// static
+// The cluster payload in mClusterBuffer is reset to hold just the start timecode.
 void WebmFrameSinkThread::initCluster(
     List<const sp<WebmFrame> >& frames,
-    uint64_t& clusterTimecodeL,
-    List<sp<WebmElement> >& children) {
-    CHECK(!frames.empty() && children.empty());
+    uint64_t& clusterTimecodeL) {
+    CHECK(!frames.empty());
 
     const sp<WebmFrame> f = *(frames.begin());
     clusterTimecodeL = f->mAbsTimecode;
-    WebmUnsigned *clusterTimecode = new WebmUnsigned(kMkvTimecode, clusterTimecodeL);
-    children.clear();
-    children.push_back(clusterTimecode);
+    mClusterBuffer->setRange(kClusterHeaderSpace, 0);
+    mNumClusterBlocks = 0;
+
+    WebmUnsigned clusterTimecode(kMkvTimecode, clusterTimecodeL);
+    clusterTimecode.serializeInto(extendRange(mClusterBuffer, clusterTimecode.totalSize()));
 }
 
-void WebmFrameSinkThread::writeCluster(List<sp<WebmElement> >& children) {
-    // children must contain at least one simpleblock and its timecode
-    CHECK_GE(children.size(), 2);
+void WebmFrameSinkThread::addSimpleBlock(const sp<WebmFrame>& frame, uint64_t clusterTimecodeL) {
+    WebmSimpleBlock block(
+            frame->mType == kVideoType ? kVideoTrackNum : kAudioTrackNum,
+            frame->mAbsTimecode - clusterTimecodeL,
+            frame->mKey,
+            frame->mData);
+    block.serializeInto(extendRange(mClusterBuffer, block.totalSize()));
+    ++mNumClusterBlocks;
+}
 
-    uint64_t size;
-    sp<WebmElement> cluster = new WebmMaster(kMkvCluster, children);
-    cluster->write(mFd, size);
-    children.clear();
+void WebmFrameSinkThread::writeCluster() {
+    // the cluster must contain at least one simpleblock besides its timecode
+    CHECK_GE(mNumClusterBlocks, 1u);
+
+    // Serialize the header so that it ends right where the payload starts.
+    const uint64_t codedSize = encodeUnsigned(mClusterBuffer->size());
+    const size_t headerSize = sizeOf(kMkvCluster) + sizeOf(codedSize);
+    CHECK_LE(headerSize, kClusterHeaderSpace);
+    uint8_t *header = mClusterBuffer->data() - headerSize;
+    int idSize = serializeCodedUnsigned(kMkvCluster, header);
+    serializeCodedUnsigned(codedSize, header + idSize);
+
+    writeFully(mFd, header, headerSize + mClusterBuffer->size());
+    mClusterBuffer->setRange(kClusterHeaderSpace, 0);
+    mNumClusterBlocks = 0;
 }
 
 // Write out (possibly multiple) webm cluster(s) from frames split on video key frames.
@@ -136,8 +200,7 @@ void WebmFrameSinkThread::flushFrames(List<const sp<WebmFrame> >& frames, bool l
     }
 
     uint64_t clusterTimecodeL;
-    List<sp<WebmElement> > children;
-    initCluster(frames, clusterTimecodeL, children);
+    initCluster(frames, clusterTimecodeL);
 
     uint64_t cueTime = clusterTimecodeL;
     off_t fpos = ::lseek(mFd, 0, SEEK_CUR);
@@ -160,12 +223,12 @@ void WebmFrameSinkThread::flushFrames(List<const sp<WebmFrame> >& frames, bool l
         }
 
         if (f->mAbsTimecode - clusterTimecodeL > INT16_MAX) {
-            writeCluster(children);
-            initCluster(frames, clusterTimecodeL, children);
+            writeCluster();
+            initCluster(frames, clusterTimecodeL);
         }
 
         frames.erase(frames.begin());
-        children.push_back(f->SimpleBlock(clusterTimecodeL));
+        addSimpleBlock(f, clusterTimecodeL);
     }
 
     // equivalent to last==false
@@ -174,17 +237,21 @@ void WebmFrameSinkThread::flushFrames(List<const sp<WebmFrame> >& frames, bool l
         const sp<WebmFrame> secondLastFrame = *(frames.begin());
         if (secondLastFrame->mType == kVideoType) {
             frames.erase(frames.begin());
-            children.push_back(secondLastFrame->SimpleBlock(clusterTimecodeL));
+            addSimpleBlock(secondLastFrame, clusterTimecodeL);
         }
     }
 
-    writeCluster(children);
+    writeCluster();
+
+    // Cue points are serialized as they are produced, so that stopping only has to write out
+    // the accumulated bytes.
     sp<WebmElement> cuePoint = WebmElement::CuePointEntry(cueTime, 1, fpos - mSegmentDataStart);
-    mCues.push_back(cuePoint);
+    cuePoint->serializeInto(extendRange(mCuePoints, cuePoint->totalSize()));
 }
 
 status_t WebmFrameSinkThread::start() {
     mDone = false;
+    mCuePoints->setRange(0, 0);
     return WebmFrameThread::start();
 }
 
@@ -248,7 +315,7 @@ void WebmFrameMediaSourceThread::clearFlags() {
 WebmFrameMediaSourceThread::WebmFrameMediaSourceThread(
         const sp<MediaSource>& source,
         int type,
-        LinkedBlockingQueue<const sp<WebmFrame> >& sink,
+        WebmFrameQueue& sink,
         uint64_t timeCodeScale,
         int64_t startTimeRealUs,
         int32_t startTimeOffsetMs,
@@ -18,7 +18,7 @@
 #define WEBMFRAMETHREAD_H_
 
 #include "WebmFrame.h"
-#include "LinkedBlockingQueue.h"
+#include "WebmFrameQueue.h"
 
 #include <media/stagefright/FileSource.h>
 #include <media/stagefright/MediaSource.h>
@@ -60,15 +60,13 @@ public:
             const int& fd,
             const uint64_t& off,
             sp<WebmFrameSourceThread> videoThread,
-            sp<WebmFrameSourceThread> audioThread,
-            List<sp<WebmElement> >& cues);
+            sp<WebmFrameSourceThread> audioThread);
 
     WebmFrameSinkThread(
             const int& fd,
             const uint64_t& off,
-            LinkedBlockingQueue<const sp<WebmFrame> >& videoSource,
-            LinkedBlockingQueue<const sp<WebmFrame> >& audioSource,
-            List<sp<WebmElement> >& cues);
+            WebmFrameQueue& videoSource,
+            WebmFrameQueue& audioSource);
 
     void run();
     bool running() {
@@ -77,20 +75,30 @@ public:
     status_t start();
     status_t stop();
 
+    // Payload of the Cues element: the serialized CuePoints of every cluster written so far.
+    // Only valid once the thread has stopped.
+    const sp<ABuffer>& cuePoints() const {
+        return mCuePoints;
+    }
+
 private:
     const int& mFd;
     const uint64_t& mSegmentDataStart;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mVideoFrames;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mAudioFrames;
-    List<sp<WebmElement> >& mCues;
+    WebmFrameQueue& mVideoFrames;
+    WebmFrameQueue& mAudioFrames;
+
+    // A cluster is serialized straight into mClusterBuffer, whose storage is kept from one
+    // cluster to the next, and then written with a single write(). The range of the buffer is
+    // the cluster payload; kClusterHeaderSpace bytes are kept in front of it for the header.
+    sp<ABuffer> mClusterBuffer;
+    size_t mNumClusterBlocks;
+    sp<ABuffer> mCuePoints;
 
     volatile bool mDone;
 
-    static void initCluster(
-            List<const sp<WebmFrame> >& frames,
-            uint64_t& clusterTimecodeL,
-            List<sp<WebmElement> >& children);
-    void writeCluster(List<sp<WebmElement> >& children);
+    void initCluster(List<const sp<WebmFrame> >& frames, uint64_t& clusterTimecodeL);
+    void addSimpleBlock(const sp<WebmFrame>& frame, uint64_t clusterTimecodeL);
+    void writeCluster();
     void flushFrames(List<const sp<WebmFrame> >& frames, bool last);
 };
 
@@ -98,11 +106,11 @@ private:
 
 class WebmFrameSourceThread : public WebmFrameThread {
 public:
-    WebmFrameSourceThread(int type, LinkedBlockingQueue<const sp<WebmFrame> >& sink);
+    WebmFrameSourceThread(int type, WebmFrameQueue& sink);
     virtual int64_t getDurationUs() = 0;
 protected:
     const int mType;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mSink;
+    WebmFrameQueue& mSink;
 
     friend class WebmFrameSinkThread;
 };
@@ -111,7 +119,7 @@ protected:
 
 class WebmFrameEmptySourceThread : public WebmFrameSourceThread {
 public:
-    WebmFrameEmptySourceThread(int type, LinkedBlockingQueue<const sp<WebmFrame> >& sink)
+    WebmFrameEmptySourceThread(int type, WebmFrameQueue& sink)
         : WebmFrameSourceThread(type, sink) {
     }
     void run() { mSink.push(WebmFrame::EOS); }
@@ -125,7 +133,7 @@ public:
     WebmFrameMediaSourceThread(
             const sp<MediaSource>& source,
             int type,
-            LinkedBlockingQueue<const sp<WebmFrame> >& sink,
+            WebmFrameQueue& sink,
             uint64_t timeCodeScale,
             int64_t startTimeRealUs,
             int32_t startTimeOffsetMs,
@@ -76,8 +76,7 @@ WebmWriter::WebmWriter(int fd)
             mFd,
             mSegmentDataStart,
             mStreams[kVideoIndex].mSink,
-            mStreams[kAudioIndex].mSink,
-            mCuePoints);
+            mStreams[kAudioIndex].mSink);
 }
 
 // static
@@ -273,7 +272,8 @@ status_t WebmWriter::reset() {
         return err;
     }
 
-    sp<WebmElement> cues = new WebmMaster(kMkvCues, mCuePoints);
+    // The sink thread has already serialized the cue points, wrap them in the Cues element.
+    sp<WebmElement> cues = new WebmBinary(kMkvCues, mSinkThread->cuePoints());
     uint64_t cuesSize = cues->totalSize();
     // TRICKY Even when the cues do fit in the space we reserved, if they do not fit
     // perfectly, we still need to check if there is enough "extra space" to write an
@@ -289,7 +289,6 @@ status_t WebmWriter::reset() {
         space->write(mFd, spaceSize);
     }
 
-    mCuePoints.clear();
     mStreams[kVideoIndex].mSink.clear();
     mStreams[kAudioIndex].mSink.clear();
 
@@ -19,7 +19,7 @@
 
 #include "WebmConstants.h"
 #include "WebmFrameThread.h"
-#include "LinkedBlockingQueue.h"
+#include "WebmFrameQueue.h"
 
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaWriter.h>
@@ -72,7 +72,6 @@ private:
     uint64_t mEstimatedCuesSize;
 
     Mutex mLock;
-    List<sp<WebmElement> > mCuePoints;
 
     enum {
         kAudioIndex     =  0,
@@ -88,7 +87,7 @@ private:
         sp<MediaSource> mSource;
         sp<WebmElement> mTrackEntry;
         sp<WebmFrameSourceThread> mThread;
-        LinkedBlockingQueue<const sp<WebmFrame> > mSink;
+        WebmFrameQueue mSink;
 
         WebmStream()
             : mType(kInvalidType),
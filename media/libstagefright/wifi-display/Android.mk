@@ -7,6 +7,7 @@ LOCAL_SRC_FILES:= \
         Parameters.cpp                  \
         rtp/RTPSender.cpp               \
         source/Converter.cpp            \
+        source/LatencyController.cpp    \
         source/MediaPuller.cpp          \
         source/PlaybackSession.cpp      \
         source/RepeaterSource.cpp       \
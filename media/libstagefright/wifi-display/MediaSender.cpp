@@ -359,6 +359,33 @@ void MediaSender::onSenderNotify(const sp<AMessage> &msg) {
             break;
         }
 
+        case RTPSender::kWhatTransportStats:
+        {
+            size_t queuedBytes;
+            CHECK(msg->findSize("queuedBytes", &queuedBytes));
+
+            int64_t sendLatencyUs;
+            CHECK(msg->findInt64("sendLatencyUs", &sendLatencyUs));
+
+            sp<AMessage> notify = mNotify->dup();
+            notify->setInt32("what", kWhatTransportStats);
+            notify->setSize("queuedBytes", queuedBytes);
+            notify->setInt64("sendLatencyUs", sendLatencyUs);
+
+            int32_t fractionLost;
+            if (msg->findInt32("fractionLost", &fractionLost)) {
+                int64_t jitterUs, rttUs;
+                CHECK(msg->findInt64("jitterUs", &jitterUs));
+                CHECK(msg->findInt64("rttUs", &rttUs));
+
+                notify->setInt32("fractionLost", fractionLost);
+                notify->setInt64("jitterUs", jitterUs);
+                notify->setInt64("rttUs", rttUs);
+            }
+            notify->post();
+            break;
+        }
+
         default:
             TRESPASS();
     }
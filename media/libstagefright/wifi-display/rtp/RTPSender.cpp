@@ -212,11 +212,9 @@ status_t RTPSender::queueRawPacket(
     int64_t timeUs;
     CHECK(packet->meta()->findInt64("timeUs", &timeUs));
 
-    sp<ABuffer> udpPacket = new ABuffer(12 + packet->size());
+    sp<ABuffer> header = new ABuffer(12);
 
-    udpPacket->setInt32Data(mRTPSeqNo);
-
-    uint8_t *rtp = udpPacket->data();
+    uint8_t *rtp = header->data();
     rtp[0] = 0x80;
     rtp[1] = packetType;
 
@@ -236,10 +234,9 @@ status_t RTPSender::queueRawPacket(
     rtp[10] = (kSourceID >> 8) & 0xff;
     rtp[11] = kSourceID & 0xff;
 
-    memcpy(&rtp[12], packet->data(), packet->size());
-
     return sendRTPPacket(
-            udpPacket,
+            header,
+            packet, 0, packet->size(),
             true /* storeInHistory */,
             true /* timeValid */,
             ALooper::GetNowUs());
@@ -254,12 +251,9 @@ status_t RTPSender::queueTSPackets(
 
     size_t srcOffset = 0;
     while (srcOffset < tsPackets->size()) {
-        sp<ABuffer> udpPacket =
-            new ABuffer(12 + kMaxNumTSPacketsPerRTPPacket * 188);
-
-        udpPacket->setInt32Data(mRTPSeqNo);
+        sp<ABuffer> header = new ABuffer(12);
 
-        uint8_t *rtp = udpPacket->data();
+        uint8_t *rtp = header->data();
         rtp[0] = 0x80;
         rtp[1] = packetType;
 
@@ -285,15 +279,13 @@ status_t RTPSender::queueTSPackets(
             numTSPackets = kMaxNumTSPacketsPerRTPPacket;
         }
 
-        memcpy(&rtp[12], tsPackets->data() + srcOffset, numTSPackets * 188);
-
-        udpPacket->setRange(0, 12 + numTSPackets * 188);
-
+        size_t offset = srcOffset;
         srcOffset += numTSPackets * 188;
         bool isLastPacket = (srcOffset == tsPackets->size());
 
         status_t err = sendRTPPacket(
-                udpPacket,
+                header,
+                tsPackets, offset, numTSPackets * 188,
                 true /* storeInHistory */,
                 isLastPacket /* timeValid */,
                 timeUs);
@@ -313,7 +305,7 @@ status_t RTPSender::queueAVCBuffer(
 
     uint32_t rtpTime = (timeUs * 9 / 100ll);
 
-    List<sp<ABuffer> > packets;
+    List<Packet> packets;
 
     sp<ABuffer> out = new ABuffer(kMaxUDPPacketSize);
     size_t outBytesUsed = 12;  // Placeholder for RTP header.
@@ -331,30 +323,32 @@ status_t RTPSender::queueAVCBuffer(
         }
 
         if (outBytesUsed + bytesNeeded > out->capacity()) {
-            bool emitSingleNALPacket = false;
-
             if (outBytesUsed == 12
                     && outBytesUsed + nalSize <= out->capacity()) {
                 // We haven't emitted anything into the current packet yet and
                 // this NAL unit fits into a single-NAL-unit-packet while
                 // it wouldn't have fit as part of a STAP-A packet.
 
-                memcpy(out->data() + outBytesUsed, nalStart, nalSize);
-                outBytesUsed += nalSize;
-
-                emitSingleNALPacket = true;
+                Packet packet;
+                packet.mHeader = new ABuffer(12);
+                packet.mOffset = nalStart - accessUnit->data();
+                packet.mSize = nalSize;
+                packets.push_back(packet);
+                continue;
             }
 
             if (outBytesUsed > 12) {
                 out->setRange(0, outBytesUsed);
-                packets.push_back(out);
+
+                Packet packet;
+                packet.mHeader = out;
+                packet.mOffset = 0;
+                packet.mSize = 0;
+                packets.push_back(packet);
+
                 out = new ABuffer(kMaxUDPPacketSize);
                 outBytesUsed = 12;  // Placeholder for RTP header
             }
-
-            if (emitSingleNALPacket) {
-                continue;
-            }
         }
 
         if (outBytesUsed + bytesNeeded <= out->capacity()) {
@@ -382,12 +376,17 @@ status_t RTPSender::queueAVCBuffer(
 
         size_t srcOffset = 1;
         while (srcOffset < nalSize) {
-            size_t copy = out->capacity() - outBytesUsed - 2;
+            size_t copy = kMaxUDPPacketSize - 12 - 2;
             if (copy > nalSize - srcOffset) {
                 copy = nalSize - srcOffset;
             }
 
-            uint8_t *dst = out->data() + outBytesUsed;
+            Packet packet;
+            packet.mHeader = new ABuffer(12 + 2);
+            packet.mOffset = nalStart + srcOffset - accessUnit->data();
+            packet.mSize = copy;
+
+            uint8_t *dst = packet.mHeader->data() + 12;
             dst[0] = (nri << 5) | 28;
 
             dst[1] = nalType;
@@ -400,31 +399,29 @@ status_t RTPSender::queueAVCBuffer(
                 dst[1] |= 0x40;
             }
 
-            memcpy(&dst[2], nalStart + srcOffset, copy);
             srcOffset += copy;
 
-            out->setRange(0, outBytesUsed + copy + 2);
-
-            packets.push_back(out);
-            out = new ABuffer(kMaxUDPPacketSize);
-            outBytesUsed = 12;  // Placeholder for RTP header
+            packets.push_back(packet);
         }
     }
 
     if (outBytesUsed > 12) {
         out->setRange(0, outBytesUsed);
-        packets.push_back(out);
+
+        Packet packet;
+        packet.mHeader = out;
+        packet.mOffset = 0;
+        packet.mSize = 0;
+        packets.push_back(packet);
     }
 
     while (!packets.empty()) {
-        sp<ABuffer> out = *packets.begin();
+        Packet packet = *packets.begin();
         packets.erase(packets.begin());
 
-        out->setInt32Data(mRTPSeqNo);
-
         bool last = packets.empty();
 
-        uint8_t *dst = out->data();
+        uint8_t *dst = packet.mHeader->data();
 
         dst[0] = 0x80;
 
@@ -446,7 +443,11 @@ status_t RTPSender::queueAVCBuffer(
         dst[10] = (kSourceID >> 8) & 0xff;
         dst[11] = kSourceID & 0xff;
 
-        status_t err = sendRTPPacket(out, true /* storeInHistory */);
+        status_t err = sendRTPPacket(
+                packet.mHeader,
+                packet.mSize > 0 ? accessUnit : sp<ABuffer>(),
+                packet.mOffset, packet.mSize,
+                true /* storeInHistory */);
 
         if (err != OK) {
             return err;
@@ -457,36 +458,68 @@ status_t RTPSender::queueAVCBuffer(
 }
 
 status_t RTPSender::sendRTPPacket(
-        const sp<ABuffer> &buffer, bool storeInHistory,
+        const sp<ABuffer> &header,
+        const sp<ABuffer> &payload, size_t offset, size_t size,
+        bool storeInHistory,
         bool timeValid, int64_t timeUs) {
     CHECK(mRTPConnected);
 
-    status_t err = mNetSession->sendRequest(
-            mRTPSessionID, buffer->data(), buffer->size(),
-            timeValid, timeUs);
+    status_t err;
+    if (payload == NULL) {
+        err = mNetSession->sendRequest(
+                mRTPSessionID, header, timeValid, timeUs);
+    } else {
+        err = mNetSession->sendRequest(
+                mRTPSessionID, header, payload, offset, size,
+                timeValid, timeUs);
+    }
 
     if (err != OK) {
         return err;
     }
 
     mLastNTPTime = GetNowNTP();
-    mLastRTPTime = U32_AT(buffer->data() + 4);
+    mLastRTPTime = U32_AT(header->data() + 4);
 
     ++mNumRTPSent;
-    mNumRTPOctetsSent += buffer->size() - 12;
+    mNumRTPOctetsSent += header->size() - 12 + (payload == NULL ? 0 : size);
 
     if (storeInHistory) {
-        if (mHistorySize == kMaxHistorySize) {
-            mHistory.erase(mHistory.begin());
-        } else {
+        uint16_t seqNo = U16_AT(header->data() + 2);
+
+        HistoryEntry *entry = &mHistory[seqNo & (kMaxHistorySize - 1)];
+        entry->mSeqNo = seqNo;
+        entry->mHeader = header;
+        entry->mPayload = payload;
+        entry->mOffset = offset;
+        entry->mSize = size;
+
+        if (mHistorySize < kMaxHistorySize) {
             ++mHistorySize;
         }
-        mHistory.push_back(buffer);
     }
 
     return OK;
 }
 
+bool RTPSender::retransmitPacket(uint16_t seqNo) {
+    const HistoryEntry &entry = mHistory[seqNo & (kMaxHistorySize - 1)];
+
+    if (entry.mHeader == NULL || entry.mSeqNo != seqNo) {
+        return false;
+    }
+
+    ALOGV("retransmitting seqNo %d", seqNo);
+
+    CHECK_EQ((status_t)OK,
+             sendRTPPacket(
+                 entry.mHeader,
+                 entry.mPayload, entry.mOffset, entry.mSize,
+                 false /* storeInHistory */));
+
+    return true;
+}
+
 // static
 uint64_t RTPSender::GetNowNTP() {
     struct timeval tv;
@@ -509,6 +542,10 @@ void RTPSender::onMessageReceived(const sp<AMessage> &msg) {
             onNetNotify(msg->what() == kWhatRTPNotify, msg);
             break;
 
+        case kWhatSendSR:
+            onSendSR();
+            break;
+
         default:
             TRESPASS();
     }
@@ -683,16 +720,120 @@ status_t RTPSender::onRTCPData(const sp<ABuffer> &buffer) {
     return OK;
 }
 
-status_t RTPSender::parseReceiverReport(
-        const uint8_t *data, size_t /* size */) {
-    float fractionLost = data[12] / 256.0f;
+status_t RTPSender::parseReceiverReport(const uint8_t *data, size_t size) {
+    // The report blocks follow the sender info in an SR.
+    size_t offset = (data[1] == 200) ? 28 : 8;
 
-    ALOGI("lost %.2f %% of packets during report interval.",
-          100.0f * fractionLost);
+    if ((data[0] & 0x1f) == 0) {
+        return OK;
+    }
+
+    if (size < offset + 24) {
+        return ERROR_MALFORMED;
+    }
+
+    const uint8_t *block = &data[offset];
+    if (U32_AT(block) != kSourceID) {
+        return OK;
+    }
+
+    uint32_t fractionLost = block[4];
+    uint32_t jitter = U32_AT(&block[12]);
+    uint32_t lsr = U32_AT(&block[16]);
+    uint32_t dlsr = U32_AT(&block[20]);
+
+    ALOGV("lost %.2f %% of packets during report interval.",
+          100.0f * fractionLost / 256.0f);
+
+    // Round trip in units of 1/65536 seconds (RFC 3550, 6.4.1).
+    int64_t rttUs = -1ll;
+    if (lsr != 0 && mNumSRsSent > 0) {
+        int32_t rtt = (int32_t)((uint32_t)(GetNowNTP() >> 16) - lsr - dlsr);
+        if (rtt >= 0) {
+            rttUs = (int64_t)rtt * 1000000ll / 65536;
+        }
+    }
+
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatTransportStats);
+    notify->setInt32("fractionLost", fractionLost);
+    notify->setInt64("jitterUs", (int64_t)jitter * 1000000ll / 90000);
+    notify->setInt64("rttUs", rttUs);
+    notifyTransportStats(notify);
 
     return OK;
 }
 
+void RTPSender::onSendSR() {
+    if (mRTCPSessionID != 0 && mRTCPConnected) {
+        sendSR();
+    }
+
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatTransportStats);
+    notifyTransportStats(notify);
+
+    (new AMessage(kWhatSendSR, this))->post(kSRIntervalUs);
+}
+
+status_t RTPSender::sendSR() {
+    uint64_t ntpTime = GetNowNTP();
+
+    // The RTP time corresponding to now, from the last packet sent.
+    uint64_t elapsedNTP = ntpTime - mLastNTPTime;
+    uint32_t rtpTime = mLastRTPTime;
+    if (mNumRTPSent > 0) {
+        rtpTime += (uint32_t)(((elapsedNTP >> 16) * 90000) >> 16);
+    }
+
+    uint8_t data[28];
+    data[0] = 0x80;
+    data[1] = 200;  // SR
+    data[2] = 0;
+    data[3] = 6;    // length in 32-bit words minus one
+    data[4] = kSourceID >> 24;
+    data[5] = (kSourceID >> 16) & 0xff;
+    data[6] = (kSourceID >> 8) & 0xff;
+    data[7] = kSourceID & 0xff;
+
+    const uint32_t words[] = {
+        (uint32_t)(ntpTime >> 32),
+        (uint32_t)ntpTime,
+        rtpTime,
+        mNumRTPSent,
+        mNumRTPOctetsSent,
+    };
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i) {
+        uint8_t *dst = &data[8 + 4 * i];
+        dst[0] = words[i] >> 24;
+        dst[1] = (words[i] >> 16) & 0xff;
+        dst[2] = (words[i] >> 8) & 0xff;
+        dst[3] = words[i] & 0xff;
+    }
+
+    status_t err = mNetSession->sendRequest(mRTCPSessionID, data, sizeof(data));
+
+    if (err == OK) {
+        ++mNumSRsSent;
+    }
+
+    return err;
+}
+
+void RTPSender::notifyTransportStats(const sp<AMessage> &notify) {
+    ANetworkSession::SessionStats stats;
+    if (mRTPSessionID == 0
+            || mNetSession->getSessionStats(mRTPSessionID, &stats) != OK) {
+        return;
+    }
+
+    notify->setSize("queuedBytes", stats.mQueuedBytes);
+    notify->setInt64(
+            "sendLatencyUs",
+            stats.mQueuedFragments > 0 ? stats.mLastSendLatencyUs : 0ll);
+    notify->post();
+}
+
 status_t RTPSender::parseTSFB(const uint8_t *data, size_t size) {
     if ((data[0] & 0x1f) != 1) {
         return ERROR_UNSUPPORTED;  // We only support NACK for now.
@@ -707,42 +848,13 @@ status_t RTPSender::parseTSFB(const uint8_t *data, size_t size) {
         uint16_t seqNo = U16_AT(&data[i]);
         uint16_t blp = U16_AT(&data[i + 2]);
 
-        List<sp<ABuffer> >::iterator it = mHistory.begin();
-        bool foundSeqNo = false;
-        while (it != mHistory.end()) {
-            const sp<ABuffer> &buffer = *it;
-
-            uint16_t bufferSeqNo = buffer->int32Data() & 0xffff;
-
-            bool retransmit = false;
-            if (bufferSeqNo == seqNo) {
-                retransmit = true;
-            } else if (blp != 0) {
-                for (size_t i = 0; i < 16; ++i) {
-                    if ((blp & (1 << i))
-                        && (bufferSeqNo == ((seqNo + i + 1) & 0xffff))) {
-                        blp &= ~(1 << i);
-                        retransmit = true;
-                    }
-                }
-            }
-
-            if (retransmit) {
-                ALOGV("retransmitting seqNo %d", bufferSeqNo);
-
-                CHECK_EQ((status_t)OK,
-                         sendRTPPacket(buffer, false /* storeInHistory */));
+        bool foundSeqNo = retransmitPacket(seqNo);
 
-                if (bufferSeqNo == seqNo) {
-                    foundSeqNo = true;
-                }
-
-                if (foundSeqNo && blp == 0) {
-                    break;
-                }
+        for (size_t j = 0; j < 16; ++j) {
+            if ((blp & (1 << j))
+                    && retransmitPacket((seqNo + j + 1) & 0xffff)) {
+                blp &= ~(1 << j);
             }
-
-            ++it;
         }
 
         if (!foundSeqNo || blp != 0) {
@@ -750,9 +862,9 @@ status_t RTPSender::parseTSFB(const uint8_t *data, size_t size) {
                   "retransmission (seqNo = %d, foundSeqNo = %d, blp = 0x%04x)",
                   seqNo, foundSeqNo, blp);
 
-            if (!mHistory.empty()) {
-                int32_t earliest = (*mHistory.begin())->int32Data() & 0xffff;
-                int32_t latest = (*--mHistory.end())->int32Data() & 0xffff;
+            if (mHistorySize > 0) {
+                int32_t earliest = (mRTPSeqNo - mHistorySize) & 0xffff;
+                int32_t latest = (mRTPSeqNo - 1) & 0xffff;
 
                 ALOGI("have seq numbers from %d - %d", earliest, latest);
             }
@@ -782,6 +894,10 @@ void RTPSender::notifyInitDone(status_t err) {
     notify->setInt32("what", kWhatInitDone);
     notify->setInt32("err", err);
     notify->post();
+
+    if (err == OK) {
+        (new AMessage(kWhatSendSR, this))->post(kSRIntervalUs);
+    }
 }
 
 void RTPSender::notifyError(status_t err) {
@@ -38,6 +38,12 @@ struct RTPSender : public RTPBase, public AHandler {
         kWhatError,
         kWhatNetworkStall,
         kWhatInformSender,
+        // Posted with every sender report interval, and as soon as a
+        // receiver report arrives:
+        //   "queuedBytes", "sendLatencyUs": the RTP send queue.
+        //   "fractionLost" (out of 256), "jitterUs", "rttUs" (-1 unless the
+        //   sink echoed one of our sender reports): only for a receiver report.
+        kWhatTransportStats,
     };
     RTPSender(
             const sp<ANetworkSession> &netSession,
@@ -64,12 +70,14 @@ private:
     enum {
         kWhatRTPNotify,
         kWhatRTCPNotify,
+        kWhatSendSR,
     };
 
     enum {
         kMaxNumTSPacketsPerRTPPacket = (kMaxUDPPacketSize - 12) / 188,
         kMaxHistorySize              = 1024,
         kSourceID                    = 0xdeadbeef,
+        kSRIntervalUs                = 500000,
     };
 
     sp<ANetworkSession> mNetSession;
@@ -89,19 +97,45 @@ private:
 
     uint32_t mRTPSeqNo;
 
-    List<sp<ABuffer> > mHistory;
+    // A sent packet is kept as its RTP header (which for STAP-A packets
+    // also holds the aggregated NAL units) and a range of the buffer that
+    // was queued, so that neither queueing nor a retransmission copies the
+    // payload. Entry i holds the last packet with (seqNo % kMaxHistorySize) == i.
+    struct HistoryEntry {
+        uint16_t mSeqNo;
+        sp<ABuffer> mHeader;
+        sp<ABuffer> mPayload;
+        size_t mOffset;
+        size_t mSize;
+    };
+
+    HistoryEntry mHistory[kMaxHistorySize];
     size_t mHistorySize;
 
+    // An H.264 packet that has yet to be numbered. Single NAL unit packets
+    // and FU-A fragments refer to mSize bytes at mOffset in the access unit,
+    // STAP-A packets are assembled in mHeader.
+    struct Packet {
+        sp<ABuffer> mHeader;
+        size_t mOffset;
+        size_t mSize;
+    };
+
     static uint64_t GetNowNTP();
 
     status_t queueRawPacket(const sp<ABuffer> &tsPackets, uint8_t packetType);
     status_t queueTSPackets(const sp<ABuffer> &tsPackets, uint8_t packetType);
     status_t queueAVCBuffer(const sp<ABuffer> &accessUnit, uint8_t packetType);
 
+    // "payload" may be NULL if "header" is the complete packet.
     status_t sendRTPPacket(
-            const sp<ABuffer> &packet, bool storeInHistory,
+            const sp<ABuffer> &header,
+            const sp<ABuffer> &payload, size_t offset, size_t size,
+            bool storeInHistory,
             bool timeValid = false, int64_t timeUs = -1ll);
 
+    bool retransmitPacket(uint16_t seqNo);
+
     void onNetNotify(bool isRTP, const sp<AMessage> &msg);
 
     status_t onRTCPData(const sp<ABuffer> &data);
@@ -109,6 +143,11 @@ private:
     status_t parseTSFB(const uint8_t *data, size_t size);
     status_t parseAPP(const uint8_t *data, size_t size);
 
+    void onSendSR();
+    status_t sendSR();
+
+    void notifyTransportStats(const sp<AMessage> &notify);
+
     void notifyInitDone(status_t err);
     void notifyError(status_t err);
     void notifyNetworkStall(size_t numBytesQueued);
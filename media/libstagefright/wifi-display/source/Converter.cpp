@@ -171,11 +171,17 @@ status_t Converter::initEncoder() {
         mOutputFormat->setInt32("bitrate", videoBitrate);
         mOutputFormat->setInt32("bitrate-mode", OMX_Video_ControlRateConstant);
         mOutputFormat->setInt32("frame-rate", 30);
-        mOutputFormat->setInt32("i-frame-interval", 15);  // Iframes every 15 secs
 
 #ifndef BOARD_NO_INTRA_MACROBLOCK_MODE_SUPPORT
         // Configure encoder to use intra macroblock refresh mode
         mOutputFormat->setInt32("intra-refresh-mode", OMX_VIDEO_IntraRefreshCyclic);
+
+        // The refresh heals the picture after a loss, periodic IDR frames
+        // would only add bursts the network has to absorb. IDRs are still
+        // sent on request.
+        mOutputFormat->setInt32("i-frame-interval", -1);
+#else
+        mOutputFormat->setInt32("i-frame-interval", 15);  // Iframes every 15 secs
 #endif
 
         int width, height, mbs;
@@ -191,6 +197,15 @@ status_t Converter::initEncoder() {
         // to recover from a lost/corrupted packet.
         mbs = (((width + 15) / 16) * ((height + 15) / 16) * 10) / 100;
         mOutputFormat->setInt32("intra-refresh-CIR-mbs", mbs);
+
+        if (mFlags & FLAG_USE_SURFACE_INPUT) {
+            // Drop display frames that the encoder could not keep up with
+            // rather than letting the mirroring latency grow.
+            int32_t maxLatencyMs = GetInt32Property("media.wfd.max-latency-ms", 100);
+            if (maxLatencyMs > 0) {
+                mOutputFormat->setInt64("max-latency-to-encoder", maxLatencyMs * 1000ll);
+            }
+        }
     }
 
     ALOGV("output format is '%s'", mOutputFormat->debugString(0).c_str());
@@ -771,6 +786,12 @@ status_t Converter::doMoreWork() {
                 sp<AMessage> notify = mNotify->dup();
                 notify->setInt32("what", kWhatAccessUnit);
                 notify->setBuffer("accessUnit", buffer);
+                if (mIsVideo) {
+                    // Input timestamps are system time, this is how long
+                    // the frame spent waiting for and in the encoder.
+                    int64_t latencyUs = ALooper::GetNowUs() - timeUs;
+                    notify->setInt64("latencyUs", latencyUs > 0 ? latencyUs : 0);
+                }
                 notify->post();
             }
         }
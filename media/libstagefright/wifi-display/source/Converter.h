@@ -33,6 +33,8 @@ struct MediaCodec;
 // Right now this'll convert raw video into H.264 and raw audio into AAC.
 struct Converter : public AHandler {
     enum {
+        // Video access units carry "latencyUs", the time from capture
+        // until the encoder produced them.
         kWhatAccessUnit,
         kWhatEOS,
         kWhatError,
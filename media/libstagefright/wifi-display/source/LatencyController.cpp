@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "LatencyController"
+#include <utils/Log.h>
+
+#include "LatencyController.h"
+
+namespace android {
+
+// Decisions are taken at most this often...
+static const int64_t kEvaluationIntervalUs = 200000ll;
+// ...and a decrease is given this long to show an effect before the next.
+static const int64_t kDecreaseHoldUs = 500000ll;
+// Probing for more bandwidth starts this long after the last decrease, one
+// step per kIncreaseIntervalUs.
+static const int64_t kIncreaseHoldUs = 2000000ll;
+static const int64_t kIncreaseIntervalUs = 1000000ll;
+
+// Receiver and sink reports older than this are not taken into account.
+static const int64_t kReportValidityUs = 3000000ll;
+
+// Fraction lost, out of 256. Up to kLossThreshold the intra refresh heals
+// the picture on its own, beyond kHeavyLoss it takes too long and an IDR
+// frame is requested, at most every kMinIDRIntervalUs.
+static const int32_t kLossThreshold = 13;   // 5%
+static const int32_t kHeavyLoss = 26;       // 10%
+static const int64_t kMinIDRIntervalUs = 2000000ll;
+
+LatencyController::LatencyController(
+        int64_t targetLatencyUs,
+        int32_t minVideoBitrate, int32_t maxVideoBitrate,
+        double minFrameRate, double maxFrameRate)
+    : mTargetLatencyUs(targetLatencyUs),
+      mMinVideoBitrate(minVideoBitrate),
+      mMaxVideoBitrate(maxVideoBitrate),
+      mMinFrameRate(minFrameRate),
+      mMaxFrameRate(maxFrameRate),
+      mEncoderLatencyUs(-1ll),
+      mSendLatencyUs(-1ll),
+      mRTTUs(-1ll),
+      mJitterUs(-1ll),
+      mFractionLost(0),
+      mLastReportUs(-1ll),
+      mHeavyLoss(false),
+      mSinkLatencyUs(-1ll),
+      mLastSinkReportUs(-1ll),
+      mLastEvaluationUs(-1ll),
+      mLastDecreaseUs(-1ll),
+      mLastIncreaseUs(-1ll),
+      mLastIDRUs(-1ll) {
+}
+
+// static
+int64_t LatencyController::Smooth(int64_t averageUs, int64_t sampleUs) {
+    if (averageUs < 0) {
+        return sampleUs;
+    }
+
+    return (7 * averageUs + sampleUs) / 8;
+}
+
+void LatencyController::onEncoderLatency(int64_t latencyUs) {
+    mEncoderLatencyUs = Smooth(mEncoderLatencyUs, latencyUs);
+}
+
+void LatencyController::onSendQueue(
+        size_t queuedBytes, int64_t sendLatencyUs) {
+    ALOGV("send queue %zu bytes, %lld us", queuedBytes, (long long)sendLatencyUs);
+
+    mSendLatencyUs = Smooth(mSendLatencyUs, sendLatencyUs);
+}
+
+void LatencyController::onReceiverReport(
+        int64_t nowUs, int32_t fractionLost, int64_t jitterUs, int64_t rttUs) {
+    mFractionLost = fractionLost;
+    mLastReportUs = nowUs;
+
+    if (fractionLost >= kHeavyLoss) {
+        mHeavyLoss = true;
+    }
+
+    mJitterUs = Smooth(mJitterUs, jitterUs);
+
+    if (rttUs >= 0) {
+        mRTTUs = Smooth(mRTTUs, rttUs);
+    }
+}
+
+void LatencyController::onSinkLatency(int64_t nowUs, int64_t avgLatencyUs) {
+    mSinkLatencyUs = avgLatencyUs;
+    mLastSinkReportUs = nowUs;
+}
+
+int64_t LatencyController::estimatedLatencyUs() const {
+    int64_t latencyUs = 0;
+
+    if (mEncoderLatencyUs > 0) {
+        latencyUs += mEncoderLatencyUs;
+    }
+
+    if (mSendLatencyUs > 0) {
+        latencyUs += mSendLatencyUs;
+    }
+
+    if (mRTTUs > 0) {
+        latencyUs += mRTTUs / 2;
+    }
+
+    if (mJitterUs > 0) {
+        latencyUs += mJitterUs;
+    }
+
+    return latencyUs;
+}
+
+bool LatencyController::evaluate(
+        int64_t nowUs, int32_t videoBitrate, double frameRate,
+        Decision *decision) {
+    if (mLastEvaluationUs >= 0
+            && nowUs - mLastEvaluationUs < kEvaluationIntervalUs) {
+        return false;
+    }
+    mLastEvaluationUs = nowUs;
+
+    int32_t fractionLost =
+        (mLastReportUs >= 0 && nowUs - mLastReportUs < kReportValidityUs)
+            ? mFractionLost : 0;
+
+    // The sink's figure includes its own jitter buffer, it only counts
+    // once it is far off.
+    bool sinkIsLate =
+        mLastSinkReportUs >= 0
+            && nowUs - mLastSinkReportUs < kReportValidityUs
+            && mSinkLatencyUs > 3 * mTargetLatencyUs;
+
+    int64_t latencyUs = estimatedLatencyUs();
+
+    decision->mVideoBitrate = videoBitrate;
+    decision->mFrameRate = frameRate;
+    decision->mRequestIDR = false;
+
+    if (mHeavyLoss) {
+        mHeavyLoss = false;
+
+        if (mLastIDRUs < 0 || nowUs - mLastIDRUs >= kMinIDRIntervalUs) {
+            decision->mRequestIDR = true;
+            mLastIDRUs = nowUs;
+        }
+    }
+
+    if (latencyUs > mTargetLatencyUs
+            || fractionLost >= kLossThreshold
+            || sinkIsLate) {
+        if (mLastDecreaseUs < 0 || nowUs - mLastDecreaseUs >= kDecreaseHoldUs) {
+            double scale = (latencyUs > 2 * mTargetLatencyUs) ? 0.7 : 0.85;
+
+            decision->mVideoBitrate = (int32_t)(videoBitrate * scale);
+            if (decision->mVideoBitrate < mMinVideoBitrate) {
+                decision->mVideoBitrate = mMinVideoBitrate;
+            }
+
+            // A backlog in the encoder isn't helped by fewer bits per frame.
+            if (frameRate > 0.0 && mEncoderLatencyUs > mTargetLatencyUs / 2) {
+                decision->mFrameRate = frameRate * 0.9;
+                if (decision->mFrameRate < mMinFrameRate) {
+                    decision->mFrameRate = mMinFrameRate;
+                }
+            }
+
+            mLastDecreaseUs = nowUs;
+
+            ALOGV("latency %lld us, lost %d/256 -> %d bps, %.2f Hz",
+                  (long long)latencyUs, fractionLost,
+                  decision->mVideoBitrate, decision->mFrameRate);
+        }
+    } else if (latencyUs < mTargetLatencyUs / 2
+            && fractionLost == 0
+            && (mLastDecreaseUs < 0 || nowUs - mLastDecreaseUs >= kIncreaseHoldUs)
+            && (mLastIncreaseUs < 0
+                    || nowUs - mLastIncreaseUs >= kIncreaseIntervalUs)) {
+        decision->mVideoBitrate = (int32_t)(videoBitrate * 1.05);
+        if (decision->mVideoBitrate > mMaxVideoBitrate) {
+            decision->mVideoBitrate = mMaxVideoBitrate;
+        }
+
+        if (frameRate > 0.0 && mEncoderLatencyUs < mTargetLatencyUs / 4) {
+            decision->mFrameRate = frameRate * 1.1;
+            if (decision->mFrameRate > mMaxFrameRate) {
+                decision->mFrameRate = mMaxFrameRate;
+            }
+        }
+
+        mLastIncreaseUs = nowUs;
+    }
+
+    return decision->mVideoBitrate != videoBitrate
+        || decision->mFrameRate != frameRate
+        || decision->mRequestIDR;
+}
+
+}  // namespace android
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LATENCY_CONTROLLER_H_
+
+#define LATENCY_CONTROLLER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+// Keeps the mirroring latency near a target by steering the video bitrate,
+// the frame rate and, after heavy loss, IDR frames. Its inputs are the
+// encoder backlog (Converter), the RTP send queue and the receiver reports
+// (RTPSender), and the latency the sink measured, if it reports any.
+// Not thread safe, owned by the PlaybackSession.
+struct LatencyController {
+    struct Decision {
+        int32_t mVideoBitrate;
+        double mFrameRate;
+        bool mRequestIDR;
+    };
+
+    LatencyController(
+            int64_t targetLatencyUs,
+            int32_t minVideoBitrate, int32_t maxVideoBitrate,
+            double minFrameRate, double maxFrameRate);
+
+    void onEncoderLatency(int64_t latencyUs);
+    void onSendQueue(size_t queuedBytes, int64_t sendLatencyUs);
+    void onReceiverReport(
+            int64_t nowUs, int32_t fractionLost, int64_t jitterUs, int64_t rttUs);
+    void onSinkLatency(int64_t nowUs, int64_t avgLatencyUs);
+
+    // Returns true and fills in *decision if the current bitrate or frame
+    // rate should change or an IDR frame is due. Cheap enough to call for
+    // every encoded frame, decisions are spaced out internally.
+    bool evaluate(
+            int64_t nowUs, int32_t videoBitrate, double frameRate,
+            Decision *decision);
+
+    // The current estimate of the latency up to the sink's network stack.
+    int64_t estimatedLatencyUs() const;
+
+private:
+    int64_t mTargetLatencyUs;
+    int32_t mMinVideoBitrate;
+    int32_t mMaxVideoBitrate;
+    double mMinFrameRate;
+    double mMaxFrameRate;
+
+    // Smoothed, -1 until measured.
+    int64_t mEncoderLatencyUs;
+    int64_t mSendLatencyUs;
+    int64_t mRTTUs;
+    int64_t mJitterUs;
+
+    int32_t mFractionLost;
+    int64_t mLastReportUs;
+    bool mHeavyLoss;
+
+    int64_t mSinkLatencyUs;
+    int64_t mLastSinkReportUs;
+
+    int64_t mLastEvaluationUs;
+    int64_t mLastDecreaseUs;
+    int64_t mLastIncreaseUs;
+    int64_t mLastIDRUs;
+
+    static int64_t Smooth(int64_t averageUs, int64_t sampleUs);
+
+    DISALLOW_EVIL_CONSTRUCTORS(LatencyController);
+};
+
+}  // namespace android
+
+#endif  // LATENCY_CONTROLLER_H_
@@ -49,6 +49,11 @@
 
 namespace android {
 
+static const int32_t kMinVideoBitrate = 500000;
+static const int32_t kMaxVideoBitrate = 10000000;
+static const double kMinFrameRate = 5.0;
+static const double kMaxFrameRate = 30.0;
+
 struct WifiDisplaySource::PlaybackSession::Track : public AHandler {
     enum {
         kWhatStopped,
@@ -365,7 +370,12 @@ WifiDisplaySource::PlaybackSession::PlaybackSession(
       mPullExtractorPending(false),
       mPullExtractorGeneration(0),
       mFirstSampleTimeRealUs(-1ll),
-      mFirstSampleTimeUs(-1ll) {
+      mFirstSampleTimeUs(-1ll),
+      mLatencyController(
+              Converter::GetInt32Property(
+                  "media.wfd.target-latency-ms", 100) * 1000ll,
+              kMinVideoBitrate, kMaxVideoBitrate,
+              kMinFrameRate, kMaxFrameRate) {
     if (path != NULL) {
         mMediaPath.setTo(path);
     }
@@ -505,6 +515,13 @@ void WifiDisplaySource::PlaybackSession::onMessageReceived(
 
                 if (err != OK) {
                     notifySessionDead();
+                    break;
+                }
+
+                int64_t latencyUs;
+                if (msg->findInt64("latencyUs", &latencyUs)) {
+                    mLatencyController.onEncoderLatency(latencyUs);
+                    adaptToNetwork();
                 }
                 break;
             } else if (what == Converter::kWhatEOS) {
@@ -568,6 +585,8 @@ void WifiDisplaySource::PlaybackSession::onMessageReceived(
                 }
             } else if (what == MediaSender::kWhatInformSender) {
                 onSinkFeedback(msg);
+            } else if (what == MediaSender::kWhatTransportStats) {
+                onTransportStats(msg);
             } else {
                 TRESPASS();
             }
@@ -674,76 +693,105 @@ void WifiDisplaySource::PlaybackSession::onSinkFeedback(const sp<AMessage> &msg)
           avgLatencyUs / 1000ll,
           maxLatencyUs / 1000ll);
 
-    if (mVideoTrackIndex >= 0) {
-        const sp<Track> &videoTrack = mTracks.valueFor(mVideoTrackIndex);
-        sp<Converter> converter = videoTrack->converter();
+    mLatencyController.onSinkLatency(ALooper::GetNowUs(), avgLatencyUs);
 
-        if (converter != NULL) {
-            int32_t videoBitrate =
-                Converter::GetInt32Property("media.wfd.video-bitrate", -1);
+    adaptToNetwork();
+}
 
-            char val[PROPERTY_VALUE_MAX];
-            if (videoBitrate < 0
-                    && property_get("media.wfd.video-bitrate", val, NULL)
-                    && !strcasecmp("adaptive", val)) {
-                videoBitrate = converter->getVideoBitrate();
+void WifiDisplaySource::PlaybackSession::onTransportStats(
+        const sp<AMessage> &msg) {
+    size_t queuedBytes;
+    CHECK(msg->findSize("queuedBytes", &queuedBytes));
 
-                if (avgLatencyUs > 300000ll) {
-                    videoBitrate *= 0.6;
-                } else if (avgLatencyUs < 100000ll) {
-                    videoBitrate *= 1.1;
-                }
-            }
+    int64_t sendLatencyUs;
+    CHECK(msg->findInt64("sendLatencyUs", &sendLatencyUs));
 
-            if (videoBitrate > 0) {
-                if (videoBitrate < 500000) {
-                    videoBitrate = 500000;
-                } else if (videoBitrate > 10000000) {
-                    videoBitrate = 10000000;
-                }
+    mLatencyController.onSendQueue(queuedBytes, sendLatencyUs);
 
-                if (videoBitrate != converter->getVideoBitrate()) {
-                    ALOGI("setting video bitrate to %d bps", videoBitrate);
+    int32_t fractionLost;
+    if (msg->findInt32("fractionLost", &fractionLost)) {
+        int64_t jitterUs, rttUs;
+        CHECK(msg->findInt64("jitterUs", &jitterUs));
+        CHECK(msg->findInt64("rttUs", &rttUs));
 
-                    converter->setVideoBitrate(videoBitrate);
-                }
-            }
-        }
+        mLatencyController.onReceiverReport(
+                ALooper::GetNowUs(), fractionLost, jitterUs, rttUs);
+    }
 
-        sp<RepeaterSource> repeaterSource = videoTrack->repeaterSource();
-        if (repeaterSource != NULL) {
-            double rateHz =
-                Converter::GetInt32Property(
-                        "media.wfd.video-framerate", -1);
-
-            char val[PROPERTY_VALUE_MAX];
-            if (rateHz < 0.0
-                    && property_get("media.wfd.video-framerate", val, NULL)
-                    && !strcasecmp("adaptive", val)) {
-                 rateHz = repeaterSource->getFrameRate();
-
-                if (avgLatencyUs > 300000ll) {
-                    rateHz *= 0.9;
-                } else if (avgLatencyUs < 200000ll) {
-                    rateHz *= 1.1;
-                }
-            }
+    adaptToNetwork();
+}
 
-            if (rateHz > 0) {
-                if (rateHz < 5.0) {
-                    rateHz = 5.0;
-                } else if (rateHz > 30.0) {
-                    rateHz = 30.0;
-                }
+// Applies the latency controller's decisions. Setting "media.wfd.video-bitrate"
+// or "media.wfd.video-framerate" to a number pins that parameter instead.
+void WifiDisplaySource::PlaybackSession::adaptToNetwork() {
+    if (mVideoTrackIndex < 0) {
+        return;
+    }
 
-                if (rateHz != repeaterSource->getFrameRate()) {
-                    ALOGI("setting frame rate to %.2f Hz", rateHz);
+    const sp<Track> &videoTrack = mTracks.valueFor(mVideoTrackIndex);
+    sp<Converter> converter = videoTrack->converter();
+    sp<RepeaterSource> repeaterSource = videoTrack->repeaterSource();
 
-                    repeaterSource->setFrameRate(rateHz);
-                }
-            }
+    if (converter == NULL) {
+        return;
+    }
+
+    LatencyController::Decision decision;
+    if (!mLatencyController.evaluate(
+                ALooper::GetNowUs(),
+                converter->getVideoBitrate(),
+                repeaterSource != NULL ? repeaterSource->getFrameRate() : 0.0,
+                &decision)) {
+        return;
+    }
+
+    int32_t videoBitrate =
+        Converter::GetInt32Property("media.wfd.video-bitrate", -1);
+
+    if (videoBitrate < 0) {
+        videoBitrate = decision.mVideoBitrate;
+    }
+
+    if (videoBitrate < kMinVideoBitrate) {
+        videoBitrate = kMinVideoBitrate;
+    } else if (videoBitrate > kMaxVideoBitrate) {
+        videoBitrate = kMaxVideoBitrate;
+    }
+
+    if (videoBitrate != converter->getVideoBitrate()) {
+        ALOGI("setting video bitrate to %d bps (latency %lld ms)",
+              videoBitrate,
+              (long long)mLatencyController.estimatedLatencyUs() / 1000ll);
+
+        converter->setVideoBitrate(videoBitrate);
+    }
+
+    if (repeaterSource != NULL) {
+        double rateHz =
+            Converter::GetInt32Property("media.wfd.video-framerate", -1);
+
+        if (rateHz < 0.0) {
+            rateHz = decision.mFrameRate;
+        }
+
+        if (rateHz < kMinFrameRate) {
+            rateHz = kMinFrameRate;
+        } else if (rateHz > kMaxFrameRate) {
+            rateHz = kMaxFrameRate;
+        }
+
+        if (rateHz != repeaterSource->getFrameRate()) {
+            ALOGI("setting frame rate to %.2f Hz", rateHz);
+
+            repeaterSource->setFrameRate(rateHz);
         }
     }
+
+    if (decision.mRequestIDR) {
+        ALOGI("requesting IDR frame after heavy packet loss");
+
+        videoTrack->requestIDRFrame();
+    }
 }
 
 status_t WifiDisplaySource::PlaybackSession::setupMediaPacketizer(
@@ -1050,6 +1098,11 @@ status_t WifiDisplaySource::PlaybackSession::addVideoSource(
     sp<RepeaterSource> videoSource =
         new RepeaterSource(source, framesPerSecond);
 
+    // Mirrored screens are mostly static, don't keep encoding and sending
+    // the same frame unless "media.wfd.suppress-repeats" is set to 0.
+    videoSource->setSuppressRepeats(
+            Converter::GetInt32Property("media.wfd.suppress-repeats", 1) != 0);
+
     size_t numInputBuffers;
     status_t err = addSource(
             true /* isVideo */, videoSource, true /* isRepeaterSource */,
@@ -18,6 +18,7 @@
 
 #define PLAYBACK_SESSION_H_
 
+#include "LatencyController.h"
 #include "MediaSender.h"
 #include "VideoFormats.h"
 #include "WifiDisplaySource.h"
@@ -129,6 +130,8 @@ private:
     int64_t mFirstSampleTimeRealUs;
     int64_t mFirstSampleTimeUs;
 
+    LatencyController mLatencyController;
+
     status_t setupMediaPacketizer(bool enableAudio, bool enableVideo);
 
     status_t setupPacketizer(
@@ -166,6 +169,8 @@ private:
     void onPullExtractor();
 
     void onSinkFeedback(const sp<AMessage> &msg);
+    void onTransportStats(const sp<AMessage> &msg);
+    void adaptToNetwork();
 
     DISALLOW_EVIL_CONSTRUCTORS(PlaybackSession);
 };
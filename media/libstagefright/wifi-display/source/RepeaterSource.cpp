@@ -20,7 +20,10 @@ RepeaterSource::RepeaterSource(const sp<MediaSource> &source, double rateHz)
       mResult(OK),
       mLastBufferUpdateUs(-1ll),
       mStartTimeUs(-1ll),
-      mFrameCount(0) {
+      mFrameCount(0),
+      mSuppressRepeats(false),
+      mBufferIsNew(false),
+      mLastEmitUs(-1ll) {
 }
 
 RepeaterSource::~RepeaterSource() {
@@ -46,6 +49,12 @@ void RepeaterSource::setFrameRate(double rateHz) {
     mRateHz = rateHz;
 }
 
+void RepeaterSource::setSuppressRepeats(bool suppress) {
+    Mutex::Autolock autoLock(mLock);
+    mSuppressRepeats = suppress;
+    mCondition.broadcast();
+}
+
 status_t RepeaterSource::start(MetaData *params) {
     CHECK(!mStarted);
 
@@ -59,6 +68,8 @@ status_t RepeaterSource::start(MetaData *params) {
     mResult = OK;
     mStartTimeUs = -1ll;
     mFrameCount = 0;
+    mBufferIsNew = false;
+    mLastEmitUs = -1ll;
 
     mLooper = new ALooper;
     mLooper->setName("repeater_looper");
@@ -140,6 +151,31 @@ status_t RepeaterSource::read(
 
         {
             Mutex::Autolock autoLock(mLock);
+
+            if (mSuppressRepeats && !mBufferIsNew && mBuffer != NULL
+                    && mLastBufferUpdateUs >= 0ll
+                    && ALooper::GetNowUs()
+                            >= mLastBufferUpdateUs + kRefineDurationUs) {
+                // The screen is static and the encoder has already had
+                // its share of repeats, hold off until it changes or a
+                // keep-alive repeat is due.
+                int64_t deadlineUs = mLastEmitUs + kIdleRepeatIntervalUs;
+                for (;;) {
+                    int64_t nowUs = ALooper::GetNowUs();
+                    if (mBufferIsNew || mResult != OK || !mSuppressRepeats
+                            || nowUs >= deadlineUs) {
+                        break;
+                    }
+                    mCondition.waitRelative(
+                            mLock, (deadlineUs - nowUs) * 1000ll);
+                }
+
+                // Do not catch up on the frames that were suppressed.
+                mStartTimeUs = ALooper::GetNowUs();
+                mFrameCount = 0;
+                bufferTimeUs = mStartTimeUs;
+            }
+
             if (mResult != OK) {
                 CHECK(mBuffer == NULL);
                 return mResult;
@@ -157,6 +193,9 @@ status_t RepeaterSource::read(
                 *buffer = mBuffer;
                 (*buffer)->meta_data()->setInt64(kKeyTime, bufferTimeUs);
                 ++mFrameCount;
+
+                mBufferIsNew = false;
+                mLastEmitUs = ALooper::GetNowUs();
             }
         }
 
@@ -193,6 +232,7 @@ void RepeaterSource::onMessageReceived(const sp<AMessage> &msg) {
             mBuffer = buffer;
             mResult = err;
             mLastBufferUpdateUs = ALooper::GetNowUs();
+            mBufferIsNew = (err == OK);
 
             mCondition.broadcast();
 
@@ -11,7 +11,10 @@
 namespace android {
 
 // This MediaSource delivers frames at a constant rate by repeating buffers
-// if necessary.
+// if necessary. With repeat suppression enabled, an unchanged frame is only
+// repeated for a short while after the last update, so that the encoder can
+// refine it, and then only as an occasional keep-alive until the screen
+// changes again.
 struct RepeaterSource : public MediaSource {
     RepeaterSource(const sp<MediaSource> &source, double rateHz);
 
@@ -31,6 +34,8 @@ struct RepeaterSource : public MediaSource {
     double getFrameRate() const;
     void setFrameRate(double rateHz);
 
+    void setSuppressRepeats(bool suppress);
+
 protected:
     virtual ~RepeaterSource();
 
@@ -39,6 +44,14 @@ private:
         kWhatRead,
     };
 
+    enum {
+        // Unchanged frames keep being repeated at the full rate for this long
+        // after an update...
+        kRefineDurationUs     = 500000ll,
+        // ...and then once per this interval.
+        kIdleRepeatIntervalUs = 1000000ll,
+    };
+
     Mutex mLock;
     Condition mCondition;
 
@@ -57,6 +70,10 @@ private:
     int64_t mStartTimeUs;
     int32_t mFrameCount;
 
+    bool mSuppressRepeats;
+    bool mBufferIsNew;
+    int64_t mLastEmitUs;
+
     void postRead();
 
     DISALLOW_EVIL_CONSTRUCTORS(RepeaterSource);
@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include "TSPacketizer.h"
+#include "TSCrc32.h"
 #include "include/avc_utils.h"
 
 #include <media/stagefright/foundation/ABuffer.h>
@@ -346,8 +347,6 @@ TSPacketizer::TSPacketizer(uint32_t flags)
     : mFlags(flags),
       mPATContinuityCounter(0),
       mPMTContinuityCounter(0) {
-    initCrcTable();
-
     if (flags & (EMIT_HDCP20_DESCRIPTOR | EMIT_HDCP21_DESCRIPTOR)) {
         int32_t hdcpVersion;
         if (flags & EMIT_HDCP20_DESCRIPTOR) {
@@ -697,7 +696,7 @@ status_t TSPacketizer::packetize(
         *ptr++ = kPID_PMT & 0xff;
 
         CHECK_EQ(ptr - crcDataStart, 12);
-        uint32_t crc = htonl(crc32(crcDataStart, ptr - crcDataStart));
+        uint32_t crc = htonl(ComputeTSCrc32(crcDataStart, ptr - crcDataStart));
         memcpy(ptr, &crc, 4);
         ptr += 4;
 
@@ -812,7 +811,7 @@ status_t TSPacketizer::packetize(
         crcDataStart[1] = 0xb0 | (section_length >> 8);
         crcDataStart[2] = section_length & 0xff;
 
-        crc = htonl(crc32(crcDataStart, ptr - crcDataStart));
+        crc = htonl(ComputeTSCrc32(crcDataStart, ptr - crcDataStart));
         memcpy(ptr, &crc, 4);
         ptr += 4;
 
@@ -1011,29 +1010,6 @@ status_t TSPacketizer::packetize(
     return OK;
 }
 
-void TSPacketizer::initCrcTable() {
-    uint32_t poly = 0x04C11DB7;
-
-    for (int i = 0; i < 256; i++) {
-        uint32_t crc = i << 24;
-        for (int j = 0; j < 8; j++) {
-            crc = (crc << 1) ^ ((crc & 0x80000000) ? (poly) : 0);
-        }
-        mCrcTable[i] = crc;
-    }
-}
-
-uint32_t TSPacketizer::crc32(const uint8_t *start, size_t size) const {
-    uint32_t crc = 0xFFFFFFFF;
-    const uint8_t *p;
-
-    for (p = start; p < start + size; ++p) {
-        crc = (crc << 8) ^ mCrcTable[((crc >> 24) ^ *p) & 0xFF];
-    }
-
-    return crc;
-}
-
 sp<ABuffer> TSPacketizer::prependCSD(
         size_t trackIndex, const sp<ABuffer> &accessUnit) const {
     CHECK_LT(trackIndex, mTracks.size());
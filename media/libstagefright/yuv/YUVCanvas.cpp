@@ -32,19 +32,41 @@ YUVCanvas::~YUVCanvas() {
 }
 
 void YUVCanvas::FillYUV(uint8_t yValue, uint8_t uValue, uint8_t vValue) {
-    for (int32_t y = 0; y < mYUVImage.height(); ++y) {
-        for (int32_t x = 0; x < mYUVImage.width(); ++x) {
-            mYUVImage.setPixelValue(x, y, yValue, uValue, vValue);
-        }
+    FillYUVRectangle(Rect(mYUVImage.width(), mYUVImage.height()),
+            yValue, uValue, vValue);
+}
+
+// static
+void YUVCanvas::fillChroma(uint8_t *dest, int32_t step, int32_t count, uint8_t value) {
+    if (step == 1) {
+        memset(dest, value, count);
+        return;
+    }
+    for (int32_t i = 0; i < count; ++i) {
+        dest[i * step] = value;
     }
 }
 
 void YUVCanvas::FillYUVRectangle(const Rect& rect,
         uint8_t yValue, uint8_t uValue, uint8_t vValue) {
+    if (rect.isEmpty()) {
+        return;
+    }
+    CHECK(mYUVImage.validPixel(rect.left, rect.top));
+    CHECK(mYUVImage.validPixel(rect.right - 1, rect.bottom - 1));
+
+    // Same result as setting every pixel: fill the Y rows of the rectangle
+    // and every chroma value shared by one of its pixels.
     for (int32_t y = rect.top; y < rect.bottom; ++y) {
-        for (int32_t x = rect.left; x < rect.right; ++x) {
-            mYUVImage.setPixelValue(x, y, yValue, uValue, vValue);
-        }
+        memset(mYUVImage.getYRow(y) + rect.left, yValue, rect.width());
+    }
+
+    const int32_t step = mYUVImage.chromaStep();
+    const int32_t chromaLeft = rect.left >> 1;
+    const int32_t chromaCount = ((rect.right - 1) >> 1) - chromaLeft + 1;
+    for (int32_t y = rect.top & ~1; y < rect.bottom; y += 2) {
+        fillChroma(mYUVImage.getURow(y) + chromaLeft * step, step, chromaCount, uValue);
+        fillChroma(mYUVImage.getVRow(y) + chromaLeft * step, step, chromaCount, vValue);
     }
 }
 
@@ -61,22 +83,63 @@ void YUVCanvas::CopyImageRect(
         return;
     }
 
-    int32_t srcStartX = srcRect.left;
-    int32_t srcStartY = srcRect.top;
-    for (int32_t offsetY = 0; offsetY < srcRect.height(); ++offsetY) {
-        for (int32_t offsetX = 0; offsetX < srcRect.width(); ++offsetX) {
-            int32_t srcX = srcStartX + offsetX;
-            int32_t srcY = srcStartY + offsetY;
-
-            int32_t destX = destStartX + offsetX;
-            int32_t destY = destStartY + offsetY;
+    // The formats differ, convert a row at a time.
+    const int32_t srcStartX = srcRect.left;
+    const int32_t srcStartY = srcRect.top;
+    const int32_t width = srcRect.width();
+    const int32_t height = srcRect.height();
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    CHECK(srcImage.validPixel(srcStartX, srcStartY));
+    CHECK(srcImage.validPixel(srcRect.right - 1, srcRect.bottom - 1));
+    CHECK(mYUVImage.validPixel(destStartX, destStartY));
+    CHECK(mYUVImage.validPixel(destStartX + width - 1, destStartY + height - 1));
+
+    for (int32_t offsetY = 0; offsetY < height; ++offsetY) {
+        memcpy(mYUVImage.getYRow(destStartY + offsetY) + destStartX,
+                srcImage.getYRow(srcStartY + offsetY) + srcStartX,
+                width);
+    }
 
-            uint8_t yValue;
-            uint8_t uValue;
-            uint8_t vValue;
+    // Each destination chroma value takes the value of the last pixel
+    // copied to it, as setting the pixels one by one would.
+    const int32_t srcStep = srcImage.chromaStep();
+    const int32_t destStep = mYUVImage.chromaStep();
+    const int32_t destChromaLeft = destStartX >> 1;
+    const int32_t destChromaRight = (destStartX + width - 1) >> 1;
+    const bool aligned = !(srcStartX & 1) && !(destStartX & 1);
+    for (int32_t destY = destStartY & ~1; destY < destStartY + height; destY += 2) {
+        int32_t offsetY = destY + 1 - destStartY;
+        if (offsetY >= height) {
+            offsetY = height - 1;
+        }
+        const uint8_t *srcU = srcImage.getURow(srcStartY + offsetY);
+        const uint8_t *srcV = srcImage.getVRow(srcStartY + offsetY);
+        uint8_t *destU = mYUVImage.getURow(destY);
+        uint8_t *destV = mYUVImage.getVRow(destY);
+
+        if (aligned) {
+            // interleave or deinterleave whole rows
+            srcU += (srcStartX >> 1) * srcStep;
+            srcV += (srcStartX >> 1) * srcStep;
+            destU += destChromaLeft * destStep;
+            destV += destChromaLeft * destStep;
+            for (int32_t i = 0; i <= destChromaRight - destChromaLeft; ++i) {
+                destU[i * destStep] = srcU[i * srcStep];
+                destV[i * destStep] = srcV[i * srcStep];
+            }
+            continue;
+        }
 
-            srcImage.getPixelValue(srcX, srcY, &yValue, &uValue, &vValue);
-            mYUVImage.setPixelValue(destX, destY, yValue, uValue, vValue);
+        for (int32_t destCx = destChromaLeft; destCx <= destChromaRight; ++destCx) {
+            int32_t offsetX = 2 * destCx + 1 - destStartX;
+            if (offsetX >= width) {
+                offsetX = width - 1;
+            }
+            int32_t srcOffset = ((srcStartX + offsetX) >> 1) * srcStep;
+            destU[destCx * destStep] = srcU[srcOffset];
+            destV[destCx * destStep] = srcV[srcOffset];
         }
     }
 }
@@ -91,21 +154,99 @@ void YUVCanvas::downsample(
     CHECK((srcOffsetX + (mYUVImage.width() - 1) * skipX) < srcImage.width());
     CHECK((srcOffsetY + (mYUVImage.height() - 1) * skipY) < srcImage.height());
 
-    uint8_t yValue;
-    uint8_t uValue;
-    uint8_t vValue;
+    const int32_t width = mYUVImage.width();
+    const int32_t height = mYUVImage.height();
+
+    for (int32_t y = 0; y < height; ++y) {
+        const uint8_t *srcRow = srcImage.getYRow(srcOffsetY + y * skipY) + srcOffsetX;
+        uint8_t *destRow = mYUVImage.getYRow(y);
+        for (int32_t x = 0; x < width; ++x) {
+            destRow[x] = srcRow[x * skipX];
+        }
+    }
+
+    // Like CopyImageRect(), each chroma value is taken from the source pixel
+    // of the last destination pixel sharing it.
+    const int32_t srcStep = srcImage.chromaStep();
+    const int32_t destStep = mYUVImage.chromaStep();
+    for (int32_t y = 0; y < height; y += 2) {
+        const int32_t lastY = y + 1 < height ? y + 1 : y;
+        const int32_t srcY = srcOffsetY + lastY * skipY;
+        const uint8_t *srcU = srcImage.getURow(srcY);
+        const uint8_t *srcV = srcImage.getVRow(srcY);
+        uint8_t *destU = mYUVImage.getURow(y);
+        uint8_t *destV = mYUVImage.getVRow(y);
+        for (int32_t x = 0; x < width; x += 2) {
+            const int32_t lastX = x + 1 < width ? x + 1 : x;
+            const int32_t srcOffset = ((srcOffsetX + lastX * skipX) >> 1) * srcStep;
+            const int32_t destOffset = (x >> 1) * destStep;
+            destU[destOffset] = srcU[srcOffset];
+            destV[destOffset] = srcV[srcOffset];
+        }
+    }
+}
 
-    int32_t srcY = srcOffsetY;
-    for (int32_t y = 0; y < mYUVImage.height(); ++y) {
-        int32_t srcX = srcOffsetX;
-        for (int32_t x = 0; x < mYUVImage.width(); ++x) {
-            srcImage.getPixelValue(srcX, srcY, &yValue, &uValue, &vValue);
-            mYUVImage.setPixelValue(x, y, yValue, uValue, vValue);
+// Bilinear scaling of one plane, in 16.16 fixed point with 8 bit weights.
+static void resizePlane(
+        const uint8_t *src, int32_t srcWidth, int32_t srcHeight,
+        int32_t srcStride, int32_t srcStep,
+        uint8_t *dest, int32_t destWidth, int32_t destHeight,
+        int32_t destStride, int32_t destStep) {
+    if (srcWidth <= 0 || srcHeight <= 0 || destWidth <= 0 || destHeight <= 0) {
+        return;
+    }
 
-            srcX += skipX;
+    // Pixel centers of the destination map to pixel centers of the source.
+    const int64_t xStep = ((int64_t)srcWidth << 16) / destWidth;
+    const int64_t yStep = ((int64_t)srcHeight << 16) / destHeight;
+    const int64_t xMax = (int64_t)(srcWidth - 1) << 16;
+    const int64_t yMax = (int64_t)(srcHeight - 1) << 16;
+
+    int64_t sy = yStep / 2 - 0x8000;
+    for (int32_t y = 0; y < destHeight; ++y, sy += yStep) {
+        const int64_t cy = sy < 0 ? 0 : (sy > yMax ? yMax : sy);
+        const int32_t y0 = cy >> 16;
+        const int32_t y1 = y0 + 1 < srcHeight ? y0 + 1 : y0;
+        const int32_t fy = (cy >> 8) & 0xff;
+        const uint8_t *row0 = src + y0 * srcStride;
+        const uint8_t *row1 = src + y1 * srcStride;
+        uint8_t *out = dest + y * destStride;
+
+        int64_t sx = xStep / 2 - 0x8000;
+        for (int32_t x = 0; x < destWidth; ++x, sx += xStep) {
+            const int64_t cx = sx < 0 ? 0 : (sx > xMax ? xMax : sx);
+            const int32_t x0 = (cx >> 16) * srcStep;
+            const int32_t x1 = (cx >> 16) + 1 < srcWidth ? x0 + srcStep : x0;
+            const int32_t fx = (cx >> 8) & 0xff;
+
+            const int32_t top = row0[x0] * (256 - fx) + row0[x1] * fx;
+            const int32_t bottom = row1[x0] * (256 - fx) + row1[x1] * fx;
+            out[x * destStep] = (top * (256 - fy) + bottom * fy + 0x8000) >> 16;
         }
-        srcY += skipY;
     }
 }
 
+void YUVCanvas::resize(const YUVImage &srcImage) {
+    const int32_t srcWidth = srcImage.width();
+    const int32_t srcHeight = srcImage.height();
+    const int32_t destWidth = mYUVImage.width();
+    const int32_t destHeight = mYUVImage.height();
+
+    resizePlane(srcImage.getYRow(0), srcWidth, srcHeight, srcWidth, 1,
+            mYUVImage.getYRow(0), destWidth, destHeight, destWidth, 1);
+
+    const int32_t srcStep = srcImage.chromaStep();
+    const int32_t destStep = mYUVImage.chromaStep();
+    const int32_t srcChromaStride = (srcWidth >> 1) * srcStep;
+    const int32_t destChromaStride = (destWidth >> 1) * destStep;
+    resizePlane(srcImage.getURow(0), srcWidth >> 1, srcHeight >> 1,
+            srcChromaStride, srcStep,
+            mYUVImage.getURow(0), destWidth >> 1, destHeight >> 1,
+            destChromaStride, destStep);
+    resizePlane(srcImage.getVRow(0), srcWidth >> 1, srcHeight >> 1,
+            srcChromaStride, srcStep,
+            mYUVImage.getVRow(0), destWidth >> 1, destHeight >> 1,
+            destChromaStride, destStep);
+}
+
 }  // namespace android
@@ -141,6 +141,23 @@ uint8_t* YUVImage::getVAddress(int32_t offset) const {
     return mVdata + offset;
 }
 
+uint8_t *YUVImage::getYRow(int32_t y) const {
+    return mYdata + y * mWidth;
+}
+
+uint8_t *YUVImage::getURow(int32_t y) const {
+    return mUdata + (y >> 1) * (mWidth >> 1) * chromaStep();
+}
+
+uint8_t *YUVImage::getVRow(int32_t y) const {
+    return mVdata + (y >> 1) * (mWidth >> 1) * chromaStep();
+}
+
+int32_t YUVImage::chromaStep() const {
+    // U and V are interleaved in semi planar formats.
+    return mYUVFormat == YUV420SemiPlanar ? 2 : 1;
+}
+
 bool YUVImage::getYUVAddresses(int32_t x, int32_t y,
         uint8_t **yAddr, uint8_t **uAddr, uint8_t **vAddr) const {
     int32_t yOffset;
@@ -383,6 +400,18 @@ void YUVImage::yuv2rgb(uint8_t yValue, uint8_t uValue, uint8_t vValue,
     *b = clamp(bTmp, 0, 255);
 }
 
+static char *appendDecimal(char *out, uint8_t value, char separator) {
+    if (value >= 100) {
+        *out++ = '0' + value / 100;
+    }
+    if (value >= 10) {
+        *out++ = '0' + (value / 10) % 10;
+    }
+    *out++ = '0' + value % 10;
+    *out++ = separator;
+    return out;
+}
+
 bool YUVImage::writeToPPM(const char *filename) const {
     FILE *fp = fopen(filename, "w");
     if (fp == NULL) {
@@ -391,21 +420,33 @@ bool YUVImage::writeToPPM(const char *filename) const {
     fprintf(fp, "P3\n");
     fprintf(fp, "%d %d\n", mWidth, mHeight);
     fprintf(fp, "255\n");
+
+    // Formats a row at a time, up to "255 255 255\n" per pixel.
+    char *row = new char[mWidth * 12];
+    const int32_t step = chromaStep();
     for (int32_t y = 0; y < mHeight; ++y) {
+        const uint8_t *yRow = getYRow(y);
+        const uint8_t *uRow = getURow(y);
+        const uint8_t *vRow = getVRow(y);
+
+        char *out = row;
         for (int32_t x = 0; x < mWidth; ++x) {
-            uint8_t yValue = 0u;
-            uint8_t uValue = 0u;
-            uint8_t vValue = 0u;
-            getPixelValue(x, y, &yValue, &uValue, & vValue);
+            int32_t chromaOffset = (x >> 1) * step;
 
             uint8_t rValue;
             uint8_t gValue;
             uint8_t bValue;
-            yuv2rgb(yValue, uValue, vValue, &rValue, &gValue, &bValue);
+            yuv2rgb(yRow[x], uRow[chromaOffset], vRow[chromaOffset],
+                    &rValue, &gValue, &bValue);
 
-            fprintf(fp, "%d %d %d\n", (int32_t)rValue, (int32_t)gValue, (int32_t)bValue);
+            out = appendDecimal(out, rValue, ' ');
+            out = appendDecimal(out, gValue, ' ');
+            out = appendDecimal(out, bValue, '\n');
         }
+        fwrite(row, 1, out - row, fp);
     }
+    delete[] row;
+
     fclose(fp);
     return true;
 }
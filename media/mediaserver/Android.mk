@@ -25,6 +25,7 @@ LOCAL_SHARED_LIBRARIES := \
 	libnbaio \
 	libmedia \
 	libmediaplayerservice \
+	libstagefright_foundation \
 	libutils \
 	liblog \
 	libbinder \
@@ -19,13 +19,17 @@
 //#define LOG_NDEBUG 0
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/prctl.h>
 #include <sys/wait.h>
 #include <binder/IPCThreadState.h>
 #include <binder/ProcessState.h>
 #include <binder/IServiceManager.h>
 #include <cutils/properties.h>
+#include <media/IMediaLogService.h>
+#include <media/stagefright/foundation/ACpuAccounting.h>
 #include <utils/Log.h>
+#include <utils/Timers.h>
 #include "RegisterExtensions.h"
 
 // from LOCAL_C_INCLUDES
@@ -46,6 +50,33 @@
 
 using namespace android;
 
+// A service instantiated on its own thread at startup, because it only probes its HAL and
+// does not depend on the other services being registered.
+struct ServiceInit {
+    const char *mName;
+    void (*mInstantiate)();
+    pthread_t mThread;
+    bool mOnThread;         // mThread was created
+    nsecs_t mDurationNs;
+};
+
+static void *instantiateService(void *arg)
+{
+    ServiceInit *init = (ServiceInit *) arg;
+    const nsecs_t startNs = systemTime();
+    init->mInstantiate();
+    init->mDurationNs = systemTime() - startNs;
+    return NULL;
+}
+
+// Instantiates a service on this thread, logging how long it took.
+static void instantiateTimed(const char *name, void (*instantiate)())
+{
+    const nsecs_t startNs = systemTime();
+    instantiate();
+    ALOGI("%s instantiated in %lld ms", name, (long long) ns2ms(systemTime() - startNs));
+}
+
 int main(int argc __unused, char** argv)
 {
     limitProcessMemory(
@@ -139,18 +170,57 @@ int main(int argc __unused, char** argv)
         sp<ProcessState> proc(ProcessState::self());
         sp<IServiceManager> sm = defaultServiceManager();
         ALOGI("ServiceManager: %p", sm.get());
-        AudioFlinger::instantiate();
-        MediaPlayerService::instantiate();
-        ResourceManagerService::instantiate();
-        CameraService::instantiate();
+        // before any service starts a thread, as only threads started later are accounted
+        if (doLog && property_get_bool("media.log.cpu", false /* default_value */)) {
+            sp<IMemory> cpuAccounting = ACpuAccounting::enable();
+            sp<IMediaLogService> mediaLog = interface_cast<IMediaLogService>(
+                    sm->getService(String16("media.log")));
+            if (cpuAccounting != 0 && mediaLog != 0) {
+                mediaLog->registerCpuAccounting(cpuAccounting);
+            }
+        }
+        const nsecs_t startNs = systemTime();
+
+        // Camera, sound trigger and radio probe their HALs in parallel with the audio
+        // services, which must start in order: AudioPolicyService opens its outputs
+        // through AudioFlinger.  OMX and its vendor plugins are already only loaded on the
+        // first MediaPlayerService::getOMX() call.
+        ServiceInit parallelInits[] = {
+            { "CameraService", CameraService::instantiate, 0, false, 0 },
+            { "SoundTriggerHwService", SoundTriggerHwService::instantiate, 0, false, 0 },
+            { "RadioService", RadioService::instantiate, 0, false, 0 },
+        };
+        const size_t numParallelInits = sizeof(parallelInits) / sizeof(parallelInits[0]);
+        const bool parallel = !property_get_bool("ro.mediaserver.serial_init",
+                                                 false /* default_value */);
+        for (size_t i = 0; i < numParallelInits; i++) {
+            ServiceInit *init = &parallelInits[i];
+            init->mOnThread = parallel &&
+                    pthread_create(&init->mThread, NULL, instantiateService, init) == 0;
+            if (!init->mOnThread) {
+                instantiateService(init);
+            }
+        }
+
+        instantiateTimed("AudioFlinger", AudioFlinger::instantiate);
+        instantiateTimed("MediaPlayerService", MediaPlayerService::instantiate);
+        instantiateTimed("ResourceManagerService", ResourceManagerService::instantiate);
 #ifdef AUDIO_LISTEN_ENABLED
-        ALOGI("ListenService instantiated");
-        ListenService::instantiate();
+        instantiateTimed("ListenService", ListenService::instantiate);
 #endif
-        AudioPolicyService::instantiate();
-        SoundTriggerHwService::instantiate();
-        RadioService::instantiate();
+        instantiateTimed("AudioPolicyService", AudioPolicyService::instantiate);
+
+        for (size_t i = 0; i < numParallelInits; i++) {
+            ServiceInit *init = &parallelInits[i];
+            if (init->mOnThread) {
+                pthread_join(init->mThread, NULL);
+            }
+            ALOGI("%s instantiated in %lld ms%s", init->mName,
+                    (long long) ns2ms(init->mDurationNs),
+                    init->mOnThread ? " (in parallel)" : "");
+        }
         registerExtensions();
+        ALOGI("services instantiated in %lld ms", (long long) ns2ms(systemTime() - startNs));
         ProcessState::self()->startThreadPool();
         IPCThreadState::self()->joinThreadPool();
     }
@@ -17,13 +17,14 @@
 #ifndef _MTP_DATABASE_H
 #define _MTP_DATABASE_H
 
+#include "mtp.h"
+#include "MtpObjectInfo.h"
 #include "MtpTypes.h"
 
 namespace android {
 
 class MtpDataPacket;
 class MtpProperty;
-class MtpObjectInfo;
 
 class MtpDatabase {
 public:
@@ -84,6 +85,20 @@ public:
     virtual MtpResponseCode         getObjectInfo(MtpObjectHandle handle,
                                             MtpObjectInfo& info) = 0;
 
+    // bulk getObjectInfo, used by MtpServer to fill its object info cache.
+    // appends a new MtpObjectInfo for each handle that was found, which the caller deletes.
+    // databases that can should answer this with a single query.
+    virtual void                    getObjectInfoList(const MtpObjectHandleList& handles,
+                                            MtpObjectInfoList& infos) {
+        for (size_t i = 0; i < handles.size(); i++) {
+            MtpObjectInfo* info = new MtpObjectInfo(handles[i]);
+            if (getObjectInfo(handles[i], *info) == MTP_RESPONSE_OK)
+                infos.push(info);
+            else
+                delete info;
+        }
+    }
+
     virtual void*                   getThumbnail(MtpObjectHandle handle, size_t& outThumbSize) = 0;
 
     virtual MtpResponseCode         getObjectFilePath(MtpObjectHandle handle,
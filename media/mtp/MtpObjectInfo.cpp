@@ -55,6 +55,33 @@ MtpObjectInfo::~MtpObjectInfo() {
         free(mKeywords);
 }
 
+void MtpObjectInfo::copyFrom(const MtpObjectInfo& other) {
+    mStorageID = other.mStorageID;
+    mFormat = other.mFormat;
+    mProtectionStatus = other.mProtectionStatus;
+    mCompressedSize = other.mCompressedSize;
+    mThumbFormat = other.mThumbFormat;
+    mThumbCompressedSize = other.mThumbCompressedSize;
+    mThumbPixWidth = other.mThumbPixWidth;
+    mThumbPixHeight = other.mThumbPixHeight;
+    mImagePixWidth = other.mImagePixWidth;
+    mImagePixHeight = other.mImagePixHeight;
+    mImagePixDepth = other.mImagePixDepth;
+    mParent = other.mParent;
+    mAssociationType = other.mAssociationType;
+    mAssociationDesc = other.mAssociationDesc;
+    mSequenceNumber = other.mSequenceNumber;
+    mDateCreated = other.mDateCreated;
+    mDateModified = other.mDateModified;
+
+    if (mName)
+        free(mName);
+    mName = (other.mName ? strdup(other.mName) : NULL);
+    if (mKeywords)
+        free(mKeywords);
+    mKeywords = (other.mKeywords ? strdup(other.mKeywords) : NULL);
+}
+
 bool MtpObjectInfo::read(MtpDataPacket& packet) {
     MtpStringBuffer string;
     time_t time;
@@ -51,6 +51,8 @@ public:
     virtual             ~MtpObjectInfo();
 
     bool                read(MtpDataPacket& packet);
+    // deep copy, everything but mHandle
+    void                copyFrom(const MtpObjectInfo& other);
 
     void                print();
 };
@@ -54,7 +54,10 @@ void MtpPacket::reset() {
 
 void MtpPacket::allocate(size_t length) {
     if (length > mBufferSize) {
-        int newLength = length + mAllocationIncrement;
+        size_t newLength = length + mAllocationIncrement;
+        // grow geometrically, large object property lists are built one value at a time
+        if (newLength < mBufferSize * 2)
+            newLength = mBufferSize * 2;
         mBuffer = (uint8_t *)realloc(mBuffer, newLength);
         if (!mBuffer) {
             ALOGE("out of memory!");
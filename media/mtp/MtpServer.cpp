@@ -37,10 +37,37 @@
 #include "MtpStorage.h"
 #include "MtpStringBuffer.h"
 
+#include <linux/falloc.h>
 #include <linux/usb/f_mtp.h>
 
 namespace android {
 
+// The driver reads the file for MTP_SEND_FILE_WITH_HEADER with plain vfs reads from its
+// work queue, one USB request at a time. Tell the kernel the file is read sequentially
+// and start reading its beginning, so that USB writes are not held up by the storage.
+static const off64_t kSendReadAheadSize = 8 * 1024 * 1024;
+
+// Object infos fetched from the database at once on a cache miss, and kept at most.
+static const size_t kObjectInfoBatchSize = 256;
+static const size_t kMaxCachedObjectInfos = 8192;
+
+// Transfers smaller than this aren't worth logging a rate for.
+static const uint64_t kMinLoggedTransferSize = 1024 * 1024;
+
+static void prepareFileForSend(int fd, off64_t offset, off64_t length) {
+    posix_fadvise(fd, offset, length, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fd, offset, length < kSendReadAheadSize ? length : kSendReadAheadSize,
+            POSIX_FADV_WILLNEED);
+}
+
+// Reserve the blocks for a file of a known size before the driver writes it, so that
+// its writes don't allocate blocks one request at a time and the file isn't fragmented.
+static void prepareFileForReceive(int fd, off64_t offset, off64_t length) {
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, length) != 0) {
+        ALOGV("fallocate failed: %s", strerror(errno));
+    }
+}
+
 static const MtpOperationCode kSupportedOperationCodes[] = {
     MTP_OPERATION_GET_DEVICE_INFO,
     MTP_OPERATION_OPEN_SESSION,
@@ -110,17 +137,20 @@ MtpServer::MtpServer(int fd, MtpDatabase* database, bool ptp,
         mSessionOpen(false),
         mSendObjectHandle(kInvalidObjectHandle),
         mSendObjectFormat(0),
-        mSendObjectFileSize(0)
+        mSendObjectFileSize(0),
+        mObjectInfoGeneration(0)
 {
 }
 
 MtpServer::~MtpServer() {
+    clearObjectInfoCache();
 }
 
 void MtpServer::addStorage(MtpStorage* storage) {
     Mutex::Autolock autoLock(mMutex);
 
     mStorages.push(storage);
+    clearObjectInfoCache();
     sendStoreAdded(storage->getStorageID());
 }
 
@@ -130,6 +160,7 @@ void MtpServer::removeStorage(MtpStorage* storage) {
     for (size_t i = 0; i < mStorages.size(); i++) {
         if (mStorages[i] == storage) {
             mStorages.removeAt(i);
+            clearObjectInfoCache();
             sendStoreRemoved(storage->getStorageID());
             break;
         }
@@ -219,6 +250,9 @@ void MtpServer::run() {
         }
     }
 
+    dumpTransferStats(mSendStats, "sent");
+    dumpTransferStats(mReceiveStats, "received");
+
     // commit any open edits
     int count = mObjectEditList.size();
     for (int i = 0; i < count; i++) {
@@ -230,10 +264,30 @@ void MtpServer::run() {
 
     if (mSessionOpen)
         mDatabase->sessionEnded();
+    clearObjectInfoCache();
     close(fd);
     mFD = -1;
 }
 
+void MtpServer::updateTransferStats(TransferStats& stats, const char* direction,
+        const char* path, uint64_t bytes, nsecs_t durationNs) {
+    stats.mBytes += bytes;
+    stats.mDurationNs += durationNs;
+    stats.mTransfers++;
+    if (bytes >= kMinLoggedTransferSize && durationNs > 0) {
+        ALOGD("%s %s: %" PRIu64 " bytes in %.2f s, %.1f MB/s", direction, path, bytes,
+                durationNs * 1e-9, bytes * 1e3 / durationNs);
+    }
+}
+
+void MtpServer::dumpTransferStats(const TransferStats& stats, const char* direction) {
+    if (stats.mTransfers == 0 || stats.mDurationNs <= 0)
+        return;
+    ALOGI("%s %u objects, %" PRIu64 " bytes in %.2f s, %.1f MB/s", direction,
+            stats.mTransfers, stats.mBytes, stats.mDurationNs * 1e-9,
+            stats.mBytes * 1e3 / stats.mDurationNs);
+}
+
 void MtpServer::sendObjectAdded(MtpObjectHandle handle) {
     ALOGV("sendObjectAdded %d\n", handle);
     sendEvent(MTP_EVENT_OBJECT_ADDED, handle);
@@ -241,14 +295,160 @@ void MtpServer::sendObjectAdded(MtpObjectHandle handle) {
 
 void MtpServer::sendObjectRemoved(MtpObjectHandle handle) {
     ALOGV("sendObjectRemoved %d\n", handle);
+    invalidateObjectInfo(handle);
     sendEvent(MTP_EVENT_OBJECT_REMOVED, handle);
 }
 
 void MtpServer::sendObjectUpdated(MtpObjectHandle handle) {
     ALOGV("sendObjectUpdated %d\n", handle);
+    invalidateObjectInfo(handle);
     sendEvent(MTP_EVENT_OBJECT_PROP_CHANGED, handle);
 }
 
+MtpResponseCode MtpServer::getObjectInfo(MtpObjectHandle handle, MtpObjectInfo& info) {
+    for (int pass = 0; pass < 2; pass++) {
+        {
+            Mutex::Autolock autoLock(mObjectInfoLock);
+            ssize_t index = mObjectInfoCache.indexOfKey(handle);
+            if (index >= 0) {
+                info.copyFrom(*mObjectInfoCache.valueAt(index));
+                return MTP_RESPONSE_OK;
+            }
+        }
+        if (pass == 0)
+            fillObjectInfoCache(handle);
+    }
+
+    // not a listed object, or it changed while the cache was being filled
+    uint32_t generation;
+    {
+        Mutex::Autolock autoLock(mObjectInfoLock);
+        generation = mObjectInfoGeneration;
+    }
+    MtpResponseCode result = mDatabase->getObjectInfo(handle, info);
+    if (result == MTP_RESPONSE_OK) {
+        Mutex::Autolock autoLock(mObjectInfoLock);
+        if (generation == mObjectInfoGeneration && mObjectInfoCache.indexOfKey(handle) < 0) {
+            MtpObjectInfo* cached = new MtpObjectInfo(handle);
+            cached->copyFrom(info);
+            cacheObjectInfo_l(cached);
+        }
+    }
+    return result;
+}
+
+void MtpServer::fillObjectInfoCache(MtpObjectHandle handle) {
+    // clients usually walk the list they got from GetObjectHandles in order,
+    // so fetch the objects following this one with the same query
+    size_t start = 0;
+    while (start < mLastObjectHandles.size() && mLastObjectHandles[start] != handle)
+        start++;
+    if (start == mLastObjectHandles.size())
+        return;
+
+    MtpObjectHandleList handles;
+    uint32_t generation;
+    {
+        Mutex::Autolock autoLock(mObjectInfoLock);
+        generation = mObjectInfoGeneration;
+        for (size_t i = start; i < mLastObjectHandles.size()
+                && handles.size() < kObjectInfoBatchSize; i++) {
+            if (mObjectInfoCache.indexOfKey(mLastObjectHandles[i]) < 0)
+                handles.push(mLastObjectHandles[i]);
+        }
+    }
+
+    MtpObjectInfoList infos;
+    mDatabase->getObjectInfoList(handles, infos);
+
+    Mutex::Autolock autoLock(mObjectInfoLock);
+    for (size_t i = 0; i < infos.size(); i++) {
+        MtpObjectInfo* info = infos[i];
+        if (generation == mObjectInfoGeneration && mObjectInfoCache.indexOfKey(info->mHandle) < 0)
+            cacheObjectInfo_l(info);
+        else
+            delete info;
+    }
+}
+
+void MtpServer::cacheObjectInfo_l(MtpObjectInfo* info) {
+    if (mObjectInfoCache.size() >= kMaxCachedObjectInfos)
+        clearObjectInfoCache_l();
+    mObjectInfoCache.add(info->mHandle, info);
+}
+
+void MtpServer::invalidateObjectInfo(MtpObjectHandle handle) {
+    Mutex::Autolock autoLock(mObjectInfoLock);
+    ssize_t index = mObjectInfoCache.indexOfKey(handle);
+    if (index >= 0) {
+        delete mObjectInfoCache.valueAt(index);
+        mObjectInfoCache.removeItemsAt(index);
+    }
+    mObjectInfoGeneration++;
+}
+
+void MtpServer::clearObjectInfoCache() {
+    Mutex::Autolock autoLock(mObjectInfoLock);
+    clearObjectInfoCache_l();
+    mObjectInfoGeneration++;
+}
+
+void MtpServer::clearObjectInfoCache_l() {
+    for (size_t i = 0; i < mObjectInfoCache.size(); i++)
+        delete mObjectInfoCache.valueAt(i);
+    mObjectInfoCache.clear();
+}
+
+// The object properties that are answered from the object info.
+static bool getObjectInfoPropertyType(MtpObjectProperty property, MtpDataType& type) {
+    switch (property) {
+        case MTP_PROPERTY_STORAGE_ID:
+        case MTP_PROPERTY_PARENT_OBJECT:
+            type = MTP_TYPE_UINT32;
+            return true;
+        case MTP_PROPERTY_OBJECT_FORMAT:
+        case MTP_PROPERTY_PROTECTION_STATUS:
+            type = MTP_TYPE_UINT16;
+            return true;
+        case MTP_PROPERTY_OBJECT_FILE_NAME:
+        case MTP_PROPERTY_DATE_MODIFIED:
+            type = MTP_TYPE_STR;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void putObjectInfoProperty(const MtpObjectInfo& info, MtpObjectProperty property,
+        MtpDataPacket& packet) {
+    switch (property) {
+        case MTP_PROPERTY_STORAGE_ID:
+            packet.putUInt32(info.mStorageID);
+            break;
+        case MTP_PROPERTY_PARENT_OBJECT:
+            packet.putUInt32(info.mParent);
+            break;
+        case MTP_PROPERTY_OBJECT_FORMAT:
+            packet.putUInt16(info.mFormat);
+            break;
+        case MTP_PROPERTY_PROTECTION_STATUS:
+            packet.putUInt16(info.mProtectionStatus);
+            break;
+        case MTP_PROPERTY_OBJECT_FILE_NAME:
+            if (info.mName)
+                packet.putString(info.mName);
+            else
+                packet.putEmptyString();
+            break;
+        case MTP_PROPERTY_DATE_MODIFIED: {
+            char date[20];
+            formatDateTime(info.mDateModified, date, sizeof(date));
+            packet.putString(date);
+            break;
+        }
+    }
+}
+
 MtpStorage* MtpServer::getStorageLocked(MtpStorageID id) {
     if (id == 0)
         return mStorages.empty() ? NULL : mStorages[0];
@@ -321,6 +521,7 @@ void MtpServer::removeEditObject(MtpObjectHandle handle) {
 
 void MtpServer::commitEdit(ObjectEdit* edit) {
     mDatabase->endSendObject((const char *)edit->mPath, edit->mHandle, edit->mFormat, true);
+    invalidateObjectInfo(edit->mHandle);
 }
 
 
@@ -513,6 +714,7 @@ MtpResponseCode MtpServer::doOpenSession() {
 
     mSessionID = mRequest.getParameter(1);
     mSessionOpen = true;
+    clearObjectInfoCache();
 
     mDatabase->sessionStarted();
 
@@ -524,6 +726,8 @@ MtpResponseCode MtpServer::doCloseSession() {
         return MTP_RESPONSE_SESSION_NOT_OPEN;
     mSessionID = 0;
     mSessionOpen = false;
+    clearObjectInfoCache();
+    mLastObjectHandles.clear();
     mDatabase->sessionEnded();
     return MTP_RESPONSE_OK;
 }
@@ -593,6 +797,10 @@ MtpResponseCode MtpServer::doGetObjectHandles() {
 
     MtpObjectHandleList* handles = mDatabase->getObjectList(storageID, format, parent);
     mData.putAUInt32(handles);
+    if (handles)
+        mLastObjectHandles = *handles;
+    else
+        mLastObjectHandles.clear();
     delete handles;
     return MTP_RESPONSE_OK;
 }
@@ -666,6 +874,15 @@ MtpResponseCode MtpServer::doGetObjectPropValue() {
     ALOGV("GetObjectPropValue %d %s\n", handle,
             MtpDebug::getObjectPropCodeName(property));
 
+    MtpDataType type;
+    if (getObjectInfoPropertyType(property, type)) {
+        MtpObjectInfo info(handle);
+        if (getObjectInfo(handle, info) == MTP_RESPONSE_OK) {
+            putObjectInfoProperty(info, property, mData);
+            return MTP_RESPONSE_OK;
+        }
+    }
+
     return mDatabase->getObjectPropertyValue(handle, property, mData);
 }
 
@@ -679,7 +896,9 @@ MtpResponseCode MtpServer::doSetObjectPropValue() {
     ALOGV("SetObjectPropValue %d %s\n", handle,
             MtpDebug::getObjectPropCodeName(property));
 
-    return mDatabase->setObjectPropertyValue(handle, property, mData);
+    MtpResponseCode result = mDatabase->setObjectPropertyValue(handle, property, mData);
+    invalidateObjectInfo(handle);
+    return result;
 }
 
 MtpResponseCode MtpServer::doGetDevicePropValue() {
@@ -728,6 +947,21 @@ MtpResponseCode MtpServer::doGetObjectPropList() {
             handle, MtpDebug::getFormatCodeName(format),
             MtpDebug::getObjectPropCodeName(property), groupCode, depth);
 
+    // a single property of a single object, as clients ask while browsing a folder
+    MtpDataType type;
+    if (depth == 0 && groupCode == 0 && format == 0 && handle != 0 && handle != 0xFFFFFFFF
+            && getObjectInfoPropertyType(property, type)) {
+        MtpObjectInfo info(handle);
+        if (getObjectInfo(handle, info) == MTP_RESPONSE_OK) {
+            mData.putUInt32(1);
+            mData.putUInt32(handle);
+            mData.putUInt16(property);
+            mData.putUInt16(type);
+            putObjectInfoProperty(info, property, mData);
+            return MTP_RESPONSE_OK;
+        }
+    }
+
     return mDatabase->getObjectPropertyList(handle, format, property, groupCode, depth, mData);
 }
 
@@ -738,7 +972,7 @@ MtpResponseCode MtpServer::doGetObjectInfo() {
         return MTP_RESPONSE_INVALID_PARAMETER;
     MtpObjectHandle handle = mRequest.getParameter(1);
     MtpObjectInfo info(handle);
-    MtpResponseCode result = mDatabase->getObjectInfo(handle, info);
+    MtpResponseCode result = getObjectInfo(handle, info);
     if (result == MTP_RESPONSE_OK) {
         char    date[20];
 
@@ -797,8 +1031,10 @@ MtpResponseCode MtpServer::doGetObject() {
     mfr.length = fileLength;
     mfr.command = mRequest.getOperationCode();
     mfr.transaction_id = mRequest.getTransactionID();
+    prepareFileForSend(mfr.fd, mfr.offset, mfr.length);
 
     // then transfer the file
+    nsecs_t start = systemTime();
     int ret = ioctl(mFD, MTP_SEND_FILE_WITH_HEADER, (unsigned long)&mfr);
     if (ret < 0) {
         if (errno == ECANCELED) {
@@ -808,6 +1044,7 @@ MtpResponseCode MtpServer::doGetObject() {
         }
     } else {
         result = MTP_RESPONSE_OK;
+        updateTransferStats(mSendStats, "sent", filePath, fileLength, systemTime() - start);
     }
 
     ALOGV("MTP_SEND_FILE_WITH_HEADER returned %d\n", ret);
@@ -877,8 +1114,10 @@ MtpResponseCode MtpServer::doGetPartialObject(MtpOperationCode operation) {
     mfr.command = mRequest.getOperationCode();
     mfr.transaction_id = mRequest.getTransactionID();
     mResponse.setParameter(1, length);
+    prepareFileForSend(mfr.fd, mfr.offset, mfr.length);
 
     // transfer the file
+    nsecs_t start = systemTime();
     int ret = ioctl(mFD, MTP_SEND_FILE_WITH_HEADER, (unsigned long)&mfr);
     ALOGV("MTP_SEND_FILE_WITH_HEADER returned %d\n", ret);
     result = MTP_RESPONSE_OK;
@@ -887,6 +1126,8 @@ MtpResponseCode MtpServer::doGetPartialObject(MtpOperationCode operation) {
             result = MTP_RESPONSE_TRANSACTION_CANCELLED;
         else
             result = MTP_RESPONSE_GENERAL_ERROR;
+    } else {
+        updateTransferStats(mSendStats, "sent", filePath, length, systemTime() - start);
     }
     close(mfr.fd);
     return result;
@@ -1004,6 +1245,7 @@ MtpResponseCode MtpServer::doSendObject() {
     mode_t mask;
     int ret, initialData;
     bool isCanceled = false;
+    nsecs_t start = systemTime();
 
     if (mSendObjectHandle == kInvalidObjectHandle) {
         ALOGE("Expected SendObjectInfo before SendObject");
@@ -1031,6 +1273,10 @@ MtpResponseCode MtpServer::doSendObject() {
     fchmod(mfr.fd, mFilePermission);
     umask(mask);
 
+    if (mSendObjectFileSize > 0 && mSendObjectFileSize != 0xFFFFFFFF) {
+        prepareFileForReceive(mfr.fd, 0, mSendObjectFileSize);
+    }
+
     if (initialData > 0) {
         ret = write(mfr.fd, mData.getData(), initialData);
     }
@@ -1058,6 +1304,13 @@ MtpResponseCode MtpServer::doSendObject() {
             ALOGV("MTP_RECEIVE_FILE returned %d\n", ret);
         }
     }
+    if (ret >= 0) {
+        struct stat sstat;
+        if (fstat(mfr.fd, &sstat) == 0) {
+            updateTransferStats(mReceiveStats, "received", mSendObjectFilePath,
+                    sstat.st_size, systemTime() - start);
+        }
+    }
     close(mfr.fd);
 
     if (ret < 0) {
@@ -1071,6 +1324,7 @@ MtpResponseCode MtpServer::doSendObject() {
 done:
     // reset so we don't attempt to send the data back
     mData.reset();
+    invalidateObjectInfo(mSendObjectHandle);
 
     mDatabase->endSendObject(mSendObjectFilePath, mSendObjectHandle, mSendObjectFormat,
             result == MTP_RESPONSE_OK);
@@ -1155,6 +1409,8 @@ MtpResponseCode MtpServer::doDeleteObject() {
     if (result == MTP_RESPONSE_OK) {
         ALOGV("deleting %s", (const char *)filePath);
         result = mDatabase->deleteFile(handle);
+        // a folder takes its children with it
+        clearObjectInfoCache();
         // Don't delete the actual files unless the database deletion is allowed
         if (result == MTP_RESPONSE_OK) {
             deletePath((const char *)filePath);
@@ -1220,10 +1476,16 @@ MtpResponseCode MtpServer::doSendPartialObject() {
     ALOGV("receiving partial %s %" PRIu64 " %" PRIu32, filePath, offset, length);
 
     // read the header, and possibly some data
+    nsecs_t start = systemTime();
     int ret = mData.read(mFD);
     if (ret < MTP_CONTAINER_HEADER_SIZE)
         return MTP_RESPONSE_GENERAL_ERROR;
     int initialData = ret - MTP_CONTAINER_HEADER_SIZE;
+    const uint32_t totalLength = length;
+
+    if (offset + length > edit->mSize) {
+        prepareFileForReceive(edit->mFD, offset, length);
+    }
 
     if (initialData > 0) {
         ret = pwrite(edit->mFD, mData.getData(), initialData, offset);
@@ -1257,6 +1519,9 @@ MtpResponseCode MtpServer::doSendPartialObject() {
             return MTP_RESPONSE_GENERAL_ERROR;
     }
 
+    updateTransferStats(mReceiveStats, "received", filePath, totalLength,
+            systemTime() - start);
+
     // reset so we don't attempt to send this back
     mData.reset();
     mResponse.setParameter(1, length);
@@ -24,6 +24,7 @@
 #include "mtp.h"
 #include "MtpUtils.h"
 
+#include <utils/KeyedVector.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -89,6 +90,28 @@ private:
     };
     Vector<ObjectEdit*>  mObjectEditList;
 
+    // object data moved by the driver in one direction, for the transfer rate log
+    struct TransferStats {
+        uint64_t            mBytes;
+        nsecs_t             mDurationNs;
+        uint32_t            mTransfers;
+
+        TransferStats() : mBytes(0), mDurationNs(0), mTransfers(0) {}
+    };
+    TransferStats       mSendStats;         // device to host
+    TransferStats       mReceiveStats;      // host to device
+
+    // Object info of recently listed objects, so that clients that walk a folder with
+    // GetObjectInfo or GetObjectPropValue don't cost a database query per object.
+    // Guarded by mObjectInfoLock rather than mMutex, because the database reports
+    // changes through sendObject*() while a request is being handled.
+    Mutex               mObjectInfoLock;
+    KeyedVector<MtpObjectHandle, MtpObjectInfo*> mObjectInfoCache;
+    // bumped by every invalidation, so that a fill racing with one is dropped
+    uint32_t            mObjectInfoGeneration;
+    // result of the last GetObjectHandles, cache misses are filled in batches from it
+    MtpObjectHandleList mLastObjectHandles;
+
 public:
                         MtpServer(int fd, MtpDatabase* database, bool ptp,
                                     int fileGroup, int filePerm, int directoryPerm);
@@ -122,6 +145,17 @@ private:
 
     bool                handleRequest();
 
+    MtpResponseCode     getObjectInfo(MtpObjectHandle handle, MtpObjectInfo& info);
+    void                fillObjectInfoCache(MtpObjectHandle handle);
+    void                cacheObjectInfo_l(MtpObjectInfo* info);
+    void                invalidateObjectInfo(MtpObjectHandle handle);
+    void                clearObjectInfoCache();
+    void                clearObjectInfoCache_l();
+
+    void                updateTransferStats(TransferStats& stats, const char* direction,
+                                const char* path, uint64_t bytes, nsecs_t durationNs);
+    void                dumpTransferStats(const TransferStats& stats, const char* direction);
+
     MtpResponseCode     doGetDeviceInfo();
     MtpResponseCode     doOpenSession();
     MtpResponseCode     doCloseSession();
@@ -50,10 +50,12 @@ typedef uint32_t MtpObjectHandle;
 class MtpStorage;
 class MtpDevice;
 class MtpProperty;
+class MtpObjectInfo;
 
 typedef Vector<MtpStorage *> MtpStorageList;
 typedef Vector<MtpDevice*> MtpDeviceList;
 typedef Vector<MtpProperty*> MtpPropertyList;
+typedef Vector<MtpObjectInfo*> MtpObjectInfoList;
 
 typedef Vector<uint8_t> UInt8List;
 typedef Vector<uint16_t> UInt16List;
@@ -25,12 +25,17 @@
 #include "NdkMediaFormatPriv.h"
 
 #include <utils/Log.h>
+#include <utils/Mutex.h>
 #include <utils/StrongPointer.h>
 #include <gui/Surface.h>
 
+#include <media/hardware/HardwareAPI.h>
+
+#include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AString.h>
 
 #include <media/stagefright/MediaCodec.h>
 #include <media/stagefright/MediaErrors.h>
@@ -52,6 +57,7 @@ enum {
     kWhatActivityNotify,
     kWhatRequestActivityNotifications,
     kWhatStopActivityNotifications,
+    kWhatAsyncNotify,
 };
 
 
@@ -74,6 +80,12 @@ struct AMediaCodec {
     bool mRequestedActivityNotification;
     OnCodecEvent mCallback;
     void *mCallbackUserData;
+
+    sp<AMessage> mAsyncNotify;
+    bool mAsync;    // buffers are only accessible by index
+    mutable Mutex mAsyncCallbackLock;
+    AMediaCodecOnAsyncNotifyCallback mAsyncCallback;
+    void *mAsyncCallbackUserData;
 };
 
 CodecHandler::CodecHandler(AMediaCodec *codec) {
@@ -114,6 +126,92 @@ void CodecHandler::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatAsyncNotify:
+        {
+            int32_t cbID;
+            if (!msg->findInt32("callbackID", &cbID)) {
+                ALOGE("kWhatAsyncNotify: callbackID is expected.");
+                break;
+            }
+
+            // do not hold the lock across the callback, which may set another one
+            AMediaCodecOnAsyncNotifyCallback callback;
+            void *userdata;
+            {
+                Mutex::Autolock _l(mCodec->mAsyncCallbackLock);
+                callback = mCodec->mAsyncCallback;
+                userdata = mCodec->mAsyncCallbackUserData;
+            }
+
+            switch (cbID) {
+                case MediaCodec::CB_INPUT_AVAILABLE:
+                {
+                    int32_t index;
+                    CHECK(msg->findInt32("index", &index));
+                    if (callback.onAsyncInputAvailable != NULL) {
+                        callback.onAsyncInputAvailable(mCodec, userdata, index);
+                    }
+                    break;
+                }
+
+                case MediaCodec::CB_OUTPUT_AVAILABLE:
+                {
+                    int32_t index;
+                    size_t offset;
+                    size_t size;
+                    int64_t timeUs;
+                    int32_t flags;
+                    CHECK(msg->findInt32("index", &index));
+                    CHECK(msg->findSize("offset", &offset));
+                    CHECK(msg->findSize("size", &size));
+                    CHECK(msg->findInt64("timeUs", &timeUs));
+                    CHECK(msg->findInt32("flags", &flags));
+
+                    AMediaCodecBufferInfo bufferInfo = {
+                        (int32_t)offset,
+                        (int32_t)size,
+                        timeUs,
+                        (uint32_t)flags};
+                    if (callback.onAsyncOutputAvailable != NULL) {
+                        callback.onAsyncOutputAvailable(mCodec, userdata, index, &bufferInfo);
+                    }
+                    break;
+                }
+
+                case MediaCodec::CB_OUTPUT_FORMAT_CHANGED:
+                {
+                    sp<AMessage> format;
+                    CHECK(msg->findMessage("format", &format));
+                    if (callback.onAsyncFormatChanged != NULL) {
+                        AMediaFormat *aMediaFormat = AMediaFormat_fromMsg(&format);
+                        callback.onAsyncFormatChanged(mCodec, userdata, aMediaFormat);
+                        AMediaFormat_delete(aMediaFormat);
+                    }
+                    break;
+                }
+
+                case MediaCodec::CB_ERROR:
+                {
+                    status_t err;
+                    int32_t actionCode;
+                    AString detail;
+                    CHECK(msg->findInt32("err", &err));
+                    CHECK(msg->findInt32("actionCode", &actionCode));
+                    bool haveDetail = msg->findString("detail", &detail);
+                    if (callback.onAsyncError != NULL) {
+                        callback.onAsyncError(mCodec, userdata, translate_error(err),
+                                actionCode, haveDetail ? detail.c_str() : NULL);
+                    }
+                    break;
+                }
+
+                default:
+                    ALOGE("kWhatAsyncNotify: callbackID(%d) is unexpected.", cbID);
+                    break;
+            }
+            break;
+        }
+
         case kWhatStopActivityNotifications:
         {
             sp<AReplyToken> replyID;
@@ -164,6 +262,10 @@ static AMediaCodec * createAMediaCodec(const char *name, bool name_is_type, bool
     mData->mRequestedActivityNotification = false;
     mData->mCallback = NULL;
 
+    mData->mAsync = false;
+    memset(&mData->mAsyncCallback, 0, sizeof(mData->mAsyncCallback));
+    mData->mAsyncCallbackUserData = NULL;
+
     return mData;
 }
 
@@ -263,6 +365,18 @@ ssize_t AMediaCodec_dequeueInputBuffer(AMediaCodec *mData, int64_t timeoutUs) {
 
 EXPORT
 uint8_t* AMediaCodec_getInputBuffer(AMediaCodec *mData, size_t idx, size_t *out_size) {
+    if (mData->mAsync) {
+        sp<ABuffer> abuf;
+        if (mData->mCodec->getInputBuffer(idx, &abuf) != OK || abuf == NULL) {
+            ALOGE("input buffer %zu is not available", idx);
+            return NULL;
+        }
+        if (out_size != NULL) {
+            *out_size = abuf->capacity();
+        }
+        return abuf->data();
+    }
+
     android::Vector<android::sp<android::ABuffer> > abufs;
     if (mData->mCodec->getInputBuffers(&abufs) == 0) {
         size_t n = abufs.size();
@@ -281,6 +395,18 @@ uint8_t* AMediaCodec_getInputBuffer(AMediaCodec *mData, size_t idx, size_t *out_
 
 EXPORT
 uint8_t* AMediaCodec_getOutputBuffer(AMediaCodec *mData, size_t idx, size_t *out_size) {
+    if (mData->mAsync) {
+        sp<ABuffer> abuf;
+        if (mData->mCodec->getOutputBuffer(idx, &abuf) != OK || abuf == NULL) {
+            ALOGE("output buffer %zu is not available", idx);
+            return NULL;
+        }
+        if (out_size != NULL) {
+            *out_size = abuf->capacity();
+        }
+        return abuf->data();
+    }
+
     android::Vector<android::sp<android::ABuffer> > abufs;
     if (mData->mCodec->getOutputBuffers(&abufs) == 0) {
         size_t n = abufs.size();
@@ -359,6 +485,102 @@ media_status_t AMediaCodec_releaseOutputBufferAtTime(
     return translate_error(mData->mCodec->renderOutputBufferAndRelease(idx, timestampNs));
 }
 
+EXPORT
+media_status_t AMediaCodec_getOutputImage(AMediaCodec *mData, size_t idx,
+        AMediaCodecImage *image) {
+    if (image == NULL) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    sp<ABuffer> abuf;
+    if (mData->mCodec->getOutputBuffer(idx, &abuf) != OK || abuf == NULL) {
+        ALOGE("output buffer %zu is not available", idx);
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+
+    // set by MediaCodec from the flexible YUV description of ACodec
+    sp<ABuffer> imageData;
+    if (!abuf->meta()->findBuffer("image-data", &imageData)
+            || imageData->size() < sizeof(MediaImage)) {
+        return AMEDIA_ERROR_UNSUPPORTED;
+    }
+    const MediaImage &mediaImage = *(const MediaImage *)imageData->data();
+    if (mediaImage.mType != MediaImage::MEDIA_IMAGE_TYPE_YUV
+            || mediaImage.mNumPlanes != 3 || mediaImage.mBitDepth != 8) {
+        return AMEDIA_ERROR_UNSUPPORTED;
+    }
+
+    const int32_t frameWidth = mediaImage.mWidth;
+    const int32_t frameHeight = mediaImage.mHeight;
+    int32_t left, top, right, bottom;
+    if (!abuf->meta()->findRect("crop-rect", &left, &top, &right, &bottom)
+            || left < 0 || top < 0 || right < left || bottom < top
+            || right >= frameWidth || bottom >= frameHeight) {
+        left = 0;
+        top = 0;
+        right = frameWidth - 1;
+        bottom = frameHeight - 1;
+    }
+
+    // the offsets are relative to the start of the valid data
+    const size_t available = abuf->capacity() - abuf->offset();
+    for (uint32_t i = 0; i < 3; i++) {
+        const MediaImage::PlaneInfo &plane = mediaImage.mPlane[i];
+        const uint32_t subsampling = i == MediaImage::Y ? 1 : 2;
+        if (plane.mHorizSubsampling != subsampling || plane.mVertSubsampling != subsampling
+                || plane.mColInc == 0 || plane.mRowInc == 0) {
+            return AMEDIA_ERROR_UNSUPPORTED;
+        }
+        // the last sample of the plane must be within the buffer
+        const uint64_t cols = (frameWidth + subsampling - 1) / subsampling;
+        const uint64_t rows = (frameHeight + subsampling - 1) / subsampling;
+        const uint64_t last = plane.mOffset
+                + (rows - 1) * plane.mRowInc + (cols - 1) * plane.mColInc;
+        if (last >= available) {
+            ALOGE("plane %u of buffer %zu ends at %" PRIu64 ", past %zu",
+                    i, idx, last, available);
+            return AMEDIA_ERROR_MALFORMED;
+        }
+
+        AMediaCodecImagePlane *out = &image->planes[i];
+        out->data = abuf->data() + plane.mOffset
+                + (top / subsampling) * plane.mRowInc + (left / subsampling) * plane.mColInc;
+        out->rowStride = plane.mRowInc;
+        out->pixelStride = plane.mColInc;
+    }
+
+    image->format = AMEDIACODEC_IMAGE_FORMAT_YUV_420_888;
+    image->width = right - left + 1;
+    image->height = bottom - top + 1;
+    image->cropLeft = left;
+    image->cropTop = top;
+    image->numPlanes = 3;
+    return AMEDIA_OK;
+}
+
+EXPORT
+media_status_t AMediaCodec_setAsyncNotifyCallback(
+        AMediaCodec *mData,
+        AMediaCodecOnAsyncNotifyCallback callback,
+        void *userdata) {
+    if (mData->mAsyncNotify == NULL) {
+        mData->mAsyncNotify = new AMessage(kWhatAsyncNotify, mData->mHandler);
+    }
+
+    {
+        Mutex::Autolock _l(mData->mAsyncCallbackLock);
+        mData->mAsyncCallback = callback;
+        mData->mAsyncCallbackUserData = userdata;
+    }
+
+    status_t err = mData->mCodec->setCallback(mData->mAsyncNotify);
+    if (err != OK) {
+        ALOGE("setAsyncNotifyCallback: err(%d), failed to set async callback", err);
+        return translate_error(err);
+    }
+    mData->mAsync = true;
+    return AMEDIA_OK;
+}
+
 //EXPORT
 media_status_t AMediaCodec_setNotificationCallback(AMediaCodec *mData, OnCodecEvent callback,
         void *userdata) {
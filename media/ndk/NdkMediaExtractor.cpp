@@ -23,11 +23,16 @@
 #include "NdkMediaFormatPriv.h"
 
 
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
 #include <utils/Log.h>
 #include <utils/StrongPointer.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
 #include <media/hardware/CryptoAPI.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/NuMediaExtractor.h>
 #include <media/IMediaHTTPService.h>
@@ -46,10 +51,184 @@ static media_status_t translate_error(status_t err) {
     return AMEDIA_ERROR_UNKNOWN;
 }
 
+static android::MediaSource::ReadOptions::SeekMode translate_seek_mode(SeekMode mode) {
+    if (mode == AMEDIAEXTRACTOR_SEEK_PREVIOUS_SYNC) {
+        return android::MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC;
+    } else if (mode == AMEDIAEXTRACTOR_SEEK_CLOSEST_SYNC) {
+        return android::MediaSource::ReadOptions::SEEK_CLOSEST_SYNC;
+    }
+    return android::MediaSource::ReadOptions::SEEK_NEXT_SYNC;
+}
+
+// Reads one batch of samples of a track, returns the number of samples, 0 at
+// end of stream, or a media_status_t.
+static ssize_t readTrackSamples(const sp<NuMediaExtractor> &impl, size_t trackIdx,
+        uint8_t *buffer, size_t capacity, AMediaExtractorSampleInfo *info, size_t maxSamples) {
+    Vector<NuMediaExtractor::SampleInfo> infos;
+    infos.resize(maxSamples);
+
+    size_t numSamples;
+    status_t err = impl->readTrackSamples(
+            trackIdx, buffer, capacity, infos.editArray(), maxSamples, &numSamples);
+    if (err == ERROR_END_OF_STREAM) {
+        return 0;
+    } else if (err == -ENOMEM || err == -EINVAL) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    } else if (err != OK) {
+        return translate_error(err);
+    }
+
+    for (size_t i = 0; i < numSamples; ++i) {
+        info[i].offset = infos[i].mOffset;
+        info[i].size = infos[i].mSize;
+        info[i].presentationTimeUs = infos[i].mTimeUs;
+        info[i].flags = infos[i].mFlags;
+    }
+    return numSamples;
+}
+
+namespace {
+
+struct TrackReadRequest {
+    uint8_t *mBuffer;
+    size_t mCapacity;
+    AMediaExtractorSampleInfo *mInfo;
+    size_t mMaxSamples;
+    ssize_t mResult;
+};
+
+// The buffers queued on one track. At most one pool thread serves a queue at
+// any time, which keeps the buffers of a track in order while different tracks
+// and extractors are read in parallel.
+struct TrackReadQueue : public RefBase {
+    TrackReadQueue(const sp<NuMediaExtractor> &impl, size_t trackIdx)
+        : mImpl(impl),
+          mTrackIdx(trackIdx),
+          mScheduled(false),
+          mCancelled(false) {
+    }
+
+    const sp<NuMediaExtractor> mImpl;
+    const size_t mTrackIdx;
+
+    Mutex mLock;
+    Condition mCondition;
+    List<TrackReadRequest> mQueued;     // the front one is being filled if mScheduled
+    List<TrackReadRequest> mFilled;
+    bool mScheduled;                    // pending on, or served by, the pool
+    bool mCancelled;                    // the extractor is being deleted
+};
+
+class TrackReadPool {
+public:
+    static void schedule(const sp<TrackReadQueue> &queue);
+
+private:
+    static const size_t kNumThreads = 4;
+
+    struct ReadThread : public Thread {
+        ReadThread() : Thread(false /* canCallJava */) {}
+        virtual bool threadLoop();
+    };
+
+    static Mutex sLock;
+    static Condition sCondition;
+    static List<sp<TrackReadQueue> > sPending;
+    static Vector<sp<Thread> > sThreads;
+    static size_t sNumIdle;
+};
+
+Mutex TrackReadPool::sLock;
+Condition TrackReadPool::sCondition;
+List<sp<TrackReadQueue> > TrackReadPool::sPending;
+Vector<sp<Thread> > TrackReadPool::sThreads;
+size_t TrackReadPool::sNumIdle = 0;
+
+// static
+void TrackReadPool::schedule(const sp<TrackReadQueue> &queue) {
+    Mutex::Autolock autoLock(sLock);
+
+    // The threads are started on first use and then live as long as the process.
+    if (sNumIdle <= sPending.size() && sThreads.size() < kNumThreads) {
+        sp<Thread> thread = new ReadThread;
+        if (thread->run("NdkExtractorRead") == OK) {
+            sThreads.push(thread);
+        }
+    }
+
+    sPending.push_back(queue);
+    sCondition.signal();
+}
+
+bool TrackReadPool::ReadThread::threadLoop() {
+    sp<TrackReadQueue> queue;
+    {
+        Mutex::Autolock autoLock(sLock);
+        while (sPending.empty()) {
+            ++sNumIdle;
+            sCondition.wait(sLock);
+            --sNumIdle;
+        }
+        queue = *sPending.begin();
+        sPending.erase(sPending.begin());
+    }
+
+    TrackReadRequest request;
+    bool cancelled;
+    {
+        Mutex::Autolock autoLock(queue->mLock);
+        request = *queue->mQueued.begin();
+        cancelled = queue->mCancelled;
+    }
+
+    // The queue lock is not held while reading, so that the filled buffers
+    // can be dequeued meanwhile.
+    if (cancelled) {
+        request.mResult = AMEDIA_ERROR_INVALID_OBJECT;
+    } else {
+        request.mResult = readTrackSamples(queue->mImpl, queue->mTrackIdx,
+                request.mBuffer, request.mCapacity, request.mInfo, request.mMaxSamples);
+    }
+
+    bool more;
+    {
+        Mutex::Autolock autoLock(queue->mLock);
+        queue->mQueued.erase(queue->mQueued.begin());
+        queue->mFilled.push_back(request);
+        more = !queue->mQueued.empty();
+        queue->mScheduled = more;
+        queue->mCondition.broadcast();
+    }
+
+    if (more) {
+        schedule(queue);
+    }
+
+    return true;
+}
+
+}  // anonymous namespace
+
 struct AMediaExtractor {
     sp<NuMediaExtractor> mImpl;
     sp<ABuffer> mPsshBuf;
 
+    Mutex mReadQueuesLock;
+    KeyedVector<size_t, sp<TrackReadQueue> > mReadQueues;   // by track index
+
+    sp<TrackReadQueue> getReadQueue(size_t trackIdx, bool create) {
+        Mutex::Autolock autoLock(mReadQueuesLock);
+        ssize_t index = mReadQueues.indexOfKey(trackIdx);
+        if (index >= 0) {
+            return mReadQueues.valueAt(index);
+        }
+        if (!create) {
+            return NULL;
+        }
+        sp<TrackReadQueue> queue = new TrackReadQueue(mImpl, trackIdx);
+        mReadQueues.add(trackIdx, queue);
+        return queue;
+    }
 };
 
 extern "C" {
@@ -65,6 +244,15 @@ AMediaExtractor* AMediaExtractor_new() {
 EXPORT
 media_status_t AMediaExtractor_delete(AMediaExtractor *mData) {
     ALOGV("dtor");
+    // The pool threads must be done with the caller's buffers before returning.
+    for (size_t i = 0; i < mData->mReadQueues.size(); ++i) {
+        const sp<TrackReadQueue> &queue = mData->mReadQueues.valueAt(i);
+        Mutex::Autolock autoLock(queue->mLock);
+        queue->mCancelled = true;
+        while (queue->mScheduled) {
+            queue->mCondition.wait(queue->mLock);
+        }
+    }
     delete mData;
     return AMEDIA_OK;
 }
@@ -152,16 +340,7 @@ bool AMediaExtractor_advance(AMediaExtractor *mData) {
 
 EXPORT
 media_status_t AMediaExtractor_seekTo(AMediaExtractor *ex, int64_t seekPosUs, SeekMode mode) {
-    android::MediaSource::ReadOptions::SeekMode sfmode;
-    if (mode == AMEDIAEXTRACTOR_SEEK_PREVIOUS_SYNC) {
-        sfmode = android::MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC;
-    } else if (mode == AMEDIAEXTRACTOR_SEEK_CLOSEST_SYNC) {
-        sfmode = android::MediaSource::ReadOptions::SEEK_CLOSEST_SYNC;
-    } else {
-        sfmode = android::MediaSource::ReadOptions::SEEK_NEXT_SYNC;
-    }
-
-    return translate_error(ex->mImpl->seekTo(seekPosUs, sfmode));
+    return translate_error(ex->mImpl->seekTo(seekPosUs, translate_seek_mode(mode)));
 }
 
 EXPORT
@@ -300,6 +479,96 @@ PsshInfo* AMediaExtractor_getPsshInfo(AMediaExtractor *ex) {
     return (PsshInfo*) ex->mPsshBuf->data();
 }
 
+EXPORT
+ssize_t AMediaExtractor_readTrackSamples(AMediaExtractor *ex, size_t trackIdx,
+        uint8_t *buffer, size_t capacity, AMediaExtractorSampleInfo *info, size_t maxSamples) {
+    if (maxSamples == 0) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    return readTrackSamples(ex->mImpl, trackIdx, buffer, capacity, info, maxSamples);
+}
+
+EXPORT
+media_status_t AMediaExtractor_seekTrackTo(AMediaExtractor *ex, size_t trackIdx,
+        int64_t seekPosUs, SeekMode mode) {
+    status_t err = ex->mImpl->seekTrackTo(trackIdx, seekPosUs, translate_seek_mode(mode));
+    if (err == -EINVAL) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    return translate_error(err);
+}
+
+EXPORT
+media_status_t AMediaExtractor_queueTrackBuffer(AMediaExtractor *ex, size_t trackIdx,
+        uint8_t *buffer, size_t capacity, AMediaExtractorSampleInfo *info, size_t maxSamples) {
+    if (buffer == NULL || info == NULL || maxSamples == 0) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+
+    sp<TrackReadQueue> queue = ex->getReadQueue(trackIdx, true /* create */);
+
+    TrackReadRequest request;
+    request.mBuffer = buffer;
+    request.mCapacity = capacity;
+    request.mInfo = info;
+    request.mMaxSamples = maxSamples;
+    request.mResult = AMEDIA_OK;
+
+    bool schedule;
+    {
+        Mutex::Autolock autoLock(queue->mLock);
+        queue->mQueued.push_back(request);
+        schedule = !queue->mScheduled;
+        queue->mScheduled = true;
+    }
+
+    if (schedule) {
+        TrackReadPool::schedule(queue);
+    }
+    return AMEDIA_OK;
+}
+
+EXPORT
+ssize_t AMediaExtractor_dequeueTrackBuffer(AMediaExtractor *ex, size_t trackIdx,
+        int64_t timeoutUs, uint8_t **buffer, AMediaExtractorSampleInfo **info) {
+    sp<TrackReadQueue> queue = ex->getReadQueue(trackIdx, false /* create */);
+    if (queue == NULL) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+
+    Mutex::Autolock autoLock(queue->mLock);
+
+    if (queue->mFilled.empty() && queue->mQueued.empty()) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+
+    if (timeoutUs < 0) {
+        while (queue->mFilled.empty()) {
+            queue->mCondition.wait(queue->mLock);
+        }
+    } else if (queue->mFilled.empty()) {
+        nsecs_t deadlineNs = systemTime() + timeoutUs * 1000ll;
+        while (queue->mFilled.empty()) {
+            nsecs_t remainingNs = deadlineNs - systemTime();
+            if (remainingNs <= 0
+                    || queue->mCondition.waitRelative(queue->mLock, remainingNs) == TIMED_OUT) {
+                break;
+            }
+        }
+        if (queue->mFilled.empty()) {
+            return AMEDIAEXTRACTOR_INFO_TRY_AGAIN_LATER;
+        }
+    }
+
+    const TrackReadRequest &request = *queue->mFilled.begin();
+    *buffer = request.mBuffer;
+    *info = request.mInfo;
+    ssize_t result = request.mResult;
+    queue->mFilled.erase(queue->mFilled.begin());
+
+    return result;
+}
+
 EXPORT
 AMediaCodecCryptoInfo *AMediaExtractor_getSampleCryptoInfo(AMediaExtractor *ex) {
     sp<MetaData> meta;
@@ -19,12 +19,15 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES := \
   BatteryNotifier.cpp \
   ISchedulingPolicyService.cpp \
+  MediaSchedulingPolicy.cpp \
   SchedulingPolicyService.cpp
 
 LOCAL_SHARED_LIBRARIES := \
   libbinder \
   libcutils \
   liblog \
+  libpowermanager \
+  libstagefright_foundation \
   libutils \
 
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/include
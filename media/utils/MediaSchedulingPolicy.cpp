@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MediaSchedulingPolicy"
+//#define LOG_NDEBUG 0
+
+#include "include/mediautils/MediaSchedulingPolicy.h"
+#include "include/mediautils/SchedulingPolicyService.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <binder/IServiceManager.h>
+#include <hardware/power.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <private/android_filesystem_config.h>
+#include <system/thread_defs.h>
+#include <utils/Log.h>
+
+namespace android {
+
+// requestPriority() priority of MEDIA_LATENCY_CLASS_AUDIO_RT threads, as for audio app threads
+static const int32_t kPriorityAudioRt = 2;
+
+// frame deadline threads are boosted while the sum of the frame rates of the active video
+// sessions reaches this, e.g. one 60 fps playback or a 30 fps recording with its preview
+static const float kBoostFrameRate = 60.0f;
+// assumed frame rate of a video session that did not configure one
+static const float kDefaultFrameRate = 30.0f;
+
+static const char *latencyClassName(media_latency_class_t latencyClass) {
+    switch (latencyClass) {
+        case MEDIA_LATENCY_CLASS_AUDIO_RT:      return "audio-rt";
+        case MEDIA_LATENCY_CLASS_VIDEO_FRAME:   return "video-frame";
+        case MEDIA_LATENCY_CLASS_BACKGROUND:    return "background";
+        default:                                return "?";
+    }
+}
+
+static bool threadExists(pid_t tid) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/task/%d", tid);
+    return access(path, F_OK) == 0;
+}
+
+static void setAffinity(pid_t tid, const cpu_set_t *cpus) {
+    if (sched_setaffinity(tid, sizeof(*cpus), cpus) != 0) {
+        ALOGW("sched_setaffinity(%d) failed: %s", tid, strerror(errno));
+    }
+}
+
+static void getAllCores(cpu_set_t *cpus) {
+    CPU_ZERO(cpus);
+    const long numCpus = sysconf(_SC_NPROCESSORS_CONF);
+    for (long cpu = 0; cpu < numCpus && cpu < CPU_SETSIZE; ++cpu) {
+        CPU_SET(cpu, cpus);
+    }
+}
+
+// The big cores are the ones with the highest maximum frequency, and there are none if all
+// cores have the same.
+static void getBigCores(cpu_set_t *cpus) {
+    CPU_ZERO(cpus);
+    const long numCpus = sysconf(_SC_NPROCESSORS_CONF);
+    long maxFreq[CPU_SETSIZE];
+    long highest = 0;
+    long lowest = 0;
+    for (long cpu = 0; cpu < numCpus && cpu < CPU_SETSIZE; ++cpu) {
+        char path[80];
+        snprintf(path, sizeof(path),
+                "/sys/devices/system/cpu/cpu%ld/cpufreq/cpuinfo_max_freq", cpu);
+        maxFreq[cpu] = 0;
+        FILE *f = fopen(path, "r");
+        if (f != NULL) {
+            if (fscanf(f, "%ld", &maxFreq[cpu]) != 1) {
+                maxFreq[cpu] = 0;
+            }
+            fclose(f);
+        }
+        if (maxFreq[cpu] <= 0) {
+            // offline, or no cpufreq: topology unknown, do not restrict affinity
+            return;
+        }
+        if (highest == 0 || maxFreq[cpu] > highest) {
+            highest = maxFreq[cpu];
+        }
+        if (lowest == 0 || maxFreq[cpu] < lowest) {
+            lowest = maxFreq[cpu];
+        }
+    }
+    if (highest == lowest) {
+        return;
+    }
+    for (long cpu = 0; cpu < numCpus && cpu < CPU_SETSIZE; ++cpu) {
+        if (maxFreq[cpu] == highest) {
+            CPU_SET(cpu, cpus);
+        }
+    }
+}
+
+MediaSchedulingPolicy::MediaSchedulingPolicy()
+    : mEnabled(getuid() == AID_MEDIA),
+      mNextSessionId(1),
+      mBoosted(false),
+      mDecodeHint(false),
+      mEncodeHint(false) {
+    CPU_ZERO(&mBigCores);
+    if (!mEnabled) {
+        return;
+    }
+    getBigCores(&mBigCores);
+    ALOGV("%d big cores", CPU_COUNT(&mBigCores));
+}
+
+MediaSchedulingPolicy::~MediaSchedulingPolicy() {
+}
+
+status_t MediaSchedulingPolicy::registerThread(
+        pid_t tid, media_latency_class_t latencyClass, const char *name) {
+    if (!mEnabled) {
+        return OK;
+    }
+    if (tid <= 0) {
+        return BAD_VALUE;
+    }
+    {
+        Mutex::Autolock _l(mLock);
+
+        // forget the threads that exited without unregistering, their tid may be reused
+        for (size_t i = mThreads.size(); i > 0; --i) {
+            if (!threadExists(mThreads.keyAt(i - 1))) {
+                mThreads.removeItemsAt(i - 1);
+            }
+        }
+
+        ssize_t index = mThreads.indexOfKey(tid);
+        if (index < 0) {
+            ThreadInfo info;
+            errno = 0;
+            info.mOriginalNice = getpriority(PRIO_PROCESS, tid);
+            if (info.mOriginalNice == -1 && errno != 0) {
+                ALOGW("thread %d (%s) not found", tid, name);
+                return BAD_VALUE;
+            }
+            if (get_sched_policy(tid, &info.mOriginalPolicy) != 0) {
+                info.mOriginalPolicy = SP_FOREGROUND;
+            }
+            info.mBoosted = false;
+            index = mThreads.add(tid, info);
+        }
+        ThreadInfo *info = &mThreads.editValueAt(index);
+        info->mName = name;
+        info->mClass = latencyClass;
+        applyPolicy_l(tid, info);
+        ALOGV("thread %d (%s) is %s", tid, name, latencyClassName(latencyClass));
+    }
+
+    // the scheduling policy service may not be up yet, do not wait for it with mLock held
+    if (latencyClass == MEDIA_LATENCY_CLASS_AUDIO_RT) {
+        int err = requestPriority(getpid(), tid, kPriorityAudioRt, true /*asynchronous*/);
+        if (err != 0) {
+            ALOGW("requestPriority(%d) failed: %d", tid, err);
+            return err;
+        }
+    }
+    return OK;
+}
+
+status_t MediaSchedulingPolicy::registerLooper(
+        const sp<ALooper> &looper, media_latency_class_t latencyClass) {
+    if (!mEnabled) {
+        return OK;
+    }
+    pid_t tid = looper->getTid();
+    if (tid <= 0) {
+        // not started, or running on the calling thread
+        return INVALID_OPERATION;
+    }
+    const char *name = looper->getName();
+    return registerThread(tid, latencyClass, *name != '\0' ? name : "ALooper");
+}
+
+void MediaSchedulingPolicy::unregisterThread(pid_t tid) {
+    Mutex::Autolock _l(mLock);
+    ssize_t index = mThreads.indexOfKey(tid);
+    if (index < 0) {
+        return;
+    }
+    const ThreadInfo &info = mThreads.valueAt(index);
+    if (threadExists(tid)) {
+        if (info.mClass == MEDIA_LATENCY_CLASS_AUDIO_RT) {
+            struct sched_param param;
+            param.sched_priority = 0;
+            sched_setscheduler(tid, SCHED_OTHER, &param);
+        }
+        setpriority(PRIO_PROCESS, tid, info.mOriginalNice);
+        set_sched_policy(tid, info.mOriginalPolicy);
+        if (info.mBoosted) {
+            cpu_set_t all;
+            getAllCores(&all);
+            setAffinity(tid, &all);
+        }
+    }
+    mThreads.removeItemsAt(index);
+}
+
+void MediaSchedulingPolicy::applyPolicy_l(pid_t tid, ThreadInfo *info) {
+    int nice;
+    SchedPolicy policy;
+    bool boosted = false;
+    switch (info->mClass) {
+        case MEDIA_LATENCY_CLASS_AUDIO_RT:
+            // the priority is set by requestPriority(), the nice value does not matter
+            nice = info->mOriginalNice;
+            policy = SP_FOREGROUND;
+            break;
+        case MEDIA_LATENCY_CLASS_VIDEO_FRAME:
+            nice = mBoosted ? ANDROID_PRIORITY_URGENT_DISPLAY : ANDROID_PRIORITY_DISPLAY;
+            if (info->mOriginalNice < nice) {
+                nice = info->mOriginalNice;
+            }
+            policy = SP_FOREGROUND;
+            boosted = mBoosted && CPU_COUNT(&mBigCores) > 0;
+            break;
+        case MEDIA_LATENCY_CLASS_BACKGROUND:
+        default:
+            nice = ANDROID_PRIORITY_BACKGROUND;
+            policy = SP_BACKGROUND;
+            break;
+    }
+
+    if (setpriority(PRIO_PROCESS, tid, nice) != 0) {
+        ALOGW("setpriority(%d, %d) failed: %s", tid, nice, strerror(errno));
+    }
+    if (set_sched_policy(tid, policy) != 0) {
+        ALOGW("set_sched_policy(%d, %d) failed", tid, policy);
+    }
+    if (boosted) {
+        setAffinity(tid, &mBigCores);
+    } else if (info->mBoosted) {
+        cpu_set_t all;
+        getAllCores(&all);
+        setAffinity(tid, &all);
+    }
+    info->mBoosted = boosted;
+}
+
+int32_t MediaSchedulingPolicy::startSession(bool isVideo, bool isEncoder, float frameRate) {
+    if (!mEnabled) {
+        return 0;
+    }
+    Mutex::Autolock _l(mLock);
+    SessionInfo session;
+    session.mIsVideo = isVideo;
+    session.mIsEncoder = isEncoder;
+    session.mFrameRate = frameRate;
+    int32_t sessionId = mNextSessionId++;
+    if (mNextSessionId <= 0) {
+        mNextSessionId = 1;
+    }
+    mSessions.add(sessionId, session);
+    updateSessions_l();
+    return sessionId;
+}
+
+void MediaSchedulingPolicy::stopSession(int32_t sessionId) {
+    Mutex::Autolock _l(mLock);
+    if (mSessions.removeItem(sessionId) < 0) {
+        ALOGW("stopSession: unknown session %d", sessionId);
+        return;
+    }
+    updateSessions_l();
+}
+
+void MediaSchedulingPolicy::updateSessions_l() {
+    float videoFrameRate = 0;
+    bool decoding = false;
+    bool encoding = false;
+    for (size_t i = 0; i < mSessions.size(); ++i) {
+        const SessionInfo &session = mSessions.valueAt(i);
+        if (!session.mIsVideo) {
+            continue;
+        }
+        videoFrameRate += session.mFrameRate > 0 ? session.mFrameRate : kDefaultFrameRate;
+        if (session.mIsEncoder) {
+            encoding = true;
+        } else {
+            decoding = true;
+        }
+    }
+
+    if (decoding != mDecodeHint) {
+        powerHint_l(POWER_HINT_VIDEO_DECODE, decoding);
+        mDecodeHint = decoding;
+    }
+    if (encoding != mEncodeHint) {
+        powerHint_l(POWER_HINT_VIDEO_ENCODE, encoding);
+        mEncodeHint = encoding;
+    }
+
+    bool boosted = videoFrameRate >= kBoostFrameRate;
+    if (boosted != mBoosted) {
+        ALOGV("%s frame deadline threads, video at %.1f fps",
+                boosted ? "boosting" : "unboosting", videoFrameRate);
+        mBoosted = boosted;
+        for (size_t i = 0; i < mThreads.size(); ++i) {
+            if (mThreads.valueAt(i).mClass == MEDIA_LATENCY_CLASS_VIDEO_FRAME) {
+                applyPolicy_l(mThreads.keyAt(i), &mThreads.editValueAt(i));
+            }
+        }
+    }
+}
+
+void MediaSchedulingPolicy::powerHint_l(int hint, bool on) {
+    if (mPowerManager == NULL) {
+        sp<IBinder> binder = defaultServiceManager()->checkService(String16("power"));
+        if (binder == NULL) {
+            ALOGW("power manager unavailable, no power hint %d", hint);
+            return;
+        }
+        mPowerManager = interface_cast<IPowerManager>(binder);
+    }
+    if (mPowerManager->powerHint(hint, on ? 1 : 0) == DEAD_OBJECT) {
+        mPowerManager.clear();
+    }
+}
+
+void MediaSchedulingPolicy::dump(int fd) {
+    Mutex::Autolock _l(mLock);
+    dprintf(fd, " Media scheduling policy: %zu threads, %zu sessions%s%s%s\n",
+            mThreads.size(), mSessions.size(), mBoosted ? ", boosted" : "",
+            mDecodeHint ? ", decode hint" : "", mEncodeHint ? ", encode hint" : "");
+    for (size_t i = 0; i < mThreads.size(); ++i) {
+        const ThreadInfo &info = mThreads.valueAt(i);
+        pid_t tid = mThreads.keyAt(i);
+        errno = 0;
+        int nice = getpriority(PRIO_PROCESS, tid);
+        if (nice == -1 && errno != 0) {
+            dprintf(fd, "  %5d %-24s %-12s exited\n",
+                    tid, info.mName.string(), latencyClassName(info.mClass));
+            continue;
+        }
+        dprintf(fd, "  %5d %-24s %-12s nice %3d policy %d%s\n",
+                tid, info.mName.string(), latencyClassName(info.mClass), nice,
+                sched_getscheduler(tid), info.mBoosted ? " big cores" : "");
+    }
+    for (size_t i = 0; i < mSessions.size(); ++i) {
+        const SessionInfo &session = mSessions.valueAt(i);
+        dprintf(fd, "  session %d: %s %s, %.1f fps\n", mSessions.keyAt(i),
+                session.mIsVideo ? "video" : "audio",
+                session.mIsEncoder ? "encoder" : "decoder", session.mFrameRate);
+    }
+}
+
+ANDROID_SINGLETON_STATIC_INSTANCE(MediaSchedulingPolicy);
+
+}  // namespace android
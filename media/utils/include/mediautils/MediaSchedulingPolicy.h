@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_SCHEDULING_POLICY_H
+#define MEDIA_SCHEDULING_POLICY_H
+
+#include <sched.h>
+#include <sys/types.h>
+
+#include <cutils/sched_policy.h>
+#include <powermanager/IPowerManager.h>
+#include <utils/Errors.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Singleton.h>
+#include <utils/String8.h>
+
+namespace android {
+
+struct ALooper;
+
+enum media_latency_class_t {
+    // SCHED_FIFO through the framework scheduling policy service, for threads that must
+    // never miss an audio period.
+    MEDIA_LATENCY_CLASS_AUDIO_RT,
+    // Threads with a per frame deadline: codec loopers, renderers, camera request threads.
+    // They run in the foreground group at display priority or better, and are moved to
+    // urgent display priority and to the big cores while the active video load is high.
+    MEDIA_LATENCY_CLASS_VIDEO_FRAME,
+    // Work without a deadline, e.g. thumbnail extraction. Background group and priority.
+    MEDIA_LATENCY_CLASS_BACKGROUND,
+};
+
+/**
+ * Assigns scheduling parameters to the media threads of mediaserver by latency class,
+ * and sends video decode and encode power hints while MediaCodec video sessions run.
+ *
+ * The policy only applies in mediaserver. In other processes, e.g. an application using
+ * MediaCodec, every call is a no-op.
+ *
+ * A registered thread keeps its class until it is unregistered, which restores the nice
+ * value and the affinity the thread had when it was registered. The class never lowers the
+ * priority of a frame deadline thread that was started at a higher one.
+ */
+class MediaSchedulingPolicy : public Singleton<MediaSchedulingPolicy> {
+
+    friend class Singleton<MediaSchedulingPolicy>;
+    MediaSchedulingPolicy();
+
+public:
+    ~MediaSchedulingPolicy();
+
+    status_t registerThread(pid_t tid, media_latency_class_t latencyClass, const char *name);
+    // Registers the thread of a looper started on its own thread.
+    status_t registerLooper(const sp<ALooper> &looper, media_latency_class_t latencyClass);
+    void unregisterThread(pid_t tid);
+
+    // A MediaCodec session is active while the codec is started, including while flushed.
+    // frameRate is 0 if unknown. Returns a handle for stopSession(), or 0 if not tracked.
+    int32_t startSession(bool isVideo, bool isEncoder, float frameRate);
+    void stopSession(int32_t sessionId);
+
+    void dump(int fd);
+
+private:
+    struct ThreadInfo {
+        String8 mName;
+        media_latency_class_t mClass;
+        int mOriginalNice;
+        SchedPolicy mOriginalPolicy;
+        bool mBoosted;
+    };
+
+    struct SessionInfo {
+        bool mIsVideo;
+        bool mIsEncoder;
+        float mFrameRate;
+    };
+
+    const bool mEnabled;    // running in mediaserver
+    Mutex mLock;
+    KeyedVector<pid_t, ThreadInfo> mThreads;
+    KeyedVector<int32_t, SessionInfo> mSessions;
+    int32_t mNextSessionId;
+    bool mBoosted;          // frame deadline threads are boosted
+    bool mDecodeHint;       // POWER_HINT_VIDEO_DECODE is on
+    bool mEncodeHint;       // POWER_HINT_VIDEO_ENCODE is on
+    cpu_set_t mBigCores;    // empty on symmetric systems
+    sp<IPowerManager> mPowerManager;
+
+    void applyPolicy_l(pid_t tid, ThreadInfo *info);
+    void updateSessions_l();
+    void powerHint_l(int hint, bool on);
+};
+
+}  // namespace android
+
+#endif // MEDIA_SCHEDULING_POLICY_H
@@ -48,8 +48,11 @@ LOCAL_SRC_FILES:=               \
     Effects.cpp                 \
     AudioMixer.cpp.arm          \
     BufferProviders.cpp         \
+    MixerWorkerPool.cpp         \
     PatchPanel.cpp              \
-    StateQueue.cpp
+    SinkDrainEstimator.cpp      \
+    StateQueue.cpp              \
+    ThreadMetrics.cpp
 
 LOCAL_C_INCLUDES := \
     $(TOPDIR)frameworks/av/services/audiopolicy \
@@ -74,7 +77,8 @@ LOCAL_SHARED_LIBRARIES := \
     libpowermanager \
     libserviceutility \
     libsonic \
-    libmediautils
+    libmediautils \
+    libstagefright_foundation
 
 LOCAL_STATIC_LIBRARIES := \
     libcpustats \
@@ -179,6 +183,9 @@ endif
 
 LOCAL_MODULE := libaudioresampler
 
+# filters of AudioResamplerDyn designed at build time
+LOCAL_REQUIRED_MODULES := audio_resampler_fir.bin
+
 include $(BUILD_SHARED_LIBRARY)
 
 include $(call all-makefiles-under,$(LOCAL_PATH))
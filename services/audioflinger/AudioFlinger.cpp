@@ -211,7 +211,9 @@ AudioFlinger::AudioFlinger()
       mIsLowRamDevice(true),
       mIsDeviceTypeKnown(false),
       mGlobalEffectEnableTime(0),
-      mSystemReady(false)
+      mSystemReady(false),
+      mIoStateTable(NULL),
+      mIoStateSlotsInUse(0)
 {
     getpid_cached = getpid();
     char value[PROPERTY_VALUE_MAX];
@@ -221,6 +223,17 @@ AudioFlinger::AudioFlinger()
                 MemoryHeapBase::READ_ONLY);
     }
 
+    mIoStateDealer = new MemoryDealer(sizeof(AudioIoStateTable), "AudioIoState",
+            MemoryHeapBase::READ_ONLY);
+    mIoStateMemory = mIoStateDealer->allocate(sizeof(AudioIoStateTable));
+    if (mIoStateMemory != 0 && mIoStateMemory->pointer() != NULL) {
+        mIoStateTable = (AudioIoStateTable *) mIoStateMemory->pointer();
+        mIoStateTable->init();
+    } else {
+        ALOGE("unable to allocate the published output state");
+        mIoStateMemory.clear();
+    }
+
 #ifdef TEE_SINK
     (void) property_get("ro.debuggable", value, "0");
     int debuggable = atoi(value);
@@ -454,6 +467,10 @@ status_t AudioFlinger::dump(int fd, const Vector<String16>& args)
             mRecordThreads.valueAt(i)->dump(fd, args);
         }
 
+        if (mPatchPanel != 0) {
+            mPatchPanel->dump(fd);
+        }
+
         // dump orphan effect chains
         if (mOrphanEffectChains.size() != 0) {
             write(fd, "  Orphan Effect Chains\n", strlen("  Orphan Effect Chains\n"));
@@ -971,6 +988,42 @@ status_t AudioFlinger::setStreamVolume(audio_stream_type_t stream, float value,
     ALOG_ASSERT(stream != AUDIO_STREAM_PATCH, "attempt to change AUDIO_STREAM_PATCH volume");
 
     AutoMutex lock(mLock);
+    return setStreamVolume_l(stream, value, output);
+}
+
+status_t AudioFlinger::setStreamVolumes(const StreamVolume *volumes, size_t count)
+{
+    // check calling permissions
+    if (!settingsAllowed()) {
+        return PERMISSION_DENIED;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        status_t status = checkStreamType(volumes[i].mStream);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        ALOG_ASSERT(volumes[i].mStream != AUDIO_STREAM_PATCH,
+                "attempt to change AUDIO_STREAM_PATCH volume");
+    }
+
+    // the volumes of a batch are usually for outputs which are all still opened: keep going
+    // on a closed output and report it at the end
+    status_t status = NO_ERROR;
+    AutoMutex lock(mLock);
+    for (size_t i = 0; i < count; i++) {
+        status_t volumeStatus = setStreamVolume_l(volumes[i].mStream, volumes[i].mVolume,
+                                                  volumes[i].mOutput);
+        if (volumeStatus != NO_ERROR) {
+            status = volumeStatus;
+        }
+    }
+    return status;
+}
+
+status_t AudioFlinger::setStreamVolume_l(audio_stream_type_t stream, float value,
+        audio_io_handle_t output)
+{
     PlaybackThread *thread = NULL;
     if (output != AUDIO_IO_HANDLE_NONE) {
         thread = checkPlaybackThread_l(output);
@@ -1461,6 +1514,42 @@ void AudioFlinger::Client::releaseTimedTrack()
     mTimedTrackCount--;
 }
 
+sp<IMemory> AudioFlinger::Client::allocate(size_t size)
+{
+    Mutex::Autolock _l(mRecycledMemoryLock);
+    for (size_t i = mRecycledMemory.size(); i > 0; ) {
+        --i;
+        if (mRecycledMemory[i]->size() == size) {
+            sp<IMemory> memory = mRecycledMemory[i];
+            mRecycledMemory.removeAt(i);
+            return memory;
+        }
+    }
+    sp<IMemory> memory = mMemoryDealer->allocate(size);
+    if (memory == 0 && !mRecycledMemory.isEmpty()) {
+        // the recycled allocations may be what is left of the heap
+        mRecycledMemory.clear();
+        memory = mMemoryDealer->allocate(size);
+    }
+    return memory;
+}
+
+void AudioFlinger::Client::recycle(sp<IMemory>& memory)
+{
+    if (memory == 0) {
+        return;
+    }
+    // don't let large buffers hold a significant part of the heap
+    if (memory->size() <= mMemoryDealer->getMemoryHeap()->getSize() / 16) {
+        Mutex::Autolock _l(mRecycledMemoryLock);
+        if (mRecycledMemory.size() >= kMaxRecycledMemory) {
+            mRecycledMemory.removeAt(0);
+        }
+        mRecycledMemory.add(memory);
+    }
+    memory.clear();
+}
+
 // ----------------------------------------------------------------------------
 
 AudioFlinger::NotificationClient::NotificationClient(const sp<AudioFlinger>& audioFlinger,
@@ -1805,6 +1894,12 @@ status_t AudioFlinger::systemReady()
     return NO_ERROR;
 }
 
+sp<IMemory> AudioFlinger::getIoState() const
+{
+    // mIoStateMemory is only set by the constructor
+    return mIoStateMemory;
+}
+
 // setAudioHwSyncForSession_l() must be called with AudioFlinger::mLock held
 void AudioFlinger::setAudioHwSyncForSession_l(PlaybackThread *thread, audio_session_t sessionId)
 {
@@ -2018,6 +2113,10 @@ status_t AudioFlinger::closeOutput_nonvirtual(audio_io_handle_t output)
     thread->exit();
     // The thread entity (active unit of execution) is no longer running here,
     // but the ThreadBase container still exists.
+    {
+        Mutex::Autolock _l(mLock);
+        releaseIoState_l(thread->detachIoState());
+    }
 
     if (!thread->isDuplicating()) {
         closeOutputFinish(thread);
@@ -2459,6 +2558,33 @@ AudioFlinger::RecordThread *AudioFlinger::checkRecordThread_l(audio_io_handle_t
     return mRecordThreads.valueFor(input).get();
 }
 
+AudioIoState *AudioFlinger::acquireIoState_l()
+{
+    if (mIoStateTable == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < AudioIoStateTable::kNumSlots; i++) {
+        if ((mIoStateSlotsInUse & (1u << i)) == 0) {
+            mIoStateSlotsInUse |= 1u << i;
+            return &mIoStateTable->mSlots[i];
+        }
+    }
+    ALOGW("acquireIoState_l() no free slot, state of the new output will not be published");
+    return NULL;
+}
+
+void AudioFlinger::releaseIoState_l(AudioIoState *state)
+{
+    if (state == NULL) {
+        return;
+    }
+    AudioIoStateData data;
+    memset(&data, 0, sizeof(data));
+    data.mIoHandle = AUDIO_IO_HANDLE_NONE;
+    state->write(data);
+    mIoStateSlotsInUse &= ~(1u << (state - mIoStateTable->mSlots));
+}
+
 uint32_t AudioFlinger::nextUniqueId()
 {
     return (uint32_t) android_atomic_inc(&mNextUniqueId);
@@ -59,10 +59,14 @@
 #include "AudioStreamOut.h"
 #include "SpdifStreamOut.h"
 #include "AudioHwDevice.h"
+#include "SinkDrainEstimator.h"
+#include "TrackRateCorrector.h"
+#include "ThreadMetrics.h"
 
 #include <powermanager/IPowerManager.h>
 
 #include <media/nbaio/NBLog.h>
+#include <private/media/AudioIoState.h>
 #include <private/media/AudioTrackShared.h>
 
 namespace android {
@@ -151,6 +155,7 @@ public:
     virtual     status_t    setStreamVolume(audio_stream_type_t stream, float value,
                                             audio_io_handle_t output);
     virtual     status_t    setStreamMute(audio_stream_type_t stream, bool muted);
+    virtual     status_t    setStreamVolumes(const StreamVolume *volumes, size_t count);
 
     virtual     float       streamVolume(audio_stream_type_t stream,
                                          audio_io_handle_t output) const;
@@ -266,6 +271,8 @@ public:
     /* Indicate JAVA services are ready (scheduling, power management ...) */
     virtual status_t systemReady();
 
+    virtual sp<IMemory> getIoState() const;
+
     virtual     status_t    onTransact(
                                 uint32_t code,
                                 const Parcel& data,
@@ -425,6 +432,14 @@ private:
         bool reserveTimedTrack();
         void releaseTimedTrack();
 
+        // Allocates a track control block and buffer from heap(), reusing the allocation
+        // of a destroyed track of this client with the same size if there is one.
+        // Clients creating many short lived tracks of one configuration then skip the
+        // heap allocation and the new IMemory.
+        sp<IMemory>         allocate(size_t size);
+        // Keeps an allocation for a later allocate(), and clears memory.
+        void                recycle(sp<IMemory>& memory);
+
     private:
                             Client(const Client&);
                             Client& operator = (const Client&);
@@ -434,6 +449,11 @@ private:
 
         Mutex               mTimedTrackLock;
         int                 mTimedTrackCount;
+
+        static const size_t kMaxRecycledMemory = 4;
+        Mutex               mRecycledMemoryLock;
+        // most recently recycled last, released before mMemoryDealer
+        Vector< sp<IMemory> > mRecycledMemory;
     };
 
     // --- Notification Client ---
@@ -541,6 +561,11 @@ private:
               PlaybackThread *checkPlaybackThread_l(audio_io_handle_t output) const;
               MixerThread *checkMixerThread_l(audio_io_handle_t output) const;
               RecordThread *checkRecordThread_l(audio_io_handle_t input) const;
+              // Returns a free slot of mIoStateTable for a new PlaybackThread, or NULL if none.
+              AudioIoState *acquireIoState_l();
+              void releaseIoState_l(AudioIoState *state);
+              status_t setStreamVolume_l(audio_stream_type_t stream, float value,
+                                         audio_io_handle_t output);
               sp<RecordThread> openInput_l(audio_module_handle_t module,
                                            audio_io_handle_t *input,
                                            audio_config_t *config,
@@ -770,6 +795,13 @@ private:
     sp<PatchPanel> mPatchPanel;
 
     bool        mSystemReady;
+
+    // State published by the playback threads, see IAudioFlinger::getIoState().
+    // The memory is mapped read-only by clients.
+    sp<MemoryDealer>    mIoStateDealer;
+    sp<IMemory>         mIoStateMemory;         // == 0 if the allocation failed
+    AudioIoStateTable  *mIoStateTable;          // == NULL if the allocation failed
+    uint32_t            mIoStateSlotsInUse;     // bit i is set when mSlots[i] has an owner
 };
 
 #undef INCLUDING_FROM_AUDIOFLINGER_H
@@ -40,6 +40,7 @@
 #include <common_time/cc_helper.h>
 
 #include "AudioMixerOps.h"
+#include "AudioMixerOpsSimd.h"
 #include "AudioMixer.h"
 
 // The FCC_2 macro refers to the Fixed Channel Count of 2 for the legacy integer mixer.
@@ -122,7 +123,7 @@ AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTr
     mState.outputTemp   = NULL;
     mState.resampleTemp = NULL;
     mState.mLog         = &mDummyLog;
-    // mState.reserved
+    mState.parallel     = NULL;
 
     // FIXME Most of the following initialization is probably redundant since
     // tracks[i] should only be referenced if (mTrackNames & (1 << i)) != 0
@@ -150,6 +151,7 @@ AudioMixer::~AudioMixer()
     }
     delete [] mState.outputTemp;
     delete [] mState.resampleTemp;
+    setParallelMixing(0, 0);
 }
 
 void AudioMixer::setLog(NBLog::Writer *log)
@@ -157,6 +159,44 @@ void AudioMixer::setLog(NBLog::Writer *log)
     mState.mLog = log;
 }
 
+void AudioMixer::setParallelMixing(uint32_t numThreads, int priority)
+{
+    if (mState.parallel != NULL) {
+        delete mState.parallel->pool;
+        for (uint32_t i = 1; i < MixerWorkerPool::MAX_WORKERS; ++i) {
+            delete [] mState.parallel->outputTemp[i];
+            delete [] mState.parallel->resampleTemp[i];
+        }
+        delete mState.parallel;
+        mState.parallel = NULL;
+    }
+    if (numThreads > 0) {
+        parallel_t *parallel = new parallel_t;
+        parallel->pool = new MixerWorkerPool(numThreads, priority);
+        parallel->outputTemp[0] = NULL;
+        parallel->resampleTemp[0] = NULL;
+        for (uint32_t i = 1; i < MixerWorkerPool::MAX_WORKERS; ++i) {
+            if (i < parallel->pool->workers()) {
+                parallel->outputTemp[i] = new int32_t[MAX_NUM_CHANNELS * mState.frameCount];
+                parallel->resampleTemp[i] = new int32_t[MAX_NUM_CHANNELS * mState.frameCount];
+            } else {
+                parallel->outputTemp[i] = NULL;
+                parallel->resampleTemp[i] = NULL;
+            }
+        }
+        mState.parallel = parallel;
+    }
+    // revalidate the enabled tracks to select the process hook
+    invalidateState(mState.enabledTracks);
+}
+
+void AudioMixer::dumpParallelMixing(int fd, uint32_t budgetUs) const
+{
+    if (mState.parallel != NULL) {
+        mState.parallel->pool->dump(fd, budgetUs);
+    }
+}
+
 static inline audio_format_t selectMixerInFormat(audio_format_t inputFormat __unused) {
     return kUseFloat && kUseNewMixer ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
 }
@@ -229,6 +269,7 @@ int AudioMixer::getTrackName(audio_channel_mask_t channelMask,
         t->mFormat = format;
         t->mMixerInFormat = selectMixerInFormat(format);
         t->mDownmixRequiresFormat = AUDIO_FORMAT_INVALID; // no format required
+        t->mRemixInputFormat = AUDIO_FORMAT_INVALID; // no remixer
         t->mMixerChannelMask = audio_channel_mask_from_representation_and_bits(
                 AUDIO_CHANNEL_REPRESENTATION_POSITION, AUDIO_CHANNEL_OUT_STEREO);
         t->mMixerChannelCount = audio_channel_count_from_out_mask(t->mMixerChannelMask);
@@ -284,12 +325,14 @@ bool AudioMixer::setChannelMasks(int name,
     // channel masks have changed, does this track need a downmixer?
     // update to try using our desired format (if we aren't already using it)
     const audio_format_t prevDownmixerFormat = track.mDownmixRequiresFormat;
+    const audio_format_t prevRemixInputFormat = track.mRemixInputFormat;
     const status_t status = mState.tracks[name].prepareForDownmix();
     ALOGE_IF(status != OK,
             "prepareForDownmix error %d, track channel mask %#x, mixer channel mask %#x",
             status, track.channelMask, track.mMixerChannelMask);
 
-    if (prevDownmixerFormat != track.mDownmixRequiresFormat) {
+    if (prevDownmixerFormat != track.mDownmixRequiresFormat
+            || prevRemixInputFormat != track.mRemixInputFormat) {
         track.prepareForReformat(); // because of downmixer, track format may change!
     }
 
@@ -314,6 +357,7 @@ void AudioMixer::track_t::unprepareForDownmix() {
         reconfigureBufferProviders();
     }
     mDownmixRequiresFormat = AUDIO_FORMAT_INVALID;
+    mRemixInputFormat = AUDIO_FORMAT_INVALID;
     if (downmixerBufferProvider != NULL) {
         // this track had previously been configured with a downmixer, delete it
         ALOGV(" deleting old downmixer");
@@ -358,8 +402,12 @@ status_t AudioMixer::track_t::prepareForDownmix()
     }
 
     // Effect downmixer does not accept the channel conversion.  Let's use our remixer.
+    // If it can, the remixer also converts the track format, so no ReformatBufferProvider
+    // (and no extra copy) is needed in front of it.
+    mRemixInputFormat = RemixBufferProvider::isFusableFormat(mFormat, mMixerInFormat)
+            ? mFormat : mMixerInFormat;
     RemixBufferProvider* pRbp = new RemixBufferProvider(channelMask,
-            mMixerChannelMask, mMixerInFormat, kCopyBufferFrameCount);
+            mMixerChannelMask, mMixerInFormat, kCopyBufferFrameCount, mRemixInputFormat);
     // Remix always finds a conversion whereas Downmixer effect above may fail.
     downmixerBufferProvider = pRbp;
     reconfigureBufferProviders();
@@ -380,9 +428,17 @@ status_t AudioMixer::track_t::prepareForReformat()
     ALOGV("AudioMixer::prepareForReformat(%p) with format %#x", this, mFormat);
     // discard previous reformatters
     unprepareForReformat();
+    // the remixer may have been created for a different track format
+    if (mRemixInputFormat != AUDIO_FORMAT_INVALID
+            && mRemixInputFormat != (RemixBufferProvider::isFusableFormat(mFormat, mMixerInFormat)
+                    ? mFormat : mMixerInFormat)) {
+        prepareForDownmix();
+    }
     // only configure reformatters as needed
-    const audio_format_t targetFormat = mDownmixRequiresFormat != AUDIO_FORMAT_INVALID
-            ? mDownmixRequiresFormat : mMixerInFormat;
+    const audio_format_t targetFormat = mRemixInputFormat != AUDIO_FORMAT_INVALID
+            ? mRemixInputFormat
+            : mDownmixRequiresFormat != AUDIO_FORMAT_INVALID
+                    ? mDownmixRequiresFormat : mMixerInFormat;
     bool requiresReconfigure = false;
     if (mFormat != targetFormat) {
         mReformatBufferProvider = new ReformatBufferProvider(
@@ -1008,14 +1064,18 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     // select the processing hooks
     state->hook = process__nop;
     if (countActiveTracks > 0) {
-        if (resampling) {
+        const bool parallel = state->parallel != NULL
+                && (uint32_t)countActiveTracks >= kMinParallelTracks;
+        if (resampling || parallel) {
             if (!state->outputTemp) {
                 state->outputTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
             }
             if (!state->resampleTemp) {
                 state->resampleTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
             }
-            state->hook = process__genericResampling;
+            // the parallel process hook is based on process__genericResampling,
+            // which also handles tracks that do not resample.
+            state->hook = parallel ? process__parallelResampling : process__genericResampling;
         } else {
             if (state->outputTemp) {
                 delete [] state->outputTemp;
@@ -1045,9 +1105,10 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     }
 
     ALOGV("mixer configuration change: %d activeTracks (%08x) "
-        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d",
+        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d, parallel=%d",
         countActiveTracks, state->enabledTracks,
-        all16BitsStereoNoResample, resampling, volumeRamp);
+        all16BitsStereoNoResample, resampling, volumeRamp,
+        state->hook == process__parallelResampling);
 
    state->hook(state, pts);
 
@@ -1558,46 +1619,161 @@ void AudioMixer::process__genericResampling(state_t* state, int64_t pts)
         while (e1) {
             const int i = 31 - __builtin_clz(e1);
             e1 &= ~(1<<i);
-            track_t& t = state->tracks[i];
-            int32_t *aux = NULL;
-            if (CC_UNLIKELY(t.needs & NEEDS_AUX)) {
-                aux = t.auxBuffer;
+            mixTrack(state->tracks[i], outTemp, state->resampleTemp, numFrames, pts);
+        }
+        convertMixerFormat(out, t1.mMixerFormat,
+                outTemp, t1.mMixerInFormat, numFrames * t1.mMixerChannelCount);
+    }
+}
+
+// mix all numFrames of one track into outTemp, used by the process__*Resampling hooks
+void AudioMixer::mixTrack(track_t& t, int32_t* outTemp, int32_t* resampleTemp,
+        size_t numFrames, int64_t pts)
+{
+    int32_t *aux = NULL;
+    if (CC_UNLIKELY(t.needs & NEEDS_AUX)) {
+        aux = t.auxBuffer;
+    }
+
+    // this is a little goofy, on the resampling case we don't
+    // acquire/release the buffers because it's done by
+    // the resampler.
+    if (t.needs & NEEDS_RESAMPLE) {
+        t.resampler->setPTS(pts);
+        t.hook(&t, outTemp, numFrames, resampleTemp, aux);
+    } else {
+
+        size_t outFrames = 0;
+
+        while (outFrames < numFrames) {
+            t.buffer.frameCount = numFrames - outFrames;
+            int64_t outputPTS = calculateOutputPTS(t, pts, outFrames);
+            t.bufferProvider->getNextBuffer(&t.buffer, outputPTS);
+            t.in = t.buffer.raw;
+            // t.in == NULL can happen if the track was flushed just after having
+            // been enabled for mixing.
+            if (t.in == NULL) break;
+
+            if (CC_UNLIKELY(aux != NULL)) {
+                aux += outFrames;
             }
+            t.hook(&t, outTemp + outFrames * t.mMixerChannelCount, t.buffer.frameCount,
+                    resampleTemp, aux);
+            outFrames += t.buffer.frameCount;
+            t.bufferProvider->releaseBuffer(&t.buffer);
+        }
+    }
+}
 
-            // this is a little goofy, on the resampling case we don't
-            // acquire/release the buffers because it's done by
-            // the resampler.
-            if (t.needs & NEEDS_RESAMPLE) {
-                t.resampler->setPTS(pts);
-                t.hook(&t, outTemp, numFrames, state->resampleTemp, aux);
-            } else {
+// work description for mixTracksJob(), one track mask per worker
+struct parallel_job_t {
+    void*       state;
+    int64_t     pts;
+    size_t      numFrames;
+    size_t      sampleCount;    // numFrames * mixer channel count of the group
+    uint32_t    tracks[MixerWorkerPool::MAX_WORKERS];
+};
 
-                size_t outFrames = 0;
+void AudioMixer::mixTracksJob(void *cookie, uint32_t index)
+{
+    const parallel_job_t *job = static_cast<const parallel_job_t *>(cookie);
+    state_t *state = static_cast<state_t *>(job->state);
+    int32_t *outTemp = index == 0 ? state->outputTemp : state->parallel->outputTemp[index];
+    int32_t *resampleTemp = index == 0 ? state->resampleTemp
+            : state->parallel->resampleTemp[index];
+
+    memset(outTemp, 0, sizeof(*outTemp) * job->sampleCount);
+    uint32_t e = job->tracks[index];
+    while (e) {
+        const int i = 31 - __builtin_clz(e);
+        e &= ~(1<<i);
+        mixTrack(state->tracks[i], outTemp, resampleTemp, job->numFrames, job->pts);
+    }
+}
 
-                while (outFrames < numFrames) {
-                    t.buffer.frameCount = numFrames - outFrames;
-                    int64_t outputPTS = calculateOutputPTS(t, pts, outFrames);
-                    t.bufferProvider->getNextBuffer(&t.buffer, outputPTS);
-                    t.in = t.buffer.raw;
-                    // t.in == NULL can happen if the track was flushed just after having
-                    // been enabled for mixing.
-                    if (t.in == NULL) break;
+// generic code with resampling, with the tracks of each group split over the worker pool.
+// Every track is mixed by a single worker into that worker's buffer, and the buffers are
+// summed afterwards.  Tracks sending to an aux buffer are all mixed by the calling thread
+// because the aux buffer is accumulated in place.
+void AudioMixer::process__parallelResampling(state_t* state, int64_t pts)
+{
+    ALOGVV("process__parallelResampling\n");
+    MixerWorkerPool *pool = state->parallel->pool;
+    const uint32_t workers = pool->workers();
+    int32_t* const outTemp = state->outputTemp;
+    size_t numFrames = state->frameCount;
+
+    uint32_t e0 = state->enabledTracks;
+    while (e0) {
+        // process by group of tracks with same output buffer
+        uint32_t e1 = e0, e2 = e0;
+        int j = 31 - __builtin_clz(e1);
+        track_t& t1 = state->tracks[j];
+        e2 &= ~(1<<j);
+        while (e2) {
+            j = 31 - __builtin_clz(e2);
+            e2 &= ~(1<<j);
+            track_t& t2 = state->tracks[j];
+            if (CC_UNLIKELY(t2.mainBuffer != t1.mainBuffer)) {
+                e1 &= ~(1<<j);
+            }
+        }
+        e0 &= ~(e1);
 
-                    if (CC_UNLIKELY(aux != NULL)) {
-                        aux += outFrames;
+        parallel_job_t job;
+        job.state = state;
+        job.pts = pts;
+        job.numFrames = numFrames;
+        job.sampleCount = numFrames * t1.mMixerChannelCount;
+        memset(job.tracks, 0, sizeof(job.tracks));
+        uint32_t next = 1 % workers; // the calling thread also takes the aux tracks, if any
+        uint32_t count = 0;
+        while (e1) {
+            const int i = 31 - __builtin_clz(e1);
+            e1 &= ~(1<<i);
+            ++count;
+            if (state->tracks[i].needs & NEEDS_AUX) {
+                job.tracks[0] |= 1<<i;
+            } else {
+                job.tracks[next] |= 1<<i;
+                next = (next + 1) % workers;
+            }
+        }
+
+        if (count < kMinParallelTracks) {
+            // not worth waking up the workers for a small group
+            for (uint32_t w = 1; w < workers; ++w) {
+                job.tracks[0] |= job.tracks[w];
+                job.tracks[w] = 0;
+            }
+            mixTracksJob(&job, 0);
+        } else {
+            pool->run(mixTracksJob, &job);
+            // sum the partial mixes into the worker 0 buffer
+            for (uint32_t w = 1; w < workers; ++w) {
+                if (job.tracks[w] == 0) {
+                    continue;
+                }
+                const int32_t *partial = state->parallel->outputTemp[w];
+                if (t1.mMixerInFormat == AUDIO_FORMAT_PCM_FLOAT) {
+                    float *sum = reinterpret_cast<float *>(outTemp);
+                    const float *in = reinterpret_cast<const float *>(partial);
+                    for (size_t k = 0; k < job.sampleCount; ++k) {
+                        sum[k] += in[k];
+                    }
+                } else {
+                    for (size_t k = 0; k < job.sampleCount; ++k) {
+                        outTemp[k] += partial[k];
                     }
-                    t.hook(&t, outTemp + outFrames * t.mMixerChannelCount, t.buffer.frameCount,
-                            state->resampleTemp, aux);
-                    outFrames += t.buffer.frameCount;
-                    t.bufferProvider->releaseBuffer(&t.buffer);
                 }
             }
         }
-        convertMixerFormat(out, t1.mMixerFormat,
-                outTemp, t1.mMixerInFormat, numFrames * t1.mMixerChannelCount);
+        convertMixerFormat(t1.mainBuffer, t1.mMixerFormat,
+                outTemp, t1.mMixerInFormat, job.sampleCount);
     }
 }
 
+
 // one track, 16 bits stereo without resampling is the most common case
 void AudioMixer::process__OneTrack16BitsStereoNoResampling(state_t* state,
                                                            int64_t pts)
@@ -1718,15 +1894,24 @@ int64_t AudioMixer::calculateOutputPTS(const track_t& t, int64_t basePTS,
         mixtype == MIXTYPE_MULTI_SAVEONLY ? MIXTYPE_MULTI_SAVEONLY_MONOVOL : mixtype)
 
 /* MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
+ * VECTORIZE   (set to true to use the AudioMixerOpsSimd.h kernels when available)
  * TO: int32_t (Q4.27) or float
  * TI: int32_t (Q4.27) or int16_t (Q0.15) or float
  * TA: int32_t (Q4.27)
  */
-template <int MIXTYPE,
+template <int MIXTYPE, bool VECTORIZE,
         typename TO, typename TI, typename TV, typename TA, typename TAV>
 static void volumeRampMulti(uint32_t channels, TO* out, size_t frameCount,
         const TI* in, TA* aux, TV *vol, const TV *volinc, TAV *vola, TAV volainc)
 {
+    // multichannel tracks use the MONOVOL mixtypes, like the scalar dispatch below.
+    if (VECTORIZE && aux == NULL && (channels <= 2
+            ? MixerSimd<MIXTYPE, TO, TI, TV>::volumeRampMulti(
+                    channels, out, frameCount, in, vol, volinc)
+            : MixerSimd<MIXTYPE_MONOVOL(MIXTYPE), TO, TI, TV>::volumeRampMulti(
+                    channels, out, frameCount, in, vol, volinc))) {
+        return;
+    }
     switch (channels) {
     case 1:
         volumeRampMulti<MIXTYPE, 1>(out, frameCount, in, aux, vol, volinc, vola, volainc);
@@ -1762,15 +1947,23 @@ static void volumeRampMulti(uint32_t channels, TO* out, size_t frameCount,
 }
 
 /* MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
+ * VECTORIZE   (set to true to use the AudioMixerOpsSimd.h kernels when available)
  * TO: int32_t (Q4.27) or float
  * TI: int32_t (Q4.27) or int16_t (Q0.15) or float
  * TA: int32_t (Q4.27)
  */
-template <int MIXTYPE,
+template <int MIXTYPE, bool VECTORIZE,
         typename TO, typename TI, typename TV, typename TA, typename TAV>
 static void volumeMulti(uint32_t channels, TO* out, size_t frameCount,
         const TI* in, TA* aux, const TV *vol, TAV vola)
 {
+    // multichannel tracks use the MONOVOL mixtypes, like the scalar dispatch below.
+    if (VECTORIZE && aux == NULL && (channels <= 2
+            ? MixerSimd<MIXTYPE, TO, TI, TV>::volumeMulti(channels, out, frameCount, in, vol)
+            : MixerSimd<MIXTYPE_MONOVOL(MIXTYPE), TO, TI, TV>::volumeMulti(
+                    channels, out, frameCount, in, vol))) {
+        return;
+    }
     switch (channels) {
     case 1:
         volumeMulti<MIXTYPE, 1>(out, frameCount, in, aux, vol, vola);
@@ -1800,37 +1993,38 @@ static void volumeMulti(uint32_t channels, TO* out, size_t frameCount,
 }
 
 /* MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
+ * VECTORIZE   (set to true to use the AudioMixerOpsSimd.h kernels when available)
  * USEFLOATVOL (set to true if float volume is used)
  * ADJUSTVOL   (set to true if volume ramp parameters needs adjustment afterwards)
  * TO: int32_t (Q4.27) or float
  * TI: int32_t (Q4.27) or int16_t (Q0.15) or float
  * TA: int32_t (Q4.27)
  */
-template <int MIXTYPE, bool USEFLOATVOL, bool ADJUSTVOL,
+template <int MIXTYPE, bool VECTORIZE, bool USEFLOATVOL, bool ADJUSTVOL,
     typename TO, typename TI, typename TA>
 void AudioMixer::volumeMix(TO *out, size_t outFrames,
         const TI *in, TA *aux, bool ramp, AudioMixer::track_t *t)
 {
     if (USEFLOATVOL) {
         if (ramp) {
-            volumeRampMulti<MIXTYPE>(t->mMixerChannelCount, out, outFrames, in, aux,
+            volumeRampMulti<MIXTYPE, VECTORIZE>(t->mMixerChannelCount, out, outFrames, in, aux,
                     t->mPrevVolume, t->mVolumeInc, &t->prevAuxLevel, t->auxInc);
             if (ADJUSTVOL) {
                 t->adjustVolumeRamp(aux != NULL, true);
             }
         } else {
-            volumeMulti<MIXTYPE>(t->mMixerChannelCount, out, outFrames, in, aux,
+            volumeMulti<MIXTYPE, VECTORIZE>(t->mMixerChannelCount, out, outFrames, in, aux,
                     t->mVolume, t->auxLevel);
         }
     } else {
         if (ramp) {
-            volumeRampMulti<MIXTYPE>(t->mMixerChannelCount, out, outFrames, in, aux,
+            volumeRampMulti<MIXTYPE, VECTORIZE>(t->mMixerChannelCount, out, outFrames, in, aux,
                     t->prevVolume, t->volumeInc, &t->prevAuxLevel, t->auxInc);
             if (ADJUSTVOL) {
                 t->adjustVolumeRamp(aux != NULL);
             }
         } else {
-            volumeMulti<MIXTYPE>(t->mMixerChannelCount, out, outFrames, in, aux,
+            volumeMulti<MIXTYPE, VECTORIZE>(t->mMixerChannelCount, out, outFrames, in, aux,
                     t->volume, t->auxLevel);
         }
     }
@@ -1841,11 +2035,12 @@ void AudioMixer::volumeMix(TO *out, size_t outFrames,
  * TODO: Update the hook selection: this can properly handle aux and ramp.
  *
  * MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
+ * VECTORIZE   (set to true to use the AudioMixerOpsSimd.h kernels when available)
  * TO: int32_t (Q4.27) or float
  * TI: int32_t (Q4.27) or int16_t (Q0.15) or float
  * TA: int32_t (Q4.27)
  */
-template <int MIXTYPE, typename TO, typename TI, typename TA>
+template <int MIXTYPE, bool VECTORIZE, typename TO, typename TI, typename TA>
 void AudioMixer::process_NoResampleOneTrack(state_t* state, int64_t pts)
 {
     ALOGVV("process_NoResampleOneTrack\n");
@@ -1878,7 +2073,7 @@ void AudioMixer::process_NoResampleOneTrack(state_t* state, int64_t pts)
         }
 
         const size_t outFrames = b.frameCount;
-        volumeMix<MIXTYPE, is_same<TI, float>::value, false> (
+        volumeMix<MIXTYPE, VECTORIZE, is_same<TI, float>::value, false> (
                 out, outFrames, in, aux, ramp, t);
 
         out += outFrames * channels;
@@ -1899,11 +2094,12 @@ void AudioMixer::process_NoResampleOneTrack(state_t* state, int64_t pts)
  * pulling from the track's upstream AudioBufferProvider.
  *
  * MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
+ * VECTORIZE   (set to true to use the AudioMixerOpsSimd.h kernels when available)
  * TO: int32_t (Q4.27) or float
  * TI: int32_t (Q4.27) or int16_t (Q0.15) or float
  * TA: int32_t (Q4.27)
  */
-template <int MIXTYPE, typename TO, typename TI, typename TA>
+template <int MIXTYPE, bool VECTORIZE, typename TO, typename TI, typename TA>
 void AudioMixer::track__Resample(track_t* t, TO* out, size_t outFrameCount, TO* temp, TA* aux)
 {
     ALOGVV("track__Resample\n");
@@ -1917,7 +2113,7 @@ void AudioMixer::track__Resample(track_t* t, TO* out, size_t outFrameCount, TO*
         memset(temp, 0, outFrameCount * t->mMixerChannelCount * sizeof(TO));
         t->resampler->resample((int32_t*)temp, outFrameCount, t->bufferProvider);
 
-        volumeMix<MIXTYPE, is_same<TI, float>::value, true>(
+        volumeMix<MIXTYPE, VECTORIZE, is_same<TI, float>::value, true>(
                 out, outFrameCount, temp, aux, ramp, t);
 
     } else { // constant volume gain
@@ -1930,18 +2126,19 @@ void AudioMixer::track__Resample(track_t* t, TO* out, size_t outFrameCount, TO*
  * The input buffer should be present in t->in.
  *
  * MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
+ * VECTORIZE   (set to true to use the AudioMixerOpsSimd.h kernels when available)
  * TO: int32_t (Q4.27) or float
  * TI: int32_t (Q4.27) or int16_t (Q0.15) or float
  * TA: int32_t (Q4.27)
  */
-template <int MIXTYPE, typename TO, typename TI, typename TA>
+template <int MIXTYPE, bool VECTORIZE, typename TO, typename TI, typename TA>
 void AudioMixer::track__NoResample(track_t* t, TO* out, size_t frameCount,
         TO* temp __unused, TA* aux)
 {
     ALOGVV("track__NoResample\n");
     const TI *in = static_cast<const TI *>(t->in);
 
-    volumeMix<MIXTYPE, is_same<TI, float>::value, true>(
+    volumeMix<MIXTYPE, VECTORIZE, is_same<TI, float>::value, true>(
             out, frameCount, in, aux, t->needsRamp(), t);
 
     // MIXTYPE_MONOEXPAND reads a single input channel and expands to NCHAN output channels.
@@ -1994,7 +2191,7 @@ void AudioMixer::convertMixerFormat(void *out, audio_format_t mixerOutFormat,
 /* Returns the proper track hook to use for mixing the track into the output buffer.
  */
 AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount,
-        audio_format_t mixerInFormat, audio_format_t mixerOutFormat __unused)
+        audio_format_t mixerInFormat, audio_format_t mixerOutFormat)
 {
     if (!kUseNewMixer && channelCount == FCC_2 && mixerInFormat == AUDIO_FORMAT_PCM_16_BIT) {
         switch (trackType) {
@@ -2011,6 +2208,19 @@ AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount
             break;
         }
     }
+    return sUseVectorMixing
+            ? selectTrackHook<true>(trackType, channelCount, mixerInFormat, mixerOutFormat)
+            : selectTrackHook<false>(trackType, channelCount, mixerInFormat, mixerOutFormat);
+}
+
+/* Returns the multi-format track hook, see getTrackHook().
+ *
+ * VECTORIZE   (set to true to use the AudioMixerOpsSimd.h kernels when available)
+ */
+template <bool VECTORIZE>
+AudioMixer::hook_t AudioMixer::selectTrackHook(int trackType, uint32_t channelCount,
+        audio_format_t mixerInFormat, audio_format_t mixerOutFormat __unused)
+{
     LOG_ALWAYS_FATAL_IF(channelCount > MAX_NUM_CHANNELS);
     switch (trackType) {
     case TRACKTYPE_NOP:
@@ -2019,10 +2229,10 @@ AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount
         switch (mixerInFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
             return (AudioMixer::hook_t)
-                    track__Resample<MIXTYPE_MULTI, float /*TO*/, float /*TI*/, int32_t /*TA*/>;
+                    track__Resample<MIXTYPE_MULTI, VECTORIZE, float /*TO*/, float /*TI*/, int32_t /*TA*/>;
         case AUDIO_FORMAT_PCM_16_BIT:
             return (AudioMixer::hook_t)\
-                    track__Resample<MIXTYPE_MULTI, int32_t, int16_t, int32_t>;
+                    track__Resample<MIXTYPE_MULTI, VECTORIZE, int32_t, int16_t, int32_t>;
         default:
             LOG_ALWAYS_FATAL("bad mixerInFormat: %#x", mixerInFormat);
             break;
@@ -2032,10 +2242,10 @@ AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount
         switch (mixerInFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
             return (AudioMixer::hook_t)
-                    track__NoResample<MIXTYPE_MONOEXPAND, float, float, int32_t>;
+                    track__NoResample<MIXTYPE_MONOEXPAND, VECTORIZE, float, float, int32_t>;
         case AUDIO_FORMAT_PCM_16_BIT:
             return (AudioMixer::hook_t)
-                    track__NoResample<MIXTYPE_MONOEXPAND, int32_t, int16_t, int32_t>;
+                    track__NoResample<MIXTYPE_MONOEXPAND, VECTORIZE, int32_t, int16_t, int32_t>;
         default:
             LOG_ALWAYS_FATAL("bad mixerInFormat: %#x", mixerInFormat);
             break;
@@ -2045,10 +2255,10 @@ AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount
         switch (mixerInFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
             return (AudioMixer::hook_t)
-                    track__NoResample<MIXTYPE_MULTI, float, float, int32_t>;
+                    track__NoResample<MIXTYPE_MULTI, VECTORIZE, float, float, int32_t>;
         case AUDIO_FORMAT_PCM_16_BIT:
             return (AudioMixer::hook_t)
-                    track__NoResample<MIXTYPE_MULTI, int32_t, int16_t, int32_t>;
+                    track__NoResample<MIXTYPE_MULTI, VECTORIZE, int32_t, int16_t, int32_t>;
         default:
             LOG_ALWAYS_FATAL("bad mixerInFormat: %#x", mixerInFormat);
             break;
@@ -2078,15 +2288,28 @@ AudioMixer::process_hook_t AudioMixer::getProcessHook(int processType, uint32_t
     if (!kUseNewMixer && channelCount == FCC_2 && mixerInFormat == AUDIO_FORMAT_PCM_16_BIT) {
         return process__OneTrack16BitsStereoNoResampling;
     }
+    return sUseVectorMixing
+            ? selectProcessHook<true>(processType, channelCount, mixerInFormat, mixerOutFormat)
+            : selectProcessHook<false>(processType, channelCount, mixerInFormat, mixerOutFormat);
+}
+
+/* Returns the multi-format process hook, see getProcessHook().
+ *
+ * VECTORIZE   (set to true to use the AudioMixerOpsSimd.h kernels when available)
+ */
+template <bool VECTORIZE>
+AudioMixer::process_hook_t AudioMixer::selectProcessHook(int processType __unused,
+        uint32_t channelCount, audio_format_t mixerInFormat, audio_format_t mixerOutFormat)
+{
     LOG_ALWAYS_FATAL_IF(channelCount > MAX_NUM_CHANNELS);
     switch (mixerInFormat) {
     case AUDIO_FORMAT_PCM_FLOAT:
         switch (mixerOutFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
-            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY,
+            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY, VECTORIZE,
                     float /*TO*/, float /*TI*/, int32_t /*TA*/>;
         case AUDIO_FORMAT_PCM_16_BIT:
-            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY,
+            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY, VECTORIZE,
                     int16_t, float, int32_t>;
         default:
             LOG_ALWAYS_FATAL("bad mixerOutFormat: %#x", mixerOutFormat);
@@ -2096,10 +2319,10 @@ AudioMixer::process_hook_t AudioMixer::getProcessHook(int processType, uint32_t
     case AUDIO_FORMAT_PCM_16_BIT:
         switch (mixerOutFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
-            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY,
+            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY, VECTORIZE,
                     float, int16_t, int32_t>;
         case AUDIO_FORMAT_PCM_16_BIT:
-            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY,
+            return process_NoResampleOneTrack<MIXTYPE_MULTI_SAVEONLY, VECTORIZE,
                     int16_t, int16_t, int32_t>;
         default:
             LOG_ALWAYS_FATAL("bad mixerOutFormat: %#x", mixerOutFormat);
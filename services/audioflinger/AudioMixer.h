@@ -31,6 +31,7 @@
 
 #include "AudioResampler.h"
 #include "BufferProviders.h"
+#include "MixerWorkerPool.h"
 
 // FIXME This is actually unity gain, which might not be max in future, expressed in U.12
 #define MAX_GAIN_INT AudioMixer::UNITY_GAIN_INT
@@ -132,6 +133,26 @@ public:
 
     size_t      getUnreleasedFrames(int name) const;
 
+    // Enable or disable the vectorized (NEON or SSE) mixing kernels in AudioMixerOpsSimd.h
+    // for all mixers in this process.  Enabled by default when the target supports them.
+    // Takes effect the next time the hooks of a mixer are validated; disabling them gives
+    // the scalar reference output, for example to compare against in test-mixer.
+    static void setVectorMixing(bool enable) { sUseVectorMixing = enable; }
+    static bool isVectorMixing() { return sUseVectorMixing; }
+
+    // Split the tracks sharing a main buffer over numThreads worker threads at the given
+    // priority, in addition to the calling thread, once at least kMinParallelTracks tracks
+    // are enabled.  Each worker mixes into its own buffer and the partial mixes are summed.
+    // numThreads == 0 (the default) disables parallel mixing.
+    void        setParallelMixing(uint32_t numThreads, int priority);
+
+    // Dump the per-worker mix times of the parallel mode, if enabled.
+    // budgetUs is the mix deadline to compare against, or 0.
+    void        dumpParallelMixing(int fd, uint32_t budgetUs) const;
+
+    // minimum number of enabled tracks for parallel mixing to be used
+    static const uint32_t kMinParallelTracks = 8;
+
     static inline bool isValidPcmTrackFormat(audio_format_t format) {
         switch (format) {
         case AUDIO_FORMAT_PCM_8_BIT:
@@ -229,7 +250,9 @@ private:
          *    requires reformat. For example, it may convert floating point input to
          *    PCM_16_bit if that's required by the downmixer.
          * 3) downmixerBufferProvider: If not NULL, performs the channel remixing to match
-         *    the number of channels required by the mixer sink.
+         *    the number of channels required by the mixer sink. A RemixBufferProvider
+         *    also converts 16 bit and float input itself, in which case there is no
+         *    mReformatBufferProvider (see mRemixInputFormat).
          * 4) mPostDownmixReformatBufferProvider: If not NULL, performs reformatting from
          *    the downmixer requirements to the mixer engine input requirements.
          * 5) mTimestretchBufferProvider: Adds timestretching for playback rate
@@ -249,6 +272,8 @@ private:
         audio_format_t mDownmixRequiresFormat;  // required downmixer format
                                                 // AUDIO_FORMAT_PCM_16_BIT if 16 bit necessary
                                                 // AUDIO_FORMAT_INVALID if no required format
+        audio_format_t mRemixInputFormat;       // input format of the RemixBufferProvider
+                                                // AUDIO_FORMAT_INVALID if not remixing
 
         float          mVolume[MAX_NUM_VOLUMES];     // floating point set volume
         float          mPrevVolume[MAX_NUM_VOLUMES]; // floating point previous volume
@@ -281,6 +306,13 @@ private:
 
     typedef void (*process_hook_t)(state_t* state, int64_t pts);
 
+    // per-worker buffers for parallel mixing, worker 0 uses state_t outputTemp and resampleTemp
+    struct parallel_t {
+        MixerWorkerPool* pool;
+        int32_t*         outputTemp[MixerWorkerPool::MAX_WORKERS];
+        int32_t*         resampleTemp[MixerWorkerPool::MAX_WORKERS];
+    };
+
     // pad to 32-bytes to fill cache line
     struct state_t {
         uint32_t        enabledTracks;
@@ -290,7 +322,7 @@ private:
         int32_t         *outputTemp;
         int32_t         *resampleTemp;
         NBLog::Writer*  mLog;
-        int32_t         reserved[1];
+        parallel_t*     parallel;   // NULL unless setParallelMixing() enabled it
         // FIXME allocate dynamically to save some memory when maxNumTracks < MAX_NUM_TRACKS
         track_t         tracks[MAX_NUM_TRACKS] __attribute__((aligned(32)));
     };
@@ -335,38 +367,45 @@ private:
     static void process__genericResampling(state_t* state, int64_t pts);
     static void process__OneTrack16BitsStereoNoResampling(state_t* state,
                                                           int64_t pts);
+    static void process__parallelResampling(state_t* state, int64_t pts);
+
+    static void mixTrack(track_t& t, int32_t* outTemp, int32_t* resampleTemp,
+                         size_t numFrames, int64_t pts);
+    static void mixTracksJob(void *cookie, uint32_t index);
 
     static int64_t calculateOutputPTS(const track_t& t, int64_t basePTS,
                                       int outputFrameIndex);
 
     static uint64_t         sLocalTimeFreq;
     static pthread_once_t   sOnceControl;
+    static bool             sUseVectorMixing;
     static void             sInitRoutine();
 
     /* multi-format volume mixing function (calls template functions
      * in AudioMixerOps.h).  The template parameters are as follows:
      *
      *   MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
+     *   VECTORIZE   (set to true to use the AudioMixerOpsSimd.h kernels when available)
      *   USEFLOATVOL (set to true if float volume is used)
      *   ADJUSTVOL   (set to true if volume ramp parameters needs adjustment afterwards)
      *   TO: int32_t (Q4.27) or float
      *   TI: int32_t (Q4.27) or int16_t (Q0.15) or float
      *   TA: int32_t (Q4.27)
      */
-    template <int MIXTYPE, bool USEFLOATVOL, bool ADJUSTVOL,
+    template <int MIXTYPE, bool VECTORIZE, bool USEFLOATVOL, bool ADJUSTVOL,
         typename TO, typename TI, typename TA>
     static void volumeMix(TO *out, size_t outFrames,
             const TI *in, TA *aux, bool ramp, AudioMixer::track_t *t);
 
     // multi-format process hooks
-    template <int MIXTYPE, typename TO, typename TI, typename TA>
+    template <int MIXTYPE, bool VECTORIZE, typename TO, typename TI, typename TA>
     static void process_NoResampleOneTrack(state_t* state, int64_t pts);
 
     // multi-format track hooks
-    template <int MIXTYPE, typename TO, typename TI, typename TA>
+    template <int MIXTYPE, bool VECTORIZE, typename TO, typename TI, typename TA>
     static void track__Resample(track_t* t, TO* out, size_t frameCount,
             TO* temp __unused, TA* aux);
-    template <int MIXTYPE, typename TO, typename TI, typename TA>
+    template <int MIXTYPE, bool VECTORIZE, typename TO, typename TI, typename TA>
     static void track__NoResample(track_t* t, TO* out, size_t frameCount,
             TO* temp __unused, TA* aux);
 
@@ -389,6 +428,12 @@ private:
             audio_format_t mixerInFormat, audio_format_t mixerOutFormat);
     static hook_t getTrackHook(int trackType, uint32_t channelCount,
             audio_format_t mixerInFormat, audio_format_t mixerOutFormat);
+    template <bool VECTORIZE>
+    static process_hook_t selectProcessHook(int processType, uint32_t channelCount,
+            audio_format_t mixerInFormat, audio_format_t mixerOutFormat);
+    template <bool VECTORIZE>
+    static hook_t selectTrackHook(int trackType, uint32_t channelCount,
+            audio_format_t mixerInFormat, audio_format_t mixerOutFormat);
 };
 
 // ----------------------------------------------------------------------------
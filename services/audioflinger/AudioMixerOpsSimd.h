@@ -0,0 +1,516 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MIXER_OPS_SIMD_H
+#define ANDROID_AUDIO_MIXER_OPS_SIMD_H
+
+#include <string.h>
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_MIXER_NEON (true)
+#define USE_MIXER_SSE (false)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_MIXER_NEON (false)
+#define USE_MIXER_SSE (true)
+#else
+#define USE_MIXER_NEON (false)
+#define USE_MIXER_SSE (false)
+#endif
+
+namespace android {
+
+// depends on AudioMixerOps.h
+
+/* Vector kernels for the most common volumeMulti() and volumeRampMulti() cases.
+ *
+ * MixerSimd<MIXTYPE, TO, TI, TV>::volumeMulti() and ::volumeRampMulti() return true
+ * if the mix was done, and false if the caller must fall back to the scalar templates
+ * in AudioMixerOps.h.  Only mixes without an aux buffer are handled:
+ *
+ *   stereo MIXTYPE_MULTI, MIXTYPE_MULTI_SAVEONLY and MIXTYPE_MONOEXPAND,
+ *   multichannel (4 to 8 channels) MIXTYPE_MULTI_MONOVOL and MIXTYPE_MULTI_SAVEONLY_MONOVOL,
+ *
+ * for <TO, TI, TV> equal to <float, float, float>, <int32_t, int16_t, int16_t>,
+ * <int32_t, int16_t, int32_t>, <int16_t, int16_t, int16_t> and <int16_t, int16_t, int32_t>.
+ *
+ * The results are bit-exact with respect to the scalar path: the integer kernels
+ * compute the same 16x16 -> 32 bit products, and the float kernels perform the same
+ * multiply then add (no fused multiply-add), with ramp volumes advanced one frame
+ * at a time exactly as in volumeRampMulti().
+ */
+
+static const bool kMixerSimdAvailable = USE_MIXER_NEON || USE_MIXER_SSE;
+
+template <int MIXTYPE, typename TO, typename TI, typename TV>
+struct MixerSimd {
+    static inline bool volumeMulti(uint32_t channels __unused, TO* out __unused,
+            size_t frameCount __unused, const TI* in __unused, const TV *vol __unused) {
+        return false;
+    }
+    static inline bool volumeRampMulti(uint32_t channels __unused, TO* out __unused,
+            size_t frameCount __unused, const TI* in __unused, TV *vol __unused,
+            const TV *volinc __unused) {
+        return false;
+    }
+};
+
+#if USE_MIXER_NEON || USE_MIXER_SSE
+
+// Mapping of MIXTYPE to the kernel behavior.
+template <int MIXTYPE>
+struct MixTypeTraits {
+    // output is stored instead of accumulated
+    static const bool kSaveOnly = MIXTYPE == MIXTYPE_MULTI_SAVEONLY
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_MONOVOL;
+    // a single volume is applied to all channels
+    static const bool kMonoVol = MIXTYPE == MIXTYPE_MULTI_MONOVOL
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_MONOVOL;
+};
+
+#if USE_MIXER_NEON
+
+typedef float32x4_t mixer_vf4_t;   // 4 float samples or volumes
+typedef int16x4_t mixer_vi16x4_t;  // 4 int16_t samples or U4.12 volumes
+
+static inline mixer_vf4_t mixer_load_f4(const float *in) { return vld1q_f32(in); }
+static inline mixer_vf4_t mixer_dup_f4(float v) { return vdupq_n_f32(v); }
+static inline mixer_vf4_t mixer_pair_f4(float v0, float v1) {
+    const float v[4] = { v0, v1, v0, v1 };
+    return vld1q_f32(v);
+}
+
+// Returns { in[0], in[0], in[1], in[1] }.
+static inline mixer_vf4_t mixer_expand_f4(const float *in) {
+    const float32x2_t x = vld1_f32(in);
+    const float32x2x2_t z = vzip_f32(x, x);
+    return vcombine_f32(z.val[0], z.val[1]);
+}
+
+template <bool SAVEONLY>
+static inline void mixer_mix_f4(float *out, mixer_vf4_t in, mixer_vf4_t vol) {
+    const float32x4_t prod = vmulq_f32(in, vol);
+    vst1q_f32(out, SAVEONLY ? prod : vaddq_f32(vld1q_f32(out), prod));
+}
+
+// Stereo float ramp, two frames at a time; { lo, hi } are the volumes of the next two frames.
+struct mixer_ramp_f2_t {
+    float32x2_t lo;
+    float32x2_t inc;
+
+    mixer_ramp_f2_t(const float *vol, const float *volinc)
+        : lo(vld1_f32(vol)), inc(vld1_f32(volinc)) { }
+    inline mixer_vf4_t next() {
+        const float32x2_t hi = vadd_f32(lo, inc);
+        const float32x4_t v = vcombine_f32(lo, hi);
+        lo = vadd_f32(hi, inc);
+        return v;
+    }
+    inline void save(float *vol) const { vst1_f32(vol, lo); }
+};
+
+static inline mixer_vi16x4_t mixer_load_i16x4(const int16_t *in) { return vld1_s16(in); }
+static inline mixer_vi16x4_t mixer_dup_i16x4(int16_t v) { return vdup_n_s16(v); }
+static inline mixer_vi16x4_t mixer_pair_i16x4(int16_t v0, int16_t v1) {
+    const int16_t v[4] = { v0, v1, v0, v1 };
+    return vld1_s16(v);
+}
+
+// Returns { in[0], in[0], in[1], in[1] }.
+static inline mixer_vi16x4_t mixer_expand_i16x4(const int16_t *in) {
+    int16_t v[4];
+    v[0] = v[1] = in[0];
+    v[2] = v[3] = in[1];
+    return vld1_s16(v);
+}
+
+// out (Q4.27) += in (Q0.15) * vol (U4.12)
+static inline void mixer_mix_i32(int32_t *out, mixer_vi16x4_t in, mixer_vi16x4_t vol,
+        bool saveOnly) {
+    const int32x4_t prod = vmull_s16(in, vol);
+    vst1q_s32(out, saveOnly ? prod : vaddq_s32(vld1q_s32(out), prod));
+}
+
+// out (Q0.15) = clamp16(in (Q0.15) * vol (U4.12) >> 12)
+static inline void mixer_save_i16(int16_t *out, mixer_vi16x4_t in, mixer_vi16x4_t vol) {
+    vst1_s16(out, vqshrn_n_s32(vmull_s16(in, vol), 12));
+}
+
+// Stereo U4.28 ramp, two frames at a time, returned as the U4.12 volumes used by MixMul().
+struct mixer_ramp_i2_t {
+    int32x2_t lo;
+    int32x2_t inc;
+
+    mixer_ramp_i2_t(const int32_t *vol, const int32_t *volinc)
+        : lo(vld1_s32(vol)), inc(vld1_s32(volinc)) { }
+    inline mixer_vi16x4_t next() {
+        const int32x2_t hi = vadd_s32(lo, inc);
+        // (vol >> 16) always fits in int16_t, so the narrowing is exact.
+        const int16x4_t v = vshrn_n_s32(vcombine_s32(lo, hi), 16);
+        lo = vadd_s32(hi, inc);
+        return v;
+    }
+    inline void save(int32_t *vol) const { vst1_s32(vol, lo); }
+};
+
+#else // USE_MIXER_SSE
+
+typedef __m128 mixer_vf4_t;     // 4 float samples or volumes
+typedef __m128i mixer_vi16x4_t; // 4 int16_t samples or U4.12 volumes in the low 64 bits
+
+static inline mixer_vf4_t mixer_load_f4(const float *in) { return _mm_loadu_ps(in); }
+static inline mixer_vf4_t mixer_dup_f4(float v) { return _mm_set1_ps(v); }
+static inline mixer_vf4_t mixer_pair_f4(float v0, float v1) {
+    return _mm_setr_ps(v0, v1, v0, v1);
+}
+
+// Returns { in[0], in[0], in[1], in[1] }.
+static inline mixer_vf4_t mixer_expand_f4(const float *in) {
+    const __m128 x = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)in);
+    return _mm_unpacklo_ps(x, x);
+}
+
+template <bool SAVEONLY>
+static inline void mixer_mix_f4(float *out, mixer_vf4_t in, mixer_vf4_t vol) {
+    const __m128 prod = _mm_mul_ps(in, vol);
+    _mm_storeu_ps(out, SAVEONLY ? prod : _mm_add_ps(_mm_loadu_ps(out), prod));
+}
+
+// Stereo float ramp, two frames at a time; the low and high halves are the
+// volumes of the next two frames.
+struct mixer_ramp_f2_t {
+    __m128 lo;
+    __m128 inc;
+
+    mixer_ramp_f2_t(const float *vol, const float *volinc)
+        : lo(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)vol))
+        , inc(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)volinc)) { }
+    inline mixer_vf4_t next() {
+        const __m128 hi = _mm_add_ps(lo, inc);
+        const __m128 v = _mm_movelh_ps(lo, hi);
+        lo = _mm_add_ps(hi, inc);
+        return v;
+    }
+    inline void save(float *vol) const { _mm_storel_pi((__m64 *)vol, lo); }
+};
+
+static inline mixer_vi16x4_t mixer_load_i16x4(const int16_t *in) {
+    return _mm_loadl_epi64((const __m128i *)in);
+}
+static inline mixer_vi16x4_t mixer_dup_i16x4(int16_t v) { return _mm_set1_epi16(v); }
+static inline mixer_vi16x4_t mixer_pair_i16x4(int16_t v0, int16_t v1) {
+    return _mm_setr_epi16(v0, v1, v0, v1, 0, 0, 0, 0);
+}
+
+// Returns { in[0], in[0], in[1], in[1] }.
+static inline mixer_vi16x4_t mixer_expand_i16x4(const int16_t *in) {
+    int32_t pair;
+    memcpy(&pair, in, sizeof(pair)); // in is only guaranteed to be 16 bit aligned
+    const __m128i x = _mm_cvtsi32_si128(pair);
+    return _mm_unpacklo_epi16(x, x);
+}
+
+// Full 32 bit products of the low 4 int16_t lanes.
+static inline __m128i mixer_mull_i16x4(mixer_vi16x4_t in, mixer_vi16x4_t vol) {
+    return _mm_unpacklo_epi16(_mm_mullo_epi16(in, vol), _mm_mulhi_epi16(in, vol));
+}
+
+// out (Q4.27) += in (Q0.15) * vol (U4.12)
+static inline void mixer_mix_i32(int32_t *out, mixer_vi16x4_t in, mixer_vi16x4_t vol,
+        bool saveOnly) {
+    const __m128i prod = mixer_mull_i16x4(in, vol);
+    _mm_storeu_si128((__m128i *)out, saveOnly ? prod
+            : _mm_add_epi32(_mm_loadu_si128((const __m128i *)out), prod));
+}
+
+// out (Q0.15) = clamp16(in (Q0.15) * vol (U4.12) >> 12)
+static inline void mixer_save_i16(int16_t *out, mixer_vi16x4_t in, mixer_vi16x4_t vol) {
+    const __m128i prod = _mm_srai_epi32(mixer_mull_i16x4(in, vol), 12);
+    _mm_storel_epi64((__m128i *)out, _mm_packs_epi32(prod, prod));
+}
+
+// Stereo U4.28 ramp, two frames at a time, returned as the U4.12 volumes used by MixMul().
+struct mixer_ramp_i2_t {
+    __m128i lo;
+    __m128i inc;
+
+    mixer_ramp_i2_t(const int32_t *vol, const int32_t *volinc)
+        : lo(_mm_loadl_epi64((const __m128i *)vol))
+        , inc(_mm_loadl_epi64((const __m128i *)volinc)) { }
+    inline mixer_vi16x4_t next() {
+        const __m128i hi = _mm_add_epi32(lo, inc);
+        // (vol >> 16) always fits in int16_t, so the saturating pack is exact.
+        const __m128i v = _mm_srai_epi32(_mm_unpacklo_epi64(lo, hi), 16);
+        lo = _mm_add_epi32(hi, inc);
+        return _mm_packs_epi32(v, v);
+    }
+    inline void save(int32_t *vol) const { _mm_storel_epi64((__m128i *)vol, lo); }
+};
+
+#endif // USE_MIXER_SSE
+
+// Number of samples mixed per vector operation.
+static const size_t kMixerSimdLanes = 4;
+
+/* Float input, float output, float volume.
+ */
+template <int MIXTYPE>
+struct MixerSimd<MIXTYPE, float, float, float> {
+    typedef MixTypeTraits<MIXTYPE> traits;
+
+    static inline bool volumeMulti(uint32_t channels, float* out, size_t frameCount,
+            const float* in, const float *vol) {
+        if (channels == 2 && MIXTYPE == MIXTYPE_MONOEXPAND) {
+            const mixer_vf4_t v = mixer_pair_f4(vol[0], vol[1]);
+            for (; frameCount >= 2; frameCount -= 2, in += 2, out += 4) {
+                mixer_mix_f4<false>(out, mixer_expand_f4(in), v);
+            }
+            if (frameCount != 0) {
+                out[0] += in[0] * vol[0];
+                out[1] += in[0] * vol[1];
+            }
+            return true;
+        }
+        if (!(channels == 2 && (MIXTYPE == MIXTYPE_MULTI || MIXTYPE == MIXTYPE_MULTI_SAVEONLY))
+                && !(channels >= kMixerSimdLanes && traits::kMonoVol)) {
+            return false;
+        }
+        // a stereo volume pair repeats every 2 samples, so it is aligned to the vector.
+        const size_t volMask = traits::kMonoVol ? 0 : 1;
+        const mixer_vf4_t v = traits::kMonoVol
+                ? mixer_dup_f4(vol[0]) : mixer_pair_f4(vol[0], vol[1]);
+        size_t count = frameCount * channels;
+        for (; count >= kMixerSimdLanes; count -= kMixerSimdLanes) {
+            mixer_mix_f4<traits::kSaveOnly>(out, mixer_load_f4(in), v);
+            in += kMixerSimdLanes;
+            out += kMixerSimdLanes;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const float prod = in[i] * vol[i & volMask];
+            out[i] = traits::kSaveOnly ? prod : out[i] + prod;
+        }
+        return true;
+    }
+
+    static inline bool volumeRampMulti(uint32_t channels, float* out, size_t frameCount,
+            const float* in, float *vol, const float *volinc) {
+        if (channels == 2 && (MIXTYPE == MIXTYPE_MULTI || MIXTYPE == MIXTYPE_MULTI_SAVEONLY)) {
+            mixer_ramp_f2_t ramp(vol, volinc);
+            for (; frameCount >= 2; frameCount -= 2, in += 4, out += 4) {
+                mixer_mix_f4<traits::kSaveOnly>(out, mixer_load_f4(in), ramp.next());
+            }
+            ramp.save(vol);
+            if (frameCount != 0) {
+                for (int i = 0; i < 2; ++i) {
+                    const float prod = in[i] * vol[i];
+                    out[i] = traits::kSaveOnly ? prod : out[i] + prod;
+                    vol[i] += volinc[i];
+                }
+            }
+            return true;
+        }
+        if (!(channels >= kMixerSimdLanes && traits::kMonoVol)) {
+            return false;
+        }
+        do {
+            const mixer_vf4_t v = mixer_dup_f4(vol[0]);
+            uint32_t i = 0;
+            for (; i + kMixerSimdLanes <= channels; i += kMixerSimdLanes) {
+                mixer_mix_f4<traits::kSaveOnly>(out + i, mixer_load_f4(in + i), v);
+            }
+            for (; i < channels; ++i) {
+                const float prod = in[i] * vol[0];
+                out[i] = traits::kSaveOnly ? prod : out[i] + prod;
+            }
+            in += channels;
+            out += channels;
+            vol[0] += volinc[0];
+        } while (--frameCount);
+        return true;
+    }
+};
+
+/* int16_t input, Q4.27 int32_t output.  TV is either int16_t (U4.12, constant volume)
+ * or int32_t (U4.28, ramp volume); both are applied as U4.12 16 bit multiplies.
+ */
+template <int MIXTYPE, typename TV>
+struct MixerSimdInt16 {
+    typedef MixTypeTraits<MIXTYPE> traits;
+
+    static inline void mix(int32_t *out, mixer_vi16x4_t in, mixer_vi16x4_t vol) {
+        mixer_mix_i32(out, in, vol, traits::kSaveOnly);
+    }
+    // int16_t output is only used by the MIXTYPE_MULTI_SAVEONLY one track process hook.
+    static inline void mix(int16_t *out, mixer_vi16x4_t in, mixer_vi16x4_t vol) {
+        mixer_save_i16(out, in, vol);
+    }
+
+    static inline int16_t u4_12(int16_t vol) { return vol; }
+    static inline int16_t u4_12(int32_t vol) { return vol >> 16; }
+
+    template <typename TO>
+    static inline void mixScalar(TO *out, int16_t in, TV vol) {
+        if (traits::kSaveOnly) {
+            *out = MixMul<TO, int16_t, TV>(in, vol);
+        } else {
+            *out += MixMul<TO, int16_t, TV>(in, vol);
+        }
+    }
+
+    template <typename TO>
+    static inline bool volumeMulti(uint32_t channels, TO* out, size_t frameCount,
+            const int16_t* in, const TV *vol) {
+        if (channels == 2 && MIXTYPE == MIXTYPE_MONOEXPAND) {
+            if (!is_same<TO, int32_t>::value) {
+                return false;
+            }
+            const mixer_vi16x4_t v = mixer_pair_i16x4(u4_12(vol[0]), u4_12(vol[1]));
+            for (; frameCount >= 2; frameCount -= 2, in += 2, out += 4) {
+                mix(out, mixer_expand_i16x4(in), v);
+            }
+            if (frameCount != 0) {
+                mixScalar(&out[0], in[0], vol[0]);
+                mixScalar(&out[1], in[0], vol[1]);
+            }
+            return true;
+        }
+        if (!(channels == 2 && (MIXTYPE == MIXTYPE_MULTI || MIXTYPE == MIXTYPE_MULTI_SAVEONLY))
+                && !(channels >= kMixerSimdLanes && traits::kMonoVol)) {
+            return false;
+        }
+        const size_t volMask = traits::kMonoVol ? 0 : 1;
+        const mixer_vi16x4_t v = traits::kMonoVol
+                ? mixer_dup_i16x4(u4_12(vol[0])) : mixer_pair_i16x4(u4_12(vol[0]), u4_12(vol[1]));
+        size_t count = frameCount * channels;
+        for (; count >= kMixerSimdLanes; count -= kMixerSimdLanes) {
+            mix(out, mixer_load_i16x4(in), v);
+            in += kMixerSimdLanes;
+            out += kMixerSimdLanes;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            mixScalar(&out[i], in[i], vol[i & volMask]);
+        }
+        return true;
+    }
+
+    template <typename TO>
+    static inline bool volumeRampMulti(uint32_t channels, TO* out, size_t frameCount,
+            const int16_t* in, int32_t *vol, const int32_t *volinc) {
+        if (channels == 2 && (MIXTYPE == MIXTYPE_MULTI || MIXTYPE == MIXTYPE_MULTI_SAVEONLY)) {
+            mixer_ramp_i2_t ramp(vol, volinc);
+            for (; frameCount >= 2; frameCount -= 2, in += 4, out += 4) {
+                mix(out, mixer_load_i16x4(in), ramp.next());
+            }
+            ramp.save(vol);
+            if (frameCount != 0) {
+                for (int i = 0; i < 2; ++i) {
+                    mixScalar(&out[i], in[i], vol[i]);
+                    vol[i] += volinc[i];
+                }
+            }
+            return true;
+        }
+        if (!(channels >= kMixerSimdLanes && traits::kMonoVol)) {
+            return false;
+        }
+        do {
+            const mixer_vi16x4_t v = mixer_dup_i16x4(u4_12(vol[0]));
+            uint32_t i = 0;
+            for (; i + kMixerSimdLanes <= channels; i += kMixerSimdLanes) {
+                mix(out + i, mixer_load_i16x4(in + i), v);
+            }
+            for (; i < channels; ++i) {
+                mixScalar(&out[i], in[i], vol[0]);
+            }
+            in += channels;
+            out += channels;
+            vol[0] += volinc[0];
+        } while (--frameCount);
+        return true;
+    }
+};
+
+template <int MIXTYPE>
+struct MixerSimd<MIXTYPE, int32_t, int16_t, int16_t> {
+    static inline bool volumeMulti(uint32_t channels, int32_t* out, size_t frameCount,
+            const int16_t* in, const int16_t *vol) {
+        return MixerSimdInt16<MIXTYPE, int16_t>::volumeMulti(
+                channels, out, frameCount, in, vol);
+    }
+    static inline bool volumeRampMulti(uint32_t channels __unused, int32_t* out __unused,
+            size_t frameCount __unused, const int16_t* in __unused, int16_t *vol __unused,
+            const int16_t *volinc __unused) {
+        return false; // ramps use U4.28 volumes
+    }
+};
+
+template <int MIXTYPE>
+struct MixerSimd<MIXTYPE, int32_t, int16_t, int32_t> {
+    static inline bool volumeMulti(uint32_t channels, int32_t* out, size_t frameCount,
+            const int16_t* in, const int32_t *vol) {
+        return MixerSimdInt16<MIXTYPE, int32_t>::volumeMulti(
+                channels, out, frameCount, in, vol);
+    }
+    static inline bool volumeRampMulti(uint32_t channels, int32_t* out, size_t frameCount,
+            const int16_t* in, int32_t *vol, const int32_t *volinc) {
+        return MixerSimdInt16<MIXTYPE, int32_t>::volumeRampMulti(
+                channels, out, frameCount, in, vol, volinc);
+    }
+};
+
+template <int MIXTYPE>
+struct MixerSimd<MIXTYPE, int16_t, int16_t, int16_t> {
+    static inline bool volumeMulti(uint32_t channels, int16_t* out, size_t frameCount,
+            const int16_t* in, const int16_t *vol) {
+        if (!MixTypeTraits<MIXTYPE>::kSaveOnly) {
+            return false;
+        }
+        return MixerSimdInt16<MIXTYPE, int16_t>::volumeMulti(
+                channels, out, frameCount, in, vol);
+    }
+    static inline bool volumeRampMulti(uint32_t channels __unused, int16_t* out __unused,
+            size_t frameCount __unused, const int16_t* in __unused, int16_t *vol __unused,
+            const int16_t *volinc __unused) {
+        return false; // ramps use U4.28 volumes
+    }
+};
+
+template <int MIXTYPE>
+struct MixerSimd<MIXTYPE, int16_t, int16_t, int32_t> {
+    static inline bool volumeMulti(uint32_t channels, int16_t* out, size_t frameCount,
+            const int16_t* in, const int32_t *vol) {
+        if (!MixTypeTraits<MIXTYPE>::kSaveOnly) {
+            return false;
+        }
+        return MixerSimdInt16<MIXTYPE, int32_t>::volumeMulti(
+                channels, out, frameCount, in, vol);
+    }
+    static inline bool volumeRampMulti(uint32_t channels, int16_t* out, size_t frameCount,
+            const int16_t* in, int32_t *vol, const int32_t *volinc) {
+        if (!MixTypeTraits<MIXTYPE>::kSaveOnly) {
+            return false;
+        }
+        return MixerSimdInt16<MIXTYPE, int32_t>::volumeRampMulti(
+                channels, out, frameCount, in, vol, volinc);
+    }
+};
+
+#endif // USE_MIXER_NEON || USE_MIXER_SSE
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_MIXER_OPS_SIMD_H*/
@@ -126,6 +126,11 @@ void AudioResampler::init_routine()
             }
         }
     }
+    // low-end devices default to the cheapest dynamic filters
+    if (defaultQuality == DEFAULT_QUALITY && property_get_bool("ro.config.low_ram", false)) {
+        defaultQuality = DYN_LOW_QUALITY;
+        ALOGD("low ram device, AudioResampler quality defaults to %d", defaultQuality);
+    }
 }
 
 uint32_t AudioResampler::qualityMHz(src_quality quality)
@@ -175,12 +180,12 @@ AudioResampler* AudioResampler::create(audio_format_t format, int inChannelCount
 
     /* if the caller requests DEFAULT_QUALITY and af.resampler.property
      * has not been set, the target resampler quality is set to DYN_MED_QUALITY,
-     * and allowed to "throttle" down to DYN_LOW_QUALITY if necessary
+     * or DYN_HIGH_QUALITY for hi-res outputs above 48 kHz, and allowed to "throttle" down to DYN_LOW_QUALITY if necessary
      * due to estimated CPU load of having too many active resamplers
-     * (the code below the if).
+     * (the code below the if).  Low ram devices start at DYN_LOW_QUALITY.
      */
     if (quality == DEFAULT_QUALITY) {
-        quality = DYN_MED_QUALITY;
+        quality = sampleRate > 48000 ? DYN_HIGH_QUALITY : DYN_MED_QUALITY;
     }
 
     // naive implementation of CPU load throttling doesn't account for whether resampler is active
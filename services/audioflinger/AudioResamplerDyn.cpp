@@ -21,24 +21,259 @@
 #include <string.h>
 #include <stdlib.h>
 #include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <cutils/compiler.h>
 #include <cutils/properties.h>
 #include <utils/Debug.h>
 #include <utils/Log.h>
+#include <utils/Mutex.h>
+#include <utils/Vector.h>
 #include <audio_utils/primitives.h>
 
 #include "AudioResamplerFirOps.h" // USE_NEON and USE_INLINE_ASSEMBLY defined here
 #include "AudioResamplerFirProcess.h"
 #include "AudioResamplerFirProcessNeon.h"
 #include "AudioResamplerFirGen.h" // requires math.h
+#include "AudioResamplerFirDesign.h"
 #include "AudioResamplerDyn.h"
+#include "AudioResamplerFirTable.h"
 
 //#define DEBUG_RESAMPLER
 
 namespace android {
 
+/*
+ * FirCache is a process-wide cache of polyphase filter banks.
+ *
+ * Designing a Kaiser filter takes milliseconds and up to several hundred KB per resampler,
+ * but every resampler converting between the same pair of rates at the same quality
+ * designs exactly the same filter. Filters are therefore shared and reference counted.
+ * A few unreferenced filters are kept, so that a track which is restarted does not
+ * redesign its filter. Filters from the optional prebuilt table are mapped from the file
+ * and are never freed.
+ */
+class FirCache {
+public:
+    struct Key {
+        int32_t mInSampleRate;
+        int32_t mOutSampleRate;
+        int32_t mQuality;
+        int32_t mPhases;
+        int32_t mHalfNumCoefs;
+        uint32_t mCoefType;
+
+        bool operator==(const Key& other) const {
+            return mInSampleRate == other.mInSampleRate
+                    && mOutSampleRate == other.mOutSampleRate
+                    && mQuality == other.mQuality
+                    && mPhases == other.mPhases
+                    && mHalfNumCoefs == other.mHalfNumCoefs
+                    && mCoefType == other.mCoefType;
+        }
+    };
+
+    // Returns a reference to the filter for key, or NULL if there is none yet.
+    static const void* acquire(const Key& key);
+
+    // Takes ownership of coefs, which was allocated with posix_memalign() for key,
+    // and returns a reference to the filter to use. This is a different filter
+    // if another resampler added one for the same key in the meantime.
+    static const void* add(const Key& key, void* coefs);
+
+    // Releases a reference returned by acquire() or add().
+    static void release(const void* coefs);
+
+private:
+    struct Entry {
+        Key         mKey;
+        const void* mCoefs;
+        int32_t     mRefCount;
+        bool        mPrebuilt;
+    };
+
+    // maximum number of unreferenced designed filters kept
+    static const size_t kMaxIdleFilters = 4;
+
+    static ssize_t find_l(const Key& key);
+    static void loadPrebuilt_l();
+    static void trim_l();
+
+    static Mutex            sLock;
+    static Vector<Entry>    sEntries;   // in order of last release, oldest first
+    static bool             sPrebuiltLoaded;
+};
+
+Mutex FirCache::sLock;
+Vector<FirCache::Entry> FirCache::sEntries;
+bool FirCache::sPrebuiltLoaded = false;
+
+ssize_t FirCache::find_l(const Key& key)
+{
+    for (size_t i = 0; i < sEntries.size(); ++i) {
+        if (sEntries[i].mKey == key) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static size_t firCoefSize(uint32_t coefType)
+{
+    switch (coefType) {
+    case FIR_COEF_INT16:
+        return sizeof(int16_t);
+    case FIR_COEF_INT32:
+        return sizeof(int32_t);
+    case FIR_COEF_FLOAT:
+        return sizeof(float);
+    default:
+        return 0;
+    }
+}
+
+void FirCache::loadPrebuilt_l()
+{
+    sPrebuiltLoaded = true;
+    int fd = open(kFirTablePath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return; // the prebuilt table is optional
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(FirTableHeader)) {
+        ALOGW("%s: invalid prebuilt filter table", kFirTablePath);
+        close(fd);
+        return;
+    }
+    const size_t size = st.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        ALOGW("%s: mmap failed: %s", kFirTablePath, strerror(errno));
+        return;
+    }
+    const FirTableHeader *header = static_cast<const FirTableHeader *>(base);
+    if (header->mMagic != kFirTableMagic || header->mVersion != kFirTableVersion
+            || header->mNumEntries > (size - sizeof(*header)) / sizeof(FirTableEntry)) {
+        ALOGW("%s: unsupported prebuilt filter table", kFirTablePath);
+        munmap(base, size);
+        return;
+    }
+    const FirTableEntry *entries = reinterpret_cast<const FirTableEntry *>(header + 1);
+    size_t loaded = 0;
+    for (uint32_t i = 0; i < header->mNumEntries; ++i) {
+        const FirTableEntry& e = entries[i];
+        const size_t coefSize = firCoefSize(e.mCoefType);
+        if (coefSize == 0 || e.mPhases <= 0 || e.mHalfNumCoefs <= 0
+                || e.mSize != (size_t) (e.mPhases + 1) * e.mHalfNumCoefs * coefSize
+                || e.mOffset % kFirTableAlignment != 0
+                || e.mOffset > size || e.mSize > size - e.mOffset) {
+            ALOGW("%s: skipping invalid entry %u", kFirTablePath, i);
+            continue;
+        }
+        Entry entry;
+        entry.mKey.mInSampleRate = e.mInSampleRate;
+        entry.mKey.mOutSampleRate = e.mOutSampleRate;
+        entry.mKey.mQuality = e.mQuality;
+        entry.mKey.mPhases = e.mPhases;
+        entry.mKey.mHalfNumCoefs = e.mHalfNumCoefs;
+        entry.mKey.mCoefType = e.mCoefType;
+        entry.mCoefs = static_cast<const uint8_t *>(base) + e.mOffset;
+        entry.mRefCount = 0;
+        entry.mPrebuilt = true;
+        sEntries.add(entry);
+        ++loaded;
+    }
+    ALOGV("loaded %zu prebuilt filters from %s", loaded, kFirTablePath);
+    // the mapping is kept for the lifetime of the process
+}
+
+const void* FirCache::acquire(const Key& key)
+{
+    AutoMutex _l(sLock);
+    if (!sPrebuiltLoaded) {
+        loadPrebuilt_l();
+    }
+    ssize_t index = find_l(key);
+    if (index < 0) {
+        return NULL;
+    }
+    Entry& entry = sEntries.editItemAt(index);
+    ++entry.mRefCount;
+    return entry.mCoefs;
+}
+
+const void* FirCache::add(const Key& key, void* coefs)
+{
+    AutoMutex _l(sLock);
+    ssize_t index = find_l(key);
+    if (index >= 0) {
+        // designed concurrently by another resampler
+        free(coefs);
+        Entry& entry = sEntries.editItemAt(index);
+        ++entry.mRefCount;
+        return entry.mCoefs;
+    }
+    Entry entry;
+    entry.mKey = key;
+    entry.mCoefs = coefs;
+    entry.mRefCount = 1;
+    entry.mPrebuilt = false;
+    sEntries.add(entry);
+    return coefs;
+}
+
+void FirCache::release(const void* coefs)
+{
+    AutoMutex _l(sLock);
+    for (size_t i = 0; i < sEntries.size(); ++i) {
+        if (sEntries[i].mCoefs == coefs) {
+            Entry entry = sEntries[i];
+            LOG_ALWAYS_FATAL_IF(entry.mRefCount <= 0, "filter %p released too often", coefs);
+            if (--entry.mRefCount == 0 && !entry.mPrebuilt) {
+                // move to the end, so that the least recently used filters are trimmed first
+                sEntries.removeAt(i);
+                sEntries.add(entry);
+                trim_l();
+            } else {
+                sEntries.editItemAt(i) = entry;
+            }
+            return;
+        }
+    }
+    LOG_ALWAYS_FATAL("unknown filter %p released", coefs);
+}
+
+void FirCache::trim_l()
+{
+    size_t idle = 0;
+    for (size_t i = 0; i < sEntries.size(); ++i) {
+        if (sEntries[i].mRefCount == 0 && !sEntries[i].mPrebuilt) {
+            ++idle;
+        }
+    }
+    for (size_t i = 0; idle > kMaxIdleFilters && i < sEntries.size(); ) {
+        const Entry& entry = sEntries[i];
+        if (entry.mRefCount == 0 && !entry.mPrebuilt) {
+            free(const_cast<void *>(entry.mCoefs));
+            sEntries.removeAt(i);
+            --idle;
+        } else {
+            ++i;
+        }
+    }
+}
+
+template<typename TC> static uint32_t firCoefType();
+template<> uint32_t firCoefType<int16_t>() { return FIR_COEF_INT16; }
+template<> uint32_t firCoefType<int32_t>() { return FIR_COEF_INT32; }
+template<> uint32_t firCoefType<float>() { return FIR_COEF_FLOAT; }
+
 /*
  * InBuffer is a type agnostic input buffer.
  *
@@ -180,7 +415,9 @@ AudioResamplerDyn<TC, TI, TO>::AudioResamplerDyn(
 template<typename TC, typename TI, typename TO>
 AudioResamplerDyn<TC, TI, TO>::~AudioResamplerDyn()
 {
-    free(mCoefBuffer);
+    if (mCoefBuffer != NULL) {
+        FirCache::release(mCoefBuffer);
+    }
 }
 
 template<typename TC, typename TI, typename TO>
@@ -205,34 +442,22 @@ void AudioResamplerDyn<TC, TI, TO>::setVolume(float left, float right)
     }
 }
 
-template<typename T> T max(T a, T b) {return a > b ? a : b;}
-
 template<typename T> T absdiff(T a, T b) {return a > b ? a - b : b - a;}
 
 template<typename TC, typename TI, typename TO>
-void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
-        double stopBandAtten, int inSampleRate, int outSampleRate, double tbwCheat)
+TC* AudioResamplerDyn<TC, TI, TO>::createKaiserFir(const Constants &c, const FirDesign &design)
 {
     TC* buf = NULL;
-    static const double atten = 0.9998;   // to avoid ripple overflow
-    double fcr;
-    double tbw = firKaiserTbw(c.mHalfNumCoefs, stopBandAtten);
+    const double atten = kFirDesignAtten;
+    const double stopBandAtten = design.mStopBandAtten;
+    const double fcr = design.mCutoff;
 
     (void)posix_memalign(reinterpret_cast<void**>(&buf), 32, (c.mL+1)*c.mHalfNumCoefs*sizeof(TC));
-    if (inSampleRate < outSampleRate) { // upsample
-        fcr = max(0.5*tbwCheat - tbw/2, tbw/2);
-    } else { // downsample
-        fcr = max(0.5*tbwCheat*outSampleRate/inSampleRate - tbw/2, tbw/2);
-    }
     // create and set filter
     firKaiserGen(buf, c.mL, c.mHalfNumCoefs, stopBandAtten, fcr, atten);
-    c.mFirCoefs = buf;
-    if (mCoefBuffer) {
-        free(mCoefBuffer);
-    }
-    mCoefBuffer = buf;
 #ifdef DEBUG_RESAMPLER
     // print basic filter stats
+    const double tbw = firKaiserTbw(c.mHalfNumCoefs, stopBandAtten);
     printf("L:%d  hnc:%d  stopBandAtten:%lf  fcr:%lf  atten:%lf  tbw:%lf\n",
             c.mL, c.mHalfNumCoefs, stopBandAtten, fcr, atten, tbw);
     // test the filter and report results
@@ -245,15 +470,7 @@ void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
     printf("passband(%lf, %lf): %.8lf %.8lf %.8lf\n", 0., fp, passMin, passMax, passRipple);
     printf("stopband(%lf, %lf): %.8lf %.3lf\n", fs, 0.5, stopMax, stopRipple);
 #endif
-}
-
-// recursive gcd. Using objdump, it appears the tail recursion is converted to a while loop.
-static int gcd(int n, int m)
-{
-    if (m == 0) {
-        return n;
-    }
-    return gcd(m, n % m);
+    return buf;
 }
 
 static bool isClose(int32_t newSampleRate, int32_t prevSampleRate,
@@ -288,101 +505,37 @@ void AudioResamplerDyn<TC, TI, TO>::setSampleRate(int32_t inSampleRate)
 
     mInSampleRate = inSampleRate;
 
-    // TODO: Add precalculated Equiripple filters
-
     if (mFilterQuality != getQuality() ||
             !isClose(inSampleRate, oldSampleRate, mFilterSampleRate, mSampleRate)) {
         mFilterSampleRate = inSampleRate;
         mFilterQuality = getQuality();
 
         // Begin Kaiser Filter computation
-        //
-        // The quantization floor for S16 is about 96db - 10*log_10(#length) + 3dB.
-        // Keep the stop band attenuation no greater than 84-85dB for 32 length S16 filters
-        //
-        // For s32 we keep the stop band attenuation at the same as 16b resolution, about
-        // 96-98dB
-        //
-
-        double stopBandAtten;
-        double tbwCheat = 1.; // how much we "cheat" into aliasing
-        int halfLength;
-        if (mFilterQuality == DYN_HIGH_QUALITY) {
-            // 32b coefficients, 64 length
-            useS32 = true;
-            stopBandAtten = 98.;
-            if (inSampleRate >= mSampleRate * 4) {
-                halfLength = 48;
-            } else if (inSampleRate >= mSampleRate * 2) {
-                halfLength = 40;
-            } else {
-                halfLength = 32;
-            }
-        } else if (mFilterQuality == DYN_LOW_QUALITY) {
-            // 16b coefficients, 16-32 length
-            useS32 = false;
-            stopBandAtten = 80.;
-            if (inSampleRate >= mSampleRate * 4) {
-                halfLength = 24;
-            } else if (inSampleRate >= mSampleRate * 2) {
-                halfLength = 16;
-            } else {
-                halfLength = 8;
-            }
-            if (inSampleRate <= mSampleRate) {
-                tbwCheat = 1.05;
-            } else {
-                tbwCheat = 1.03;
-            }
-        } else { // DYN_MED_QUALITY
-            // 16b coefficients, 32-64 length
-            // note: > 64 length filters with 16b coefs can have quantization noise problems
-            useS32 = false;
-            stopBandAtten = 84.;
-            if (inSampleRate >= mSampleRate * 4) {
-                halfLength = 32;
-            } else if (inSampleRate >= mSampleRate * 2) {
-                halfLength = 24;
-            } else {
-                halfLength = 16;
-            }
-            if (inSampleRate <= mSampleRate) {
-                tbwCheat = 1.03;
-            } else {
-                tbwCheat = 1.01;
-            }
-        }
+        FirDesign design;
+        firDesign(&design, firTier(mFilterQuality), inSampleRate, mSampleRate);
+        useS32 = design.mUseS32;
+        const int phases = design.mPhases;
+        const int halfLength = design.mHalfNumCoefs;
 
-        // determine the number of polyphases in the filterbank.
-        // for 16b, it is desirable to have 2^(16/2) = 256 phases.
-        // https://ccrma.stanford.edu/~jos/resample/Relation_Interpolation_Error_Quantization.html
-        //
-        // We are a bit more lax on this.
-
-        int phases = mSampleRate / gcd(mSampleRate, inSampleRate);
-
-        // TODO: Once dynamic sample rate change is an option, the code below
-        // should be modified to execute only when dynamic sample rate change is enabled.
-        //
-        // as above, #phases less than 63 is too few phases for accurate linear interpolation.
-        // we increase the phases to compensate, but more phases means more memory per
-        // filter and more time to compute the filter.
-        //
-        // if we know that the filter will be used for dynamic sample rate changes,
-        // that would allow us skip this part for fixed sample rate resamplers.
-        //
-        while (phases<63) {
-            phases *= 2; // this code only needed to support dynamic rate changes
+        // use a shared or prebuilt filter if possible, otherwise create the filter
+        mConstants.set(phases, halfLength, inSampleRate, mSampleRate);
+        FirCache::Key key;
+        key.mInSampleRate = inSampleRate;
+        key.mOutSampleRate = mSampleRate;
+        key.mQuality = mFilterQuality;
+        key.mPhases = phases;
+        key.mHalfNumCoefs = halfLength;
+        key.mCoefType = firCoefType<TC>();
+        const void* coefs = FirCache::acquire(key);
+        if (coefs == NULL) {
+            // TODO: Add precalculated Equiripple filters
+            coefs = FirCache::add(key, createKaiserFir(mConstants, design));
         }
-
-        if (phases>=256) {  // too many phases, always interpolate
-            phases = 127;
+        if (mCoefBuffer != NULL) {
+            FirCache::release(mCoefBuffer);
         }
-
-        // create the filter
-        mConstants.set(phases, halfLength, inSampleRate, mSampleRate);
-        createKaiserFir(mConstants, stopBandAtten,
-                inSampleRate, mSampleRate, tbwCheat);
+        mCoefBuffer = coefs;
+        mConstants.mFirCoefs = static_cast<const TC*>(coefs);
     } // End Kaiser filter
 
     // update phase and state based on the new filter.
@@ -25,6 +25,8 @@
 
 namespace android {
 
+struct FirDesign;
+
 /* AudioResamplerDyn
  *
  * This class template is used for floating point and integer resamplers.
@@ -107,8 +109,8 @@ private:
         size_t mStateCount; // size of state in units of TI.
     };
 
-    void createKaiserFir(Constants &c, double stopBandAtten,
-            int inSampleRate, int outSampleRate, double tbwCheat);
+    // returns a newly allocated filter bank for c, to be handed over to the filter cache
+    TC* createKaiserFir(const Constants &c, const FirDesign &design);
 
     template<int CHANNELS, bool LOCKED, int STRIDE>
     size_t resample(TO* out, size_t outFrameCount, AudioBufferProvider* provider);
@@ -124,7 +126,7 @@ private:
      resample_ABP_t mResampleFunc;     // called function for resampling
             int32_t mFilterSampleRate; // designed filter sample rate.
         src_quality mFilterQuality;    // designed filter quality.
-              void* mCoefBuffer;       // if a filter is created, this is not null
+        const void* mCoefBuffer;       // shared filter from the filter cache, if not null
 };
 
 } // namespace android
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_RESAMPLER_FIR_DESIGN_H
+#define ANDROID_AUDIO_RESAMPLER_FIR_DESIGN_H
+
+#include <stdint.h>
+
+#include "AudioResampler.h"
+#include "AudioResamplerFirGen.h" // requires math.h and is_same<>
+
+namespace android {
+
+/*
+ * Quality/CPU tiers of the Kaiser polyphase filters of AudioResamplerDyn.
+ *
+ * This is shared with the host tool that generates the prebuilt filter table described in
+ * AudioResamplerFirTable.h, so that a prebuilt filter is exactly the filter the resampler
+ * would otherwise design at run time.
+ *
+ * The quantization floor for S16 is about 96db - 10*log_10(#length) + 3dB.
+ * Keep the stop band attenuation no greater than 84-85dB for 32 length S16 filters
+ *
+ * For s32 we keep the stop band attenuation at the same as 16b resolution, about
+ * 96-98dB
+ */
+struct FirTier {
+    AudioResampler::src_quality mQuality;
+    bool    mUseS32;            // 32 bit coefficients for 16 bit input
+    double  mStopBandAtten;     // dB
+    double  mTbwCheatUp;        // how much we "cheat" into aliasing, for upsampling and 1:1
+    double  mTbwCheatDown;      // and for downsampling
+    int     mHalfNumCoefs[3];   // below 2x, from 2x and from 4x downsampling
+};
+
+static const FirTier kFirTiers[] = {
+    // 16b coefficients, 16-48 length
+    { AudioResampler::DYN_LOW_QUALITY,  false, 80., 1.05, 1.03, { 8, 16, 24 } },
+    // 16b coefficients, 32-64 length
+    // note: > 64 length filters with 16b coefs can have quantization noise problems
+    { AudioResampler::DYN_MED_QUALITY,  false, 84., 1.03, 1.01, { 16, 24, 32 } },
+    // 32b coefficients, 64-96 length
+    { AudioResampler::DYN_HIGH_QUALITY, true,  98., 1.,   1.,   { 32, 40, 48 } },
+};
+
+static const size_t kNumFirTiers = sizeof(kFirTiers) / sizeof(kFirTiers[0]);
+
+// gain of the designed filters, to avoid ripple overflow
+static const double kFirDesignAtten = 0.9998;
+
+// Returns the tier for quality, DYN_MED_QUALITY for anything that is not a dynamic quality.
+static inline const FirTier& firTier(int32_t quality)
+{
+    for (size_t i = 0; i < kNumFirTiers; ++i) {
+        if (kFirTiers[i].mQuality == quality) {
+            return kFirTiers[i];
+        }
+    }
+    return kFirTiers[1];
+}
+
+// recursive gcd. Using objdump, it appears the tail recursion is converted to a while loop.
+static inline int gcd(int n, int m)
+{
+    if (m == 0) {
+        return n;
+    }
+    return gcd(m, n % m);
+}
+
+// The parameters of one filter bank, as passed to firKaiserGen().
+struct FirDesign {
+    int     mPhases;            // L, number of polyphases
+    int     mHalfNumCoefs;
+    double  mStopBandAtten;
+    double  mCutoff;            // fcr, normalized to the input rate of a single polyphase
+    bool    mUseS32;
+};
+
+static inline void firDesign(FirDesign *design, const FirTier& tier,
+        int32_t inSampleRate, int32_t outSampleRate)
+{
+    int halfLength;
+    if (inSampleRate >= outSampleRate * 4) {
+        halfLength = tier.mHalfNumCoefs[2];
+    } else if (inSampleRate >= outSampleRate * 2) {
+        halfLength = tier.mHalfNumCoefs[1];
+    } else {
+        halfLength = tier.mHalfNumCoefs[0];
+    }
+
+    // determine the number of polyphases in the filterbank.
+    // for 16b, it is desirable to have 2^(16/2) = 256 phases.
+    // https://ccrma.stanford.edu/~jos/resample/Relation_Interpolation_Error_Quantization.html
+    //
+    // We are a bit more lax on this.
+
+    int phases = outSampleRate / gcd(outSampleRate, inSampleRate);
+
+    // TODO: Once dynamic sample rate change is an option, the code below
+    // should be modified to execute only when dynamic sample rate change is enabled.
+    //
+    // as above, #phases less than 63 is too few phases for accurate linear interpolation.
+    // we increase the phases to compensate, but more phases means more memory per
+    // filter and more time to compute the filter.
+    //
+    // if we know that the filter will be used for dynamic sample rate changes,
+    // that would allow us skip this part for fixed sample rate resamplers.
+    //
+    while (phases<63) {
+        phases *= 2; // this code only needed to support dynamic rate changes
+    }
+
+    if (phases>=256) {  // too many phases, always interpolate
+        phases = 127;
+    }
+
+    const double tbwCheat = inSampleRate <= outSampleRate
+            ? tier.mTbwCheatUp : tier.mTbwCheatDown;
+    const double tbw = firKaiserTbw(halfLength, tier.mStopBandAtten);
+    double fcr;
+    if (inSampleRate < outSampleRate) { // upsample
+        fcr = 0.5*tbwCheat - tbw/2;
+    } else { // downsample
+        fcr = 0.5*tbwCheat*outSampleRate/inSampleRate - tbw/2;
+    }
+    if (fcr < tbw/2) {
+        fcr = tbw/2;
+    }
+
+    design->mPhases = phases;
+    design->mHalfNumCoefs = halfLength;
+    design->mStopBandAtten = tier.mStopBandAtten;
+    design->mCutoff = fcr;
+    design->mUseS32 = tier.mUseS32;
+}
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_RESAMPLER_FIR_DESIGN_H*/
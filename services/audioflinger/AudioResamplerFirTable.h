@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_RESAMPLER_FIR_TABLE_H
+#define ANDROID_AUDIO_RESAMPLER_FIR_TABLE_H
+
+#include <stdint.h>
+
+namespace android {
+
+/*
+ * File format of the optional prebuilt polyphase filter table used by AudioResamplerDyn.
+ *
+ * The file is mapped read-only, so that the coefficients are shared with the page cache
+ * and never need to be computed at run time:
+ *
+ *   FirTableHeader
+ *   FirTableEntry[header.mNumEntries]
+ *   coefficients, each filter starting at a multiple of kFirTableAlignment bytes
+ *
+ * All values are in native byte order. A filter is only used if every field of its entry
+ * matches the filter AudioResamplerDyn would have designed; otherwise it is generated.
+ *
+ * The table is generated at build time by tools/resampler_tools/fir_table.cpp, from the
+ * quality tiers of AudioResamplerFirDesign.h.
+ */
+
+static const char kFirTablePath[] = "/system/etc/audio_resampler_fir.bin";
+static const uint32_t kFirTableMagic = 0x54524946;   // 'FIRT'
+static const uint32_t kFirTableVersion = 1;
+static const uint32_t kFirTableAlignment = 32;       // matches posix_memalign() for NEON
+
+enum fir_coef_type_t {
+    FIR_COEF_INT16 = 0,
+    FIR_COEF_INT32 = 1,
+    FIR_COEF_FLOAT = 2,
+};
+
+struct FirTableHeader {
+    uint32_t    mMagic;         // kFirTableMagic
+    uint32_t    mVersion;       // kFirTableVersion
+    uint32_t    mNumEntries;
+    uint32_t    mReserved;
+};
+
+struct FirTableEntry {
+    int32_t     mInSampleRate;  // designed input sample rate
+    int32_t     mOutSampleRate;
+    int32_t     mQuality;       // AudioResampler::src_quality
+    int32_t     mPhases;        // L, number of polyphases
+    int32_t     mHalfNumCoefs;
+    uint32_t    mCoefType;      // fir_coef_type_t
+    uint32_t    mOffset;        // byte offset of the coefficients from the start of the file
+    uint32_t    mSize;          // (mPhases + 1) * mHalfNumCoefs * coefficient size in bytes
+};
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_RESAMPLER_FIR_TABLE_H*/
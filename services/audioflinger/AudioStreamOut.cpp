@@ -19,6 +19,7 @@
 //#define LOG_NDEBUG 0
 
 #include <hardware/audio.h>
+#include <media/AudioParameter.h>
 #include <utils/Log.h>
 
 #include "AudioHwDevice.h"
@@ -26,6 +27,8 @@
 
 namespace android {
 
+const char * const AudioStreamOut::kClientBuffersKey = "client_buffers";
+
 // ----------------------------------------------------------------------------
 AudioStreamOut::AudioStreamOut(AudioHwDevice *dev, audio_output_flags_t flags)
         : audioHwDev(dev)
@@ -37,6 +40,7 @@ AudioStreamOut::AudioStreamOut(AudioHwDevice *dev, audio_output_flags_t flags)
         , mRateMultiplier(1)
         , mHalFormatIsLinearPcm(false)
         , mHalFrameSize(0)
+        , mCanWriteClientBuffers(false)
 {
 }
 
@@ -138,6 +142,19 @@ status_t AudioStreamOut::open(
         mHalFormatIsLinearPcm = audio_is_linear_pcm(config->format);
         ALOGI("AudioStreamOut::open(), mHalFormatIsLinearPcm = %d", (int)mHalFormatIsLinearPcm);
         mHalFrameSize = audio_stream_out_frame_size(stream);
+
+        // only direct and offloaded streams are written from a single client's buffer
+        if ((flags & (AUDIO_OUTPUT_FLAG_DIRECT | AUDIO_OUTPUT_FLAG_COMPRESS_OFFLOAD)) != 0) {
+            char *reply = stream->common.get_parameters(&stream->common, kClientBuffersKey);
+            if (reply != NULL) {
+                AudioParameter param = AudioParameter(String8(reply));
+                int value;
+                mCanWriteClientBuffers =
+                        param.getInt(String8(kClientBuffersKey), value) == NO_ERROR && value != 0;
+                free(reply);
+            }
+            ALOGI_IF(mCanWriteClientBuffers, "AudioStreamOut::open(), writing client buffers");
+        }
     }
 
     return status;
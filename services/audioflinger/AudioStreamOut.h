@@ -60,6 +60,12 @@ public:
 
     virtual status_t getPresentationPosition(uint64_t *frames, struct timespec *timestamp);
 
+    // Number of frames written since the last standby or flush, in the same units
+    // as the frames returned by getPresentationPosition().
+    uint64_t getFramesWritten() const {
+        return (mFramesWritten - mFramesWrittenAtStandby) / mRateMultiplier;
+    }
+
     /**
     * Write audio buffer to driver. Returns number of bytes written, or a
     * negative status_t. If at least one frame was written successfully prior to the error,
@@ -101,6 +107,20 @@ public:
     virtual status_t flush();
     virtual status_t standby();
 
+    /**
+     * @return true if the HAL accepts write() buffers that alias client shared memory, so
+     * direct and offload threads may write client frames without copying them first.
+     * The HAL opts in by answering kClientBuffersKey=1 in the stream's get_parameters().
+     * Such a HAL must not modify the buffer; with a non-blocking write it must have consumed
+     * the bytes it reports as written before write() returns.
+     */
+    virtual bool canWriteClientBuffers() const { return mCanWriteClientBuffers; }
+
+    // Dumps state specific to the kind of stream, called from the thread's dump.
+    virtual void dump(int fd __unused) const { }
+
+    static const char * const kClientBuffersKey;
+
 protected:
     uint64_t             mFramesWritten; // reset by flush
     uint64_t             mFramesWrittenAtStandby;
@@ -108,6 +128,7 @@ protected:
     int                  mRateMultiplier;
     bool                 mHalFormatIsLinearPcm;
     size_t               mHalFrameSize;
+    bool                 mCanWriteClientBuffers;
 };
 
 } // namespace android
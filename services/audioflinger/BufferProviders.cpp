@@ -279,29 +279,90 @@ void DownmixerBufferProvider::copyFrames(void *dst, const void *src, size_t fram
 
 RemixBufferProvider::RemixBufferProvider(audio_channel_mask_t inputChannelMask,
         audio_channel_mask_t outputChannelMask, audio_format_t format,
-        size_t bufferFrameCount) :
+        size_t bufferFrameCount, audio_format_t inputFormat) :
         CopyBufferProvider(
-                audio_bytes_per_sample(format)
+                audio_bytes_per_sample(inputFormat == AUDIO_FORMAT_INVALID ? format : inputFormat)
                     * audio_channel_count_from_out_mask(inputChannelMask),
                 audio_bytes_per_sample(format)
                     * audio_channel_count_from_out_mask(outputChannelMask),
                 bufferFrameCount),
         mFormat(format),
+        mInputFormat(inputFormat == AUDIO_FORMAT_INVALID ? format : inputFormat),
         mSampleSize(audio_bytes_per_sample(format)),
         mInputChannels(audio_channel_count_from_out_mask(inputChannelMask)),
         mOutputChannels(audio_channel_count_from_out_mask(outputChannelMask))
 {
-    ALOGV("RemixBufferProvider(%p)(%#x, %#x, %#x) %zu %zu",
-            this, format, inputChannelMask, outputChannelMask,
+    ALOGV("RemixBufferProvider(%p)(%#x, %#x, %#x, %#x) %zu %zu",
+            this, format, inputChannelMask, outputChannelMask, mInputFormat,
             mInputChannels, mOutputChannels);
+    LOG_ALWAYS_FATAL_IF(!isFusableFormat(mInputFormat, mFormat),
+            "RemixBufferProvider can't convert %#x to %#x", mInputFormat, mFormat);
     (void) memcpy_by_index_array_initialization_from_channel_mask(
             mIdxAry, ARRAY_SIZE(mIdxAry), outputChannelMask, inputChannelMask);
 }
 
+/*static*/ bool RemixBufferProvider::isFusableFormat(
+        audio_format_t inputFormat, audio_format_t outputFormat)
+{
+    if (inputFormat == outputFormat) {
+        return true;
+    }
+    return (inputFormat == AUDIO_FORMAT_PCM_16_BIT || inputFormat == AUDIO_FORMAT_PCM_FLOAT)
+            && (outputFormat == AUDIO_FORMAT_PCM_16_BIT || outputFormat == AUDIO_FORMAT_PCM_FLOAT);
+}
+
+static inline void convertSample(float *dst, int16_t src) {
+    *dst = float_from_i16(src);
+}
+
+static inline void convertSample(int16_t *dst, float src) {
+    *dst = clamp16_from_float(src);
+}
+
+// Remixes and converts frames in a single pass. idxAry follows the conventions of
+// memcpy_by_index_array(): a negative index zero fills the destination channel.
+template <typename TO, typename TI>
+static void remixAndConvert(TO *dst, size_t dstChannels,
+        const TI *src, size_t srcChannels, const int8_t *idxAry, size_t frames)
+{
+    if (dstChannels == 2 && idxAry[0] >= 0 && idxAry[1] >= 0) {
+        // the common multichannel to stereo case; keep the inner loop free of branches
+        const int left = idxAry[0];
+        const int right = idxAry[1];
+        for (; frames > 0; --frames) {
+            convertSample(&dst[0], src[left]);
+            convertSample(&dst[1], src[right]);
+            dst += 2;
+            src += srcChannels;
+        }
+        return;
+    }
+    for (; frames > 0; --frames) {
+        for (size_t i = 0; i < dstChannels; ++i) {
+            const int index = idxAry[i];
+            if (index < 0) {
+                dst[i] = 0;
+            } else {
+                convertSample(&dst[i], src[index]);
+            }
+        }
+        dst += dstChannels;
+        src += srcChannels;
+    }
+}
+
 void RemixBufferProvider::copyFrames(void *dst, const void *src, size_t frames)
 {
-    memcpy_by_index_array(dst, mOutputChannels,
-            src, mInputChannels, mIdxAry, mSampleSize, frames);
+    if (mInputFormat == mFormat) {
+        memcpy_by_index_array(dst, mOutputChannels,
+                src, mInputChannels, mIdxAry, mSampleSize, frames);
+    } else if (mInputFormat == AUDIO_FORMAT_PCM_16_BIT) {
+        remixAndConvert((float *)dst, mOutputChannels,
+                (const int16_t *)src, mInputChannels, mIdxAry, frames);
+    } else {
+        remixAndConvert((int16_t *)dst, mOutputChannels,
+                (const float *)src, mInputChannels, mIdxAry, frames);
+    }
 }
 
 ReformatBufferProvider::ReformatBufferProvider(int32_t channelCount,
@@ -116,16 +116,22 @@ protected:
 
 // RemixBufferProvider derives from CopyBufferProvider to perform an
 // upmix or downmix to the proper channel count and mask.
+// If inputFormat differs from format, the input is also converted to format in the
+// same pass, which avoids chaining a separate ReformatBufferProvider and its copy.
 class RemixBufferProvider : public CopyBufferProvider {
 public:
     RemixBufferProvider(audio_channel_mask_t inputChannelMask,
             audio_channel_mask_t outputChannelMask, audio_format_t format,
-            size_t bufferFrameCount);
+            size_t bufferFrameCount, audio_format_t inputFormat = AUDIO_FORMAT_INVALID);
     //Overrides
     virtual void copyFrames(void *dst, const void *src, size_t frames);
 
+    // returns true if the remixer can convert from inputFormat to outputFormat itself
+    static bool isFusableFormat(audio_format_t inputFormat, audio_format_t outputFormat);
+
 protected:
     const audio_format_t mFormat;
+    const audio_format_t mInputFormat;
     const size_t         mSampleSize;
     const size_t         mInputChannels;
     const size_t         mOutputChannels;
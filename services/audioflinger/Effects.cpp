@@ -64,6 +64,7 @@ AudioFlinger::EffectModule::EffectModule(ThreadBase *thread,
       mThread(thread), mChain(chain), mId(id), mSessionId(sessionId),
       mDescriptor(*desc),
       // mConfig is set by configure() and not used before then
+      mFloatBuffer(NULL), mProcessFloat(false),
       mEffectInterface(NULL),
       mStatus(NO_INIT), mState(IDLE),
       // mMaxDisableWaitCnt is set by configure() and not used before then
@@ -277,9 +278,18 @@ void AudioFlinger::EffectModule::process()
         }
 
         // do the actual processing in the effect engine
-        int ret = (*mEffectInterface)->process(mEffectInterface,
+        int ret;
+        if (mProcessFloat) {
+            // the chain has converted its input buffer into mFloatBuffer
+            audio_buffer_t buffer;
+            buffer.frameCount = mConfig.inputCfg.buffer.frameCount;
+            buffer.raw = mFloatBuffer;
+            ret = (*mEffectInterface)->process(mEffectInterface, &buffer, &buffer);
+        } else {
+            ret = (*mEffectInterface)->process(mEffectInterface,
                                                &mConfig.inputCfg.buffer,
                                                &mConfig.outputCfg.buffer);
+        }
 
         // force transition to IDLE state when engine is ready
         if (mState == STOPPED && ret == -ENODATA) {
@@ -384,15 +394,43 @@ status_t AudioFlinger::EffectModule::configure()
     ALOGV("configure() %p thread %p buffer %p framecount %d",
             this, thread.get(), mConfig.inputCfg.buffer.raw, mConfig.inputCfg.buffer.frameCount);
 
-    size = sizeof(int);
-    status = (*mEffectInterface)->command(mEffectInterface,
-                                                   EFFECT_CMD_SET_CONFIG,
-                                                   sizeof(effect_config_t),
-                                                   &mConfig,
-                                                   &size,
-                                                   &cmdStatus);
-    if (status == 0) {
-        status = cmdStatus;
+    // Offer float in place processing to insert effects overwriting the chain buffer.
+    // Engines not supporting it reject the configuration and are configured in 16 bit.
+    mProcessFloat = false;
+    if (mFloatBuffer != NULL &&
+            (mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_INSERT &&
+            mConfig.inputCfg.buffer.raw == mConfig.outputCfg.buffer.raw &&
+            mConfig.inputCfg.channels == AUDIO_CHANNEL_OUT_STEREO &&
+            channelMask == AUDIO_CHANNEL_OUT_STEREO) {
+        effect_config_t config = mConfig;
+        config.inputCfg.format = AUDIO_FORMAT_PCM_FLOAT;
+        config.outputCfg.format = AUDIO_FORMAT_PCM_FLOAT;
+        config.inputCfg.buffer.raw = mFloatBuffer;
+        config.outputCfg.buffer.raw = mFloatBuffer;
+        size = sizeof(int);
+        status = (*mEffectInterface)->command(mEffectInterface,
+                                                       EFFECT_CMD_SET_CONFIG,
+                                                       sizeof(effect_config_t),
+                                                       &config,
+                                                       &size,
+                                                       &cmdStatus);
+        mProcessFloat = status == 0 && cmdStatus == 0;
+        ALOGV("configure() %p float processing %s", this, mProcessFloat ? "on" : "rejected");
+    }
+
+    if (mProcessFloat) {
+        status = NO_ERROR;
+    } else {
+        size = sizeof(int);
+        status = (*mEffectInterface)->command(mEffectInterface,
+                                                       EFFECT_CMD_SET_CONFIG,
+                                                       sizeof(effect_config_t),
+                                                       &mConfig,
+                                                       &size,
+                                                       &cmdStatus);
+        if (status == 0) {
+            status = cmdStatus;
+        }
     }
 
     if (status == 0 &&
@@ -1026,6 +1064,10 @@ void AudioFlinger::EffectModule::dump(int fd, const Vector<String16>& args __unu
             formatToString((audio_format_t)mConfig.inputCfg.format),
             mConfig.inputCfg.buffer.raw);
     result.append(buffer);
+    if (mProcessFloat) {
+        snprintf(buffer, SIZE, "\t\t- Processing in place in float: %p\n", mFloatBuffer);
+        result.append(buffer);
+    }
 
     result.append("\t\t- Output configuration:\n");
     result.append("\t\t\tBuffer     Frames  Smp rate Channels Format\n");
@@ -1375,6 +1417,7 @@ void AudioFlinger::EffectHandle::dumpToBuffer(char* buffer, size_t size)
 AudioFlinger::EffectChain::EffectChain(ThreadBase *thread,
                                         int sessionId)
     : mThread(thread), mSessionId(sessionId), mActiveTrackCnt(0), mTrackCnt(0), mTailBufferCount(0),
+      mFloatBuffer(NULL), mFloatBufferFrames(0),
       mOwnInBuffer(false), mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
       mNewLeftVolume(UINT_MAX), mNewRightVolume(UINT_MAX), mForceVolume(false)
 {
@@ -1391,7 +1434,7 @@ AudioFlinger::EffectChain::~EffectChain()
     if (mOwnInBuffer) {
         delete mInBuffer;
     }
-
+    free(mFloatBuffer);
 }
 
 // getEffectFromDesc_l() must be called with ThreadBase::mLock held
@@ -1459,6 +1502,27 @@ void AudioFlinger::EffectChain::clearInputBuffer_l(sp<ThreadBase> thread)
     memset(mInBuffer, 0, thread->frameCount() * frameSize);
 }
 
+// Must be called with EffectChain::mLock locked
+void AudioFlinger::EffectChain::allocateFloatBuffer_l(size_t frameCount)
+{
+    if (mFloatBuffer != NULL && frameCount <= mFloatBufferFrames) {
+        return;
+    }
+    float *buffer;
+    // 32 byte alignment for SIMD loads in the effect engines
+    if (posix_memalign((void **)&buffer, 32, frameCount * FCC_2 * sizeof(float)) != 0) {
+        ALOGW("allocateFloatBuffer_l(): cannot allocate %zu frames", frameCount);
+        return;
+    }
+    // effects process the buffer passed to process(), not the one given at configuration
+    for (size_t i = 0; i < mEffects.size(); i++) {
+        mEffects[i]->setFloatBuffer(buffer);
+    }
+    free(mFloatBuffer);
+    mFloatBuffer = buffer;
+    mFloatBufferFrames = frameCount;
+}
+
 // Must be called with EffectChain::mLock locked
 void AudioFlinger::EffectChain::process_l()
 {
@@ -1496,8 +1560,28 @@ void AudioFlinger::EffectChain::process_l()
 
     size_t size = mEffects.size();
     if (doProcess) {
+        // consecutive effects processing in float share mFloatBuffer, which is only
+        // converted from and back to the 16 bit chain input buffer at the run boundaries
+        const size_t sampleCount = thread->frameCount() * FCC_2;
+        bool floatValid = false;    // mFloatBuffer holds the current chain samples
         for (size_t i = 0; i < size; i++) {
-            mEffects[i]->process();
+            const sp<EffectModule>& effect = mEffects[i];
+            if (effect->isProcessFloat()) {
+                if (!effect->isProcessEnabled() || thread->frameCount() > mFloatBufferFrames) {
+                    continue;
+                }
+                if (!floatValid) {
+                    memcpy_to_float_from_i16(mFloatBuffer, mInBuffer, sampleCount);
+                    floatValid = true;
+                }
+            } else if (floatValid) {
+                memcpy_to_i16_from_float(mInBuffer, mFloatBuffer, sampleCount);
+                floatValid = false;
+            }
+            effect->process();
+        }
+        if (floatValid) {
+            memcpy_to_i16_from_float(mInBuffer, mFloatBuffer, sampleCount);
         }
     }
     for (size_t i = 0; i < size; i++) {
@@ -1600,6 +1684,10 @@ status_t AudioFlinger::EffectChain::addEffect_l(const sp<EffectModule>& effect)
 
         // always read samples from chain input buffer
         effect->setInBuffer(mInBuffer);
+        if (thread->channelCount() == FCC_2) {
+            allocateFloatBuffer_l(thread->frameCount());
+            effect->setFloatBuffer(mFloatBuffer);
+        }
 
         // if last effect in the chain, output samples to chain
         // output buffer, otherwise to chain input buffer
@@ -88,6 +88,10 @@ public:
     int16_t     *inBuffer() { return mConfig.inputCfg.buffer.s16; }
     void        setOutBuffer(int16_t *buffer) { mConfig.outputCfg.buffer.s16 = buffer; }
     int16_t     *outBuffer() { return mConfig.outputCfg.buffer.s16; }
+    // float work buffer of the chain, used instead of the 16 bit buffers if the effect engine
+    // accepts to process it in place in AUDIO_FORMAT_PCM_FLOAT. Takes effect at configure().
+    void        setFloatBuffer(float *buffer) { mFloatBuffer = buffer; }
+    bool        isProcessFloat() const { return mProcessFloat; }
     void        setChain(const wp<EffectChain>& chain) { mChain = chain; }
     void        setThread(const wp<ThreadBase>& thread) { mThread = thread; }
     const wp<ThreadBase>& thread() { return mThread; }
@@ -144,6 +148,8 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
     const int           mSessionId; // audio session ID
     const effect_descriptor_t mDescriptor;// effect descriptor received from effect engine
     effect_config_t     mConfig;    // input and output audio configuration
+    float               *mFloatBuffer;  // chain float work buffer, or NULL
+    bool                mProcessFloat;  // engine configured to process mFloatBuffer in place
     effect_handle_t  mEffectInterface; // Effect module C API
     status_t            mStatus;    // initialization status
     effect_state        mState;     // current activation state
@@ -356,6 +362,7 @@ protected:
     bool isEffectEligibleForSuspend(const effect_descriptor_t& desc);
 
     void clearInputBuffer_l(sp<ThreadBase> thread);
+    void allocateFloatBuffer_l(size_t frameCount);
 
     void setThread(const sp<ThreadBase>& thread);
 
@@ -365,6 +372,11 @@ protected:
     int mSessionId;             // audio session ID
     int16_t *mInBuffer;         // chain input buffer
     int16_t *mOutBuffer;        // chain output buffer
+    // Aligned work buffer shared by consecutive insert effects processing in place in float:
+    // the chain input buffer is converted once before the first of them and back once after
+    // the last, instead of each effect converting to and from 16 bit internally.
+    float   *mFloatBuffer;
+    size_t  mFloatBufferFrames; // capacity of mFloatBuffer in stereo frames
 
     // 'volatile' here means these are accessed with atomic operations instead of mutex
     volatile int32_t mActiveTrackCnt;    // number of active tracks connected
@@ -51,6 +51,9 @@ FastMixer::FastMixer() : FastThread(),
     mSlopNs(0),
     // mFastTrackNames
     // mGenerations
+    // mTrackVolumes
+    mTrackStoppedMask(0),
+    // mAckedUnderruns
     mOutputSink(NULL),
     mOutputSinkGen(0),
     mMixer(NULL),
@@ -81,6 +84,8 @@ FastMixer::FastMixer() : FastThread(),
     for (i = 0; i < FastMixerState::kMaxFastTracks; ++i) {
         mFastTrackNames[i] = -1;
         mGenerations[i] = 0;
+        mTrackVolumes[i] = AudioMixer::UNITY_GAIN_FLOAT;
+        mAckedUnderruns[i] = 0;
     }
 #ifdef FAST_THREAD_STATISTICS
     mOldLoad.tv_sec = 0;
@@ -278,6 +283,7 @@ void FastMixer::onStateChange()
                         (void *)(uintptr_t)mSinkChannelMask);
                 mMixer->enable(name);
             }
+            resetTrackCommandState(i);
             mGenerations[i] = fastTrack->mGeneration;
         }
 
@@ -315,6 +321,7 @@ void FastMixer::onStateChange()
                             (void *)(uintptr_t)mSinkChannelMask);
                     // already enabled
                 }
+                resetTrackCommandState(i);
                 mGenerations[i] = fastTrack->mGeneration;
             }
         }
@@ -325,6 +332,39 @@ void FastMixer::onStateChange()
     }
 }
 
+void FastMixer::resetTrackCommandState(int i)
+{
+    // Until the normal mixer says otherwise, a new or modified track is started at full scale.
+    mTrackVolumes[i] = AudioMixer::UNITY_GAIN_FLOAT;
+    mTrackStoppedMask &= ~(1 << i);
+    const FastTrackUnderruns& underruns = ((FastMixerDumpState *) mDumpState)->mTracks[i].mUnderruns;
+    mAckedUnderruns[i] = underruns.mBitFields.mPartial + underruns.mBitFields.mEmpty;
+}
+
+void FastMixer::processTrackCommands(int i, FastTrackCommandQueue *queue)
+{
+    FastTrackCommand command;
+    while (queue->pop(&command)) {
+        switch (command.mType) {
+        case FastTrackCommand::VOLUME:
+            mTrackVolumes[i] = command.mVolume;
+            break;
+        case FastTrackCommand::START:
+            mTrackStoppedMask &= ~(1 << i);
+            break;
+        case FastTrackCommand::STOP:
+            mTrackStoppedMask |= 1 << i;
+            break;
+        case FastTrackCommand::ACK_UNDERRUNS:
+            mAckedUnderruns[i] = command.mUnderruns;
+            break;
+        default:
+            ALOGW("unknown fast track command %d", command.mType);
+            break;
+        }
+    }
+}
+
 void FastMixer::onWork()
 {
     const FastMixerState * const current = (const FastMixerState *) mCurrent;
@@ -364,10 +404,19 @@ void FastMixer::onWork()
 
             int name = mFastTrackNames[i];
             ALOG_ASSERT(name >= 0);
+            if (fastTrack->mCommandQueue != NULL) {
+                processTrackCommands(i, fastTrack->mCommandQueue);
+            }
+            if (mTrackStoppedMask & (1 << i)) {
+                // stopped by the normal mixer, and not yet removed from the state;
+                // don't read framesReady() or count this cycle as an underrun
+                mMixer->disable(name);
+                continue;
+            }
             if (fastTrack->mVolumeProvider != NULL) {
                 gain_minifloat_packed_t vlr = fastTrack->mVolumeProvider->getVolumeLR();
-                float vlf = float_from_gain(gain_minifloat_unpack_left(vlr));
-                float vrf = float_from_gain(gain_minifloat_unpack_right(vlr));
+                float vlf = float_from_gain(gain_minifloat_unpack_left(vlr)) * mTrackVolumes[i];
+                float vrf = float_from_gain(gain_minifloat_unpack_right(vlr)) * mTrackVolumes[i];
 
                 mMixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME0, &vlf);
                 mMixer->setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME1, &vrf);
@@ -407,6 +456,8 @@ void FastMixer::onWork()
             }
             ftDump->mUnderruns = underruns;
             ftDump->mFramesReady = framesReady;
+            ftDump->mUnackedUnderruns = ((underruns.mBitFields.mPartial +
+                    underruns.mBitFields.mEmpty) - mAckedUnderruns[i]) & UNDERRUN_MASK;
         }
 
         int64_t pts;
@@ -48,6 +48,9 @@ private:
     virtual void onStateChange();
     virtual void onWork();
 
+    void resetTrackCommandState(int i);
+    void processTrackCommands(int i, FastTrackCommandQueue *queue);
+
     // FIXME these former local variables need comments
     static const FastMixerState sInitial;
 
@@ -57,6 +60,12 @@ private:
                                 // handles used by mixer to identify tracks
     int             mGenerations[FastMixerState::kMaxFastTracks];
                                 // last observed mFastTracks[i].mGeneration
+    // Per-track state received through FastTrack::mCommandQueue
+    float           mTrackVolumes[FastMixerState::kMaxFastTracks];
+                                // combined master volume and stream type volume
+    uint32_t        mTrackStoppedMask;  // bit i is set if mFastTracks[i] was stopped
+    uint32_t        mAckedUnderruns[FastMixerState::kMaxFastTracks];
+                                // partial + empty underruns acknowledged by the normal mixer
     NBAIO_Sink*     mOutputSink;
     int             mOutputSinkGen;
     AudioMixer*     mMixer;
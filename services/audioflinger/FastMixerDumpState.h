@@ -53,10 +53,12 @@ private:
 
 // Represents the dump state of a fast track
 struct FastTrackDump {
-    FastTrackDump() : mFramesReady(0) { }
+    FastTrackDump() : mFramesReady(0), mUnackedUnderruns(0) { }
     /*virtual*/ ~FastTrackDump() { }
     FastTrackUnderruns  mUnderruns;
     size_t              mFramesReady;        // most recent value only; no long-term statistics kept
+    uint32_t            mUnackedUnderruns;   // partial and empty underruns not yet acknowledged
+                                             // by the normal mixer, see FastTrackCommand
 };
 
 struct FastMixerDumpState : FastThreadDumpState {
@@ -23,6 +23,7 @@
 #include <media/nbaio/NBAIO.h>
 #include <media/nbaio/NBLog.h>
 #include "FastThreadState.h"
+#include "FastTrackCommandQueue.h"
 
 namespace android {
 
@@ -44,6 +45,7 @@ struct FastTrack {
 
     ExtendedAudioBufferProvider* mBufferProvider; // must be NULL if inactive, or non-NULL if active
     VolumeProvider*         mVolumeProvider; // optional; if NULL then full-scale
+    FastTrackCommandQueue*  mCommandQueue;   // optional; commands from the normal mixer
     audio_channel_mask_t    mChannelMask;    // AUDIO_CHANNEL_OUT_MONO or AUDIO_CHANNEL_OUT_STEREO
     audio_format_t          mFormat;         // track format
     int                     mGeneration;     // increment when any field is assigned
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FAST_TRACK_COMMAND_QUEUE_H
+#define ANDROID_AUDIO_FAST_TRACK_COMMAND_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+namespace android {
+
+// A command from the normal mixer to the fast mixer about one fast track.
+struct FastTrackCommand {
+    enum Type {
+        VOLUME,     // mVolume is the new combined master volume and stream type volume
+        START,      // resume mixing the track
+        STOP,       // stop mixing the track immediately, without waiting for a state push
+        // Acknowledges the underruns observed by the normal mixer up to mUnderruns,
+        // the fast mixer then reports the number of unacknowledged underruns in
+        // FastTrackDump::mUnackedUnderruns.
+        ACK_UNDERRUNS,
+    };
+    Type        mType;
+    union {
+        float       mVolume;        // VOLUME
+        uint32_t    mUnderruns;     // ACK_UNDERRUNS, partial + empty underrun count
+    };
+};
+
+// Wait-free single producer (normal mixer) and single consumer (fast mixer) ring of
+// FastTrackCommand, one per fast track.  Neither side ever blocks: push() fails if the
+// ring is full, and pop() fails if it is empty.  This lets the normal mixer update a fast
+// track without building and pushing a complete FastMixerState, and without the fast mixer
+// ever waiting on the normal mixer's lock.
+class FastTrackCommandQueue {
+public:
+    static const uint32_t kCapacity = 16;  // must be a power of 2
+
+    FastTrackCommandQueue() {
+        atomic_init(&mFront, 0u);
+        atomic_init(&mRear, 0u);
+    }
+
+    // Producer API, called only by the normal mixer thread.
+    // Returns false, and does not enqueue, if the ring is full.
+    bool push(const FastTrackCommand& command) {
+        const uint32_t rear = atomic_load_explicit(&mRear, memory_order_relaxed);
+        const uint32_t front = atomic_load_explicit(&mFront, memory_order_acquire);
+        if (rear - front >= kCapacity) {
+            return false;
+        }
+        mCommands[rear & (kCapacity - 1)] = command;
+        atomic_store_explicit(&mRear, rear + 1, memory_order_release);
+        return true;
+    }
+
+    // Consumer API, called only by the fast mixer thread.
+    // Returns false if there is no pending command.
+    bool pop(FastTrackCommand *command) {
+        const uint32_t front = atomic_load_explicit(&mFront, memory_order_relaxed);
+        const uint32_t rear = atomic_load_explicit(&mRear, memory_order_acquire);
+        if (front == rear) {
+            return false;
+        }
+        *command = mCommands[front & (kCapacity - 1)];
+        atomic_store_explicit(&mFront, front + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    FastTrackCommand        mCommands[kCapacity];
+    atomic_uint_least32_t   mFront;     // next command to pop, written by consumer only
+    atomic_uint_least32_t   mRear;      // next slot to push, written by producer only
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_FAST_TRACK_COMMAND_QUEUE_H
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MixerWorkerPool"
+//#define LOG_NDEBUG 0
+
+#include "Configuration.h"
+#include <stdio.h>
+#include <utils/Log.h>
+#include "MixerWorkerPool.h"
+
+namespace android {
+
+MixerWorkerPool::WorkerThread::WorkerThread(MixerWorkerPool *pool, uint32_t index)
+    :   Thread(false /*canCallJava*/), mPool(pool), mIndex(index), mGeneration(0)
+{
+}
+
+bool MixerWorkerPool::WorkerThread::threadLoop()
+{
+    {
+        AutoMutex _l(mPool->mLock);
+        while (mGeneration == mPool->mGeneration && !mPool->mExit) {
+            mPool->mWorkCond.wait(mPool->mLock);
+        }
+        if (mPool->mExit) {
+            return false;
+        }
+        mGeneration = mPool->mGeneration;
+    }
+    mPool->execute(mIndex);
+    return true;
+}
+
+MixerWorkerPool::MixerWorkerPool(uint32_t numThreads, int priority)
+    :   mNumThreads(numThreads < MAX_THREADS ? numThreads : MAX_THREADS),
+        mGeneration(0), mPending(0), mExit(false), mJob(NULL), mCookie(NULL)
+{
+    for (uint32_t i = 0; i < mNumThreads; ++i) {
+        char name[16];
+        snprintf(name, sizeof(name), "AudioMixWorker%u", i + 1);
+        mThreads[i] = new WorkerThread(this, i + 1);
+        status_t status = mThreads[i]->run(name, priority);
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR, "failed to start %s: %d", name, status);
+    }
+}
+
+MixerWorkerPool::~MixerWorkerPool()
+{
+    {
+        AutoMutex _l(mLock);
+        mExit = true;
+        mWorkCond.broadcast();
+    }
+    for (uint32_t i = 0; i < mNumThreads; ++i) {
+        mThreads[i]->requestExitAndWait();
+        mThreads[i].clear();
+    }
+}
+
+void MixerWorkerPool::run(job_t job, void *cookie)
+{
+    {
+        AutoMutex _l(mLock);
+        mJob = job;
+        mCookie = cookie;
+        mPending = mNumThreads;
+        ++mGeneration;
+        mWorkCond.broadcast();
+    }
+    execute(0);
+    AutoMutex _l(mLock);
+    while (mPending > 0) {
+        mDoneCond.wait(mLock);
+    }
+}
+
+void MixerWorkerPool::execute(uint32_t index)
+{
+    const nsecs_t start = systemTime();
+    mJob(mCookie, index);
+    const nsecs_t duration = systemTime() - start;
+
+    AutoMutex _l(mLock);
+    updateStats(index, duration);
+    if (index != 0 && --mPending == 0) {
+        mDoneCond.signal();
+    }
+}
+
+void MixerWorkerPool::updateStats(uint32_t index, nsecs_t duration)
+{
+    Stats& stats = mStats[index];
+    ++stats.mJobs;
+    stats.mLastNs = duration;
+    if (duration > stats.mMaxNs) {
+        stats.mMaxNs = duration;
+    }
+    stats.mTotalNs += duration;
+}
+
+void MixerWorkerPool::resetStats()
+{
+    AutoMutex _l(mLock);
+    for (uint32_t i = 0; i < MAX_WORKERS; ++i) {
+        mStats[i] = Stats();
+    }
+}
+
+void MixerWorkerPool::dump(int fd, uint32_t budgetUs) const
+{
+    Stats stats[MAX_WORKERS];
+    {
+        AutoMutex _l(mLock);
+        for (uint32_t i = 0; i < workers(); ++i) {
+            stats[i] = mStats[i];
+        }
+    }
+    dprintf(fd, "  Parallel mix workers: %u", workers());
+    if (budgetUs != 0) {
+        dprintf(fd, ", budget %u us", budgetUs);
+    }
+    dprintf(fd, "\n");
+    dprintf(fd, "    Worker    Jobs   Last(us)   Mean(us)    Max(us)\n");
+    for (uint32_t i = 0; i < workers(); ++i) {
+        const Stats& s = stats[i];
+        const double meanUs = s.mJobs > 0 ? s.mTotalNs * 1e-3 / s.mJobs : 0.;
+        dprintf(fd, "    %6u %7u %10.1f %10.1f %10.1f%s\n",
+                i, s.mJobs, s.mLastNs * 1e-3, meanUs, s.mMaxNs * 1e-3,
+                budgetUs != 0 && s.mMaxNs > (nsecs_t)budgetUs * 1000 ? " over budget" : "");
+    }
+}
+
+}   // namespace android
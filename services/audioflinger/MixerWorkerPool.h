@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// A small pool of fixed priority threads used by AudioMixer to mix
+// groups of tracks in parallel.  The calling thread participates in
+// every job as worker 0, so a pool of N threads has N + 1 workers.
+
+#ifndef ANDROID_MIXER_WORKER_POOL_H
+#define ANDROID_MIXER_WORKER_POOL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Thread.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+class MixerWorkerPool {
+public:
+    // upper limit on the number of threads in the pool, not counting the caller
+    static const uint32_t MAX_THREADS = 3;
+    static const uint32_t MAX_WORKERS = MAX_THREADS + 1;
+
+    // job(cookie, index) is called once for each worker index in [0, workers()).
+    typedef void (*job_t)(void *cookie, uint32_t index);
+
+    // Starts numThreads (at most MAX_THREADS) threads at the given priority.
+    MixerWorkerPool(uint32_t numThreads, int priority);
+    ~MixerWorkerPool();
+
+    // number of workers, including the calling thread
+    uint32_t    workers() const { return mNumThreads + 1; }
+
+    // Runs the job on all workers, and returns once every worker is done.
+    // Must be called from a single thread, which executes the job for index 0.
+    void        run(job_t job, void *cookie);
+
+    // Per-worker mix time statistics, updated after each job.
+    struct Stats {
+        Stats() : mJobs(0), mLastNs(0), mMaxNs(0), mTotalNs(0) { }
+        uint32_t    mJobs;      // number of jobs completed
+        nsecs_t     mLastNs;    // duration of the most recent job
+        nsecs_t     mMaxNs;     // longest job since creation or last resetStats()
+        nsecs_t     mTotalNs;   // sum of all job durations
+    };
+
+    void        resetStats();
+
+    // dump the statistics; budgetUs is the deadline to compare the mix times against,
+    // or 0 if none.
+    void        dump(int fd, uint32_t budgetUs) const;
+
+private:
+    class WorkerThread : public Thread {
+    public:
+        WorkerThread(MixerWorkerPool *pool, uint32_t index);
+    private:
+        virtual bool threadLoop();
+        MixerWorkerPool * const mPool;
+        const uint32_t  mIndex;
+        uint32_t        mGeneration;    // last job generation executed
+    };
+
+    void        execute(uint32_t index);
+    void        updateStats(uint32_t index, nsecs_t duration);
+
+    const uint32_t      mNumThreads;
+    sp<WorkerThread>    mThreads[MAX_THREADS];
+
+    mutable Mutex       mLock;
+    Condition           mWorkCond;      // signaled when a new job is posted, or on exit
+    Condition           mDoneCond;      // signaled when the last pending worker is done
+    uint32_t            mGeneration;    // incremented for every job posted
+    uint32_t            mPending;       // number of threads still running the current job
+    bool                mExit;
+    job_t               mJob;
+    void*               mCookie;
+    Stats               mStats[MAX_WORKERS];
+};
+
+}   // namespace android
+
+#endif  // ANDROID_MIXER_WORKER_POOL_H
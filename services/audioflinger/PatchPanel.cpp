@@ -387,25 +387,31 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
         return status;
     }
 
-    // use a pseudo LCM between input and output framecount
-    size_t playbackFrameCount = patch->mPlaybackThread->frameCount();
-    int playbackShift = __builtin_ctz(playbackFrameCount);
-    size_t recordFramecount = patch->mRecordThread->frameCount();
-    int shift = __builtin_ctz(recordFramecount);
-    if (playbackShift < shift) {
-        shift = playbackShift;
-    }
-    size_t frameCount = (playbackFrameCount * recordFramecount) >> shift;
-    ALOGV("createPatchConnections() playframeCount %d recordFramecount %d frameCount %d ",
-          playbackFrameCount, recordFramecount, frameCount);
-
-    // create a special record track to capture from record thread
     uint32_t channelCount = patch->mPlaybackThread->channelCount();
     audio_channel_mask_t inChannelMask = audio_channel_in_mask_from_count(channelCount);
     audio_channel_mask_t outChannelMask = patch->mPlaybackThread->channelMask();
     uint32_t sampleRate = patch->mPlaybackThread->sampleRate();
     audio_format_t format = patch->mPlaybackThread->format();
 
+    // The mixer must find a full mix buffer while the record thread delivers a period at a
+    // time, whatever the phase between the two threads. Keeping a period of each plus half
+    // of the shorter one buffered covers that, and the playback track corrects the clock
+    // drift that would move away from it. The buffer only needs headroom on top of that,
+    // a common multiple of both periods would add its full length to the latency once the
+    // clocks drift apart.
+    size_t playbackFrameCount = patch->mPlaybackThread->frameCount();
+    uint32_t recordSampleRate = patch->mRecordThread->sampleRate();
+    size_t recordFrameCount = ((uint64_t)patch->mRecordThread->frameCount() * sampleRate
+            + recordSampleRate - 1) / recordSampleRate;
+    size_t shorterFrameCount = playbackFrameCount < recordFrameCount ?
+            playbackFrameCount : recordFrameCount;
+    size_t targetFrames = playbackFrameCount + recordFrameCount + shorterFrameCount / 2;
+    size_t frameCount = 2 * (playbackFrameCount + recordFrameCount);
+    ALOGV("createPatchConnections() playFrameCount %zu recordFrameCount %zu frameCount %zu "
+          "targetFrames %zu", playbackFrameCount, recordFrameCount, frameCount, targetFrames);
+
+    // create a special record track to capture from record thread
+
     patch->mPatchRecord = new RecordThread::PatchRecord(
                                              patch->mRecordThread.get(),
                                              sampleRate,
@@ -441,6 +447,7 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
     if (status != NO_ERROR) {
         return status;
     }
+    patch->mPatchTrack->setRateCorrectionTarget(targetFrames);
     patch->mPlaybackThread->addPatchTrack(patch->mPatchTrack);
 
     // tie playback and record tracks together
@@ -605,6 +612,33 @@ status_t AudioFlinger::PatchPanel::listAudioPatches(unsigned int *num_patches __
     return NO_ERROR;
 }
 
+void AudioFlinger::PatchPanel::dump(int fd) const
+{
+    bool header = false;
+    for (size_t i = 0; i < mPatches.size(); i++) {
+        const Patch *patch = mPatches[i];
+        const sp<PlaybackThread::PatchTrack> track = patch->mPatchTrack;
+        if (track == 0) {
+            continue;
+        }
+        if (!header) {
+            dprintf(fd, "\nSoftware patches:\n");
+            header = true;
+        }
+        // the buffered frames are what the patch adds to the latency of both threads
+        const TrackRateCorrector& corrector = track->rateCorrector();
+        const uint32_t sampleRate = corrector.nominalSampleRate();
+        dprintf(fd, "  Patch %d: record thread %d to playback thread %d, %zu frames buffer\n",
+                patch->mHandle, patch->mRecordThread->id(), patch->mPlaybackThread->id(),
+                track->bufferFrameCount());
+        dprintf(fd, "    buffered %.0f frames (%.1f ms), target %zu frames (%.1f ms), "
+                "rate %u Hz for %u Hz\n",
+                corrector.averageFrames(), corrector.averageFrames() * 1000 / sampleRate,
+                corrector.targetFrames(), corrector.targetFrames() * 1000.0f / sampleRate,
+                track->sampleRate(), sampleRate);
+    }
+}
+
 /* Set audio port configuration */
 status_t AudioFlinger::PatchPanel::setAudioPortConfig(const struct audio_port_config *config)
 {
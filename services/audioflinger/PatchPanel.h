@@ -48,6 +48,8 @@ public:
     /* Set audio port configuration */
     status_t setAudioPortConfig(const struct audio_port_config *config);
 
+    void dump(int fd) const;
+
     status_t createPatchConnections(Patch *patch,
                                     const struct audio_patch *audioPatch);
     void clearPatchConnections(Patch *patch);
@@ -101,6 +101,15 @@ protected:
     void flushAck();
     bool isResumePending();
     void resumeAck();
+    // called by prepareTracks_l() once per mix, before the requested sample rate is read
+    void updateRateCorrection_l();
+
+    // Timestamp of a mixed track derived from the thread's latched sink timestamp.
+    status_t getLatchedTimestamp_l(const PlaybackThread *playbackThread,
+                                   AudioTimestamp& timestamp);
+    // called by the thread once per mix, after the sink timestamp is latched, so that the
+    // client reads it from the control block instead of calling getTimestamp()
+    void publishTimestamp_l(const PlaybackThread *playbackThread);
 
     sp<IMemory> sharedBuffer() const { return mSharedBuffer; }
 
@@ -115,6 +124,14 @@ public:
     bool isInvalid() const { return mIsInvalid; }
     int fastIndex() const { return mFastIndex; }
 
+    // For tracks filled by another AudioFlinger thread running on a different clock, like
+    // the tracks of software patches and of duplicating threads: keeps the number of frames
+    // buffered near targetFrames by adjusting the rate the mixer consumes them at.
+    // 0 disables the correction.
+    void setRateCorrectionTarget(size_t targetFrames)
+            { mRateCorrector.setTarget(mSampleRate, targetFrames); }
+    const TrackRateCorrector& rateCorrector() const { return mRateCorrector; }
+
 protected:
 
     // FILLED state is used for suppressing volume ramp at begin of playing
@@ -148,13 +165,16 @@ private:
                                     // but the slot is only used if track is active
     FastTrackUnderruns  mObservedUnderruns; // Most recently observed value of
                                     // mFastMixerDumpState.mTracks[mFastIndex].mUnderruns
-    volatile float      mCachedVolume;  // combined master volume and stream type volume;
-                                        // 'volatile' means accessed without lock or
-                                        // barrier, but is read/written atomically
+    float               mCachedVolume;  // combined master volume and stream type volume
+                                        // most recently sent to the fast mixer through
+                                        // mFastCommandQueue; only used by the normal mixer
+    FastTrackCommandQueue mFastCommandQueue; // volume, start/stop and underrun
+                                        // acknowledgements to the fast mixer
     bool                mIsInvalid; // non-resettable latch, set by invalidate()
     AudioTrackServerProxy*  mAudioTrackServerProxy;
     bool                mResumeToStopping; // track was paused in stopping state.
     bool                mFlushHwPending; // track requests for thread flush
+    TrackRateCorrector  mRateCorrector; // only used by the mixer thread, see updateRateCorrection_l()
 
 };  // end of Track
 
@@ -314,6 +334,9 @@ public:
 
             void setPeerProxy(PatchProxyBufferProvider *proxy) { mPeerProxy = proxy; }
 
+            // for dumpsys
+            size_t bufferFrameCount() const { return mFrameCount; }
+
 private:
     sp<ClientProxy>             mProxy;
     PatchProxyBufferProvider*   mPeerProxy;
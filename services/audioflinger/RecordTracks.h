@@ -83,6 +83,10 @@ private:
 
             // used by the record thread to convert frames to proper destination format
             RecordBufferConverter              *mRecordBufferConverter;
+
+            // true if data was last converted by another track's mRecordBufferConverter,
+            // so that the resampler state of this one must be reset before it is used again
+            bool                                mConverterStale;
 };
 
 // playback track, used by PatchPanel
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SinkDrainEstimator"
+//#define LOG_NDEBUG 0
+
+#include "Configuration.h"
+#include <utils/Log.h>
+#include "SinkDrainEstimator.h"
+
+namespace android {
+
+const double SinkDrainEstimator::kRateAlpha = 0.125;
+
+void SinkDrainEstimator::reset(uint32_t nominalRate)
+{
+    mNominalRate = nominalRate;
+    mRate = nominalRate;
+    mLastPresented = 0;
+    mLastTime = 0;
+    mBasePresented = 0;
+    mBaseTime = 0;
+}
+
+void SinkDrainEstimator::addPosition(uint64_t presented, nsecs_t time)
+{
+    if (mLastTime == 0 || presented < mBasePresented || time <= mBaseTime
+            || time - mBaseTime > kMaxIntervalNs) {
+        // first position, position went backwards or a long gap: restart the measurement
+        mBasePresented = presented;
+        mBaseTime = time;
+    } else if (time - mBaseTime >= kMinIntervalNs) {
+        const double rate = (presented - mBasePresented) * 1e9 / (time - mBaseTime);
+        // ignore implausible rates, such as while the sink is still starting up
+        if (rate > mNominalRate * 0.5 && rate < mNominalRate * 2.0) {
+            mRate += (rate - mRate) * kRateAlpha;
+        }
+        mBasePresented = presented;
+        mBaseTime = time;
+    }
+    mLastPresented = presented;
+    mLastTime = time;
+}
+
+nsecs_t SinkDrainEstimator::timeUntilQueued(uint64_t written, uint64_t threshold,
+        nsecs_t now) const
+{
+    ALOG_ASSERT(hasPosition());
+    if (mRate <= 0.) {
+        return 0;
+    }
+    // extrapolate the presentation position to now
+    const double presented = mLastPresented + (now - mLastTime) * mRate * 1e-9;
+    const double queued = written - presented;
+    if (queued <= threshold) {
+        return 0;
+    }
+    return (nsecs_t) ((queued - threshold) * 1e9 / mRate);
+}
+
+}   // namespace android
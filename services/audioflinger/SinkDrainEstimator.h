@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_SINK_DRAIN_ESTIMATOR_H
+#define ANDROID_AUDIO_SINK_DRAIN_ESTIMATOR_H
+
+#include <stdint.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// SinkDrainEstimator estimates how fast an output sink actually consumes frames, from
+// successive (presented frames, time) pairs reported by the HAL, and predicts when the
+// frames queued in the sink will have drained down to a given level.
+//
+// The measured rate is smoothed, and samples implying a rate far from the nominal sample
+// rate (e.g. after standby, or a HAL position glitch) restart the measurement instead of
+// disturbing the estimate.  Not thread safe; used only by the owning thread loop.
+class SinkDrainEstimator {
+public:
+    SinkDrainEstimator() { reset(0); }
+
+    // forgets all samples; nominalRate is the sink sample rate in Hz
+    void        reset(uint32_t nominalRate);
+
+    // presented is the number of frames presented at time, both as returned by
+    // AudioStreamOut::getPresentationPosition()
+    void        addPosition(uint64_t presented, nsecs_t time);
+
+    // true once at least one position has been added since reset()
+    bool        hasPosition() const { return mLastTime != 0; }
+
+    // estimated consumption rate in frames per second, the nominal rate until measured
+    double      rate() const { return mRate; }
+
+    // Returns the time from now until only threshold of the written frames are still
+    // queued in the sink, or 0 if that is already the case.  Requires hasPosition().
+    nsecs_t     timeUntilQueued(uint64_t written, uint64_t threshold, nsecs_t now) const;
+
+private:
+    // weight of a new rate measurement in the smoothed rate
+    static const double kRateAlpha;
+    // measurement intervals shorter than this are too noisy and are accumulated
+    static const nsecs_t kMinIntervalNs = 5000000;
+    // measurement intervals longer than this (e.g. after standby) restart the measurement
+    static const nsecs_t kMaxIntervalNs = 1000000000;
+
+    uint32_t    mNominalRate;
+    double      mRate;
+    uint64_t    mLastPresented;     // most recent position
+    nsecs_t     mLastTime;          // time of mLastPresented, 0 if none
+    uint64_t    mBasePresented;     // start of the current measurement interval
+    nsecs_t     mBaseTime;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_SINK_DRAIN_ESTIMATOR_H
@@ -17,6 +17,9 @@
 
 #define LOG_TAG "AudioFlinger"
 //#define LOG_NDEBUG 0
+#include <stdio.h>
+#include <string.h>
+
 #include <hardware/audio.h>
 #include <utils/Log.h>
 
@@ -41,7 +44,22 @@ SpdifStreamOut::SpdifStreamOut(AudioHwDevice *dev,
         , mApplicationFormat(AUDIO_FORMAT_DEFAULT)
         , mApplicationSampleRate(0)
         , mApplicationChannelMask(0)
+        , mRing(NULL)
+        , mRingSize(0)
+        , mHalPeriodBytes(0)
+        , mRingFront(0)
+        , mRingFilled(0)
+        , mNumBursts(0)
+        , mNumUnalignedBursts(0)
+        , mNumHalWrites(0)
+        , mNumShortHalWrites(0)
+        , mBytesPadded(0)
+{
+}
+
+SpdifStreamOut::~SpdifStreamOut()
 {
+    delete[] mRing;
 }
 
 status_t SpdifStreamOut::open(
@@ -99,24 +117,128 @@ status_t SpdifStreamOut::open(
 
     ALOGI("SpdifStreamOut::open() status = %d", status);
 
+    if (status == NO_ERROR) {
+        mHalPeriodBytes = stream->common.get_buffer_size(&stream->common);
+        if (mHalPeriodBytes < mHalFrameSize) {
+            mHalPeriodBytes = mHalFrameSize;
+        }
+        size_t periods = (kMinRingBytes + mHalPeriodBytes - 1) / mHalPeriodBytes;
+        if (periods < 2) {
+            periods = 2;
+        }
+        delete[] mRing;
+        mRingSize = periods * mHalPeriodBytes;
+        mRing = new uint8_t[mRingSize];
+        resetRing();
+
+        mNumBursts = 0;
+        mNumUnalignedBursts = 0;
+        mNumHalWrites = 0;
+        mNumShortHalWrites = 0;
+        mBytesPadded = 0;
+        ALOGV("SpdifStreamOut::open() ring of %zu periods of %zu bytes",
+                periods, mHalPeriodBytes);
+    }
+
     return status;
 }
 
 int SpdifStreamOut::flush()
 {
     mSpdifEncoder.reset();
+    resetRing();
     return AudioStreamOut::flush();
 }
 
 int SpdifStreamOut::standby()
 {
     mSpdifEncoder.reset();
+    // Complete the last period with zeros, which is valid stuffing between data bursts,
+    // rather than drop the end of the last burst.
+    size_t partial = mRing != NULL ? mRingFilled % mHalPeriodBytes : 0;
+    if (partial != 0) {
+        size_t padding = mHalPeriodBytes - partial;
+        size_t rear = (mRingFront + mRingFilled) % mRingSize;
+        size_t first = padding < mRingSize - rear ? padding : mRingSize - rear;
+        memset(mRing + rear, 0, first);
+        memset(mRing, 0, padding - first);
+        mRingFilled += padding;
+        mBytesPadded += padding;
+        writeRingToHal();
+    }
+    resetRing();
     return AudioStreamOut::standby();
 }
 
+void SpdifStreamOut::resetRing()
+{
+    mRingFront = 0;
+    mRingFilled = 0;
+}
+
+// Writes all the whole periods in the ring, at most two HAL writes when the ring wraps.
+ssize_t SpdifStreamOut::writeRingToHal()
+{
+    size_t toWrite = mRingFilled - (mRingFilled % mHalPeriodBytes);
+    size_t written = 0;
+    while (written < toWrite) {
+        size_t chunk = toWrite - written;
+        if (chunk > mRingSize - mRingFront) {
+            chunk = mRingSize - mRingFront;
+        }
+        ssize_t result = AudioStreamOut::write(mRing + mRingFront, chunk);
+        mNumHalWrites++;
+        if (result < 0) {
+            return written > 0 ? (ssize_t) written : result;
+        }
+        mRingFront = (mRingFront + result) % mRingSize;
+        mRingFilled -= result;
+        written += result;
+        if ((size_t) result < chunk) {
+            mNumShortHalWrites++;
+            break;
+        }
+    }
+    return written;
+}
+
 ssize_t SpdifStreamOut::writeDataBurst(const void* buffer, size_t bytes)
 {
-    return AudioStreamOut::write(buffer, bytes);
+    mNumBursts++;
+    if (bytes % mHalPeriodBytes != 0) {
+        mNumUnalignedBursts++;
+    }
+
+    const uint8_t *src = (const uint8_t *) buffer;
+    size_t copied = 0;
+    while (copied < bytes) {
+        if (mRingFilled == mRingSize) {
+            ssize_t result = writeRingToHal();
+            if (result <= 0) {
+                return copied > 0 ? (ssize_t) copied : result;
+            }
+        }
+        size_t rear = (mRingFront + mRingFilled) % mRingSize;
+        size_t chunk = bytes - copied;
+        if (chunk > mRingSize - mRingFilled) {
+            chunk = mRingSize - mRingFilled;
+        }
+        if (chunk > mRingSize - rear) {
+            chunk = mRingSize - rear;
+        }
+        memcpy(mRing + rear, src + copied, chunk);
+        mRingFilled += chunk;
+        copied += chunk;
+    }
+
+    // Batch all the complete periods in as few HAL writes as possible.
+    if (mRingFilled >= mHalPeriodBytes) {
+        ssize_t result = writeRingToHal();
+        if (result < 0) {
+            return result;
+        }
+    }
+    return bytes;
 }
 
 ssize_t SpdifStreamOut::write(const void* buffer, size_t numBytes)
@@ -125,4 +247,15 @@ ssize_t SpdifStreamOut::write(const void* buffer, size_t numBytes)
     return mSpdifEncoder.write(buffer, numBytes);
 }
 
+void SpdifStreamOut::dump(int fd) const
+{
+    dprintf(fd, "  SPDIF ring: %zu bytes of %zu (%zu byte HAL periods)\n",
+            mRingFilled, mRingSize, mHalPeriodBytes);
+    dprintf(fd, "  SPDIF data bursts: %llu, not period aligned: %llu\n",
+            (unsigned long long) mNumBursts, (unsigned long long) mNumUnalignedBursts);
+    dprintf(fd, "  SPDIF HAL writes: %llu, short: %llu, bytes padded: %llu\n",
+            (unsigned long long) mNumHalWrites, (unsigned long long) mNumShortHalWrites,
+            (unsigned long long) mBytesPadded);
+}
+
 } // namespace android
@@ -41,7 +41,7 @@ public:
     SpdifStreamOut(AudioHwDevice *dev, audio_output_flags_t flags,
             audio_format_t format);
 
-    virtual ~SpdifStreamOut() { }
+    virtual ~SpdifStreamOut();
 
     virtual status_t open(
             audio_io_handle_t handle,
@@ -89,6 +89,8 @@ public:
     virtual status_t flush();
     virtual status_t standby();
 
+    virtual void dump(int fd) const;
+
 private:
 
     class MySPDIFEncoder : public SPDIFEncoder
@@ -116,6 +118,27 @@ private:
     ssize_t  writeDataBurst(const void* data, size_t bytes);
     ssize_t  writeInternal(const void* buffer, size_t bytes);
 
+    // The data bursts are gathered in a ring of a whole number of HAL periods, and only
+    // whole periods are written to the HAL, so that a burst that does not end on a period
+    // boundary never causes a short HAL write.
+    ssize_t  writeRingToHal();
+    void     resetRing();
+
+    static const size_t kMinRingBytes = 32768;  // a few of the largest data bursts
+
+    uint8_t             *mRing;
+    size_t               mRingSize;         // multiple of mHalPeriodBytes
+    size_t               mHalPeriodBytes;
+    size_t               mRingFront;        // next byte to write to the HAL
+    size_t               mRingFilled;
+
+    // statistics, reset by open() only
+    uint64_t             mNumBursts;
+    uint64_t             mNumUnalignedBursts;   // not a multiple of the HAL period
+    uint64_t             mNumHalWrites;
+    uint64_t             mNumShortHalWrites;
+    uint64_t             mBytesPadded;          // zeros written at standby
+
 };
 
 } // namespace android
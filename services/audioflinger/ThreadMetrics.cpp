@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ThreadMetrics"
+//#define LOG_NDEBUG 0
+
+#include "Configuration.h"
+#include <stdio.h>
+#include <utils/Log.h>
+#include "ThreadMetrics.h"
+
+namespace android {
+
+LatencyHistogram::LatencyHistogram()
+{
+    for (uint32_t i = 0; i < kNumBuckets; ++i) {
+        atomic_init(&mBuckets[i], 0u);
+    }
+    atomic_init(&mCount, 0u);
+    atomic_init(&mMaxUs, 0u);
+    atomic_init(&mTotalUs, (uint_fast64_t) 0);
+}
+
+/*static*/ uint32_t LatencyHistogram::bucketOf(uint32_t us)
+{
+    if (us < kLinearUs) {
+        return us;
+    }
+    // octave 0 starts at kLinearUs
+    const uint32_t log2 = 31 - __builtin_clz(us);
+    uint32_t octave = log2 - (31 - __builtin_clz(kLinearUs));
+    if (octave >= kOctaves) {
+        return kNumBuckets - 1;
+    }
+    const uint32_t sub = (us >> (log2 - kSubBucketBits)) & ((1 << kSubBucketBits) - 1);
+    return kLinearUs + (octave << kSubBucketBits) + sub;
+}
+
+/*static*/ uint32_t LatencyHistogram::upperBoundUs(uint32_t bucket)
+{
+    if (bucket < kLinearUs) {
+        return bucket;
+    }
+    const uint32_t octave = (bucket - kLinearUs) >> kSubBucketBits;
+    const uint32_t sub = (bucket - kLinearUs) & ((1 << kSubBucketBits) - 1);
+    const uint32_t base = kLinearUs << octave;
+    return base + (((sub + 1) * base) >> kSubBucketBits) - 1;
+}
+
+void LatencyHistogram::add(nsecs_t ns)
+{
+    // single writer, so relaxed load and store are sufficient and never spin
+    const uint32_t us = ns <= 0 ? 0 : ns >= (nsecs_t) UINT32_MAX * 1000 ? UINT32_MAX : ns / 1000;
+    atomic_uint_least32_t *bucket = &mBuckets[bucketOf(us)];
+    atomic_store_explicit(bucket,
+            atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+    if (us > atomic_load_explicit(&mMaxUs, memory_order_relaxed)) {
+        atomic_store_explicit(&mMaxUs, us, memory_order_relaxed);
+    }
+    atomic_store_explicit(&mTotalUs,
+            atomic_load_explicit(&mTotalUs, memory_order_relaxed) + us, memory_order_relaxed);
+    atomic_store_explicit(&mCount,
+            atomic_load_explicit(&mCount, memory_order_relaxed) + 1, memory_order_release);
+}
+
+void LatencyHistogram::snapshot(Summary *summary) const
+{
+    uint32_t buckets[kNumBuckets];
+    const uint32_t count = atomic_load_explicit(&mCount, memory_order_acquire);
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < kNumBuckets; ++i) {
+        buckets[i] = atomic_load_explicit(&mBuckets[i], memory_order_relaxed);
+        total += buckets[i];
+    }
+    summary->mCount = count;
+    summary->mMaxUs = atomic_load_explicit(&mMaxUs, memory_order_relaxed);
+    summary->mMeanUs = count > 0 ?
+            (double) atomic_load_explicit(&mTotalUs, memory_order_relaxed) / count : 0.;
+    const uint64_t targets[3] = { total * 50ULL, total * 90ULL, total * 99ULL };
+    uint32_t *results[3] = { &summary->mP50Us, &summary->mP90Us, &summary->mP99Us };
+    uint64_t cumulative = 0;
+    uint32_t t = 0;
+    for (uint32_t i = 0; i < kNumBuckets && t < 3; ++i) {
+        cumulative += buckets[i] * 100ULL;
+        while (t < 3 && cumulative >= targets[t] && total > 0) {
+            // the bucket upper bound can exceed the largest sample actually recorded
+            const uint32_t bound = upperBoundUs(i);
+            *results[t++] = bound < summary->mMaxUs ? bound : summary->mMaxUs;
+        }
+    }
+    while (t < 3) {
+        *results[t++] = 0;
+    }
+}
+
+void LatencyHistogram::dump(int fd, const char *name) const
+{
+    Summary s;
+    snapshot(&s);
+    if (s.mCount == 0) {
+        return;
+    }
+    dprintf(fd, "    %-12s %10u %10.1f %8u %8u %8u %8u\n", name, s.mCount, s.mMeanUs,
+            s.mP50Us, s.mP90Us, s.mP99Us, s.mMaxUs);
+}
+
+void ThreadMetrics::dump(int fd, const char *ioName, const char *underrunName) const
+{
+    dprintf(fd, "  Latency histograms (us):\n");
+    dprintf(fd, "    %-12s %10s %10s %8s %8s %8s %8s\n",
+            "", "count", "mean", "50%", "90%", "99%", "max");
+    mIoNs.dump(fd, ioName);
+    mProcessNs.dump(fd, "process");
+    mWakeJitterNs.dump(fd, "wake jitter");
+    dprintf(fd, "  %s: %u\n", underrunName,
+            atomic_load_explicit(&mUnderruns, memory_order_relaxed));
+}
+
+}   // namespace android
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_THREAD_METRICS_H
+#define ANDROID_AUDIO_THREAD_METRICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// LatencyHistogram is a fixed size log-linear histogram of durations, with a resolution of
+// 1/8 octave above 16 us and a range of about 16 seconds.
+//
+// It is designed to be recorded into by a single real-time thread (the audio thread that
+// owns it) without locks, and to be read concurrently by dumpsys.  Each bucket is updated
+// atomically, but a reader may observe a sample in the total count before it appears in a
+// bucket, which only matters for percentiles computed from a single sample.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    // writer thread only; negative durations are counted as 0
+    void        add(nsecs_t ns);
+
+    // result of snapshot(), in microseconds
+    struct Summary {
+        uint32_t    mCount;
+        uint32_t    mP50Us;
+        uint32_t    mP90Us;
+        uint32_t    mP99Us;
+        uint32_t    mMaxUs;
+        double      mMeanUs;
+    };
+
+    // any thread
+    void        snapshot(Summary *summary) const;
+
+    // prints one line with the name, count and percentiles, or nothing if empty
+    void        dump(int fd, const char *name) const;
+
+private:
+    static const uint32_t kLinearUs = 16;       // 0 to 15 us have one bucket per us
+    static const uint32_t kSubBucketBits = 3;   // 8 buckets per octave above that
+    static const uint32_t kOctaves = 20;        // 16 us to 16 s
+    static const uint32_t kNumBuckets = kLinearUs + (kOctaves << kSubBucketBits);
+
+    static uint32_t bucketOf(uint32_t us);
+    static uint32_t upperBoundUs(uint32_t bucket);
+
+    atomic_uint_least32_t   mBuckets[kNumBuckets];
+    atomic_uint_least32_t   mCount;
+    atomic_uint_least32_t   mMaxUs;
+    atomic_uint_fast64_t    mTotalUs;
+};
+
+// Timing statistics kept by every ThreadBase, and shown by dumpsys media.audio_flinger.
+struct ThreadMetrics {
+    ThreadMetrics() { atomic_init(&mUnderruns, 0u); }
+
+    LatencyHistogram    mIoNs;          // duration of each HAL write() or read()
+    LatencyHistogram    mProcessNs;     // duration of each mix (or other processing) cycle
+    LatencyHistogram    mWakeJitterNs;  // how much later than requested a sleep returned
+    atomic_uint_least32_t mUnderruns;   // delayed writes for playback, overruns for capture
+
+    void        noteUnderrun() {
+        atomic_fetch_add_explicit(&mUnderruns, 1u, memory_order_relaxed);
+    }
+
+    // ioName and underrunName describe mIoNs and mUnderruns for this type of thread
+    void        dump(int fd, const char *ioName, const char *underrunName) const;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_THREAD_METRICS_H
@@ -67,6 +67,7 @@
 #include <media/nbaio/Pipe.h>
 #include <media/nbaio/PipeReader.h>
 #include <media/nbaio/SourceAudioBufferProvider.h>
+#include <media/stagefright/foundation/ACpuAccounting.h>
 
 #include <powermanager/PowerManager.h>
 
@@ -228,6 +229,40 @@ static void sFastTrackMultiplierInit()
     }
 }
 
+// Number of extra threads used by each MixerThread's AudioMixer to mix tracks in parallel,
+// specified per-device via property af.mixer.workers.  0 (the default) disables parallel mixing.
+static uint32_t sMixerWorkerThreads = 0;
+
+static pthread_once_t sMixerWorkerThreadsOnce = PTHREAD_ONCE_INIT;
+
+static void sMixerWorkerThreadsInit()
+{
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("af.mixer.workers", value, NULL) > 0) {
+        char *endptr;
+        unsigned long ul = strtoul(value, &endptr, 0);
+        if (*endptr == '\0' && ul <= MixerWorkerPool::MAX_THREADS) {
+            sMixerWorkerThreads = (uint32_t) ul;
+        }
+    }
+}
+
+// Whether a MixerThread writing directly to the HAL times its sleep, when active tracks are
+// not ready, from the measured HAL consumption rate rather than from the nominal buffer
+// duration.  Enabled by default, property af.mixer.adaptive_sleep=0 disables it.
+static bool sAdaptiveSleep = true;
+
+static pthread_once_t sAdaptiveSleepOnce = PTHREAD_ONCE_INIT;
+
+static void sAdaptiveSleepInit()
+{
+    sAdaptiveSleep = property_get_bool("af.mixer.adaptive_sleep", true /* default_value */);
+}
+
+// Margin kept before the predicted time at which the HAL would have only one normal mix
+// buffer left, to absorb scheduling latency and the cost of the next mix.
+static const uint32_t kAdaptiveSleepMarginUs = 2000;
+
 // ----------------------------------------------------------------------------
 
 #ifdef ADD_BATTERY_DATA
@@ -871,6 +906,8 @@ void AudioFlinger::ThreadBase::dumpBase(int fd, const Vector<String16>& args __u
     dprintf(fd, "  Output device: %#x (%s)\n", mOutDevice, devicesToString(mOutDevice).string());
     dprintf(fd, "  Input device: %#x (%s)\n", mInDevice, devicesToString(mInDevice).string());
     dprintf(fd, "  Audio source: %d (%s)\n", mAudioSource, sourceToString(mAudioSource));
+    mMetrics.dump(fd, mType == RECORD ? "read" : "write",
+            mType == RECORD ? "Overruns" : "Delayed writes");
 
     if (locked) {
         mLock.unlock();
@@ -1491,6 +1528,7 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         mStandbyDelayNs(AudioFlinger::mStandbyTimeInNsecs),
         mBytesRemaining(0),
         mCurrentWriteLength(0),
+        mWriteSource(NULL),
         mUseAsyncWrite(false),
         mWriteAckSequence(0),
         mDrainSequence(0),
@@ -1500,10 +1538,14 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         mFastTrackAvailMask(((1 << FastMixerState::kMaxFastTracks) - 1) & ~1),
         mHwSupportsPause(false), mHwPaused(false), mFlushPending(false),
         // mLatchD, mLatchQ,
-        mLatchDValid(false), mLatchQValid(false)
+        mLatchDValid(false), mLatchQValid(false),
+        mIoState(NULL)
 {
     snprintf(mThreadName, kThreadNameLength, "AudioOut_%X", id);
     mNBLogWriter = audioFlinger->newWriter_l(kLogSize, mThreadName);
+    mIoState = audioFlinger->acquireIoState_l();
+    memset(&mIoStateData, 0, sizeof(mIoStateData));
+    mIoStateData.mIoHandle = id;
 
     // Assumes constructor is called by AudioFlinger with it's mLock held, but
     // it would be safer to explicitly pass initial masterVolume/masterMute as
@@ -1635,6 +1677,9 @@ void AudioFlinger::PlaybackThread::dumpInternals(int fd, const Vector<String16>&
     audio_output_flags_t flags = output != NULL ? output->flags : AUDIO_OUTPUT_FLAG_NONE;
     String8 flagsAsString = outputFlagsToString(flags);
     dprintf(fd, "  AudioStreamOut: %p flags %#x (%s)\n", output, flags, flagsAsString.string());
+    if (output != NULL) {
+        output->dump(fd);
+    }
 }
 
 // Thread virtuals
@@ -2063,6 +2108,7 @@ void AudioFlinger::PlaybackThread::ioConfigChanged(audio_io_config_event event,
         desc->mFrameCount = mNormalFrameCount; // FIXME see
                                              // AudioFlinger::frameCount(audio_io_handle_t)
         desc->mLatency = latency_l();
+        publishIoConfig(desc);
         break;
 
     case AUDIO_OUTPUT_CLOSED:
@@ -2072,6 +2118,48 @@ void AudioFlinger::PlaybackThread::ioConfigChanged(audio_io_config_event event,
     mAudioFlinger->ioConfigChanged(event, desc, pid);
 }
 
+void AudioFlinger::PlaybackThread::publishIoConfig(const sp<AudioIoDescriptor>& desc)
+{
+    Mutex::Autolock _l(mIoStateLock);
+    if (mIoState == NULL) {
+        return;
+    }
+    mIoStateData.mSampleRate = desc->mSamplingRate;
+    mIoStateData.mFrameCount = desc->mFrameCount;
+    mIoStateData.mLatencyMs = desc->mLatency;
+    mIoStateData.mPeriodNs = desc->mSamplingRate != 0 ?
+            (int64_t)desc->mFrameCount * 1000000000LL / desc->mSamplingRate : 0;
+    // the render position is republished by the next write
+    mIoStateData.mRenderTimeNs = 0;
+    mIoState->write(mIoStateData);
+}
+
+void AudioFlinger::PlaybackThread::publishRenderPosition()
+{
+    uint32_t halFrames = 0;
+    uint32_t dspFrames = 0;
+    status_t status = getRenderPosition(&halFrames, &dspFrames);
+    const nsecs_t now = systemTime();
+
+    Mutex::Autolock _l(mIoStateLock);
+    if (mIoState == NULL) {
+        return;
+    }
+    mIoStateData.mRenderStatus = status;
+    mIoStateData.mHalFrames = halFrames;
+    mIoStateData.mDspFrames = dspFrames;
+    mIoStateData.mRenderTimeNs = now;
+    mIoState->write(mIoStateData);
+}
+
+AudioIoState *AudioFlinger::PlaybackThread::detachIoState()
+{
+    Mutex::Autolock _l(mIoStateLock);
+    AudioIoState *state = mIoState;
+    mIoState = NULL;
+    return state;
+}
+
 void AudioFlinger::PlaybackThread::writeCallback()
 {
     ALOG_ASSERT(mCallbackThread != 0);
@@ -2495,7 +2583,9 @@ ssize_t AudioFlinger::PlaybackThread::threadLoop_write()
         }
         // FIXME We should have an implementation of timestamps for direct output threads.
         // They are used e.g for multichannel PCM playback over HDMI.
-        bytesWritten = mOutput->write((char *)mSinkBuffer + offset, mBytesRemaining);
+        const char *source = mWriteSource != NULL ?
+                (const char *)mWriteSource : (const char *)mSinkBuffer;
+        bytesWritten = mOutput->write(source + offset, mBytesRemaining);
         if (mUseAsyncWrite &&
                 ((bytesWritten < 0) || (bytesWritten == (ssize_t)mBytesRemaining))) {
             // do not wait for async callback in case of error of full write
@@ -2763,6 +2853,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
 
     CpuStats cpuStats;
     const String8 myName(String8::format("thread %p type %d TID %d", this, mType, gettid()));
+    ACpuAccounting cpuAccounting(mThreadName);
 
     acquireWakeLock();
 #ifdef SRS_PROCESSING
@@ -2789,6 +2880,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
     while (!exitPending())
     {
         cpuStats.sample(myName);
+        cpuAccounting.update();
 
         Vector< sp<EffectChain> > effectChains;
 
@@ -2820,6 +2912,12 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                 mLatchQ = mLatchD;
                 mLatchDValid = false;
                 mLatchQValid = true;
+                for (size_t i = 0; i < size; i++) {
+                    sp<Track> t = mActiveTracks[i].promote();
+                    if (t != 0) {
+                        t->publishTimestamp_l(this);
+                    }
+                }
             }
 
             saveOutputTracks();
@@ -2916,7 +3014,9 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             mCurrentWriteLength = 0;
             if (mMixerStatus == MIXER_TRACKS_READY) {
                 // threadLoop_mix() sets mCurrentWriteLength
+                const nsecs_t mixStartNs = systemTime();
                 threadLoop_mix();
+                mMetrics.mProcessNs.add(systemTime() - mixStartNs);
             } else if ((mMixerStatus != MIXER_DRAIN_TRACK)
                         && (mMixerStatus != MIXER_DRAIN_ALL)) {
                 // threadLoop_sleepTime sets mSleepTimeUs to 0 if data
@@ -2999,12 +3099,15 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                 }
 #endif
                 if (mBytesRemaining) {
+                    const nsecs_t writeStartNs = systemTime();
                     ret = threadLoop_write();
+                    mMetrics.mIoNs.add(systemTime() - writeStartNs);
                     if (ret < 0) {
                         mBytesRemaining = 0;
                     } else {
                         mBytesWritten += ret;
                         mBytesRemaining -= ret;
+                        publishRenderPosition();
                     }
                 } else if ((mMixerStatus == MIXER_DRAIN_TRACK) ||
                         (mMixerStatus == MIXER_DRAIN_ALL)) {
@@ -3016,6 +3119,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                     nsecs_t delta = now - mLastWriteTime;
                     if (delta > maxPeriod) {
                         mNumDelayedWrites++;
+                        mMetrics.noteUnderrun();
                         if ((now - lastWarning) > kWarningThrottleNs) {
                             ATRACE_NAME("underrun");
                             ALOGW("write blocked for %llu msecs, %d delayed writes, thread %p",
@@ -3064,7 +3168,10 @@ bool AudioFlinger::PlaybackThread::threadLoop()
 
             } else {
                 ATRACE_BEGIN("sleep");
+                const nsecs_t sleepStartNs = systemTime();
                 usleep(mSleepTimeUs);
+                mMetrics.mWakeJitterNs.add(
+                        systemTime() - sleepStartNs - (nsecs_t) mSleepTimeUs * 1000);
                 ATRACE_END();
             }
         }
@@ -3353,6 +3460,11 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
             mSampleRate, mChannelMask, mChannelCount, mFormat, mFrameSize, mFrameCount,
             mNormalFrameCount);
     mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+    pthread_once(&sMixerWorkerThreadsOnce, sMixerWorkerThreadsInit);
+    pthread_once(&sAdaptiveSleepOnce, sAdaptiveSleepInit);
+    if (sMixerWorkerThreads > 0) {
+        mAudioMixer->setParallelMixing(sMixerWorkerThreads, ANDROID_PRIORITY_URGENT_AUDIO);
+    }
 
     if (type == DUPLICATING) {
         // The Duplicating thread uses the AudioMixer and delivers data to OutputTracks
@@ -3596,11 +3708,24 @@ ssize_t AudioFlinger::MixerThread::threadLoop_write()
             sq->end(false /*didModify*/);
         }
     }
-    return PlaybackThread::threadLoop_write();
+    ssize_t bytesWritten = PlaybackThread::threadLoop_write();
+
+    // sample the HAL position after each direct write, for adaptiveSleepTimeUs()
+    if (sAdaptiveSleep && mNormalSink == mOutputSink && bytesWritten > 0) {
+        uint64_t position;
+        struct timespec ts;
+        if (mOutput->getPresentationPosition(&position, &ts) == NO_ERROR) {
+            // the presentation timestamp is CLOCK_MONOTONIC, as is systemTime()
+            mDrainEstimator.addPosition(position, seconds(ts.tv_sec) + ts.tv_nsec);
+        }
+    }
+    return bytesWritten;
 }
 
 void AudioFlinger::MixerThread::threadLoop_standby()
 {
+    mDrainEstimator.reset(mSampleRate);
+
     // Idle the fast mixer if it's currently running
     if (mFastMixer != 0) {
         FastMixerStateQueue *sq = mFastMixer->sq();
@@ -3704,7 +3829,9 @@ void AudioFlinger::MixerThread::threadLoop_sleepTime()
     // buffer size, then write 0s to the output
     if (mSleepTimeUs == 0) {
         if (mMixerStatus == MIXER_TRACKS_ENABLED) {
-            mSleepTimeUs = mActiveSleepTimeUs >> sleepTimeShift;
+            if (!adaptiveSleepTimeUs(&mSleepTimeUs)) {
+                mSleepTimeUs = mActiveSleepTimeUs >> sleepTimeShift;
+            }
             if (mSleepTimeUs < kMinThreadSleepTimeUs) {
                 mSleepTimeUs = kMinThreadSleepTimeUs;
             }
@@ -3733,6 +3860,25 @@ void AudioFlinger::MixerThread::threadLoop_sleepTime()
     // TODO add standby time extension fct of effect tail
 }
 
+// Computes the time the thread can sleep, waiting for active tracks to become ready,
+// without letting the HAL drain below one normal mix buffer.  Returns false, leaving
+// sleepTimeUs unchanged, when no estimate of the HAL consumption rate is available.
+bool AudioFlinger::MixerThread::adaptiveSleepTimeUs(uint32_t *sleepTimeUs)
+{
+    if (!sAdaptiveSleep || mNormalSink != mOutputSink || !mDrainEstimator.hasPosition()) {
+        return false;
+    }
+    const nsecs_t drainNs = mDrainEstimator.timeUntilQueued(mOutput->getFramesWritten(),
+            mNormalFrameCount, systemTime());
+    const nsecs_t marginNs = (nsecs_t)kAdaptiveSleepMarginUs * 1000;
+    uint32_t us = drainNs > marginNs ? (uint32_t)((drainNs - marginNs) / 1000) : 0;
+    if (us > mActiveSleepTimeUs) {
+        us = mActiveSleepTimeUs;
+    }
+    *sleepTimeUs = us;
+    return true;
+}
+
 // prepareTracks_l() must be called with ThreadBase::mLock held
 AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTracks_l(
         Vector< sp<Track> > *tracksToRemove)
@@ -3817,6 +3963,14 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 // FIXME fast mixer will pull & mix partial buffers, but we count as a full underrun
                 track->mAudioTrackServerProxy->tallyUnderrunFrames(recentUnderruns * mFrameCount);
             }
+            if (recentUnderruns > 0) {
+                // let the fast mixer know these underruns have been accounted for; if the
+                // queue is full the next underrun acknowledges these too
+                FastTrackCommand ack;
+                ack.mType = FastTrackCommand::ACK_UNDERRUNS;
+                ack.mUnderruns = underruns.mBitFields.mPartial + underruns.mBitFields.mEmpty;
+                (void) track->mFastCommandQueue.push(ack);
+            }
 
             // This is similar to the state machine for normal tracks,
             // with a few modifications for fast tracks.
@@ -3831,10 +3985,21 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
             case TrackBase::PAUSING:
                 // ramp down is not yet implemented
                 track->setPaused();
+                // stop mixing now, rather than when the fast mixer runs out of frames
+                {
+                    FastTrackCommand stop;
+                    stop.mType = FastTrackCommand::STOP;
+                    (void) track->mFastCommandQueue.push(stop);
+                }
                 break;
             case TrackBase::RESUMING:
                 // ramp up is not yet implemented
                 track->mState = TrackBase::ACTIVE;
+                {
+                    FastTrackCommand start;
+                    start.mType = FastTrackCommand::START;
+                    (void) track->mFastCommandQueue.push(start);
+                }
                 break;
             case TrackBase::ACTIVE:
                 if (recentFull > 0 || recentPartial > 0) {
@@ -3897,27 +4062,45 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
             }
 
             if (isActive) {
+                const float volume = masterVolume * mStreamTypes[track->streamType()].volume;
+                bool sendVolume = volume != track->mCachedVolume;
                 // was it previously inactive?
                 if (!(state->mTrackMask & (1 << j))) {
                     ExtendedAudioBufferProvider *eabp = track;
                     VolumeProvider *vp = track;
                     fastTrack->mBufferProvider = eabp;
                     fastTrack->mVolumeProvider = vp;
+                    fastTrack->mCommandQueue = &track->mFastCommandQueue;
                     fastTrack->mChannelMask = track->mChannelMask;
                     fastTrack->mFormat = track->mFormat;
                     fastTrack->mGeneration++;
                     state->mTrackMask |= 1 << j;
                     didModify = true;
                     // no acknowledgement required for newly active tracks
+                    // The fast mixer resets the slot to full scale and started when it sees
+                    // the new generation, and only then starts draining the queue, so also
+                    // override any STOP left over from a previous activation.
+                    FastTrackCommand start;
+                    start.mType = FastTrackCommand::START;
+                    (void) track->mFastCommandQueue.push(start);
+                    sendVolume = true;
+                }
+                // send the combined master volume and stream type volume to the fast mixer
+                // only when it changes; if the queue is full, retry on the next cycle
+                if (sendVolume) {
+                    FastTrackCommand command;
+                    command.mType = FastTrackCommand::VOLUME;
+                    command.mVolume = volume;
+                    // an impossible volume forces a retry if the queue is full
+                    track->mCachedVolume =
+                            track->mFastCommandQueue.push(command) ? volume : -1.0f;
                 }
-                // cache the combined master volume and stream type volume for fast mixer; this
-                // lacks any synchronization or barrier so VolumeProvider may read a stale value
-                track->mCachedVolume = masterVolume * mStreamTypes[track->streamType()].volume;
                 ++fastTracks;
             } else {
                 // was it previously active?
                 if (state->mTrackMask & (1 << j)) {
                     fastTrack->mBufferProvider = NULL;
+                    fastTrack->mCommandQueue = NULL;
                     fastTrack->mGeneration++;
                     state->mTrackMask &= ~(1 << j);
                     didModify = true;
@@ -3947,6 +4130,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
         // hence the test on (mMixerStatus == MIXER_TRACKS_READY) meaning the track was mixed
         // during last round
         size_t desiredFrames;
+        track->updateRateCorrection_l();
         const uint32_t sampleRate = track->mAudioTrackServerProxy->getSampleRate();
         AudioPlaybackRate playbackRate = track->mAudioTrackServerProxy->getPlaybackRate();
 
@@ -4438,6 +4622,9 @@ bool AudioFlinger::MixerThread::checkForNewParameter_l(const String8& keyValuePa
             readOutputParameters_l();
             delete mAudioMixer;
             mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+            if (sMixerWorkerThreads > 0) {
+                mAudioMixer->setParallelMixing(sMixerWorkerThreads, ANDROID_PRIORITY_URGENT_AUDIO);
+            }
             for (size_t i = 0; i < mTracks.size() ; i++) {
                 int name = getTrackName_l(mTracks[i]->mChannelMask,
                         mTracks[i]->mFormat, mTracks[i]->mSessionId);
@@ -4473,6 +4660,11 @@ void AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>& ar
     PlaybackThread::dumpInternals(fd, args);
     dprintf(fd, "  Thread throttle time (msecs): %u\n", mThreadThrottleTimeMs);
     dprintf(fd, "  AudioMixer tracks: 0x%08x\n", mAudioMixer->trackNames());
+    // the parallel mix must complete within one normal mix period
+    mAudioMixer->dumpParallelMixing(fd, (uint32_t)((mNormalFrameCount * 1000000LL) / mSampleRate));
+    if (mDrainEstimator.hasPosition()) {
+        dprintf(fd, "  HAL drain rate: %.1f Hz\n", mDrainEstimator.rate());
+    }
 
     // Make a non-atomic copy of fast mixer dump state so it won't change underneath us
     // while we are dumping it.  It may be inconsistent, but it won't mutate!
@@ -4523,23 +4715,31 @@ void AudioFlinger::MixerThread::cacheParameters_l()
     // increase threshold again due to low power audio mode. The way this warning
     // threshold is calculated and its usefulness should be reconsidered anyway.
     maxPeriod = seconds(mNormalFrameCount) / mSampleRate * 15;
+
+    mDrainEstimator.reset(mSampleRate);
 }
 
 // ----------------------------------------------------------------------------
 
 AudioFlinger::DirectOutputThread::DirectOutputThread(const sp<AudioFlinger>& audioFlinger,
         AudioStreamOut* output, audio_io_handle_t id, audio_devices_t device, bool systemReady)
-    :   PlaybackThread(audioFlinger, output, id, device, DIRECT, systemReady)
+    :   PlaybackThread(audioFlinger, output, id, device, DIRECT, systemReady),
         // mLeftVolFloat, mRightVolFloat
+        mUseClientBuffer(false)
 {
+    mClientBuffer.raw = NULL;
+    mClientBuffer.frameCount = 0;
 }
 
 AudioFlinger::DirectOutputThread::DirectOutputThread(const sp<AudioFlinger>& audioFlinger,
         AudioStreamOut* output, audio_io_handle_t id, uint32_t device,
         ThreadBase::type_t type, bool systemReady)
-    :   PlaybackThread(audioFlinger, output, id, device, type, systemReady)
+    :   PlaybackThread(audioFlinger, output, id, device, type, systemReady),
         // mLeftVolFloat, mRightVolFloat
+        mUseClientBuffer(false)
 {
+    mClientBuffer.raw = NULL;
+    mClientBuffer.frameCount = 0;
 }
 
 AudioFlinger::DirectOutputThread::~DirectOutputThread()
@@ -4702,6 +4902,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::DirectOutputThread::prep
                     if (track != previousTrack.get()) {
                         // Flush any data still being written from last track
                         mBytesRemaining = 0;
+                        releaseClientBuffer();
                         // Invalidate previous track to force a seek when resuming.
                         previousTrack->invalidate();
                     }
@@ -4711,6 +4912,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::DirectOutputThread::prep
                 // reset retry count
                 track->mRetryCount = kMaxTrackRetriesDirect;
                 mActiveTrack = t;
+                mUseClientBuffer = mOutput->canWriteClientBuffers() && mEffectChains.isEmpty();
                 mixerStatus = MIXER_TRACKS_READY;
                 if (mHwPaused) {
                     doHwResume = true;
@@ -4810,6 +5012,22 @@ void AudioFlinger::DirectOutputThread::threadLoop_mix()
 {
     size_t frameCount = mFrameCount;
     int8_t *curBuf = (int8_t *)mSinkBuffer;
+    // the previous client buffer, if any, has been written by now
+    releaseClientBuffer();
+    if (mUseClientBuffer) {
+        // write the client's frames straight from shared memory, without copying them
+        mClientBuffer.frameCount = frameCount;
+        status_t status = mActiveTrack->getNextBuffer(&mClientBuffer);
+        if (status == NO_ERROR && mClientBuffer.raw != NULL) {
+            mClientBufferTrack = mActiveTrack;
+            mWriteSource = mClientBuffer.raw;
+            mCurrentWriteLength = mClientBuffer.frameCount * mFrameSize;
+            mSleepTimeUs = 0;
+            mStandbyTimeNs = systemTime() + mStandbyDelayNs;
+            mActiveTrack.clear();
+            return;
+        }
+    }
     // output audio to hardware
     while (frameCount) {
         AudioBufferProvider::Buffer buffer;
@@ -4830,6 +5048,26 @@ void AudioFlinger::DirectOutputThread::threadLoop_mix()
     mActiveTrack.clear();
 }
 
+ssize_t AudioFlinger::DirectOutputThread::threadLoop_write()
+{
+    ssize_t bytesWritten = PlaybackThread::threadLoop_write();
+    // give the client buffer back as soon as the HAL has consumed all of it
+    if (mClientBufferTrack != 0
+            && (bytesWritten < 0 || (size_t) bytesWritten >= mBytesRemaining)) {
+        releaseClientBuffer();
+    }
+    return bytesWritten;
+}
+
+void AudioFlinger::DirectOutputThread::releaseClientBuffer()
+{
+    if (mClientBufferTrack != 0) {
+        mClientBufferTrack->releaseBuffer(&mClientBuffer);
+        mClientBufferTrack.clear();
+    }
+    mWriteSource = NULL;
+}
+
 void AudioFlinger::DirectOutputThread::threadLoop_sleepTime()
 {
     // do not write to HAL when paused
@@ -4844,6 +5082,8 @@ void AudioFlinger::DirectOutputThread::threadLoop_sleepTime()
             mSleepTimeUs = mIdleSleepTimeUs;
         }
     } else if (mBytesWritten != 0 && audio_is_linear_pcm(mFormat)) {
+        // write silence from mSinkBuffer, not from a client buffer
+        releaseClientBuffer();
         memset(mSinkBuffer, 0, mFrameCount * mFrameSize);
         mSleepTimeUs = 0;
     }
@@ -4862,6 +5102,7 @@ void AudioFlinger::DirectOutputThread::threadLoop_exit()
         if (mFlushPending) {
             flushHw_l();
         }
+        releaseClientBuffer();
     }
     PlaybackThread::threadLoop_exit();
 }
@@ -5005,6 +5246,7 @@ void AudioFlinger::DirectOutputThread::cacheParameters_l()
 
 void AudioFlinger::DirectOutputThread::flushHw_l()
 {
+    releaseClientBuffer();
     mOutput->flush();
     mHwPaused = false;
     mFlushPending = false;
@@ -5135,6 +5377,7 @@ void AudioFlinger::OffloadThread::threadLoop_exit()
         ALOG_ASSERT(mCallbackThread != 0);
         mCallbackThread->exit();
     }
+    releaseClientBuffer();
     PlaybackThread::threadLoop_exit();
 }
 
@@ -5230,6 +5473,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::OffloadThread::prepareTr
                     if (track != previousTrack.get()) {
                         // Flush any data still being written from last track
                         mBytesRemaining = 0;
+                        releaseClientBuffer();
                         if (mPausedBytesRemaining) {
                             // Last track was paused so we also need to flush saved
                             // mixbuffer state and invalidate track so that it will
@@ -5252,6 +5496,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::OffloadThread::prepareTr
                 // reset retry count
                 track->mRetryCount = kMaxTrackRetriesOffload;
                 mActiveTrack = t;
+                mUseClientBuffer = mOutput->canWriteClientBuffers() && mEffectChains.isEmpty();
                 mixerStatus = MIXER_TRACKS_READY;
             }
         } else {
@@ -5472,11 +5717,18 @@ void AudioFlinger::DuplicatingThread::addOutputTrack(MixerThread *thread)
     // The downstream MixerThread consumes thread->frameCount() amount of frames per mix pass.
     // Adjust for thread->sampleRate() to determine minimum buffer frame count.
     // Then triple buffer because Threads do not run synchronously and may not be clock locked.
-    const size_t frameCount =
-            3 * sourceFramesNeeded(mSampleRate, thread->frameCount(), thread->sampleRate());
-    // TODO: Consider asynchronous sample rate conversion to handle clock disparity
-    // from different OutputTracks and their associated MixerThreads (e.g. one may
-    // nearly empty and the other may be dropping data).
+    const size_t mixFrameCount =
+            sourceFramesNeeded(mSampleRate, thread->frameCount(), thread->sampleRate());
+    // The downstream MixerThread corrects the clock disparity by resampling the track
+    // so that it keeps a mix pass of each thread plus half of the shorter one buffered,
+    // as any phase between the threads needs. Leave as much headroom again.
+    const size_t shorterFrameCount =
+            mixFrameCount < mNormalFrameCount ? mixFrameCount : mNormalFrameCount;
+    const size_t targetFrames = mixFrameCount + mNormalFrameCount + shorterFrameCount / 2;
+    size_t frameCount = 2 * (mixFrameCount + mNormalFrameCount);
+    if (frameCount < 3 * mixFrameCount) {
+        frameCount = 3 * mixFrameCount;
+    }
 
     sp<OutputTrack> outputTrack = new OutputTrack(thread,
                                             this,
@@ -5486,6 +5738,7 @@ void AudioFlinger::DuplicatingThread::addOutputTrack(MixerThread *thread)
                                             frameCount,
                                             IPCThreadState::self()->getCallingUid());
     if (outputTrack->cblk() != NULL) {
+        outputTrack->setRateCorrectionTarget(targetFrames);
         thread->setStreamVolume(AUDIO_STREAM_PATCH, 1.0f);
         mOutputTracks.add(outputTrack);
         ALOGV("addOutputTrack() track %p, on thread %p", outputTrack.get(), thread);
@@ -5722,6 +5975,7 @@ void AudioFlinger::RecordThread::onFirstRef()
 bool AudioFlinger::RecordThread::threadLoop()
 {
     nsecs_t lastWarning = 0;
+    ACpuAccounting cpuAccounting(mThreadName);
 
     inputStandBy();
 
@@ -5753,18 +6007,24 @@ reacquire_wakelock:
 
     // loop while there is work to do
     for (;;) {
+        cpuAccounting.update();
         Vector< sp<EffectChain> > effectChains;
 
         // sleep with mutex unlocked
         if (sleepUs > 0) {
             ATRACE_BEGIN("sleep");
+            const nsecs_t sleepStartNs = systemTime();
             usleep(sleepUs);
+            mMetrics.mWakeJitterNs.add(systemTime() - sleepStartNs - (nsecs_t) sleepUs * 1000);
             ATRACE_END();
             sleepUs = 0;
         }
 
         // activeTracks accumulates a copy of a subset of mActiveTracks
         Vector< sp<RecordTrack> > activeTracks;
+        // sharedConversion[i] is true once activeTracks[i] was handled by convertShared()
+        Vector<bool> sharedConversion;
+        Vector< sp<RecordTrack> > sharingTracks;
 
         // reference to the (first and only) active fast track
         sp<RecordTrack> fastTrack;
@@ -5940,6 +6200,7 @@ reacquire_wakelock:
 
         int32_t rear = mRsmpInRear & (mRsmpInFramesP2 - 1);
         ssize_t framesRead;
+        const nsecs_t readStartNs = systemTime();
 
         // If an NBAIO source is present, use it to read the normal capture's data
         if (mPipeSource != 0) {
@@ -5960,6 +6221,8 @@ reacquire_wakelock:
                 framesRead = bytesRead / mFrameSize;
             }
         }
+        const nsecs_t readEndNs = systemTime();
+        mMetrics.mIoNs.add(readEndNs - readStartNs);
 
         if (framesRead < 0 || (framesRead == 0 && mPipeSource == 0)) {
             ALOGE("read failed: framesRead=%d", framesRead);
@@ -5986,23 +6249,42 @@ reacquire_wakelock:
         rear = mRsmpInRear += framesRead;
 
         size = activeTracks.size();
+        sharedConversion.insertAt(false, 0, size);
         // loop over each active track
         for (size_t i = 0; i < size; i++) {
             activeTrack = activeTracks[i];
 
             // skip fast tracks, as those are handled directly by FastCapture
-            if (activeTrack->isFastTrack()) {
+            if (activeTrack->isFastTrack() || sharedConversion[i]) {
+                continue;
+            }
+
+            // Clients recording with the same configuration, typically started while this
+            // one was keeping up, share one conversion instead of each doing it again.
+            sharingTracks.clear();
+            for (size_t j = i + 1; j < size; j++) {
+                if (!sharedConversion[j] && canShareConversion(activeTrack, activeTracks[j])) {
+                    if (sharingTracks.isEmpty()) {
+                        sharingTracks.add(activeTrack);
+                    }
+                    sharingTracks.add(activeTracks[j]);
+                    sharedConversion.editItemAt(j) = true;
+                }
+            }
+            if (!sharingTracks.isEmpty()) {
+                convertShared(sharingTracks, &lastWarning);
                 continue;
             }
 
             // TODO: This code probably should be moved to RecordTrack.
             // TODO: Update the activeTrack buffer converter in case of reconfigure.
 
-            enum {
-                OVERRUN_UNKNOWN,
-                OVERRUN_TRUE,
-                OVERRUN_FALSE
-            } overrun = OVERRUN_UNKNOWN;
+            overrun_t overrun = OVERRUN_UNKNOWN;
+
+            if (activeTrack->mConverterStale) {
+                activeTrack->mRecordBufferConverter->reset();
+                activeTrack->mConverterStale = false;
+            }
 
             // loop over getNextBuffer to handle circular sink
             for (;;) {
@@ -6070,26 +6352,9 @@ reacquire_wakelock:
                 }
             }
 
-            switch (overrun) {
-            case OVERRUN_TRUE:
-                // client isn't retrieving buffers fast enough
-                if (!activeTrack->setOverflow()) {
-                    nsecs_t now = systemTime();
-                    // FIXME should lastWarning per track?
-                    if ((now - lastWarning) > kWarningThrottleNs) {
-                        ALOGW("RecordThread: buffer overflow");
-                        lastWarning = now;
-                    }
-                }
-                break;
-            case OVERRUN_FALSE:
-                activeTrack->clearOverflow();
-                break;
-            case OVERRUN_UNKNOWN:
-                break;
-            }
-
+            updateOverrun(activeTrack, overrun, &lastWarning);
         }
+        mMetrics.mProcessNs.add(systemTime() - readEndNs);
 
 unlock:
         // enable changes in effect chain
@@ -6116,6 +6381,116 @@ unlock:
     return false;
 }
 
+void AudioFlinger::RecordThread::updateOverrun(const sp<RecordTrack>& track, overrun_t overrun,
+        nsecs_t *lastWarning)
+{
+    switch (overrun) {
+    case OVERRUN_TRUE:
+        // client isn't retrieving buffers fast enough
+        mMetrics.noteUnderrun();
+        if (!track->setOverflow()) {
+            nsecs_t now = systemTime();
+            // FIXME should lastWarning per track?
+            if ((now - *lastWarning) > kWarningThrottleNs) {
+                ALOGW("RecordThread: buffer overflow");
+                *lastWarning = now;
+            }
+        }
+        break;
+    case OVERRUN_FALSE:
+        track->clearOverflow();
+        break;
+    case OVERRUN_UNKNOWN:
+        break;
+    }
+}
+
+/*static*/
+bool AudioFlinger::RecordThread::canShareConversion(const sp<RecordTrack>& track,
+        const sp<RecordTrack>& other)
+{
+    // mFramesToDrop != 0 means a sync start event is pending, which is handled per track
+    return !other->isFastTrack() &&
+            other->mSampleRate == track->mSampleRate &&
+            other->mFormat == track->mFormat &&
+            other->mChannelMask == track->mChannelMask &&
+            other->mFramesToDrop == 0 && track->mFramesToDrop == 0 &&
+            other->mResamplerBufferProvider->getFront() ==
+                    track->mResamplerBufferProvider->getFront();
+}
+
+void AudioFlinger::RecordThread::convertShared(const Vector< sp<RecordTrack> >& tracks,
+        nsecs_t *lastWarning)
+{
+    Vector< sp<RecordTrack> > members(tracks);
+    overrun_t overrun = OVERRUN_UNKNOWN;
+
+    // loop over getNextBuffer to handle circular sinks
+    for (;;) {
+        size_t framesOut = ~0;
+        for (size_t i = 0; i < members.size(); ) {
+            const sp<RecordTrack>& track = members[i];
+            track->mSink.frameCount = ~0;
+            status_t status = track->getNextBuffer(&track->mSink);
+            LOG_ALWAYS_FATAL_IF((status == OK) != (track->mSink.frameCount > 0));
+            if (status != OK) {
+                // client buffer is full, this track stays behind the others
+                members.removeAt(i);
+                continue;
+            }
+            framesOut = min(framesOut, track->mSink.frameCount);
+            i++;
+        }
+        if (members.isEmpty()) {
+            break;
+        }
+
+        const sp<RecordTrack> leader = members[0];
+        bool hasOverrun;
+        size_t framesIn;
+        leader->mResamplerBufferProvider->sync(&framesIn, &hasOverrun);
+        if (hasOverrun) {
+            overrun = OVERRUN_TRUE;
+        }
+        if (framesIn == 0) {
+            break;
+        }
+        framesOut = min(framesOut,
+                destinationFramesPossible(framesIn, mSampleRate, leader->mSampleRate));
+        if (leader->mConverterStale) {
+            leader->mRecordBufferConverter->reset();
+            leader->mConverterStale = false;
+        }
+        framesOut = leader->mRecordBufferConverter->convert(
+                leader->mSink.raw, leader->mResamplerBufferProvider, framesOut);
+        if (framesOut > 0 && overrun == OVERRUN_UNKNOWN) {
+            overrun = OVERRUN_FALSE;
+        }
+
+        const int32_t front = leader->mResamplerBufferProvider->getFront();
+        for (size_t i = 1; i < members.size(); i++) {
+            const sp<RecordTrack>& track = members[i];
+            memcpy(track->mSink.raw, leader->mSink.raw, framesOut * track->mFrameSize);
+            track->mResamplerBufferProvider->setFront(front);
+            track->mConverterStale = true;
+        }
+        for (size_t i = 0; i < members.size(); i++) {
+            const sp<RecordTrack>& track = members[i];
+            if (framesOut > 0) {
+                track->mSink.frameCount = framesOut;
+                track->releaseBuffer(&track->mSink);
+            }
+        }
+        if (framesOut == 0) {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < tracks.size(); i++) {
+        updateOverrun(tracks[i], overrun, lastWarning);
+    }
+}
+
 void AudioFlinger::RecordThread::standbyIfNotAlreadyInStandby()
 {
     if (!mStandby) {
@@ -476,6 +476,8 @@ protected:
                 sp<NBLog::Writer>       mNBLogWriter;
                 bool                    mSystemReady;
                 bool                    mIsDirectPcm; // flag to indicate unique Direct thread
+                // recorded by the thread loop without locks, read by dump()
+                ThreadMetrics           mMetrics;
 };
 
 // --- PlaybackThread ---
@@ -595,6 +597,9 @@ public:
     virtual     String8     getParameters(const String8& keys);
     virtual     void        ioConfigChanged(audio_io_config_event event, pid_t pid = 0);
                 status_t    getRenderPosition(uint32_t *halFrames, uint32_t *dspFrames);
+                // Returns the slot where the state of this output was published, if any, and
+                // stops publishing. Called once the thread has exited.
+                AudioIoState *detachIoState();
                 // FIXME rename mixBuffer() to sinkBuffer() and remove int16_t* dependency.
                 // Consider also removing and passing an explicit mMainBuffer initialization
                 // parameter to AF::PlaybackThread::Track::Track().
@@ -711,6 +716,14 @@ protected:
     // FIXME overflows every 6+ hours at 44.1 kHz stereo 16-bit samples
     // mFramesWritten would be better, or 64-bit even better
     size_t                          mBytesWritten;
+
+    // Copies the configuration sent to clients, or the current render position, to mIoState.
+                void        publishIoConfig(const sp<AudioIoDescriptor>& desc);
+                void        publishRenderPosition();
+    // Lock order: mLock, then mIoStateLock.
+    Mutex                           mIoStateLock;
+    AudioIoState                   *mIoState;       // NULL if not published
+    AudioIoStateData                mIoStateData;   // last state written to mIoState
 private:
     // mMasterMute is in both PlaybackThread and in AudioFlinger.  When a
     // PlaybackThread needs to find out if master-muted, it checks it's local
@@ -813,6 +826,9 @@ private:
 
     size_t                          mBytesRemaining;
     size_t                          mCurrentWriteLength;
+    // if not NULL, threadLoop_write() writes from here instead of mSinkBuffer,
+    // see DirectOutputThread::mClientBuffer
+    const void*                     mWriteSource;
     bool                            mUseAsyncWrite;
     // mWriteAckSequence contains current write sequence on bits 31-1. The write sequence is
     // incremented each time a write(), a flush() or a standby() occurs.
@@ -928,6 +944,12 @@ private:
                 //          mFastMixer->sq()    // for mutating and pushing state
                 int32_t     mFastMixerFutex;    // for cold idle
 
+                // measured HAL consumption rate, used to time the sleep when active tracks
+                // are not ready; only valid while the mixer writes directly to the HAL.
+                // Accessible only within the threadLoop(), no locks required.
+                SinkDrainEstimator mDrainEstimator;
+                bool        adaptiveSleepTimeUs(uint32_t *sleepTimeUs);
+
 public:
     virtual     bool        hasFastMixer() const { return mFastMixer != 0; }
     virtual     FastTrackUnderruns getFastTrackUnderruns(size_t fastIndex) const {
@@ -962,12 +984,16 @@ protected:
     // threadLoop snippets
     virtual     mixer_state prepareTracks_l(Vector< sp<Track> > *tracksToRemove);
     virtual     void        threadLoop_mix();
+    virtual     ssize_t     threadLoop_write();
     virtual     void        threadLoop_sleepTime();
     virtual     void        threadLoop_exit();
     virtual     bool        shouldStandby_l();
 
     virtual     void        onAddNewTrack_l();
 
+    // returns the client buffer held for writing, if any, to its track
+                void        releaseClientBuffer();
+
     // volumes last sent to audio HAL with stream->set_volume()
     float mLeftVolFloat;
     float mRightVolFloat;
@@ -980,6 +1006,13 @@ protected:
     // prepareTracks_l() tells threadLoop_mix() the name of the single active track
     sp<Track>               mActiveTrack;
 
+    // Zero copy write: if mOutput->canWriteClientBuffers() and no effect is applied,
+    // threadLoop_mix() holds on to the client buffer and points mWriteSource at it instead
+    // of copying it into mSinkBuffer, until threadLoop_write() has written all of it.
+    bool                    mUseClientBuffer;       // set by prepareTracks_l()
+    sp<Track>               mClientBufferTrack;     // track mClientBuffer belongs to
+    AudioBufferProvider::Buffer mClientBuffer;
+
     wp<Track>               mPreviousTrack;         // used to detect track switch
 
 public:
@@ -1116,6 +1149,11 @@ public:
 
         virtual void sync(size_t *framesAvailable = NULL, bool *hasOverrun = NULL);
 
+        // Read position in the RecordThread buffer, so that tracks sharing a conversion
+        // can be kept at the same position as the track that did the conversion.
+        int32_t      getFront() const { return mRsmpInFront; }
+        void         setFront(int32_t front) { mRsmpInFront = front; }
+
         // AudioBufferProvider interface
         virtual status_t    getNextBuffer(AudioBufferProvider::Buffer* buffer, int64_t pts);
         virtual void        releaseBuffer(AudioBufferProvider::Buffer* buffer);
@@ -1318,6 +1356,28 @@ private:
             // Call the HAL standby method unconditionally, and don't change mStandby flag
             void    inputStandBy();
 
+            // whether a track lost data because its client buffer was full, during one pass
+            enum overrun_t {
+                OVERRUN_UNKNOWN,
+                OVERRUN_TRUE,
+                OVERRUN_FALSE
+            };
+
+            // Sets or clears the overflow flag of a track, after a pass of threadLoop()
+            void    updateOverrun(const sp<RecordTrack>& track, overrun_t overrun,
+                                  nsecs_t *lastWarning);
+
+            // Returns true if other can be given a copy of the data converted for track,
+            // instead of converting it again: same client configuration and same read position.
+    static  bool    canShareConversion(const sp<RecordTrack>& track,
+                                       const sp<RecordTrack>& other);
+
+            // Converts new input once for all the tracks, into the client buffer of the first
+            // one with room, and copies the result into the others.  A track whose client
+            // buffer is full falls behind, and is converted by itself from then on.
+            void    convertShared(const Vector< sp<RecordTrack> >& tracks,
+                                  nsecs_t *lastWarning);
+
             AudioStreamIn                       *mInput;
             SortedVector < sp<RecordTrack> >    mTracks;
             // mActiveTracks has dual roles:  it indicates the current active track(s), and
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_TRACK_RATE_CORRECTOR_H
+#define ANDROID_AUDIO_TRACK_RATE_CORRECTOR_H
+
+#include <math.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+// A track written by one thread and mixed by another, such as the tracks of a software
+// patch or of a DuplicatingThread, is filled and drained by two clocks that drift apart.
+// TrackRateCorrector keeps the number of frames buffered in such a track near a target by
+// returning the sample rate the mixer should consume the track at.  The correction is at
+// most 0.5%, which is inaudible.  The rate is dithered between integer values
+// so that corrections finer than 1 Hz average out, as the control block rate is in Hz.
+//
+// Not thread safe: update() is called by the mixer thread of the track only, the accessors
+// may be read for dumpsys.
+class TrackRateCorrector {
+public:
+    TrackRateCorrector()
+        : mNominalSampleRate(0), mTargetFrames(0), mAverageFrames(0), mRemainder(0) { }
+
+    // targetFrames 0 disables the correction.
+    void setTarget(uint32_t nominalSampleRate, size_t targetFrames) {
+        mNominalSampleRate = nominalSampleRate;
+        mTargetFrames = targetFrames;
+        mAverageFrames = targetFrames;
+        mRemainder = 0;
+    }
+
+    bool enabled() const { return mTargetFrames != 0; }
+
+    // Called once per mix with the number of frames buffered before the mixer consumes
+    // any, returns the sample rate to consume the track at.
+    uint32_t update(size_t framesBuffered) {
+        // fraction of the difference to the filtered fill level taken per update
+        static const float kFilterCoefficient = 1.0f / 32.0f;
+        // correction per relative distance from the target
+        static const float kGain = 1.0f / 64.0f;
+        static const float kMaxCorrection = 0.005f;
+
+        if (mTargetFrames == 0) {
+            return mNominalSampleRate;
+        }
+
+        mAverageFrames += kFilterCoefficient * ((float)framesBuffered - mAverageFrames);
+
+        // There is no dead band around the target: the level settles wherever the phase
+        // between the two threads left it, and any drift eventually moves it into underruns.
+        const float error = (mAverageFrames - mTargetFrames) / mTargetFrames;
+        float correction = error * kGain;
+        if (correction > kMaxCorrection) {
+            correction = kMaxCorrection;
+        } else if (correction < -kMaxCorrection) {
+            correction = -kMaxCorrection;
+        }
+        // consume faster when frames accumulate, slower when running low
+        const float rate = mNominalSampleRate * (1.0f + correction) + mRemainder;
+        const uint32_t sampleRate = (uint32_t)floorf(rate);
+        mRemainder = rate - sampleRate;
+        return sampleRate;
+    }
+
+    uint32_t nominalSampleRate() const { return mNominalSampleRate; }
+    size_t targetFrames() const { return mTargetFrames; }
+    float averageFrames() const { return mAverageFrames; }
+
+private:
+    uint32_t    mNominalSampleRate;
+    size_t      mTargetFrames;
+    float       mAverageFrames;     // low pass filtered frames buffered
+    float       mRemainder;         // dithering error carried to the next update
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_TRACK_RATE_CORRECTOR_H
@@ -121,7 +121,7 @@ AudioFlinger::ThreadBase::TrackBase::TrackBase(
     }
 
     if (client != 0) {
-        mCblkMemory = client->heap()->allocate(size);
+        mCblkMemory = client->allocate(size);
         if (mCblkMemory == 0 ||
                 (mCblk = static_cast<audio_track_cblk_t *>(mCblkMemory->pointer())) == NULL) {
             ALOGE("not enough memory for AudioTrack size=%u", size);
@@ -230,7 +230,12 @@ AudioFlinger::ThreadBase::TrackBase::~TrackBase()
             mCblk->~audio_track_cblk_t();   // destroy our shared-structure.
         }
     }
-    mCblkMemory.clear();    // free the shared memory before releasing the heap it belongs to
+    // free the shared memory before releasing the heap it belongs to,
+    // unless the client keeps it for its next track
+    if (mClient != 0 && mCblk != NULL) {
+        mClient->recycle(mCblkMemory);
+    }
+    mCblkMemory.clear();
     if (mClient != 0) {
         // Client destructor must run with AudioFlinger client mutex locked
         Mutex::Autolock _l(mClient->audioFlinger()->mClientLock);
@@ -629,6 +634,16 @@ size_t AudioFlinger::PlaybackThread::Track::framesReleased() const
     return mAudioTrackServerProxy->framesReleased();
 }
 
+// Don't call for fast tracks; the framesReady() could result in priority inversion.
+// The requested sample rate in the control block is only set by the client at creation
+// for the tracks using rate correction, so the mixer thread owns it.
+void AudioFlinger::PlaybackThread::Track::updateRateCorrection_l()
+{
+    if (mRateCorrector.enabled()) {
+        mCblk->mSampleRate = mRateCorrector.update(framesReady());
+    }
+}
+
 // Don't call for fast tracks; the framesReady() could result in priority inversion
 bool AudioFlinger::PlaybackThread::Track::isReady() const {
     if (mFillingUpStatus != FS_FILLING || isStopped() || isPausing()) {
@@ -904,30 +919,7 @@ status_t AudioFlinger::PlaybackThread::Track::getTimestamp(AudioTimestamp& times
 
     status_t result = INVALID_OPERATION;
     if (!isOffloaded() && !isDirect()) {
-        if (!playbackThread->mLatchQValid) {
-            return INVALID_OPERATION;
-        }
-        // FIXME Not accurate under dynamic changes of sample rate and speed.
-        // Do not use track's mSampleRate as it is not current for mixer tracks.
-        uint32_t sampleRate = mAudioTrackServerProxy->getSampleRate();
-        AudioPlaybackRate playbackRate = mAudioTrackServerProxy->getPlaybackRate();
-        uint32_t unpresentedFrames = ((double) playbackThread->mLatchQ.mUnpresentedFrames *
-                sampleRate * playbackRate.mSpeed)/ playbackThread->mSampleRate;
-        // FIXME Since we're using a raw pointer as the key, it is theoretically possible
-        //       for a brand new track to share the same address as a recently destroyed
-        //       track, and thus for us to get the frames released of the wrong track.
-        //       It is unlikely that we would be able to call getTimestamp() so quickly
-        //       right after creating a new track.  Nevertheless, the index here should
-        //       be changed to something that is unique.  Or use a completely different strategy.
-        ssize_t i = playbackThread->mLatchQ.mFramesReleased.indexOfKey(this);
-        uint32_t framesWritten = i >= 0 ?
-                playbackThread->mLatchQ.mFramesReleased[i] :
-                mAudioTrackServerProxy->framesReleased();
-        if (framesWritten >= unpresentedFrames) {
-            timestamp.mPosition = framesWritten - unpresentedFrames;
-            timestamp.mTime = playbackThread->mLatchQ.mTimestamp.mTime;
-            result = NO_ERROR;
-        }
+        result = getLatchedTimestamp_l(playbackThread, timestamp);
     } else { // offloaded or direct
         result = playbackThread->getTimestamp_l(timestamp);
     }
@@ -935,6 +927,47 @@ status_t AudioFlinger::PlaybackThread::Track::getTimestamp(AudioTimestamp& times
     return result;
 }
 
+status_t AudioFlinger::PlaybackThread::Track::getLatchedTimestamp_l(
+        const PlaybackThread *playbackThread, AudioTimestamp& timestamp)
+{
+    if (!playbackThread->mLatchQValid) {
+        return INVALID_OPERATION;
+    }
+    // FIXME Not accurate under dynamic changes of sample rate and speed.
+    // Do not use track's mSampleRate as it is not current for mixer tracks.
+    uint32_t sampleRate = mAudioTrackServerProxy->getSampleRate();
+    AudioPlaybackRate playbackRate = mAudioTrackServerProxy->getPlaybackRate();
+    uint32_t unpresentedFrames = ((double) playbackThread->mLatchQ.mUnpresentedFrames *
+            sampleRate * playbackRate.mSpeed)/ playbackThread->mSampleRate;
+    // FIXME Since we're using a raw pointer as the key, it is theoretically possible
+    //       for a brand new track to share the same address as a recently destroyed
+    //       track, and thus for us to get the frames released of the wrong track.
+    //       It is unlikely that we would be able to call getTimestamp() so quickly
+    //       right after creating a new track.  Nevertheless, the index here should
+    //       be changed to something that is unique.  Or use a completely different strategy.
+    ssize_t i = playbackThread->mLatchQ.mFramesReleased.indexOfKey(this);
+    uint32_t framesWritten = i >= 0 ?
+            playbackThread->mLatchQ.mFramesReleased[i] :
+            mAudioTrackServerProxy->framesReleased();
+    if (framesWritten < unpresentedFrames) {
+        return INVALID_OPERATION;
+    }
+    timestamp.mPosition = framesWritten - unpresentedFrames;
+    timestamp.mTime = playbackThread->mLatchQ.mTimestamp.mTime;
+    return NO_ERROR;
+}
+
+void AudioFlinger::PlaybackThread::Track::publishTimestamp_l(const PlaybackThread *playbackThread)
+{
+    if (isFastTrack() || isOffloaded() || isDirect() || !isExternalTrack()) {
+        return;
+    }
+    AudioTimestamp timestamp;
+    if (getLatchedTimestamp_l(playbackThread, timestamp) == NO_ERROR) {
+        mAudioTrackServerProxy->setTimestamp(timestamp);
+    }
+}
+
 status_t AudioFlinger::PlaybackThread::Track::attachAuxEffect(int EffectId)
 {
     status_t status = DEAD_OBJECT;
@@ -1048,11 +1081,8 @@ gain_minifloat_packed_t AudioFlinger::PlaybackThread::Track::getVolumeLR()
     if (vr > GAIN_FLOAT_UNITY) {
         vr = GAIN_FLOAT_UNITY;
     }
-    // now apply the cached master volume and stream type volume;
-    // this is trusted but lacks any synchronization or barrier so may be stale
-    float v = mCachedVolume;
-    vl *= v;
-    vr *= v;
+    // the master volume and stream type volume are applied by the fast mixer,
+    // which receives them through mFastCommandQueue
     // re-combine into packed minifloat
     vlr = gain_minifloat_pack(gain_from_float(vl), gain_from_float(vr));
     // FIXME look at mute, pause, and stop flags
@@ -1963,7 +1993,8 @@ AudioFlinger::RecordThread::RecordTrack::RecordTrack(
         mOverflow(false),
         mFramesToDrop(0),
         mResamplerBufferProvider(NULL), // initialize in case of early constructor exit
-        mRecordBufferConverter(NULL)
+        mRecordBufferConverter(NULL),
+        mConverterStale(false)
 {
     if (mCblk == NULL) {
         return;
@@ -33,7 +33,8 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES:= \
 	test-mixer.cpp \
 	../AudioMixer.cpp.arm \
-	../BufferProviders.cpp
+	../BufferProviders.cpp \
+	../MixerWorkerPool.cpp
 
 LOCAL_C_INCLUDES := \
 	$(call include-path-for, audio-effects) \
@@ -63,3 +64,67 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_CXX_STL := libc++
 
 include $(BUILD_EXECUTABLE)
+
+#
+# mixer, resampler, buffer provider and format conversion throughput benchmark
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	mixer_benchmark.cpp \
+	../AudioMixer.cpp.arm \
+	../BufferProviders.cpp \
+	../MixerWorkerPool.cpp
+
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-effects) \
+	$(call include-path-for, audio-utils) \
+	frameworks/av/services/audioflinger \
+	external/sonic
+
+LOCAL_SHARED_LIBRARIES := \
+	libeffects \
+	libnbaio \
+	libcommon_time_client \
+	libaudioresampler \
+	libaudioutils \
+	libdl \
+	libcutils \
+	libutils \
+	liblog \
+	libsonic
+
+# benchmark the vendor resampler when libaudioresampler includes it
+ifeq ($(call is-vendor-board-platform,QCOM),true)
+ifeq ($(strip $(AUDIO_FEATURE_ENABLED_EXTN_RESAMPLER)),true)
+LOCAL_CFLAGS += -DQTI_RESAMPLER
+endif
+endif
+
+LOCAL_MODULE:= mixer_benchmark
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CXX_STL := libc++
+
+include $(BUILD_EXECUTABLE)
+
+#
+# AudioTrack create / destroy cycle benchmark
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	track_create_benchmark.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libmedia \
+	libbinder \
+	libutils \
+	liblog
+
+LOCAL_MODULE:= track_create_benchmark
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,679 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput benchmarks of the AudioFlinger mixing pipeline: AudioMixer configurations,
+// AudioResampler qualities and ratios, buffer provider chains and format conversions.
+// Results are ns per output frame, the best of several runs, written as JSON so that
+// runs before and after a change (or a vendor resampler) can be compared by a script.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "mixer_benchmark"
+#include <utils/Log.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <audio_utils/primitives.h>
+#include <media/AudioBufferProvider.h>
+#include <media/AudioResamplerPublic.h>
+#include <utils/Timers.h>
+
+#include "AudioMixer.h"
+#include "AudioResampler.h"
+#include "BufferProviders.h"
+
+using namespace android;
+
+static const uint32_t kSampleRate = 48000;
+static const size_t kMaxChannels = 8;
+
+// largest number of frames per mixer or resampler call
+static const size_t kMaxBufferFrames = 4096;
+
+// length of the looped input signal, larger than and not a multiple of the buffer size
+static const size_t kLoopFrames = 4801;
+
+static const char *formatName(audio_format_t format) {
+    switch (format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        return "i16";
+    case AUDIO_FORMAT_PCM_8_BIT:
+        return "u8";
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        return "p24";
+    case AUDIO_FORMAT_PCM_32_BIT:
+        return "i32";
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        return "q8_24";
+    case AUDIO_FORMAT_PCM_FLOAT:
+        return "f32";
+    default:
+        return "unknown";
+    }
+}
+
+// An endless AudioBufferProvider, which loops over a sine wave in any PCM format.
+class LoopProvider : public AudioBufferProvider {
+public:
+    LoopProvider(audio_format_t format, uint32_t channels)
+        : mFrameSize(channels * audio_bytes_per_sample(format)), mPosition(0) {
+        std::vector<float> signal(kLoopFrames * channels);
+        for (size_t i = 0; i < kLoopFrames; ++i) {
+            const float y = 0.5f * sinf(2 * M_PI * 997.0f * i / kSampleRate);
+            for (size_t j = 0; j < channels; ++j) {
+                signal[i * channels + j] = y / (j + 1);
+            }
+        }
+        mData.resize(kLoopFrames * mFrameSize);
+        memcpy_by_audio_format(&mData[0], format, &signal[0], AUDIO_FORMAT_PCM_FLOAT,
+                signal.size());
+    }
+
+    virtual status_t getNextBuffer(Buffer *buffer, int64_t pts __unused = kInvalidPTS) {
+        if (buffer->frameCount > kLoopFrames - mPosition) {
+            buffer->frameCount = kLoopFrames - mPosition;
+        }
+        buffer->raw = &mData[mPosition * mFrameSize];
+        return NO_ERROR;
+    }
+
+    virtual void releaseBuffer(Buffer *buffer) {
+        mPosition = (mPosition + buffer->frameCount) % kLoopFrames;
+        buffer->frameCount = 0;
+        buffer->raw = NULL;
+    }
+
+private:
+    const size_t        mFrameSize;
+    std::vector<char>   mData;
+    size_t              mPosition;
+};
+
+// One case, run() processes frames output frames.
+class BenchmarkCase {
+public:
+    virtual ~BenchmarkCase() { }
+    virtual void run(size_t frames) = 0;
+};
+
+class Benchmark {
+public:
+    Benchmark() : mRuns(5), mFrames(kSampleRate / 2), mBufferFrames(480), mFilter(NULL) { }
+
+    // Returns true if the case is to be run, so that filtered cases are not even set up.
+    bool selected(const char *group, const std::string& name) const {
+        const std::string id = std::string(group) + "/" + name;
+        return mFilter == NULL || strstr(id.c_str(), mFilter) != NULL;
+    }
+
+    // Runs a case once untimed, to design filters and to fault in buffers,
+    // then reports the best of mRuns runs.
+    void measure(const char *group, const std::string& name, uint32_t channels,
+            BenchmarkCase *c) {
+        const std::string id = std::string(group) + "/" + name;
+        c->run(mBufferFrames);
+        nsecs_t bestNs = INT64_MAX;
+        for (int i = 0; i < mRuns; ++i) {
+            const nsecs_t startNs = systemTime(SYSTEM_TIME_MONOTONIC);
+            c->run(mFrames);
+            const nsecs_t ns = systemTime(SYSTEM_TIME_MONOTONIC) - startNs;
+            if (ns < bestNs) {
+                bestNs = ns;
+            }
+        }
+        Result result;
+        result.mGroup = group;
+        result.mName = name;
+        result.mChannels = channels;
+        result.mNsPerFrame = (double)bestNs / mFrames;
+        mResults.push_back(result);
+        fprintf(stderr, "%-56s %8.2f ns/frame\n", id.c_str(), result.mNsPerFrame);
+    }
+
+    void writeJson(FILE *f) const {
+        fprintf(f, "{\n  \"frames\": %zu,\n  \"runs\": %d,\n  \"buffer_frames\": %zu,\n",
+                mFrames, mRuns, mBufferFrames);
+        fprintf(f, "  \"benchmarks\": [\n");
+        for (size_t i = 0; i < mResults.size(); ++i) {
+            const Result& r = mResults[i];
+            fprintf(f, "    { \"group\": \"%s\", \"name\": \"%s\", \"channels\": %u, "
+                    "\"ns_per_frame\": %.3f }%s\n",
+                    r.mGroup.c_str(), r.mName.c_str(), r.mChannels, r.mNsPerFrame,
+                    i + 1 < mResults.size() ? "," : "");
+        }
+        fprintf(f, "  ]\n}\n");
+    }
+
+    int         mRuns;          // timed runs per case
+    size_t      mFrames;        // output frames per run
+    size_t      mBufferFrames;  // frames per mixer or resampler call
+    const char *mFilter;        // only run the cases whose id contains this
+
+private:
+    struct Result {
+        std::string mGroup;
+        std::string mName;
+        uint32_t    mChannels;
+        double      mNsPerFrame;
+    };
+    std::vector<Result> mResults;
+};
+
+// ----------------------------------------------------------------------------
+// AudioMixer
+//
+// The mixer picks its process and track hooks from the track configuration, so each case
+// below is a configuration that selects a particular set of hooks:
+//   one track, no resampling          process__NoResampleOneTrack<>
+//                                     (mono uses process__genericNoResampling)
+//   several tracks, no resampling     process__genericNoResampling, track__NoResample<>
+//   several tracks, volume ramp       as above with the volume ramp
+//   several tracks with aux           as above with the aux send
+//   several tracks, resampling        process__genericResampling, track__Resample<>
+//   parallel tracks                   process__parallelResampling
+
+struct MixerCase {
+    const char *mName;
+    uint32_t    mTracks;
+    uint32_t    mTrackSampleRate;
+    bool        mRamp;
+    bool        mAux;
+    uint32_t    mWorkers;
+};
+
+static const MixerCase kMixerCases[] = {
+    { "one_track",      1, kSampleRate, false, false, 0 },
+    { "tracks4",        4, kSampleRate, false, false, 0 },
+    { "tracks4_ramp",   4, kSampleRate, true,  false, 0 },
+    { "tracks4_aux",    4, kSampleRate, false, true,  0 },
+    { "resample1",      1, 44100,       false, false, 0 },
+    { "resample4",      4, 44100,       false, false, 0 },
+    { "parallel8",      8, kSampleRate, false, false, 2 },
+};
+
+class MixerRun : public BenchmarkCase {
+public:
+    MixerRun(AudioMixer *mixer, const std::vector<int>& names, size_t frameCount, bool ramp,
+            float volume)
+        : mMixer(mixer), mNames(names), mFrameCount(frameCount), mRamp(ramp),
+          mVolume(volume), mRampUp(false) { }
+
+    virtual void run(size_t frames) {
+        for (size_t done = 0; done < frames; done += mFrameCount) {
+            if (mRamp) {
+                // the volume ramps at every mix, alternating between two targets
+                float target = mRampUp ? mVolume : 0.f;
+                for (size_t i = 0; i < mNames.size(); ++i) {
+                    mMixer->setParameter(mNames[i], AudioMixer::RAMP_VOLUME,
+                            AudioMixer::VOLUME0, &target);
+                    mMixer->setParameter(mNames[i], AudioMixer::RAMP_VOLUME,
+                            AudioMixer::VOLUME1, &target);
+                }
+                mRampUp = !mRampUp;
+            }
+            mMixer->process(AudioBufferProvider::kInvalidPTS);
+        }
+    }
+
+private:
+    AudioMixer * const      mMixer;
+    const std::vector<int>  mNames;
+    const size_t            mFrameCount;
+    const bool              mRamp;
+    const float             mVolume;
+    bool                    mRampUp;
+};
+
+static void benchmarkMixer(Benchmark *b, const MixerCase& mc, audio_format_t inFormat,
+        audio_format_t mixerFormat, uint32_t channels) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s/%s_%s", mc.mName, formatName(inFormat),
+            formatName(mixerFormat));
+    if (!b->selected("mixer", name)) {
+        return;
+    }
+
+    // mono tracks are mixed into stereo, as they are by the playback threads
+    const size_t frameCount = b->mBufferFrames;
+    const uint32_t mixerChannels = channels < 2 ? 2 : channels;
+    const audio_channel_mask_t channelMask = audio_channel_out_mask_from_count(channels);
+    const audio_channel_mask_t mixerChannelMask =
+            audio_channel_out_mask_from_count(mixerChannels);
+    std::vector<char> output(frameCount * mixerChannels * audio_bytes_per_sample(mixerFormat));
+    std::vector<int32_t> aux(frameCount);
+
+    AudioMixer *mixer = new AudioMixer(frameCount, kSampleRate);
+    if (mc.mWorkers > 0) {
+        mixer->setParallelMixing(mc.mWorkers, ANDROID_PRIORITY_URGENT_AUDIO);
+    }
+    std::vector<LoopProvider *> providers;
+    std::vector<int> names;
+    float volume = AudioMixer::UNITY_GAIN_FLOAT / mc.mTracks;
+    for (uint32_t i = 0; i < mc.mTracks; ++i) {
+        LoopProvider *provider = new LoopProvider(inFormat, channels);
+        providers.push_back(provider);
+        const int trackName = mixer->getTrackName(channelMask, inFormat,
+                AUDIO_SESSION_OUTPUT_MIX);
+        LOG_ALWAYS_FATAL_IF(trackName < 0, "cannot create mixer track %u", i);
+        names.push_back(trackName);
+        mixer->setBufferProvider(trackName, provider);
+        mixer->setParameter(trackName, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER,
+                &output[0]);
+        mixer->setParameter(trackName, AudioMixer::TRACK, AudioMixer::MIXER_FORMAT,
+                (void *)(uintptr_t)mixerFormat);
+        mixer->setParameter(trackName, AudioMixer::TRACK, AudioMixer::FORMAT,
+                (void *)(uintptr_t)inFormat);
+        mixer->setParameter(trackName, AudioMixer::TRACK, AudioMixer::MIXER_CHANNEL_MASK,
+                (void *)(uintptr_t)mixerChannelMask);
+        mixer->setParameter(trackName, AudioMixer::TRACK, AudioMixer::CHANNEL_MASK,
+                (void *)(uintptr_t)channelMask);
+        mixer->setParameter(trackName, AudioMixer::RESAMPLE, AudioMixer::SAMPLE_RATE,
+                (void *)(uintptr_t)mc.mTrackSampleRate);
+        mixer->setParameter(trackName, AudioMixer::VOLUME, AudioMixer::VOLUME0, &volume);
+        mixer->setParameter(trackName, AudioMixer::VOLUME, AudioMixer::VOLUME1, &volume);
+        if (mc.mAux) {
+            mixer->setParameter(trackName, AudioMixer::TRACK, AudioMixer::AUX_BUFFER,
+                    &aux[0]);
+            mixer->setParameter(trackName, AudioMixer::VOLUME, AudioMixer::AUXLEVEL,
+                    &volume);
+        }
+        mixer->enable(trackName);
+    }
+
+    MixerRun run(mixer, names, frameCount, mc.mRamp, volume);
+    b->measure("mixer", name, channels, &run);
+
+    delete mixer;
+    for (size_t i = 0; i < providers.size(); ++i) {
+        delete providers[i];
+    }
+}
+
+static void benchmarkMixers(Benchmark *b) {
+    static const audio_format_t kInFormats[] = {
+        AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_FLOAT,
+    };
+    static const audio_format_t kMixerFormats[] = {
+        AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_FLOAT,
+    };
+    for (size_t c = 0; c < sizeof(kMixerCases) / sizeof(kMixerCases[0]); ++c) {
+        for (size_t i = 0; i < sizeof(kInFormats) / sizeof(kInFormats[0]); ++i) {
+            for (size_t m = 0; m < sizeof(kMixerFormats) / sizeof(kMixerFormats[0]); ++m) {
+                for (uint32_t channels = 1; channels <= kMaxChannels; ++channels) {
+                    benchmarkMixer(b, kMixerCases[c], kInFormats[i], kMixerFormats[m],
+                            channels);
+                }
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// AudioResampler
+
+struct ResamplerQuality {
+    const char *mName;
+    AudioResampler::src_quality mQuality;
+    bool        mDynamic;   // supports float and more than 2 channels
+};
+
+static const ResamplerQuality kQualities[] = {
+    { "low",        AudioResampler::LOW_QUALITY,        false },
+    { "med",        AudioResampler::MED_QUALITY,        false },
+    { "high",       AudioResampler::HIGH_QUALITY,       false },
+    { "very_high",  AudioResampler::VERY_HIGH_QUALITY,  false },
+    { "dyn_low",    AudioResampler::DYN_LOW_QUALITY,    true },
+    { "dyn_med",    AudioResampler::DYN_MED_QUALITY,    true },
+    { "dyn_high",   AudioResampler::DYN_HIGH_QUALITY,   true },
+#ifdef QTI_RESAMPLER
+    { "qti",        AudioResampler::QTI_QUALITY,        false },
+#endif
+};
+
+static const uint32_t kInSampleRates[] = {
+    8000, 16000, 22050, 44100, 88200, 96000, 192000,
+};
+
+class ResamplerRun : public BenchmarkCase {
+public:
+    ResamplerRun(AudioResampler *resampler, AudioBufferProvider *provider, size_t frameCount,
+            uint32_t channels)
+        // mono is resampled to stereo, and the output is always 32 bits per sample
+        : mResampler(resampler), mProvider(provider), mFrameCount(frameCount),
+          mOutput(frameCount * (channels < 2 ? 2 : channels)) { }
+
+    virtual void run(size_t frames) {
+        for (size_t done = 0; done < frames; done += mFrameCount) {
+            memset(&mOutput[0], 0, mOutput.size() * sizeof(mOutput[0]));
+            mResampler->resample(&mOutput[0], mFrameCount, mProvider);
+        }
+    }
+
+private:
+    AudioResampler * const      mResampler;
+    AudioBufferProvider * const mProvider;
+    const size_t                mFrameCount;
+    std::vector<int32_t>        mOutput;
+};
+
+static void benchmarkResampler(Benchmark *b, const ResamplerQuality& q, audio_format_t format,
+        uint32_t channels, uint32_t inSampleRate) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s/%s/%u", q.mName, formatName(format), inSampleRate);
+    if (!b->selected("resampler", name)) {
+        return;
+    }
+    AudioResampler *resampler = AudioResampler::create(format, channels, kSampleRate,
+            q.mQuality);
+    resampler->setSampleRate(inSampleRate);
+    resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
+    LoopProvider provider(format, channels);
+
+    ResamplerRun run(resampler, &provider, b->mBufferFrames, channels);
+    b->measure("resampler", name, channels, &run);
+    delete resampler;
+}
+
+static void benchmarkResamplers(Benchmark *b) {
+    for (size_t q = 0; q < sizeof(kQualities) / sizeof(kQualities[0]); ++q) {
+        const ResamplerQuality& quality = kQualities[q];
+        for (size_t r = 0; r < sizeof(kInSampleRates) / sizeof(kInSampleRates[0]); ++r) {
+            const uint32_t maxChannels = quality.mDynamic ? kMaxChannels : 2;
+            for (uint32_t channels = 1; channels <= maxChannels; ++channels) {
+                benchmarkResampler(b, quality, AUDIO_FORMAT_PCM_16_BIT, channels,
+                        kInSampleRates[r]);
+                if (quality.mDynamic) {
+                    benchmarkResampler(b, quality, AUDIO_FORMAT_PCM_FLOAT, channels,
+                            kInSampleRates[r]);
+                }
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Buffer providers, as chained by the mixer in front of a track
+
+// pulls frames through the last provider of a chain, as the mixer does
+class ProviderRun : public BenchmarkCase {
+public:
+    ProviderRun(AudioBufferProvider *provider, size_t bufferFrames)
+        : mProvider(provider), mBufferFrames(bufferFrames) { }
+
+    virtual void run(size_t frames) {
+        while (frames > 0) {
+            AudioBufferProvider::Buffer buffer;
+            buffer.frameCount = frames < mBufferFrames ? frames : mBufferFrames;
+            if (mProvider->getNextBuffer(&buffer) != NO_ERROR || buffer.frameCount == 0) {
+                LOG_ALWAYS_FATAL("buffer provider has no data");
+            }
+            frames -= buffer.frameCount;
+            mProvider->releaseBuffer(&buffer);
+        }
+    }
+
+private:
+    AudioBufferProvider * const mProvider;
+    const size_t                mBufferFrames;
+};
+
+static void benchmarkProviderChain(Benchmark *b, const char *name, uint32_t channels,
+        LoopProvider *source, std::vector<PassthruBufferProvider *>& chain) {
+    AudioBufferProvider *upstream = source;
+    for (size_t i = 0; i < chain.size(); ++i) {
+        chain[i]->setBufferProvider(upstream);
+        upstream = chain[i];
+    }
+    if (b->selected("provider", name)) {
+        ProviderRun run(upstream, b->mBufferFrames);
+        b->measure("provider", name, channels, &run);
+    }
+    for (size_t i = chain.size(); i > 0; --i) {
+        delete chain[i - 1];
+    }
+    chain.clear();
+    delete source;
+}
+
+static void benchmarkProviders(Benchmark *b) {
+    const size_t bufferFrames = b->mBufferFrames;
+    const audio_channel_mask_t stereo = AUDIO_CHANNEL_OUT_STEREO;
+    AudioPlaybackRate playbackRate = AUDIO_PLAYBACK_RATE_DEFAULT;
+    playbackRate.mSpeed = 1.25f;
+    DownmixerBufferProvider::init();
+
+    for (uint32_t channels = 1; channels <= kMaxChannels; ++channels) {
+        const audio_channel_mask_t mask = audio_channel_out_mask_from_count(channels);
+        std::vector<PassthruBufferProvider *> chain;
+        char name[64];
+
+        chain.push_back(new ReformatBufferProvider(channels, AUDIO_FORMAT_PCM_16_BIT,
+                AUDIO_FORMAT_PCM_FLOAT, bufferFrames));
+        benchmarkProviderChain(b, "reformat/i16_f32", channels,
+                new LoopProvider(AUDIO_FORMAT_PCM_16_BIT, channels), chain);
+
+        chain.push_back(new ReformatBufferProvider(channels, AUDIO_FORMAT_PCM_FLOAT,
+                AUDIO_FORMAT_PCM_16_BIT, bufferFrames));
+        benchmarkProviderChain(b, "reformat/f32_i16", channels,
+                new LoopProvider(AUDIO_FORMAT_PCM_FLOAT, channels), chain);
+
+        if (channels != 2) {
+            chain.push_back(new RemixBufferProvider(mask, stereo, AUDIO_FORMAT_PCM_FLOAT,
+                    bufferFrames));
+            benchmarkProviderChain(b, "remix/f32_stereo", channels,
+                    new LoopProvider(AUDIO_FORMAT_PCM_FLOAT, channels), chain);
+
+            // the remixer converts 16 bit input itself, instead of a chained reformatter
+            chain.push_back(new RemixBufferProvider(mask, stereo, AUDIO_FORMAT_PCM_FLOAT,
+                    bufferFrames, AUDIO_FORMAT_PCM_16_BIT));
+            benchmarkProviderChain(b, "remix/i16_f32_stereo", channels,
+                    new LoopProvider(AUDIO_FORMAT_PCM_16_BIT, channels), chain);
+        }
+
+        if (channels > 2 && DownmixerBufferProvider::isMultichannelCapable()) {
+            DownmixerBufferProvider *downmixer = new DownmixerBufferProvider(mask, stereo,
+                    AUDIO_FORMAT_PCM_FLOAT, kSampleRate, AUDIO_SESSION_OUTPUT_MIX,
+                    bufferFrames);
+            if (downmixer->isValid()) {
+                chain.push_back(downmixer);
+                benchmarkProviderChain(b, "downmix/f32_stereo", channels,
+                        new LoopProvider(AUDIO_FORMAT_PCM_FLOAT, channels), chain);
+            } else {
+                delete downmixer;
+            }
+        }
+
+        chain.push_back(new TimestretchBufferProvider(channels, AUDIO_FORMAT_PCM_FLOAT,
+                kSampleRate, playbackRate));
+        snprintf(name, sizeof(name), "timestretch/f32_%.2f", playbackRate.mSpeed);
+        benchmarkProviderChain(b, name, channels,
+                new LoopProvider(AUDIO_FORMAT_PCM_FLOAT, channels), chain);
+
+        // the full chain of a 16 bit multichannel track with a playback rate
+        if (channels != 2) {
+            chain.push_back(new RemixBufferProvider(mask, stereo, AUDIO_FORMAT_PCM_FLOAT,
+                    bufferFrames, AUDIO_FORMAT_PCM_16_BIT));
+        } else {
+            chain.push_back(new ReformatBufferProvider(channels, AUDIO_FORMAT_PCM_16_BIT,
+                    AUDIO_FORMAT_PCM_FLOAT, bufferFrames));
+        }
+        chain.push_back(new TimestretchBufferProvider(2, AUDIO_FORMAT_PCM_FLOAT,
+                kSampleRate, playbackRate));
+        snprintf(name, sizeof(name), "chain/i16_stereo_f32_%.2f", playbackRate.mSpeed);
+        benchmarkProviderChain(b, name, channels,
+                new LoopProvider(AUDIO_FORMAT_PCM_16_BIT, channels), chain);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// memcpy_by_audio_format()
+
+class FormatRun : public BenchmarkCase {
+public:
+    FormatRun(void *dst, audio_format_t dstFormat, const void *src, audio_format_t srcFormat,
+            size_t bufferFrames, uint32_t channels)
+        : mDst(dst), mDstFormat(dstFormat), mSrc(src), mSrcFormat(srcFormat),
+          mBufferFrames(bufferFrames), mChannels(channels) { }
+
+    virtual void run(size_t frames) {
+        for (size_t done = 0; done < frames; done += mBufferFrames) {
+            memcpy_by_audio_format(mDst, mDstFormat, mSrc, mSrcFormat,
+                    mBufferFrames * mChannels);
+        }
+    }
+
+private:
+    void * const            mDst;
+    const audio_format_t    mDstFormat;
+    const void * const      mSrc;
+    const audio_format_t    mSrcFormat;
+    const size_t            mBufferFrames;
+    const uint32_t          mChannels;
+};
+
+static void benchmarkFormats(Benchmark *b) {
+    static const audio_format_t kFormats[] = {
+        AUDIO_FORMAT_PCM_16_BIT,
+        AUDIO_FORMAT_PCM_8_BIT,
+        AUDIO_FORMAT_PCM_24_BIT_PACKED,
+        AUDIO_FORMAT_PCM_32_BIT,
+        AUDIO_FORMAT_PCM_8_24_BIT,
+        AUDIO_FORMAT_PCM_FLOAT,
+    };
+    static const size_t kNumFormats = sizeof(kFormats) / sizeof(kFormats[0]);
+    const size_t bufferFrames = b->mBufferFrames;
+    std::vector<char> dst(bufferFrames * kMaxChannels * sizeof(int32_t));
+
+    for (uint32_t channels = 1; channels <= kMaxChannels; ++channels) {
+        for (size_t s = 0; s < kNumFormats; ++s) {
+            LoopProvider source(kFormats[s], channels);
+            AudioBufferProvider::Buffer buffer;
+            buffer.frameCount = bufferFrames;
+            source.getNextBuffer(&buffer);
+            const void *src = buffer.raw;
+            for (size_t d = 0; d < kNumFormats; ++d) {
+                if (d == s) {
+                    continue;
+                }
+                char name[64];
+                snprintf(name, sizeof(name), "%s_%s", formatName(kFormats[s]),
+                        formatName(kFormats[d]));
+                if (b->selected("format", name)) {
+                    FormatRun run(&dst[0], kFormats[d], src, kFormats[s], bufferFrames,
+                            channels);
+                    b->measure("format", name, channels, &run);
+                }
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-S] [-r runs] [-t seconds] [-b frames] [-f filter] "
+                    "[-o <output-file>] [mixer|resampler|provider|format]...\n", name);
+    fprintf(stderr, "    -S    use the scalar mixing kernels only\n");
+    fprintf(stderr, "    -r    timed runs per case, the best is reported (5)\n");
+    fprintf(stderr, "    -t    seconds of output at %u Hz per run (0.5)\n", kSampleRate);
+    fprintf(stderr, "    -b    frames per mixer or resampler call, at most %zu (480)\n",
+            kMaxBufferFrames);
+    fprintf(stderr, "    -f    only run the cases whose group/name contains filter\n");
+    fprintf(stderr, "    -o    write the JSON results to <output-file> instead of stdout\n");
+    fprintf(stderr, "    the groups to run, all by default\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *const progname = argv[0];
+    const char *outputFilename = NULL;
+    Benchmark b;
+
+    for (int ch; (ch = getopt(argc, argv, "Sr:t:b:f:o:")) != -1;) {
+        switch (ch) {
+        case 'S':
+            AudioMixer::setVectorMixing(false);
+            break;
+        case 'r':
+            b.mRuns = atoi(optarg);
+            break;
+        case 't':
+            b.mFrames = atof(optarg) * kSampleRate;
+            break;
+        case 'b':
+            b.mBufferFrames = atoi(optarg);
+            break;
+        case 'f':
+            b.mFilter = optarg;
+            break;
+        case 'o':
+            outputFilename = optarg;
+            break;
+        case '?':
+        default:
+            usage(progname);
+            return EXIT_FAILURE;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (b.mRuns < 1 || b.mBufferFrames == 0 || b.mBufferFrames > kMaxBufferFrames
+            || b.mFrames < b.mBufferFrames) {
+        usage(progname);
+        return EXIT_FAILURE;
+    }
+    // whole mixer buffers per run
+    b.mFrames -= b.mFrames % b.mBufferFrames;
+
+    static const struct {
+        const char *mName;
+        void (*mRun)(Benchmark *b);
+    } kGroups[] = {
+        { "mixer",      benchmarkMixers },
+        { "resampler",  benchmarkResamplers },
+        { "provider",   benchmarkProviders },
+        { "format",     benchmarkFormats },
+    };
+    for (size_t g = 0; g < sizeof(kGroups) / sizeof(kGroups[0]); ++g) {
+        bool selected = argc == 0;
+        for (int i = 0; i < argc; ++i) {
+            selected |= !strcmp(argv[i], kGroups[g].mName);
+        }
+        if (selected) {
+            kGroups[g].mRun(&b);
+        }
+    }
+
+    FILE *f = stdout;
+    if (outputFilename != NULL) {
+        f = fopen(outputFilename, "w");
+        if (f == NULL) {
+            perror(outputFilename);
+            return EXIT_FAILURE;
+        }
+    }
+    b.writeJson(f);
+    if (f != stdout) {
+        fclose(f);
+    }
+    return EXIT_SUCCESS;
+}
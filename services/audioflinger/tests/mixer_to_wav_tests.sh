@@ -141,4 +141,20 @@ createwav "" "tests/mixer_i_i"
 createwav "-f -m" "tests/mixer_f_f"
 createwav "-m" "tests/mixer_i_f"
 
+#
+# The vectorized mixing kernels must be bit-exact with the scalar ones:
+# regenerate with -S (scalar only) and compare.
+#
+createwav "-S" "tests/mixer_i_i_scalar"
+createwav "-S -f -m" "tests/mixer_f_f_scalar"
+createwav "-S -m" "tests/mixer_i_f_scalar"
+
+for dir in tests/mixer_i_i tests/mixer_f_f tests/mixer_i_f; do
+    for file in $dir/*.wav; do
+        if ! cmp -s $file ${dir}_scalar/$(basename $file); then
+            echo "MISMATCH: $file differs from the scalar mixer output"
+        fi
+    done
+done
+
 popd
@@ -0,0 +1,26 @@
+#!/bin/bash
+#
+# Runs mixer_benchmark on the device and pulls its JSON results, for example
+#   run_mixer_benchmark.sh before.json
+#   (merge the change, rebuild and push)
+#   run_mixer_benchmark.sh after.json
+# Extra arguments are passed to mixer_benchmark, e.g. "-f dyn_ resampler".
+
+if [ -z "$ANDROID_BUILD_TOP" ]; then
+    echo "Android build environment not set"
+    exit -1
+fi
+
+if [ -z "$1" ]; then
+    echo "usage: $0 <output.json> [mixer_benchmark arguments]"
+    exit -1
+fi
+output=$1
+shift
+
+echo "waiting for device"
+adb root && adb wait-for-device remount
+adb push $OUT/system/bin/mixer_benchmark /system/bin
+
+adb shell /system/bin/mixer_benchmark -o /data/local/tmp/mixer_benchmark.json "$@"
+adb pull /data/local/tmp/mixer_benchmark.json $output
@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <math.h>
+#include <unistd.h>
 #include <vector>
 #include <audio_utils/primitives.h>
 #include <audio_utils/sndfile.h>
@@ -36,11 +37,13 @@
 using namespace android;
 
 static void usage(const char* name) {
-    fprintf(stderr, "Usage: %s [-f] [-m] [-c channels]"
+    fprintf(stderr, "Usage: %s [-f] [-m] [-S] [-w threads] [-c channels]"
                     " [-s sample-rate] [-o <output-file>] [-a <aux-buffer-file>] [-P csv]"
                     " (<input-file> | <command>)+\n", name);
     fprintf(stderr, "    -f    enable floating point input track by default\n");
     fprintf(stderr, "    -m    enable floating point mixer output\n");
+    fprintf(stderr, "    -S    use the scalar mixing kernels only (reference output)\n");
+    fprintf(stderr, "    -w    number of parallel mixing worker threads\n");
     fprintf(stderr, "    -c    number of mixer output channels\n");
     fprintf(stderr, "    -s    mixer sample-rate\n");
     fprintf(stderr, "    -o    <output-file> WAV file, pcm16 (or float if -m specified)\n");
@@ -97,6 +100,7 @@ int main(int argc, char* argv[]) {
     bool useRamp = true;
     uint32_t outputSampleRate = 48000;
     uint32_t outputChannels = 2; // stereo for now
+    uint32_t workerThreads = 0;
     std::vector<int> Pvalues;
     const char* outputFilename = NULL;
     const char* auxFilename = NULL;
@@ -104,7 +108,7 @@ int main(int argc, char* argv[]) {
     std::vector<SignalProvider> providers;
     std::vector<audio_format_t> formats;
 
-    for (int ch; (ch = getopt(argc, argv, "fmc:s:o:a:P:")) != -1;) {
+    for (int ch; (ch = getopt(argc, argv, "fmSw:c:s:o:a:P:")) != -1;) {
         switch (ch) {
         case 'f':
             useInputFloat = true;
@@ -112,6 +116,12 @@ int main(int argc, char* argv[]) {
         case 'm':
             useMixerFloat = true;
             break;
+        case 'S':
+            AudioMixer::setVectorMixing(false);
+            break;
+        case 'w':
+            workerThreads = atoi(optarg);
+            break;
         case 'c':
             outputChannels = atoi(optarg);
             break;
@@ -237,6 +247,9 @@ int main(int argc, char* argv[]) {
     // create the mixer.
     const size_t mixerFrameCount = 320; // typical numbers may range from 240 or 960
     AudioMixer *mixer = new AudioMixer(mixerFrameCount, outputSampleRate);
+    if (workerThreads > 0) {
+        mixer->setParallelMixing(workerThreads, ANDROID_PRIORITY_URGENT_AUDIO);
+    }
     audio_format_t mixerFormat = useMixerFloat
             ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
     float f = AudioMixer::UNITY_GAIN_FLOAT / providers.size(); // normalize volume by # tracks
@@ -321,6 +334,7 @@ int main(int argc, char* argv[]) {
         writeFile(auxFilename, auxAddr, outputSampleRate, 1, outputFrames, false);
     }
 
+    mixer->dumpParallelMixing(STDOUT_FILENO, 0);
     delete mixer;
     free(outputAddr);
     free(auxAddr);
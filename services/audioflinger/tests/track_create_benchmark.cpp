@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the create / start / stop / destroy cycle of short lived AudioTracks,
+// as used for games and notification sounds.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "track_create_benchmark"
+#include <utils/Log.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <binder/ProcessState.h>
+#include <media/AudioTrack.h>
+#include <utils/Timers.h>
+
+using namespace android;
+
+enum {
+    PHASE_CREATE,
+    PHASE_START,
+    PHASE_WRITE,
+    PHASE_STOP,
+    PHASE_DESTROY,
+    NUM_PHASES,
+};
+
+static const char * const kPhaseNames[NUM_PHASES] = {
+    "create", "start", "write", "stop", "destroy",
+};
+
+struct PhaseStats {
+    PhaseStats() : mMinNs(INT64_MAX), mMaxNs(0), mTotalNs(0) { }
+    void add(nsecs_t ns) {
+        if (ns < mMinNs) {
+            mMinNs = ns;
+        }
+        if (ns > mMaxNs) {
+            mMaxNs = ns;
+        }
+        mTotalNs += ns;
+    }
+    nsecs_t mMinNs;
+    nsecs_t mMaxNs;
+    nsecs_t mTotalNs;
+};
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n <cycles>] [-r <sample rate>] [-c <channels>] "
+            "[-f <frames>]\n", me);
+    fprintf(stderr, "       -n number of create/start/stop/destroy cycles, default 100\n");
+    fprintf(stderr, "       -r sample rate in Hz, default 48000\n");
+    fprintf(stderr, "       -c channel count, 1 or 2, default 2\n");
+    fprintf(stderr, "       -f track frame count, default 0 for the minimum\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    int numCycles = 100;
+    uint32_t sampleRate = 48000;
+    int channels = 2;
+    size_t frameCount = 0;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:r:c:f:")) >= 0) {
+        switch (res) {
+            case 'n':
+                numCycles = atoi(optarg);
+                if (numCycles < 1) {
+                    usage(me);
+                }
+                break;
+
+            case 'r':
+                sampleRate = atoi(optarg);
+                break;
+
+            case 'c':
+                channels = atoi(optarg);
+                if (channels != 1 && channels != 2) {
+                    usage(me);
+                }
+                break;
+
+            case 'f':
+                frameCount = atoi(optarg);
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (optind != argc) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    // a short burst of silence, as a notification sound would write
+    const size_t writeFrames = sampleRate / 100;
+    const size_t frameSize = channels * sizeof(int16_t);
+    int16_t *data = (int16_t *) calloc(writeFrames, frameSize);
+
+    PhaseStats stats[NUM_PHASES];
+    for (int i = 0; i < numCycles; ++i) {
+        nsecs_t t[NUM_PHASES + 1];
+
+        t[PHASE_CREATE] = systemTime();
+        sp<AudioTrack> track = new AudioTrack(AUDIO_STREAM_MUSIC, sampleRate,
+                AUDIO_FORMAT_PCM_16_BIT,
+                channels == 2 ? AUDIO_CHANNEL_OUT_STEREO : AUDIO_CHANNEL_OUT_MONO,
+                frameCount, AUDIO_OUTPUT_FLAG_NONE, NULL /*cbf*/, NULL /*user*/,
+                0 /*notificationFrames*/, AUDIO_SESSION_ALLOCATE, AudioTrack::TRANSFER_SYNC);
+        if (track->initCheck() != NO_ERROR) {
+            fprintf(stderr, "unable to create AudioTrack, cycle %d: %d\n", i, track->initCheck());
+            free(data);
+            return 1;
+        }
+        t[PHASE_START] = systemTime();
+        track->start();
+        t[PHASE_WRITE] = systemTime();
+        track->write(data, writeFrames * frameSize);
+        t[PHASE_STOP] = systemTime();
+        track->stop();
+        t[PHASE_DESTROY] = systemTime();
+        track.clear();
+        t[NUM_PHASES] = systemTime();
+
+        for (int phase = 0; phase < NUM_PHASES; ++phase) {
+            stats[phase].add(t[phase + 1] - t[phase]);
+        }
+    }
+    free(data);
+
+    printf("%d cycles, %u Hz, %d channels, frame count %zu\n",
+            numCycles, sampleRate, channels, frameCount);
+    printf("%-8s %10s %10s %10s\n", "phase", "min(us)", "mean(us)", "max(us)");
+    nsecs_t totalNs = 0;
+    for (int phase = 0; phase < NUM_PHASES; ++phase) {
+        const PhaseStats& s = stats[phase];
+        printf("%-8s %10.1f %10.1f %10.1f\n", kPhaseNames[phase],
+                s.mMinNs * 1e-3, s.mTotalNs * 1e-3 / numCycles, s.mMaxNs * 1e-3);
+        totalNs += s.mTotalNs;
+    }
+    printf("%.1f us per cycle\n", totalNs * 1e-3 / numCycles);
+
+    return 0;
+}
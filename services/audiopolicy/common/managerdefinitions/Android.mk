@@ -15,6 +15,7 @@ LOCAL_SRC_FILES:= \
     src/AudioOutputDescriptor.cpp \
     src/EffectDescriptor.cpp \
     src/ConfigParsingUtils.cpp \
+    src/ConfigBinaryUtils.cpp \
     src/SoundTriggerSession.cpp \
     src/SessionRoute.cpp \
 
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "DeviceDescriptor.h"
+#include "HwModule.h"
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+#include <stdint.h>
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+// Precompiled audio policy configuration
+// ----------------------------------------------------------------------------
+//
+// The binary file is generated at build time from audio_policy.conf by
+// audio_policy_conf_compiler, and holds the configuration exactly as ConfigParsingUtils builds
+// it, with every name already converted to its enum value. Loading it does not involve any
+// string parsing or table lookup. The file is a sequence of native endian 32 bit words:
+//
+//   header: magic, version, size of the file in words, size of the source file in bytes,
+//           speaker DRC enabled, default output device type, number of modules
+//   module: name, HAL version, declared devices, output profiles, input profiles
+//   device: type, tag, address, channel masks, gains
+//   profile: name, flags, sampling rates, formats, channel masks, device refs, gains
+//   attached output device refs, attached input device refs
+//
+// A string is its length in bytes followed by its characters, padded to a word. An array is
+// its number of elements followed by the elements. A gain is its index followed by the
+// audio_gain fields. A device ref is a module index and the index of a device declared by the
+// module, or kDeviceRefNone followed by a device type and address for undeclared devices.
+
+class ConfigBinaryUtils
+{
+public:
+    static const uint32_t kMagic = 0x42435041;   // 'APCB'
+    static const uint32_t kVersion = 1;
+    static const uint32_t kDeviceRefNone = 0xffffffff;
+
+    // Same output as ConfigParsingUtils::loadAudioPolicyConfig(). Fails without modifying
+    // the output parameters if the file is missing, malformed, or was compiled from a source
+    // file of a different size than sourcePath, if not NULL.
+    static status_t loadAudioPolicyConfig(const char *path,
+                                          const char *sourcePath,
+                                          HwModuleCollection &hwModules,
+                                          DeviceVector &availableInputDevices,
+                                          DeviceVector &availableOutputDevices,
+                                          sp<DeviceDescriptor> &defaultOutputDevice,
+                                          bool &isSpeakerDrcEnabled);
+
+    static status_t writeAudioPolicyConfig(const char *path,
+                                           uint32_t sourceSize,
+                                           const HwModuleCollection &hwModules,
+                                           const DeviceVector &availableInputDevices,
+                                           const DeviceVector &availableOutputDevices,
+                                           const sp<DeviceDescriptor> &defaultOutputDevice,
+                                           bool isSpeakerDrcEnabled);
+};
+
+}; // namespace android
@@ -25,6 +25,9 @@
 
 #define AUDIO_POLICY_CONFIG_FILE "/system/etc/audio_policy.conf"
 #define AUDIO_POLICY_VENDOR_CONFIG_FILE "/vendor/etc/audio_policy.conf"
+// precompiled versions of the above, see ConfigBinaryUtils.h
+#define AUDIO_POLICY_BINARY_CONFIG_FILE "/system/etc/audio_policy.bin"
+#define AUDIO_POLICY_VENDOR_BINARY_CONFIG_FILE "/vendor/etc/audio_policy.bin"
 
 // global configuration
 #define GLOBAL_CONFIG_TAG "global_configuration"
@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "APM::ConfigBinaryUtils"
+//#define LOG_NDEBUG 0
+
+#include "ConfigBinaryUtils.h"
+#include "AudioGain.h"
+#include "IOProfile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+// number of audio_gain fields following the index of a gain
+const size_t kGainWords = 8;
+// number of header words before the first module
+const size_t kHeaderWords = 7;
+
+class Writer
+{
+public:
+    void word(uint32_t value) { mWords.add(value); }
+
+    void string(const String8& str)
+    {
+        word(str.length());
+        size_t start = mWords.size();
+        mWords.insertAt(0, start, (str.length() + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+        memcpy(mWords.editArray() + start, str.string(), str.length());
+    }
+
+    template <typename T>
+    void array(const Vector<T>& values)
+    {
+        word(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            word((uint32_t)values[i]);
+        }
+    }
+
+    void gains(const Vector< sp<AudioGain> >& gains)
+    {
+        word(gains.size());
+        for (size_t i = 0; i < gains.size(); i++) {
+            const struct audio_gain& gain = gains[i]->mGain;
+            word(gains[i]->mIndex);
+            word(gain.mode);
+            word(gain.channel_mask);
+            word(gain.min_value);
+            word(gain.max_value);
+            word(gain.default_value);
+            word(gain.step_value);
+            word(gain.min_ramp_ms);
+            word(gain.max_ramp_ms);
+        }
+    }
+
+    void deviceRef(const HwModuleCollection& hwModules, const sp<DeviceDescriptor>& device)
+    {
+        for (size_t i = 0; i < hwModules.size(); i++) {
+            const DeviceVector& declared = hwModules[i]->mDeclaredDevices;
+            for (size_t j = 0; j < declared.size(); j++) {
+                if (declared[j] == device) {
+                    word(i);
+                    word(j);
+                    return;
+                }
+            }
+        }
+        word(ConfigBinaryUtils::kDeviceRefNone);
+        word(device->type());
+        string(device->mAddress);
+    }
+
+    void deviceRefs(const HwModuleCollection& hwModules, const DeviceVector& devices)
+    {
+        word(devices.size());
+        for (size_t i = 0; i < devices.size(); i++) {
+            deviceRef(hwModules, devices[i]);
+        }
+    }
+
+    void profiles(const HwModuleCollection& hwModules, const Vector< sp<IOProfile> >& profiles)
+    {
+        word(profiles.size());
+        for (size_t i = 0; i < profiles.size(); i++) {
+            const sp<IOProfile>& profile = profiles[i];
+            string(profile->mName);
+            word(profile->mFlags);
+            array(profile->mSamplingRates);
+            array(profile->mFormats);
+            array(profile->mChannelMasks);
+            deviceRefs(hwModules, profile->mSupportedDevices);
+            gains(profile->mGains);
+        }
+    }
+
+    Vector<uint32_t>& words() { return mWords; }
+
+private:
+    Vector<uint32_t> mWords;
+};
+
+// Reads the words of a mapped file. Any out of bounds access sets an error and returns 0,
+// so that records can be read without checking each word; the caller checks ok() at the end.
+class Reader
+{
+public:
+    Reader(const uint32_t *words, size_t size) : mWords(words), mSize(size), mPos(0),
+            mError(false) {}
+
+    bool ok() const { return !mError; }
+
+    uint32_t word()
+    {
+        if (mPos >= mSize) {
+            mError = true;
+            return 0;
+        }
+        return mWords[mPos++];
+    }
+
+    // number of elements of an array of elementWords words each
+    size_t count(size_t elementWords)
+    {
+        size_t count = word();
+        if (mError || count > (mSize - mPos) / elementWords) {
+            mError = true;
+            return 0;
+        }
+        return count;
+    }
+
+    String8 string()
+    {
+        size_t length = count(1);
+        size_t words = (length + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+        if (mError || words > mSize - mPos) {
+            mError = true;
+            return String8("");
+        }
+        String8 str((const char *)(mWords + mPos), length);
+        mPos += words;
+        return str;
+    }
+
+    template <typename T>
+    void array(Vector<T>& values)
+    {
+        size_t size = count(1);
+        values.setCapacity(size);
+        for (size_t i = 0; i < size; i++) {
+            values.add((T)mWords[mPos++]);
+        }
+    }
+
+    void gains(const sp<AudioPort>& port)
+    {
+        size_t size = count(kGainWords + 1);
+        for (size_t i = 0; i < size; i++) {
+            sp<AudioGain> gain = new AudioGain(word(), port->mUseInChannelMask);
+            struct audio_gain& g = gain->mGain;
+            g.mode = (audio_gain_mode_t)word();
+            g.channel_mask = (audio_channel_mask_t)word();
+            g.min_value = word();
+            g.max_value = word();
+            g.default_value = word();
+            g.step_value = word();
+            g.min_ramp_ms = word();
+            g.max_ramp_ms = word();
+            port->mGains.add(gain);
+        }
+    }
+
+    // declared holds the devices declared by each module, in file order
+    sp<DeviceDescriptor> deviceRef(const Vector< Vector< sp<DeviceDescriptor> > >& declared)
+    {
+        uint32_t module = word();
+        if (module == ConfigBinaryUtils::kDeviceRefNone) {
+            sp<DeviceDescriptor> device = new DeviceDescriptor((audio_devices_t)word());
+            device->mAddress = string();
+            return device;
+        }
+        uint32_t index = word();
+        if (module >= declared.size() || index >= declared[module].size()) {
+            mError = true;
+            return NULL;
+        }
+        return declared[module][index];
+    }
+
+    void deviceRefs(const Vector< Vector< sp<DeviceDescriptor> > >& declared,
+                    DeviceVector& devices)
+    {
+        size_t size = count(2);
+        for (size_t i = 0; i < size && !mError; i++) {
+            sp<DeviceDescriptor> device = deviceRef(declared);
+            if (device != 0) {
+                devices.add(device);
+            }
+        }
+    }
+
+    void profiles(const Vector< Vector< sp<DeviceDescriptor> > >& declared,
+                  const sp<HwModule>& module, audio_port_role_t role,
+                  Vector< sp<IOProfile> >& profiles)
+    {
+        size_t size = count(1);
+        for (size_t i = 0; i < size && !mError; i++) {
+            sp<IOProfile> profile = new IOProfile(string(), role);
+            profile->mFlags = word();
+            array(profile->mSamplingRates);
+            array(profile->mFormats);
+            array(profile->mChannelMasks);
+            deviceRefs(declared, profile->mSupportedDevices);
+            gains(profile);
+            profile->attach(module);
+            profiles.add(profile);
+        }
+    }
+
+private:
+    const uint32_t *mWords;
+    const size_t mSize;
+    size_t mPos;
+    bool mError;
+};
+
+} // anonymous namespace
+
+//static
+status_t ConfigBinaryUtils::loadAudioPolicyConfig(const char *path,
+                                                  const char *sourcePath,
+                                                  HwModuleCollection &hwModules,
+                                                  DeviceVector &availableInputDevices,
+                                                  DeviceVector &availableOutputDevices,
+                                                  sp<DeviceDescriptor> &defaultOutputDevice,
+                                                  bool &isSpeakerDrcEnabled)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -ENODEV;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)(kHeaderWords * sizeof(uint32_t)) ||
+            (st.st_size % sizeof(uint32_t)) != 0) {
+        ALOGW("loadAudioPolicyConfig() invalid size for %s", path);
+        close(fd);
+        return BAD_VALUE;
+    }
+    size_t size = st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -errno;
+    }
+
+    Reader reader((const uint32_t *)data, size / sizeof(uint32_t));
+    status_t status = BAD_VALUE;
+    HwModuleCollection modules;
+    DeviceVector inputDevices;
+    DeviceVector outputDevices;
+    Vector< Vector< sp<DeviceDescriptor> > > declared;
+    bool speakerDrcEnabled = false;
+    audio_devices_t defaultDevice = AUDIO_DEVICE_NONE;
+
+    if (reader.word() != kMagic || reader.word() != kVersion ||
+            reader.word() != size / sizeof(uint32_t)) {
+        ALOGW("loadAudioPolicyConfig() invalid header for %s", path);
+        goto exit;
+    }
+    {
+        uint32_t sourceSize = reader.word();
+        if (sourcePath != NULL && stat(sourcePath, &st) == 0 &&
+                (uint32_t)st.st_size != sourceSize) {
+            ALOGW("loadAudioPolicyConfig() %s is out of date with %s", path, sourcePath);
+            goto exit;
+        }
+    }
+    speakerDrcEnabled = reader.word() != 0;
+    defaultDevice = reader.word();
+
+    for (size_t numModules = reader.count(1); numModules > 0 && reader.ok(); numModules--) {
+        sp<HwModule> module = new HwModule(reader.string().string());
+        module->mHalVersion = reader.word();
+
+        Vector< sp<DeviceDescriptor> > devices;
+        for (size_t numDevices = reader.count(1); numDevices > 0 && reader.ok(); numDevices--) {
+            sp<DeviceDescriptor> device = new DeviceDescriptor((audio_devices_t)reader.word());
+            device->mTag = reader.string();
+            device->mAddress = reader.string();
+            reader.array(device->mChannelMasks);
+            reader.gains(device);
+            devices.add(device);
+            module->mDeclaredDevices.add(device);
+        }
+        declared.add(devices);
+
+        reader.profiles(declared, module, AUDIO_PORT_ROLE_SOURCE, module->mOutputProfiles);
+        reader.profiles(declared, module, AUDIO_PORT_ROLE_SINK, module->mInputProfiles);
+        modules.add(module);
+    }
+    reader.deviceRefs(declared, outputDevices);
+    reader.deviceRefs(declared, inputDevices);
+    if (!reader.ok()) {
+        ALOGW("loadAudioPolicyConfig() %s is truncated", path);
+        goto exit;
+    }
+
+    for (size_t i = 0; i < modules.size(); i++) {
+        hwModules.add(modules[i]);
+    }
+    for (size_t i = 0; i < outputDevices.size(); i++) {
+        availableOutputDevices.add(outputDevices[i]);
+    }
+    for (size_t i = 0; i < inputDevices.size(); i++) {
+        availableInputDevices.add(inputDevices[i]);
+    }
+    if (defaultDevice != AUDIO_DEVICE_NONE) {
+        defaultOutputDevice = new DeviceDescriptor(defaultDevice);
+    }
+    isSpeakerDrcEnabled = speakerDrcEnabled;
+    status = NO_ERROR;
+    ALOGI("loadAudioPolicyConfig() loaded %s", path);
+
+exit:
+    munmap(data, size);
+    return status;
+}
+
+//static
+status_t ConfigBinaryUtils::writeAudioPolicyConfig(const char *path,
+                                                   uint32_t sourceSize,
+                                                   const HwModuleCollection &hwModules,
+                                                   const DeviceVector &availableInputDevices,
+                                                   const DeviceVector &availableOutputDevices,
+                                                   const sp<DeviceDescriptor> &defaultOutputDevice,
+                                                   bool isSpeakerDrcEnabled)
+{
+    Writer writer;
+    writer.word(kMagic);
+    writer.word(kVersion);
+    writer.word(0);     // size, patched below
+    writer.word(sourceSize);
+    writer.word(isSpeakerDrcEnabled ? 1 : 0);
+    writer.word(defaultOutputDevice != 0 ? defaultOutputDevice->type() : AUDIO_DEVICE_NONE);
+
+    writer.word(hwModules.size());
+    for (size_t i = 0; i < hwModules.size(); i++) {
+        const sp<HwModule>& module = hwModules[i];
+        writer.string(String8(module->mName));
+        writer.word(module->mHalVersion);
+        writer.word(module->mDeclaredDevices.size());
+        for (size_t j = 0; j < module->mDeclaredDevices.size(); j++) {
+            const sp<DeviceDescriptor>& device = module->mDeclaredDevices[j];
+            writer.word(device->type());
+            writer.string(device->mTag);
+            writer.string(device->mAddress);
+            writer.array(device->mChannelMasks);
+            writer.gains(device->mGains);
+        }
+        writer.profiles(hwModules, module->mOutputProfiles);
+        writer.profiles(hwModules, module->mInputProfiles);
+    }
+    writer.deviceRefs(hwModules, availableOutputDevices);
+    writer.deviceRefs(hwModules, availableInputDevices);
+
+    Vector<uint32_t>& words = writer.words();
+    words.editItemAt(2) = words.size();
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+    size_t size = words.size() * sizeof(uint32_t);
+    ssize_t written = write(fd, words.array(), size);
+    status_t status = written == (ssize_t)size ? NO_ERROR : -errno;
+    close(fd);
+    return status;
+}
+
+}; // namespace android
@@ -38,6 +38,7 @@
 #include <soundtrigger/SoundTrigger.h>
 #include "AudioPolicyManager.h"
 #include "audio_policy_conf.h"
+#include <ConfigBinaryUtils.h>
 #include <ConfigParsingUtils.h>
 #include <policy.h>
 
@@ -160,7 +161,9 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(audio_devices_t device,
                 sp<SwAudioOutputDescriptor> desc = mOutputs.valueFor(outputs[i]);
                 // close unused outputs after device disconnection or direct outputs that have been
                 // opened by checkOutputsForDevice() to query dynamic parameters
-                if ((state == AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE) ||
+                if ((state == AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE) && canParkOutput(desc)) {
+                    parkOutput(outputs[i]);
+                } else if ((state == AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE) ||
                         (((desc->mFlags & AUDIO_OUTPUT_FLAG_DIRECT) != 0) &&
                          (desc->mDirectOpenCount == 0))) {
                     closeOutput(outputs[i]);
@@ -960,11 +963,12 @@ non_direct_output:
     if (audio_is_linear_pcm(format)) {
         // get which output is suitable for the specified stream. The actual
         // routing change will happen when startOutput() will be called
-        SortedVector<audio_io_handle_t> outputs = getOutputsForDevice(device, mOutputs);
-
         // at this stage we should ignore the DIRECT flag as no direct output could be found earlier
         flags = (audio_output_flags_t)(flags & ~AUDIO_OUTPUT_FLAG_DIRECT);
-        output = selectOutput(outputs, flags, format);
+        if (!mDeferredOutputProfiles.isEmpty()) {
+            openDeferredOutputs(device, flags);
+        }
+        output = selectOutputForDevice(device, flags, format);
     }
     ALOGW_IF((output == 0), "getOutput() could not find output for stream %d, samplingRate %d,"
             "format %d, channels %x, flags %x", stream, samplingRate, format, channelMask, flags);
@@ -1032,6 +1036,96 @@ audio_io_handle_t AudioPolicyManager::selectOutput(const SortedVector<audio_io_h
     return outputs[0];
 }
 
+void AudioPolicyManager::openDeferredOutputs(audio_devices_t device, audio_output_flags_t flags)
+{
+    for (size_t i = 0; i < mDeferredOutputProfiles.size(); ) {
+        const sp<IOProfile> profile = mDeferredOutputProfiles[i];
+        if ((profile->mFlags & flags) == 0 ||
+                (profile->mSupportedDevices.types() & device) != device) {
+            i++;
+            continue;
+        }
+        // the profile may have been opened meanwhile by checkOutputsForDevice(): keep it
+        // deferred in case that output is closed on disconnection
+        size_t j;
+        for (j = 0; j < mOutputs.size(); j++) {
+            if (mOutputs.valueAt(j)->mProfile == profile) {
+                break;
+            }
+        }
+        if (j != mOutputs.size()) {
+            i++;
+            continue;
+        }
+        mDeferredOutputProfiles.removeAt(i);
+
+        sp<SwAudioOutputDescriptor> outputDesc = new SwAudioOutputDescriptor(profile,
+                                                                             mpClientInterface);
+        outputDesc->mDevice = device;
+        audio_config_t config = AUDIO_CONFIG_INITIALIZER;
+        config.sample_rate = outputDesc->mSamplingRate;
+        config.channel_mask = outputDesc->mChannelMask;
+        config.format = outputDesc->mFormat;
+        audio_io_handle_t output = AUDIO_IO_HANDLE_NONE;
+        status_t status = mpClientInterface->openOutput(profile->getModuleHandle(),
+                                                        &output,
+                                                        &config,
+                                                        &outputDesc->mDevice,
+                                                        String8(""),
+                                                        &outputDesc->mLatency,
+                                                        outputDesc->mFlags);
+        if (status != NO_ERROR) {
+            ALOGW("openDeferredOutputs() cannot open output %s for device %08x",
+                  profile->mName.string(), device);
+            continue;
+        }
+        outputDesc->mSamplingRate = config.sample_rate;
+        outputDesc->mChannelMask = config.channel_mask;
+        outputDesc->mFormat = config.format;
+
+        audio_io_handle_t srcOutput = getOutputForEffect();
+        addOutput(output, outputDesc);
+        audio_io_handle_t dstOutput = getOutputForEffect();
+        if (dstOutput == output) {
+            mpClientInterface->moveEffects(AUDIO_SESSION_OUTPUT_MIX, srcOutput, dstOutput);
+        }
+        mPreviousOutputs = mOutputs;
+        setOutputDevice(outputDesc, outputDesc->mDevice, true);
+        ALOGV("openDeferredOutputs() opened output %d for profile %s", output,
+              profile->mName.string());
+        mpClientInterface->onAudioPortListUpdate();
+    }
+}
+
+audio_io_handle_t AudioPolicyManager::selectOutputForDevice(audio_devices_t device,
+                                                            audio_output_flags_t flags,
+                                                            audio_format_t format)
+{
+    for (size_t i = 0; i < mOutputSelections.size(); i++) {
+        const OutputSelection& selection = mOutputSelections[i];
+        if (selection.mDevice == device && selection.mFlags == flags &&
+                selection.mFormat == format) {
+            return selection.mOutput;
+        }
+    }
+
+    SortedVector<audio_io_handle_t> outputs = getOutputsForDevice(device, mOutputs);
+    audio_io_handle_t output = selectOutput(outputs, flags, format);
+    // do not remember failures: the output may be opened by a later connection
+    if (output != AUDIO_IO_HANDLE_NONE) {
+        if (mOutputSelections.size() >= kMaxOutputSelections) {
+            mOutputSelections.removeAt(0);
+        }
+        OutputSelection selection;
+        selection.mDevice = device;
+        selection.mFlags = flags;
+        selection.mFormat = format;
+        selection.mOutput = output;
+        mOutputSelections.add(selection);
+    }
+    return output;
+}
+
 status_t AudioPolicyManager::startOutput(audio_io_handle_t output,
                                              audio_stream_type_t stream,
                                              audio_session_t session)
@@ -2729,7 +2823,9 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
     mBeaconMuteRefCount(0),
     mBeaconPlayingRefCount(0),
     mBeaconMuted(false),
-    mTtsOutputAvailable(false)
+    mTtsOutputAvailable(false),
+    mKeepStandbyOutputs(property_get_bool("ro.audio.policy.standby_outputs",
+                                          false /* default_value */))
 {
     audio_policy::EngineInstance *engineInstance = audio_policy::EngineInstance::getInstance();
     if (!engineInstance) {
@@ -2750,15 +2846,24 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
     mpClientInterface = clientInterface;
 
     mDefaultOutputDevice = new DeviceDescriptor(AUDIO_DEVICE_OUT_SPEAKER);
-    if (ConfigParsingUtils::loadAudioPolicyConfig(AUDIO_POLICY_VENDOR_CONFIG_FILE,
+    // a precompiled configuration is preferred to the text file it was built from, but never
+    // to a text file with higher precedence
+    if (ConfigBinaryUtils::loadAudioPolicyConfig(AUDIO_POLICY_VENDOR_BINARY_CONFIG_FILE,
+                 AUDIO_POLICY_VENDOR_CONFIG_FILE,
+                 mHwModules, mAvailableInputDevices, mAvailableOutputDevices,
+                 mDefaultOutputDevice, mSpeakerDrcEnabled) != NO_ERROR &&
+            ConfigParsingUtils::loadAudioPolicyConfig(AUDIO_POLICY_VENDOR_CONFIG_FILE,
+                 mHwModules, mAvailableInputDevices, mAvailableOutputDevices,
+                 mDefaultOutputDevice, mSpeakerDrcEnabled) != NO_ERROR &&
+            ConfigBinaryUtils::loadAudioPolicyConfig(AUDIO_POLICY_BINARY_CONFIG_FILE,
+                 AUDIO_POLICY_CONFIG_FILE,
+                 mHwModules, mAvailableInputDevices, mAvailableOutputDevices,
+                 mDefaultOutputDevice, mSpeakerDrcEnabled) != NO_ERROR &&
+            ConfigParsingUtils::loadAudioPolicyConfig(AUDIO_POLICY_CONFIG_FILE,
                  mHwModules, mAvailableInputDevices, mAvailableOutputDevices,
                  mDefaultOutputDevice, mSpeakerDrcEnabled) != NO_ERROR) {
-        if (ConfigParsingUtils::loadAudioPolicyConfig(AUDIO_POLICY_CONFIG_FILE,
-                                  mHwModules, mAvailableInputDevices, mAvailableOutputDevices,
-                                  mDefaultOutputDevice, mSpeakerDrcEnabled) != NO_ERROR) {
-            ALOGE("could not load audio policy configuration file, setting defaults");
-            defaultAudioPolicyConfig();
-        }
+        ALOGE("could not load audio policy configuration file, setting defaults");
+        defaultAudioPolicyConfig();
     }
     // mAvailableOutputDevices and mAvailableInputDevices now contain all attached devices
 
@@ -2767,6 +2872,8 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
 
     // open all output streams needed to access attached devices
     audio_devices_t outputDeviceTypes = mAvailableOutputDevices.types();
+    const bool deferOutputs = property_get_bool("ro.audio.policy.defer_outputs",
+                                                false /* default_value */);
     audio_devices_t inputDeviceTypes = mAvailableInputDevices.types() & ~AUDIO_DEVICE_BIT_IN;
     for (size_t i = 0; i < mHwModules.size(); i++) {
         mHwModules[i]->mHandle = mpClientInterface->loadHwModule(mHwModules[i]->mName);
@@ -2809,6 +2916,16 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
             if ((profileType & outputDeviceTypes) == 0) {
                 continue;
             }
+            // mixed outputs other than the primary output can be opened on first use, as long
+            // as the primary output reaches all their attached devices and can validate them
+            if (deferOutputs && mPrimaryOutput != 0 &&
+                    (outProfile->mFlags & AUDIO_OUTPUT_FLAG_PRIMARY) == 0 &&
+                    (outProfile->mSupportedDevices.types() & outputDeviceTypes &
+                            ~mPrimaryOutput->supportedDevices()) == 0) {
+                ALOGV("deferring output %s", outProfile->mName.string());
+                mDeferredOutputProfiles.add(outProfile);
+                continue;
+            }
             sp<SwAudioOutputDescriptor> outputDesc = new SwAudioOutputDescriptor(outProfile,
                                                                                  mpClientInterface);
 
@@ -2989,6 +3106,10 @@ AudioPolicyManager::~AudioPolicyManager()
    for (size_t i = 0; i < mOutputs.size(); i++) {
         mpClientInterface->closeOutput(mOutputs.keyAt(i));
    }
+   for (size_t i = 0; i < mStandbyOutputs.size(); i++) {
+        mpClientInterface->closeOutput(mStandbyOutputs[i]->mIoHandle);
+   }
+   mStandbyOutputs.clear();
    for (size_t i = 0; i < mInputs.size(); i++) {
         mpClientInterface->closeInput(mInputs.keyAt(i));
    }
@@ -3168,12 +3289,14 @@ void AudioPolicyManager::addOutput(audio_io_handle_t output, sp<SwAudioOutputDes
 {
     outputDesc->setIoHandle(output);
     mOutputs.add(output, outputDesc);
+    mOutputSelections.clear();
     nextAudioPortGeneration();
 }
 
 void AudioPolicyManager::removeOutput(audio_io_handle_t output)
 {
     mOutputs.removeItem(output);
+    mOutputSelections.clear();
 }
 
 void AudioPolicyManager::addInput(audio_io_handle_t input, sp<AudioInputDescriptor> inputDesc)
@@ -3272,25 +3395,39 @@ status_t AudioPolicyManager::checkOutputsForDevice(const sp<DeviceDescriptor> de
                 continue;
             }
 
-            ALOGV("opening output for device %08x with params %s profile %p",
-                                                      device, address.string(), profile.get());
-            desc = new SwAudioOutputDescriptor(profile, mpClientInterface);
-            desc->mDevice = device;
             audio_config_t config = AUDIO_CONFIG_INITIALIZER;
-            config.sample_rate = desc->mSamplingRate;
-            config.channel_mask = desc->mChannelMask;
-            config.format = desc->mFormat;
-            config.offload_info.sample_rate = desc->mSamplingRate;
-            config.offload_info.channel_mask = desc->mChannelMask;
-            config.offload_info.format = desc->mFormat;
             audio_io_handle_t output = AUDIO_IO_HANDLE_NONE;
-            status_t status = mpClientInterface->openOutput(profile->getModuleHandle(),
-                                                            &output,
-                                                            &config,
-                                                            &desc->mDevice,
-                                                            address,
-                                                            &desc->mLatency,
-                                                            desc->mFlags);
+            status_t status;
+            desc = takeStandbyOutput(profile);
+            if (desc != 0) {
+                // the HAL stream is still open in standby since the device was disconnected:
+                // only its descriptor must be restored, the device is set by setOutputDevice()
+                ALOGV("reusing standby output %d for device %08x", desc->mIoHandle, device);
+                desc->mDevice = device;
+                output = desc->mIoHandle;
+                config.sample_rate = desc->mSamplingRate;
+                config.channel_mask = desc->mChannelMask;
+                config.format = desc->mFormat;
+                status = NO_ERROR;
+            } else {
+                ALOGV("opening output for device %08x with params %s profile %p",
+                                                      device, address.string(), profile.get());
+                desc = new SwAudioOutputDescriptor(profile, mpClientInterface);
+                desc->mDevice = device;
+                config.sample_rate = desc->mSamplingRate;
+                config.channel_mask = desc->mChannelMask;
+                config.format = desc->mFormat;
+                config.offload_info.sample_rate = desc->mSamplingRate;
+                config.offload_info.channel_mask = desc->mChannelMask;
+                config.offload_info.format = desc->mFormat;
+                status = mpClientInterface->openOutput(profile->getModuleHandle(),
+                                                       &output,
+                                                       &config,
+                                                       &desc->mDevice,
+                                                       address,
+                                                       &desc->mLatency,
+                                                       desc->mFlags);
+            }
             if (status == NO_ERROR) {
                 desc->mSamplingRate = config.sample_rate;
                 desc->mChannelMask = config.channel_mask;
@@ -3708,6 +3845,85 @@ void AudioPolicyManager::closeOutput(audio_io_handle_t output)
         ALOGW("closeOutput() unknown output %d", output);
         return;
     }
+    detachOutput(outputDesc);
+
+    AudioParameter param;
+    param.add(String8("closing"), String8("true"));
+    mpClientInterface->setParameters(output, param.toString());
+
+    mpClientInterface->closeOutput(output);
+    removeOutput(output);
+    mPreviousOutputs = mOutputs;
+}
+
+void AudioPolicyManager::parkOutput(audio_io_handle_t output)
+{
+    ALOGV("parkOutput(%d)", output);
+
+    sp<SwAudioOutputDescriptor> outputDesc = mOutputs.valueFor(output);
+    if (outputDesc == NULL) {
+        ALOGW("parkOutput() unknown output %d", output);
+        return;
+    }
+    detachOutput(outputDesc);
+
+    // tracks were moved to other outputs by checkOutputForAllStrategies() and will never stop
+    // on this one, which must look idle when it is reused
+    for (int i = 0; i < AUDIO_STREAM_CNT; i++) {
+        outputDesc->mRefCount[i] = 0;
+        outputDesc->mMuteCount[i] = 0;
+    }
+    for (int i = 0; i < NUM_STRATEGIES; i++) {
+        outputDesc->mStrategyMutedByDevice[i] = false;
+    }
+    outputDesc->mDevice = AUDIO_DEVICE_NONE;
+    outputDesc->mPatchHandle = 0;
+
+    removeOutput(output);
+    mPreviousOutputs = mOutputs;
+
+    if (mStandbyOutputs.size() >= kMaxStandbyOutputs) {
+        ALOGV("parkOutput() closing oldest standby output %d", mStandbyOutputs[0]->mIoHandle);
+        mpClientInterface->closeOutput(mStandbyOutputs[0]->mIoHandle);
+        mStandbyOutputs.removeAt(0);
+    }
+    mStandbyOutputs.add(outputDesc);
+}
+
+sp<SwAudioOutputDescriptor> AudioPolicyManager::takeStandbyOutput(const sp<IOProfile>& profile)
+{
+    for (size_t i = 0; i < mStandbyOutputs.size(); i++) {
+        sp<SwAudioOutputDescriptor> desc = mStandbyOutputs[i];
+        if (desc->mProfile == profile) {
+            mStandbyOutputs.removeAt(i);
+            return desc;
+        }
+    }
+    return NULL;
+}
+
+bool AudioPolicyManager::canParkOutput(const sp<SwAudioOutputDescriptor>& outputDesc) const
+{
+    if (!mKeepStandbyOutputs || outputDesc->isDuplicated() || outputDesc->mPolicyMix != NULL) {
+        return false;
+    }
+    // direct outputs are reopened with the client's configuration anyway
+    if ((outputDesc->mFlags & AUDIO_OUTPUT_FLAG_DIRECT) != 0) {
+        return false;
+    }
+    sp<IOProfile> profile = outputDesc->mProfile;
+    if (profile == 0 || device_distinguishes_on_address(profile->mSupportedDevices.types())) {
+        return false;
+    }
+    // the parameters of dynamic profiles are those of the device that was disconnected,
+    // the next one may not support them
+    return profile->mSamplingRates[0] != 0 &&
+            profile->mFormats[0] != AUDIO_FORMAT_DEFAULT &&
+            profile->mChannelMasks[0] != 0;
+}
+
+void AudioPolicyManager::detachOutput(const sp<SwAudioOutputDescriptor>& outputDesc)
+{
     mPolicyMixes.closeOutput(outputDesc);
 
     // look for duplicated outputs connected to the output being removed.
@@ -3747,14 +3963,6 @@ void AudioPolicyManager::closeOutput(audio_io_handle_t output)
         mAudioPatches.removeItemsAt(index);
         mpClientInterface->onAudioPatchListUpdate();
     }
-
-    AudioParameter param;
-    param.add(String8("closing"), String8("true"));
-    mpClientInterface->setParameters(output, param.toString());
-
-    mpClientInterface->closeOutput(output);
-    removeOutput(output);
-    mPreviousOutputs = mOutputs;
 }
 
 void AudioPolicyManager::closeInput(audio_io_handle_t input)
@@ -3782,8 +3990,8 @@ void AudioPolicyManager::closeInput(audio_io_handle_t input)
 }
 
 SortedVector<audio_io_handle_t> AudioPolicyManager::getOutputsForDevice(
-                                                                audio_devices_t device,
-                                                                SwAudioOutputCollection openOutputs)
+                                                        audio_devices_t device,
+                                                        const SwAudioOutputCollection& openOutputs)
 {
     SortedVector<audio_io_handle_t> outputs;
 
@@ -3818,10 +4026,10 @@ void AudioPolicyManager::checkOutputForStrategy(routing_strategy strategy)
 {
     audio_devices_t oldDevice = getDeviceForStrategy(strategy, true /*fromCache*/);
     audio_devices_t newDevice = getDeviceForStrategy(strategy, false /*fromCache*/);
-    SortedVector<audio_io_handle_t> srcOutputs = getOutputsForDevice(oldDevice, mOutputs);
-    SortedVector<audio_io_handle_t> dstOutputs = getOutputsForDevice(newDevice, mOutputs);
+    SortedVector<audio_io_handle_t> srcOutputs;
+    SortedVector<audio_io_handle_t> dstOutputs;
 
-    // also take into account external policy-related changes: add all outputs which are
+    // take into account external policy-related changes: add all outputs which are
     // associated with policies in the "before" and "after" output vectors
     ALOGVV("checkOutputForStrategy(): policy related outputs");
     for (size_t i = 0 ; i < mPreviousOutputs.size() ; i++) {
@@ -3839,6 +4047,14 @@ void AudioPolicyManager::checkOutputForStrategy(routing_strategy strategy)
         }
     }
 
+    // the outputs for the device are looked up in mOutputs for both the old and new device:
+    // if the device of the strategy did not change, only policy related outputs can differ.
+    if (oldDevice == newDevice && vectorsEqual(srcOutputs, dstOutputs)) {
+        return;
+    }
+    srcOutputs.merge(getOutputsForDevice(oldDevice, mOutputs));
+    dstOutputs.merge(getOutputsForDevice(newDevice, mOutputs));
+
     if (!vectorsEqual(srcOutputs,dstOutputs)) {
         ALOGV("checkOutputForStrategy() strategy %d, moving from output %d to output %d",
               strategy, srcOutputs[0], dstOutputs[0]);
@@ -377,6 +377,16 @@ protected:
 
         // close an output and its companion duplicating output.
         void closeOutput(audio_io_handle_t output);
+        // same as closeOutput() but leaves the HAL stream open and in standby in
+        // mStandbyOutputs, so that reconnecting the device does not reopen it.
+        void parkOutput(audio_io_handle_t output);
+        // releases what closeOutput() and parkOutput() have in common: the policy mix,
+        // companion duplicating outputs and the audio patch.
+        void detachOutput(const sp<SwAudioOutputDescriptor>& outputDesc);
+        // returns and removes the parked output opened with profile, if any
+        sp<SwAudioOutputDescriptor> takeStandbyOutput(const sp<IOProfile>& profile);
+        // true if parkOutput() may keep this output open after its device is disconnected
+        bool canParkOutput(const sp<SwAudioOutputDescriptor>& outputDesc) const;
 
         // close an input.
         void closeInput(audio_io_handle_t input);
@@ -426,7 +436,7 @@ protected:
 #endif //AUDIO_POLICY_TEST
 
         SortedVector<audio_io_handle_t> getOutputsForDevice(audio_devices_t device,
-                                                            SwAudioOutputCollection openOutputs);
+                                                    const SwAudioOutputCollection& openOutputs);
         bool vectorsEqual(SortedVector<audio_io_handle_t>& outputs1,
                                            SortedVector<audio_io_handle_t>& outputs2);
 
@@ -441,6 +451,13 @@ protected:
         audio_io_handle_t selectOutput(const SortedVector<audio_io_handle_t>& outputs,
                                        audio_output_flags_t flags,
                                        audio_format_t format);
+        // same as selectOutput(getOutputsForDevice(device, mOutputs), flags, format), memoized
+        // in mOutputSelections until an output is opened or closed
+        audio_io_handle_t selectOutputForDevice(audio_devices_t device,
+                                                audio_output_flags_t flags,
+                                                audio_format_t format);
+        // opens the deferred mixed outputs reaching device with at least one of flags
+        void openDeferredOutputs(audio_devices_t device, audio_output_flags_t flags);
         // samplingRate, format, channelMask are in/out and so may be modified
         sp<IOProfile> getInputProfile(audio_devices_t device,
                                       String8 address,
@@ -518,6 +535,18 @@ protected:
         StreamDescriptorCollection mStreams; // stream descriptors for volume control
         bool    mLimitRingtoneVolume;        // limit ringtone volume to music volume if headset connected
         audio_devices_t mDeviceForStrategy[NUM_STRATEGIES];
+
+        // mixed output previously selected for a device, flags and format combination.
+        // The selection only depends on the set of opened outputs, and is cleared by
+        // addOutput() and removeOutput().
+        struct OutputSelection {
+            audio_devices_t     mDevice;
+            audio_output_flags_t mFlags;
+            audio_format_t      mFormat;
+            audio_io_handle_t   mOutput;
+        };
+        static const size_t kMaxOutputSelections = 16;
+        Vector<OutputSelection> mOutputSelections;
         float   mLastVoiceVolume;            // last voice volume value sent to audio HAL
 
         EffectDescriptorCollection mEffects;  // list of registered audio effects
@@ -549,6 +578,14 @@ protected:
         uint32_t mBeaconPlayingRefCount;// ref count for the playing beacon streams
         bool mBeaconMuted;              // has STREAM_TTS been muted
         bool mTtsOutputAvailable;       // true if a dedicated output for TTS stream is available
+        // mixed output profiles not opened at boot when ro.audio.policy.defer_outputs is set,
+        // see openDeferredOutputs()
+        Vector< sp<IOProfile> > mDeferredOutputProfiles;
+        // outputs kept open in standby after their device was disconnected when
+        // ro.audio.policy.standby_outputs is set, oldest first, see parkOutput()
+        static const size_t kMaxStandbyOutputs = 2;
+        bool mKeepStandbyOutputs;
+        Vector< sp<SwAudioOutputDescriptor> > mStandbyOutputs;
 
         AudioPolicyMixCollection mPolicyMixes; // list of registered mixes
 
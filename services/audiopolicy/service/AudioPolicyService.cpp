@@ -482,12 +482,46 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                     mLock.lock();
                     }break;
                 case SET_VOLUME: {
-                    VolumeData *data = (VolumeData *)command->mParam.get();
-                    ALOGV("AudioCommandThread() processing set volume stream %d, \
-                            volume %f, output %d", data->mStream, data->mVolume, data->mIO);
-                    command->mStatus = AudioSystem::setStreamVolume(data->mStream,
-                                                                    data->mVolume,
-                                                                    data->mIO);
+                    // send all volume commands due now with a single call to audio flinger,
+                    // keeping only the last volume for each stream and output
+                    Vector< sp<AudioCommand> > batch;
+                    Vector<IAudioFlinger::StreamVolume> volumes;
+                    batch.add(command);
+                    while (!mAudioCommands.isEmpty() &&
+                            mAudioCommands[0]->mCommand == SET_VOLUME &&
+                            mAudioCommands[0]->mTime <= curTime) {
+                        batch.add(mAudioCommands[0]);
+                        mAudioCommands.removeAt(0);
+                    }
+                    for (size_t i = 0; i < batch.size(); i++) {
+                        VolumeData *data = (VolumeData *)batch[i]->mParam.get();
+                        ALOGV("AudioCommandThread() processing set volume stream %d, \
+                                volume %f, output %d", data->mStream, data->mVolume, data->mIO);
+                        size_t j;
+                        for (j = 0; j < volumes.size(); j++) {
+                            if (volumes[j].mStream == data->mStream &&
+                                    volumes[j].mOutput == data->mIO) {
+                                break;
+                            }
+                        }
+                        if (j == volumes.size()) {
+                            IAudioFlinger::StreamVolume volume;
+                            volume.mStream = data->mStream;
+                            volume.mOutput = data->mIO;
+                            volumes.add(volume);
+                        }
+                        volumes.editItemAt(j).mVolume = data->mVolume;
+                    }
+                    command->mStatus = AudioSystem::setStreamVolumes(volumes.array(),
+                                                                     volumes.size());
+                    for (size_t i = 1; i < batch.size(); i++) {
+                        Mutex::Autolock _l(batch[i]->mLock);
+                        batch[i]->mStatus = command->mStatus;
+                        if (batch[i]->mWaitStatus) {
+                            batch[i]->mWaitStatus = false;
+                            batch[i]->mCond.signal();
+                        }
+                    }
                     }break;
                 case SET_PARAMETERS: {
                     ParametersData *data = (ParametersData *)command->mParam.get();
@@ -731,7 +765,9 @@ status_t AudioPolicyService::AudioCommandThread::volumeCommand(audio_stream_type
     data->mVolume = volume;
     data->mIO = output;
     command->mParam = data;
-    command->mWaitStatus = true;
+    // the status is always NO_ERROR for a valid stream: do not wait for it, so that a burst of
+    // volume changes is queued and sent to audio flinger as a single batch
+    command->mWaitStatus = false;
     ALOGV("AudioCommandThread() adding set volume stream %d, volume %f, output %d",
             stream, volume, output);
     return sendCommand(command, delayMs);
@@ -0,0 +1,72 @@
+LOCAL_PATH:= $(call my-dir)
+
+# Host tool compiling audio_policy.conf into the binary configuration loaded by
+# AudioPolicyManager, see ConfigBinaryUtils.h.
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    audio_policy_conf_compiler.cpp \
+    ../../common/managerdefinitions/src/AudioGain.cpp \
+    ../../common/managerdefinitions/src/AudioPort.cpp \
+    ../../common/managerdefinitions/src/ConfigBinaryUtils.cpp \
+    ../../common/managerdefinitions/src/ConfigParsingUtils.cpp \
+    ../../common/managerdefinitions/src/DeviceDescriptor.cpp \
+    ../../common/managerdefinitions/src/HwModule.cpp \
+    ../../common/managerdefinitions/src/IOProfile.cpp \
+
+LOCAL_STATIC_LIBRARIES := \
+    libutils \
+    libcutils \
+    liblog \
+
+LOCAL_C_INCLUDES += \
+    $(TOPDIR)frameworks/av/services/audiopolicy/common/managerdefinitions/include \
+    $(TOPDIR)frameworks/av/services/audiopolicy/common/include \
+    $(TOPDIR)frameworks/av/services/audiopolicy
+
+# must match the enum tables built into libaudiopolicycomponents
+ifeq ($(strip $(AUDIO_FEATURE_ENABLED_FLAC_OFFLOAD)),true)
+LOCAL_CFLAGS     += -DFLAC_OFFLOAD_ENABLED
+endif
+ifneq ($(strip $(AUDIO_FEATURE_ENABLED_PROXY_DEVICE)),false)
+LOCAL_CFLAGS     += -DAUDIO_EXTN_AFE_PROXY_ENABLED
+endif
+ifeq ($(strip $(AUDIO_FEATURE_ENABLED_WMA_OFFLOAD)),true)
+LOCAL_CFLAGS     += -DWMA_OFFLOAD_ENABLED
+endif
+ifeq ($(strip $(AUDIO_FEATURE_ENABLED_ALAC_OFFLOAD)),true)
+LOCAL_CFLAGS     += -DALAC_OFFLOAD_ENABLED
+endif
+ifeq ($(strip $(AUDIO_FEATURE_ENABLED_APE_OFFLOAD)),true)
+LOCAL_CFLAGS     += -DAPE_OFFLOAD_ENABLED
+endif
+ifeq ($(strip $(AUDIO_FEATURE_ENABLED_AAC_ADTS_OFFLOAD)),true)
+LOCAL_CFLAGS     += -DAAC_ADTS_OFFLOAD_ENABLED
+endif
+
+LOCAL_CFLAGS += -Wall -Werror
+
+LOCAL_MODULE := audio_policy_conf_compiler
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# A device installing its audio_policy.conf from BOARD_AUDIO_POLICY_CONF also gets the
+# precompiled configuration installed next to it.
+ifneq ($(strip $(BOARD_AUDIO_POLICY_CONF)),)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_policy.bin
+LOCAL_MODULE_CLASS := ETC
+LOCAL_MODULE_PATH := $(TARGET_OUT_ETC)
+
+include $(BUILD_SYSTEM)/base_rules.mk
+
+AUDIO_POLICY_CONF_COMPILER := $(HOST_OUT_EXECUTABLES)/audio_policy_conf_compiler$(HOST_EXECUTABLE_SUFFIX)
+
+$(LOCAL_BUILT_MODULE): $(BOARD_AUDIO_POLICY_CONF) $(AUDIO_POLICY_CONF_COMPILER)
+	@mkdir -p $(dir $@)
+	$(hide) $(AUDIO_POLICY_CONF_COMPILER) $< $@
+
+endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiles audio_policy.conf into the binary configuration loaded by ConfigBinaryUtils.
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ConfigBinaryUtils.h>
+#include <ConfigParsingUtils.h>
+#include <IOProfile.h>
+
+using namespace android;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s <audio_policy.conf> <audio_policy.bin>\n", me);
+}
+
+static size_t countProfiles(const HwModuleCollection &hwModules) {
+    size_t count = 0;
+    for (size_t i = 0; i < hwModules.size(); i++) {
+        count += hwModules[i]->mOutputProfiles.size() + hwModules[i]->mInputProfiles.size();
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *source = argv[1];
+    const char *output = argv[2];
+
+    struct stat st;
+    if (stat(source, &st) != 0) {
+        fprintf(stderr, "unable to stat '%s'\n", source);
+        return 1;
+    }
+
+    // same defaults as AudioPolicyManager
+    HwModuleCollection hwModules;
+    DeviceVector availableInputDevices;
+    DeviceVector availableOutputDevices;
+    sp<DeviceDescriptor> defaultOutputDevice = new DeviceDescriptor(AUDIO_DEVICE_OUT_SPEAKER);
+    bool speakerDrcEnabled = false;
+    if (ConfigParsingUtils::loadAudioPolicyConfig(source, hwModules,
+            availableInputDevices, availableOutputDevices,
+            defaultOutputDevice, speakerDrcEnabled) != NO_ERROR) {
+        fprintf(stderr, "unable to load '%s'\n", source);
+        return 1;
+    }
+
+    status_t status = ConfigBinaryUtils::writeAudioPolicyConfig(output, st.st_size, hwModules,
+            availableInputDevices, availableOutputDevices,
+            defaultOutputDevice, speakerDrcEnabled);
+    if (status != NO_ERROR) {
+        fprintf(stderr, "unable to write '%s': %s\n", output, strerror(-status));
+        return 1;
+    }
+
+    // read it back, as AudioPolicyManager would
+    HwModuleCollection loadedModules;
+    DeviceVector loadedInputDevices;
+    DeviceVector loadedOutputDevices;
+    sp<DeviceDescriptor> loadedDefaultDevice = new DeviceDescriptor(AUDIO_DEVICE_OUT_SPEAKER);
+    bool loadedSpeakerDrcEnabled = false;
+    if (ConfigBinaryUtils::loadAudioPolicyConfig(output, source, loadedModules,
+            loadedInputDevices, loadedOutputDevices,
+            loadedDefaultDevice, loadedSpeakerDrcEnabled) != NO_ERROR ||
+            loadedModules.size() != hwModules.size() ||
+            countProfiles(loadedModules) != countProfiles(hwModules) ||
+            loadedInputDevices.types() != availableInputDevices.types() ||
+            loadedOutputDevices.types() != availableOutputDevices.types() ||
+            loadedDefaultDevice->type() != defaultOutputDevice->type() ||
+            loadedSpeakerDrcEnabled != speakerDrcEnabled) {
+        fprintf(stderr, "'%s' does not match '%s'\n", output, source);
+        unlink(output);
+        return 1;
+    }
+
+    printf("%s: %zu modules, %zu profiles\n", output, hwModules.size(), countProfiles(hwModules));
+    return 0;
+}
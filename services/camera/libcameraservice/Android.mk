@@ -63,6 +63,7 @@ LOCAL_SHARED_LIBRARIES:= \
     libcutils \
     libmedia \
     libmediautils \
+    libstagefright_foundation \
     libcamera_client \
     libgui \
     libhardware \
@@ -44,6 +44,38 @@ static int getCallingPid() {
     return IPCThreadState::self()->getCallingPid();
 }
 
+namespace {
+
+// Builds the default parameters of a client from its static camera characteristics
+class ParametersInitializer : public Thread {
+  public:
+    ParametersInitializer(SharedParameters &parameters, const CameraMetadata *info,
+            int deviceVersion) :
+            Thread(/*canCallJava*/false),
+            mParameters(parameters),
+            mInfo(info),
+            mDeviceVersion(deviceVersion),
+            mResult(NO_INIT) {
+    }
+
+    // Valid once join() returned
+    status_t result() const { return mResult; }
+
+  private:
+    virtual bool threadLoop() {
+        SharedParameters::Lock l(mParameters);
+        mResult = l.mParameters.initialize(mInfo, mDeviceVersion);
+        return false;
+    }
+
+    SharedParameters &mParameters;
+    const CameraMetadata *mInfo;
+    const int mDeviceVersion;
+    status_t mResult;
+};
+
+} // anonymous namespace
+
 // Interface used by CameraService
 
 Camera2Client::Camera2Client(const sp<CameraService>& cameraService,
@@ -73,7 +105,27 @@ status_t Camera2Client::initialize(CameraModule *module)
     ALOGV("%s: Initializing client for camera %d", __FUNCTION__, mCameraId);
     status_t res;
 
+    // Opening the HAL device takes a while; meanwhile build the default parameters from the
+    // static characteristics the camera module has cached, which are the ones the device will
+    // report.
+    CameraMetadata staticInfo;
+    sp<ParametersInitializer> parametersInitializer;
+    struct camera_info info;
+    if (module->getCameraInfo(mCameraId, &info) == OK &&
+            info.static_camera_characteristics != NULL) {
+        staticInfo = info.static_camera_characteristics;
+        parametersInitializer = new ParametersInitializer(mParameters, &staticInfo,
+                mDeviceVersion);
+        if (parametersInitializer->run(String8::format("C2-%d-ParamInit",
+                mCameraId).string()) != OK) {
+            parametersInitializer.clear();
+        }
+    }
+
     res = Camera2ClientBase::initialize(module);
+    if (parametersInitializer != 0) {
+        parametersInitializer->join();
+    }
     if (res != OK) {
         return res;
     }
@@ -81,11 +133,16 @@ status_t Camera2Client::initialize(CameraModule *module)
     {
         SharedParameters::Lock l(mParameters);
 
-        res = l.mParameters.initialize(&(mDevice->info()), mDeviceVersion);
-        if (res != OK) {
-            ALOGE("%s: Camera %d: unable to build defaults: %s (%d)",
-                    __FUNCTION__, mCameraId, strerror(-res), res);
-            return NO_INIT;
+        if (parametersInitializer != 0 && parametersInitializer->result() == OK) {
+            // The parameters keep using the static info, it must be the device's copy
+            l.mParameters.info = &(mDevice->info());
+        } else {
+            res = l.mParameters.initialize(&(mDevice->info()), mDeviceVersion);
+            if (res != OK) {
+                ALOGE("%s: Camera %d: unable to build defaults: %s (%d)",
+                        __FUNCTION__, mCameraId, strerror(-res), res);
+                return NO_INIT;
+            }
         }
     }
 
@@ -1514,7 +1571,14 @@ status_t Camera2Client::setParameters(const String8& params) {
 
     SharedParameters::Lock l(mParameters);
 
+    // Applications commonly send back what getParameters() returned, with no change at all
+    if (params == l.mParameters.paramsFlattened) {
+        ALOGV("%s: Camera %d: Parameters unchanged", __FUNCTION__, mCameraId);
+        return OK;
+    }
+
     Parameters::focusMode_t focusModeBefore = l.mParameters.focusMode;
+    Parameters::StreamConfig streamsBefore = l.mParameters.getStreamConfig();
     res = l.mParameters.set(params);
     if (res != OK) return res;
     Parameters::focusMode_t focusModeAfter = l.mParameters.focusMode;
@@ -1523,6 +1587,12 @@ status_t Camera2Client::setParameters(const String8& params) {
         mZslProcessor->clearZslQueue();
     }
 
+    // Zoom, focus and 3A changes, made per frame by some applications, only need the
+    // repeating request to be rebuilt; leave the streams alone.
+    if (l.mParameters.getStreamConfig() == streamsBefore) {
+        return updateCaptureRequests(l.mParameters);
+    }
+
     res = updateRequests(l.mParameters);
 
     return res;
@@ -2042,6 +2112,48 @@ status_t Camera2Client::updateRequests(Parameters &params) {
     return res;
 }
 
+status_t Camera2Client::updateCaptureRequests(Parameters &params) {
+    ATRACE_CALL();
+    status_t res;
+
+    if (params.state != Parameters::PREVIEW &&
+            params.state != Parameters::RECORD &&
+            params.state != Parameters::VIDEO_SNAPSHOT) {
+        return updateRequests(params);
+    }
+
+    res = mStreamingProcessor->incrementStreamingIds();
+    if (res != OK) {
+        ALOGE("%s: Camera %d: Unable to increment request IDs: %s (%d)",
+                __FUNCTION__, mCameraId, strerror(-res), res);
+        return res;
+    }
+
+    res = mStreamingProcessor->updatePreviewRequest(params);
+    if (res != OK) {
+        ALOGE("%s: Camera %d: Unable to update preview request: %s (%d)",
+                __FUNCTION__, mCameraId, strerror(-res), res);
+        return res;
+    }
+    res = mStreamingProcessor->updateRecordingRequest(params);
+    if (res != OK) {
+        ALOGE("%s: Camera %d: Unable to update recording request: %s (%d)",
+                __FUNCTION__, mCameraId, strerror(-res), res);
+        return res;
+    }
+
+    res = mStreamingProcessor->updateActiveStream();
+    if (res == INVALID_OPERATION) {
+        // Not streaming right now, e.g. paused: go through the full restart
+        return updateRequests(params);
+    }
+    if (res != OK) {
+        ALOGE("%s: Camera %d: Error streaming new request: %s (%d)",
+                __FUNCTION__, mCameraId, strerror(-res), res);
+    }
+    return res;
+}
+
 
 size_t Camera2Client::calculateBufferSize(int width, int height,
         int format, int stride) {
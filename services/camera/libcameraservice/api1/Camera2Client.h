@@ -184,6 +184,8 @@ private:
 
     void     setPreviewCallbackFlagL(Parameters &params, int flag);
     status_t updateRequests(Parameters &params);
+    // Like updateRequests, for parameter changes that keep the same output streams
+    status_t updateCaptureRequests(Parameters &params);
 
     template <typename ProcessorT>
     status_t updateProcessorStream(sp<ProcessorT> processor, Parameters params);
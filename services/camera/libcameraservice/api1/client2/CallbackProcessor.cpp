@@ -26,11 +26,52 @@
 #include "api1/Camera2Client.h"
 #include "api1/client2/CallbackProcessor.h"
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON_CONVERSION 1
+#else
+#define USE_NEON_CONVERSION 0
+#endif
+
 #define ALIGN(x, mask) ( ((x) + (mask) - 1) & ~((mask) - 1) )
 
 namespace android {
 namespace camera2 {
 
+// Swaps the bytes of chromaWidth interleaved chroma pairs, CbCr to CrCb.
+static void swapChromaRow(uint8_t *dst, const uint8_t *src, size_t chromaWidth) {
+    size_t col = 0;
+#if USE_NEON_CONVERSION
+    for (; col + 16 <= chromaWidth; col += 16) {
+        uint8x16x2_t cbcr = vld2q_u8(src + 2 * col);
+        uint8x16x2_t crcb = { { cbcr.val[1], cbcr.val[0] } };
+        vst2q_u8(dst + 2 * col, crcb);
+    }
+#endif
+    for (; col < chromaWidth; col++) {
+        dst[2 * col] = src[2 * col + 1];
+        dst[2 * col + 1] = src[2 * col];
+    }
+}
+
+// Splits chromaWidth interleaved chroma pairs into two planes, first and second
+// receiving the first and second byte of each pair.
+static void deinterleaveChromaRow(uint8_t *first, uint8_t *second, const uint8_t *src,
+        size_t chromaWidth) {
+    size_t col = 0;
+#if USE_NEON_CONVERSION
+    for (; col + 16 <= chromaWidth; col += 16) {
+        uint8x16x2_t pairs = vld2q_u8(src + 2 * col);
+        vst1q_u8(first + col, pairs.val[0]);
+        vst1q_u8(second + col, pairs.val[1]);
+    }
+#endif
+    for (; col < chromaWidth; col++) {
+        first[col] = src[2 * col];
+        second[col] = src[2 * col + 1];
+    }
+}
+
 CallbackProcessor::CallbackProcessor(sp<Camera2Client> client):
         Thread(false),
         mClient(client),
@@ -465,10 +506,15 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
     // Copy Y plane, adjusting for stride
     const uint8_t *ySrc = src.data;
     uint8_t *yDst = dst;
-    for (size_t row = 0; row < src.height; row++) {
-        memcpy(yDst, ySrc, src.width);
-        ySrc += src.stride;
-        yDst += dstYStride;
+    if (src.stride == src.width && dstYStride == src.width) {
+        memcpy(yDst, ySrc, src.width * src.height);
+        yDst += src.width * src.height;
+    } else {
+        for (size_t row = 0; row < src.height; row++) {
+            memcpy(yDst, ySrc, src.width);
+            ySrc += src.stride;
+            yDst += dstYStride;
+        }
     }
 
     // Copy/swizzle chroma planes, 4:2:0 subsampling
@@ -487,10 +533,22 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
         if (cbSrc == crSrc + 1 && src.chromaStep == 2) {
             ALOGV("%s: Fast NV21->NV21", __FUNCTION__);
             // Source has semiplanar CrCb chroma layout, can copy by rows
+            if (src.chromaStride == src.width) {
+                memcpy(crcbDst, crSrc, src.width * chromaHeight);
+            } else {
+                for (size_t row = 0; row < chromaHeight; row++) {
+                    memcpy(crcbDst, crSrc, src.width);
+                    crcbDst += src.width;
+                    crSrc += src.chromaStride;
+                }
+            }
+        } else if (crSrc == cbSrc + 1 && src.chromaStep == 2) {
+            ALOGV("%s: Fast NV12->NV21", __FUNCTION__);
+            // Source has semiplanar CbCr chroma layout, swap each pair
             for (size_t row = 0; row < chromaHeight; row++) {
-                memcpy(crcbDst, crSrc, src.width);
+                swapChromaRow(crcbDst, cbSrc, chromaWidth);
                 crcbDst += src.width;
-                crSrc += src.chromaStride;
+                cbSrc += src.chromaStride;
             }
         } else {
             ALOGV("%s: Generic->NV21", __FUNCTION__);
@@ -525,6 +583,21 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
                 cbDst += dstCStride;
                 cbSrc += src.chromaStride;
             }
+        } else if (src.chromaStep == 2 && (cbSrc == crSrc + 1 || crSrc == cbSrc + 1)) {
+            ALOGV("%s: Fast NV21/NV12->YV12", __FUNCTION__);
+            // Source has semiplanar chroma layout, split each row into both planes
+            const bool crFirst = cbSrc == crSrc + 1;
+            const uint8_t *chromaSrc = crFirst ? crSrc : cbSrc;
+            for (size_t row = 0; row < chromaHeight; row++) {
+                if (crFirst) {
+                    deinterleaveChromaRow(crDst, cbDst, chromaSrc, chromaWidth);
+                } else {
+                    deinterleaveChromaRow(cbDst, crDst, chromaSrc, chromaWidth);
+                }
+                crDst += dstCStride;
+                cbDst += dstCStride;
+                chromaSrc += src.chromaStride;
+            }
         } else {
             ALOGV("%s: Generic->YV12", __FUNCTION__);
             // Generic copy, always works but not very efficient
@@ -43,7 +43,8 @@ JpegProcessor::JpegProcessor(
         mSequencer(sequencer),
         mId(client->getCameraId()),
         mCaptureAvailable(false),
-        mCaptureStreamId(NO_STREAM) {
+        mCaptureStreamId(NO_STREAM),
+        mLastCaptureHeap(0) {
 }
 
 JpegProcessor::~JpegProcessor() {
@@ -94,22 +95,24 @@ status_t JpegProcessor::updateStream(const Parameters &params) {
     // Since ashmem heaps are rounded up to page size, don't reallocate if
     // the capture heap isn't exactly the same size as the required JPEG buffer
     const size_t HEAP_SLACK_FACTOR = 2;
-    if (mCaptureHeap == 0 ||
-            (mCaptureHeap->getSize() < static_cast<size_t>(maxJpegSize)) ||
-            (mCaptureHeap->getSize() >
+    if (mCaptureHeaps.isEmpty() ||
+            (mCaptureHeaps[0]->getSize() < static_cast<size_t>(maxJpegSize)) ||
+            (mCaptureHeaps[0]->getSize() >
                     static_cast<size_t>(maxJpegSize) * HEAP_SLACK_FACTOR) ) {
         // Create memory for API consumption
-        mCaptureHeap.clear();
-        mCaptureHeap =
+        mCaptureHeaps.clear();
+        sp<MemoryHeapBase> captureHeap =
                 new MemoryHeapBase(maxJpegSize, 0, "Camera2Client::CaptureHeap");
-        if (mCaptureHeap->getSize() == 0) {
+        if (captureHeap->getSize() == 0) {
             ALOGE("%s: Camera %d: Unable to allocate memory for capture",
                     __FUNCTION__, mId);
             return NO_MEMORY;
         }
+        mCaptureHeaps.push_back(captureHeap);
+        mLastCaptureHeap = 0;
     }
     ALOGV("%s: Camera %d: JPEG capture heap now %d bytes; requested %d bytes",
-            __FUNCTION__, mId, mCaptureHeap->getSize(), maxJpegSize);
+            __FUNCTION__, mId, mCaptureHeaps[0]->getSize(), maxJpegSize);
 
     if (mCaptureStreamId != NO_STREAM) {
         // Check if stream parameters have to change
@@ -172,7 +175,7 @@ status_t JpegProcessor::deleteStream() {
 
         device->deleteStream(mCaptureStreamId);
 
-        mCaptureHeap.clear();
+        mCaptureHeaps.clear();
         mCaptureWindow.clear();
         mCaptureConsumer.clear();
 
@@ -251,7 +254,8 @@ status_t JpegProcessor::processNewCapture() {
         if (jpegSize == 0) { // failed to find size, default to whole buffer
             jpegSize = imgBuffer.width;
         }
-        size_t heapSize = mCaptureHeap->getSize();
+        sp<MemoryHeapBase> captureHeap = getCaptureHeapLocked();
+        size_t heapSize = captureHeap->getSize();
         if (jpegSize > heapSize) {
             ALOGW("%s: JPEG image is larger than expected, truncating "
                     "(got %zu, expected at most %zu bytes)",
@@ -260,8 +264,8 @@ status_t JpegProcessor::processNewCapture() {
         }
 
         // TODO: Optimize this to avoid memcopy
-        captureBuffer = new MemoryBase(mCaptureHeap, 0, jpegSize);
-        void* captureMemory = mCaptureHeap->getBase();
+        captureBuffer = new MemoryBase(captureHeap, 0, jpegSize);
+        void* captureMemory = captureHeap->getBase();
         memcpy(captureMemory, imgBuffer.data, jpegSize);
 
         mCaptureConsumer->unlockBuffer(imgBuffer);
@@ -275,6 +279,35 @@ status_t JpegProcessor::processNewCapture() {
     return OK;
 }
 
+sp<MemoryHeapBase> JpegProcessor::getCaptureHeapLocked() {
+    // Once the client and CaptureSequencer have released the MemoryBase of the previous
+    // capture, mCaptureHeaps holds the only reference to its heap
+    for (size_t i = 0; i < mCaptureHeaps.size(); i++) {
+        size_t idx = (mLastCaptureHeap + 1 + i) % mCaptureHeaps.size();
+        if (mCaptureHeaps[idx]->getStrongCount() == 1) {
+            mLastCaptureHeap = idx;
+            return mCaptureHeaps[idx];
+        }
+    }
+
+    if (mCaptureHeaps.size() < kMaxCaptureHeaps) {
+        sp<MemoryHeapBase> captureHeap = new MemoryHeapBase(mCaptureHeaps[0]->getSize(), 0,
+                "Camera2Client::CaptureHeap");
+        if (captureHeap->getSize() != 0) {
+            ALOGV("%s: Camera %d: Previous JPEG still in use, adding capture heap %zu",
+                    __FUNCTION__, mId, mCaptureHeaps.size());
+            mCaptureHeaps.push_back(captureHeap);
+            mLastCaptureHeap = mCaptureHeaps.size() - 1;
+            return captureHeap;
+        }
+    }
+
+    ALOGW("%s: Camera %d: All capture heaps are in use, overwriting the oldest JPEG",
+            __FUNCTION__, mId);
+    mLastCaptureHeap = (mLastCaptureHeap + 1) % mCaptureHeaps.size();
+    return mCaptureHeaps[mLastCaptureHeap];
+}
+
 /*
  * JPEG FILE FORMAT OVERVIEW.
  * http://www.jpeg.org/public/jfif.pdf
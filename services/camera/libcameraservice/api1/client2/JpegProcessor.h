@@ -71,11 +71,20 @@ class JpegProcessor:
     int mCaptureStreamId;
     sp<CpuConsumer>    mCaptureConsumer;
     sp<Surface>        mCaptureWindow;
-    sp<MemoryHeapBase> mCaptureHeap;
+
+    // Heaps the JPEGs are copied to for the client. A burst would overwrite a JPEG the
+    // client has not read yet if there were only one, so a second heap is allocated when
+    // a capture arrives while the first one is still referenced.
+    static const size_t kMaxCaptureHeaps = 2;
+    Vector<sp<MemoryHeapBase> > mCaptureHeaps;
+    size_t             mLastCaptureHeap;
 
     virtual bool threadLoop();
 
     status_t processNewCapture();
+    // Returns a capture heap no longer referenced by a previous capture if possible,
+    // otherwise the least recently used one. mInputMutex must be held.
+    sp<MemoryHeapBase> getCaptureHeapLocked();
     size_t findJpegSize(uint8_t* jpegBuffer, size_t maxSize);
 
 };
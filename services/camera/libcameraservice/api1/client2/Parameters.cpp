@@ -926,6 +926,38 @@ String8 Parameters::get() const {
     return paramsFlattened;
 }
 
+Parameters::StreamConfig Parameters::getStreamConfig() const {
+    StreamConfig config;
+    config.previewWidth = previewWidth;
+    config.previewHeight = previewHeight;
+    config.previewFormat = previewFormat;
+    config.pictureWidth = pictureWidth;
+    config.pictureHeight = pictureHeight;
+    config.videoWidth = videoWidth;
+    config.videoHeight = videoHeight;
+    config.recordingHint = recordingHint;
+    config.zslMode = zslMode;
+    config.slowJpegMode = slowJpegMode;
+    config.previewCallbackFlags = previewCallbackFlags;
+    config.previewCallbackSurface = previewCallbackSurface;
+    return config;
+}
+
+bool Parameters::StreamConfig::operator==(const StreamConfig &other) const {
+    return previewWidth == other.previewWidth &&
+            previewHeight == other.previewHeight &&
+            previewFormat == other.previewFormat &&
+            pictureWidth == other.pictureWidth &&
+            pictureHeight == other.pictureHeight &&
+            videoWidth == other.videoWidth &&
+            videoHeight == other.videoHeight &&
+            recordingHint == other.recordingHint &&
+            zslMode == other.zslMode &&
+            slowJpegMode == other.slowJpegMode &&
+            previewCallbackFlags == other.previewCallbackFlags &&
+            previewCallbackSurface == other.previewCallbackSurface;
+}
+
 status_t Parameters::buildFastInfo() {
 
     camera_metadata_ro_entry_t activeArraySize =
@@ -262,6 +262,23 @@ struct Parameters {
     // Retrieve the current settings
     String8 get() const;
 
+    // The settings that select the output streams. A set() that leaves them unchanged
+    // only needs the capture requests to be rebuilt, not the streams.
+    struct StreamConfig {
+        int previewWidth, previewHeight;
+        int previewFormat;
+        int pictureWidth, pictureHeight;
+        int videoWidth, videoHeight;
+        bool recordingHint;
+        bool zslMode;
+        bool slowJpegMode;
+        uint32_t previewCallbackFlags;
+        bool previewCallbackSurface;
+
+        bool operator==(const StreamConfig &other) const;
+    };
+    StreamConfig getStreamConfig() const;
+
     // Update passed-in request for common parameters
     status_t updateRequest(CameraMetadata *request) const;
 
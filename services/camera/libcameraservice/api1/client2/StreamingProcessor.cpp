@@ -589,6 +589,21 @@ status_t StreamingProcessor::startStream(StreamType type,
     return OK;
 }
 
+status_t StreamingProcessor::updateActiveStream() {
+    ATRACE_CALL();
+    StreamType type;
+    Vector<int32_t> outputStreams;
+    {
+        Mutex::Autolock m(mMutex);
+        if (mActiveRequest == NONE || mPaused) {
+            return INVALID_OPERATION;
+        }
+        type = mActiveRequest;
+        outputStreams = mActiveStreamIds;
+    }
+    return startStream(type, outputStreams);
+}
+
 status_t StreamingProcessor::togglePauseStream(bool pause) {
     ATRACE_CALL();
     status_t res;
@@ -71,6 +71,10 @@ class StreamingProcessor:
     status_t startStream(StreamType type,
             const Vector<int32_t> &outputStreams);
 
+    // Resubmit the active request, after updatePreviewRequest or updateRecordingRequest,
+    // to the streams it already targets. Returns INVALID_OPERATION if no request is active.
+    status_t updateActiveStream();
+
     // Toggle between paused and unpaused. Stream must be started first.
     status_t togglePauseStream(bool pause);
 
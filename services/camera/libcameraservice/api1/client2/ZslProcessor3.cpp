@@ -27,6 +27,7 @@
 
 #include <inttypes.h>
 
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include <gui/Surface.h>
@@ -184,7 +185,8 @@ status_t ZslProcessor3::updateStream(const Parameters &params) {
         // Note that format specified internally in Camera3ZslStream
         res = device->createZslStream(
                 params.fastInfo.arrayWidth, params.fastInfo.arrayHeight,
-                mBufferQueueDepth,
+                getBudgetedBufferQueueDepth(params.fastInfo.arrayWidth,
+                        params.fastInfo.arrayHeight),
                 &mZslStreamId,
                 &mZslStream);
         if (res != OK) {
@@ -438,6 +440,33 @@ status_t ZslProcessor3::clearZslQueue() {
     return clearZslQueueLocked();
 }
 
+size_t ZslProcessor3::getBudgetedBufferQueueDepth(uint32_t width, uint32_t height) const {
+    size_t depth = mBufferQueueDepth;
+    if (property_get_bool("ro.config.low_ram", false)) {
+        depth = kMinBufferQueueDepth;
+    } else {
+        const int64_t budgetBytes =
+                property_get_int64("ro.camera.zsl.max_memory_mb", 0) * 1024 * 1024;
+        // The ZSL format is implementation defined, assume it is YUV 4:2:0
+        const int64_t bufferBytes = (int64_t)width * height * 3 / 2;
+        if (budgetBytes > 0 && bufferBytes > 0 &&
+                (int64_t)depth * bufferBytes > budgetBytes) {
+            depth = budgetBytes / bufferBytes;
+        }
+    }
+    if (depth < kMinBufferQueueDepth) {
+        depth = kMinBufferQueueDepth;
+    }
+    if (depth > mBufferQueueDepth) {
+        depth = mBufferQueueDepth;
+    }
+    if (depth != mBufferQueueDepth) {
+        ALOGI("%s: Camera %d: ZSL ring of %ux%u buffers trimmed from %zu to %zu buffers",
+                __FUNCTION__, mId, width, height, mBufferQueueDepth, depth);
+    }
+    return depth;
+}
+
 status_t ZslProcessor3::clearZslQueueLocked() {
     if (mZslStream != 0) {
         // clear result metadata list first.
@@ -110,6 +110,8 @@ class ZslProcessor3 :
     };
 
     static const int32_t kDefaultMaxPipelineDepth = 4;
+    // Fewest buffers the ZSL ring is trimmed to by the memory budget
+    static const size_t kMinBufferQueueDepth = 2;
     size_t mBufferQueueDepth;
     size_t mFrameListDepth;
     Vector<CameraMetadata> mFrameList;
@@ -123,6 +125,10 @@ class ZslProcessor3 :
 
     CameraMetadata mLatestCapturedRequest;
 
+    // Returns mBufferQueueDepth, reduced so that the ring of width x height buffers fits in
+    // ro.camera.zsl.max_memory_mb, or to kMinBufferQueueDepth on low RAM devices.
+    size_t getBudgetedBufferQueueDepth(uint32_t width, uint32_t height) const;
+
     bool mHasFocuser;
 
     virtual bool threadLoop();
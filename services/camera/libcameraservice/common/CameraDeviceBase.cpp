@@ -27,4 +27,7 @@ CameraDeviceBase::~CameraDeviceBase() {
 CameraDeviceBase::NotificationListener::~NotificationListener() {
 }
 
+void CameraDeviceBase::traceResultDelivered(int64_t /*frameNumber*/) {
+}
+
 } // namespace android
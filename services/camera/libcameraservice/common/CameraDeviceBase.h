@@ -303,6 +303,12 @@ class CameraDeviceBase : public virtual RefBase {
      * Get the HAL device version.
      */
     virtual uint32_t getDeviceVersion() = 0;
+
+    /**
+     * Record that the final result of frameNumber was delivered to the result listeners,
+     * in the device's event trace. Does nothing by default.
+     */
+    virtual void traceResultDelivered(int64_t frameNumber);
 };
 
 }; // namespace android
@@ -222,6 +222,9 @@ status_t FrameProcessorBase::processListeners(const CaptureResult &result,
     for (; item != listeners.end(); item++) {
         (*item)->onResultAvailable(result);
     }
+    if (!isPartialResult) {
+        device->traceResultDelivered(result.mResultExtras.frameNumber);
+    }
     return OK;
 }
 
@@ -39,12 +39,15 @@
 
 #include <inttypes.h>
 
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include <utils/Timers.h>
+#include <media/stagefright/foundation/ACpuAccounting.h>
 
 #include "CameraService.h"
 #include "utils/CameraTraces.h"
+#include "mediautils/MediaSchedulingPolicy.h"
 #include "mediautils/SchedulingPolicyService.h"
 #include "device3/Camera3Device.h"
 #include "device3/Camera3OutputStream.h"
@@ -69,7 +72,8 @@ Camera3Device::Camera3Device(int id):
         mNextReprocessResultFrameNumber(0),
         mNextShutterFrameNumber(0),
         mNextReprocessShutterFrameNumber(0),
-        mListener(NULL)
+        mListener(NULL),
+        mEventTrace(new CameraEventTrace())
 {
     ATRACE_CALL();
     camera3_callback_ops::notify = &sNotify;
@@ -178,7 +182,8 @@ status_t Camera3Device::initialize(CameraModule *module)
     }
 
     /** Start up request queue thread */
-    mRequestThread = new RequestThread(this, mStatusTracker, device, aeLockAvailable);
+    mRequestThread = new RequestThread(this, mStatusTracker, device, aeLockAvailable,
+            mEventTrace);
     res = mRequestThread->run(String8::format("C3Dev-%d-ReqQueue", mId).string());
     if (res != OK) {
         SET_ERR_L("Unable to start request queue thread: %s (%d)",
@@ -187,6 +192,8 @@ status_t Camera3Device::initialize(CameraModule *module)
         mRequestThread.clear();
         return res;
     }
+    MediaSchedulingPolicy::getInstance().registerThread(mRequestThread->getTid(),
+            MEDIA_LATENCY_CLASS_VIDEO_FRAME, "Camera3RequestThread");
 
     mPreparerThread = new PreparerThread();
 
@@ -268,6 +275,7 @@ status_t Camera3Device::disconnect() {
         }
 
         if (mRequestThread != NULL) {
+            MediaSchedulingPolicy::getInstance().unregisterThread(mRequestThread->getTid());
             mRequestThread->requestExit();
         }
 
@@ -474,8 +482,8 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
     if (mInFlightMap.size() == 0) {
         lines.append("      None\n");
     } else {
-        for (size_t i = 0; i < mInFlightMap.size(); i++) {
-            InFlightRequest r = mInFlightMap.valueAt(i);
+        for (ssize_t i = mInFlightMap.nextIndex(-1); i >= 0; i = mInFlightMap.nextIndex(i)) {
+            const InFlightRequest &r = mInFlightMap.valueAt(i);
             lines.appendFormat("      Frame %d |  Timestamp: %" PRId64 ", metadata"
                     " arrived: %s, buffers left: %d\n", mInFlightMap.keyAt(i),
                     r.shutterTimestamp, r.haveResultMetadata ? "true" : "false",
@@ -484,6 +492,8 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
     }
     write(fd, lines.string(), lines.size());
 
+    mEventTrace->dump(fd, /*indent*/4);
+
     {
         lines = String8("    Last request sent:\n");
         write(fd, lines.string(), lines.size());
@@ -1061,6 +1071,7 @@ status_t Camera3Device::deleteStream(int id) {
     if (outputStreamIdx != NAME_NOT_FOUND) {
         deletedStream = mOutputStreams.editValueAt(outputStreamIdx);
         mOutputStreams.removeItem(id);
+        mPreparerThread->cancelSpeculativePrepare(deletedStream);
     }
 
     // Free up the stream endpoint so that it can be used by some other stream
@@ -1338,6 +1349,10 @@ status_t Camera3Device::getNextResult(CaptureResult *frame) {
     return OK;
 }
 
+void Camera3Device::traceResultDelivered(int64_t frameNumber) {
+    mEventTrace->record(CameraEventTrace::RESULT_DELIVERED, frameNumber);
+}
+
 status_t Camera3Device::triggerAutofocus(uint32_t id) {
     ATRACE_CALL();
     Mutex::Autolock il(mInterfaceLock);
@@ -1456,6 +1471,11 @@ status_t Camera3Device::prepare(int maxCount, int streamId) {
 
     stream = mOutputStreams.editValueAt(outputStreamIdx);
 
+    if (mPreparerThread->adoptSpeculativePrepare(stream)) {
+        ALOGV("%s: Camera %d: Stream %d already being prepared", __FUNCTION__, mId, streamId);
+        return OK;
+    }
+
     if (stream->isUnpreparable() || stream->hasOutstandingBuffers() ) {
         CLOGE("Stream %d has already been a request target", streamId);
         return BAD_VALUE;
@@ -1491,6 +1511,7 @@ status_t Camera3Device::tearDown(int streamId) {
     }
 
     stream = mOutputStreams.editValueAt(outputStreamIdx);
+    mPreparerThread->cancelSpeculativePrepare(stream);
 
     if (stream->hasOutstandingBuffers() || mRequestThread->isStreamPending(stream)) {
         CLOGE("Stream %d is a target of a in-progress request", streamId);
@@ -1647,6 +1668,9 @@ status_t Camera3Device::configureStreamsLocked() {
         return OK;
     }
 
+    // Streams can't be reconfigured while they are being prepared
+    mPreparerThread->cancelSpeculativePrepare(NULL);
+
     // Workaround for device HALv3.2 or older spec bug - zero streams requires
     // adding a dummy stream instead.
     // TODO: Bug: 17321404 for fixing the HAL spec and removing this workaround.
@@ -1803,6 +1827,23 @@ status_t Camera3Device::configureStreamsLocked() {
     // tear down the deleted streams after configure streams.
     mDeletedStreams.clear();
 
+    // Preview streams are used by the first request right away, but the first still capture
+    // or recording would wait for its buffers to be allocated: allocate them in the
+    // background while preview starts.
+    if (property_get_bool("ro.camera.speculative_prepare", false)) {
+        for (size_t i = 0; i < mOutputStreams.size(); i++) {
+            sp<Camera3OutputStreamInterface> outputStream = mOutputStreams.editValueAt(i);
+            if (outputStream->getFormat() != HAL_PIXEL_FORMAT_BLOB &&
+                    !outputStream->isVideoStream()) {
+                continue;
+            }
+            sp<Camera3StreamInterface> stream = outputStream;
+            if (!stream->isUnpreparable() && !stream->hasOutstandingBuffers()) {
+                mPreparerThread->prepareSpeculatively(stream);
+            }
+        }
+    }
+
     return OK;
 }
 
@@ -1921,6 +1962,100 @@ void Camera3Device::setErrorStateLockedV(const char *fmt, va_list args) {
  * In-flight request management
  */
 
+Camera3Device::InFlightMap::InFlightMap() :
+        mSize(0) {
+    for (size_t i = 0; i < kRingSize; i++) {
+        mRingFrameNumbers[i] = 0;
+        mRingUsed[i] = false;
+    }
+}
+
+ssize_t Camera3Device::InFlightMap::add(uint32_t frameNumber, const InFlightRequest &request) {
+    const size_t slot = frameNumber & (kRingSize - 1);
+    if (mRingUsed[slot] && mRingFrameNumbers[slot] != frameNumber) {
+        ssize_t idx = mOverflow.indexOfKey(frameNumber);
+        if (idx < 0) {
+            mSize++;
+        }
+        idx = mOverflow.add(frameNumber, request);
+        return idx < 0 ? idx : (ssize_t)kRingSize + idx;
+    }
+    if (!mRingUsed[slot]) {
+        mRingUsed[slot] = true;
+        mRingFrameNumbers[slot] = frameNumber;
+        mSize++;
+    }
+    mRing[slot] = request;
+    return slot;
+}
+
+ssize_t Camera3Device::InFlightMap::indexOfKey(uint32_t frameNumber) const {
+    const size_t slot = frameNumber & (kRingSize - 1);
+    if (mRingUsed[slot] && mRingFrameNumbers[slot] == frameNumber) {
+        return slot;
+    }
+    if (mOverflow.isEmpty()) {
+        return NAME_NOT_FOUND;
+    }
+    ssize_t idx = mOverflow.indexOfKey(frameNumber);
+    return idx < 0 ? idx : (ssize_t)kRingSize + idx;
+}
+
+const Camera3Device::InFlightRequest& Camera3Device::InFlightMap::valueAt(ssize_t idx) const {
+    if ((size_t)idx < kRingSize) {
+        return mRing[idx];
+    }
+    return mOverflow.valueAt(idx - kRingSize);
+}
+
+Camera3Device::InFlightRequest& Camera3Device::InFlightMap::editValueAt(ssize_t idx) {
+    if ((size_t)idx < kRingSize) {
+        return mRing[idx];
+    }
+    return mOverflow.editValueAt(idx - kRingSize);
+}
+
+uint32_t Camera3Device::InFlightMap::keyAt(ssize_t idx) const {
+    if ((size_t)idx < kRingSize) {
+        return mRingFrameNumbers[idx];
+    }
+    return mOverflow.keyAt(idx - kRingSize);
+}
+
+void Camera3Device::InFlightMap::removeAt(ssize_t idx) {
+    if ((size_t)idx < kRingSize) {
+        // release the metadata and buffers now rather than when the slot is reused
+        mRing[idx] = InFlightRequest();
+        mRingUsed[idx] = false;
+        mSize--;
+        // a stalled request that took the slot of a newer one can now move back to the ring
+        if (!mOverflow.isEmpty()) {
+            for (size_t i = 0; i < mOverflow.size(); i++) {
+                if ((mOverflow.keyAt(i) & (kRingSize - 1)) == (size_t)idx) {
+                    mRing[idx] = mOverflow.valueAt(i);
+                    mRingFrameNumbers[idx] = mOverflow.keyAt(i);
+                    mRingUsed[idx] = true;
+                    mOverflow.removeItemsAt(i, 1);
+                    break;
+                }
+            }
+        }
+        return;
+    }
+    mOverflow.removeItemsAt(idx - kRingSize, 1);
+    mSize--;
+}
+
+ssize_t Camera3Device::InFlightMap::nextIndex(ssize_t idx) const {
+    for (size_t i = idx + 1; i < kRingSize; i++) {
+        if (mRingUsed[i]) {
+            return i;
+        }
+    }
+    size_t next = idx + 1 > (ssize_t)kRingSize ? idx + 1 : kRingSize;
+    return next < kRingSize + mOverflow.size() ? (ssize_t)next : -1;
+}
+
 status_t Camera3Device::registerInFlight(uint32_t frameNumber,
         int32_t numBuffers, CaptureResultExtras resultExtras, bool hasInput,
         const AeTriggerCancelOverride_t &aeTriggerCancelOverride) {
@@ -1997,13 +2132,14 @@ bool Camera3Device::processPartial3AResult(
 
     Mutex::Autolock l(mOutputLock);
 
-    CaptureResult captureResult;
-    captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = CameraMetadata(kMinimal3AResultEntries, /*dataCapacity*/ 0);
     // TODO: change this to sp<CaptureResult>. This will need other changes, including,
     // but not limited to CameraDeviceBase::getNextResult
+    // The result is built in place, copying a CaptureResult clones its metadata.
     CaptureResult& min3AResult =
-            *mResultQueue.insert(mResultQueue.end(), captureResult);
+            *mResultQueue.insert(mResultQueue.end(), CaptureResult());
+    min3AResult.mResultExtras = resultExtras;
+    min3AResult.mMetadata.acquire(
+            allocate_camera_metadata(kMinimal3AResultEntries, /*dataCapacity*/ 0));
 
     if (!insert3AResult(min3AResult.mMetadata, ANDROID_REQUEST_FRAME_COUNT,
             // TODO: This is problematic casting. Need to fix CameraMetadata.
@@ -2156,7 +2292,7 @@ void Camera3Device::removeInFlightRequestIfReadyLocked(int idx) {
         returnOutputBuffers(request.pendingOutputBuffers.array(),
             request.pendingOutputBuffers.size(), 0);
 
-        mInFlightMap.removeItemsAt(idx, 1);
+        mInFlightMap.removeAt(idx);
 
         ALOGVV("%s: removed frame %d from InFlightMap", __FUNCTION__, frameNumber);
      }
@@ -2205,7 +2341,7 @@ void Camera3Device::sendCaptureResult(CameraMetadata &pendingMetadata,
 
     CaptureResult captureResult;
     captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = pendingMetadata;
+    captureResult.mMetadata.acquire(pendingMetadata);
 
     if (captureResult.mMetadata.update(ANDROID_REQUEST_FRAME_COUNT,
             (int32_t*)&frameNumber, 1) != OK) {
@@ -2235,9 +2371,11 @@ void Camera3Device::sendCaptureResult(CameraMetadata &pendingMetadata,
 
     overrideResultForPrecaptureCancel(&captureResult.mMetadata, aeTriggerCancelOverride);
 
-    // Valid result, insert into queue
+    // Valid result, move it into the queue
     List<CaptureResult>::iterator queuedResult =
-            mResultQueue.insert(mResultQueue.end(), CaptureResult(captureResult));
+            mResultQueue.insert(mResultQueue.end(), CaptureResult());
+    queuedResult->mResultExtras = captureResult.mResultExtras;
+    queuedResult->mMetadata.acquire(captureResult.mMetadata);
     ALOGVV("%s: result requestId = %" PRId32 ", frameNumber = %" PRId64
            ", burstId = %" PRId32, __FUNCTION__,
            queuedResult->mResultExtras.requestId,
@@ -2368,6 +2506,7 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
                     request.partialResult.collectedResult);
             }
             request.haveResultMetadata = true;
+            mEventTrace->record(CameraEventTrace::HAL_RESULT, frameNumber);
         }
 
         uint32_t numBuffersReturned = result->num_output_buffers;
@@ -2394,6 +2533,13 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
             request.sensorTimestamp = entry.data.i64[0];
         }
 
+        for (uint32_t i = 0; i < result->num_output_buffers; i++) {
+            const camera3_stream_buffer_t &buffer = result->output_buffers[i];
+            mEventTrace->record(CameraEventTrace::BUFFER_RETURN, frameNumber,
+                    Camera3Stream::cast(buffer.stream)->getId(),
+                    buffer.status == CAMERA3_BUFFER_STATUS_ERROR ? 1 : 0);
+        }
+
         // If shutter event isn't received yet, append the output buffers to
         // the in-flight request. Otherwise, return the output buffers to
         // streams.
@@ -2408,7 +2554,7 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
         if (result->result != NULL && !isPartialResult) {
             if (shutterTimestamp == 0) {
                 request.pendingMetadata = result->result;
-                request.partialResult.collectedResult = collectedPartialResult;
+                request.partialResult.collectedResult.acquire(collectedPartialResult);
             } else {
                 CameraMetadata metadata;
                 metadata = result->result;
@@ -2584,6 +2730,7 @@ void Camera3Device::notifyShutter(const camera3_shutter_msg_t &msg,
             }
 
             r.shutterTimestamp = msg.timestamp;
+            mEventTrace->record(CameraEventTrace::SHUTTER, msg.frame_number);
 
             // send pending result and buffers
             sendCaptureResult(r.pendingMetadata, r.resultExtras,
@@ -2623,11 +2770,13 @@ CameraMetadata Camera3Device::getLatestRequestLocked() {
 Camera3Device::RequestThread::RequestThread(wp<Camera3Device> parent,
         sp<StatusTracker> statusTracker,
         camera3_device_t *hal3Device,
-        bool aeLockAvailable) :
+        bool aeLockAvailable,
+        sp<CameraEventTrace> eventTrace) :
         Thread(/*canCallJava*/false),
         mParent(parent),
         mStatusTracker(statusTracker),
         mHal3Device(hal3Device),
+        mEventTrace(eventTrace),
         mId(getId(parent)),
         mReconfigured(false),
         mDoPause(false),
@@ -2637,10 +2786,16 @@ Camera3Device::RequestThread::RequestThread(wp<Camera3Device> parent,
         mCurrentAfTriggerId(0),
         mCurrentPreCaptureTriggerId(0),
         mRepeatingLastFrameNumber(NO_IN_FLIGHT_REPEATING_FRAMES),
-        mAeLockAvailable(aeLockAvailable) {
+        mAeLockAvailable(aeLockAvailable),
+        mCpuAccountingEnabled(ACpuAccounting::isEnabled()),
+        mCpuAccounting(NULL) {
     mStatusId = statusTracker->addComponent();
 }
 
+Camera3Device::RequestThread::~RequestThread() {
+    delete mCpuAccounting;
+}
+
 void Camera3Device::RequestThread::setNotificationListener(
         NotificationListener *listener) {
     Mutex::Autolock l(mRequestLock);
@@ -2919,6 +3074,12 @@ bool Camera3Device::RequestThread::threadLoop() {
     ATRACE_CALL();
     status_t res;
 
+    if (mCpuAccounting != NULL) {
+        mCpuAccounting->update();
+    } else if (mCpuAccountingEnabled) {
+        mCpuAccounting = new ACpuAccounting("Camera3RequestThread");
+    }
+
     // Handle paused state.
     if (waitIfPaused()) {
         return true;
@@ -2973,12 +3134,25 @@ bool Camera3Device::RequestThread::threadLoop() {
         mFlushLock.lock();
     }
 
+    // Only the settings of the last request of the batch that has some need to be kept as the
+    // latest request, so that a batch clones them once.
+    ssize_t latestSettingsIdx = -1;
+    for (size_t i = 0; i < mNextRequests.size(); i++) {
+        if (mNextRequests[i].halRequest.settings != NULL) {
+            latestSettingsIdx = i;
+        }
+    }
+
     ALOGVV("%s: %d: submitting %d requests in a batch.", __FUNCTION__, __LINE__,
             mNextRequests.size());
-    for (auto& nextRequest : mNextRequests) {
+    for (size_t i = 0; i < mNextRequests.size(); i++) {
+        NextRequest& nextRequest = mNextRequests.editItemAt(i);
         // Submit request and block until ready for next one
         ATRACE_ASYNC_BEGIN("frame capture", nextRequest.halRequest.frame_number);
         ATRACE_BEGIN("camera3->process_capture_request");
+        // before the call, the HAL may return results before it returns
+        mEventTrace->record(CameraEventTrace::REQUEST_SUBMIT,
+                nextRequest.halRequest.frame_number);
         res = mHal3Device->ops->process_capture_request(mHal3Device, &nextRequest.halRequest);
         ATRACE_END();
 
@@ -3000,7 +3174,7 @@ bool Camera3Device::RequestThread::threadLoop() {
         nextRequest.submitted = true;
 
         // Update the latest request sent to HAL
-        if (nextRequest.halRequest.settings != NULL) { // Don't update if they were unchanged
+        if ((ssize_t)i == latestSettingsIdx) { // Don't update if they were unchanged
             Mutex::Autolock al(mLatestRequestMutex);
 
             camera_metadata_t* cloned = clone_camera_metadata(nextRequest.halRequest.settings);
@@ -3041,6 +3215,16 @@ bool Camera3Device::RequestThread::threadLoop() {
 status_t Camera3Device::RequestThread::prepareHalRequests() {
     ATRACE_CALL();
 
+    sp<Camera3Device> parent = mParent.promote();
+    if (parent == NULL) {
+        // Should not happen, and nowhere to send errors to, so just log it
+        CLOGE("RequestThread: Parent is gone");
+        return INVALID_OPERATION;
+    }
+
+    // Settings given to the HAL by the previous request of this batch, still locked
+    const camera_metadata_t* batchSettings = NULL;
+
     for (auto& nextRequest : mNextRequests) {
         sp<CaptureRequest> captureRequest = nextRequest.captureRequest;
         camera3_capture_request_t* halRequest = &nextRequest.halRequest;
@@ -3083,7 +3267,19 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
             captureRequest->mSettings.sort();
             halRequest->settings = captureRequest->mSettings.getAndLock();
             mPrevRequest = captureRequest;
-            ALOGVV("%s: Request settings are NEW", __FUNCTION__);
+
+            // The requests of a high speed batch are distinct, but usually identical:
+            // let the HAL reuse the settings instead of parsing the same ones again.
+            if (!triggersMixedIn && batchSettings != NULL &&
+                    isSameMetadata(batchSettings, halRequest->settings)) {
+                captureRequest->mSettings.unlock(halRequest->settings);
+                halRequest->settings = NULL;
+                ALOGVV("%s: Request settings are the same as the previous request",
+                        __FUNCTION__);
+            } else {
+                batchSettings = halRequest->settings;
+                ALOGVV("%s: Request settings are NEW", __FUNCTION__);
+            }
 
             IF_ALOGV() {
                 camera_metadata_ro_entry_t e = camera_metadata_ro_entry_t();
@@ -3119,8 +3315,14 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
                 captureRequest->mOutputStreams.size());
         halRequest->output_buffers = outputBuffers->array();
         for (size_t i = 0; i < captureRequest->mOutputStreams.size(); i++) {
-            res = captureRequest->mOutputStreams.editItemAt(i)->
-                    getBuffer(&outputBuffers->editItemAt(i));
+            sp<Camera3OutputStreamInterface> outputStream =
+                    captureRequest->mOutputStreams.editItemAt(i);
+            if (outputStream->isPreparing()) {
+                // Whatever was allocated so far stays in the stream's queue
+                parent->mPreparerThread->cancelSpeculativePrepare(outputStream);
+            }
+            nsecs_t waitStartNs = systemTime();
+            res = outputStream->getBuffer(&outputBuffers->editItemAt(i));
             if (res != OK) {
                 // Can't get output buffer from gralloc queue - this could be due to
                 // abandoned queue or other consumer misbehavior, so not a fatal
@@ -3130,17 +3332,13 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
 
                 return TIMED_OUT;
             }
+            mEventTrace->record(CameraEventTrace::CONSUMER_RELEASE, halRequest->frame_number,
+                    outputStream->getId(), ns2us(systemTime() - waitStartNs));
             halRequest->num_output_buffers++;
         }
         totalNumBuffers += halRequest->num_output_buffers;
 
         // Log request in the in-flight queue
-        sp<Camera3Device> parent = mParent.promote();
-        if (parent == NULL) {
-            // Should not happen, and nowhere to send errors to, so just log it
-            CLOGE("RequestThread: Parent is gone");
-            return INVALID_OPERATION;
-        }
         res = parent->registerInFlight(halRequest->frame_number,
                 totalNumBuffers, captureRequest->mResultExtras,
                 /*hasInput*/halRequest->input_buffer != NULL,
@@ -3160,6 +3358,31 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
     return OK;
 }
 
+bool Camera3Device::RequestThread::isSameMetadata(const camera_metadata_t* a,
+        const camera_metadata_t* b) {
+    if (a == b) {
+        return true;
+    }
+    const size_t size = get_camera_metadata_compact_size(a);
+    if (get_camera_metadata_compact_size(b) != size ||
+            get_camera_metadata_entry_count(a) != get_camera_metadata_entry_count(b) ||
+            get_camera_metadata_data_count(a) != get_camera_metadata_data_count(b)) {
+        return false;
+    }
+    // Entries are sorted, so equal settings compare equal entry by entry
+    for (size_t i = 0; i < get_camera_metadata_entry_count(a); i++) {
+        camera_metadata_ro_entry_t ea, eb;
+        if (get_camera_metadata_ro_entry(a, i, &ea) != OK ||
+                get_camera_metadata_ro_entry(b, i, &eb) != OK ||
+                ea.tag != eb.tag || ea.type != eb.type || ea.count != eb.count ||
+                memcmp(ea.data.u8, eb.data.u8,
+                        ea.count * camera_metadata_type_size[ea.type]) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 CameraMetadata Camera3Device::RequestThread::getLatestRequest() const {
     Mutex::Autolock al(mLatestRequestMutex);
 
@@ -3646,15 +3869,62 @@ Camera3Device::PreparerThread::~PreparerThread() {
 }
 
 status_t Camera3Device::PreparerThread::prepare(int maxCount, sp<Camera3StreamInterface>& stream) {
-    status_t res;
+    Mutex::Autolock l(mLock);
+    return prepareLocked(maxCount, stream, /*speculative*/false);
+}
+
+status_t Camera3Device::PreparerThread::prepareSpeculatively(
+        sp<Camera3StreamInterface>& stream) {
+    Mutex::Autolock l(mLock);
+    return prepareLocked(Camera3StreamInterface::ALLOCATE_PIPELINE_MAX, stream,
+            /*speculative*/true);
+}
+
+bool Camera3Device::PreparerThread::adoptSpeculativePrepare(
+        const sp<Camera3StreamInterface>& stream) {
+    Mutex::Autolock l(mLock);
+    return mSpeculativeStreams.remove(stream->getId()) >= 0;
+}
 
+void Camera3Device::PreparerThread::cancelSpeculativePrepare(
+        const sp<Camera3StreamInterface>& stream) {
     Mutex::Autolock l(mLock);
+    if (mSpeculativeStreams.isEmpty()) {
+        return;
+    }
+
+    for (auto it = mPendingStreams.begin(); it != mPendingStreams.end(); ) {
+        const int id = (*it)->getId();
+        if ((stream == nullptr || *it == stream) && mSpeculativeStreams.indexOf(id) >= 0) {
+            ALOGV("%s: Cancelling speculative prepare of pending stream %d", __FUNCTION__, id);
+            (*it)->cancelPrepare();
+            mSpeculativeStreams.remove(id);
+            it = mPendingStreams.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // The current stream stays in mSpeculativeStreams so that threadLoop() doesn't notify
+    // the listener when prepareNextBuffer() fails
+    if (mCurrentStream != nullptr && (stream == nullptr || mCurrentStream == stream) &&
+            mSpeculativeStreams.indexOf(mCurrentStream->getId()) >= 0 &&
+            mCurrentStream->isPreparing()) {
+        ALOGV("%s: Cancelling speculative prepare of stream %d", __FUNCTION__,
+                mCurrentStream->getId());
+        mCurrentStream->cancelPrepare();
+    }
+}
+
+status_t Camera3Device::PreparerThread::prepareLocked(int maxCount,
+        sp<Camera3StreamInterface>& stream, bool speculative) {
+    status_t res;
 
     res = stream->startPrepare(maxCount);
     if (res == OK) {
         // No preparation needed, fire listener right off
         ALOGV("%s: Stream %d already prepared", __FUNCTION__, stream->getId());
-        if (mListener) {
+        if (mListener && !speculative) {
             mListener->notifyPrepared(stream->getId());
         }
         return OK;
@@ -3670,7 +3940,8 @@ status_t Camera3Device::PreparerThread::prepare(int maxCount, sp<Camera3StreamIn
         res = Thread::run("C3PrepThread", PRIORITY_BACKGROUND);
         if (res != OK) {
             ALOGE("%s: Unable to start preparer stream: %d (%s)", __FUNCTION__, res, strerror(-res));
-            if (mListener) {
+            stream->cancelPrepare();
+            if (mListener && !speculative) {
                 mListener->notifyPrepared(stream->getId());
             }
             return res;
@@ -3682,7 +3953,11 @@ status_t Camera3Device::PreparerThread::prepare(int maxCount, sp<Camera3StreamIn
 
     // queue up the work
     mPendingStreams.push_back(stream);
-    ALOGV("%s: Stream %d queued for preparing", __FUNCTION__, stream->getId());
+    if (speculative) {
+        mSpeculativeStreams.add(stream->getId());
+    }
+    ALOGV("%s: Stream %d queued for %spreparing", __FUNCTION__, stream->getId(),
+            speculative ? "speculative " : "");
 
     return OK;
 }
@@ -3696,6 +3971,7 @@ status_t Camera3Device::PreparerThread::clear() {
         stream->cancelPrepare();
     }
     mPendingStreams.clear();
+    mSpeculativeStreams.clear();
     mCancelNow = true;
 
     return OK;
@@ -3738,7 +4014,12 @@ bool Camera3Device::PreparerThread::threadLoop() {
 
     res = mCurrentStream->prepareNextBuffer();
     if (res == NOT_ENOUGH_DATA) return true;
-    if (res != OK) {
+
+    Mutex::Autolock l(mLock);
+    // A speculative prepare cancelled by cancelSpeculativePrepare() fails, and nobody is waiting
+    // for it
+    const bool speculative = mSpeculativeStreams.remove(mCurrentStream->getId()) >= 0;
+    if (res != OK && (!speculative || mCurrentStream->isPreparing())) {
         // Something bad happened; try to recover by cancelling prepare and
         // signalling listener anyway
         ALOGE("%s: Stream %d returned error %d (%s) during prepare", __FUNCTION__,
@@ -3747,8 +4028,7 @@ bool Camera3Device::PreparerThread::threadLoop() {
     }
 
     // This stream has finished, notify listener
-    Mutex::Autolock l(mLock);
-    if (mListener) {
+    if (mListener && !speculative) {
         ALOGV("%s: Stream %d prepare done, signaling listener", __FUNCTION__,
                 mCurrentStream->getId());
         mListener->notifyPrepared(mCurrentStream->getId());
@@ -29,6 +29,7 @@
 
 #include "common/CameraDeviceBase.h"
 #include "device3/StatusTracker.h"
+#include "utils/CameraTraces.h"
 
 /**
  * Function pointer types with C calling convention to
@@ -46,6 +47,8 @@ extern "C" {
 
 namespace android {
 
+struct ACpuAccounting;
+
 namespace camera3 {
 
 class Camera3Stream;
@@ -130,6 +133,7 @@ class Camera3Device :
     virtual bool     willNotify3A();
     virtual status_t waitForNextFrame(nsecs_t timeout);
     virtual status_t getNextResult(CaptureResult *frame);
+    virtual void     traceResultDelivered(int64_t frameNumber);
 
     virtual status_t triggerAutofocus(uint32_t id);
     virtual status_t triggerCancelAutofocus(uint32_t id);
@@ -416,7 +420,9 @@ class Camera3Device :
         RequestThread(wp<Camera3Device> parent,
                 sp<camera3::StatusTracker> statusTracker,
                 camera3_device_t *hal3Device,
-                bool aeLockAvailable);
+                bool aeLockAvailable,
+                sp<camera3::CameraEventTrace> eventTrace);
+        virtual ~RequestThread();
 
         void     setNotificationListener(NotificationListener *listener);
 
@@ -533,6 +539,9 @@ class Camera3Device :
         // request batch.
         status_t prepareHalRequests();
 
+        // Whether two sorted settings buffers hold the same entries
+        static bool isSameMetadata(const camera_metadata_t* a, const camera_metadata_t* b);
+
         // Return buffers, etc, for requests in mNextRequests that couldn't be fully constructed and
         // send request errors if sendRequestError is true. The buffers will be returned in the
         // ERROR state to mark them as not having valid data. mNextRequests will be cleared.
@@ -554,6 +563,7 @@ class Camera3Device :
         wp<Camera3Device>  mParent;
         wp<camera3::StatusTracker>  mStatusTracker;
         camera3_device_t  *mHal3Device;
+        sp<camera3::CameraEventTrace> mEventTrace;
 
         NotificationListener *mListener;
 
@@ -605,6 +615,10 @@ class Camera3Device :
 
         // Whether the device supports AE lock
         bool               mAeLockAvailable;
+
+        // Created by the thread itself if CPU accounting is enabled
+        bool               mCpuAccountingEnabled;
+        ACpuAccounting    *mCpuAccounting;
     };
     sp<RequestThread> mRequestThread;
 
@@ -680,8 +694,40 @@ class Camera3Device :
         }
     };
 
-    // Map from frame number to the in-flight request state
-    typedef KeyedVector<uint32_t, InFlightRequest> InFlightMap;
+    // Map from frame number to the in-flight request state.
+    // Frame numbers are consecutive, so requests are stored in a ring indexed by frame
+    // number and found, added and removed in constant time, without moving the other
+    // requests and their metadata around. Only a request whose slot is still taken by an
+    // older one, stalled in the HAL, goes to a sorted overflow map.
+    class InFlightMap {
+      public:
+        InFlightMap();
+
+        // Adds, or replaces, the request of frameNumber and returns its index
+        ssize_t add(uint32_t frameNumber, const InFlightRequest &request);
+        // Returns the index of the request of frameNumber, or NAME_NOT_FOUND
+        ssize_t indexOfKey(uint32_t frameNumber) const;
+
+        const InFlightRequest& valueAt(ssize_t idx) const;
+        InFlightRequest& editValueAt(ssize_t idx);
+        uint32_t keyAt(ssize_t idx) const;
+        // Invalidates the index of the requests in the overflow map
+        void removeAt(ssize_t idx);
+
+        size_t size() const { return mSize; }
+        // Returns the index of the request following idx, in no particular order, or -1
+        // after the last one. idx is -1 to get the first request.
+        ssize_t nextIndex(ssize_t idx) const;
+
+      private:
+        static const size_t kRingSize = 256; // power of 2, see kInFlightWarnLimitHighSpeed
+
+        InFlightRequest mRing[kRingSize];
+        uint32_t        mRingFrameNumbers[kRingSize];
+        bool            mRingUsed[kRingSize];
+        KeyedVector<uint32_t, InFlightRequest> mOverflow;
+        size_t          mSize;
+    };
 
     Mutex                  mInFlightLock; // Protects mInFlightMap
     InFlightMap            mInFlightMap;
@@ -736,6 +782,25 @@ class Camera3Device :
          */
         status_t prepare(int maxCount, sp<camera3::Camera3StreamInterface>& stream);
 
+        /**
+         * Queue up a stream to be fully prepared without notifying the listener, so that its
+         * buffers are allocated before its first request. Any use of the stream must first
+         * cancel it with cancelSpeculativePrepare().
+         */
+        status_t prepareSpeculatively(sp<camera3::Camera3StreamInterface>& stream);
+
+        /**
+         * If the stream is being prepared speculatively, notify the listener when it is done as
+         * if prepare() had been called instead, and return true.
+         */
+        bool adoptSpeculativePrepare(const sp<camera3::Camera3StreamInterface>& stream);
+
+        /**
+         * Cancel the speculative preparation of the stream, or of all streams if stream is
+         * NULL, so that it can be used right away. Requested preparations are not cancelled.
+         */
+        void cancelSpeculativePrepare(const sp<camera3::Camera3StreamInterface>& stream);
+
         /**
          * Cancel all current and pending stream preparation
          */
@@ -746,19 +811,28 @@ class Camera3Device :
 
         virtual bool threadLoop();
 
+        status_t prepareLocked(int maxCount, sp<camera3::Camera3StreamInterface>& stream,
+                bool speculative);
+
         // Guarded by mLock
 
         NotificationListener *mListener;
         List<sp<camera3::Camera3StreamInterface> > mPendingStreams;
+        // IDs of the pending or current streams prepared by prepareSpeculatively()
+        SortedVector<int> mSpeculativeStreams;
         bool mActive;
         bool mCancelNow;
 
-        // Only accessed by threadLoop and the destructor
+        // Only used by threadLoop and the destructor, but only changed with mLock held so
+        // that cancelSpeculativePrepare() can read it
 
         sp<camera3::Camera3StreamInterface> mCurrentStream;
     };
     sp<PreparerThread> mPreparerThread;
 
+    // Capture pipeline events, shared with the request thread
+    sp<camera3::CameraEventTrace> mEventTrace;
+
     /**
      * Output result queue and current HAL device 3A state
      */
@@ -800,6 +874,7 @@ class Camera3Device :
 
     // Insert the capture result given the pending metadata, result extras,
     // partial results, and the frame number to the result queue.
+    // The pending metadata is moved into the queued result, not copied.
     void sendCaptureResult(CameraMetadata &pendingMetadata,
             CaptureResultExtras &resultExtras,
             CameraMetadata &collectedPartialResult, uint32_t frameNumber,
@@ -21,12 +21,16 @@
 #include "utils/CameraTraces.h"
 #include <utils/ProcessCallStack.h>
 
+#include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
 #include <utils/List.h>
+#include <utils/Timers.h>
 
 #include <utils/Log.h>
 #include <cutils/trace.h>
 
+#include <unistd.h>
+
 namespace android {
 namespace camera3 {
 
@@ -90,5 +94,177 @@ status_t CameraTraces::dump(int fd, const Vector<String16> &args __attribute__((
     return OK;
 }
 
+CameraEventTrace::CameraEventTrace() {
+    for (uint32_t i = 0; i < kCapacity; i++) {
+        atomic_init(&mEntries[i].mSeq, 0u);
+    }
+    atomic_init(&mNext, 0u);
+}
+
+void CameraEventTrace::record(Event event, uint32_t frameNumber, int streamId, int32_t value) {
+    const uint32_t ticket = atomic_fetch_add_explicit(&mNext, 1u, memory_order_relaxed);
+    Entry &entry = mEntries[ticket & (kCapacity - 1)];
+
+    atomic_store_explicit(&entry.mSeq, 0u, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    entry.mRecord.mTimeNs = systemTime(SYSTEM_TIME_MONOTONIC);
+    entry.mRecord.mFrameNumber = frameNumber;
+    entry.mRecord.mValue = value;
+    entry.mRecord.mStreamId = streamId;
+    entry.mRecord.mEvent = event;
+    atomic_store_explicit(&entry.mSeq, ticket + 1, memory_order_release);
+}
+
+void CameraEventTrace::snapshot(Vector<Record> *records) const {
+    const uint32_t next = atomic_load_explicit(&mNext, memory_order_acquire);
+    const uint32_t count = next < kCapacity ? next : kCapacity;
+    records->setCapacity(count);
+    for (uint32_t ticket = next - count; ticket != next; ticket++) {
+        const Entry &entry = mEntries[ticket & (kCapacity - 1)];
+        if (atomic_load_explicit(&entry.mSeq, memory_order_acquire) != ticket + 1) {
+            continue;
+        }
+        Record record = entry.mRecord;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&entry.mSeq, memory_order_relaxed) != ticket + 1) {
+            continue;   // overwritten while copying
+        }
+        records->push_back(record);
+    }
+}
+
+static int compareLatency(const int64_t *lhs, const int64_t *rhs) {
+    return *lhs < *rhs ? -1 : (*lhs > *rhs ? 1 : 0);
+}
+
+void CameraEventTrace::appendPercentiles(String8 *lines, const char *name,
+        Vector<int64_t> *samples) {
+    if (samples->isEmpty()) {
+        return;
+    }
+    samples->sort(compareLatency);
+    const size_t n = samples->size();
+    lines->appendFormat("%s: n %zu, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+            name, n,
+            (*samples)[n / 2] / 1e6,
+            (*samples)[n * 9 / 10] / 1e6,
+            (*samples)[n * 99 / 100] / 1e6,
+            (*samples)[n - 1] / 1e6);
+}
+
+void CameraEventTrace::dump(int fd, int indent) const {
+    Vector<Record> records;
+    snapshot(&records);
+
+    String8 lines;
+    String8 prefix(String8::format("%*s", indent, ""));
+    if (records.isEmpty()) {
+        lines.appendFormat("%sEvent trace: empty\n", prefix.string());
+        write(fd, lines.string(), lines.size());
+        return;
+    }
+
+    struct FrameTimes {
+        nsecs_t submit;
+        nsecs_t halResult;
+    };
+    struct StreamStats {
+        uint32_t buffers;
+        uint32_t errors;
+        Vector<int64_t> bufferLatencies;
+        Vector<int64_t> releaseWaits;
+    };
+
+    uint32_t counts[NUM_EVENTS] = {};
+    KeyedVector<uint32_t, FrameTimes> frames;
+    KeyedVector<int, StreamStats> streams;
+    Vector<int64_t> shutterLatencies;
+    Vector<int64_t> resultLatencies;
+    Vector<int64_t> deliveryLatencies;
+
+    for (size_t i = 0; i < records.size(); i++) {
+        const Record &r = records[i];
+        if (r.mEvent >= NUM_EVENTS) {
+            continue;
+        }
+        counts[r.mEvent]++;
+
+        if (r.mEvent == REQUEST_SUBMIT) {
+            FrameTimes times = { r.mTimeNs, 0 };
+            frames.add(r.mFrameNumber, times);
+            continue;
+        }
+        if (r.mEvent == CONSUMER_RELEASE || r.mEvent == BUFFER_RETURN) {
+            ssize_t index = streams.indexOfKey(r.mStreamId);
+            if (index < 0) {
+                StreamStats stats;
+                stats.buffers = 0;
+                stats.errors = 0;
+                index = streams.add(r.mStreamId, stats);
+            }
+            StreamStats &stats = streams.editValueAt(index);
+            if (r.mEvent == CONSUMER_RELEASE) {
+                stats.releaseWaits.push_back(r.mValue * 1000LL);
+                continue;
+            }
+            stats.buffers++;
+            if (r.mValue != 0) {
+                stats.errors++;
+            }
+        }
+
+        // the latencies of the frames whose submission is still in the ring
+        ssize_t frameIndex = frames.indexOfKey(r.mFrameNumber);
+        if (frameIndex < 0) {
+            continue;
+        }
+        FrameTimes &times = frames.editValueAt(frameIndex);
+        const int64_t latency = r.mTimeNs - times.submit;
+        switch (r.mEvent) {
+            case SHUTTER:
+                shutterLatencies.push_back(latency);
+                break;
+            case HAL_RESULT:
+                times.halResult = r.mTimeNs;
+                resultLatencies.push_back(latency);
+                break;
+            case BUFFER_RETURN:
+                streams.editValueFor(r.mStreamId).bufferLatencies.push_back(latency);
+                break;
+            case RESULT_DELIVERED:
+                if (times.halResult != 0) {
+                    deliveryLatencies.push_back(r.mTimeNs - times.halResult);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    const nsecs_t spanNs = records[records.size() - 1].mTimeNs - records[0].mTimeNs;
+    lines.appendFormat("%sEvent trace: %zu events over %.1f s\n",
+            prefix.string(), records.size(), spanNs / 1e9);
+    lines.appendFormat("%s  submitted %u, shutters %u, HAL results %u, delivered %u\n",
+            prefix.string(), counts[REQUEST_SUBMIT], counts[SHUTTER], counts[HAL_RESULT],
+            counts[RESULT_DELIVERED]);
+    appendPercentiles(&lines, String8::format("%s  submit to shutter", prefix.string()),
+            &shutterLatencies);
+    appendPercentiles(&lines, String8::format("%s  submit to HAL result", prefix.string()),
+            &resultLatencies);
+    appendPercentiles(&lines, String8::format("%s  HAL result to delivery", prefix.string()),
+            &deliveryLatencies);
+    for (size_t i = 0; i < streams.size(); i++) {
+        StreamStats &stats = streams.editValueAt(i);
+        lines.appendFormat("%s  Stream %d: %u buffers returned, %u in error\n",
+                prefix.string(), streams.keyAt(i), stats.buffers, stats.errors);
+        appendPercentiles(&lines, String8::format("%s    submit to buffer", prefix.string()),
+                &stats.bufferLatencies);
+        appendPercentiles(&lines,
+                String8::format("%s    consumer release wait", prefix.string()),
+                &stats.releaseWaits);
+    }
+    write(fd, lines.string(), lines.size());
+}
+
 }; // namespace camera3
 }; // namespace android
@@ -17,8 +17,13 @@
 #ifndef ANDROID_SERVERS_CAMERA_TRACES_H_
 #define ANDROID_SERVERS_CAMERA_TRACES_H_
 
+#include <stdatomic.h>
+#include <stdint.h>
+
 #include <utils/Errors.h>
+#include <utils/RefBase.h>
 #include <utils/String16.h>
+#include <utils/String8.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -60,6 +65,70 @@ private:
     static CameraTracesImpl& sImpl;
 }; // class CameraTraces
 
+/**
+ * Fixed size ring of timestamped capture pipeline events of one camera device.
+ *
+ * Unlike ATRACE, recording is cheap enough to stay on in the field: record() is wait-free
+ * and any thread can call it. When full, the oldest events are overwritten.
+ *
+ * <p>dump() derives the counts and latency percentiles per stage and per stream from the
+ * events still in the ring, to tell where frames are lost.</p>
+ */
+class CameraEventTrace : public virtual RefBase {
+public:
+    enum Event {
+        // process_capture_request() accepted the request
+        REQUEST_SUBMIT,
+        // final result metadata returned by the HAL
+        HAL_RESULT,
+        // shutter notification
+        SHUTTER,
+        // output buffer returned by the HAL, value is 1 if the buffer is in error
+        BUFFER_RETURN,
+        // result delivered to the FrameProcessorBase listeners
+        RESULT_DELIVERED,
+        // the consumer released a buffer that was dequeued for the request,
+        // value is how long the request thread waited for it, in us
+        CONSUMER_RELEASE,
+        NUM_EVENTS
+    };
+
+    // About 15 s of events at 30 fps with two streams
+    static const uint32_t kCapacity = 4096;    // must be a power of 2
+
+    CameraEventTrace();
+
+    void record(Event event, uint32_t frameNumber, int streamId = -1, int32_t value = 0);
+
+    void dump(int fd, int indent) const;
+
+private:
+    struct Record {
+        int64_t mTimeNs;
+        uint32_t mFrameNumber;
+        int32_t mValue;
+        int16_t mStreamId;
+        uint8_t mEvent;
+    };
+
+    struct Entry {
+        // ticket of the record + 1 once written, 0 while being written
+        atomic_uint_least32_t mSeq;
+        Record mRecord;
+    };
+
+    // Copies the readable records, oldest first, skipping the ones being overwritten
+    void snapshot(Vector<Record> *records) const;
+
+    static void appendPercentiles(String8 *lines, const char *name, Vector<int64_t> *samples);
+
+    Entry mEntries[kCapacity];
+    atomic_uint_least32_t mNext;    // ticket of the next event
+
+    CameraEventTrace(const CameraEventTrace&);
+    CameraEventTrace& operator=(const CameraEventTrace&);
+}; // class CameraEventTrace
+
 }; // namespace camera3
 }; // namespace android
 
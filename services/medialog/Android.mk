@@ -6,6 +6,8 @@ LOCAL_SRC_FILES := MediaLogService.cpp
 
 LOCAL_SHARED_LIBRARIES := libmedia libbinder libutils liblog libnbaio
 
+LOCAL_STATIC_LIBRARIES := libcpustats
+
 LOCAL_MODULE:= libmedialogservice
 
 LOCAL_32_BIT_ONLY := true
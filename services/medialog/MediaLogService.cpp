@@ -20,6 +20,7 @@
 #include <sys/mman.h>
 #include <utils/Log.h>
 #include <binder/PermissionCache.h>
+#include <cpustats/CpuAccountingTable.h>
 #include <media/nbaio/NBLog.h>
 #include <private/android_filesystem_config.h>
 #include "MediaLogService.h"
@@ -54,6 +55,22 @@ void MediaLogService::unregisterWriter(const sp<IMemory>& shared)
     }
 }
 
+void MediaLogService::registerCpuAccounting(const sp<IMemory>& shared)
+{
+    if (IPCThreadState::self()->getCallingUid() != AID_MEDIA || shared == 0 ||
+            shared->pointer() == NULL || shared->size() < sizeof(CpuAccountingTable)) {
+        return;
+    }
+    const CpuAccountingTable *table = (const CpuAccountingTable *) shared->pointer();
+    if (table->mMagic != CpuAccountingTable::kMagic ||
+            table->mNumSlots != CpuAccountingTable::kNumSlots) {
+        ALOGW("ignoring CPU accounting table with a different layout");
+        return;
+    }
+    Mutex::Autolock _l(mLock);
+    mCpuAccounting = shared;
+}
+
 status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
 {
     // FIXME merge with similar but not identical code at services/audioflinger/ServiceUtilities.cpp
@@ -67,9 +84,11 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
     }
 
     Vector<NamedReader> namedReaders;
+    sp<IMemory> cpuAccounting;
     {
         Mutex::Autolock _l(mLock);
         namedReaders = mNamedReaders;
+        cpuAccounting = mCpuAccounting;
     }
     for (size_t i = 0; i < namedReaders.size(); i++) {
         const NamedReader& namedReader = namedReaders[i];
@@ -80,6 +99,10 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
         }
         namedReader.reader()->dump(fd, 0 /*indent*/);
     }
+    if (cpuAccounting != 0 && fd >= 0) {
+        dprintf(fd, "\n");
+        ((const CpuAccountingTable *) cpuAccounting->pointer())->dump(fd, 0 /*indent*/);
+    }
     return NO_ERROR;
 }
 
@@ -37,6 +37,7 @@ public:
     static const size_t kMaxSize = 0x10000;
     virtual void        registerWriter(const sp<IMemory>& shared, size_t size, const char *name);
     virtual void        unregisterWriter(const sp<IMemory>& shared);
+    virtual void        registerCpuAccounting(const sp<IMemory>& shared);
 
     virtual status_t    dump(int fd, const Vector<String16>& args);
     virtual status_t    onTransact(uint32_t code, const Parcel& data, Parcel* reply,
@@ -58,6 +59,7 @@ private:
         char                mName[kMaxName];
     };
     Vector<NamedReader> mNamedReaders;
+    sp<IMemory>         mCpuAccounting;     // of mediaserver, NULL unless enabled
 };
 
 }   // namespace android
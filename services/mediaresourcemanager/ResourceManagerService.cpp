@@ -51,15 +51,6 @@ static bool hasResourceType(String8 type, Vector<MediaResource> resources) {
     return false;
 }
 
-static bool hasResourceType(String8 type, ResourceInfos infos) {
-    for (size_t i = 0; i < infos.size(); ++i) {
-        if (hasResourceType(type, infos[i].resources)) {
-            return true;
-        }
-    }
-    return false;
-}
-
 static ResourceInfos& getResourceInfosForEdit(
         int pid,
         PidResourceInfosMap& map) {
@@ -197,6 +188,7 @@ void ResourceManagerService::addResource(
     ResourceInfo& info = getResourceInfoForEdit(clientId, client, infos);
     // TODO: do the merge instead of append.
     info.resources.appendVector(resources);
+    addToTypeMap_l(pid, resources);
 }
 
 void ResourceManagerService::removeResource(int pid, int64_t clientId) {
@@ -215,6 +207,7 @@ void ResourceManagerService::removeResource(int pid, int64_t clientId) {
     ResourceInfos &infos = mMap.editValueAt(index);
     for (size_t j = 0; j < infos.size(); ++j) {
         if (infos[j].clientId == clientId) {
+            removeFromTypeMap_l(pid, infos[j].resources);
             j = infos.removeAt(j);
             found = true;
             break;
@@ -245,62 +238,11 @@ bool ResourceManagerService::reclaimResource(
     Vector<sp<IResourceManagerClient>> clients;
     {
         Mutex::Autolock lock(mLock);
-        const MediaResource *secureCodec = NULL;
-        const MediaResource *nonSecureCodec = NULL;
-        const MediaResource *graphicMemory = NULL;
-        for (size_t i = 0; i < resources.size(); ++i) {
-            String8 type = resources[i].mType;
-            if (resources[i].mType == kResourceSecureCodec) {
-                secureCodec = &resources[i];
-            } else if (type == kResourceNonSecureCodec) {
-                nonSecureCodec = &resources[i];
-            } else if (type == kResourceGraphicMemory) {
-                graphicMemory = &resources[i];
-            }
-        }
-
-        // first pass to handle secure/non-secure codec conflict
-        if (secureCodec != NULL) {
-            if (!mSupportsMultipleSecureCodecs) {
-                if (!getAllClients_l(callingPid, String8(kResourceSecureCodec), &clients)) {
-                    return false;
-                }
-            }
-            if (!mSupportsSecureWithNonSecureCodec) {
-                if (!getAllClients_l(callingPid, String8(kResourceNonSecureCodec), &clients)) {
-                    return false;
-                }
-            }
-        }
-        if (nonSecureCodec != NULL) {
-            if (!mSupportsSecureWithNonSecureCodec) {
-                if (!getAllClients_l(callingPid, String8(kResourceSecureCodec), &clients)) {
-                    return false;
-                }
-            }
-        }
-
-        if (clients.size() == 0) {
-            // if no secure/non-secure codec conflict, run second pass to handle other resources.
-            getClientForResource_l(callingPid, graphicMemory, &clients);
-        }
-
-        if (clients.size() == 0) {
-            // if we are here, run the third pass to free one codec with the same type.
-            getClientForResource_l(callingPid, secureCodec, &clients);
-            getClientForResource_l(callingPid, nonSecureCodec, &clients);
-        }
-
-        if (clients.size() == 0) {
-            // if we are here, run the fourth pass to free one codec with the different type.
-            if (secureCodec != NULL) {
-                MediaResource temp(String8(kResourceNonSecureCodec), 1);
-                getClientForResource_l(callingPid, &temp, &clients);
-            }
-            if (nonSecureCodec != NULL) {
-                MediaResource temp(String8(kResourceSecureCodec), 1);
-                getClientForResource_l(callingPid, &temp, &clients);
-            }
+        snapshotPriorities_l(callingPid);
+        bool found = getClientsToReclaim_l(callingPid, resources, &clients, NULL);
+        mPriorities.clear();
+        if (!found) {
+            return false;
         }
     }
 
@@ -329,6 +271,7 @@ bool ResourceManagerService::reclaimResource(
             ResourceInfos &infos = mMap.editValueAt(i);
             for (size_t j = 0; j < infos.size();) {
                 if (infos[j].client == failedClient) {
+                    removeFromTypeMap_l(mMap.keyAt(i), infos[j].resources);
                     j = infos.removeAt(j);
                     found = true;
                 } else {
@@ -347,20 +290,109 @@ bool ResourceManagerService::reclaimResource(
     return false;
 }
 
+bool ResourceManagerService::reclaimResourceDryRun(
+        int callingPid, const Vector<MediaResource> &resources, bool *policyConflict) {
+    Vector<sp<IResourceManagerClient>> clients;
+    *policyConflict = false;
+
+    Mutex::Autolock lock(mLock);
+    snapshotPriorities_l(callingPid);
+    bool found = getClientsToReclaim_l(callingPid, resources, &clients, policyConflict);
+    mPriorities.clear();
+    if (!found || clients.size() == 0) {
+        *policyConflict = false;
+        return false;
+    }
+    return true;
+}
+
+bool ResourceManagerService::getClientsToReclaim_l(
+        int callingPid, const Vector<MediaResource> &resources,
+        Vector<sp<IResourceManagerClient>> *clients, bool *policyConflict) {
+    const MediaResource *secureCodec = NULL;
+    const MediaResource *nonSecureCodec = NULL;
+    const MediaResource *graphicMemory = NULL;
+    for (size_t i = 0; i < resources.size(); ++i) {
+        String8 type = resources[i].mType;
+        if (resources[i].mType == kResourceSecureCodec) {
+            secureCodec = &resources[i];
+        } else if (type == kResourceNonSecureCodec) {
+            nonSecureCodec = &resources[i];
+        } else if (type == kResourceGraphicMemory) {
+            graphicMemory = &resources[i];
+        }
+    }
+
+    // first pass to handle secure/non-secure codec conflict
+    if (secureCodec != NULL) {
+        if (!mSupportsMultipleSecureCodecs) {
+            if (!getAllClients_l(callingPid, String8(kResourceSecureCodec), clients)) {
+                return false;
+            }
+        }
+        if (!mSupportsSecureWithNonSecureCodec) {
+            if (!getAllClients_l(callingPid, String8(kResourceNonSecureCodec), clients)) {
+                return false;
+            }
+        }
+    }
+    if (nonSecureCodec != NULL) {
+        if (!mSupportsSecureWithNonSecureCodec) {
+            if (!getAllClients_l(callingPid, String8(kResourceSecureCodec), clients)) {
+                return false;
+            }
+        }
+    }
+    if (policyConflict != NULL) {
+        *policyConflict = (clients->size() > 0);
+    }
+
+    if (clients->size() == 0) {
+        // if no secure/non-secure codec conflict, run second pass to handle other resources.
+        getClientForResource_l(callingPid, graphicMemory, clients);
+    }
+
+    if (clients->size() == 0) {
+        // if we are here, run the third pass to free one codec with the same type.
+        getClientForResource_l(callingPid, secureCodec, clients);
+        getClientForResource_l(callingPid, nonSecureCodec, clients);
+    }
+
+    if (clients->size() == 0) {
+        // if we are here, run the fourth pass to free one codec with the different type.
+        if (secureCodec != NULL) {
+            MediaResource temp(String8(kResourceNonSecureCodec), 1);
+            getClientForResource_l(callingPid, &temp, clients);
+        }
+        if (nonSecureCodec != NULL) {
+            MediaResource temp(String8(kResourceSecureCodec), 1);
+            getClientForResource_l(callingPid, &temp, clients);
+        }
+    }
+    return true;
+}
+
 bool ResourceManagerService::getAllClients_l(
         int callingPid, const String8 &type, Vector<sp<IResourceManagerClient>> *clients) {
     Vector<sp<IResourceManagerClient>> temp;
-    for (size_t i = 0; i < mMap.size(); ++i) {
-        ResourceInfos &infos = mMap.editValueAt(i);
+    ssize_t typeIndex = mTypeMap.indexOfKey(type);
+    const PidResourceCountMap *pids = typeIndex >= 0 ? &mTypeMap.valueAt(typeIndex) : NULL;
+    for (size_t i = 0; pids != NULL && i < pids->size(); ++i) {
+        const int pid = pids->keyAt(i);
+        if (!isCallingPriorityHigher_l(callingPid, pid)) {
+            // some higher/equal priority process owns the resource,
+            // this request can't be fulfilled.
+            ALOGE("getAllClients_l: can't reclaim resource %s from pid %d",
+                    type.string(), pid);
+            return false;
+        }
+        ssize_t index = mMap.indexOfKey(pid);
+        if (index < 0) {
+            continue;
+        }
+        const ResourceInfos &infos = mMap.valueAt(index);
         for (size_t j = 0; j < infos.size(); ++j) {
             if (hasResourceType(type, infos[j].resources)) {
-                if (!isCallingPriorityHigher_l(callingPid, mMap.keyAt(i))) {
-                    // some higher/equal priority process owns the resource,
-                    // this request can't be fulfilled.
-                    ALOGE("getAllClients_l: can't reclaim resource %s from pid %d",
-                            type.string(), mMap.keyAt(i));
-                    return false;
-                }
                 temp.push_back(infos[j].client);
             }
         }
@@ -378,7 +410,7 @@ bool ResourceManagerService::getLowestPriorityBiggestClient_l(
     int lowestPriorityPid;
     int lowestPriority;
     int callingPriority;
-    if (!mProcessInfo->getPriority(callingPid, &callingPriority)) {
+    if (!getPriority_l(callingPid, &callingPriority)) {
         ALOGE("getLowestPriorityBiggestClient_l: can't get process priority for pid %d",
                 callingPid);
         return false;
@@ -402,18 +434,16 @@ bool ResourceManagerService::getLowestPriorityPid_l(
         const String8 &type, int *lowestPriorityPid, int *lowestPriority) {
     int pid = -1;
     int priority = -1;
-    for (size_t i = 0; i < mMap.size(); ++i) {
-        if (mMap.valueAt(i).size() == 0) {
-            // no client on this process.
-            continue;
-        }
-        if (!hasResourceType(type, mMap.valueAt(i))) {
-            // doesn't have the requested resource type
-            continue;
-        }
-        int tempPid = mMap.keyAt(i);
+    ssize_t typeIndex = mTypeMap.indexOfKey(type);
+    if (typeIndex < 0) {
+        // no process has the requested resource type
+        return false;
+    }
+    const PidResourceCountMap &pids = mTypeMap.valueAt(typeIndex);
+    for (size_t i = 0; i < pids.size(); ++i) {
+        int tempPid = pids.keyAt(i);
         int tempPriority;
-        if (!mProcessInfo->getPriority(tempPid, &tempPriority)) {
+        if (!getPriority_l(tempPid, &tempPriority)) {
             ALOGV("getLowestPriorityPid_l: can't get priority of pid %d, skipped", tempPid);
             // TODO: remove this pid from mMap?
             continue;
@@ -433,18 +463,89 @@ bool ResourceManagerService::getLowestPriorityPid_l(
 
 bool ResourceManagerService::isCallingPriorityHigher_l(int callingPid, int pid) {
     int callingPidPriority;
-    if (!mProcessInfo->getPriority(callingPid, &callingPidPriority)) {
+    if (!getPriority_l(callingPid, &callingPidPriority)) {
         return false;
     }
 
     int priority;
-    if (!mProcessInfo->getPriority(pid, &priority)) {
+    if (!getPriority_l(pid, &priority)) {
         return false;
     }
 
     return (callingPidPriority < priority);
 }
 
+void ResourceManagerService::snapshotPriorities_l(int callingPid) {
+    Vector<int> pids;
+    pids.push_back(callingPid);
+    for (size_t i = 0; i < mMap.size(); ++i) {
+        if (mMap.keyAt(i) != callingPid && mMap.valueAt(i).size() > 0) {
+            pids.push_back(mMap.keyAt(i));
+        }
+    }
+
+    Vector<int> priorities;
+    priorities.insertAt(-1, 0, pids.size());
+    mPriorities.clear();
+    if (!mProcessInfo->getPriorities(pids.array(), pids.size(), priorities.editArray())) {
+        ALOGE("snapshotPriorities_l: can't get process priorities");
+        return;
+    }
+    for (size_t i = 0; i < pids.size(); ++i) {
+        mPriorities.add(pids[i], priorities[i]);
+    }
+}
+
+bool ResourceManagerService::getPriority_l(int pid, int *priority) {
+    ssize_t index = mPriorities.indexOfKey(pid);
+    if (index < 0) {
+        // not in the snapshot, or there is none.
+        return mProcessInfo->getPriority(pid, priority);
+    }
+    if (mPriorities.valueAt(index) < 0) {
+        return false;
+    }
+    *priority = mPriorities.valueAt(index);
+    return true;
+}
+
+void ResourceManagerService::addToTypeMap_l(int pid, const Vector<MediaResource> &resources) {
+    for (size_t i = 0; i < resources.size(); ++i) {
+        ssize_t index = mTypeMap.indexOfKey(resources[i].mType);
+        if (index < 0) {
+            index = mTypeMap.add(resources[i].mType, PidResourceCountMap());
+        }
+        PidResourceCountMap &pids = mTypeMap.editValueAt(index);
+        ssize_t pidIndex = pids.indexOfKey(pid);
+        if (pidIndex < 0) {
+            pids.add(pid, 1);
+        } else {
+            ++pids.editValueAt(pidIndex);
+        }
+    }
+}
+
+void ResourceManagerService::removeFromTypeMap_l(
+        int pid, const Vector<MediaResource> &resources) {
+    for (size_t i = 0; i < resources.size(); ++i) {
+        ssize_t index = mTypeMap.indexOfKey(resources[i].mType);
+        if (index < 0) {
+            continue;
+        }
+        PidResourceCountMap &pids = mTypeMap.editValueAt(index);
+        ssize_t pidIndex = pids.indexOfKey(pid);
+        if (pidIndex < 0) {
+            continue;
+        }
+        if (--pids.editValueAt(pidIndex) == 0) {
+            pids.removeItemsAt(pidIndex);
+            if (pids.isEmpty()) {
+                mTypeMap.removeItemsAt(index);
+            }
+        }
+    }
+}
+
 bool ResourceManagerService::getBiggestClient_l(
         int pid, const String8 &type, sp<IResourceManagerClient> *client) {
     ssize_t index = mMap.indexOfKey(pid);
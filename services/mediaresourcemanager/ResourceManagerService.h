@@ -41,6 +41,9 @@ struct ResourceInfo {
 
 typedef Vector<ResourceInfo> ResourceInfos;
 typedef KeyedVector<int, ResourceInfos> PidResourceInfosMap;
+// Number of resources of one type held by each process.
+typedef KeyedVector<int, uint32_t> PidResourceCountMap;
+typedef KeyedVector<String8, PidResourceCountMap> ResourceTypeMap;
 
 class ResourceManagerService
     : public BinderService<ResourceManagerService>,
@@ -70,12 +73,20 @@ public:
     // Returns true if any resource has been reclaimed, otherwise returns false.
     virtual bool reclaimResource(int callingPid, const Vector<MediaResource> &resources);
 
+    virtual bool reclaimResourceDryRun(
+            int callingPid, const Vector<MediaResource> &resources, bool *policyConflict);
+
 protected:
     virtual ~ResourceManagerService();
 
 private:
     friend class ResourceManagerServiceTest;
 
+    // Gets the clients to reclaim from for the requested resources, see reclaimResource().
+    // Returns false if the request can't be fulfilled. policyConflict may be NULL.
+    bool getClientsToReclaim_l(int callingPid, const Vector<MediaResource> &resources,
+            Vector<sp<IResourceManagerClient>> *clients, bool *policyConflict);
+
     // Gets the list of all the clients who own the specified resource type.
     // Returns false if any client belongs to a process with higher priority than the
     // calling process. The clients will remain unchanged if returns false.
@@ -98,6 +109,14 @@ private:
 
     bool isCallingPriorityHigher_l(int callingPid, int pid);
 
+    // Queries the priorities of the calling process and of every process holding resources
+    // with a single call; getPriority_l() uses them until mPriorities is cleared.
+    void snapshotPriorities_l(int callingPid);
+    bool getPriority_l(int pid, int *priority);
+
+    void addToTypeMap_l(int pid, const Vector<MediaResource> &resources);
+    void removeFromTypeMap_l(int pid, const Vector<MediaResource> &resources);
+
     // A helper function basically calls getLowestPriorityBiggestClient_l and add the result client
     // to the given Vector.
     void getClientForResource_l(
@@ -107,6 +126,8 @@ private:
     sp<ProcessInfoInterface> mProcessInfo;
     sp<ServiceLog> mServiceLog;
     PidResourceInfosMap mMap;
+    ResourceTypeMap mTypeMap;           // the processes holding each resource type in mMap
+    KeyedVector<int, int> mPriorities;  // pid to priority, -1 if unknown
     bool mSupportsMultipleSecureCodecs;
     bool mSupportsSecureWithNonSecureCodec;
 };
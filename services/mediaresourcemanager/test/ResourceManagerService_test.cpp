@@ -490,6 +490,31 @@ protected:
         EXPECT_EQ(mTestClient2, client);
     }
 
+    void testReclaimResourceDryRun() {
+        Vector<MediaResource> resources;
+        resources.push_back(MediaResource(String8(kResourceSecureCodec), 1));
+        bool policyConflict;
+
+        addResource();
+        mService->mSupportsMultipleSecureCodecs = false;
+        mService->mSupportsSecureWithNonSecureCodec = true;
+
+        // priority too low
+        EXPECT_FALSE(mService->reclaimResourceDryRun(kLowPriorityPid, resources, &policyConflict));
+        EXPECT_FALSE(policyConflict);
+
+        // the secure codecs conflict with the request, but nothing is reclaimed
+        EXPECT_TRUE(mService->reclaimResourceDryRun(kHighPriorityPid, resources, &policyConflict));
+        EXPECT_TRUE(policyConflict);
+        verifyClients(false /* c1 */, false /* c2 */, false /* c3 */);
+
+        // no conflict, one secure codec would be reclaimed from the lowest priority process
+        mService->mSupportsMultipleSecureCodecs = true;
+        EXPECT_TRUE(mService->reclaimResourceDryRun(kHighPriorityPid, resources, &policyConflict));
+        EXPECT_FALSE(policyConflict);
+        verifyClients(false /* c1 */, false /* c2 */, false /* c3 */);
+    }
+
     void testIsCallingPriorityHigher() {
         EXPECT_FALSE(mService->isCallingPriorityHigher_l(101, 100));
         EXPECT_FALSE(mService->isCallingPriorityHigher_l(100, 100));
@@ -519,6 +544,10 @@ TEST_F(ResourceManagerServiceTest, reclaimResource) {
     testReclaimResourceNonSecure();
 }
 
+TEST_F(ResourceManagerServiceTest, reclaimResourceDryRun) {
+    testReclaimResourceDryRun();
+}
+
 TEST_F(ResourceManagerServiceTest, getAllClients_l) {
     testGetAllClients();
 }
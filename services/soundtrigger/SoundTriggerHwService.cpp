@@ -187,7 +187,7 @@ static bool tryLock(Mutex& mutex)
     return locked;
 }
 
-status_t SoundTriggerHwService::dump(int fd, const Vector<String16>& args __unused) {
+status_t SoundTriggerHwService::dump(int fd, const Vector<String16>& args) {
     String8 result;
     if (checkCallingPermission(String16("android.permission.DUMP")) == false) {
         result.appendFormat("Permission Denial: can't dump SoundTriggerHwService");
@@ -200,6 +200,10 @@ status_t SoundTriggerHwService::dump(int fd, const Vector<String16>& args __unus
             write(fd, result.string(), result.size());
         }
 
+        for (size_t i = 0; i < mModules.size(); i++) {
+            mModules.valueAt(i)->dump(fd, args);
+        }
+
         if (locked) mServiceLock.unlock();
     }
     return NO_ERROR;
@@ -499,7 +503,7 @@ void SoundTriggerHwService::CallbackThread::sendCallbackEvent(
 
 SoundTriggerHwService::CallbackEvent::CallbackEvent(event_type type, sp<IMemory> memory,
                                                     wp<Module> module)
-    : mType(type), mMemory(memory), mModule(module)
+    : mType(type), mMemory(memory), mModule(module), mTimeNs(systemTime())
 {
 }
 
@@ -516,7 +520,9 @@ SoundTriggerHwService::Module::Module(const sp<SoundTriggerHwService>& service,
                                       sound_trigger_module_descriptor descriptor,
                                       const sp<ISoundTriggerClient>& client)
  : mService(service), mHwDevice(hwDevice), mDescriptor(descriptor),
-   mClient(client), mServiceState(SOUND_TRIGGER_STATE_NO_INIT)
+   mClient(client), mServiceState(SOUND_TRIGGER_STATE_NO_INIT),
+   mCaptureSession(AUDIO_SESSION_ALLOCATE), mCaptureIOHandle(AUDIO_IO_HANDLE_NONE),
+   mCaptureDevice(AUDIO_DEVICE_NONE), mCaptureSessionRefs(0)
 {
 }
 
@@ -537,6 +543,7 @@ void SoundTriggerHwService::Module::detach() {
                 mHwDevice->stop_recognition(mHwDevice, model->mHandle);
             }
             mHwDevice->unload_sound_model(mHwDevice, model->mHandle);
+            releaseCaptureSession_l();
         }
         mModels.clear();
     }
@@ -600,21 +607,49 @@ status_t SoundTriggerHwService::Module::loadSoundModel(const sp<IMemory>& modelM
     if (status != NO_ERROR) {
         return status;
     }
-    audio_session_t session;
-    audio_io_handle_t ioHandle;
-    audio_devices_t device;
-
-    status = AudioSystem::acquireSoundTriggerSession(&session, &ioHandle, &device);
+    status = acquireCaptureSession_l();
     if (status != NO_ERROR) {
+        mHwDevice->unload_sound_model(mHwDevice, *handle);
         return status;
     }
 
-    sp<Model> model = new Model(*handle, session, ioHandle, device, sound_model->type);
+    sp<Model> model = new Model(*handle, mCaptureSession, mCaptureIOHandle, mCaptureDevice,
+                                sound_model->type);
     mModels.replaceValueFor(*handle, model);
 
     return status;
 }
 
+status_t SoundTriggerHwService::Module::acquireCaptureSession_l()
+{
+    if (mCaptureSessionRefs == 0) {
+        status_t status = AudioSystem::acquireSoundTriggerSession(&mCaptureSession,
+                                                                  &mCaptureIOHandle,
+                                                                  &mCaptureDevice);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        ALOGV("acquireCaptureSession_l() session %d io handle %d device %08x",
+              mCaptureSession, mCaptureIOHandle, mCaptureDevice);
+    }
+    mCaptureSessionRefs++;
+    return NO_ERROR;
+}
+
+void SoundTriggerHwService::Module::releaseCaptureSession_l()
+{
+    if (mCaptureSessionRefs == 0) {
+        return;
+    }
+    if (--mCaptureSessionRefs == 0) {
+        ALOGV("releaseCaptureSession_l() session %d", mCaptureSession);
+        AudioSystem::releaseSoundTriggerSession(mCaptureSession);
+        mCaptureSession = AUDIO_SESSION_ALLOCATE;
+        mCaptureIOHandle = AUDIO_IO_HANDLE_NONE;
+        mCaptureDevice = AUDIO_DEVICE_NONE;
+    }
+}
+
 status_t SoundTriggerHwService::Module::unloadSoundModel(sound_model_handle_t handle)
 {
     ALOGV("unloadSoundModel() model handle %d", handle);
@@ -638,7 +673,7 @@ status_t SoundTriggerHwService::Module::unloadSoundModel_l(sound_model_handle_t
         mHwDevice->stop_recognition(mHwDevice, model->mHandle);
         model->mState = Model::STATE_IDLE;
     }
-    AudioSystem::releaseSoundTriggerSession(model->mCaptureSession);
+    releaseCaptureSession_l();
     return mHwDevice->unload_sound_model(mHwDevice, handle);
 }
 
@@ -752,6 +787,17 @@ void SoundTriggerHwService::Module::onCallbackEvent(const sp<CallbackEvent>& eve
             recognitionEvent->capture_session = model->mCaptureSession;
             model->mState = Model::STATE_IDLE;
             client = mClient;
+
+            if (recognitionEvent->status == RECOGNITION_STATUS_SUCCESS) {
+                const nsecs_t dispatchNs = systemTime() - event->mTimeNs;
+                model->mNumRecognitions++;
+                model->mLastDispatchNs = dispatchNs;
+                if (dispatchNs > model->mMaxDispatchNs) {
+                    model->mMaxDispatchNs = dispatchNs;
+                }
+                model->mCaptureDelayMs = recognitionEvent->capture_delay_ms;
+                model->mCapturePreambleMs = recognitionEvent->capture_preamble_ms;
+            }
         }
         if (client != 0) {
             client->onRecognitionEvent(eventMemory);
@@ -878,14 +924,42 @@ SoundTriggerHwService::Model::Model(sound_model_handle_t handle, audio_session_t
                                     audio_io_handle_t ioHandle, audio_devices_t device,
                                     sound_trigger_sound_model_type_t type) :
     mHandle(handle), mState(STATE_IDLE), mCaptureSession(session),
-    mCaptureIOHandle(ioHandle), mCaptureDevice(device), mType(type)
+    mCaptureIOHandle(ioHandle), mCaptureDevice(device), mType(type),
+    mNumRecognitions(0), mLastDispatchNs(0), mMaxDispatchNs(0),
+    mCaptureDelayMs(0), mCapturePreambleMs(0)
 {
 
 }
 
-status_t SoundTriggerHwService::Module::dump(int fd __unused,
+status_t SoundTriggerHwService::Module::dump(int fd,
                                              const Vector<String16>& args __unused) {
     String8 result;
+    bool locked = tryLock(mLock);
+    if (!locked) {
+        result.appendFormat("Module %d may be deadlocked\n", mDescriptor.handle);
+    }
+
+    result.appendFormat("Module %d: %s, state %d, %zu model(s)\n", mDescriptor.handle,
+                        mDescriptor.properties.description, mServiceState, mModels.size());
+    result.appendFormat("  capture session %d io handle %d device %08x, %u model(s)\n",
+                        mCaptureSession, mCaptureIOHandle, mCaptureDevice, mCaptureSessionRefs);
+    for (size_t i = 0; i < mModels.size(); i++) {
+        const sp<Model>& model = mModels.valueAt(i);
+        // The first captured sample is available capture_delay_ms after the trigger was
+        // reported by the HAL, while the client learns about it after the dispatch latency.
+        result.appendFormat("  model %d: type %d, %s, %u recognition(s), dispatch last %.2f ms"
+                            " max %.2f ms, capture delay %u ms preamble %u ms\n",
+                            model->mHandle, model->mType,
+                            model->mState == Model::STATE_ACTIVE ? "active" : "idle",
+                            model->mNumRecognitions, model->mLastDispatchNs / 1E6,
+                            model->mMaxDispatchNs / 1E6, model->mCaptureDelayMs,
+                            model->mCapturePreambleMs);
+    }
+
+    if (locked) {
+        mLock.unlock();
+    }
+    write(fd, result.string(), result.size());
     return NO_ERROR;
 }
 
@@ -79,6 +79,13 @@ public:
         audio_devices_t         mCaptureDevice;
         sound_trigger_sound_model_type_t mType;
         struct sound_trigger_recognition_config mConfig;
+
+        // recognition statistics, reported by dump()
+        uint32_t                mNumRecognitions;
+        nsecs_t                 mLastDispatchNs;    // HAL callback to client callback
+        nsecs_t                 mMaxDispatchNs;
+        uint32_t                mCaptureDelayMs;    // as reported by the HAL, last event
+        uint32_t                mCapturePreambleMs;
     };
 
     class CallbackEvent : public RefBase {
@@ -95,6 +102,7 @@ public:
         event_type mType;
         sp<IMemory> mMemory;
         wp<Module> mModule;
+        nsecs_t mTimeNs;    // when the HAL callback was received
     };
 
     class Module : public virtual RefBase,
@@ -143,6 +151,10 @@ public:
 
        status_t unloadSoundModel_l(sound_model_handle_t handle);
 
+       // All models loaded on the module share one capture session, so that a trigger on any
+       // of them is followed by capture on the same input without reconfiguring audio policy.
+       status_t acquireCaptureSession_l();
+       void releaseCaptureSession_l();
 
         Mutex                                  mLock;
         wp<SoundTriggerHwService>              mService;
@@ -151,6 +163,10 @@ public:
         sp<ISoundTriggerClient>                mClient;
         DefaultKeyedVector< sound_model_handle_t, sp<Model> >     mModels;
         sound_trigger_service_state_t          mServiceState;
+        audio_session_t                        mCaptureSession;
+        audio_io_handle_t                      mCaptureIOHandle;
+        audio_devices_t                        mCaptureDevice;
+        uint32_t                               mCaptureSessionRefs; // models using the session
     }; // class Module
 
     class CallbackThread : public Thread {
@@ -15,3 +15,40 @@ LOCAL_MODULE := fir
 include $(BUILD_HOST_EXECUTABLE)
 
 
+
+#
+# generator of the prebuilt AudioResamplerDyn filter table
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	fir_table.cpp
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/../../services/audioflinger
+
+LOCAL_MODULE := resampler_fir_table
+
+include $(BUILD_HOST_EXECUTABLE)
+
+#
+# prebuilt AudioResamplerDyn filter table, installed as /system/etc/audio_resampler_fir.bin
+#
+# The mixer resamples float by default, set AUDIO_RESAMPLER_FIR_TABLE_INT := true
+# to also include the 16 and 32 bit integer filters.
+#
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_resampler_fir.bin
+LOCAL_MODULE_CLASS := ETC
+LOCAL_MODULE_PATH := $(TARGET_OUT_ETC)
+
+include $(BUILD_SYSTEM)/base_rules.mk
+
+FIR_TABLE_GEN := $(HOST_OUT_EXECUTABLES)/resampler_fir_table$(HOST_EXECUTABLE_SUFFIX)
+
+$(LOCAL_BUILT_MODULE): PRIVATE_COEFS := $(if $(filter true,$(AUDIO_RESAMPLER_FIR_TABLE_INT)),all,float)
+$(LOCAL_BUILT_MODULE): $(FIR_TABLE_GEN)
+	@echo "Generate: $@"
+	@mkdir -p $(dir $@)
+	$(hide) $(FIR_TABLE_GEN) -c $(PRIVATE_COEFS) -o $@
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Generates the prebuilt polyphase filter table of AudioResamplerDyn,
+ * see AudioResamplerFirTable.h for the file format.
+ *
+ * Every quality tier of AudioResamplerFirDesign.h is designed for each pair of common input
+ * and output sample rates, so that no resampler converting between these rates has to
+ * design its filter at run time.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "AudioResamplerFirOps.h"   // is_same<>
+#include "AudioResamplerFirDesign.h"
+#include "AudioResamplerFirTable.h"
+
+using namespace android;
+
+static const int32_t kInSampleRates[] = {
+    8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000, 88200, 96000, 176400, 192000,
+};
+
+static const int32_t kDefaultOutSampleRates[] = {
+    44100, 48000,
+};
+
+enum {
+    COEFS_INT   = 1 << 0,   // int16_t and int32_t, for 16 bit mixer input
+    COEFS_FLOAT = 1 << 1,   // float, for float mixer input
+};
+
+struct Filter {
+    FirTableEntry       mEntry;
+    std::vector<char>   mCoefs;
+};
+
+template <typename T>
+static void design(std::vector<Filter> *filters, const FirTier& tier, uint32_t coefType,
+        int32_t inSampleRate, int32_t outSampleRate)
+{
+    FirDesign d;
+    firDesign(&d, tier, inSampleRate, outSampleRate);
+
+    Filter filter;
+    filter.mEntry.mInSampleRate = inSampleRate;
+    filter.mEntry.mOutSampleRate = outSampleRate;
+    filter.mEntry.mQuality = tier.mQuality;
+    filter.mEntry.mPhases = d.mPhases;
+    filter.mEntry.mHalfNumCoefs = d.mHalfNumCoefs;
+    filter.mEntry.mCoefType = coefType;
+    filter.mEntry.mOffset = 0;
+    filter.mEntry.mSize = (d.mPhases + 1) * d.mHalfNumCoefs * sizeof(T);
+    filter.mCoefs.resize(filter.mEntry.mSize);
+    firKaiserGen(reinterpret_cast<T *>(&filter.mCoefs[0]), d.mPhases, d.mHalfNumCoefs,
+            d.mStopBandAtten, d.mCutoff, kFirDesignAtten);
+    filters->push_back(filter);
+}
+
+static bool write(FILE *f, const void *data, size_t size)
+{
+    return size == 0 || fwrite(data, size, 1, f) == 1;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-h] [-v] [-c {int|float|all}] [-s rate[,rate...]] -o file\n"
+            "    -h    this help message\n"
+            "    -v    print each filter\n"
+            "    -c    coefficient types, int for a 16 bit mixer, float for a float mixer (all)\n"
+            "    -s    output sample rates (44100,48000)\n"
+            "    -o    output file\n",
+            name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    bool verbose = false;
+    int coefs = COEFS_INT | COEFS_FLOAT;
+    std::vector<int32_t> outSampleRates(kDefaultOutSampleRates, kDefaultOutSampleRates
+            + sizeof(kDefaultOutSampleRates) / sizeof(kDefaultOutSampleRates[0]));
+
+    int ch;
+    while ((ch = getopt(argc, argv, "hvc:s:o:")) != -1) {
+        switch (ch) {
+        case 'v':
+            verbose = true;
+            break;
+        case 'c':
+            if (!strcmp(optarg, "int")) {
+                coefs = COEFS_INT;
+            } else if (!strcmp(optarg, "float")) {
+                coefs = COEFS_FLOAT;
+            } else if (!strcmp(optarg, "all")) {
+                coefs = COEFS_INT | COEFS_FLOAT;
+            } else {
+                usage(argv[0]);
+            }
+            break;
+        case 's': {
+            outSampleRates.clear();
+            char *rate = optarg;
+            for (;;) {
+                char *end;
+                const long value = strtol(rate, &end, 10);
+                if (end == rate || value <= 0 || (*end != '\0' && *end != ',')) {
+                    usage(argv[0]);
+                }
+                outSampleRates.push_back(value);
+                if (*end == '\0') {
+                    break;
+                }
+                rate = end + 1;
+            }
+            } break;
+        case 'o':
+            path = optarg;
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+            break;
+        }
+    }
+    if (path == NULL || optind != argc) {
+        usage(argv[0]);
+    }
+
+    std::vector<Filter> filters;
+    for (size_t o = 0; o < outSampleRates.size(); ++o) {
+        const int32_t outSampleRate = outSampleRates[o];
+        for (size_t i = 0; i < sizeof(kInSampleRates) / sizeof(kInSampleRates[0]); ++i) {
+            const int32_t inSampleRate = kInSampleRates[i];
+            // the mixer resamples tracks at the output rate only after a rate change
+            if (inSampleRate == outSampleRate) {
+                continue;
+            }
+            for (size_t t = 0; t < kNumFirTiers; ++t) {
+                const FirTier& tier = kFirTiers[t];
+                if (coefs & COEFS_INT) {
+                    if (tier.mUseS32) {
+                        design<int32_t>(&filters, tier, FIR_COEF_INT32,
+                                inSampleRate, outSampleRate);
+                    } else {
+                        design<int16_t>(&filters, tier, FIR_COEF_INT16,
+                                inSampleRate, outSampleRate);
+                    }
+                }
+                if (coefs & COEFS_FLOAT) {
+                    design<float>(&filters, tier, FIR_COEF_FLOAT, inSampleRate, outSampleRate);
+                }
+            }
+        }
+    }
+
+    FirTableHeader header;
+    header.mMagic = kFirTableMagic;
+    header.mVersion = kFirTableVersion;
+    header.mNumEntries = filters.size();
+    header.mReserved = 0;
+
+    // place each filter at the next aligned offset after the entries
+    uint32_t offset = sizeof(header) + filters.size() * sizeof(FirTableEntry);
+    for (size_t i = 0; i < filters.size(); ++i) {
+        offset = (offset + kFirTableAlignment - 1) / kFirTableAlignment * kFirTableAlignment;
+        filters[i].mEntry.mOffset = offset;
+        offset += filters[i].mEntry.mSize;
+        if (verbose) {
+            const FirTableEntry& e = filters[i].mEntry;
+            printf("%6d -> %6d Hz  quality %d  coefs %u  L %3d  length %3d  %6u bytes\n",
+                    e.mInSampleRate, e.mOutSampleRate, e.mQuality, e.mCoefType,
+                    e.mPhases, 2 * e.mHalfNumCoefs, e.mSize);
+        }
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "%s: cannot create %s\n", argv[0], path);
+        return 1;
+    }
+    bool ok = write(f, &header, sizeof(header));
+    for (size_t i = 0; ok && i < filters.size(); ++i) {
+        ok = write(f, &filters[i].mEntry, sizeof(FirTableEntry));
+    }
+    static const char kZeros[kFirTableAlignment] = {};
+    long position = sizeof(header) + filters.size() * sizeof(FirTableEntry);
+    for (size_t i = 0; ok && i < filters.size(); ++i) {
+        const Filter& filter = filters[i];
+        ok = write(f, kZeros, filter.mEntry.mOffset - position)
+                && write(f, &filter.mCoefs[0], filter.mCoefs.size());
+        position = filter.mEntry.mOffset + filter.mEntry.mSize;
+    }
+    if (fclose(f) != 0 || !ok) {
+        fprintf(stderr, "%s: cannot write %s\n", argv[0], path);
+        unlink(path);
+        return 1;
+    }
+    if (verbose) {
+        printf("%zu filters, %ld bytes\n", filters.size(), position);
+    }
+    return 0;
+}